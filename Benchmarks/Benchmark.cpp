@@ -0,0 +1,214 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.h"
+
+#include <algorithm>
+
+/* Runs before timing, so caches, page faults and thread pools have settled */
+#define BENCH_WARMUP_RUNS 3
+/* Bounds the runs of the fastest benchmarks */
+#define BENCH_MAX_RUNS 100000
+
+Benchmark::Benchmark (const String& name_)
+    : name (name_)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+const String& Benchmark::getName() const
+{
+    return name;
+}
+
+void Benchmark::fillSynthetic (AudioSampleBuffer& buffer, int64 firstSample)
+{
+    Random random (firstSample);
+
+    for (int chan = 0; chan < buffer.getNumChannels(); chan++)
+    {
+        float* data = buffer.getWritePointer (chan);
+        const double frequency = 5.0 + chan % 60;
+
+        for (int n = 0; n < buffer.getNumSamples(); n++)
+        {
+            const int64 sample = firstSample + n;
+            float value = 30.0f * (float) std::sin (2.0 * double_Pi * frequency * sample / BENCH_SAMPLE_RATE);
+            value += 10.0f * (random.nextFloat() - 0.5f);
+
+            // a negative spike every 100 ms, staggered across channels
+            if ((sample + chan * 37) % 3000 < 10)
+                value -= 200.0f;
+
+            data[n] = value;
+        }
+    }
+}
+
+
+BenchmarkRunner::BenchmarkRunner()
+    : minimumSeconds (0.5)
+{
+    channelCounts.add (64);
+    channelCounts.add (384);
+    channelCounts.add (1024);
+    channelCounts.add (4096);
+}
+
+void BenchmarkRunner::setChannelCounts (const Array<int>& counts)
+{
+    channelCounts = counts;
+}
+
+void BenchmarkRunner::setFilter (const String& filter_)
+{
+    filter = filter_;
+}
+
+void BenchmarkRunner::setMinimumSeconds (double seconds)
+{
+    minimumSeconds = seconds;
+}
+
+void BenchmarkRunner::run (OwnedArray<Benchmark>& benchmarks)
+{
+    results.clear();
+
+    std::cout << String ("benchmark").paddedRight (' ', 36) << String ("channels").paddedLeft (' ', 9)
+              << String ("median us").paddedLeft (' ', 12) << String ("min us").paddedLeft (' ', 12)
+              << String ("Msamples/s").paddedLeft (' ', 12) << String ("x realtime").paddedLeft (' ', 12) << std::endl;
+
+    for (auto benchmark : benchmarks)
+    {
+        if (filter.isNotEmpty() && !benchmark->getName().containsIgnoreCase (filter))
+            continue;
+
+        for (int numChannels : channelCounts)
+        {
+            BenchmarkResult result = measure (*benchmark, numChannels);
+            results.add (result);
+
+            std::cout << result.name.paddedRight (' ', 36) << String (numChannels).paddedLeft (' ', 9)
+                      << String (result.medianMicroseconds, 1).paddedLeft (' ', 12)
+                      << String (result.minMicroseconds, 1).paddedLeft (' ', 12)
+                      << String (result.samplesPerSecond / 1.0e6, 1).paddedLeft (' ', 12)
+                      << String (result.realtimeFactor, 1).paddedLeft (' ', 12) << std::endl;
+        }
+    }
+}
+
+BenchmarkResult BenchmarkRunner::measure (Benchmark& benchmark, int numChannels) const
+{
+    benchmark.prepare (numChannels);
+
+    for (int i = 0; i < BENCH_WARMUP_RUNS; i++)
+        benchmark.run();
+
+    Array<double> times;
+    int64 samples = 0;
+    double elapsed = 0;
+
+    while (elapsed < minimumSeconds && times.size() < BENCH_MAX_RUNS)
+    {
+        const int64 start = Time::getHighResolutionTicks();
+        samples += benchmark.run();
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+        times.add (seconds * 1.0e6);
+        elapsed += seconds;
+    }
+
+    benchmark.release();
+
+    std::sort (times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.name = benchmark.getName();
+    result.numChannels = numChannels;
+    result.iterations = times.size();
+    result.meanMicroseconds = elapsed * 1.0e6 / times.size();
+    result.medianMicroseconds = times[times.size() / 2];
+    result.minMicroseconds = times[0];
+    result.samplesPerSecond = elapsed > 0 ? samples * (double) numChannels / elapsed : 0;
+    result.realtimeFactor = elapsed > 0 ? samples / (elapsed * BENCH_SAMPLE_RATE) : 0;
+
+    return result;
+}
+
+const Array<BenchmarkResult>& BenchmarkRunner::getResults() const
+{
+    return results;
+}
+
+bool BenchmarkRunner::writeCsv (const File& file) const
+{
+    String csv = "benchmark,channels,iterations,mean_us,median_us,min_us,samples_per_second,realtime_factor\n";
+
+    for (const BenchmarkResult& result : results)
+    {
+        csv << result.name << "," << result.numChannels << "," << result.iterations << ","
+            << String (result.meanMicroseconds, 3) << "," << String (result.medianMicroseconds, 3) << ","
+            << String (result.minMicroseconds, 3) << "," << String (result.samplesPerSecond, 0) << ","
+            << String (result.realtimeFactor, 3) << "\n";
+    }
+
+    return file.replaceWithText (csv);
+}
+
+int BenchmarkRunner::compareWithBaseline (const File& baseline, double tolerance) const
+{
+    StringArray lines;
+    baseline.readLines (lines);
+
+    int regressions = 0;
+
+    for (int i = 1; i < lines.size(); i++)
+    {
+        StringArray fields;
+        fields.addTokens (lines[i], ",", "");
+
+        if (fields.size() < 5)
+            continue;
+
+        for (const BenchmarkResult& result : results)
+        {
+            if (result.name != fields[0] || result.numChannels != fields[1].getIntValue())
+                continue;
+
+            const double baselineMedian = fields[4].getDoubleValue();
+
+            if (baselineMedian > 0 && result.medianMicroseconds > baselineMedian * (1.0 + tolerance))
+            {
+                std::cout << "REGRESSION " << result.name << " at " << result.numChannels << " channels: "
+                          << String (result.medianMicroseconds, 1) << " us, was " << String (baselineMedian, 1)
+                          << " us" << std::endl;
+                regressions++;
+            }
+        }
+    }
+
+    return regressions;
+}
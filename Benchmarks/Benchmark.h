@@ -0,0 +1,129 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/* Synthetic data is generated at this sample rate, in blocks of this many samples */
+#define BENCH_SAMPLE_RATE 30000.0f
+#define BENCH_BLOCK_SIZE 1024
+
+/**
+    A microbenchmark of one hot path of the signal chain.
+
+    Each benchmark is prepared once for every channel count the runner is
+    given, and then run repeatedly; every run processes one block of
+    synthetic data on all channels.
+
+    @see BenchmarkRunner
+*/
+class Benchmark
+{
+public:
+    Benchmark (const String& name);
+    virtual ~Benchmark();
+
+    const String& getName() const;
+
+    /** Allocates the buffers and synthetic data for numChannels channels */
+    virtual void prepare (int numChannels) = 0;
+
+    /** Processes one block, and returns the number of samples per channel it went through */
+    virtual int run() = 0;
+
+    /** Frees what prepare() allocated */
+    virtual void release() {}
+
+    /** Fills every channel of the buffer with a noisy sine, different on each channel,
+        with a few spikes well above the noise */
+    static void fillSynthetic (AudioSampleBuffer& buffer, int64 firstSample);
+
+private:
+    const String name;
+
+    JUCE_DECLARE_NON_COPYABLE (Benchmark);
+};
+
+
+/** Times of a benchmark at one channel count */
+struct BenchmarkResult
+{
+    String name;
+    int numChannels;
+    int iterations;
+    double meanMicroseconds;    // per block
+    double medianMicroseconds;
+    double minMicroseconds;
+    double samplesPerSecond;    // samples of all channels processed per second
+    double realtimeFactor;      // how many times faster than real time at BENCH_SAMPLE_RATE
+};
+
+
+/**
+    Runs benchmarks at each channel count and reports their times, optionally
+    comparing them with those of an earlier run.
+*/
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner();
+
+    void setChannelCounts (const Array<int>& counts);
+
+    /** Only benchmarks whose names contain the filter are run */
+    void setFilter (const String& filter);
+
+    /** Each benchmark is run for at least this long at every channel count */
+    void setMinimumSeconds (double seconds);
+
+    /** Runs the benchmarks and prints a line for each result */
+    void run (OwnedArray<Benchmark>& benchmarks);
+
+    const Array<BenchmarkResult>& getResults() const;
+
+    /** Writes the results as CSV, the format compareWithBaseline() reads */
+    bool writeCsv (const File& file) const;
+
+    /** Prints the results that are slower than in the baseline CSV by more than tolerance
+        (0.1 for 10%), comparing medians, and returns how many there were */
+    int compareWithBaseline (const File& baseline, double tolerance) const;
+
+private:
+    BenchmarkResult measure (Benchmark& benchmark, int numChannels) const;
+
+    Array<int> channelCounts;
+    String filter;
+    double minimumSeconds;
+
+    Array<BenchmarkResult> results;
+};
+
+
+/* The benchmarks of each area, added in the order they are run */
+void addDataPathBenchmarks (OwnedArray<Benchmark>& benchmarks);
+void addProcessorBenchmarks (OwnedArray<Benchmark>& benchmarks);
+void addEventBenchmarks (OwnedArray<Benchmark>& benchmarks);
+
+#endif  // BENCHMARK_H_INCLUDED
@@ -0,0 +1,93 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.h"
+
+/*
+    open-ephys-bench [--channels 64,384,1024,4096] [--filter name] [--seconds 0.5]
+                     [--csv results.csv] [--baseline results.csv] [--tolerance 10]
+
+    Runs the microbenchmarks of the hot paths on synthetic data. With --baseline, the
+    medians are compared with those of an earlier --csv file, and the exit code is the
+    number of benchmarks that got slower by more than the tolerance, in percent.
+*/
+int main (int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    // as on the processing threads of the ProcessorGraph
+    FloatVectorOperations::disableDenormalisedNumberSupport();
+
+    BenchmarkRunner runner;
+    File csvFile, baselineFile;
+    double tolerance = 0.1;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const String option (argv[i]);
+        const String value (argv[i + 1]);
+
+        if (option == "--channels")
+        {
+            StringArray tokens;
+            tokens.addTokens (value, ",", "");
+
+            Array<int> counts;
+            for (const String& token : tokens)
+                if (token.getIntValue() > 0)
+                    counts.add (token.getIntValue());
+
+            runner.setChannelCounts (counts);
+        }
+        else if (option == "--filter")
+            runner.setFilter (value);
+        else if (option == "--seconds")
+            runner.setMinimumSeconds (value.getDoubleValue());
+        else if (option == "--csv")
+            csvFile = File::getCurrentWorkingDirectory().getChildFile (value);
+        else if (option == "--baseline")
+            baselineFile = File::getCurrentWorkingDirectory().getChildFile (value);
+        else if (option == "--tolerance")
+            tolerance = value.getDoubleValue() / 100.0;
+        else
+        {
+            std::cout << "Unknown option " << option << std::endl;
+            return -1;
+        }
+    }
+
+    OwnedArray<Benchmark> benchmarks;
+    addDataPathBenchmarks (benchmarks);
+    addProcessorBenchmarks (benchmarks);
+    addEventBenchmarks (benchmarks);
+
+    runner.run (benchmarks);
+
+    if (csvFile != File() && !runner.writeCsv (csvFile))
+        std::cout << "Could not write " << csvFile.getFullPathName() << std::endl;
+
+    if (baselineFile.existsAsFile())
+        return runner.compareWithBaseline (baselineFile, tolerance);
+
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.h"
+
+#include "../Source/Processors/DataThreads/DataBuffer.h"
+#include "../Source/Processors/RecordNode/DataQueue.h"
+#include "../Source/Processors/RecordNode/BinaryFormat/SequentialBlockFile.h"
+#include "../Source/Processors/RecordNode/BinaryFormat/SampleConversion.h"
+
+/* Blocks the rings and queues hold, as in a running acquisition */
+#define BENCH_RING_BLOCKS 10
+
+namespace
+{
+
+/** Accepts the blocks of a SequentialBlockFile without writing them, so the
+    benchmarks time the memory path and not the disk */
+class NullBlockOutputFile : public BlockOutputFile
+{
+public:
+    bool write (const void*, size_t) override   { return true; }
+    bool isOpen() const override                 { return true; }
+};
+
+
+/** A data thread adding interleaved frames, and the source node reading them out */
+class DataBufferBenchmark : public Benchmark
+{
+public:
+    DataBufferBenchmark (bool wholeBlock_)
+        : Benchmark (wholeBlock_ ? "DataBuffer::addBlock+read" : "DataBuffer::addToBuffer+read")
+        , wholeBlock (wholeBlock_)
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        dataBuffer = new DataBuffer (numChannels, BENCH_BLOCK_SIZE * BENCH_RING_BLOCKS);
+        output.setSize (numChannels, BENCH_BLOCK_SIZE);
+
+        AudioSampleBuffer planar (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (planar, 0);
+
+        interleaved.malloc ((size_t) numChannels * BENCH_BLOCK_SIZE);
+        for (int n = 0; n < BENCH_BLOCK_SIZE; n++)
+            for (int chan = 0; chan < numChannels; chan++)
+                interleaved[n * numChannels + chan] = planar.getSample (chan, n);
+
+        timestamps.malloc (BENCH_BLOCK_SIZE);
+        eventCodes.calloc (BENCH_BLOCK_SIZE);
+        readTimestamps.malloc (BENCH_BLOCK_SIZE);
+        readEventCodes.malloc (BENCH_BLOCK_SIZE);
+        sampleNumber = 0;
+    }
+
+    int run() override
+    {
+        for (int n = 0; n < BENCH_BLOCK_SIZE; n++)
+            timestamps[n] = sampleNumber + n;
+
+        if (wholeBlock)
+        {
+            dataBuffer->addBlock (interleaved, timestamps, eventCodes, BENCH_BLOCK_SIZE);
+        }
+        else
+        {
+            // data threads add one frame at a time
+            const int numChannels = dataBuffer->getNumChannels();
+
+            for (int n = 0; n < BENCH_BLOCK_SIZE; n++)
+                dataBuffer->addToBuffer (interleaved + n * numChannels, timestamps + n, eventCodes + n, 1);
+        }
+
+        sampleNumber += BENCH_BLOCK_SIZE;
+
+        return dataBuffer->readAllFromBuffer (output, readTimestamps, readEventCodes, BENCH_BLOCK_SIZE);
+    }
+
+    void release() override
+    {
+        dataBuffer = nullptr;
+    }
+
+private:
+    const bool wholeBlock;
+
+    ScopedPointer<DataBuffer> dataBuffer;
+    AudioSampleBuffer output;
+    HeapBlock<float> interleaved;
+    HeapBlock<int64> timestamps;
+    HeapBlock<uint64> eventCodes;
+    HeapBlock<uint64> readTimestamps;
+    HeapBlock<uint64> readEventCodes;
+    int64 sampleNumber;
+};
+
+
+/** The RecordNode queueing every channel of a block, and the RecordThread draining it */
+class DataQueueBenchmark : public Benchmark
+{
+public:
+    DataQueueBenchmark()
+        : Benchmark ("DataQueue::writeChannel+read")
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        queue = new DataQueue (BENCH_BLOCK_SIZE, BENCH_RING_BLOCKS);
+        queue->setChannels (numChannels);
+        queue->prefault();
+
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (buffer, 0);
+        timestamp = 0;
+    }
+
+    int run() override
+    {
+        for (int chan = 0; chan < buffer.getNumChannels(); chan++)
+            queue->writeChannel (buffer, chan, chan, BENCH_BLOCK_SIZE, timestamp);
+
+        timestamp += BENCH_BLOCK_SIZE;
+
+        if (queue->startRead (indexes, timestamps, BENCH_BLOCK_SIZE))
+            queue->stopRead();
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        queue = nullptr;
+    }
+
+private:
+    ScopedPointer<DataQueue> queue;
+    AudioSampleBuffer buffer;
+    Array<CircularBufferIndexes> indexes;
+    Array<int64> timestamps;
+    int64 timestamp;
+};
+
+
+/** The BinaryRecording write path: converting each channel to int16 and laying it
+    out in the interleaved blocks of the .dat file, one channel or a whole block of
+    channels at a time */
+class BlockFileBenchmark : public Benchmark
+{
+public:
+    BlockFileBenchmark (bool staged_)
+        : Benchmark (staged_ ? "BinaryRecording staged write" : "SequentialBlockFile::writeChannel")
+        , staged (staged_)
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        file = new SequentialBlockFile (numChannels, BINARY_SAMPLES_PER_BLOCK);
+        file->openFile (new NullBlockOutputFile());
+
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (buffer, 0);
+
+        converted.malloc ((size_t) numChannels * BENCH_BLOCK_SIZE);
+        position = 0;
+    }
+
+    int run() override
+    {
+        const int numChannels = buffer.getNumChannels();
+        const float multFactor = 1.0f / (float (0x7fff) * 0.195f);
+
+        for (int chan = 0; chan < numChannels; chan++)
+        {
+            int16* row = converted + chan * BENCH_BLOCK_SIZE;
+            convertFloatToInt16Scaled (buffer.getReadPointer (chan), row, multFactor, BENCH_BLOCK_SIZE);
+
+            if (!staged)
+                file->writeChannel (position, chan, row, BENCH_BLOCK_SIZE);
+        }
+
+        // the engine stages the rows of all channels and flushes them together
+        if (staged)
+            file->writeChannelBlock (position, 0, numChannels, converted, BENCH_BLOCK_SIZE, BENCH_BLOCK_SIZE);
+
+        position += BENCH_BLOCK_SIZE;
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        file = nullptr;
+    }
+
+private:
+    /* The block length of BinaryRecording's continuous files */
+    static const int BINARY_SAMPLES_PER_BLOCK = 4096;
+
+    const bool staged;
+
+    ScopedPointer<SequentialBlockFile> file;
+    AudioSampleBuffer buffer;
+    HeapBlock<int16> converted;
+    uint64 position;
+};
+
+}
+
+
+void addDataPathBenchmarks (OwnedArray<Benchmark>& benchmarks)
+{
+    benchmarks.add (new DataBufferBenchmark (false));
+    benchmarks.add (new DataBufferBenchmark (true));
+    benchmarks.add (new DataQueueBenchmark());
+    benchmarks.add (new BlockFileBenchmark (false));
+    benchmarks.add (new BlockFileBenchmark (true));
+}
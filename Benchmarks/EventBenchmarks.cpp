@@ -0,0 +1,221 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.h"
+
+#include "../Source/Processors/GenericProcessor/GenericProcessor.h"
+#include "../Source/Processors/Events/Events.h"
+
+#define BENCH_NODE_ID 100
+
+/* Lines of the TTL word of the benchmark's event channel */
+#define BENCH_TTL_LINES 8
+
+namespace
+{
+
+/** Owns the event and spike channels of the benchmarks */
+class EventSource : public GenericProcessor
+{
+public:
+    EventSource()
+        : GenericProcessor ("Benchmark source")
+    {
+        setNodeId (BENCH_NODE_ID);
+    }
+
+    void process (AudioSampleBuffer&) override {}
+};
+
+
+/** A TTL edge per channel and block, serialized into the event buffer and read back
+    by a downstream processor */
+class TTLEventBenchmark : public Benchmark
+{
+public:
+    TTLEventBenchmark (bool view_)
+        : Benchmark (view_ ? "TTL serialize+EventView" : "TTL serialize+deserialize")
+        , view (view_)
+    {
+    }
+
+    void prepare (int numChannels_) override
+    {
+        numChannels = numChannels_;
+        channel = new EventChannel (EventChannel::TTL, BENCH_TTL_LINES, 1, BENCH_SAMPLE_RATE, &source);
+        eventSize = (int) (channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE);
+        events.ensureSize ((size_t) numChannels * (eventSize + 8));
+        timestamp = 0;
+    }
+
+    int run() override
+    {
+        events.clear();
+
+        const int spacing = jmax (1, BENCH_BLOCK_SIZE / numChannels);
+
+        for (int n = 0; n < numChannels; n++)
+        {
+            const int sampleNum = jmin (n * spacing, BENCH_BLOCK_SIZE - 1);
+            uint8* data = events.addEventSpace (eventSize, sampleNum);
+            TTLEvent::serializeTTLEdge (channel, timestamp + sampleNum, (uint16) (n % BENCH_TTL_LINES), (n & 1) == 0, data, eventSize);
+        }
+
+        MidiBuffer::Iterator it (events);
+        MidiMessage message;
+        int samplePosition;
+        int high = 0;
+
+        while (it.getNextEvent (message, samplePosition))
+        {
+            if (view)
+            {
+                EventView ttl (message, channel);
+                if (ttl.isValid() && ttl.getState())
+                    high++;
+            }
+            else
+            {
+                TTLEventPtr ttl = TTLEvent::deserializeFromMessage (message, channel);
+                if (ttl != nullptr && ttl->getState())
+                    high++;
+            }
+        }
+
+        jassert (high == (numChannels + 1) / 2);
+
+        timestamp += BENCH_BLOCK_SIZE;
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        channel = nullptr;
+    }
+
+private:
+    const bool view;
+
+    EventSource source;
+    ScopedPointer<EventChannel> channel;
+    MidiBuffer events;
+    int numChannels;
+    int eventSize;
+    int64 timestamp;
+};
+
+
+/** A spike per tetrode and block, serialized with its waveform and deserialized
+    by a downstream processor */
+class SpikeEventBenchmark : public Benchmark
+{
+public:
+    SpikeEventBenchmark()
+        : Benchmark ("Spike serialize+deserialize")
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        for (int chan = 0; chan < 4; chan++)
+            dataChannels.add (new DataChannel (DataChannel::HEADSTAGE_CHANNEL, BENCH_SAMPLE_RATE, &source));
+
+        Array<const DataChannel*> tetrode;
+        for (auto dataChannel : dataChannels)
+            tetrode.add (dataChannel);
+
+        channel = new SpikeChannel (SpikeChannel::typeFromNumChannels (4), &source, tetrode);
+        channel->setNumSamples (8, 32);
+
+        waveform = new SpikeEvent::SpikeBuffer (channel);
+        AudioSampleBuffer shape (4, 40);
+        fillSynthetic (shape, 0);
+        for (int chan = 0; chan < 4; chan++)
+            waveform->set (chan, shape.getReadPointer (chan), 40);
+
+        for (int chan = 0; chan < 4; chan++)
+            thresholds[chan] = -50.0f;
+
+        numSpikes = jmax (1, numChannels / 4);
+        spikeSize = (int) (channel->getDataSize() + channel->getTotalEventMetaDataSize() + SPIKE_BASE_SIZE + 4 * sizeof (float));
+        events.ensureSize ((size_t) numSpikes * (spikeSize + 8));
+        timestamp = 0;
+    }
+
+    int run() override
+    {
+        events.clear();
+
+        const int spacing = jmax (1, BENCH_BLOCK_SIZE / numSpikes);
+
+        for (int n = 0; n < numSpikes; n++)
+        {
+            const int sampleNum = jmin (n * spacing, BENCH_BLOCK_SIZE - 1);
+            uint8* data = events.addEventSpace (spikeSize, sampleNum);
+            SpikeEvent::serializeSpikeEvent (channel, timestamp + sampleNum, thresholds, *waveform, 0, nullptr, data, spikeSize);
+        }
+
+        MidiBuffer::Iterator it (events);
+        MidiMessage message;
+        int samplePosition;
+
+        while (it.getNextEvent (message, samplePosition))
+        {
+            SpikeEventPtr spike = SpikeEvent::deserializeFromMessage (message, channel);
+            jassert (spike != nullptr);
+        }
+
+        timestamp += BENCH_BLOCK_SIZE;
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        waveform = nullptr;
+        channel = nullptr;
+        dataChannels.clear();
+    }
+
+private:
+    EventSource source;
+    OwnedArray<DataChannel> dataChannels;
+    ScopedPointer<SpikeChannel> channel;
+    ScopedPointer<SpikeEvent::SpikeBuffer> waveform;
+    float thresholds[4];
+    MidiBuffer events;
+    int numSpikes;
+    int spikeSize;
+    int64 timestamp;
+};
+
+}
+
+
+void addEventBenchmarks (OwnedArray<Benchmark>& benchmarks)
+{
+    benchmarks.add (new TTLEventBenchmark (false));
+    benchmarks.add (new TTLEventBenchmark (true));
+    benchmarks.add (new SpikeEventBenchmark());
+}
@@ -0,0 +1,284 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.h"
+
+#include "../Source/Processors/Dsp/Dsp.h"
+#include "../Source/Processors/Events/SpikeStore.h"
+#include "../Plugins/CAR/CAR.h"
+#include "../Plugins/BasicSpikeDisplay/SpikeDetector/SpikeDetector.h"
+
+/* The node id of the processors run outside a ProcessorGraph */
+#define BENCH_NODE_ID 100
+
+namespace
+{
+
+/** The band pass the FilterNode applies by default */
+const double FILTER_LOW_CUT = 300.0;
+const double FILTER_HIGH_CUT = 6000.0;
+
+
+/** One SmoothedFilterDesign per channel, the way the FilterNode ran its filters
+    before they were grouped into cascades */
+class SmoothedFilterBenchmark : public Benchmark
+{
+public:
+    SmoothedFilterBenchmark()
+        : Benchmark ("SmoothedFilterDesign bandpass")
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (buffer, 0);
+
+        Dsp::Params params;
+        params[0] = BENCH_SAMPLE_RATE;
+        params[1] = 2; // order
+        params[2] = (FILTER_HIGH_CUT + FILTER_LOW_CUT) / 2;
+        params[3] = FILTER_HIGH_CUT - FILTER_LOW_CUT;
+
+        for (int chan = 0; chan < numChannels; chan++)
+        {
+            Dsp::Filter* filter = new Dsp::SmoothedFilterDesign<Dsp::Butterworth::Design::BandPass<2>, 1> (1024);
+            filter->setParams (params);
+            filters.add (filter);
+        }
+    }
+
+    int run() override
+    {
+        float* const* channels = buffer.getArrayOfWritePointers();
+
+        for (int chan = 0; chan < filters.size(); chan++)
+            filters[chan]->process (BENCH_BLOCK_SIZE, channels + chan);
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        filters.clear();
+    }
+
+private:
+    AudioSampleBuffer buffer;
+    OwnedArray<Dsp::Filter> filters;
+};
+
+
+/** The same band pass on all channels in one MultichannelCascade, as the FilterNode runs it */
+class MultichannelCascadeBenchmark : public Benchmark
+{
+public:
+    MultichannelCascadeBenchmark (Dsp::MultichannelCascade::Precision precision_)
+        : Benchmark (precision_ == Dsp::MultichannelCascade::SinglePrecision ? "MultichannelCascade bandpass (float)"
+                                                                              : "MultichannelCascade bandpass")
+        , precision (precision_)
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (buffer, 0);
+
+        Dsp::Butterworth::BandPass<2> design;
+        design.setup (2, BENCH_SAMPLE_RATE, (FILTER_HIGH_CUT + FILTER_LOW_CUT) / 2, FILTER_HIGH_CUT - FILTER_LOW_CUT);
+
+        cascade = new Dsp::MultichannelCascade();
+        cascade->setNumChannels (numChannels);
+        cascade->setDenormalPrevention (false);
+        cascade->setPrecision (precision);
+
+        for (int chan = 0; chan < numChannels; chan++)
+            cascade->setChannelCascade (chan, design);
+    }
+
+    int run() override
+    {
+        cascade->process (BENCH_BLOCK_SIZE, buffer.getArrayOfWritePointers());
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        cascade = nullptr;
+    }
+
+private:
+    const Dsp::MultichannelCascade::Precision precision;
+
+    AudioSampleBuffer buffer;
+    ScopedPointer<Dsp::MultichannelCascade> cascade;
+};
+
+
+/** Common average referencing of every channel against all of them */
+class CARBenchmark : public Benchmark
+{
+public:
+    CARBenchmark (CAR::ReferenceMode mode_)
+        : Benchmark (mode_ == CAR::MEDIAN_REFERENCE ? "CAR::process (median)" : "CAR::process (mean)")
+        , mode (mode_)
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        fillSynthetic (buffer, 0);
+
+        Array<int> channels;
+        for (int chan = 0; chan < numChannels; chan++)
+            channels.add (chan);
+
+        car = new CAR();
+        car->settings.numInputs = car->settings.numOutputs = numChannels;
+        car->updateSettings();
+        car->setReferenceMode (mode);
+        car->setGainLevel (100.0f);
+        car->setReferenceChannels (channels);
+        car->setAffectedChannels (channels);
+    }
+
+    int run() override
+    {
+        car->process (buffer);
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        car = nullptr;
+    }
+
+private:
+    const CAR::ReferenceMode mode;
+
+    AudioSampleBuffer buffer;
+    ScopedPointer<CAR> car;
+};
+
+
+/** A SpikeDetector with tetrodes on all of its channels, set up without a signal chain:
+    it holds its input channels itself, and stamps every block with its own clock as the
+    source node would */
+class StandaloneSpikeDetector : public SpikeDetector
+{
+public:
+    StandaloneSpikeDetector (int numChannels)
+        : timestamp (0)
+    {
+        setNodeId (BENCH_NODE_ID);
+
+        for (int chan = 0; chan < numChannels; chan++)
+            dataChannelArray.add (new DataChannel (DataChannel::HEADSTAGE_CHANNEL, BENCH_SAMPLE_RATE, this));
+
+        settings.numInputs = settings.numOutputs = numChannels;
+
+        for (int chan = 0; chan + 4 <= numChannels; chan += 4)
+            addElectrode (4);
+
+        createSpikeChannels();
+        updateSettings();
+        updateChannelIndexes();
+        enable();
+    }
+
+    void process (AudioSampleBuffer& buffer) override
+    {
+        setTimestampAndSamples (timestamp, buffer.getNumSamples());
+        timestamp += buffer.getNumSamples();
+
+        SpikeDetector::process (buffer);
+    }
+
+private:
+    int64 timestamp;
+};
+
+
+class SpikeDetectorBenchmark : public Benchmark
+{
+public:
+    SpikeDetectorBenchmark()
+        : Benchmark ("SpikeDetector::process")
+        , sampleNumber (0)
+    {
+    }
+
+    void prepare (int numChannels) override
+    {
+        SpikeStore::getInstance()->start();
+
+        detector = new StandaloneSpikeDetector (numChannels);
+        buffer.setSize (numChannels, BENCH_BLOCK_SIZE);
+        sampleNumber = 0;
+    }
+
+    int run() override
+    {
+        // new data every block, so the spikes move across block boundaries
+        fillSynthetic (buffer, sampleNumber);
+        sampleNumber += BENCH_BLOCK_SIZE;
+
+        SpikeStore::getInstance()->startBlock();
+        events.clear();
+
+        // through the entry point the ProcessorGraph calls
+        AudioProcessor& processor = *detector;
+        processor.processBlock (buffer, events);
+
+        return BENCH_BLOCK_SIZE;
+    }
+
+    void release() override
+    {
+        detector = nullptr;
+        SpikeStore::getInstance()->stop();
+    }
+
+private:
+    ScopedPointer<StandaloneSpikeDetector> detector;
+    AudioSampleBuffer buffer;
+    MidiBuffer events;
+    int64 sampleNumber;
+};
+
+}
+
+
+void addProcessorBenchmarks (OwnedArray<Benchmark>& benchmarks)
+{
+    benchmarks.add (new SmoothedFilterBenchmark());
+    benchmarks.add (new MultichannelCascadeBenchmark (Dsp::MultichannelCascade::DoublePrecision));
+    benchmarks.add (new MultichannelCascadeBenchmark (Dsp::MultichannelCascade::SinglePrecision));
+    benchmarks.add (new CARBenchmark (CAR::MEAN_REFERENCE));
+    benchmarks.add (new CARBenchmark (CAR::MEDIAN_REFERENCE));
+    benchmarks.add (new SpikeDetectorBenchmark());
+}
@@ -134,6 +134,22 @@ void MidiBuffer::addEvent (const void* const newData, const int maxBytes, const
     }
 }
 
+// <Open-Ephys>
+uint8* MidiBuffer::addEventSpace (const int numBytes, const int sampleNumber)
+{
+    jassert (numBytes > 0);
+
+    const size_t newItemSize = (size_t) numBytes + sizeof (int32) + sizeof (uint16);
+    const int offset = (int) (MidiBufferHelpers::findEventAfter (data.begin(), data.end(), sampleNumber) - data.begin());
+
+    data.insertMultiple (offset, 0, (int) newItemSize);
+
+    uint8* const d = data.begin() + offset;
+    writeUnaligned<int32>  (d, sampleNumber);
+    writeUnaligned<uint16> (d + 4, static_cast<uint16> (numBytes));
+    return d + 6;
+}
+
 void MidiBuffer::addEvents (const MidiBuffer& otherBuffer,
                             const int startSample,
                             const int numSamples,
@@ -116,6 +116,14 @@ public:
                    int maxBytesOfMidiData,
                    int sampleNumber);
 
+    // <Open-Ephys>
+    /** Adds an event of numBytes bytes and returns where its data goes, so it can be
+        written in place instead of being copied in.
+
+        The returned pointer is only valid until the buffer is next modified.
+    */
+    uint8* addEventSpace (int numBytes, int sampleNumber);
+
     /** Adds some events from another buffer to this one.
 
         @param otherBuffer          the buffer containing the events you want to add
@@ -23,6 +23,7 @@
 */
 
 const int AudioProcessorGraph::midiChannelIndex = 0x8000;
+const Identifier AudioProcessorGraph::readOnlyInputProperty ("readOnlyInput");
 
 //==============================================================================
 template <typename FloatType, typename Impl> struct FloatDoubleUtil {};
@@ -58,11 +59,43 @@ template <typename FloatingType> struct FloatDoubleType<AudioBuffer<FloatPlaceho
 namespace GraphRenderingOps
 {
 
+//Open ephys modification
+/** The shared buffers read and written by rendering ops, used to find the nodes that can be
+    rendered at the same time. Index 0 of both kinds is the read-only empty buffer, and
+    graphIOBuffer stands for the graph's own input and output buffers. */
+struct RenderBufferAccess
+{
+    enum { graphIOBuffer = -1 };
+
+    SortedSet<int> audioRead, audioWritten, midiRead, midiWritten;
+
+    static bool overlap (const SortedSet<int>& a, const SortedSet<int>& b)
+    {
+        for (int i = 0; i < a.size(); ++i)
+            if (a.getUnchecked (i) != 0 && b.contains (a.getUnchecked (i)))
+                return true;
+
+        return false;
+    }
+
+    /** True if the two sets of ops have to run in order: one writes a buffer the other uses */
+    bool conflictsWith (const RenderBufferAccess& other) const
+    {
+        return overlap (audioWritten, other.audioRead) || overlap (audioWritten, other.audioWritten)
+            || overlap (audioRead, other.audioWritten)
+            || overlap (midiWritten, other.midiRead) || overlap (midiWritten, other.midiWritten)
+            || overlap (midiRead, other.midiWritten);
+    }
+};
+
 struct AudioGraphRenderingOpBase
 {
     AudioGraphRenderingOpBase() noexcept {}
     virtual ~AudioGraphRenderingOpBase() {}
 
+    //Open ephys modification
+    virtual void addBufferAccess (RenderBufferAccess& access) const = 0;
+
     virtual void perform (AudioBuffer<float>& sharedBufferChans,
                           const OwnedArray<MidiBuffer>& sharedMidiBuffers,
                           const int numSamples) = 0;
@@ -104,6 +137,8 @@ struct ClearChannelOp  : public AudioGraphRenderingOp<ClearChannelOp>
         sharedBufferChans.clear (channelNum, 0, numSamples);
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override    { access.audioWritten.add (channelNum); }
+
     const int channelNum;
 
     JUCE_DECLARE_NON_COPYABLE (ClearChannelOp)
@@ -122,6 +157,12 @@ struct CopyChannelOp  : public AudioGraphRenderingOp<CopyChannelOp>
         sharedBufferChans.copyFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        access.audioRead.add (srcChannelNum);
+        access.audioWritten.add (dstChannelNum);
+    }
+
     const int srcChannelNum, dstChannelNum;
 
     JUCE_DECLARE_NON_COPYABLE (CopyChannelOp)
@@ -140,6 +181,12 @@ struct AddChannelOp  : public AudioGraphRenderingOp<AddChannelOp>
         sharedBufferChans.addFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        access.audioRead.add (srcChannelNum);
+        access.audioWritten.add (dstChannelNum);
+    }
+
     const int srcChannelNum, dstChannelNum;
 
     JUCE_DECLARE_NON_COPYABLE (AddChannelOp)
@@ -156,6 +203,8 @@ struct ClearMidiBufferOp  : public AudioGraphRenderingOp<ClearMidiBufferOp>
         sharedMidiBuffers.getUnchecked (bufferNum)->clear();
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override    { access.midiWritten.add (bufferNum); }
+
     const int bufferNum;
 
     JUCE_DECLARE_NON_COPYABLE (ClearMidiBufferOp)
@@ -174,6 +223,12 @@ struct CopyMidiBufferOp  : public AudioGraphRenderingOp<CopyMidiBufferOp>
         *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        access.midiRead.add (srcBufferNum);
+        access.midiWritten.add (dstBufferNum);
+    }
+
     const int srcBufferNum, dstBufferNum;
 
     JUCE_DECLARE_NON_COPYABLE (CopyMidiBufferOp)
@@ -193,6 +248,12 @@ struct AddMidiBufferOp  : public AudioGraphRenderingOp<AddMidiBufferOp>
             ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        access.midiRead.add (srcBufferNum);
+        access.midiWritten.add (dstBufferNum);
+    }
+
     const int srcBufferNum, dstBufferNum;
 
     JUCE_DECLARE_NON_COPYABLE (AddMidiBufferOp)
@@ -226,6 +287,12 @@ struct DelayChannelOp  : public AudioGraphRenderingOp<DelayChannelOp>
         }
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        access.audioRead.add (channel);
+        access.audioWritten.add (channel);
+    }
+
 private:
     FloatAndDoubleComposition<HeapBlock<FloatPlaceholder> > buffer;
     const int channel, bufferSize;
@@ -240,12 +307,14 @@ struct ProcessBufferOp   : public AudioGraphRenderingOp<ProcessBufferOp>
     ProcessBufferOp (const AudioProcessorGraph::Node::Ptr& n,
                      const Array<int>& audioChannelsUsed,
                      const int totalNumChans,
-                     const int midiBuffer)
+                     const int midiBuffer,
+                     const int numReadOnlyChannels = 0)
         : node (n),
           processor (n->getProcessor()),
           audioChannelsToUse (audioChannelsUsed),
           totalChans (jmax (1, totalNumChans)),
-          midiBufferToUse (midiBuffer)
+          midiBufferToUse (midiBuffer),
+          numReadOnlyChans (numReadOnlyChannels)
     {
         audioChannels.floatVersion. calloc ((size_t) totalChans);
         audioChannels.doubleVersion.calloc ((size_t) totalChans);
@@ -267,6 +336,24 @@ struct ProcessBufferOp   : public AudioGraphRenderingOp<ProcessBufferOp>
         callProcess (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
     }
 
+    void addBufferAccess (RenderBufferAccess& access) const override
+    {
+        for (int i = 0; i < totalChans; ++i)
+        {
+            access.audioRead.add (audioChannelsToUse.getUnchecked (i));
+
+            // the input channels of a read-only node can be read by other branches at the same time
+            if (i >= numReadOnlyChans)
+                access.audioWritten.add (audioChannelsToUse.getUnchecked (i));
+        }
+
+        access.midiRead.add (midiBufferToUse);
+        access.midiWritten.add (midiBufferToUse);
+
+        if (dynamic_cast<AudioProcessorGraph::AudioGraphIOProcessor*> (processor) != nullptr)
+            access.audioWritten.add (RenderBufferAccess::graphIOBuffer);
+    }
+
     void callProcess (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
     {
         processor->processBlock (buffer, midiMessages);
@@ -299,6 +386,7 @@ private:
     AudioBuffer<float> tempBuffer;
     const int totalChans;
     const int midiBufferToUse;
+    const int numReadOnlyChans;
 
     JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
 };
@@ -311,7 +399,8 @@ struct RenderingOpSequenceCalculator
 {
     RenderingOpSequenceCalculator (AudioProcessorGraph& g,
                                    const Array<AudioProcessorGraph::Node*>& nodes,
-                                   Array<void*>& renderingOps)
+                                   Array<void*>& renderingOps,
+                                   Array<int>& nodeFirstOps)
         : graph (g),
           orderedNodes (nodes),
           totalLatency (0)
@@ -321,8 +410,11 @@ struct RenderingOpSequenceCalculator
 
         midiNodeIds.add ((uint32) zeroNodeID);
 
+        calculateLastReadSteps();
+
         for (int i = 0; i < orderedNodes.size(); ++i)
         {
+            nodeFirstOps.add (renderingOps.size());
             createRenderingOpsForNode (*orderedNodes.getUnchecked(i), renderingOps, i);
             markAnyUnusedBuffersAsFree (i);
         }
@@ -340,6 +432,47 @@ private:
     Array<int> channels;
     Array<uint32> nodeIds, midiNodeIds;
 
+    // output channels of read-only nodes, and the channel whose buffer they are found in
+    HashMap<int64, int64> sharedChannelSources;
+
+    //Open ephys modification
+    // the last step that reads each output channel, so the lifetime of a buffer is known without
+    // searching the rest of the graph for every channel
+    HashMap<int64, int> lastReadSteps;
+
+    static int64 getChannelKey (uint32 nodeId, int channel) noexcept
+    {
+        return (int64) (((uint64) nodeId << 32) | (uint32) channel);
+    }
+
+    void calculateLastReadSteps()
+    {
+        HashMap<int, int> nodeSteps;
+
+        for (int i = 0; i < orderedNodes.size(); ++i)
+            nodeSteps.set ((int) orderedNodes.getUnchecked(i)->nodeId, i);
+
+        for (int i = graph.getNumConnections(); --i >= 0;)
+        {
+            const AudioProcessorGraph::Connection* const c = graph.getConnection (i);
+
+            if (! nodeSteps.contains ((int) c->destNodeId))
+                continue;
+
+            const int step = nodeSteps[(int) c->destNodeId];
+
+            // channels beyond the inputs of a node are never read by it
+            if (c->destChannelIndex != AudioProcessorGraph::midiChannelIndex
+                 && c->destChannelIndex >= orderedNodes.getUnchecked (step)->getProcessor()->getTotalNumInputChannels())
+                continue;
+
+            const int64 key = getChannelKey (c->sourceNodeId, c->sourceChannelIndex);
+
+            if (! lastReadSteps.contains (key) || lastReadSteps[key] < step)
+                lastReadSteps.set (key, step);
+        }
+    }
+
     enum { freeNodeID = 0xffffffff, zeroNodeID = 0xfffffffe };
 
     static bool isNodeBusy (uint32 nodeID) noexcept     { return nodeID != freeNodeID && nodeID != zeroNodeID; }
@@ -400,8 +533,14 @@ private:
 
         bool isBufferNeededLaterOverride = false;
 
+        // Open ephys modification: nodes that only read their input channels don't need a copy
+        // of a channel that's needed later by another node
+        const bool readOnly = node.properties [AudioProcessorGraph::readOnlyInputProperty];
+
         for (int inputChan = 0; inputChan < numIns; ++inputChan)
         {
+            bool sharedInput = false;
+
             // get a list of all the inputs to this node
             Array<uint32> sourceNodes;
             Array<int> sourceOutputChans;
@@ -468,20 +607,30 @@ private:
                     */
                 }
 
+                const int nodeDelay = getNodeDelay (srcNode);
+
                 if (inputChan < numOuts
                      && isBufferNeededLaterOverride)
                 {
-                    // can't mess up this channel because it's needed later by another node, so we
-                    // need to use a copy of it..
-                    const int newFreeBuffer = getFreeBuffer (false);
+                    if (readOnly && nodeDelay >= maxLatency)
+                    {
+                        // the node leaves this channel unchanged, so it can read the source's
+                        // buffer in place, and its output is found in the same buffer
+                        markBufferAsShared (node.nodeId, inputChan, srcNode, srcChan);
+                        sharedInput = true;
+                    }
+                    else
+                    {
+                        // can't mess up this channel because it's needed later by another node, so we
+                        // need to use a copy of it..
+                        const int newFreeBuffer = getFreeBuffer (false);
 
-                    renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
+                        renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
 
-                    bufIndex = newFreeBuffer;
+                        bufIndex = newFreeBuffer;
+                    }
                 }
 
-                const int nodeDelay = getNodeDelay (srcNode);
-
                 if (nodeDelay < maxLatency)
                     renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
             }
@@ -610,7 +759,7 @@ private:
             jassert (bufIndex >= 0);
             audioChannelsToUse.add (bufIndex);
 
-            if (inputChan < numOuts)
+            if (inputChan < numOuts && ! sharedInput)
                 markBufferAsContaining (bufIndex, node.nodeId, inputChan);
         }
 
@@ -740,7 +889,8 @@ private:
             totalLatency = maxLatency;
 
         renderingOps.add (new ProcessBufferOp (&node, audioChannelsToUse,
-                                               totalChans, midiBufferToUse));
+                                               totalChans, midiBufferToUse,
+                                               readOnly ? numIns : 0));
     }
 
     //==============================================================================
@@ -772,7 +922,35 @@ private:
         return 0;
     }
 
-    int getBufferContaining (const uint32 nodeId, const int outputChannel) const noexcept
+    void markBufferAsShared (uint32 nodeId, int outputIndex, uint32 sourceNodeId, int sourceOutputIndex)
+    {
+        resolveSharedChannel (sourceNodeId, sourceOutputIndex);
+
+        const int64 key = getChannelKey (nodeId, outputIndex);
+        const int64 sourceKey = getChannelKey (sourceNodeId, sourceOutputIndex);
+
+        sharedChannelSources.set (key, sourceKey);
+
+        // the buffer now lives until the last node reading either channel
+        if (lastReadSteps.contains (key)
+             && (! lastReadSteps.contains (sourceKey) || lastReadSteps[sourceKey] < lastReadSteps[key]))
+            lastReadSteps.set (sourceKey, lastReadSteps[key]);
+    }
+
+    /** Follows read-only nodes back to the node whose output channel actually owns the buffer */
+    void resolveSharedChannel (uint32& nodeId, int& outputChannel) const noexcept
+    {
+        const int64 key = getChannelKey (nodeId, outputChannel);
+
+        if (sharedChannelSources.contains (key))
+        {
+            const int64 sourceKey = sharedChannelSources[key];
+            nodeId = (uint32) ((uint64) sourceKey >> 32);
+            outputChannel = (int) (uint32) sourceKey;
+        }
+    }
+
+    int getBufferContaining (uint32 nodeId, int outputChannel) const noexcept
     {
         if (outputChannel == AudioProcessorGraph::midiChannelIndex)
         {
@@ -782,6 +960,8 @@ private:
         }
         else
         {
+            resolveSharedChannel (nodeId, outputChannel);
+
             for (int i = nodeIds.size(); --i >= 0;)
                 if (nodeIds.getUnchecked(i) == nodeId
                      && channels.getUnchecked(i) == outputChannel)
@@ -793,37 +973,11 @@ private:
 
     void markAnyUnusedBuffersAsFree (const int stepIndex)
     {
-
-        //enum { freeNodeID = 0xffffffff, zeroNodeID = 0xfffffffe };
-
-        bool isBufferNeededLaterOverride = false;
-
+        // with the last reader of each channel known, every buffer's lifetime is checked on its own
         for (int i = 0; i < nodeIds.size(); ++i)
         {
-
-            if (channels.getUnchecked(i) == 0)
-            {
-                isBufferNeededLaterOverride = isBufferNeededLater (stepIndex, -1,
-                                           nodeIds.getUnchecked(i),
-                                           channels.getUnchecked(i));
-
-                /*
-                //If node is in first branch after the splitter, isBufferNeededLater = true 
-                //Else if node is in second branch after a splitter, isBufferNeededLater = false
-                String name = "???";
-                if (nodeIds.getUnchecked(i) >= 100 && nodeIds.getUnchecked(i) < 200)
-                    name = graph.getNodeForId(nodeIds.getUnchecked(i))->getProcessor()->getName();
-                else if (nodeIds.getUnchecked(i) == (uint32)freeNodeID)
-                    name = "Free Node";
-                else if (nodeIds.getUnchecked(i) == (uint32)zeroNodeID)
-                    name = "Zero Node";
-                
-                std::cout << "[markAnyUnusedBuffersAsFree:781] Node: " << name << " channel: " << channels.getUnchecked(i) << " isBufferNeededLater: " << isBufferNeededLaterOverride << std::endl;
-                */
-            }
-
             if (isNodeBusy (nodeIds.getUnchecked(i))
-                 && ! isBufferNeededLaterOverride)
+                 && ! isBufferNeededLater (stepIndex, -1, nodeIds.getUnchecked(i), channels.getUnchecked(i)))
             {
                 nodeIds.set (i, (uint32) freeNodeID);
             }
@@ -858,33 +1012,46 @@ private:
 
     bool isBufferNeededLater (int stepIndexToSearchFrom,
                               int inputChannelOfIndexToIgnore,
-                              const uint32 nodeId,
-                              const int outputChanIndex) const
+                              uint32 nodeId,
+                              int outputChanIndex) const
     {
-        while (stepIndexToSearchFrom < orderedNodes.size())
+        if (outputChanIndex != AudioProcessorGraph::midiChannelIndex)
+            resolveSharedChannel (nodeId, outputChanIndex);
+
+        const int64 key = getChannelKey (nodeId, outputChanIndex);
+
+        if (! lastReadSteps.contains (key))
+            return false;
+
+        const int lastStep = lastReadSteps[key];
+
+        if (lastStep != stepIndexToSearchFrom || inputChannelOfIndexToIgnore < 0)
+            return lastStep >= stepIndexToSearchFrom;
+
+        // the node being rendered is the last to read the channel, so it's only needed later
+        // if the node also reads it through an input other than the one being connected
+        const AudioProcessorGraph::Node* const node = orderedNodes.getUnchecked (lastStep);
+
+        if (outputChanIndex == AudioProcessorGraph::midiChannelIndex)
+            return inputChannelOfIndexToIgnore != AudioProcessorGraph::midiChannelIndex;
+
+        const int numInputChannels = node->getProcessor()->getTotalNumInputChannels();
+
+        for (int i = graph.getNumConnections(); --i >= 0;)
         {
-            const AudioProcessorGraph::Node* const node = (const AudioProcessorGraph::Node*) orderedNodes.getUnchecked (stepIndexToSearchFrom);
+            const AudioProcessorGraph::Connection* const c = graph.getConnection (i);
 
-            if (outputChanIndex == AudioProcessorGraph::midiChannelIndex)
-            {
-                if (inputChannelOfIndexToIgnore != AudioProcessorGraph::midiChannelIndex
-                     && graph.getConnectionBetween (nodeId, AudioProcessorGraph::midiChannelIndex,
-                                                    node->nodeId, AudioProcessorGraph::midiChannelIndex) != nullptr)
-                    return true;
-            }
-            else
-            {
-				//Open ephys modification
-				unsigned int numInputChannels = node->getProcessor()->getTotalNumInputChannels();
-                for (int i = 0; i < numInputChannels; ++i)
-                    if (i != inputChannelOfIndexToIgnore
-                         && graph.getConnectionBetween (nodeId, outputChanIndex,
-                                                        node->nodeId, i) != nullptr)
-                        return true;
-            }
+            if (c->destNodeId != node->nodeId
+                 || c->destChannelIndex == inputChannelOfIndexToIgnore
+                 || c->destChannelIndex >= numInputChannels)
+                continue;
 
-            inputChannelOfIndexToIgnore = -1;
-            ++stepIndexToSearchFrom;
+            uint32 sourceNodeId = c->sourceNodeId;
+            int sourceChannel = c->sourceChannelIndex;
+            resolveSharedChannel (sourceNodeId, sourceChannel);
+
+            if (sourceNodeId == nodeId && sourceChannel == outputChanIndex)
+                return true;
         }
 
         return false;
@@ -1106,13 +1273,43 @@ struct AudioProcessorGraph::AudioProcessorGraphBufferHelpers
         currentAudioInputBuffer.doubleVersion = nullptr;
     }
 
-    void setRenderingBufferSize (int newNumChannels, int newNumSamples)
+    //Open ephys modification
+    /** Only the precision the graph processes in is allocated, and each channel starts on a
+        cache line, so neighbouring channels processed by different threads don't share one */
+    void setRenderingBufferSize (int newNumChannels, int newNumSamples, bool doublePrecision)
+    {
+        if (doublePrecision)
+        {
+            renderingBuffers.floatVersion.setSize (1, 1);
+            allocateAligned (renderingBuffers.doubleVersion, doubleRenderingData,
+                             renderingChannels.doubleVersion, newNumChannels, newNumSamples);
+        }
+        else
+        {
+            renderingBuffers.doubleVersion.setSize (1, 1);
+            allocateAligned (renderingBuffers.floatVersion, floatRenderingData,
+                             renderingChannels.floatVersion, newNumChannels, newNumSamples);
+        }
+    }
+
+    template <typename FloatType>
+    static void allocateAligned (AudioBuffer<FloatType>& buffer, HeapBlock<char>& data,
+                                 HeapBlock<FloatType*>& channels, int numChannels, int numSamples)
     {
-        renderingBuffers.floatVersion. setSize (newNumChannels, newNumSamples);
-        renderingBuffers.doubleVersion.setSize (newNumChannels, newNumSamples);
+        const size_t alignment = 64;
+        const size_t stride = ((size_t) numSamples * sizeof (FloatType) + alignment - 1) & ~(alignment - 1);
+
+        data.calloc (stride * (size_t) numChannels + alignment);
+        channels.malloc ((size_t) numChannels + 1);
+
+        char* const start = data + ((alignment - ((size_t) (pointer_sized_int) data.getData() & (alignment - 1))) & (alignment - 1));
+
+        for (int i = 0; i < numChannels; ++i)
+            channels[i] = reinterpret_cast<FloatType*> (start + stride * (size_t) i);
+
+        channels[numChannels] = nullptr;
 
-        renderingBuffers.floatVersion. clear();
-        renderingBuffers.doubleVersion.clear();
+        buffer.setDataToReferTo (channels, numChannels, numSamples);
     }
 
     void release()
@@ -1120,6 +1317,11 @@ struct AudioProcessorGraph::AudioProcessorGraphBufferHelpers
         renderingBuffers.floatVersion. setSize (1, 1);
         renderingBuffers.doubleVersion.setSize (1, 1);
 
+        floatRenderingData. free();
+        doubleRenderingData.free();
+        renderingChannels.floatVersion. free();
+        renderingChannels.doubleVersion.free();
+
         currentAudioInputBuffer.floatVersion  = nullptr;
         currentAudioInputBuffer.doubleVersion = nullptr;
 
@@ -1137,14 +1339,301 @@ struct AudioProcessorGraph::AudioProcessorGraphBufferHelpers
     }
 
     FloatAndDoubleComposition<AudioBuffer<FloatPlaceholder> > renderingBuffers;
+    HeapBlock<char> floatRenderingData, doubleRenderingData;
+    FloatAndDoubleComposition<HeapBlock<FloatPlaceholder*> > renderingChannels;
     FloatAndDoubleComposition<AudioBuffer<FloatPlaceholder>*> currentAudioInputBuffer;
     FloatAndDoubleComposition<AudioBuffer<FloatPlaceholder> > currentAudioOutputBuffer;
 };
 
+//==============================================================================
+//Open ephys modification
+/** Renders nodes that don't share any buffers on several threads.
+
+    The ops of each node form a step, which can start once every earlier step using one
+    of its buffers has finished, so the output is the same as rendering the ops in order.
+    The audio thread renders steps as well, and returns once all of them are done.
+    Threads with nothing to render sleep until a step becomes ready or the block ends.
+*/
+struct AudioProcessorGraph::ParallelRenderer
+{
+    struct Step
+    {
+        int firstOp, numOps;
+        int numDependencies;
+        Array<int> dependents;
+        int pending;
+    };
+
+    /** The steps of a rendering sequence */
+    struct Plan
+    {
+        OwnedArray<Step> steps;
+        HeapBlock<int> readySteps;
+        bool hasParallelSteps;
+    };
+
+    class Worker  : public Thread
+    {
+    public:
+        Worker (ParallelRenderer& r)  : Thread ("Graph Renderer"), owner (r) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                if (! blockStarted.wait (100))
+                    continue;
+
+                ++owner.activeWorkers;
+
+                if (owner.running.get() != 0)
+                    owner.renderSteps (stepReady);
+
+                if (--owner.activeWorkers == 0)
+                    owner.workersFinished.signal();
+            }
+        }
+
+        WaitableEvent blockStarted, stepReady;
+
+    private:
+        ParallelRenderer& owner;
+
+        JUCE_DECLARE_NON_COPYABLE (Worker)
+    };
+
+    ParallelRenderer()  : ops (nullptr), audioBuffers (nullptr), midiBuffers (nullptr),
+                          numSamples (0), doublePrecision (false),
+                          readyHead (0), readyTail (0), numCompleted (0), numIdle (0)
+    {
+    }
+
+    ~ParallelRenderer()
+    {
+        workers.clear();
+    }
+
+    static Plan* createPlan (const Array<void*>& renderingOps, const Array<int>& nodeFirstOps)
+    {
+        Plan* const plan = new Plan();
+        OwnedArray<GraphRenderingOps::RenderBufferAccess> access;
+
+        for (int i = 0; i < nodeFirstOps.size(); ++i)
+        {
+            Step* const step = plan->steps.add (new Step());
+            step->firstOp = nodeFirstOps.getUnchecked (i);
+            step->numOps = (i + 1 < nodeFirstOps.size() ? nodeFirstOps.getUnchecked (i + 1)
+                                                        : renderingOps.size()) - step->firstOp;
+            step->numDependencies = 0;
+
+            GraphRenderingOps::RenderBufferAccess* const stepAccess = access.add (new GraphRenderingOps::RenderBufferAccess());
+
+            for (int op = step->firstOp; op < step->firstOp + step->numOps; ++op)
+                static_cast<GraphRenderingOps::AudioGraphRenderingOpBase*> (renderingOps.getUnchecked (op))->addBufferAccess (*stepAccess);
+        }
+
+        // a step has to wait for every earlier step using one of its buffers; steps that end
+        // up at the same depth of this ordering can be rendered at the same time
+        Array<int> depths;
+        plan->hasParallelSteps = false;
+
+        for (int j = 0; j < plan->steps.size(); ++j)
+        {
+            int depth = 0;
+
+            for (int i = 0; i < j; ++i)
+            {
+                if (access.getUnchecked (i)->conflictsWith (*access.getUnchecked (j)))
+                {
+                    plan->steps.getUnchecked (i)->dependents.add (j);
+                    ++plan->steps.getUnchecked (j)->numDependencies;
+                    depth = jmax (depth, depths.getUnchecked (i) + 1);
+                }
+            }
+
+            if (depths.contains (depth))
+                plan->hasParallelSteps = true;
+
+            depths.add (depth);
+        }
+
+        plan->readySteps.malloc ((size_t) jmax (1, plan->steps.size()));
+        return plan;
+    }
+
+    void setNumThreads (int numThreads)
+    {
+        workers.clear();
+
+        // every worker and the audio thread can be waiting at once
+        idleThreads.malloc ((size_t) numThreads + 1);
+
+        for (int i = 0; i < numThreads; ++i)
+            workers.add (new Worker (*this))->startThread (9);
+    }
+
+    int getNumThreads() const noexcept     { return workers.size(); }
+
+    /** Renders the ops through the plan. Returns false if they should be rendered in order instead. */
+    template <typename FloatType>
+    bool render (const Array<void*>& renderingOps, AudioBuffer<FloatType>& buffers,
+                 const OwnedArray<MidiBuffer>& sharedMidiBuffers, int samples)
+    {
+        if (plan == nullptr || ! plan->hasParallelSteps || workers.size() == 0)
+            return false;
+
+        ops = &renderingOps;
+        audioBuffers = &buffers;
+        midiBuffers = &sharedMidiBuffers;
+        numSamples = samples;
+        doublePrecision = sizeof (FloatType) == sizeof (double);
+
+        const int numSteps = plan->steps.size();
+
+        {
+            const ScopedLock sl (readyLock);
+
+            readyHead = 0;
+            readyTail = 0;
+            numCompleted = 0;
+            numIdle = 0;
+
+            for (int i = 0; i < numSteps; ++i)
+            {
+                Step& step = *plan->steps.getUnchecked (i);
+                step.pending = step.numDependencies;
+
+                if (step.pending == 0)
+                    plan->readySteps[readyTail++] = i;
+            }
+        }
+
+        running = 1;
+
+        for (int i = 0; i < workers.size(); ++i)
+            workers.getUnchecked (i)->blockStarted.signal();
+
+        renderSteps (audioThreadReady);
+
+        // the block ends once no worker is left looking at its steps. The waits are bounded,
+        // in case the last worker leaves between the check and the wait
+        running = 0;
+        while (activeWorkers.get() > 0)
+            workersFinished.wait (1);
+
+        return true;
+    }
+
+    /** Renders ready steps until all of them are done, sleeping on the given event while
+        there are none */
+    void renderSteps (WaitableEvent& stepReady)
+    {
+        const int numSteps = plan->steps.size();
+
+        for (;;)
+        {
+            int stepIndex = -1;
+
+            {
+                const ScopedLock sl (readyLock);
+
+                if (numCompleted == numSteps)
+                    return;
+
+                if (readyHead < readyTail)
+                    stepIndex = plan->readySteps[readyHead++];
+                else
+                    idleThreads[numIdle++] = &stepReady;
+            }
+
+            if (stepIndex < 0)
+            {
+                // woken by pushReadyStep() or the last step; a timeout just checks again
+                if (! stepReady.wait (1))
+                    removeIdleThread (stepReady);
+
+                continue;
+            }
+
+            Step& step = *plan->steps.getUnchecked (stepIndex);
+
+            for (int i = step.firstOp; i < step.firstOp + step.numOps; ++i)
+            {
+                GraphRenderingOps::AudioGraphRenderingOpBase* const op
+                    = static_cast<GraphRenderingOps::AudioGraphRenderingOpBase*> (ops->getUnchecked (i));
+
+                if (doublePrecision)
+                    op->perform (*static_cast<AudioBuffer<double>*> (audioBuffers), *midiBuffers, numSamples);
+                else
+                    op->perform (*static_cast<AudioBuffer<float>*> (audioBuffers), *midiBuffers, numSamples);
+            }
+
+            const ScopedLock sl (readyLock);
+
+            for (int i = 0; i < step.dependents.size(); ++i)
+                if (--(plan->steps.getUnchecked (step.dependents.getUnchecked (i))->pending) == 0)
+                    pushReadyStep (step.dependents.getUnchecked (i));
+
+            // the last step sends every sleeping thread out of the block
+            if (++numCompleted == numSteps)
+            {
+                for (int i = 0; i < numIdle; ++i)
+                    idleThreads[i]->signal();
+
+                numIdle = 0;
+            }
+        }
+    }
+
+    /** Queues a step, and wakes a sleeping thread to render it. Called with readyLock held */
+    void pushReadyStep (int stepIndex)
+    {
+        plan->readySteps[readyTail++] = stepIndex;
+
+        if (numIdle > 0)
+            idleThreads[--numIdle]->signal();
+    }
+
+    void removeIdleThread (WaitableEvent& stepReady)
+    {
+        const ScopedLock sl (readyLock);
+
+        for (int i = 0; i < numIdle; ++i)
+        {
+            if (idleThreads[i] == &stepReady)
+            {
+                idleThreads[i] = idleThreads[--numIdle];
+                break;
+            }
+        }
+    }
+
+    ScopedPointer<Plan> plan;
+    OwnedArray<Worker> workers;
+
+    const Array<void*>* ops;
+    void* audioBuffers;
+    const OwnedArray<MidiBuffer>* midiBuffers;
+    int numSamples;
+    bool doublePrecision;
+
+    /** The queue of ready steps, and the threads sleeping until one is queued */
+    CriticalSection readyLock;
+    int readyHead, readyTail, numCompleted;
+    HeapBlock<WaitableEvent*> idleThreads;
+    int numIdle;
+
+    WaitableEvent audioThreadReady, workersFinished;
+    Atomic<int> running, activeWorkers;
+
+    JUCE_DECLARE_NON_COPYABLE (ParallelRenderer)
+};
+
 //==============================================================================
 AudioProcessorGraph::AudioProcessorGraph()
     : lastNodeId (0), audioBuffers (new AudioProcessorGraphBufferHelpers),
-      currentMidiInputBuffer (nullptr), isPlaying(false)
+      currentMidiInputBuffer (nullptr), isPlaying(false),
+      parallelRenderer (new ParallelRenderer())
 {
 }
 
@@ -1393,6 +1882,64 @@ bool AudioProcessorGraph::removeIllegalConnections()
     return doneAnything;
 }
 
+//Open ephys modification
+bool AudioProcessorGraph::setConnections (const Array<Connection>& newConnections)
+{
+    GraphRenderingOps::ConnectionSorter sorter;
+
+    OwnedArray<Connection> sorted;
+    sorted.ensureStorageAllocated (newConnections.size());
+
+    for (int i = 0; i < newConnections.size(); ++i)
+    {
+        const Connection& c = newConnections.getReference (i);
+
+        if (c.sourceNodeId != c.destNodeId
+             && (c.sourceChannelIndex == midiChannelIndex) == (c.destChannelIndex == midiChannelIndex)
+             && isConnectionLegal (&c))
+            sorted.add (new Connection (c));
+    }
+
+    sorted.sort (sorter);
+
+    OwnedArray<Connection> result;
+    result.ensureStorageAllocated (sorted.size());
+    bool changed = false;
+    int existing = 0;
+
+    for (int i = 0; i < sorted.size(); ++i)
+    {
+        Connection* const c = sorted.getUnchecked (i);
+
+        if (result.size() > 0 && sorter.compareElements (result.getLast(), c) == 0)
+            continue;
+
+        // skip the current connections that are not wanted any more
+        while (existing < connections.size() && sorter.compareElements (connections.getUnchecked (existing), c) < 0)
+        {
+            ++existing;
+            changed = true;
+        }
+
+        if (existing < connections.size() && sorter.compareElements (connections.getUnchecked (existing), c) == 0)
+            ++existing;
+        else
+            changed = true;
+
+        result.add (new Connection (*c));
+    }
+
+    if (existing < connections.size())
+        changed = true;
+
+    if (! changed)
+        return false;
+
+    connections.swapWith (result);
+    triggerAsyncUpdate();
+    return true;
+}
+
 //==============================================================================
 static void deleteRenderOpArray (Array<void*>& ops)
 {
@@ -1403,10 +1950,12 @@ static void deleteRenderOpArray (Array<void*>& ops)
 void AudioProcessorGraph::clearRenderingSequence()
 {
     Array<void*> oldOps;
+    ScopedPointer<ParallelRenderer::Plan> oldPlan;
 
     {
         const ScopedLock sl (getCallbackLock());
         renderingOps.swapWith (oldOps);
+        parallelRenderer->plan.swapWith (oldPlan);
     }
 
     deleteRenderOpArray (oldOps);
@@ -1435,6 +1984,8 @@ bool AudioProcessorGraph::isAnInputTo (const uint32 possibleInputId,
 void AudioProcessorGraph::buildRenderingSequence()
 {
     Array<void*> newRenderingOps;
+    Array<int> nodeFirstOps;
+    ScopedPointer<ParallelRenderer::Plan> newPlan;
     int numRenderingBuffersNeeded = 2;
     int numMidiBuffersNeeded = 1;
 
@@ -1461,17 +2012,20 @@ void AudioProcessorGraph::buildRenderingSequence()
             }
         }
 
-        GraphRenderingOps::RenderingOpSequenceCalculator calculator (*this, orderedNodes, newRenderingOps);
+        GraphRenderingOps::RenderingOpSequenceCalculator calculator (*this, orderedNodes, newRenderingOps, nodeFirstOps);
 
         numRenderingBuffersNeeded = calculator.getNumBuffersNeeded();
         numMidiBuffersNeeded = calculator.getNumMidiBuffersNeeded();
     }
 
+    newPlan = ParallelRenderer::createPlan (newRenderingOps, nodeFirstOps);
+
     {
         // swap over to the new rendering sequence..
         const ScopedLock sl (getCallbackLock());
 
-        audioBuffers->setRenderingBufferSize (numRenderingBuffersNeeded, getBlockSize());
+        audioBuffers->setRenderingBufferSize (numRenderingBuffersNeeded, getBlockSize(),
+                                              getProcessingPrecision() == doublePrecision);
 
         for (int i = midiBuffers.size(); --i >= 0;)
             midiBuffers.getUnchecked(i)->clear();
@@ -1480,12 +2034,27 @@ void AudioProcessorGraph::buildRenderingSequence()
             midiBuffers.add (new MidiBuffer());
 
         renderingOps.swapWith (newRenderingOps);
+        parallelRenderer->plan.swapWith (newPlan);
     }
 
     // delete the old ones..
     deleteRenderOpArray (newRenderingOps);
 }
 
+//Open ephys modification
+void AudioProcessorGraph::setNumRenderThreads (int numThreads)
+{
+    const ScopedLock sl (getCallbackLock());
+
+    if (parallelRenderer->getNumThreads() != numThreads)
+        parallelRenderer->setNumThreads (jmax (0, numThreads));
+}
+
+int AudioProcessorGraph::getNumRenderThreads() const noexcept
+{
+    return parallelRenderer->getNumThreads();
+}
+
 void AudioProcessorGraph::handleAsyncUpdate()
 {
     buildRenderingSequence();
@@ -1566,12 +2135,15 @@ void AudioProcessorGraph::processAudio (AudioBuffer<FloatType>& buffer, MidiBuff
     currentMidiInputBuffer = &midiMessages;
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
+    if (! parallelRenderer->render (renderingOps, renderingBuffers, midiBuffers, numSamples))
     {
-        GraphRenderingOps::AudioGraphRenderingOpBase* const op
-            = (GraphRenderingOps::AudioGraphRenderingOpBase*) renderingOps.getUnchecked(i);
+        for (int i = 0; i < renderingOps.size(); ++i)
+        {
+            GraphRenderingOps::AudioGraphRenderingOpBase* const op
+                = (GraphRenderingOps::AudioGraphRenderingOpBase*) renderingOps.getUnchecked(i);
 
-        op->perform (renderingBuffers, midiBuffers, numSamples);
+            op->perform (renderingBuffers, midiBuffers, numSamples);
+        }
     }
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
@@ -248,6 +248,14 @@ public:
     */
     bool removeIllegalConnections();
 
+    //Open ephys modification
+    /** Replaces all the connections with the given ones, only removing and adding the ones
+        that differ, so the rendering sequence is only rebuilt when something changed.
+        Illegal and duplicate connections are skipped.
+        @returns true if the connections changed
+    */
+    bool setConnections (const Array<Connection>& newConnections);
+
     //==============================================================================
     /** A special number that represents the midi channel of a node.
 
@@ -256,6 +264,12 @@ public:
     */
     static const int midiChannelIndex;
 
+    /** Set this node property to true when the node's processor never writes to its input
+        channels. The node then reads the buffers of its sources in place, instead of getting
+        a copy of the channels that other nodes still need.
+    */
+    static const Identifier readOnlyInputProperty;
+
 
     //==============================================================================
     /** A special type of AudioProcessor that can live inside an AudioProcessorGraph
@@ -375,6 +389,13 @@ public:
 
     bool isPlaying;
 
+    //Open ephys modification
+    /** Lets nodes that don't share any buffers render at the same time, on up to numThreads
+        threads besides the audio thread. With 0 every node is rendered on the audio thread.
+    */
+    void setNumRenderThreads (int numThreads);
+    int getNumRenderThreads() const noexcept;
+
 private:
     //==============================================================================
     template <typename floatType>
@@ -394,6 +415,9 @@ private:
     MidiBuffer* currentMidiInputBuffer;
     MidiBuffer currentMidiOutputBuffer;
 
+    struct ParallelRenderer;
+    ScopedPointer<ParallelRenderer> parallelRenderer;
+
     void handleAsyncUpdate() override;
     void clearRenderingSequence();
     void buildRenderingSequence();
@@ -35,6 +35,7 @@ ArduinoOutput::ArduinoOutput()
     , state                 (true)
     , acquisitionIsActive   (false)
     , deviceSelected        (false)
+    , dispatcher            ("Arduino output", *this)
 {
     setProcessorType (PROCESSOR_TYPE_SINK);
 }
@@ -47,6 +48,12 @@ ArduinoOutput::~ArduinoOutput()
 }
 
 
+void ArduinoOutput::writeOutput (const OutputDispatcher::Command& command)
+{
+    arduino.sendDigital (command.channel, command.value);
+}
+
+
 AudioProcessorEditor* ArduinoOutput::createEditor()
 {
     editor = new ArduinoOutputEditor (this, true);
@@ -102,11 +109,11 @@ void ArduinoOutput::handleEvent (const EventChannel* eventInfo, const MidiMessag
 {
     if (Event::getEventType(event) == EventChannel::TTL)
     {
-		TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
+		EventView ttl(event, eventInfo);
 
         //int eventNodeId = *(dataptr+1);
-        const int eventId         = ttl->getState() ? 1: 0;
-        const int eventChannel    = ttl->getChannel();
+        const int eventId         = ttl.getState() ? 1: 0;
+        const int eventChannel    = ttl.getChannel();
 
         // std::cout << "Received event from " << eventNodeId
         //           << " on channel " << eventChannel
@@ -124,14 +131,11 @@ void ArduinoOutput::handleEvent (const EventChannel* eventInfo, const MidiMessag
         {
             if (inputChannel == -1 || eventChannel == inputChannel)
             {
-                if (eventId == 0)
-                {
-                    arduino.sendDigital (outputChannel, ARD_LOW);
-                }
-                else
-                {
-                    arduino.sendDigital (outputChannel, ARD_HIGH);
-                }
+                dispatcher.push (outputChannel,
+                                 eventId == 0 ? ARD_LOW : ARD_HIGH,
+                                 eventInfo->getTimestampOriginProcessor(),
+                                 eventInfo->getTimestampOriginSubProcessor(),
+                                 ttl.getTimestamp());
             }
         }
     }
@@ -184,6 +188,7 @@ void ArduinoOutput::setGateChannel (int chan)
 bool ArduinoOutput::enable()
 {
     acquisitionIsActive = true;
+    dispatcher.start();
 
     return deviceSelected;
 }
@@ -191,9 +196,13 @@ bool ArduinoOutput::enable()
 
 bool ArduinoOutput::disable()
 {
+    dispatcher.stop();
     arduino.sendDigital (outputChannel, ARD_LOW);
     acquisitionIsActive = false;
 
+    std::cout << "Arduino output: "
+              << (CoreServices::getLatencyBenchmark() ? dispatcher.getReport() : dispatcher.getSummary()) << std::endl;
+
     return true;
 }
 
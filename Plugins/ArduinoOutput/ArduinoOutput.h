@@ -40,6 +40,7 @@
     @see GenericProcessor
  */
 class ArduinoOutput : public GenericProcessor
+                    , private OutputDispatcher::Device
 {
 public:
     ArduinoOutput();
@@ -83,6 +84,12 @@ private:
     bool acquisitionIsActive;
     bool deviceSelected;
 
+    /** Sends the digital writes on its own thread */
+    void writeOutput (const OutputDispatcher::Command& command) override;
+
+    /** Queues the digital writes of handleEvent() */
+    OutputDispatcher dispatcher;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ArduinoOutput);
 };
 
@@ -24,12 +24,19 @@
 #include <stdio.h>
 #include "SpikeDetector.h"
 
+/** Time constant of the channel statistics, in seconds */
+#define SPIKE_DETECTOR_STATISTICS_SECONDS 2.0
+
+/** Smallest number of electrodes processed by a worker thread */
+#define SPIKE_DETECTOR_ELECTRODES_PER_RANGE 4
+
+/** Spikes of all electrodes in a buffer that can be sorted without allocating */
+#define SPIKE_DETECTOR_PENDING_SPIKES 1024
+
 
 SpikeDetector::SpikeDetector()
     : GenericProcessor      ("Spike Detector")
-    , overflowBuffer        (2, 100)
-    , dataBuffer            (nullptr),
-      overflowBufferSize    (100)
+    , dataBuffer            (nullptr)
     , currentElectrode      (-1)
     , uniqueID              (0)
 {
@@ -83,6 +90,8 @@ AudioProcessorEditor* SpikeDetector::createEditor()
 
 void SpikeDetector::createSpikeChannels()
 {
+	electrodeStates.clear();
+
 	for (int i = 0; i < electrodes.size(); ++i)
 	{
 		SimpleElectrode* elec = electrodes[i];
@@ -101,17 +110,25 @@ void SpikeDetector::createSpikeChannels()
 		SpikeChannel* spk = new SpikeChannel(SpikeChannel::typeFromNumChannels(nChans), this, chans);
 		spk->setNumSamples(elec->prePeakSamples, elec->postPeakSamples);
 		spikeChannelArray.add(spk);
+
+		ElectrodeState* state = new ElectrodeState();
+		state->thresholds.malloc(nChans);
+		state->data.calloc(nChans);
+		state->history.setSize(nChans, getLookahead(elec) + elec->prePeakSamples + 2);
+		state->history.clear();
+		state->spikeBuffers.add(new SpikeEvent::SpikeBuffer(spk));
+		state->spikeSamples.add(0);
+		electrodeStates.add(state);
 	}
 }
 
 
 void SpikeDetector::updateSettings()
 {
-	if (getNumInputs() > 0)
-	{
-		overflowBuffer.setSize(getNumInputs(), overflowBufferSize);
-		overflowBuffer.clear();
-	}
+	channelStatistics.setup(getNumInputs(), 1.0);
+
+	for (int chan = 0; chan < getNumInputs(); ++chan)
+		channelStatistics.setTimeConstant(chan, getDataChannel(chan)->getSampleRate() * SPIKE_DETECTOR_STATISTICS_SECONDS);
 
 }
 
@@ -161,7 +178,7 @@ bool SpikeDetector::addElectrode (int nChans, int electrodeID)
     newElectrode->prePeakSamples = 8;
     newElectrode->postPeakSamples = 32;
     newElectrode->thresholds.malloc (nChans);
-    newElectrode->isActive.malloc (nChans);
+    newElectrode->isActive.setSize (nChans, true);
     newElectrode->channels.malloc (nChans);
     newElectrode->isMonitored = false;
 
@@ -169,7 +186,6 @@ bool SpikeDetector::addElectrode (int nChans, int electrodeID)
     {
         *(newElectrode->channels + i) = firstChan+i;
         *(newElectrode->thresholds + i) = getDefaultThreshold();
-        *(newElectrode->isActive + i) = true;
     }
 
     if (electrodeID > 0) 
@@ -291,15 +307,15 @@ void SpikeDetector::setChannelActive (int electrodeIndex, int subChannel, bool a
     std::cout << "Setting channel active to " << active << std::endl;
 
     if (active)
-        setParameter (98, 1);
+        queueParameterChange (98, 1, getElectrodeChannelIndex (electrodeIndex, subChannel));
     else
-        setParameter (98, 0);
+        queueParameterChange (98, 0, getElectrodeChannelIndex (electrodeIndex, subChannel));
 }
 
 
 bool SpikeDetector::isChannelActive (int electrodeIndex, int i)
 {
-    return *(electrodes[electrodeIndex]->isActive + i);
+    return electrodes[electrodeIndex]->isActive[i];
 }
 
 
@@ -310,7 +326,18 @@ void SpikeDetector::setChannelThreshold (int electrodeNum, int channelNum, float
 
     std::cout << "Setting electrode " << electrodeNum << " channel threshold " << channelNum << " to " << thresh << std::endl;
 
-    setParameter (99, thresh);
+    queueParameterChange (99, thresh, getElectrodeChannelIndex (electrodeNum, channelNum));
+}
+
+
+int SpikeDetector::getElectrodeChannelIndex (int electrodeIndex, int subChannel) const
+{
+    int index = subChannel;
+
+    for (int i = 0; i < electrodeIndex; ++i)
+        index += electrodes[i]->numChannels;
+
+    return index;
 }
 
 
@@ -320,20 +347,38 @@ double SpikeDetector::getChannelThreshold(int electrodeNum, int channelNum) cons
 }
 
 
+float SpikeDetector::getChannelNoiseLevel (int electrodeNum, int channelNum) const
+{
+    const int chan = *(electrodes[electrodeNum]->channels + channelNum);
+
+    if (chan < 0 || chan >= channelStatistics.getNumChannels())
+        return 0.0f;
+
+    return channelStatistics.getNoiseLevel (chan);
+}
+
+
 void SpikeDetector::setParameter (int parameterIndex, float newValue)
 {
     //editor->updateParameterButtons(parameterIndex);
 
-    if (parameterIndex == 99 && currentElectrode > -1)
+    // the current channel counts the channels of all electrodes, see getElectrodeChannelIndex()
+    int electrode = 0;
+    int subChannel = currentChannel;
+
+    while (electrode < electrodes.size() && subChannel >= electrodes[electrode]->numChannels)
+        subChannel -= electrodes[electrode++]->numChannels;
+
+    if (subChannel < 0 || electrode >= electrodes.size())
+        return;
+
+    if (parameterIndex == 99)
     {
-        *(electrodes[currentElectrode]->thresholds + currentChannelIndex) = newValue;
+        *(electrodes[electrode]->thresholds + subChannel) = newValue;
     }
-    else if (parameterIndex == 98 && currentElectrode > -1)
+    else if (parameterIndex == 98)
     {
-        if (newValue == 0.0f)
-            *(electrodes[currentElectrode]->isActive + currentChannelIndex) = false;
-        else
-            *(electrodes[currentElectrode]->isActive + currentChannelIndex) = true;
+        electrodes[electrode]->isActive.set (subChannel, newValue != 0.0f);
     }
 }
 
@@ -342,10 +387,12 @@ bool SpikeDetector::enable()
 {
     sampleRateForElectrode = (uint16_t) getSampleRate();
 
-    useOverflowBuffer.clear();
+    channelStatistics.reset();
 
-    for (int i = 0; i < electrodes.size(); ++i)
-        useOverflowBuffer.add (false);
+    pendingSpikes.ensureStorageAllocated (SPIKE_DETECTOR_PENDING_SPIKES);
+
+    for (int i = 0; i < electrodeStates.size(); ++i)
+        electrodeStates[i]->history.clear();
 
     return true;
 }
@@ -363,218 +410,277 @@ bool SpikeDetector::disable()
 
 
 void SpikeDetector::addWaveformToSpikeObject (SpikeEvent::SpikeBuffer& s,
-                                              int& peakIndex,
-                                              int& electrodeNumber,
-                                              int& currentChannel)
+                                              const ElectrodeState& state,
+                                              int electrodeNumber,
+                                              int currentChannel)
 {
-    int spikeLength = electrodes[electrodeNumber]->prePeakSamples
-                      + electrodes[electrodeNumber]->postPeakSamples;
-
+    const SimpleElectrode* electrode = electrodes[electrodeNumber];
+    const int spikeLength = electrode->prePeakSamples + electrode->postPeakSamples;
 
-    const int chan = *(electrodes[electrodeNumber]->channels + currentChannel);
+    int sample = 0;
 
     if (isChannelActive (electrodeNumber, currentChannel))
     {
-		
-        for (int sample = 0; sample < spikeLength; ++sample)
-        {
-            s.set(currentChannel,sample, getNextSample (*(electrodes[electrodeNumber]->channels+currentChannel)));
-            ++sampleIndex;
+        // the waveform starts prePeakSamples before the peak, possibly in the history, and
+        // detection stops early enough for it to end in the current buffer
+        int index = state.sampleIndex - electrode->prePeakSamples;
 
-            //std::cout << currentIndex << std::endl;
+        if (index < 0)
+        {
+            const int historySamples = jmin (spikeLength, -index);
+            s.set (currentChannel, 0,
+                   state.history.getReadPointer (currentChannel, state.history.getNumSamples() + index),
+                   historySamples);
+            sample = historySamples;
+            index += historySamples;
         }
-    }
-    else
-    {
-        for (int sample = 0; sample < spikeLength; ++sample)
+
+        const int bufferSamples = jmin (spikeLength - sample, state.numSamples - index);
+
+        if (bufferSamples > 0)
         {
-            // insert a blank spike if the
-			s.set(currentChannel, sample, 0);
-            ++sampleIndex;
-            //std::cout << currentIndex << std::endl;
+            s.set (currentChannel, sample, state.data[currentChannel] + index, bufferSamples);
+            sample += bufferSamples;
         }
     }
 
-    sampleIndex -= spikeLength; // reset sample index
+    // insert a blank spike if the channel is not active
+    for (; sample < spikeLength; ++sample)
+        s.set (currentChannel, sample, 0);
 }
 
 
 void SpikeDetector::process (AudioSampleBuffer& buffer)
 {
 
-    // cycle through electrodes
-    SimpleElectrode* electrode;
     dataBuffer = &buffer;
 
+    for (int chan = 0; chan < channelStatistics.getNumChannels(); ++chan)
+        channelStatistics.process (chan, buffer.getReadPointer (chan), getNumSamples (chan));
+
     //std::cout << dataBuffer.getMagnitude(0,nSamples) << std::endl;
 
-    for (int i = 0; i < electrodes.size(); ++i)
+    const int numElectrodes = jmin (electrodes.size(), electrodeStates.size());
+
+    // electrodes only read their own channels and history, so they are processed in parallel
+    forEachChannelRange (numElectrodes, [this] (int firstElectrode, int lastElectrode)
+    {
+        for (int i = firstElectrode; i < lastElectrode; ++i)
+            detectSpikes (i);
+    }, SPIKE_DETECTOR_ELECTRODES_PER_RANGE);
+
+    // package spikes, in timestamp order whichever electrode found them
+    pendingSpikes.clearQuick();
+
+    for (int i = 0; i < numElectrodes; ++i)
+    {
+        const ElectrodeState* state = electrodeStates[i];
+        const int64 firstTimestamp = getTimestamp (electrodes[i]->channels[0]);
+
+        for (int spike = 0; spike < state->numSpikes; ++spike)
+        {
+            PendingSpike pendingSpike = { firstTimestamp + state->spikeSamples[spike], i, spike };
+            pendingSpikes.add (pendingSpike);
+        }
+    }
+
+    std::sort (pendingSpikes.begin(), pendingSpikes.end(), [] (const PendingSpike& a, const PendingSpike& b)
+    {
+        return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.electrode < b.electrode);
+    });
+
+    for (const PendingSpike& pendingSpike : pendingSpikes)
     {
-        //  std::cout << "ELECTRODE " << i << std::endl;
+        const ElectrodeState* state = electrodeStates[pendingSpike.electrode];
+
+        addSpike (getSpikeChannel (pendingSpike.electrode),
+                  pendingSpike.timestamp,
+                  state->thresholds,
+                  *state->spikeBuffers[pendingSpike.spike],
+                  0,
+                  state->spikeSamples[pendingSpike.spike]);
+    }
+}
+
+
+void SpikeDetector::detectSpikes (int electrodeIndex)
+{
+    SimpleElectrode* electrode = electrodes[electrodeIndex];
+    ElectrodeState& state = *electrodeStates[electrodeIndex];
+
+    state.numSpikes = 0;
+
+    for (int chan = 0; chan < electrode->numChannels; ++chan)
+        state.thresholds[chan] = (int) *(electrode->thresholds + chan);
+
+    // refresh buffer index for this electrode
+    state.sampleIndex = electrode->lastBufferIndex - 1; // subtract 1 to account for
+    // increment at start of getNextSample()
+
+    const int nSamples = getNumSamples (*electrode->channels);
+
+    state.numSamples = nSamples;
 
-        electrode = electrodes[i];
+    for (int chan = 0; chan < electrode->numChannels; ++chan)
+        state.data[chan] = dataBuffer->getReadPointer (*(electrode->channels + chan));
 
-        // refresh buffer index for this electrode
-        sampleIndex = electrode->lastBufferIndex - 1; // subtract 1 to account for
-        // increment at start of getNextSample()
+    // samples of this buffer that are checked for spikes, the others are checked with the next one
+    const int scanEnd = nSamples - getLookahead (electrode);
 
-        const int nSamples = getNumSamples (*electrode->channels);
+    markCrossings (electrode, state, scanEnd);
 
-        // cycle through samples
-        while (samplesAvailable (nSamples))
+    // cycle through samples
+    while (samplesAvailable (state, scanEnd))
+    {
+        ++state.sampleIndex;
+
+        // skip the samples where no channel can trigger a spike
+        if (state.sampleIndex >= 0)
         {
-            ++sampleIndex;
+            state.sampleIndex = Dsp::VectorOps::findNextMarked (state.crossingMask, state.sampleIndex, scanEnd);
+
+            if (state.sampleIndex >= scanEnd)
+                break;
+        }
 
-            // cycle through channels
-            for (int chan = 0; chan < electrode->numChannels; ++chan)
+        // cycle through the active channels
+        for (int chan : electrode->isActive)
+        {
+            if (-getNextSample (state, chan) > *(electrode->thresholds + chan)) // trigger spike
             {
-                // std::cout << "  channel " << chan << std::endl;
-                if (*(electrode->isActive + chan))
+
+                // find the peak
+                int peakIndex = state.sampleIndex;
+
+                while (-getCurrentSample (state, chan) < -getNextSample (state, chan)
+                       && state.sampleIndex < peakIndex + electrode->postPeakSamples)
                 {
-                    int currentChannel = *(electrode->channels + chan);
+                    ++state.sampleIndex;
+                }
 
-                    if (-getNextSample (currentChannel) > *(electrode->thresholds + chan)) // trigger spike
-                    {
+                peakIndex = state.sampleIndex;
 
-                        // find the peak
-                        int peakIndex = sampleIndex;
-
-                        while (-getCurrentSample(currentChannel) < -getNextSample(currentChannel)
-                               && sampleIndex < peakIndex + electrode->postPeakSamples)
-                        {
-                            ++sampleIndex;
-                        }
-
-                        peakIndex = sampleIndex;
-
-                        /* DEBUG SPIPKE DATA */
-                        /*
-
-                        std::cout << "Peak detected @ " << sampleIndex << std::endl;
-
-                        sampleIndex -= (electrode->prePeakSamples + 1);
-                        for (int j = 0; j < electrode->prePeakSamples + electrode->postPeakSamples + 1; j++)
-                        {
-                            std::cout << getCurrentSample(currentChannel);
-                            if (sampleIndex == peakIndex)
-                                std::cout << "**PEAK**";
-                            std::cout << std::endl;
-                            sampleIndex++;
-                        }
-                        sampleIndex = peakIndex - (electrode->prePeakSamples + 1);
-                        */
-
-						const SpikeChannel* spikeChan = getSpikeChannel(i);
-						SpikeEvent::SpikeBuffer spikeData(spikeChan);
-						Array<float> thresholds;
-						for (int channel = 0; channel < electrode->numChannels; ++channel)
-						{
-							addWaveformToSpikeObject(spikeData,
-								peakIndex,
-								i,
-								channel);
-							thresholds.add((int)*(electrode->thresholds + channel));
-						}
-						int64 timestamp = getTimestamp(electrode->channels[0]) + peakIndex;
-						SpikeEventPtr newSpike = SpikeEvent::createSpikeEvent(spikeChan, timestamp, thresholds, spikeData, 0);
-
-                        // package spikes;
-                        
-						addSpike(spikeChan, newSpike, peakIndex);
-
-
-                        // advance the sample index
-                        sampleIndex = peakIndex + electrode->postPeakSamples;
-
-                        // quit spike "for" loop
-                        break;
-
-                    // end spike trigger
-                    }
+                // the waveform buffers are kept between buffers, so this only allocates
+                // when an electrode finds more spikes in a buffer than ever before
+                if (state.numSpikes == state.spikeBuffers.size())
+                {
+                    state.spikeBuffers.add (new SpikeEvent::SpikeBuffer (getSpikeChannel (electrodeIndex)));
+                    state.spikeSamples.add (0);
+                }
+
+                SpikeEvent::SpikeBuffer& spikeData = *state.spikeBuffers[state.numSpikes];
 
-                // end if channel is active
+                for (int channel = 0; channel < electrode->numChannels; ++channel)
+                {
+                    addWaveformToSpikeObject (spikeData,
+                                              state,
+                                              electrodeIndex,
+                                              channel);
                 }
 
-            // end cycle through channels on electrode
-            }
+                state.spikeSamples.set (state.numSpikes++, peakIndex);
 
-        // end cycle through samples
-        }
+                // advance the sample index
+                state.sampleIndex = peakIndex + electrode->postPeakSamples;
 
-        electrode->lastBufferIndex = sampleIndex - nSamples; // should be negative
+                // quit spike "for" loop
+                break;
 
-        if (nSamples > overflowBufferSize)
-        {
-            for (int j = 0; j < electrode->numChannels; ++j)
-            {
-                overflowBuffer.copyFrom (*electrode->channels+j,
-                                         0,
-                                         buffer,
-                                         *electrode->channels + j,
-                                         nSamples-overflowBufferSize,
-                                         overflowBufferSize);
+            // end spike trigger
             }
 
-            useOverflowBuffer.set (i, true);
-        }
-        else
-        {
-            useOverflowBuffer.set (i, false);
+        // end cycle through channels on electrode
         }
 
-    // end cycle through electrodes
+    // end cycle through samples
     }
+
+    electrode->lastBufferIndex = state.sampleIndex - nSamples; // should be negative
+
+    updateHistory (state);
 }
 
 
-float SpikeDetector::getNextSample (int& chan)
+int SpikeDetector::getLookahead (const SimpleElectrode* electrode)
 {
-    if (sampleIndex < 0)
-    {
-        const int ind = overflowBufferSize + sampleIndex;
+    return 2 * electrode->postPeakSamples + 1;
+}
 
-        if (ind < overflowBuffer.getNumSamples())
-            return *overflowBuffer.getWritePointer (chan, ind);
-        else
-            return 0;
 
-    }
-    else
+void SpikeDetector::updateHistory (ElectrodeState& state)
+{
+    const int historySize = state.history.getNumSamples();
+    const int numSamples = state.numSamples;
+
+    for (int chan = 0; chan < state.history.getNumChannels(); ++chan)
     {
-        if (sampleIndex < getNumSamples(chan))
-            return *dataBuffer->getWritePointer (chan, sampleIndex);
-        else
-            return 0;
+        float* history = state.history.getWritePointer (chan);
+
+        if (numSamples >= historySize)
+        {
+            FloatVectorOperations::copy (history, state.data[chan] + numSamples - historySize, historySize);
+        }
+        else if (numSamples > 0)
+        {
+            // a short buffer only replaces the oldest samples
+            memmove (history, history + numSamples, (historySize - numSamples) * sizeof (float));
+            FloatVectorOperations::copy (history + historySize - numSamples, state.data[chan], numSamples);
+        }
     }
 }
 
 
-float SpikeDetector::getCurrentSample (int& chan)
+float SpikeDetector::getNextSample (const ElectrodeState& state, int chan) const
 {
-    if (sampleIndex < 1)
-    {
-        return *overflowBuffer.getWritePointer (chan, overflowBufferSize + sampleIndex - 1);
-    }
-    else
-    {
-        return *dataBuffer->getWritePointer (chan, sampleIndex - 1);
-    }
+    return state.getSample (chan, state.sampleIndex);
 }
 
 
-bool SpikeDetector::samplesAvailable (int nSamples)
+void SpikeDetector::markCrossings (const SimpleElectrode* electrode, ElectrodeState& state, int numSamples)
 {
-    if (sampleIndex > nSamples - overflowBufferSize/2)
+    if (numSamples <= 0)
+        return;
+
+    const int numWords = (numSamples + 31) / 32;
+
+    if (numWords > state.crossingMaskSize)
     {
-        return false;
+        state.crossingMask.malloc (numWords);
+        state.crossingMaskSize = numWords;
     }
-    else
+
+    state.crossingMask.clear (numWords);
+
+    for (int chan : electrode->isActive)
     {
-        return true;
+        const int channel = *(electrode->channels + chan);
+        const int available = jmin (numSamples, (int) getNumSamples (channel));
+        const float threshold = (float) *(electrode->thresholds + chan);
+
+        Dsp::VectorOps::markBelow (dataBuffer->getReadPointer (channel), available, -threshold, state.crossingMask);
+
+        // samples past the end of the data read as 0, which can only trigger a negative threshold
+        if (threshold < 0)
+        {
+            for (int i = available; i < numSamples; ++i)
+                state.crossingMask[i / 32] |= uint32 (1) << (i % 32);
+        }
     }
 }
 
 
+float SpikeDetector::getCurrentSample (const ElectrodeState& state, int chan) const
+{
+    return state.getSample (chan, state.sampleIndex - 1);
+}
+
+
+bool SpikeDetector::samplesAvailable (const ElectrodeState& state, int scanEnd) const
+{
+    return state.sampleIndex + 1 < scanEnd;
+}
+
+
 void SpikeDetector::saveCustomParametersToXml (XmlElement* parentElement)
 {
     for (int i = 0; i < electrodes.size(); ++i)
@@ -591,7 +697,7 @@ void SpikeDetector::saveCustomParametersToXml (XmlElement* parentElement)
             XmlElement* channelNode = electrodeNode->createNewChildElement ("SUBCHANNEL");
             channelNode->setAttribute ("ch",        *(electrodes[i]->channels + j));
             channelNode->setAttribute ("thresh",    *(electrodes[i]->thresholds + j));
-            channelNode->setAttribute ("isActive",  *(electrodes[i]->isActive + j));
+            channelNode->setAttribute ("isActive",  electrodes[i]->isActive[j]);
         }
     }
 }
@@ -25,6 +25,7 @@
 #define __SPIKEDETECTOR_H_3F920F95__
 
 #include <ProcessorHeaders.h>
+#include <DspLib.h>
 #include "SpikeDetectorEditor.h"
 
 
@@ -43,7 +44,7 @@ struct SimpleElectrode
 
     HeapBlock<int> channels;
     HeapBlock<double> thresholds;
-    HeapBlock<bool> isActive;
+    ChannelMask isActive;
 };
 
 
@@ -82,14 +83,6 @@ public:
     void loadCustomParametersFromXml()                          override;
 
 
-    // INTERNAL BUFFERS
-    // =====================================================================
-    /** Extra samples are placed in this buffer to allow seamless
-        transitions between callbacks. */
-    AudioSampleBuffer overflowBuffer;
-    // =====================================================================
-
-
     // CREATE AND DELETE ELECTRODES
     // =====================================================================
     /** Adds an electrode with n channels to be processed. */
@@ -143,32 +136,106 @@ public:
 
     double getChannelThreshold (int electrodeNum, int channelNum) const;
 
+    /** Robust estimate of the noise standard deviation of a channel of an electrode, from the median
+        absolute deviation of its signal over the last seconds of acquisition. Can be used to set
+        thresholds as a multiple of the noise. */
+    float getChannelNoiseLevel (int electrodeNum, int channelNum) const;
+
+    /** Index of a channel of an electrode among the channels of all electrodes, which is the
+        channel setParameter() expects for the threshold (99) and active state (98) parameters */
+    int getElectrodeChannelIndex (int electrodeIndex, int subChannel) const;
+
 
 private:
 
     float getDefaultThreshold() const;
 
-    float getNextSample (int& chan);
-    float getCurrentSample (int& chan);
-    bool samplesAvailable (int nSamples);
+    /** Detection state of an electrode, so that electrodes can be processed in parallel */
+    struct ElectrodeState
+    {
+        ElectrodeState() : sampleIndex (0), numSamples (0), crossingMaskSize (0), numSpikes (0) {}
+
+        /** A sample of a channel of the electrode, negative indexes being in the previous buffers */
+        float getSample (int chan, int index) const
+        {
+            if (index < 0)
+                return history.getSample (chan, history.getNumSamples() + index);
+
+            return index < numSamples ? data[chan][index] : 0;
+        }
+
+        /** Current sample of the buffer, negative in the history */
+        int sampleIndex;
+
+        /** The channels of the electrode in the current buffer */
+        HeapBlock<const float*> data;
+        int numSamples;
+
+        /** The samples of each channel just before the current buffer, enough for any window
+            that is read from the previous buffers */
+        AudioSampleBuffer history;
+
+        /** One bit per sample of the current buffer, set where the electrode may spike */
+        HeapBlock<uint32> crossingMask;
+        int crossingMaskSize;
+
+        /** Thresholds stored with the spikes of the current buffer */
+        HeapBlock<float> thresholds;
+
+        /** Waveforms and peak samples of the spikes found in the current buffer. The waveform
+            buffers are reused, so detecting a spike allocates nothing. */
+        OwnedArray<SpikeEvent::SpikeBuffer> spikeBuffers;
+        Array<int> spikeSamples;
+        int numSpikes;
+    };
+
+    /** A spike found by an electrode, waiting to be added to the event buffer */
+    struct PendingSpike
+    {
+        int64 timestamp;
+        int electrode;
+        int spike;
+    };
+
+    /** Finds the spikes of an electrode in the current buffer, and keeps them in its state */
+    void detectSpikes (int electrodeIndex);
+
+    float getNextSample (const ElectrodeState& state, int chan) const;
+    float getCurrentSample (const ElectrodeState& state, int chan) const;
+    bool samplesAvailable (const ElectrodeState& state, int scanEnd) const;
+
+    /** Samples after a threshold crossing that detection reads: the peak can be up to
+        postPeakSamples after the crossing, and the waveform ends postPeakSamples after the peak */
+    static int getLookahead (const SimpleElectrode* electrode);
+
+    /** Keeps the end of the current buffer in the history of the electrode */
+    void updateHistory (ElectrodeState& state);
+
+    /** Marks in the crossing mask each sample, from 0 to numSamples, where an active channel of the
+        electrode is beyond its threshold. Each channel is scanned once, as a contiguous block. */
+    void markCrossings (const SimpleElectrode* electrode, ElectrodeState& state, int numSamples);
 
       void addWaveformToSpikeObject (SpikeEvent::SpikeBuffer& s,
-                                   int& peakIndex,
-                                   int& electrodeNumber,
-                                   int& currentChannel);
+                                   const ElectrodeState& state,
+                                   int electrodeNumber,
+                                   int currentChannel);
 
     void resetElectrode (SimpleElectrode*);
 
+    /** Running mean, RMS and noise level of every input channel */
+    Dsp::ChannelStatistics channelStatistics;
+
+    /** Detection state of each electrode, created with the spike channels */
+    OwnedArray<ElectrodeState> electrodeStates;
+
+    /** Spikes of all electrodes in the current buffer, sorted by timestamp before they are added */
+    Array<PendingSpike> pendingSpikes;
+
     /** Pointer to a continuous buffer. */
     AudioSampleBuffer* dataBuffer;
 
-    int overflowBufferSize;
-    int sampleIndex;
-
     Array<int> electrodeCounter;
 
-    Array<bool> useOverflowBuffer;
-
     int currentElectrode;
     int currentChannelIndex;
 
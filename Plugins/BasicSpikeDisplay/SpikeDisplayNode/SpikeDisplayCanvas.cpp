@@ -153,7 +153,7 @@ void SpikeDisplayCanvas::refresh()
 void SpikeDisplayCanvas::processSpikeEvents()
 {
 
-    processor->setParameter(2, 0.0f); // request redraw
+    processor->transferSpikes();
 
 }
 
@@ -867,7 +867,7 @@ WaveAxes::WaveAxes(int channel) : GenericAxes(channel),
     drawGrid(true),
     displayThresholdLevel(0.0f),
     detectorThresholdLevel(0.0f),
-    spikesReceivedSinceLastRedraw(0),
+    waveformImageValid(false),
     spikeIndex(0),
     bufferSize(5),
     range(250.0f),
@@ -897,9 +897,16 @@ void WaveAxes::setRange(float r)
 
     range = r;
 
+    waveformImageValid = false;
+
     repaint();
 }
 
+void WaveAxes::resized()
+{
+    waveformImageValid = false;
+}
+
 void WaveAxes::paint(Graphics& g)
 {
     g.setColour(Colours::black);
@@ -912,34 +919,64 @@ void WaveAxes::paint(Graphics& g)
     if (drawGrid)
         drawWaveformGrid(g);
 
+    // only the spikes received since the last repaint are drawn, on top of the cached ones
+    updateWaveformImage();
+
+    g.drawImageAt(waveformImage, 0, 0);
+
     // draw the threshold line and labels
     drawThresholdSlider(g);
     //drawBoundingBox(g);
 
-    // if no spikes have been received then don't plot anything
-    if (!gotFirstSpike)
+}
+
+void WaveAxes::updateWaveformImage()
+{
+    OwnedArray<SpikeEvent> spikes;
+
     {
-        return;
+        const ScopedLock lock(newSpikesLock);
+        spikes.swapWith(newSpikes);
     }
 
-
-    for (int spikeNum = 0; spikeNum < bufferSize; spikeNum++)
+    if (!waveformImageValid
+        || waveformImage.getWidth() != getWidth()
+        || waveformImage.getHeight() != getHeight())
     {
+        waveformImage = Image(Image::ARGB, jmax(1, getWidth()), jmax(1, getHeight()), true);
+        waveformImageValid = true;
+
+        Graphics ig(waveformImage);
 
-        if (spikeNum != spikeIndex)
+        // oldest first, each faded as if the newer ones had been added after it
+        for (int age = bufferSize - 1; age >= 0; age--)
         {
-            g.setColour(Colours::grey);
-            plotSpike(spikeBuffer[spikeNum], g);
+            ig.setColour(Colours::white.withAlpha(std::pow(WAVEFORM_DECAY, float(age + spikes.size()))));
+            plotSpike(spikeBuffer[(spikeIndex - age + bufferSize) % bufferSize], ig);
         }
-
     }
 
-    
-    plotSpike(spikeBuffer[spikeIndex], g);
+    if (spikes.size() == 0)
+        return;
+
+    // fade everything once for the whole batch, then draw the batch with matching alphas
+    waveformImage.multiplyAllAlphas(std::pow(WAVEFORM_DECAY, float(spikes.size())));
 
+    Graphics ig(waveformImage);
 
-    spikesReceivedSinceLastRedraw = 0;
+    for (int i = 0; i < spikes.size(); i++)
+    {
+        ig.setColour(Colours::white.withAlpha(std::pow(WAVEFORM_DECAY, float(spikes.size() - 1 - i))));
+        plotSpike(spikes[i], ig);
 
+        spikeIndex++;
+        spikeIndex %= bufferSize;
+
+        spikeBuffer.set(spikeIndex, spikes[i]);
+    }
+
+    // now owned by spikeBuffer
+    spikes.clear(false);
 }
 
 void WaveAxes::plotSpike(const SpikeEvent* s, Graphics& g)
@@ -955,8 +992,6 @@ void WaveAxes::plotSpike(const SpikeEvent* s, Graphics& g)
     //TODO: check for special metadata for this
 	//if (s.sortedId > 0)
     //   g.setColour(Colour(s.color[0],s.color[1],s.color[2]));
-    //else
-       g.setColour(Colours::white);
 
     // type corresponds to channel so we need to calculate the starting
     // sample based upon which channel is getting plotted
@@ -967,37 +1002,23 @@ void WaveAxes::plotSpike(const SpikeEvent* s, Graphics& g)
     float x = 0.0f;
 	const float* data = s->getDataPointer();
 
-	for (int i = 0; i < nSamples - 1; i++)
-	{
-		//std::cout << s.data[sampIdx] << std::endl;
-
-
-
-		float s1, s2;
-
-		if (spikesInverted)
-		{
-			s1 = h / 2 + data[sampIdx] / range * h;
-			s2 = h / 2 + data[sampIdx + 1] / range * h;
-		}
-		else
-		{
-			s1 = h / 2 - data[sampIdx] / range * h;
-			s2 = h / 2 - data[sampIdx + 1] / range * h;
-
-		}
-		g.drawLine(x,
-			s1,
-			x + dx,
-			s2);
-
-
+	const float sign = spikesInverted ? 1.0f : -1.0f;
 
+	// one path per waveform instead of a line per sample
+	Path waveform;
+	waveform.preallocateSpace(nSamples * 3);
+	waveform.startNewSubPath(x, h / 2 + sign * data[sampIdx] / range * h);
 
+	for (int i = 0; i < nSamples - 1; i++)
+	{
 		sampIdx += dSamples;
 		x += dx;
+
+		waveform.lineTo(x, h / 2 + sign * data[sampIdx] / range * h);
 	}
 
+	g.strokePath(waveform, PathStrokeType(1.0f));
+
 }
 
 void WaveAxes::drawThresholdSlider(Graphics& g)
@@ -1051,18 +1072,12 @@ bool WaveAxes::updateSpikeData(const SpikeEvent* s)
         gotFirstSpike = true;
     }
 
-    if (spikesReceivedSinceLastRedraw < bufferSize)
-    {
-
-        SpikeEvent* newSpike = new SpikeEvent(*s);
-
-        spikeIndex++;
-        spikeIndex %= bufferSize;
-
-        spikeBuffer.set(spikeIndex, newSpike);
-
-        spikesReceivedSinceLastRedraw++;
+    // called by the processor; the spikes are drawn on the next repaint
+    const ScopedLock lock(newSpikesLock);
 
+    if (newSpikes.size() < bufferSize)
+    {
+        newSpikes.add(new SpikeEvent(*s));
     }
 
     return true;
@@ -1101,6 +1116,13 @@ void WaveAxes::clear()
         spikeBuffer.add(nullptr);
     }
 
+    {
+        const ScopedLock lock(newSpikesLock);
+        newSpikes.clear();
+    }
+
+    waveformImageValid = false;
+
     repaint();
 }
 
@@ -1264,6 +1286,8 @@ void ProjectionAxes::paint(Graphics& g)
     //g.setColour(Colours::orange);
     //g.fillRect(5,5,getWidth()-5, getHeight()-5);
 
+    drawNewPeaks();
+
     g.drawImage(projectionImage,
                 0, 0, getWidth(), getHeight(),
                 0, imageDim-rangeY, rangeX, rangeY);
@@ -1279,34 +1303,46 @@ bool ProjectionAxes::updateSpikeData(const SpikeEvent* s)
     int idx1, idx2;
     calcWaveformPeakIdx(s, ampDim1, ampDim2, &idx1, &idx2);
 
-    // add peaks to image
-    Colour col;
+	const float* data = s->getDataPointer();
 
+    // called by the processor; the peaks are drawn on the next repaint
+    const ScopedLock lock(newPeaksLock);
+    newPeaks.add(Point<float>(data[idx1], data[idx2]));
+
+    return true;
+}
+
+void ProjectionAxes::drawNewPeaks()
+{
+    Array<Point<float>> peaks;
+
+    {
+        const ScopedLock lock(newPeaksLock);
+        peaks.swapWith(newPeaks);
+    }
+
+    // add peaks to image
 	//Again, fix this adding proper metadata check
     //if (s.sortedId > 0)
     //    col = Colour(s.color[0], s.color[1], s.color[2]);
-    //else
-        col = Colours::white;
-
-	const float* data = s->getDataPointer();
-    updateProjectionImage(data[idx1], data[idx2], 1, col);
-
-    return true;
+    for (auto& peak : peaks)
+        updateProjectionImage(peak.x, peak.y, 1, Colours::white);
 }
 
 void ProjectionAxes::updateProjectionImage(float x, float y, float gain, Colour col)
 {
-    Graphics g(projectionImage);
-
     // h/2 + float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f / range * h;
 
     if (gain != 0)
     {
-		float xf = x;
-        float yf = float(imageDim) - y; // in microvolts
+        // a 2x2 splat written straight into the pixels, like the ellipse it replaces
+        const int xi = roundToInt(x);
+        const int yi = roundToInt(float(imageDim) - y); // in microvolts
 
-        g.setColour(col);
-        g.fillEllipse(xf,yf,2.0f,2.0f);
+        const Rectangle<int> splat = Rectangle<int>(xi, yi, 2, 2).getIntersection(projectionImage.getBounds());
+
+        if (!splat.isEmpty())
+            projectionImage.clear(splat, col);
     }
 
 }
@@ -1338,6 +1374,11 @@ void ProjectionAxes::calcWaveformPeakIdx(const SpikeEvent* s, int d1, int d2, in
 
 void ProjectionAxes::clear()
 {
+    {
+        const ScopedLock lock(newPeaksLock);
+        newPeaks.clear();
+    }
+
     projectionImage.clear(Rectangle<int>(0, 0, projectionImage.getWidth(), projectionImage.getHeight()),
                           Colours::black);
 
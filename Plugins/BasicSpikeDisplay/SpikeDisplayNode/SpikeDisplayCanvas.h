@@ -48,6 +48,9 @@
 #define MAX_NUMBER_OF_SPIKE_SOURCES 128
 #define MAX_N_CHAN 4
 
+// alpha kept by the waveforms already drawn each time a new spike is added
+#define WAVEFORM_DECAY 0.75f
+
 class SpikeDisplayNode;
 
 class SpikeDisplay;
@@ -333,6 +336,8 @@ public:
 
     void clear();
 
+    void resized();
+
     void mouseMove(const MouseEvent& event);
     void mouseExit(const MouseEvent& event);
     void mouseDown(const MouseEvent& event);
@@ -356,6 +361,7 @@ public:
     void invertSpikes(bool shouldInvert)
     {
         spikesInverted = shouldInvert;
+        waveformImageValid = false;
         repaint();
     }
 
@@ -374,11 +380,22 @@ private:
 
     void drawThresholdSlider(Graphics& g);
 
-    int spikesReceivedSinceLastRedraw;
+    /** Draws the spikes received since the last repaint into waveformImage, or redraws
+        the whole buffer if the image has been invalidated */
+    void updateWaveformImage();
 
     Font font;
 
-   OwnedArray<SpikeEvent> spikeBuffer;
+    /** Most recent spikes, only used on the message thread */
+    OwnedArray<SpikeEvent> spikeBuffer;
+
+    /** Spikes added by the processor since the last repaint */
+    OwnedArray<SpikeEvent> newSpikes;
+    CriticalSection newSpikesLock;
+
+    /** Waveforms drawn so far, fading as new ones are added on top */
+    Image waveformImage;
+    bool waveformImageValid;
 
     int spikeIndex;
     int bufferSize;
@@ -425,12 +442,19 @@ private:
 
     void updateProjectionImage(float, float, float, Colour);
 
+    /** Splats the peaks received since the last repaint into projectionImage */
+    void drawNewPeaks();
+
     void calcWaveformPeakIdx(const SpikeEvent*, int, int, int*, int*);
 
     int ampDim1, ampDim2;
 
     Image projectionImage;
 
+    /** Peaks added by the processor since the last repaint */
+    Array<Point<float>> newPeaks;
+    CriticalSection newPeaksLock;
+
     Colour pointColour;
     Colour gridColour;
 
@@ -30,7 +30,6 @@
 SpikeDisplayNode::SpikeDisplayNode()
     : GenericProcessor  ("Spike Viewer")
     , displayBufferSize (5)
-    ,  redrawRequested  (false)
     , isRecording       (false)
 {
     setProcessorType (PROCESSOR_TYPE_SINK);
@@ -61,8 +60,11 @@ void SpikeDisplayNode::updateSettings()
 		elec->numChannels = spikeChannelArray[i]->getNumChannels();
 		elec->bitVolts = spikeChannelArray[i]->getChannelBitVolts(0); //lets assume all channels have the same bitvolts
 		elec->name = spikeChannelArray[i]->getName();
-		elec->currentSpikeIndex = 0;
-		elec->mostRecentSpikes.ensureStorageAllocated(displayBufferSize);
+		elec->readPosition = -1;
+		elec->spikePlot = nullptr;
+
+		for (int j = 0; j < spikeChannelArray[i]->getEventMetaDataCount(); ++j)
+			elec->metaData.add(new MetaDataValue(*spikeChannelArray[i]->getEventMetaDataDescriptor(j)));
 
 		for (int j = 0; j < elec->numChannels; ++j)
 		{
@@ -85,6 +87,7 @@ bool SpikeDisplayNode::enable()
 	for (int i = 0; i < spikeChannelArray.size(); i ++)
 	{
 		Electrode* elec = electrodes[i];
+		elec->readPosition = -1; // from the spikes of this acquisition
 		//elec->recordIndex = CoreServices::RecordNode::addSpikeElectrode(spikeChannelArray[i]);
 	}
 
@@ -177,94 +180,85 @@ void SpikeDisplayNode::setParameter (int param, float val)
     {
         isRecording = true;
     }
-    else if (param == 2)   // redraw
-    {
-        redrawRequested = true;
-    }
 }
 
 
 void SpikeDisplayNode::process (AudioSampleBuffer& buffer)
 {
-    checkForEvents (true); // automatically calls 'handleEvent
+    // the spikes are read from the SpikeWaveformStore by transferSpikes()
+}
 
-    if (redrawRequested)
-    {
-        // update incoming thresholds
-        for (int i = 0; i < getNumElectrodes(); ++i)
-        {
-            Electrode* e = electrodes[i];
 
-            // update thresholds
-            for (int j = 0; j < e->numChannels; ++j)
-            {
-                e->displayThresholds.set (j,
-                                         e->spikePlot->getDisplayThresholdForChannel (j));
+void SpikeDisplayNode::transferSpikes()
+{
+    SpikeWaveformStore* store = SpikeWaveformStore::getInstance();
 
-                e->spikePlot->setDetectorThresholdForChannel (j, e->detectorThresholds[j]);
-            }
+    for (int i = 0; i < getNumElectrodes(); ++i)
+    {
+        Electrode* e = electrodes[i];
+        const SpikeChannel* channel = spikeChannelArray[i];
 
-            // transfer buffered spikes to spike plot
-            for (int j = 0; j < e->currentSpikeIndex; ++j)
-            {
-                //std::cout << "Transferring spikes." << std::endl;
-                e->spikePlot->processSpikeObject (e->mostRecentSpikes[j]);
-                e->currentSpikeIndex = 0;
-            }
+        if (e->spikePlot == nullptr)
+            continue;
+
+        // update thresholds
+        for (int j = 0; j < e->numChannels; ++j)
+        {
+            e->displayThresholds.set (j, e->spikePlot->getDisplayThresholdForChannel (j));
         }
 
-        redrawRequested = false;
-    }
-}
+        store->readNew (channel, e->readPosition, SPIKE_DISPLAY_CANDIDATES, storedSpikes);
 
+        const int numSamples = storedSpikes.numSamples;
+        int numShown = 0;
 
-void SpikeDisplayNode::handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition)
-{
-	SpikeEventPtr newSpike = SpikeEvent::deserializeFromMessage(event, spikeInfo);
-	if (!newSpike) return;
+        for (int k = 0; k < storedSpikes.size(); ++k)
+        {
+            const float* thresholds = storedSpikes.getThresholds (k);
+            const float* waveform = storedSpikes.getWaveform (k);
 
-	int electrodeNum = getSpikeChannelIndex(newSpike);
+            bool aboveThreshold = false;
 
-	Electrode* e = electrodes[electrodeNum];
-	// std::cout << electrodeNum << std::endl;
+            for (int j = 0; j < e->numChannels; ++j)
+            {
+                e->detectorThresholds.set (j, thresholds[j]);
 
-	bool aboveThreshold = false;
+                aboveThreshold = aboveThreshold | checkThreshold (e->displayThresholds[j], waveform + j * numSamples, numSamples);
+            }
 
-	// update threshold / check threshold
-	for (int i = 0; i < e->numChannels; ++i)
-	{
-		e->detectorThresholds.set(i, float(newSpike->getThreshold(i))); // / float(newSpike.gain[i]));
+            if (! aboveThreshold || numShown >= displayBufferSize)
+                continue;
 
-		aboveThreshold = aboveThreshold | checkThreshold(i, e->displayThresholds[i], newSpike);
-	}
+            SpikeEvent::SpikeBuffer data (channel);
+            for (int j = 0; j < e->numChannels; ++j)
+                data.set (j, waveform + j * numSamples, numSamples);
 
-	if (aboveThreshold)
-	{
-		// save spike
-		if (false)
-		{
-			//CoreServices::RecordNode::writeSpike(newSpike, spikeInfo);
-		}
-		// add to buffer
-		if (e->currentSpikeIndex < displayBufferSize)
-		{
-			//This releases the spike from the smart pointer to avoid copies, so it's done latest.
-			e->mostRecentSpikes.set(e->currentSpikeIndex, newSpike.release());
-			e->currentSpikeIndex++;
-		}
+            Array<float> spikeThresholds (thresholds, e->numChannels);
 
-		
-	}
+            SpikeEventPtr spike = (e->metaData.size() > 0)
+                ? SpikeEvent::createSpikeEvent (channel, storedSpikes.timestamps[k], spikeThresholds, data, storedSpikes.sortedIds[k], e->metaData)
+                : SpikeEvent::createSpikeEvent (channel, storedSpikes.timestamps[k], spikeThresholds, data, storedSpikes.sortedIds[k]);
+
+            if (spike != nullptr)
+            {
+                e->spikePlot->processSpikeObject (spike);
+                ++numShown;
+            }
+        }
+
+        for (int j = 0; j < e->numChannels; ++j)
+        {
+            e->spikePlot->setDetectorThresholdForChannel (j, e->detectorThresholds[j]);
+        }
+    }
 }
 
 
-bool SpikeDisplayNode::checkThreshold (int chan, float thresh, SpikeEvent* s)
+bool SpikeDisplayNode::checkThreshold (float thresh, const float* waveform, int numSamples) const
 {
-	int nSamples = getSpikeChannel(getSpikeChannelIndex(s))->getTotalSamples();
-
-    for (int i = 0; i < nSamples-1; ++i)
+    for (int i = 0; i < numSamples-1; ++i)
     {
-        if  (s->getDataPointer(chan)[i]  > thresh)
+        if  (waveform[i] > thresh)
         {
             return true;
         }
@@ -30,12 +30,19 @@
 class DataViewport;
 class SpikePlot;
 
+/** Spikes per electrode checked against the display thresholds at each refresh */
+#define SPIKE_DISPLAY_CANDIDATES 64
+
 
 /**
-  Takes in MidiEvents and extracts SpikeObjects from the MidiEvent buffers.
-  Those Events are then held in a queue until they are pulled by the SpikeDisplayCanvas.
+  Shows the spikes of the electrodes upstream.
+
+  The spikes are not received through the event buffers: at each refresh of the
+  SpikeDisplayCanvas, the spikes written to the SpikeWaveformStore since the last one
+  are read, on the message thread, and the first ones above the display thresholds
+  are passed to the spike plots.
 
-  @see GenericProcessor, SpikeDisplayEditor, SpikeDisplayCanvas
+  @see GenericProcessor, SpikeDisplayEditor, SpikeDisplayCanvas, SpikeWaveformStore
 */
 class SpikeDisplayNode :  public GenericProcessor
 {
@@ -47,9 +54,9 @@ public:
 
     void process (AudioSampleBuffer& buffer) override;
 
-    void setParameter (int parameterIndex, float newValue) override;
+    bool isSheddable() const override { return true; }
 
-	void handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition) override;
+    void setParameter (int parameterIndex, float newValue) override;
 
     void updateSettings() override;
 
@@ -66,7 +73,10 @@ public:
     void addSpikePlotForElectrode (SpikePlot* sp, int i);
     void removeSpikePlots();
 
-    bool checkThreshold (int, float, SpikeEvent*);
+    /** Passes the spikes written since the last call to the spike plots. Called by the canvas. */
+    void transferSpikes();
+
+    bool checkThreshold (float thresh, const float* waveform, int numSamples) const;
 
 
 private:
@@ -76,12 +86,13 @@ private:
 
         int numChannels;
         int recordIndex;
-        int currentSpikeIndex;
+        juce::int64 readPosition;
 
         Array<float> displayThresholds;
         Array<float> detectorThresholds;
 
-        OwnedArray<SpikeEvent> mostRecentSpikes;
+        /** Default values of the spike channel's metadata, which the plots don't show */
+        MetaDataValueArray metaData;
 
 		float bitVolts;
 
@@ -91,7 +102,8 @@ private:
     OwnedArray<Electrode> electrodes;
 
     int displayBufferSize;
-    bool redrawRequested;
+
+    SpikeWaveformStore::Spikes storedSpikes;
 
     // members for recording
     bool isRecording;
@@ -22,6 +22,7 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
 
 #include "CAR.h"
 #include "CAREditor.h"
@@ -29,10 +30,11 @@
 
 CAR::CAR()
     : GenericProcessor ("Common Avg Ref") //, threshold(200.0), state(true)
+    , m_referenceMode (MEAN_REFERENCE)
+    , m_referenceTiles (CAR_MAX_GROUPS, CAR_TILE_SIZE)
+    , m_medianScratchSize (0)
 {
     setProcessorType (PROCESSOR_TYPE_FILTER);
-
-    m_avgBuffer = AudioSampleBuffer (1, 10000); // 1-dimensional buffer to hold the avg
 }
 
 
@@ -48,6 +50,15 @@ AudioProcessorEditor* CAR::createEditor()
 }
 
 
+void CAR::updateSettings()
+{
+    const ScopedLock myScopedLock (objectLock);
+
+    m_medianScratchSize = jmax (1, getNumInputs());
+    m_medianScratch.malloc (m_medianScratchSize);
+}
+
+
 float CAR::getGainLevel()
 {
     m_gainLevel.updateTarget();
@@ -61,81 +72,154 @@ void CAR::setGainLevel (float newGain)
 }
 
 
+CAR::ReferenceMode CAR::getReferenceMode() const
+{
+    return static_cast<ReferenceMode> (m_referenceMode.get());
+}
+
+
+void CAR::setReferenceMode (ReferenceMode newMode)
+{
+    m_referenceMode = newMode;
+}
+
+
 void CAR::process (AudioSampleBuffer& buffer)
 {
-    const int numSamples            = buffer.getNumSamples();
-    const int numReferenceChannels  = m_referenceChannels.size();
-    const int numAffectedChannels   = m_affectedChannels.size();
+    // Skip a block rather than wait for the editor to finish changing the channels
+    const ScopedTryLock myScopedLock (objectLock);
+    if (! myScopedLock.isLocked())
+        return;
+
+    const int numSamples = buffer.getNumSamples();
 
-    // There are no sense to do any processing if either number of reference or affected channels is zero.
-    if (! numReferenceChannels
-        || ! numAffectedChannels)
+    m_gainLevel.updateTarget();
+    const float gain = -1.0f * m_gainLevel.getNextValue() / 100.f;
+
+    // There are no sense to do any processing for a group if either number of reference or affected channels is zero.
+    const ReferenceGroup* activeGroups[CAR_MAX_GROUPS];
+    int numActiveGroups = 0;
+
+    for (int g = 0; g < CAR_MAX_GROUPS; ++g)
     {
-        return;
+        if (m_groups[g].referenceChannels.size() > 0
+            && m_groups[g].affectedChannels.size() > 0)
+        {
+            activeGroups[numActiveGroups++] = &m_groups[g];
+        }
     }
 
-    m_avgBuffer.clear();
-
-    for (int i = 0; i < numReferenceChannels; ++i)
+    for (int startSample = 0; startSample < numSamples; startSample += CAR_TILE_SIZE)
     {
-        m_avgBuffer.addFrom (0,                         // destChannel
-                             0,                         // destStartSample
-                             buffer,                    // source
-                             m_referenceChannels[i],    // sourceChannel
-                             0,                         // sourceStartSample
-                             numSamples,                // numSamples
-                             1.0f);                     // gain to apply
+        const int tileSize = jmin (CAR_TILE_SIZE, numSamples - startSample);
+
+        // A channel can be affected by one group and a reference of another, so all
+        // references are computed before any channel is changed
+        for (int g = 0; g < numActiveGroups; ++g)
+            computeReference (*activeGroups[g], buffer, startSample, tileSize, m_referenceTiles.getWritePointer (g));
+
+        for (int g = 0; g < numActiveGroups; ++g)
+        {
+            const float* reference = m_referenceTiles.getReadPointer (g);
+            const Array<int>& affectedChannels = activeGroups[g]->affectedChannels;
+
+            for (int i = 0; i < affectedChannels.size(); ++i)
+            {
+                FloatVectorOperations::addWithMultiply (buffer.getWritePointer (affectedChannels[i], startSample),
+                                                        reference, gain, tileSize);
+            }
+        }
     }
+}
 
-    m_avgBuffer.applyGain (1.0f / float (numReferenceChannels));
 
-    m_gainLevel.updateTarget();
-    const float gain = -1.0f * m_gainLevel.getNextValue() / 100.f;
+void CAR::computeReference (const ReferenceGroup& group, const AudioSampleBuffer& buffer,
+                            int startSample, int numSamples, float* reference)
+{
+    const Array<int>& referenceChannels = group.referenceChannels;
+    const int numReferenceChannels = referenceChannels.size();
 
-    for (int i = 0; i < numAffectedChannels; ++i)
+    if (getReferenceMode() == MEDIAN_REFERENCE && numReferenceChannels <= m_medianScratchSize)
     {
-        buffer.addFrom (m_affectedChannels[i],  // destChannel
-                        0,                      // destStartSample
-                        m_avgBuffer,            // source
-                        0,                      // sourceChannel
-                        0,                      // sourceStartSample
-                        numSamples,             // numSamples
-                        gain);                  // gain to apply
+        const int middle = numReferenceChannels / 2;
+        float* values = m_medianScratch.getData();
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            for (int i = 0; i < numReferenceChannels; ++i)
+                values[i] = buffer.getReadPointer (referenceChannels[i])[startSample + n];
+
+            std::nth_element (values, values + middle, values + numReferenceChannels);
+            float median = values[middle];
+
+            if ((numReferenceChannels & 1) == 0)
+                median = (median + *std::max_element (values, values + middle)) / 2;
+
+            reference[n] = median;
+        }
+        return;
     }
+
+    FloatVectorOperations::copy (reference, buffer.getReadPointer (referenceChannels[0], startSample), numSamples);
+
+    for (int i = 1; i < numReferenceChannels; ++i)
+        FloatVectorOperations::add (reference, buffer.getReadPointer (referenceChannels[i], startSample), numSamples);
+
+    FloatVectorOperations::multiply (reference, 1.0f / float (numReferenceChannels), numSamples);
+}
+
+
+Array<int> CAR::getReferenceChannels (int group) const
+{
+    const ScopedLock myScopedLock (objectLock);
+
+    return m_groups[group].referenceChannels;
 }
 
 
-void CAR::setReferenceChannels (const Array<int>& newReferenceChannels)
+Array<int> CAR::getAffectedChannels (int group) const
 {
     const ScopedLock myScopedLock (objectLock);
 
-    m_referenceChannels = Array<int> (newReferenceChannels);
+    return m_groups[group].affectedChannels;
 }
 
 
-void CAR::setAffectedChannels (const Array<int>& newAffectedChannels)
+void CAR::setReferenceChannels (const Array<int>& newReferenceChannels, int group)
 {
     const ScopedLock myScopedLock (objectLock);
 
-    m_affectedChannels = Array<int> (newAffectedChannels);
+    m_groups[group].referenceChannels = Array<int> (newReferenceChannels);
 }
 
 
-void CAR::setReferenceChannelState (int channel, bool newState)
+void CAR::setAffectedChannels (const Array<int>& newAffectedChannels, int group)
 {
+    const ScopedLock myScopedLock (objectLock);
+
+    m_groups[group].affectedChannels = Array<int> (newAffectedChannels);
+}
+
+
+void CAR::setReferenceChannelState (int channel, bool newState, int group)
+{
+    const ScopedLock myScopedLock (objectLock);
+
     if (! newState)
-        m_referenceChannels.removeFirstMatchingValue (channel);
+        m_groups[group].referenceChannels.removeFirstMatchingValue (channel);
     else
-        m_referenceChannels.addIfNotAlreadyThere (channel);
+        m_groups[group].referenceChannels.addIfNotAlreadyThere (channel);
 }
 
 
-void CAR::setAffectedChannelState (int channel, bool newState)
+void CAR::setAffectedChannelState (int channel, bool newState, int group)
 {
+    const ScopedLock myScopedLock (objectLock);
+
     if (! newState)
-        m_affectedChannels.removeFirstMatchingValue (channel);
+        m_groups[group].affectedChannels.removeFirstMatchingValue (channel);
     else
-        m_affectedChannels.addIfNotAlreadyThere (channel);
+        m_groups[group].affectedChannels.addIfNotAlreadyThere (channel);
 }
 
 void CAR::saveCustomChannelParametersToXml(XmlElement* channelElement,
@@ -143,15 +227,22 @@ void CAR::saveCustomChannelParametersToXml(XmlElement* channelElement,
 {
     if (channelType == InfoObjectCommon::DATA_CHANNEL)
     {
-        XmlElement* groupState = channelElement->createNewChildElement("GROUPSTATE");
-        
-        const Array<int>& referenceChannels = getReferenceChannels();
-        bool isReferenceChannel = referenceChannels.contains(channelNumber);
-        groupState->setAttribute("reference", isReferenceChannel);
-
-        const Array<int>& affectedChannels = getAffectedChannels();
-        bool isAffectedChannel = affectedChannels.contains(channelNumber);
-        groupState->setAttribute("affected", isAffectedChannel);
+        const ScopedLock myScopedLock (objectLock);
+
+        for (int group = 0; group < CAR_MAX_GROUPS; ++group)
+        {
+            bool isReferenceChannel = m_groups[group].referenceChannels.contains(channelNumber);
+            bool isAffectedChannel = m_groups[group].affectedChannels.contains(channelNumber);
+
+            // the first group is always saved, as older versions only know about it
+            if (group > 0 && ! isReferenceChannel && ! isAffectedChannel)
+                continue;
+
+            XmlElement* groupState = channelElement->createNewChildElement("GROUPSTATE");
+            groupState->setAttribute("group", group);
+            groupState->setAttribute("reference", isReferenceChannel);
+            groupState->setAttribute("affected", isAffectedChannel);
+        }
     }
 }
 
@@ -164,16 +255,18 @@ void CAR::loadCustomChannelParametersFromXml(XmlElement* channelElement,
 
         forEachXmlChildElementWithTagName(*channelElement, groupState, "GROUPSTATE")
         {
+            int group = jlimit(0, CAR_MAX_GROUPS - 1, groupState->getIntAttribute("group", 0));
+
             if (groupState->hasAttribute("reference"))
             {
                 bool isReferenceChannel = groupState->getBoolAttribute("reference");
-                setReferenceChannelState(channelNumber, isReferenceChannel);
+                setReferenceChannelState(channelNumber, isReferenceChannel, group);
             }
 
             if (groupState->hasAttribute("affected"))
             {
                 bool isAffectedChannel = groupState->getBoolAttribute("affected");
-                setAffectedChannelState(channelNumber, isAffectedChannel);
+                setAffectedChannelState(channelNumber, isAffectedChannel, group);
             }
         }
     }
@@ -31,10 +31,21 @@
 
 #include <ProcessorHeaders.h>
 
+/** Number of independent reference groups, e.g. one per probe shank */
+#define CAR_MAX_GROUPS 8
+
+/** Number of samples referenced at a time, so the channels stay in cache between
+    computing the reference and subtracting it */
+#define CAR_TILE_SIZE 64
+
 /**
     This is a simple filter that subtracts the average of all other channels from 
     each channel. The gain parameter allows you to subtract a percentage of the total avg.
 
+    Channels can be split into independent groups, each with its own reference and
+    affected channels, and the reference can be either the mean or the median of the
+    group's reference channels.
+
     See Ludwig et al. 2009 Using a common average reference to improve cortical
     neuron recordings from microelectrode arrays. J. Neurophys, 2009 for a detailed
     discussion
@@ -42,6 +53,12 @@
 class CAR : public GenericProcessor
 {
 public:
+    enum ReferenceMode
+    {
+        MEAN_REFERENCE = 0,
+        MEDIAN_REFERENCE
+    };
+
     /** The class constructor, used to initialize any members. */
     CAR();
 
@@ -68,17 +85,22 @@ public:
     /** Sets the new gain level that will be used in the processor */
     void setGainLevel (float newGain);
 
+    ReferenceMode getReferenceMode() const;
+    void setReferenceMode (ReferenceMode newMode);
+
     /** Creates the CAREditor. */
     AudioProcessorEditor* createEditor() override;
 
-    Array<int> getReferenceChannels() const     { return m_referenceChannels; }
-    Array<int> getAffectedChannels()  const     { return m_affectedChannels; }
+    void updateSettings() override;
+
+    Array<int> getReferenceChannels (int group = 0) const;
+    Array<int> getAffectedChannels  (int group = 0) const;
 
-    void setReferenceChannels (const Array<int>& newReferenceChannels);
-    void setAffectedChannels  (const Array<int>& newAffectedChannels);
+    void setReferenceChannels (const Array<int>& newReferenceChannels, int group = 0);
+    void setAffectedChannels  (const Array<int>& newAffectedChannels,  int group = 0);
 
-    void setReferenceChannelState (int channel, bool newState);
-    void setAffectedChannelState  (int channel, bool newState);
+    void setReferenceChannelState (int channel, bool newState, int group = 0);
+    void setAffectedChannelState  (int channel, bool newState, int group = 0);
 
     /** Saving/loading channel parameters */
     void saveCustomChannelParametersToXml(XmlElement* channelElement,
@@ -87,9 +109,29 @@ public:
         InfoObjectCommon::InfoObjectType channelType);
 
 private:
+    struct ReferenceGroup
+    {
+        /** Array of channels which will be used to calculate mean signal. */
+        Array<int> referenceChannels;
+
+        /** Array of channels that will be affected by adding/substracting of mean signal of reference channels */
+        Array<int> affectedChannels;
+    };
+
+    /** Computes the reference of a group for a tile of samples */
+    void computeReference (const ReferenceGroup& group, const AudioSampleBuffer& buffer,
+                           int startSample, int numSamples, float* reference);
+
     LinearSmoothedValueAtomic<float> m_gainLevel;
 
-    AudioSampleBuffer m_avgBuffer;
+    Atomic<int> m_referenceMode;
+
+    /** The reference of each active group, for the current tile */
+    AudioSampleBuffer m_referenceTiles;
+
+    /** Room for one sample of every reference channel, to find their median */
+    HeapBlock<float> m_medianScratch;
+    int m_medianScratchSize;
 
     /** We should add this for safety to prevent any app crashes or invalid data processing.
         Since we use m_referenceChannels and m_affectedChannels arrays in the process() function,
@@ -100,11 +142,7 @@ private:
     */
     CriticalSection objectLock;
 
-    /** Array of channels which will be used to calculate mean signal. */
-    Array<int> m_referenceChannels;
-
-    /** Array of channels that will be affected by adding/substracting of mean signal of reference channels */
-    Array<int> m_affectedChannels;
+    ReferenceGroup m_groups[CAR_MAX_GROUPS];
 
     // ==================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CAR);
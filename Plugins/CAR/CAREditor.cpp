@@ -33,6 +33,7 @@ static const Colour COLOUR_ACCENT  (Colour::fromRGB (3, 169, 244));
 CAREditor::CAREditor (GenericProcessor* parentProcessor, bool useDefaultParameterEditors)
     : GenericEditor (parentProcessor, useDefaultParameterEditors)
     , m_currentChannelsView          (REFERENCE_CHANNELS)
+    , m_currentGroup                 (0)
     , m_channelSelectorButtonManager (new LinearButtonGroupManager)
     , m_gainSlider                   (new ParameterSlider (0.0, 100.0, 100.0, Font("Default", 13.f, Font::plain)))
 {
@@ -66,6 +67,22 @@ CAREditor::CAREditor (GenericProcessor* parentProcessor, bool useDefaultParamete
     m_gainSlider->addListener (this);
     addAndMakeVisible (m_gainSlider);
 
+    m_groupSelector = new ComboBox ("Group");
+    for (int group = 0; group < CAR_MAX_GROUPS; ++group)
+        m_groupSelector->addItem ("Group " + String (group + 1), group + 1);
+    m_groupSelector->setSelectedId (1, dontSendNotification);
+    m_groupSelector->setTooltip ("Each group has its own reference and affected channels");
+    m_groupSelector->addListener (this);
+    addAndMakeVisible (m_groupSelector);
+
+    m_referenceModeSelector = new ComboBox ("Reference mode");
+    m_referenceModeSelector->addItem ("Mean",   CAR::MEAN_REFERENCE + 1);
+    m_referenceModeSelector->addItem ("Median", CAR::MEDIAN_REFERENCE + 1);
+    m_referenceModeSelector->setSelectedId (CAR::MEAN_REFERENCE + 1, dontSendNotification);
+    m_referenceModeSelector->setTooltip ("Subtract the mean or the median of the reference channels");
+    m_referenceModeSelector->addListener (this);
+    addAndMakeVisible (m_referenceModeSelector);
+
     channelSelector->paramButtonsToggledByDefault (false);
 
     setDesiredWidth (280);
@@ -93,7 +110,9 @@ void CAREditor::paint (Graphics& g)
 
 void CAREditor::resized()
 {
-    m_channelSelectorButtonManager->setBounds (110, 50, 150, 36);
+    m_channelSelectorButtonManager->setBounds (110, 40, 150, 36);
+    m_groupSelector->setBounds (110, 86, 72, 20);
+    m_referenceModeSelector->setBounds (188, 86, 72, 20);
 
     m_gainSlider->setBounds (15, 30, 80, 80);
 
@@ -108,32 +127,57 @@ void CAREditor::buttonClicked (Button* buttonThatWasClicked)
     // "Reference channels" button clicked
     if (buttonName.startsWith ("reference"))
     {
-        channelSelector->setActiveChannels (static_cast<CAR*> (getProcessor())->getReferenceChannels());
-
         m_currentChannelsView = REFERENCE_CHANNELS;
+        updateChannelSelector();
     }
     // "Affected channels" button clicked
     else if (buttonName.startsWith ("affected"))
     {
-        channelSelector->setActiveChannels (static_cast<CAR*> (getProcessor())->getAffectedChannels());
-
         m_currentChannelsView = AFFECTED_CHANNELS;
+        updateChannelSelector();
     }
 
     GenericEditor::buttonClicked (buttonThatWasClicked);
 }
 
 
+void CAREditor::comboBoxChanged (ComboBox* comboBoxThatHasChanged)
+{
+    auto processor = static_cast<CAR*> (getProcessor());
+
+    if (comboBoxThatHasChanged == m_groupSelector)
+    {
+        m_currentGroup = m_groupSelector->getSelectedId() - 1;
+        updateChannelSelector();
+    }
+    else if (comboBoxThatHasChanged == m_referenceModeSelector)
+    {
+        processor->setReferenceMode (static_cast<CAR::ReferenceMode> (m_referenceModeSelector->getSelectedId() - 1));
+    }
+}
+
+
+void CAREditor::updateChannelSelector()
+{
+    auto processor = static_cast<CAR*> (getProcessor());
+
+    if (m_currentChannelsView == REFERENCE_CHANNELS)
+        channelSelector->setActiveChannels (processor->getReferenceChannels (m_currentGroup));
+    else
+        channelSelector->setActiveChannels (processor->getAffectedChannels (m_currentGroup));
+}
+
+
 void CAREditor::channelChanged (int channel, bool newState)
 {
     auto processor = static_cast<CAR*> (getProcessor());
     if (m_currentChannelsView == REFERENCE_CHANNELS)
     {
-        processor->setReferenceChannelState (channel, newState);
+        processor->setReferenceChannelState (channel, newState, m_currentGroup);
     }
     else
     {
-        processor->setAffectedChannelState (channel, newState);
+        processor->setAffectedChannelState (channel, newState, m_currentGroup);
     }
 }
 
@@ -153,6 +197,7 @@ void CAREditor::saveCustomParameters(XmlElement* xml)
 
     XmlElement* paramValues = xml->createNewChildElement("VALUES");
     paramValues->setAttribute("gainLevel", processor->getGainLevel());
+    paramValues->setAttribute("referenceMode", (int) processor->getReferenceMode());
 }
 
 void CAREditor::loadCustomParameters(XmlElement* xml)
@@ -163,5 +208,8 @@ void CAREditor::loadCustomParameters(XmlElement* xml)
     {
         double gain = xmlNode->getDoubleAttribute("gainLevel", m_gainSlider->getValue());
         m_gainSlider->setValue(gain, sendNotificationSync);
+
+        int mode = xmlNode->getIntAttribute("referenceMode", CAR::MEAN_REFERENCE);
+        m_referenceModeSelector->setSelectedId(mode + 1, sendNotificationSync);
     }
 }
\ No newline at end of file
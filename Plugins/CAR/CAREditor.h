@@ -38,7 +38,8 @@ class ParameterSlider;
 
    @see CAR
 */
-class CAREditor : public GenericEditor
+class CAREditor : public GenericEditor,
+                  public ComboBox::Listener
 {
 public:
     CAREditor (GenericProcessor* parentProcessor, bool useDefaultParameterEditors);
@@ -52,6 +53,10 @@ public:
     // ==========================================================
     void buttonClicked (Button* buttonThatWasClicked) override;
 
+    // ComboBox::Listener methods
+    // ==========================================================
+    void comboBoxChanged (ComboBox* comboBoxThatHasChanged) override;
+
     // GenericEditor methods
     // =========================================================
     /** This methods is called when any sliders that we are listen for change their values */
@@ -69,10 +74,16 @@ private:
         AFFECTED_CHANNELS
     };
 
+    /** Shows the reference or affected channels of the current group in the channel selector */
+    void updateChannelSelector();
+
     ChannelsType m_currentChannelsView;
+    int m_currentGroup;
 
     ScopedPointer<LinearButtonGroupManager> m_channelSelectorButtonManager;
     ScopedPointer<ParameterSlider>          m_gainSlider;
+    ScopedPointer<ComboBox>                 m_groupSelector;
+    ScopedPointer<ComboBox>                 m_referenceModeSelector;
 
     // LookAndFeel
     SharedResourcePointer<MaterialButtonLookAndFeel> m_materialButtonLookAndFeel;
@@ -58,8 +58,10 @@ ChannelMappingEditor::ChannelMappingEditor(GenericProcessor* parentNode, bool us
     addAndMakeVisible(electrodeButtonViewport = new Viewport());
     electrodeButtonViewport->setBounds(10,30,330,70);
     electrodeButtonViewport->setScrollBarsShown(true,false,true,true);
-    electrodeButtonHolder = new Component();
-    electrodeButtonViewport->setViewedComponent(electrodeButtonHolder,false);
+    electrodeGrid = new ElectrodeGrid();
+    electrodeGrid->setListener(this);
+    electrodeGrid->addMouseListener(this, false); // the editor drags the cells in reorder mode
+    electrodeButtonViewport->setViewedComponent(electrodeGrid,false);
     
 
     loadButton = new LoadButton();
@@ -72,6 +74,17 @@ ChannelMappingEditor::ChannelMappingEditor(GenericProcessor* parentNode, bool us
     saveButton->setBounds(305,5,15,15);
     addAndMakeVisible(saveButton);
 
+    // item ids are the reference types plus one
+    referenceTypeSelector = new ComboBox("reference type");
+    referenceTypeSelector->addItem("Channel", ChannelMappingNode::REFERENCE_CHANNEL + 1);
+    referenceTypeSelector->addItem("Mean", ChannelMappingNode::REFERENCE_MEAN + 1);
+    referenceTypeSelector->addItem("Median", ChannelMappingNode::REFERENCE_MEDIAN + 1);
+    referenceTypeSelector->setSelectedId(ChannelMappingNode::REFERENCE_CHANNEL + 1, dontSendNotification);
+    referenceTypeSelector->setBounds(215,5,80,15);
+    referenceTypeSelector->setTooltip("Reference the selected group against a channel, or against the mean or median of its own channels");
+    referenceTypeSelector->addListener(this);
+    addAndMakeVisible(referenceTypeSelector);
+
 
 
     //    channelSelector->setRadioStatus(true);
@@ -136,11 +149,12 @@ void ChannelMappingEditor::createElectrodeButtons(int numNeeded, bool clearPrevi
 
     if (clearPrevious)
     {
-        electrodeButtons.clear();
+        electrodeGrid->setNumElectrodes(0, false);
 
         referenceArray.clear();
         channelArray.clear();
         referenceChannels.clear();
+        referenceTypes.clear();
         enabledChannelArray.clear();
         startButton=0;
         previousClickedChan = -1;
@@ -153,37 +167,18 @@ void ChannelMappingEditor::createElectrodeButtons(int numNeeded, bool clearPrevi
     }
     else
     {
-        startButton = electrodeButtons.size();
+        startButton = electrodeGrid->getNumElectrodes();
         if (startButton > numNeeded) return;
         //row = startButton/16;
         //column = startButton % 16;
     }
 
+    // new positions are selected while reordering, so that they show as enabled
+    electrodeGrid->setNumElectrodes(numNeeded, reorderActive);
+    electrodeGrid->setReorderMode(reorderActive);
+
     for (int i = startButton; i < numNeeded; i++)
     {
-        ElectrodeButton* button = new ElectrodeButton(i+1);
-        electrodeButtons.add(button);
-
-        button->setRadioGroupId(0);
-
-        // if (!getCollapsedState())
-        //     addAndMakeVisible(button);
-        // else
-        electrodeButtonHolder->addAndMakeVisible(button); // determine visibility in refreshButtonLocations()
-
-        button->addListener(this);
-        if (reorderActive)
-        {
-            button->setToggleState(true,dontSendNotification);
-            electrodeButtons[i]->setClickingTogglesState(false);
-            electrodeButtons[i]->addMouseListener(this,false);
-        }
-        else
-        {
-            button->setToggleState(false,dontSendNotification);
-            electrodeButtons[i]->setClickingTogglesState(true);
-        }
-
         referenceArray.add(-1);
 
         getProcessor()->setCurrentChannel(i);
@@ -204,8 +199,15 @@ void ChannelMappingEditor::createElectrodeButtons(int numNeeded, bool clearPrevi
 
             getProcessor()->setParameter(2,i); //Clear reference
             referenceChannels.add(-1);
+            referenceTypes.add(ChannelMappingNode::REFERENCE_CHANNEL);
             referenceButtons[i]->setEnabled(true);
         }
+
+        for (int i = 0; i < NUM_REFERENCES; i++)
+            setReferenceType(i, ChannelMappingNode::REFERENCE_CHANNEL);
+
+        referenceTypeSelector->setSelectedId(ChannelMappingNode::REFERENCE_CHANNEL + 1, dontSendNotification);
+        referenceTypeSelector->setEnabled(true);
     }
     channelSelector->setRadioStatus(true);
 
@@ -215,29 +217,7 @@ void ChannelMappingEditor::createElectrodeButtons(int numNeeded, bool clearPrevi
 void ChannelMappingEditor::refreshButtonLocations()
 {
     electrodeButtonViewport->setVisible(!getCollapsedState());
-    int width = 19;
-    int height = 15;
-    int row = 0;
-    int column = 0;
-    int totalWidth = 0;
-    int totalHeight = 0;
-    for (int i = 0; i < electrodeButtons.size(); i++)
-    {
-        ElectrodeButton* button = electrodeButtons[i];
-        button->setBounds(column*width, row*height, width, height);
-        totalWidth =  jmax(totalWidth, ++column*width);
-        
-        if (column == 1)
-        {
-            totalHeight = jmax(totalHeight, (row + 1)*height);
-        }
-        else if (column == 16)
-        {
-            row++;
-            column = 0;            
-        }
-    }
-    electrodeButtonHolder->setSize(totalWidth,totalHeight);
+    electrodeGrid->updateSize();
 }
 
 void ChannelMappingEditor::collapsedStateChanged()
@@ -250,10 +230,10 @@ void ChannelMappingEditor::buttonEvent(Button* button)
 
     if (button == selectAllButton)
     {
-        for (int i = 0; i < electrodeButtons.size(); i++)
+        for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
         {
-            electrodeButtons[i]->setToggleState(true,dontSendNotification);
-            setChannelReference(electrodeButtons[i]);
+            electrodeGrid->setToggleState(i, true);
+            setChannelReference(i);
         }
         previousClickedChan = -1;
         setConfigured(true);
@@ -288,42 +268,24 @@ void ChannelMappingEditor::buttonEvent(Button* button)
                 referenceButtons[i]->setEnabled(true);
             }
             referenceButtons[0]->setToggleState(true, dontSendNotification);
-            Array<int> a;
+            referenceTypeSelector->setEnabled(true);
 
-            if (referenceChannels[selectedReference] >= 0)
+            if (referenceChannels[selectedReference] >= channelSelector->getNumChannels())
             {
-				if (referenceChannels[selectedReference] < channelSelector->getNumChannels())
-					a.add(referenceChannels[selectedReference]);
-				else
-				{
-					a.add(channelSelector->getNumChannels() - 1);
-					getProcessor()->setCurrentChannel(channelSelector->getNumChannels() - 1);
-					getProcessor()->setParameter(2, selectedReference);
-					referenceChannels.set(selectedReference, channelSelector->getNumChannels() - 1);
-				}
+                getProcessor()->setCurrentChannel(channelSelector->getNumChannels() - 1);
+                getProcessor()->setParameter(2, selectedReference);
+                referenceChannels.set(selectedReference, channelSelector->getNumChannels() - 1);
             }
-            channelSelector->setActiveChannels(a);
+            showSelectedReference();
+
+            electrodeGrid->setReorderMode(false);
 
-            for (int i = 0; i < electrodeButtons.size(); i++)
+            for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
             {
-                electrodeButtons[i]->setClickingTogglesState(true);
-                electrodeButtons[i]->removeMouseListener(this);
-                if (referenceArray[electrodeButtons[i]->getChannelNum()-1] == selectedReference)
-                {
-                    electrodeButtons[i]->setToggleState(true, dontSendNotification);
-                }
-                else
-                {
-                    electrodeButtons[i]->setToggleState(false, dontSendNotification);
-                }
-                if ((enabledChannelArray[electrodeButtons[i]->getChannelNum()-1]) && (electrodeButtons[i]->getChannelNum() <= getProcessor()->getNumInputs()))
-                {
-                    electrodeButtons[i]->setEnabled(true);
-                }
-                else
-                {
-                    electrodeButtons[i]->setEnabled(false);
-                }
+                const int channelNum = electrodeGrid->getChannelNum(i);
+
+                electrodeGrid->setToggleState(i, referenceArray[channelNum-1] == selectedReference);
+                electrodeGrid->setElectrodeEnabled(i, enabledChannelArray[channelNum-1] && (channelNum <= getProcessor()->getNumInputs()));
             }
             selectAllButton->setEnabled(true);
         }
@@ -337,21 +299,14 @@ void ChannelMappingEditor::buttonEvent(Button* button)
                 referenceButtons[i]->setEnabled(false);
                 referenceButtons[i]->setToggleState(false, dontSendNotification);
             }
+            referenceTypeSelector->setEnabled(false);
 
-            for (int i = 0; i < electrodeButtons.size(); i++)
-            {
-                electrodeButtons[i]->setClickingTogglesState(false);
-                electrodeButtons[i]->setEnabled(true);
-                if (enabledChannelArray[electrodeButtons[i]->getChannelNum()-1])
-                {
-                    electrodeButtons[i]->setToggleState(true, dontSendNotification);
-                }
-                else
-                {
-                    electrodeButtons[i]->setToggleState(false, dontSendNotification);
-                }
-                electrodeButtons[i]->addMouseListener(this,false);
+            electrodeGrid->setReorderMode(true);
 
+            for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
+            {
+                electrodeGrid->setElectrodeEnabled(i, true);
+                electrodeGrid->setToggleState(i, enabledChannelArray[electrodeGrid->getChannelNum(i)-1]);
             }
             selectAllButton->setEnabled(false);
         }
@@ -360,163 +315,16 @@ void ChannelMappingEditor::buttonEvent(Button* button)
     {
         selectedReference = ((ElectrodeButton*)button)->getChannelNum()-1;
 
-        Array<int> a;
-
-        if ((referenceChannels[selectedReference] >= 0)
-            && (referenceChannels[selectedReference] < channelSelector->getNumChannels()))
-        {
-            a.add(referenceChannels[selectedReference]);
-        }
-        channelSelector->setActiveChannels(a);
+        showSelectedReference();
 
-        for (int i = 0; i < electrodeButtons.size(); i++)
+        for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
         {
-            if (referenceArray[electrodeButtons[i]->getChannelNum()-1] == selectedReference)
-            {
-                electrodeButtons[i]->setToggleState(true, dontSendNotification);
-            }
-            else
-            {
-                electrodeButtons[i]->setToggleState(false, dontSendNotification);
-            }
+            electrodeGrid->setToggleState(i, referenceArray[electrodeGrid->getChannelNum(i)-1] == selectedReference);
         }
         previousClickedChan = -1;
 
     }
-    else if (electrodeButtons.contains((ElectrodeButton*)button))
-    {
-        if (!reorderActive)
-        {
-            setConfigured(true);
-            int clickedChan = electrodeButtons.indexOf((ElectrodeButton*)button);
-
-            if (ModifierKeys::getCurrentModifiers().isShiftDown() && (previousClickedChan >= 0))
-            {
-                int toChanA = 0;
-                int toChanD = 0;
-                int fromChanA = 0;
-                int fromChanD = 0;
-
-                if (previousShiftClickedChan < 0)
-                {
-                    previousShiftClickedChan = clickedChan;
-                    if (clickedChan > previousClickedChan)
-                    {
-                        toChanA = clickedChan;
-                        fromChanA = previousClickedChan;
-                    }
-                    else
-                    {
-                        toChanA = previousClickedChan;
-                        fromChanA = clickedChan;
-                    }
-                    for (int i = fromChanA; i <= toChanA; i++)
-                    {
-                        electrodeButtons[i]->setToggleState(previousClickedState, dontSendNotification);
-                        setChannelReference(electrodeButtons[i]);
-                    }
-                }
-                else
-                {
-                    if ((clickedChan > previousClickedChan) && (clickedChan > previousShiftClickedChan))
-                    {
-                        fromChanA = previousShiftClickedChan+1;
-                        toChanA = clickedChan;
-                        if (previousShiftClickedChan < previousClickedChan)
-                        {
-                            fromChanD = previousShiftClickedChan;
-                            toChanD = previousClickedChan-1;
-                        }
-                        else
-                        {
-                            fromChanD = -1;
-                        }
-                    }
-                    else if ((clickedChan > previousClickedChan) && (clickedChan < previousShiftClickedChan))
-                    {
-                        fromChanA = -1;
-                        fromChanD = clickedChan+1;
-                        toChanD = previousShiftClickedChan;
-                        button->setToggleState(previousClickedState, dontSendNotification); // Do not toggle this button;
-                    }
-                    else if ((clickedChan < previousClickedChan) && (clickedChan < previousShiftClickedChan))
-                    {
-                        fromChanA = clickedChan;
-                        toChanA = previousShiftClickedChan-1;
-                        if (previousShiftClickedChan > previousClickedChan)
-                        {
-                            fromChanD = previousClickedChan+1;
-                            toChanD = previousShiftClickedChan;
-                        }
-                        else
-                        {
-                            fromChanD = -1;
-                        }
-                    }
-                    else if ((clickedChan < previousClickedChan) && (clickedChan > previousShiftClickedChan))
-                    {
-                        fromChanA = -1;
-                        fromChanD = previousShiftClickedChan;
-                        toChanD = clickedChan - 1;
-                        button->setToggleState(previousClickedState, dontSendNotification); // Do not toggle this button;
-                    }
-                    else if (clickedChan == previousShiftClickedChan)
-                    {
-                        fromChanA = -1;
-                        fromChanD = -1;
-                        button->setToggleState(previousClickedState, dontSendNotification); // Do not toggle this button;
-                    }
-                    else
-                    {
-                        fromChanA = -1;
-                        button->setToggleState(previousClickedState, dontSendNotification); // Do not toggle this button;
-                        if (previousShiftClickedChan < previousClickedChan)
-                        {
-                            fromChanD = previousShiftClickedChan;
-                            toChanD = previousClickedChan - 1;
-                        }
-                        else if (previousShiftClickedChan > previousClickedChan)
-                        {
-                            fromChanD = previousClickedChan + 1;
-                            toChanD = previousShiftClickedChan;
-                        }
-                        else
-                        {
-                            fromChanD = -1;
-                        }
-                    }
-
-                    if (fromChanA >= 0)
-                    {
-                        for (int i = fromChanA; i <= toChanA; i++)
-                        {
-                            electrodeButtons[i]->setToggleState(previousClickedState, dontSendNotification);
-                            setChannelReference(electrodeButtons[i]);
-                        }
-                    }
-                    if (fromChanD >= 0)
-                    {
-                        for (int i = fromChanD; i <= toChanD; i++)
-                        {
-                            electrodeButtons[i]->setToggleState(!previousClickedState, dontSendNotification);
-                            setChannelReference(electrodeButtons[i]);
-                        }
-                    }
-                }
-
-                previousShiftClickedChan = clickedChan;
-            }
-            else
-            {
-                previousClickedChan = clickedChan;
-                previousShiftClickedChan = -1;
-                setChannelReference((ElectrodeButton*)button);
-                previousClickedState = button->getToggleState();
-            }
-
-
-        }
-    } else if (button == saveButton)
+    else if (button == saveButton)
     {
         //std::cout << "Save button clicked." << std::endl;
 
@@ -564,12 +372,145 @@ void ChannelMappingEditor::buttonEvent(Button* button)
     }
 }
 
-void ChannelMappingEditor::setChannelReference(ElectrodeButton* button)
+void ChannelMappingEditor::electrodeClicked(int position)
 {
-    int chan = button->getChannelNum()-1;
+    if (!reorderActive)
+    {
+        setConfigured(true);
+        int clickedChan = position;
+
+        if (ModifierKeys::getCurrentModifiers().isShiftDown() && (previousClickedChan >= 0))
+        {
+            int toChanA = 0;
+            int toChanD = 0;
+            int fromChanA = 0;
+            int fromChanD = 0;
+
+            if (previousShiftClickedChan < 0)
+            {
+                previousShiftClickedChan = clickedChan;
+                if (clickedChan > previousClickedChan)
+                {
+                    toChanA = clickedChan;
+                    fromChanA = previousClickedChan;
+                }
+                else
+                {
+                    toChanA = previousClickedChan;
+                    fromChanA = clickedChan;
+                }
+                for (int i = fromChanA; i <= toChanA; i++)
+                {
+                    electrodeGrid->setToggleState(i, previousClickedState);
+                    setChannelReference(i);
+                }
+            }
+            else
+            {
+                if ((clickedChan > previousClickedChan) && (clickedChan > previousShiftClickedChan))
+                {
+                    fromChanA = previousShiftClickedChan+1;
+                    toChanA = clickedChan;
+                    if (previousShiftClickedChan < previousClickedChan)
+                    {
+                        fromChanD = previousShiftClickedChan;
+                        toChanD = previousClickedChan-1;
+                    }
+                    else
+                    {
+                        fromChanD = -1;
+                    }
+                }
+                else if ((clickedChan > previousClickedChan) && (clickedChan < previousShiftClickedChan))
+                {
+                    fromChanA = -1;
+                    fromChanD = clickedChan+1;
+                    toChanD = previousShiftClickedChan;
+                    electrodeGrid->setToggleState(clickedChan, previousClickedState); // Do not toggle this button;
+                }
+                else if ((clickedChan < previousClickedChan) && (clickedChan < previousShiftClickedChan))
+                {
+                    fromChanA = clickedChan;
+                    toChanA = previousShiftClickedChan-1;
+                    if (previousShiftClickedChan > previousClickedChan)
+                    {
+                        fromChanD = previousClickedChan+1;
+                        toChanD = previousShiftClickedChan;
+                    }
+                    else
+                    {
+                        fromChanD = -1;
+                    }
+                }
+                else if ((clickedChan < previousClickedChan) && (clickedChan > previousShiftClickedChan))
+                {
+                    fromChanA = -1;
+                    fromChanD = previousShiftClickedChan;
+                    toChanD = clickedChan - 1;
+                    electrodeGrid->setToggleState(clickedChan, previousClickedState); // Do not toggle this button;
+                }
+                else if (clickedChan == previousShiftClickedChan)
+                {
+                    fromChanA = -1;
+                    fromChanD = -1;
+                    electrodeGrid->setToggleState(clickedChan, previousClickedState); // Do not toggle this button;
+                }
+                else
+                {
+                    fromChanA = -1;
+                    electrodeGrid->setToggleState(clickedChan, previousClickedState); // Do not toggle this button;
+                    if (previousShiftClickedChan < previousClickedChan)
+                    {
+                        fromChanD = previousShiftClickedChan;
+                        toChanD = previousClickedChan - 1;
+                    }
+                    else if (previousShiftClickedChan > previousClickedChan)
+                    {
+                        fromChanD = previousClickedChan + 1;
+                        toChanD = previousShiftClickedChan;
+                    }
+                    else
+                    {
+                        fromChanD = -1;
+                    }
+                }
+
+                if (fromChanA >= 0)
+                {
+                    for (int i = fromChanA; i <= toChanA; i++)
+                    {
+                        electrodeGrid->setToggleState(i, previousClickedState);
+                        setChannelReference(i);
+                    }
+                }
+                if (fromChanD >= 0)
+                {
+                    for (int i = fromChanD; i <= toChanD; i++)
+                    {
+                        electrodeGrid->setToggleState(i, !previousClickedState);
+                        setChannelReference(i);
+                    }
+                }
+            }
+
+            previousShiftClickedChan = clickedChan;
+        }
+        else
+        {
+            previousClickedChan = clickedChan;
+            previousShiftClickedChan = -1;
+            setChannelReference(clickedChan);
+            previousClickedState = electrodeGrid->getToggleState(clickedChan);
+        }
+    }
+}
+
+void ChannelMappingEditor::setChannelReference(int position)
+{
+    int chan = electrodeGrid->getChannelNum(position)-1;
     getProcessor()->setCurrentChannel(chan);
 
-    if (button->getToggleState())
+    if (electrodeGrid->getToggleState(position))
     {
         referenceArray.set(chan,selectedReference);
         getProcessor()->setParameter(1,selectedReference);
@@ -590,7 +531,51 @@ void ChannelMappingEditor::channelChanged (int channel, bool /*newState*/)
         getProcessor()->setCurrentChannel (channel - 1);
         getProcessor()->setParameter (2, selectedReference);
         referenceChannels.set (selectedReference, channel - 1);
+
+        // picking a channel makes the group a single channel reference again
+        if (referenceTypes[selectedReference] != ChannelMappingNode::REFERENCE_CHANNEL)
+        {
+            setReferenceType (selectedReference, ChannelMappingNode::REFERENCE_CHANNEL);
+            referenceTypeSelector->setSelectedId (ChannelMappingNode::REFERENCE_CHANNEL + 1, dontSendNotification);
+        }
+    }
+}
+
+void ChannelMappingEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == referenceTypeSelector && ! reorderActive)
+    {
+        setConfigured(true);
+        setReferenceType(selectedReference, referenceTypeSelector->getSelectedId() - 1);
+        showSelectedReference();
+    }
+}
+
+void ChannelMappingEditor::setReferenceType(int reference, int type)
+{
+    type = jlimit((int) ChannelMappingNode::REFERENCE_CHANNEL, (int) ChannelMappingNode::REFERENCE_MEDIAN, type);
+    referenceTypes.set(reference, type);
+
+    // the processor takes the reference group as its current channel for this parameter
+    getProcessor()->setCurrentChannel(reference);
+    getProcessor()->setParameter(5, type);
+}
+
+void ChannelMappingEditor::showSelectedReference()
+{
+    const int type = referenceTypes[selectedReference];
+    referenceTypeSelector->setSelectedId(type + 1, dontSendNotification);
+
+    // only single channel references are picked in the channel selector
+    Array<int> a;
+
+    if ((type == ChannelMappingNode::REFERENCE_CHANNEL)
+        && (referenceChannels[selectedReference] >= 0)
+        && (referenceChannels[selectedReference] < channelSelector->getNumChannels()))
+    {
+        a.add(referenceChannels[selectedReference]);
     }
+    channelSelector->setActiveChannels(a);
 }
 
 void ChannelMappingEditor::saveCustomParameters(XmlElement* xml)
@@ -614,6 +599,7 @@ void ChannelMappingEditor::saveCustomParameters(XmlElement* xml)
         XmlElement* referenceXml = xml->createNewChildElement("REFERENCE");
         referenceXml->setAttribute("Number", i);
         referenceXml->setAttribute("Channel",referenceChannels[i]);
+        referenceXml->setAttribute("Type",referenceTypes[i]);
     }
 
 }
@@ -647,9 +633,8 @@ void ChannelMappingEditor::loadCustomParameters(XmlElement* xml)
             referenceArray.set(mapping-1, reference);
             enabledChannelArray.set(mapping-1,enabled);
 
-            electrodeButtons[i]->setChannelNum(mapping);
-            electrodeButtons[i]->setEnabled(enabled);
-            electrodeButtons[i]->repaint();
+            electrodeGrid->setChannelNum(i, mapping);
+            electrodeGrid->setElectrodeEnabled(i, enabled);
 
 
             getProcessor()->setCurrentChannel(i);
@@ -678,21 +663,19 @@ void ChannelMappingEditor::loadCustomParameters(XmlElement* xml)
             getProcessor()->setCurrentChannel(channel);
 
             getProcessor()->setParameter(2,i);
+
+            setReferenceType(i, referenceXml->getIntAttribute("Type", ChannelMappingNode::REFERENCE_CHANNEL));
         }
     }
 
-    for (int i = 0; i < electrodeButtons.size(); i++)
+    for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
     {
-        if (referenceArray[electrodeButtons[i]->getChannelNum()-1] == selectedReference)
-        {
-            electrodeButtons[i]->setToggleState(true, dontSendNotification);
-        }
-        else
-        {
-            electrodeButtons[i]->setToggleState(false, dontSendNotification);
-        }
+        electrodeGrid->setToggleState(i, referenceArray[electrodeGrid->getChannelNum(i)-1] == selectedReference);
     }
 
+    if (! reorderActive)
+        showSelectedReference();
+
     refreshButtonLocations();
 
 }
@@ -701,20 +684,24 @@ void ChannelMappingEditor::mouseDrag(const MouseEvent& e)
 {
     if (reorderActive)
     {
-        if ((!isDragging) && (electrodeButtons.contains((ElectrodeButton*) e.originalComponent)))
+        if ((!isDragging) && (e.originalComponent == electrodeGrid))
         {
-            ElectrodeButton* button = (ElectrodeButton*)e.originalComponent;
+            const int position = electrodeGrid->getElectrodeAt(e.getEventRelativeTo(electrodeGrid).getMouseDownPosition());
+
+            if (position < 0)
+                return;
+
             isDragging = true;
 
             String desc = "EditorDrag/MAP/";
-            desc += button->getChannelNum();
+            desc += electrodeGrid->getChannelNum(position);
 
             const String dragDescription = desc;
 
             Image dragImage(Image::ARGB,20,15,true);
 
             Graphics g(dragImage);
-            if (button->getToggleState())
+            if (electrodeGrid->getToggleState(position))
             {
                 g.setColour(Colours::orange);
             }
@@ -724,89 +711,59 @@ void ChannelMappingEditor::mouseDrag(const MouseEvent& e)
             }
             g.fillAll();
             g.setColour(Colours::black);
-            g.drawText(String(button->getChannelNum()),0,0,20,15,Justification::centred,true);
+            g.drawText(String(electrodeGrid->getChannelNum(position)),0,0,20,15,Justification::centred,true);
 
             dragImage.multiplyAllAlphas(0.6f);
 
             startDragging(dragDescription,this,dragImage,false);
-            button->setVisible(false);
-            initialDraggedButton = electrodeButtons.indexOf(button);
+            electrodeGrid->setHiddenElectrode(position);
+            initialDraggedButton = position;
             lastHoverButton = initialDraggedButton;
-            draggingChannel = button->getChannelNum();
+            draggingChannel = electrodeGrid->getChannelNum(position);
         }
         else if (isDragging)
         {
-            MouseEvent ev = e.getEventRelativeTo(this);
-            int mouseDownY = ev.getMouseDownY()-30;
-            int mouseDownX = ev.getMouseDownX()-10;
-            juce::Point<int> viewPosition =electrodeButtonViewport->getViewPosition();
-            
-            int distanceY = ev.getDistanceFromDragStartY();
-            int distanceX = ev.getDistanceFromDragStartX();
-            
-            int newPosY = viewPosition.getY()+ mouseDownY + distanceY;
-            int newPosX = viewPosition.getX()+ mouseDownX + distanceX;
-            if ( mouseDownY + distanceY > 70){
-                electrodeButtonViewport->setViewPosition(viewPosition.getX(),newPosY);
-            }else if( mouseDownY + distanceY < 0 ){
-                electrodeButtonViewport->setViewPosition(viewPosition.getX(),newPosY);
-            }
-            
-            
-            int col = (newPosX / 19);
-            if (col < 0) col = 0;
-            else if (col > 16) col = 16;
-            int row = (newPosY / 15);
-            if (row < 0) row = 0;
+            // scroll the grid when the mouse goes past the top or bottom of the viewport
+            MouseEvent viewportEvent = e.getEventRelativeTo(electrodeButtonViewport);
+            electrodeButtonViewport->autoScroll(viewportEvent.x, viewportEvent.y, 15, 15);
+
+            MouseEvent ev = e.getEventRelativeTo(electrodeGrid);
 
-            int hoverButton = row*16+col;
+            int col = jlimit(0, ElectrodeGrid::numColumns - 1, ev.x / ElectrodeGrid::electrodeWidth);
+            int row = jmax(0, ev.y / ElectrodeGrid::electrodeHeight);
 
-            if (hoverButton >= electrodeButtons.size())
+            int hoverButton = row*ElectrodeGrid::numColumns+col;
+
+            if (hoverButton >= electrodeGrid->getNumElectrodes())
             {
-                hoverButton = electrodeButtons.size() -1;
+                hoverButton = electrodeGrid->getNumElectrodes() -1;
             }
 
             if (hoverButton != lastHoverButton)
             {
-
-                electrodeButtons[lastHoverButton]->setVisible(true);
-                electrodeButtons[hoverButton]->setVisible(false);
+                // shift the channels in between by one position; only their cells are repainted
+                electrodeGrid->setHiddenElectrode(hoverButton);
 
                 if (lastHoverButton > hoverButton)
                 {
                     for (int i = lastHoverButton; i > hoverButton; i--)
                     {
-                        electrodeButtons[i]->setChannelNum(electrodeButtons[i-1]->getChannelNum());
-                        if (enabledChannelArray[electrodeButtons[i]->getChannelNum()-1]) //Could be more compact, but definitely less legible
-                        {
-                            electrodeButtons[i]->setToggleState(true, dontSendNotification);
-                        }
-                        else
-                        {
-                            electrodeButtons[i]->setToggleState(false, dontSendNotification);
-                        }
+                        electrodeGrid->setChannelNum(i, electrodeGrid->getChannelNum(i-1));
+                        electrodeGrid->setToggleState(i, enabledChannelArray[electrodeGrid->getChannelNum(i)-1]);
                     }
                 }
                 else
                 {
                     for (int i = lastHoverButton; i < hoverButton; i++)
                     {
-                        electrodeButtons[i]->setChannelNum(electrodeButtons[i+1]->getChannelNum());
-                        if (enabledChannelArray[electrodeButtons[i]->getChannelNum()-1])
-                        {
-                            electrodeButtons[i]->setToggleState(true, dontSendNotification);
-                        }
-                        else
-                        {
-                            electrodeButtons[i]->setToggleState(false, dontSendNotification);
-                        }
+                        electrodeGrid->setChannelNum(i, electrodeGrid->getChannelNum(i+1));
+                        electrodeGrid->setToggleState(i, enabledChannelArray[electrodeGrid->getChannelNum(i)-1]);
                     }
                 }
-                electrodeButtons[hoverButton]->setChannelNum(draggingChannel);
-                electrodeButtons[hoverButton]->setToggleState(enabledChannelArray[draggingChannel-1], dontSendNotification);
+                electrodeGrid->setChannelNum(hoverButton, draggingChannel);
+                electrodeGrid->setToggleState(hoverButton, enabledChannelArray[draggingChannel-1]);
 
                 lastHoverButton = hoverButton;
-                repaint();
             }
 
         }
@@ -819,7 +776,7 @@ void ChannelMappingEditor::mouseUp(const MouseEvent& e)
     if (isDragging)
     {
         isDragging = false;
-        electrodeButtons[lastHoverButton]->setVisible(true);
+        electrodeGrid->setHiddenElectrode(-1);
         int from, to;
         if (lastHoverButton == initialDraggedButton)
         {
@@ -838,7 +795,7 @@ void ChannelMappingEditor::mouseUp(const MouseEvent& e)
 
         for (int i=from; i <= to; i++)
         {
-            setChannelPosition(i,electrodeButtons[i]->getChannelNum());
+            setChannelPosition(i,electrodeGrid->getChannelNum(i));
         }
         setConfigured(true);
 		CoreServices::updateSignalChain(this);
@@ -854,47 +811,33 @@ void ChannelMappingEditor::setChannelPosition(int position, int channel)
 
 void ChannelMappingEditor::mouseDoubleClick(const MouseEvent& e)
 {
-    if ((reorderActive) && electrodeButtons.contains((ElectrodeButton*)e.originalComponent))
+    if ((reorderActive) && e.originalComponent == electrodeGrid)
     {
+        const int position = electrodeGrid->getElectrodeAt(e.getEventRelativeTo(electrodeGrid).getPosition());
+
+        if (position < 0)
+            return;
+
         setConfigured(true);
-        ElectrodeButton* button = (ElectrodeButton*)e.originalComponent;
-        if (button->getToggleState())
-        {
-            button->setToggleState(false, dontSendNotification);
-            enabledChannelArray.set(button->getChannelNum()-1,false);
-            getProcessor()->setCurrentChannel(button->getChannelNum()-1);
-            getProcessor()->setParameter(3,0);
-        }
-        else
-        {
-            button->setToggleState(true, dontSendNotification);
-            enabledChannelArray.set(button->getChannelNum()-1,true);
-            getProcessor()->setCurrentChannel(button->getChannelNum()-1);
-            getProcessor()->setParameter(3,1);
-        }
+        const int channel = electrodeGrid->getChannelNum(position);
+        const bool enabled = !electrodeGrid->getToggleState(position);
+
+        electrodeGrid->setToggleState(position, enabled);
+        enabledChannelArray.set(channel-1,enabled);
+        getProcessor()->setCurrentChannel(channel-1);
+        getProcessor()->setParameter(3,enabled ? 1 : 0);
+
 		CoreServices::updateSignalChain(this);
     }
 }
 
 void ChannelMappingEditor::checkUnusedChannels()
 {
-    for (int i = 0; i < electrodeButtons.size(); i++)
+    for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
     {
-        if (electrodeButtons[i]->getChannelNum() > getProcessor()->getNumInputs())
-        {
-            electrodeButtons[i]->setEnabled(false);
-        }
-        else
-        {
-            if (enabledChannelArray[electrodeButtons[i]->getChannelNum()-1])
-            {
-                electrodeButtons[i]->setEnabled(true);
-            }
-            else
-            {
-                electrodeButtons[i]->setEnabled(false);
-            }
-        }
+        const int channel = electrodeGrid->getChannelNum(i);
+
+        electrodeGrid->setElectrodeEnabled(i, channel <= getProcessor()->getNumInputs() && enabledChannelArray[channel-1]);
     }
 }
 void ChannelMappingEditor::setConfigured(bool state)
@@ -963,6 +906,13 @@ String ChannelMappingEditor::writePrbFile(File filename)
     }
     nestedObj2->setProperty("channels", var(arr4));
 
+    Array<var> arr6;
+    for (int i = 0; i < referenceTypes.size(); i++)
+    {
+        arr6.add(var(referenceTypes[i]));
+    }
+    nestedObj2->setProperty("types", var(arr6));
+
     info->setProperty("refs", nestedObj2);
 
 	DynamicObject* nestedObj3 = new DynamicObject();
@@ -1022,8 +972,8 @@ String ChannelMappingEditor::loadPrbFile(File filename)
         bool en = enbl->getUnchecked(i);
         enabledChannelArray.set(ch-1, en);
 
-        electrodeButtons[i]->setChannelNum(ch);
-        electrodeButtons[i]->setEnabled(en);
+        electrodeGrid->setChannelNum(i, ch);
+        electrodeGrid->setElectrodeEnabled(i, en);
 		
 		getProcessor()->setCurrentChannel(i);
 		getProcessor()->setParameter(0,ch-1);
@@ -1045,18 +995,19 @@ String ChannelMappingEditor::loadPrbFile(File filename)
         getProcessor()->setParameter(2,i);
     }
 
+    // files saved before reference types existed only have single channel references
+    var types = refChans[Identifier("types")];
+    if (Array<var>* typeList = types.getArray())
+    {
+        for (int i = 0; i < typeList->size() && i < referenceTypes.size(); i++)
+            setReferenceType(i, typeList->getUnchecked(i));
+    }
+
     referenceButtons[0]->setToggleState(true, sendNotificationSync);
 
-    for (int i = 0; i < electrodeButtons.size(); i++)
+    for (int i = 0; i < electrodeGrid->getNumElectrodes(); i++)
     {
-        if (referenceArray[electrodeButtons[i]->getChannelNum()-1] == 0)
-        {
-            electrodeButtons[i]->setToggleState(true, dontSendNotification);
-        }
-        else
-        {
-            electrodeButtons[i]->setToggleState(false, dontSendNotification);
-        }
+        electrodeGrid->setToggleState(i, referenceArray[electrodeGrid->getChannelNum(i)-1] == 0);
     }
 
 	setConfigured(true);
@@ -1075,3 +1026,229 @@ String ChannelMappingEditor::loadPrbFile(File filename)
     return "Loaded " + filename.getFileName();
 
 }
+
+ElectrodeGrid::ElectrodeGrid()
+    : listener(nullptr), reorderMode(false), hiddenElectrode(-1), hoverElectrode(-1)
+{
+}
+
+ElectrodeGrid::~ElectrodeGrid()
+{
+}
+
+void ElectrodeGrid::setListener(Listener* newListener)
+{
+    listener = newListener;
+}
+
+void ElectrodeGrid::setNumElectrodes(int numElectrodes, bool state)
+{
+    const int previousNumElectrodes = channelNums.size();
+
+    channelNums.resize(numElectrodes);
+    for (int i = previousNumElectrodes; i < numElectrodes; i++)
+        channelNums.set(i, i+1);
+
+    toggleStates.setSize(numElectrodes, state);
+    enabledStates.setSize(numElectrodes, true);
+
+    if (hoverElectrode >= numElectrodes)
+        hoverElectrode = -1;
+
+    if (hiddenElectrode >= numElectrodes)
+        hiddenElectrode = -1;
+
+    updateSize();
+    repaint();
+}
+
+int ElectrodeGrid::getNumElectrodes() const
+{
+    return channelNums.size();
+}
+
+int ElectrodeGrid::getChannelNum(int position) const
+{
+    return channelNums[position];
+}
+
+void ElectrodeGrid::setChannelNum(int position, int channel)
+{
+    if (isPositiveAndBelow(position, channelNums.size()) && channelNums[position] != channel)
+    {
+        channelNums.set(position, channel);
+        repaintElectrode(position);
+    }
+}
+
+bool ElectrodeGrid::getToggleState(int position) const
+{
+    return toggleStates[position];
+}
+
+void ElectrodeGrid::setToggleState(int position, bool state)
+{
+    if (isPositiveAndBelow(position, channelNums.size()) && toggleStates[position] != state)
+    {
+        toggleStates.set(position, state);
+        repaintElectrode(position);
+    }
+}
+
+bool ElectrodeGrid::isElectrodeEnabled(int position) const
+{
+    return enabledStates[position];
+}
+
+void ElectrodeGrid::setElectrodeEnabled(int position, bool enabled)
+{
+    if (isPositiveAndBelow(position, channelNums.size()) && enabledStates[position] != enabled)
+    {
+        enabledStates.set(position, enabled);
+        repaintElectrode(position);
+    }
+}
+
+void ElectrodeGrid::setReorderMode(bool reorder)
+{
+    reorderMode = reorder;
+}
+
+void ElectrodeGrid::setHiddenElectrode(int position)
+{
+    if (position != hiddenElectrode)
+    {
+        repaintElectrode(hiddenElectrode);
+        hiddenElectrode = position;
+        repaintElectrode(hiddenElectrode);
+    }
+}
+
+int ElectrodeGrid::getElectrodeAt(juce::Point<int> point) const
+{
+    if (point.x < 0 || point.y < 0)
+        return -1;
+
+    const int column = point.x / electrodeWidth;
+    const int row = point.y / electrodeHeight;
+
+    if (column >= numColumns)
+        return -1;
+
+    const int position = row*numColumns + column;
+
+    return position < channelNums.size() ? position : -1;
+}
+
+void ElectrodeGrid::updateSize()
+{
+    const int numElectrodes = channelNums.size();
+    const int numRows = (numElectrodes + numColumns - 1) / numColumns;
+
+    setSize(jmin(numElectrodes, (int) numColumns) * electrodeWidth, numRows * electrodeHeight);
+}
+
+juce::Rectangle<int> ElectrodeGrid::getElectrodeBounds(int position) const
+{
+    return juce::Rectangle<int>((position % numColumns) * electrodeWidth,
+                                (position / numColumns) * electrodeHeight,
+                                electrodeWidth,
+                                electrodeHeight);
+}
+
+void ElectrodeGrid::repaintElectrode(int position)
+{
+    if (isPositiveAndBelow(position, channelNums.size()))
+        repaint(getElectrodeBounds(position));
+}
+
+void ElectrodeGrid::paint(Graphics& g)
+{
+    const juce::Rectangle<int> clip = g.getClipBounds();
+
+    // only the rows the viewport shows, and only those that need repainting
+    const int firstRow = jmax(0, clip.getY() / electrodeHeight);
+    const int lastRow = clip.getBottom() / electrodeHeight;
+
+    const int first = firstRow*numColumns;
+    const int last = jmin(channelNums.size(), (lastRow + 1)*numColumns);
+
+    for (int i = first; i < last; i++)
+    {
+        if (i == hiddenElectrode)
+            continue;
+
+        const juce::Rectangle<int> bounds = getElectrodeBounds(i);
+        const int chan = channelNums[i];
+
+        if (toggleStates[i])
+            g.setColour(Colours::orange);
+        else
+            g.setColour(Colours::darkgrey);
+
+        if (i == hoverElectrode)
+            g.setColour(Colours::white);
+
+        if (!enabledStates[i])
+            g.setColour(Colours::black);
+
+        g.fillRect(bounds);
+
+        g.setColour(Colours::black);
+
+        g.drawRect(bounds, 1);
+
+        if (!enabledStates[i])
+        {
+            g.setColour(Colours::grey);
+        }
+
+        if (chan < 100)
+            g.setFont(10.f);
+        else
+            g.setFont(8.f);
+
+        if (chan >= 0)
+            g.drawText(String(chan), bounds, Justification::centred, true);
+    }
+}
+
+void ElectrodeGrid::mouseMove(const MouseEvent& e)
+{
+    int position = getElectrodeAt(e.getPosition());
+
+    if (position >= 0 && !enabledStates[position])
+        position = -1;
+
+    if (position != hoverElectrode)
+    {
+        repaintElectrode(hoverElectrode);
+        hoverElectrode = position;
+        repaintElectrode(hoverElectrode);
+    }
+}
+
+void ElectrodeGrid::mouseExit(const MouseEvent& e)
+{
+    repaintElectrode(hoverElectrode);
+    hoverElectrode = -1;
+}
+
+void ElectrodeGrid::mouseUp(const MouseEvent& e)
+{
+    if (reorderMode)
+        return;
+
+    // a click is a press and release on the same enabled cell
+    const int position = getElectrodeAt(e.getPosition());
+
+    if (position < 0
+        || position != getElectrodeAt(e.getMouseDownPosition())
+        || !enabledStates[position])
+        return;
+
+    setToggleState(position, !toggleStates[position]);
+
+    if (listener != nullptr)
+        listener->electrodeClicked(position);
+}
@@ -28,6 +28,88 @@
 
 #define NUM_REFERENCES 4
 
+/**
+
+  The channels of the Channel Mapping editor, drawn as a single grid of electrode cells.
+
+  Each cell shows the channel mapped to its position. The grid paints only the cells
+  in view and finds the cell under the mouse from its position, so remapping a probe
+  with a thousand channels needs no more components than remapping a tetrode, and a
+  change repaints only the cells it touches.
+
+  @see ChannelMappingEditor
+
+*/
+
+class ElectrodeGrid : public Component
+{
+public:
+    ElectrodeGrid();
+    ~ElectrodeGrid();
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** Called when an enabled cell has been clicked, and toggled, outside of reorder mode */
+        virtual void electrodeClicked(int position) = 0;
+    };
+
+    void setListener(Listener* listener);
+
+    /** Resizes the grid; new positions show their own channel, enabled and in the given state */
+    void setNumElectrodes(int numElectrodes, bool state);
+    int getNumElectrodes() const;
+
+    int getChannelNum(int position) const;
+    void setChannelNum(int position, int channel);
+
+    bool getToggleState(int position) const;
+    void setToggleState(int position, bool state);
+
+    bool isElectrodeEnabled(int position) const;
+    void setElectrodeEnabled(int position, bool enabled);
+
+    /** In reorder mode clicks leave the cells as they are, and the editor drags them instead */
+    void setReorderMode(bool reorder);
+
+    /** Leaves a position blank while its channel is dragged; -1 shows every position */
+    void setHiddenElectrode(int position);
+
+    /** The position whose cell contains a point of the grid, or -1 */
+    int getElectrodeAt(juce::Point<int> point) const;
+
+    /** The size the grid needs to show every position */
+    void updateSize();
+
+    void paint(Graphics& g);
+
+    void mouseMove(const MouseEvent& e);
+    void mouseExit(const MouseEvent& e);
+    void mouseUp(const MouseEvent& e);
+
+    static const int electrodeWidth = 19;
+    static const int electrodeHeight = 15;
+    static const int numColumns = 16;
+
+private:
+    juce::Rectangle<int> getElectrodeBounds(int position) const;
+    void repaintElectrode(int position);
+
+    Listener* listener;
+
+    Array<int> channelNums;
+    ChannelMask toggleStates;
+    ChannelMask enabledStates;
+
+    bool reorderMode;
+    int hiddenElectrode;
+    int hoverElectrode;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ElectrodeGrid);
+};
+
 /**
 
   User interface for the Channel Mapping processor.
@@ -37,7 +119,9 @@
 */
 
 class ChannelMappingEditor : public GenericEditor,
-    public DragAndDropContainer
+    public DragAndDropContainer,
+    public ElectrodeGrid::Listener,
+    public ComboBox::Listener
 
 {
 public:
@@ -46,6 +130,8 @@ public:
 
     void buttonEvent(Button* button);
 
+    void comboBoxChanged(ComboBox* comboBox) override;
+
     void updateSettings();
 
     void createElectrodeButtons(int numNeeded, bool clearPrevious = true);
@@ -55,6 +141,8 @@ public:
 
     void channelChanged (int channel, bool newState) override;
 
+    void electrodeClicked(int position) override;
+
     void mouseDrag(const MouseEvent& e);
 
     void mouseUp(const MouseEvent& e);
@@ -72,26 +160,29 @@ public:
 
 private:
 
-    void setChannelReference(ElectrodeButton* button);
+    void setChannelReference(int position);
+    void setReferenceType(int reference, int type);
+    void showSelectedReference();
     void setChannelPosition(int position, int channel);
     void checkUnusedChannels();
     void setConfigured(bool state);
 
     void refreshButtonLocations();
 
-    OwnedArray<ElectrodeButton> electrodeButtons;
     OwnedArray<ElectrodeButton> referenceButtons;
     ScopedPointer<ElectrodeEditorButton> selectAllButton;
     ScopedPointer<ElectrodeEditorButton> modifyButton;
     ScopedPointer<ElectrodeEditorButton> resetButton;
     ScopedPointer<LoadButton> loadButton;
     ScopedPointer<SaveButton> saveButton;
+    ScopedPointer<ComboBox> referenceTypeSelector;
     ScopedPointer<Viewport> electrodeButtonViewport;
-    ScopedPointer<Component> electrodeButtonHolder;
+    ScopedPointer<ElectrodeGrid> electrodeGrid;
 
     Array<int> channelArray;
     Array<int> referenceArray;
     Array<int> referenceChannels;
+    Array<int> referenceTypes;
     Array<bool> enabledChannelArray;
 	Array<int> channelCountArray;
 
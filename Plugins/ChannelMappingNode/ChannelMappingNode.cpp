@@ -21,13 +21,16 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
 #include "ChannelMappingNode.h"
 #include "ChannelMappingEditor.h"
 
 
 ChannelMappingNode::ChannelMappingNode()
     : GenericProcessor  ("Channel Map")
-    , channelBuffer     (1, 10000)
+    , channelBuffer     (NUM_REFERENCES + 1, 10000)
+    , enabledChannels   (1024, true)
+    , medianBufferSize  (0)
 {
     setProcessorType (PROCESSOR_TYPE_FILTER);
 
@@ -38,12 +41,13 @@ ChannelMappingNode::ChannelMappingNode()
     {
         channelArray.set        (i, i);
         referenceArray.set      (i, -1);
-        enabledChannelArray.set (i, true);
     }
 
     for (int i = 0; i < NUM_REFERENCES; ++i)
     {
         referenceChannels.set (i, -1);
+        referenceTypes.set    (i, REFERENCE_CHANNEL);
+        referenceMembers.add  (new Array<int>());
     }
 }
 
@@ -65,8 +69,19 @@ AudioProcessorEditor* ChannelMappingNode::createEditor()
 
 void ChannelMappingNode::updateSettings()
 {
-    if (getNumInputs() > 0)
-        channelBuffer.setSize (getNumInputs(), 10000);
+    mapSources.ensureStorageAllocated (getNumInputs());
+    mapReferences.ensureStorageAllocated (getNumInputs());
+    mapReaders.ensureStorageAllocated (getNumInputs());
+    mapDone.ensureStorageAllocated (getNumInputs());
+
+    for (auto members : referenceMembers)
+        members->ensureStorageAllocated (getNumInputs());
+
+    if (medianBufferSize < getNumInputs() * REFERENCE_TILE_SAMPLES)
+    {
+        medianBufferSize = getNumInputs() * REFERENCE_TILE_SAMPLES;
+        medianBuffer.malloc (medianBufferSize);
+    }
 
     if (editorIsConfigured)
     {
@@ -79,7 +94,7 @@ void ChannelMappingNode::updateSettings()
 
         for (int i = 0; i < getNumInputs(); ++i)
         {
-            if ( (enabledChannelArray[channelArray[i]])
+            if ( (enabledChannels[channelArray[i]])
                  && (channelArray[i] < oldChannels.size()))
             {
 				DataChannel* oldChan = oldChannels[channelArray[i]];
@@ -111,12 +126,18 @@ void ChannelMappingNode::setParameter (int parameterIndex, float newValue)
     }
     else if (parameterIndex == 3)
     {
-        enabledChannelArray.set (currentChannel, (newValue != 0) ? true : false);
+        enabledChannels.set (currentChannel, (newValue != 0) ? true : false);
     }
     else if (parameterIndex == 4)
     {
         editorIsConfigured = (newValue != 0) ? true : false;
     }
+    else if (parameterIndex == 5)
+    {
+        // the current channel is the reference group here
+        if (currentChannel >= 0 && currentChannel < referenceTypes.size())
+            referenceTypes.set (currentChannel, jlimit ((int) REFERENCE_CHANNEL, (int) REFERENCE_MEDIAN, (int) newValue));
+    }
     else
     {
         channelArray.set (currentChannel, (int) newValue);
@@ -126,46 +147,190 @@ void ChannelMappingNode::setParameter (int parameterIndex, float newValue)
 
 void ChannelMappingNode::process (AudioSampleBuffer& buffer)
 {
-    int j = 0;
-    int i = 0;
-    int realChan;
+    const int numChannels = buffer.getNumChannels();
 
-    // use copy constructor to set the data to refer to
-    channelBuffer = buffer;
+    // output j takes input channel mapSources[j], minus reference mapReferences[j]
+    mapSources.clearQuick();
+    mapReferences.clearQuick();
+    usedReferences.clearQuick();
 
-   // buffer.clear();
+    for (auto members : referenceMembers)
+        members->clearQuick();
 
-    while (j < settings.numOutputs)
+    for (int i = 0; mapSources.size() < settings.numOutputs && i < channelArray.size(); ++i)
     {
-        realChan = channelArray[i];
-        if ((realChan < channelBuffer.getNumChannels())
-            && (enabledChannelArray[realChan]))
+        int realChan = channelArray[i];
+        if ((realChan < numChannels)
+            && (enabledChannels[realChan]))
         {
-            // copy it back into the buffer according to the channel mapping
-            buffer.copyFrom (j,                                       // destChannel
-                             0,                                       // destStartSample
-                             channelBuffer.getReadPointer (realChan), // source
-                             getNumSamples (j),                       // numSamples
-                             1.0f); // gain to apply to source (positive for original signal)
-
-            // now do the referencing
-            if ((referenceArray[realChan] > -1)
-                && (referenceChannels[referenceArray[realChan]] > -1)
-                && (referenceChannels[referenceArray[realChan]] < channelBuffer.getNumChannels()))
+            // groups that average their channels need no reference channel
+            int reference = referenceArray[realChan];
+            if ((reference < 0)
+                || (reference >= referenceTypes.size())
+                || ((referenceTypes[reference] == REFERENCE_CHANNEL)
+                    && ((referenceChannels[reference] < 0)
+                        || (referenceChannels[reference] >= numChannels))))
             {
-                buffer.addFrom (j,                                                                // destChannel
-                                0,                                                                // destStartSample
-                                channelBuffer,                                                    // source
-                                channelArray[referenceChannels[referenceArray[realChan]]], // sourceChannel
-                                0,                                                                // sourceStartSample
-                                getNumSamples (j),                                                // numSamples
-                                -1.0f); // gain to apply to source (negative for reference)
+                reference = -1;
             }
 
-            ++j;
+            if (reference > -1)
+            {
+                usedReferences.addIfNotAlreadyThere (reference);
+                referenceMembers[reference]->add (realChan);
+            }
+
+            mapSources.add (realChan);
+            mapReferences.add (reference);
         }
+    }
+
+    if (channelBuffer.getNumSamples() < buffer.getNumSamples())
+        channelBuffer.setSize (NUM_REFERENCES + 1, buffer.getNumSamples());
+
+    // keep the reference signals before any channel is overwritten
+    for (int r = 0; r < usedReferences.size(); ++r)
+        computeReference (buffer, usedReferences[r], buffer.getNumSamples());
+
+    // the channels are moved in place: a channel is only overwritten once no other output
+    // still has to read it, and the remaining cycles go through the scratch channel
+    const int numMapped = mapSources.size();
+    mapReaders.clearQuick();
+    mapReaders.insertMultiple (0, 0, numChannels);
+    mapDone.clearQuick();
+    mapDone.insertMultiple (0, false, numMapped);
+
+    for (int j = 0; j < numMapped; ++j)
+    {
+        if (mapSources[j] != j)
+            mapReaders.set (mapSources[j], mapReaders[mapSources[j]] + 1);
+    }
+
+    for (int j = 0; j < numMapped; ++j)
+    {
+        // follow the chain of channels that are no longer needed once moved
+        int dest = j;
+        while (dest >= 0 && ! mapDone[dest] && mapReaders[dest] == 0)
+        {
+            const int source = mapSources[dest];
+            mapChannel (buffer, dest, buffer.getReadPointer (source));
+            mapDone.set (dest, true);
+
+            if (source == dest)
+                break;
+
+            mapReaders.set (source, mapReaders[source] - 1);
+            dest = (source < numMapped) ? source : -1;
+        }
+    }
+
+    for (int j = 0; j < numMapped; ++j)
+    {
+        if (mapDone[j])
+            continue;
+
+        // every channel left is part of a cycle
+        channelBuffer.copyFrom (0, 0, buffer, j, 0, buffer.getNumSamples());
+
+        int dest = j;
+        while (true)
+        {
+            const int source = mapSources[dest];
+            mapDone.set (dest, true);
+
+            if (source == j)
+            {
+                mapChannel (buffer, dest, channelBuffer.getReadPointer (0));
+                break;
+            }
+
+            mapChannel (buffer, dest, buffer.getReadPointer (source));
+            dest = source;
+        }
+    }
+}
+
+
+void ChannelMappingNode::mapChannel (AudioSampleBuffer& buffer, int dest, const float* source)
+{
+    float* destPtr = buffer.getWritePointer (dest);
+    const int reference = mapReferences[dest];
 
-        ++i;
+    if (reference > -1)
+    {
+        // copy and reference in a single pass
+        FloatVectorOperations::subtract (destPtr, source, channelBuffer.getReadPointer (reference + 1), getNumSamples (dest));
+    }
+    else if (destPtr != source)
+    {
+        FloatVectorOperations::copy (destPtr, source, getNumSamples (dest));
     }
 }
 
+
+void ChannelMappingNode::computeReference (const AudioSampleBuffer& buffer, int reference, int numSamples)
+{
+    float* dest = channelBuffer.getWritePointer (reference + 1);
+    const Array<int>& members = *referenceMembers.getUnchecked (reference);
+    const int numMembers = members.size();
+
+    if (referenceTypes[reference] == REFERENCE_CHANNEL)
+    {
+        FloatVectorOperations::copy (dest, buffer.getReadPointer (channelArray[referenceChannels[reference]]), numSamples);
+    }
+    else if (referenceTypes[reference] == REFERENCE_MEAN)
+    {
+        const float scale = 1.0f / numMembers;
+
+        for (int start = 0; start < numSamples; start += REFERENCE_TILE_SAMPLES)
+        {
+            const int num = jmin (REFERENCE_TILE_SAMPLES, numSamples - start);
+            float* tile = dest + start;
+
+            FloatVectorOperations::copy (tile, buffer.getReadPointer (members.getUnchecked (0), start), num);
+
+            for (int m = 1; m < numMembers; ++m)
+                FloatVectorOperations::add (tile, buffer.getReadPointer (members.getUnchecked (m), start), num);
+
+            FloatVectorOperations::multiply (tile, scale, num);
+        }
+    }
+    else
+    {
+        if (medianBufferSize < numMembers * REFERENCE_TILE_SAMPLES)
+        {
+            medianBufferSize = numMembers * REFERENCE_TILE_SAMPLES;
+            medianBuffer.malloc (medianBufferSize);
+        }
+
+        const int middle = numMembers / 2;
+
+        for (int start = 0; start < numSamples; start += REFERENCE_TILE_SAMPLES)
+        {
+            const int num = jmin (REFERENCE_TILE_SAMPLES, numSamples - start);
+
+            for (int m = 0; m < numMembers; ++m)
+            {
+                const float* source = buffer.getReadPointer (members.getUnchecked (m), start);
+                float* column = medianBuffer + m;
+
+                for (int s = 0; s < num; ++s)
+                    column[s * numMembers] = source[s];
+            }
+
+            for (int s = 0; s < num; ++s)
+            {
+                float* values = medianBuffer + s * numMembers;
+
+                std::nth_element (values, values + middle, values + numMembers);
+                float median = values[middle];
+
+                // an even group takes the mean of the two middle values
+                if (numMembers % 2 == 0)
+                    median = 0.5f * (median + *std::max_element (values, values + middle));
+
+                dest[start + s] = median;
+            }
+        }
+    }
+}
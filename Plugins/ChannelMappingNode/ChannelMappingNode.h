@@ -26,18 +26,30 @@
 
 #include <ProcessorHeaders.h>
 
+/** Samples of a reference computed at a time, so the partial result stays in the cache
+    while every channel of the group is added to it */
+#define REFERENCE_TILE_SAMPLES 256
 
 /**
     Channel mapping node.
 
     Allows the user to select a subset of channels, remap their order, and reference them against
-    any other channel.
+    any other channel, or against the mean or median of the channels in their reference group,
+    e.g. per shank or per tetrode. Each reference is computed once per block.
 
     @see GenericProcessor
 */
 class ChannelMappingNode : public GenericProcessor
 {
 public:
+    /** How the signal of a reference group is made */
+    enum ReferenceType
+    {
+        REFERENCE_CHANNEL = 0,  // a single channel
+        REFERENCE_MEAN,         // mean of the channels referenced to the group
+        REFERENCE_MEDIAN        // median of the channels referenced to the group
+    };
+
     ChannelMappingNode();
     ~ChannelMappingNode();
 
@@ -53,15 +65,39 @@ public:
 
 
 private:
+    /** Writes an output channel from its source, subtracting its reference if it has one */
+    void mapChannel (AudioSampleBuffer& buffer, int dest, const float* source);
+
+    /** Writes the signal of a reference group to its channel of channelBuffer */
+    void computeReference (const AudioSampleBuffer& buffer, int reference, int numSamples);
+
     Array<int> referenceArray;
     Array<int> referenceChannels;
+    Array<int> referenceTypes;
     Array<int> channelArray;
-    Array<bool> enabledChannelArray;
-
     bool editorIsConfigured;
 
+    /** A scratch channel, to move the channels of mapping cycles in place, and a copy of each
+        reference channel in use */
     AudioSampleBuffer channelBuffer;
 
+    /** Input channels that are mapped to an output */
+    ChannelMask enabledChannels;
+
+    Array<int> mapSources;
+    Array<int> mapReferences;
+    Array<int> usedReferences;
+
+    /** Input channels referenced to each group in this block */
+    OwnedArray<Array<int>> referenceMembers;
+
+    /** The channels of a median group, one tile at a time, with the values of each sample together */
+    HeapBlock<float> medianBuffer;
+    int medianBufferSize;
+
+    Array<int> mapReaders;
+    Array<bool> mapDone;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelMappingNode);
 };
 
@@ -0,0 +1,116 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DownsamplingEditor.h"
+#include "DownsamplingNode.h"
+
+
+static const int targetRates[] = { 500, 1000, 1250, 2000, 2500, 5000 };
+
+
+DownsamplingEditor::DownsamplingEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
+    : GenericEditor(parentNode, useDefaultParameterEditors)
+
+{
+    desiredWidth = 150;
+
+    targetRateLabel = new Label("target rate label", "Target rate (Hz):");
+    targetRateLabel->setBounds(10,25,130,20);
+    targetRateLabel->setFont(Font("Small Text", 12, Font::plain));
+    targetRateLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(targetRateLabel);
+
+    DownsamplingNode* processor = (DownsamplingNode*) getProcessor();
+
+    targetRateSelector = new ComboBox("target rate");
+    targetRateSelector->setBounds(15,47,100,20);
+    for (int i = 0; i < numElementsInArray(targetRates); i++)
+        targetRateSelector->addItem(String(targetRates[i]), targetRates[i]);
+    targetRateSelector->setSelectedId(roundFloatToInt(processor->getTargetSampleRate()), dontSendNotification);
+    targetRateSelector->addListener(this);
+    targetRateSelector->setTooltip("Each input is downsampled by the integer factor that brings it closest to this rate");
+    addAndMakeVisible(targetRateSelector);
+
+    outputRateLabel = new Label("output rate label", "");
+    outputRateLabel->setBounds(10,75,130,20);
+    outputRateLabel->setFont(Font("Small Text", 12, Font::plain));
+    outputRateLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(outputRateLabel);
+
+}
+
+DownsamplingEditor::~DownsamplingEditor()
+{
+
+}
+
+void DownsamplingEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == targetRateSelector)
+    {
+        getProcessor()->setParameter(0, float(targetRateSelector->getSelectedId()));
+        CoreServices::updateSignalChain(this);
+    }
+}
+
+void DownsamplingEditor::updateSettings()
+{
+    DownsamplingNode* processor = (DownsamplingNode*) getProcessor();
+
+    if (processor->getNumInputs() > 0)
+        outputRateLabel->setText("1/" + String(processor->getDownsamplingFactor(0)) + ": "
+                                 + String(processor->getSampleRate(0), 1) + " Hz", dontSendNotification);
+    else
+        outputRateLabel->setText("", dontSendNotification);
+}
+
+void DownsamplingEditor::startAcquisition()
+{
+    targetRateSelector->setEnabled(false);
+}
+
+void DownsamplingEditor::stopAcquisition()
+{
+    targetRateSelector->setEnabled(true);
+}
+
+void DownsamplingEditor::saveCustomParameters(XmlElement* xml)
+{
+
+    xml->setAttribute("Type", "DownsamplingEditor");
+
+    XmlElement* values = xml->createNewChildElement("VALUES");
+    values->setAttribute("TargetRate", targetRateSelector->getSelectedId());
+}
+
+void DownsamplingEditor::loadCustomParameters(XmlElement* xml)
+{
+
+    forEachXmlChildElement(*xml, xmlNode)
+    {
+        if (xmlNode->hasTagName("VALUES"))
+        {
+            targetRateSelector->setSelectedId(xmlNode->getIntAttribute("TargetRate", targetRateSelector->getSelectedId()), sendNotificationSync);
+        }
+    }
+
+}
@@ -0,0 +1,185 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DownsamplingNode.h"
+#include "DownsamplingEditor.h"
+
+
+DownsamplingNode::DownsamplingNode()
+    : GenericProcessor  ("Downsampler")
+    , targetSampleRate  (1000.0f)
+{
+    setProcessorType (PROCESSOR_TYPE_FILTER);
+}
+
+
+DownsamplingNode::~DownsamplingNode()
+{
+}
+
+
+AudioProcessorEditor* DownsamplingNode::createEditor()
+{
+    editor = new DownsamplingEditor (this, true);
+
+    return editor;
+}
+
+
+int DownsamplingNode::getNumSubProcessors() const
+{
+    return jmax (1, sourceGroups.size());
+}
+
+
+float DownsamplingNode::getSampleRate (int subProcessorIdx) const
+{
+    if (SourceGroup* group = sourceGroups[subProcessorIdx])
+        return group->outputSampleRate;
+
+    return GenericProcessor::getSampleRate (subProcessorIdx);
+}
+
+
+float DownsamplingNode::getTargetSampleRate() const
+{
+    return targetSampleRate;
+}
+
+
+int DownsamplingNode::getDownsamplingFactor (int subProcessorIdx) const
+{
+    if (SourceGroup* group = sourceGroups[subProcessorIdx])
+        return group->factor;
+
+    return 1;
+}
+
+
+void DownsamplingNode::updateSettings()
+{
+    sourceGroups.clear();
+
+    // the downsampled channels replace the input channels, with this node as their source
+    OwnedArray<DataChannel> inputChannels;
+    inputChannels.swapWith (dataChannelArray);
+
+    for (int i = 0; i < inputChannels.size(); ++i)
+    {
+        const DataChannel* input = inputChannels[i];
+        const uint32 sourceId = getProcessorFullId (input->getSourceNodeID(), input->getSubProcessorIdx());
+
+        int groupIndex = 0;
+        while (groupIndex < sourceGroups.size() && sourceGroups[groupIndex]->sourceId != sourceId)
+            ++groupIndex;
+
+        if (groupIndex == sourceGroups.size())
+        {
+            SourceGroup* group = new SourceGroup();
+            group->sourceId = sourceId;
+            group->inputSampleRate = input->getSampleRate();
+            group->factor = jmax (1, roundToInt (group->inputSampleRate / targetSampleRate));
+            group->outputSampleRate = group->inputSampleRate / group->factor;
+            group->isAligned = false;
+            sourceGroups.add (group);
+        }
+
+        SourceGroup* group = sourceGroups[groupIndex];
+        group->channels.add (i);
+
+        DataChannel* output = new DataChannel (input->getChannelType(), group->outputSampleRate, this, groupIndex);
+        output->setName (input->getName());
+        output->setBitVolts (input->getBitVolts());
+        output->setDataUnits (input->getDataUnits());
+        output->setEnable (input->isEnabled());
+        output->setRecordState (input->getRecordState());
+        output->setMonitored (input->isMonitored());
+        output->addToHistoricString (input->getHistoricString());
+        dataChannelArray.add (output);
+    }
+
+    for (auto group : sourceGroups)
+    {
+        const int factor = group->factor;
+
+        // a single unit tap when the data is kept at its own rate
+        std::vector<float> taps (1, 1.0f);
+        if (factor > 1)
+            taps = Dsp::PolyphaseDecimator::designLowPass (DOWNSAMPLING_TAPS_PER_FACTOR * factor + 1,
+                                                           DOWNSAMPLING_CUTOFF / factor);
+
+        group->decimator.setup (group->channels.size(), factor, taps);
+        group->channelPointers.insertMultiple (0, nullptr, group->channels.size());
+    }
+}
+
+
+bool DownsamplingNode::enable()
+{
+    for (auto group : sourceGroups)
+    {
+        group->decimator.reset();
+        group->isAligned = false;
+    }
+
+    return true;
+}
+
+
+void DownsamplingNode::setParameter (int parameterIndex, float newValue)
+{
+    if (parameterIndex == 0 && newValue > 0)
+        targetSampleRate = newValue;
+}
+
+
+void DownsamplingNode::process (AudioSampleBuffer& buffer)
+{
+    for (int g = 0; g < sourceGroups.size(); ++g)
+    {
+        SourceGroup* group = sourceGroups.getUnchecked (g);
+        Dsp::PolyphaseDecimator& decimator = group->decimator;
+        const int factor = group->factor;
+
+        const int numSamples = getNumSourceSamples (group->sourceId);
+        const juce::uint64 timestamp = getSourceTimestamp (group->sourceId);
+
+        // keep the samples whose source timestamps are multiples of the factor,
+        // so the output timestamps are the source timestamps divided by it
+        if (! group->isAligned)
+        {
+            decimator.setPhase (-int (timestamp % factor));
+            group->isAligned = true;
+        }
+
+        const juce::uint64 firstSample = timestamp + decimator.getPhase();
+
+        for (int j = 0; j < group->channels.size(); ++j)
+            group->channelPointers.setUnchecked (j, buffer.getWritePointer (group->channels.getUnchecked (j)));
+
+        const int numOutputs = decimator.process (numSamples,
+                                                  group->channelPointers.getRawDataPointer(),
+                                                  group->channelPointers.getRawDataPointer());
+
+        setTimestampAndSamples (firstSample / factor, numOutputs, g);
+    }
+}
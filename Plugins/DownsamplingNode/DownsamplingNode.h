@@ -0,0 +1,94 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DOWNSAMPLINGNODE_H__
+#define __DOWNSAMPLINGNODE_H__
+
+#include <ProcessorHeaders.h>
+#include <DspLib.h>
+
+/** Length of the anti-aliasing filters, in taps per unit of the downsampling factor */
+#define DOWNSAMPLING_TAPS_PER_FACTOR 16
+/** Cutoff of the anti-aliasing filters, relative to the output sample rate */
+#define DOWNSAMPLING_CUTOFF 0.4
+
+
+/**
+    Low pass filters and downsamples continuous data, e.g. to turn wideband data into LFP.
+
+    Each subprocessor upstream is downsampled by the integer factor that brings it closest
+    to the target sample rate, and its channels come out of a subprocessor of this node with
+    the lower sample rate, so the processors downstream handle fewer samples per block.
+    Events are passed through unchanged, with the timestamps of their source.
+
+    @see GenericProcessor, DownsamplingEditor
+*/
+class DownsamplingNode : public GenericProcessor
+{
+public:
+    DownsamplingNode();
+    ~DownsamplingNode();
+
+    AudioProcessorEditor* createEditor() override;
+
+    bool hasEditor() const override { return true; }
+
+    void process (AudioSampleBuffer& buffer) override;
+
+    void setParameter (int parameterIndex, float newValue) override;
+
+    void updateSettings() override;
+
+    bool enable() override;
+
+    int getNumSubProcessors() const override;
+
+    float getSampleRate (int subProcessorIdx = 0) const override;
+
+    float getTargetSampleRate() const;
+
+    /** Downsampling factor of one of the subprocessors */
+    int getDownsamplingFactor (int subProcessorIdx = 0) const;
+
+
+private:
+    /** Channels from the same subprocessor upstream are downsampled together, in lockstep */
+    struct SourceGroup
+    {
+        Dsp::PolyphaseDecimator decimator;
+        uint32 sourceId;
+        float inputSampleRate;
+        float outputSampleRate;
+        int factor;
+        bool isAligned;
+        Array<int> channels;
+        Array<float*> channelPointers;
+    };
+
+    OwnedArray<SourceGroup> sourceGroups;
+
+    float targetSampleRate;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DownsamplingNode);
+};
+
+#endif  // __DOWNSAMPLINGNODE_H__
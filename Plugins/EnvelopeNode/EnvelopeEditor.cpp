@@ -0,0 +1,171 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EnvelopeEditor.h"
+#include "EnvelopeNode.h"
+
+
+static const int targetRates[] = { 100, 200, 250, 500, 1000, 1250, 2000, 2500 };
+static const int smoothingTimes[] = { 1, 2, 5, 10, 20, 50, 100, 200 };
+
+
+EnvelopeEditor::EnvelopeEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
+    : GenericEditor(parentNode, useDefaultParameterEditors)
+
+{
+    desiredWidth = 230;
+
+    EnvelopeNode* processor = (EnvelopeNode*) getProcessor();
+
+    detectorLabel = addLabel("Envelope:", 10, 25, 100);
+
+    // item ids are the detector values plus one
+    detectorSelector = new ComboBox("detector");
+    detectorSelector->setBounds(15,47,90,20);
+    detectorSelector->addItem("Rectified", Dsp::EnvelopeDecimator::Rectified + 1);
+    detectorSelector->addItem("Power", Dsp::EnvelopeDecimator::Power + 1);
+    detectorSelector->addItem("RMS", Dsp::EnvelopeDecimator::Rms + 1);
+    detectorSelector->setSelectedId(processor->getDetector() + 1, dontSendNotification);
+    detectorSelector->addListener(this);
+    detectorSelector->setTooltip("Mean absolute value, mean square, or root mean square of the input");
+    addAndMakeVisible(detectorSelector);
+
+    smootherLabel = addLabel("Smoothing (ms):", 10, 72, 110);
+
+    smootherSelector = new ComboBox("smoother");
+    smootherSelector->setBounds(15,94,90,20);
+    smootherSelector->addItem("Low pass", Dsp::EnvelopeDecimator::OnePole + 1);
+    smootherSelector->addItem("Boxcar", Dsp::EnvelopeDecimator::Boxcar + 1);
+    smootherSelector->setSelectedId(processor->getSmoother() + 1, dontSendNotification);
+    smootherSelector->addListener(this);
+    smootherSelector->setTooltip("One-pole low pass with this time constant, or moving average over this window");
+    addAndMakeVisible(smootherSelector);
+
+    smoothingSelector = new ComboBox("smoothing time");
+    smoothingSelector->setBounds(110,94,55,20);
+    for (int i = 0; i < numElementsInArray(smoothingTimes); i++)
+        smoothingSelector->addItem(String(smoothingTimes[i]), smoothingTimes[i]);
+    smoothingSelector->setSelectedId(roundFloatToInt(processor->getSmoothingTime()), dontSendNotification);
+    smoothingSelector->addListener(this);
+    addAndMakeVisible(smoothingSelector);
+
+    targetRateLabel = addLabel("Output rate (Hz):", 120, 25, 110);
+
+    targetRateSelector = new ComboBox("target rate");
+    targetRateSelector->setBounds(125,47,90,20);
+    for (int i = 0; i < numElementsInArray(targetRates); i++)
+        targetRateSelector->addItem(String(targetRates[i]), targetRates[i]);
+    targetRateSelector->setSelectedId(roundFloatToInt(processor->getTargetSampleRate()), dontSendNotification);
+    targetRateSelector->addListener(this);
+    targetRateSelector->setTooltip("Each input is downsampled by the integer factor that brings it closest to this rate");
+    addAndMakeVisible(targetRateSelector);
+
+    outputRateLabel = addLabel("", 120, 72, 110);
+
+}
+
+EnvelopeEditor::~EnvelopeEditor()
+{
+
+}
+
+Label* EnvelopeEditor::addLabel(const String& text, int x, int y, int width)
+{
+    Label* label = new Label(text, text);
+    label->setBounds(x,y,width,20);
+    label->setFont(Font("Small Text", 12, Font::plain));
+    label->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(label);
+
+    return label;
+}
+
+void EnvelopeEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == detectorSelector)
+        getProcessor()->setParameter(EnvelopeNode::DETECTOR, float(detectorSelector->getSelectedId() - 1));
+    else if (comboBox == smootherSelector)
+        getProcessor()->setParameter(EnvelopeNode::SMOOTHER, float(smootherSelector->getSelectedId() - 1));
+    else if (comboBox == smoothingSelector)
+        getProcessor()->setParameter(EnvelopeNode::SMOOTHING_MS, float(smoothingSelector->getSelectedId()));
+    else if (comboBox == targetRateSelector)
+        getProcessor()->setParameter(EnvelopeNode::TARGET_RATE, float(targetRateSelector->getSelectedId()));
+    else
+        return;
+
+    CoreServices::updateSignalChain(this);
+}
+
+void EnvelopeEditor::updateSettings()
+{
+    EnvelopeNode* processor = (EnvelopeNode*) getProcessor();
+
+    if (processor->getNumInputs() > 0)
+        outputRateLabel->setText("1/" + String(processor->getDownsamplingFactor(0)) + ": "
+                                 + String(processor->getSampleRate(0), 1) + " Hz", dontSendNotification);
+    else
+        outputRateLabel->setText("", dontSendNotification);
+}
+
+void EnvelopeEditor::startAcquisition()
+{
+    detectorSelector->setEnabled(false);
+    smootherSelector->setEnabled(false);
+    smoothingSelector->setEnabled(false);
+    targetRateSelector->setEnabled(false);
+}
+
+void EnvelopeEditor::stopAcquisition()
+{
+    detectorSelector->setEnabled(true);
+    smootherSelector->setEnabled(true);
+    smoothingSelector->setEnabled(true);
+    targetRateSelector->setEnabled(true);
+}
+
+void EnvelopeEditor::saveCustomParameters(XmlElement* xml)
+{
+
+    xml->setAttribute("Type", "EnvelopeEditor");
+
+    XmlElement* values = xml->createNewChildElement("VALUES");
+    values->setAttribute("Detector", detectorSelector->getSelectedId() - 1);
+    values->setAttribute("Smoother", smootherSelector->getSelectedId() - 1);
+    values->setAttribute("SmoothingMs", smoothingSelector->getSelectedId());
+    values->setAttribute("TargetRate", targetRateSelector->getSelectedId());
+}
+
+void EnvelopeEditor::loadCustomParameters(XmlElement* xml)
+{
+
+    forEachXmlChildElement(*xml, xmlNode)
+    {
+        if (xmlNode->hasTagName("VALUES"))
+        {
+            detectorSelector->setSelectedId(xmlNode->getIntAttribute("Detector", detectorSelector->getSelectedId() - 1) + 1, sendNotificationSync);
+            smootherSelector->setSelectedId(xmlNode->getIntAttribute("Smoother", smootherSelector->getSelectedId() - 1) + 1, sendNotificationSync);
+            smoothingSelector->setSelectedId(xmlNode->getIntAttribute("SmoothingMs", smoothingSelector->getSelectedId()), sendNotificationSync);
+            targetRateSelector->setSelectedId(xmlNode->getIntAttribute("TargetRate", targetRateSelector->getSelectedId()), sendNotificationSync);
+        }
+    }
+
+}
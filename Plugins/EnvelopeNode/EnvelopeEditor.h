@@ -0,0 +1,73 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ENVELOPEEDITOR_H__
+#define __ENVELOPEEDITOR_H__
+
+
+#include <EditorHeaders.h>
+
+/**
+
+  User interface for the EnvelopeNode processor.
+
+  @see EnvelopeNode
+
+*/
+
+class EnvelopeEditor : public GenericEditor,
+    public ComboBox::Listener
+{
+public:
+    EnvelopeEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
+    virtual ~EnvelopeEditor();
+
+    void comboBoxChanged(ComboBox* comboBox);
+
+    void updateSettings();
+
+    void saveCustomParameters(XmlElement* xml);
+    void loadCustomParameters(XmlElement* xml);
+
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+private:
+
+    Label* addLabel(const String& text, int x, int y, int width);
+
+    ScopedPointer<Label> detectorLabel;
+    ScopedPointer<ComboBox> detectorSelector;
+    ScopedPointer<Label> smootherLabel;
+    ScopedPointer<ComboBox> smootherSelector;
+    ScopedPointer<ComboBox> smoothingSelector;
+    ScopedPointer<Label> targetRateLabel;
+    ScopedPointer<ComboBox> targetRateSelector;
+    ScopedPointer<Label> outputRateLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EnvelopeEditor);
+
+};
+
+
+
+#endif  // __ENVELOPEEDITOR_H__
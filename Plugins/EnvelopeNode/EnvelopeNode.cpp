@@ -0,0 +1,226 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EnvelopeNode.h"
+#include "EnvelopeEditor.h"
+
+
+EnvelopeNode::EnvelopeNode()
+    : GenericProcessor  ("Envelope")
+    , targetSampleRate  (1000.0f)
+    , detector          (Dsp::EnvelopeDecimator::Rectified)
+    , smoother          (Dsp::EnvelopeDecimator::OnePole)
+    , smoothingMs       (10.0f)
+{
+    setProcessorType (PROCESSOR_TYPE_FILTER);
+}
+
+
+EnvelopeNode::~EnvelopeNode()
+{
+}
+
+
+AudioProcessorEditor* EnvelopeNode::createEditor()
+{
+    editor = new EnvelopeEditor (this, true);
+
+    return editor;
+}
+
+
+int EnvelopeNode::getNumSubProcessors() const
+{
+    return jmax (1, sourceGroups.size());
+}
+
+
+float EnvelopeNode::getSampleRate (int subProcessorIdx) const
+{
+    if (SourceGroup* group = sourceGroups[subProcessorIdx])
+        return group->outputSampleRate;
+
+    return GenericProcessor::getSampleRate (subProcessorIdx);
+}
+
+
+float EnvelopeNode::getTargetSampleRate() const
+{
+    return targetSampleRate;
+}
+
+
+Dsp::EnvelopeDecimator::Detector EnvelopeNode::getDetector() const
+{
+    return detector;
+}
+
+
+Dsp::EnvelopeDecimator::Smoother EnvelopeNode::getSmoother() const
+{
+    return smoother;
+}
+
+
+float EnvelopeNode::getSmoothingTime() const
+{
+    return smoothingMs;
+}
+
+
+int EnvelopeNode::getDownsamplingFactor (int subProcessorIdx) const
+{
+    if (SourceGroup* group = sourceGroups[subProcessorIdx])
+        return group->factor;
+
+    return 1;
+}
+
+
+void EnvelopeNode::updateSettings()
+{
+    sourceGroups.clear();
+
+    // the envelopes replace the input channels, with this node as their source
+    OwnedArray<DataChannel> inputChannels;
+    inputChannels.swapWith (dataChannelArray);
+
+    for (int i = 0; i < inputChannels.size(); ++i)
+    {
+        const DataChannel* input = inputChannels[i];
+        const uint32 sourceId = getProcessorFullId (input->getSourceNodeID(), input->getSubProcessorIdx());
+
+        int groupIndex = 0;
+        while (groupIndex < sourceGroups.size() && sourceGroups[groupIndex]->sourceId != sourceId)
+            ++groupIndex;
+
+        if (groupIndex == sourceGroups.size())
+        {
+            SourceGroup* group = new SourceGroup();
+            group->sourceId = sourceId;
+            group->inputSampleRate = input->getSampleRate();
+            group->factor = jmax (1, roundToInt (group->inputSampleRate / targetSampleRate));
+            group->outputSampleRate = group->inputSampleRate / group->factor;
+            group->isAligned = false;
+            sourceGroups.add (group);
+        }
+
+        SourceGroup* group = sourceGroups[groupIndex];
+        group->channels.add (i);
+
+        // the mean square is in the square of the input units
+        String units = input->getDataUnits();
+        if (detector == Dsp::EnvelopeDecimator::Power && units.isNotEmpty())
+            units += "^2";
+
+        DataChannel* output = new DataChannel (input->getChannelType(), group->outputSampleRate, this, groupIndex);
+        output->setName (input->getName());
+        output->setBitVolts (input->getBitVolts());
+        output->setDataUnits (units);
+        output->setEnable (input->isEnabled());
+        output->setRecordState (input->getRecordState());
+        output->setMonitored (input->isMonitored());
+        output->addToHistoricString (input->getHistoricString());
+        dataChannelArray.add (output);
+    }
+
+    for (auto group : sourceGroups)
+    {
+        const double smoothingSamples = smoothingMs * group->inputSampleRate / 1000.0;
+
+        group->envelope.setup (group->channels.size(), group->factor, detector, smoother, smoothingSamples);
+        group->channelPointers.insertMultiple (0, nullptr, group->channels.size());
+    }
+}
+
+
+bool EnvelopeNode::enable()
+{
+    for (auto group : sourceGroups)
+    {
+        group->envelope.reset();
+        group->isAligned = false;
+    }
+
+    return true;
+}
+
+
+void EnvelopeNode::setParameter (int parameterIndex, float newValue)
+{
+    switch (parameterIndex)
+    {
+        case TARGET_RATE:
+            if (newValue > 0)
+                targetSampleRate = newValue;
+            break;
+
+        case DETECTOR:
+            detector = Dsp::EnvelopeDecimator::Detector (jlimit (0, 2, int (newValue)));
+            break;
+
+        case SMOOTHER:
+            smoother = Dsp::EnvelopeDecimator::Smoother (jlimit (0, 1, int (newValue)));
+            break;
+
+        case SMOOTHING_MS:
+            if (newValue > 0)
+                smoothingMs = newValue;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void EnvelopeNode::process (AudioSampleBuffer& buffer)
+{
+    for (int g = 0; g < sourceGroups.size(); ++g)
+    {
+        SourceGroup* group = sourceGroups.getUnchecked (g);
+        Dsp::EnvelopeDecimator& envelope = group->envelope;
+        const int factor = group->factor;
+
+        const int numSamples = getNumSourceSamples (group->sourceId);
+        const juce::uint64 timestamp = getSourceTimestamp (group->sourceId);
+
+        // keep the samples whose source timestamps are multiples of the factor,
+        // so the output timestamps are the source timestamps divided by it
+        if (! group->isAligned)
+        {
+            envelope.setPhase (-int (timestamp % factor));
+            group->isAligned = true;
+        }
+
+        const juce::uint64 firstSample = timestamp + envelope.getPhase();
+
+        for (int j = 0; j < group->channels.size(); ++j)
+            group->channelPointers.setUnchecked (j, buffer.getWritePointer (group->channels.getUnchecked (j)));
+
+        const int numOutputs = envelope.process (numSamples,
+                                                 group->channelPointers.getRawDataPointer(),
+                                                 group->channelPointers.getRawDataPointer());
+
+        setTimestampAndSamples (firstSample / factor, numOutputs, g);
+    }
+}
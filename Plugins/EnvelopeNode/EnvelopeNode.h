@@ -0,0 +1,106 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ENVELOPENODE_H__
+#define __ENVELOPENODE_H__
+
+#include <ProcessorHeaders.h>
+#include <DspLib.h>
+
+
+/**
+    Turns continuous data into its envelope at a lower sample rate, e.g. EMG activity
+    or the power of a filtered LFP band, for displays, recording and closed-loop triggers.
+
+    Every sample is rectified or squared, smoothed by a one-pole low pass or a boxcar,
+    and downsampled, all in one pass over the block. Like the Downsampler, each
+    subprocessor upstream is downsampled by the integer factor that brings it closest
+    to the output sample rate, and its channels come out of a subprocessor of this node
+    with the lower sample rate. Events are passed through unchanged.
+
+    @see GenericProcessor, EnvelopeEditor, DownsamplingNode
+*/
+class EnvelopeNode : public GenericProcessor
+{
+public:
+    /** Parameters, as used by setParameter() */
+    enum Parameter
+    {
+        TARGET_RATE = 0,
+        DETECTOR,
+        SMOOTHER,
+        SMOOTHING_MS
+    };
+
+    EnvelopeNode();
+    ~EnvelopeNode();
+
+    AudioProcessorEditor* createEditor() override;
+
+    bool hasEditor() const override { return true; }
+
+    void process (AudioSampleBuffer& buffer) override;
+
+    void setParameter (int parameterIndex, float newValue) override;
+
+    void updateSettings() override;
+
+    bool enable() override;
+
+    int getNumSubProcessors() const override;
+
+    float getSampleRate (int subProcessorIdx = 0) const override;
+
+    float getTargetSampleRate() const;
+    Dsp::EnvelopeDecimator::Detector getDetector() const;
+    Dsp::EnvelopeDecimator::Smoother getSmoother() const;
+    float getSmoothingTime() const;
+
+    /** Downsampling factor of one of the subprocessors */
+    int getDownsamplingFactor (int subProcessorIdx = 0) const;
+
+
+private:
+    /** Channels from the same subprocessor upstream are processed together, in lockstep */
+    struct SourceGroup
+    {
+        Dsp::EnvelopeDecimator envelope;
+        uint32 sourceId;
+        float inputSampleRate;
+        float outputSampleRate;
+        int factor;
+        bool isAligned;
+        Array<int> channels;
+        Array<float*> channelPointers;
+    };
+
+    OwnedArray<SourceGroup> sourceGroups;
+
+    float targetSampleRate;
+    Dsp::EnvelopeDecimator::Detector detector;
+    Dsp::EnvelopeDecimator::Smoother smoother;
+    float smoothingMs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EnvelopeNode);
+};
+
+#endif  // __ENVELOPENODE_H__
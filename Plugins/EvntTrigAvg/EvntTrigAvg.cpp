@@ -39,8 +39,6 @@ EvntTrigAvg::EvntTrigAvg()
 
 EvntTrigAvg::~EvntTrigAvg()
 {
-    clearHistogramArray();
-    clearMinMaxMean();
 }
 
 void EvntTrigAvg::setParameter(int parameterIndex, float newValue)
@@ -68,8 +66,6 @@ void EvntTrigAvg::setParameter(int parameterIndex, float newValue)
     
     // If anything was changed, delete all data and start over
     if (changed){
-        spikeData.clear();
-        ttlTimestampBuffer.clear();
         lastTTLCalculated=0;
         updateSettings();
     }
@@ -77,65 +73,56 @@ void EvntTrigAvg::setParameter(int parameterIndex, float newValue)
 
 void EvntTrigAvg::updateSettings()
 {
-    clearMinMaxMean();
-    clearHistogramArray();
     initializeHistogramArray();
-    initializeMinMaxMean();
   //  electrodeMap.clear();
  //   electrodeMap = createElectrodeMap();
     electrodeLabels.clear();
     electrodeLabels = createElectrodeLabels();
-    if(spikeData.size()!=getTotalSpikeChannels())
-        spikeData.resize(getTotalSpikeChannels());
-    electrodeSortedId.clear();
-    if(electrodeSortedId.size()!=getTotalSpikeChannels())
-        electrodeSortedId.resize(getTotalSpikeChannels());
-    for(int electrodeIt = 0 ; electrodeIt < spikeData.size() ; electrodeIt++){
-        electrodeSortedId[electrodeIt].push_back(0);
-        if(spikeData[electrodeIt].size()<1)
-            spikeData[electrodeIt].resize(1);
-    }
+
+    // the trigger is a TTL channel
+    for (int i = 0; i < getTotalEventChannels(); i++)
+        setEventChannelSubscription(i, getEventChannel(i)->getChannelType() == EventChannel::TTL);
 }
+
 void EvntTrigAvg::initializeHistogramArray()
 {
     const ScopedLock lock(mut);
-    for (int i = 0 ; i < getTotalSpikeChannels() ; i++){
-        histogramData.add(new uint64[1003]{0});
-        histogramData[i][0]=i;//electrode
-        histogramData[i][1]=0;//sortedID
-        histogramData[i][2]=0;//num bins used
-        for (int data = 3 ; data < 1003 ; data++){
-            histogramData[i][data] = 0;
-        }
+
+    const int numElectrodes = getTotalSpikeChannels();
+
+    // the rows stay where they are unless the electrodes change, as the canvas may point to them
+    if (maxRows != numElectrodes + EVNT_TRIG_AVG_MAX_UNITS){
+        maxRows = numElectrodes + EVNT_TRIG_AVG_MAX_UNITS;
+        histogramData.malloc(maxRows * EVNT_TRIG_AVG_ROW_SIZE);
+        minMaxMean.malloc(maxRows * 5);
     }
-}
+    if (recentSpikes == nullptr)
+        recentSpikes.malloc(EVNT_TRIG_AVG_MAX_RECENT_SPIKES);
+    openTriggers.ensureStorageAllocated(EVNT_TRIG_AVG_MAX_OPEN_TRIGGERS);
 
-void EvntTrigAvg::initializeMinMaxMean()
-{
-    const ScopedLock lock(mut);
-    for (int i = 0 ; i < getTotalSpikeChannels() ; i++){
-        minMaxMean.add(new float[5]);
-        minMaxMean[i][0]=i;//electrode
-        minMaxMean[i][1]=0;//sortedId
-        minMaxMean[i][2]=0;//minimum
-        minMaxMean[i][3]=0;//maximum
-        minMaxMean[i][4]=0;//Mean
+    histogramData.clear(maxRows * EVNT_TRIG_AVG_ROW_SIZE);
+    minMaxMean.clear(maxRows * 5);
+
+    numBins = jlimit(1, EVNT_TRIG_AVG_MAX_BINS, int(windowSize/jmax(uint64(1),binSize)));
+    numRows = numElectrodes;
+    electrodeFirstRow.resize(numElectrodes);
+    electrodeSortedId.clear();
+    electrodeSortedId.resize(numElectrodes);
+
+    for (int i = 0 ; i < numElectrodes ; i++){
+        uint64* row = histogramData + i*EVNT_TRIG_AVG_ROW_SIZE;
+        row[0]=i;//electrode
+        row[1]=0;//sortedID
+        row[2]=numBins;//num bins used
+        minMaxMean[i*5]=i;//electrode
+        minMaxMean[i*5+1]=0;//sortedId
+        electrodeFirstRow[i]=i;
+        electrodeSortedId[i].push_back(0);
     }
-}
 
-void EvntTrigAvg::clearHistogramArray()
-{
-    const ScopedLock lock(mut);
-    for (int i = 0 ; i < histogramData.size() ; i++)
-        delete[] histogramData[i];
-    histogramData.clear();
-}
-void EvntTrigAvg::clearMinMaxMean()
-{
-    const ScopedLock lock(mut);
-    for (int i = 0 ; i < minMaxMean.size() ; i++)
-        delete[] minMaxMean[i];
-    minMaxMean.clear();
+    openTriggers.clearQuick();
+    firstRecentSpike = 0;
+    numRecentSpikes = 0;
 }
 
 bool EvntTrigAvg::enable()
@@ -156,24 +143,31 @@ void EvntTrigAvg::process(AudioSampleBuffer& buffer)
     
     if(buffer.getNumChannels() != numChannels)
         numChannels = buffer.getNumChannels();
-    if(ttlTimestampBuffer.size() > lastTTLCalculated && buffer.getNumSamples() + getTimestamp(0) >= ttlTimestampBuffer[lastTTLCalculated+1] + windowSize/2){ // if need to recalc
-        recalc = true;
-    }
-    if(recalc){ // triggered after window time has expirered
-        //process the data
-        processSpikeData(spikeData, ttlTimestampBuffer);
-        
-        //clear the data
-        for(int channelIterator = 0 ; channelIterator < spikeData.size() ; channelIterator++){
-            for(int sortedIdIterator = 0 ; sortedIdIterator < spikeData[channelIterator].size() ; sortedIdIterator++){
-                spikeData[channelIterator][sortedIdIterator].clear();
-            }
-        }
-        //advance the TTL that needs to be calculated
-        lastTTLCalculated+=1;
-        //just recalculated, don't need to again until next ttl window has expired
-        recalc=false;
+
+    if (buffer.getNumChannels() > 0)
+        closeTriggers(getTimestamp(0) + getNumSamples(0));
+}
+
+void EvntTrigAvg::closeTriggers(int64 timestamp)
+{
+    const ScopedLock lock(mut);
+
+    int numClosed = 0;
+    while (numClosed < openTriggers.size() && openTriggers[numClosed] + int64(windowSize/2) < timestamp)
+        numClosed++;
+
+    // forget the spikes no trigger to come can reach
+    while (numRecentSpikes > 0 && recentSpikes[firstRecentSpike].timestamp + int64(windowSize/2) < timestamp){
+        firstRecentSpike = (firstRecentSpike + 1) % EVNT_TRIG_AVG_MAX_RECENT_SPIKES;
+        numRecentSpikes--;
     }
+
+    if (numClosed == 0)
+        return;
+
+    openTriggers.removeRange(0, numClosed);
+    lastTTLCalculated += numClosed;
+    updateMinMaxMean();
 }
 
 void EvntTrigAvg::handleEvent(const EventChannel* eventInfo, const MidiMessage& event, int sampleNum)
@@ -181,103 +175,120 @@ void EvntTrigAvg::handleEvent(const EventChannel* eventInfo, const MidiMessage&
     if (triggerEvent < 0) return;
     else if (eventInfo->getChannelType() == EventChannel::TTL && eventInfo == eventChannelArray[triggerEvent])
     {// if TTL from right channel
-        TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
-        if (ttl->getChannel() == triggerChannel && ttl->getState())
-            ttlTimestampBuffer.push_back(Event::getTimestamp(event)); // add timestamp of TTL to buffer
+        EventView ttl(event, eventInfo);
+        if (ttl.getChannel() == triggerChannel && ttl.getState()){
+            const ScopedLock lock(mut);
+            const int64 trigger = Event::getTimestamp(event);
+
+            // the window of the oldest trigger is cut short if too many are open
+            if (openTriggers.size() == EVNT_TRIG_AVG_MAX_OPEN_TRIGGERS){
+                openTriggers.remove(0);
+                lastTTLCalculated++;
+            }
+            openTriggers.add(trigger);
+
+            // the spikes that came before the trigger
+            for (int i = 0 ; i < numRecentSpikes ; i++){
+                const RecentSpike& spike = recentSpikes[(firstRecentSpike + i) % EVNT_TRIG_AVG_MAX_RECENT_SPIKES];
+                addSpike(spike.timestamp, spike.electrode, spike.unit, trigger);
+            }
+        }
     }
 }
 
 void EvntTrigAvg::handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition)
 {
-    SpikeEventPtr newSpike = SpikeEvent::deserializeFromMessage(event, spikeInfo);
-    if (!newSpike)
+    SpikeView newSpike(event, spikeInfo);
+    if (!newSpike.isValid())
         return;
     else {
+        // the canvas can clear the histograms at any time
+        const ScopedLock lock(mut);
+
         // extract information from spike
-        
-        const SpikeChannel* chan = newSpike->getChannelInfo();
-        Array<SourceChannelInfo> chanInfo = chan->getSourceChannelInfo();
-        //int chanIDX = chanInfo[0].channelIDX;
-        int electrode = getSpikeChannelIndex(newSpike);
-        //std::cout<<"chanIDX: " << chanIDX << "\n";
-        int sortedID = newSpike->getSortedID();
-        //int electrode = electrodeMap[chanInfo];
-        if(sortedID!=0 && sortedID>idIndex.size()){ // respond to new sortedID
-            idIndex.push_back(spikeData[electrode].size());// update map of what sorted ID is on what electrode
+        int electrode = getSpikeChannelIndex(newSpike.getSourceIndex(), newSpike.getSourceID(), newSpike.getSubProcessorIdx());
+        if (electrode < 0 || electrode >= electrodeSortedId.size())
+            return;
+        int sortedID = newSpike.getSortedID();
+        const int64 timestamp = newSpike.getTimestamp();
+
+        std::vector<int>& units = electrodeSortedId[electrode];
+        int unit = 0;
+        while (unit < units.size() && units[unit] != sortedID)
+            unit++;
+        if (unit == units.size()){
+            if (numRows == maxRows)
+                unit = 0; // out of rows, the spike only counts for its electrode
+            else
+                addNewSortedId(electrode, sortedID); //insert new sortedId into histogramArray
         }
-            
-        bool newID = true;
-        //for(int i = 0 ; i < electrodeSortedId[chanIDX].size() ; i++){
-        for(int i = 0 ; i < electrodeSortedId[electrode].size() ; i++){
-            //if(sortedID == electrodeSortedId[chanIDX][i])
-           if(sortedID == electrodeSortedId[electrode][i])
-               newID=false;
+
+        for (int i = 0 ; i < openTriggers.size() ; i++)
+            addSpike(timestamp, electrode, unit, openTriggers.getUnchecked(i));
+
+        if (numRecentSpikes == EVNT_TRIG_AVG_MAX_RECENT_SPIKES){
+            firstRecentSpike = (firstRecentSpike + 1) % EVNT_TRIG_AVG_MAX_RECENT_SPIKES;
+            numRecentSpikes--;
         }
-        if(newID){
-            //electrodeSortedId[chanIDX].push_back(sortedID);
-            electrodeSortedId[electrode].push_back(sortedID);
-            addNewSortedIdMinMaxMean(electrode,sortedID);
-            addNewSortedIdHistoData(electrode,sortedID); //insert new sortedId into histogramArray
-            spikeData[electrode].resize(spikeData[electrode].size()+1);
-            }
-        
-        int relativeSortedID = 0;
-        if (sortedID>0)
-            relativeSortedID = idIndex[sortedID-1];
-        spikeData[electrode][0].push_back(newSpike->getTimestamp());
-        if (sortedID>0)
-            spikeData[electrode][relativeSortedID].push_back(newSpike->getTimestamp());
+        RecentSpike& recent = recentSpikes[(firstRecentSpike + numRecentSpikes) % EVNT_TRIG_AVG_MAX_RECENT_SPIKES];
+        recent.timestamp = timestamp;
+        recent.electrode = electrode;
+        recent.unit = unit;
+        numRecentSpikes++;
     }
 }
 
-void EvntTrigAvg::addNewSortedIdHistoData(int electrode,int sortedId)
+void EvntTrigAvg::addSpike(int64 spikeTimestamp, int electrode, int unit, int64 triggerTimestamp)
+{
+    const int64 relativeSpikeValue = spikeTimestamp - triggerTimestamp + int64(windowSize/2);
+    if (relativeSpikeValue < 0 || relativeSpikeValue > int64(windowSize))
+        return;
+
+    const int bin = jmin(numBins-1, int(relativeSpikeValue/int64(binSize)));
+    const int firstRow = electrodeFirstRow[electrode];
+
+    histogramData[firstRow*EVNT_TRIG_AVG_ROW_SIZE + 3 + bin]++;
+    if (unit > 0)
+        histogramData[(firstRow + unit)*EVNT_TRIG_AVG_ROW_SIZE + 3 + bin]++;
+}
+
+void EvntTrigAvg::addNewSortedId(int electrode,int sortedId)
 {
     const ScopedLock myScopedLock(mut);
-    if(electrode == getTotalSpikeChannels()-1){
-        histogramData.add(new uint64[1003]{0});
-        histogramData.getLast()[0]=electrode;//electrode
-        histogramData.getLast()[1]=sortedId;//sortedID
-        histogramData.getLast()[2]=windowSize/binSize;//num bins used
 
-        return;
-    }
-    else{
-        for(int i = 1 ; i < histogramData.size() ; i++){
-            if(histogramData[i][0]>electrode){
-                histogramData.insert(i,new uint64[1003]{0});
-                histogramData[i][0]=electrode;//electrode
-                histogramData[i][1]=sortedId;//sortedID
-                histogramData[i][2]=windowSize/binSize;//num bins used
-                return;
-            }
-        }
-    }
+    electrodeSortedId[electrode].push_back(sortedId);
+
+    // make room after the last row of the electrode
+    const int row = electrodeFirstRow[electrode] + electrodeSortedId[electrode].size() - 1;
+    memmove(histogramData + (row+1)*EVNT_TRIG_AVG_ROW_SIZE, histogramData + row*EVNT_TRIG_AVG_ROW_SIZE,
+            (numRows-row)*EVNT_TRIG_AVG_ROW_SIZE*sizeof(uint64));
+    memmove(minMaxMean + (row+1)*5, minMaxMean + row*5, (numRows-row)*5*sizeof(float));
+    for (int i = electrode+1 ; i < electrodeFirstRow.size() ; i++)
+        electrodeFirstRow[i]++;
+    numRows++;
+
+    uint64* histogramRow = histogramData + row*EVNT_TRIG_AVG_ROW_SIZE;
+    zeromem(histogramRow, EVNT_TRIG_AVG_ROW_SIZE*sizeof(uint64));
+    histogramRow[0]=electrode;//electrode
+    histogramRow[1]=sortedId;//sortedID
+    histogramRow[2]=numBins;//num bins used
+
+    float* minMaxMeanRow = minMaxMean + row*5;
+    minMaxMeanRow[0]=electrode;//electrode
+    minMaxMeanRow[1]=sortedId;//sortedID
+    minMaxMeanRow[2]=0;//minimum
+    minMaxMeanRow[3]=0;//maximum
+    minMaxMeanRow[4]=0;//mean
 }
 
-void EvntTrigAvg::addNewSortedIdMinMaxMean(int electrode,int sortedId)
+void EvntTrigAvg::updateMinMaxMean()
 {
     const ScopedLock myScopedLock(mut);
-    if(electrode == getTotalSpikeChannels()-1){
-        minMaxMean.add(new float[5]);
-        minMaxMean.getLast()[0]=electrode;//electrode
-        minMaxMean.getLast()[1]=sortedId;//sortedID
-        minMaxMean.getLast()[2]=0;//minimum
-        minMaxMean.getLast()[3]=0;//maximum
-        minMaxMean.getLast()[4]=0;//mean
-        return;
-    }
-    else{
-        for(int i = 1 ; i < histogramData.size() ; i++){
-            if(minMaxMean[i][0]>electrode){
-                minMaxMean.insert(i,new float[5]);
-                minMaxMean[i][0]=electrode;//electrode
-                minMaxMean[i][1]=sortedId;//sortedID
-                minMaxMean[i][2]=0;//minimum
-                minMaxMean[i][3]=0;//maximum
-                minMaxMean[i][4]=0;//mean
-                return;
-            }
-        }
+    for (int row = 0 ; row < numRows ; row++){
+        uint64* bins = histogramData + row*EVNT_TRIG_AVG_ROW_SIZE + 3;
+        minMaxMean[row*5+2] = findMin(bins);
+        minMaxMean[row*5+3] = findMax(bins);
+        minMaxMean[row*5+4] = findMean(bins);
     }
 }
 
@@ -336,86 +347,6 @@ std::vector<String> EvntTrigAvg::createElectrodeLabels()
     return map;
 }
 
-/** passes data into createHistogramData() by electrode and sorted ID */
-void EvntTrigAvg::processSpikeData(std::vector<std::vector<std::vector<uint64>>> spikeData,std::vector<uint64> ttlData)
-{
-    
-    for (int channelIterator = 0 ; channelIterator < getTotalSpikeChannels() ; channelIterator++){
-        const ScopedLock myScopedLock(mut);
-        for (int sortedIdIterator = 0 ; sortedIdIterator < spikeData[channelIterator].size() ; sortedIdIterator++){
-            uint64* data = createHistogramData(spikeData[channelIterator][sortedIdIterator],ttlData);
-            histogramData[channelIterator+sortedIdIterator][2]=windowSize/binSize;
-            for(int dataIterator = 3 ; dataIterator<windowSize/binSize+3 ; dataIterator++){
-                histogramData[channelIterator+sortedIdIterator][dataIterator] += (data[dataIterator-3]);
-            }
-        minMaxMean[channelIterator+sortedIdIterator][2]= findMin(&histogramData[channelIterator+sortedIdIterator][3]);
-            
-        minMaxMean[channelIterator+sortedIdIterator][3]= findMax(&histogramData[channelIterator+sortedIdIterator][3]);
-            
-        minMaxMean[channelIterator+sortedIdIterator][4] = findMean(&histogramData[channelIterator+sortedIdIterator][3]);
-        }
-    }
-}
-
-/** returns bin counts */
-uint64* EvntTrigAvg::createHistogramData(std::vector<uint64> spikeData, std::vector<uint64> ttlData)
-{
-    uint64 numberOfBins = windowSize/binSize;
-    std::vector<uint64> histoData;
-    for(int ttlIterator = 0 ; ttlIterator < ttlData.size() ; ttlIterator++){
-        for(int spikeIterator = 0 ; spikeIterator < spikeData.size() ; spikeIterator++){
-            int relativeSpikeValue = int(spikeData[spikeIterator])-int(ttlData[ttlIterator]);
-            if (relativeSpikeValue >= -int(windowSize)/2 && relativeSpikeValue <= int(windowSize)/2){
-                uint64 bin = binDataPoint(0, numberOfBins, binSize, relativeSpikeValue+windowSize/2);
-                histoData.push_back(bin);
-            }
-        }
-    }
-    return binCount(histoData,numberOfBins);
-}
-
-
-/** Returns the bin a data point belongs to given the very first bin, the very last bin, bin size and the data point to bin, currently only works for positive numbers (can get around by adding minimum value to all values*/
-uint64 EvntTrigAvg::binDataPoint(uint64 startBin, uint64 endBin, uint64 binSize, uint64 dataPoint)
-{
-    uint64 binsInRange = (endBin-startBin);
-    uint64 binsToSearch = binsInRange/2;
-    if (binsToSearch <= 1){
-        
-        if (dataPoint < (startBin+binsToSearch)*binSize){
-            return startBin;
-        }
-        else if (dataPoint < (startBin+1+binsToSearch) * binSize){
-            return startBin+1;
-        }
-        else{
-            return startBin+2;
-        }
-    }
-
-    else if (dataPoint < (startBin+binsToSearch)*binSize){ // if in first half of search range
-        return binDataPoint(startBin,startBin+(binsToSearch),binSize,dataPoint);
-    }
-    else if (dataPoint >= (startBin+binsToSearch) * binSize){ // if in second half of search range
-        return binDataPoint(startBin+(binsToSearch),endBin,binSize,dataPoint);
-    }
-    else{
-        return (uint64) NULL;
-    }
-}
-
-/** count the number of bin instances */
-uint64* EvntTrigAvg::binCount(std::vector<uint64> binData,uint64 numberOfBins)
-{
-    for (int i = 0 ; i < 1000 ; i++){
-        bins[i]=0;
-    }
-    for (int dataIterator = 0 ; dataIterator < binData.size() ; dataIterator++){
-        bins[binData[dataIterator]] = bins[binData[dataIterator]]+1;
-    }
-    return bins;
-}
-
 uint64 EvntTrigAvg::getBinSize()
 {
     return binSize;
@@ -429,13 +360,19 @@ uint64 EvntTrigAvg::getWindowSize()
 Array<uint64 *> EvntTrigAvg::getHistoData()
 {
     const ScopedLock myScopedLock(mut);
-    return histogramData;
+    Array<uint64 *> rows;
+    for (int row = 0 ; row < numRows ; row++)
+        rows.add(histogramData + row*EVNT_TRIG_AVG_ROW_SIZE);
+    return rows;
 }
 
 Array<float *> EvntTrigAvg::getMinMaxMean()
 {
     const ScopedLock myScopedLock(mut);
-    return minMaxMean;
+    Array<float *> rows;
+    for (int row = 0 ; row < numRows ; row++)
+        rows.add(minMaxMean + row*5);
+    return rows;
 }
 
 float EvntTrigAvg::findMin(uint64* data_)
@@ -443,7 +380,7 @@ float EvntTrigAvg::findMin(uint64* data_)
     const ScopedLock myScopedLock(mut);
     //uint64 min = UINT64_MAX;
     uint64 min = 18446744073709551614U;
-    for (int i = 0 ; i < windowSize/binSize ; i++){
+    for (int i = 0 ; i < numBins ; i++){
         if(data_[i]<min){
             min=data_[i];
         }
@@ -455,7 +392,7 @@ float EvntTrigAvg::findMax(uint64* data_)
 {
     const ScopedLock myScopedLock(mut);
     uint64 max = 0;
-    for (int i = 0 ; i < windowSize/binSize ; i++){
+    for (int i = 0 ; i < numBins ; i++){
         if(data_[i]>max){
             max=data_[i];
         }
@@ -467,10 +404,10 @@ float EvntTrigAvg::findMean(uint64* data_)
 {
     const ScopedLock myScopedLock(mut);
     uint64 runningSum=0;
-    for(int i=0 ; i < windowSize/binSize ; i++){
+    for(int i=0 ; i < numBins ; i++){
         runningSum += data_[i];
     }
-    float mean = float(runningSum)/(float(windowSize)/float(binSize));
+    float mean = float(runningSum)/float(numBins);
     return mean;
 }
 
@@ -481,14 +418,6 @@ std::vector<String> EvntTrigAvg::getElectrodeLabels()
     return electrodeLabels;
 }
 
-void EvntTrigAvg::clearHistogramData(uint64 * dataptr)
-{
-    const ScopedLock myScopedLock(mut);
-    for(int i = 0 ; i < 1000 ; i++)
-        dataptr[i] = 0;
-}
-
-
 void EvntTrigAvg::saveCustomParametersToXml (XmlElement* parentElement)
 {
     XmlElement* mainNode = parentElement->createNewChildElement ("EVNTTRIGAVG");
@@ -29,10 +29,20 @@
 #include <vector>
 #include <map>
 
+#define EVNT_TRIG_AVG_MAX_BINS 1000
+#define EVNT_TRIG_AVG_ROW_SIZE (EVNT_TRIG_AVG_MAX_BINS + 3) // electrode, sorted ID, bins used, bins
+#define EVNT_TRIG_AVG_MAX_UNITS 256 // sorted units of all electrodes
+#define EVNT_TRIG_AVG_MAX_OPEN_TRIGGERS 256
+#define EVNT_TRIG_AVG_MAX_RECENT_SPIKES 8192
+
 class EvntTrigAvgEditor;
 
 /**
 Aligns spike times with TTL input.
+
+The histograms are built as the spikes come: a spike is added to the window of every
+trigger still open, and a new trigger takes in the spikes of the half window before it
+from a short history. Memory doesn't grow with the length of the recording.
  
 @see EvntTrigAvgCanvas, EvntTrigAvgEditor
 
@@ -55,6 +65,8 @@ public:
     void handleSpike(const SpikeChannel* channelInfo, const MidiMessage& event, int samplePosition) override;
     void process(AudioSampleBuffer& buffer) override;
 
+    bool isSheddable() const override { return true; }
+
     /** Used to alter parameters of data acquisition. */
     void setParameter(int parameterIndex, float newValue) override;
 
@@ -81,11 +93,6 @@ public:
     Array<uint64 *> getHistoData();
     Array<float *> getMinMaxMean();
 
-    //create histogram data
-    uint64* createHistogramData(std::vector<uint64> spikeData, std::vector<uint64> ttlData); // shared data
-    uint64 binDataPoint(uint64 startBin, uint64 endBin, uint64 binSize, uint64 dataPoint); // shared data
-    void processSpikeData(std::vector<std::vector<std::vector<uint64>>> spikeData,std::vector<uint64> ttlData);
-    uint64* binCount(std::vector<uint64> binData, uint64 numberOfBins); // shared data
     bool shouldReadHistoData();
     float findMin(uint64* data_);
     float findMax(uint64* data_);
@@ -100,30 +107,47 @@ public:
 private:
     CriticalSection mut;
     void initializeHistogramArray();
-    void initializeMinMaxMean();
-    void clearHistogramArray();
-    void clearMinMaxMean();
-    void addNewSortedIdHistoData(int electrode, int sortedId);
-    void addNewSortedIdMinMaxMean(int electrode,int sortedID);
+    /** Inserts the rows of a new sorted unit after the other rows of its electrode */
+    void addNewSortedId(int electrode, int sortedId);
+    /** Adds a spike to the histograms of its electrode and unit, for a trigger */
+    void addSpike(int64 spikeTimestamp, int electrode, int unit, int64 triggerTimestamp);
+    /** Closes the trigger windows that ended before the timestamp */
+    void closeTriggers(int64 timestamp);
+    void updateMinMaxMean();
     std::atomic<int> triggerEvent;
     std::atomic<int> triggerChannel;
 
-    uint64 bins[1000]; // workspace for bin counting
-
     int numChannels = 0;
-    bool recalc = false;
     int lastTTLCalculated = 0;
     uint64 windowSize;
     uint64 binSize;
-    
-    std::vector<uint64> ttlTimestampBuffer;
-    std::vector<std::vector<std::vector<uint64>>> spikeData;// channel.sortedID.spikeInstance.timestamp
-    void clearHistogramData(uint64 * const);
-    Array<uint64*> histogramData; // shared data
-    Array<float*> minMaxMean; // shared data
+    int numBins = 0;
+
+    /** One row per electrode and per sorted unit, the units right after their electrode, in
+    contiguous blocks that are only reallocated when the electrodes change, so the canvas can
+    keep pointers to the rows */
+    HeapBlock<uint64> histogramData; // shared data
+    HeapBlock<float> minMaxMean; // shared data: electrode, sorted ID, min, max, mean
+    int numRows = 0;
+    int maxRows = 0;
+
+    /** Triggers whose window is still open, oldest first */
+    Array<int64> openTriggers;
+
+    /** Spikes of the last half window, for the triggers to come */
+    struct RecentSpike
+    {
+        int64 timestamp;
+        int electrode;
+        int unit; // index in electrodeSortedId
+    };
+    HeapBlock<RecentSpike> recentSpikes;
+    int firstRecentSpike = 0;
+    int numRecentSpikes = 0;
+
     //std::map<SourceChannelInfo,int> electrodeMap; // Used to identify what electrode a spike came from
     std::vector<String> electrodeLabels;
-    std::vector<int> idIndex; //sorted ID, electrode. used to match a sortedID with its electrode
+    std::vector<int> electrodeFirstRow;
     std::vector<std::vector<int>> electrodeSortedId; 
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EvntTrigAvg);
@@ -82,6 +82,13 @@ FilterEditor::FilterEditor(GenericProcessor* parentNode, bool useDefaultParamete
     applyFilterOnChan->setTooltip("When this button is off, selected channels will not be filtered");
     addAndMakeVisible(applyFilterOnChan);
 
+    linearPhaseButton = new UtilityButton("FIR",Font("Default", 10, Font::plain));
+    linearPhaseButton->addListener(this);
+    linearPhaseButton->setBounds(95,45,30,18);
+    linearPhaseButton->setClickingTogglesState(true);
+    linearPhaseButton->setTooltip("When this button is on, channels are filtered with linear-phase FIR filters");
+    addAndMakeVisible(linearPhaseButton);
+
 }
 
 FilterEditor::~FilterEditor()
@@ -143,8 +150,7 @@ void FilterEditor::labelTextChanged(Label* label)
 
             if (requestedValue > minVal)
             {
-                fn->setCurrentChannel(chans[n]);
-                fn->setParameter(1, requestedValue);
+                fn->setFilterCutoffs(chans[n], minVal, requestedValue);
             }
 
             lastHighCutString = label->getText();
@@ -156,8 +162,7 @@ void FilterEditor::labelTextChanged(Label* label)
 
             if (requestedValue < maxVal)
             {
-                fn->setCurrentChannel(chans[n]);
-                fn->setParameter(0, requestedValue);
+                fn->setFilterCutoffs(chans[n], requestedValue, maxVal);
             }
 
             lastLowCutString = label->getText();
@@ -196,10 +201,20 @@ void FilterEditor::buttonEvent(Button* button)
         {
             float newValue = button->getToggleState() ? 1.0 : 0.0;
 
-            fn->setCurrentChannel(chans[n]);
-            fn->setParameter(2, newValue);
+            fn->queueParameterChange(2, newValue, chans[n]);
         }
     }
+    else if (button == linearPhaseButton)
+    {
+        FilterNode* fn = (FilterNode*) getProcessor();
+        fn->queueParameterChange(3, button->getToggleState() ? 1.0 : 0.0, 0);
+
+        if (button->getToggleState())
+            linearPhaseButton->setTooltip("Linear-phase FIR filters, which delay the signal by "
+                                          + String(fn->getLinearPhaseDelayMs(), 1) + " ms");
+        else
+            linearPhaseButton->setTooltip("When this button is on, channels are filtered with linear-phase FIR filters");
+    }
 }
 
 
@@ -215,6 +230,7 @@ void FilterEditor::saveCustomParameters(XmlElement* xml)
     textLabelValues->setAttribute("HighCut",lastHighCutString);
     textLabelValues->setAttribute("LowCut",lastLowCutString);
     textLabelValues->setAttribute("ApplyToADC",	applyFilterOnADC->getToggleState());
+    textLabelValues->setAttribute("LinearPhase", linearPhaseButton->getToggleState());
 }
 
 void FilterEditor::loadCustomParameters(XmlElement* xml)
@@ -229,6 +245,7 @@ void FilterEditor::loadCustomParameters(XmlElement* xml)
             resetToSavedText();
 
             applyFilterOnADC->setToggleState(xmlNode->getBoolAttribute("ApplyToADC",false), sendNotification);
+            linearPhaseButton->setToggleState(xmlNode->getBoolAttribute("LinearPhase",false), sendNotification);
         }
     }
 
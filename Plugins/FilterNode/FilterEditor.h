@@ -67,6 +67,7 @@ private:
     ScopedPointer<Label> lowCutValue;
     ScopedPointer<UtilityButton> applyFilterOnADC;
     ScopedPointer<UtilityButton> applyFilterOnChan;
+    ScopedPointer<UtilityButton> linearPhaseButton;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FilterEditor);
 
@@ -27,6 +27,13 @@
 
 FilterNode::FilterNode()
     : GenericProcessor  ("Bandpass Filter")
+    , firDesignLowCut   (0)
+    , firDesignHighCut  (0)
+    , firDesignSampleRate (0)
+    , firDesignTaps     (0)
+    , filterChangeFifo  (FILTER_CHANGE_QUEUE_SIZE)
+    , filterChanges     (FILTER_CHANGE_QUEUE_SIZE)
+    , linearPhase       (false)
     , defaultLowCut     (300.0f)
     , defaultHighCut    (6000.0f)
 {
@@ -129,8 +136,8 @@ void FilterNode::updateSettings()
 {
     //int id = nodeId;
     int numInputs = getNumInputs();
-    int numfilt = filters.size();
-    if (numInputs < 1024 && numInputs != numfilt)
+    int numfilt = lowCuts.size();
+    if (numInputs != numfilt)
     {
         // SO fixed this. I think values were never restored correctly because you cleared lowCuts.
         Array<double> oldlowCuts;
@@ -138,20 +145,12 @@ void FilterNode::updateSettings()
         oldlowCuts = lowCuts;
         oldhighCuts = highCuts;
 
-        filters.clear();
         lowCuts.clear();
         highCuts.clear();
         shouldFilterChannel.clear();
 
         for (int n = 0; n < getNumInputs(); ++n)
         {
-            filters.add (new Dsp::SmoothedFilterDesign
-                         <Dsp::Butterworth::Design::BandPass    // design type
-                         <2>,                                   // order
-                         1,                                     // number of channels (must be const)
-                         Dsp::DirectFormII> (1));               // realization
-
-
             //Parameter& p1 =  parameters.getReference(0);
             //p1.setValue(600.0f, n);
             //Parameter& p2 =  parameters.getReference(1);
@@ -177,15 +176,80 @@ void FilterNode::updateSettings()
 
             lowCuts.add  (newLowCut);
             highCuts.add (newHighCut);
-
-            setFilterParameters (newLowCut, newHighCut, n);
         }
     }
 
+    updateChannelBanks();
+
     setApplyOnADC (applyOnADC);
 }
 
 
+void FilterNode::updateChannelBanks()
+{
+    channelBanks.clear();
+    channelBankIndex.clearQuick();
+    channelBankPosition.clearQuick();
+
+    Array<uint32> bankIds;
+
+    for (int n = 0; n < dataChannelArray.size(); ++n)
+    {
+        uint32 id = getProcessorFullId (dataChannelArray[n]->getSourceNodeID(),
+                                        dataChannelArray[n]->getSubProcessorIdx());
+        int bank = bankIds.indexOf (id);
+
+        if (bank < 0)
+        {
+            bank = bankIds.size();
+            bankIds.add (id);
+            channelBanks.add (new ChannelBank());
+        }
+
+        channelBankIndex.add (bank);
+        channelBankPosition.add (channelBanks[bank]->channels.size());
+        channelBanks[bank]->channels.add (n);
+    }
+
+    for (int b = 0; b < channelBanks.size(); ++b)
+    {
+        ChannelBank* bank = channelBanks[b];
+        bank->sampleRate = dataChannelArray[bank->channels[0]]->getSampleRate();
+        bank->firTaps = 2 * roundToInt (bank->sampleRate * FIR_GROUP_DELAY_MS / 1000.0) + 1;
+        bank->cascade.setNumChannels (bank->channels.size());
+        bank->cascade.setDenormalPrevention (false); // denormals are flushed to zero while processing
+        bank->fir.setNumChannels (bank->channels.size(), FIR_PARTITION_SIZE, bank->firTaps);
+        bank->channelPointers.resize (bank->channels.size());
+    }
+
+    for (int n = 0; n < dataChannelArray.size(); ++n)
+    {
+        setFilterParameters (lowCuts[n], highCuts[n], n);
+        setChannelFiltering (n, shouldFilterChannel[n]);
+    }
+
+    for (int b = 0; b < channelBanks.size(); ++b)
+        updateBankPrecision (channelBanks[b]->channels[0]);
+}
+
+
+void FilterNode::updateBankPrecision (int chan)
+{
+    if (channelBankIndex.size() <= chan)
+        return;
+
+    ChannelBank* bank = channelBanks[channelBankIndex[chan]];
+
+    // the poles of filters with low cuts close to DC are too close to z = 1 for single precision
+    bool singlePrecision = true;
+    for (int i = 0; i < bank->channels.size() && singlePrecision; ++i)
+        singlePrecision = lowCuts[bank->channels.getUnchecked (i)] >= FILTER_SINGLE_PRECISION_MIN_CUTOFF * bank->sampleRate;
+
+    bank->cascade.setPrecision (singlePrecision ? Dsp::MultichannelCascade::SinglePrecision
+                                                : Dsp::MultichannelCascade::DoublePrecision);
+}
+
+
 double FilterNode::getLowCutValueForChannel (int chan) const
 {
     return lowCuts[chan];
@@ -204,19 +268,192 @@ bool FilterNode::getBypassStatusForChannel (int chan) const
 }
 
 
+bool FilterNode::isLinearPhase() const
+{
+    return linearPhase;
+}
+
+
+double FilterNode::getLinearPhaseDelayMs() const
+{
+    double delayMs = 0;
+
+    for (int b = 0; b < channelBanks.size(); ++b)
+    {
+        const ChannelBank* bank = channelBanks[b];
+        const int delay = FIR_PARTITION_SIZE + (bank->firTaps - 1) / 2;
+        delayMs = jmax (delayMs, 1000.0 * delay / bank->sampleRate);
+    }
+
+    return delayMs;
+}
+
+
 void FilterNode::setFilterParameters (double lowCut, double highCut, int chan)
 {
     if (dataChannelArray.size() - 1 < chan)
         return;
 
-    Dsp::Params params;
-    params[0] = dataChannelArray[chan]->getSampleRate(); // sample rate
-    params[1] = 2;                          // order
-    params[2] = (highCut + lowCut) / 2;     // center frequency
-    params[3] = highCut - lowCut;           // bandwidth
+    if (channelBankIndex.size() <= chan)
+        return;
+
+    filterDesign.setup (2,                                      // order
+                        dataChannelArray[chan]->getSampleRate(), // sample rate
+                        (highCut + lowCut) / 2,                 // center frequency
+                        highCut - lowCut);                      // bandwidth
+
+    ChannelBank* bank = channelBanks[channelBankIndex[chan]];
+    bank->cascade.setChannelCascade (channelBankPosition[chan], filterDesign);
+
+    // the FIR kernels are kept up to date as well, so switching filters designs nothing
+    Dsp::FirFilterBank::KernelDesign kernel = getFirKernel (bank, lowCut, highCut);
+    bank->fir.setChannelKernel (channelBankPosition[chan], kernel);
+}
+
+
+const Dsp::FirFilterBank::KernelDesign& FilterNode::getFirKernel (const ChannelBank* bank, double lowCut, double highCut)
+{
+    if (firDesignLowCut != lowCut || firDesignHighCut != highCut
+        || firDesignSampleRate != bank->sampleRate || firDesignTaps != bank->firTaps)
+    {
+        firDesign = bank->fir.prepareKernel (Dsp::FirFilterBank::designBandPass (bank->firTaps, bank->sampleRate,
+                                                                                 lowCut, highCut));
+        firDesignLowCut = lowCut;
+        firDesignHighCut = highCut;
+        firDesignSampleRate = bank->sampleRate;
+        firDesignTaps = bank->firTaps;
+    }
+
+    return firDesign;
+}
+
+
+void FilterNode::setFilterCutoffs (int chan, double lowCut, double highCut)
+{
+    if (channelBankIndex.size() <= chan)
+        return;
+
+    if (CoreServices::getAcquisitionStatus())
+    {
+        // a change to a channel that is still held back replaces the one held back
+        for (int i = heldFilterChanges.size(); --i >= 0;)
+        {
+            if (heldFilterChanges.getReference (i).channel == chan)
+                heldFilterChanges.remove (i);
+        }
+
+        FilterChange change;
+        change.channel = chan;
+        change.lowCut  = lowCut;
+        change.highCut = highCut;
+
+        Dsp::Butterworth::BandPass<2> design;
+        design.setup (2, dataChannelArray[chan]->getSampleRate(), (highCut + lowCut) / 2, highCut - lowCut);
+        change.coefficients.setCascade (design);
+        change.kernel = getFirKernel (channelBanks[channelBankIndex[chan]], lowCut, highCut);
+
+        heldFilterChanges.add (change);
+        queueHeldFilterChanges();
+        return;
+    }
+
+    // changes left over from the last acquisition go first
+    applyHeldFilterChanges();
+
+    lowCuts.set  (chan, lowCut);
+    highCuts.set (chan, highCut);
+    setFilterParameters (lowCut, highCut, chan);
+    updateBankPrecision (chan);
+}
+
+
+void FilterNode::queueHeldFilterChanges()
+{
+    int numQueued = 0;
+
+    while (numQueued < heldFilterChanges.size())
+    {
+        int start1, size1, start2, size2;
+        filterChangeFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            break;
+
+        filterChanges[size1 > 0 ? start1 : start2] = heldFilterChanges.getReference (numQueued++);
+        filterChangeFifo.finishedWrite (1);
+    }
+
+    heldFilterChanges.removeRange (0, numQueued);
+
+    if (heldFilterChanges.size() > 0)
+        std::cout << "Filter change queue full, holding back " << heldFilterChanges.size() << " changes" << std::endl;
+}
+
+
+void FilterNode::applyHeldFilterChanges()
+{
+    // the processing thread is stopped, so whatever it didn't get to is applied from here
+    applyFilterChanges();
+
+    for (int i = 0; i < heldFilterChanges.size(); ++i)
+    {
+        const FilterChange& change = heldFilterChanges.getReference (i);
+
+        lowCuts.set  (change.channel, change.lowCut);
+        highCuts.set (change.channel, change.highCut);
+        setFilterParameters (change.lowCut, change.highCut, change.channel);
+        updateBankPrecision (change.channel);
+    }
+
+    heldFilterChanges.clearQuick();
+}
+
+
+bool FilterNode::disable()
+{
+    applyHeldFilterChanges();
+    return true;
+}
+
+
+void FilterNode::applyFilterChanges()
+{
+    int start1, size1, start2, size2;
+    filterChangeFifo.prepareToRead (filterChangeFifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        FilterChange& change = filterChanges[i < size1 ? start1 + i : start2 + i - size1];
+        const int chan = change.channel;
+
+        lowCuts.set  (chan, change.lowCut);
+        highCuts.set (chan, change.highCut);
+        updateBankPrecision (chan);
+
+        // only the filters in use crossfade, the others just take the new settings
+        ChannelBank* bank = channelBanks[channelBankIndex[chan]];
+        const int fadeSamples = roundToInt (bank->sampleRate * FILTER_CROSSFADE_MS / 1000.0);
 
-    if (filters.size() > chan)
-        filters[chan]->setParams (params);
+        bank->cascade.setChannelCoefficients (channelBankPosition[chan], change.coefficients,
+                                              linearPhase ? 0 : fadeSamples);
+        bank->fir.setChannelKernel (channelBankPosition[chan], change.kernel,
+                                    linearPhase ? fadeSamples : 0);
+    }
+
+    filterChangeFifo.finishedRead (size1 + size2);
+}
+
+
+void FilterNode::setChannelFiltering (int chan, bool shouldFilter)
+{
+    shouldFilterChannel.set (chan, shouldFilter);
+
+    if (channelBankIndex.size() > chan)
+    {
+        ChannelBank* bank = channelBanks[channelBankIndex[chan]];
+        bank->cascade.setChannelEnabled (channelBankPosition[chan], shouldFilter);
+        bank->fir.setChannelEnabled (channelBankPosition[chan], shouldFilter);
+    }
 }
 
 
@@ -239,33 +476,59 @@ void FilterNode::setParameter (int parameterIndex, float newValue)
         setFilterParameters (lowCuts[currentChannel],
                              highCuts[currentChannel],
                              currentChannel);
+        updateBankPrecision (currentChannel);
 
-        editor->updateParameterButtons (parameterIndex);
+        if (! isApplyingParameterChanges())
+            editor->updateParameterButtons (parameterIndex);
     }
-    // change channel bypass state
-    else
+    // switch between the IIR and linear-phase filters
+    else if (parameterIndex == 3)
     {
-        if (newValue == 0)
+        if (linearPhase != (newValue != 0))
         {
-            shouldFilterChannel.set (currentChannel, false);
-        }
-        else
-        {
-            shouldFilterChannel.set (currentChannel, true);
+            linearPhase = newValue != 0;
+
+            for (int b = 0; b < channelBanks.size(); ++b)
+            {
+                channelBanks[b]->cascade.reset();
+                channelBanks[b]->fir.reset();
+            }
         }
     }
+    // change channel bypass state
+    else
+    {
+        setChannelFiltering (currentChannel, newValue != 0);
+    }
 }
 
 
 void FilterNode::process (AudioSampleBuffer& buffer)
 {
-    for (int n = 0; n < getNumOutputs(); ++n)
+    applyFilterChanges();
+
+    for (int b = 0; b < channelBanks.size(); ++b)
     {
-        if (shouldFilterChannel[n])
+        ChannelBank* bank = channelBanks[b];
+
+        for (int i = 0; i < bank->channels.size(); ++i)
+            bank->channelPointers.set (i, buffer.getWritePointer (bank->channels[i]));
+
+        const int numSamples = getNumSamples (bank->channels[0]);
+        float* const* channelPointers = bank->channelPointers.getRawDataPointer();
+
+        if (linearPhase)
         {
-            float* ptr = buffer.getWritePointer (n);
-            filters[n]->process (getNumSamples (n), &ptr);
+            bank->fir.process (numSamples, channelPointers);
+            continue;
         }
+
+        bank->cascade.prepareToProcess (numSamples);
+
+        forEachChannelRange (bank->channels.size(), [=] (int startChannel, int endChannel)
+        {
+            bank->cascade.processChannels (numSamples, channelPointers, startChannel, endChannel);
+        }, 32, Dsp::MultichannelCascade::Lanes);
     }
 }
 
@@ -277,12 +540,10 @@ void FilterNode::setApplyOnADC (bool state)
         if (dataChannelArray[n]->getChannelType() == DataChannel::ADC_CHANNEL
             || dataChannelArray[n]->getChannelType() == DataChannel::AUX_CHANNEL)
         {
-            setCurrentChannel (n);
-
             if (state)
-                setParameter (2,1.0);
+                queueParameterChange (2, 1.0, n);
             else
-                setParameter (2,0.0);
+                queueParameterChange (2, 0.0, n);
         }
     }
 }
@@ -319,9 +580,10 @@ void FilterNode::loadCustomChannelParametersFromXml(XmlElement* channelInfo, Inf
             {
                 highCuts.set (channelNum, subNode->getDoubleAttribute ("highcut", defaultHighCut));
                 lowCuts.set  (channelNum, subNode->getDoubleAttribute ("lowcut",  defaultLowCut));
-                shouldFilterChannel.set (channelNum, subNode->getBoolAttribute ("shouldFilter", true));
+                setChannelFiltering (channelNum, subNode->getBoolAttribute ("shouldFilter", true));
 
                 setFilterParameters (lowCuts[channelNum], highCuts[channelNum], channelNum);
+                updateBankPrecision (channelNum);
             }
         }
     }
@@ -26,11 +26,24 @@
 #include <ProcessorHeaders.h>
 #include <DspLib.h>
 
+/** Group delay of the linear-phase FIR filters, which sets their length */
+#define FIR_GROUP_DELAY_MS 25
+/** Block size of the FIR convolution, which adds its own delay */
+#define FIR_PARTITION_SIZE 256
+/** Lowest low cut, relative to the sample rate, for which channels are filtered in single precision */
+#define FILTER_SINGLE_PRECISION_MIN_CUTOFF 0.01
+/** Length of the crossfade to new cutoffs during acquisition */
+#define FILTER_CROSSFADE_MS 20
+/** Number of cutoff changes that can wait for the processing thread */
+#define FILTER_CHANGE_QUEUE_SIZE 1024
+
 
 /**
     Filters data using a filter from the DSP library.
 
-    The user can select the low- and high-frequency cutoffs.
+    The user can select the low- and high-frequency cutoffs, and choose between
+    2nd order Butterworth filters and linear-phase FIR filters, which delay the
+    signal by a fixed getLinearPhaseDelayMs().
 
     @see GenericProcessor, FilterEditor
 */
@@ -50,6 +63,8 @@ public:
 
     void updateSettings() override;
 
+    bool disable() override;
+
     void saveCustomChannelParametersToXml(XmlElement* channelInfo, int channelNumber, InfoObjectCommon::InfoObjectType channelTypel) override;
     void loadCustomChannelParametersFromXml(XmlElement* channelInfo, InfoObjectCommon::InfoObjectType channelType)  override;
 
@@ -58,19 +73,92 @@ public:
 
     bool getBypassStatusForChannel (int chan) const;
 
+    /** Changes the cutoffs of a channel. During acquisition the new coefficients and FIR kernel
+        are designed on the calling thread, and the processing thread crossfades to them between
+        blocks. Changes that don't fit in the full queue are held back until the next call, or
+        until acquisition stops. */
+    void setFilterCutoffs (int chan, double lowCut, double highCut);
+
     void setApplyOnADC (bool state);
 
+    bool isLinearPhase() const;
+
+    /** Total delay of the signal when using the linear-phase filters: the group delay of the
+        filters plus the convolution block size. */
+    double getLinearPhaseDelayMs() const;
+
 
 private:
+    /** Channels from the same subprocessor have the same number of samples in each block,
+        so they are filtered together, in lockstep */
+    struct ChannelBank
+    {
+        Dsp::MultichannelCascade cascade;
+        Dsp::FirFilterBank fir;
+        int firTaps;
+        double sampleRate;
+        Array<int> channels;
+        Array<float*> channelPointers;
+    };
+
+    /** Cutoffs and precomputed coefficients for a channel, on their way to the processing thread.
+        The processing thread swaps the kernel it replaces into the change, so it is freed here. */
+    struct FilterChange
+    {
+        int channel;
+        double lowCut;
+        double highCut;
+        Dsp::MultichannelCascade::Coefficients coefficients;
+        Dsp::FirFilterBank::KernelDesign kernel;
+    };
+
+    /** Groups the input channels by subprocessor and sets up their filters */
+    void updateChannelBanks();
+
+    /** Swaps in the coefficients queued by setFilterCutoffs() */
+    void applyFilterChanges();
+
+    /** Queues as many held back changes as fit in the queue */
+    void queueHeldFilterChanges();
+
+    /** Applies the queued and held back changes, once the processing thread has stopped */
+    void applyHeldFilterChanges();
+
+    /** Returns the FIR kernel of a bank for the given cutoffs. Windowed-sinc designs are slow
+        for long filters, so the last one is reused by the following channels with the same settings */
+    const Dsp::FirFilterBank::KernelDesign& getFirKernel (const ChannelBank* bank, double lowCut, double highCut);
+
+    /** Filters a bank in single precision when all its low cuts are high enough for it */
+    void updateBankPrecision (int chan);
+
     void setFilterParameters (double, double, int);
+    void setChannelFiltering (int chan, bool shouldFilter);
 
     Array<double> lowCuts;
     Array<double> highCuts;
 
-    OwnedArray<Dsp::Filter> filters;
+    /** Designs the coefficients that are copied into the channel banks */
+    Dsp::Butterworth::BandPass<2> filterDesign;
+
+    /** Last FIR design, only used on the message thread */
+    Dsp::FirFilterBank::KernelDesign firDesign;
+    double firDesignLowCut;
+    double firDesignHighCut;
+    double firDesignSampleRate;
+    int firDesignTaps;
+
+    AbstractFifo filterChangeFifo;
+    std::vector<FilterChange> filterChanges;
+    /** Changes that didn't fit in the full queue, at most one per channel. Only touched from the message thread */
+    Array<FilterChange> heldFilterChanges;
+
+    OwnedArray<ChannelBank> channelBanks;
+    Array<int> channelBankIndex;
+    Array<int> channelBankPosition;
     Array<bool> shouldFilterChannel;
 
     bool applyOnADC;
+    bool linearPhase;
 
     double defaultLowCut;
     double defaultHighCut;
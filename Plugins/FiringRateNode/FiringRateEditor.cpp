@@ -0,0 +1,170 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FiringRateEditor.h"
+#include "FiringRateNode.h"
+
+
+static const int outputRates[] = { 10, 20, 50, 100, 200, 500, 1000 };
+
+
+FiringRateEditor::FiringRateEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
+    : GenericEditor(parentNode, useDefaultParameterEditors)
+
+{
+    desiredWidth = 180;
+
+    FiringRateNode* processor = (FiringRateNode*) getProcessor();
+
+    estimatorLabel = createLabel("estimator label", "Estimator:", 25);
+
+    estimatorSelector = new ComboBox("estimator");
+    estimatorSelector->setBounds(80,25,90,20);
+    estimatorSelector->addItem("Exponential", FiringRateNode::EXPONENTIAL + 1);
+    estimatorSelector->addItem("Boxcar", FiringRateNode::BOXCAR + 1);
+    estimatorSelector->setSelectedId(processor->getEstimator() + 1, dontSendNotification);
+    estimatorSelector->addListener(this);
+    addAndMakeVisible(estimatorSelector);
+
+    timeConstantLabel = createLabel("time constant label", "Tau (ms):", 50);
+    timeConstantValue = createValueLabel("time constant", String(processor->getTimeConstantMs()), 50);
+    timeConstantValue->setTooltip("Time constant of the exponential estimate, or length of the boxcar window");
+
+    rateLabel = createLabel("rate label", "Rate (Hz):", 75);
+
+    rateSelector = new ComboBox("rate");
+    rateSelector->setBounds(80,75,90,20);
+    for (int i = 0; i < numElementsInArray(outputRates); i++)
+        rateSelector->addItem(String(outputRates[i]), outputRates[i]);
+    rateSelector->setSelectedId(roundFloatToInt(processor->getTargetSampleRate()), dontSendNotification);
+    rateSelector->addListener(this);
+    rateSelector->setTooltip("The first input is decimated by the integer factor that brings it closest to this rate");
+    addAndMakeVisible(rateSelector);
+
+    unitsLabel = createLabel("units label", "Units:", 100);
+    unitsValue = createValueLabel("units", String(processor->getNumUnits()), 100);
+    unitsValue->setTooltip("Sorted units with a rate channel of their own, assigned as they first fire");
+
+}
+
+FiringRateEditor::~FiringRateEditor()
+{
+
+}
+
+Label* FiringRateEditor::createLabel(const String& name, const String& text, int y)
+{
+    Label* label = new Label(name, text);
+    label->setBounds(10,y,70,20);
+    label->setFont(Font("Small Text", 12, Font::plain));
+    label->setColour(Label::textColourId, Colours::darkgrey);
+
+    addAndMakeVisible(label);
+    return label;
+}
+
+Label* FiringRateEditor::createValueLabel(const String& name, const String& text, int y)
+{
+    Label* label = new Label(name, text);
+    label->setEditable(true);
+    label->setBounds(80,y,90,20);
+    label->setColour(Label::textColourId, Colours::white);
+    label->setColour(Label::backgroundColourId, Colours::grey);
+    label->addListener(this);
+
+    addAndMakeVisible(label);
+    return label;
+}
+
+void FiringRateEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == estimatorSelector)
+    {
+        getProcessor()->setParameter(0, float(estimatorSelector->getSelectedId() - 1));
+    }
+    else if (comboBox == rateSelector)
+    {
+        getProcessor()->setParameter(2, float(rateSelector->getSelectedId()));
+        CoreServices::updateSignalChain(this);
+    }
+}
+
+void FiringRateEditor::labelTextChanged(Label* label)
+{
+    FiringRateNode* processor = (FiringRateNode*) getProcessor();
+
+    if (label == timeConstantValue)
+    {
+        processor->setParameter(1, label->getText().getFloatValue());
+        label->setText(String(processor->getTimeConstantMs()), dontSendNotification);
+    }
+    else if (label == unitsValue)
+    {
+        processor->setParameter(3, float(label->getText().getIntValue()));
+        label->setText(String(processor->getNumUnits()), dontSendNotification);
+        CoreServices::updateSignalChain(this);
+    }
+}
+
+void FiringRateEditor::startAcquisition()
+{
+    estimatorSelector->setEnabled(false);
+    timeConstantValue->setEditable(false);
+    rateSelector->setEnabled(false);
+    unitsValue->setEditable(false);
+}
+
+void FiringRateEditor::stopAcquisition()
+{
+    estimatorSelector->setEnabled(true);
+    timeConstantValue->setEditable(true);
+    rateSelector->setEnabled(true);
+    unitsValue->setEditable(true);
+}
+
+void FiringRateEditor::saveCustomParameters(XmlElement* xml)
+{
+
+    xml->setAttribute("Type", "FiringRateEditor");
+
+    XmlElement* values = xml->createNewChildElement("VALUES");
+    values->setAttribute("Estimator", estimatorSelector->getSelectedId());
+    values->setAttribute("TimeConstant", timeConstantValue->getText());
+    values->setAttribute("Rate", rateSelector->getSelectedId());
+    values->setAttribute("Units", unitsValue->getText());
+}
+
+void FiringRateEditor::loadCustomParameters(XmlElement* xml)
+{
+
+    forEachXmlChildElement(*xml, xmlNode)
+    {
+        if (xmlNode->hasTagName("VALUES"))
+        {
+            estimatorSelector->setSelectedId(xmlNode->getIntAttribute("Estimator", estimatorSelector->getSelectedId()), sendNotificationSync);
+            timeConstantValue->setText(xmlNode->getStringAttribute("TimeConstant", timeConstantValue->getText()), sendNotificationSync);
+            rateSelector->setSelectedId(xmlNode->getIntAttribute("Rate", rateSelector->getSelectedId()), sendNotificationSync);
+            unitsValue->setText(xmlNode->getStringAttribute("Units", unitsValue->getText()), sendNotificationSync);
+        }
+    }
+
+}
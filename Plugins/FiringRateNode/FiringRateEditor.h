@@ -0,0 +1,75 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __FIRINGRATEEDITOR_H__
+#define __FIRINGRATEEDITOR_H__
+
+
+#include <EditorHeaders.h>
+
+/**
+
+  User interface for the FiringRateNode processor.
+
+  @see FiringRateNode
+
+*/
+
+class FiringRateEditor : public GenericEditor,
+    public ComboBox::Listener,
+    public Label::Listener
+{
+public:
+    FiringRateEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
+    virtual ~FiringRateEditor();
+
+    void comboBoxChanged(ComboBox* comboBox);
+
+    void labelTextChanged(Label* label);
+
+    void saveCustomParameters(XmlElement* xml);
+    void loadCustomParameters(XmlElement* xml);
+
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+private:
+
+    Label* createLabel(const String& name, const String& text, int y);
+    Label* createValueLabel(const String& name, const String& text, int y);
+
+    ScopedPointer<Label> estimatorLabel;
+    ScopedPointer<ComboBox> estimatorSelector;
+    ScopedPointer<Label> timeConstantLabel;
+    ScopedPointer<Label> timeConstantValue;
+    ScopedPointer<Label> rateLabel;
+    ScopedPointer<ComboBox> rateSelector;
+    ScopedPointer<Label> unitsLabel;
+    ScopedPointer<Label> unitsValue;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FiringRateEditor);
+
+};
+
+
+
+#endif  // __FIRINGRATEEDITOR_H__
@@ -0,0 +1,324 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FiringRateNode.h"
+#include "FiringRateEditor.h"
+
+#include <algorithm>
+
+
+FiringRateNode::FiringRateNode()
+    : GenericProcessor  ("Firing Rate")
+    , estimator         (EXPONENTIAL)
+    , timeConstantMs    (100.0f)
+    , targetSampleRate  (100.0f)
+    , numUnits          (32)
+    , hasClock          (false)
+    , clockSourceId     (0)
+    , factor            (1)
+    , outputSampleRate  (100.0f)
+    , firstRateChannel  (0)
+    , numAssignedUnits  (0)
+    , blockFirstSample  (0)
+    , windowLength      (1)
+    , historyPosition   (0)
+    , decay             (0.0f)
+    , gain              (0.0f)
+{
+    setProcessorType (PROCESSOR_TYPE_FILTER);
+}
+
+
+FiringRateNode::~FiringRateNode()
+{
+}
+
+
+AudioProcessorEditor* FiringRateNode::createEditor()
+{
+    editor = new FiringRateEditor (this, true);
+
+    return editor;
+}
+
+
+float FiringRateNode::getSampleRate (int subProcessorIdx) const
+{
+    return outputSampleRate;
+}
+
+
+FiringRateNode::Estimator FiringRateNode::getEstimator() const
+{
+    return estimator;
+}
+
+
+float FiringRateNode::getTimeConstantMs() const
+{
+    return timeConstantMs;
+}
+
+
+float FiringRateNode::getTargetSampleRate() const
+{
+    return targetSampleRate;
+}
+
+
+int FiringRateNode::getNumUnits() const
+{
+    return numUnits;
+}
+
+
+void FiringRateNode::updateSettings()
+{
+    // the input channels are passed through, and the rate channels come after them
+    firstRateChannel = dataChannelArray.size();
+    hasClock = firstRateChannel > 0;
+
+    if (hasClock)
+    {
+        const DataChannel* clock = dataChannelArray[0];
+        clockSourceId = getProcessorFullId (clock->getSourceNodeID(), clock->getSubProcessorIdx());
+        factor = jmax (1, roundToInt (clock->getSampleRate() / targetSampleRate));
+        outputSampleRate = clock->getSampleRate() / factor;
+    }
+    else
+    {
+        clockSourceId = 0;
+        factor = 1;
+        outputSampleRate = targetSampleRate;
+    }
+
+    for (int i = 0; i <= numUnits; ++i)
+    {
+        DataChannel* channel = new DataChannel (DataChannel::ADC_CHANNEL, outputSampleRate, this, 0);
+        channel->setName (i < numUnits ? "FR" + String (i + 1) : "POP");
+        channel->setBitVolts (1.0f);
+        channel->setDataUnits ("Hz");
+        dataChannelArray.add (channel);
+    }
+
+    settings.numOutputs = dataChannelArray.size();
+
+    unitSlots.clear();
+    unitSlots.resize (getTotalSpikeChannels());
+}
+
+
+bool FiringRateNode::enable()
+{
+    const int numSlots = numUnits + 1;
+    const float timeConstant = jmax (timeConstantMs, 1.0f) / 1000.0f;
+
+    decay = std::exp (-1.0f / (outputSampleRate * timeConstant));
+    rates.calloc ((size_t) numSlots);
+
+    // a whole output sample at least, so the boxcar window is never empty
+    windowLength = jmax (1, roundToInt (timeConstant * outputSampleRate));
+    windowCounts.calloc ((size_t) numSlots);
+    history.calloc ((size_t) numSlots * windowLength);
+    historyPosition = 0;
+
+    // each spike adds as much as keeps a steady train at its own rate, in Hz
+    gain = estimator == EXPONENTIAL ? outputSampleRate * (1.0f - decay)
+                                    : outputSampleRate / windowLength;
+
+    for (int i = 0; i < unitSlots.size(); ++i)
+    {
+        unitSlots.getReference (i).clearQuick();
+        unitSlots.getReference (i).ensureStorageAllocated (64);
+    }
+
+    numAssignedUnits = 0;
+
+    pendingSpikes.clearQuick();
+    laterSpikes.clearQuick();
+    pendingSpikes.ensureStorageAllocated (4096);
+    laterSpikes.ensureStorageAllocated (4096);
+
+    return true;
+}
+
+
+void FiringRateNode::setParameter (int parameterIndex, float newValue)
+{
+    switch (parameterIndex)
+    {
+    case 0:
+        estimator = newValue == BOXCAR ? BOXCAR : EXPONENTIAL;
+        break;
+    case 1:
+        if (newValue > 0)
+            timeConstantMs = newValue;
+        break;
+    case 2:
+        if (newValue > 0)
+            targetSampleRate = newValue;
+        break;
+    case 3:
+        numUnits = jlimit (1, FIRING_RATE_MAX_UNITS, (int) newValue);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void FiringRateNode::handleSpike (const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition)
+{
+    SpikeView spike (event, spikeInfo);
+
+    if (! spike.isValid())
+        return;
+
+    // the first output sample at or after the spike
+    const juce::int64 sample = (juce::int64 (spike.getTimestamp()) + factor - 1) / factor;
+
+    PendingSpike population;
+    population.sample = sample;
+    population.slot = numUnits;
+    pendingSpikes.add (population);
+
+    const int electrode = getSpikeChannelIndex (spike.getSourceIndex(), spike.getSourceID(), spike.getSubProcessorIdx());
+    const int sortedId = spike.getSortedID();
+
+    if (sortedId == 0 || ! isPositiveAndBelow (electrode, unitSlots.size()))
+        return;
+
+    Array<int>& slots = unitSlots.getReference (electrode);
+
+    if (sortedId >= slots.size())
+        slots.insertMultiple (-1, -1, sortedId + 1 - slots.size());
+
+    int slot = slots.getUnchecked (sortedId);
+
+    if (slot < 0)
+    {
+        // out of rate channels, the unit only counts for the population
+        if (numAssignedUnits == numUnits)
+            return;
+
+        slot = numAssignedUnits++;
+        slots.setUnchecked (sortedId, slot);
+    }
+
+    PendingSpike unit;
+    unit.sample = sample;
+    unit.slot = slot;
+    pendingSpikes.add (unit);
+}
+
+
+void FiringRateNode::process (AudioSampleBuffer& buffer)
+{
+    int numOutputs = 0;
+
+    if (hasClock)
+    {
+        // keep the samples whose source timestamps are multiples of the factor
+        const juce::int64 timestamp = getSourceTimestamp (clockSourceId);
+        const juce::int64 numSamples = getNumSourceSamples (clockSourceId);
+
+        blockFirstSample = (timestamp + factor - 1) / factor;
+        numOutputs = int ((timestamp + numSamples + factor - 1) / factor - blockFirstSample);
+    }
+
+    checkForEvents (true);
+
+    if (! hasClock)
+    {
+        pendingSpikes.clearQuick();
+        return;
+    }
+
+    // walk the rates one unit at a time, so each unit's state and channel are read and written in a row
+    std::sort (pendingSpikes.begin(), pendingSpikes.end(),
+               [] (const PendingSpike& a, const PendingSpike& b)
+               {
+                   return a.slot != b.slot ? a.slot < b.slot : a.sample < b.sample;
+               });
+
+    const PendingSpike* spike = pendingSpikes.begin();
+    const PendingSpike* const lastSpike = pendingSpikes.end();
+    laterSpikes.clearQuick();
+
+    for (int slot = 0; slot <= numUnits; ++slot)
+    {
+        float* output = buffer.getWritePointer (firstRateChannel + slot);
+
+        if (estimator == EXPONENTIAL)
+        {
+            float rate = rates[slot];
+
+            for (int i = 0; i < numOutputs; ++i)
+            {
+                rate *= decay;
+
+                // spikes that came too late for their sample count towards the first one
+                for (; spike != lastSpike && spike->slot == slot && spike->sample <= blockFirstSample + i; ++spike)
+                    rate += gain;
+
+                output[i] = rate;
+            }
+
+            rates[slot] = rate;
+        }
+        else
+        {
+            float* counts = history + (size_t) slot * windowLength;
+            float count = windowCounts[slot];
+            int position = historyPosition;
+
+            for (int i = 0; i < numOutputs; ++i)
+            {
+                // the oldest sample leaves the window, and this one takes its place
+                count -= counts[position];
+                counts[position] = 0.0f;
+
+                for (; spike != lastSpike && spike->slot == slot && spike->sample <= blockFirstSample + i; ++spike)
+                {
+                    counts[position] += 1.0f;
+                    count += 1.0f;
+                }
+
+                output[i] = count * gain;
+
+                if (++position == windowLength)
+                    position = 0;
+            }
+
+            windowCounts[slot] = count;
+        }
+
+        // the spikes of the next blocks
+        for (; spike != lastSpike && spike->slot == slot; ++spike)
+            laterSpikes.add (*spike);
+    }
+
+    historyPosition = (historyPosition + numOutputs) % windowLength;
+    pendingSpikes.swapWith (laterSpikes);
+
+    setTimestampAndSamples (blockFirstSample, numOutputs, 0);
+}
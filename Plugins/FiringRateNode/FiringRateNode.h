@@ -0,0 +1,129 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __FIRINGRATENODE_H__
+#define __FIRINGRATENODE_H__
+
+#include <ProcessorHeaders.h>
+
+/** Most units whose rates a single node can estimate */
+#define FIRING_RATE_MAX_UNITS 4096
+
+
+/**
+    Estimates the firing rates of sorted units from their spikes, and outputs them as
+    continuous channels, in Hz, at a low sample rate.
+
+    Each sorted unit (a spike channel and sorted ID, as set by the Spike Sorter) gets one
+    of the rate channels the first time it fires during an acquisition, up to the number
+    of units; a last channel holds the population rate of all the incoming spikes, sorted
+    or not. The rates are either exponentially weighted, with a time constant, or counted
+    over a boxcar window of that length.
+
+    The output samples are those of the first input subprocessor whose timestamps are
+    multiples of the decimation factor, and spikes are taken to share its clock. Each
+    spike costs a constant time however many units there are; the rates of all units are
+    updated once per output sample, from flat per-unit arrays.
+
+    @see GenericProcessor, FiringRateEditor
+*/
+class FiringRateNode : public GenericProcessor
+{
+public:
+    enum Estimator
+    {
+        EXPONENTIAL = 0,
+        BOXCAR
+    };
+
+    FiringRateNode();
+    ~FiringRateNode();
+
+    AudioProcessorEditor* createEditor() override;
+
+    bool hasEditor() const override { return true; }
+
+    void process (AudioSampleBuffer& buffer) override;
+
+    void handleSpike (const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition) override;
+
+    void setParameter (int parameterIndex, float newValue) override;
+
+    void updateSettings() override;
+
+    bool enable() override;
+
+    float getSampleRate (int subProcessorIdx = 0) const override;
+
+    Estimator getEstimator() const;
+
+    /** Time constant of the exponential estimate, or length of the boxcar window */
+    float getTimeConstantMs() const;
+
+    float getTargetSampleRate() const;
+
+    /** Units with a rate channel of their own */
+    int getNumUnits() const;
+
+
+private:
+    /** A spike waiting for the output sample it counts towards */
+    struct PendingSpike
+    {
+        juce::int64 sample;     // in output samples
+        int slot;               // rate channel, relative to the first one
+    };
+
+    Estimator estimator;
+    float timeConstantMs;
+    float targetSampleRate;
+    int numUnits;
+
+    /** The input subprocessor whose timestamps the output follows */
+    bool hasClock;
+    uint32 clockSourceId;
+    int factor;
+    float outputSampleRate;
+    int firstRateChannel;
+
+    /** Rate channel of each sorted ID of each spike channel, -1 until the unit fires */
+    Array<Array<int>> unitSlots;
+    int numAssignedUnits;
+
+    Array<PendingSpike> pendingSpikes;
+    Array<PendingSpike> laterSpikes;
+    juce::int64 blockFirstSample;
+
+    /** Per-unit state, the population rate last */
+    HeapBlock<float> rates;         // the exponential estimates
+    HeapBlock<float> windowCounts;  // spikes within the boxcar windows
+    HeapBlock<float> history;       // spikes of each output sample of the windows, one unit after the other
+    int windowLength;
+    int historyPosition;
+
+    float decay;
+    float gain;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FiringRateNode);
+};
+
+#endif  // __FIRINGRATENODE_H__
@@ -29,4 +29,8 @@ Should be included in the source files which declare a processor class.
 #include "../../JuceLibraryCode/JuceHeader.h"
 #include "../../Source/Processors/GenericProcessor/GenericProcessor.h"
 #include "../../Source/Processors/Events/Events.h"
+#include "../../Source/Processors/GenericProcessor/OutputLatencyMonitor.h"
+#include "../../Source/Processors/GenericProcessor/OutputDispatcher.h"
+#include "../../Source/Utils/PipelineTrace.h"
+#include "../../Source/Utils/ThreadConfig.h"
 
@@ -26,3 +26,4 @@ This header provides access to the simple serial library included in the GUI cod
 */
 
 #include "../../Source/Processors/Serial/ofSerial.h"
+#include "../../Source/Processors/Serial/SerialEventLoop.h"
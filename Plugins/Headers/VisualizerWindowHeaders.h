@@ -29,3 +29,4 @@ graphic representations must be coded using standard Juce methods.
 
 #include "../../JuceLibraryCode/JuceHeader.h"
 #include "../../Source/Processors/Visualization/Visualizer.h"
+#include "../../Source/Utils/PipelineTrace.h"
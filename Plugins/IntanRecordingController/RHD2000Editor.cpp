@@ -722,6 +722,15 @@ RHD2000Editor::RHD2000Editor(GenericProcessor* parentNode,
     dacHPFcombo->setSelectedId(1, sendNotification);
     addAndMakeVisible(dacHPFcombo);
 
+    latencyButton = new UtilityButton("LOW LAT", Font("Small Text", 13, Font::plain));
+    latencyButton->setRadius(3.0f);
+	latencyButton->setBounds(6, 108, 65, 18);
+    latencyButton->addListener(this);
+    latencyButton->setClickingTogglesState(true);
+    latencyButton->setTooltip("Read each USB block as soon as it is complete, for closed-loop experiments. "
+                              "When off, reads are batched for throughput");
+    addAndMakeVisible(latencyButton);
+    latencyButton->setToggleState(true, dontSendNotification);
 }
 
 RHD2000Editor::~RHD2000Editor()
@@ -861,6 +870,10 @@ void RHD2000Editor::buttonEvent(Button* button)
     {
         board->setTTLoutputMode(dacTTLButton->getToggleState());
     }
+    else if (button == latencyButton && !acquisitionIsActive)
+    {
+        board->setLowLatencyReads(button->getToggleState());
+    }
     else if (button == dspoffsetButton && !acquisitionIsActive)
     {
         std::cout << "DSP offset " << button->getToggleState() << "\n";
@@ -900,6 +913,7 @@ void RHD2000Editor::startAcquisition()
     rescanButton->setEnabledState(false);
     adcButton->setEnabledState(false);
     dspoffsetButton-> setEnabledState(false);
+    latencyButton->setEnabledState(false);
     acquisitionIsActive = true;
 	if (canvas != nullptr)
 		canvas->channelList->disableAll();
@@ -914,6 +928,7 @@ void RHD2000Editor::stopAcquisition()
     rescanButton->setEnabledState(true);
     adcButton->setEnabledState(true);
     dspoffsetButton-> setEnabledState(true);
+    latencyButton->setEnabledState(true);
 
     acquisitionIsActive = false;
 	if (canvas != nullptr)
@@ -941,7 +956,7 @@ void RHD2000Editor::saveCustomParameters(XmlElement* xml)
     xml->setAttribute("DSPCutoffFreq", dspInterface->getDspCutoffFreq());
     xml->setAttribute("save_impedance_measurements",saveImpedances);
     xml->setAttribute("auto_measure_impedances",measureWhenRecording);
-
+    xml->setAttribute("LowLatencyReads", latencyButton->getToggleState());
 }
 
 void RHD2000Editor::loadCustomParameters(XmlElement* xml)
@@ -958,6 +973,7 @@ void RHD2000Editor::loadCustomParameters(XmlElement* xml)
     audioInterface->setNoiseSlicerLevel(xml->getIntAttribute("NoiseSlicer"));
     ttlSettleCombo->setSelectedId(xml->getIntAttribute("TTLFastSettle"));
     dacTTLButton->setToggleState(xml->getBoolAttribute("DAC_TTL"), sendNotification);
+    latencyButton->setToggleState(xml->getBoolAttribute("LowLatencyReads", true), sendNotification);
     dacHPFcombo->setSelectedId(xml->getIntAttribute("DAC_HPF"));
     dspoffsetButton->setToggleState(xml->getBoolAttribute("DSPOffset"), sendNotification);
     dspInterface->setDspCutoffFreq(xml->getDoubleAttribute("DSPCutoffFreq"));
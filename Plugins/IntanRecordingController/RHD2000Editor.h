@@ -199,6 +199,7 @@ namespace IntanRecordingController
 
 		ScopedPointer<UtilityButton> rescanButton, dacTTLButton;
 		ScopedPointer<UtilityButton> adcButton;
+		ScopedPointer<UtilityButton> latencyButton;
 
 		ScopedPointer<UtilityButton> dspoffsetButton;
 		ScopedPointer<ComboBox> ttlSettleCombo, dacHPFcombo;
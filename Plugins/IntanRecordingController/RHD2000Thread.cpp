@@ -42,10 +42,20 @@ using namespace IntanRecordingController;
 #define CHIP_ID_RHD2216  2
 #define CHIP_ID_RHD2164  4
 #define CHIP_ID_RHD2164_B  1000
+#define USB_BLOCK_WAIT_MS 5
+// Samples covered by a single USB read when low latency reads are off
+#define USB_THROUGHPUT_READ_MS 20
 #define REGISTER_59_MISO_A  53
 #define REGISTER_59_MISO_B  58
 #define RHD2132_16CH_OFFSET 8
 
+// Layout of a single sample frame in the USB data block, see Rhd2000DataBlockUsb3::fillFromUsbBuffer()
+#define USB_FRAME_AUX_OFFSET(numStreams) (12 + 2 * (numStreams)) // past the AuxCmd1 slots
+#define USB_FRAME_NEURAL_OFFSET(numStreams) (12 + 6 * (numStreams))
+#define USB_FRAME_ADC_OFFSET(numStreams) (12 + 6 * (numStreams) + 2 * CHANNELS_PER_STREAM * (numStreams) + 2 * ((numStreams) % 4))
+#define USB_FRAME_TTL_OFFSET(numStreams) (USB_FRAME_ADC_OFFSET(numStreams) + 16)
+#define USB_FRAME_BYTES(numStreams) (USB_FRAME_TTL_OFFSET(numStreams) + 4)
+
 #define INIT_STEP 256
 
 //#define SCAN_DEBUG
@@ -86,7 +96,6 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     numChannels(0),
     deviceFound(false),
     isTransmitting(false),
-    dacOutputShouldChange(false),
     acquireAdcChannels(false),
     acquireAuxChannels(true),
     fastSettleEnabled(false),
@@ -101,7 +110,8 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     savedSampleRateIndex(16),
     cableLengthPortA(0.914f), cableLengthPortB(0.914f), cableLengthPortC(0.914f), cableLengthPortD(0.914f), // default is 3 feet (0.914 m),
     audioOutputL(-1), audioOutputR(-1) ,numberingScheme(1),
-	newScan(true)
+	newScan(true),
+	lowLatencyReads(true)
 {
 	impedanceThread = new RHDImpedanceMeasure(this);
 	memset(auxBuffer, 0, sizeof(auxBuffer));
@@ -135,7 +145,6 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     dacStream = nullptr;
     dacChannels = nullptr;
     dacThresholds = nullptr;
-    dacChannelsToUpdate = nullptr;
     if (openBoard(libraryFilePath))
     {
 		dataBlock = new Rhd2000DataBlockUsb3(1);
@@ -151,10 +160,8 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
         dacStream = new int[8];
         dacChannels = new int[8];
         dacThresholds = new float[8];
-        dacChannelsToUpdate = new bool[8];
         for (int k = 0; k < 8; k++)
         {
-            dacChannelsToUpdate[k] = true;
             dacStream[k] = 0;
             setDACthreshold(k, 65534);
             dacChannels[k] = 0;
@@ -196,7 +203,6 @@ RHD2000Thread::~RHD2000Thread()
     delete[] dacStream;
     delete[] dacChannels;
     delete[] dacThresholds;
-    delete[] dacChannelsToUpdate;
 }
 
 bool RHD2000Thread::usesCustomNames() const
@@ -214,9 +220,11 @@ unsigned int RHD2000Thread::getNumSubProcessors() const
 
 void RHD2000Thread::setDACthreshold(int dacOutput, float threshold)
 {
-    dacThresholds[dacOutput]= threshold;
-    dacChannelsToUpdate[dacOutput] = true;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        dacThresholds[dacOutput] = threshold;
+    }
+    queueBoardCommands(CMD_DAC_OUTPUT << dacOutput);
 
     //  evalBoard->setDacThresholdVoltage(dacOutput,threshold);
 }
@@ -230,6 +238,7 @@ void RHD2000Thread::setDACchannel(int dacOutput, int channel)
         {
             if (channel < channelCount + numChannelsPerDataStream[i])
             {
+                const SpinLock::ScopedLockType lock(boardCommandLock);
                 dacChannels[dacOutput] = channel - channelCount;
                 dacStream[dacOutput] = i;
                 break;
@@ -239,8 +248,7 @@ void RHD2000Thread::setDACchannel(int dacOutput, int channel)
                 channelCount += numChannelsPerDataStream[i];
             }
         }
-        dacChannelsToUpdate[dacOutput] = true;
-        dacOutputShouldChange = true;
+        queueBoardCommands(CMD_DAC_OUTPUT << dacOutput);
     }
 }
 
@@ -385,7 +393,7 @@ void RHD2000Thread::initializeBoard()
     }
 
 	//Instantiate usb thread
-	usbThread = new USBThread(evalBoard);
+	usbThread = new USBThread(evalBoard, this);
 
     // Initialize the board
     std::cout << "Initializing acquisition board." << std::endl;
@@ -439,9 +447,7 @@ void RHD2000Thread::initializeBoard()
 
     // Read the resulting single data block from the USB interface. We don't
     // need to do anything with this, since it was only used for ADC calibration
-    ScopedPointer<Rhd2000DataBlockUsb3> dataBlock = new Rhd2000DataBlockUsb3(evalBoard->getNumEnabledDataStreams());
-
-	evalBoard->readDataBlock(dataBlock, INIT_STEP);
+	evalBoard->readDataBlock(getDataBlock(), INIT_STEP);
     // Now that ADC calibration has been performed, we switch to the command sequence
     // that does not execute ADC calibration.
 	evalBoard->selectAuxCommandBank(Rhd2000EvalBoardUsb3::PortA, Rhd2000EvalBoardUsb3::AuxCmd3,
@@ -544,8 +550,7 @@ void RHD2000Thread::scanPorts()
 	evalBoard->setMaxTimeStep(INIT_STEP);
 	evalBoard->setContinuousRunMode(false);
 
-	ScopedPointer<Rhd2000DataBlockUsb3> dataBlock =
-		new Rhd2000DataBlockUsb3(evalBoard->getNumEnabledDataStreams());
+	Rhd2000DataBlockUsb3* dataBlock = getDataBlock();
 
 	Array<int> sumGoodDelays;
 	sumGoodDelays.insertMultiple(0, 0, MAX_NUM_HEADSTAGES);
@@ -584,7 +589,7 @@ void RHD2000Thread::scanPorts()
 			;
 		}
 		// Read the resulting single data block from the USB interface.
-		evalBoard->readDataBlock(dataBlock.get(), INIT_STEP);
+		evalBoard->readDataBlock(dataBlock, INIT_STEP);
 		
 		// Read the Intan chip ID number from each RHD2000 chip found.
 		// Record delay settings that yield good communication with the chip.
@@ -736,6 +741,14 @@ void RHD2000Thread::scanPorts()
     newScan = true;
 }
 
+Rhd2000DataBlockUsb3* RHD2000Thread::getDataBlock()
+{
+	if (dataBlock == nullptr || dataBlock->getNumDataStreams() != evalBoard->getNumEnabledDataStreams())
+		dataBlock = new Rhd2000DataBlockUsb3(evalBoard->getNumEnabledDataStreams());
+
+	return dataBlock;
+}
+
 int RHD2000Thread::deviceId(Rhd2000DataBlockUsb3* dataBlock, int stream, int& register59Value)
 {
     bool intanChipPresent;
@@ -783,6 +796,7 @@ void RHD2000Thread::setNumChannels(int hsNum, int numChannels)
         else
             headstagesArray[hsNum]->setHalfChannels(false);
         numChannelsPerDataStream.set(headstagesArray[hsNum]->getStreamIndex(0), numChannels);
+        updateDecodeTables();
     }
 }
 
@@ -1000,6 +1014,12 @@ float RHD2000Thread::getSampleRate(int subproc) const
     return evalBoard->getSampleRate();
 }
 
+void RHD2000Thread::resizeBuffers()
+{
+    // the buffer holds a fixed time of data, so it follows the sample rate too
+    resizeSourceBuffer(0, getNumChannels());
+}
+
 float RHD2000Thread::getBitVolts (const DataChannel* ch) const
 {
     if (ch->getChannelType() == DataChannel::ADC_CHANNEL)
@@ -1063,28 +1083,40 @@ void RHD2000Thread::setDSPOffset(bool state)
 
 void RHD2000Thread::setTTLoutputMode(bool state)
 {
-    ttlMode = state;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        ttlMode = state;
+    }
+    queueBoardCommands(CMD_TTL_MODE);
 }
 
 void RHD2000Thread::setDAChpf(float cutoff, bool enabled)
 {
-    dacOutputShouldChange = true;
-    desiredDAChpf = cutoff;
-    desiredDAChpfState = enabled;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        desiredDAChpf = cutoff;
+        desiredDAChpfState = enabled;
+    }
+    queueBoardCommands(CMD_DAC_HPF);
 }
 
 void RHD2000Thread::setFastTTLSettle(bool state, int channel)
 {
-    fastTTLSettleEnabled = state;
-    fastSettleTTLChannel = channel;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        fastTTLSettleEnabled = state;
+        fastSettleTTLChannel = channel;
+    }
+    queueBoardCommands(CMD_FAST_SETTLE);
 }
 
 int RHD2000Thread::setNoiseSlicerLevel(int level)
 {
-    desiredNoiseSlicerLevel = level;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        desiredNoiseSlicerLevel = level;
+    }
+    queueBoardCommands(CMD_NOISE_SLICER);
 
     // Level has been checked once before this and then is checked again in setAudioNoiseSuppress.
     // This may be overkill - maybe API should change so that the final function returns the value?
@@ -1142,7 +1174,7 @@ bool RHD2000Thread::enableHeadstage(int hsNum, bool enabled, int nStr, int strCh
         std::cout << numChannelsPerDataStream[i] << " ";
     }*/
 
-    sourceBuffers[0]->resize(getNumChannels(), 10000);
+    resizeSourceBuffer(0, getNumChannels());
 
     return true;
 }
@@ -1160,6 +1192,38 @@ void RHD2000Thread::updateBoardStreams()
             evalBoard->enableDataStream(i,false);
         }
     }
+
+    updateDecodeTables();
+}
+
+void RHD2000Thread::updateDecodeTables()
+{
+    int numStreams = enabledStreams.size();
+
+    // channel chan of a stream is neural word (chan * numStreams + dataStream) of each frame
+    neuralWordOffsets.clearQuick();
+    for (int dataStream = 0; dataStream < numStreams; dataStream++)
+    {
+        int nChans = numChannelsPerDataStream[dataStream];
+        int chanOffset = 0;
+        if ((chipId[dataStream] == CHIP_ID_RHD2132) && (nChans == 16)) //RHD2132 16ch. headstage
+        {
+            chanOffset = RHD2132_16CH_OFFSET;
+        }
+        for (int chan = 0; chan < nChans; chan++)
+            neuralWordOffsets.add(USB_FRAME_NEURAL_OFFSET(numStreams) + 2 * ((chan + chanOffset) * numStreams + dataStream));
+    }
+
+    // the second stream of an RHD2164 has no aux inputs of its own
+    auxStreams.clearQuick();
+    if (acquireAuxChannels)
+    {
+        for (int dataStream = 0; dataStream < numStreams; dataStream++)
+            if (chipId[dataStream] != CHIP_ID_RHD2164_B)
+                auxStreams.add(dataStream);
+    }
+
+    numDecodedAdcs = acquireAdcChannels ? 8 : 0;
 }
 
 bool RHD2000Thread::isHeadstageEnabled(int hsNum) const
@@ -1204,11 +1268,22 @@ int RHD2000Thread::getChannelsInHeadstage (int hsNum) const
 
 }*/
 
+void RHD2000Thread::setLowLatencyReads(bool enable)
+{
+	lowLatencyReads = enable;
+}
+
+bool RHD2000Thread::getLowLatencyReads() const
+{
+	return lowLatencyReads;
+}
+
 void RHD2000Thread::enableAdcs(bool t)
 {
     acquireAdcChannels = t;
+    updateDecodeTables();
 
-    sourceBuffers[0]->resize (getNumChannels(), 10000);
+    resizeSourceBuffer(0, getNumChannels());
 
 	sn->update();
 }
@@ -1443,7 +1518,7 @@ void RHD2000Thread::updateRegisters()
 bool RHD2000Thread::startAcquisition()
 {
 	impedanceThread->waitSafely();
-    dataBlock = new Rhd2000DataBlockUsb3(evalBoard->getNumEnabledDataStreams());
+	getDataBlock();
 
     std::cout << "Expecting " << getNumChannels() << " channels." << std::endl;
 
@@ -1470,8 +1545,12 @@ bool RHD2000Thread::startAcquisition()
 	evalBoard->flush();
 	std::cout << "FIFO count " << evalBoard->getNumWordsInFifo() << std::endl;
 
-	std::cout << "Starting usb thread with buffer of " << blockSize * 2 << " bytes" << std::endl;
-	usbThread->startAcquisition(blockSize * 2);
+	int blocksPerRead = 1;
+	if (!lowLatencyReads)
+		blocksPerRead = jmax(1, roundToInt(boardSampleRate * USB_THROUGHPUT_READ_MS / 1000.0 / SAMPLES_PER_DATA_BLOCK));
+
+	std::cout << "Starting usb thread with blocks of " << blockSize * 2 << " bytes, " << blocksPerRead << " per read" << std::endl;
+	usbThread->startAcquisition(blockSize * 2, blocksPerRead);
 
 	std::cout << "Starting acquisition." << std::endl;
 	evalBoard->setContinuousRunMode(true);
@@ -1498,6 +1577,14 @@ bool RHD2000Thread::stopAcquisition()
     std::cout << "RHD2000 data thread stopping acquisition." << std::endl;
 	usbThread->stopAcquisition();
 
+	if (CoreServices::getLatencyBenchmark())
+	{
+		USBThreadMetrics metrics = usbThread->getMetrics();
+		std::cout << "RHD2000 USB reads (" << (lowLatencyReads ? "low latency" : "throughput") << "): "
+			<< metrics.reads << " reads of " << (metrics.reads > 0 ? double(metrics.blocksRead) / metrics.reads : 0.0)
+			<< " blocks on average, max decode lag " << metrics.maxDecodeLagMs << " ms" << std::endl;
+	}
+
     if (isThreadRunning())
     {
         signalThreadShouldExit();
@@ -1538,150 +1625,181 @@ bool RHD2000Thread::stopAcquisition()
     }
 
     isTransmitting = false;
-	dacOutputShouldChange = false;
 
     return true;
 }
 
-bool RHD2000Thread::updateBuffer()
+void RHD2000Thread::decodeUsbBlock(unsigned char* bufferPtr, long return_code)
 {
-	//int chOffset;
-    //cout << "Number of 16-bit words in FIFO: " << evalBoard->numWordsInFifo() << endl;
-	//cout << "Block size: " << blockSize << endl;
-	unsigned char* bufferPtr;
-	//std::cout << "Current number of words: " <<  evalBoard->numWordsInFifo() << " for " << blockSize << std::endl;
-	long return_code;
+	int numStreams = enabledStreams.size();
+	int frameBytes = USB_FRAME_BYTES(numStreams);
+	int nSamps = int(return_code / (2 * Rhd2000DataBlockUsb3::calculateDataBlockSizeInWords(numStreams, 1)));
 
-	return_code = usbThread->usbRead(bufferPtr);
-	if (return_code == 0)
-		return true;
+	int bufferChannels = sourceBuffers[0]->getNumChannels();
 
-	int index = 0;
-	int auxIndex, chanIndex;
-	int numStreams = enabledStreams.size();
-	int nSamps = Rhd2000DataBlockUsb3::getSamplesPerDataBlock();
+	if (nSamps > blockCapacity)
+	{
+		blockSamples.malloc(nSamps * MAX_NUM_CHANNELS);
+		blockTimestamps.malloc(nSamps);
+		blockEventWords.malloc(nSamps);
+		blockCapacity = nSamps;
+	}
+
+	// the channels each frame is gathered into, as laid out by updateDecodeTables()
+	const int* neuralOffsets = neuralWordOffsets.getRawDataPointer();
+	int numNeural = jmin(neuralWordOffsets.size(), bufferChannels);
+	int numAux = jmin(3 * auxStreams.size(), bufferChannels - numNeural);
+	int numAdcs = jmin(numDecodedAdcs, bufferChannels - numNeural - numAux);
 
 	//evalBoard->printFIFOmetrics();
-	for (int samp = 0; samp < nSamps; samp++)
+	int samp;
+	for (samp = 0; samp < nSamps; samp++)
 	{
-		int channel = -1;
+		unsigned char* frame = bufferPtr + samp * frameBytes;
+		float* thisSample = blockSamples + samp * bufferChannels;
 
-		if (!Rhd2000DataBlockUsb3::checkUsbHeader(bufferPtr, index))
+		if (!Rhd2000DataBlockUsb3::checkUsbHeader(frame, 0))
 		{
 			cerr << "Error in Rhd2000EvalBoard::readDataBlock: Incorrect header." << endl;
 			cerr << "Read code: " << return_code << endl;
 			break;
 		}
 
-		index += 8;
-		timestamps.set(0, Rhd2000DataBlockUsb3::convertUsbTimeStamp(bufferPtr, index));
-		index += 4;
-		auxIndex = index;
-		//skip the aux channels
-		index += numStreams * 6;
+		blockTimestamps[samp] = Rhd2000DataBlockUsb3::convertUsbTimeStamp(frame, 8);
+
 		// do the neural data channels first
-		for (int dataStream = 0; dataStream < numStreams; dataStream++)
+		for (int channel = 0; channel < numNeural; channel++)
+			thisSample[channel] = float(*(uint16*)(frame + neuralOffsets[channel]) - 32768)*0.195f;
+
+		//now we can do the aux channels
+		int auxNum = (samp + 3) % 4;
+		float* auxChannels = thisSample + numNeural;
+		float* latched = auxBuffer + numNeural;
+		for (int k = 0; 3 * k < numAux; k++)
 		{
-			int nChans = numChannelsPerDataStream[dataStream];
-			chanIndex = index + 2 * dataStream;
-			if ((chipId[dataStream] == CHIP_ID_RHD2132) && (nChans == 16)) //RHD2132 16ch. headstage
-			{
-				chanIndex += 2 * RHD2132_16CH_OFFSET*numStreams;
-			}
-			for (int chan = 0; chan < nChans; chan++)
+			int dataStream = auxStreams.getUnchecked(k);
+			if (auxNum < 3)
 			{
-				channel++;
-				thisSample[channel] = float(*(uint16*)(bufferPtr + chanIndex) - 32768)*0.195f;
-				chanIndex += 2 * numStreams;
+				auxSamples[dataStream][auxNum] = float(*(uint16*)(frame + USB_FRAME_AUX_OFFSET(numStreams) + 2 * dataStream) - 32768)*0.0000374;
 			}
-		}
-		index += 2 * CHANNELS_PER_STREAM * numStreams;
-		//now we can do the aux channels
-		auxIndex += 2 * numStreams;
-		for (int dataStream = 0; dataStream < numStreams; dataStream++)
-		{
-			if (chipId[dataStream] != CHIP_ID_RHD2164_B)
+			for (int chan = 0; chan < 3 && 3 * k + chan < numAux; chan++)
 			{
-				int auxNum = (samp + 3) % 4;
-				if (auxNum < 3)
+				if (auxNum == 3)
 				{
-					auxSamples[dataStream][auxNum] = float(*(uint16*)(bufferPtr + auxIndex) - 32768)*0.0000374;
-				}
-				for (int chan = 0; chan < 3; chan++)
-				{
-					channel++;
-					if (auxNum == 3)
-					{
-						auxBuffer[channel] = auxSamples[dataStream][chan];
-					}
-					thisSample[channel] = auxBuffer[channel];
+					latched[3 * k + chan] = auxSamples[dataStream][chan];
 				}
+				auxChannels[3 * k + chan] = latched[3 * k + chan];
 			}
-			auxIndex += 2;
-
 		}
 
-		//skip filler words
-		index += 2 * (numStreams % 4);
-		if (acquireAdcChannels)
-		{
-			for (int adcChan = 0; adcChan < 8; ++adcChan)
-			{
-
-				channel++;
-				// ADC waveform units = volts
-				thisSample[channel] =
-					//0.000050354 * float(dataBlock->boardAdcData[adcChan][samp]);
-					0.00015258789 * float(*(uint16*)(bufferPtr + index)) - 5 - 0.4096; // account for +/-5V input range and DC offset
-				index += 2;
-			}
-		}
-		else
+		float* adcChannels = auxChannels + numAux;
+		const unsigned char* adc = frame + USB_FRAME_ADC_OFFSET(numStreams);
+		for (int adcChan = 0; adcChan < numAdcs; ++adcChan)
 		{
-			index += 16;
+			// ADC waveform units = volts
+			adcChannels[adcChan] =
+				0.00015258789 * float(*(uint16*)(adc + 2 * adcChan)) - 5 - 0.4096; // account for +/-5V input range and DC offset
 		}
-		ttlEventWords.set(0, *(uint16*)(bufferPtr + index));
-		index += 4;
-		sourceBuffers[0]->addToBuffer(thisSample, &timestamps.getReference(0), &ttlEventWords.getReference(0), 1);
+
+		blockEventWords[samp] = *(uint16*)(frame + USB_FRAME_TTL_OFFSET(numStreams));
 	}
 
+	if (samp > 0)
+		sourceBuffers[0]->addBlock(blockSamples, blockTimestamps, blockEventWords, samp);
+}
 
+bool RHD2000Thread::updateBuffer()
+{
+	//int chOffset;
+    //cout << "Number of 16-bit words in FIFO: " << evalBoard->numWordsInFifo() << endl;
+	//cout << "Block size: " << blockSize << endl;
+	unsigned char* bufferPtr;
+	//std::cout << "Current number of words: " <<  evalBoard->numWordsInFifo() << " for " << blockSize << std::endl;
 
+	if (!usbThread->waitForBlock(USB_BLOCK_WAIT_MS))
+		return true;
 
-	if (dacOutputShouldChange)
+	// decode the blocks in the USB ring in place, releasing each slot once it is in the DataBuffer
+	long return_code;
+	while ((return_code = usbThread->peekBlock(bufferPtr)) > 0)
 	{
-        for (int k=0; k<8; k++)
+		decodeUsbBlock(bufferPtr, return_code);
+		usbThread->releaseBlock();
+	}
+
+    return true;
+
+}
+
+void RHD2000Thread::queueBoardCommands(uint32 commands)
+{
+    pendingBoardCommands.fetch_or(commands, std::memory_order_release);
+}
+
+void RHD2000Thread::applyBoardCommands()
+{
+    if (pendingBoardCommands.load(std::memory_order_relaxed) == 0)
+        return;
+
+    uint32 commands = pendingBoardCommands.exchange(0, std::memory_order_acquire);
+
+    // take the latest values, so that the setters never wait for the USB writes
+    int streams[8], channels[8];
+    float thresholds[8];
+    bool ttl, fastSettle, hpfEnabled;
+    int fastSettleChannel, noiseSlicerLevel;
+    double hpf;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        for (int k = 0; k < 8; k++)
         {
-            if (dacChannelsToUpdate[k])
-            {
-                dacChannelsToUpdate[k] = false;
-                if (dacChannels[k] >= 0)
-                {
-                    evalBoard->enableDac(k, true);
-                    evalBoard->selectDacDataStream(k, dacStream[k]);
-                    evalBoard->selectDacDataChannel(k, dacChannels[k]);
-                    evalBoard->setDacThreshold(k, (int)abs((dacThresholds[k]/0.195) + 32768),dacThresholds[k] >= 0);
-                   // evalBoard->setDacThresholdVoltage(k, (int) dacThresholds[k]);
-                }
-                else
-                {
-                    evalBoard->enableDac(k, false);
-                }
-            }
+            streams[k] = dacStream[k];
+            channels[k] = dacChannels[k];
+            thresholds[k] = dacThresholds[k];
+        }
+        ttl = ttlMode;
+        fastSettle = fastTTLSettleEnabled;
+        fastSettleChannel = fastSettleTTLChannel;
+        hpf = desiredDAChpf;
+        hpfEnabled = desiredDAChpfState;
+        noiseSlicerLevel = desiredNoiseSlicerLevel;
+    }
+
+    for (int k = 0; k < 8; k++)
+    {
+        if (!(commands & (CMD_DAC_OUTPUT << k)))
+            continue;
+
+        if (channels[k] >= 0)
+        {
+            evalBoard->enableDac(k, true);
+            evalBoard->selectDacDataStream(k, streams[k]);
+            evalBoard->selectDacDataChannel(k, channels[k]);
+            evalBoard->setDacThreshold(k, (int)abs((thresholds[k]/0.195) + 32768), thresholds[k] >= 0);
+        }
+        else
+        {
+            evalBoard->enableDac(k, false);
         }
+    }
 
-        evalBoard->setTtlMode(ttlMode ? 1 : 0);
-        evalBoard->enableExternalFastSettle(fastTTLSettleEnabled);
-        evalBoard->setExternalFastSettleChannel(fastSettleTTLChannel);
-        evalBoard->setDacHighpassFilter(desiredDAChpf);
-        evalBoard->enableDacHighpassFilter(desiredDAChpfState);
-        evalBoard->setAudioNoiseSuppress(desiredNoiseSlicerLevel);
+    if (commands & CMD_TTL_MODE)
+        evalBoard->setTtlMode(ttl ? 1 : 0);
 
-        dacOutputShouldChange = false;
+    if (commands & CMD_FAST_SETTLE)
+    {
+        evalBoard->enableExternalFastSettle(fastSettle);
+        evalBoard->setExternalFastSettleChannel(fastSettleChannel);
+    }
+
+    if (commands & CMD_DAC_HPF)
+    {
+        evalBoard->setDacHighpassFilter(hpf);
+        evalBoard->enableDacHighpassFilter(hpfEnabled);
     }
-	
-    return true;
 
+    if (commands & CMD_NOISE_SLICER)
+        evalBoard->setAudioNoiseSuppress(noiseSlicerLevel);
 }
 
 int RHD2000Thread::getChannelFromHeadstage (int hs, int ch) const
@@ -1935,53 +2053,26 @@ float RHDImpedanceMeasure::updateImpedanceFrequency(float desiredImpedanceFreq,
 }
 
 
-// Reads numBlocks blocks of raw USB data stored in a queue of Rhd2000DataBlock
-// objects, loads this data into this SignalProcessor object, scaling the raw
-// data to generate waveforms with units of volts or microvolts.
-int RHDImpedanceMeasure::loadAmplifierData(queue<Rhd2000DataBlockUsb3>& dataQueue,
-	int numBlocks, int numDataStreams)
+// Reads numBlocks blocks of raw USB data decoded into the data block pool, and
+// scales the samples of one amplifier channel of every stream to microvolts.
+// Only the channel under test carries the impedance signal.
+int RHDImpedanceMeasure::loadAmplifierData(int numBlocks, int numDataStreams, int channel)
 {
-
-	int block, t, channel, stream;
 	int indexAmp = 0;
-    /*
-	int indexAux = 0;
-	int indexSupply = 0;
-	int indexAdc = 0;
-	int indexDig = 0;
-	int numWordsWritten = 0;
-
-	int bufferIndex;
-	int16 tempQint16;
-	uint16 tempQuint16;
-	int32 tempQint32;
 
-	bool triggerFound = false;
-	const double AnalogTriggerThreshold = 1.65;
-     */
-
-
-	for (block = 0; block < numBlocks; ++block)
+	for (int block = 0; block < numBlocks; ++block)
 	{
+		const Rhd2000DataBlockUsb3& dataBlock = *dataBlocks[block];
 
-		// Load and scale RHD2000 amplifier waveforms
-		// (sampled at amplifier sampling rate)
-		for (t = 0; t < SAMPLES_PER_DATA_BLOCK; ++t)
+		for (int stream = 0; stream < numDataStreams; ++stream)
 		{
-			for (channel = 0; channel < 32; ++channel)
-			{
-				for (stream = 0; stream < numDataStreams; ++stream)
-				{
-					const Rhd2000DataBlockUsb3& block = dataQueue.front();
-					// Amplifier waveform units = microvolts
-					amplifierPreFilter[stream][channel][indexAmp] = 0.195 *
-						(block.amplifierDataFast[block.fastIndex(stream,channel,t)] - 32768);
-				}
-			}
-			++indexAmp;
+			double* dest = amplifierPreFilter[stream][channel].data() + indexAmp;
+
+			// Amplifier waveform units = microvolts
+			for (int t = 0; t < SAMPLES_PER_DATA_BLOCK; ++t)
+				dest[t] = 0.195 * (dataBlock.amplifierDataFast[dataBlock.fastIndex(stream, channel, t)] - 32768);
 		}
-		// We are done with this Rhd2000DataBlock object; remove it from dataQueue
-		dataQueue.pop();
+		indexAmp += SAMPLES_PER_DATA_BLOCK;
 	}
 
 	return 0;
@@ -1992,12 +2083,9 @@ int RHDImpedanceMeasure::loadAmplifierData(queue<Rhd2000DataBlockUsb3>& dataQueu
 #define DEGREES_TO_RADIANS  0.0174532925199
 #define RADIANS_TO_DEGREES  57.2957795132
 
-// Return the magnitude and phase (in degrees) of a selected frequency component (in Hz)
-// for a selected amplifier channel on the selected USB data stream.
-void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
-	std::vector<std::vector<std::vector<double>>>& measuredPhase,
-	int capIndex, int stream, int chipChannel, int numBlocks,
-	double sampleRate, double frequency, int numPeriods)
+// Chooses the samples every channel is measured over, and tabulates the sine and
+// cosine waveforms they are correlated with.
+void RHDImpedanceMeasure::prepareCorrelation(int numBlocks, double sampleRate, double frequency, int numPeriods)
 {
 	int period = (sampleRate / frequency);
 	int startIndex = 0;
@@ -2010,11 +2098,29 @@ void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::v
 		endIndex += period;
 	}
 
+	const double k = TWO_PI * frequency / sampleRate;
+
+	windowStart = startIndex;
+	correlationCos.resize(endIndex - startIndex + 1);
+	correlationSin.resize(endIndex - startIndex + 1);
+
+	for (int t = startIndex; t <= endIndex; ++t)
+	{
+		correlationCos[t - startIndex] = cos(k * t);
+		correlationSin[t - startIndex] = -1.0 * sin(k * t);
+	}
+}
+
+// Return the magnitude and phase (in degrees) of the frequency component set by
+// prepareCorrelation() for a selected amplifier channel on the selected USB data stream.
+void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
+	std::vector<std::vector<std::vector<double>>>& measuredPhase,
+	int capIndex, int stream, int chipChannel)
+{
 	double iComponent, qComponent;
 
 	// Measure real (iComponent) and imaginary (qComponent) amplitude of frequency component.
-	amplitudeOfFreqComponent(iComponent, qComponent, amplifierPreFilter[stream][chipChannel],
-		startIndex, endIndex, sampleRate, frequency);
+	amplitudeOfFreqComponent(iComponent, qComponent, amplifierPreFilter[stream][chipChannel].data() + windowStart);
 	// Calculate magnitude and phase from real (I) and imaginary (Q) components.
 	measuredMagnitude[stream][chipChannel][capIndex] =
 		sqrt(iComponent * iComponent + qComponent * qComponent);
@@ -2022,23 +2128,37 @@ void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::v
 		RADIANS_TO_DEGREES *atan2(qComponent, iComponent);
 }
 
-// Returns the real and imaginary amplitudes of a selected frequency component in the vector
-// data, between a start index and end index.
+// Returns the real and imaginary amplitudes of the tabulated frequency component in the
+// measurement window of the data.
 void RHDImpedanceMeasure::amplitudeOfFreqComponent(double& realComponent, double& imagComponent,
-	const std::vector<double>& data, int startIndex,
-	int endIndex, double sampleRate, double frequency)
+	const double* data)
 {
-	int length = endIndex - startIndex + 1;
-	const double k = TWO_PI * frequency / sampleRate;  // precalculate for speed
+	const int length = (int) correlationCos.size();
+	const double* cosTable = correlationCos.data();
+	const double* sinTable = correlationSin.data();
 
-	// Perform correlation with sine and cosine waveforms.
-	double meanI = 0.0;
-	double meanQ = 0.0;
-	for (int t = startIndex; t <= endIndex; ++t)
+	// Perform correlation with sine and cosine waveforms. Independent partial sums
+	// let the compiler keep several multiply-adds in flight.
+	double sumI[4] = { 0.0, 0.0, 0.0, 0.0 };
+	double sumQ[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+	int t = 0;
+	for (; t + 4 <= length; t += 4)
 	{
-		meanI += data.at(t) * cos(k * t);
-		meanQ += data.at(t) * -1.0 * sin(k * t);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			sumI[lane] += data[t + lane] * cosTable[t + lane];
+			sumQ[lane] += data[t + lane] * sinTable[t + lane];
+		}
+	}
+	for (; t < length; ++t)
+	{
+		sumI[0] += data[t] * cosTable[t];
+		sumQ[0] += data[t] * sinTable[t];
 	}
+
+	double meanI = (sumI[0] + sumI[1]) + (sumI[2] + sumI[3]);
+	double meanQ = (sumQ[0] + sumQ[1]) + (sumQ[2] + sumQ[3]);
 	meanI /= (double)length;
 	meanQ /= (double)length;
 
@@ -2103,12 +2223,45 @@ void RHDImpedanceMeasure::run()
 	data = nullptr;
 }
 
+// Sets the series capacitance and the channel to check, and starts the board
+void RHDImpedanceMeasure::startImpedanceRun(int capRange, int zcheckChannel)
+{
+	if (capRange != currentCapRange)
+	{
+		switch (capRange)
+		{
+		case 0:
+			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs100fF);
+			cout << "setting capacitance to 0.1pF" << endl;
+			break;
+		case 1:
+			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs1pF);
+			cout << "setting capacitance to 1pF" << endl;
+			break;
+		case 2:
+			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs10pF);
+			cout << "setting capacitance to 10pF" << endl;
+			break;
+		}
+		currentCapRange = capRange;
+	}
+
+	cout << "running impedance on channel " << zcheckChannel << endl;
+
+	vector<int> commandList;
+	board->chipRegisters.setZcheckChannel(zcheckChannel);
+	board->chipRegisters.createCommandListRegisterConfig(commandList, false);
+	// Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
+	board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoardUsb3::AuxCmd3, 3);
+
+	board->evalBoard->run();
+}
+
 #define CHECK_EXIT if (threadShouldExit()) return
 
 void RHDImpedanceMeasure::runImpedanceMeasurement()
 {
 	int commandSequenceLength, stream, channel, capRange;
-	double cSeries;
 	vector<int> commandList;
 	//int triggerIndex;                       // dummy reference variable; not used
 	queue<Rhd2000DataBlockUsb3> bufferQueue;    // dummy reference variable; not used
@@ -2201,6 +2354,7 @@ void RHDImpedanceMeasure::runImpedanceMeasurement()
 	// of all amplifier channels (32 on each data stream) at three different Cseries values.
 	std::vector<std::vector<std::vector<double>>>  measuredMagnitude;
 	std::vector<std::vector<std::vector<double>>>  measuredPhase;
+	currentCapRange = -1;
 
 	measuredMagnitude.resize(board->evalBoard->getNumEnabledDataStreams());
 	measuredPhase.resize(board->evalBoard->getNumEnabledDataStreams());
@@ -2229,90 +2383,55 @@ void RHDImpedanceMeasure::runImpedanceMeasurement()
 
 	int bestAmplitudeIndex;
 
+	prepareCorrelation(numBlocks, board->boardSampleRate, actualImpedanceFreq, numPeriods);
+
 	// We execute three complete electrode impedance measurements: one each with
 	// Cseries set to 0.1 pF, 1 pF, and 10 pF.  Then we select the best measurement
 	// for each channel so that we achieve a wide impedance measurement range.
-	for (capRange = 0; capRange < 3; ++capRange)
+	// Each run checks one channel across all active data streams; if an RHD2164 chip
+	// is plugged in, its channels 32-63 take another run.
+	struct ImpedanceRun
 	{
+		int capRange;
+		int channel;
+		bool rhd2164Channels;
+	};
 
-		switch (capRange)
-		{
-		case 0:
-			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs100fF);
-			cSeries = 0.1e-12;
-			cout << "setting capacitance to 0.1pF" << endl;
-			break;
-		case 1:
-			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs1pF);
-			cSeries = 1.0e-12;
-			cout << "setting capacitance to 1pF" << endl;
-			break;
-		case 2:
-			board->chipRegisters.setZcheckScale(Rhd2000RegistersUsb3::ZcheckCs10pF);
-			cSeries = 10.0e-12;
-			cout << "setting capacitance to 10pF" << endl;
-			break;
-		}
-
-		// Check all 32 channels across all active data streams.
+	std::vector<ImpedanceRun> runs;
+	for (capRange = 0; capRange < 3; ++capRange)
+	{
 		for (channel = 0; channel < 32; ++channel)
 		{
-			CHECK_EXIT;
-			cout << "running impedance on channel " << channel << endl;
+			runs.push_back({ capRange, channel, false });
 
-			board->chipRegisters.setZcheckChannel(channel);
-			commandSequenceLength =
-				board->chipRegisters.createCommandListRegisterConfig(commandList, false);
-			// Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
-			board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoardUsb3::AuxCmd3, 3);
+			if (rhd2164ChipPresent)
+				runs.push_back({ capRange, channel, true });
+		}
+	}
 
-			board->evalBoard->run();
-			while (board->evalBoard->isRunning())
-			{
+	// The board acquires the next run while the data of the previous one is analyzed
+	CHECK_EXIT;
+	startImpedanceRun(runs[0].capRange, runs[0].channel + (runs[0].rhd2164Channels ? 32 : 0));
 
-			}
-			queue<Rhd2000DataBlockUsb3> dataQueue;
-			board->evalBoard->readDataBlocks(numBlocks, dataQueue);
-			loadAmplifierData(dataQueue, numBlocks, numdataStreams);
-			for (stream = 0; stream < numdataStreams; ++stream)
-			{
-				if (board->chipId[stream] != CHIP_ID_RHD2164_B)
-				{
-					measureComplexAmplitude(measuredMagnitude, measuredPhase,
-						capRange, stream, channel, numBlocks, board->boardSampleRate,
-						actualImpedanceFreq, numPeriods);
-				}
-			}
+	for (size_t i = 0; i < runs.size(); ++i)
+	{
+		while (board->evalBoard->isRunning())
+		{
 
-			// If an RHD2164 chip is plugged in, we have to set the Zcheck select register to channels 32-63
-			// and repeat the previous steps.
-			if (rhd2164ChipPresent)
-			{
-				CHECK_EXIT;
-				board->chipRegisters.setZcheckChannel(channel + 32); // address channels 32-63
-				commandSequenceLength =
-					board->chipRegisters.createCommandListRegisterConfig(commandList, false);
-				// Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
-				board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoardUsb3::AuxCmd3, 3);
-
-				board->evalBoard->run();
-				while (board->evalBoard->isRunning())
-				{
+		}
+		board->evalBoard->readDataBlocks(numBlocks, dataBlocks);
 
-				}
-				board->evalBoard->readDataBlocks(numBlocks, dataQueue);
-				loadAmplifierData(dataQueue, numBlocks, numdataStreams);
+		CHECK_EXIT;
+		if (i + 1 < runs.size())
+			startImpedanceRun(runs[i + 1].capRange, runs[i + 1].channel + (runs[i + 1].rhd2164Channels ? 32 : 0));
 
-				for (stream = 0; stream < board->evalBoard->getNumEnabledDataStreams(); ++stream)
-				{
-					if (board->chipId[stream] == CHIP_ID_RHD2164_B)
-					{
-						measureComplexAmplitude(measuredMagnitude, measuredPhase,
-							capRange, stream, channel, numBlocks, board->boardSampleRate,
-							actualImpedanceFreq, numPeriods);
-					}
-				}
-			}
+		const ImpedanceRun& run = runs[i];
+		loadAmplifierData(numBlocks, numdataStreams, run.channel);
+
+		for (stream = 0; stream < numdataStreams; ++stream)
+		{
+			if ((board->chipId[stream] == CHIP_ID_RHD2164_B) == run.rhd2164Channels)
+				measureComplexAmplitude(measuredMagnitude, measuredPhase, run.capRange, stream, run.channel);
 		}
 	}
 
@@ -33,6 +33,7 @@
 #include "rhythm-api/rhd2000registersusb3.h"
 #include "rhythm-api/rhd2000datablockusb3.h"
 #include "rhythm-api/okFrontPanelDLL.h"
+#include "USBThread.h"
 
 #define MAX_NUM_HEADSTAGES ( MAX_NUM_DATA_STREAMS / 2 )
 
@@ -61,6 +62,7 @@ namespace IntanRecordingController
 		*/
 	class RHD2000Thread : public DataThread
 		, public Timer
+		, private USBBoardCommands
 	{
 		friend class RHDImpedanceMeasure;
 
@@ -82,6 +84,7 @@ namespace IntanRecordingController
 		bool usesCustomNames() const override;
 
 		float getSampleRate(int subprocessor) const override;
+		void resizeBuffers() override;
 		float getBitVolts(const DataChannel* chan) const override;
 
 		float getAdcBitVolts(int channelNum) const;
@@ -107,6 +110,13 @@ namespace IntanRecordingController
 		void scanPorts();
 		void enableAdcs(bool);
 
+		/** In low latency mode each USB block is read as soon as it is complete. Otherwise reads
+			are batched to cover USB_THROUGHPUT_READ_MS of samples, which costs less CPU and USB
+			overhead per sample when nothing reacts to the data in closed loop. Takes effect at
+			the next start of acquisition */
+		void setLowLatencyReads(bool enable);
+		bool getLowLatencyReads() const;
+
 		bool isReady() override;
 
 		bool isAcquisitionActive() const;
@@ -144,10 +154,17 @@ namespace IntanRecordingController
 		bool enableHeadstage(int hsNum, bool enabled, int nStr = 1, int strChans = 32);
 		void updateBoardStreams();
 
+		/** Rebuilds the tables that map the words of a USB frame to the enabled channels. Called
+			whenever the data streams, their channel counts or the acquired inputs change */
+		void updateDecodeTables();
+
 		void setDefaultChannelNames() override;
 
 		bool updateBuffer() override;
 
+		/** Decodes the raw USB data blocks of a read of return_code bytes into the source buffer */
+		void decodeUsbBlock(unsigned char* bufferPtr, long return_code);
+
 		void timerCallback() override;
 
 		bool startAcquisition() override;
@@ -160,7 +177,16 @@ namespace IntanRecordingController
 		int numChannels;
 		bool deviceFound;
 
-		float thisSample[MAX_NUM_CHANNELS];
+		// interleaved samples, timestamps and TTL words of a whole USB block, handed to the DataBuffer at once
+		HeapBlock<float> blockSamples;
+		HeapBlock<int64> blockTimestamps;
+		HeapBlock<uint64> blockEventWords;
+		int blockCapacity{ 0 };
+
+		// decode tables for the current stream layout, see updateDecodeTables()
+		Array<int> neuralWordOffsets;	// byte offset in a USB frame of each acquired neural channel, in channel order
+		Array<int> auxStreams;			// data stream of each aux channel triple, in channel order
+		int numDecodedAdcs{ 0 };
 		// aux inputs are only sampled every 4th sample, so use this to buffer the samples so they can be handles just like the regular neural channels later
 		float auxBuffer[MAX_NUM_CHANNELS];
 		float auxSamples[MAX_NUM_DATA_STREAMS][3];
@@ -169,13 +195,12 @@ namespace IntanRecordingController
 
 		bool isTransmitting;
 
-		bool dacOutputShouldChange;
 		bool acquireAdcChannels;
 		bool acquireAuxChannels;
 
 		bool fastSettleEnabled;
 		bool fastTTLSettleEnabled;
-		bool fastSettleTTLChannel;
+		int fastSettleTTLChannel;
 		bool ttlMode;
 		bool desiredDAChpfState;
 		double desiredDAChpf;
@@ -196,6 +221,29 @@ namespace IntanRecordingController
 
 		void updateRegisters();
 
+		/** Board output registers that are written between USB reads during acquisition */
+		enum BoardCommand
+		{
+			CMD_DAC_OUTPUT = 1,				// bits 0-7, one per DAC
+			CMD_TTL_MODE = 1 << 8,
+			CMD_FAST_SETTLE = 1 << 9,
+			CMD_DAC_HPF = 1 << 10,
+			CMD_NOISE_SLICER = 1 << 11
+		};
+
+		/** Marks registers whose value has changed. Called after the new values are stored
+			under boardCommandLock */
+		void queueBoardCommands(uint32 commands);
+
+		/** Writes each marked register once, with its latest value. Called by the USB thread */
+		void applyBoardCommands() override;
+
+		std::atomic<uint32> pendingBoardCommands{ 0 };
+		SpinLock boardCommandLock;		// guards the values the board commands write
+
+		/** The reusable data block, reallocated only when the number of enabled streams changes */
+		Rhd2000DataBlockUsb3* getDataBlock();
+
 		int deviceId(Rhd2000DataBlockUsb3* dataBlock, int stream, int& register59Value);
 
 		double cableLengthPortA, cableLengthPortB, cableLengthPortC, cableLengthPortD;
@@ -204,7 +252,6 @@ namespace IntanRecordingController
 		int audioOutputL, audioOutputR;
 		int* dacChannels, *dacStream;
 		float* dacThresholds;
-		bool* dacChannelsToUpdate;
 		Array<int> chipId;
 		OwnedArray<RHDHeadstage> headstagesArray;
 		Array<int> enabledStreams;
@@ -214,6 +261,7 @@ namespace IntanRecordingController
 		int numberingScheme;
 		Array<float> adcBitVolts;
 		bool newScan;
+		bool lowLatencyReads;
 		ScopedPointer<RHDImpedanceMeasure> impedanceThread;
 		ScopedPointer<USBThread> usbThread;
 
@@ -270,14 +318,16 @@ namespace IntanRecordingController
 		void runImpedanceMeasurement();
 		void restoreFPGA();
 
+		void startImpedanceRun(int capRange, int zcheckChannel);
+
+		void prepareCorrelation(int numBlocks, double sampleRate, double frequency, int numPeriods);
+
 		void measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
 			std::vector<std::vector<std::vector<double>>>& measuredPhase,
-			int capIndex, int stream, int chipChannel, int numBlocks,
-			double sampleRate, double frequency, int numPeriods);
+			int capIndex, int stream, int chipChannel);
 
 		void amplitudeOfFreqComponent(double& realComponent, double& imagComponent,
-			const std::vector<double>& data, int startIndex,
-			int endIndex, double sampleRate, double frequency);
+			const double* data);
 
 		void factorOutParallelCapacitance(double& impedanceMagnitude, double& impedancePhase,
 			double frequency, double parasiticCapacitance);
@@ -286,11 +336,21 @@ namespace IntanRecordingController
 			double boardSampleRate);
 
 		float updateImpedanceFrequency(float desiredImpedanceFreq, bool& impedanceFreqValid);
-		int loadAmplifierData(queue<Rhd2000DataBlockUsb3>& dataQueue,
-			int numBlocks, int numDataStreams);
+		int loadAmplifierData(int numBlocks, int numDataStreams, int channel);
+
+		/** Blocks the board decodes each run into, kept between runs and measurements */
+		std::vector<std::unique_ptr<Rhd2000DataBlockUsb3>> dataBlocks;
 
 		std::vector<std::vector<std::vector<double>>> amplifierPreFilter;
 
+		/** Sine and cosine of the test frequency over the measurement window, which
+			starts at sample windowStart of every run */
+		std::vector<double> correlationCos;
+		std::vector<double> correlationSin;
+		int windowStart;
+
+		int currentCapRange;
+
 		ImpedanceData* data;
 		RHD2000Thread* board;
 
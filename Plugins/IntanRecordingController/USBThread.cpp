@@ -23,11 +23,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "USBThread.h"
 #include "rhythm-api/rhd2000evalboardusb3.h"
+#include <ProcessorHeaders.h>
 
 using namespace IntanRecordingController;
 
-USBThread::USBThread(Rhd2000EvalBoardUsb3* b)
-	: m_board(b), Thread("USBThread")
+USBThread::USBThread(Rhd2000EvalBoardUsb3* b, USBBoardCommands* commands)
+	: Thread("USBThread"), m_board(b), m_commands(commands)
 {
 }
 
@@ -36,18 +37,38 @@ USBThread::~USBThread()
 {
 }
 
-void USBThread::startAcquisition(int nBytes)
+void USBThread::startAcquisition(int blockBytes, int blocksPerRead)
 {
-    ScopedLock lock(m_lock);
-	for (int i = 0; i < 2; i++)
+	m_blockBytes = blockBytes;
+	m_blocksPerRead = blocksPerRead;
+	m_maxBlocksPerRead = blocksPerRead * USB_CATCH_UP_FACTOR;
+
+	for (int i = 0; i < USB_RING_BLOCKS; i++)
 	{
 		m_lastRead[i] = 0;
-		m_buffers[i].malloc(nBytes);
+		m_readTicks[i] = 0;
+		m_buffers[i].malloc(blockBytes * m_maxBlocksPerRead);
 	}
-	m_curBuffer = 0;
-	m_readBuffer = 0;
-	m_canRead = true;
-	startThread();
+	m_writeIndex = 0;
+	m_readIndex = 0;
+	m_blockReady.reset();
+	m_slotFree.reset();
+
+	m_fifoWords = 0;
+	m_maxFifoWords = 0;
+	m_maxRingFill = 0;
+	m_blocksRead = 0;
+	m_reads = 0;
+	m_ringFullWaits = 0;
+	m_lagTicks = 0;
+	m_maxLagTicks = 0;
+	m_unpolledReads = 0;
+	m_transferTicks = 0;
+	m_maxTransferTicks = 0;
+	m_totalTransferTicks = 0;
+	m_bytesRead = 0;
+
+	ThreadConfig::startThread(*this, ThreadConfig::ACQUISITION);
 }
 
 void USBThread::stopAcquisition()
@@ -55,52 +76,156 @@ void USBThread::stopAcquisition()
 	std::cout << "Stopping usb thread" << std::endl;
 	if (isThreadRunning())
 	{
+		signalThreadShouldExit();
+		m_slotFree.signal();
 		if (!stopThread(1000))
 		{
 			std::cerr << "USB Thread could not stop cleanly. Force quitting it" << std::endl;
 		}
 	}
+
+	USBThreadMetrics metrics = getMetrics();
+	std::cout << "USB thread read " << metrics.blocksRead << " blocks in " << metrics.reads << " reads. Max FIFO words: " << metrics.maxFifoWords
+		<< ", max ring fill: " << metrics.maxRingFill << "/" << USB_RING_BLOCKS
+		<< ", max decode lag: " << metrics.maxDecodeLagMs << " ms, waits for a free slot: " << metrics.ringFullWaits << std::endl;
+	std::cout << "USB pipe reads took " << metrics.meanTransferMs << " ms on average, " << metrics.maxTransferMs << " ms at most ("
+		<< metrics.transferMBps << " MB/s while reading), " << metrics.unpolledReads << " reads without a FIFO poll" << std::endl;
 }
 
-long USBThread::usbRead(unsigned char*& buffer)
+long USBThread::peekBlock(unsigned char*& buffer)
 {
-	ScopedLock lock(m_lock);
-	if (m_readBuffer == m_curBuffer)
+	unsigned int readIndex = m_readIndex.load(std::memory_order_relaxed);
+	if (readIndex == m_writeIndex.load(std::memory_order_acquire))
 		return 0;
-	buffer = m_buffers[m_readBuffer].getData();
-	long read = m_lastRead[m_readBuffer];
-	m_readBuffer = ++m_readBuffer % 2;
-	m_canRead = true;
-	notify();
-	return read;
+
+	int slot = readIndex % USB_RING_BLOCKS;
+	buffer = m_buffers[slot].getData();
+	return m_lastRead[slot];
+}
+
+void USBThread::releaseBlock()
+{
+	unsigned int readIndex = m_readIndex.load(std::memory_order_relaxed);
+
+	int64 lag = Time::getHighResolutionTicks() - m_readTicks[readIndex % USB_RING_BLOCKS];
+	m_lagTicks.store(lag, std::memory_order_relaxed);
+	if (lag > m_maxLagTicks.load(std::memory_order_relaxed))
+		m_maxLagTicks.store(lag, std::memory_order_relaxed);
+
+	m_readIndex.store(readIndex + 1, std::memory_order_release);
+	m_slotFree.signal();
+}
+
+bool USBThread::waitForBlock(int timeOutMs)
+{
+	if (m_readIndex.load(std::memory_order_relaxed) != m_writeIndex.load(std::memory_order_acquire))
+		return true;
+
+	m_blockReady.wait(timeOutMs);
+	return m_readIndex.load(std::memory_order_relaxed) != m_writeIndex.load(std::memory_order_acquire);
+}
+
+USBThreadMetrics USBThread::getMetrics() const
+{
+	USBThreadMetrics metrics;
+	double ticksPerMs = Time::getHighResolutionTicksPerSecond() / 1000.0;
+
+	metrics.fifoWords = m_fifoWords;
+	metrics.maxFifoWords = m_maxFifoWords;
+	metrics.ringFill = int(m_writeIndex.load() - m_readIndex.load());
+	metrics.maxRingFill = m_maxRingFill;
+	metrics.decodeLagMs = m_lagTicks / ticksPerMs;
+	metrics.maxDecodeLagMs = m_maxLagTicks / ticksPerMs;
+	metrics.blocksRead = m_blocksRead;
+	metrics.reads = m_reads;
+	metrics.ringFullWaits = m_ringFullWaits;
+	metrics.unpolledReads = m_unpolledReads;
+	metrics.transferMs = m_transferTicks / ticksPerMs;
+	metrics.maxTransferMs = m_maxTransferTicks / ticksPerMs;
+
+	int64 totalTicks = m_totalTransferTicks;
+	if (metrics.reads > 0)
+		metrics.meanTransferMs = totalTicks / ticksPerMs / metrics.reads;
+	if (totalTicks > 0)
+		metrics.transferMBps = m_bytesRead / (totalTicks / ticksPerMs) / 1000.0;
+	return metrics;
 }
 
 void USBThread::run()
 {
+	int numBlocks = m_blocksPerRead;
+	int blockWords = m_blockBytes / 2;
+	/* words the FIFO is known to hold past the last read, from the last poll of its level */
+	int64 knownWords = 0;
+
 	while (!threadShouldExit())
 	{
-		m_lock.enter();
-		if (m_canRead)
+		unsigned int writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_readIndex.load(std::memory_order_acquire) >= USB_RING_BLOCKS)
 		{
-			m_lock.exit();
-			long read;
-			do
-			{
-				if (threadShouldExit())
-					break;
-				read = m_board->readDataBlocksRaw(1, m_buffers[m_curBuffer].getData());
-			} while (read <= 0);
-			{
-				ScopedLock lock(m_lock);
-				m_lastRead[m_curBuffer] = read;
-				m_curBuffer = ++m_curBuffer % 2;
-				m_canRead = false;
-			}
+			m_ringFullWaits++;
+			m_slotFree.wait(100);
+			continue;
 		}
-		else
-			m_lock.exit();
 
-		if (!threadShouldExit())
-			wait(100);
+		int slot = writeIndex % USB_RING_BLOCKS;
+		long read;
+		bool pollFifo;
+		int64 transferTicks;
+		int backoffMs = 0;
+		do
+		{
+			if (threadShouldExit())
+				return;
+			/* register writes share the USB link with the reads, so they are made in between */
+			if (m_commands != nullptr)
+				m_commands->applyBoardCommands();
+			pollFifo = knownWords < int64(numBlocks) * blockWords;
+			int64 startTicks = Time::getHighResolutionTicks();
+			read = m_board->readDataBlocksRaw(numBlocks, m_buffers[slot].getData(), -1, pollFifo);
+			transferTicks = Time::getHighResolutionTicks() - startTicks;
+			if (read <= 0)
+			{
+				knownWords = 0;
+				// back off while the block is not complete instead of spinning on the FIFO count
+				if (backoffMs == 0)
+					Thread::yield();
+				else
+					wait(backoffMs);
+				backoffMs = jmin(jmax(1, backoffMs * 2), USB_POLL_MAX_BACKOFF_MS);
+			}
+		} while (read <= 0);
+
+		m_lastRead[slot] = read;
+		m_readTicks[slot] = Time::getHighResolutionTicks();
+
+		m_transferTicks = transferTicks;
+		m_totalTransferTicks += transferTicks;
+		if (transferTicks > m_maxTransferTicks)
+			m_maxTransferTicks = transferTicks;
+		m_bytesRead += read;
+		if (!pollFifo)
+			m_unpolledReads++;
+
+		/* a polled read checks the FIFO level before reading, so this costs no extra USB transfer */
+		unsigned int fifoWords = pollFifo ? m_board->getLastNumWordsInFifo() : (unsigned int)knownWords;
+		knownWords = int64(fifoWords) - int64(numBlocks) * blockWords;
+		m_fifoWords = fifoWords;
+		if (fifoWords > m_maxFifoWords)
+			m_maxFifoWords = fifoWords;
+
+		m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+		m_blocksRead += numBlocks;
+		m_reads++;
+
+		/* blocks left in the FIFO after this read are taken along with the next one */
+		int backlog = int(int64(fifoWords) * 2 / m_blockBytes) - numBlocks;
+		numBlocks = jlimit(m_blocksPerRead, m_maxBlocksPerRead, backlog);
+
+		int fill = int(writeIndex + 1 - m_readIndex.load(std::memory_order_relaxed));
+		if (fill > m_maxRingFill)
+			m_maxRingFill = fill;
+
+		m_blockReady.signal();
 	}
 }
@@ -29,24 +29,98 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 class Rhd2000EvalBoardUsb3;
 namespace IntanRecordingController
 {
+	/** Raw USB blocks the reader can hold before the USB thread has to wait for the decoder */
+#define USB_RING_BLOCKS 32
+	/** Longest wait between two polls of the board FIFO */
+#define USB_POLL_MAX_BACKOFF_MS 2
+	/** A slot of the ring holds this many times the blocks of a regular read, so that a backlog
+	in the board FIFO is caught up with in fewer reads */
+#define USB_CATCH_UP_FACTOR 2
 
+	struct USBThreadMetrics
+	{
+		unsigned int fifoWords{ 0 };		//Words in the board FIFO when the last block was read
+		unsigned int maxFifoWords{ 0 };
+		int ringFill{ 0 };					//Blocks waiting to be decoded
+		int maxRingFill{ 0 };
+		double decodeLagMs{ 0 };			//Time between a block arriving and its release by the decoder
+		double maxDecodeLagMs{ 0 };
+		int64 blocksRead{ 0 };
+		int64 reads{ 0 };					//USB transfers the blocks were read in
+		int64 ringFullWaits{ 0 };			//Times the USB thread had to wait for a free slot
+		int64 unpolledReads{ 0 };			//Reads made without polling the FIFO level first
+		double transferMs{ 0 };				//Duration of the last pipe read
+		double maxTransferMs{ 0 };
+		double meanTransferMs{ 0 };
+		double transferMBps{ 0 };			//Bytes read per second spent in pipe reads
+	};
+
+	/** Board writes that are made on the USB thread, between two reads */
+	class USBBoardCommands
+	{
+	public:
+		virtual ~USBBoardCommands() {}
+
+		/** Writes the board registers changed since the last call */
+		virtual void applyBoardCommands() = 0;
+	};
+
+	/** Reads raw USB data blocks into a lock-free single producer, single consumer ring,
+	which the data thread decodes in place.
+
+	The FrontPanel pipe reads are synchronous and the board is not shared between threads, so
+	the link is kept busy by reading back to back: while the FIFO level seen at the last poll
+	still covers the next read, it is made without polling the level again */
 	class USBThread : Thread
 	{
 	public:
-		USBThread(Rhd2000EvalBoardUsb3*);
+		USBThread(Rhd2000EvalBoardUsb3*, USBBoardCommands* commands = nullptr);
 		~USBThread();
 		void run() override;
-		void startAcquisition(int nBytes);
+		/** Starts reading blocksPerRead blocks of blockBytes bytes at a time, or more while
+		the board FIFO holds a backlog */
+		void startAcquisition(int blockBytes, int blocksPerRead);
 		void stopAcquisition();
-		long usbRead(unsigned char*&);
+
+		/** Points buffer to the oldest block read and returns its size, or 0 if there is none.
+		The block stays valid until releaseBlock() is called */
+		long peekBlock(unsigned char*& buffer);
+		void releaseBlock();
+
+		/** Waits up to timeOutMs for a block to be available. Returns true if there is one */
+		bool waitForBlock(int timeOutMs);
+
+		USBThreadMetrics getMetrics() const;
 	private:
 		Rhd2000EvalBoardUsb3* const m_board;
-		HeapBlock<unsigned char> m_buffers[2];
-		long m_lastRead[2];
-		unsigned short m_curBuffer{ 0 };
-		unsigned short m_readBuffer{ 0 };
-		bool m_canRead{ false };
-		CriticalSection m_lock;
+		USBBoardCommands* const m_commands;
+		HeapBlock<unsigned char> m_buffers[USB_RING_BLOCKS];
+		long m_lastRead[USB_RING_BLOCKS];
+		int m_blockBytes{ 0 };
+		int m_blocksPerRead{ 1 };
+		int m_maxBlocksPerRead{ 1 };
+		int64 m_readTicks[USB_RING_BLOCKS];
+
+		/* Free-running block counters; the producer only writes m_writeIndex, the consumer only m_readIndex */
+		std::atomic<unsigned int> m_writeIndex{ 0 };
+		std::atomic<unsigned int> m_readIndex{ 0 };
+
+		WaitableEvent m_blockReady;
+		WaitableEvent m_slotFree;
+
+		std::atomic<unsigned int> m_fifoWords{ 0 };
+		std::atomic<unsigned int> m_maxFifoWords{ 0 };
+		std::atomic<int> m_maxRingFill{ 0 };
+		std::atomic<int64> m_blocksRead{ 0 };
+		std::atomic<int64> m_reads{ 0 };
+		std::atomic<int64> m_ringFullWaits{ 0 };
+		std::atomic<int64> m_lagTicks{ 0 };
+		std::atomic<int64> m_maxLagTicks{ 0 };
+		std::atomic<int64> m_unpolledReads{ 0 };
+		std::atomic<int64> m_transferTicks{ 0 };
+		std::atomic<int64> m_maxTransferTicks{ 0 };
+		std::atomic<int64> m_totalTransferTicks{ 0 };
+		std::atomic<int64> m_bytesRead{ 0 };
 	};
 }
 #endif
@@ -51,6 +51,7 @@ public:
     void write(ofstream &saveOut, int numDataStreams) const;
     static bool checkUsbHeader(unsigned char usbBuffer[], int index);
 	static unsigned int convertUsbTimeStamp(unsigned char usbBuffer[], int index);
+    int getNumDataStreams() const { return numDataStreamsStored; }
     inline int fastIndex(int stream, int channel, int t) const
     {
     	return ((t * numDataStreamsStored * CHANNELS_PER_STREAM) + (channel * numDataStreamsStored) + stream);
@@ -1486,14 +1486,15 @@ bool Rhd2000EvalBoardUsb3::readDataBlock(Rhd2000DataBlockUsb3 *dataBlock, int nS
 }
 
 // Reads a certain number of USB data blocks, if the specified number is available, and writes the raw bytes
-// to a buffer.  Returns total number of bytes read.
-long Rhd2000EvalBoardUsb3::readDataBlocksRaw(int numBlocks, unsigned char* buffer, int nSamples)
+// to a buffer.  Returns total number of bytes read.  A caller that knows from an earlier poll that the
+// FIFO holds the blocks can pass pollFifo = false, which saves the wire-out update before the pipe read.
+long Rhd2000EvalBoardUsb3::readDataBlocksRaw(int numBlocks, unsigned char* buffer, int nSamples, bool pollFifo)
 {
     lock_guard<mutex> lockOk(okMutex);
 
     unsigned int numWordsToRead = numBlocks * Rhd2000DataBlockUsb3::calculateDataBlockSizeInWords(numDataStreams, nSamples);
 
-    if (numWordsInFifo() < numWordsToRead)
+    if (pollFifo && numWordsInFifo() < numWordsToRead)
 	   return 0;
     long result = dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, 2 * numWordsToRead, buffer);
 
@@ -1506,18 +1507,14 @@ long Rhd2000EvalBoardUsb3::readDataBlocksRaw(int numBlocks, unsigned char* buffe
     return result;
 }
 
-// Reads a certain number of USB data blocks, if the specified number is available, and appends them
-// to queue.  Returns true if data blocks were available.
-bool Rhd2000EvalBoardUsb3::readDataBlocks(int numBlocks, queue<Rhd2000DataBlockUsb3> &dataQueue)
+// Reads a certain number of USB data blocks into the USB buffer, if the specified number is available.
+// Returns true if data blocks were available.  The caller holds okMutex.
+bool Rhd2000EvalBoardUsb3::readUsbBlocks(int numBlocks)
 {
-    lock_guard<mutex> lockOk(okMutex);
-
     unsigned int numWordsToRead, numBytesToRead;
-    int j;
-    Rhd2000DataBlockUsb3 *dataBlock;
     long result;
 
-    numWordsToRead = numBlocks * dataBlock->calculateDataBlockSizeInWords(numDataStreams);
+    numWordsToRead = numBlocks * Rhd2000DataBlockUsb3::calculateDataBlockSizeInWords(numDataStreams);
 
     if (numWordsInFifo() < numWordsToRead)
         return false;
@@ -1538,6 +1535,21 @@ bool Rhd2000EvalBoardUsb3::readDataBlocks(int numBlocks, queue<Rhd2000DataBlockU
         cerr << "CRITICAL (readDataBlocks): Timeout on pipe read.  Check block and buffer sizes." << endl;
     }
 
+    return true;
+}
+
+// Reads a certain number of USB data blocks, if the specified number is available, and appends them
+// to queue.  Returns true if data blocks were available.
+bool Rhd2000EvalBoardUsb3::readDataBlocks(int numBlocks, queue<Rhd2000DataBlockUsb3> &dataQueue)
+{
+    lock_guard<mutex> lockOk(okMutex);
+
+    int j;
+    Rhd2000DataBlockUsb3 *dataBlock;
+
+    if (!readUsbBlocks(numBlocks))
+        return false;
+
     dataBlock = new Rhd2000DataBlockUsb3(numDataStreams);
 
     for (j = 0; j < numBlocks; ++j) {
@@ -1549,6 +1561,32 @@ bool Rhd2000EvalBoardUsb3::readDataBlocks(int numBlocks, queue<Rhd2000DataBlockU
     return true;
 }
 
+// Reads a certain number of USB data blocks, if the specified number is available, and decodes them
+// in place into the first numBlocks blocks of a pool. Blocks are only allocated when the pool is
+// smaller or was sized for a different number of data streams, so a pool kept between calls
+// is decoded into without allocating.  Returns true if data blocks were available.
+bool Rhd2000EvalBoardUsb3::readDataBlocks(int numBlocks, vector<unique_ptr<Rhd2000DataBlockUsb3> > &blocks)
+{
+    lock_guard<mutex> lockOk(okMutex);
+
+    int j;
+
+    if (!readUsbBlocks(numBlocks))
+        return false;
+
+    if (blocks.size() < (size_t) numBlocks)
+        blocks.resize(numBlocks);
+
+    for (j = 0; j < numBlocks; ++j) {
+        if (blocks[j] == nullptr || blocks[j]->getNumDataStreams() != numDataStreams)
+            blocks[j].reset(new Rhd2000DataBlockUsb3(numDataStreams));
+
+        blocks[j]->fillFromUsbBuffer(usbBuffer, j, numDataStreams);
+    }
+
+    return true;
+}
+
 // Writes the contents of a data block queue (dataQueue) to a binary output stream (saveOut).
 // Returns the number of data blocks written.
 int Rhd2000EvalBoardUsb3::queueToFile(queue<Rhd2000DataBlockUsb3> &dataQueue, ofstream &saveOut)
@@ -38,6 +38,7 @@
 
 #include <queue>
 #include <mutex>
+#include <memory>
 
 using namespace std;
 
@@ -152,8 +153,9 @@ public:
 
     void flush();
     bool readDataBlock(Rhd2000DataBlockUsb3 *dataBlock, int nSamples = -1);
-	long readDataBlocksRaw(int numBlocks, unsigned char* buffer, int nSamples = -1);
+	long readDataBlocksRaw(int numBlocks, unsigned char* buffer, int nSamples = -1, bool pollFifo = true);
     bool readDataBlocks(int numBlocks, queue<Rhd2000DataBlockUsb3> &dataQueue);
+    bool readDataBlocks(int numBlocks, vector<unique_ptr<Rhd2000DataBlockUsb3> > &blocks);
     int queueToFile(queue<Rhd2000DataBlockUsb3> &dataQueue, std::ofstream &saveOut);
     int getBoardMode();
     int getCableDelay(BoardPort port) const;
@@ -168,6 +170,8 @@ public:
 	bool getStreamEnabled(int stream) const;
 
 private:
+    bool readUsbBlocks(int numBlocks);
+
     OpalKellyLegacy::okCFrontPanel *dev;
     AmplifierSampleRate sampleRate;
     unsigned int usbBufferSize;
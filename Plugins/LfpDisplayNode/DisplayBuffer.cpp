@@ -32,9 +32,20 @@ namespace LfpViewer {
     */
 #define BUFFER_LENGTH_S 1.0f
 
+    // each level of the pyramid aggregates this many runs of the level below
+#define PYRAMID_BASE 4
+#define PYRAMID_LEVELS 5
+
+    // most source samples kept as one min/max pair
+#define MAX_DECIMATION 256
+
     DisplayBuffer::DisplayBuffer(int id_, String name_, float sampleRate_) : 
-        id(id_), name(name_), sampleRate(sampleRate_), isNeeded(true)
+        id(id_), name(name_), sampleRate(sampleRate_), isNeeded(true),
+        decimation(1), requestedDecimation(1), generation(0),
+        eventBlockPhase(0), eventBlockLength(0)
     {
+        history = new DisplayHistory(this);
+
         previousSize = 0;
         numChannels = 0;
 
@@ -47,12 +58,32 @@ namespace LfpViewer {
 
         ttlState = 0;
 
+        // only the event channel until the first update
+        displayBufferIndices.allocate(1, false);
+        new (displayBufferIndices.getData()) std::atomic<int>(0);
+
+        pendingMin.allocate(1, true);
+        pendingMax.allocate(1, true);
+        pendingCount.allocate(1, true);
+
+        int factor = 1;
+        for (int l = 0; l < PYRAMID_LEVELS; ++l)
+        {
+            factor *= PYRAMID_BASE;
+            PyramidLevel* level = new PyramidLevel();
+            level->factor = factor;
+            pyramid.add(level);
+        }
+
        // std::cout << "Subprocessor " << id << " has " << displays.size() << " displays." << std::endl;
         //std::cout << "Display buffer sample rate: " << sampleRate << std::endl;
     }
 
     DisplayBuffer::~DisplayBuffer()
     {
+        // the writer thread reads the buffer until it stops
+        history = nullptr;
+
         delete[] arrayOfOnes;
     }
 
@@ -66,7 +97,7 @@ namespace LfpViewer {
         isNeeded = false;
     }
 
-    void DisplayBuffer::addChannel(String name, int channelNum, int group, float ypos, String structure)
+    int DisplayBuffer::addChannel(String name, int channelNum, int group, float ypos, String structure)
     {
         ChannelMetadata metadata = ChannelMetadata();
         metadata.name = name;
@@ -81,26 +112,57 @@ namespace LfpViewer {
         isNeeded = true;
 
        // std::cout << "Adding channel " << name << " with index " << numChannels << "; ";
+
+        return numChannels - 1;
     }
 
     void DisplayBuffer::update()
     {
             
         if (numChannels != previousSize)
-            setSize(numChannels + 1, int(sampleRate * BUFFER_LENGTH_S));
+        {
+            // a whole number of the longest runs, so no run wraps around the end of the buffer
+            const int longestRun = pyramid.getLast()->factor;
+            const int bufferLength = (int(sampleRate * BUFFER_LENGTH_S) + longestRun - 1) / longestRun * longestRun;
+
+            setSize(numChannels + 1, bufferLength);
+
+            for (auto level : pyramid)
+            {
+                level->runMin.setSize(numChannels + 1, bufferLength / level->factor);
+                level->runMax.setSize(numChannels + 1, bufferLength / level->factor);
+                level->runSum.setSize(numChannels + 1, bufferLength / level->factor);
+            }
+        }
 
         clear();
 
-        displayBufferIndices.clear();
+        for (auto level : pyramid)
+        {
+            level->runMin.clear();
+            level->runMax.clear();
+            level->runSum.clear();
+        }
+
+        displayBufferIndices.allocate(numChannels + 1, false);
 
         for (int i = 0; i <= numChannels; i++)
-            displayBufferIndices.set(i, 0);
+            new (displayBufferIndices + i) std::atomic<int>(0);
+
+        pendingMin.allocate(numChannels + 1, true);
+        pendingMax.allocate(numChannels + 1, true);
+        pendingCount.allocate(numChannels + 1, true);
+
+        decimation.store(requestedDecimation.load());
     }
 
     void DisplayBuffer::resetIndices()
     {
         for (int i = 0; i <= numChannels; i++)
-            displayBufferIndices.set(i, 0);
+        {
+            setIndex(i, 0);
+            pendingCount[i] = 0;
+        }
     }
 
     void DisplayBuffer::addDisplay(int splitID)
@@ -116,86 +178,92 @@ namespace LfpViewer {
         if (displays.contains(splitID))
             displays.remove(displays.indexOf(splitID));
 
+        displayResolutions.erase(splitID);
+
        // std::cout << "Subprocessor " << id << " has " << displays.size() << " displays." << std::endl;
 
     }
 
-    void DisplayBuffer::initializeEventChannel(int nSamples)
+    void DisplayBuffer::setDisplayResolution(int splitID, float samplesPerPixel)
     {
-        if (displays.size() == 0)
-            return;
+        displayResolutions[splitID] = samplesPerPixel;
 
-        const int samplesLeft = getNumSamples() - displayBufferIndices[numChannels];
+        float finest = -1.0f;
 
-        if (nSamples < samplesLeft)
+        for (auto display : displays)
         {
+            auto it = displayResolutions.find(display);
 
-            copyFrom(numChannels,                                      // destChannel
-                displayBufferIndices[numChannels],             // destStartSample
-                arrayOfOnes,                               // source
-                nSamples,                                  // numSamples
-                float(ttlState));     // gain
+            if (it != displayResolutions.end() && (finest < 0 || it->second < finest))
+                finest = it->second;
         }
-        else
-        {
-            int extraSamples = nSamples - samplesLeft;
 
-            copyFrom(numChannels,                               // destChannel
-                displayBufferIndices[numChannels],             // destStartSample
-                arrayOfOnes,                               // source
-                samplesLeft,                               // numSamples
-                float(ttlState));                        // gain
-
-            copyFrom(numChannels,                                      // destChannel
-                0,                                         // destStartSample
-                arrayOfOnes,                               // source
-                extraSamples,                              // numSamples
-                float(ttlState));     // gain
-        }
+        // a power of two, so a window never holds more samples than the finest display's pixel
+        int factor = 1;
+
+        while (factor * 2 <= jmin(finest, float(MAX_DECIMATION)))
+            factor *= 2;
+
+        requestedDecimation.store(factor);
     }
 
-    void DisplayBuffer::finalizeEventChannel(int nSamples)
+    float DisplayBuffer::getDisplaySampleRate() const
     {
+        const int factor = decimation.load(std::memory_order_acquire);
 
-        if (displays.size() == 0)
+        return factor > 1 ? sampleRate * 2.0f / factor : sampleRate;
+    }
+
+    void DisplayBuffer::applyDecimation()
+    {
+        const int factor = requestedDecimation.load();
+
+        if (factor == decimation.load(std::memory_order_relaxed))
             return;
 
-        const int index = displayBufferIndices[numChannels];
-        const int samplesLeft = getNumSamples() - index;
-   
-        int newIdx = 0;
+        // stored pairs stay aligned to even indices, so no pair wraps around the end of the buffer
+        resetIndices();
 
-        if (nSamples < samplesLeft)
-        {
-            newIdx = displayBufferIndices[numChannels] + nSamples;
-        }
-        else
-        {
-            newIdx = nSamples - samplesLeft;
-        }
-        
-        displayBufferIndices.set(numChannels, newIdx);
+        decimation.store(factor, std::memory_order_release);
+        generation.fetch_add(1, std::memory_order_release);
     }
 
-    void DisplayBuffer::addEvent(int eventTime, int eventChannel, int eventId, int numSourceSamples)
+    int DisplayBuffer::getBlockOffset(int sampleInBlock) const
     {
+        const int factor = decimation.load(std::memory_order_relaxed);
+
+        if (factor == 1)
+            return sampleInBlock;
+
+        return (eventBlockPhase + sampleInBlock) / factor * 2;
+    }
+
+    int DisplayBuffer::getEventIndex(int sampleInBlock) const
+    {
+        return (getIndex(numChannels) + getBlockOffset(sampleInBlock)) % getNumSamples();
+    }
+
+    void DisplayBuffer::initializeEventChannel(int nSamples)
+    {
+        applyDecimation();
 
         if (displays.size() == 0)
             return;
 
-        const int index = (displayBufferIndices[numChannels] + eventTime) % getNumSamples();
-        const int samplesLeft = getNumSamples() - index;
-        const int nSamples = numSourceSamples - eventTime;
+        eventBlockPhase = pendingCount[numChannels];
+        eventBlockLength = getBlockOffset(nSamples);
 
-        if (eventId == 1)
-        {
-            ttlState |= (1LL << eventChannel);
-        }
-        else {
-            ttlState &= ~(1LL << eventChannel);
-        }
+        fillEventChannel(0);
+    }
 
-       // std::cout << "Display buffer received event on " << eventChannel << " at " << eventTime << " with " << numSourceSamples << std::endl;
+    void DisplayBuffer::fillEventChannel(int blockOffset)
+    {
+        const int index = (getIndex(numChannels) + blockOffset) % getNumSamples();
+        const int samplesLeft = getNumSamples() - index;
+        const int nSamples = eventBlockLength - blockOffset;
+
+        if (nSamples <= 0)
+            return;
 
         if (nSamples < samplesLeft)
         {
@@ -223,57 +291,208 @@ namespace LfpViewer {
         }
     }
 
-    void DisplayBuffer::addData(AudioSampleBuffer& buffer, int chan, int nSamples)
+    void DisplayBuffer::finalizeEventChannel(int nSamples)
     {
+
         if (displays.size() == 0)
             return;
 
-        int previousIndex = displayBufferIndices[channelMap[chan]];
-        int channelIndex = channelMap[chan];
+        const int index = getIndex(numChannels);
 
-        const int samplesLeft = getNumSamples() - displayBufferIndices[channelMap[chan]];
+        // the events of the block have been written by now
+        updatePyramid(numChannels, index, eventBlockLength);
 
-        int newIndex;
-        
-        if (nSamples < samplesLeft)
+        const int factor = decimation.load(std::memory_order_relaxed);
+        pendingCount[numChannels] = factor > 1 ? (eventBlockPhase + nSamples) % factor : 0;
+
+        setIndex(numChannels, (index + eventBlockLength) % getNumSamples());
+    }
+
+    void DisplayBuffer::addEvent(int eventTime, int eventChannel, int eventId, int numSourceSamples)
+    {
+
+        if (displays.size() == 0)
+            return;
+
+        if (eventId == 1)
         {
-            copyFrom(channelMap[chan],                      // destChannel
-                displayBufferIndices[channelMap[chan]],  // destStartSample
-                buffer,                    // source
-                chan,                      // source channel
-                0,                         // source start sample
-                nSamples);                 // numSamples
+            ttlState |= (1LL << eventChannel);
+        }
+        else {
+            ttlState &= ~(1LL << eventChannel);
+        }
 
-            int lastIndex = displayBufferIndices[channelMap[chan]];
+       // std::cout << "Display buffer received event on " << eventChannel << " at " << eventTime << " with " << numSourceSamples << std::endl;
 
-            newIndex = lastIndex + nSamples;
-            
+        int blockOffset = getBlockOffset(eventTime);
+
+        // an event that turns off within a window still shows in the window's first sample
+        if (eventId == 0 && decimation.load(std::memory_order_relaxed) > 1)
+            blockOffset++;
+
+        fillEventChannel(blockOffset);
+    }
+
+    void DisplayBuffer::addData(AudioSampleBuffer& buffer, int chan, int channelIndex, int nSamples)
+    {
+        if (displays.size() == 0)
+            return;
+
+        const int previousIndex = getIndex(channelIndex);
+        const int factor = decimation.load(std::memory_order_relaxed);
+
+        int numWritten = 0;
+
+        if (factor == 1)
+        {
+            const int samplesLeft = getNumSamples() - previousIndex;
+
+            if (nSamples < samplesLeft)
+            {
+                copyFrom(channelIndex,                      // destChannel
+                    previousIndex,             // destStartSample
+                    buffer,                    // source
+                    chan,                      // source channel
+                    0,                         // source start sample
+                    nSamples);                 // numSamples
+            }
+            else
+            {
+                const int extraSamples = nSamples - samplesLeft;
+
+                copyFrom(channelIndex,                      // destChannel
+                    previousIndex,             // destStartSample
+                    buffer,                    // source
+                    chan,                      // source channel
+                    0,                         // source start sample
+                    samplesLeft);              // numSamples
+
+                copyFrom(channelIndex,                      // destChannel
+                    0,                         // destStartSample
+                    buffer,                    // source
+                    chan,                      // source channel
+                    samplesLeft,               // source start sample
+                    extraSamples);             // numSamples
+            }
+
+            numWritten = nSamples;
         }
         else
         {
-            const int extraSamples = nSamples - samplesLeft;
-
-            copyFrom(channelMap[chan],                      // destChannel
-                displayBufferIndices[channelMap[chan]],  // destStartSample
-                buffer,                    // source
-                chan,                      // source channel
-                0,                         // source start sample
-                samplesLeft);              // numSamples
-
-            copyFrom(channelMap[chan],                      // destChannel
-                0,                         // destStartSample
-                buffer,                    // source
-                chan,                      // source channel
-                samplesLeft,               // source start sample
-                extraSamples);             // numSamples
-
-            newIndex = extraSamples;
+            const float* source = buffer.getReadPointer(chan);
+            float* dest = getWritePointer(channelIndex);
+
+            float& windowMin = pendingMin[channelIndex];
+            float& windowMax = pendingMax[channelIndex];
+            int& windowCount = pendingCount[channelIndex];
+
+            int index = previousIndex;
+
+            // a window left unfinished by the last block is completed first, then whole windows
+            for (int n = 0; n < nSamples;)
+            {
+                const int count = jmin(factor - windowCount, nSamples - n);
+                const Range<float> range = FloatVectorOperations::findMinAndMax(source + n, count);
+
+                windowMin = windowCount == 0 ? range.getStart() : jmin(windowMin, range.getStart());
+                windowMax = windowCount == 0 ? range.getEnd() : jmax(windowMax, range.getEnd());
+
+                windowCount += count;
+                n += count;
+
+                if (windowCount == factor)
+                {
+                    dest[index] = windowMin;
+                    dest[index + 1] = windowMax;
+
+                    index = (index + 2) % getNumSamples();
+                    numWritten += 2;
+                    windowCount = 0;
+                }
+            }
         }
 
-        ScopedLock displayLock(displayMutex);
+        updatePyramid(channelIndex, previousIndex, numWritten);
+
+        // the samples and their runs are written before the index is published
+        setIndex(channelIndex, (previousIndex + numWritten) % getNumSamples());
+
+    }
+
+    void DisplayBuffer::updatePyramid(int channel, int startSample, int numSamples)
+    {
+        const int endSample = startSample + numSamples;
+
+        for (int l = 0; l < pyramid.size(); ++l)
+        {
+            PyramidLevel& level = *pyramid[l];
+            const int factor = level.factor;
+            const int numRuns = level.runMin.getNumSamples();
+
+            float* runMin = level.runMin.getWritePointer(channel);
+            float* runMax = level.runMax.getWritePointer(channel);
+            float* runSum = level.runSum.getWritePointer(channel);
+
+            // runs that started in an earlier block are completed by this one
+            for (int run = startSample / factor; (run + 1) * factor <= endSample; ++run)
+            {
+                const int r = run % numRuns;
+                float mn, mx, sum = 0;
+
+                if (l == 0)
+                {
+                    const float* samples = getReadPointer(channel, r * factor);
+                    mn = mx = samples[0];
+
+                    for (int i = 0; i < factor; ++i)
+                    {
+                        mn = jmin(mn, samples[i]);
+                        mx = jmax(mx, samples[i]);
+                        sum += samples[i];
+                    }
+                }
+                else
+                {
+                    const PyramidLevel& below = *pyramid[l - 1];
+                    const float* belowMin = below.runMin.getReadPointer(channel, r * PYRAMID_BASE);
+                    const float* belowMax = below.runMax.getReadPointer(channel, r * PYRAMID_BASE);
+                    const float* belowSum = below.runSum.getReadPointer(channel, r * PYRAMID_BASE);
+                    mn = belowMin[0];
+                    mx = belowMax[0];
+
+                    for (int i = 0; i < PYRAMID_BASE; ++i)
+                    {
+                        mn = jmin(mn, belowMin[i]);
+                        mx = jmax(mx, belowMax[i]);
+                        sum += belowSum[i];
+                    }
+                }
+
+                runMin[r] = mn;
+                runMax[r] = mx;
+                runSum[r] = sum;
+            }
+        }
+    }
 
-        displayBufferIndices.set(channelMap[chan], newIndex);
+    int DisplayBuffer::getRun(int channel, int sample, int maxSamples, float& runMin, float& runMax, float& runSum) const
+    {
+        for (int l = pyramid.size(); --l >= 0;)
+        {
+            const PyramidLevel& level = *pyramid[l];
+
+            if (level.factor <= maxSamples && sample % level.factor == 0)
+            {
+                const int r = sample / level.factor;
+                runMin = level.runMin.getSample(channel, r);
+                runMax = level.runMax.getSample(channel, r);
+                runSum = level.runSum.getSample(channel, r);
+                return level.factor;
+            }
+        }
 
+        runMin = runMax = runSum = getSample(channel, sample);
+        return 1;
     }
 
 };
@@ -24,8 +24,10 @@
 #define __DISPLAYBUFFER_H__
 
 #include <ProcessorHeaders.h>
+#include "DisplayHistory.h"
 
 #include <map>
+#include <atomic>
 
 namespace LfpViewer {
 #pragma  mark - LfpDisplay -
@@ -44,7 +46,8 @@ namespace LfpViewer {
         void prepareToUpdate();
         void update();
 
-        void addChannel(String name, int channelNum, int group = 0, float ypos = 0, String structure = "None");
+        /** Adds a channel and returns its index in this buffer */
+        int addChannel(String name, int channelNum, int group = 0, float ypos = 0, String structure = "None");
 
         void initializeEventChannel(int nSamples);
         void finalizeEventChannel(int nSamples);
@@ -52,9 +55,34 @@ namespace LfpViewer {
         void resetIndices();
 
         void addEvent(int eventTime, int eventChannel, int eventId, int numSourceSamples);
-        void addData(AudioSampleBuffer& buffer, int chan, int nSamples);
 
-        CriticalSection* getMutex() { return &displayMutex; }
+        /** Adds the samples of an input channel to the channel at channelIndex, as returned by
+            addChannel(). When decimating, each window of samples is stored as its min and max. */
+        void addData(AudioSampleBuffer& buffer, int chan, int channelIndex, int nSamples);
+
+        /** Sets the number of source samples per pixel that a display needs, so the buffer can
+            keep the min and max of windows no longer than the finest resolution of its displays */
+        void setDisplayResolution(int splitID, float samplesPerPixel);
+
+        /** Returns the rate of the samples stored in the buffer, after decimation */
+        float getDisplaySampleRate() const;
+
+        /** Incremented by the audio thread each time it switches to a new decimation and resets
+            the indices; displays resynchronize when it changes */
+        int getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+        /** Returns the buffer index of a sample of the current block of the event channel. Only
+            valid on the audio thread, between initializeEventChannel() and finalizeEventChannel(). */
+        int getEventIndex(int sampleInBlock) const;
+
+        /** Returns the index up to which the samples of a channel have been written. Safe to call
+            from any thread while the audio thread is adding data, without taking a lock. */
+        int getIndex(int channel) const { return displayBufferIndices[channel].load(std::memory_order_acquire); }
+
+        /** Finds the longest run of samples of a channel that starts at a sample, is no longer
+            than maxSamples and has been aggregated in the min/max pyramid. Returns its length,
+            1 for a single sample, along with the min, max and sum of its samples. */
+        int getRun(int channel, int sample, int maxSamples, float& runMin, float& runMax, float& runSum) const;
 
         struct ChannelMetadata {
             String name = "";
@@ -71,8 +99,6 @@ namespace LfpViewer {
         int64 bufferIndex;
         std::map<int, int> channelMap;
 
-        Array<int> displayBufferIndices;
-
         int numChannels;
 
         float* arrayOfOnes;
@@ -88,8 +114,6 @@ namespace LfpViewer {
         int latestTriggerTime;
         int latestCurrentTriggerTime;
 
-        CriticalSection displayMutex;
-
         bool isNeeded;
 
         void addDisplay(int splitID);
@@ -98,6 +122,56 @@ namespace LfpViewer {
 
         Array<int> displays;
 
+        /** Scrollback of the buffer's channels, written while LfpDisplayNode::setHistoryEnabled() is on */
+        ScopedPointer<DisplayHistory> history;
+
+    private:
+        /** Number of stored samples that a block's first n samples complete, given the source
+            samples already waiting in the event channel's partial window */
+        int getBlockOffset(int sampleInBlock) const;
+
+        /** Writes the current TTL state to the event channel from a block offset to its end */
+        void fillEventChannel(int blockOffset);
+
+        /** Applies a decimation requested by setDisplayResolution(), on the audio thread */
+        void applyDecimation();
+
+        /** Source samples per stored min/max pair, or 1 to store every sample */
+        std::atomic<int> decimation;
+        std::atomic<int> requestedDecimation;
+        std::atomic<int> generation;
+
+        /** Min and max of each channel's partially filled window, and how many samples it holds */
+        HeapBlock<float> pendingMin;
+        HeapBlock<float> pendingMax;
+        HeapBlock<int> pendingCount;
+
+        /** Event channel window count at the start of the block, and stored samples in the block */
+        int eventBlockPhase;
+        int eventBlockLength;
+
+        std::map<int, float> displayResolutions;
+
+        /** Publishes the new write index of a channel once its samples are in the buffer */
+        void setIndex(int channel, int index) { displayBufferIndices[channel].store(index, std::memory_order_release); }
+
+        /** Write index of each channel, plus the event channel. Only the audio thread writes them,
+            so readers never contend with it. */
+        HeapBlock<std::atomic<int>> displayBufferIndices;
+
+        /** Aggregates the runs of all levels of the pyramid that end in a range of samples
+            that was just written, which may wrap around the end of the buffer */
+        void updatePyramid(int channel, int startSample, int numSamples);
+
+        /** Min, max and sum of consecutive runs of samples of each channel. Each level aggregates
+            a few runs of the one below, so a display can read any timebase in O(pixels). */
+        struct PyramidLevel
+        {
+            int factor;
+            AudioSampleBuffer runMin, runMax, runSum;
+        };
+        OwnedArray<PyramidLevel> pyramid;
+
     };
 };
 
@@ -0,0 +1,230 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "DisplayHistory.h"
+#include "DisplayBuffer.h"
+
+namespace LfpViewer {
+
+    DisplayHistory::DisplayHistory(DisplayBuffer* buffer_) :
+        Thread("LFP display history"),
+        buffer(buffer_), binData(nullptr),
+        numChannels(0), capacity(0), sourcePerBin(1), bufferGeneration(0),
+        numBins(0)
+    {
+    }
+
+    DisplayHistory::~DisplayHistory()
+    {
+        stop();
+    }
+
+    bool DisplayHistory::start()
+    {
+        stop();
+
+        numChannels = buffer->numChannels + 1;
+        sourcePerBin = jmax(1, roundToInt(buffer->sampleRate * getBinDuration()));
+        capacity = HISTORY_MINUTES * 60 * 1000 / HISTORY_BIN_MS;
+
+        // the bins of a channel are contiguous, so a display reads each channel in one sweep
+        const int64 fileSize = int64(numChannels) * capacity * 3 * sizeof(float);
+
+        file = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("lfp-history-" + String(buffer->id), ".bin");
+
+        {
+            FileOutputStream out(file);
+
+            if (out.failedToOpen() || !out.setPosition(fileSize - 1) || !out.writeByte(0))
+            {
+                std::cout << "Could not create the display history file " << file.getFullPathName() << std::endl;
+                file.deleteFile();
+                return false;
+            }
+        }
+
+        mappedFile = new MemoryMappedFile(file, MemoryMappedFile::readWrite);
+
+        if (mappedFile->getData() == nullptr || (int64) mappedFile->getSize() < fileSize)
+        {
+            std::cout << "Could not map the display history file " << file.getFullPathName() << std::endl;
+            mappedFile = nullptr;
+            file.deleteFile();
+            return false;
+        }
+
+        binData = static_cast<float*>(mappedFile->getData());
+
+        readIndices.allocate(numChannels, true);
+        channelBins.allocate(numChannels, true);
+        pendingSource.allocate(numChannels, true);
+        pendingMin.allocate(numChannels, true);
+        pendingMax.allocate(numChannels, true);
+        pendingSum.allocate(numChannels, true);
+        pendingCount.allocate(numChannels, true);
+
+        for (int channel = 0; channel < numChannels; channel++)
+            readIndices[channel] = buffer->getIndex(channel);
+
+        bufferGeneration = buffer->getGeneration();
+        numBins.store(0, std::memory_order_release);
+
+        ThreadConfig::startThread(*this, ThreadConfig::RECORD_IO);
+
+        return true;
+    }
+
+    void DisplayHistory::stop()
+    {
+        stopThread(1000);
+
+        binData = nullptr;
+        mappedFile = nullptr;
+
+        if (file != File())
+        {
+            file.deleteFile();
+            file = File();
+        }
+
+        numBins.store(0, std::memory_order_release);
+    }
+
+    void DisplayHistory::run()
+    {
+        while (!threadShouldExit())
+        {
+            ThreadConfig::applyToCurrentThread(ThreadConfig::RECORD_IO);
+
+            // a new decimation restarts the buffer from index 0; the samples of the old one
+            // that weren't read yet are lost, which only shifts the history by a few ms
+            const int generation = buffer->getGeneration();
+
+            if (generation != bufferGeneration)
+            {
+                bufferGeneration = generation;
+
+                for (int channel = 0; channel < numChannels; channel++)
+                    readIndices[channel] = 0;
+            }
+
+            const float displayRate = buffer->getDisplaySampleRate();
+            const int sourcePerSample = jmax(1, roundToInt(buffer->sampleRate / displayRate));
+
+            int64 written = -1;
+
+            for (int channel = 0; channel < numChannels; channel++)
+            {
+                readChannel(channel, buffer->getIndex(channel), sourcePerSample);
+                written = written < 0 ? channelBins[channel] : jmin(written, channelBins[channel]);
+            }
+
+            // the bins are in the file before they are published
+            numBins.store(jmax(int64(0), written), std::memory_order_release);
+
+            wait(HISTORY_POLL_MS);
+        }
+    }
+
+    void DisplayHistory::readChannel(int channel, int newIndex, int sourcePerSample)
+    {
+        const int bufferSize = buffer->getNumSamples();
+        int index = readIndices[channel];
+
+        int newSamples = newIndex - index;
+
+        if (newSamples < 0)
+            newSamples += bufferSize;
+
+        const float* samples = buffer->getReadPointer(channel);
+
+        while (newSamples > 0)
+        {
+            // samples up to the end of the bin, or of the buffer
+            const int toBinEnd = (sourcePerBin - pendingSource[channel] + sourcePerSample - 1) / sourcePerSample;
+            const int count = jmin(newSamples, jmax(1, toBinEnd), bufferSize - index);
+
+            const Range<float> range = FloatVectorOperations::findMinAndMax(samples + index, count);
+
+            double sum = 0;
+            for (int i = 0; i < count; i++)
+                sum += samples[index + i];
+
+            pendingMin[channel] = pendingCount[channel] == 0 ? range.getStart() : jmin(pendingMin[channel], range.getStart());
+            pendingMax[channel] = pendingCount[channel] == 0 ? range.getEnd() : jmax(pendingMax[channel], range.getEnd());
+            pendingSum[channel] += sum;
+            pendingCount[channel] += count;
+            pendingSource[channel] += count * sourcePerSample;
+
+            const float lastValue = samples[index + count - 1];
+
+            // a sample longer than a bin fills several
+            while (pendingSource[channel] >= sourcePerBin)
+            {
+                writeBin(channel, lastValue);
+                pendingSource[channel] -= sourcePerBin;
+            }
+
+            index = (index + count) % bufferSize;
+            newSamples -= count;
+        }
+
+        readIndices[channel] = index;
+    }
+
+    void DisplayHistory::writeBin(int channel, float lastValue)
+    {
+        float* bin = getBin(channel, channelBins[channel]);
+
+        if (pendingCount[channel] > 0)
+        {
+            bin[0] = pendingMin[channel];
+            bin[1] = pendingMax[channel];
+            bin[2] = float(pendingSum[channel] / pendingCount[channel]);
+        }
+        else
+        {
+            bin[0] = bin[1] = bin[2] = lastValue;
+        }
+
+        pendingSum[channel] = 0;
+        pendingCount[channel] = 0;
+        channelBins[channel]++;
+    }
+
+    void DisplayHistory::getRange(int channel, int64 firstBin, int count, float& rangeMin, float& rangeMax, float& rangeMean) const
+    {
+        double sum = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            const float* bin = getBin(channel, firstBin + i);
+
+            rangeMin = i == 0 ? bin[0] : jmin(rangeMin, bin[0]);
+            rangeMax = i == 0 ? bin[1] : jmax(rangeMax, bin[1]);
+            sum += bin[2];
+        }
+
+        rangeMean = float(sum / jmax(1, count));
+    }
+};
@@ -0,0 +1,122 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __DISPLAYHISTORY_H__
+#define __DISPLAYHISTORY_H__
+
+#include <ProcessorHeaders.h>
+
+#include <atomic>
+
+/* Source time aggregated in each bin of the history */
+#define HISTORY_BIN_MS 5
+
+/* Length of the history kept for each display buffer */
+#define HISTORY_MINUTES 5
+
+/* How often the writer thread moves new samples from the display buffer into the history */
+#define HISTORY_POLL_MS 20
+
+namespace LfpViewer {
+
+    class DisplayBuffer;
+
+    //==============================================================================
+    /**
+        A multi-minute ring of the min, max and mean of a DisplayBuffer's channels, in bins
+        of HISTORY_BIN_MS of source time, kept in a memory-mapped temporary file.
+
+        The DisplayBuffer only holds a second or so of each channel. A background thread
+        follows its write indices, the same way the displays do, and adds a bin to each
+        channel every HISTORY_BIN_MS, so a paused display can scroll back through the last
+        HISTORY_MINUTES without touching the audio thread or the recording.
+
+        @see DisplayBuffer, LfpDisplaySplitter
+    */
+    class DisplayHistory : private Thread
+    {
+    public:
+        DisplayHistory(DisplayBuffer* buffer);
+        ~DisplayHistory();
+
+        /** Creates the file for the buffer's current channels and starts following the
+            buffer from its current indices. Returns false if the file could not be mapped. */
+        bool start();
+
+        /** Stops the writer thread and deletes the file */
+        void stop();
+
+        bool isRunning() const { return isThreadRunning(); }
+
+        /** Number of bins written to every channel since start(). Only the last
+            getCapacity() of them are kept. */
+        int64 getNumBins() const { return numBins.load(std::memory_order_acquire); }
+
+        int getCapacity() const { return capacity; }
+
+        /** Channels of the history, the buffer's event channel last */
+        int getNumChannels() const { return numChannels; }
+
+        static float getBinDuration() { return HISTORY_BIN_MS / 1000.0f; }
+
+        /** Min, max and mean of a channel over numBins bins from firstBin, which must
+            still be kept in the ring */
+        void getRange(int channel, int64 firstBin, int numBins, float& rangeMin, float& rangeMax, float& rangeMean) const;
+
+    private:
+        void run() override;
+
+        /** Adds the samples of a channel written to the buffer since the last pass */
+        void readChannel(int channel, int newIndex, int sourcePerSample);
+
+        /** Stores a channel's pending bin, or a single value if the bin is empty */
+        void writeBin(int channel, float lastValue);
+
+        float* getBin(int channel, int64 bin) const { return binData + (channel * (size_t) capacity + size_t(bin % capacity)) * 3; }
+
+        DisplayBuffer* buffer;
+
+        File file;
+        ScopedPointer<MemoryMappedFile> mappedFile;
+        float* binData;
+
+        int numChannels;
+        int capacity;
+        int sourcePerBin;
+        int bufferGeneration;
+
+        /** Read index, bins written and pending bin of each channel, only touched by the writer thread */
+        HeapBlock<int> readIndices;
+        HeapBlock<int64> channelBins;
+        HeapBlock<int> pendingSource;
+        HeapBlock<float> pendingMin;
+        HeapBlock<float> pendingMax;
+        HeapBlock<double> pendingSum;
+        HeapBlock<int> pendingCount;
+
+        std::atomic<int64> numBins;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DisplayHistory);
+    };
+};
+
+#endif //__DISPLAYHISTORY_H__
@@ -47,6 +47,13 @@ public:
     /** Plots one subsample of data from a single channel to the bitmap provided */
     virtual void plot(Image::BitmapData &bitmapData, LfpBitmapPlotterInfo &plotterInfo) = 0;
     
+    /** Called before the channels plot the columns from fromColumn to toColumn, which wrap
+        around the end of the bitmap if toColumn < fromColumn */
+    virtual void beginPlot(int fromColumn, int toColumn, bool fullRedraw) {}
+    
+    /** Called once all channels have plotted their new columns */
+    virtual void endPlot() {}
+    
 protected:
     LfpDisplay * display;
 };
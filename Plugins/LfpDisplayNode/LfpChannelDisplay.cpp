@@ -174,6 +174,11 @@ void LfpChannelDisplay::pxPaint()
     }
     
     bool drawWithOffsetCorrection = display->getMedianOffsetPlotting();
+
+    // the same offset for the whole channel, kept up to date by the splitter as pixels arrive
+    const double mean = drawWithOffsetCorrection
+                      ? canvasSplit->getMedianOffset(chan) / range * channelHeightFloat
+                      : 0.0;
     
     LfpBitmapPlotterInfo plotterInfo; // hold and pass plotting info for each plotting method class
     
@@ -192,7 +197,7 @@ void LfpChannelDisplay::pxPaint()
             
         if (m > 0 && m < display->lfpChannelBitmap.getHeight())
         {
-            if ( bdLfpChannelBitmap.getPixelColour(i,m) == display->getColourSchemePtr()->getBackgroundColour() ) { // make sure we're not drawing over an existing plot from another channel
+            if ( bdLfpChannelBitmap.getPixelColour(i,m) == display->getBitmapBackgroundColour() ) { // make sure we're not drawing over an existing plot from another channel
                 bdLfpChannelBitmap.setPixelColour(i,m,Colour(50,50,50));
             }
         }
@@ -207,30 +212,13 @@ void LfpChannelDisplay::pxPaint()
             {
                 if (m > 0 && m < display->lfpChannelBitmap.getHeight())
                 {
-                    if ( bdLfpChannelBitmap.getPixelColour(i,m) == display->getColourSchemePtr()->getBackgroundColour()) // make sure we're not drawing over an existing plot from another channel
+                    if ( bdLfpChannelBitmap.getPixelColour(i,m) == display->getBitmapBackgroundColour()) // make sure we're not drawing over an existing plot from another channel
                         bdLfpChannelBitmap.setPixelColour(i, m, Colour(80,80,80));
                 }
             }
         }
             
-        // draw event markers
-        int rawEventState = canvasSplit->getEventState(i); // get event state
-            
-        for (int ev_ch = 0; ev_ch < 8; ev_ch++) // for all event channels
-        {
-            if (display->getEventDisplayState(ev_ch))  // check if plotting for this channel is enabled
-            {
-                if (rawEventState & (1 << ev_ch))    // events are  representet by a bit code, so we have to extract the individual bits with a mask
-                {
-                    //                        std::cout << "Drawing event." << std::endl;
-                    Colour currentcolor = display->channelColours[ev_ch * 2];
-
-                    for (int k = jfrom_wholechannel; k <= jto_wholechannel; k++) // draw line
-                        bdLfpChannelBitmap.setPixelColour(i, k, bdLfpChannelBitmap.getPixelColour(i, k).interpolatedWith(currentcolor, 0.3f));
-
-                }
-            }
-        }
+        // event markers are drawn for all channels at once by LfpDisplay::drawEventOverlay()
  
         //std::cout << "e " << canvas->getYCoord(canvas->getNumChannels()-1, i) << std::endl;
             
@@ -238,8 +226,6 @@ void LfpChannelDisplay::pxPaint()
         double a = (canvasSplit->getYCoordMax(chan, i)/range*channelHeightFloat);
         double b = (canvasSplit->getYCoordMin(chan, i)/range*channelHeightFloat);
             
-        double mean = (canvasSplit->getMean(chan)/range*channelHeightFloat);
-            
         if (drawWithOffsetCorrection)
         {
             a -= mean;
@@ -0,0 +1,139 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2021 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "LfpChannelRasterizer.h"
+#include "LfpChannelDisplay.h"
+
+using namespace LfpViewer;
+
+#define MAX_RASTER_WORKERS 7
+
+#pragma  mark - LfpChannelRasterizer -
+
+LfpChannelRasterizer::LfpChannelRasterizer()
+    : currentChannels(nullptr)
+    , currentPhase(0)
+    , numPhaseBands(0)
+{
+    const int numWorkers = jmin(SystemStats::getNumCpus() - 1, MAX_RASTER_WORKERS);
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        Worker* worker = new Worker(*this, i + 1);
+        workers.add(worker);
+        worker->startThread();
+    }
+}
+
+LfpChannelRasterizer::~LfpChannelRasterizer()
+{
+    for (auto worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->startPhase.signal();
+    }
+
+    for (auto worker : workers)
+        worker->stopThread(1000);
+}
+
+void LfpChannelRasterizer::paint(const Array<LfpChannelDisplay*>& channels, int minChannelsPerBand)
+{
+    const int numChannels = channels.size();
+    const int numBands = jmin(2 * (workers.size() + 1), numChannels / jmax(1, minChannelsPerBand));
+
+    // too few channels to keep concurrent bands apart
+    if (workers.size() == 0 || numBands < 3)
+    {
+        for (int i = 0; i < numChannels; i++)
+            channels[i]->pxPaint();
+
+        return;
+    }
+
+    currentChannels = &channels;
+
+    bandStarts.clearQuick();
+
+    for (int band = 0; band <= numBands; band++)
+        bandStarts.add(band * numChannels / numBands);
+
+    for (int phase = 0; phase < 2; phase++)
+    {
+        currentPhase = phase;
+        numPhaseBands = (numBands - phase + 1) / 2;
+        nextBand.set(0);
+        pendingWorkers.set(workers.size());
+
+        for (auto worker : workers)
+            worker->startPhase.signal();
+
+        paintBands();
+
+        phaseDone.wait();
+    }
+
+    currentChannels = nullptr;
+}
+
+void LfpChannelRasterizer::paintBands()
+{
+    while (true)
+    {
+        const int k = (nextBand += 1) - 1;
+
+        if (k >= numPhaseBands)
+            break;
+
+        const int band = 2 * k + currentPhase;
+
+        for (int i = bandStarts[band]; i < bandStarts[band + 1]; i++)
+            (*currentChannels)[i]->pxPaint();
+    }
+}
+
+void LfpChannelRasterizer::finishPhase()
+{
+    if ((pendingWorkers -= 1) == 0)
+        phaseDone.signal();
+}
+
+LfpChannelRasterizer::Worker::Worker(LfpChannelRasterizer& rasterizer_, int index)
+    : Thread("LFP raster " + String(index))
+    , rasterizer(rasterizer_)
+{
+}
+
+void LfpChannelRasterizer::Worker::run()
+{
+    while (true)
+    {
+        startPhase.wait();
+
+        if (threadShouldExit())
+            break;
+
+        rasterizer.paintBands();
+        rasterizer.finishPhase();
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __LFPCHANNELRASTERIZER_H__
+#define __LFPCHANNELRASTERIZER_H__
+
+#include <VisualizerWindowHeaders.h>
+
+#include "LfpDisplayClasses.h"
+
+namespace LfpViewer {
+#pragma  mark - LfpChannelRasterizer -
+//==============================================================================
+/**
+    Calls LfpChannelDisplay::pxPaint() for a list of channels on a small pool
+    of worker threads, shared by all LfpDisplays through a SharedResourcePointer.
+
+    The channels are split into bands of neighbouring channels. Traces can
+    spill into the rows of the next channels when they overlap, so the even
+    bands are painted first and the odd bands after them; two bands that run
+    at the same time are always separated by a whole band. paint() returns
+    once every channel is done, so the bitmap can be blitted right after it.
+
+    Only pxPaint() runs on the workers; Component calls such as repaint()
+    must stay on the message thread.
+
+    @see LfpDisplay::refresh
+ */
+class LfpChannelRasterizer
+{
+public:
+    LfpChannelRasterizer();
+    ~LfpChannelRasterizer();
+
+    /** Paints the channels in order of their position in the bitmap, with bands of
+        at least minChannelsPerBand channels */
+    void paint(const Array<LfpChannelDisplay*>& channels, int minChannelsPerBand);
+
+private:
+    class Worker : public Thread
+    {
+    public:
+        Worker(LfpChannelRasterizer& rasterizer, int index);
+        void run() override;
+
+        WaitableEvent startPhase;
+
+    private:
+        LfpChannelRasterizer& rasterizer;
+    };
+
+    void paintBands();
+    void finishPhase();
+
+    OwnedArray<Worker> workers;
+
+    WaitableEvent phaseDone;
+    Atomic<int> nextBand;
+    Atomic<int> pendingWorkers;
+
+    const Array<LfpChannelDisplay*>* currentChannels;
+    Array<int> bandStarts;
+    int currentPhase;
+    int numPhaseBands;
+
+    JUCE_DECLARE_NON_COPYABLE(LfpChannelRasterizer);
+};
+
+}; // namespace
+#endif
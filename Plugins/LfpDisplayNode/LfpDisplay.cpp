@@ -35,6 +35,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "LfpBitmapPlotter.h"
 #include "PerPixelBitmapPlotter.h"
 #include "SupersampledBitmapPlotter.h"
+#include "OpenGLTracePlotter.h"
+#include "LfpChannelRasterizer.h"
 
 #include "ColourSchemes/DefaultColourScheme.h"
 #include "ColourSchemes/MonochromeGrayColourScheme.h"
@@ -50,6 +52,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace LfpViewer;
 
+namespace
+{
+    /** Orders channel displays from the top of the bitmap to the bottom */
+    struct ChannelPositionSorter
+    {
+        static int compareElements(LfpChannelDisplay* first, LfpChannelDisplay* second)
+        {
+            return first->getY() - second->getY();
+        }
+    };
+}
+
 #pragma  mark - LfpDisplay -
 // ---------------------------------------------------------------
 
@@ -61,9 +75,12 @@ LfpDisplay::LfpDisplay(LfpDisplaySplitter* c, Viewport* v)
     , channelsOrderedByDepth(false)
     , displaySkipAmt(0)
     , m_SpikeRasterPlottingFlag(false)
+    , drawMethod(false)
+    , openGLRendering(false)
 {
     perPixelPlotter = new PerPixelBitmapPlotter(this);
     supersampledPlotter = new SupersampledBitmapPlotter(this);
+    openGLPlotter = new OpenGLTracePlotter(this);
     
     colourSchemeList.add(new DefaultColourScheme(this, canvasSplit));
     colourSchemeList.add(new MonochromeGrayColourScheme(this, canvasSplit));
@@ -334,9 +351,7 @@ void LfpDisplay::resized()
 
 
     //inititalize background
-    Graphics gLfpChannelBitmap(lfpChannelBitmap);
-    gLfpChannelBitmap.setColour(getColourSchemePtr()->getBackgroundColour()); //background color
-    gLfpChannelBitmap.fillRect(0,0, lfpChannelBitmap.getWidth(), lfpChannelBitmap.getHeight());
+    lfpChannelBitmap.clear(lfpChannelBitmap.getBounds(), getBitmapBackgroundColour()); //background color
 
     canvasSplit->fullredraw = true;
     
@@ -348,13 +363,15 @@ void LfpDisplay::resized()
 
 void LfpDisplay::paint(Graphics& g)
 {
-    
+    TRACE_SCOPE("visualizer", "LfpDisplay paint");
+
     g.drawImageAt(lfpChannelBitmap, canvasSplit->leftmargin, 0);
     
 }
 
 void LfpDisplay::refresh()
 {
+    TRACE_SCOPE("visualizer", "LfpDisplay refresh");
 
     if (numChans == 0)
         return;
@@ -376,26 +393,27 @@ void LfpDisplay::refresh()
     int bottomBorder = viewport->getViewHeight() + topBorder;
 
     // clear appropriate section of the bitmap --
-    // we need to do this before each channel draws its new section of data into lfpChannelBitmap
-    Graphics gLfpChannelBitmap(lfpChannelBitmap);
-    gLfpChannelBitmap.setColour(getColourSchemePtr()->getBackgroundColour()); //background color
+    // we need to do this before each channel draws its new section of data into lfpChannelBitmap.
+    // Image::clear() replaces the pixels, so this also works for the transparent background
+    // used when the traces are rendered with OpenGL
+    const Colour bitmapBackground = getBitmapBackgroundColour();
 
     if (canvasSplit->fullredraw)
     {
-        gLfpChannelBitmap.fillRect(0, 0, lfpChannelBitmap.getWidth(), lfpChannelBitmap.getHeight());
+        lfpChannelBitmap.clear(lfpChannelBitmap.getBounds(), bitmapBackground);
         
     }
     else {
 
         if (fillfrom < fillto)
         {
-            gLfpChannelBitmap.fillRect(fillfrom, 0, (fillto - fillfrom) + 2, lfpChannelBitmap.getHeight()); // just clear one section
+            lfpChannelBitmap.clear(Rectangle<int>(fillfrom, 0, (fillto - fillfrom) + 2, lfpChannelBitmap.getHeight()), bitmapBackground); // just clear one section
             //std::cout << "Clearing " << fillfrom << " to " << fillto << std::endl;
         }
         else if (fillfrom > fillto) {
 
-            gLfpChannelBitmap.fillRect(fillfrom, 0, lfpChannelBitmap.getWidth() - fillfrom + 2, lfpChannelBitmap.getHeight()); // first segment
-            gLfpChannelBitmap.fillRect(0, 0, fillto + 2, lfpChannelBitmap.getHeight()); // second segment
+            lfpChannelBitmap.clear(Rectangle<int>(fillfrom, 0, lfpChannelBitmap.getWidth() - fillfrom + 2, lfpChannelBitmap.getHeight()), bitmapBackground); // first segment
+            lfpChannelBitmap.clear(Rectangle<int>(0, 0, fillto + 2, lfpChannelBitmap.getHeight()), bitmapBackground); // second segment
 
             //std::cout << "Clearing " << fillfrom << " to " << lfpChannelBitmap.getWidth() << std::endl;
             //std::cout << "Clearing " << 0 << " to " << fillto << std::endl;
@@ -406,8 +424,10 @@ void LfpDisplay::refresh()
         
     }
 
+    plotter->beginPlot(fillfrom, fillto, canvasSplit->fullredraw);
+
+    channelsToPaint.clearQuick();
 
-    
     for (int i = 0; i < numChans; i++)
     {
 
@@ -417,17 +437,55 @@ void LfpDisplay::refresh()
         if ((topBorder <= componentBottom && bottomBorder >= componentTop)) // only draw things that are visible
         {
             if (canvasSplit->fullredraw)
-            {
                 channels[i]->fullredraw = true;
-                channels[i]->pxPaint();
+
+            // fill in the screen buffer if the channel was skipped while it was off-screen
+            if (isChannelVisible(i))
+                canvasSplit->materializeChannel(i);
+
+            channelsToPaint.add(channels[i]);
+        }
+    }
+
+    // draws to lfpChannelBitmap on the rasterizer's threads; bands are formed from
+    // neighbouring channels, so sort them by their position in the bitmap
+    ChannelPositionSorter sorter;
+    channelsToPaint.sort(sorter, true);
+
+    // under the traces, which are drawn over it
+    if (canvasSplit->fullredraw)
+    {
+        drawEventOverlay(0, lfpChannelBitmap.getWidth());
+    }
+    else if (fillfrom < fillto)
+    {
+        drawEventOverlay(fillfrom, fillto);
+    }
+    else if (fillfrom > fillto)
+    {
+        drawEventOverlay(fillfrom, lfpChannelBitmap.getWidth());
+        drawEventOverlay(0, fillto);
+    }
+
+    // a trace reaches channelOverlapFactor channel heights past its centre
+    const int minChannelsPerBand = jmax(2, (int) std::ceil(2.0f * canvasSplit->channelOverlapFactor) + 1);
+
+    rasterizer->paint(channelsToPaint, minChannelsPerBand);
+
+    for (int i = 0; i < numChans; i++)
+    {
+
+        int componentTop = channels[i]->getY();
+        int componentBottom = channels[i]->getHeight() + componentTop;
+
+        if ((topBorder <= componentBottom && bottomBorder >= componentTop)) // only draw things that are visible
+        {
+            if (canvasSplit->fullredraw)
+            {
                 channelInfo[i]->repaint();
             }
             else
             {
-                
-
-                 channels[i]->pxPaint(); // draws to lfpChannelBitmap
-                
                  // it's not clear why, but apparently because the pxPaint() is in a child component of LfpDisplay, 
                  // we also need to issue repaint() calls for each channel, even though there's nothing 
                  // to repaint there. Otherwise, the repaint call in LfpDisplay::refresh(), a few lines down, 
@@ -452,6 +510,17 @@ void LfpDisplay::refresh()
 
     }
 
+    plotter->endPlot();
+
+    if (openGLRendering)
+    {
+        openGLPlotter->setViewArea(Rectangle<int>(canvasSplit->leftmargin - viewport->getViewPositionX(),
+                                                  -viewport->getViewPositionY(),
+                                                  lfpChannelBitmap.getWidth(),
+                                                  lfpChannelBitmap.getHeight()),
+                                   getColourSchemePtr()->getBackgroundColour());
+    }
+
     if (fillfrom == 0 && singleChan != -1)
     {
         channelInfo[singleChan]->repaint();
@@ -469,6 +538,52 @@ void LfpDisplay::refresh()
     //std::cout << "REFRESH" << std::endl;
 }
 
+void LfpDisplay::drawEventOverlay(int fromColumn, int toColumn)
+{
+    if (channelsToPaint.size() == 0)
+        return;
+
+    int shownChannels = 0;
+
+    for (int ev_ch = 0; ev_ch < 8; ev_ch++)
+    {
+        if (getEventDisplayState(ev_ch))
+            shownChannels |= 1 << ev_ch;
+    }
+
+    const int top = jmax(0, channelsToPaint.getFirst()->getY());
+    const int bottom = jmin(lfpChannelBitmap.getHeight(), channelsToPaint.getLast()->getBottom());
+
+    if (shownChannels == 0 || bottom <= top)
+        return;
+
+    Graphics g(lfpChannelBitmap);
+
+    int spanStart = fromColumn;
+    int spanState = 0;
+
+    // the column past the end closes the last span
+    for (int i = fromColumn; i <= toColumn; i++)
+    {
+        const int state = i < toColumn ? (int(canvasSplit->getEventState(i)) & shownChannels) : 0;
+
+        if (state == spanState)
+            continue;
+
+        for (int ev_ch = 0; ev_ch < 8; ev_ch++)
+        {
+            if (spanState & (1 << ev_ch))
+            {
+                g.setColour(channelColours[ev_ch * 2].withAlpha(0.3f));
+                g.fillRect(spanStart, top, i - spanStart, bottom - top);
+            }
+        }
+
+        spanStart = i;
+        spanState = state;
+    }
+}
+
 void LfpDisplay::setRange(float r, DataChannel::DataChannelTypes type)
 {
     range[type] = r;
@@ -554,7 +669,13 @@ void LfpDisplay::setDrawMethod(bool isDrawMethod)
         channels[i]->setDrawMethod(isDrawMethod);
     }
     
-    if (isDrawMethod)
+    drawMethod = isDrawMethod;
+    
+    if (openGLRendering)
+    {
+        ; // the GPU plotter draws min-max segments regardless of the draw method
+    }
+    else if (isDrawMethod)
     {
         plotter = supersampledPlotter;
     }
@@ -567,6 +688,45 @@ void LfpDisplay::setDrawMethod(bool isDrawMethod)
 
 }
 
+void LfpDisplay::setOpenGLRendering(bool state)
+{
+    if (state == openGLRendering)
+        return;
+    
+    openGLRendering = state;
+    
+    if (openGLRendering)
+    {
+        // the segments are built from the per-pixel plotter info
+        for (int i = 0; i < numChans; i++)
+            channels[i]->setDrawMethod(false);
+        
+        plotter = openGLPlotter;
+        openGLPlotter->attachTo(*viewport);
+    }
+    else
+    {
+        openGLPlotter->detach();
+        setDrawMethod(drawMethod);
+        return;
+    }
+    
+    resized();
+}
+
+bool LfpDisplay::getOpenGLRendering()
+{
+    return openGLRendering;
+}
+
+Colour LfpDisplay::getBitmapBackgroundColour()
+{
+    if (openGLRendering)
+        return Colours::transparentBlack;
+    
+    return getColourSchemePtr()->getBackgroundColour();
+}
+
 int LfpDisplay::getChannelHeight()
 {
 //    return cachedDisplayChannelHeight;
@@ -1097,6 +1257,22 @@ void LfpDisplay::rebuildDrawableChannelsList()
    // std::cout << "Finished standard channel rebuild" << std::endl;
 }
 
+bool LfpDisplay::isChannelVisible(int chan)
+{
+    if (chan < 0 || chan >= numChans)
+        return false;
+    
+    LfpChannelDisplay* channel = channels[chan];
+    
+    if (!channel->getEnabledState() || channel->getHidden())
+        return false;
+    
+    const int topBorder = viewport->getViewPositionY();
+    const int bottomBorder = viewport->getViewHeight() + topBorder;
+    
+    return topBorder <= channel->getBottom() && bottomBorder >= channel->getY();
+}
+
 LfpBitmapPlotter * const LfpDisplay::getPlotterPtr() const
 {
     return plotter;
@@ -88,6 +88,16 @@ public:
     void setInputInverted(bool);
     void setDrawMethod(bool);
     
+    /** Draws the traces with the GPU plotter behind the bitmap when state == true */
+    void setOpenGLRendering(bool state);
+    
+    /** Returns true if the traces are drawn with the GPU plotter */
+    bool getOpenGLRendering();
+    
+    /** Returns the colour that clears lfpChannelBitmap, which is transparent when the
+        traces are rendered underneath it */
+    Colour getBitmapBackgroundColour();
+    
     /** Returns a bool indicating if the channels are displayed in reverse order (true) */
     bool getChannelsReversed();
     
@@ -177,6 +187,10 @@ public:
     /** Reconstructs the list of drawableChannels based on ordering and filterning parameters */
     void rebuildDrawableChannelsList();
     
+    /** Returns true if a channel is enabled, not hidden, and at least partly inside the
+        visible area of the viewport */
+    bool isChannelVisible(int chan);
+    
     /** Returns a const pointer to the internally managed plotter method class */
     LfpBitmapPlotter * const getPlotterPtr() const;
 
@@ -249,6 +263,18 @@ private:
     
     ScopedPointer<PerPixelBitmapPlotter> perPixelPlotter;
     ScopedPointer<SupersampledBitmapPlotter> supersampledPlotter;
+    ScopedPointer<OpenGLTracePlotter> openGLPlotter;
+    
+    bool drawMethod;
+    bool openGLRendering;
+    
+    SharedResourcePointer<LfpChannelRasterizer> rasterizer;
+    Array<LfpChannelDisplay*> channelsToPaint;
+
+    /** Tints the columns from fromColumn up to toColumn where the event channels shown are
+        on, over the channels to paint. Columns with the same event state are filled as one
+        span per event channel. */
+    void drawEventOverlay(int fromColumn, int toColumn);
 
     // TODO: (kelly) add reference to a color scheme
 //    LfpChannelColourScheme * colourScheme;
@@ -245,7 +245,7 @@ void LfpDisplayCanvas::beginAnimation()
             split->beginAnimation();
         }
 
-        //startCallbacks();
+        startCallbacks();
     }    
 }
 
@@ -257,7 +257,8 @@ void LfpDisplayCanvas::endAnimation()
         {
             split->endAnimation();
         }
-        //stopCallbacks();
+
+        stopCallbacks();
     }
 }
 
@@ -619,14 +620,20 @@ void LfpDisplayCanvas::paint(Graphics& g)
 
 void LfpDisplayCanvas::refresh()
 {
-    /*if (true)
-    { 
-        for (auto split : displaySplits)
-        {
-            if (split->isVisible())
-                 split->refresh();
-        }
-    }*/
+    // called by the VisualizationScheduler while acquisition is running
+    for (auto split : displaySplits)
+    {
+        if (split->isVisible())
+             split->refresh();
+    }
+}
+
+void LfpDisplayCanvas::setHistory(bool state)
+{
+    processor->setHistoryEnabled(state);
+
+    for (auto split : displaySplits)
+        split->options->setHistory(state);
 }
 
 void LfpDisplayCanvas::redrawAll()
@@ -754,6 +761,15 @@ LfpDisplaySplitter::LfpDisplaySplitter(LfpDisplayNode* node,
 
     isSelected = false;
 
+    // before the options, which set the timebase
+    historyScrollBar = new ScrollBar(false);
+    historyScrollBar->setAutoHide(false);
+    historyScrollBar->addListener(this);
+    addChildComponent(historyScrollBar);
+
+    showingHistory = false;
+    historyEndBin = 0;
+
     viewport = new LfpViewport(this);
     lfpDisplay = new LfpDisplay(this, viewport);
     timescale = new LfpTimescale(this, lfpDisplay);
@@ -787,6 +803,9 @@ LfpDisplaySplitter::LfpDisplaySplitter(LfpDisplayNode* node,
     isLoading = true;
     isUpdating = false;
 
+    requestedResolution = -1.0f;
+    bufferGeneration = 0;
+
     displayBuffer = nullptr;
 
 }
@@ -816,13 +835,18 @@ void LfpDisplaySplitter::resized()
 
     timescale->setBounds(leftmargin, 0, getWidth() - scrollBarThickness - leftmargin, timescaleHeight);
 
+    // the history scroll bar takes a strip under the timescale while it is shown
+    const int historyHeight = showingHistory ? 12 : 0;
+
+    historyScrollBar->setBounds(leftmargin, timescaleHeight, getWidth() - scrollBarThickness - leftmargin, historyHeight);
+
     if (canvas->makeRoomForOptions(splitID))
     {
-        viewport->setBounds(0, timescaleHeight, getWidth(), getHeight() - 87);
+        viewport->setBounds(0, timescaleHeight + historyHeight, getWidth(), getHeight() - 87 - historyHeight);
     }
     else
     {
-        viewport->setBounds(0, timescaleHeight, getWidth(), getHeight() - 32);
+        viewport->setBounds(0, timescaleHeight + historyHeight, getWidth(), getHeight() - 32 - historyHeight);
     }
 
     if (screenBufferMean != nullptr)
@@ -892,19 +916,18 @@ void LfpDisplaySplitter::beginAnimation()
 
     }    
 
-    startTimer(20);
-
     reachedEnd = true;
 }
 
 void LfpDisplaySplitter::endAnimation()
 {
-    stopTimer();
-}
-
-void LfpDisplaySplitter::timerCallback()
-{
-    refresh();
+    // the history is deleted when acquisition stops
+    if (showingHistory)
+    {
+        showingHistory = false;
+        historyScrollBar->setVisible(false);
+        resized();
+    }
 }
 
 void LfpDisplaySplitter::select()
@@ -980,7 +1003,9 @@ void LfpDisplaySplitter::updateSettings()
         displayBufferSize = displayBuffer->getNumSamples();
         nChans = displayBuffer->numChannels;
         //resizeSamplesPerPixelBuffer(nChans);
-        sampleRate = displayBuffer->sampleRate;
+        sampleRate = displayBuffer->getDisplaySampleRate();
+        bufferGeneration = displayBuffer->getGeneration();
+        requestedResolution = -1.0f;
 
         options->setEnabled(true);
         channelOverlapFactor = options->selectedOverlapValue.getFloatValue();
@@ -1118,6 +1143,16 @@ void LfpDisplaySplitter::syncDisplay()
 
     }
 
+    medianEstimators.resize(nChans);
+    medianOffsets.resize(nChans);
+    hasMedianOffset.resize(nChans);
+
+    for (int channel = 0; channel < nChans; channel++)
+    {
+        medianEstimators.getReference(channel).reset();
+        hasMedianOffset.set(channel, false);
+    }
+
     syncDisplayBuffer();
 
 }
@@ -1131,7 +1166,7 @@ void LfpDisplaySplitter::syncDisplayBuffer()
 
     for (int channel = 0; channel <= nChans; channel++)
     {
-        displayBufferIndex.set(channel, displayBuffer->displayBufferIndices[channel]);
+        displayBufferIndex.set(channel, displayBuffer->getIndex(channel));
         leftOverSamples.set(channel, 0.0f);
     }
 
@@ -1146,6 +1181,24 @@ void LfpDisplaySplitter::updateScreenBuffer()
         int maxSamples = lfpDisplay->getWidth() - leftmargin; // leftmargin accounts for the fact that the display doesn't start
                                                               // at the leftmost pixel
 
+        // the display buffer keeps min/max windows no wider than the finest pixel of its displays
+        const float resolution = displayBuffer->sampleRate * timebase / float(maxSamples);
+
+        if (resolution != requestedResolution)
+        {
+            displayBuffer->setDisplayResolution(splitID, resolution);
+            requestedResolution = resolution;
+        }
+
+        // the buffer switched to another decimation and restarted from index 0
+        if (displayBuffer->getGeneration() != bufferGeneration)
+        {
+            bufferGeneration = displayBuffer->getGeneration();
+            sampleRate = displayBuffer->getDisplaySampleRate();
+            syncDisplayBuffer();
+            return;
+        }
+
         int triggerTime = triggerChannel >=0 
                           ? processor->getLatestTriggerTime(splitID)
                           : -1;
@@ -1158,16 +1211,18 @@ void LfpDisplaySplitter::updateScreenBuffer()
             //    syncDisplay();
         }
                 
+        // channels that can't be seen are skipped, and rebuilt by materializeChannel() once they
+        // are scrolled in. Triggered and paused displays keep history that can't be rebuilt.
+        const bool skipHiddenChannels = triggerChannel < 0 && !lfpDisplay->isPaused;
+
+        staleChannels.resize(nChans + 1);
+
         for (int channel = 0; channel <= nChans; channel++) // pull one extra channel for event display
         {
             
             int dbi = displayBufferIndex[channel]; // display buffer index from the last round of drawing
 
-            int newDisplayBufferIndex;
-            {
-                ScopedLock displayLock(*displayBuffer->getMutex());
-                newDisplayBufferIndex = displayBuffer->displayBufferIndices[channel]; // get the latest value from the display buffer
-            }
+            int newDisplayBufferIndex = displayBuffer->getIndex(channel); // get the latest value from the display buffer
             
             int newSamples = newDisplayBufferIndex - dbi; // N new samples (not pixels) to be drawn
 
@@ -1177,6 +1232,12 @@ void LfpDisplaySplitter::updateScreenBuffer()
                 return;
             }
 
+            if (channel < nChans && (staleChannels[channel] || (skipHiddenChannels && !lfpDisplay->isChannelVisible(channel))))
+            {
+                staleChannels.set(channel, true);
+                continue;
+            }
+
             if (newSamples < 0)
                 newSamples += displayBufferSize;
 
@@ -1362,6 +1423,9 @@ void LfpDisplaySplitter::updateScreenBuffer()
                             float sample_sum = 0;
                             float sampleCount = 0;
 
+                            // the event channel holds the TTL state bits, which are ORed over the pixel
+                            int eventBits = 0;
+
                             subSampleOffset += ratio;
 
                             if (subSampleOffset <= 1.0f)
@@ -1370,35 +1434,46 @@ void LfpDisplaySplitter::updateScreenBuffer()
                                 sample_min = sample_sum;
                                 sample_max = sample_sum;
                                 sampleCount = 1.0f;
+
+                                if (channel == nChans)
+                                    eventBits = int(sample_sum);
                             }
 
                             bool foundIt = false;
 
                             while (subSampleOffset > 1.0f && sampleNumber < newSamples) 
                             {
-                                sampleNumber++;
+                                // take whole runs of samples from the display buffer's min/max pyramid
+                                // where they fit in the pixel, so long timebases cost O(pixels). Runs only
+                                // keep the max of the event channel, so its samples are read one by one.
+                                const int maxRun = channel == nChans ? 1 : jmin(newSamples - sampleNumber, int(std::ceil(subSampleOffset)) - 1);
 
-                                float sample_current = displayBuffer->getSample(channel, dbi);
+                                float run_min, run_max, run_sum;
+                                const int run = displayBuffer->getRun(channel, dbi, jmax(1, maxRun), run_min, run_max, run_sum);
 
+                                if (channel == nChans)
+                                    eventBits |= int(run_max);
 
-                                sample_sum = sample_sum + sample_current;
+                                sampleNumber += run;
 
-                                if (sample_min >= sample_current)
+                                sample_sum = sample_sum + run_sum;
+
+                                if (sample_min >= run_min)
                                 {
-                                    sample_min = sample_current;
+                                    sample_min = run_min;
                                 }
 
-                                if (sample_max <= sample_current)
+                                if (sample_max <= run_max)
                                 {
-                                    sample_max = sample_current;
+                                    sample_max = run_max;
                                 }
                               
-                                subSampleOffset -= 1.0f;
+                                subSampleOffset -= float(run);
 
-                                dbi += 1;
+                                dbi += run;
                                 dbi %= displayBufferSize;
 
-                                sampleCount += 1.0f;
+                                sampleCount += float(run);
 
                             }
 
@@ -1411,7 +1486,7 @@ void LfpDisplaySplitter::updateScreenBuffer()
                                 //    std::cout << "Event state changed to " << sample_max << " at dbi " << dbi << " & sbi " << sbi << std::endl;
 
                                // eventState = sample_max;
-                                eventDisplayBuffer->setSample(0, sbi, sample_max);
+                                eventDisplayBuffer->setSample(0, sbi, float(eventBits));
                             }
                             else {
 
@@ -1440,6 +1515,9 @@ void LfpDisplaySplitter::updateScreenBuffer()
                             screenBufferMax->applyGain(channel, sbi, 1, 1 / (numTrials + 1));
                         }
 
+                        if (channel < nChans)
+                            updateMedianOffset(channel, sbi, maxSamples);
+
                         sbi++;
 
                         sbi %= maxSamples;
@@ -1497,8 +1575,144 @@ void LfpDisplaySplitter::updateScreenBuffer()
                
             }
         }
+
+        // skipped channels follow the event channel, which is always updated, so that
+        // screenBufferIndex[0] keeps marking the drawing position
+        for (int channel = 0; channel < nChans; channel++)
+        {
+            if (staleChannels[channel])
+            {
+                screenBufferIndex.set(channel, screenBufferIndex[nChans]);
+                lastScreenBufferIndex.set(channel, lastScreenBufferIndex[nChans]);
+                displayBufferIndex.set(channel, displayBufferIndex[nChans]);
+                leftOverSamples.set(channel, leftOverSamples[nChans]);
+            }
+        }
+    }
+
+}
+
+void LfpDisplaySplitter::materializeChannel(int channel)
+{
+    if (channel < 0 || channel >= staleChannels.size() || !staleChannels[channel])
+        return;
+
+    staleChannels.set(channel, false);
+
+    const int maxSamples = lfpDisplay->getWidth() - leftmargin;
+
+    if (displayBuffer == nullptr || maxSamples <= 0 || channel >= screenBufferMean->getNumChannels())
+        return;
+
+    screenBufferIndex.set(channel, screenBufferIndex[nChans]);
+    lastScreenBufferIndex.set(channel, lastScreenBufferIndex[nChans]);
+    displayBufferIndex.set(channel, displayBufferIndex[nChans]);
+    leftOverSamples.set(channel, leftOverSamples[nChans]);
+
+    const float ratio = sampleRate * timebase / float(maxSamples); // samples / pixel
+    const int sbi = screenBufferIndex[channel];
+    const int dbi = displayBufferIndex[channel];
+
+    // stay well behind the audio thread, which keeps writing ahead of dbi
+    const float maxHistory = displayBufferSize * 0.75f;
+
+    // walk back from the newest pixel, each one covering the ratio samples before the next
+    for (int k = 1; k <= maxSamples && k <= screenBufferMean->getNumSamples(); k++)
+    {
+        const int px = ((sbi - k) % maxSamples + maxSamples) % maxSamples;
+
+        const int windowStart = int(k * ratio);
+        const int windowEnd = int((k - 1) * ratio);
+
+        float sample_min, sample_max, sample_mean;
+
+        if (windowStart > maxHistory)
+        {
+            sample_min = sample_max = sample_mean = 0.0f;
+        }
+        else if (windowStart <= windowEnd)
+        {
+            // less than one sample per pixel
+            int index = (dbi - 1 - windowEnd) % displayBufferSize;
+
+            if (index < 0)
+                index += displayBufferSize;
+
+            sample_min = sample_max = sample_mean = displayBuffer->getSample(channel, index);
+        }
+        else
+        {
+            const int count = windowStart - windowEnd;
+
+            int index = (dbi - windowStart) % displayBufferSize;
+
+            if (index < 0)
+                index += displayBufferSize;
+
+            sample_min = 10000000;
+            sample_max = -10000000;
+            float sample_sum = 0;
+
+            for (int n = 0; n < count;)
+            {
+                float run_min, run_max, run_sum;
+                const int run = displayBuffer->getRun(channel, index, jmin(count - n, displayBufferSize - index), run_min, run_max, run_sum);
+
+                sample_min = jmin(sample_min, run_min);
+                sample_max = jmax(sample_max, run_max);
+                sample_sum += run_sum;
+
+                n += run;
+                index = (index + run) % displayBufferSize;
+            }
+
+            sample_mean = sample_sum / float(count);
+        }
+
+        screenBufferMean->setSample(channel, px, sample_mean);
+        screenBufferMin->setSample(channel, px, sample_min);
+        screenBufferMax->setSample(channel, px, sample_max);
     }
 
+    // the rebuilt row stands in for the last sweep, and its first pixels start the current one
+    LfpMedianEstimator& estimator = medianEstimators.getReference(channel);
+    estimator.reset();
+
+    const int numPixels = jmin(maxSamples, screenBufferMean->getNumSamples());
+
+    for (int px = 0; px < numPixels; px++)
+        estimator.addValue(screenBufferMean->getSample(channel, px));
+
+    medianOffsets.set(channel, estimator.getMedian());
+    hasMedianOffset.set(channel, true);
+
+    estimator.reset();
+
+    for (int px = 0; px < sbi && px < numPixels; px++)
+        estimator.addValue(screenBufferMean->getSample(channel, px));
+}
+
+void LfpDisplaySplitter::updateMedianOffset(int channel, int px, int maxSamples)
+{
+    LfpMedianEstimator& estimator = medianEstimators.getReference(channel);
+
+    estimator.addValue(screenBufferMean->getSample(channel, px));
+
+    if (px == maxSamples - 1)
+    {
+        medianOffsets.set(channel, estimator.getMedian());
+        hasMedianOffset.set(channel, true);
+        estimator.reset();
+    }
+}
+
+float LfpDisplaySplitter::getMedianOffset(int chan)
+{
+    if (chan < 0 || chan >= medianEstimators.size())
+        return 0.0f;
+
+    // the first sweep uses the estimate of the pixels drawn so far
+    return hasMedianOffset[chan] ? medianOffsets[chan] : medianEstimators.getReference(chan).getMedian();
 }
 
 void LfpDisplaySplitter::setTimebase(float t)
@@ -1513,6 +1727,13 @@ void LfpDisplaySplitter::setTimebase(float t)
     syncDisplay();
 
     reachedEnd = true;
+
+    // a paused history view keeps its start and shows the new timebase from there
+    if (showingHistory)
+    {
+        historyScrollBar->setCurrentRange(historyScrollBar->getCurrentRangeStart(), timebase, dontSendNotification);
+        drawHistory(historyScrollBar->getCurrentRangeStart());
+    }
 }
 
 const float LfpDisplaySplitter::getXCoord(int chan, int samp)
@@ -1695,6 +1916,7 @@ void LfpDisplaySplitter::refresh()
 {
     if (true)
     { 
+       updateHistoryView();
 
        updateScreenBuffer();
 
@@ -1702,6 +1924,110 @@ void LfpDisplaySplitter::refresh()
     }
 }
 
+void LfpDisplaySplitter::updateHistoryView()
+{
+    DisplayHistory* history = displayBuffer != nullptr ? displayBuffer->history.get() : nullptr;
+
+    const bool show = lfpDisplay->isPaused && triggerChannel < 0
+        && history != nullptr && history->isRunning() && history->getNumBins() > 0;
+
+    if (show == showingHistory)
+        return;
+
+    showingHistory = show;
+    historyScrollBar->setVisible(show);
+    resized();
+
+    if (show)
+    {
+        // the history stops where the display was paused, and starts with the oldest bin kept
+        historyEndBin = history->getNumBins();
+
+        const double keptSeconds = jmin(historyEndBin, int64(history->getCapacity())) * DisplayHistory::getBinDuration();
+
+        historyScrollBar->setRangeLimits(0.0, keptSeconds, dontSendNotification);
+        historyScrollBar->setCurrentRange(jmax(0.0, keptSeconds - timebase), timebase, dontSendNotification);
+        historyScrollBar->setSingleStepSize(timebase / 10.0);
+
+        drawHistory(historyScrollBar->getCurrentRangeStart());
+    }
+    else
+    {
+        // back to the live sweep, from the left edge of a clear screen
+        refreshScreenBuffer();
+        syncDisplay();
+        fullredraw = true;
+    }
+}
+
+void LfpDisplaySplitter::scrollBarMoved(ScrollBar* scrollBar, double newRangeStart)
+{
+    if (scrollBar == historyScrollBar && showingHistory)
+        drawHistory(newRangeStart);
+}
+
+void LfpDisplaySplitter::drawHistory(double startSeconds)
+{
+    DisplayHistory* history = displayBuffer != nullptr ? displayBuffer->history.get() : nullptr;
+    const int maxSamples = lfpDisplay->getWidth() - leftmargin;
+
+    if (history == nullptr || !history->isRunning() || maxSamples <= 0 || screenBufferMean == nullptr)
+        return;
+
+    const double binDuration = DisplayHistory::getBinDuration();
+    const int64 oldestKept = jmax(int64(0), historyEndBin - history->getCapacity());
+
+    // the writer keeps overwriting the oldest bins while the display is paused
+    const int64 oldestNow = jmax(oldestKept, history->getNumBins() - history->getCapacity() + 1);
+    const int64 startBin = jmax(oldestNow, oldestKept + int64(startSeconds / binDuration));
+    const double binsPerPixel = timebase / binDuration / maxSamples;
+
+    const int numChannels = jmin(nChans, history->getNumChannels() - 1, screenBufferMean->getNumChannels());
+    const int eventChannel = history->getNumChannels() - 1;
+
+    for (int px = 0; px < maxSamples && px < screenBufferMean->getNumSamples(); px++)
+    {
+        const int64 firstBin = startBin + int64(px * binsPerPixel);
+        const int64 endBin = jmin(historyEndBin, startBin + int64((px + 1) * binsPerPixel));
+        const int numBins = int(jmax(int64(1), endBin - firstBin));
+
+        float rangeMin = 0, rangeMax = 0, rangeMean = 0;
+
+        if (firstBin >= historyEndBin)
+        {
+            // past the pause, where the history ends
+            for (int channel = 0; channel < numChannels; channel++)
+            {
+                screenBufferMin->setSample(channel, px, 0);
+                screenBufferMean->setSample(channel, px, 0);
+                screenBufferMax->setSample(channel, px, 0);
+            }
+
+            eventDisplayBuffer->setSample(0, px, 0);
+            continue;
+        }
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            history->getRange(channel, firstBin, numBins, rangeMin, rangeMax, rangeMean);
+
+            screenBufferMin->setSample(channel, px, rangeMin);
+            screenBufferMean->setSample(channel, px, rangeMean);
+            screenBufferMax->setSample(channel, px, rangeMax);
+        }
+
+        history->getRange(eventChannel, firstBin, numBins, rangeMin, rangeMax, rangeMean);
+        eventDisplayBuffer->setSample(0, px, rangeMax);
+    }
+
+    // every channel is drawn from the history, so none needs rebuilding from the display buffer
+    for (int channel = 0; channel < staleChannels.size(); channel++)
+        staleChannels.set(channel, false);
+
+    fullredraw = true;
+    lfpDisplay->refresh();
+}
+
 void LfpDisplaySplitter::comboBoxChanged(juce::ComboBox *comboBox)
 {
     if (comboBox == subprocessorSelection)
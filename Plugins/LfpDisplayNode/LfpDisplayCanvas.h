@@ -31,6 +31,7 @@
 #include "LfpDisplayClasses.h"
 #include "LfpDisplayNode.h"
 #include "DisplayBuffer.h"
+#include "LfpMedianEstimator.h"
 
 
 namespace LfpViewer {
@@ -99,6 +100,9 @@ public:
 
     void redrawAll();
 
+    /** Turns the processor's scrollback history on or off, for all the split displays */
+    void setHistory(bool state);
+
     void select(LfpDisplaySplitter*);
 
     void mouseMove(const MouseEvent&) override;
@@ -132,7 +136,7 @@ private:
 
 class LfpDisplaySplitter : public Component,
                            public ComboBoxListener,
-                           public Timer
+                           public ScrollBar::Listener
 {
 public:
     LfpDisplaySplitter(LfpDisplayNode* node, LfpDisplayCanvas* canvas, DisplayBuffer* displayBuffer, int id);
@@ -208,6 +212,10 @@ public:
     float getMean(int chan);
     float getStd(int chan);
 
+    /** Returns the median of a channel's screen buffer over the last complete sweep, which
+        is subtracted from its trace when median offset plotting is on */
+    float getMedianOffset(int chan);
+
     Array<int> screenBufferIndex;
     Array<int> lastScreenBufferIndex;
     Array<float> leftOverSamples;
@@ -239,6 +247,10 @@ public:
 
     void visibleAreaChanged();
 
+    /** Rebuilds the screen buffer of a channel from the display buffer, if it was skipped by
+        updateScreenBuffer() while it was not visible */
+    void materializeChannel(int channel);
+
     void select();
     void deselect();
 
@@ -249,6 +261,9 @@ public:
     /** Respond to user's subprocessor selection */
     void comboBoxChanged(ComboBox *cb);
 
+    /** Shows the part of the display buffer's history selected with the history scroll bar */
+    void scrollBarMoved(ScrollBar* scrollBar, double newRangeStart) override;
+
 	DataChannel::DataChannelTypes selectedChannelType;
 
     ScopedPointer<ComboBox> subprocessorSelection;
@@ -266,7 +281,6 @@ public:
 
     DisplayBuffer* displayBuffer; // sample wise data buffer for display
 
-    void timerCallback();
 
 private:
 
@@ -305,9 +319,42 @@ private:
     void refreshScreenBuffer();
     void updateScreenBuffer();
 
+    /** Shows the history scroll bar while the display is paused and its buffer keeps a
+        history, and returns to the live display once it is unpaused */
+    void updateHistoryView();
+
+    /** Fills the screen buffers with a timebase of history that starts startSeconds after
+        the oldest bin kept when the display was paused */
+    void drawHistory(double startSeconds);
+
+    /** Scrolls back through the history while the display is paused */
+    ScopedPointer<ScrollBar> historyScrollBar;
+    bool showingHistory;
+
+    /** Bins of history written when the display was paused; later ones aren't shown */
+    int64 historyEndBin;
+
     Array<int> displayBufferIndex;
     int displayBufferSize;
 
+    /** Channels whose screen buffer was not updated because they were off-screen or hidden */
+    Array<bool> staleChannels;
+
+    /** Adds the pixel that was just written to a channel's median estimate, and starts a
+        new estimate when the sweep reaches the end of the screen */
+    void updateMedianOffset(int channel, int px, int maxSamples);
+
+    /** Running median of each channel's current sweep, and the result of the last sweep */
+    Array<LfpMedianEstimator> medianEstimators;
+    Array<float> medianOffsets;
+    Array<bool> hasMedianOffset;
+
+    /** Source samples per pixel last requested from the display buffer */
+    float requestedResolution;
+
+    /** Decimation generation of the display buffer that displayBufferIndex follows */
+    int bufferGeneration;
+
     int scrollBarThickness;
 
 	//void resizeSamplesPerPixelBuffer(int numChannels);
@@ -23,6 +23,8 @@ namespace LfpViewer {
     class LfpBitmapPlotter;
     class PerPixelBitmapPlotter;
     class SupersampledBitmapPlotter;
+    class OpenGLTracePlotter;
+    class LfpChannelRasterizer;
     class ChannelColourScheme;
     class DefaultColourScheme;
     class MonochromaticColourScheme;
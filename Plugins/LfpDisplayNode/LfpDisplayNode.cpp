@@ -30,6 +30,7 @@ using namespace LfpViewer;
 
 LfpDisplayNode::LfpDisplayNode()
     : GenericProcessor  ("LFP Viewer")
+    , historyEnabled    (false)
 {
     setProcessorType (PROCESSOR_TYPE_SINK);
 
@@ -67,6 +68,9 @@ void LfpDisplayNode::updateSettings()
         displayBuffer->prepareToUpdate();
     }
 
+    channelDisplayBuffers.clearQuick();
+    channelBufferIndices.clearQuick();
+
     for (int ch = 0; ch < getNumInputs(); ch++)
     {
         uint32 id = getChannelSourceId(getDataChannel(ch));
@@ -102,7 +106,8 @@ void LfpDisplayNode::updateSettings()
             val->getValue(&channelGroup);
         }
 
-        displayBufferMap[id]->addChannel(getDataChannel(ch)->getName(), ch, channelGroup, channelDepth);
+        channelDisplayBuffers.add(displayBufferMap[id]);
+        channelBufferIndices.add(displayBufferMap[id]->addChannel(getDataChannel(ch)->getName(), ch, channelGroup, channelDepth));
     }
 
     Array<DisplayBuffer*> toDelete;
@@ -138,6 +143,10 @@ void LfpDisplayNode::updateSettings()
    
     //std::cout << "Total display buffers: " << displayBuffers.size() << std::endl;
 
+    // only TTLs are drawn, so the events of the other channels don't need to be dispatched
+    for (int i = 0; i < getTotalEventChannels(); i++)
+        setEventChannelSubscription(i, getEventChannel(i)->getChannelType() == EventChannel::TTL);
+
     // TODO: add event channels separately, as they may have a different source
 }
 
@@ -215,6 +224,10 @@ bool LfpDisplayNode::enable()
     LfpDisplayEditor* editor = (LfpDisplayEditor*)getEditor();
     editor->enable();
 
+    // after the displays reset the buffer indices
+    if (historyEnabled)
+        startHistories();
+
     return true;
 
 }
@@ -224,10 +237,47 @@ bool LfpDisplayNode::disable()
 {
     LfpDisplayEditor* editor = (LfpDisplayEditor*) getEditor();
     editor->disable();
+
+    stopHistories();
+
     return true;
 }
 
 
+void LfpDisplayNode::setHistoryEnabled(bool state)
+{
+    if (state == historyEnabled)
+        return;
+
+    historyEnabled = state;
+
+    if (!CoreServices::getAcquisitionStatus())
+        return;
+
+    if (historyEnabled)
+        startHistories();
+    else
+        stopHistories();
+}
+
+
+void LfpDisplayNode::startHistories()
+{
+    for (auto displayBuffer : displayBuffers)
+    {
+        if (displayBuffer->numChannels > 0 && displayBuffer->displays.size() > 0)
+            displayBuffer->history->start();
+    }
+}
+
+
+void LfpDisplayNode::stopHistories()
+{
+    for (auto displayBuffer : displayBuffers)
+        displayBuffer->history->stop();
+}
+
+
 void LfpDisplayNode::setParameter (int parameterIndex, float newValue)
 {
     //std::cout << "Setting trigger channel for display index " << int(newValue) << " to " << parameterIndex << std::endl;
@@ -239,11 +289,11 @@ void LfpDisplayNode::handleEvent(const EventChannel* eventInfo, const MidiMessag
 {
     if (Event::getEventType(event) == EventChannel::TTL)
     {
-        TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
+        EventView ttl(event, eventInfo);
         
         //int eventNodeId = *(dataptr+1);
-        const int eventId = ttl->getState() ? 1 : 0;
-        const int eventChannel = ttl->getChannel();
+        const int eventId = ttl.getState() ? 1 : 0;
+        const int eventChannel = ttl.getChannel();
         const int eventTime = samplePosition;
 
         // find sample rate of event channel
@@ -322,7 +372,7 @@ void LfpDisplayNode::finalizeEventChannels()
     {
         if (latestTrigger[i] == -1 && latestCurrentTrigger[i] > -1) // received a trigger, but not yet acknowledged
         {
-            int triggerSample = latestCurrentTrigger[i] + splitDisplays[i]->displayBuffer->displayBufferIndices.getLast();
+            int triggerSample = splitDisplays[i]->displayBuffer->getEventIndex(latestCurrentTrigger[i]);
             //std::cout << "Setting latest trigger to " << triggerSample << std::endl;
             latestTrigger.set(i, triggerSample);
         }
@@ -345,11 +395,9 @@ void LfpDisplayNode::process (AudioSampleBuffer& buffer)
 
     for (int chan = 0; chan < buffer.getNumChannels(); ++chan)
     {
-        uint32 subProcId = getChannelSourceId(getDataChannel(chan));
-
         const int nSamples = getNumSamples(chan);
 
-        displayBufferMap[subProcId]->addData(buffer, chan, nSamples);
+        channelDisplayBuffers[chan]->addData(buffer, chan, channelBufferIndices[chan], nSamples);
     }
 }
 
@@ -55,6 +55,10 @@ public:
 
     void process (AudioSampleBuffer& buffer) override;
 
+    bool isReadOnly() const override { return true; }
+
+    bool isSheddable() const override { return true; }
+
     void setParameter (int parameterIndex, float newValue) override;
 
     void updateSettings() override;
@@ -94,6 +98,11 @@ public:
 
    // void setNumberOfDisplays(int num); // should not be needed
 
+    /** Turns the scrollback history of the display buffers on or off, starting or stopping
+        their writers right away during acquisition */
+    void setHistoryEnabled(bool state);
+    bool isHistoryEnabled() const { return historyEnabled; }
+
     void setTriggerSource(int ch, int splitId); 
     int getTriggerSource(int splitId) const;
     int64 getLatestTriggerTime(int splitId) const;
@@ -102,10 +111,20 @@ private:
     void initializeEventChannels();
     void finalizeEventChannels();
 
+    /** Starts the history of each display buffer that is shown, or stops them all */
+    void startHistories();
+    void stopHistories();
+
+    bool historyEnabled;
+
     //std::vector<std::shared_ptr<DisplayBuffer>> displayBuffers;
     
     OwnedArray<DisplayBuffer> displayBuffers;
 
+    /** Display buffer of each input channel and the channel's index in it, set in updateSettings() */
+    Array<DisplayBuffer*> channelDisplayBuffers;
+    Array<int> channelBufferIndices;
+
     Array<LfpDisplaySplitter*> splitDisplays;
 
 
@@ -354,6 +354,27 @@ LfpDisplayOptions::LfpDisplayOptions(LfpDisplayCanvas* canvas_, LfpDisplaySplitt
     medianOffsetPlottingButton->setToggleState(false, sendNotification);
     addAndMakeVisible(medianOffsetPlottingButton);
 
+    // draw traces on the GPU
+    openGLRenderingButton = new UtilityButton("OFF", labelFont);
+    openGLRenderingButton->setRadius(5.0f);
+    openGLRenderingButton->setEnabledState(true);
+    openGLRenderingButton->setCorners(true, true, true, true);
+    openGLRenderingButton->addListener(this);
+    openGLRenderingButton->setClickingTogglesState(true);
+    openGLRenderingButton->setToggleState(false, sendNotification);
+    addAndMakeVisible(openGLRenderingButton);
+
+    // keep a scrollback history to review while paused
+    historyButton = new UtilityButton("OFF", labelFont);
+    historyButton->setRadius(5.0f);
+    historyButton->setEnabledState(true);
+    historyButton->setCorners(true, true, true, true);
+    historyButton->addListener(this);
+    historyButton->setClickingTogglesState(true);
+    historyButton->setToggleState(processor->isHistoryEnabled(), dontSendNotification);
+    historyButton->setLabel(processor->isHistoryEnabled() ? "ON" : "OFF");
+    addAndMakeVisible(historyButton);
+
     // TRIGGERED DISPLAY
     sectionTitles.add("TRIGGERED DISPLAY");
     // trigger channel selection
@@ -612,6 +633,16 @@ void LfpDisplayOptions::resized()
         35,
         height);
 
+    openGLRenderingButton->setBounds(getWidth() / 2 + 110,
+        getHeight() - startHeight + verticalSpacing * 2,
+        35,
+        height);
+
+    historyButton->setBounds(getWidth() / 2 + 110,
+        getHeight() - startHeight + verticalSpacing * 3,
+        35,
+        height);
+
     //TRIGGERED DISPLAY
     triggerSourceSelection->setBounds(getWidth() / 4 * 3 + 118,
         getHeight()-startHeight,
@@ -758,6 +789,22 @@ void LfpDisplayOptions::paint(Graphics& g)
         Justification::left,
         false);
 
+    g.drawText("GPU rendering:",
+        getWidth() / 2 + 10,
+        openGLRenderingButton->getY(),
+        150,
+        22,
+        Justification::left,
+        false);
+
+    g.drawText("History (" + String(HISTORY_MINUTES) + " min):",
+        getWidth() / 2 + 10,
+        historyButton->getY(),
+        150,
+        22,
+        Justification::left,
+        false);
+
     g.drawText("Trigger channel:",
         getWidth() / 4 * 3 + 10,
         triggerSourceSelection->getY(),
@@ -937,6 +984,34 @@ void LfpDisplayOptions::setMedianOffset(bool state)
     }
 }
 
+void LfpDisplayOptions::setOpenGLRendering(bool state)
+{
+    lfpDisplay->setOpenGLRendering(state);
+
+    openGLRenderingButton->setToggleState(state, dontSendNotification);
+
+    if (state)
+    {
+        openGLRenderingButton->setLabel("ON");
+    }
+    else {
+        openGLRenderingButton->setLabel("OFF");
+    }
+}
+
+void LfpDisplayOptions::setHistory(bool state)
+{
+    historyButton->setToggleState(state, dontSendNotification);
+
+    if (state)
+    {
+        historyButton->setLabel("ON");
+    }
+    else {
+        historyButton->setLabel("OFF");
+    }
+}
+
 void LfpDisplayOptions::setAveraging(bool state)
 {
     canvasSplit->setAveraging(state);
@@ -1007,6 +1082,18 @@ void LfpDisplayOptions::buttonClicked(Button* b)
         setMedianOffset(b->getToggleState());
         return;
     } 
+
+    if (b == openGLRenderingButton)
+    {
+        setOpenGLRendering(b->getToggleState());
+        return;
+    }
+
+    if (b == historyButton)
+    {
+        canvas->setHistory(b->getToggleState());
+        return;
+    }
     
     if (b == averageSignalButton)
     {
@@ -1492,6 +1579,8 @@ void LfpDisplayOptions::saveParameters(XmlElement* xml)
     xmlNode->setAttribute("subtractOffset", medianOffsetPlottingButton->getToggleState());
 
     xmlNode->setAttribute("isInverted",invertInputButton->getToggleState());
+    xmlNode->setAttribute("openGLRendering", openGLRenderingButton->getToggleState());
+    xmlNode->setAttribute("history", historyButton->getToggleState());
     
     xmlNode->setAttribute("triggerSource", triggerSourceSelection->getSelectedId());
     xmlNode->setAttribute("trialAvg", averageSignalButton->getToggleState());
@@ -1627,6 +1716,8 @@ void LfpDisplayOptions::loadParameters(XmlElement* xml)
             setInputInverted(xmlNode->getBoolAttribute("isInverted", false));
             setAveraging(xmlNode->getBoolAttribute("trialAvg", false));
             setMedianOffset(xmlNode->getBoolAttribute("subtractOffset", false));
+            setOpenGLRendering(xmlNode->getBoolAttribute("openGLRendering", false));
+            canvas->setHistory(xmlNode->getBoolAttribute("history", false));
 
             // CHANNEL SKIP
             channelDisplaySkipSelection->setSelectedId(xmlNode->getIntAttribute("channelSkip"), dontSendNotification);
@@ -129,6 +129,9 @@ public:
     void setChannelsReversed(bool);
     void setInputInverted(bool);
     void setMedianOffset(bool);
+    void setOpenGLRendering(bool);
+    /** Shows whether the processor keeps a history; see LfpDisplayCanvas::setHistory() */
+    void setHistory(bool);
     void setAveraging(bool);
     void setSortByDepth(bool);
     void setShowChannelNumbers(bool);
@@ -173,6 +176,8 @@ private:
     // SIGNAL PROCESSING SECTION
     ScopedPointer<UtilityButton> medianOffsetPlottingButton;
     ScopedPointer<UtilityButton> invertInputButton;
+    ScopedPointer<UtilityButton> openGLRenderingButton;
+    ScopedPointer<UtilityButton> historyButton;
 
     // TRIGGERED DISPLAY SECTION
     ScopedPointer<ComboBox> triggerSourceSelection;
@@ -0,0 +1,133 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2021 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "LfpMedianEstimator.h"
+
+using namespace LfpViewer;
+
+#pragma  mark - LfpMedianEstimator -
+
+LfpMedianEstimator::LfpMedianEstimator()
+{
+    reset();
+}
+
+void LfpMedianEstimator::reset()
+{
+    count = 0;
+
+    for (int i = 0; i < 5; i++)
+    {
+        heights[i] = 0.0f;
+        positions[i] = i;
+    }
+
+    // markers for the minimum, lower quartile, median, upper quartile and maximum
+    desiredPositions[0] = 0.0f;
+    desiredPositions[1] = 1.0f;
+    desiredPositions[2] = 2.0f;
+    desiredPositions[3] = 3.0f;
+    desiredPositions[4] = 4.0f;
+}
+
+void LfpMedianEstimator::addValue(float value)
+{
+    if (count < 5)
+    {
+        // the first five values become the markers
+        heights[count++] = value;
+
+        if (count == 5)
+            std::sort(heights, heights + 5);
+
+        return;
+    }
+
+    count++;
+
+    int cell;
+
+    if (value < heights[0])
+    {
+        heights[0] = value;
+        cell = 0;
+    }
+    else if (value >= heights[4])
+    {
+        heights[4] = value;
+        cell = 3;
+    }
+    else
+    {
+        cell = 0;
+
+        while (value >= heights[cell + 1])
+            cell++;
+    }
+
+    for (int i = cell + 1; i < 5; i++)
+        positions[i]++;
+
+    desiredPositions[1] += 0.25f;
+    desiredPositions[2] += 0.5f;
+    desiredPositions[3] += 0.75f;
+    desiredPositions[4] += 1.0f;
+
+    // move the middle markers by one position when they drift from where they should be
+    for (int i = 1; i < 4; i++)
+    {
+        const float drift = desiredPositions[i] - positions[i];
+
+        if ((drift >= 1.0f && positions[i + 1] - positions[i] > 1)
+            || (drift <= -1.0f && positions[i - 1] - positions[i] < -1))
+        {
+            const int step = drift > 0 ? 1 : -1;
+
+            const float parabolic = heights[i] + float(step) / (positions[i + 1] - positions[i - 1])
+                * ((positions[i] - positions[i - 1] + step) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i])
+                 + (positions[i + 1] - positions[i] - step) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+
+            if (heights[i - 1] < parabolic && parabolic < heights[i + 1])
+                heights[i] = parabolic;
+            else
+                heights[i] += float(step) * (heights[i + step] - heights[i]) / (positions[i + step] - positions[i]);
+
+            positions[i] += step;
+        }
+    }
+}
+
+float LfpMedianEstimator::getMedian() const
+{
+    if (count >= 5)
+        return heights[2];
+
+    if (count == 0)
+        return 0.0f;
+
+    float sorted[5];
+    std::copy(heights, heights + count, sorted);
+    std::sort(sorted, sorted + count);
+
+    return count % 2 == 1 ? sorted[count / 2] : 0.5f * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
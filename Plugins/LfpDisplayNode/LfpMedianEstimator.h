@@ -0,0 +1,64 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __LFPMEDIANESTIMATOR_H__
+#define __LFPMEDIANESTIMATOR_H__
+
+#include <VisualizerWindowHeaders.h>
+
+namespace LfpViewer {
+#pragma  mark - LfpMedianEstimator -
+//==============================================================================
+/**
+    Streaming estimate of the median of a channel, using the P-squared algorithm
+    of Jain and Chlamtac (1985): five markers are moved towards the quantiles
+    they track as values arrive, so each value costs a constant amount of work
+    and no history is kept.
+
+    @see LfpDisplaySplitter::getMedianOffset
+ */
+class LfpMedianEstimator
+{
+public:
+    LfpMedianEstimator();
+
+    /** Forgets all the values added so far */
+    void reset();
+
+    /** Adds a value to the estimate */
+    void addValue(float value);
+
+    /** Returns the estimated median of the values added since the last reset, or 0 if there are none */
+    float getMedian() const;
+
+    /** Returns the number of values added since the last reset */
+    int getNumValues() const { return count; }
+
+private:
+    float heights[5];
+    int positions[5];
+    float desiredPositions[5];
+    int count;
+};
+
+}; // namespace
+#endif
@@ -0,0 +1,335 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2021 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "OpenGLTracePlotter.h"
+#include "LfpDisplay.h"
+#include "LfpBitmapPlotterInfo.h"
+
+#include <stddef.h>
+
+using namespace LfpViewer;
+
+#pragma  mark - OpenGLTracePlotter -
+
+OpenGLTracePlotter::OpenGLTracePlotter(LfpDisplay * lfpDisplay)
+    : LfpBitmapPlotter(lfpDisplay)
+    , target(nullptr)
+    , numColumns(0)
+    , numRows(0)
+    , resizePending(false)
+    , targetWidth(0)
+    , targetHeight(0)
+    , backgroundColour(Colours::black)
+    , vertexBuffer(0)
+    , numBufferedVertices(0)
+{
+    openGLContext.setRenderer(this);
+    openGLContext.setComponentPaintingEnabled(true);
+    openGLContext.setContinuousRepainting(false);
+}
+
+OpenGLTracePlotter::~OpenGLTracePlotter()
+{
+    detach();
+}
+
+void OpenGLTracePlotter::attachTo(Component& viewport)
+{
+    if (target == &viewport)
+        return;
+
+    detach();
+
+    target = &viewport;
+    openGLContext.attachTo(viewport);
+}
+
+void OpenGLTracePlotter::detach()
+{
+    if (target == nullptr)
+        return;
+
+    openGLContext.detach();
+    target = nullptr;
+}
+
+bool OpenGLTracePlotter::isAttached() const
+{
+    return target != nullptr;
+}
+
+void OpenGLTracePlotter::setViewArea(Rectangle<int> bitmapBounds, Colour background)
+{
+    const ScopedLock vertexGuard(vertexLock);
+
+    viewArea = bitmapBounds;
+    backgroundColour = background;
+
+    if (target != nullptr)
+    {
+        targetWidth = target->getWidth();
+        targetHeight = target->getHeight();
+    }
+}
+
+void OpenGLTracePlotter::beginPlot(int fromColumn, int toColumn, bool fullRedraw)
+{
+    // the lock is held until endPlot(), so the renderer never uploads a half-plotted column
+    vertexLock.enter();
+
+    const int width = display->lfpChannelBitmap.getWidth();
+    const int height = display->getNumChannels();
+
+    if (width != numColumns || height != numRows)
+    {
+        numColumns = width;
+        numRows = height;
+
+        vertices.allocate((size_t) numColumns * numRows * 2, true);
+        dirtyColumns.allocate((size_t) numColumns, false);
+
+        for (int column = 0; column < numColumns; column++)
+            new (dirtyColumns + column) std::atomic<bool>(false);
+
+        resizePending = true;
+        fullRedraw = true;
+    }
+
+    if (fullRedraw)
+        clearColumns(0, numColumns - 1);
+    else if (fromColumn != toColumn)
+        clearColumns(fromColumn, toColumn);
+}
+
+void OpenGLTracePlotter::clearColumns(int fromColumn, int toColumn)
+{
+    if (numColumns == 0)
+        return;
+
+    // match the +2 margin that LfpDisplay::refresh() clears in the bitmap
+    int count = toColumn - fromColumn + 2;
+
+    if (count <= 0)
+        count += numColumns;
+
+    count = jmin(count, numColumns);
+
+    for (int n = 0; n < count; n++)
+    {
+        const int column = (fromColumn + n) % numColumns;
+
+        if (column < 0)
+            continue;
+
+        Vertex* v = vertices + (size_t) column * numRows * 2;
+
+        for (int k = 0; k < numRows * 2; k++)
+        {
+            v[k].x = (float) column + 0.5f;
+            v[k].y = 0.0f;
+            v[k].colour[3] = 0;
+        }
+
+        dirtyColumns[column].store(true, std::memory_order_relaxed);
+    }
+}
+
+void OpenGLTracePlotter::plot(Image::BitmapData &bitmapData, LfpBitmapPlotterInfo &pInfo)
+{
+    if (pInfo.channelID < 0 || pInfo.channelID >= numRows)
+        return;
+
+    if (pInfo.samp < 0) {pInfo.samp = 0;};
+    if (pInfo.samp >= numColumns) {pInfo.samp = numColumns - 1;};
+
+    int jfrom = pInfo.from + pInfo.y;
+    int jto = pInfo.to + pInfo.y;
+
+    if (jfrom < 0) {jfrom = 0;};
+    if (jto >= display->lfpChannelBitmap.getHeight()) {jto = display->lfpChannelBitmap.getHeight() - 1;};
+
+    Vertex* v = vertices + ((size_t) pInfo.samp * numRows + pInfo.channelID) * 2;
+
+    const float x = (float) pInfo.samp + 0.5f;
+    const uint8 r = pInfo.lineColour.getRed();
+    const uint8 g = pInfo.lineColour.getGreen();
+    const uint8 b = pInfo.lineColour.getBlue();
+    const uint8 a = jto < jfrom ? 0 : pInfo.lineColour.getAlpha();
+
+    // the segment covers the pixel rows jfrom to jto inclusive, like PerPixelBitmapPlotter
+    v[0] = { x, (float) jfrom, { r, g, b, a } };
+    v[1] = { x, (float) jto + 1.0f, { r, g, b, a } };
+
+    // channels are plotted concurrently, each into its own vertex slots
+    dirtyColumns[pInfo.samp].store(true, std::memory_order_relaxed);
+}
+
+void OpenGLTracePlotter::endPlot()
+{
+    vertexLock.exit();
+
+    if (target != nullptr)
+        openGLContext.triggerRepaint();
+}
+
+void OpenGLTracePlotter::newOpenGLContextCreated()
+{
+    shader = new OpenGLShaderProgram(openGLContext);
+
+    const String vertexShader =
+        "attribute vec2 position;\n"
+        "attribute vec4 colour;\n"
+        "uniform vec4 viewTransform;\n"
+        "varying vec4 fragColour;\n"
+        "void main()\n"
+        "{\n"
+        "    fragColour = colour;\n"
+        "    gl_Position = vec4(position * viewTransform.xy + viewTransform.zw, 0.0, 1.0);\n"
+        "}\n";
+
+    const String fragmentShader =
+        "varying " JUCE_LOWP " vec4 fragColour;\n"
+        "void main()\n"
+        "{\n"
+        "    gl_FragColor = fragColour;\n"
+        "}\n";
+
+    if (shader->addVertexShader(OpenGLHelpers::translateVertexShaderToV3(vertexShader))
+        && shader->addFragmentShader(OpenGLHelpers::translateFragmentShaderToV3(fragmentShader))
+        && shader->link())
+    {
+        positionAttribute = new OpenGLShaderProgram::Attribute(*shader, "position");
+        colourAttribute = new OpenGLShaderProgram::Attribute(*shader, "colour");
+        viewTransform = new OpenGLShaderProgram::Uniform(*shader, "viewTransform");
+    }
+    else
+    {
+        std::cout << "LfpDisplay: could not compile trace shader: " << shader->getLastError() << std::endl;
+        shader = nullptr;
+    }
+
+    openGLContext.extensions.glGenBuffers(1, &vertexBuffer);
+    numBufferedVertices = 0;
+
+    // a new context has an empty buffer, so the next frame uploads everything
+    const ScopedLock vertexGuard(vertexLock);
+    resizePending = true;
+}
+
+void OpenGLTracePlotter::renderOpenGL()
+{
+    OpenGLExtensionFunctions& gl = openGLContext.extensions;
+
+    const ScopedLock vertexGuard(vertexLock);
+
+    const float scale = (float) openGLContext.getRenderingScale();
+
+    glViewport(0, 0, roundToInt(scale * targetWidth), roundToInt(scale * targetHeight));
+    OpenGLHelpers::clear(backgroundColour);
+
+    if (shader == nullptr || numColumns == 0 || numRows == 0 || targetWidth == 0 || targetHeight == 0)
+        return;
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+    const size_t columnBytes = sizeof(Vertex) * numRows * 2;
+
+    if (resizePending || numBufferedVertices != numColumns * numRows * 2)
+    {
+        numBufferedVertices = numColumns * numRows * 2;
+        gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (columnBytes * numColumns), vertices, GL_DYNAMIC_DRAW);
+
+        for (int column = 0; column < numColumns; column++)
+            dirtyColumns[column].store(false, std::memory_order_relaxed);
+
+        resizePending = false;
+    }
+    else
+    {
+        // upload each run of plotted columns with a single call
+        int column = 0;
+
+        while (column < numColumns)
+        {
+            if (!dirtyColumns[column].load(std::memory_order_relaxed))
+            {
+                column++;
+                continue;
+            }
+
+            const int start = column;
+
+            while (column < numColumns && dirtyColumns[column].load(std::memory_order_relaxed))
+                dirtyColumns[column++].store(false, std::memory_order_relaxed);
+
+            gl.glBufferSubData(GL_ARRAY_BUFFER,
+                               (GLintptr) (columnBytes * start),
+                               (GLsizeiptr) (columnBytes * (column - start)),
+                               vertices + (size_t) start * numRows * 2);
+        }
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glLineWidth(scale);
+
+    shader->use();
+
+    // bitmap pixels -> normalised device coordinates of the viewport
+    viewTransform->set(2.0f / targetWidth,
+                       -2.0f / targetHeight,
+                       2.0f * viewArea.getX() / targetWidth - 1.0f,
+                       1.0f - 2.0f * viewArea.getY() / targetHeight);
+
+    gl.glVertexAttribPointer((GLuint) positionAttribute->attributeID, 2, GL_FLOAT, GL_FALSE,
+                             sizeof(Vertex), (GLvoid*) offsetof(Vertex, x));
+    gl.glEnableVertexAttribArray((GLuint) positionAttribute->attributeID);
+
+    gl.glVertexAttribPointer((GLuint) colourAttribute->attributeID, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                             sizeof(Vertex), (GLvoid*) offsetof(Vertex, colour));
+    gl.glEnableVertexAttribArray((GLuint) colourAttribute->attributeID);
+
+    // all channels and columns in one pass
+    glDrawArrays(GL_LINES, 0, numBufferedVertices);
+
+    gl.glDisableVertexAttribArray((GLuint) positionAttribute->attributeID);
+    gl.glDisableVertexAttribArray((GLuint) colourAttribute->attributeID);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OpenGLTracePlotter::openGLContextClosing()
+{
+    positionAttribute = nullptr;
+    colourAttribute = nullptr;
+    viewTransform = nullptr;
+    shader = nullptr;
+
+    if (vertexBuffer != 0)
+    {
+        openGLContext.extensions.glDeleteBuffers(1, &vertexBuffer);
+        vertexBuffer = 0;
+    }
+
+    numBufferedVertices = 0;
+}
+
@@ -0,0 +1,118 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __OPENGLTRACEPLOTTER_H__
+#define __OPENGLTRACEPLOTTER_H__
+
+#include <VisualizerWindowHeaders.h>
+
+#include <vector>
+#include <array>
+#include <atomic>
+
+#include "LfpDisplayClasses.h"
+#include "LfpDisplayNode.h"
+#include "LfpBitmapPlotter.h"
+namespace LfpViewer {
+#pragma  mark - OpenGLTracePlotter -
+//==============================================================================
+/**
+    Plots the min-max range of each pixel column as a vertical line segment,
+    but instead of setting the bitmap's pixels it keeps the segments of all
+    channels in a vertex buffer that is drawn in a single OpenGL pass.
+
+    The vertices are stored column by column, so the columns written in a
+    refresh are a contiguous part of the buffer and only those are uploaded.
+    Events, markers and warnings are still drawn to the bitmap, which is
+    composited on top of the traces.
+
+    @see LfpBitmapPlotter, LfpDisplay
+ */
+class OpenGLTracePlotter : public LfpBitmapPlotter,
+                           public OpenGLRenderer
+{
+public:
+    OpenGLTracePlotter(LfpDisplay * lfpDisplay);
+    virtual ~OpenGLTracePlotter();
+
+    /** Stores the min-max segment of one column of a single channel */
+    virtual void plot(Image::BitmapData &bitmapData, LfpBitmapPlotterInfo &plotterInfo) override;
+
+    /** Resizes the vertex buffer to the bitmap and clears the columns about to be plotted */
+    virtual void beginPlot(int fromColumn, int toColumn, bool fullRedraw) override;
+
+    /** Schedules the new columns to be drawn */
+    virtual void endPlot() override;
+
+    /** Starts rendering the traces behind the components of the viewport */
+    void attachTo(Component& viewport);
+
+    /** Stops rendering the traces */
+    void detach();
+
+    /** Returns true if the traces are being rendered to a viewport */
+    bool isAttached() const;
+
+    /** Sets the position of the bitmap relative to the viewport, and the colour drawn
+        behind the traces */
+    void setViewArea(Rectangle<int> bitmapBounds, Colour background);
+
+    void newOpenGLContextCreated() override;
+    void renderOpenGL() override;
+    void openGLContextClosing() override;
+
+private:
+    struct Vertex
+    {
+        float x;
+        float y;
+        uint8 colour[4];
+    };
+
+    void clearColumns(int fromColumn, int toColumn);
+
+    OpenGLContext openGLContext;
+    Component* target;
+
+    CriticalSection vertexLock;
+
+    HeapBlock<Vertex> vertices;
+    HeapBlock<std::atomic<bool>> dirtyColumns; // set by plot() from the rasterizer's threads
+    int numColumns;
+    int numRows;
+    bool resizePending;
+
+    Rectangle<int> viewArea;
+    int targetWidth;
+    int targetHeight;
+    Colour backgroundColour;
+
+    ScopedPointer<OpenGLShaderProgram> shader;
+    ScopedPointer<OpenGLShaderProgram::Attribute> positionAttribute;
+    ScopedPointer<OpenGLShaderProgram::Attribute> colourAttribute;
+    ScopedPointer<OpenGLShaderProgram::Uniform> viewTransform;
+    GLuint vertexBuffer;
+    int numBufferedVertices;
+};
+
+}; // namespace
+#endif
@@ -0,0 +1,556 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "AsyncHDF5Writer.h"
+#include <hdf5.h>
+
+static size_t getElementSize (AsyncHDF5Writer::ElementType type)
+{
+    switch (type)
+    {
+        case AsyncHDF5Writer::INT16:
+        case AsyncHDF5Writer::UINT16:
+            return 2;
+        case AsyncHDF5Writer::INT32:
+        case AsyncHDF5Writer::FLOAT:
+            return 4;
+        case AsyncHDF5Writer::INT64:
+        case AsyncHDF5Writer::DOUBLE:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+static hid_t createStringType (size_t length)
+{
+    hid_t text = H5Tcopy (H5T_C_S1);
+    H5Tset_size (text, jmax ((size_t) 1, length));
+    H5Tset_strpad (text, H5T_STR_NULLPAD);
+    H5Tset_cset (text, H5T_CSET_UTF8);
+    return text;
+}
+
+/** A copy of the memory type of a dataset's elements, to be closed with H5Tclose */
+static hid_t createElementType (AsyncHDF5Writer::ElementType type, const Array<int>& rowShape)
+{
+    switch (type)
+    {
+        case AsyncHDF5Writer::INT8:     return H5Tcopy (H5T_NATIVE_INT8);
+        case AsyncHDF5Writer::UINT8:    return H5Tcopy (H5T_NATIVE_UINT8);
+        case AsyncHDF5Writer::INT16:    return H5Tcopy (H5T_NATIVE_INT16);
+        case AsyncHDF5Writer::UINT16:   return H5Tcopy (H5T_NATIVE_UINT16);
+        case AsyncHDF5Writer::INT32:    return H5Tcopy (H5T_NATIVE_INT32);
+        case AsyncHDF5Writer::INT64:    return H5Tcopy (H5T_NATIVE_INT64);
+        case AsyncHDF5Writer::FLOAT:    return H5Tcopy (H5T_NATIVE_FLOAT);
+        case AsyncHDF5Writer::DOUBLE:   return H5Tcopy (H5T_NATIVE_DOUBLE);
+        default: break;
+    }
+
+    return createStringType ((size_t) rowShape[0]);
+}
+
+/** Rank of a growing dataset: its rows, then the dimensions of each row. Text rows are single strings. */
+static int getRank (AsyncHDF5Writer::ElementType type, const Array<int>& rowShape)
+{
+    return type == AsyncHDF5Writer::TEXT ? 1 : 1 + rowShape.size();
+}
+
+
+AsyncHDF5Writer::AsyncHDF5Writer()
+    : Thread ("HDF5 Writer")
+    , chunkBytes (0)
+    , compressionLevel (0)
+    , fileId (-1)
+    , queue (HDF5_QUEUE_SIZE)
+    , finishing (0)
+    , failed (0)
+{
+}
+
+AsyncHDF5Writer::~AsyncHDF5Writer()
+{
+    finish();
+}
+
+int AsyncHDF5Writer::addGroup (const String& path, const NamedValueSet& attributes)
+{
+    jassert (! isThreadRunning());
+
+    Object* group = new Object();
+    group->path = path;
+    group->attributes = attributes;
+    group->isGroup = true;
+    group->isGrowing = false;
+    group->type = UINT8;
+    group->rowBytes = 0;
+    group->hid = -1;
+    group->chunkRows = 0;
+    group->chunkFill = 0;
+    group->rowsWritten = 0;
+
+    objects.add (group);
+    return objects.size() - 1;
+}
+
+int AsyncHDF5Writer::addText (const String& path, const String& text, const NamedValueSet& attributes)
+{
+    const int index = addGroup (path, attributes);
+    objects[index]->isGroup = false;
+    objects[index]->text = text;
+    return index;
+}
+
+int AsyncHDF5Writer::addDataset (const String& path, ElementType type, const Array<int>& rowShape,
+                                 const NamedValueSet& attributes)
+{
+    const int index = addGroup (path, attributes);
+
+    Object* dataset = objects[index];
+    dataset->isGroup = false;
+    dataset->isGrowing = true;
+    dataset->type = type;
+    dataset->rowShape = rowShape;
+    dataset->rowBytes = getElementSize (type);
+
+    for (int i = 0; i < rowShape.size(); i++)
+        dataset->rowBytes *= (size_t) jmax (1, rowShape[i]);
+
+    return index;
+}
+
+size_t AsyncHDF5Writer::getRowBytes (int dataset) const
+{
+    return objects[dataset]->rowBytes;
+}
+
+bool AsyncHDF5Writer::start (const File& file_, int chunkBytes_, int compressionLevel_)
+{
+    jassert (! isThreadRunning());
+
+    file = file_;
+    chunkBytes = jmax (1, chunkBytes_);
+    compressionLevel = jlimit (0, 9, compressionLevel_);
+
+    queueData.allocate (HDF5_QUEUE_SIZE, false);
+
+    if (queueData == nullptr)
+        return false;
+
+    queue.reset();
+    finishing = 0;
+    failed = 0;
+
+    startThread();
+    return true;
+}
+
+void AsyncHDF5Writer::append (int dataset, const void* rows, int numRows)
+{
+    if (queueData == nullptr || numRows <= 0)
+        return;
+
+    const size_t rowBytes = objects[dataset]->rowBytes;
+    const int maxRows = jmax (1, (int) ((HDF5_QUEUE_SIZE / 4) / rowBytes));
+    const char* source = static_cast<const char*> (rows);
+
+    while (numRows > 0)
+    {
+        const int queuedRows = jmin (numRows, maxRows);
+        const int payloadBytes = (int) (queuedRows * rowBytes);
+        const int totalBytes = (int) sizeof (QueuedRows) + payloadBytes;
+
+        // a recording can't drop data, so a full queue holds the caller until the writer catches up
+        while (queue.getFreeSpace() < totalBytes)
+        {
+            if (! isThreadRunning())
+                return;
+
+            rowsTaken.wait (100);
+        }
+
+        QueuedRows header;
+        header.dataset = dataset;
+        header.numRows = queuedRows;
+
+        int start1, size1, start2, size2;
+        queue.prepareToWrite (totalBytes, start1, size1, start2, size2);
+
+        const char* parts[2] = { reinterpret_cast<const char*> (&header), source };
+        const int partSizes[2] = { (int) sizeof (header), payloadBytes };
+        int written = 0;
+
+        for (int p = 0; p < 2; p++)
+        {
+            const char* data = parts[p];
+            int remaining = partSizes[p];
+
+            while (remaining > 0)
+            {
+                const bool inFirst = written < size1;
+                const int offset = inFirst ? start1 + written : start2 + written - size1;
+                const int chunk = jmin (remaining, inFirst ? size1 - written : size2 - (written - size1));
+
+                memcpy (queueData + offset, data, (size_t) chunk);
+                data += chunk;
+                remaining -= chunk;
+                written += chunk;
+            }
+        }
+
+        queue.finishedWrite (totalBytes);
+        rowsQueued.signal();
+
+        source += payloadBytes;
+        numRows -= queuedRows;
+    }
+}
+
+void AsyncHDF5Writer::finish()
+{
+    if (isThreadRunning())
+    {
+        finishing = 1;
+        rowsQueued.signal();
+        waitForThreadToExit (-1);
+    }
+
+    objects.clear();
+    queueData.free();
+}
+
+int AsyncHDF5Writer::getNumPendingBytes() const
+{
+    return queue.getNumReady();
+}
+
+bool AsyncHDF5Writer::hasFailed() const
+{
+    return failed.get() != 0;
+}
+
+void AsyncHDF5Writer::run()
+{
+    if (! createFile())
+    {
+        std::cout << "NWB: could not create " << file.getFullPathName() << std::endl;
+        failed = 1;
+    }
+
+    while (true)
+    {
+        const bool lastPass = finishing.get() != 0;
+
+        if (readRows())
+        {
+            rowsTaken.signal();
+            continue;
+        }
+
+        if (lastPass)
+            break;
+
+        rowsQueued.wait (100);
+    }
+
+    closeFile();
+}
+
+bool AsyncHDF5Writer::createFile()
+{
+    hid_t fileAccess = H5Pcreate (H5P_FILE_ACCESS);
+    H5Pset_alignment (fileAccess, HDF5_ALIGNMENT_THRESHOLD, HDF5_ALIGNMENT);
+
+    fileId = H5Fcreate (file.getFullPathName().toRawUTF8(), H5F_ACC_TRUNC, H5P_DEFAULT, fileAccess);
+    H5Pclose (fileAccess);
+
+    if (fileId < 0)
+        return false;
+
+    bool created = true;
+
+    for (auto object : objects)
+    {
+        if (! createObject (*object))
+        {
+            std::cout << "NWB: could not create " << object->path << std::endl;
+            created = false;
+        }
+    }
+
+    return created;
+}
+
+bool AsyncHDF5Writer::createObject (Object& object)
+{
+    if (object.isGroup)
+    {
+        hid_t group = object.path == "/" ? H5Gopen2 (fileId, "/", H5P_DEFAULT)
+                                         : H5Gcreate2 (fileId, object.path.toRawUTF8(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (group < 0)
+            return false;
+
+        const bool written = writeAttributes (group, object.attributes);
+        H5Gclose (group);
+        return written;
+    }
+
+    if (! object.isGrowing)
+    {
+        const size_t length = object.text.getNumBytesAsUTF8();
+        HeapBlock<char> text ((size_t) jmax ((size_t) 1, length), true);
+        memcpy (text, object.text.toRawUTF8(), length);
+
+        hid_t type = createStringType (length);
+        hid_t space = H5Screate (H5S_SCALAR);
+        hid_t dataset = H5Dcreate2 (fileId, object.path.toRawUTF8(), type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+        bool written = dataset >= 0 && H5Dwrite (dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, text) >= 0;
+
+        if (dataset >= 0)
+        {
+            written = writeAttributes (dataset, object.attributes) && written;
+            H5Dclose (dataset);
+        }
+
+        H5Sclose (space);
+        H5Tclose (type);
+        return written;
+    }
+
+    const int rank = getRank (object.type, object.rowShape);
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t maxDims[H5S_MAX_RANK];
+    hsize_t chunkDims[H5S_MAX_RANK];
+
+    object.chunkRows = jmax (1, (int) (chunkBytes / object.rowBytes));
+
+    dims[0] = 0;
+    maxDims[0] = H5S_UNLIMITED;
+    chunkDims[0] = (hsize_t) object.chunkRows;
+
+    for (int i = 1; i < rank; i++)
+        dims[i] = maxDims[i] = chunkDims[i] = (hsize_t) jmax (1, object.rowShape[i - 1]);
+
+    hid_t space = H5Screate_simple (rank, dims, maxDims);
+    hid_t type = createElementType (object.type, object.rowShape);
+
+    // every chunk but the last is written whole, so no fill values and no chunk cache are needed
+    hid_t create = H5Pcreate (H5P_DATASET_CREATE);
+    H5Pset_chunk (create, rank, chunkDims);
+    H5Pset_fill_time (create, H5D_FILL_TIME_NEVER);
+
+    if (compressionLevel > 0 && H5Zfilter_avail (H5Z_FILTER_DEFLATE) > 0)
+    {
+        if (getElementSize (object.type) > 1)
+            H5Pset_shuffle (create);
+
+        H5Pset_deflate (create, (unsigned) compressionLevel);
+    }
+
+    hid_t access = H5Pcreate (H5P_DATASET_ACCESS);
+    H5Pset_chunk_cache (access, H5D_CHUNK_CACHE_NSLOTS_DEFAULT, 0, H5D_CHUNK_CACHE_W0_DEFAULT);
+
+    object.hid = H5Dcreate2 (fileId, object.path.toRawUTF8(), type, space, H5P_DEFAULT, create, access);
+
+    H5Pclose (access);
+    H5Pclose (create);
+    H5Tclose (type);
+    H5Sclose (space);
+
+    if (object.hid < 0)
+        return false;
+
+    object.chunk.malloc ((size_t) object.chunkRows * object.rowBytes);
+    object.chunkFill = 0;
+    object.rowsWritten = 0;
+
+    return writeAttributes (object.hid, object.attributes);
+}
+
+bool AsyncHDF5Writer::writeAttributes (juce::int64 location, const NamedValueSet& attributes)
+{
+    bool written = true;
+
+    for (int i = 0; i < attributes.size(); i++)
+    {
+        const String name = attributes.getName (i).toString();
+        const var& value = attributes.getValueAt (i);
+
+        hid_t space = H5Screate (H5S_SCALAR);
+        hid_t type;
+        HeapBlock<char> data;
+
+        if (value.isString())
+        {
+            const String text = value.toString();
+            const size_t length = text.getNumBytesAsUTF8();
+
+            type = createStringType (length);
+            data.calloc (jmax ((size_t) 1, length));
+            memcpy (data, text.toRawUTF8(), length);
+        }
+        else if (value.isDouble())
+        {
+            type = H5Tcopy (H5T_NATIVE_DOUBLE);
+            data.malloc (sizeof (double));
+            *reinterpret_cast<double*> (data.getData()) = (double) value;
+        }
+        else
+        {
+            type = H5Tcopy (H5T_NATIVE_INT64);
+            data.malloc (sizeof (juce::int64));
+            *reinterpret_cast<juce::int64*> (data.getData()) = (juce::int64) value;
+        }
+
+        hid_t attribute = H5Acreate2 (location, name.toRawUTF8(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+
+        if (attribute < 0 || H5Awrite (attribute, type, data) < 0)
+            written = false;
+
+        if (attribute >= 0)
+            H5Aclose (attribute);
+
+        H5Tclose (type);
+        H5Sclose (space);
+    }
+
+    return written;
+}
+
+void AsyncHDF5Writer::closeFile()
+{
+    for (auto object : objects)
+    {
+        if (object->isGrowing && object->hid >= 0)
+        {
+            if (! writeChunk (*object))
+                failed = 1;
+
+            H5Dclose (object->hid);
+            object->hid = -1;
+        }
+    }
+
+    if (fileId >= 0)
+    {
+        H5Fflush (fileId, H5F_SCOPE_GLOBAL);
+
+        if (H5Fclose (fileId) < 0)
+            failed = 1;
+
+        fileId = -1;
+    }
+}
+
+bool AsyncHDF5Writer::readRows()
+{
+    if (queue.getNumReady() < (int) sizeof (QueuedRows))
+        return false;
+
+    // the rows are queued together with their header, so they are ready too
+    QueuedRows header;
+
+    int start1, size1, start2, size2;
+    queue.prepareToRead (sizeof (header), start1, size1, start2, size2);
+    memcpy (&header, queueData + start1, (size_t) size1);
+
+    if (size2 > 0)
+        memcpy (reinterpret_cast<char*> (&header) + size1, queueData + start2, (size_t) size2);
+
+    queue.finishedRead (size1 + size2);
+
+    Object& dataset = *objects[header.dataset];
+    const int payloadBytes = (int) (header.numRows * dataset.rowBytes);
+
+    queue.prepareToRead (payloadBytes, start1, size1, start2, size2);
+    collectRows (dataset, queueData + start1, (size_t) size1);
+    collectRows (dataset, queueData + start2, (size_t) size2);
+    queue.finishedRead (size1 + size2);
+
+    return true;
+}
+
+void AsyncHDF5Writer::collectRows (Object& dataset, const char* data, size_t numBytes)
+{
+    if (dataset.hid < 0)
+        return;
+
+    const size_t chunkSize = (size_t) dataset.chunkRows * dataset.rowBytes;
+
+    while (numBytes > 0)
+    {
+        const size_t copied = jmin (numBytes, chunkSize - dataset.chunkFill);
+
+        memcpy (dataset.chunk + dataset.chunkFill, data, copied);
+        dataset.chunkFill += copied;
+        data += copied;
+        numBytes -= copied;
+
+        if (dataset.chunkFill == chunkSize && ! writeChunk (dataset))
+            failed = 1;
+    }
+}
+
+bool AsyncHDF5Writer::writeChunk (Object& dataset)
+{
+    const int numRows = (int) (dataset.chunkFill / dataset.rowBytes);
+    dataset.chunkFill = 0;
+
+    if (numRows == 0)
+        return true;
+
+    const int rank = getRank (dataset.type, dataset.rowShape);
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+
+    dims[0] = (hsize_t) (dataset.rowsWritten + numRows);
+    start[0] = (hsize_t) dataset.rowsWritten;
+    count[0] = (hsize_t) numRows;
+
+    for (int i = 1; i < rank; i++)
+    {
+        dims[i] = count[i] = (hsize_t) jmax (1, dataset.rowShape[i - 1]);
+        start[i] = 0;
+    }
+
+    if (H5Dset_extent (dataset.hid, dims) < 0)
+        return false;
+
+    hid_t fileSpace = H5Dget_space (dataset.hid);
+    H5Sselect_hyperslab (fileSpace, H5S_SELECT_SET, start, nullptr, count, nullptr);
+
+    hid_t memorySpace = H5Screate_simple (rank, count, nullptr);
+    hid_t type = createElementType (dataset.type, dataset.rowShape);
+
+    const bool written = H5Dwrite (dataset.hid, type, memorySpace, fileSpace, H5P_DEFAULT, dataset.chunk) >= 0;
+
+    H5Tclose (type);
+    H5Sclose (memorySpace);
+    H5Sclose (fileSpace);
+
+    dataset.rowsWritten += numRows;
+    return written;
+}
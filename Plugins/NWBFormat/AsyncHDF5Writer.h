@@ -0,0 +1,164 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __ASYNCHDF5WRITER_H_5C2E71A4__
+#define __ASYNCHDF5WRITER_H_5C2E71A4__
+
+#include <RecordingLib.h>
+
+/* Rows waiting for the writer thread, in bytes */
+#define HDF5_QUEUE_SIZE (64 * 1024 * 1024)
+
+/* Objects of at least this many bytes, chunks included, start at a multiple of HDF5_ALIGNMENT in the file */
+#define HDF5_ALIGNMENT_THRESHOLD (64 * 1024)
+#define HDF5_ALIGNMENT 4096
+
+/**
+    Writes an HDF5 file from its own thread.
+
+    The layout is declared first: groups, fixed text datasets and datasets that grow
+    along their first dimension, each with its attributes. start() hands it to the
+    writer thread, which creates the file and all its objects, and from then on the
+    recording thread only copies rows into a lock-free queue with append(). No HDF5
+    call is made outside the writer thread, so the caller never waits on the library
+    or its global lock.
+
+    The writer collects the rows of each growing dataset into a whole chunk and writes
+    it at once, chunk-aligned, optionally shuffled and deflated. finish() writes the
+    partial chunks that are left, sets the final extents and closes the file, so it is
+    complete as soon as finish() returns.
+
+    @see NWBRecording
+*/
+class AsyncHDF5Writer : private Thread
+{
+public:
+    enum ElementType
+    {
+        INT8 = 0,
+        UINT8,
+        INT16,
+        UINT16,
+        INT32,
+        INT64,
+        FLOAT,
+        DOUBLE,
+        TEXT        // fixed-length strings of rowShape[0] characters
+    };
+
+    AsyncHDF5Writer();
+    ~AsyncHDF5Writer();
+
+    /** Declares a group; parent groups must be declared first. Attribute values may be
+        strings, ints, int64s or doubles. Returns the group's index. */
+    int addGroup (const String& path, const NamedValueSet& attributes = NamedValueSet());
+
+    /** Declares a scalar text dataset, written when the file is created */
+    int addText (const String& path, const String& text, const NamedValueSet& attributes = NamedValueSet());
+
+    /** Declares a dataset of rows of rowShape elements that grows with every append().
+        Returns its index for append() */
+    int addDataset (const String& path, ElementType type, const Array<int>& rowShape,
+                    const NamedValueSet& attributes = NamedValueSet());
+
+    /** Size in bytes of a row of a declared dataset */
+    size_t getRowBytes (int dataset) const;
+
+    /** Creates the file with the declared layout from the writer thread. Datasets are chunked
+        in chunks of about chunkBytes and deflated at compressionLevel, 0 for no compression.
+        Returns false if the queue could not be allocated. */
+    bool start (const File& file, int chunkBytes, int compressionLevel);
+
+    /** Queues numRows rows of a dataset. If the queue is full, waits until the writer makes
+        room for them. Called from a single thread. */
+    void append (int dataset, const void* rows, int numRows);
+
+    /** Writes everything queued, closes the file and clears the layout */
+    void finish();
+
+    /** Bytes queued and not yet taken by the writer */
+    int getNumPendingBytes() const;
+
+    /** True if the writer could not create or write some part of the file */
+    bool hasFailed() const;
+
+private:
+    struct Object
+    {
+        String path;
+        NamedValueSet attributes;
+        bool isGroup;
+        bool isGrowing;
+        String text;
+        ElementType type;
+        Array<int> rowShape;
+        size_t rowBytes;
+
+        juce::int64 hid;
+        int chunkRows;
+        HeapBlock<char> chunk;
+        size_t chunkFill;
+        juce::int64 rowsWritten;
+    };
+
+    struct QueuedRows
+    {
+        int dataset;
+        int numRows;
+    };
+
+    void run() override;
+
+    bool createFile();
+    bool createObject (Object& object);
+    bool writeAttributes (juce::int64 location, const NamedValueSet& attributes);
+    void closeFile();
+
+    /** Takes the next rows out of the queue into their dataset's chunk. Returns false if there are none. */
+    bool readRows();
+
+    /** Copies the bytes of rows into the dataset's chunk, writing the chunk out whenever it fills up */
+    void collectRows (Object& dataset, const char* data, size_t numBytes);
+
+    /** Writes the rows collected in the dataset's chunk at the end of the dataset */
+    bool writeChunk (Object& dataset);
+
+    OwnedArray<Object> objects;
+
+    File file;
+    int chunkBytes;
+    int compressionLevel;
+    juce::int64 fileId;
+
+    AbstractFifo queue;
+    HeapBlock<char> queueData;
+    WaitableEvent rowsQueued;
+    WaitableEvent rowsTaken;
+    Atomic<int> finishing;
+    Atomic<int> failed;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AsyncHDF5Writer);
+};
+
+#endif  // __ASYNCHDF5WRITER_H_5C2E71A4__
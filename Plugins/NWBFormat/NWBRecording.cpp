@@ -0,0 +1,529 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "NWBRecording.h"
+
+static NamedValueSet getTimeSeriesAttributes (const String& neurodataType, const String& description)
+{
+    NamedValueSet attributes;
+    attributes.set ("namespace", "core");
+    attributes.set ("neurodata_type", neurodataType);
+    attributes.set ("object_id", Uuid().toDashedString());
+    attributes.set ("description", description);
+    attributes.set ("comments", "no comments");
+    return attributes;
+}
+
+/** HDF5 object names can't hold slashes */
+static String getObjectName (const String& name)
+{
+    return name.replaceCharacters (" /", "__");
+}
+
+/** Shape of rows of a single dimension */
+static Array<int> getRowShape (int length)
+{
+    Array<int> shape;
+    shape.add (length);
+    return shape;
+}
+
+static int16 toInt16 (float sample, float scale)
+{
+    return (int16) jlimit (-0x7fff, 0x7fff, roundToInt (sample * scale));
+}
+
+/** int16 samples are already counts of the channel's bitVolts */
+static int16 toInt16 (int16 sample, float)
+{
+    return sample;
+}
+
+
+NWBRecording::NWBRecording()
+    : m_syncDataset (-1)
+    , m_timeBufferSize (0)
+    , m_compress (false)
+    , m_compressionLevel (4)
+    , m_chunkKiB (NWB_DEFAULT_CHUNK_KB)
+{
+    m_writer = new AsyncHDF5Writer();
+}
+
+NWBRecording::~NWBRecording()
+{
+    m_writer->finish();
+}
+
+String NWBRecording::getEngineID() const
+{
+    return "NWB";
+}
+
+String NWBRecording::getProcessorString (const InfoObjectCommon* channelInfo)
+{
+    return getObjectName (channelInfo->getSourceName()) + "-" + String (channelInfo->getSourceNodeID())
+        + "." + String (channelInfo->getSubProcessorIdx());
+}
+
+NamedValueSet NWBRecording::getDataAttributes (double conversion, const String& unit) const
+{
+    NamedValueSet attributes;
+    attributes.set ("conversion", conversion);
+    attributes.set ("resolution", -1.0);
+    attributes.set ("unit", unit);
+    return attributes;
+}
+
+int NWBRecording::addTimeSeries (const String& path, const String& description)
+{
+    m_writer->addGroup (path, getTimeSeriesAttributes ("TimeSeries", description));
+
+    NamedValueSet timeAttributes;
+    timeAttributes.set ("interval", 1);
+    timeAttributes.set ("unit", "seconds");
+    return m_writer->addDataset (path + "/timestamps", AsyncHDF5Writer::DOUBLE, Array<int>(), timeAttributes);
+}
+
+void NWBRecording::openFiles (File rootFolder, int experimentNumber, int recordingNumber)
+{
+    File nwbFile = rootFolder.getChildFile ("experiment" + String (experimentNumber)
+                                            + "_recording" + String (recordingNumber + 1) + ".nwb");
+
+    NamedValueSet fileAttributes;
+    fileAttributes.set ("namespace", "core");
+    fileAttributes.set ("neurodata_type", "NWBFile");
+    fileAttributes.set ("nwb_version", NWB_VERSION);
+    fileAttributes.set ("object_id", Uuid().toDashedString());
+
+    const String startTime = Time::getCurrentTime().toISO8601 (true);
+
+    m_writer->addGroup ("/", fileAttributes);
+    m_writer->addText ("/identifier", Uuid().toDashedString());
+    m_writer->addText ("/session_description", "Experiment " + String (experimentNumber)
+                       + ", recording " + String (recordingNumber + 1));
+    m_writer->addText ("/session_start_time", startTime);
+    m_writer->addText ("/timestamps_reference_time", startTime);
+    m_writer->addText ("/file_create_date", startTime);
+
+    m_writer->addGroup ("/acquisition");
+    m_writer->addGroup ("/analysis");
+    m_writer->addGroup ("/general");
+    m_writer->addGroup ("/stimulus");
+    m_writer->addGroup ("/stimulus/presentation");
+    m_writer->addGroup ("/stimulus/templates");
+
+    NamedValueSet moduleAttributes = getTimeSeriesAttributes ("ProcessingModule", "Spikes detected during acquisition");
+    moduleAttributes.remove ("comments");
+    m_writer->addGroup ("/processing");
+    m_writer->addGroup ("/processing/ecephys", moduleAttributes);
+
+    m_writer->addText ("/general/data_collection", getLatestSettingsXml());
+    m_syncDataset = m_writer->addDataset ("/general/sync_messages", AsyncHDF5Writer::TEXT, getRowShape (NWB_SYNC_TEXT_LENGTH));
+
+    /* Continuous data: one series per recorded processor */
+    const int numChannels = getNumRecordedChannels();
+    m_channelSeries.insertMultiple (0, 0, numChannels);
+    m_channelColumns.insertMultiple (0, 0, numChannels);
+    m_channelStaged.insertMultiple (0, 0, numChannels);
+    m_blockScales.malloc (jmax (1, numChannels));
+
+    Array<float> channelConversions;
+    Array<int> conversionSeries;
+
+    for (int proc = 0; proc < getNumRecordedProcessors(); proc++)
+    {
+        const RecordProcessorInfo& pInfo = getProcessorInfo (proc);
+        const int recChans = pInfo.recordedChannels.size();
+
+        if (recChans == 0)
+            continue;
+
+        const DataChannel* firstChannel = getDataChannel (getRealChannel (pInfo.recordedChannels[0]));
+        const String path = "/acquisition/" + getProcessorString (firstChannel);
+
+        ScopedPointer<ContinuousSeries> series = new ContinuousSeries();
+        series->numChannels = recChans;
+        series->sampleRate = firstChannel->getSampleRate();
+        series->blockRows = NWB_STAGING_SAMPLES;
+        series->block.malloc ((size_t) NWB_STAGING_SAMPLES * recChans);
+
+        series->timestampDataset = addTimeSeries (path, String (recChans) + " channels of " + firstChannel->getSourceName());
+        series->dataset = m_writer->addDataset (path + "/data", AsyncHDF5Writer::INT16, getRowShape (recChans),
+                                                getDataAttributes (firstChannel->getBitVolts() * 1e-6, "volts"));
+
+        NamedValueSet conversionAttributes;
+        conversionAttributes.set ("axis", 1);
+        const int conversionDataset = m_writer->addDataset (path + "/channel_conversion", AsyncHDF5Writer::FLOAT,
+                                                            Array<int>(), conversionAttributes);
+
+        for (int chan = 0; chan < recChans; chan++)
+        {
+            const int recordedChan = pInfo.recordedChannels[chan];
+            const DataChannel* channelInfo = getDataChannel (getRealChannel (recordedChan));
+
+            m_channelSeries.set (recordedChan, m_continuous.size());
+            m_channelColumns.set (recordedChan, chan);
+
+            channelConversions.add (channelInfo->getBitVolts() / firstChannel->getBitVolts());
+            conversionSeries.add (conversionDataset);
+        }
+
+        m_continuous.add (series.release());
+    }
+
+    /* Events */
+    const int numEvents = getNumRecordedEvents();
+
+    for (int ev = 0; ev < numEvents; ev++)
+    {
+        const EventChannel* chan = getEventChannel (ev);
+        String path = "/acquisition/" + getProcessorString (chan);
+
+        ScopedPointer<EventSeries> series = new EventSeries();
+        series->sampleRate = chan->getSampleRate();
+
+        switch (chan->getChannelType())
+        {
+            case EventChannel::TTL:
+                path += "_TTL_" + String (chan->getSourceIndex() + 1);
+                series->timestampDataset = addTimeSeries (path, "TTL lines, positive when set and negative when cleared");
+                series->dataset = m_writer->addDataset (path + "/data", AsyncHDF5Writer::INT16, Array<int>(),
+                                                        getDataAttributes (1.0, "n/a"));
+                break;
+
+            case EventChannel::TEXT:
+                path += "_TEXT_" + String (chan->getSourceIndex() + 1);
+                series->timestampDataset = addTimeSeries (path, chan->getDescription());
+                series->dataset = m_writer->addDataset (path + "/data", AsyncHDF5Writer::TEXT,
+                                                        getRowShape ((int) chan->getDataSize()),
+                                                        getDataAttributes (1.0, "n/a"));
+                break;
+
+            default:
+                path += "_BINARY_" + String (chan->getSourceIndex() + 1);
+                series->timestampDataset = addTimeSeries (path, chan->getDescription());
+                series->dataset = m_writer->addDataset (path + "/data", AsyncHDF5Writer::UINT8,
+                                                        getRowShape ((int) chan->getDataSize()),
+                                                        getDataAttributes (1.0, "n/a"));
+                break;
+        }
+
+        series->sampleDataset = m_writer->addDataset (path + "/sample_numbers", AsyncHDF5Writer::INT64, Array<int>());
+        series->extraDataset = m_writer->addDataset (path + "/channels", AsyncHDF5Writer::UINT16, Array<int>());
+
+        m_events.add (series.release());
+    }
+
+    /* Spikes: one series per electrode */
+    const int numSpikes = getNumRecordedSpikes();
+    int maxWaveformSamples = 0;
+
+    for (int sp = 0; sp < numSpikes; sp++)
+    {
+        const SpikeChannel* chan = getSpikeChannel (sp);
+        const String path = "/processing/ecephys/" + getObjectName (chan->getName()) + "_" + String (sp);
+
+        ScopedPointer<EventSeries> series = new EventSeries();
+        series->sampleRate = chan->getSampleRate();
+
+        Array<int> waveformShape;
+        waveformShape.add ((int) chan->getNumChannels());
+        waveformShape.add ((int) chan->getTotalSamples());
+
+        series->timestampDataset = addTimeSeries (path, "Spike waveforms from " + chan->getSourceName());
+        series->dataset = m_writer->addDataset (path + "/data", AsyncHDF5Writer::INT16, waveformShape,
+                                                getDataAttributes (chan->getChannelBitVolts (0) * 1e-6, "volts"));
+        series->sampleDataset = m_writer->addDataset (path + "/sample_numbers", AsyncHDF5Writer::INT64, Array<int>());
+        series->extraDataset = m_writer->addDataset (path + "/sorted_ids", AsyncHDF5Writer::UINT16, Array<int>());
+
+        maxWaveformSamples = jmax (maxWaveformSamples, (int) (chan->getNumChannels() * chan->getTotalSamples()));
+        m_spikes.add (series.release());
+    }
+
+    /* Scratch buffers are sized here, so the RecordThread doesn't allocate */
+    m_timeBufferSize = NWB_STAGING_SAMPLES;
+    m_timeBuffer.malloc (m_timeBufferSize);
+    m_spikeBuffer.malloc (jmax (1, maxWaveformSamples));
+    m_syncText.malloc (NWB_SYNC_TEXT_LENGTH);
+
+    const int compressionLevel = m_compress ? m_compressionLevel : 0;
+
+    if (! m_writer->start (nwbFile, m_chunkKiB * 1024, compressionLevel))
+    {
+        std::cout << "NWB: could not allocate the write queue for " << nwbFile.getFullPathName() << std::endl;
+        return;
+    }
+
+    for (int i = 0; i < channelConversions.size(); i++)
+        m_writer->append (conversionSeries[i], &channelConversions.getReference (i), 1);
+}
+
+void NWBRecording::closeFiles()
+{
+    resetChannels();
+}
+
+void NWBRecording::resetChannels()
+{
+    m_writer->finish();
+
+    if (m_writer->hasFailed())
+        std::cout << "NWB: some of the recording could not be written" << std::endl;
+
+    m_continuous.clear();
+    m_events.clear();
+    m_spikes.clear();
+    m_channelSeries.clear();
+    m_channelColumns.clear();
+    m_channelStaged.clear();
+    m_syncDataset = -1;
+}
+
+template <typename SampleType>
+void NWBRecording::stageSamples (int writeChannel, const SampleType* buffer, float scale, int size)
+{
+    ContinuousSeries& series = *m_continuous[m_channelSeries[writeChannel]];
+    const int staged = m_channelStaged[writeChannel];
+
+    growStagingBlock (series, staged, size);
+
+    int16* dest = series.block + (size_t) staged * series.numChannels + m_channelColumns[writeChannel];
+
+    for (int i = 0; i < size; i++)
+        dest[(size_t) i * series.numChannels] = toInt16 (buffer[i], scale);
+
+    m_channelStaged.set (writeChannel, staged + size);
+
+    // after a wrap of the record queue, getTimestamp() already points past the staged samples
+    if (m_channelColumns[writeChannel] == 0)
+        writeSampleTimes (series, getTimestamp (writeChannel), size);
+}
+
+template <typename SampleType>
+void NWBRecording::stageBlock (int firstWriteChannel, const SampleType* const* channels, int numChannels, int size)
+{
+    int ch = 0;
+
+    while (ch < numChannels)
+    {
+        const int first = firstWriteChannel + ch;
+        const int staged = m_channelStaged[first];
+
+        int run = 1;
+        while (ch + run < numChannels
+               && m_channelSeries[first + run] == m_channelSeries[first]
+               && m_channelColumns[first + run] == m_channelColumns[first] + run
+               && m_channelStaged[first + run] == staged)
+        {
+            run++;
+        }
+
+        ContinuousSeries& series = *m_continuous[m_channelSeries[first]];
+        growStagingBlock (series, staged, size);
+
+        for (int c = 0; c < run; c++)
+            m_blockScales[c] = 1.0f / getDataChannel (first + c)->getBitVolts();
+
+        const SampleType* const* runChannels = channels + ch;
+        int16* dest = series.block + (size_t) staged * series.numChannels + m_channelColumns[first];
+
+        for (int i = 0; i < size; i++)
+        {
+            int16* row = dest + (size_t) i * series.numChannels;
+
+            for (int c = 0; c < run; c++)
+                row[c] = toInt16 (runChannels[c][i], m_blockScales[c]);
+        }
+
+        for (int c = 0; c < run; c++)
+            m_channelStaged.set (first + c, staged + size);
+
+        if (m_channelColumns[first] == 0)
+            writeSampleTimes (series, getTimestamp (first), size);
+
+        ch += run;
+    }
+}
+
+void NWBRecording::growStagingBlock (ContinuousSeries& series, int staged, int size)
+{
+    if (staged + size > series.blockRows)
+    {
+        // only blocks longer than any seen so far grow the staging block
+        series.blockRows = staged + size;
+        series.block.realloc ((size_t) series.blockRows * series.numChannels);
+    }
+}
+
+void NWBRecording::writeSampleTimes (ContinuousSeries& series, juce::int64 firstSample, int size)
+{
+    for (int start = 0; start < size; start += m_timeBufferSize)
+    {
+        const int chunk = jmin (m_timeBufferSize, size - start);
+
+        for (int i = 0; i < chunk; i++)
+            m_timeBuffer[i] = double (firstSample + start + i) / series.sampleRate;
+
+        m_writer->append (series.timestampDataset, m_timeBuffer, chunk);
+    }
+}
+
+void NWBRecording::writeData (int writeChannel, int realChannel, const float* buffer, int size)
+{
+    if (size > 0)
+        stageSamples (writeChannel, buffer, 1.0f / getDataChannel (realChannel)->getBitVolts(), size);
+}
+
+void NWBRecording::writeInt16Data (int writeChannel, int realChannel, const int16* buffer, int size)
+{
+    if (size > 0)
+        stageSamples (writeChannel, buffer, 1.0f, size);
+}
+
+void NWBRecording::writeDataBlock (int firstWriteChannel, const float* const* channels, int numChannels, int numSamples, const juce::int64*)
+{
+    if (numSamples > 0)
+        stageBlock (firstWriteChannel, channels, numChannels, numSamples);
+}
+
+void NWBRecording::writeInt16DataBlock (int firstWriteChannel, const int16* const* channels, int numChannels, int numSamples, const juce::int64*)
+{
+    if (numSamples > 0)
+        stageBlock (firstWriteChannel, channels, numChannels, numSamples);
+}
+
+void NWBRecording::endChannelBlock (bool lastBlock)
+{
+    /* Each processor's block goes out as one run of interleaved rows */
+    for (int ch = 0; ch < m_channelStaged.size(); ch++)
+    {
+        if (m_channelColumns[ch] != 0 || m_channelStaged[ch] == 0)
+            continue;
+
+        const ContinuousSeries& series = *m_continuous[m_channelSeries[ch]];
+        m_writer->append (series.dataset, series.block, m_channelStaged[ch]);
+    }
+
+    for (int ch = 0; ch < m_channelStaged.size(); ch++)
+        m_channelStaged.set (ch, 0);
+}
+
+int NWBRecording::getNumPendingWrites() const
+{
+    const int chunkBytes = m_chunkKiB * 1024;
+    return (m_writer->getNumPendingBytes() + chunkBytes - 1) / chunkBytes;
+}
+
+void NWBRecording::writeEvent (int eventIndex, const MidiMessage& event)
+{
+    EventSeries* series = m_events[eventIndex];
+
+    if (series == nullptr)
+        return;
+
+    const EventChannel* info = getEventChannel (eventIndex);
+    EventPtr ev = Event::deserializeFromMessage (event, info);
+
+    if (ev == nullptr)
+        return;
+
+    if (ev->getEventType() == EventChannel::TTL)
+    {
+        TTLEvent* ttl = static_cast<TTLEvent*> (ev.get());
+        int16 state = (int16) ((ttl->getChannel() + 1) * (ttl->getState() ? 1 : -1));
+        m_writer->append (series->dataset, &state, 1);
+    }
+    else
+    {
+        m_writer->append (series->dataset, ev->getRawDataPointer(), 1);
+    }
+
+    const juce::int64 sample = ev->getTimestamp();
+    const double time = double (sample) / series->sampleRate;
+    const uint16 channel = (uint16) (ev->getChannel() + 1);
+
+    m_writer->append (series->timestampDataset, &time, 1);
+    m_writer->append (series->sampleDataset, &sample, 1);
+    m_writer->append (series->extraDataset, &channel, 1);
+}
+
+void NWBRecording::writeTimestampSyncText (uint16 sourceID, uint16 sourceIdx, juce::int64 timestamp, float, String text)
+{
+    if (m_syncDataset < 0)
+        return;
+
+    zeromem (m_syncText, NWB_SYNC_TEXT_LENGTH);
+    text.copyToUTF8 (m_syncText, NWB_SYNC_TEXT_LENGTH);
+    m_writer->append (m_syncDataset, m_syncText, 1);
+}
+
+void NWBRecording::addSpikeElectrode (int index, const SpikeChannel* elec)
+{
+}
+
+void NWBRecording::writeSpike (int electrodeIndex, const SpikeEvent* spike)
+{
+    EventSeries* series = m_spikes[electrodeIndex];
+
+    if (series == nullptr)
+        return;
+
+    const SpikeChannel* channel = getSpikeChannel (electrodeIndex);
+    const int totalSamples = (int) (channel->getTotalSamples() * channel->getNumChannels());
+    const float scale = 1.0f / channel->getChannelBitVolts (0);
+    const float* waveform = spike->getDataPointer();
+
+    for (int i = 0; i < totalSamples; i++)
+        m_spikeBuffer[i] = toInt16 (waveform[i], scale);
+
+    const juce::int64 sample = spike->getTimestamp();
+    const double time = double (sample) / series->sampleRate;
+    const uint16 sortedId = spike->getSortedID();
+
+    m_writer->append (series->dataset, m_spikeBuffer, 1);
+    m_writer->append (series->timestampDataset, &time, 1);
+    m_writer->append (series->sampleDataset, &sample, 1);
+    m_writer->append (series->extraDataset, &sortedId, 1);
+}
+
+RecordEngineManager* NWBRecording::getEngineManager()
+{
+    RecordEngineManager* man = new RecordEngineManager ("NWB", "NWB", &(engineFactory<NWBRecording>));
+    EngineParameter* param;
+    param = new EngineParameter (EngineParameter::BOOL, 0, "Compress datasets (deflate)", false);
+    man->addParameter (param);
+    param = new EngineParameter (EngineParameter::INT, 1, "Compression level", 4, 1, 9);
+    man->addParameter (param);
+    param = new EngineParameter (EngineParameter::INT, 2, "Chunk size (KiB)", NWB_DEFAULT_CHUNK_KB, 64, 16384);
+    man->addParameter (param);
+    return man;
+}
+
+void NWBRecording::setParameter (EngineParameter& parameter)
+{
+    boolParameter (0, m_compress);
+    intParameter (1, m_compressionLevel);
+    intParameter (2, m_chunkKiB);
+}
@@ -0,0 +1,153 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __NWBRECORDING_H_3F8B12D6__
+#define __NWBRECORDING_H_3F8B12D6__
+
+#include <RecordingLib.h>
+#include "AsyncHDF5Writer.h"
+
+#define NWB_VERSION "2.2.5"
+
+/* Default size of the dataset chunks, in KiB */
+#define NWB_DEFAULT_CHUNK_KB 1024
+
+/* Rows of the continuous staging blocks allocated when the files are opened */
+#define NWB_STAGING_SAMPLES 4096
+
+/* Characters kept of each sync message */
+#define NWB_SYNC_TEXT_LENGTH 256
+
+/**
+    Records to a single NWB 2 (HDF5) file per recording, so sessions don't need to be
+    converted from Binary before they are archived.
+
+    Each recorded processor is a TimeSeries in /acquisition holding its int16 samples,
+    interleaved by channel, and the time of each sample. Event channels are TimeSeries
+    in /acquisition too, and spike electrodes in the /processing/ecephys module.
+
+    The RecordThread only converts and interleaves the samples; every HDF5 call is made
+    by the AsyncHDF5Writer's thread, which writes whole, optionally deflated chunks.
+    closeFiles() returns once the file is complete and closed.
+
+    @see AsyncHDF5Writer
+*/
+class NWBRecording : public RecordEngine
+{
+public:
+    NWBRecording();
+    ~NWBRecording();
+
+    String getEngineID() const override;
+
+    void openFiles (File rootFolder, int experimentNumber, int recordingNumber) override;
+    void closeFiles() override;
+
+    void writeData (int writeChannel, int realChannel, const float* buffer, int size) override;
+    void writeInt16Data (int writeChannel, int realChannel, const int16* buffer, int size) override;
+    void writeDataBlock (int firstWriteChannel, const float* const* channels, int numChannels, int numSamples, const juce::int64* timestamps) override;
+    void writeInt16DataBlock (int firstWriteChannel, const int16* const* channels, int numChannels, int numSamples, const juce::int64* timestamps) override;
+    void endChannelBlock (bool lastBlock) override;
+    int getNumPendingWrites() const override;
+
+    void writeEvent (int eventIndex, const MidiMessage& event) override;
+    void writeTimestampSyncText (uint16 sourceID, uint16 sourceIdx, juce::int64 timestamp, float, String text) override;
+
+    void addSpikeElectrode (int index, const SpikeChannel* elec) override;
+    void writeSpike (int electrodeIndex, const SpikeEvent* spike) override;
+
+    void resetChannels() override;
+    void setParameter (EngineParameter& parameter) override;
+
+    static RecordEngineManager* getEngineManager();
+
+private:
+    /** A recorded processor: its samples are staged as rows of numChannels interleaved channels */
+    struct ContinuousSeries
+    {
+        int dataset;
+        int timestampDataset;
+        int numChannels;
+        double sampleRate;
+        HeapBlock<int16> block;
+        int blockRows;
+    };
+
+    /** An event channel or spike electrode */
+    struct EventSeries
+    {
+        int dataset;
+        int timestampDataset;
+        int sampleDataset;
+        int extraDataset;       // event channels for events, sorted ids for spikes
+        double sampleRate;
+    };
+
+    /** Declares a TimeSeries group with its timestamps and sample numbers */
+    int addTimeSeries (const String& path, const String& description);
+
+    NamedValueSet getDataAttributes (double conversion, const String& unit) const;
+
+    /** Converts or copies samples of a recorded channel into its column of the processor's staging block */
+    template <typename SampleType>
+    void stageSamples (int writeChannel, const SampleType* buffer, float scale, int size);
+
+    /** Interleaves a span of recorded channels into the staging blocks row by row, in one pass
+        over the channels of each processor that fill consecutive columns */
+    template <typename SampleType>
+    void stageBlock (int firstWriteChannel, const SampleType* const* channels, int numChannels, int size);
+
+    /** Makes room in a processor's staging block for rows up to staged + size */
+    void growStagingBlock (ContinuousSeries& series, int staged, int size);
+
+    /** Queues the sample times of a block of a recorded processor */
+    void writeSampleTimes (ContinuousSeries& series, juce::int64 firstSample, int size);
+
+    static String getProcessorString (const InfoObjectCommon* channelInfo);
+
+    ScopedPointer<AsyncHDF5Writer> m_writer;
+
+    OwnedArray<ContinuousSeries> m_continuous;
+    OwnedArray<EventSeries> m_events;
+    OwnedArray<EventSeries> m_spikes;
+
+    Array<int> m_channelSeries;
+    Array<int> m_channelColumns;
+    Array<int> m_channelStaged;
+    int m_syncDataset;
+
+    HeapBlock<double> m_timeBuffer;
+    int m_timeBufferSize;
+    HeapBlock<float> m_blockScales;
+    HeapBlock<int16> m_spikeBuffer;
+    HeapBlock<char> m_syncText;
+
+    bool m_compress;
+    int m_compressionLevel;
+    int m_chunkKiB;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NWBRecording);
+};
+
+#endif  // __NWBRECORDING_H_3F8B12D6__
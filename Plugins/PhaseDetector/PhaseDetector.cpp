@@ -23,10 +23,12 @@
 #include <stdio.h>
 #include "PhaseDetector.h"
 #include "PhaseDetectorEditor.h"
+#include <DspLib.h>
 
 
 PhaseDetector::PhaseDetector()
     : GenericProcessor      ("Phase Detector")
+    , maskSize              (0)
     , activeModule          (-1)
     , risingPos             (false)
     , risingNeg             (false)
@@ -64,8 +66,12 @@ void PhaseDetector::addModule()
     m.samplesSinceTrigger = 5000;
     m.wasTriggered = false;
     m.phase = NO_PHASE;
+    m.latencyMs = -1.0f;
+    m.pendingTrigger = -1;
+    m.lastTrigger = 0;
 
     modules.add (m);
+    predictors.add (new PhasePredictor());
 }
 
 
@@ -129,6 +135,10 @@ void PhaseDetector::setParameter (int parameterIndex, float newValue)
             module.isActive = false;
         }
     }
+    else if (parameterIndex == 5)   // latency compensation, in ms
+    {
+        module.latencyMs = newValue;
+    }
 }
 
 //Usually, to be more ordered, we'd create the event channels overriding the createEventChannels() method.
@@ -187,6 +197,16 @@ void PhaseDetector::updateSettings()
 
 bool PhaseDetector::enable()
 {
+    for (int i = 0; i < modules.size(); ++i)
+    {
+        DetectorModule& module = modules.getReference (i);
+        module.pendingTrigger = -1;
+        module.lastTrigger = std::numeric_limits<int64>::min() / 2;
+
+        if (const DataChannel* in = getDataChannel (module.inputChan))
+            predictors[i]->prepare (in->getSampleRate());
+    }
+
     return true;
 }
 
@@ -200,11 +220,11 @@ void PhaseDetector::handleEvent (const EventChannel* channelInfo, const MidiMess
 
     if (Event::getEventType(event)  == EventChannel::TTL)
     {
-		TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, channelInfo);
+		EventView ttl(event, channelInfo);
 
         // int eventNodeId = *(dataptr+1);
-		const int eventId = ttl->getState() ? 1 : 0;
-		const int eventChannel = ttl->getChannel();
+		const int eventId = ttl.getState() ? 1 : 0;
+		const int eventChannel = ttl.getChannel();
 
         for (int i = 0; i < modules.size(); ++i)
         {
@@ -231,90 +251,169 @@ void PhaseDetector::process (AudioSampleBuffer& buffer)
     {
         DetectorModule& module = modules.getReference (m);
 
+        if (module.latencyMs >= 0)
+        {
+            if (module.outputChan >= 0
+                && module.inputChan >= 0
+                && module.inputChan < buffer.getNumChannels())
+                processPredicted (m, buffer);
+
+            continue;
+        }
+
         // check to see if it's active and has a channel
         if (module.isActive && module.outputChan >= 0
             && module.inputChan >= 0
             && module.inputChan < buffer.getNumChannels())
         {
-            for (int i = 0; i < getNumSamples (module.inputChan); ++i)
+            processDetected (m, buffer);
+        }
+    }
+}
+
+
+void PhaseDetector::processDetected (int m, AudioSampleBuffer& buffer)
+{
+    DetectorModule& module = modules.getReference (m);
+
+    const int numSamples = getNumSamples (module.inputChan);
+
+    if (numSamples <= 0)
+        return;
+
+    const float* samples = buffer.getReadPointer (module.inputChan);
+    const int64 firstTimestamp = getTimestamp (module.inputChan);
+
+    const int numWords = (numSamples + 31) / 32;
+
+    if (numWords > maskSize)
+    {
+        phaseMask.malloc (numWords);
+        otherMask.malloc (numWords);
+        maskSize = numWords;
+    }
+
+    phaseMask.clear (numWords);
+    otherMask.clear (numWords);
+
+    // the module types are numbered as the quarters of the cycle they trigger on
+    Dsp::VectorOps::markQuarter (samples, numSamples, module.lastSample, (int) module.type, phaseMask, otherMask);
+
+    static const PhaseType quarterPhases[] = { NO_PHASE, FALLING_POS, FALLING_NEG, RISING_NEG, RISING_POS };
+    const PhaseType targetPhase = quarterPhases[module.type];
+
+    // the state machine only triggers when it enters the quarter from another one
+    bool inQuarter = module.type != NONE && module.phase == targetPhase;
+    int lastTrigger = -module.samplesSinceTrigger;
+    int i = 0;
+
+    while (module.type != NONE)
+    {
+        if (inQuarter)
+        {
+            i = Dsp::VectorOps::findNextMarked (otherMask, i, numSamples);
+
+            if (i == numSamples)
+                break;
+
+            inQuarter = false;
+        }
+
+        i = Dsp::VectorOps::findNextMarked (phaseMask, i, numSamples);
+
+        if (i == numSamples)
+            break;
+
+        if (module.wasTriggered && lastTrigger + 1001 < i)
+        {
+            addTTLEvent(moduleEventChannels[m], firstTimestamp + lastTrigger + 1001, module.outputChan, false, lastTrigger + 1001);
+            module.wasTriggered = false;
+        }
+
+        addTTLEvent(moduleEventChannels[m], firstTimestamp + i, module.outputChan, true, i);
+        module.wasTriggered = true;
+        lastTrigger = i;
+        inQuarter = true;
+    }
+
+    // a trigger is held for 1001 samples
+    if (module.wasTriggered && lastTrigger + 1001 < numSamples)
+    {
+        addTTLEvent(moduleEventChannels[m], firstTimestamp + lastTrigger + 1001, module.outputChan, false, lastTrigger + 1001);
+        module.wasTriggered = false;
+    }
+
+    if (module.wasTriggered)
+        module.samplesSinceTrigger = numSamples - lastTrigger;
+
+    module.phase = inQuarter ? targetPhase : NO_PHASE;
+    module.lastSample = samples[numSamples - 1];
+}
+
+
+void PhaseDetector::processPredicted (int m, AudioSampleBuffer& buffer)
+{
+    DetectorModule& module = modules.getReference (m);
+    PhasePredictor& predictor = *predictors[m];
+
+    double targetPhase;
+
+    switch (module.type)
+    {
+        case PEAK: targetPhase = 0; break;
+        case FALLING_ZERO: targetPhase = double_Pi / 2; break;
+        case TROUGH: targetPhase = double_Pi; break;
+        case RISING_ZERO: targetPhase = 3 * double_Pi / 2; break;
+        default: targetPhase = -1; break;
+    }
+
+    const double latencySamples = module.latencyMs * getDataChannel (module.inputChan)->getSampleRate() / 1000.0;
+    const int64 firstTimestamp = getTimestamp (module.inputChan);
+    const float* samples = buffer.getReadPointer (module.inputChan);
+
+    for (int i = 0; i < getNumSamples (module.inputChan); ++i)
+    {
+        const int64 timestamp = firstTimestamp + i;
+
+        // the predictor follows the input while gated, so its history stays continuous
+        if (predictor.addSample (samples[i])
+            && predictor.isValid()
+            && module.isActive
+            && targetPhase >= 0)
+        {
+            const double period = 1.0 / predictor.getFrequency();
+            double lead = predictor.getSamplesUntilPhase (targetPhase) - latencySamples;
+
+            while (lead < 0)
+                lead += period;
+
+            // schedule the trigger if it is due before the next estimate, once per cycle
+            const int64 trigger = timestamp + (int64) lead;
+
+            if (lead < predictor.getSamplesPerEstimate()
+                && trigger - module.lastTrigger > period / 2)
+                module.pendingTrigger = trigger;
+        }
+
+        if (module.pendingTrigger >= 0 && timestamp >= module.pendingTrigger)
+        {
+            addTTLEvent(moduleEventChannels[m], timestamp, module.outputChan, true, i);
+            module.samplesSinceTrigger = 0;
+            module.wasTriggered = true;
+            module.lastTrigger = timestamp;
+            module.pendingTrigger = -1;
+        }
+
+        if (module.wasTriggered)
+        {
+            if (module.samplesSinceTrigger > 1000)
+            {
+                addTTLEvent(moduleEventChannels[m], timestamp, module.outputChan, false, i);
+                module.wasTriggered = false;
+            }
+            else
             {
-                const float sample = *buffer.getReadPointer (module.inputChan, i);
-
-                if (sample < module.lastSample
-                    && sample > 0
-                    && module.phase != FALLING_POS)
-                {
-                    if (module.type == PEAK)
-                    {
-						uint8 ttlData = 1 << module.outputChan;
-						TTLEventPtr event = TTLEvent::createTTLEvent(moduleEventChannels[m], getTimestamp(module.inputChan) + i, &ttlData, sizeof(uint8), module.outputChan);
-						addEvent(moduleEventChannels[m], event, i);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = FALLING_POS;
-                }
-                else if (sample < 0
-                         && module.lastSample >= 0
-                         && module.phase != FALLING_NEG)
-                {
-                    if (module.type == FALLING_ZERO)
-                    {
-						uint8 ttlData = 1 << module.outputChan;
-						TTLEventPtr event = TTLEvent::createTTLEvent(moduleEventChannels[m], getTimestamp(module.inputChan) + i, &ttlData, sizeof(uint8), module.outputChan);
-						addEvent(moduleEventChannels[m], event, i);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = FALLING_NEG;
-                }
-                else if (sample > module.lastSample && sample < 0 && module.phase != RISING_NEG)
-                {
-                    if (module.type == TROUGH)
-                    {
-						uint8 ttlData = 1 << module.outputChan;
-						TTLEventPtr event = TTLEvent::createTTLEvent(moduleEventChannels[m], getTimestamp(module.inputChan) + i, &ttlData, sizeof(uint8), module.outputChan);
-						addEvent(moduleEventChannels[m], event, i);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = RISING_NEG;
-                }
-                else if (sample > 0
-                         && module.lastSample <= 0
-                         && module.phase != RISING_POS)
-                {
-                    if (module.type == RISING_ZERO)
-                    {
-						uint8 ttlData = 1 << module.outputChan;
-						TTLEventPtr event = TTLEvent::createTTLEvent(moduleEventChannels[m], getTimestamp(module.inputChan) + i, &ttlData, sizeof(uint8), module.outputChan);
-						addEvent(moduleEventChannels[m], event, i);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = RISING_POS;
-                }
-
-                module.lastSample = sample;
-
-                if (module.wasTriggered)
-                {
-                    if (module.samplesSinceTrigger > 1000)
-                    {
-						uint8 ttlData = 0;
-						TTLEventPtr event = TTLEvent::createTTLEvent(moduleEventChannels[m], getTimestamp(module.inputChan) + i, &ttlData, sizeof(uint8), module.outputChan);
-						addEvent(moduleEventChannels[m], event, i);
-                        module.wasTriggered = false;
-                    }
-                    else
-                    {
-                        module.samplesSinceTrigger++;
-                    }
-                }
+                module.samplesSinceTrigger++;
             }
         }
     }
@@ -26,6 +26,7 @@
 
 
 #include <ProcessorHeaders.h>
+#include "PhasePredictor.h"
 
 #define NUM_INTERVALS 5
 
@@ -34,6 +35,10 @@
 
     Uses peaks to estimate the phase of a continuous signal.
 
+    A module either reacts to the phase, triggering once the signal has passed it, or
+    predicts it with a PhasePredictor and triggers ahead of it by its latency
+    compensation, so the output reaches the hardware at that phase.
+
     @see GenericProcessor, PhaseDetectorEditor
 */
 class PhaseDetector : public GenericProcessor
@@ -62,6 +67,12 @@ private:
 
     void estimateFrequency();
 
+    /** Triggers the module at the first sample of each quarter of the cycle of its type */
+    void processDetected (int module, AudioSampleBuffer& buffer);
+
+    /** Triggers the module ahead of the predicted phase of its input */
+    void processPredicted (int module, AudioSampleBuffer& buffer);
+
     enum ModuleType
     {
         NONE, PEAK, FALLING_ZERO, TROUGH, RISING_ZERO
@@ -86,9 +97,19 @@ private:
 
         ModuleType type;
         PhaseType phase;
+
+        float latencyMs;        // how far ahead of the predicted phase to trigger; < 0 reacts to it
+        int64 pendingTrigger;   // timestamp of the next predicted trigger, or -1
+        int64 lastTrigger;
     };
 
     Array<DetectorModule> modules;
+    OwnedArray<PhasePredictor> predictors;
+
+    /** Samples of the block in the quarter of the cycle a module triggers on, and in the others */
+    HeapBlock<uint32> phaseMask;
+    HeapBlock<uint32> otherMask;
+    int maskSize;
 
     int activeModule;
 
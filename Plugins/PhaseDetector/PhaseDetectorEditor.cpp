@@ -189,6 +189,7 @@ void PhaseDetectorEditor::saveCustomParameters(XmlElement* xml)
         d->setAttribute("INPUT",interfaces[i]->getInputChan());
         d->setAttribute("GATE",interfaces[i]->getGateChan());
         d->setAttribute("OUTPUT",interfaces[i]->getOutputChan());
+        d->setAttribute("LATENCY",interfaces[i]->getLatency());
     }
 }
 
@@ -211,6 +212,7 @@ void PhaseDetectorEditor::loadCustomParameters(XmlElement* xml)
             interfaces[i]->setInputChan(xmlNode->getIntAttribute("INPUT"));
             interfaces[i]->setGateChan(xmlNode->getIntAttribute("GATE"));
             interfaces[i]->setOutputChan(xmlNode->getIntAttribute("OUTPUT"));
+            interfaces[i]->setLatency((float) xmlNode->getDoubleAttribute("LATENCY", -1.0));
 
             i++;
         }
@@ -293,6 +295,25 @@ DetectorInterface::DetectorInterface(PhaseDetector* pd, Colour c, int id) :
     outputSelector->setSelectedId(1);
     addAndMakeVisible(outputSelector);
 
+    latencies.add(0.0f);
+    latencies.add(5.0f);
+    latencies.add(10.0f);
+    latencies.add(20.0f);
+    latencies.add(50.0f);
+
+    latencySelector = new ComboBox();
+    latencySelector->setBounds(5,58,55,18);
+    latencySelector->setTooltip("Predict the phase and trigger this far ahead of it, to compensate the output latency; - triggers once the phase is detected");
+    latencySelector->addItem("-",1);
+    latencySelector->addListener(this);
+
+    for (int i = 0; i < latencies.size(); i++)
+    {
+        latencySelector->addItem(String(latencies[i]) + " ms",i+2);
+    }
+    latencySelector->setSelectedId(1);
+    addAndMakeVisible(latencySelector);
+
 
    // std::cout << "Updating channels" << std::endl;
 
@@ -328,8 +349,11 @@ void DetectorInterface::comboBoxChanged(ComboBox* c)
     else if (c == gateSelector)
     {
         parameterIndex = 4;
-    } else {
-        
+    }
+    else if (c == latencySelector)
+    {
+        processor->setParameter(5, getLatency());
+        return;
     }
 
     processor->setParameter(parameterIndex, (float) c->getSelectedId() - 2);
@@ -434,6 +458,21 @@ void DetectorInterface::setGateChan(int chan)
     processor->setParameter(4, (float) chan);
 }
 
+void DetectorInterface::setLatency(float latency)
+{
+    latencySelector->setSelectedId(latencies.indexOf(latency)+2);
+
+    processor->setActiveModule(idNum);
+    processor->setParameter(5, getLatency());
+}
+
+float DetectorInterface::getLatency()
+{
+    int index = latencySelector->getSelectedId()-2;
+
+    return index >= 0 ? latencies[index] : -1.0f;
+}
+
 int DetectorInterface::getInputChan()
 {
     return inputSelector->getSelectedId()-2;
@@ -451,6 +490,7 @@ int DetectorInterface::getGateChan()
 void DetectorInterface::setEnableStatus(bool status)
 {
 	inputSelector->setEnabled(status);
+	latencySelector->setEnabled(status);
 	for (int i = 0; i < phaseButtons.size(); i++)
 		phaseButtons[i]->setEnabled(status);
 }
\ No newline at end of file
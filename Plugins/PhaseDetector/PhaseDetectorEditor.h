@@ -102,11 +102,13 @@ public:
     void setInputChan(int);
     void setOutputChan(int);
     void setGateChan(int);
+    void setLatency(float);
 
     int getPhase();
     int getInputChan();
     int getOutputChan();
     int getGateChan();
+    float getLatency();
 
 	void setEnableStatus(bool status);
 
@@ -126,6 +128,10 @@ private:
     ScopedPointer<ComboBox> inputSelector;
     ScopedPointer<ComboBox> gateSelector;
     ScopedPointer<ComboBox> outputSelector;
+    ScopedPointer<ComboBox> latencySelector;
+
+    /** Latency compensation of each item of latencySelector after the first, in ms */
+    Array<float> latencies;
 
 };
 
@@ -0,0 +1,272 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "PhasePredictor.h"
+
+#include <cmath>
+
+
+static double wrapPhase (double phase)
+{
+    phase = std::fmod (phase, 2.0 * double_Pi);
+    return phase < 0 ? phase + 2.0 * double_Pi : phase;
+}
+
+
+PhasePredictor::PhasePredictor()
+    : factor            (1)
+    , numAccumulated    (0)
+    , accumulator       (0)
+    , historyIndex      (0)
+    , numDecimated      (0)
+    , samplesSinceFit   (0)
+    , modelFitted       (false)
+    , valid             (false)
+    , phase             (0)
+    , frequency         (0)
+{
+    history.calloc (PHASE_PREDICTOR_WINDOW);
+    series.calloc (PHASE_PREDICTOR_WINDOW + PHASE_PREDICTOR_HALF_TAPS);
+    forward.calloc (PHASE_PREDICTOR_WINDOW);
+    backward.calloc (PHASE_PREDICTOR_WINDOW);
+
+    // Hamming windowed ideal Hilbert transformer; the even taps are zero
+    hilbertTaps[0] = 0;
+
+    for (int k = 1; k <= PHASE_PREDICTOR_HALF_TAPS; k++)
+    {
+        const double window = 0.54 + 0.46 * std::cos (double_Pi * k / PHASE_PREDICTOR_HALF_TAPS);
+        hilbertTaps[k] = (k % 2 == 1) ? window * 2.0 / (double_Pi * k) : 0;
+    }
+}
+
+
+void PhasePredictor::prepare (float sampleRate)
+{
+    factor = jmax (1, roundToInt (sampleRate / PHASE_PREDICTOR_RATE));
+
+    numAccumulated = 0;
+    accumulator = 0;
+    historyIndex = 0;
+    numDecimated = 0;
+    samplesSinceFit = 0;
+    modelFitted = false;
+    valid = false;
+}
+
+
+bool PhasePredictor::addSample (float sample)
+{
+    accumulator += sample;
+
+    if (++numAccumulated < factor)
+        return false;
+
+    // the block average is enough to decimate an input that is band-limited already
+    history[historyIndex] = accumulator / factor;
+    historyIndex = (historyIndex + 1) % PHASE_PREDICTOR_WINDOW;
+    numAccumulated = 0;
+    accumulator = 0;
+
+    numDecimated++;
+    samplesSinceFit++;
+
+    estimate();
+    return true;
+}
+
+
+bool PhasePredictor::isValid() const
+{
+    return valid;
+}
+
+
+double PhasePredictor::getPhase() const
+{
+    return phase;
+}
+
+
+double PhasePredictor::getFrequency() const
+{
+    return frequency;
+}
+
+
+int PhasePredictor::getSamplesPerEstimate() const
+{
+    return factor;
+}
+
+
+double PhasePredictor::getSamplesUntilPhase (double targetPhase) const
+{
+    // the newest decimated sample stands for the middle of the input samples it averages
+    return wrapPhase (targetPhase - phase) / (2.0 * double_Pi * frequency) - (factor - 1) / 2.0;
+}
+
+
+void PhasePredictor::fitModel()
+{
+    const int n = PHASE_PREDICTOR_WINDOW;
+    const int order = PHASE_PREDICTOR_ORDER;
+
+    double* a = coefficients;
+
+    for (int k = 0; k <= order; k++)
+        a[k] = 0;
+
+    a[0] = 1.0;
+
+    double denominator = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        forward[i] = backward[i] = series[i];
+        denominator += 2.0 * series[i] * series[i];
+    }
+
+    denominator -= series[0] * series[0] + series[n - 1] * series[n - 1];
+
+    for (int k = 0; k < order && denominator > 0; k++)
+    {
+        double mu = 0;
+
+        for (int i = 0; i < n - k - 1; i++)
+            mu += forward[i + k + 1] * backward[i];
+
+        mu *= -2.0 / denominator;
+
+        for (int i = 0; i <= (k + 1) / 2; i++)
+        {
+            const double lower = a[i] + mu * a[k + 1 - i];
+            const double upper = a[k + 1 - i] + mu * a[i];
+            a[i] = lower;
+            a[k + 1 - i] = upper;
+        }
+
+        for (int i = 0; i < n - k - 1; i++)
+        {
+            const double f = forward[i + k + 1] + mu * backward[i];
+            const double b = backward[i] + mu * forward[i + k + 1];
+            forward[i + k + 1] = f;
+            backward[i] = b;
+        }
+
+        denominator = (1.0 - mu * mu) * denominator
+                      - forward[k + 1] * forward[k + 1]
+                      - backward[n - k - 2] * backward[n - k - 2];
+    }
+
+    modelFitted = true;
+}
+
+
+double PhasePredictor::hilbertAt (int index) const
+{
+    double sum = 0;
+
+    for (int k = 1; k <= PHASE_PREDICTOR_HALF_TAPS; k += 2)
+        sum += hilbertTaps[k] * (series[index - k] - series[index + k]);
+
+    return sum;
+}
+
+
+void PhasePredictor::estimate()
+{
+    valid = false;
+
+    if (numDecimated < PHASE_PREDICTOR_WINDOW)
+        return;
+
+    const int n = PHASE_PREDICTOR_WINDOW;
+
+    // the history from oldest to newest, without its mean
+    double mean = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        series[i] = history[(historyIndex + i) % n];
+        mean += series[i];
+    }
+
+    mean /= n;
+    double power = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        series[i] -= mean;
+        power += series[i] * series[i];
+    }
+
+    if (power <= 0)
+        return;
+
+    if (!modelFitted || samplesSinceFit >= PHASE_PREDICTOR_REFIT)
+    {
+        fitModel();
+        samplesSinceFit = 0;
+    }
+
+    // forecast the samples the centred Hilbert filter needs beyond the newest one
+    for (int i = n; i < n + PHASE_PREDICTOR_HALF_TAPS; i++)
+    {
+        double prediction = 0;
+
+        for (int k = 1; k <= PHASE_PREDICTOR_ORDER; k++)
+            prediction -= coefficients[k] * series[i - k];
+
+        series[i] = prediction;
+    }
+
+    const int newest = n - 1;
+    const double imaginary = hilbertAt (newest);
+
+    // too weak to have a meaningful phase
+    if (series[newest] * series[newest] + imaginary * imaginary < 1.0e-6 * power / n)
+        return;
+
+    phase = wrapPhase (std::atan2 (imaginary, series[newest]));
+
+    // the mean phase step over the last samples
+    double step = 0;
+    double later = phase;
+
+    for (int m = 1; m <= PHASE_PREDICTOR_FREQ_STEPS; m++)
+    {
+        const double earlier = std::atan2 (hilbertAt (newest - m), series[newest - m]);
+        step += wrapPhase (later - earlier + double_Pi) - double_Pi;
+        later = earlier;
+    }
+
+    step /= PHASE_PREDICTOR_FREQ_STEPS;
+
+    if (step <= 0)
+        return;
+
+    frequency = step / (2.0 * double_Pi * factor);
+    valid = true;
+}
@@ -0,0 +1,114 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __PHASEPREDICTOR_H_8D2C4F17__
+#define __PHASEPREDICTOR_H_8D2C4F17__
+
+#include <ProcessorHeaders.h>
+
+#define PHASE_PREDICTOR_RATE        250.0f  // target rate of the decimated signal, in Hz
+#define PHASE_PREDICTOR_WINDOW      500     // decimated samples the model is fitted to
+#define PHASE_PREDICTOR_ORDER       20      // order of the autoregressive model
+#define PHASE_PREDICTOR_HALF_TAPS   48      // the Hilbert filter has 2 * this + 1 taps
+#define PHASE_PREDICTOR_REFIT       25      // decimated samples between fits of the model
+#define PHASE_PREDICTOR_FREQ_STEPS  8       // phase steps averaged into the frequency
+
+
+/**
+
+    Estimates the phase of a band-limited signal in real time, without the delay of a
+    causal filter.
+
+    The input is decimated to about PHASE_PREDICTOR_RATE. An autoregressive model fitted
+    to the recent history (Burg's method) forecasts the next PHASE_PREDICTOR_HALF_TAPS
+    samples, so a centred FIR Hilbert transform can be evaluated at the newest sample.
+    The input should already be band-pass filtered around the rhythm of interest.
+
+    Phases are in radians, as for cos(phase): 0 at peaks, pi/2 at falling zero crossings,
+    pi at troughs and 3pi/2 at rising zero crossings.
+
+    @see PhaseDetector
+
+*/
+class PhasePredictor
+{
+public:
+    PhasePredictor();
+
+    /** Sets the rate of the input and forgets its history */
+    void prepare (float sampleRate);
+
+    /** Adds an input sample. Returns true when it completes a decimated sample and
+        the estimate was updated. */
+    bool addSample (float sample);
+
+    /** True when the last update gave a usable estimate */
+    bool isValid() const;
+
+    /** Phase at the newest decimated sample */
+    double getPhase() const;
+
+    /** Cycles per input sample */
+    double getFrequency() const;
+
+    /** Input samples from the newest input sample until the signal reaches the given phase */
+    double getSamplesUntilPhase (double targetPhase) const;
+
+    /** Input samples between updates of the estimate */
+    int getSamplesPerEstimate() const;
+
+private:
+    /** Fits the autoregressive coefficients to the history with Burg's method */
+    void fitModel();
+
+    /** Forecasts the history and evaluates the analytic signal at its last samples */
+    void estimate();
+
+    /** Imaginary part of the analytic signal at a sample of the forecast series */
+    double hilbertAt (int index) const;
+
+    int factor;
+    int numAccumulated;
+    double accumulator;
+
+    HeapBlock<double> history;  // ring of PHASE_PREDICTOR_WINDOW decimated samples
+    int historyIndex;
+    int numDecimated;
+    int samplesSinceFit;
+
+    HeapBlock<double> series;   // the history in order, then the forecast
+    HeapBlock<double> forward;
+    HeapBlock<double> backward;
+    double coefficients[PHASE_PREDICTOR_ORDER + 1];
+    double hilbertTaps[PHASE_PREDICTOR_HALF_TAPS + 1];
+    bool modelFitted;
+
+    bool valid;
+    double phase;
+    double frequency;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PhasePredictor);
+};
+
+#endif  // __PHASEPREDICTOR_H_8D2C4F17__
@@ -60,3 +60,76 @@ foreach( plugin_src_file IN ITEMS ${PLUGIN_SRC_FILES})
 	endif()
 endforeach()
 endfunction()
+
+
+#This function is to be called at the end of a plugin's CMakeLists.txt, after its sources and libraries
+#are added, to also build the plugin for wider instruction sets, e.g. plugin_add_simd_variants(avx2 avx512).
+#Each variant is installed next to the baseline library as ${PLUGIN_NAME}.<variant>, and the PluginManager
+#loads the best one the CPU supports, or the baseline build on older machines.
+function(plugin_add_simd_variants)
+get_target_property(PLUGIN_SRC_FILES ${PLUGIN_NAME} SOURCES)
+get_target_property(PLUGIN_INCLUDES ${PLUGIN_NAME} INCLUDE_DIRECTORIES)
+get_target_property(PLUGIN_LIBRARIES ${PLUGIN_NAME} LINK_LIBRARIES)
+get_target_property(PLUGIN_OPTIONS ${PLUGIN_NAME} COMPILE_OPTIONS)
+get_target_property(PLUGIN_DEFINITIONS ${PLUGIN_NAME} COMPILE_DEFINITIONS)
+get_target_property(PLUGIN_LINK_FLAGS ${PLUGIN_NAME} LINK_FLAGS)
+
+foreach(variant IN ITEMS ${ARGN})
+	unset(variant_flags)
+	if (CMAKE_SYSTEM_PROCESSOR MATCHES "x86|AMD64|amd64|i.86")
+		if (variant STREQUAL "avx2")
+			if (MSVC)
+				set(variant_flags /arch:AVX2)
+			else()
+				set(variant_flags -mavx2 -mfma)
+			endif()
+		elseif (variant STREQUAL "avx512")
+			if (MSVC)
+				set(variant_flags /arch:AVX512)
+			else()
+				set(variant_flags -mavx512f -mavx512dq -mavx512bw -mavx512vl -mavx2 -mfma)
+			endif()
+		endif()
+	elseif (CMAKE_SYSTEM_PROCESSOR MATCHES "^arm" AND variant STREQUAL "neon")
+		#64-bit ARM always has NEON, so only 32-bit builds need a variant
+		set(variant_flags -mfpu=neon)
+	endif()
+
+	if (NOT variant_flags)
+		message(STATUS "${PLUGIN_NAME}: no ${variant} build for ${CMAKE_SYSTEM_PROCESSOR}")
+		continue()
+	endif()
+
+	set(variant_target ${PLUGIN_NAME}_${variant})
+	if (APPLE)
+		add_library(${variant_target} MODULE ${PLUGIN_SRC_FILES})
+		set_target_properties(${variant_target} PROPERTIES
+			BUNDLE TRUE
+			MACOSX_BUNDLE_GUI_IDENTIFIER "org.open-ephys.plugin.${PLUGIN_NAME}.${variant}"
+		)
+	else()
+		add_library(${variant_target} SHARED ${PLUGIN_SRC_FILES})
+	endif()
+
+	add_dependencies(${variant_target} open-ephys)
+	target_include_directories(${variant_target} PRIVATE ${PLUGIN_INCLUDES})
+	target_compile_features(${variant_target} PUBLIC cxx_auto_type cxx_generalized_initializers)
+	if (PLUGIN_LIBRARIES)
+		target_link_libraries(${variant_target} ${PLUGIN_LIBRARIES})
+	endif()
+	if (PLUGIN_OPTIONS)
+		target_compile_options(${variant_target} PRIVATE ${PLUGIN_OPTIONS})
+	endif()
+	if (PLUGIN_DEFINITIONS)
+		target_compile_definitions(${variant_target} PRIVATE ${PLUGIN_DEFINITIONS})
+	endif()
+	if (PLUGIN_LINK_FLAGS)
+		set_property(TARGET ${variant_target} PROPERTY LINK_FLAGS ${PLUGIN_LINK_FLAGS})
+	endif()
+	target_compile_options(${variant_target} PRIVATE ${variant_flags})
+
+	set_target_properties(${variant_target} PROPERTIES OUTPUT_NAME ${PLUGIN_NAME}.${variant})
+	set_property(TARGET ${variant_target} PROPERTY RUNTIME_OUTPUT_DIRECTORY ${BIN_PLUGIN_DIR})
+	set_property(TARGET ${variant_target} PROPERTY LIBRARY_OUTPUT_DIRECTORY ${BIN_PLUGIN_DIR})
+endforeach()
+endfunction()
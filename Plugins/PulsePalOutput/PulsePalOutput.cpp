@@ -40,6 +40,8 @@
 PulsePalOutput::PulsePalOutput()
     : GenericProcessor ("Pulse Pal")
     , channelToChange (0)
+    , activeRoutes (0)
+    , dispatcher ("Pulse Pal output", *this)
 {
     setProcessorType (PROCESSOR_TYPE_SINK);
 
@@ -90,45 +92,111 @@ void PulsePalOutput::handleEvent (const EventChannel* eventInfo, const MidiMessa
 {
     if (Event::getEventType(event) == EventChannel::TTL)
     {
-        TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
-        const int state         = ttl->getState() ? 1 : 0;
-        const int eventId       = ttl->getSourceIndex();
-        const int sourceId      = ttl->getSourceID();
-        const int eventChannel  = ttl->getChannel();
+        EventView ttl(event, eventInfo);
+        const uint64 key = getRouteKey (ttl.getSourceID(), ttl.getSourceIndex(), ttl.getChannel());
 
-        for (int i = 0; i < PULSEPALCHANNELS; ++i)
+        for (const EventRoute& route : routes[activeRoutes.load (std::memory_order_acquire)])
         {
-            if (channelTtlTrigger[i] != -1)
+            if (route.key != key)
+                continue;
+
+            const bool state = ttl.getState();
+
+            if (state && route.triggerMask != 0)
             {
-                EventSources s = sources.getReference (channelTtlTrigger[i]);
-                if (eventId == s.eventIndex && sourceId == s.sourceId
-                        && eventChannel == s.channel && state)
-                {
-                    std::cout << "Trigger " << i + 1 << std::endl;
-                    pulsePal.triggerChannel (i + 1);
-                }
+                dispatcher.push (route.triggerMask, 1,
+                                 eventInfo->getTimestampOriginProcessor(),
+                                 eventInfo->getTimestampOriginSubProcessor(),
+                                 ttl.getTimestamp());
             }
-            if (channelTtlGate[i] != -1)
+
+            for (int i = 0; i < PULSEPALCHANNELS; ++i)
             {
-                EventSources s = sources.getReference (channelTtlGate[i]);
-                if (eventId == s.eventIndex && sourceId == s.sourceId
-                        && eventChannel == s.channel)
-                {
-                    std::cout << "Gate " << i + 1 << std::endl;
-                    if (state == 1)
-                        channelState.set (i, true);
-                    else
-                        channelState.set (i, false);
-                }
+                if (route.gateMask & (1 << i))
+                    channelState.set (i, state);
             }
+
+            break;
+        }
+    }
+}
+
+
+void PulsePalOutput::writeOutput (const OutputDispatcher::Command& command)
+{
+    pulsePal.triggerChannels (command.channel & 1, (command.channel >> 1) & 1,
+                              (command.channel >> 2) & 1, (command.channel >> 3) & 1);
+}
+
+
+uint64 PulsePalOutput::getRouteKey (int sourceId, int eventIndex, int channel)
+{
+    return (uint64 (uint32 (sourceId)) << 32) | (uint64 (uint16 (eventIndex)) << 16) | uint16 (channel);
+}
+
+
+void PulsePalOutput::addRoute (Array<EventRoute>& table, int sourceIndex, uint8 triggerMask, uint8 gateMask)
+{
+    if (! isPositiveAndBelow (sourceIndex, sources.size()))
+        return;
+
+    const EventSources& s = sources.getReference (sourceIndex);
+    const uint64 key = getRouteKey (s.sourceId, s.eventIndex, s.channel);
+
+    for (EventRoute& route : table)
+    {
+        if (route.key == key)
+        {
+            route.triggerMask |= triggerMask;
+            route.gateMask |= gateMask;
+            return;
         }
     }
+
+    EventRoute route;
+    route.key = key;
+    route.triggerMask = triggerMask;
+    route.gateMask = gateMask;
+    table.add (route);
+}
+
+
+void PulsePalOutput::updateRouting()
+{
+    const int next = 1 - activeRoutes.load();
+    Array<EventRoute>& table = routes[next];
+    table.clearQuick();
+
+    for (int i = 0; i < PULSEPALCHANNELS; ++i)
+    {
+        addRoute (table, channelTtlTrigger[i], uint8 (1 << i), 0);
+        addRoute (table, channelTtlGate[i], 0, uint8 (1 << i));
+    }
+
+    activeRoutes.store (next, std::memory_order_release);
+}
+
+
+bool PulsePalOutput::enable()
+{
+    dispatcher.start();
+    return isEnabled;
+}
+
+
+bool PulsePalOutput::disable()
+{
+    dispatcher.stop();
+    std::cout << "Pulse Pal output: "
+              << (CoreServices::getLatencyBenchmark() ? dispatcher.getReport() : dispatcher.getSummary()) << std::endl;
+    return true;
 }
 
 
 void PulsePalOutput::setParameter (int parameterIndex, float newValue)
 {
-    editor->updateParameterButtons (parameterIndex);
+    if (! isApplyingParameterChanges())
+        editor->updateParameterButtons (parameterIndex);
 
     switch (parameterIndex)
     {
@@ -138,6 +206,7 @@ void PulsePalOutput::setParameter (int parameterIndex, float newValue)
 
     case 1:
         channelTtlTrigger.set (channelToChange, (int) newValue);
+        updateRouting();
         break;
 
     case 2:
@@ -151,6 +220,7 @@ void PulsePalOutput::setParameter (int parameterIndex, float newValue)
         {
             channelState.set (channelToChange, false);
         }
+        updateRouting();
         break;
 
     default:
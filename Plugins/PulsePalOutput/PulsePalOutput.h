@@ -38,6 +38,7 @@
 #include <ProcessorHeaders.h>
 #include "PulsePalOutputEditor.h"
 #include "serial/PulsePal.h"
+#include <atomic>
 
 #define DEF_PHASE_DURATION 1
 #define DEF_INTER_PHASE 1
@@ -63,6 +64,17 @@ struct EventSources
     unsigned int channel;
 };
 
+/**
+ * @brief The EventRoute struct holds the Pulse Pal channels a TTL line
+ * triggers and gates, as bitmasks (bit 0 for channel 1)
+ */
+struct EventRoute
+{
+    uint64 key;     // see PulsePalOutput::getRouteKey()
+    uint8 triggerMask;
+    uint8 gateMask;
+};
+
 /**
     Allows the user to set all Pulse Pal (Sanworks - www.sanworks.io) parameters and to trigger
     and gate Pulse Pal stimulation in response to TTL events.
@@ -70,6 +82,7 @@ struct EventSources
     @see GenericProcessor, PulsePalOutputEditor, PulsePalOutputCanvas, PulsePal
 */
 class PulsePalOutput : public GenericProcessor
+                     , private OutputDispatcher::Device
 {
 public:
     /** The class constructor, used to connect to PulsePal initialize any members. */
@@ -89,6 +102,8 @@ public:
     void process (AudioSampleBuffer& buffer) override;
     void setParameter (int parameterIndex, float newValue) override;
     void handleEvent (const EventChannel* eventInfo, const MidiMessage& event, int sampleNum) override;
+    bool enable() override;
+    bool disable() override;
     void saveCustomParametersToXml(XmlElement *parentElement);
     void loadCustomParametersFromXml();
     /**
@@ -169,6 +184,12 @@ public:
      * @brief clearEventSources clears sources array
      */
     void clearEventSources();
+    /**
+     * @brief updateRouting compiles the trigger and gate selections into the
+     *        routing table looked up by handleEvent(). Called whenever the
+     *        selections or the sources change
+     */
+    void updateRouting();
 
 private:
     Array<int> channelTtlTrigger;
@@ -176,6 +197,12 @@ private:
     Array<bool> channelState;
     Array<EventSources> sources;
     int channelToChange;
+    // routes of the TTL lines with a trigger or gate; handleEvent() reads one
+    // table while updateRouting() fills the other
+    Array<EventRoute> routes[2];
+    std::atomic<int> activeRoutes;
+    static uint64 getRouteKey (int sourceId, int eventIndex, int channel);
+    void addRoute (Array<EventRoute>& table, int sourceIndex, uint8 triggerMask, uint8 gateMask);
     // Pulse Pal parameter arrays
     vector<int> m_isBiphasic;
     vector<float> m_phase1Duration; // ms
@@ -196,6 +223,10 @@ private:
     // Pulse Pal instance and version
     PulsePal pulsePal;
     uint32_t pulsePalVersion;
+    // sends the triggers of handleEvent() on the dispatcher thread, all the
+    // channels of an event in one command (its channel is their bitmask)
+    void writeOutput (const OutputDispatcher::Command& command) override;
+    OutputDispatcher dispatcher;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PulsePalOutput);
 };
@@ -60,6 +60,8 @@ void PulsePalOutputEditor::updateSettings()
     {
         channelTriggerInterfaces[i]->updateSources();
     }
+
+    ((PulsePalOutput*) getProcessor())->updateRouting();
 }
 
 void PulsePalOutputEditor::saveCustomParameters(XmlElement* xml)
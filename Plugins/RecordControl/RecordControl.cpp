@@ -28,6 +28,8 @@
 RecordControl::RecordControl()
     : GenericProcessor  ("Record Control")
     , triggerChannel    (0)
+    , preTriggerMs      (500.0f)
+    , postTriggerMs     (1000.0f)
 {
     setProcessorType (PROCESSOR_TYPE_UTILITY);
 }
@@ -63,11 +65,30 @@ void RecordControl::setParameter (int parameterIndex, float newValue)
     {
         triggerEdge = (Edges)((int)newValue - 1);
     }
+    else if (parameterIndex == 4)
+    {
+        preTriggerMs = newValue;
+    }
+    else if (parameterIndex == 5)
+    {
+        postTriggerMs = newValue;
+    }
 }
 
 
 bool RecordControl::enable()
 {
+    // the record nodes only size their pre-trigger ring when recording starts
+    CoreServices::RecordNode::setTriggeredRecording (triggerType == SNIPPET, preTriggerMs / 1000.0f, postTriggerMs / 1000.0f);
+    return true;
+}
+
+
+bool RecordControl::disable()
+{
+    if (triggerType == SNIPPET)
+        CoreServices::RecordNode::setTriggeredRecording (false, 0.0f, 0.0f);
+
     return true;
 }
 
@@ -83,12 +104,21 @@ void RecordControl::handleEvent (const EventChannel* eventInfo, const MidiMessag
 	if (triggerEvent < 0) return;
     if (eventInfo->getChannelType() == EventChannel::TTL && eventInfo == eventChannelArray[triggerEvent])
     {
-		TTLEventPtr ttl = TTLEvent::deserializeFromMessage(event, eventInfo);
-		if (ttl->getChannel() == triggerChannel)
+		EventView ttl(event, eventInfo);
+		if (ttl.getChannel() == triggerChannel)
 		{
-			int eventId = ttl->getState() ? 1 : 0;
+			int eventId = ttl.getState() ? 1 : 0;
 			int edge = triggerEdge == RISING ? 1 : 0;
 
+			// snippets are opened from this thread, without waiting for the message thread
+			if (triggerType == SNIPPET)
+			{
+				if (eventId == edge)
+					CoreServices::RecordNode::triggerRecording(eventInfo->getSourceNodeID(), eventInfo->getSubProcessorIdx(),
+						ttl.getTimestamp(), eventInfo->getSampleRate());
+				return;
+			}
+
 			const MessageManagerLock mmLock;
 
 			if (triggerType == SET)
@@ -46,17 +46,22 @@ public:
     void handleEvent (const EventChannel* eventInfo, const MidiMessage& event, int) override;
 
     bool enable() override;
+    bool disable() override;
 
 private:
     std::atomic<int> triggerEvent;
 	std::atomic<int> triggerChannel;
 
     enum Edges { RISING = 0, FALLING = 1 };
-    enum Types { SET = 0, TOGGLE = 1};
+    /** SNIPPET records the windows around each trigger edge in the open files, with RecordNode's triggered recording */
+    enum Types { SET = 0, TOGGLE = 1, SNIPPET = 2 };
 
     Edges triggerEdge;
     Types triggerType;
 
+    float preTriggerMs;
+    float postTriggerMs;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RecordControl);
 };
 
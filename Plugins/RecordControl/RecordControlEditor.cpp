@@ -28,7 +28,7 @@
 RecordControlEditor::RecordControlEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
     : GenericEditor(parentNode, useDefaultParameterEditors)
 {
-    desiredWidth = 170;
+    desiredWidth = 250;
 
     //channelSelector->eventsOnly = true;
 
@@ -85,6 +85,23 @@ RecordControlEditor::RecordControlEditor(GenericProcessor* parentNode, bool useD
 
     addAndMakeVisible(triggerPol);
 
+    preLabel = new Label("Pre Text", "Pre (ms):");
+    preLabel->setEditable(false);
+    preLabel->setJustificationType(Justification::centredLeft);
+    preLabel->setBounds(155, 20, 80, 20);
+
+    addAndMakeVisible(preLabel);
+
+    postLabel = new Label("Post Text", "Post (ms):");
+    postLabel->setEditable(false);
+    postLabel->setJustificationType(Justification::centredLeft);
+    postLabel->setBounds(155, 60, 80, 20);
+
+    addAndMakeVisible(postLabel);
+
+    preValue = createValueLabel("Pre", 500.0f, 40);
+    postValue = createValueLabel("Post", 1000.0f, 80);
+
     availableChans->addItem("None",1);
   /*  for (int i = 0; i < 10 ; i++)
     {
@@ -96,6 +113,7 @@ RecordControlEditor::RecordControlEditor(GenericProcessor* parentNode, bool useD
 
     triggerMode->addItem("Edge set", 1);
     triggerMode->addItem("Edge toggle", 2);
+    triggerMode->addItem("Snippet", 3);
     triggerMode->setSelectedId(1, sendNotification);
 
     triggerPol->addItem("Rising", 1);
@@ -108,6 +126,28 @@ RecordControlEditor::~RecordControlEditor()
 
 }
 
+Label* RecordControlEditor::createValueLabel(const String& name, float value, int y)
+{
+    Label* label = new Label(name + " Value", String(value));
+    label->setEditable(true);
+    label->setJustificationType(Justification::centredLeft);
+    label->setColour(Label::textColourId, Colours::white);
+    label->setColour(Label::backgroundColourId, Colours::grey);
+    label->addListener(this);
+    label->setBounds(160, y, 70, 20);
+
+    addAndMakeVisible(label);
+    return label;
+}
+
+void RecordControlEditor::labelTextChanged(Label* label)
+{
+    float value = jmax(label->getText().getFloatValue(), 0.0f);
+    label->setText(String(value), dontSendNotification);
+
+    getProcessor()->setParameter(label == preValue ? 4 : 5, value);
+}
+
 void RecordControlEditor::comboBoxChanged(ComboBox* comboBox)
 {
 
@@ -178,6 +218,8 @@ void RecordControlEditor::saveCustomParameters(XmlElement* xml)
     info->setAttribute("Channel",availableChans->getSelectedId());
     info->setAttribute("Mode", triggerMode->getSelectedId());
     info->setAttribute("Edge", triggerPol->getSelectedId());
+    info->setAttribute("PreMs", preValue->getText().getFloatValue());
+    info->setAttribute("PostMs", postValue->getText().getFloatValue());
 
 }
 
@@ -192,6 +234,8 @@ void RecordControlEditor::loadCustomParameters(XmlElement* xml)
             availableChans->setSelectedId(xmlNode->getIntAttribute("Channel"), sendNotification);
             triggerMode->setSelectedId(xmlNode->getIntAttribute("Mode", 1), sendNotification);
             triggerPol->setSelectedId(xmlNode->getIntAttribute("Edge", 1), sendNotification);
+            preValue->setText(String(xmlNode->getDoubleAttribute("PreMs", 500.0)), sendNotificationSync);
+            postValue->setText(String(xmlNode->getDoubleAttribute("PostMs", 1000.0)), sendNotificationSync);
         }
 
     }
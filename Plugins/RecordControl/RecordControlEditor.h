@@ -35,12 +35,14 @@
 */
 
 class RecordControlEditor : public GenericEditor,
-    public ComboBox::Listener
+    public ComboBox::Listener,
+    public Label::Listener
 {
 public:
     RecordControlEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
     ~RecordControlEditor();
     void comboBoxChanged(ComboBox* comboBox);
+    void labelTextChanged(Label* label);
     void updateSettings();
     void loadCustomParameters(XmlElement*);
     void saveCustomParameters(XmlElement*);
@@ -56,6 +58,12 @@ private:
     ScopedPointer<ComboBox> availableChans, triggerMode, triggerPol;
     ScopedPointer<Label> chanSel, triggerLabel, polLabel;
 
+    /** Milliseconds recorded before and after each trigger in snippet mode */
+    ScopedPointer<Label> preLabel, postLabel, preValue, postValue;
+
+    /** Creates an editable millisecond value */
+    Label* createValueLabel(const String& name, float value, int y);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordControlEditor);
 
 };
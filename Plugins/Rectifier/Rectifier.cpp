@@ -23,6 +23,7 @@
 
 
 #include <stdio.h>
+#include <DspLib.h>
 #include "Rectifier.h"
 
 
@@ -43,7 +44,8 @@ Rectifier::~Rectifier()
 
 void Rectifier::setParameter (int parameterIndex, float newValue)
 {
-    editor->updateParameterButtons (parameterIndex);
+    if (! isApplyingParameterChanges())
+        editor->updateParameterButtons (parameterIndex);
 
     if (currentChannel >= 0)
     {
@@ -57,13 +59,12 @@ void Rectifier::process (AudioSampleBuffer& buffer)
 {
     const int nChannels = buffer.getNumChannels();
 
-    for (int ch = 0; ch < nChannels ; ++ch)
+    forEachChannelRange (nChannels, [&buffer] (int startChannel, int endChannel)
     {
-        const int nSamples = buffer.getNumSamples();
-        float* bufPtr = buffer.getWritePointer (ch);
-        for (int n = 0; n < nSamples; ++n)
+        for (int ch = startChannel; ch < endChannel; ++ch)
         {
-            *(bufPtr + n) = fabsf (*(bufPtr + n));
+            float* bufPtr = buffer.getWritePointer (ch);
+            Dsp::VectorOps::abs (bufPtr, bufPtr, buffer.getNumSamples());
         }
-    }
+    }, 128);
 }
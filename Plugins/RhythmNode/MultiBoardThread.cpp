@@ -0,0 +1,198 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MultiBoardThread.h"
+#include "RHD2000Thread.h"
+
+using namespace RhythmNode;
+
+DataThread* MultiBoardThread::createDataThread(SourceNode* sn)
+{
+    return new MultiBoardThread(sn);
+}
+
+MultiBoardThread::MultiBoardThread(SourceNode* sn) : DataThread(sn)
+{
+    // each board opens the first device that is not open yet
+    while (boards.size() < MAX_NUM_BOARDS)
+    {
+        ScopedPointer<RHD2000Thread> board = new RHD2000Thread(sn);
+
+        if (!board->foundInputSource())
+            break;
+
+        board->setSyncAligner(&aligner, boards.size());
+        board->readByOwner = true;
+        boards.add(board.release());
+    }
+
+    std::cout << "Multi-board Rhythm source found " << boards.size() << " board(s)." << std::endl;
+}
+
+MultiBoardThread::~MultiBoardThread()
+{
+}
+
+bool MultiBoardThread::foundInputSource()
+{
+    return boards.size() > 0;
+}
+
+bool MultiBoardThread::isReady()
+{
+    if (boards.size() == 0)
+        return false;
+
+    for (auto board : boards)
+    {
+        if (!board->isReady())
+            return false;
+    }
+    return true;
+}
+
+unsigned int MultiBoardThread::getNumSubProcessors() const
+{
+    return boards.size();
+}
+
+int MultiBoardThread::getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessorIdx) const
+{
+    if (subProcessorIdx >= boards.size())
+        return 0;
+
+    return boards[subProcessorIdx]->getNumDataOutputs(type, 0);
+}
+
+int MultiBoardThread::getNumTTLOutputs(int subProcessorIdx) const
+{
+    if (subProcessorIdx >= boards.size())
+        return 0;
+
+    return boards[subProcessorIdx]->getNumTTLOutputs(0);
+}
+
+float MultiBoardThread::getSampleRate(int subProcessorIdx) const
+{
+    if (subProcessorIdx >= boards.size())
+        return boards.size() > 0 ? boards[0]->getSampleRate(0) : 30000.0f;
+
+    return boards[subProcessorIdx]->getSampleRate(0);
+}
+
+float MultiBoardThread::getBitVolts(const DataChannel* chan) const
+{
+    return boards[chan->getSubProcessorIdx()]->getBitVolts(chan);
+}
+
+DataBuffer* MultiBoardThread::getBufferAddress(int subProcessor) const
+{
+    return boards[subProcessor]->getBufferAddress(0);
+}
+
+void MultiBoardThread::resizeBuffers()
+{
+    copyMasterSettings();
+
+    for (auto board : boards)
+        board->resizeBuffers();
+}
+
+void MultiBoardThread::getEventChannelNames(StringArray& names) const
+{
+    if (boards.size() > 0)
+        boards[0]->getEventChannelNames(names);
+}
+
+GenericEditor* MultiBoardThread::createEditor(SourceNode* sn)
+{
+    if (boards.size() == 0)
+        return nullptr;
+
+    return boards[0]->createEditor(sn);
+}
+
+void MultiBoardThread::copyMasterSettings()
+{
+    for (int i = 1; i < boards.size(); i++)
+        boards[i]->copySettingsFrom(*boards[0]);
+}
+
+bool MultiBoardThread::updateBuffer()
+{
+    return true;
+}
+
+bool MultiBoardThread::usesSubProcessorThreads() const
+{
+    return true;
+}
+
+bool MultiBoardThread::updateSubProcessorBuffer(int subProcessor)
+{
+    return boards[subProcessor]->updateBuffer();
+}
+
+bool MultiBoardThread::startAcquisition()
+{
+    copyMasterSettings();
+
+    aligner.reset(boards.size(), SYNC_TTL_LINE, getSampleRate(0));
+
+    for (int i = 0; i < boards.size(); i++)
+    {
+        boards[i]->prepareWaitStates();
+
+        if (!boards[i]->startAcquisition())
+        {
+            for (int j = 0; j < i; j++)
+                boards[j]->stopAcquisition();
+            return false;
+        }
+    }
+
+    // one reader per board, pinned to consecutive cores when a first core is set
+    startThread();
+
+    return true;
+}
+
+bool MultiBoardThread::stopAcquisition()
+{
+    // the readers are stopped before the boards they read
+    signalThreadShouldExit();
+    waitForThreadToExit(1000);
+
+    for (auto board : boards)
+        board->stopAcquisition();
+
+    for (int i = 1; i < boards.size(); i++)
+    {
+        if (aligner.isAligned(i))
+            std::cout << "Board " << i << " aligned with offset " << aligner.getOffset(i)
+                      << " samples, rate " << aligner.getRate(i) << std::endl;
+        else
+            std::cout << "Board " << i << " did not see a sync edge on TTL input "
+                      << SYNC_TTL_LINE + 1 << "; its timestamps were not aligned." << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MULTIBOARDTHREAD_H__
+#define __MULTIBOARDTHREAD_H__
+
+#include <DataThreadHeaders.h>
+
+#include "SyncAligner.h"
+
+#define MAX_NUM_BOARDS 4
+/** TTL input that carries the shared sync pulse on every board */
+#define SYNC_TTL_LINE 0
+
+namespace RhythmNode
+{
+	class RHD2000Thread;
+
+	/**
+		Acquires from several Rhythm boards as one source, with one subprocessor per board.
+
+		Each board is an RHD2000Thread that fills its own buffer, read by its own subprocessor
+		reader thread, so a slow USB transfer on one board doesn't hold up the others. The boards must share a
+		sync pulse on TTL input SYNC_TTL_LINE, e.g. the clock divider output of the first board
+		wired to that input of every board; a SyncAligner then maps the sample numbers of all
+		boards onto those of the first.
+
+		The editor of the first board configures all of them: its sample rate, filter and
+		channel settings are applied to the other boards before acquisition starts.
+
+		@see RHD2000Thread, SyncAligner
+	*/
+	class MultiBoardThread : public DataThread
+	{
+	public:
+		MultiBoardThread(SourceNode* sn);
+		~MultiBoardThread();
+
+		bool foundInputSource() override;
+		bool isReady() override;
+
+		unsigned int getNumSubProcessors() const override;
+		int getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessorIdx) const override;
+		int getNumTTLOutputs(int subProcessorIdx) const override;
+		float getSampleRate(int subProcessorIdx) const override;
+		float getBitVolts(const DataChannel* chan) const override;
+
+		DataBuffer* getBufferAddress(int subProcessor) const override;
+		void resizeBuffers() override;
+
+		void getEventChannelNames(StringArray& names) const override;
+
+		GenericEditor* createEditor(SourceNode* sn) override;
+
+		static DataThread* createDataThread(SourceNode* sn);
+
+	private:
+		/** The boards are read by the subprocessor readers */
+		bool updateBuffer() override;
+
+		bool usesSubProcessorThreads() const override;
+		bool updateSubProcessorBuffer(int subProcessor) override;
+
+		bool startAcquisition() override;
+		bool stopAcquisition() override;
+
+		void copyMasterSettings();
+
+		OwnedArray<RHD2000Thread> boards;
+		SyncAligner aligner;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MultiBoardThread);
+	};
+}
+
+#endif
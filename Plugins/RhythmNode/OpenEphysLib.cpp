@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <PluginInfo.h>
 #include "RHD2000Thread.h"
+#include "MultiBoardThread.h"
 #include <string>
 #ifdef WIN32
 #include <Windows.h>
@@ -32,7 +33,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 using namespace Plugin;
-#define NUM_PLUGINS 1
+#define NUM_PLUGINS 2
 
 extern "C" EXPORT void getLibInfo(Plugin::LibraryInfo* info)
 {
@@ -51,6 +52,11 @@ extern "C" EXPORT int getPluginInfo(int index, Plugin::PluginInfo* info)
 		info->dataThread.name = "Rhythm FPGA";
 		info->dataThread.creator = &createDataThread<RhythmNode::RHD2000Thread>;
 		break;
+	case 1:
+		info->type = Plugin::PLUGIN_TYPE_DATA_THREAD;
+		info->dataThread.name = "Rhythm FPGA (multi-board)";
+		info->dataThread.creator = &createDataThread<RhythmNode::MultiBoardThread>;
+		break;
 	default:
 		return -1;
 		break;
@@ -733,6 +733,16 @@ RHD2000Editor::RHD2000Editor(GenericProcessor* parentNode,
     ledButton->setTooltip("Toggle board LEDs");
     addAndMakeVisible(ledButton);
     ledButton->setToggleState(true, dontSendNotification);
+
+    latencyButton = new UtilityButton("LAT", Font("Small Text", 13, Font::plain));
+    latencyButton->setRadius(3.0f);
+    latencyButton->setBounds(252, 108, 32, 18);
+    latencyButton->addListener(this);
+    latencyButton->setClickingTogglesState(true);
+    latencyButton->setTooltip("Read each USB block as soon as it is complete, for closed-loop experiments. "
+                              "When off, reads are batched for throughput");
+    addAndMakeVisible(latencyButton);
+    latencyButton->setToggleState(true, dontSendNotification);
 }
 
 RHD2000Editor::~RHD2000Editor()
@@ -897,6 +907,10 @@ void RHD2000Editor::buttonEvent(Button* button)
     {
         board->enableBoardLeds(button->getToggleState());
     }
+    else if (button == latencyButton && !acquisitionIsActive)
+    {
+        board->setLowLatencyReads(button->getToggleState());
+    }
     /*
     else
     {
@@ -931,6 +945,7 @@ void RHD2000Editor::startAcquisition()
     auxButton->setEnabledState(false);
     adcButton->setEnabledState(false);
     dspoffsetButton-> setEnabledState(false);
+    latencyButton->setEnabledState(false);
     acquisitionIsActive = true;
     if (canvas != nullptr)
         canvas->channelList->disableAll();
@@ -945,6 +960,7 @@ void RHD2000Editor::stopAcquisition()
     auxButton->setEnabledState(true);
     adcButton->setEnabledState(true);
     dspoffsetButton-> setEnabledState(true);
+    latencyButton->setEnabledState(true);
 
     acquisitionIsActive = false;
     if (canvas != nullptr)
@@ -970,6 +986,7 @@ void RHD2000Editor::saveCustomParameters(XmlElement* xml)
     xml->setAttribute("save_impedance_measurements",saveImpedances);
     xml->setAttribute("auto_measure_impedances",measureWhenRecording);
     xml->setAttribute("LEDs", ledButton->getToggleState());
+    xml->setAttribute("LowLatencyReads", latencyButton->getToggleState());
     xml->setAttribute("ClockDivideRatio", clockInterface->getClockDivideRatio());
     for (int i = 0; i < 8; i++)
     {
@@ -1010,6 +1027,7 @@ void RHD2000Editor::loadCustomParameters(XmlElement* xml)
     saveImpedances = xml->getBoolAttribute("save_impedance_measurements");
     measureWhenRecording = xml->getBoolAttribute("auto_measure_impedances");
     ledButton->setToggleState(xml->getBoolAttribute("LEDs", true),sendNotification);
+    latencyButton->setToggleState(xml->getBoolAttribute("LowLatencyReads", true), sendNotification);
     clockInterface->setClockDivideRatio(xml->getIntAttribute("ClockDivideRatio"));
     
     forEachXmlChildElementWithTagName(*xml, adc, "ADCRANGE")
@@ -204,6 +204,7 @@ namespace RhythmNode
 		ScopedPointer<UtilityButton> auxButton;
 		ScopedPointer<UtilityButton> adcButton;
 		ScopedPointer<UtilityButton> ledButton;
+		ScopedPointer<UtilityButton> latencyButton;
 
 		ScopedPointer<UtilityButton> dspoffsetButton;
 		ScopedPointer<ComboBox> ttlSettleCombo, dacHPFcombo;
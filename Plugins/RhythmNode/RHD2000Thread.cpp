@@ -23,6 +23,7 @@
 
 #include "RHD2000Thread.h"
 #include "RHD2000Editor.h"
+#include "SyncAligner.h"
 using namespace RhythmNode;
 
 #if defined(_WIN32)
@@ -47,8 +48,98 @@ using namespace RhythmNode;
 //#define DEBUG_EMULATE_HEADSTAGES 8
 //#define DEBUG_EMULATE_64CH
 
+// Writes the raw USB data of every acquisition to this file, see UsbCaptureWriter
+//#define DEBUG_CAPTURE_USB_FILE "rhythm-usb.capture"
+// Emulates the board from a capture instead of opening one, see UsbCaptureReplay...
+//#define DEBUG_REPLAY_USB_FILE "rhythm-usb.capture"
+// ...at its sample rate, or as fast as it is decoded when this is 0
+#define DEBUG_REPLAY_REAL_TIME 1
+
 #define INIT_STEP ( evalBoard->isUSB3() ? 256 : 60)
 
+// Samples covered by a single USB read when low latency reads are off
+#define USB_THROUGHPUT_READ_MS 20
+
+// Layout of a single sample frame in the USB data block, see Rhd2000DataBlock::fillFromUsbBuffer()
+#define USB_FRAME_BYTES(numStreams) (32 + 72 * (numStreams))
+#define USB_FRAME_AUX_OFFSET(numStreams) (12 + 2 * (numStreams)) // past the AuxCmd1 slots
+#define USB_FRAME_NEURAL_OFFSET(numStreams) (12 + 6 * (numStreams))
+#define USB_FRAME_ADC_OFFSET(numStreams) (12 + 72 * (numStreams))
+#define USB_FRAME_TTL_OFFSET(numStreams) (28 + 72 * (numStreams))
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RHD_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RHD_USE_NEON 1
+#endif
+
+namespace
+{
+    /* Converts the neural words of numFrames USB frames to microvolts, writing word w of frame i
+       to rows[w][i]. Only the groups of 4 words starting at groups[0 .. numGroups) are converted */
+    void convertNeuralWords(const unsigned char* src, int frameBytes, const int* groups, int numGroups, float* const* rows, int numFrames)
+    {
+        int frame = 0;
+#if RHD_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i offset = _mm_set1_epi32(32768);
+        const __m128 scale = _mm_set1_ps(0.195f);
+
+        for (; frame + 4 <= numFrames; frame += 4)
+        {
+            const unsigned char* frames = src + frame * frameBytes;
+            for (int group = 0; group < numGroups; ++group)
+            {
+                const int word = groups[group];
+                __m128 r[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    __m128i raw = _mm_loadl_epi64((const __m128i*)(frames + k * frameBytes + 2 * word));
+                    r[k] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpacklo_epi16(raw, zero), offset)), scale);
+                }
+                _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+                _mm_storeu_ps(rows[word] + frame, r[0]);
+                _mm_storeu_ps(rows[word + 1] + frame, r[1]);
+                _mm_storeu_ps(rows[word + 2] + frame, r[2]);
+                _mm_storeu_ps(rows[word + 3] + frame, r[3]);
+            }
+        }
+#elif RHD_USE_NEON
+        const int32x4_t offset = vdupq_n_s32(32768);
+
+        for (; frame + 4 <= numFrames; frame += 4)
+        {
+            const unsigned char* frames = src + frame * frameBytes;
+            for (int group = 0; group < numGroups; ++group)
+            {
+                const int word = groups[group];
+                float32x4_t r[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    uint16x4_t raw = vld1_u16((const uint16_t*)(frames + k * frameBytes + 2 * word));
+                    r[k] = vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(raw)), offset)), 0.195f);
+                }
+                float32x4x2_t t01 = vtrnq_f32(r[0], r[1]);
+                float32x4x2_t t23 = vtrnq_f32(r[2], r[3]);
+                vst1q_f32(rows[word] + frame, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+                vst1q_f32(rows[word + 1] + frame, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+                vst1q_f32(rows[word + 2] + frame, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+                vst1q_f32(rows[word + 3] + frame, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+            }
+        }
+#endif
+        for (; frame < numFrames; ++frame)
+        {
+            const unsigned char* words = src + frame * frameBytes;
+            for (int group = 0; group < numGroups; ++group)
+                for (int word = groups[group]; word < groups[group] + 4; ++word)
+                    rows[word][frame] = float(*(uint16*)(words + 2 * word) - 32768)*0.195f;
+        }
+    }
+}
+
 // Allocates memory for a 3-D array of doubles.
 void allocateDoubleArray3D(std::vector<std::vector<std::vector<double> > >& array3D,
                            int xSize, int ySize, int zSize)
@@ -76,8 +167,9 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     chipRegisters(30000.0f),
     numChannels(0),
     deviceFound(false),
+    lowLatencyReads(true),
+    syncAligner(nullptr), syncBoardIndex(0), readByOwner(false),
     isTransmitting(false),
-    dacOutputShouldChange(false),
     acquireAuxChannels(false),
     acquireAdcChannels(false),
     fastSettleEnabled(false),
@@ -90,6 +182,7 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     desiredLowerBandwidth(1.0f),
     boardSampleRate(30000.0f),
     savedSampleRateIndex(16),
+    pendingBoardCommands(0),
     cableLengthPortA(0.914f), cableLengthPortB(0.914f), cableLengthPortC(0.914f), cableLengthPortD(0.914f), // default is 3 feet (0.914 m),
     audioOutputL(-1), audioOutputR(-1) ,numberingScheme(1),
     newScan(true), ledsEnabled(true)
@@ -129,9 +222,13 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     dacStream = nullptr;
     dacChannels = nullptr;
     dacThresholds = nullptr;
-    dacChannelsToUpdate = nullptr;
 
-    if (openBoard(libraryFilePath))
+    bool boardOpened = false;
+#ifdef DEBUG_REPLAY_USB_FILE
+    boardOpened = openReplay(File::getCurrentWorkingDirectory().getChildFile(DEBUG_REPLAY_USB_FILE));
+#endif
+
+    if (!boardOpened && openBoard(libraryFilePath))
     {
         dataBlock = new Rhd2000DataBlock(1,evalBoard->isUSB3());
         // upload bitfile and restore default settings
@@ -141,16 +238,19 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
 
         // automatically find connected headstages
         scanPorts(); // things would appear to run more smoothly if this were done after the editor has been created
+        boardOpened = true;
+    }
+
+    if (boardOpened)
+    {
 
         // probably better to do this with a thread, but a timer works for now:
         // startTimer(10); // initialize the board in the background
         dacStream = new int[8];
         dacChannels = new int[8];
         dacThresholds = new float[8];
-        dacChannelsToUpdate = new bool[8];
         for (int k = 0; k < 8; k++)
         {
-            dacChannelsToUpdate[k] = true;
             dacStream[k] = 0;
             setDACthreshold(k, 65534);
             dacChannels[k] = 0;
@@ -197,7 +297,6 @@ RHD2000Thread::~RHD2000Thread()
     delete[] dacStream;
     delete[] dacChannels;
     delete[] dacThresholds;
-    delete[] dacChannelsToUpdate;
 }
 
 bool RHD2000Thread::usesCustomNames() const
@@ -215,9 +314,11 @@ unsigned int RHD2000Thread::getNumSubProcessors() const
 
 void RHD2000Thread::setDACthreshold(int dacOutput, float threshold)
 {
-    dacThresholds[dacOutput]= threshold;
-    dacChannelsToUpdate[dacOutput] = true;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        dacThresholds[dacOutput] = threshold;
+    }
+    queueBoardCommands(CMD_DAC_OUTPUT << dacOutput);
 
     //  evalBoard->setDacThresholdVoltage(dacOutput,threshold);
 }
@@ -231,6 +332,7 @@ void RHD2000Thread::setDACchannel(int dacOutput, int channel)
         {
             if (channel < channelCount + numChannelsPerDataStream[i])
             {
+                const SpinLock::ScopedLockType lock(boardCommandLock);
                 dacChannels[dacOutput] = channel - channelCount;
                 dacStream[dacOutput] = i;
                 break;
@@ -240,8 +342,7 @@ void RHD2000Thread::setDACchannel(int dacOutput, int channel)
                 channelCount += numChannelsPerDataStream[i];
             }
         }
-        dacChannelsToUpdate[dacOutput] = true;
-        dacOutputShouldChange = true;
+        queueBoardCommands(CMD_DAC_OUTPUT << dacOutput);
     }
 }
 
@@ -319,6 +420,35 @@ bool RHD2000Thread::openBoard(String pathToLibrary)
 
 }
 
+bool RHD2000Thread::openReplay(const File& captureFile)
+{
+    usbReplay = new UsbCaptureReplay();
+
+    if (!usbReplay->open(captureFile))
+    {
+        usbReplay = nullptr;
+        return false;
+    }
+
+    evalBoard->openEmulated(usbReplay, usbReplay->isUSB3());
+    deviceFound = true;
+    dataBlock = new Rhd2000DataBlock(1, evalBoard->isUSB3());
+
+    // the streams a port scan found when the capture was made
+    enabledStreams.clear();
+    chipId.clearQuick();
+    chipId.insertMultiple(0, -1, 8);
+    enableFoundHeadstages(usbReplay->getHeadstageChipIds());
+    updateBoardStreams();
+
+    if (enabledStreams.size() != usbReplay->getNumStreams())
+        std::cerr << "The capture holds " << usbReplay->getNumStreams() << " streams, but its headstages make "
+                  << enabledStreams.size() << std::endl;
+
+    setSampleRate(usbReplay->getSampleRateIndex());
+    return true;
+}
+
 bool RHD2000Thread::uploadBitfile(String bitfilename)
 {
 
@@ -430,9 +560,7 @@ void RHD2000Thread::initializeBoard()
 
     // Read the resulting single data block from the USB interface. We don't
     // need to do anything with this, since it was only used for ADC calibration
-    ScopedPointer<Rhd2000DataBlock> dataBlock = new Rhd2000DataBlock(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
-
-    evalBoard->readDataBlock(dataBlock, INIT_STEP);
+    evalBoard->readDataBlock(getDataBlock(), INIT_STEP);
     // Now that ADC calibration has been performed, we switch to the command sequence
     // that does not execute ADC calibration.
     evalBoard->selectAuxCommandBank(Rhd2000EvalBoard::PortA, Rhd2000EvalBoard::AuxCmd3,
@@ -537,8 +665,7 @@ void RHD2000Thread::scanPorts()
     evalBoard->setMaxTimeStep(INIT_STEP);
     evalBoard->setContinuousRunMode(false);
 
-    ScopedPointer<Rhd2000DataBlock> dataBlock =
-        new Rhd2000DataBlock(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
+    Rhd2000DataBlock* dataBlock = getDataBlock();
 
     Array<int> sumGoodDelays;
     sumGoodDelays.insertMultiple(0, 0, 8);
@@ -634,36 +761,7 @@ void RHD2000Thread::scanPorts()
     }
 
 #else
-    // Now, disable data streams where we did not find chips present.
-    int chipIdx = 0;
-    for (hs = 0; hs < MAX_NUM_HEADSTAGES; ++hs)
-    {
-        if ((tmpChipId[hs] > 0) && (enabledStreams.size() < MAX_NUM_DATA_STREAMS(evalBoard->isUSB3())))
-        {
-            chipId.set(chipIdx++,tmpChipId[hs]);
-            //std::cout << "Enabling headstage on stream " << stream << std::endl;
-            if (tmpChipId[hs] == CHIP_ID_RHD2164) //RHD2164
-            {
-                if (enabledStreams.size() < MAX_NUM_DATA_STREAMS(evalBoard->isUSB3()) - 1)
-                {
-                    enableHeadstage(hs,true,2,32);
-                    chipId.set(chipIdx++,CHIP_ID_RHD2164_B);
-                }
-                else //just one stream left
-                {
-                    enableHeadstage(hs,true,1,32);
-                }
-            }
-            else
-            {
-                enableHeadstage(hs, true,1,tmpChipId[hs] == 1 ? 32:16);
-            }
-        }
-        else
-        {
-            enableHeadstage(hs, false);
-        }
-    }
+    enableFoundHeadstages(tmpChipId);
 #endif
     updateBoardStreams();
 
@@ -711,6 +809,48 @@ void RHD2000Thread::scanPorts()
     newScan = true;
 }
 
+void RHD2000Thread::enableFoundHeadstages(const Array<int>& tmpChipId)
+{
+    // Now, disable data streams where we did not find chips present.
+    int chipIdx = 0;
+    for (int hs = 0; hs < MAX_NUM_HEADSTAGES; ++hs)
+    {
+        if ((tmpChipId[hs] > 0) && (enabledStreams.size() < MAX_NUM_DATA_STREAMS(evalBoard->isUSB3())))
+        {
+            chipId.set(chipIdx++,tmpChipId[hs]);
+            //std::cout << "Enabling headstage on stream " << stream << std::endl;
+            if (tmpChipId[hs] == CHIP_ID_RHD2164) //RHD2164
+            {
+                if (enabledStreams.size() < MAX_NUM_DATA_STREAMS(evalBoard->isUSB3()) - 1)
+                {
+                    enableHeadstage(hs,true,2,32);
+                    chipId.set(chipIdx++,CHIP_ID_RHD2164_B);
+                }
+                else //just one stream left
+                {
+                    enableHeadstage(hs,true,1,32);
+                }
+            }
+            else
+            {
+                enableHeadstage(hs, true,1,tmpChipId[hs] == 1 ? 32:16);
+            }
+        }
+        else
+        {
+            enableHeadstage(hs, false);
+        }
+    }
+}
+
+Rhd2000DataBlock* RHD2000Thread::getDataBlock()
+{
+    if (dataBlock == nullptr || dataBlock->getNumDataStreams() != evalBoard->getNumEnabledDataStreams())
+        dataBlock = new Rhd2000DataBlock(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
+
+    return dataBlock;
+}
+
 int RHD2000Thread::deviceId(Rhd2000DataBlock* dataBlock, int stream, int& register59Value)
 {
     bool intanChipPresent;
@@ -758,6 +898,7 @@ void RHD2000Thread::setNumChannels(int hsNum, int numChannels)
         else
             headstagesArray[hsNum]->setHalfChannels(false);
         numChannelsPerDataStream.set(headstagesArray[hsNum]->getStreamIndex(0), numChannels);
+        updateDecodeTables();
     }
 }
 
@@ -983,6 +1124,12 @@ float RHD2000Thread::getSampleRate(int subproc) const
     return evalBoard->getSampleRate();
 }
 
+void RHD2000Thread::resizeBuffers()
+{
+    // the buffer holds a fixed time of data, so it follows the sample rate too
+    resizeSourceBuffer(0, getNumChannels());
+}
+
 float RHD2000Thread::getBitVolts (const DataChannel* ch) const
 {
     if (ch->getChannelType() == DataChannel::ADC_CHANNEL)
@@ -1046,22 +1193,31 @@ void RHD2000Thread::setDSPOffset(bool state)
 
 void RHD2000Thread::setTTLoutputMode(bool state)
 {
-    ttlMode = state;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        ttlMode = state;
+    }
+    queueBoardCommands(CMD_TTL_MODE);
 }
 
 void RHD2000Thread::setDAChpf(float cutoff, bool enabled)
 {
-    dacOutputShouldChange = true;
-    desiredDAChpf = cutoff;
-    desiredDAChpfState = enabled;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        desiredDAChpf = cutoff;
+        desiredDAChpfState = enabled;
+    }
+    queueBoardCommands(CMD_DAC_HPF);
 }
 
 void RHD2000Thread::setFastTTLSettle(bool state, int channel)
 {
-    fastTTLSettleEnabled = state;
-    fastSettleTTLChannel = channel;
-    dacOutputShouldChange = true;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        fastTTLSettleEnabled = state;
+        fastSettleTTLChannel = channel;
+    }
+    queueBoardCommands(CMD_FAST_SETTLE);
 }
 
 int RHD2000Thread::setNoiseSlicerLevel(int level)
@@ -1126,7 +1282,7 @@ bool RHD2000Thread::enableHeadstage(int hsNum, bool enabled, int nStr, int strCh
         std::cout << numChannelsPerDataStream[i] << " ";
     }*/
 
-    sourceBuffers[0]->resize(getNumChannels(), 10000);
+    resizeSourceBuffer(0, getNumChannels());
 
     return true;
 }
@@ -1145,6 +1301,56 @@ void RHD2000Thread::updateBoardStreams()
             evalBoard->enableDataStream(i,false);
         }
     }
+
+    updateDecodeTables();
+}
+
+void RHD2000Thread::updateDecodeTables()
+{
+    int numStreams = enabledStreams.size();
+
+    // neural word (chan * numStreams + dataStream) of each frame holds channel chan of its stream
+    neuralWordChannels.clearQuick();
+    neuralWordChannels.insertMultiple(0, -1, 32 * numStreams);
+
+    int channel = 0;
+    for (int dataStream = 0; dataStream < numStreams; dataStream++)
+    {
+        int nChans = numChannelsPerDataStream[dataStream];
+        int chanOffset = 0;
+        if ((chipId[dataStream] == CHIP_ID_RHD2132) && (nChans == 16)) //RHD2132 16ch. headstage
+        {
+            chanOffset = RHD2132_16CH_OFFSET;
+        }
+        for (int chan = 0; chan < nChans; chan++)
+            neuralWordChannels.set((chan + chanOffset) * numStreams + dataStream, channel++);
+    }
+    numNeuralChannels = channel;
+
+    // groups of 4 words are converted together, and skipped when none of them is acquired
+    neuralWordGroups.clearQuick();
+    for (int word = 0; word < 32 * numStreams; word += 4)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            if (neuralWordChannels[word + k] >= 0)
+            {
+                neuralWordGroups.add(word);
+                break;
+            }
+        }
+    }
+
+    // the second stream of an RHD2164 has no aux inputs of its own
+    auxStreams.clearQuick();
+    if (acquireAuxChannels)
+    {
+        for (int dataStream = 0; dataStream < numStreams; dataStream++)
+            if (chipId[dataStream] != CHIP_ID_RHD2164_B)
+                auxStreams.add(dataStream);
+    }
+
+    numDecodedAdcs = acquireAdcChannels ? 8 : 0;
 }
 
 bool RHD2000Thread::isHeadstageEnabled(int hsNum) const
@@ -1192,7 +1398,8 @@ int RHD2000Thread::getChannelsInHeadstage (int hsNum) const
 void RHD2000Thread::enableAuxs(bool t)
 {
     acquireAuxChannels = t;
-    sourceBuffers[0]->resize(getNumChannels(), 10000);
+    updateDecodeTables();
+    resizeSourceBuffer(0, getNumChannels());
     updateRegisters();
     sn->update();
 }
@@ -1200,7 +1407,8 @@ void RHD2000Thread::enableAuxs(bool t)
 void RHD2000Thread::enableAdcs(bool t)
 {
     acquireAdcChannels = t;
-    sourceBuffers[0]->resize(getNumChannels(), 10000);
+    updateDecodeTables();
+    resizeSourceBuffer(0, getNumChannels());
     sn->update();
 }
 
@@ -1461,7 +1669,7 @@ void RHD2000Thread::setCableLength(int hsNum, float length)
 bool RHD2000Thread::startAcquisition()
 {
     impedanceThread->waitSafely();
-    dataBlock = new Rhd2000DataBlock(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
+    getDataBlock();
 
     std::cout << "Expecting " << getNumChannels() << " channels." << std::endl;
 
@@ -1489,12 +1697,39 @@ bool RHD2000Thread::startAcquisition()
         //evalBoard->printFIFOmetrics();
         evalBoard->run();
         //evalBoard->printFIFOmetrics();
+
+        if (usbReplay != nullptr)
+            usbReplay->start(boardSampleRate, DEBUG_REPLAY_REAL_TIME);
     }
 
     blockSize = dataBlock->calculateDataBlockSizeInWords(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
     std::cout << "Expecting blocksize of " << blockSize << " for " << evalBoard->getNumEnabledDataStreams() << " streams" << std::endl;
+
+    int samplesPerBlock = Rhd2000DataBlock::getSamplesPerDataBlock(evalBoard->isUSB3());
+    maxUsbBlocksPerRead = jmax(1, (int) (USB_BUFFER_SIZE / (2 * blockSize)));
+    if (lowLatencyReads)
+        usbBlocksPerRead = 1;
+    else
+        usbBlocksPerRead = jlimit(1, maxUsbBlocksPerRead,
+                                  roundToInt(boardSampleRate * USB_THROUGHPUT_READ_MS / 1000.0f / samplesPerBlock));
+    numUsbReads = 0;
+    numUsbBlocksRead = 0;
+
+#ifdef DEBUG_CAPTURE_USB_FILE
+    if (usbReplay == nullptr)
+    {
+        Array<int> headstageChipIds;
+        for (int hs = 0; hs < MAX_NUM_HEADSTAGES; hs++)
+            headstageChipIds.add(headstagesArray[hs]->isPlugged() ? chipId[headstagesArray[hs]->getStreamIndex(0)] : 0);
+
+        usbCapture.open(File::getCurrentWorkingDirectory().getChildFile(DEBUG_CAPTURE_USB_FILE), evalBoard->isUSB3(),
+                        savedSampleRateIndex, headstageChipIds, enabledStreams.size());
+    }
+#endif
+
     //evalBoard->printFIFOmetrics();
-    startThread();
+    if (!readByOwner)
+        startThread();
 
 
     isTransmitting = true;
@@ -1508,6 +1743,13 @@ bool RHD2000Thread::stopAcquisition()
     //  isTransmitting = false;
     std::cout << "RHD2000 data thread stopping acquisition." << std::endl;
 
+    if (CoreServices::getLatencyBenchmark() && numUsbReads > 0)
+    {
+        std::cout << "RHD2000 USB reads (" << (lowLatencyReads ? "low latency" : "throughput") << "): "
+                  << numUsbReads << " reads of " << double(numUsbBlocksRead) / numUsbReads
+                  << " blocks on average, " << usbBlocksPerRead << " blocks per read targeted" << std::endl;
+    }
+
     if (isThreadRunning())
     {
         signalThreadShouldExit();
@@ -1523,6 +1765,10 @@ bool RHD2000Thread::stopAcquisition()
         std::cout << "Thread failed to exit, continuing anyway..." << std::endl;
     }
 
+    if (usbReplay != nullptr)
+        usbReplay->stop();
+    usbCapture.close();
+
     if (deviceFound)
     {
         evalBoard->setContinuousRunMode(false);
@@ -1548,11 +1794,112 @@ bool RHD2000Thread::stopAcquisition()
     }
 
     isTransmitting = false;
-    dacOutputShouldChange = false;
 
     return true;
 }
 
+void RHD2000Thread::decodeUsbBlock(unsigned char* bufferPtr, int numFrames, int numStreams)
+{
+    DataBuffer* buffer = sourceBuffers[0];
+
+    if (numFrames > decodeCapacity)
+    {
+        decodeSink.malloc(numFrames);
+        wordRows.malloc(32 * MAX_NUM_DATA_STREAMS_USB3);
+        decodeCapacity = numFrames;
+    }
+
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+    int numItems = buffer->prepareToWrite(numFrames, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    decodeUsbFrames(bufferPtr, 0, blockSize1, startIndex1, numStreams);
+    if (blockSize2 > 0)
+        decodeUsbFrames(bufferPtr, blockSize1, blockSize2, startIndex2, numStreams);
+
+    buffer->finishedWrite(numItems, startIndex1);
+}
+
+void RHD2000Thread::decodeUsbFrames(unsigned char* bufferPtr, int firstFrame, int numFrames, int dstStart, int numStreams)
+{
+    DataBuffer* buffer = sourceBuffers[0];
+    float* const* channels = buffer->getChannelWritePointers();
+    int64* timestamps = buffer->getTimestampWritePointer() + dstStart;
+    uint64* eventWords = buffer->getEventCodeWritePointer() + dstStart;
+    int bufferChannels = buffer->getNumChannels();
+
+    int frameBytes = USB_FRAME_BYTES(numStreams);
+    int numWords = 32 * numStreams;
+    unsigned char* frames = bufferPtr + firstFrame * frameBytes;
+
+    jassert(neuralWordChannels.size() == numWords);
+
+    // neural word (chan * numStreams + dataStream) of each frame goes to the row of its channel,
+    // words not mapped to a channel to a scratch row
+    for (int word = 0; word < numWords; ++word)
+    {
+        int channel = neuralWordChannels.getUnchecked(word);
+        wordRows[word] = (channel >= 0 && channel < bufferChannels) ? channels[channel] + dstStart : decodeSink.getData();
+    }
+
+    convertNeuralWords(frames + USB_FRAME_NEURAL_OFFSET(numStreams), frameBytes,
+                       neuralWordGroups.getRawDataPointer(), neuralWordGroups.size(), wordRows, numFrames);
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        unsigned char* frame = frames + i * frameBytes;
+        timestamps[i] = Rhd2000DataBlock::convertUsbTimeStamp(frame, 8);
+        eventWords[i] = *(uint16*)(frame + USB_FRAME_TTL_OFFSET(numStreams));
+    }
+
+    // the 3 aux channels of each stream; aux inputs are only sampled every 4th frame,
+    // so each channel holds its last sample in between
+    for (int k = 0; k < auxStreams.size(); k++)
+    {
+        int dataStream = auxStreams.getUnchecked(k);
+        int firstChannel = numNeuralChannels + 3 * k;
+        if (firstChannel + 3 > bufferChannels)
+            break;
+
+        const unsigned char* aux = frames + USB_FRAME_AUX_OFFSET(numStreams) + 2 * dataStream;
+        float* latched = auxBuffer + firstChannel;
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            int auxNum = (firstFrame + i + 3) % 4;
+            if (auxNum < 3)
+            {
+                auxSamples[dataStream][auxNum] = float(*(uint16*)(aux + i * frameBytes) - 32768)*0.0000374;
+            }
+            else
+            {
+                for (int chan = 0; chan < 3; chan++)
+                    latched[chan] = auxSamples[dataStream][chan];
+            }
+            for (int chan = 0; chan < 3; chan++)
+                channels[firstChannel + chan][dstStart + i] = latched[chan];
+        }
+    }
+
+    // the 8 ADC channels, in volts
+    int firstAdcChannel = numNeuralChannels + 3 * auxStreams.size();
+    const unsigned char* adc = frames + USB_FRAME_ADC_OFFSET(numStreams);
+    for (int adcChan = 0; adcChan < numDecodedAdcs && firstAdcChannel + adcChan < bufferChannels; ++adcChan)
+    {
+        // account for the +/-5V input range and DC offset
+        bool bipolar = adcRangeSettings[adcChan] == 0;
+        float scale = bipolar ? 0.00015258789f : 0.00030517578f;
+        float offset = bipolar ? -5.0f - 0.4096f : 0.0f;
+        float* dst = channels[firstAdcChannel + adcChan] + dstStart;
+        const unsigned char* word = adc + 2 * adcChan;
+
+        for (int i = 0; i < numFrames; i++)
+            dst[i] = scale * float(*(uint16*)(word + i * frameBytes)) + offset;
+    }
+
+    if (syncAligner != nullptr)
+        syncAligner->processBlock(syncBoardIndex, timestamps, eventWords, numFrames);
+}
+
 bool RHD2000Thread::updateBuffer()
 {
     //int chOffset;
@@ -1561,142 +1908,137 @@ bool RHD2000Thread::updateBuffer()
     //cout << "Block size: " << blockSize << endl;
 
     //std::cout << "Current number of words: " <<  evalBoard->numWordsInFifo() << " for " << blockSize << std::endl;
-    if (evalBoard->isUSB3() || evalBoard->numWordsInFifo() >= blockSize)
+    int samplesPerBlock = Rhd2000DataBlock::getSamplesPerDataBlock(evalBoard->isUSB3());
+    int numBlocks = usbBlocksPerRead;
+
+    // USB3 reads wait on the board until the data is there. On USB2 the FIFO is polled first,
+    // and a backlog is caught up with in a single read
+    if (!evalBoard->isUSB3())
+    {
+        int fifoBlocks = (int) (evalBoard->numWordsInFifo() / blockSize);
+
+        if (fifoBlocks < numBlocks)
+        {
+            // sleep until the next read is due instead of spinning on the FIFO count
+            waitForData(samplesPerBlock * (numBlocks - fifoBlocks));
+            numBlocks = 0;
+        }
+        else
+            numBlocks = jmin(fifoBlocks, maxUsbBlocksPerRead);
+    }
+
+    if (numBlocks > 0)
     {
         bool return_code;
 
-        return_code = evalBoard->readRawDataBlock(&bufferPtr);
+        return_code = evalBoard->readRawDataBlock(&bufferPtr, numBlocks * samplesPerBlock);
         // see Rhd2000DataBlock::fillFromUsbBuffer() for an idea of data order in bufferPtr
 
-        int index = 0;
-        int auxIndex, chanIndex;
         int numStreams = enabledStreams.size();
-        int nSamps = Rhd2000DataBlock::getSamplesPerDataBlock(evalBoard->isUSB3());
+        int nSamps = numBlocks * samplesPerBlock;
+        int frameBytes = USB_FRAME_BYTES(numStreams);
 
-        //evalBoard->printFIFOmetrics();
-        for (int samp = 0; samp < nSamps; samp++)
-        {
-            int channel = -1;
+        numUsbReads++;
+        numUsbBlocksRead += numBlocks;
 
-            if (!Rhd2000DataBlock::checkUsbHeader(bufferPtr, index))
-            {
-                cerr << "Error in Rhd2000EvalBoard::readDataBlock: Incorrect header." << endl;
-                break;
-            }
+        // only the frames before a corrupted one are decoded
+        int numFrames = 0;
+        while (numFrames < nSamps && Rhd2000DataBlock::checkUsbHeader(bufferPtr, numFrames * frameBytes))
+            numFrames++;
 
-            index += 8; // magic number header width (bytes)
-            timestamps.set(0, Rhd2000DataBlock::convertUsbTimeStamp(bufferPtr, index));
-            index += 4; // timestamp width
-            auxIndex = index; // aux chans start at this offset
-            // skip aux channels for now
-            index += 6 * numStreams; // width of the 3 aux chans
-            // copy 64 neural data channels
-            for (int dataStream = 0; dataStream < numStreams; dataStream++)
-            {
-                int nChans = numChannelsPerDataStream[dataStream];
-                chanIndex = index + 2*dataStream;
-                if ((chipId[dataStream] == CHIP_ID_RHD2132) && (nChans == 16)) //RHD2132 16ch. headstage
-                {
-                    chanIndex += 2 * RHD2132_16CH_OFFSET*numStreams;
-                }
-                for (int chan = 0; chan < nChans; chan++)
-                {
-                    channel++;
-                    thisSample[channel] = float(*(uint16*)(bufferPtr + chanIndex) - 32768)*0.195f;
-                    chanIndex += 2*numStreams; // single chan width (2 bytes)
-                }
-            }
-            index += 64 * numStreams; // neural data width
-            auxIndex += 2 * numStreams; // skip AuxCmd1 slots (see updateRegisters())
-            // copy the 3 aux channels
-            if (acquireAuxChannels)
-            {
-                for (int dataStream = 0; dataStream < numStreams; dataStream++)
-                {
-                    if (chipId[dataStream] != CHIP_ID_RHD2164_B)
-                    {
-                        int auxNum = (samp+3) % 4;
-                        if (auxNum < 3)
-                        {
-                            auxSamples[dataStream][auxNum] = float(*(uint16*)(bufferPtr + auxIndex) - 32768)*0.0000374;
-                        }
-                        for (int chan = 0; chan < 3; chan++)
-                        {
-                            channel++;
-                            if (auxNum == 3)
-                            {
-                                auxBuffer[channel] = auxSamples[dataStream][chan];
-                            }
-                            thisSample[channel] = auxBuffer[channel];
-                        }
-                    }
-                    auxIndex += 2; // single chan width (2 bytes)
-                }
-            }
-            index += 2 * numStreams; // skip over filler word at the end of each data stream
-            // copy the 8 ADC channels
-            if (acquireAdcChannels)
-            {
-                for (int adcChan = 0; adcChan < 8; ++adcChan)
-                {
+        if (numFrames < nSamps)
+            cerr << "Error in Rhd2000EvalBoard::readDataBlock: Incorrect header." << endl;
 
-                    channel++;
-                    // ADC waveform units = volts
-                    thisSample[channel] = adcRangeSettings[adcChan] == 0 ?
-                        //0.000050354 * float(dataBlock->boardAdcData[adcChan][samp]);
-                        0.00015258789 * float(*(uint16*)(bufferPtr + index)) - 5 - 0.4096 : // account for +/-5V input range and DC offset
-                        0.00030517578 * float(*(uint16*)(bufferPtr + index));
-                    index += 2; // single chan width (2 bytes)
-                }
-            }
-            else
-            {
-                index += 16; // skip ADC chans (8 * 2 bytes)
-            }
-            ttlEventWords.set(0, *(uint16*)(bufferPtr + index));
-            index += 4;
-            sourceBuffers[0]->addToBuffer(thisSample, &timestamps.getReference(0), &ttlEventWords.getReference(0), 1);
-        }
+        usbCapture.write(bufferPtr, (int64) numFrames * frameBytes);
 
+        //evalBoard->printFIFOmetrics();
+        if (numFrames > 0)
+            decodeUsbBlock(bufferPtr, numFrames, numStreams);
+
+        dataArrived();
     }
 
 
-    if (dacOutputShouldChange)
+    applyBoardCommands();
+
+    return true;
+
+}
+
+void RHD2000Thread::queueBoardCommands(uint32 commands)
+{
+    pendingBoardCommands.fetch_or(commands, std::memory_order_release);
+}
+
+void RHD2000Thread::applyBoardCommands()
+{
+    if (pendingBoardCommands.load(std::memory_order_relaxed) == 0)
+        return;
+
+    uint32 commands = pendingBoardCommands.exchange(0, std::memory_order_acquire);
+
+    // take the latest values, so that the setters never wait for the USB writes
+    int streams[8], channels[8];
+    float thresholds[8];
+    bool ttl, fastSettle, hpfEnabled, leds;
+    int fastSettleChannel;
+    double hpf;
+    uint16 clockDivider;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        for (int k = 0; k < 8; k++)
+        {
+            streams[k] = dacStream[k];
+            channels[k] = dacChannels[k];
+            thresholds[k] = dacThresholds[k];
+        }
+        ttl = ttlMode;
+        fastSettle = fastTTLSettleEnabled;
+        fastSettleChannel = fastSettleTTLChannel;
+        hpf = desiredDAChpf;
+        hpfEnabled = desiredDAChpfState;
+        leds = ledsEnabled;
+        clockDivider = clockDivideFactor;
+    }
+
+    for (int k = 0; k < 8; k++)
     {
-        std::cout << "DAC" << std::endl;
-        for (int k=0; k<8; k++)
+        if (!(commands & (CMD_DAC_OUTPUT << k)))
+            continue;
+
+        if (channels[k] >= 0)
         {
-            if (dacChannelsToUpdate[k])
-            {
-                dacChannelsToUpdate[k] = false;
-                if (dacChannels[k] >= 0)
-                {
-                    evalBoard->enableDac(k, true);
-                    evalBoard->selectDacDataStream(k, dacStream[k]);
-                    evalBoard->selectDacDataChannel(k, dacChannels[k]);
-                    evalBoard->setDacThreshold(k, (int)abs((dacThresholds[k]/0.195) + 32768),dacThresholds[k] >= 0);
-                   // evalBoard->setDacThresholdVoltage(k, (int) dacThresholds[k]);
-                }
-                else
-                {
-                    evalBoard->enableDac(k, false);
-                }
-            }
+            evalBoard->enableDac(k, true);
+            evalBoard->selectDacDataStream(k, streams[k]);
+            evalBoard->selectDacDataChannel(k, channels[k]);
+            evalBoard->setDacThreshold(k, (int)abs((thresholds[k]/0.195) + 32768), thresholds[k] >= 0);
         }
+        else
+        {
+            evalBoard->enableDac(k, false);
+        }
+    }
 
-        evalBoard->setTtlMode(ttlMode ? 1 : 0);
-        evalBoard->enableExternalFastSettle(fastTTLSettleEnabled);
-        evalBoard->setExternalFastSettleChannel(fastSettleTTLChannel);
-        evalBoard->setDacHighpassFilter(desiredDAChpf);
-        evalBoard->enableDacHighpassFilter(desiredDAChpfState);
-        evalBoard->enableBoardLeds(ledsEnabled);
-        evalBoard->setClockDivider(clockDivideFactor);
+    if (commands & CMD_TTL_MODE)
+        evalBoard->setTtlMode(ttl ? 1 : 0);
+
+    if (commands & CMD_FAST_SETTLE)
+    {
+        evalBoard->enableExternalFastSettle(fastSettle);
+        evalBoard->setExternalFastSettleChannel(fastSettleChannel);
+    }
 
-        dacOutputShouldChange = false;
+    if (commands & CMD_DAC_HPF)
+    {
+        evalBoard->setDacHighpassFilter(hpf);
+        evalBoard->enableDacHighpassFilter(hpfEnabled);
     }
 
-    return true;
+    if (commands & CMD_BOARD_LEDS)
+        evalBoard->enableBoardLeds(leds);
 
+    if (commands & CMD_CLOCK_DIVIDER)
+        evalBoard->setClockDivider(clockDivider);
 }
 
 int RHD2000Thread::getChannelFromHeadstage (int hs, int ch) const
@@ -1793,11 +2135,51 @@ int RHD2000Thread::getHeadstageChannel (int& hs, int ch) const
     return -1;
 }
 
+void RHD2000Thread::setLowLatencyReads(bool enable)
+{
+    lowLatencyReads = enable;
+}
+
+bool RHD2000Thread::getLowLatencyReads() const
+{
+    return lowLatencyReads;
+}
+
+void RHD2000Thread::setSyncAligner(SyncAligner* aligner, int boardIndex)
+{
+    syncAligner = aligner;
+    syncBoardIndex = boardIndex;
+}
+
+void RHD2000Thread::copySettingsFrom(const RHD2000Thread& master)
+{
+    if (master.savedSampleRateIndex != savedSampleRateIndex)
+        setSampleRate(master.savedSampleRateIndex);
+
+    desiredUpperBandwidth = master.desiredUpperBandwidth;
+    desiredLowerBandwidth = master.desiredLowerBandwidth;
+    desiredDspCutoffFreq = master.desiredDspCutoffFreq;
+    setDSPOffset(master.dspEnabled);
+
+    acquireAuxChannels = master.acquireAuxChannels;
+    acquireAdcChannels = master.acquireAdcChannels;
+    lowLatencyReads = master.lowLatencyReads;
+
+    for (int i = 0; i < 8; i++)
+        adcRangeSettings[i] = master.adcRangeSettings[i].load();
+
+    updateDecodeTables();
+    resizeSourceBuffer(0, getNumChannels());
+}
+
 void RHD2000Thread::enableBoardLeds(bool enable)
 {
-    ledsEnabled = enable;
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        ledsEnabled = enable;
+    }
     if (isAcquisitionActive())
-        dacOutputShouldChange = true;
+        queueBoardCommands(CMD_BOARD_LEDS);
     else
         evalBoard->enableBoardLeds(enable);
 }
@@ -1816,13 +2198,16 @@ int RHD2000Thread::setClockDivider(int divide_ratio)
     // Ratio    N
     // 1        0
     // >=2      Ratio/2
-    if (divide_ratio == 1)
-        clockDivideFactor = 0;
-    else
-        clockDivideFactor = static_cast<uint16>(divide_ratio/2);
+    {
+        const SpinLock::ScopedLockType lock(boardCommandLock);
+        if (divide_ratio == 1)
+            clockDivideFactor = 0;
+        else
+            clockDivideFactor = static_cast<uint16>(divide_ratio/2);
+    }
 
     if (isAcquisitionActive())
-        dacOutputShouldChange = true;
+        queueBoardCommands(CMD_CLOCK_DIVIDER);
     else
         evalBoard->setClockDivider(clockDivideFactor);
 
@@ -2004,52 +2389,28 @@ float RHDImpedanceMeasure::updateImpedanceFrequency(float desiredImpedanceFreq,
 }
 
 
-// Reads numBlocks blocks of raw USB data stored in a queue of Rhd2000DataBlock
-// objects, loads this data into this SignalProcessor object, scaling the raw
-// data to generate waveforms with units of volts or microvolts.
-int RHDImpedanceMeasure::loadAmplifierData(queue<Rhd2000DataBlock>& dataQueue,
-    int numBlocks, int numDataStreams)
+// Reads numBlocks blocks of raw USB data decoded into the data block pool, and
+// scales the samples of one amplifier channel of every stream to microvolts.
+// Only the channel under test carries the impedance signal.
+int RHDImpedanceMeasure::loadAmplifierData(int numBlocks, int numDataStreams, int channel)
 {
-
-    int block, t, channel, stream;
+    const int samplesPerBlock = SAMPLES_PER_DATA_BLOCK(board->evalBoard->isUSB3());
     int indexAmp = 0;
-    /*
-    int indexAux = 0;
-    int indexSupply = 0;
-    int indexAdc = 0;
-    int indexDig = 0;
-    int numWordsWritten = 0;
-
-    int bufferIndex;
-    int16 tempQint16;
-    uint16 tempQuint16;
-    int32 tempQint32;
 
-    bool triggerFound = false;
-    const double AnalogTriggerThreshold = 1.65;
-     */
-
-
-    for (block = 0; block < numBlocks; ++block)
+    for (int block = 0; block < numBlocks; ++block)
     {
+        const Rhd2000DataBlock& dataBlock = *dataBlocks[block];
 
-        // Load and scale RHD2000 amplifier waveforms
-        // (sampled at amplifier sampling rate)
-        for (t = 0; t < SAMPLES_PER_DATA_BLOCK(board->evalBoard->isUSB3()); ++t)
+        for (int stream = 0; stream < numDataStreams; ++stream)
         {
-            for (channel = 0; channel < 32; ++channel)
-            {
-                for (stream = 0; stream < numDataStreams; ++stream)
-                {
-                    // Amplifier waveform units = microvolts
-                    amplifierPreFilter[stream][channel][indexAmp] = 0.195 *
-                        (dataQueue.front().amplifierData[stream][channel][t] - 32768);
-                }
-            }
-            ++indexAmp;
+            const int* samples = dataBlock.amplifierData.data() + dataBlock.amplifierIndex(stream, channel, 0);
+            double* dest = amplifierPreFilter[stream][channel].data() + indexAmp;
+
+            // Amplifier waveform units = microvolts
+            for (int t = 0; t < samplesPerBlock; ++t)
+                dest[t] = 0.195 * (samples[t] - 32768);
         }
-        // We are done with this Rhd2000DataBlock object; remove it from dataQueue
-        dataQueue.pop();
+        indexAmp += samplesPerBlock;
     }
 
     return 0;
@@ -2060,12 +2421,9 @@ int RHDImpedanceMeasure::loadAmplifierData(queue<Rhd2000DataBlock>& dataQueue,
 #define DEGREES_TO_RADIANS  0.0174532925199
 #define RADIANS_TO_DEGREES  57.2957795132
 
-// Return the magnitude and phase (in degrees) of a selected frequency component (in Hz)
-// for a selected amplifier channel on the selected USB data stream.
-void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
-    std::vector<std::vector<std::vector<double>>>& measuredPhase,
-    int capIndex, int stream, int chipChannel, int numBlocks,
-    double sampleRate, double frequency, int numPeriods)
+// Chooses the samples every channel is measured over, and tabulates the sine and
+// cosine waveforms they are correlated with.
+void RHDImpedanceMeasure::prepareCorrelation(int numBlocks, double sampleRate, double frequency, int numPeriods)
 {
     int period = (sampleRate / frequency);
     int startIndex = 0;
@@ -2078,11 +2436,29 @@ void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::v
         endIndex += period;
     }
 
+    const double k = TWO_PI * frequency / sampleRate;
+
+    windowStart = startIndex;
+    correlationCos.resize(endIndex - startIndex + 1);
+    correlationSin.resize(endIndex - startIndex + 1);
+
+    for (int t = startIndex; t <= endIndex; ++t)
+    {
+        correlationCos[t - startIndex] = cos(k * t);
+        correlationSin[t - startIndex] = -1.0 * sin(k * t);
+    }
+}
+
+// Return the magnitude and phase (in degrees) of the frequency component set by
+// prepareCorrelation() for a selected amplifier channel on the selected USB data stream.
+void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
+    std::vector<std::vector<std::vector<double>>>& measuredPhase,
+    int capIndex, int stream, int chipChannel)
+{
     double iComponent, qComponent;
 
     // Measure real (iComponent) and imaginary (qComponent) amplitude of frequency component.
-    amplitudeOfFreqComponent(iComponent, qComponent, amplifierPreFilter[stream][chipChannel],
-        startIndex, endIndex, sampleRate, frequency);
+    amplitudeOfFreqComponent(iComponent, qComponent, amplifierPreFilter[stream][chipChannel].data() + windowStart);
     // Calculate magnitude and phase from real (I) and imaginary (Q) components.
     measuredMagnitude[stream][chipChannel][capIndex] =
         sqrt(iComponent * iComponent + qComponent * qComponent);
@@ -2090,23 +2466,37 @@ void RHDImpedanceMeasure::measureComplexAmplitude(std::vector<std::vector<std::v
         RADIANS_TO_DEGREES *atan2(qComponent, iComponent);
 }
 
-// Returns the real and imaginary amplitudes of a selected frequency component in the vector
-// data, between a start index and end index.
+// Returns the real and imaginary amplitudes of the tabulated frequency component in the
+// measurement window of the data.
 void RHDImpedanceMeasure::amplitudeOfFreqComponent(double& realComponent, double& imagComponent,
-    const std::vector<double>& data, int startIndex,
-    int endIndex, double sampleRate, double frequency)
+    const double* data)
 {
-    int length = endIndex - startIndex + 1;
-    const double k = TWO_PI * frequency / sampleRate;  // precalculate for speed
+    const int length = (int) correlationCos.size();
+    const double* cosTable = correlationCos.data();
+    const double* sinTable = correlationSin.data();
 
-    // Perform correlation with sine and cosine waveforms.
-    double meanI = 0.0;
-    double meanQ = 0.0;
-    for (int t = startIndex; t <= endIndex; ++t)
+    // Perform correlation with sine and cosine waveforms. Independent partial sums
+    // let the compiler keep several multiply-adds in flight.
+    double sumI[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double sumQ[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+    int t = 0;
+    for (; t + 4 <= length; t += 4)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            sumI[lane] += data[t + lane] * cosTable[t + lane];
+            sumQ[lane] += data[t + lane] * sinTable[t + lane];
+        }
+    }
+    for (; t < length; ++t)
     {
-        meanI += data.at(t) * cos(k * t);
-        meanQ += data.at(t) * -1.0 * sin(k * t);
+        sumI[0] += data[t] * cosTable[t];
+        sumQ[0] += data[t] * sinTable[t];
     }
+
+    double meanI = (sumI[0] + sumI[1]) + (sumI[2] + sumI[3]);
+    double meanQ = (sumQ[0] + sumQ[1]) + (sumQ[2] + sumQ[3]);
     meanI /= (double)length;
     meanQ /= (double)length;
 
@@ -2171,12 +2561,45 @@ void RHDImpedanceMeasure::run()
     data = nullptr;
 }
 
+// Sets the series capacitance and the channel to check, and starts the board
+void RHDImpedanceMeasure::startImpedanceRun(int capRange, int zcheckChannel)
+{
+    if (capRange != currentCapRange)
+    {
+        switch (capRange)
+        {
+        case 0:
+            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs100fF);
+            cout << "setting capacitance to 0.1pF" << endl;
+            break;
+        case 1:
+            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs1pF);
+            cout << "setting capacitance to 1pF" << endl;
+            break;
+        case 2:
+            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs10pF);
+            cout << "setting capacitance to 10pF" << endl;
+            break;
+        }
+        currentCapRange = capRange;
+    }
+
+    cout << "running impedance on channel " << zcheckChannel << endl;
+
+    vector<int> commandList;
+    board->chipRegisters.setZcheckChannel(zcheckChannel);
+    board->chipRegisters.createCommandListRegisterConfig(commandList, false);
+    // Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
+    board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoard::AuxCmd3, 3);
+
+    board->evalBoard->run();
+}
+
 #define CHECK_EXIT if (threadShouldExit()) return
 
 void RHDImpedanceMeasure::runImpedanceMeasurement()
 {
     int commandSequenceLength, stream, channel, capRange;
-    double cSeries;
     vector<int> commandList;
     //int triggerIndex;                       // dummy reference variable; not used
     queue<Rhd2000DataBlock> bufferQueue;    // dummy reference variable; not used
@@ -2257,6 +2680,7 @@ void RHDImpedanceMeasure::runImpedanceMeasurement()
     // of all amplifier channels (32 on each data stream) at three different Cseries values.
     std::vector<std::vector<std::vector<double>>>  measuredMagnitude;
     std::vector<std::vector<std::vector<double>>>  measuredPhase;
+    currentCapRange = -1;
 
     measuredMagnitude.resize(board->evalBoard->getNumEnabledDataStreams());
     measuredPhase.resize(board->evalBoard->getNumEnabledDataStreams());
@@ -2285,90 +2709,55 @@ void RHDImpedanceMeasure::runImpedanceMeasurement()
 
     int bestAmplitudeIndex;
 
+    prepareCorrelation(numBlocks, board->boardSampleRate, actualImpedanceFreq, numPeriods);
+
     // We execute three complete electrode impedance measurements: one each with
     // Cseries set to 0.1 pF, 1 pF, and 10 pF.  Then we select the best measurement
     // for each channel so that we achieve a wide impedance measurement range.
-    for (capRange = 0; capRange < 3; ++capRange)
+    // Each run checks one channel across all active data streams; if an RHD2164 chip
+    // is plugged in, its channels 32-63 take another run.
+    struct ImpedanceRun
     {
+        int capRange;
+        int channel;
+        bool rhd2164Channels;
+    };
 
-        switch (capRange)
-        {
-        case 0:
-            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs100fF);
-            cSeries = 0.1e-12;
-            cout << "setting capacitance to 0.1pF" << endl;
-            break;
-        case 1:
-            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs1pF);
-            cSeries = 1.0e-12;
-            cout << "setting capacitance to 1pF" << endl;
-            break;
-        case 2:
-            board->chipRegisters.setZcheckScale(Rhd2000Registers::ZcheckCs10pF);
-            cSeries = 10.0e-12;
-            cout << "setting capacitance to 10pF" << endl;
-            break;
-        }
-
-        // Check all 32 channels across all active data streams.
+    std::vector<ImpedanceRun> runs;
+    for (capRange = 0; capRange < 3; ++capRange)
+    {
         for (channel = 0; channel < 32; ++channel)
         {
-            CHECK_EXIT;
-            cout << "running impedance on channel " << channel << endl;
+            runs.push_back({ capRange, channel, false });
 
-            board->chipRegisters.setZcheckChannel(channel);
-            commandSequenceLength =
-                board->chipRegisters.createCommandListRegisterConfig(commandList, false);
-            // Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
-            board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoard::AuxCmd3, 3);
+            if (rhd2164ChipPresent)
+                runs.push_back({ capRange, channel, true });
+        }
+    }
 
-            board->evalBoard->run();
-            while (board->evalBoard->isRunning())
-            {
+    // The board acquires the next run while the data of the previous one is analyzed
+    CHECK_EXIT;
+    startImpedanceRun(runs[0].capRange, runs[0].channel + (runs[0].rhd2164Channels ? 32 : 0));
 
-            }
-            queue<Rhd2000DataBlock> dataQueue;
-            board->evalBoard->readDataBlocks(numBlocks, dataQueue);
-            loadAmplifierData(dataQueue, numBlocks, numdataStreams);
-            for (stream = 0; stream < numdataStreams; ++stream)
-            {
-                if (board->chipId[stream] != CHIP_ID_RHD2164_B)
-                {
-                    measureComplexAmplitude(measuredMagnitude, measuredPhase,
-                        capRange, stream, channel, numBlocks, board->boardSampleRate,
-                        actualImpedanceFreq, numPeriods);
-                }
-            }
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        while (board->evalBoard->isRunning())
+        {
 
-            // If an RHD2164 chip is plugged in, we have to set the Zcheck select register to channels 32-63
-            // and repeat the previous steps.
-            if (rhd2164ChipPresent)
-            {
-                CHECK_EXIT;
-                board->chipRegisters.setZcheckChannel(channel + 32); // address channels 32-63
-                commandSequenceLength =
-                    board->chipRegisters.createCommandListRegisterConfig(commandList, false);
-                // Upload version with no ADC calibration to AuxCmd3 RAM Bank 1.
-                board->evalBoard->uploadCommandList(commandList, Rhd2000EvalBoard::AuxCmd3, 3);
-
-                board->evalBoard->run();
-                while (board->evalBoard->isRunning())
-                {
+        }
+        board->evalBoard->readDataBlocks(numBlocks, dataBlocks);
 
-                }
-                board->evalBoard->readDataBlocks(numBlocks, dataQueue);
-                loadAmplifierData(dataQueue, numBlocks, numdataStreams);
+        CHECK_EXIT;
+        if (i + 1 < runs.size())
+            startImpedanceRun(runs[i + 1].capRange, runs[i + 1].channel + (runs[i + 1].rhd2164Channels ? 32 : 0));
 
-                for (stream = 0; stream < board->evalBoard->getNumEnabledDataStreams(); ++stream)
-                {
-                    if (board->chipId[stream] == CHIP_ID_RHD2164_B)
-                    {
-                        measureComplexAmplitude(measuredMagnitude, measuredPhase,
-                            capRange, stream, channel, numBlocks, board->boardSampleRate,
-                            actualImpedanceFreq, numPeriods);
-                    }
-                }
-            }
+        const ImpedanceRun& run = runs[i];
+        loadAmplifierData(numBlocks, numdataStreams, run.channel);
+
+        for (stream = 0; stream < numdataStreams; ++stream)
+        {
+            if ((board->chipId[stream] == CHIP_ID_RHD2164_B) == run.rhd2164Channels)
+                measureComplexAmplitude(measuredMagnitude, measuredPhase, run.capRange, stream, run.channel);
         }
     }
 
@@ -36,6 +36,8 @@
 #include "rhythm-api/rhd2000datablock.h"
 #include "rhythm-api/okFrontPanelDLL.h"
 
+#include "UsbCapture.h"
+
 #define MAX_NUM_DATA_STREAMS_USB2 8
 #define MAX_NUM_DATA_STREAMS_USB3 16
 #define MAX_NUM_HEADSTAGES 8
@@ -47,6 +49,7 @@ namespace RhythmNode
 
 	class RHDHeadstage;
 	class RHDImpedanceMeasure;
+	class SyncAligner;
 
 	struct ImpedanceData
 	{
@@ -66,6 +69,7 @@ namespace RhythmNode
 		, public Timer
 	{
 		friend class RHDImpedanceMeasure;
+		friend class MultiBoardThread;
 
 	public:
 		RHD2000Thread(SourceNode* sn);
@@ -85,6 +89,7 @@ namespace RhythmNode
 		bool usesCustomNames() const override;
 
 		float getSampleRate(int subprocessor) const override;
+		void resizeBuffers() override;
 		float getBitVolts(const DataChannel* chan) const override;
 
 		float getAdcBitVolts(int channelNum) const;
@@ -144,6 +149,20 @@ namespace RhythmNode
 		void enableBoardLeds(bool enable);
 		int setClockDivider(int divide_ratio);
 
+		/** In low latency mode each USB block is read as soon as it is complete. Otherwise reads
+			are batched to cover USB_THROUGHPUT_READ_MS of samples, which costs less CPU and USB
+			overhead per sample when nothing reacts to the data in closed loop. Takes effect at
+			the next start of acquisition */
+		void setLowLatencyReads(bool enable);
+		bool getLowLatencyReads() const;
+
+		/** Reports the sync edges of every decoded block to the aligner, as board boardIndex.
+			The aligner rewrites the timestamps of the boards other than the master */
+		void setSyncAligner(SyncAligner* aligner, int boardIndex);
+
+		/** Applies the sample rate, filter and channel settings of another board */
+		void copySettingsFrom(const RHD2000Thread& master);
+
 		void setAdcRange(int adcChannel, short rangeType);
 		short getAdcRange(int adcChannel) const;
 
@@ -155,40 +174,72 @@ namespace RhythmNode
 	private:
 		bool enableHeadstage(int hsNum, bool enabled, int nStr = 1, int strChans = 32);
 		void updateBoardStreams();
+
+		/** Rebuilds the tables that map the words of a USB frame to the enabled channels. Called
+			whenever the data streams, their channel counts or the acquired inputs change */
+		void updateDecodeTables();
 		void setCableLength(int hsNum, float length);
 
 		void setDefaultChannelNames() override;
 
 		bool updateBuffer() override;
 
+		/** Decodes the first numFrames frames of a USB data block straight into the source buffer */
+		void decodeUsbBlock(unsigned char* bufferPtr, int numFrames, int numStreams);
+		void decodeUsbFrames(unsigned char* bufferPtr, int firstFrame, int numFrames, int dstStart, int numStreams);
+
 		void timerCallback() override;
 
 		bool startAcquisition() override;
 		bool stopAcquisition()  override;
 
 		ScopedPointer<Rhd2000EvalBoard> evalBoard;
+		ScopedPointer<UsbCaptureReplay> usbReplay;	// data of an emulated board, see openReplay()
+		UsbCaptureWriter usbCapture;
 		Rhd2000Registers chipRegisters;
 		ScopedPointer<Rhd2000DataBlock> dataBlock;
 
 		int numChannels;
 		bool deviceFound;
 
-		float thisSample[MAX_NUM_CHANNELS];
+		// destination row of each neural word of a USB frame, and the row unused words are decoded into
+		HeapBlock<float*> wordRows;
+		HeapBlock<float> decodeSink;
+		int decodeCapacity{ 0 };
+
+		// decode tables for the current stream layout, see updateDecodeTables()
+		Array<int> neuralWordChannels;	// channel of each neural word of a frame, -1 when it is not acquired
+		Array<int> neuralWordGroups;	// first word of each group of 4 words holding an acquired channel
+		Array<int> auxStreams;			// data stream of each aux channel triple, in channel order
+		int numNeuralChannels{ 0 };
+		int numDecodedAdcs{ 0 };
 		// aux inputs are only sampled every 4th sample, so use this to buffer the samples so they can be handles just like the regular neural channels later
 		float auxBuffer[MAX_NUM_CHANNELS];
 		float auxSamples[MAX_NUM_DATA_STREAMS_USB3][3];
 
 		unsigned int blockSize;
 
+		bool lowLatencyReads;
+		int usbBlocksPerRead;
+		int maxUsbBlocksPerRead;
+		int64 numUsbReads;
+		int64 numUsbBlocksRead;
+
+		SyncAligner* syncAligner;
+		int syncBoardIndex;
+
+		/** Set when a MultiBoardThread calls updateBuffer() from one of its subprocessor readers,
+			so the board doesn't start a thread of its own */
+		bool readByOwner;
+
 		bool isTransmitting;
 
-		bool dacOutputShouldChange;
 		bool acquireAuxChannels;
 		bool acquireAdcChannels;
 
 		bool fastSettleEnabled;
 		bool fastTTLSettleEnabled;
-		bool fastSettleTTLChannel;
+		int fastSettleTTLChannel;
 		bool ttlMode;
 		bool desiredDAChpfState;
 		double desiredDAChpf;
@@ -204,11 +255,42 @@ namespace RhythmNode
 		String libraryFilePath;
 
 		bool openBoard(String pathToLibrary);
+
+		/** Emulates the board from a capture of its raw USB data, with the headstages and
+			sample rate it was captured with. Returns false if the capture can't be read */
+		bool openReplay(const File& captureFile);
+
+		/** Enables the data streams of the headstages whose chip ID is known, one per headstage */
+		void enableFoundHeadstages(const Array<int>& headstageChipIds);
 		bool uploadBitfile(String pathToBitfile);
 		void initializeBoard();
 
 		void updateRegisters();
 
+		/** Board output registers that are written between USB reads during acquisition */
+		enum BoardCommand
+		{
+			CMD_DAC_OUTPUT = 1,				// bits 0-7, one per DAC
+			CMD_TTL_MODE = 1 << 8,
+			CMD_FAST_SETTLE = 1 << 9,
+			CMD_DAC_HPF = 1 << 10,
+			CMD_BOARD_LEDS = 1 << 11,
+			CMD_CLOCK_DIVIDER = 1 << 12
+		};
+
+		/** Marks registers whose value has changed. Called after the new values are stored
+			under boardCommandLock */
+		void queueBoardCommands(uint32 commands);
+
+		/** Writes each marked register once, with its latest value */
+		void applyBoardCommands();
+
+		std::atomic<uint32> pendingBoardCommands;
+		SpinLock boardCommandLock;		// guards the values the board commands write
+
+		/** The reusable data block, reallocated only when the number of enabled streams changes */
+		Rhd2000DataBlock* getDataBlock();
+
 		int deviceId(Rhd2000DataBlock* dataBlock, int stream, int& register59Value);
 
 		double cableLengthPortA, cableLengthPortB, cableLengthPortC, cableLengthPortD;
@@ -216,7 +298,6 @@ namespace RhythmNode
 		int audioOutputL, audioOutputR;
 		int* dacChannels, *dacStream;
 		float* dacThresholds;
-		bool* dacChannelsToUpdate;
 		Array<int> chipId;
 		OwnedArray<RHDHeadstage> headstagesArray;
 		Array<Rhd2000EvalBoard::BoardDataSource> enabledStreams;
@@ -290,14 +371,16 @@ namespace RhythmNode
 		void runImpedanceMeasurement();
 		void restoreFPGA();
 
+		void startImpedanceRun(int capRange, int zcheckChannel);
+
+		void prepareCorrelation(int numBlocks, double sampleRate, double frequency, int numPeriods);
+
 		void measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
 			std::vector<std::vector<std::vector<double>>>& measuredPhase,
-			int capIndex, int stream, int chipChannel, int numBlocks,
-			double sampleRate, double frequency, int numPeriods);
+			int capIndex, int stream, int chipChannel);
 
 		void amplitudeOfFreqComponent(double& realComponent, double& imagComponent,
-			const std::vector<double>& data, int startIndex,
-			int endIndex, double sampleRate, double frequency);
+			const double* data);
 
 		void factorOutParallelCapacitance(double& impedanceMagnitude, double& impedancePhase,
 			double frequency, double parasiticCapacitance);
@@ -306,11 +389,21 @@ namespace RhythmNode
 			double boardSampleRate);
 
 		float updateImpedanceFrequency(float desiredImpedanceFreq, bool& impedanceFreqValid);
-		int loadAmplifierData(queue<Rhd2000DataBlock>& dataQueue,
-			int numBlocks, int numDataStreams);
+		int loadAmplifierData(int numBlocks, int numDataStreams, int channel);
+
+		/** Blocks the board decodes each run into, kept between runs and measurements */
+		std::vector<std::unique_ptr<Rhd2000DataBlock>> dataBlocks;
 
 		std::vector<std::vector<std::vector<double>>> amplifierPreFilter;
 
+		/** Sine and cosine of the test frequency over the measurement window, which
+			starts at sample windowStart of every run */
+		std::vector<double> correlationCos;
+		std::vector<double> correlationSin;
+		int windowStart;
+
+		int currentCapRange;
+
 		ImpedanceData* data;
 		RHD2000Thread* board;
 
@@ -0,0 +1,149 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SyncAligner.h"
+
+using namespace RhythmNode;
+
+SyncAligner::SyncAligner()
+	: syncLine(0), msPerSample(0), numMasterEdges(0), nextMasterEdge(0)
+{
+}
+
+void SyncAligner::reset(int numBoards, int line, float sampleRate)
+{
+	boards.clear();
+	for (int i = 0; i < numBoards; i++)
+		boards.add(new BoardState());
+
+	syncLine = line;
+	msPerSample = sampleRate > 0 ? 1000.0 / sampleRate : 0;
+
+	const SpinLock::ScopedLockType lock(masterLock);
+	numMasterEdges = 0;
+	nextMasterEdge = 0;
+}
+
+void SyncAligner::processBlock(int board, int64* timestamps, const uint64* eventWords, int numFrames)
+{
+	BoardState* state = boards[board];
+	if (state == nullptr || numFrames <= 0)
+		return;
+
+	// the last frame of the block has just arrived; earlier frames arrived one sample period apart
+	const double nowMs = Time::getMillisecondCounterHiRes();
+	const uint64 mask = uint64(1) << syncLine;
+
+	for (int i = 0; i < numFrames; i++)
+	{
+		bool level = (eventWords[i] & mask) != 0;
+
+		if (level && !state->lastLevel)
+		{
+			Edge edge;
+			edge.sample = timestamps[i];
+			edge.arrivalMs = nowMs - (numFrames - 1 - i) * msPerSample;
+
+			if (board == 0)
+			{
+				const SpinLock::ScopedLockType lock(masterLock);
+				masterEdges[nextMasterEdge] = edge;
+				nextMasterEdge = (nextMasterEdge + 1) % SYNC_ALIGNER_HISTORY;
+				numMasterEdges = jmin(numMasterEdges + 1, SYNC_ALIGNER_HISTORY);
+			}
+			else
+			{
+				matchEdge(*state, edge);
+			}
+		}
+		state->lastLevel = level;
+	}
+
+	if (board == 0 || !state->aligned.load(std::memory_order_relaxed))
+		return;
+
+	for (int i = 0; i < numFrames; i++)
+		timestamps[i] = state->masterRef + llround((timestamps[i] - state->ref) * state->rate);
+}
+
+bool SyncAligner::findMasterEdge(double arrivalMs, int64& masterSample)
+{
+	const SpinLock::ScopedLockType lock(masterLock);
+
+	double bestDistance = SYNC_MATCH_WINDOW_MS;
+	bool found = false;
+
+	for (int i = 0; i < numMasterEdges; i++)
+	{
+		double distance = std::abs(masterEdges[i].arrivalMs - arrivalMs);
+		if (distance < bestDistance)
+		{
+			bestDistance = distance;
+			masterSample = masterEdges[i].sample;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void SyncAligner::matchEdge(BoardState& state, const Edge& edge)
+{
+	int64 masterSample;
+
+	// the master may deliver the same edge a little later; the next edge is matched then
+	if (!findMasterEdge(edge.arrivalMs, masterSample))
+		return;
+
+	if (state.hasEdge && edge.sample > state.ref)
+	{
+		double rate = double(masterSample - state.masterRef) / double(edge.sample - state.ref);
+		state.rate = std::abs(rate - 1.0) <= SYNC_MAX_RATE_ERROR ? rate : 1.0;
+	}
+
+	state.ref = edge.sample;
+	state.masterRef = masterSample;
+	state.hasEdge = true;
+
+	state.offset.store(masterSample - edge.sample, std::memory_order_relaxed);
+	state.aligned.store(true, std::memory_order_relaxed);
+}
+
+bool SyncAligner::isAligned(int board) const
+{
+	if (board == 0)
+		return true;
+
+	BoardState* state = boards[board];
+	return state != nullptr && state->aligned.load(std::memory_order_relaxed);
+}
+
+int64 SyncAligner::getOffset(int board) const
+{
+	BoardState* state = boards[board];
+	return state != nullptr ? state->offset.load(std::memory_order_relaxed) : 0;
+}
+
+double SyncAligner::getRate(int board) const
+{
+	BoardState* state = boards[board];
+	return state != nullptr ? state->rate : 1.0;
+}
@@ -0,0 +1,113 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SYNCALIGNER_H__
+#define __SYNCALIGNER_H__
+
+#include <DataThreadHeaders.h>
+
+/** Master edges kept for matching the edges of the other boards */
+#define SYNC_ALIGNER_HISTORY 8
+/** Largest difference between the arrival times of the same sync edge on two boards. Sync
+    pulses must be further apart than twice this, e.g. a 1 Hz clock divider output */
+#define SYNC_MATCH_WINDOW_MS 50.0
+/** Largest clock rate difference accepted between two boards */
+#define SYNC_MAX_RATE_ERROR 0.001
+
+namespace RhythmNode
+{
+	/**
+		Aligns the sample numbers of several boards that see the same sync TTL, so that the
+		streams of all boards carry the sample numbers of the master board (board 0).
+
+		Every board reports the timestamps and TTL words of each block it decodes. The rising
+		edges of the sync line on the master are kept with their arrival time; an edge on another
+		board is matched with the master edge that arrived at about the same time, and the pair
+		sets the offset and rate mapping that board's samples onto the master's. Until a board
+		has seen its first matched edge, its blocks keep their own sample numbers.
+
+		processBlock() is called from the acquisition thread of each board. The state of a board
+		is only touched by its own thread; the master edges are guarded by a spin lock.
+
+		@see MultiBoardThread
+	*/
+	class SyncAligner
+	{
+	public:
+		SyncAligner();
+
+		/** Clears the edges and mappings, for numBoards boards sampling at sampleRate, whose sync
+			input is TTL line syncLine */
+		void reset(int numBoards, int syncLine, float sampleRate);
+
+		/** Records the sync edges of a block of a board and, on the other boards than the master,
+			rewrites its timestamps to master sample numbers */
+		void processBlock(int board, int64* timestamps, const uint64* eventWords, int numFrames);
+
+		/** True once the board has been matched with the master */
+		bool isAligned(int board) const;
+
+		/** Master sample number minus board sample number at the last matched edge */
+		int64 getOffset(int board) const;
+
+		/** Master samples per board sample */
+		double getRate(int board) const;
+
+	private:
+		struct Edge
+		{
+			int64 sample;
+			double arrivalMs;
+		};
+
+		struct BoardState
+		{
+			bool lastLevel{ false };
+			bool hasEdge{ false };
+
+			// master sample = masterRef + (sample - ref) * rate
+			int64 ref{ 0 };
+			int64 masterRef{ 0 };
+			double rate{ 1.0 };
+			std::atomic<bool> aligned{ false };
+			std::atomic<int64> offset{ 0 };
+		};
+
+		/** Finds the master edge that arrived within SYNC_MATCH_WINDOW_MS of arrivalMs */
+		bool findMasterEdge(double arrivalMs, int64& masterSample);
+
+		void matchEdge(BoardState& state, const Edge& edge);
+
+		OwnedArray<BoardState> boards;
+		int syncLine;
+		double msPerSample;
+
+		Edge masterEdges[SYNC_ALIGNER_HISTORY];
+		int numMasterEdges;
+		int nextMasterEdge;
+		SpinLock masterLock;
+
+		JUCE_DECLARE_NON_COPYABLE(SyncAligner);
+	};
+}
+
+#endif
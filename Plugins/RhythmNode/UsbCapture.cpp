@@ -0,0 +1,235 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "UsbCapture.h"
+#include "rhythm-api/rhd2000datablock.h"
+
+using namespace RhythmNode;
+
+/** Offset of the sample timestamp in a USB frame, past the header */
+#define USB_FRAME_TIMESTAMP_OFFSET 8
+
+bool UsbCaptureWriter::open(const File& file, bool usb3, int sampleRateIndex, const Array<int>& headstageChipIds, int numStreams)
+{
+	close();
+	file.deleteFile();
+
+	// large writes, so that the acquisition thread rarely waits on the disk
+	stream = new FileOutputStream(file, 1 << 20);
+	if (stream->failedToOpen())
+	{
+		std::cerr << "Could not create USB capture " << file.getFullPathName() << std::endl;
+		stream = nullptr;
+		return false;
+	}
+
+	stream->write(USB_CAPTURE_MAGIC, 8);
+	stream->writeInt(usb3 ? 1 : 0);
+	stream->writeInt(sampleRateIndex);
+	stream->writeInt(numStreams);
+	for (int hs = 0; hs < USB_CAPTURE_HEADSTAGES; hs++)
+		stream->writeInt(headstageChipIds[hs]);
+
+	bytesWritten = 0;
+	std::cout << "Capturing raw USB data to " << file.getFullPathName() << std::endl;
+	return true;
+}
+
+void UsbCaptureWriter::close()
+{
+	if (stream != nullptr)
+	{
+		stream->flush();
+		std::cout << "USB capture closed after " << bytesWritten << " bytes" << std::endl;
+	}
+	stream = nullptr;
+}
+
+void UsbCaptureWriter::write(const unsigned char* data, int64 numBytes)
+{
+	if (stream != nullptr && stream->write(data, (size_t) numBytes))
+		bytesWritten += numBytes;
+}
+
+int64 UsbCaptureWriter::getBytesWritten() const
+{
+	return bytesWritten;
+}
+
+UsbCaptureReplay::UsbCaptureReplay()
+	: frames(nullptr), numFrameBytes(0), frameBytes(0), usb3(false), sampleRateIndex(0), numStreams(0),
+	timestampSpan(0), running(false), realTime(true), bytesPerMs(0), startMs(0), bytesRead(0)
+{
+}
+
+bool UsbCaptureReplay::open(const File& captureFile)
+{
+	const int headerBytes = 8 + 4 * (3 + USB_CAPTURE_HEADSTAGES);
+
+	file = new MemoryMappedFile(captureFile, MemoryMappedFile::readOnly);
+	const unsigned char* data = static_cast<const unsigned char*>(file->getData());
+
+	if (data == nullptr || file->getSize() < headerBytes || memcmp(data, USB_CAPTURE_MAGIC, 8) != 0)
+	{
+		std::cerr << captureFile.getFullPathName() << " is not a USB capture" << std::endl;
+		file = nullptr;
+		return false;
+	}
+
+	usb3 = ByteOrder::littleEndianInt(data + 8) != 0;
+	sampleRateIndex = (int) ByteOrder::littleEndianInt(data + 12);
+	numStreams = (int) ByteOrder::littleEndianInt(data + 16);
+	headstageChipIds.clear();
+	for (int hs = 0; hs < USB_CAPTURE_HEADSTAGES; hs++)
+		headstageChipIds.add((int) ByteOrder::littleEndianInt(data + 20 + 4 * hs));
+
+	frameBytes = 2 * (int) Rhd2000DataBlock::calculateDataBlockSizeInWords(numStreams, usb3, 1);
+	frames = data + headerBytes;
+	numFrameBytes = (((int64) file->getSize() - headerBytes) / frameBytes) * frameBytes;
+
+	if (numFrameBytes == 0)
+	{
+		std::cerr << captureFile.getFullPathName() << " holds no complete frame" << std::endl;
+		file = nullptr;
+		return false;
+	}
+
+	// each loop carries on counting from the sample after the last one of the capture
+	uint32 firstTimestamp = ByteOrder::littleEndianInt(frames + USB_FRAME_TIMESTAMP_OFFSET);
+	uint32 lastTimestamp = ByteOrder::littleEndianInt(frames + numFrameBytes - frameBytes + USB_FRAME_TIMESTAMP_OFFSET);
+	timestampSpan = lastTimestamp - firstTimestamp + 1;
+
+	std::cout << "Replaying " << numFrameBytes / frameBytes << " frames of " << numStreams << " streams from "
+		<< captureFile.getFullPathName() << std::endl;
+	return true;
+}
+
+bool UsbCaptureReplay::isUSB3() const
+{
+	return usb3;
+}
+
+int UsbCaptureReplay::getSampleRateIndex() const
+{
+	return sampleRateIndex;
+}
+
+int UsbCaptureReplay::getNumStreams() const
+{
+	return numStreams;
+}
+
+const Array<int>& UsbCaptureReplay::getHeadstageChipIds() const
+{
+	return headstageChipIds;
+}
+
+void UsbCaptureReplay::start(double sampleRate, bool replayRealTime)
+{
+	realTime = replayRealTime;
+	bytesPerMs = sampleRate * frameBytes / 1000.0;
+	bytesRead = 0;
+	startMs = Time::getMillisecondCounterHiRes();
+	running = true;
+}
+
+void UsbCaptureReplay::stop()
+{
+	running = false;
+}
+
+int64 UsbCaptureReplay::getBytesDue() const
+{
+	return (int64) ((Time::getMillisecondCounterHiRes() - startMs) * bytesPerMs);
+}
+
+unsigned int UsbCaptureReplay::numWordsAvailable()
+{
+	if (!running)
+		return 0;
+
+	if (!realTime)
+		return FIFO_CAPACITY_WORDS;
+
+	return (unsigned int) jlimit((int64) 0, (int64) FIFO_CAPACITY_WORDS, (getBytesDue() - bytesRead) / 2);
+}
+
+void UsbCaptureReplay::readData(unsigned char* data, long length)
+{
+	if (!running)
+	{
+		memset(data, 0, length);
+		return;
+	}
+
+	// a USB3 board holds the read until the data is there
+	if (realTime)
+	{
+		Thread* thread = Thread::getCurrentThread();
+
+		while (getBytesDue() < bytesRead + length)
+		{
+			if (thread != nullptr && thread->threadShouldExit())
+			{
+				memset(data, 0, length);
+				return;
+			}
+			Thread::sleep(1);
+		}
+	}
+
+	copyFrames(data, bytesRead, length);
+	bytesRead += length;
+}
+
+void UsbCaptureReplay::copyFrames(unsigned char* data, int64 position, int64 numBytes)
+{
+	while (numBytes > 0)
+	{
+		int64 loop = position / numFrameBytes;
+		int64 offset = position % numFrameBytes;
+		int64 chunk = jmin(numBytes, numFrameBytes - offset);
+
+		memcpy(data, frames + offset, (size_t) chunk);
+
+		if (loop > 0)
+		{
+			uint32 shift = (uint32) (loop * timestampSpan);
+
+			// the timestamps of the frames that start within the chunk
+			for (int64 frame = (offset + frameBytes - 1) / frameBytes * frameBytes; frame + USB_FRAME_TIMESTAMP_OFFSET + 4 <= offset + chunk; frame += frameBytes)
+			{
+				unsigned char* timestamp = data + (frame - offset) + USB_FRAME_TIMESTAMP_OFFSET;
+				uint32 value = ByteOrder::littleEndianInt(timestamp) + shift;
+				timestamp[0] = (unsigned char) value;
+				timestamp[1] = (unsigned char) (value >> 8);
+				timestamp[2] = (unsigned char) (value >> 16);
+				timestamp[3] = (unsigned char) (value >> 24);
+			}
+		}
+
+		data += chunk;
+		position += chunk;
+		numBytes -= chunk;
+	}
+}
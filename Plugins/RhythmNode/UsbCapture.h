@@ -0,0 +1,123 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __USBCAPTURE_H__
+#define __USBCAPTURE_H__
+
+#include <DataThreadHeaders.h>
+
+#include "rhythm-api/rhd2000evalboard.h"
+
+/** First bytes of a capture file */
+#define USB_CAPTURE_MAGIC "RHDUSB01"
+/** Headstage chip IDs stored in the header of a capture, one per headstage */
+#define USB_CAPTURE_HEADSTAGES 8
+
+namespace RhythmNode
+{
+	/**
+		Writes the raw USB data an RHD2000 board sends during acquisition to a file, so that it
+		can be replayed through UsbCaptureReplay without the board.
+
+		The file starts with a header holding the board's USB mode, sample rate and the chip ID
+		of each headstage, followed by the frames exactly as readRawDataBlock() returned them.
+
+		@see UsbCaptureReplay
+	*/
+	class UsbCaptureWriter
+	{
+	public:
+		/** Creates the file, replacing any existing one, and writes the header. Returns false if
+			the file could not be written */
+		bool open(const File& file, bool usb3, int sampleRateIndex, const Array<int>& headstageChipIds, int numStreams);
+		void close();
+
+		/** Appends raw USB data. Called from the acquisition thread */
+		void write(const unsigned char* data, int64 numBytes);
+
+		int64 getBytesWritten() const;
+
+	private:
+		ScopedPointer<FileOutputStream> stream;
+		int64 bytesWritten{ 0 };
+	};
+
+	/**
+		An RHD2000 board emulated from a capture written by UsbCaptureWriter.
+
+		Once started, the capture is streamed in a loop as the board would: the emulated FIFO
+		fills at the sample rate of the capture, or is always full when replaying as fast as the
+		data is read, so that the whole decode path can be profiled on any machine. The
+		timestamps of each loop continue from the end of the previous one.
+
+		@see Rhd2000EvalBoard::openEmulated()
+	*/
+	class UsbCaptureReplay : public Rhd2000UsbSource
+	{
+	public:
+		UsbCaptureReplay();
+
+		/** Maps a capture and reads its header. Returns false if it is not a valid capture */
+		bool open(const File& file);
+
+		bool isUSB3() const;
+		int getSampleRateIndex() const;
+		int getNumStreams() const;
+		const Array<int>& getHeadstageChipIds() const;
+
+		/** Streams from the first frame of the capture, at sampleRate frames per second,
+			or as fast as it is read when realTime is false */
+		void start(double sampleRate, bool realTime);
+		void stop();
+
+		unsigned int numWordsAvailable() override;
+		void readData(unsigned char* data, long length) override;
+
+	private:
+		/** Bytes of the capture that are due since start() */
+		int64 getBytesDue() const;
+
+		/** Copies bytes of the loop starting at position into data, shifting the frame timestamps
+			by the loops streamed before */
+		void copyFrames(unsigned char* data, int64 position, int64 numBytes);
+
+		ScopedPointer<MemoryMappedFile> file;
+		const unsigned char* frames;
+		int64 numFrameBytes;
+		int frameBytes;
+
+		bool usb3;
+		int sampleRateIndex;
+		int numStreams;
+		Array<int> headstageChipIds;
+		uint32 timestampSpan;
+
+		std::atomic<bool> running;
+		bool realTime;
+		double bytesPerMs;
+		double startMs;
+		int64 bytesRead;
+	};
+}
+
+#endif
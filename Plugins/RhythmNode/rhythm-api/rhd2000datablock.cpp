@@ -31,10 +31,10 @@ using namespace std;
 // from a Rhythm FPGA interface controlling up to eight RHD2000 chips.
 
 // Constructor.  Allocates memory for data block.
-Rhd2000DataBlock::Rhd2000DataBlock(int numDataStreams, bool usb3) : samplesPerBlock(SAMPLES_PER_DATA_BLOCK(usb3)), usb3(usb3)
+Rhd2000DataBlock::Rhd2000DataBlock(int numDataStreams, bool usb3) : samplesPerBlock(SAMPLES_PER_DATA_BLOCK(usb3)), usb3(usb3), numDataStreams(numDataStreams)
 {
     allocateUIntArray1D(timeStamp, samplesPerBlock);
-    allocateIntArray3D(amplifierData, numDataStreams, 32, samplesPerBlock);
+    allocateIntArray1D(amplifierData, numDataStreams * 32 * samplesPerBlock);
     allocateIntArray3D(auxiliaryData, numDataStreams, 3, samplesPerBlock);
     allocateIntArray2D(boardAdcData, 8, samplesPerBlock);
     allocateIntArray1D(ttlIn, samplesPerBlock);
@@ -167,8 +167,9 @@ void Rhd2000DataBlock::fillFromUsbBuffer(unsigned char usbBuffer[], int blockInd
 
         // Read amplifier channels
         for (channel = 0; channel < 32; ++channel) {
+            int* amp = amplifierData.data() + amplifierIndex(0, channel, t);
             for (stream = 0; stream < numDataStreams; ++stream) {
-                amplifierData[stream][channel][t] = convertUsbWord(usbBuffer, index);
+                amp[stream * 32 * samplesPerBlock] = convertUsbWord(usbBuffer, index);
                 index += 2;
             }
         }
@@ -372,7 +373,7 @@ void Rhd2000DataBlock::write(ofstream &saveOut, int numDataStreams) const
         writeWordLittleEndian(saveOut, timeStamp[t]);
         for (channel = 0; channel < 32; ++channel) {
             for (stream = 0; stream < numDataStreams; ++stream) {
-                writeWordLittleEndian(saveOut, amplifierData[stream][channel][t]);
+                writeWordLittleEndian(saveOut, amplifierData[amplifierIndex(stream, channel, t)]);
             }
         }
         for (channel = 0; channel < 3; ++channel) {
@@ -37,7 +37,7 @@ public:
     Rhd2000DataBlock(int numDataStreams, bool usb3);
 
     vector<unsigned int> timeStamp;
-    vector<vector<vector<int> > > amplifierData;
+    vector<int> amplifierData;  // all samples of a channel are contiguous, see amplifierIndex()
     vector<vector<vector<int> > > auxiliaryData;
     vector<vector<int> > boardAdcData;
     vector<int> ttlIn;
@@ -53,6 +53,12 @@ public:
     static unsigned int convertUsbTimeStamp(unsigned char usbBuffer[], int index);
     static int convertUsbWord(unsigned char usbBuffer[], int index);
 
+    int getNumDataStreams() const { return numDataStreams; }
+    inline int amplifierIndex(int stream, int channel, int t) const
+    {
+        return (stream * 32 + channel) * samplesPerBlock + t;
+    }
+
 private:
     void allocateIntArray3D(vector<vector<vector<int> > > &array3D, int xSize, int ySize, int zSize);
     void allocateIntArray2D(vector<vector<int> > &array2D, int xSize, int ySize);
@@ -64,6 +70,7 @@ private:
 
     const unsigned int samplesPerBlock;
     bool usb3;
+    const int numDataStreams;
 };
 
 #endif // RHD2000DATABLOCK_H
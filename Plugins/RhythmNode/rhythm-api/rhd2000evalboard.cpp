@@ -33,6 +33,76 @@
 using namespace std;
 using namespace OpalKellyLegacy;
 
+class Rhd2000EvalBoard::BoardIO
+{
+public:
+    virtual ~BoardIO() {}
+
+    virtual void setWireInValue(int ep, unsigned int val, unsigned int mask = 0xffffffff) = 0;
+    virtual void updateWireIns() = 0;
+    virtual void updateWireOuts() = 0;
+    virtual unsigned long getWireOutValue(int ep) = 0;
+    virtual void activateTriggerIn(int ep, int bit) = 0;
+    virtual long readFromPipeOut(int ep, long length, unsigned char *data) = 0;
+    virtual long readFromBlockPipeOut(int ep, int blockSize, long length, unsigned char *data) = 0;
+    virtual void resetFpga() = 0;
+};
+
+// Transfers with an Opal Kelly board opened through FrontPanel
+class Rhd2000EvalBoard::FrontPanelIO : public Rhd2000EvalBoard::BoardIO
+{
+public:
+    FrontPanelIO(okCFrontPanel *device) : dev(device) {}
+
+    void setWireInValue(int ep, unsigned int val, unsigned int mask) { dev->SetWireInValue(ep, val, mask); }
+    void updateWireIns() { dev->UpdateWireIns(); }
+    void updateWireOuts() { dev->UpdateWireOuts(); }
+    unsigned long getWireOutValue(int ep) { return dev->GetWireOutValue(ep); }
+    void activateTriggerIn(int ep, int bit) { dev->ActivateTriggerIn(ep, bit); }
+    long readFromPipeOut(int ep, long length, unsigned char *data) { return dev->ReadFromPipeOut(ep, length, data); }
+    long readFromBlockPipeOut(int ep, int blockSize, long length, unsigned char *data) { return dev->ReadFromBlockPipeOut(ep, blockSize, length, data); }
+    void resetFpga() { dev->ResetFPGA(); }
+
+private:
+    okCFrontPanel *dev;
+};
+
+// A board that is always idle with its clock locked, whose FIFO and data pipe are fed by a
+// Rhd2000UsbSource.  Writes to the board are dropped.
+class Rhd2000EvalBoard::EmulatedIO : public Rhd2000EvalBoard::BoardIO
+{
+public:
+    EmulatedIO(Rhd2000UsbSource *usbSource, bool isUsb3) : source(usbSource), usb3(isUsb3), numWords(0) {}
+
+    void setWireInValue(int, unsigned int, unsigned int) {}
+    void updateWireIns() {}
+    void updateWireOuts() { numWords = source->numWordsAvailable(); }
+    unsigned long getWireOutValue(int ep)
+    {
+        switch (ep) {
+        case WireOutNumWordsLsb:
+            return numWords & 0xffff;
+        case WireOutNumWordsMsb:
+            return numWords >> 16;
+        case WireOutDataClkLocked:
+            return 0x03; // DCM programming done, data clock locked
+        case WireOutBoardId:
+            return usb3 ? RHYTHM_BOARD_ID_USB3 : RHYTHM_BOARD_ID_USB2;
+        default:
+            return 0;
+        }
+    }
+    void activateTriggerIn(int, int) {}
+    long readFromPipeOut(int, long length, unsigned char *data) { source->readData(data, length); return length; }
+    long readFromBlockPipeOut(int, int, long length, unsigned char *data) { source->readData(data, length); return length; }
+    void resetFpga() {}
+
+private:
+    Rhd2000UsbSource *source;
+    bool usb3;
+    unsigned int numWords;
+};
+
 // This class provides access to and control of the Opal Kelly XEM6010 USB/FPGA
 // interface board running the Rhythm interface Verilog code.
 
@@ -43,6 +113,7 @@ Rhd2000EvalBoard::Rhd2000EvalBoard()
     sampleRate = SampleRate30000Hz; // Rhythm FPGA boots up with 30.0 kS/s/channel sampling rate
     numDataStreams = 0;
     dev = 0;
+    io = 0;
     usb3 = false;
 
     for (i = 0; i < MAX_NUM_DATA_STREAMS_USB3; ++i) {
@@ -55,6 +126,7 @@ Rhd2000EvalBoard::Rhd2000EvalBoard()
 //Destructor: Deletes the device to avoid memory leak in Open ephys
 Rhd2000EvalBoard::~Rhd2000EvalBoard()
 {
+    if (io != 0) delete io;
     if (dev != 0) delete dev;
 }
 
@@ -112,6 +184,7 @@ int Rhd2000EvalBoard::open(const char* libname)
 		cerr << "No device could be opened.  Is one connected?" << endl;
 		return -2;
 	}
+    io = new FrontPanelIO(dev);
 
     // Configure the on-board PLL appropriately.
     dev->LoadDefaultPLLConfiguration();
@@ -126,6 +199,21 @@ int Rhd2000EvalBoard::open(const char* libname)
     return 1;
 }
 
+// Open-ephys addition: emulates an opened board with an uploaded Rhythm bitfile, whose data
+// comes from source.  Returns 1.
+int Rhd2000EvalBoard::openEmulated(Rhd2000UsbSource* source, bool isUsb3)
+{
+    if (io != 0) delete io;
+    if (dev != 0) delete dev;
+    dev = 0;
+
+    usb3 = isUsb3;
+    io = new EmulatedIO(source, usb3);
+
+    cout << "Emulating a Rhythm " << (usb3 ? "USB3" : "USB2") << " board" << endl << endl;
+    return 1;
+}
+
 // Uploads the configuration file (bitfile) to the FPGA.  Returns true if successful.
 bool Rhd2000EvalBoard::uploadFpgaBitfile(string filename)
 {
@@ -163,15 +251,17 @@ bool Rhd2000EvalBoard::uploadFpgaBitfile(string filename)
     // Check for Opal Kelly FrontPanel support in the FPGA configuration.
     if (dev->IsFrontPanelEnabled() == false) {
         cerr << "Opal Kelly FrontPanel support is not enabled in this FPGA configuration." << endl;
+        delete io;
+        io = 0;
         delete dev;
         dev = 0;
         return(false);
     }
 
     int boardId, boardVersion;
-    dev->UpdateWireOuts();
-    boardId = dev->GetWireOutValue(WireOutBoardId);
-    boardVersion = dev->GetWireOutValue(WireOutBoardVersion);
+    io->updateWireOuts();
+    boardId = io->getWireOutValue(WireOutBoardId);
+    boardVersion = io->getWireOutValue(WireOutBoardVersion);
 
     if (boardId != (usb3 ? RHYTHM_BOARD_ID_USB3 : RHYTHM_BOARD_ID_USB2)) {
         cerr << "FPGA configuration does not support Rhythm.  Incorrect board ID: " << boardId << endl;
@@ -448,9 +538,9 @@ bool Rhd2000EvalBoard::setSampleRate(AmplifierSampleRate newSampleRate)
     while (isDcmProgDone() == false) {}
 
     // Reprogram clock synthesizer
-    dev->SetWireInValue(WireInDataFreqPll, (256 * M + D));
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInDcmProg, 0);
+    io->setWireInValue(WireInDataFreqPll, (256 * M + D));
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInDcmProg, 0);
 
     // Wait for DataClkLocked = 1 before allowing data acquisition to continue
     while (isDataClockLocked() == false) {}
@@ -576,19 +666,19 @@ void Rhd2000EvalBoard::uploadCommandList(const vector<int> &commandList, AuxCmdS
     }
 
     for (i = 0; i < commandList.size(); ++i) {
-        dev->SetWireInValue(WireInCmdRamData, commandList[i]);
-        dev->SetWireInValue(WireInCmdRamAddr, i);
-        dev->SetWireInValue(WireInCmdRamBank, bank);
-        dev->UpdateWireIns();
+        io->setWireInValue(WireInCmdRamData, commandList[i]);
+        io->setWireInValue(WireInCmdRamAddr, i);
+        io->setWireInValue(WireInCmdRamBank, bank);
+        io->updateWireIns();
         switch (auxCommandSlot) {
             case AuxCmd1:
-                dev->ActivateTriggerIn(TrigInRamWrite, 0);
+                io->activateTriggerIn(TrigInRamWrite, 0);
                 break;
             case AuxCmd2:
-                dev->ActivateTriggerIn(TrigInRamWrite, 1);
+                io->activateTriggerIn(TrigInRamWrite, 1);
                 break;
             case AuxCmd3:
-                dev->ActivateTriggerIn(TrigInRamWrite, 2);
+                io->activateTriggerIn(TrigInRamWrite, 2);
                 break;
         }
     }
@@ -626,16 +716,16 @@ void Rhd2000EvalBoard::selectAuxCommandBank(BoardPort port, AuxCmdSlot auxComman
 
     switch (auxCommandSlot) {
     case AuxCmd1:
-        dev->SetWireInValue(WireInAuxCmdBank1, bank << bitShift, 0x000f << bitShift);
+        io->setWireInValue(WireInAuxCmdBank1, bank << bitShift, 0x000f << bitShift);
         break;
     case AuxCmd2:
-        dev->SetWireInValue(WireInAuxCmdBank2, bank << bitShift, 0x000f << bitShift);
+        io->setWireInValue(WireInAuxCmdBank2, bank << bitShift, 0x000f << bitShift);
         break;
     case AuxCmd3:
-        dev->SetWireInValue(WireInAuxCmdBank3, bank << bitShift, 0x000f << bitShift);
+        io->setWireInValue(WireInAuxCmdBank3, bank << bitShift, 0x000f << bitShift);
         break;
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Specify a command sequence length (endIndex = 0-1023) and command loop index (0-1023) for a particular
@@ -659,38 +749,38 @@ void Rhd2000EvalBoard::selectAuxCommandLength(AuxCmdSlot auxCommandSlot, int loo
 
     switch (auxCommandSlot) {
     case AuxCmd1:
-        dev->SetWireInValue(WireInAuxCmdLoop1, loopIndex);
-        dev->SetWireInValue(WireInAuxCmdLength1, endIndex);
+        io->setWireInValue(WireInAuxCmdLoop1, loopIndex);
+        io->setWireInValue(WireInAuxCmdLength1, endIndex);
         break;
     case AuxCmd2:
-        dev->SetWireInValue(WireInAuxCmdLoop2, loopIndex);
-        dev->SetWireInValue(WireInAuxCmdLength2, endIndex);
+        io->setWireInValue(WireInAuxCmdLoop2, loopIndex);
+        io->setWireInValue(WireInAuxCmdLength2, endIndex);
         break;
     case AuxCmd3:
-        dev->SetWireInValue(WireInAuxCmdLoop3, loopIndex);
-        dev->SetWireInValue(WireInAuxCmdLength3, endIndex);
+        io->setWireInValue(WireInAuxCmdLoop3, loopIndex);
+        io->setWireInValue(WireInAuxCmdLength3, endIndex);
         break;
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Reset FPGA.  This clears all auxiliary command RAM banks, clears the USB FIFO, and resets the
 // per-channel sampling rate to 30.0 kS/s/ch.
 void Rhd2000EvalBoard::resetBoard()
 {
-    dev->SetWireInValue(WireInResetRun, 0x01, 0x01);
-    dev->UpdateWireIns();
-    dev->SetWireInValue(WireInResetRun, 0x00, 0x01);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInResetRun, 0x01, 0x01);
+    io->updateWireIns();
+    io->setWireInValue(WireInResetRun, 0x00, 0x01);
+    io->updateWireIns();
     if (usb3)
     {
-        dev->SetWireInValue(WireInMultiUse, USB3_BLOCK_SIZE / 4);
-        dev->UpdateWireIns();
-        dev->ActivateTriggerIn(TrigInOpenEphys, 16);
+        io->setWireInValue(WireInMultiUse, USB3_BLOCK_SIZE / 4);
+        io->updateWireIns();
+        io->activateTriggerIn(TrigInOpenEphys, 16);
         cout << "Blocksize set to " << USB3_BLOCK_SIZE << endl;
-        dev->SetWireInValue(WireInMultiUse, DDR_BLOCK_SIZE);
-        dev->UpdateWireIns();
-        dev->ActivateTriggerIn(TrigInOpenEphys, 17);
+        io->setWireInValue(WireInMultiUse, DDR_BLOCK_SIZE);
+        io->updateWireIns();
+        io->activateTriggerIn(TrigInOpenEphys, 17);
         cout << "DDR burst set to " << DDR_BLOCK_SIZE << endl;
     }
 }
@@ -700,11 +790,11 @@ void Rhd2000EvalBoard::resetBoard()
 void Rhd2000EvalBoard::setContinuousRunMode(bool continuousMode)
 {
     if (continuousMode) {
-        dev->SetWireInValue(WireInResetRun, 0x02, 0x02);
+        io->setWireInValue(WireInResetRun, 0x02, 0x02);
     } else {
-        dev->SetWireInValue(WireInResetRun, 0x00, 0x02);
+        io->setWireInValue(WireInResetRun, 0x00, 0x02);
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Set maxTimeStep for cases where continuousMode == false.
@@ -715,9 +805,9 @@ void Rhd2000EvalBoard::setMaxTimeStep(unsigned int maxTimeStep)
     maxTimeStepLsb = maxTimeStep & 0x0000ffff;
     maxTimeStepMsb = maxTimeStep & 0xffff0000;
 
-    dev->SetWireInValue(WireInMaxTimeStepLsb, maxTimeStepLsb);
-    dev->SetWireInValue(WireInMaxTimeStepMsb, maxTimeStepMsb >> 16);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInMaxTimeStepLsb, maxTimeStepLsb);
+    io->setWireInValue(WireInMaxTimeStepMsb, maxTimeStepMsb >> 16);
+    io->updateWireIns();
 
 
 }
@@ -725,10 +815,10 @@ void Rhd2000EvalBoard::setMaxTimeStep(unsigned int maxTimeStep)
 // Initiate SPI data acquisition.
 void Rhd2000EvalBoard::run()
 {
-    dev->UpdateWireOuts();
-//  std::cout << "Block size: " << dev->GetWireOutValue(0x26) << std::endl;
-//  std::cout << "Burst len: " << dev->GetWireOutValue(0x27) << std::endl;
-    dev->ActivateTriggerIn(TrigInSpiStart, 0);
+    io->updateWireOuts();
+//  std::cout << "Block size: " << io->getWireOutValue(0x26) << std::endl;
+//  std::cout << "Burst len: " << io->getWireOutValue(0x27) << std::endl;
+    io->activateTriggerIn(TrigInSpiStart, 0);
 }
 
 // Is the FPGA currently running?
@@ -736,8 +826,8 @@ bool Rhd2000EvalBoard::isRunning() const
 {
     int value;
 
-    dev->UpdateWireOuts();
-    value = dev->GetWireOutValue(WireOutSpiRunning);
+    io->updateWireOuts();
+    value = io->getWireOutValue(WireOutSpiRunning);
 
     if ((value & 0x01) == 0) {
         return false;
@@ -750,8 +840,8 @@ bool Rhd2000EvalBoard::isRunning() const
 // more data than the FIFO currently contains, as it is not protected against underflow.
 unsigned int Rhd2000EvalBoard::numWordsInFifo() const
 {
-    dev->UpdateWireOuts();
-    return (dev->GetWireOutValue(WireOutNumWordsMsb) << 16) + dev->GetWireOutValue(WireOutNumWordsLsb);
+    io->updateWireOuts();
+    return (io->getWireOutValue(WireOutNumWordsMsb) << 16) + io->getWireOutValue(WireOutNumWordsLsb);
 }
 
 // Returns the number of 16-bit words the USB SDRAM FIFO can hold.  The FIFO can actually hold a few
@@ -798,8 +888,8 @@ void Rhd2000EvalBoard::setCableDelay(BoardPort port, int delay)
         cerr << "Error in RHD2000EvalBoard::setCableDelay: unknown port." << endl;
     }
 
-    dev->SetWireInValue(WireInMisoDelay, delay << bitShift, 0x000f << bitShift);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInMisoDelay, delay << bitShift, 0x000f << bitShift);
+    io->updateWireIns();
 }
 
 // Set the delay for sampling the MISO line on a particular SPI port (PortA - PortD) based on the length
@@ -866,8 +956,8 @@ double Rhd2000EvalBoard::estimateCableLengthFeet(int delay) const
 // Turn on or off DSP settle function in the FPGA.  (Only executes when CONVERT commands are sent.)
 void Rhd2000EvalBoard::setDspSettle(bool enabled)
 {
-    dev->SetWireInValue(WireInResetRun, (enabled ? 0x04 : 0x00), 0x04);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInResetRun, (enabled ? 0x04 : 0x00), 0x04);
+    io->updateWireIns();
 }
 
 // Assign a particular data source (e.g., PortA1, PortA2, PortB1,...) to one of the eight
@@ -949,8 +1039,8 @@ void Rhd2000EvalBoard::setDataSource(int stream, BoardDataSource dataSource)
         break;
     }
 
-    dev->SetWireInValue(endPoint, dataSource << bitShift, 0x000f << bitShift);
-    dev->UpdateWireIns();
+    io->setWireInValue(endPoint, dataSource << bitShift, 0x000f << bitShift);
+    io->updateWireIns();
 }
 
 // Enable or disable one of the eight available USB data streams (0-7).
@@ -963,15 +1053,15 @@ void Rhd2000EvalBoard::enableDataStream(int stream, bool enabled)
 
     if (enabled) {
         if (dataStreamEnabled[stream] == 0) {
-            dev->SetWireInValue(WireInDataStreamEn, 0x0001 << stream, 0x0001 << stream);
-            dev->UpdateWireIns();
+            io->setWireInValue(WireInDataStreamEn, 0x0001 << stream, 0x0001 << stream);
+            io->updateWireIns();
             dataStreamEnabled[stream] = 1;
             ++numDataStreams;
         }
     } else {
         if (dataStreamEnabled[stream] == 1) {
-            dev->SetWireInValue(WireInDataStreamEn, 0x0000 << stream, 0x0001 << stream);
-            dev->UpdateWireIns();
+            io->setWireInValue(WireInDataStreamEn, 0x0000 << stream, 0x0001 << stream);
+            io->updateWireIns();
             dataStreamEnabled[stream] = 0;
             numDataStreams--;
         }
@@ -987,8 +1077,8 @@ int Rhd2000EvalBoard::getNumEnabledDataStreams() const
 // Set all 16 bits of the digital TTL output lines on the FPGA to zero.
 void Rhd2000EvalBoard::clearTtlOut()
 {
-    dev->SetWireInValue(WireInTtlOut, 0x0000);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInTtlOut, 0x0000);
+    io->updateWireIns();
 }
 
 // Set the 16 bits of the digital TTL output lines on the FPGA high or low according to integer array.
@@ -1001,8 +1091,8 @@ void Rhd2000EvalBoard::setTtlOut(int ttlOutArray[])
         if (ttlOutArray[i] > 0)
             ttlOut += 1 << i;
     }
-    dev->SetWireInValue(WireInTtlOut, ttlOut);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInTtlOut, ttlOut);
+    io->updateWireIns();
 }
 
 // Read the 16 bits of the digital TTL input lines on the FPGA into an integer array.
@@ -1010,8 +1100,8 @@ void Rhd2000EvalBoard::getTtlIn(int ttlInArray[])
 {
     int i, ttlIn;
 
-    dev->UpdateWireOuts();
-    ttlIn = dev->GetWireOutValue(WireOutTtlIn);
+    io->updateWireOuts();
+    ttlIn = io->getWireOutValue(WireOutTtlIn);
 
     for (i = 0; i < 16; ++i) {
         ttlInArray[i] = 0;
@@ -1028,8 +1118,8 @@ void Rhd2000EvalBoard::setDacManual(int value)
         return;
     }
 
-    dev->SetWireInValue(WireInDacManual, value);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInDacManual, value);
+    io->updateWireIns();
 }
 
 // Set the eight red LEDs on the XEM6010 board according to integer array.
@@ -1042,8 +1132,8 @@ void Rhd2000EvalBoard::setLedDisplay(int ledArray[])
         if (ledArray[i] > 0)
             ledOut += 1 << i;
     }
-    dev->SetWireInValue(WireInLedDisplay, ledOut);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInLedDisplay, ledOut);
+    io->updateWireIns();
 }
 
 // Enable or disable AD5662 DAC channel (0-7)
@@ -1058,31 +1148,31 @@ void Rhd2000EvalBoard::enableDac(int dacChannel, bool enabled)
 
     switch (dacChannel) {
     case 0:
-        dev->SetWireInValue(WireInDacSource1, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource1, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 1:
-        dev->SetWireInValue(WireInDacSource2, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource2, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 2:
-        dev->SetWireInValue(WireInDacSource3, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource3, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 3:
-        dev->SetWireInValue(WireInDacSource4, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource4, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 4:
-        dev->SetWireInValue(WireInDacSource5, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource5, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 5:
-        dev->SetWireInValue(WireInDacSource6, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource6, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 6:
-        dev->SetWireInValue(WireInDacSource7, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource7, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     case 7:
-        dev->SetWireInValue(WireInDacSource8, (enabled ? dacEnMask : 0x0000), dacEnMask);
+        io->setWireInValue(WireInDacSource8, (enabled ? dacEnMask : 0x0000), dacEnMask);
         break;
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Set the gain level of all eight DAC channels to 2^gain (gain = 0-7).
@@ -1093,8 +1183,8 @@ void Rhd2000EvalBoard::setDacGain(int gain)
         return;
     }
 
-    dev->SetWireInValue(WireInResetRun, gain << 13, 0xe000);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInResetRun, gain << 13, 0xe000);
+    io->updateWireIns();
 }
 
 // Suppress the noise on DAC channels 0 and 1 (the audio channels) between
@@ -1106,8 +1196,8 @@ void Rhd2000EvalBoard::setAudioNoiseSuppress(int noiseSuppress)
         return;
     }
 
-    dev->SetWireInValue(WireInResetRun, noiseSuppress << 6, 0x1fc0);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInResetRun, noiseSuppress << 6, 0x1fc0);
+    io->updateWireIns();
 }
 
 // Assign a particular data stream (0-7) to a DAC channel (0-7).  Setting stream
@@ -1128,31 +1218,31 @@ void Rhd2000EvalBoard::selectDacDataStream(int dacChannel, int stream)
 
     switch (dacChannel) {
     case 0:
-        dev->SetWireInValue(WireInDacSource1, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource1, stream << 5, dacStreamMask);
         break;
     case 1:
-        dev->SetWireInValue(WireInDacSource2, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource2, stream << 5, dacStreamMask);
         break;
     case 2:
-        dev->SetWireInValue(WireInDacSource3, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource3, stream << 5, dacStreamMask);
         break;
     case 3:
-        dev->SetWireInValue(WireInDacSource4, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource4, stream << 5, dacStreamMask);
         break;
     case 4:
-        dev->SetWireInValue(WireInDacSource5, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource5, stream << 5, dacStreamMask);
         break;
     case 5:
-        dev->SetWireInValue(WireInDacSource6, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource6, stream << 5, dacStreamMask);
         break;
     case 6:
-        dev->SetWireInValue(WireInDacSource7, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource7, stream << 5, dacStreamMask);
         break;
     case 7:
-        dev->SetWireInValue(WireInDacSource8, stream << 5, dacStreamMask);
+        io->setWireInValue(WireInDacSource8, stream << 5, dacStreamMask);
         break;
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Assign a particular amplifier channel (0-31) to a DAC channel (0-7).
@@ -1170,31 +1260,31 @@ void Rhd2000EvalBoard::selectDacDataChannel(int dacChannel, int dataChannel)
 
     switch (dacChannel) {
     case 0:
-        dev->SetWireInValue(WireInDacSource1, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource1, dataChannel << 0, 0x001f);
         break;
     case 1:
-        dev->SetWireInValue(WireInDacSource2, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource2, dataChannel << 0, 0x001f);
         break;
     case 2:
-        dev->SetWireInValue(WireInDacSource3, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource3, dataChannel << 0, 0x001f);
         break;
     case 3:
-        dev->SetWireInValue(WireInDacSource4, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource4, dataChannel << 0, 0x001f);
         break;
     case 4:
-        dev->SetWireInValue(WireInDacSource5, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource5, dataChannel << 0, 0x001f);
         break;
     case 5:
-        dev->SetWireInValue(WireInDacSource6, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource6, dataChannel << 0, 0x001f);
         break;
     case 6:
-        dev->SetWireInValue(WireInDacSource7, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource7, dataChannel << 0, 0x001f);
         break;
     case 7:
-        dev->SetWireInValue(WireInDacSource8, dataChannel << 0, 0x001f);
+        io->setWireInValue(WireInDacSource8, dataChannel << 0, 0x001f);
         break;
     }
-    dev->UpdateWireIns();
+    io->updateWireIns();
 }
 
 // Enable external triggering of amplifier hardware 'fast settle' function (blanking).
@@ -1202,9 +1292,9 @@ void Rhd2000EvalBoard::selectDacDataChannel(int dacChannel, int dataChannel)
 // chips will be controlled in real time via one of the 16 TTL inputs.
 void Rhd2000EvalBoard::enableExternalFastSettle(bool enable)
 {
-    dev->SetWireInValue(WireInMultiUse, enable ? 1 : 0);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInExtFastSettle, 0);
+    io->setWireInValue(WireInMultiUse, enable ? 1 : 0);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInExtFastSettle, 0);
 }
 
 // Select which of the TTL inputs 0-15 is used to perform a hardware 'fast settle' (blanking)
@@ -1216,9 +1306,9 @@ void Rhd2000EvalBoard::setExternalFastSettleChannel(int channel)
         return;
     }
 
-    dev->SetWireInValue(WireInMultiUse, channel);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInExtFastSettle, 1);
+    io->setWireInValue(WireInMultiUse, channel);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInExtFastSettle, 1);
 }
 
 // Enable external control of RHD2000 auxiliary digital output pin (auxout).
@@ -1226,21 +1316,21 @@ void Rhd2000EvalBoard::setExternalFastSettleChannel(int channel)
 // selected SPI port will be controlled in real time via one of the 16 TTL inputs.
 void Rhd2000EvalBoard::enableExternalDigOut(BoardPort port, bool enable)
 {
-    dev->SetWireInValue(WireInMultiUse, enable ? 1 : 0);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInMultiUse, enable ? 1 : 0);
+    io->updateWireIns();
 
     switch (port) {
     case PortA:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 0);
+        io->activateTriggerIn(TrigInExtDigOut, 0);
         break;
     case PortB:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 1);
+        io->activateTriggerIn(TrigInExtDigOut, 1);
         break;
     case PortC:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 2);
+        io->activateTriggerIn(TrigInExtDigOut, 2);
         break;
     case PortD:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 3);
+        io->activateTriggerIn(TrigInExtDigOut, 3);
         break;
     default:
         cerr << "Error in Rhd2000EvalBoard::enableExternalDigOut: port out of range." << endl;
@@ -1256,21 +1346,21 @@ void Rhd2000EvalBoard::setExternalDigOutChannel(BoardPort port, int channel)
         return;
     }
 
-    dev->SetWireInValue(WireInMultiUse, channel);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInMultiUse, channel);
+    io->updateWireIns();
 
     switch (port) {
     case PortA:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 4);
+        io->activateTriggerIn(TrigInExtDigOut, 4);
         break;
     case PortB:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 5);
+        io->activateTriggerIn(TrigInExtDigOut, 5);
         break;
     case PortC:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 6);
+        io->activateTriggerIn(TrigInExtDigOut, 6);
         break;
     case PortD:
-        dev->ActivateTriggerIn(TrigInExtDigOut, 7);
+        io->activateTriggerIn(TrigInExtDigOut, 7);
         break;
     default:
         cerr << "Error in Rhd2000EvalBoard::setExternalDigOutChannel: port out of range." << endl;
@@ -1284,9 +1374,9 @@ void Rhd2000EvalBoard::setExternalDigOutChannel(BoardPort port, int channel)
 // outputs, for example.
 void Rhd2000EvalBoard::enableDacHighpassFilter(bool enable)
 {
-    dev->SetWireInValue(WireInMultiUse, enable ? 1 : 0);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInDacHpf, 0);
+    io->setWireInValue(WireInMultiUse, enable ? 1 : 0);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInDacHpf, 0);
 }
 
 // Set cutoff frequency (in Hz) for optional FPGA-implemented digital high-pass filters
@@ -1313,9 +1403,9 @@ void Rhd2000EvalBoard::setDacHighpassFilter(double cutoff)
         filterCoefficient = 65535;
     }
 
-    dev->SetWireInValue(WireInMultiUse, filterCoefficient);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInDacHpf, 1);
+    io->setWireInValue(WireInMultiUse, filterCoefficient);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInDacHpf, 1);
 }
 
 // Set thresholds for DAC channels; threshold output signals appear on TTL outputs 0-7.
@@ -1336,14 +1426,14 @@ void Rhd2000EvalBoard::setDacThreshold(int dacChannel, int threshold, bool trigP
     }
 
     // Set threshold level.
-    dev->SetWireInValue(WireInMultiUse, threshold);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInDacThresh, dacChannel);
+    io->setWireInValue(WireInMultiUse, threshold);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInDacThresh, dacChannel);
 
     // Set threshold polarity.
-    dev->SetWireInValue(WireInMultiUse, (trigPolarity ? 1 : 0));
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInDacThresh, dacChannel + 8);
+    io->setWireInValue(WireInMultiUse, (trigPolarity ? 1 : 0));
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInDacThresh, dacChannel + 8);
 }
 
 // Set the TTL output mode of the board.
@@ -1357,8 +1447,8 @@ void Rhd2000EvalBoard::setTtlMode(int mode)
         return;
     }
 
-    dev->SetWireInValue(WireInResetRun, mode << 3, 0x0008);
-    dev->UpdateWireIns();
+    io->setWireInValue(WireInResetRun, mode << 3, 0x0008);
+    io->updateWireIns();
 }
 
 // Is variable-frequency clock DCM programming done?
@@ -1366,8 +1456,8 @@ bool Rhd2000EvalBoard::isDcmProgDone() const
 {
     int value;
 
-    dev->UpdateWireOuts();
-    value = dev->GetWireOutValue(WireOutDataClkLocked);
+    io->updateWireOuts();
+    value = io->getWireOutValue(WireOutDataClkLocked);
 
     return ((value & 0x0002) > 1);
 }
@@ -1377,8 +1467,8 @@ bool Rhd2000EvalBoard::isDataClockLocked() const
 {
     int value;
 
-    dev->UpdateWireOuts();
-    value = dev->GetWireOutValue(WireOutDataClkLocked);
+    io->updateWireOuts();
+    value = io->getWireOutValue(WireOutDataClkLocked);
 
     return ((value & 0x0001) > 0);
 }
@@ -1390,28 +1480,28 @@ void Rhd2000EvalBoard::flush()
 
     if (usb3)
     {
-        dev->SetWireInValue(WireInResetRun, 1 << 16, 1 << 16); //Override pipeout block throttle
-        dev->UpdateWireIns();
+        io->setWireInValue(WireInResetRun, 1 << 16, 1 << 16); //Override pipeout block throttle
+        io->updateWireIns();
         //cout << "Pre-Flush: " << numWordsInFifo() << endl;
         while (numWordsInFifo() >= USB_BUFFER_SIZE / 2) {
-            dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, USB_BUFFER_SIZE, usbBuffer);
+            io->readFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, USB_BUFFER_SIZE, usbBuffer);
         //  cout << "Flush phase A: " << numWordsInFifo() << endl;
         }
         while (numWordsInFifo() > 0) {
-            dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, USB3_BLOCK_SIZE *max(2 * numWordsInFifo() / USB3_BLOCK_SIZE, (unsigned int)1), usbBuffer);
+            io->readFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, USB3_BLOCK_SIZE *max(2 * numWordsInFifo() / USB3_BLOCK_SIZE, (unsigned int)1), usbBuffer);
         //  cout << "Flush phase B: " << numWordsInFifo() << endl;
         //  printFIFOmetrics();
         }
-        dev->SetWireInValue(WireInResetRun, 0, 1 << 16);
-        dev->UpdateWireIns();
+        io->setWireInValue(WireInResetRun, 0, 1 << 16);
+        io->updateWireIns();
     }
     else
     {
         while (numWordsInFifo() >= USB_BUFFER_SIZE / 2) {
-            dev->ReadFromPipeOut(PipeOutData, USB_BUFFER_SIZE, usbBuffer);
+            io->readFromPipeOut(PipeOutData, USB_BUFFER_SIZE, usbBuffer);
         }
         while (numWordsInFifo() > 0) {
-            dev->ReadFromPipeOut(PipeOutData, 2 * numWordsInFifo(), usbBuffer);
+            io->readFromPipeOut(PipeOutData, 2 * numWordsInFifo(), usbBuffer);
         }
     }
 }
@@ -1434,13 +1524,13 @@ bool Rhd2000EvalBoard::readDataBlock(Rhd2000DataBlock *dataBlock, int nSamples)
     if (usb3)
     {
         //std::cout << "usb3 read : " << numBytesToRead << " in " << USB3_BLOCK_SIZE << " blocks" << std::endl;
-        res = dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
+        res = io->readFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
 
     }
     else
     {
         //std::cout << "usb2 read: " << numBytesToRead << std::endl;
-        res = dev->ReadFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
+        res = io->readFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
     }
     if (res == ok_Timeout)
     {
@@ -1468,13 +1558,13 @@ bool Rhd2000EvalBoard::readRawDataBlock(unsigned char** bufferPtr, int nSamples)
     if (usb3)
     {
         //std::cout << "usb3 read : " << numBytesToRead << " in " << USB3_BLOCK_SIZE << " blocks" << std::endl;
-        res = dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
+        res = io->readFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
 
     }
     else
     {
         //std::cout << "usb2 read: " << numBytesToRead << std::endl;
-        res = dev->ReadFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
+        res = io->readFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
     }
     if (res == ok_Timeout)
     {
@@ -1484,16 +1574,14 @@ bool Rhd2000EvalBoard::readRawDataBlock(unsigned char** bufferPtr, int nSamples)
     return true;
 }
 
-// Reads a certain number of USB data blocks, if the specified number is available, and appends them
-// to queue.  Returns true if data blocks were available.
-bool Rhd2000EvalBoard::readDataBlocks(int numBlocks, queue<Rhd2000DataBlock> &dataQueue)
+// Reads a certain number of USB data blocks into the USB buffer, if the specified number is available.
+// Returns true if data blocks were available.
+bool Rhd2000EvalBoard::readUsbBlocks(int numBlocks)
 {
     unsigned int numWordsToRead, numBytesToRead;
-    int i;
-    Rhd2000DataBlock *dataBlock;
     long res;
 
-    numWordsToRead = numBlocks * dataBlock->calculateDataBlockSizeInWords(numDataStreams, usb3);
+    numWordsToRead = numBlocks * Rhd2000DataBlock::calculateDataBlockSizeInWords(numDataStreams, usb3);
 
     if (numWordsInFifo() < numWordsToRead)
         return false;
@@ -1508,17 +1596,30 @@ bool Rhd2000EvalBoard::readDataBlocks(int numBlocks, queue<Rhd2000DataBlock> &da
 
     if (usb3)
     {
-        res = dev->ReadFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
+        res = io->readFromBlockPipeOut(PipeOutData, USB3_BLOCK_SIZE, numBytesToRead, usbBuffer);
     }
     else
     {
-        res = dev->ReadFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
+        res = io->readFromPipeOut(PipeOutData, numBytesToRead, usbBuffer);
     }
     if (res == ok_Timeout)
     {
         cerr << "CRITICAL: Timeout on pipe read. Check block and buffer sizes." << endl;
     }
 
+    return true;
+}
+
+// Reads a certain number of USB data blocks, if the specified number is available, and appends them
+// to queue.  Returns true if data blocks were available.
+bool Rhd2000EvalBoard::readDataBlocks(int numBlocks, queue<Rhd2000DataBlock> &dataQueue)
+{
+    int i;
+    Rhd2000DataBlock *dataBlock;
+
+    if (!readUsbBlocks(numBlocks))
+        return false;
+
     dataBlock = new Rhd2000DataBlock(numDataStreams, usb3);
     for (i = 0; i < numBlocks; ++i) {
         dataBlock->fillFromUsbBuffer(usbBuffer, i, numDataStreams);
@@ -1529,6 +1630,30 @@ bool Rhd2000EvalBoard::readDataBlocks(int numBlocks, queue<Rhd2000DataBlock> &da
     return true;
 }
 
+// Reads a certain number of USB data blocks, if the specified number is available, and decodes them
+// in place into the first numBlocks blocks of a pool. Blocks are only allocated when the pool is
+// smaller or was sized for a different number of data streams, so a pool kept between calls
+// is decoded into without allocating.  Returns true if data blocks were available.
+bool Rhd2000EvalBoard::readDataBlocks(int numBlocks, vector<unique_ptr<Rhd2000DataBlock> > &blocks)
+{
+    int i;
+
+    if (!readUsbBlocks(numBlocks))
+        return false;
+
+    if (blocks.size() < (size_t) numBlocks)
+        blocks.resize(numBlocks);
+
+    for (i = 0; i < numBlocks; ++i) {
+        if (blocks[i] == nullptr || blocks[i]->getNumDataStreams() != numDataStreams)
+            blocks[i].reset(new Rhd2000DataBlock(numDataStreams, usb3));
+
+        blocks[i]->fillFromUsbBuffer(usbBuffer, i, numDataStreams);
+    }
+
+    return true;
+}
+
 // Writes the contents of a data block queue (dataQueue) to a binary output stream (saveOut).
 // Returns the number of data blocks written.
 int Rhd2000EvalBoard::queueToFile(queue<Rhd2000DataBlock> &dataQueue, ofstream &saveOut)
@@ -1610,8 +1735,8 @@ int Rhd2000EvalBoard::getBoardMode() const
 {
     int mode;
 
-    dev->UpdateWireOuts();
-    mode = dev->GetWireOutValue(WireOutBoardMode);
+    io->updateWireOuts();
+    mode = io->getWireOutValue(WireOutBoardMode);
 
     cout << "Board mode: " << mode << endl << endl;
 
@@ -1650,7 +1775,7 @@ void Rhd2000EvalBoard::getCableDelay(vector<int> &delays) const
 // Uses the Opal Kelly library to reset the FPGA
 void Rhd2000EvalBoard::resetFpga()
 {
-    dev->ResetFPGA();
+    io->resetFpga();
 }
 
 bool Rhd2000EvalBoard::isStreamEnabled(int streamIndex)
@@ -1663,9 +1788,9 @@ bool Rhd2000EvalBoard::isStreamEnabled(int streamIndex)
 
 void Rhd2000EvalBoard::enableBoardLeds(bool enable)
 {
-    dev->SetWireInValue(WireInMultiUse, enable ? 1 : 0);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInOpenEphys, 0);
+    io->setWireInValue(WireInMultiUse, enable ? 1 : 0);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInOpenEphys, 0);
 }
 
 // Ratio    divide_factor
@@ -1674,9 +1799,9 @@ void Rhd2000EvalBoard::enableBoardLeds(bool enable)
 void Rhd2000EvalBoard::setClockDivider(int divide_factor)
 {
 
-    dev->SetWireInValue(WireInMultiUse, divide_factor);
-    dev->UpdateWireIns();
-    dev->ActivateTriggerIn(TrigInOpenEphys, 1);
+    io->setWireInValue(WireInMultiUse, divide_factor);
+    io->updateWireIns();
+    io->activateTriggerIn(TrigInOpenEphys, 1);
 }
 
 bool Rhd2000EvalBoard::isUSB3()
@@ -1686,6 +1811,6 @@ bool Rhd2000EvalBoard::isUSB3()
 
 void Rhd2000EvalBoard::printFIFOmetrics()
 {
-    dev->UpdateWireOuts();
-    std::cout << "In FIFO: " << dev->GetWireOutValue(0x28) << " DDR: " << dev->GetWireOutValue(0x2a) << " Out FIFO: " << dev->GetWireOutValue(0x29) << std::endl;
+    io->updateWireOuts();
+    std::cout << "In FIFO: " << io->getWireOutValue(0x28) << " DDR: " << io->getWireOutValue(0x2a) << " Out FIFO: " << io->getWireOutValue(0x29) << std::endl;
 }
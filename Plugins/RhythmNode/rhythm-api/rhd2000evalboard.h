@@ -34,6 +34,7 @@
 #define DDR_BLOCK_SIZE 32
 
 #include <queue>
+#include <memory>
 
 using namespace std;
 
@@ -43,6 +44,21 @@ namespace OpalKellyLegacy
 }
 class Rhd2000DataBlock;
 
+// Open-ephys addition: the data an emulated board streams in place of the FPGA, see
+// Rhd2000EvalBoard::openEmulated().  Reads are made in bytes of raw USB data, as the
+// FPGA would send them.
+class Rhd2000UsbSource
+{
+public:
+    virtual ~Rhd2000UsbSource() {}
+
+    // Number of 16-bit words the emulated FIFO holds.
+    virtual unsigned int numWordsAvailable() = 0;
+
+    // Fills length bytes of data, waiting until they are due if the source is paced.
+    virtual void readData(unsigned char* data, long length) = 0;
+};
+
 class Rhd2000EvalBoard
 {
 
@@ -51,6 +67,9 @@ public:
     ~Rhd2000EvalBoard();
 
     int open(const char* libname); //patched to allow selecting path to dll
+    // Open-ephys addition: emulates a board whose data comes from source, without opening
+    // any hardware.  Register writes are ignored.  The source must outlive the board.
+    int openEmulated(Rhd2000UsbSource* source, bool isUsb3);
     bool uploadFpgaBitfile(string filename);
     void initialize();
 
@@ -160,6 +179,7 @@ public:
     void flush();
     bool readDataBlock(Rhd2000DataBlock *dataBlock, int nSamples = -1);
     bool readDataBlocks(int numBlocks, queue<Rhd2000DataBlock> &dataQueue);
+    bool readDataBlocks(int numBlocks, vector<unique_ptr<Rhd2000DataBlock> > &blocks);
     int queueToFile(queue<Rhd2000DataBlock> &dataQueue, std::ofstream &saveOut);
     int getBoardMode() const;
     int getCableDelay(BoardPort port) const;
@@ -175,7 +195,15 @@ public:
     bool readRawDataBlock(unsigned char** bufferPtr, int nSamples = -1);
 
 private:
+    bool readUsbBlocks(int numBlocks);
+
+    // Wire, trigger and pipe transfers with the board, made through FrontPanel or emulated
+    class BoardIO;
+    class FrontPanelIO;
+    class EmulatedIO;
+
     OpalKellyLegacy::okCFrontPanel *dev;
+    BoardIO *io;
     AmplifierSampleRate sampleRate;
     int numDataStreams; // total number of data streams currently enabled
     int dataStreamEnabled[MAX_NUM_DATA_STREAMS_USB3]; // 0 (disabled) or 1 (enabled), set for maximum stream number
@@ -24,7 +24,6 @@
 
 #include <stdio.h>
 #include "SerialInput.h"
-#define MAX_MSG_SIZE 10000
 
 const int SerialInput::BAUDRATES[12] = 
 {
@@ -46,15 +45,16 @@ const int SerialInput::BAUDRATES[12] =
 SerialInput::SerialInput()
     : GenericProcessor  ("Serial Port")
     , baudrate          (0)
-	, lastRecv			(0)
+    , delimiter         (-1)
+    , reader            (serial)
 {
     setProcessorType (PROCESSOR_TYPE_SOURCE);
-	dataBuffer.calloc(MAX_MSG_SIZE);
 }
 
 
 SerialInput::~SerialInput()
 {
+    reader.stop();
     serial.close();
 }
 
@@ -103,6 +103,11 @@ void SerialInput::setBaudrate (int baudrate)
     this->baudrate = baudrate;
 }
 
+void SerialInput::setDelimiter (int delimiter)
+{
+    this->delimiter = delimiter;
+}
+
 
 bool SerialInput::isReady()
 {
@@ -120,53 +125,40 @@ bool SerialInput::isReady()
 }
 
 
+bool SerialInput::enable()
+{
+    if (! reader.start (delimiter))
+        std::cout << "Serial input: could not wait on " << device << std::endl;
+
+    return true;
+}
+
+
 bool SerialInput::disable()
 {
+    reader.stop();
     serial.close();
+
+    if (reader.getNumDropped() > 0)
+        std::cout << "Serial input: " << reader.getNumDropped() << " messages dropped" << std::endl;
+
     return true;
 }
 
 
 void SerialInput::process (AudioSampleBuffer&)
 {
-	int64 timestamp = CoreServices::getGlobalTimestamp();
-	setTimestampAndSamples(timestamp, 0);
-
-    int bytesAvailable = serial.available();
-
-    if (bytesAvailable == OF_SERIAL_ERROR)
-    {
-        // ToDo: Properly warn about problem here!
-        AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "SerialInput device access error!", "Could not access serial device.");
-        return;
-    }
+	setTimestampAndSamples(CoreServices::getGlobalTimestamp(), 0);
 
-    if (bytesAvailable > 0)
-    {
+	const EventChannel* chan = getEventChannel(getEventChannelIndex(0, getNodeId()));
 
-        int bytesRead = serial.readBytes (dataBuffer, bytesAvailable);
-
-        if (bytesRead > 0)
-        {
-			//Clear the rest of the buffer so we don't send garbage.
-			if (bytesRead < lastRecv)
-				zeromem(dataBuffer.getData() + bytesRead, lastRecv - bytesRead);
-			lastRecv = bytesRead;
-			MetaDataValueArray metadata;
-			MetaDataValuePtr bufferRead = new MetaDataValue(MetaDataDescriptor::UINT64, 1);
-			bufferRead->setValue(static_cast<uint64>(bytesRead));
-			metadata.add(bufferRead);
-			const EventChannel* chan = getEventChannel(getEventChannelIndex(0, getNodeId()));
-			BinaryEventPtr event = BinaryEvent::createBinaryEvent(chan, timestamp, static_cast<uint8*>(dataBuffer.getData()), MAX_MSG_SIZE, metadata);
-			addEvent(chan, event, 0);
-        }
-        else if (bytesRead < 0)
-        {
-            // ToDo: Properly warn about problem here!
-            AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "SerialInput device read error!", "Could not read serial input, even though data should be available.");
-            return;
-        }
-    }
+	while (const SerialFrame* frame = reader.getNextFrame())
+	{
+		MetaDataBuilder<> metadata;
+		metadata.add(static_cast<uint64>(frame->size));
+		addBinaryEvent(chan, frame->timestamp, frame->data, MAX_MSG_SIZE, 0, metadata.getData());
+		reader.releaseFrame();
+	}
 }
 
 
@@ -31,12 +31,16 @@
 #include <ProcessorHeaders.h>
 
 #include "SerialInputEditor.h"
+#include "SerialReader.h"
 #include <SerialLib.h>
 
 
 /**
     This source processor allows you to pipe binary serial data input straight to the event cue/buffer.
 
+    The port is read by a SerialReader thread, and each frame it receives becomes an event
+    timestamped with its arrival.
+
     @see SerialInputEditor
 */
 class SerialInput : public GenericProcessor
@@ -54,7 +58,7 @@ public:
 
         The process method is called every time a new data buffer is available.
 
-        Adds all the new serial data that is available to the event data buffer.
+        Adds all the frames received since the last block to the event data buffer.
      */
     void process (AudioSampleBuffer& buffer) override;
 
@@ -67,10 +71,13 @@ public:
     */
     bool isReady() override;
 
+    /** Starts reading the open port. */
+    bool enable() override;
+
     /**
         Called immediately after the end of data acquisition by the ProcessorGraph.
 
-        It closes the open port serial port.
+        It stops the reader and closes the open port serial port.
      */
     bool disable() override;
 
@@ -89,6 +96,9 @@ public:
 
     /** Setter, that allows you to set the baudrate that will be used during acquisition */
     void setBaudrate (int baudrate);
+
+    /** Setter, that allows you to set the byte that ends each message, or -1 to send every read as a message */
+    void setDelimiter (int delimiter);
 protected:
 	void createEventChannels() override;
 
@@ -103,12 +113,15 @@ private:
     // The baudrate to be used
     int baudrate;
 
+    // The byte that ends each message, or -1
+    int delimiter;
+
+    // Reads the port during acquisition
+    SerialReader reader;
+
     // List of baudrates that are available by default.
     static const int BAUDRATES[12];
 
-	HeapBlock<unsigned char> dataBuffer;
-	int lastRecv;
-
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SerialInput);
 };
 
@@ -65,6 +65,19 @@ SerialInputEditor::SerialInputEditor(SerialInput* parentNode)
     refreshButton->addListener(this);
 
     addAndMakeVisible(refreshButton);
+
+    // Add delimiter list, item ids are the delimiter byte + 2
+    delimiterList = new ComboBox();
+    delimiterList->setBounds(10,90,150,20);
+    delimiterList->addListener(this);
+    delimiterList->setTooltip("Byte that ends each message; without one, every read from the port is a message");
+    delimiterList->addItem("No delimiter", 1);
+    delimiterList->addItem("Newline (LF)", '\n' + 2);
+    delimiterList->addItem("Carriage return (CR)", '\r' + 2);
+    delimiterList->addItem("Null byte", 2);
+    delimiterList->setSelectedId(1, dontSendNotification);
+
+    addAndMakeVisible(delimiterList);
 }
 
 void SerialInputEditor::startAcquisition()
@@ -72,6 +85,7 @@ void SerialInputEditor::startAcquisition()
     // Disable the whole gui
     deviceList->setEnabled(false);
     baudrateList->setEnabled(false);
+    delimiterList->setEnabled(false);
     refreshButton->setEnabled(false);
 }
 
@@ -80,6 +94,7 @@ void SerialInputEditor::stopAcquisition()
     // Reenable the whole gui
     deviceList->setEnabled(true);
     baudrateList->setEnabled(true);
+    delimiterList->setEnabled(true);
     refreshButton->setEnabled(true);
 }
 
@@ -102,6 +117,10 @@ void SerialInputEditor::comboBoxChanged(ComboBox* comboBox)
     {
         node->setBaudrate(comboBox->getSelectedId());
     }
+    else if (comboBox == delimiterList)
+    {
+        node->setDelimiter(comboBox->getSelectedId() - 2);
+    }
 }
 
 void SerialInputEditor::saveEditorParameters(XmlElement* xmlNode)
@@ -110,6 +129,7 @@ void SerialInputEditor::saveEditorParameters(XmlElement* xmlNode)
 
     parameters->setAttribute("device", deviceList->getText().toStdString());
     parameters->setAttribute("baudrate", baudrateList->getSelectedId());
+    parameters->setAttribute("delimiter", delimiterList->getSelectedId() - 2);
 }
 
 void SerialInputEditor::loadEditorParameters(XmlElement* xmlNode)
@@ -120,6 +140,7 @@ void SerialInputEditor::loadEditorParameters(XmlElement* xmlNode)
         {
             deviceList->setText(subNode->getStringAttribute("device", ""));
             baudrateList->setSelectedId(subNode->getIntAttribute("baudrate"));
+            delimiterList->setSelectedId(subNode->getIntAttribute("delimiter", -1) + 2);
         }
     }
 }
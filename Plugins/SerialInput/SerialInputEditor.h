@@ -66,6 +66,8 @@ private:
     ScopedPointer<ComboBox> deviceList;
     // List of all available baudrates.
     ScopedPointer<ComboBox> baudrateList;
+    // List of message delimiters
+    ScopedPointer<ComboBox> delimiterList;
 
     // Parent node
     SerialInput* node;
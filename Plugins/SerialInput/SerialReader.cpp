@@ -0,0 +1,163 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "SerialReader.h"
+
+
+SerialReader::SerialReader (ofSerial& serial_)
+    : serial            (serial_)
+    , delimiter         (-1)
+    , fifo              (SERIAL_FRAME_QUEUE_SIZE)
+    , pendingSize       (0)
+    , pendingTimestamp  (0)
+    , numDropped        (0)
+{
+    frames.calloc (SERIAL_FRAME_QUEUE_SIZE);
+    pending.malloc (MAX_MSG_SIZE);
+}
+
+
+SerialReader::~SerialReader()
+{
+    stop();
+}
+
+
+bool SerialReader::start (int delimiter_)
+{
+    stop();
+
+    delimiter = delimiter_;
+    fifo.reset();
+    pendingSize = 0;
+    numDropped = 0;
+
+    return SerialEventLoop::getInstance()->addPort (serial, this);
+}
+
+
+void SerialReader::stop()
+{
+    SerialEventLoop::getInstance()->removePort (serial);
+}
+
+
+const SerialFrame* SerialReader::getNextFrame()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+        return nullptr;
+
+    return frames + (size1 > 0 ? start1 : start2);
+}
+
+
+void SerialReader::releaseFrame()
+{
+    fifo.finishedRead (1);
+}
+
+
+int SerialReader::getNumDropped() const
+{
+    return numDropped.load();
+}
+
+
+void SerialReader::serialDataReceived (ofSerial&, const uint8* data, int numBytes)
+{
+    addBytes (data, numBytes, CoreServices::getGlobalTimestamp());
+}
+
+
+void SerialReader::serialErrorOccurred (ofSerial&)
+{
+    reportError ("Could not access serial device.");
+}
+
+
+void SerialReader::addBytes (const uint8* bytes, int numBytes, int64 timestamp)
+{
+    for (int i = 0; i < numBytes; ++i)
+    {
+        if (bytes[i] == delimiter)
+        {
+            if (pendingSize > 0)
+                queueFrame();
+
+            continue;
+        }
+
+        if (pendingSize == 0)
+            pendingTimestamp = timestamp;
+
+        pending[pendingSize++] = bytes[i];
+
+        if (pendingSize == MAX_MSG_SIZE)
+            queueFrame();
+    }
+
+    if (delimiter < 0 && pendingSize > 0)
+        queueFrame();
+}
+
+
+void SerialReader::queueFrame()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    {
+        numDropped.store (numDropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        pendingSize = 0;
+        return;
+    }
+
+    SerialFrame& frame = frames[size1 > 0 ? start1 : start2];
+
+    // clear what is left of the previous frame of the slot, so no garbage is sent
+    memcpy (frame.data, pending, (size_t) pendingSize);
+
+    if (frame.size > pendingSize)
+        zeromem (frame.data + pendingSize, (size_t) (frame.size - pendingSize));
+
+    frame.size = pendingSize;
+    frame.timestamp = pendingTimestamp;
+
+    fifo.finishedWrite (1);
+    pendingSize = 0;
+}
+
+
+void SerialReader::reportError (const String& message)
+{
+    // the message thread may be waiting in stop() for the I/O thread, so don't lock it
+    MessageManager::callAsync ([message]
+    {
+        AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "SerialInput device access error!", message);
+    });
+}
@@ -0,0 +1,108 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SERIALREADER_H_2E7A5C94__
+#define __SERIALREADER_H_2E7A5C94__
+
+#include <ProcessorHeaders.h>
+#include <SerialLib.h>
+#include <atomic>
+
+/** Longest message, in bytes; longer frames are cut */
+#define MAX_MSG_SIZE 10000
+
+/** Frames that can wait for the processing thread */
+#define SERIAL_FRAME_QUEUE_SIZE 64
+
+/** A message received from the serial port */
+struct SerialFrame
+{
+    int64 timestamp;    // global timestamp at the arrival of its first byte
+    int size;
+    uint8 data[MAX_MSG_SIZE];   // padded with zeros after size bytes
+};
+
+
+/**
+    Reads a serial port on the shared serial I/O thread, so the processing thread never
+    waits for it.
+
+    Bytes are timestamped on arrival, with the software estimate of the global timestamp,
+    and cut into frames at a delimiter byte (which isn't part of the frame), or at each
+    read when there is none. Complete frames are handed to the processing thread through
+    a lock-free queue, where they are read in place.
+
+    @see SerialInput, SerialEventLoop
+*/
+class SerialReader : private SerialEventLoop::Listener
+{
+public:
+    /** The port must stay open while the reader runs */
+    SerialReader (ofSerial& serial);
+    ~SerialReader();
+
+    /** Starts reading, with a delimiter byte, or -1 to make a frame of each read.
+        Returns false if the port can't be read. */
+    bool start (int delimiter);
+
+    /** Stops reading, dropping a partial frame and the frames not taken yet */
+    void stop();
+
+    /** The oldest complete frame, or nullptr if there is none. Only called from the
+        processing thread; the frame stays valid until releaseFrame() */
+    const SerialFrame* getNextFrame();
+    void releaseFrame();
+
+    /** Frames dropped since start() because the queue was full */
+    int getNumDropped() const;
+
+private:
+    void serialDataReceived (ofSerial& port, const uint8* data, int numBytes) override;
+    void serialErrorOccurred (ofSerial& port) override;
+
+    /** Adds bytes that arrived at the given timestamp to the frame being built */
+    void addBytes (const uint8* bytes, int numBytes, int64 timestamp);
+
+    /** Queues the frame being built */
+    void queueFrame();
+
+    /** Tells the user, from the I/O thread, that the port can't be read anymore */
+    void reportError (const String& message);
+
+    ofSerial& serial;
+    int delimiter;
+
+    AbstractFifo fifo;
+    HeapBlock<SerialFrame> frames;
+
+    HeapBlock<uint8> pending;
+    int pendingSize;
+    int64 pendingTimestamp;
+
+    std::atomic<int> numDropped;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SerialReader);
+};
+
+#endif  // __SERIALREADER_H_2E7A5C94__
@@ -0,0 +1,133 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SharedMemoryEditor.h"
+#include "SharedMemoryThread.h"
+
+using namespace SharedMemorySource;
+
+SegmentMonitor::SegmentMonitor(SharedMemoryEditor* editor_, SharedMemoryThread* thread_)
+	: Label("Status", String()), editor(editor_), thread(thread_)
+{
+	startTimer(1000);
+}
+
+void SegmentMonitor::timerCallback()
+{
+	if (!CoreServices::getAcquisitionStatus() && !thread->isConnected())
+		thread->foundInputSource();
+
+	editor->updateStatus();
+}
+
+SharedMemoryEditor::SharedMemoryEditor(SourceNode* parentNode, SharedMemoryThread* thread_)
+	: GenericEditor(parentNode, false), thread(thread_), wasConnected(thread_->isConnected())
+{
+	desiredWidth = 170;
+
+	segmentLabel = new Label("Segment", "Segment");
+	segmentLabel->setFont(Font("Small Text", 10, Font::plain));
+	segmentLabel->setBounds(10, 30, 150, 20);
+	segmentLabel->setColour(Label::textColourId, Colours::darkgrey);
+	addAndMakeVisible(segmentLabel);
+
+	segmentEditor = new Label("SegmentName", thread->getSegmentName());
+	segmentEditor->setFont(Font("Small Text", 10, Font::plain));
+	segmentEditor->setBounds(15, 50, 145, 18);
+	segmentEditor->setEditable(true);
+	segmentEditor->setColour(Label::backgroundColourId, Colours::lightgrey);
+	segmentEditor->addListener(this);
+	addAndMakeVisible(segmentEditor);
+
+	statusLabel = new SegmentMonitor(this, thread);
+	statusLabel->setFont(Font("Small Text", 10, Font::plain));
+	statusLabel->setBounds(10, 75, 150, 20);
+	statusLabel->setColour(Label::textColourId, Colours::darkgrey);
+	addAndMakeVisible(statusLabel);
+
+	updateStatus();
+}
+
+SharedMemoryEditor::~SharedMemoryEditor()
+{
+}
+
+void SharedMemoryEditor::labelTextChanged(Label* label)
+{
+	if (acquisitionIsActive)
+	{
+		CoreServices::sendStatusMessage("Can't change the shared memory segment while acquisition is active!");
+		segmentEditor->setText(thread->getSegmentName(), dontSendNotification);
+		return;
+	}
+
+	thread->setSegmentName(segmentEditor->getText());
+	segmentEditor->setText(thread->getSegmentName(), dontSendNotification);
+
+	wasConnected = thread->isConnected();
+	updateStatus();
+	CoreServices::updateSignalChain(this);
+}
+
+void SharedMemoryEditor::updateStatus()
+{
+	const bool connected = thread->isConnected();
+
+	if (connected)
+		statusLabel->setText(String(thread->getNumDataOutputs(DataChannel::HEADSTAGE_CHANNEL, 0)) + " ch @ "
+			+ String(thread->getSampleRate(0) / 1000.0f, 1) + " kS/s", dontSendNotification);
+	else
+		statusLabel->setText("Waiting for producer", dontSendNotification);
+
+	if (connected != wasConnected)
+	{
+		wasConnected = connected;
+		CoreServices::updateSignalChain(this);
+	}
+}
+
+void SharedMemoryEditor::startAcquisition()
+{
+	GenericEditor::startAcquisition();
+	segmentEditor->setEditable(false);
+}
+
+void SharedMemoryEditor::stopAcquisition()
+{
+	GenericEditor::stopAcquisition();
+	segmentEditor->setEditable(true);
+}
+
+void SharedMemoryEditor::saveCustomParameters(XmlElement* xml)
+{
+	xml->setAttribute("Segment", thread->getSegmentName());
+}
+
+void SharedMemoryEditor::loadCustomParameters(XmlElement* xml)
+{
+	thread->setSegmentName(xml->getStringAttribute("Segment", SHM_DEFAULT_SEGMENT));
+	segmentEditor->setText(thread->getSegmentName(), dontSendNotification);
+	wasConnected = thread->isConnected();
+	updateStatus();
+	CoreServices::updateSignalChain(this);
+}
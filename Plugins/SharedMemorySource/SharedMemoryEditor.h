@@ -0,0 +1,88 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SHAREDMEMORYEDITOR_H_4E2C81A7__
+#define __SHAREDMEMORYEDITOR_H_4E2C81A7__
+
+#include <EditorHeaders.h>
+
+class SourceNode;
+
+namespace SharedMemorySource
+{
+
+	class SharedMemoryThread;
+	class SharedMemoryEditor;
+
+	/** Shows the mapping state, polling for the segment while it is missing */
+	class SegmentMonitor : public Label, private Timer
+	{
+	public:
+		SegmentMonitor(SharedMemoryEditor* editor, SharedMemoryThread* thread);
+
+	private:
+		void timerCallback() override;
+
+		SharedMemoryEditor* editor;
+		SharedMemoryThread* thread;
+	};
+
+	/**
+		Selects the shared memory segment to read and shows whether it is mapped.
+
+		The signal chain is updated when the segment appears, since its header
+		decides the channel count and sample rate.
+
+		@see SharedMemoryThread
+	*/
+	class SharedMemoryEditor : public GenericEditor, public Label::Listener
+	{
+	public:
+		SharedMemoryEditor(SourceNode* parentNode, SharedMemoryThread* thread);
+		~SharedMemoryEditor();
+
+		void labelTextChanged(Label* label) override;
+
+		void startAcquisition() override;
+		void stopAcquisition() override;
+
+		void saveCustomParameters(XmlElement* xml) override;
+		void loadCustomParameters(XmlElement* xml) override;
+
+		/** Shows the mapping state, and updates the chain when it changed */
+		void updateStatus();
+
+	private:
+
+		SharedMemoryThread* thread;
+		bool wasConnected;
+
+		ScopedPointer<Label> segmentLabel, segmentEditor;
+		ScopedPointer<SegmentMonitor> statusLabel;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedMemoryEditor);
+	};
+
+}
+
+#endif  // __SHAREDMEMORYEDITOR_H_4E2C81A7__
@@ -0,0 +1,120 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SHAREDMEMORYFORMAT_H_4E2C81A7__
+#define __SHAREDMEMORYFORMAT_H_4E2C81A7__
+
+#include <atomic>
+
+#define SHM_INPUT_MAGIC			0x4d53454f	// "OESM"
+#define SHM_INPUT_VERSION		1
+#define SHM_INPUT_HEADER_SIZE	256
+#define SHM_INPUT_ALIGNMENT		64
+
+namespace SharedMemorySource
+{
+
+	/** Sample formats a producer can write */
+	enum SharedMemorySampleFormat
+	{
+		SHM_SAMPLES_FLOAT32 = 0,	// already scaled to the channel units
+		SHM_SAMPLES_INT16 = 1		// raw ADC values, multiplied by the channel's bitVolts on the way in
+	};
+
+	/**
+		Header at the start of a shared memory segment written by an external producer.
+
+		The producer creates the segment, fills in the header and keeps writing samples
+		into rings of capacity samples that follow it:
+
+		offset getBitVoltsOffset()		float bitVolts[numChannels]
+		offset getChannelOffset(ch)		numChannels planar rings of capacity samples
+		offset getTimestampOffset()		int64 timestamps[capacity], the producer's sample numbers
+		offset getEventCodeOffset()		uint64 ttlWords[capacity], one bit per TTL line
+
+		Sample n of the acquisition lives at index n % capacity of every ring. The producer
+		publishes samples by storing the new total in writeCount with release semantics,
+		once all the rings hold them; the GUI stores how far it has read in readCount. A
+		producer that would rather wait than overwrite unread samples compares the two.
+
+		All fields are little endian, as written by the host.
+	*/
+	struct SharedMemoryInputHeader
+	{
+		uint32 magic;				// SHM_INPUT_MAGIC
+		uint32 version;				// SHM_INPUT_VERSION
+		uint32 numChannels;
+		uint32 numTTLLines;			// up to 64
+		float sampleRate;
+		uint32 sampleFormat;		// a SharedMemorySampleFormat
+		uint32 capacity;			// samples held by each ring
+		uint32 reserved0;
+
+		std::atomic<uint64> writeCount;		// samples published since the producer started
+		std::atomic<uint64> readCount;		// samples consumed by the GUI
+
+		uint8 reserved[SHM_INPUT_HEADER_SIZE - 48];
+
+		static size_t align(size_t offset)
+		{
+			return (offset + SHM_INPUT_ALIGNMENT - 1) & ~(size_t)(SHM_INPUT_ALIGNMENT - 1);
+		}
+
+		size_t getSampleSize() const
+		{
+			return sampleFormat == SHM_SAMPLES_INT16 ? sizeof(int16) : sizeof(float);
+		}
+
+		size_t getBitVoltsOffset() const
+		{
+			return SHM_INPUT_HEADER_SIZE;
+		}
+
+		size_t getChannelOffset(int channel) const
+		{
+			const size_t first = align(getBitVoltsOffset() + numChannels * sizeof(float));
+			return first + channel * align(capacity * getSampleSize());
+		}
+
+		size_t getTimestampOffset() const
+		{
+			return getChannelOffset(numChannels);
+		}
+
+		size_t getEventCodeOffset() const
+		{
+			return align(getTimestampOffset() + capacity * sizeof(int64));
+		}
+
+		/** Bytes the whole segment takes */
+		size_t getSegmentSize() const
+		{
+			return align(getEventCodeOffset() + capacity * sizeof(uint64));
+		}
+	};
+
+	static_assert(sizeof(SharedMemoryInputHeader) == SHM_INPUT_HEADER_SIZE, "the header layout is shared with other processes");
+
+}
+
+#endif  // __SHAREDMEMORYFORMAT_H_4E2C81A7__
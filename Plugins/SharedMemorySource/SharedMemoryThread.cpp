@@ -0,0 +1,361 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SharedMemoryThread.h"
+#include "SharedMemoryEditor.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#elif JUCE_WINDOWS
+#include <windows.h>
+#endif
+
+#define SHM_BUFFER_SAMPLES		10000
+
+using namespace SharedMemorySource;
+
+SharedMemoryThread::SharedMemoryThread(SourceNode* sn) : DataThread(sn),
+	segmentName(SHM_DEFAULT_SEGMENT),
+	memory(nullptr),
+	memorySize(0),
+	header(nullptr),
+#if JUCE_WINDOWS
+	mapping(nullptr),
+#endif
+	numChannels(0),
+	numTTLLines(0),
+	sampleRate(30000.0f),
+	sampleFormat(SHM_SAMPLES_FLOAT32),
+	capacity(0),
+	readCount(0),
+	droppedSamples(0)
+{
+	openSegment();
+	sourceBuffers.add(new DataBuffer(numChannels, SHM_BUFFER_SAMPLES));
+}
+
+SharedMemoryThread::~SharedMemoryThread()
+{
+	closeSegment();
+}
+
+GenericEditor* SharedMemoryThread::createEditor(SourceNode* sn)
+{
+	return new SharedMemoryEditor(sn, this);
+}
+
+bool SharedMemoryThread::foundInputSource()
+{
+	return memory != nullptr || openSegment();
+}
+
+bool SharedMemoryThread::openSegment()
+{
+	closeSegment();
+
+	SharedMemoryInputHeader info;
+
+#if JUCE_LINUX || JUCE_MAC
+	const String path = "/" + segmentName;
+
+	int fd = shm_open(path.toRawUTF8(), O_RDWR, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(SharedMemoryInputHeader)
+		|| pread(fd, &info, sizeof(info), 0) != (ssize_t)sizeof(info))
+	{
+		::close(fd);
+		return false;
+	}
+	const size_t available = (size_t)status.st_size;
+#elif JUCE_WINDOWS
+	const String path = "Local\\" + segmentName;
+
+	HANDLE handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.toRawUTF8());
+	if (handle == nullptr)
+		return false;
+
+	// Map the whole segment once to learn its size and read the header
+	void* view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION region;
+	if (view == nullptr || VirtualQuery(view, &region, sizeof(region)) == 0
+		|| region.RegionSize < sizeof(SharedMemoryInputHeader))
+	{
+		if (view != nullptr)
+			UnmapViewOfFile(view);
+		CloseHandle(handle);
+		return false;
+	}
+	memcpy(&info, view, sizeof(info));
+	const size_t available = region.RegionSize;
+#else
+	return false;
+#endif
+
+	const bool valid = info.magic == SHM_INPUT_MAGIC
+		&& info.version == SHM_INPUT_VERSION
+		&& info.numChannels > 0 && info.numChannels <= SHM_MAX_CHANNELS
+		&& info.numTTLLines <= 64
+		&& info.sampleRate > 0.0f
+		&& (info.sampleFormat == SHM_SAMPLES_FLOAT32 || info.sampleFormat == SHM_SAMPLES_INT16)
+		&& info.capacity > 0
+		&& info.getSegmentSize() <= available;
+
+	if (!valid)
+	{
+		std::cout << "Shared memory segment " << segmentName << " has no valid input header." << std::endl;
+#if JUCE_LINUX || JUCE_MAC
+		::close(fd);
+#elif JUCE_WINDOWS
+		UnmapViewOfFile(view);
+		CloseHandle(handle);
+#endif
+		return false;
+	}
+
+	memorySize = info.getSegmentSize();
+
+#if JUCE_LINUX || JUCE_MAC
+	void* address = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (address == MAP_FAILED)
+		return false;
+
+	memory = address;
+#elif JUCE_WINDOWS
+	memory = view;
+	mapping = handle;
+#endif
+
+	header = static_cast<SharedMemoryInputHeader*>(memory);
+
+	// The layout is fixed from here on; a producer that changes it has to create a new segment
+	numChannels = (int)info.numChannels;
+	numTTLLines = (int)info.numTTLLines;
+	sampleRate = info.sampleRate;
+	sampleFormat = (int)info.sampleFormat;
+	capacity = info.capacity;
+
+	const float* scales = reinterpret_cast<const float*>(static_cast<const uint8*>(memory) + info.getBitVoltsOffset());
+	bitVolts.clearQuick();
+	for (int ch = 0; ch < numChannels; ++ch)
+		bitVolts.add(scales[ch] > 0.0f ? scales[ch] : 1.0f);
+
+	std::cout << "Shared memory source mapped " << segmentName << ": " << numChannels << " channels at "
+		<< sampleRate << " Hz." << std::endl;
+
+	return true;
+}
+
+void SharedMemoryThread::closeSegment()
+{
+	if (memory == nullptr)
+		return;
+
+#if JUCE_LINUX || JUCE_MAC
+	munmap(memory, memorySize);
+#elif JUCE_WINDOWS
+	UnmapViewOfFile(memory);
+	CloseHandle(mapping);
+	mapping = nullptr;
+#endif
+
+	memory = nullptr;
+	header = nullptr;
+}
+
+void SharedMemoryThread::setSegmentName(const String& name)
+{
+	segmentName = name.trim().trimCharactersAtStart("/");
+	openSegment();
+}
+
+String SharedMemoryThread::getSegmentName() const
+{
+	return segmentName;
+}
+
+bool SharedMemoryThread::isConnected() const
+{
+	return memory != nullptr;
+}
+
+int SharedMemoryThread::getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessor) const
+{
+	if (type == DataChannel::HEADSTAGE_CHANNEL && subProcessor == 0)
+		return numChannels;
+	return 0;
+}
+
+int SharedMemoryThread::getNumTTLOutputs(int subProcessor) const
+{
+	return subProcessor == 0 ? numTTLLines : 0;
+}
+
+float SharedMemoryThread::getSampleRate(int subProcessor) const
+{
+	return sampleRate;
+}
+
+float SharedMemoryThread::getBitVolts(const DataChannel* chan) const
+{
+	// int16 samples are scaled on the way in, so this is what one unit of the raw value was
+	return bitVolts[chan->getSourceTypeIndex()];
+}
+
+void SharedMemoryThread::resizeBuffers()
+{
+	resizeSourceBuffer(0, numChannels);
+}
+
+int64 SharedMemoryThread::getDroppedSamples() const
+{
+	return droppedSamples;
+}
+
+bool SharedMemoryThread::startAcquisition()
+{
+	if (header == nullptr)
+		return false;
+
+	// Start from the newest samples rather than whatever the producer wrote before
+	readCount = header->writeCount.load(std::memory_order_acquire);
+	header->readCount.store(readCount, std::memory_order_release);
+	droppedSamples = 0;
+	sourceBuffers[0]->clear();
+
+	startThread();
+
+	return true;
+}
+
+bool SharedMemoryThread::stopAcquisition()
+{
+	if (isThreadRunning())
+		signalThreadShouldExit();
+
+	if (!waitForThreadToExit(500))
+		std::cout << "Shared memory source thread failed to exit, continuing anyway..." << std::endl;
+
+	sourceBuffers[0]->clear();
+
+	if (droppedSamples > 0)
+		std::cout << "Shared memory source lost " << droppedSamples
+		<< " samples the producer overwrote before they were read." << std::endl;
+
+	return true;
+}
+
+void SharedMemoryThread::copySamples(DataBuffer* buffer, int dstStart, int numSamples, uint64 first)
+{
+	const uint8* base = static_cast<const uint8*>(memory);
+
+	// The run may wrap around the end of the rings
+	const int index = (int)(first % capacity);
+	const int run1 = jmin(numSamples, (int)capacity - index);
+	const int run2 = numSamples - run1;
+
+	float* const* channels = buffer->getChannelWritePointers();
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		float* dst = channels[ch] + dstStart;
+
+		if (sampleFormat == SHM_SAMPLES_FLOAT32)
+		{
+			const float* src = reinterpret_cast<const float*>(base + header->getChannelOffset(ch));
+			memcpy(dst, src + index, run1 * sizeof(float));
+			memcpy(dst + run1, src, run2 * sizeof(float));
+		}
+		else
+		{
+			const int16* src = reinterpret_cast<const int16*>(base + header->getChannelOffset(ch));
+			const float scale = bitVolts.getUnchecked(ch);
+			for (int i = 0; i < run1; ++i)
+				dst[i] = src[index + i] * scale;
+			for (int i = 0; i < run2; ++i)
+				dst[run1 + i] = src[i] * scale;
+		}
+	}
+
+	const int64* timestamps = reinterpret_cast<const int64*>(base + header->getTimestampOffset());
+	int64* dstTimestamps = buffer->getTimestampWritePointer() + dstStart;
+	memcpy(dstTimestamps, timestamps + index, run1 * sizeof(int64));
+	memcpy(dstTimestamps + run1, timestamps, run2 * sizeof(int64));
+
+	const uint64* eventCodes = reinterpret_cast<const uint64*>(base + header->getEventCodeOffset());
+	const uint64 lineMask = numTTLLines >= 64 ? ~(uint64)0 : ((uint64)1 << numTTLLines) - 1;
+	uint64* dstEventCodes = buffer->getEventCodeWritePointer() + dstStart;
+	for (int i = 0; i < run1; ++i)
+		dstEventCodes[i] = eventCodes[index + i] & lineMask;
+	for (int i = 0; i < run2; ++i)
+		dstEventCodes[run1 + i] = eventCodes[i] & lineMask;
+}
+
+bool SharedMemoryThread::updateBuffer()
+{
+	DataBuffer* buffer = sourceBuffers[0];
+
+	const uint64 written = header->writeCount.load(std::memory_order_acquire);
+
+	// A producer that restarted counts from zero again
+	if (written < readCount)
+		readCount = written;
+
+	uint64 available = written - readCount;
+	if (available == 0)
+	{
+		waitForData(SHM_BLOCK_SAMPLES);
+		return true;
+	}
+
+	// The producer lapped us, so the oldest unread samples are gone
+	if (available > capacity)
+	{
+		droppedSamples += (int64)(available - capacity);
+		readCount = written - capacity;
+		available = capacity;
+	}
+
+	int toWrite = (int)jmin(available, (uint64)SHM_BUFFER_SAMPLES);
+	int startIndex1, blockSize1, startIndex2, blockSize2;
+	int numItems = buffer->prepareToWrite(toWrite, startIndex1, blockSize1, startIndex2, blockSize2);
+
+	copySamples(buffer, startIndex1, blockSize1, readCount);
+	if (blockSize2 > 0)
+		copySamples(buffer, startIndex2, blockSize2, readCount + blockSize1);
+
+	buffer->finishedWrite(numItems, startIndex1);
+
+	// Samples the DataBuffer had no room for stay in the ring until the next update
+	readCount += numItems;
+	header->readCount.store(readCount, std::memory_order_release);
+
+	dataArrived();
+	return true;
+}
@@ -0,0 +1,118 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SHAREDMEMORYTHREAD_H_4E2C81A7__
+#define __SHAREDMEMORYTHREAD_H_4E2C81A7__
+
+#include <DataThreadHeaders.h>
+#include "SharedMemoryFormat.h"
+
+#define SHM_DEFAULT_SEGMENT		"open-ephys-input"
+#define SHM_MAX_CHANNELS		16384
+#define SHM_BLOCK_SAMPLES		256
+#define SHM_MIN_BUFFER_SAMPLES	10000
+
+namespace SharedMemorySource
+{
+
+	/**
+		Reads continuous data and TTL words that another process writes into a named
+		shared memory segment, laid out as described by SharedMemoryInputHeader.
+
+		The channel count, sample rate and bitVolts come from the segment header, which
+		is read when the segment is opened. Samples are copied ring by ring straight into
+		the DataBuffer, so no socket, deinterleaving or intermediate buffer is involved.
+
+		The segment is a POSIX shared memory object (/dev/shm on Linux) or a Windows file
+		mapping in the session namespace, opened read-write so readCount can be posted.
+
+		@see SharedMemoryInputHeader, DataThread
+	*/
+	class SharedMemoryThread : public DataThread
+	{
+	public:
+		SharedMemoryThread(SourceNode* sn);
+		~SharedMemoryThread();
+
+		/** Opens the segment if it is not mapped yet */
+		bool foundInputSource() override;
+
+		bool startAcquisition() override;
+		bool stopAcquisition() override;
+
+		int getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessor) const override;
+		int getNumTTLOutputs(int subProcessor) const override;
+
+		float getSampleRate(int subProcessor) const override;
+		float getBitVolts(const DataChannel* chan) const override;
+
+		void resizeBuffers() override;
+
+		GenericEditor* createEditor(SourceNode* sn) override;
+
+		/** Name of the segment to map, without the leading slash. Closes the current one. */
+		void setSegmentName(const String& name);
+		String getSegmentName() const;
+
+		bool isConnected() const;
+
+		/** Samples the producer overwrote before they were read during the last acquisition */
+		int64 getDroppedSamples() const;
+
+	private:
+		bool updateBuffer() override;
+
+		/** Maps the segment and checks its header. Returns false if it doesn't exist or is invalid. */
+		bool openSegment();
+		void closeSegment();
+
+		/** Copies numSamples samples of every ring, starting at sample number first */
+		void copySamples(DataBuffer* buffer, int dstStart, int numSamples, uint64 first);
+
+		String segmentName;
+
+		void* memory;
+		size_t memorySize;
+		SharedMemoryInputHeader* header;
+
+#if JUCE_WINDOWS
+		void* mapping;
+#endif
+
+		/** Layout read from the header when the segment was opened */
+		int numChannels;
+		int numTTLLines;
+		float sampleRate;
+		int sampleFormat;
+		uint32 capacity;
+		Array<float> bitVolts;
+
+		uint64 readCount;
+		int64 droppedSamples;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedMemoryThread);
+	};
+
+}
+
+#endif  // __SHAREDMEMORYTHREAD_H_4E2C81A7__
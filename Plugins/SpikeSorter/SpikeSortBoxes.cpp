@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
 #include "SpikeSortBoxes.h"
 #include "SpikeSorter.h"
+#include <DspLib.h>
 
 PointD::PointD()
 {
@@ -142,6 +143,18 @@ bool Box::LineSegmentIntersection(PointD p11, PointD p12, PointD p21, PointD p22
 #define MIN(x,y)((x)<(y))?(x):(y)
 #endif
 
+// spikes a unit needs before its mean waveform is used as a template
+#define TEMPLATE_MIN_SPIKES 20
+// spikes are matched to a template up to this many times the usual distance of its unit's spikes
+#define TEMPLATE_MAX_DISTANCE 1.5
+// sorted spikes after which the templates are rebuilt from the running means
+#define TEMPLATE_UPDATE_SPIKES 100
+
+// sorted spikes an electrode can queue for the statistics of its units
+#define UNIT_STATS_QUEUE_SIZE 1024
+// how often the statistics thread drains the queues, in milliseconds
+#define UNIT_STATS_INTERVAL_MS 20
+
 bool Box::isWaveFormInside(SorterSpikePtr so)
 {
     PointD BoxTopLeft(x, y);
@@ -373,6 +386,7 @@ void Histogram::setParameters(int N, double T0, double T1)
     t0 = T0;
     t1 = T1;
     numBins = N;
+    Max = 0;
     Time.resize(N);
     Counter.resize(N);
     for (int k = 0; k < N; k++)
@@ -387,6 +401,7 @@ Histogram::Histogram(int N, double T0, double T1)
     t0 = T0;
     t1 = T1;
     numBins = N;
+    Max = 0;
     Time.resize(N);
     Counter.resize(N);
     for (int k = 0; k < N; k++)
@@ -430,6 +445,7 @@ std::vector<int> Histogram::getCounter()
 // Running variance...
 //Mk = Mk-1+ (xk - Mk-1)/k
 //Sk = Sk-1 + (xk - Mk-1)*(xk - Mk).
+// Mk and Sk are kept in flat arrays of all the channels of the waveforms, channel after channel
 //For 2 ≤ k ≤ n, the kth estimate of the variance is s2 = Sk/(k - 1).
 RunningStats::~RunningStats()
 {
@@ -438,6 +454,7 @@ RunningStats::RunningStats()
 {
     hist.setParameters(101, 0, 100); // Inter spike histogram. Fixed range [0..100 ms]
     numSamples = 0;
+    numChannels = waveformLength = 0;
 }
 
 void RunningStats::reset()
@@ -451,42 +468,23 @@ Histogram RunningStats::getHistogram()
     return hist;
 }
 
-std::vector<double> RunningStats::getMean(int index)
+const float* RunningStats::getMean(int channel) const
 {
-    std::vector<double> m;
-
     if (numSamples == 0)
-    {
-        return m;
-    }
-
-    int numSamplesInWaveForm = (int) WaveFormMean[0].size();
-    m.resize(numSamplesInWaveForm);
+        return nullptr;
 
-    for (int k = 0; k < numSamplesInWaveForm; k++)
-        m[k] = WaveFormMean[index][k];
-    return m;
+    return &WaveFormMean[channel * waveformLength];
 }
 
-std::vector<double> RunningStats::getStandardDeviation(int index)
+void RunningStats::getStandardDeviation(int channel, float* deviation) const
 {
-    std::vector<double> WaveFormVar;
-
-    if (numSamples == 0)
-    {
-        return WaveFormVar;
-    }
-    int numSamplesInWaveForm = (int) WaveFormMean[0].size();
-    WaveFormVar.resize(numSamplesInWaveForm);
-
-    for (int j = 0; j < numSamplesInWaveForm; j++)
+    for (int j = 0; j < waveformLength; j++)
     {
-        if (numSamples - 1 == 0)
-            WaveFormVar[j] = 0;
+        if (numSamples < 2)
+            deviation[j] = 0;
         else
-            WaveFormVar[j] = sqrt(WaveFormSk[index][j] / (numSamples - 1));
+            deviation[j] = sqrt(WaveFormSk[channel * waveformLength + j] / (numSamples - 1));
     }
-    return WaveFormVar;
 }
 
 
@@ -509,44 +507,29 @@ void RunningStats::update(SorterSpikePtr so)
     }
 
     newData = true;
-	int nChannels = so->getChannel()->getNumChannels();
-	int nSamples = so->getChannel()->getTotalSamples();
+    const float* data = so->getData();
+    const int dim = so->getChannel()->getNumChannels() * so->getChannel()->getTotalSamples();
     if (numSamples == 0)
     {
-        // allocate
-        WaveFormMean.resize(nChannels);
-        WaveFormSk.resize(nChannels);
-        WaveFormMk.resize(nChannels);
-        for (int k=0; k<nChannels; k++)
-        {
-            WaveFormMean[k].resize(nSamples);
-            WaveFormSk[k].resize(nSamples);
-            WaveFormMk[k].resize(nSamples);
-        }
-
-        for (int i = 0; i < nChannels; i++)
-        {
-            for (int j = 0; j < nSamples; j++)
-            {
-				WaveFormMean[i][j] = so->getData()[j + i*nSamples];
-                WaveFormSk[i][j] = 0;
-				WaveFormMk[i][j] = so->getData()[j + i*nSamples];
-            }
-        }
-        numSamples += 1.0F;
+        numChannels = so->getChannel()->getNumChannels();
+        waveformLength = so->getChannel()->getTotalSamples();
+        WaveFormMean.assign(data, data + dim);
+        WaveFormSk.assign(dim, 0.0f);
+        numSamples = 1;
         return;
     }
-    // running mean
-    for (int i = 0; i < nChannels; i++)
+
+    // Welford's running mean and sum of squared deviations
+    numSamples += 1;
+    const float rate = 1.0f / numSamples;
+    float* mean = WaveFormMean.data();
+    float* sk = WaveFormSk.data();
+    for (int i = 0; i < dim; i++)
     {
-        for (int j = 0; j < nSamples; j++)
-        {
-			WaveFormMean[i][j] = (numSamples * WaveFormMean[i][j] + so->getData()[j + i*nSamples]) / (numSamples + 1);
-			WaveFormMk[i][j] += (so->getData()[j + i*nSamples] - WaveFormMk[i][j]) / numSamples;
-			WaveFormSk[i][j] += (so->getData()[j + i*nSamples] - WaveFormMk[i][j]) * (so->getData()[j + i*nSamples] - WaveFormMk[i][j]);
-        }
+        const float delta = data[i] - mean[i];
+        mean[i] += delta * rate;
+        sk[i] += delta * (data[i] - mean[i]);
     }
-    numSamples += 1.0F;
 }
 
 
@@ -592,10 +575,12 @@ void BoxUnit::updateWaveform(SorterSpikePtr so)
 
 /***********************************************/
 
-SpikeSortBoxes::SpikeSortBoxes(UniqueIDgenerator* uniqueIDgenerator_,PCAcomputingThread* pth, int numch, double SamplingRate, int WaveFormLength)
+SpikeSortBoxes::SpikeSortBoxes(UniqueIDgenerator* uniqueIDgenerator_,PCAcomputingPool* pth, UnitStatsThread* statsThread_, int numch, double SamplingRate, int WaveFormLength)
+    : statsFifo(UNIT_STATS_QUEUE_SIZE), statsQueue(UNIT_STATS_QUEUE_SIZE)
 {
     uniqueIDgenerator = uniqueIDgenerator_;
     computingThread = pth;
+    statsThread = statsThread_;
     pc1 = pc2 = nullptr;
     bufferSize = 200;
     spikeBufferIndex = -1;
@@ -605,20 +590,26 @@ SpikeSortBoxes::SpikeSortBoxes(UniqueIDgenerator* uniqueIDgenerator_,PCAcomputin
     selectedUnit = -1;
     selectedBox = -1;
     bRePCA = false;
+    rePCApriority = 1;
     pc1min = -1;
     pc2min = -1;
     pc1max = 1;
     pc2max = 1;
     numChannels = numch;
     waveformLength = WaveFormLength;
+    sampleRate = SamplingRate;
+    spikesSinceCompile = 0;
 
     pc1 = new float[numChannels * waveformLength];
     pc2 = new float[numChannels * waveformLength];
+    pca.resize(numChannels * waveformLength);
     for (int n = 0; n < bufferSize; n++)
     {
 
         spikeBuffer.add(nullptr);
     }
+    compileUnits();
+    statsThread->addSorter(this);
 }
 
 void SpikeSortBoxes::resizeWaveform(int numSamples)
@@ -630,6 +621,8 @@ void SpikeSortBoxes::resizeWaveform(int numSamples)
     delete[] pc2;
     pc1 = new float[numChannels * waveformLength];
     pc2 = new float[numChannels * waveformLength];
+    pca.resize(numChannels * waveformLength);
+    pcaJob = nullptr;
     spikeBuffer.clear();
     for (int n = 0; n < bufferSize; n++)
     {
@@ -655,6 +648,7 @@ void SpikeSortBoxes::resizeWaveform(int numSamples)
     {
         boxUnits[k].resizeWaveform(waveformLength);
     }
+    compileUnits();
     //EndCriticalSection();
 }
 
@@ -706,6 +700,11 @@ void SpikeSortBoxes::loadCustomParametersFromXml(XmlElement* electrodeNode)
                             dimcounter++;
                         }
                     }
+
+                    // keep the saved components, so the saved PCA units still apply
+                    pca.resize(waveformLength*numChannels);
+                    if (bPCAcomputed)
+                        pca.setComponents(pc1, pc2, bufferSize);
                 }
 
                 if (UnitNode->hasTagName("BOXUNIT"))
@@ -764,6 +763,9 @@ void SpikeSortBoxes::loadCustomParametersFromXml(XmlElement* electrodeNode)
             }
         }
     }
+
+    const ScopedLock myScopedLock(mut);
+    compileUnits();
 }
 
 void SpikeSortBoxes::saveCustomParametersToXml(XmlElement* electrodeNode)
@@ -842,6 +844,8 @@ void SpikeSortBoxes::saveCustomParametersToXml(XmlElement* electrodeNode)
 
 SpikeSortBoxes::~SpikeSortBoxes()
 {
+    statsThread->removeSorter(this);
+
     // wait until PCA job is done (if one was submitted).
     delete[] pc1;
     delete[] pc2;
@@ -866,9 +870,42 @@ void SpikeSortBoxes::projectOnPrincipalComponents(SorterSpikePtr so)
     spikeBufferIndex++;
     spikeBufferIndex %= bufferSize;
     spikeBuffer.set(spikeBufferIndex, so);
-    if (bPCAjobFinished)
+
+    if (bRePCA)
+    {
+        // recompute from the buffered spikes on the PCA workers, and keep
+        // sorting with the current components meanwhile
+        bRePCA = false;
+        pcaJob = new PCAjob(spikeBuffer, this, rePCApriority);
+        computingThread->addPCAjob(pcaJob);
+    }
+
+    if (pcaJob != nullptr && pcaJob->isDone())
+    {
+        if (pcaJob->dim == numChannels * waveformLength)
+        {
+            std::copy(pcaJob->pc1.begin(), pcaJob->pc1.end(), pc1);
+            std::copy(pcaJob->pc2.begin(), pcaJob->pc2.end(), pc2);
+            setPCArange(pcaJob->pc1min, pcaJob->pc2min, pcaJob->pc1max, pcaJob->pc2max);
+
+            // go on tracking from the new components
+            pca.setComponents(pc1, pc2, bufferSize);
+            bPCAcomputed = true;
+            bPCAjobFinished = true;
+        }
+        pcaJob = nullptr;
+    }
+
+    pca.update(so->getData());
+    pca.getComponents(pc1, pc2);
+
+    // the display range is only set once the components are reliable, since the units are
+    // drawn in it
+    if (!bPCAcomputed && pca.getNumSpikes() >= bufferSize)
     {
+        updatePCArange();
         bPCAcomputed = true;
+        bPCAjobFinished = true;
     }
 
     if (bPCAcomputed)
@@ -885,20 +922,34 @@ void SpikeSortBoxes::projectOnPrincipalComponents(SorterSpikePtr so)
             //int dbg = 1;
         }
     }
-    else
+}
+
+void SpikeSortBoxes::updatePCArange()
+{
+    float min1 = 1e10, min2 = 1e10, max1 = -1e10, max2 = -1e10;
+
+    for (int j = 0; j < spikeBuffer.size(); j++)
     {
-        // add a spike object to the buffer.
-        // if we have enough spikes, start the PCA computation thread.
-        if ((spikeBufferIndex == bufferSize -1 && !bPCAcomputed && !bPCAJobSubmitted) || bRePCA)
+        SorterSpikePtr spike = spikeBuffer[j];
+        if (spike == nullptr)
+            continue;
+
+        float sum1 = 0, sum2 = 0;
+        for (int k = 0; k < numChannels * waveformLength; k++)
         {
-            bPCAJobSubmitted = true;
-	    bPCAcomputed = false;
-            bRePCA = false;
-            // submit a new job to compute the spike buffer.
-            PCAJobPtr job = new PCAjob(spikeBuffer,pc1,pc2, pc1min, pc2min, pc1max, pc2max, bPCAjobFinished);
-            computingThread->addPCAjob(job);
+            sum1 += spikeDataIndexToMicrovolts(spike, k) * pc1[k];
+            sum2 += spikeDataIndexToMicrovolts(spike, k) * pc2[k];
         }
+        min1 = jmin(min1, sum1);
+        min2 = jmin(min2, sum2);
+        max1 = jmax(max1, sum1);
+        max2 = jmax(max2, sum2);
     }
+
+    pc1min = min1 - 1.5 * (max1-min1);
+    pc2min = min2 - 1.5 * (max2-min2);
+    pc1max = max1 + 1.5 * (max1-min1);
+    pc2max = max2 + 1.5 * (max2-min2);
 }
 
 void SpikeSortBoxes::getPCArange(float& p1min,float& p2min, float& p1max,  float& p2max)
@@ -927,10 +978,10 @@ bool SpikeSortBoxes::isPCAfinished()
 {
     return bPCAjobFinished;
 }
-void SpikeSortBoxes::RePCA()
+void SpikeSortBoxes::RePCA(bool isVisible)
 {
-    bPCAcomputed = false;
     bPCAJobSubmitted = false;
+    rePCApriority = isVisible ? 1 : 0;
     bRePCA = true;
 }
 
@@ -939,6 +990,7 @@ void SpikeSortBoxes::addPCAunit(PCAUnit unit)
     const ScopedLock myScopedLock(mut);
     //StartCriticalSection();
     pcaUnits.push_back(unit);
+    compileUnits();
     //EndCriticalSection();
 }
 
@@ -951,6 +1003,7 @@ int SpikeSortBoxes::addBoxUnit(int channel)
     int unusedID = uniqueIDgenerator->generateUniqueID(); //generateUnitID();
     BoxUnit unit(unusedID, generateLocalID());
     boxUnits.push_back(unit);
+    compileUnits();
     setSelectedUnitAndBox(unusedID, 0);
     //EndCriticalSection();
     return unusedID;
@@ -973,6 +1026,7 @@ int SpikeSortBoxes::addBoxUnit(int channel, Box B)
     int unusedID = uniqueIDgenerator->generateUniqueID(); //generateUnitID();
     BoxUnit unit(B, unusedID,generateLocalID());
     boxUnits.push_back(unit);
+    compileUnits();
     setSelectedUnitAndBox(unusedID, 0);
     //EndCriticalSection();
     return unusedID;
@@ -1055,6 +1109,7 @@ void SpikeSortBoxes::generateNewIDs()
     {
         pcaUnits[k].UnitID = generateUnitID();
     }
+    compileUnits();
 }
 
 void SpikeSortBoxes::removeAllUnits()
@@ -1062,6 +1117,7 @@ void SpikeSortBoxes::removeAllUnits()
     const ScopedLock myScopedLock(mut);
     boxUnits.clear();
     pcaUnits.clear();
+    compileUnits();
 }
 
 bool SpikeSortBoxes::removeUnit(int unitID)
@@ -1073,6 +1129,7 @@ bool SpikeSortBoxes::removeUnit(int unitID)
         if (boxUnits[k].getUnitID() == unitID)
         {
             boxUnits.erase(boxUnits.begin()+k);
+            compileUnits();
             //EndCriticalSection();
             return true;
         }
@@ -1083,6 +1140,7 @@ bool SpikeSortBoxes::removeUnit(int unitID)
         if (pcaUnits[k].getUnitID() == unitID)
         {
             pcaUnits.erase(pcaUnits.begin()+k);
+            compileUnits();
             //EndCriticalSection();
             return true;
         }
@@ -1108,6 +1166,7 @@ bool SpikeSortBoxes::addBoxToUnit(int channel, int unitID)
             B.y -= 30;
             B.channel = channel;
             boxUnits[k].addBox(B);
+            compileUnits();
             setSelectedUnitAndBox(unitID, (int) boxUnits[k].lstBoxes.size() - 1);
             // EndCriticalSection();
             return true;
@@ -1127,6 +1186,7 @@ bool SpikeSortBoxes::addBoxToUnit(int channel, int unitID, Box B)
         if (boxUnits[k].getUnitID() == unitID)
         {
             boxUnits[k].addBox(B);
+            compileUnits();
             // EndCriticalSection();
             return true;
         }
@@ -1159,6 +1219,7 @@ void SpikeSortBoxes::updatePCAUnits(std::vector<PCAUnit> _units)
     //StartCriticalSection();
     const ScopedLock myScopedLock(mut);
     pcaUnits = _units;
+    compileUnits();
     //EndCriticalSection();
 }
 
@@ -1167,14 +1228,133 @@ void SpikeSortBoxes::updateBoxUnits(std::vector<BoxUnit> _units)
     const ScopedLock myScopedLock(mut);
     //StartCriticalSection();
     boxUnits = _units;
+    compileUnits();
     //EndCriticalSection();
 }
 
 
 
 
+void SpikeSortBoxes::compileUnits()
+{
+    SortingUnitsPtr units = new SortingUnits(boxUnits, pcaUnits, numChannels, sampleRate, waveformLength);
+    spikesSinceCompile = 0;
+    SortingUnitsPtr previousUnits;
+    {
+        const SpinLock::ScopedLockType sortingLock(sortingUnitsLock);
+        previousUnits = sortingUnits;
+        sortingUnits = units;
+    }
+    // the replaced units are released here, unless a spike is being sorted with them
+}
+
+void SpikeSortBoxes::queueUnitSpike(int unitID, SorterSpikePtr so, bool refreshTemplates)
+{
+    // when the statistics thread falls behind, the spike is left out of them
+    int start1, size1, start2, size2;
+    statsFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+        return;
+
+    QueuedSpike& queued = statsQueue[start1];
+    queued.spike = so;
+    queued.unitID = unitID;
+    queued.refreshTemplates = refreshTemplates;
+    statsFifo.finishedWrite(1);
+}
+
+void SpikeSortBoxes::updateUnitStats()
+{
+    int start1, size1, start2, size2;
+    statsFifo.prepareToRead(statsFifo.getNumReady(), start1, size1, start2, size2);
+    const int numQueued = size1 + size2;
+    if (numQueued == 0)
+        return;
+
+    const ScopedLock myScopedLock(mut);
+    for (int n = 0; n < numQueued; n++)
+    {
+        QueuedSpike& queued = statsQueue[n < size1 ? start1 + n : start2 + n - size1];
+
+        for (int k = 0; k < boxUnits.size(); k++)
+        {
+            if (boxUnits[k].getUnitID() == queued.unitID)
+                boxUnits[k].updateWaveform(queued.spike);
+        }
+        for (int k = 0; k < pcaUnits.size(); k++)
+        {
+            if (pcaUnits[k].getUnitID() == queued.unitID)
+                pcaUnits[k].updateWaveform(queued.spike);
+        }
+
+        if (queued.refreshTemplates && ++spikesSinceCompile >= TEMPLATE_UPDATE_SPIKES)
+            compileUnits();
+
+        queued.spike = nullptr;
+    }
+    statsFifo.finishedRead(numQueued);
+}
+
 // tests whether a candidate spike belongs to one of the defined units
-bool SpikeSortBoxes::sortSpike(SorterSpikePtr so, bool PCAfirst)
+bool SpikeSortBoxes::sortSpike(SorterSpikePtr so, bool PCAfirst, bool templateMatching)
+{
+    SortingUnitsPtr units;
+    {
+        const SpinLock::ScopedLockType sortingLock(sortingUnitsLock);
+        units = sortingUnits;
+    }
+
+    if (units == nullptr || !units->matches(so))
+        return sortSpikeWithUnits(so, PCAfirst);
+
+    const SortingUnits::Unit* unit = nullptr;
+    bool updateStats = true;
+
+    if (PCAfirst)
+    {
+        int k = units->findPCAUnit(so->pcProj[0], so->pcProj[1]);
+        if (k >= 0)
+        {
+            unit = &units->pcaUnits[k];
+            updateStats = false;
+        }
+        else if ((k = units->findBoxUnit(so->getData())) >= 0)
+        {
+            unit = &units->boxUnits[k];
+        }
+    }
+    else
+    {
+        int k = units->findBoxUnit(so->getData());
+        if (k >= 0)
+            unit = &units->boxUnits[k];
+        else if ((k = units->findPCAUnit(so->pcProj[0], so->pcProj[1])) >= 0)
+            unit = &units->pcaUnits[k];
+    }
+
+    if (unit == nullptr && templateMatching)
+    {
+        const int k = units->findTemplateUnit(so->getData());
+        if (k >= 0)
+        {
+            unit = &units->templateUnits[k];
+            updateStats = true;
+        }
+    }
+
+    if (unit == nullptr)
+        return false;
+
+    so->sortedId = unit->unitID;
+    so->color[0] = unit->color[0];
+    so->color[1] = unit->color[1];
+    so->color[2] = unit->color[2];
+    if (updateStats)
+        queueUnitSpike(unit->unitID, so, templateMatching);
+    return true;
+}
+
+bool SpikeSortBoxes::sortSpikeWithUnits(SorterSpikePtr so, bool PCAfirst)
 {
     const ScopedLock myScopedLock(mut);
     if (PCAfirst)
@@ -1200,7 +1380,7 @@ bool SpikeSortBoxes::sortSpike(SorterSpikePtr so, bool PCAfirst)
                 so->color[0] = boxUnits[k].ColorRGB[0];
                 so->color[1] = boxUnits[k].ColorRGB[1];
                 so->color[2] = boxUnits[k].ColorRGB[2];
-                boxUnits[k].updateWaveform(so);
+                queueUnitSpike(boxUnits[k].getUnitID(), so, false);
                 return true;
             }
         }
@@ -1216,7 +1396,7 @@ bool SpikeSortBoxes::sortSpike(SorterSpikePtr so, bool PCAfirst)
                 so->color[0] = boxUnits[k].ColorRGB[0];
                 so->color[1] = boxUnits[k].ColorRGB[1];
                 so->color[2] = boxUnits[k].ColorRGB[2];
-                boxUnits[k].updateWaveform(so);
+                queueUnitSpike(boxUnits[k].getUnitID(), so, false);
                 return true;
             }
         }
@@ -1228,7 +1408,7 @@ bool SpikeSortBoxes::sortSpike(SorterSpikePtr so, bool PCAfirst)
                 so->color[0] = pcaUnits[k].ColorRGB[0];
                 so->color[1] = pcaUnits[k].ColorRGB[1];
                 so->color[2] = pcaUnits[k].ColorRGB[2];
-                pcaUnits[k].updateWaveform(so);
+                queueUnitSpike(pcaUnits[k].getUnitID(), so, false);
                 return true;
             }
         }
@@ -1248,6 +1428,7 @@ bool  SpikeSortBoxes::removeBoxFromUnit(int unitID, int boxIndex)
         if (boxUnits[k].getUnitID() == unitID)
         {
             bool s= boxUnits[k].deleteBox(boxIndex);
+            compileUnits();
             setSelectedUnitAndBox(-1,-1);
             //EndCriticalSection();
             return s;
@@ -1637,6 +1818,222 @@ bool cPolygon::isPointInside(PointD p)
     return inside;
 }
 
+/**************************/
+
+SortingUnits::SortingUnits(const std::vector<BoxUnit>& boxUnits_, const std::vector<PCAUnit>& pcaUnits_,
+                           int numChannels_, float sampleRate_, int waveformLength_)
+    : numChannels(numChannels_), waveformLength(waveformLength_), sampleRate(sampleRate_)
+{
+    // the same conversions as spikeTimeBinToMicrosecond() and microSecondsToSpikeTimeBin(), so the
+    // units sort exactly like the boxes and polygons themselves
+    const unsigned int totalSamples = waveformLength;
+    const float spikeTimeSpan = 1.0f / sampleRate * totalSamples * 1e6;
+    const float lastBin = float(totalSamples - 1);
+
+    binTimes.resize(waveformLength);
+    for (int pt = 0; pt < waveformLength; pt++)
+        binTimes[pt] = float(pt) / (totalSamples - 1) * spikeTimeSpan;
+
+    unitBoxes.push_back(0);
+    for (const BoxUnit& boxUnit : boxUnits_)
+    {
+        Unit unit;
+        unit.unitID = boxUnit.UnitID;
+        for (int c = 0; c < 3; c++)
+            unit.color[c] = boxUnit.ColorRGB[c];
+        boxUnits.push_back(unit);
+
+        for (const Box& box : boxUnit.lstBoxes)
+        {
+            const float left = box.x;
+            const float right = box.x + box.w;
+            boxChannel.push_back(box.channel);
+            boxBinLeft.push_back((int) jlimit(0.0f, lastBin, left / spikeTimeSpan * lastBin));
+            boxBinRight.push_back((int) jlimit(0.0f, lastBin, right / spikeTimeSpan * lastBin));
+            boxTopLeft.push_back(PointD(box.x, box.y));
+            boxBottomRight.push_back(PointD(box.x + box.w, box.y - box.h));
+        }
+        unitBoxes.push_back((int) boxChannel.size());
+
+        addTemplate(unit, boxUnit.WaveformStat);
+    }
+
+    polygonEdges.push_back(0);
+    for (const PCAUnit& pcaUnit : pcaUnits_)
+    {
+        Unit unit;
+        unit.unitID = pcaUnit.UnitID;
+        for (int c = 0; c < 3; c++)
+            unit.color[c] = pcaUnit.ColorRGB[c];
+        pcaUnits.push_back(unit);
+
+        const std::vector<PointD>& pts = pcaUnit.poly.pts;
+        const PointD& offset = pcaUnit.poly.offset;
+        PointD minPoint, maxPoint;
+
+        // polygons with less than three points contain nothing, so they get no edges
+        if (pts.size() >= 3)
+        {
+            PointD oldPoint(pts[pts.size() - 1].X + offset.X, pts[pts.size() - 1].Y + offset.Y);
+            minPoint = maxPoint = oldPoint;
+            for (int i = 0; i < pts.size(); i++)
+            {
+                PointD newPoint(pts[i].X + offset.X, pts[i].Y + offset.Y);
+                edgeStart.push_back(oldPoint);
+                edgeEnd.push_back(newPoint);
+                minPoint = PointD(jmin(minPoint.X, newPoint.X), jmin(minPoint.Y, newPoint.Y));
+                maxPoint = PointD(jmax(maxPoint.X, newPoint.X), jmax(maxPoint.Y, newPoint.Y));
+                oldPoint = newPoint;
+            }
+        }
+        polygonMin.push_back(minPoint);
+        polygonMax.push_back(maxPoint);
+        polygonEdges.push_back((int) edgeStart.size());
+
+        addTemplate(unit, pcaUnit.WaveformStat);
+    }
+}
+
+void SortingUnits::addTemplate(const Unit& unit, const RunningStats& stats)
+{
+    // the mean of a few spikes is too noisy to match others against
+    if (stats.numSamples < TEMPLATE_MIN_SPIKES
+        || stats.numChannels != numChannels
+        || stats.waveformLength != waveformLength)
+    {
+        return;
+    }
+
+    // spikes of the unit are on average at the square root of its summed variance from the mean
+    const int dim = numChannels * waveformLength;
+    templates.insert(templates.end(), stats.WaveFormMean.begin(), stats.WaveFormMean.begin() + dim);
+    double variance = 0;
+    for (int i = 0; i < dim; i++)
+        variance += stats.WaveFormSk[i] / (stats.numSamples - 1);
+    templateUnits.push_back(unit);
+    templateMaxDistance.push_back(TEMPLATE_MAX_DISTANCE * TEMPLATE_MAX_DISTANCE * variance);
+}
+
+bool SortingUnits::matches(const SorterSpikeContainer* so) const
+{
+    const SpikeChannel* channel = so->getChannel();
+    return channel->getSampleRate() == sampleRate
+        && (int) channel->getTotalSamples() == waveformLength
+        && (int) channel->getNumChannels() == numChannels;
+}
+
+int SortingUnits::findBoxUnit(const float* waveform) const
+{
+    for (int k = 0; k < boxUnits.size(); k++)
+    {
+        const int firstBox = unitBoxes[k];
+        const int lastBox = unitBoxes[k + 1];
+        if (firstBox == lastBox)
+            continue;
+
+        bool inside = true;
+        for (int b = firstBox; b < lastBox && inside; b++)
+            inside = isWaveformInsideBox(waveform, b);
+
+        if (inside)
+            return k;
+    }
+    return -1;
+}
+
+int SortingUnits::findPCAUnit(float x, float y) const
+{
+    const PointD p(x, y);
+    for (int k = 0; k < pcaUnits.size(); k++)
+    {
+        if (isPointInsidePolygon(k, p))
+            return k;
+    }
+    return -1;
+}
+
+int SortingUnits::findTemplateUnit(const float* waveform) const
+{
+    const int dim = numChannels * waveformLength;
+    int nearest = -1;
+    float nearestDistance = 0;
+
+    for (int k = 0; k < templateUnits.size(); k++)
+    {
+        const float distance = Dsp::VectorOps::squaredDistance(waveform, &templates[k * dim], dim);
+        if (distance <= templateMaxDistance[k] && (nearest < 0 || distance < nearestDistance))
+        {
+            nearest = k;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+bool SortingUnits::isWaveformInsideBox(const float* waveform, int box) const
+{
+    const int channel = boxChannel[box];
+    const int binLeft = boxBinLeft[box];
+    const int binRight = boxBinRight[box];
+    if (channel < 0 || channel >= numChannels || binLeft >= binRight)
+        return false;
+
+    const float* data = waveform + channel * waveformLength;
+    const PointD& topLeft = boxTopLeft[box];
+    const PointD& bottomRight = boxBottomRight[box];
+
+    // a waveform that stays above or below the box can't cross any of its edges
+    const Range<float> range = FloatVectorOperations::findMinAndMax(data + binLeft, binRight - binLeft + 1);
+    if (range.getEnd() < bottomRight.Y || range.getStart() > topLeft.Y)
+        return false;
+
+    const PointD bottomLeft(topLeft.X, bottomRight.Y);
+    const PointD topRight(bottomRight.X, topLeft.Y);
+
+    for (int pt = binLeft; pt < binRight; pt++)
+    {
+        const PointD wave1(binTimes[pt], data[pt]);
+        const PointD wave2(binTimes[pt + 1], data[pt + 1]);
+
+        if (Box::LineSegmentIntersection(wave1, wave2, topLeft, bottomLeft)
+            || Box::LineSegmentIntersection(wave1, wave2, topRight, bottomRight)
+            || Box::LineSegmentIntersection(wave1, wave2, topLeft, topRight)
+            || Box::LineSegmentIntersection(wave1, wave2, bottomLeft, bottomRight))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SortingUnits::isPointInsidePolygon(int polygon, PointD p) const
+{
+    const int firstEdge = polygonEdges[polygon];
+    const int lastEdge = polygonEdges[polygon + 1];
+    if (firstEdge == lastEdge
+        || p.X < polygonMin[polygon].X || p.X > polygonMax[polygon].X
+        || p.Y < polygonMin[polygon].Y || p.Y > polygonMax[polygon].Y)
+    {
+        return false;
+    }
+
+    bool inside = false;
+    for (int e = firstEdge; e < lastEdge; e++)
+    {
+        const PointD& oldPoint = edgeStart[e];
+        const PointD& newPoint = edgeEnd[e];
+        const PointD& p1 = newPoint.X > oldPoint.X ? oldPoint : newPoint;
+        const PointD& p2 = newPoint.X > oldPoint.X ? newPoint : oldPoint;
+
+        if ((newPoint.X < p.X) == (p.X <= oldPoint.X)
+            && ((p.Y - p1.Y) * (p2.X - p1.X) < (p2.Y - p1.Y) * (p.X - p1.X)))
+        {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
 
 
 
@@ -1716,17 +2113,36 @@ static int iminarg1,iminarg2;
 static double sqrarg;
 #define SQR(a) ((sqrarg = (a)) == 0.0 ? 0.0 : sqrarg * sqrarg)
 
-PCAjob::PCAjob(SorterSpikeArray& _spikes, float* _pc1, float* _pc2,
-                std::atomic<float>& pc1Min,  std::atomic<float>& pc2Min,  std::atomic<float>&pc1Max,  std::atomic<float>& pc2Max, std::atomic<bool>& _reportDone) : spikes(_spikes),
-pc1min(pc1Min), pc2min(pc2Min), pc1max(pc1Max), pc2max(pc2Max), reportDone(_reportDone)
+PCAjob::PCAjob(const SorterSpikeArray& spikes, const void* owner_, int priority_)
+    : owner(owner_), priority(priority_), numSpikes(0), dim(0)
 {
-	SorterSpikePtr spike = spikes[0];
-    cov = nullptr;
-    pc1 = _pc1;
-    pc2 = _pc2;
+    pc1min = pc2min = -1;
+    pc1max = pc2max = 1;
+    done = false;
+
+    for (int i = 0; i < spikes.size(); i++)
+    {
+        if (spikes[i] != nullptr)
+        {
+            dim = spikes[i]->getChannel()->getNumChannels()*spikes[i]->getChannel()->getTotalSamples();
+            break;
+        }
+    }
 
-    dim = spike->getChannel()->getNumChannels()*spike->getChannel()->getTotalSamples();
+    // one contiguous row per spike, so computing the job doesn't go through the spike objects
+    waveforms.reserve(spikes.size() * dim);
+    for (int i = 0; i < spikes.size(); i++)
+    {
+        SorterSpikePtr spike = spikes[i];
+        if (spike != nullptr)
+        {
+            waveforms.insert(waveforms.end(), spike->getData(), spike->getData() + dim);
+            numSpikes++;
+        }
+    }
 
+    pc1.resize(dim);
+    pc2.resize(dim);
 };
 
 PCAjob::~PCAjob()
@@ -1734,6 +2150,11 @@ PCAjob::~PCAjob()
 
 }
 
+bool PCAjob::isDone() const
+{
+    return done;
+}
+
 
 
 // calculates sqrt( a^2 + b^2 ) with decent precision
@@ -1992,202 +2413,371 @@ int PCAjob::svdcmp(float** a, int nRows, int nCols, float* w, float** v)
 
 void PCAjob::computeCov()
 {
-    // allocate and zero
-    cov = new float*[dim];
-    float* mean  = new float[dim];
-    for (int k = 0; k < dim; k++)
+    cov.assign(dim * dim, 0);
+    std::vector<float> mean(dim, 0);
+    std::vector<float> centered(dim);
+
+    // compute mean
+    for (int i = 0; i < numSpikes; i++)
     {
-        cov[k] = new float[dim];
-        for (int j=0; j<dim; j++)
-        {
-            cov[k][j] = 0;
-        }
+        const float* waveform = &waveforms[i * dim];
+        for (int j = 0; j < dim; j++)
+            mean[j] += waveform[j];
     }
-    // compute mean
+    for (int j = 0; j < dim; j++)
+        mean[j] /= numSpikes;
 
-    for (int j=0; j<dim; j++)
+    // aggregate the upper triangle, one spike at a time
+    for (int k = 0; k < numSpikes; k++)
     {
-        mean[j] = 0;
-        for (int i=0; i<spikes.size(); i++)
+        const float* waveform = &waveforms[k * dim];
+        for (int j = 0; j < dim; j++)
+            centered[j] = waveform[j] - mean[j];
+
+        for (int i = 0; i < dim; i++)
         {
-            SorterSpikePtr spike = spikes[i];
-            float v = spikeDataIndexToMicrovolts(spike, j) ;
-            mean[j] += v / dim;
+            float* row = &cov[i * dim];
+            const float vi = centered[i];
+            for (int j = i; j < dim; j++)
+                row[j] += vi * centered[j];
         }
     }
-    // aggregate
-
 
-    for (int i=0; i<dim; i++)
+    for (int i = 0; i < dim; i++)
     {
-        for (int j=i; j<dim; j++)
+        for (int j = i; j < dim; j++)
         {
-            // cov[i][j] = sum_k[ (X(i,:)) * (Xj-mue(j) ]
-            float sum = 0 ;
-            for (int k=0; k<spikes.size(); k++)
-            {
-
-                SorterSpikePtr spike = spikes[k];
-                float vi = spikeDataIndexToMicrovolts(spike, i);
-                float vj = spikeDataIndexToMicrovolts(spike, j);
-                sum += (vi-mean[i]) * (vj-mean[j]);
-            }
-            cov[i][j] = sum / (dim-1);
-            cov[j][i] = sum / (dim-1);
+            cov[i * dim + j] /= (numSpikes - 1);
+            cov[j * dim + i] = cov[i * dim + j];
         }
     }
-    delete[] mean;
-
-    // delete covariances
-    //for (int k = 0; k < dim; k++)
-    //delete cov[k];
-
-    //delete(cov);
-    //cov = nullptr;
-
-}
-
-std::vector<int> sort_indexes(std::vector<float> v)
-{
-    // initialize original index locations
-    std::vector<int> idx(v.size());
-
-    for (int i = 0; i != idx.size(); ++i)
-    {
-        idx[i] = i;
-    }
-
-    //sort indexes based on comparing values in v
-    sort(
-        idx.begin(),
-        idx.end()//,
-        //[&v](size_t i1, size_t i2)
-        //{
-        //	return v[i1] > v[i2];
-        //}
-    );
-
-    return idx;
 }
 
 void PCAjob::computeSVD()
 {
+    std::vector<float> eigvecData(dim * dim, 0);
+    std::vector<float> sigvalues(dim);
+    std::vector<float*> covRows(dim), eigvecRows(dim);
 
-
-    float** eigvec, *sigvalues;
-    sigvalues = new float[dim];
-
-    eigvec = new float*[dim];
     for (int k = 0; k < dim; k++)
     {
-        eigvec[k] = new float[dim];
-        for (int j=0; j<dim; j++)
-        {
-            eigvec[k][j] = 0;
-        }
+        covRows[k] = &cov[k * dim];
+        eigvecRows[k] = &eigvecData[k * dim];
     }
 
-    svdcmp(cov, dim, dim, sigvalues, eigvec);
+    svdcmp(covRows.data(), dim, dim, sigvalues.data(), eigvecRows.data());
 
-    std::vector<float> sig;
-    sig.resize(dim);
+    // the singular values are not sorted: find the two largest
+    std::vector<int> sortind(dim);
     for (int k = 0; k < dim; k++)
-        sig[k] = sigvalues[k];
-
-    std::vector<int> sortind = sort_indexes(sig);
+        sortind[k] = k;
+    std::sort(sortind.begin(), sortind.end(), [&sigvalues](int a, int b) { return sigvalues[a] > sigvalues[b]; });
 
     for (int k = 0; k < dim; k++)
     {
-        pc1[k] = eigvec[k][sortind[0]];
-        pc2[k] = eigvec[k][sortind[1]];
+        pc1[k] = eigvecRows[k][sortind[0]];
+        pc2[k] = eigvecRows[k][sortind[1]];
     }
     // project samples to find the display range
     float min1 = 1e10, min2 = 1e10, max1 = -1e10, max2 = -1e10;
 
-    for (int j = 0; j < spikes.size(); j++)
+    for (int j = 0; j < numSpikes; j++)
     {
+        const float* waveform = &waveforms[j * dim];
         float sum1 = 0, sum2=0;
         for (int k = 0; k < dim; k++)
         {
-            SorterSpikePtr spike = spikes[j];
-            sum1 += spikeDataIndexToMicrovolts(spike,k) * pc1[k];
-            sum2 += spikeDataIndexToMicrovolts(spike,k) * pc2[k];
+            sum1 += waveform[k] * pc1[k];
+            sum2 += waveform[k] * pc2[k];
         }
-        if (sum1 < min1)
-            min1 = sum1;
-        if (sum2 < min2)
-            min2 = sum2;
-        if (sum1 > max1)
-            max1 = sum1;
-        if (sum2 > max2)
-            max2 = sum2;
+        min1 = jmin(min1, sum1);
+        min2 = jmin(min2, sum2);
+        max1 = jmax(max1, sum1);
+        max2 = jmax(max2, sum2);
     }
 
-
     pc1min = min1 - 1.5 * (max1-min1);
     pc2min = min2 - 1.5 * (max2-min2);
     pc1max = max1 + 1.5 * (max1-min1);
     pc2max = max2 + 1.5 * (max2-min2);
 
-    // clear memory
-    for (int k = 0; k < dim; k++)
-    {
-        delete[] eigvec[k];
-    }
-    delete[] eigvec;
-    delete[] sigvalues;
+    cov.clear();
+}
 
-    // delete covariances
-    for (int k = 0; k < dim; k++)
-        delete[] cov[k];
 
-    delete[] cov;
-    cov = nullptr;
+/**********************/
 
+// most PCA worker threads, whatever the number of cores
+#define MAX_PCA_WORKERS 4
+
+UnitStatsThread::UnitStatsThread() : Thread("Unit statistics")
+{
 }
 
+UnitStatsThread::~UnitStatsThread()
+{
+    stopThread(2000);
+}
 
-/**********************/
+void UnitStatsThread::addSorter(SpikeSortBoxes* sorter)
+{
+    ScopedLock critical(lock);
+    sorters.addIfNotAlreadyThere(sorter);
+
+    if (!isThreadRunning())
+        startThread();
+}
+
+void UnitStatsThread::removeSorter(SpikeSortBoxes* sorter)
+{
+    // the lock is held while the queues are drained, so the electrode is not in use once it is removed
+    ScopedLock critical(lock);
+    sorters.removeFirstMatchingValue(sorter);
+}
+
+void UnitStatsThread::run()
+{
+    while (!threadShouldExit())
+    {
+        {
+            ScopedLock critical(lock);
+            for (auto sorter : sorters)
+                sorter->updateUnitStats();
+        }
+        wait(UNIT_STATS_INTERVAL_MS);
+    }
+}
+
+PCAcomputingPool::PCAcomputingPool()
+{
+}
 
+PCAcomputingPool::~PCAcomputingPool()
+{
+    for (auto worker : workers)
+        worker->signalThreadShouldExit();
+
+    jobAdded.signal();
+
+    for (auto worker : workers)
+        worker->stopThread(2000);
+}
 
-void PCAcomputingThread::addPCAjob(PCAJobPtr job)
+void PCAcomputingPool::addPCAjob(PCAJobPtr job)
 {
 	{
 		ScopedLock critical(lock);
+
+		// a newer job of the same electrode supersedes the pending ones
+		for (int i = jobs.size(); --i >= 0;)
+		{
+			if (jobs[i]->owner == job->owner)
+				jobs.remove(i);
+		}
 		jobs.add(job);
+
+		if (workers.size() == 0)
+		{
+			int numWorkers = jlimit(1, MAX_PCA_WORKERS, SystemStats::getNumCpus() - 1);
+			for (int i = 0; i < numWorkers; i++)
+			{
+				Worker* worker = new Worker(*this, i);
+				workers.add(worker);
+				ThreadConfig::startThread(*worker, ThreadConfig::COMPUTE_POOL);
+			}
+		}
 	}
-	
-    if (!isThreadRunning())
+
+    jobAdded.signal();
+}
+
+PCAJobPtr PCAcomputingPool::getNextJob()
+{
+    ScopedLock critical(lock);
+
+    // highest priority first, the oldest when they are equal
+    int next = -1;
+    for (int i = 0; i < jobs.size(); i++)
     {
-        startThread();
+        if (next < 0 || jobs[i]->priority > jobs[next]->priority)
+            next = i;
     }
+
+    if (next < 0)
+        return nullptr;
+
+    return jobs.removeAndReturn(next);
 }
 
-void PCAcomputingThread::run()
+PCAcomputingPool::Worker::Worker(PCAcomputingPool& pool_, int index)
+    : Thread("PCA " + String(index)), pool(pool_)
 {
-    while (jobs.size() > 0)
+}
+
+void PCAcomputingPool::Worker::run()
+{
+    while (!threadShouldExit())
     {
-		lock.enter();
-        PCAJobPtr J = jobs.removeAndReturn(0);
-	if (J == nullptr) continue;
-		lock.exit();
+        PCAJobPtr J = pool.getNextJob();
+        if (J == nullptr)
+        {
+            pool.jobAdded.wait(100);
+            continue;
+        }
+
         // compute PCA
         // 1. Compute Covariance matrix
         // 2. Apply SVD on covariance matrix
         // 3. Extract the two principal components corresponding to the largest singular values
-
-        J->computeCov();
-        J->computeSVD();
+        if (J->numSpikes > 2 && J->dim > 1)
+        {
+            J->computeCov();
+            J->computeSVD();
+        }
 
         // 4. Report to the spike sorting electrode that PCA is finished
-        J->reportDone = true;
+        J->done = true;
+
+        // wake another worker if there is more to do
+        pool.jobAdded.signal();
     }
 }
 
 
-PCAcomputingThread::PCAcomputingThread() : Thread("PCA")
+/**************************/
+
+// amnesic parameter of CCIPCA: how much more recent spikes weigh than older ones
+#define PCA_AMNESIC 2.0
+
+// smallest learning rate, so the components keep following drifts (about the last 1000 spikes)
+#define PCA_MIN_RATE 1e-3
+
+IncrementalPCA::IncrementalPCA() : dim(0), numSpikes(0), numWarmupSpikes(0)
+{
+    warmupVariance[0] = warmupVariance[1] = 0;
+}
+
+void IncrementalPCA::resize(int dim_)
+{
+    dim = dim_;
+    mean.resize(dim);
+    residual.resize(dim);
+    components[0].resize(dim);
+    components[1].resize(dim);
+    reset();
+}
+
+void IncrementalPCA::reset()
+{
+    numSpikes = 0;
+    numWarmupSpikes = 0;
+    std::fill(mean.begin(), mean.end(), 0.0);
+    std::fill(components[0].begin(), components[0].end(), 0.0);
+    std::fill(components[1].begin(), components[1].end(), 0.0);
+    warmupVariance[0] = warmupVariance[1] = 0;
+}
+
+void IncrementalPCA::setComponents(const float* pc1, const float* pc2, int warmupSpikes)
+{
+    reset();
+    for (int k = 0; k < dim; k++)
+    {
+        components[0][k] = pc1[k];
+        components[1][k] = pc2[k];
+    }
+    numWarmupSpikes = warmupSpikes;
+}
+
+void IncrementalPCA::update(const float* waveform)
 {
+    numSpikes++;
 
+    const double meanRate = jmax(1.0 / numSpikes, PCA_MIN_RATE);
+    const double rate = jlimit(PCA_MIN_RATE, 1.0, (1.0 + PCA_AMNESIC) / numSpikes);
+
+    for (int k = 0; k < dim; k++)
+    {
+        mean[k] += meanRate * (waveform[k] - mean[k]);
+        residual[k] = waveform[k] - mean[k];
+    }
+
+    for (int c = 0; c < 2; c++)
+    {
+        std::vector<double>& v = components[c];
+
+        double norm = 0, dot = 0;
+        for (int k = 0; k < dim; k++)
+        {
+            norm += v[k] * v[k];
+            dot += v[k] * residual[k];
+        }
+        norm = sqrt(norm);
+
+        if (norm == 0)
+        {
+            // the first spike that has a residual starts the component
+            v = residual;
+            continue;
+        }
+
+        dot /= norm;
+
+        if (numSpikes <= numWarmupSpikes)
+        {
+            // known direction: only estimate the variance along it, which is the length
+            // CCIPCA keeps for each component
+            warmupVariance[c] += (dot * dot - warmupVariance[c]) / numSpikes;
+            if (numSpikes == numWarmupSpikes)
+            {
+                for (int k = 0; k < dim; k++)
+                    v[k] *= warmupVariance[c] / norm;
+            }
+        }
+        else
+        {
+            // v <- (1 - rate) v + rate (u . v / |v|) u
+            for (int k = 0; k < dim; k++)
+                v[k] = (1 - rate) * v[k] + rate * dot * residual[k];
+        }
+
+        // the next component is estimated from what this one doesn't explain
+        norm = 0;
+        dot = 0;
+        for (int k = 0; k < dim; k++)
+        {
+            norm += v[k] * v[k];
+            dot += v[k] * residual[k];
+        }
+
+        if (norm > 0)
+        {
+            for (int k = 0; k < dim; k++)
+                residual[k] -= dot / norm * v[k];
+        }
+    }
+}
+
+void IncrementalPCA::getComponents(float* pc1, float* pc2) const
+{
+    float* pcs[2] = { pc1, pc2 };
+
+    for (int c = 0; c < 2; c++)
+    {
+        const std::vector<double>& v = components[c];
+
+        double norm = 0;
+        for (int k = 0; k < dim; k++)
+            norm += v[k] * v[k];
+        norm = sqrt(norm);
+
+        for (int k = 0; k < dim; k++)
+            pcs[c][k] = norm > 0 ? float(v[k] / norm) : 0.0f;
+    }
+}
+
+int IncrementalPCA::getNumSpikes() const
+{
+    return numSpikes;
 }
 
 
@@ -51,7 +51,8 @@ private:
 typedef ReferenceCountedObjectPtr<SorterSpikeContainer> SorterSpikePtr;
 typedef ReferenceCountedArray<SorterSpikeContainer, CriticalSection> SorterSpikeArray;
 
-class PCAcomputingThread;
+class PCAcomputingPool;
+class UnitStatsThread;
 class UniqueIDgenerator;
 class PointD
 {
@@ -79,7 +80,7 @@ public:
     Box();
     Box(int channel);
     Box(float X, float Y, float W, float H, int ch=0);
-    bool LineSegmentIntersection(PointD p11, PointD p12, PointD p21, PointD p22);
+    static bool LineSegmentIntersection(PointD p11, PointD p12, PointD p21, PointD p22);
     bool isWaveFormInside(SorterSpikePtr so);
     double x,y,w,h; // x&w and specified in microseconds. y&h in microvolts
     int channel;
@@ -115,15 +116,18 @@ public:
     void resizeWaveform(int newlength);
     void reset();
     Histogram getHistogram();
-    std::vector<double> getMean(int index);
-    std::vector<double> getStandardDeviation(int index);
+    /** The mean waveform of a channel, or nullptr before the first spike */
+    const float* getMean(int channel) const;
+    void getStandardDeviation(int channel, float* deviation) const;
     void update(SorterSpikePtr so);
     bool queryNewData();
 
     double LastSpikeTime;
     bool newData;
     Histogram hist;
-    std::vector<std::vector<double> > WaveFormMean,WaveFormSk,WaveFormMk;
+    // all the channels of the waveforms, one after the other
+    std::vector<float> WaveFormMean, WaveFormSk;
+    int numChannels, waveformLength;
     double numSamples;
 
 
@@ -177,24 +181,63 @@ class PCAjob
 public:
 PCAjob();
 };*/
+/** Batch PCA of the buffered spikes of an electrode. The waveforms are copied into one
+contiguous matrix, and the results are kept in the job until the electrode picks them up. */
 class PCAjob : public ReferenceCountedObject
 {
 public:
-    PCAjob(SorterSpikeArray& _spikes, float* _pc1, float* _pc2,
-           std::atomic<float>&,  std::atomic<float>&,  std::atomic<float>&,  std::atomic<float>&, std::atomic<bool>& _reportDone);
+    PCAjob(const SorterSpikeArray& spikes, const void* owner, int priority);
     ~PCAjob();
     void computeCov();
     void computeSVD();
+    bool isDone() const;
 
-    float** cov;
-    SorterSpikeArray spikes;
-    float* pc1, *pc2;
-    std::atomic<float>& pc1min, &pc2min, &pc1max, &pc2max;
-    std::atomic<bool>& reportDone;
+    /** The electrode the job is for: a newer job with the same owner replaces a pending one */
+    const void* owner;
+    /** Jobs with a higher priority are computed first */
+    int priority;
+
+    std::vector<float> waveforms;
+    int numSpikes;
+    int dim;
+
+    std::vector<float> pc1, pc2;
+    float pc1min, pc2min, pc1max, pc2max;
+    std::atomic<bool> done;
 private:
     int svdcmp(float** a, int nRows, int nCols, float* w, float** v);
     float pythag(float a, float b);
+    std::vector<float> cov;
+};
+
+/** Online estimate of the first two principal components of spike waveforms, by candid
+covariance-free incremental PCA (CCIPCA, Weng et al. 2003). Each spike costs O(dim), and the
+learning rate never drops below a floor, so the components follow slow drifts of the waveforms. */
+class IncrementalPCA
+{
+public:
+    IncrementalPCA();
+    void resize(int dim);
+    void reset();
+
+    /** Continues from known components, e.g. loaded with the settings. Their directions are
+    kept for warmupSpikes spikes, while their variances are estimated. */
+    void setComponents(const float* pc1, const float* pc2, int warmupSpikes);
+
+    void update(const float* waveform);
+
+    /** Writes the unit length components */
+    void getComponents(float* pc1, float* pc2) const;
+
+    int getNumSpikes() const;
+private:
     int dim;
+    int numSpikes;
+    int numWarmupSpikes;
+    std::vector<double> mean;
+    std::vector<double> residual;
+    std::vector<double> components[2];
+    double warmupVariance[2];
 };
 
 typedef ReferenceCountedObjectPtr<PCAjob> PCAJobPtr;
@@ -211,16 +254,52 @@ public:
 
 
 
-class PCAcomputingThread : juce::Thread
+/** Worker threads shared by all the electrodes of a sorter, which compute the PCA jobs */
+class PCAcomputingPool
 {
 public:
-    PCAcomputingThread();
-    void run(); // computes PCA on waveforms
+    PCAcomputingPool();
+    ~PCAcomputingPool();
+
+    /** Queues a job, starting the workers the first time */
     void addPCAjob(PCAJobPtr job);
 
 private:
+    class Worker : public Thread
+    {
+    public:
+        Worker(PCAcomputingPool& pool, int index);
+        void run() override; // computes PCA on waveforms
+    private:
+        PCAcomputingPool& pool;
+    };
+
+    PCAJobPtr getNextJob();
+
+    OwnedArray<Worker> workers;
     PCAJobArray jobs;
 	CriticalSection lock;
+    WaitableEvent jobAdded;
+};
+
+class SpikeSortBoxes;
+
+/** Background thread that adds the sorted spikes of all the electrodes of a sorter to the waveform
+statistics of their units, so the processing thread only queues them */
+class UnitStatsThread : public Thread
+{
+public:
+    UnitStatsThread();
+    ~UnitStatsThread();
+
+    /** Starts draining the queue of an electrode, starting the thread the first time */
+    void addSorter(SpikeSortBoxes* sorter);
+    void removeSorter(SpikeSortBoxes* sorter);
+
+    void run() override;
+private:
+    Array<SpikeSortBoxes*> sorters;
+    CriticalSection lock;
 };
 
 class PCAUnit
@@ -247,21 +326,81 @@ public:
     Time timer;
 };
 
+/** The units of an electrode compiled for sorting: the boxes are flattened into arrays of bounds
+with their ranges of waveform bins, and the polygons into edge tables with their offsets applied.
+The mean waveforms of the units are kept as templates for template matching. A new one is built
+whenever the units are edited, or every few sorted spikes to follow the templates, and is never
+changed afterwards, so spikes are sorted without holding the lock of the units. */
+class SortingUnits : public ReferenceCountedObject
+{
+public:
+    SortingUnits(const std::vector<BoxUnit>& boxUnits, const std::vector<PCAUnit>& pcaUnits,
+                 int numChannels, float sampleRate, int waveformLength);
+
+    /** Whether the bins were computed for waveforms of this spike's length and sample rate */
+    bool matches(const SorterSpikeContainer* so) const;
+
+    /** Returns the index of the first box unit all of whose boxes the waveform crosses, or -1 */
+    int findBoxUnit(const float* waveform) const;
+
+    /** Returns the index of the first PCA unit whose polygon contains the point, or -1 */
+    int findPCAUnit(float x, float y) const;
+
+    /** Returns the index of the template nearest to the waveform, or -1 if the waveform is
+    further from all of them than their spikes usually are */
+    int findTemplateUnit(const float* waveform) const;
+
+    struct Unit
+    {
+        int unitID;
+        uint8 color[3];
+    };
+    std::vector<Unit> boxUnits, pcaUnits, templateUnits;
+
+private:
+    void addTemplate(const Unit& unit, const RunningStats& stats);
+    bool isWaveformInsideBox(const float* waveform, int box) const;
+    bool isPointInsidePolygon(int polygon, PointD p) const;
+
+    int numChannels, waveformLength;
+    float sampleRate;
+    std::vector<float> binTimes;
+
+    // box unit k has the boxes [unitBoxes[k], unitBoxes[k+1])
+    std::vector<int> unitBoxes;
+    std::vector<int> boxChannel, boxBinLeft, boxBinRight;
+    std::vector<PointD> boxTopLeft, boxBottomRight;
+
+    // polygon k has the edges [polygonEdges[k], polygonEdges[k+1])
+    std::vector<int> polygonEdges;
+    std::vector<PointD> polygonMin, polygonMax;
+    std::vector<PointD> edgeStart, edgeEnd;
+
+    // template k is [k * numChannels * waveformLength, (k + 1) * numChannels * waveformLength)
+    std::vector<float> templates;
+    std::vector<float> templateMaxDistance;
+};
+typedef ReferenceCountedObjectPtr<SortingUnits> SortingUnitsPtr;
+
 // Sort spikes from a single electrode (which could have any number of channels)
 // using the box method. Any electrode could have an arbitrary number of units specified.
 // Each unit is defined by a set of boxes, which can be placed on any of the given channels.
 class SpikeSortBoxes
 {
 public:
-    SpikeSortBoxes(UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingThread* pth, int numch, double SamplingRate, int WaveFormLength);
+    SpikeSortBoxes(UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingPool* pth, UnitStatsThread* statsThread_, int numch, double SamplingRate, int WaveFormLength);
     ~SpikeSortBoxes();
 
     void resizeWaveform(int numSamples);
 
 
 	void projectOnPrincipalComponents(SorterSpikePtr so);
-	bool sortSpike(SorterSpikePtr so, bool PCAfirst);
-    void RePCA();
+	/** Assigns the spike to the first unit whose boxes or polygon it falls in. With template
+	matching, spikes outside all of them go to the unit with the nearest mean waveform. */
+	bool sortSpike(SorterSpikePtr so, bool PCAfirst, bool templateMatching = false);
+    /** Recomputes the components from the buffered spikes on the PCA workers, first for
+    electrodes that are being displayed */
+    void RePCA(bool isVisible = true);
     void addPCAunit(PCAUnit unit);
     int addBoxUnit(int channel);
     int addBoxUnit(int channel, Box B);
@@ -292,20 +431,55 @@ public:
     void getSelectedUnitAndBox(int& unitID, int& boxid);
     void saveCustomParametersToXml(XmlElement* electrodeNode);
     void loadCustomParametersFromXml(XmlElement* electrodeNode);
+
+    /** Adds the queued sorted spikes to the statistics of their units. Called by the UnitStatsThread. */
+    void updateUnitStats();
 private:
+    /** Sets the PCA display range from the projections of the buffered spikes */
+    void updatePCArange();
+
+    /** Builds the sorting units from the current units, and swaps them in. Called with mut held,
+    after any edit of the units. */
+    void compileUnits();
+
+    /** Slow path for spikes the compiled units do not match, testing the units themselves */
+    bool sortSpikeWithUnits(SorterSpikePtr so, bool PCAfirst);
+
+    /** Queues a sorted spike for the waveform statistics of its unit. The templates are refreshed
+    every few spikes if they are used. */
+    void queueUnitSpike(int unitID, SorterSpikePtr so, bool refreshTemplates);
+
     //void  StartCriticalSection();
     //void  EndCriticalSection();
     UniqueIDgenerator* uniqueIDgenerator;
     int numChannels, waveformLength;
+    float sampleRate;
     int selectedUnit, selectedBox;
     CriticalSection mut;
     std::vector<BoxUnit> boxUnits;
     std::vector<PCAUnit> pcaUnits;
+    SortingUnitsPtr sortingUnits;
+    SpinLock sortingUnitsLock;
+    int spikesSinceCompile;
+
+    struct QueuedSpike
+    {
+        SorterSpikePtr spike;
+        int unitID;
+        bool refreshTemplates;
+    };
+    // sorted spikes from the processing thread to the UnitStatsThread
+    AbstractFifo statsFifo;
+    std::vector<QueuedSpike> statsQueue;
+    UnitStatsThread* statsThread;
     float* pc1, *pc2;
     std::atomic<float> pc1min, pc2min, pc1max, pc2max;
     SorterSpikeArray spikeBuffer;
     int bufferSize,spikeBufferIndex;
-    PCAcomputingThread* computingThread;
+    IncrementalPCA pca;
+    PCAcomputingPool* computingThread;
+    PCAJobPtr pcaJob;
+    std::atomic<int> rePCApriority;
     bool bPCAJobSubmitted,bPCAcomputed,bRePCA;
     std::atomic<bool> bPCAjobFinished ;
 
@@ -47,6 +47,7 @@ SpikeSorter::SpikeSorter()
     autoDACassignment = false;
     syncThresholds = false;
     flipSignal = false;
+    templateMatching = false;
 }
 
 bool SpikeSorter::getFlipSignalState()
@@ -70,6 +71,16 @@ void SpikeSorter::setFlipSignalState(bool state)
 
 }
 
+bool SpikeSorter::getTemplateMatchingState()
+{
+    return templateMatching;
+}
+
+void SpikeSorter::setTemplateMatchingState(bool state)
+{
+    templateMatching = state;
+}
+
 int SpikeSorter::getNumPreSamples()
 {
     return numPreSamples;
@@ -193,6 +204,13 @@ void SpikeSorter::updateSettings()
     double ContinuousBufferLengthSec = 5;
     channelBuffers = new ContinuousCircularBuffer(numChannels,SamplingRate,1, ContinuousBufferLengthSec);
 
+    int maxChannels = 1;
+    for (int i = 0; i < electrodes.size(); i++)
+        maxChannels = jmax(maxChannels, electrodes[i]->numChannels);
+
+    spikeThresholds.malloc(maxChannels);
+    spikeBuffers.clear();
+
 
     for (int i = 0; i < electrodes.size(); i++)
     {
@@ -215,8 +233,10 @@ void SpikeSorter::updateSettings()
 		SpikeChannel* spk = new SpikeChannel(SpikeChannel::typeFromNumChannels(nChans), this, chans);
 		spk->setNumSamples(elec->prePeakSamples, elec->postPeakSamples);
 		spk->addEventMetaData(new MetaDataDescriptor(MetaDataDescriptor::UINT8, 3, "Color", "Color of the spike", "graphics.color"));
+		spk->addEventMetaData(new MetaDataDescriptor(MetaDataDescriptor::FLOAT, 2, "PCA", "Projections on the first two principal components", SPIKE_PCA_METADATA_ID));
 
         spikeChannelArray.add(spk);
+        spikeBuffers.add(new SpikeEvent::SpikeBuffer(spk));
     }
 	sorterReady = true;
     mut.exit();
@@ -232,10 +252,11 @@ Electrode::~Electrode()
     delete[] runningStats;
 }
 
-Electrode::Electrode(int ID, UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingThread* pth, String _name, int _numChannels, int* _channels, float default_threshold, int pre, int post, float samplingRate , int sourceId, int subIdx)
+Electrode::Electrode(int ID, UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingPool* pth, UnitStatsThread* statsThread_, String _name, int _numChannels, int* _channels, float default_threshold, int pre, int post, float samplingRate , int sourceId, int subIdx)
 {
     electrodeID = ID;
     computingThread = pth;
+    statsThread = statsThread_;
     uniqueIDgenerator = uniqueIDgenerator_;
     name = _name;
 	sourceNodeId_ = sourceId;
@@ -264,7 +285,7 @@ Electrode::Electrode(int ID, UniqueIDgenerator* uniqueIDgenerator_, PCAcomputing
     spikePlot = nullptr;
 
     if (computingThread != nullptr)
-        spikeSort = new SpikeSortBoxes(uniqueIDgenerator, computingThread, numChannels, samplingRate, pre+post);
+        spikeSort = new SpikeSortBoxes(uniqueIDgenerator, computingThread, statsThread, numChannels, samplingRate, pre+post);
     else
         spikeSort = nullptr;
 
@@ -459,7 +480,7 @@ bool SpikeSorter::addElectrode(int nChans, String name, double Depth)
     for (int k = 0; k < nChans; k++)
         chans[k] = firstChan + k;
 
-    Electrode* newElectrode = new Electrode(++uniqueID, &uniqueIDgenerator, &computingThread, name, nChans, chans, getDefaultThreshold(),
+    Electrode* newElectrode = new Electrode(++uniqueID, &uniqueIDgenerator, &computingThread, &unitStatsThread, name, nChans, chans, getDefaultThreshold(),
 		numPreSamples, numPostSamples, getSampleRate(), dataChannelArray[chans[0]]->getSourceNodeID(), dataChannelArray[chans[0]]->getSubProcessorIdx());
 
     newElectrode->depthOffsetMM = Depth;
@@ -935,15 +956,14 @@ void SpikeSorter::process(AudioSampleBuffer& buffer)
                         sampleIndex -= (electrode->prePeakSamples+1);
 
 						const SpikeChannel* spikeChan = getSpikeChannel(i);
-						SpikeEvent::SpikeBuffer spikeData(spikeChan);
-						Array<float> thresholds;
+						SpikeEvent::SpikeBuffer& spikeData = *spikeBuffers[i];
 						for (int channel = 0; channel < electrode->numChannels; ++channel)
 						{
 							addWaveformToSpikeObject(spikeData,
 								peakIndex,
 								i,
 								channel);
-							thresholds.add((int)*(electrode->thresholds + channel));
+							spikeThresholds[channel] = (int)*(electrode->thresholds + channel);
 						}
 						int64 timestamp = getTimestamp(electrode->channels[0]) + peakIndex;
 
@@ -965,7 +985,7 @@ void SpikeSorter::process(AudioSampleBuffer& buffer)
 						electrode->spikeSort->projectOnPrincipalComponents(sorterSpike);
 
                         // Add spike to drawing buffer....
-						electrode->spikeSort->sortSpike(sorterSpike, PCAbeforeBoxes);
+						electrode->spikeSort->sortSpike(sorterSpike, PCAbeforeBoxes, templateMatching);
 
 
                         // transfer buffered spikes to spike plot
@@ -983,11 +1003,11 @@ void SpikeSorter::process(AudioSampleBuffer& buffer)
 							electrode->spikePlot->processSpikeObject(sorterSpike);
                         }
 
-						MetaDataValueArray md;
-						md.add(new MetaDataValue(MetaDataDescriptor::UINT8, 3, sorterSpike->color));
-						SpikeEventPtr newSpike = SpikeEvent::createSpikeEvent(spikeChan, timestamp, thresholds, spikeData, sorterSpike->sortedId, md);
-
-                        addSpike(spikeChan, newSpike, peakIndex);
+						// the event metadata of the spike channels are the color followed by the projections
+						uint8 metaData[sizeof(sorterSpike->color) + sizeof(sorterSpike->pcProj)];
+						memcpy(metaData, sorterSpike->color, sizeof(sorterSpike->color));
+						memcpy(metaData + sizeof(sorterSpike->color), sorterSpike->pcProj, sizeof(sorterSpike->pcProj));
+						addSpike(spikeChan, timestamp, spikeThresholds, spikeData, sorterSpike->sortedId, peakIndex, metaData);
                         //prevSpike = newSpike;
                         // advance the sample index
                         sampleIndex = peakIndex + electrode->postPeakSamples;
@@ -1193,6 +1213,7 @@ void SpikeSorter::saveCustomParametersToXml(XmlElement* parentElement)
     mainNode->setAttribute("syncThresholds",syncThresholds);
     mainNode->setAttribute("uniqueID",uniqueID);
     mainNode->setAttribute("flipSignal",flipSignal);
+    mainNode->setAttribute("templateMatching",templateMatching);
 
     XmlElement* countNode = mainNode->createNewChildElement("ELECTRODE_COUNTER");
 
@@ -1255,6 +1276,7 @@ void SpikeSorter::loadCustomParametersFromXml()
                 syncThresholds = mainNode->getBoolAttribute("syncThresholds");
                 uniqueID = mainNode->getIntAttribute("uniqueID");
                 flipSignal = mainNode->getBoolAttribute("flipSignal");
+                templateMatching = mainNode->getBoolAttribute("templateMatching");
 
                 forEachXmlChildElement(*mainNode, xmlNode)
                 {
@@ -1307,7 +1329,7 @@ void SpikeSorter::loadCustomParametersFromXml()
 
                         int sourceNodeId = 102010; // some number
 
-                        Electrode* newElectrode = new Electrode(electrodeID, &uniqueIDgenerator,&computingThread, electrodeName, channelsPerElectrode, channels,getDefaultThreshold(),
+                        Electrode* newElectrode = new Electrode(electrodeID, &uniqueIDgenerator,&computingThread, &unitStatsThread, electrodeName, channelsPerElectrode, channels,getDefaultThreshold(),
                                                                 numPreSamples,numPostSamples, getSampleRate(), sourceNodeId,0);
                         for (int k=0; k<channelsPerElectrode; k++)
                         {
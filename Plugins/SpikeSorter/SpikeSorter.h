@@ -64,7 +64,7 @@ public:
 */
 
 class PCAjob;
-class PCAcomputingThread;
+class PCAcomputingPool;
 class UniqueIDgenerator
 {
 public:
@@ -148,7 +148,7 @@ private:
 class Electrode
 {
 public:
-    Electrode(int electrodeID, UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingThread* pth,String _name, int _numChannels, int* _channels, float default_threshold, int pre, int post, float samplingRate , int sourceNodeId, int sourceSubIdx);
+    Electrode(int electrodeID, UniqueIDgenerator* uniqueIDgenerator_, PCAcomputingPool* pth, UnitStatsThread* statsThread_, String _name, int _numChannels, int* _channels, float default_threshold, int pre, int post, float samplingRate , int sourceNodeId, int sourceSubIdx);
     ~Electrode();
 
     void resizeWaveform(int numPre, int numPost);
@@ -174,7 +174,8 @@ public:
     RunningStat* runningStats;
     SpikeHistogramPlot* spikePlot;
     
-    PCAcomputingThread* computingThread;
+    PCAcomputingPool* computingThread;
+    UnitStatsThread* statsThread;
     UniqueIDgenerator* uniqueIDgenerator;
 
 	ScopedPointer<SpikeSortBoxes> spikeSort;
@@ -353,6 +354,10 @@ public:
     void setThresholdSyncStatus(bool status);
     bool getFlipSignalState();
     void setFlipSignalState(bool state);
+    /** With template matching, spikes outside all boxes and polygons are assigned to the unit
+    with the nearest mean waveform */
+    bool getTemplateMatchingState();
+    void setTemplateMatchingState(bool state);
     void startRecording();
     std::vector<float> getElectrodeVoltageScales(int electrodeID);
     //void getElectrodePCArange(int electrodeID, float &minX,float &maxX,float &minY,float &maxY);
@@ -431,6 +436,7 @@ private:
     bool syncThresholds;
  //   RHD2000Thread* getRhythmAccess();
     bool flipSignal;
+    bool templateMatching;
 
 	bool sorterReady{ false };
 
@@ -442,8 +448,14 @@ private:
                                   int& currentChannel);
 
 
+    // declared before the electrodes, which stop using it when they are deleted
+    UnitStatsThread unitStatsThread;
     OwnedArray<Electrode> electrodes;
-    PCAcomputingThread computingThread;
+    PCAcomputingPool computingThread;
+
+    /** Waveform buffer of each spike channel and the thresholds of a spike, reused for every spike */
+    OwnedArray<SpikeEvent::SpikeBuffer> spikeBuffers;
+    HeapBlock<float> spikeThresholds;
 
     bool editAll = false;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpikeSorter);
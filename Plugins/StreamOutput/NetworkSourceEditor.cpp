@@ -0,0 +1,160 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "NetworkSourceEditor.h"
+#include "NetworkSourceThread.h"
+
+
+ConnectionMonitor::ConnectionMonitor (NetworkSourceEditor* editor_, NetworkSourceThread* thread_)
+    : Label ("Status", String())
+    , editor (editor_)
+    , thread (thread_)
+{
+    startTimer (1000);
+}
+
+
+void ConnectionMonitor::timerCallback()
+{
+    if (! CoreServices::getAcquisitionStatus())
+        thread->foundInputSource();
+
+    editor->updateStatus();
+}
+
+
+NetworkSourceEditor::NetworkSourceEditor (SourceNode* parentNode, NetworkSourceThread* thread_)
+    : GenericEditor (parentNode, false)
+    , thread (thread_)
+    , layoutVersion (thread_->getLayoutVersion())
+{
+    desiredWidth = 180;
+
+    hostText = createLabel ("Host Text", "Host:", 10, 30, 40, false);
+    hostLabel = createLabel ("Host", thread->getHost(), 50, 30, 120, true);
+    hostLabel->setTooltip ("Computer running the Stream Output to acquire from");
+
+    portText = createLabel ("Port Text", "Port:", 10, 55, 40, false);
+    portLabel = createLabel ("Port", String (thread->getPort()), 50, 55, 60, true);
+    portLabel->setTooltip ("TCP port of the Stream Output");
+
+    statusLabel = new ConnectionMonitor (this, thread);
+    statusLabel->setFont (Font ("Small Text", 10, Font::plain));
+    statusLabel->setBounds (10, 85, 160, 20);
+    statusLabel->setColour (Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible (statusLabel);
+
+    updateStatus();
+}
+
+
+NetworkSourceEditor::~NetworkSourceEditor()
+{
+}
+
+
+Label* NetworkSourceEditor::createLabel (const String& name, const String& text, int x, int y, int width, bool editable)
+{
+    Label* label = new Label (name, text);
+    label->setEditable (editable);
+    label->setJustificationType (Justification::centredLeft);
+    label->setBounds (x, y, width, 20);
+
+    if (editable)
+    {
+        label->setColour (Label::backgroundColourId, Colours::grey);
+        label->setColour (Label::textColourId, Colours::white);
+        label->addListener (this);
+    }
+
+    addAndMakeVisible (label);
+    return label;
+}
+
+
+void NetworkSourceEditor::labelTextChanged (Label*)
+{
+    if (acquisitionIsActive)
+    {
+        CoreServices::sendStatusMessage ("Can't change the network source while acquisition is active!");
+    }
+    else
+    {
+        thread->setAddress (hostLabel->getText(), portLabel->getText().getIntValue());
+        updateStatus();
+    }
+
+    hostLabel->setText (thread->getHost(), dontSendNotification);
+    portLabel->setText (String (thread->getPort()), dontSendNotification);
+}
+
+
+void NetworkSourceEditor::updateStatus()
+{
+    if (thread->isConnected())
+        statusLabel->setText (String (thread->getNumChannels()) + " ch in "
+                              + String (thread->getNumSubProcessors()) + " streams", dontSendNotification);
+    else
+        statusLabel->setText ("Waiting for stream", dontSendNotification);
+
+    if (layoutVersion != thread->getLayoutVersion())
+    {
+        layoutVersion = thread->getLayoutVersion();
+        CoreServices::updateSignalChain (this);
+    }
+}
+
+
+void NetworkSourceEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+    hostLabel->setEditable (false);
+    portLabel->setEditable (false);
+}
+
+
+void NetworkSourceEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+    hostLabel->setEditable (true);
+    portLabel->setEditable (true);
+}
+
+
+void NetworkSourceEditor::saveCustomParameters (XmlElement* xml)
+{
+    xml->setAttribute ("Host", thread->getHost());
+    xml->setAttribute ("Port", thread->getPort());
+}
+
+
+void NetworkSourceEditor::loadCustomParameters (XmlElement* xml)
+{
+    thread->setAddress (xml->getStringAttribute ("Host", NETWORK_SOURCE_DEFAULT_HOST),
+                        xml->getIntAttribute ("Port", STREAM_DEFAULT_PORT));
+
+    hostLabel->setText (thread->getHost(), dontSendNotification);
+    portLabel->setText (String (thread->getPort()), dontSendNotification);
+    updateStatus();
+}
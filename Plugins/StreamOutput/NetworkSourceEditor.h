@@ -0,0 +1,88 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __NETWORKSOURCEEDITOR_H_5C81E0B4__
+#define __NETWORKSOURCEEDITOR_H_5C81E0B4__
+
+#include <EditorHeaders.h>
+
+class SourceNode;
+class NetworkSourceThread;
+class NetworkSourceEditor;
+
+/** Shows the connection state, trying to connect while there is none */
+class ConnectionMonitor : public Label
+                        , private Timer
+{
+public:
+    ConnectionMonitor (NetworkSourceEditor* editor, NetworkSourceThread* thread);
+
+private:
+    void timerCallback() override;
+
+    NetworkSourceEditor* editor;
+    NetworkSourceThread* thread;
+};
+
+/**
+    Selects the StreamOutput the NetworkSourceThread connects to, and shows its layout.
+
+    The signal chain is updated whenever a connection brings a different layout.
+
+    @see NetworkSourceThread
+*/
+class NetworkSourceEditor : public GenericEditor
+                          , public Label::Listener
+{
+public:
+    NetworkSourceEditor (SourceNode* parentNode, NetworkSourceThread* thread);
+    ~NetworkSourceEditor();
+
+    void labelTextChanged (Label* label) override;
+
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+    void saveCustomParameters (XmlElement* xml) override;
+    void loadCustomParameters (XmlElement* xml) override;
+
+    /** Shows the connection state, and updates the chain when the layout changed */
+    void updateStatus();
+
+private:
+    Label* createLabel (const String& name, const String& text, int x, int y, int width, bool editable);
+
+    NetworkSourceThread* thread;
+    int layoutVersion;
+
+    ScopedPointer<Label> hostText;
+    ScopedPointer<Label> hostLabel;
+    ScopedPointer<Label> portText;
+    ScopedPointer<Label> portLabel;
+    ScopedPointer<ConnectionMonitor> statusLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NetworkSourceEditor);
+};
+
+#endif  // __NETWORKSOURCEEDITOR_H_5C81E0B4__
@@ -0,0 +1,550 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "NetworkSourceThread.h"
+#include "NetworkSourceEditor.h"
+
+#define NETWORK_SOURCE_BUFFER_SAMPLES 10000
+
+/* Samples of the largest continuous frame expected, to size the event codes before acquisition */
+#define NETWORK_SOURCE_FRAME_SAMPLES 4096
+
+
+NetworkSourceThread::NetworkSourceThread (SourceNode* sn)
+    : DataThread (sn)
+    , host (NETWORK_SOURCE_DEFAULT_HOST)
+    , port (STREAM_DEFAULT_PORT)
+    , connected (0)
+    , layoutVersion (0)
+    , eventCodesSize (0)
+    , droppedSamples (0)
+{
+    sourceBuffers.add (new DataBuffer (0, NETWORK_SOURCE_BUFFER_SAMPLES));
+}
+
+
+NetworkSourceThread::~NetworkSourceThread()
+{
+    disconnect();
+}
+
+
+GenericEditor* NetworkSourceThread::createEditor (SourceNode* sn)
+{
+    return new NetworkSourceEditor (sn, this);
+}
+
+
+bool NetworkSourceThread::foundInputSource()
+{
+    if (isThreadRunning())
+        return connected.get() != 0;
+
+    if (socket == nullptr)
+        return connect();
+
+    // the publisher closes the connection when its acquisition stops; until then only
+    // descriptions, and the last data frames sent before the subscription changed, arrive
+    while (socket->waitUntilReady (true, 0) == 1)
+    {
+        StreamFrameHeader header;
+
+        if (! readFrame (header))
+            return connect();
+
+        if (header.topic == STREAM_DESCRIPTION)
+            readDescription (header);
+    }
+
+    return true;
+}
+
+
+bool NetworkSourceThread::connect()
+{
+    disconnect();
+
+    ScopedPointer<StreamingSocket> newSocket = new StreamingSocket();
+
+    if (! newSocket->connect (host, port, NETWORK_SOURCE_CONNECT_TIMEOUT))
+        return false;
+
+    socket = newSocket.release();
+
+    // only the layout is needed until acquisition starts; a publisher sending data to
+    // a socket nobody reads would stall once its buffers are full
+    if (! subscribe (1 << STREAM_DESCRIPTION))
+    {
+        disconnect();
+        return false;
+    }
+
+    const uint32 deadline = Time::getMillisecondCounter() + NETWORK_SOURCE_DESCRIPTION_TIMEOUT;
+
+    for (uint32 now = Time::getMillisecondCounter(); now < deadline; now = Time::getMillisecondCounter())
+    {
+        StreamFrameHeader header;
+
+        if (socket->waitUntilReady (true, (int) (deadline - now)) != 1 || ! readFrame (header))
+            break;
+
+        if (header.topic != STREAM_DESCRIPTION)
+            continue;
+
+        if (! readDescription (header))
+            break;
+
+        connected = 1;
+
+        std::cout << "Network source connected to " << host << ":" << port << ": "
+                  << subProcessors.size() << " subprocessors, " << getNumChannels() << " channels." << std::endl;
+        return true;
+    }
+
+    std::cout << "Network source: " << host << ":" << port << " sent no valid stream description." << std::endl;
+    disconnect();
+    return false;
+}
+
+
+void NetworkSourceThread::disconnect()
+{
+    connected = 0;
+    socket = nullptr;
+}
+
+
+bool NetworkSourceThread::subscribe (int topics)
+{
+    const uint8 mask = (uint8) topics;
+    return socket->write (&mask, 1) == 1;
+}
+
+
+bool NetworkSourceThread::readFrame (StreamFrameHeader& header)
+{
+    if (socket->read (&header, sizeof (header), true) != (int) sizeof (header))
+        return false;
+
+    if (header.magic != STREAM_FRAME_MAGIC || header.version != STREAM_FORMAT_VERSION)
+    {
+        std::cout << "Network source: " << host << ":" << port << " is not a stream of this version." << std::endl;
+        return false;
+    }
+
+    if (payload.getSize() < header.payloadSize)
+        payload.setSize (header.payloadSize, false);
+
+    return header.payloadSize == 0
+        || socket->read (payload.getData(), (int) header.payloadSize, true) == (int) header.payloadSize;
+}
+
+
+bool NetworkSourceThread::readDescription (const StreamFrameHeader& header)
+{
+    MemoryBlock newDescription (payload.getData(), header.payloadSize);
+
+    if (newDescription == description && subProcessors.size() == (int) header.numChannels)
+        return true;
+
+    MemoryInputStream stream (newDescription, false);
+    OwnedArray<RemoteSubProcessor> layout;
+    int numChannels = 0;
+
+    for (uint32 i = 0; i < header.numChannels; i++)
+    {
+        RemoteSubProcessor* sub = layout.add (new RemoteSubProcessor());
+
+        if (stream.read (&sub->info, sizeof (sub->info)) != (int) sizeof (sub->info))
+            return false;
+
+        const int subChannels = (int) sub->info.numChannels;
+        numChannels += subChannels;
+
+        // every channel takes its bitVolts and at least the terminator of its name
+        if (subChannels <= 0 || numChannels > NETWORK_SOURCE_MAX_CHANNELS || sub->info.sampleRate <= 0.0f
+            || stream.getNumBytesRemaining() < (juce::int64) (sizeof (float) + 1) * subChannels)
+            return false;
+
+        for (int ch = 0; ch < subChannels; ch++)
+            sub->bitVolts.add (stream.readFloat());
+
+        for (int ch = 0; ch < subChannels; ch++)
+            sub->names.add (stream.readString());
+
+        sub->info.numTTLLines = jmin (sub->info.numTTLLines, (uint32) 64);
+        sub->ttlWord = 0;
+    }
+
+    subProcessors.swapWith (layout);
+    description = newDescription;
+
+    bitVolts.clearQuick();
+
+    for (const RemoteSubProcessor* sub : subProcessors)
+        for (float scale : sub->bitVolts)
+            bitVolts.add (scale > 0.0f ? scale : 1.0f);
+
+    ++layoutVersion;
+    return true;
+}
+
+
+void NetworkSourceThread::setAddress (const String& newHost, int newPort)
+{
+    host = newHost.trim();
+    port = jlimit (1, 65535, newPort);
+    connect();
+}
+
+
+String NetworkSourceThread::getHost() const
+{
+    return host;
+}
+
+
+int NetworkSourceThread::getPort() const
+{
+    return port;
+}
+
+
+bool NetworkSourceThread::isConnected() const
+{
+    return connected.get() != 0;
+}
+
+
+int NetworkSourceThread::getNumChannels() const
+{
+    return bitVolts.size();
+}
+
+
+int NetworkSourceThread::getLayoutVersion() const
+{
+    return layoutVersion.get();
+}
+
+
+juce::int64 NetworkSourceThread::getNumDroppedSamples() const
+{
+    return droppedSamples;
+}
+
+
+unsigned int NetworkSourceThread::getNumSubProcessors() const
+{
+    return (unsigned int) jmax (1, subProcessors.size());
+}
+
+
+int NetworkSourceThread::getNumDataOutputs (DataChannel::DataChannelTypes type, int subProcessor) const
+{
+    if (type == DataChannel::HEADSTAGE_CHANNEL && isPositiveAndBelow (subProcessor, subProcessors.size()))
+        return (int) subProcessors[subProcessor]->info.numChannels;
+
+    return 0;
+}
+
+
+int NetworkSourceThread::getNumTTLOutputs (int subProcessor) const
+{
+    if (isPositiveAndBelow (subProcessor, subProcessors.size()))
+        return (int) subProcessors[subProcessor]->info.numTTLLines;
+
+    return 0;
+}
+
+
+float NetworkSourceThread::getSampleRate (int subProcessor) const
+{
+    if (isPositiveAndBelow (subProcessor, subProcessors.size()))
+        return subProcessors[subProcessor]->info.sampleRate;
+
+    return 30000.0f;
+}
+
+
+float NetworkSourceThread::getBitVolts (const DataChannel* chan) const
+{
+    const int index = chan->getSourceTypeIndex();
+    return isPositiveAndBelow (index, bitVolts.size()) ? bitVolts[index] : 1.0f;
+}
+
+
+bool NetworkSourceThread::usesCustomNames() const
+{
+    return true;
+}
+
+
+void NetworkSourceThread::setDefaultChannelNames()
+{
+    int channel = 0;
+
+    for (const RemoteSubProcessor* sub : subProcessors)
+    {
+        for (int i = 0; i < sub->names.size() && channel < channelInfo.size(); i++)
+        {
+            ChannelCustomInfo& info = channelInfo.getReference (channel);
+            info.name = sub->names[i];
+            info.gain = bitVolts[channel];
+            channel++;
+        }
+    }
+}
+
+
+void NetworkSourceThread::resizeBuffers()
+{
+    const int numSubProcessors = (int) getNumSubProcessors();
+
+    while (sourceBuffers.size() < numSubProcessors)
+        sourceBuffers.add (new DataBuffer (0, NETWORK_SOURCE_BUFFER_SAMPLES));
+
+    while (sourceBuffers.size() > numSubProcessors)
+        sourceBuffers.removeLast();
+
+    for (int i = 0; i < numSubProcessors; i++)
+        resizeSourceBuffer (i, getNumDataOutputs (DataChannel::HEADSTAGE_CHANNEL, i));
+}
+
+
+bool NetworkSourceThread::startAcquisition()
+{
+    if (socket == nullptr && ! connect())
+        return false;
+
+    for (RemoteSubProcessor* sub : subProcessors)
+    {
+        sub->ttlWord = 0;
+        sub->pendingTTL.clearQuick();
+        sub->pendingTTL.ensureStorageAllocated (256);
+    }
+
+    for (DataBuffer* buffer : sourceBuffers)
+        buffer->clear();
+
+    if (eventCodesSize < NETWORK_SOURCE_FRAME_SAMPLES)
+    {
+        eventCodes.allocate (NETWORK_SOURCE_FRAME_SAMPLES, false);
+        eventCodesSize = NETWORK_SOURCE_FRAME_SAMPLES;
+    }
+
+    droppedSamples = 0;
+
+    if (! subscribe ((1 << STREAM_CONTINUOUS) | (1 << STREAM_EVENT) | (1 << STREAM_DESCRIPTION)))
+    {
+        disconnect();
+        return false;
+    }
+
+    startThread();
+    return true;
+}
+
+
+bool NetworkSourceThread::stopAcquisition()
+{
+    if (isThreadRunning())
+        signalThreadShouldExit();
+
+    if (! waitForThreadToExit (500))
+        std::cout << "Network source thread failed to exit, continuing anyway..." << std::endl;
+
+    if (socket != nullptr && ! subscribe (1 << STREAM_DESCRIPTION))
+        disconnect();
+
+    for (DataBuffer* buffer : sourceBuffers)
+        buffer->clear();
+
+    if (droppedSamples > 0)
+        std::cout << "Network source dropped " << droppedSamples
+                  << " samples that arrived while its buffers were full." << std::endl;
+
+    return true;
+}
+
+
+bool NetworkSourceThread::updateBuffer()
+{
+    const int ready = socket->waitUntilReady (true, 100);
+
+    if (ready == 0)
+        return true;
+
+    StreamFrameHeader header;
+
+    if (ready < 0 || ! readFrame (header))
+    {
+        std::cout << "Network source lost the stream from " << host << ":" << port << std::endl;
+        connected = 0;
+        return false;
+    }
+
+    // the layout can't change while the StreamOutput acquires, so descriptions are skipped
+    if (header.topic == STREAM_CONTINUOUS)
+        addContinuous (header);
+    else if (header.topic == STREAM_EVENT)
+        addTTLEvent (header);
+
+    return true;
+}
+
+
+int NetworkSourceThread::findSubProcessor (uint16 sourceNodeId, uint16 subProcessorIdx) const
+{
+    for (int i = 0; i < subProcessors.size(); i++)
+    {
+        const StreamSubProcessorInfo& info = subProcessors.getUnchecked (i)->info;
+
+        if (info.sourceNodeId == sourceNodeId && info.subProcessorIdx == subProcessorIdx)
+            return i;
+    }
+
+    return -1;
+}
+
+
+void NetworkSourceThread::addTTLEvent (const StreamFrameHeader& header)
+{
+    const uint8* event = static_cast<const uint8*> (payload.getData());
+
+    if (header.payloadSize <= EVENT_BASE_SIZE || event[0] != PROCESSOR_EVENT || event[1] != EventChannel::TTL)
+        return;
+
+    const int index = findSubProcessor (header.sourceNodeId, header.subProcessorIdx);
+
+    if (index < 0)
+        return;
+
+    RemoteSubProcessor& sub = *subProcessors.getUnchecked (index);
+
+    // the line, then the TTL word after the edge, follow the event's timestamp
+    PendingTTL edge;
+    edge.timestamp = header.timestamp;
+    edge.line = *reinterpret_cast<const uint16*> (event + 16);
+
+    if (edge.line >= sub.info.numTTLLines || header.payloadSize <= (uint32) (EVENT_BASE_SIZE + edge.line / 8))
+        return;
+
+    edge.state = ((event[EVENT_BASE_SIZE + edge.line / 8] >> (edge.line % 8)) & 1) != 0;
+
+    // edges of different event channels may arrive out of order
+    int position = sub.pendingTTL.size();
+
+    while (position > 0 && sub.pendingTTL.getReference (position - 1).timestamp > edge.timestamp)
+        position--;
+
+    sub.pendingTTL.insert (position, edge);
+}
+
+
+void NetworkSourceThread::applyTTLEvents (RemoteSubProcessor& sub, juce::int64 timestamp, int numSamples)
+{
+    if (eventCodesSize < numSamples)
+    {
+        eventCodes.allocate ((size_t) numSamples, false);
+        eventCodesSize = numSamples;
+    }
+
+    uint64 word = sub.ttlWord;
+    int written = 0;
+    int applied = 0;
+
+    for (; applied < sub.pendingTTL.size(); applied++)
+    {
+        const PendingTTL& edge = sub.pendingTTL.getReference (applied);
+
+        if (edge.timestamp >= timestamp + numSamples)
+            break;
+
+        // edges from before the frame, whose samples were dropped, take effect at its first sample
+        const int offset = (int) jlimit ((juce::int64) 0, (juce::int64) numSamples, edge.timestamp - timestamp);
+
+        for (; written < offset; written++)
+            eventCodes[written] = word;
+
+        const uint64 bit = (uint64) 1 << edge.line;
+        word = edge.state ? (word | bit) : (word & ~bit);
+    }
+
+    for (; written < numSamples; written++)
+        eventCodes[written] = word;
+
+    sub.pendingTTL.removeRange (0, applied);
+    sub.ttlWord = word;
+}
+
+
+void NetworkSourceThread::addContinuous (const StreamFrameHeader& header)
+{
+    const int index = findSubProcessor (header.sourceNodeId, header.subProcessorIdx);
+
+    if (index < 0)
+        return;
+
+    RemoteSubProcessor& sub = *subProcessors.getUnchecked (index);
+    const int numSamples = (int) header.numSamples;
+
+    if (header.numChannels != sub.info.numChannels
+        || header.payloadSize != (size_t) header.numChannels * numSamples * sizeof (float))
+        return;
+
+    applyTTLEvents (sub, header.timestamp, numSamples);
+
+    DataBuffer* buffer = sourceBuffers[index];
+
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+    const int numItems = buffer->prepareToWrite (numSamples, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    copySamples (buffer, startIndex1, blockSize1, 0, header);
+
+    if (blockSize2 > 0)
+        copySamples (buffer, startIndex2, blockSize2, blockSize1, header);
+
+    buffer->finishedWrite (numItems, startIndex1);
+    droppedSamples += numSamples - numItems;
+}
+
+
+void NetworkSourceThread::copySamples (DataBuffer* buffer, int dstStart, int numSamples, int srcStart, const StreamFrameHeader& header)
+{
+    const float* samples = static_cast<const float*> (payload.getData());
+
+    float* const* channels = buffer->getChannelWritePointers();
+
+    for (uint32 ch = 0; ch < header.numChannels; ch++)
+        memcpy (channels[ch] + dstStart, samples + (size_t) ch * header.numSamples + srcStart, (size_t) numSamples * sizeof (float));
+
+    // the remote sample numbers, which the Synchronizer fits against the sync line
+    juce::int64* timestamps = buffer->getTimestampWritePointer() + dstStart;
+
+    for (int i = 0; i < numSamples; i++)
+        timestamps[i] = header.timestamp + srcStart + i;
+
+    memcpy (buffer->getEventCodeWritePointer() + dstStart, eventCodes + srcStart, (size_t) numSamples * sizeof (uint64));
+}
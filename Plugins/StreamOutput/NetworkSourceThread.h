@@ -0,0 +1,165 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __NETWORKSOURCETHREAD_H_7F3A2D90__
+#define __NETWORKSOURCETHREAD_H_7F3A2D90__
+
+#include <DataThreadHeaders.h>
+#include "StreamFormat.h"
+
+#define NETWORK_SOURCE_DEFAULT_HOST "localhost"
+
+/* Milliseconds to wait for a connection, and then for its DESCRIPTION frame */
+#define NETWORK_SOURCE_CONNECT_TIMEOUT 250
+#define NETWORK_SOURCE_DESCRIPTION_TIMEOUT 1000
+
+#define NETWORK_SOURCE_MAX_CHANNELS 16384
+
+/**
+    Acquires the continuous data and TTL events a StreamOutput on another computer
+    publishes over the network, so a rig can be split into several signal chains that
+    each filter and record their share of the channels.
+
+    Each subprocessor of the stream's DESCRIPTION becomes a subprocessor of this source,
+    with its sample rate, bitVolts and channel names. Samples keep the sample numbers of
+    the remote subprocessor as timestamps, and its TTL events come back on the same lines
+    at the same sample numbers, so the Synchronizer of a local RecordNode aligns them with
+    the other streams through a sync line shared by both computers.
+
+    The layout is read when connecting, which needs the StreamOutput to be acquiring.
+    Until acquisition starts here, only DESCRIPTION frames are subscribed to.
+
+    @see StreamOutput, StreamFormat.h
+*/
+class NetworkSourceThread : public DataThread
+{
+public:
+    NetworkSourceThread (SourceNode* sn);
+    ~NetworkSourceThread();
+
+    /** Connects to the stream if there is no connection yet, or checks that it is still open */
+    bool foundInputSource() override;
+
+    bool startAcquisition() override;
+    bool stopAcquisition() override;
+
+    unsigned int getNumSubProcessors() const override;
+    int getNumDataOutputs (DataChannel::DataChannelTypes type, int subProcessor) const override;
+    int getNumTTLOutputs (int subProcessor) const override;
+
+    float getSampleRate (int subProcessor) const override;
+    float getBitVolts (const DataChannel* chan) const override;
+
+    bool usesCustomNames() const override;
+
+    void resizeBuffers() override;
+
+    GenericEditor* createEditor (SourceNode* sn) override;
+
+    /** Sets the StreamOutput to connect to. Closes the current connection. */
+    void setAddress (const String& host, int port);
+    String getHost() const;
+    int getPort() const;
+
+    bool isConnected() const;
+
+    /** Channels of all subprocessors of the stream */
+    int getNumChannels() const;
+
+    /** Incremented whenever a connection brings a different layout */
+    int getLayoutVersion() const;
+
+    /** Samples received while the DataBuffer was full during the last acquisition */
+    juce::int64 getNumDroppedSamples() const;
+
+protected:
+    void setDefaultChannelNames() override;
+
+private:
+    /** A TTL edge waiting for the continuous frame that holds its sample */
+    struct PendingTTL
+    {
+        juce::int64 timestamp;
+        uint16 line;
+        bool state;
+    };
+
+    struct RemoteSubProcessor
+    {
+        StreamSubProcessorInfo info;
+        Array<float> bitVolts;
+        StringArray names;
+
+        uint64 ttlWord;                 // state of the lines after the edges applied so far
+        Array<PendingTTL> pendingTTL;   // in order of arrival
+    };
+
+    bool updateBuffer() override;
+
+    bool connect();
+    void disconnect();
+
+    /** Sends the mask of topics the publisher should send from now on */
+    bool subscribe (int topics);
+
+    /** Reads the next frame into the payload. Returns false if the connection failed
+        or the stream is not one this source understands. */
+    bool readFrame (StreamFrameHeader& header);
+
+    /** Takes the layout from a DESCRIPTION frame. Returns false if it is malformed. */
+    bool readDescription (const StreamFrameHeader& header);
+
+    int findSubProcessor (uint16 sourceNodeId, uint16 subProcessorIdx) const;
+
+    void addContinuous (const StreamFrameHeader& header);
+    void addTTLEvent (const StreamFrameHeader& header);
+
+    /** Fills eventCodes with the TTL word of each sample of a continuous frame, applying
+        the pending edges that fall before its last sample */
+    void applyTTLEvents (RemoteSubProcessor& sub, juce::int64 timestamp, int numSamples);
+
+    /** Copies numSamples samples of the frame, starting at srcStart, into the buffer at dstStart */
+    void copySamples (DataBuffer* buffer, int dstStart, int numSamples, int srcStart, const StreamFrameHeader& header);
+
+    String host;
+    int port;
+
+    ScopedPointer<StreamingSocket> socket;
+    Atomic<int> connected;
+
+    OwnedArray<RemoteSubProcessor> subProcessors;
+    MemoryBlock description;
+    Array<float> bitVolts;
+    Atomic<int> layoutVersion;
+
+    MemoryBlock payload;
+    HeapBlock<uint64> eventCodes;
+    int eventCodesSize;
+
+    juce::int64 droppedSamples;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NetworkSourceThread);
+};
+
+#endif  // __NETWORKSOURCETHREAD_H_7F3A2D90__
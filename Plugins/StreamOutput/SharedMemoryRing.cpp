@@ -0,0 +1,168 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "SharedMemoryRing.h"
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+#endif
+
+SharedMemoryRing::SharedMemoryRing()
+    : memory (nullptr)
+    , memorySize (0)
+    , ring (nullptr)
+    , data (nullptr)
+#if JUCE_WINDOWS
+    , mapping (nullptr)
+#endif
+{
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    close();
+}
+
+bool SharedMemoryRing::create (const String& name, size_t capacity)
+{
+    close();
+
+    memorySize = sizeof (StreamRingHeader) + capacity;
+
+#if JUCE_LINUX || JUCE_MAC
+    segmentName = "/" + name;
+
+    int fd = shm_open (segmentName.toRawUTF8(), O_CREAT | O_RDWR, 0666);
+
+    if (fd < 0)
+        return false;
+
+    if (ftruncate (fd, (off_t) memorySize) != 0)
+    {
+        ::close (fd);
+        shm_unlink (segmentName.toRawUTF8());
+        return false;
+    }
+
+    void* address = mmap (nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close (fd);
+
+    if (address == MAP_FAILED)
+    {
+        shm_unlink (segmentName.toRawUTF8());
+        return false;
+    }
+
+    memory = address;
+#elif JUCE_WINDOWS
+    segmentName = "Local\\" + name;
+
+    mapping = CreateFileMappingA (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  (DWORD) ((uint64) memorySize >> 32), (DWORD) (memorySize & 0xffffffff),
+                                  segmentName.toRawUTF8());
+
+    if (mapping == nullptr)
+        return false;
+
+    memory = MapViewOfFile (mapping, FILE_MAP_ALL_ACCESS, 0, 0, memorySize);
+
+    if (memory == nullptr)
+    {
+        CloseHandle (mapping);
+        mapping = nullptr;
+        return false;
+    }
+#else
+    return false;
+#endif
+
+    ring = new (memory) StreamRingHeader();
+    ring->magic = STREAM_FRAME_MAGIC;
+    ring->version = STREAM_FORMAT_VERSION;
+    ring->capacity = capacity;
+    ring->writePosition.store (0, std::memory_order_relaxed);
+    ring->writeLimit.store (0, std::memory_order_release);
+
+    data = static_cast<uint8*> (memory) + sizeof (StreamRingHeader);
+    return true;
+}
+
+void SharedMemoryRing::close()
+{
+    if (memory == nullptr)
+        return;
+
+#if JUCE_LINUX || JUCE_MAC
+    munmap (memory, memorySize);
+    shm_unlink (segmentName.toRawUTF8());
+#elif JUCE_WINDOWS
+    UnmapViewOfFile (memory);
+    CloseHandle (mapping);
+    mapping = nullptr;
+#endif
+
+    memory = nullptr;
+    ring = nullptr;
+    data = nullptr;
+}
+
+bool SharedMemoryRing::isOpen() const
+{
+    return memory != nullptr;
+}
+
+void SharedMemoryRing::write (const void* header, size_t headerSize, const void* payload, size_t payloadSize)
+{
+    if (ring == nullptr || headerSize + payloadSize > ring->capacity)
+        return;
+
+    const uint64 position = ring->writePosition.load (std::memory_order_relaxed);
+
+    // readers must see the limit move before any byte of the frame they read is overwritten
+    ring->writeLimit.store (position + headerSize + payloadSize, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    copyIn (position, header, headerSize);
+    copyIn (position + headerSize, payload, payloadSize);
+
+    // publish the frame only once it is complete
+    ring->writePosition.store (position + headerSize + payloadSize, std::memory_order_release);
+}
+
+void SharedMemoryRing::copyIn (uint64 position, const void* source, size_t size)
+{
+    const uint64 capacity = ring->capacity;
+    const size_t offset = (size_t) (position % capacity);
+    const size_t first = jmin (size, (size_t) (capacity - offset));
+
+    memcpy (data + offset, source, first);
+
+    if (first < size)
+        memcpy (data, static_cast<const uint8*> (source) + first, size - first);
+}
@@ -0,0 +1,73 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SHAREDMEMORYRING_H_71D3B0C5__
+#define __SHAREDMEMORYRING_H_71D3B0C5__
+
+#include "StreamFormat.h"
+
+/**
+    A named shared memory segment holding a StreamRingHeader and a ring of frames,
+    written by a single thread and read by any number of processes on the same host.
+
+    The segment is named "open-ephys-stream-<id>": a POSIX shared memory object
+    (/dev/shm on Linux) or a Windows file mapping in the session namespace.
+
+    @see StreamRingHeader, StreamPublisher
+*/
+class SharedMemoryRing
+{
+public:
+    SharedMemoryRing();
+    ~SharedMemoryRing();
+
+    /** Creates the segment with a ring of capacity bytes. Returns false on failure. */
+    bool create (const String& name, size_t capacity);
+
+    /** Removes the segment; readers that still map it keep their view */
+    void close();
+
+    bool isOpen() const;
+
+    /** Appends a frame made of two pieces, so the header and payload don't have to be
+        contiguous. Frames larger than the ring are dropped. */
+    void write (const void* header, size_t headerSize, const void* payload, size_t payloadSize);
+
+private:
+    void copyIn (uint64 position, const void* data, size_t size);
+
+    String segmentName;
+    void* memory;
+    size_t memorySize;
+    StreamRingHeader* ring;
+    uint8* data;
+
+#if JUCE_WINDOWS
+    void* mapping;
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE (SharedMemoryRing);
+};
+
+#endif  // __SHAREDMEMORYRING_H_71D3B0C5__
@@ -0,0 +1,124 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __STREAMFORMAT_H_2E8C4A71__
+#define __STREAMFORMAT_H_2E8C4A71__
+
+#include <ProcessorHeaders.h>
+#include <atomic>
+
+/**
+    Wire format of the StreamOutput, shared by its network and shared memory transports.
+
+    Everything is little endian. A stream is a sequence of frames, each a StreamFrameHeader
+    followed by payloadSize bytes:
+    - CONTINUOUS: numChannels x numSamples float32 samples in the units of their channels,
+      channel after channel, of one subprocessor.
+    - EVENT: a serialized event, as read by Event::deserializeFromMessage.
+    - SPIKE: a serialized spike, as read by SpikeEvent::deserializeFromMessage.
+    - DESCRIPTION: the layout of the continuous frames, as numChannels StreamSubProcessorInfo
+      one after the other, each followed by its numChannels float32 bitVolts and numChannels
+      null-terminated UTF-8 channel names. sourceNodeId is the publishing StreamOutput.
+
+    Network clients connect over TCP and receive frames in batches, starting with a
+    DESCRIPTION. They can send a single byte at any time to select the topics they want,
+    as a mask of (1 << StreamTopic); they receive all topics until then.
+*/
+
+#define STREAM_FRAME_MAGIC  0x5453454f   // "OEST"
+#define STREAM_FORMAT_VERSION 2
+
+/* Port the network transport listens on by default */
+#define STREAM_DEFAULT_PORT 5557
+
+enum StreamTopic
+{
+    STREAM_CONTINUOUS = 0,
+    STREAM_EVENT = 1,
+    STREAM_SPIKE = 2,
+    STREAM_DESCRIPTION = 3,
+    STREAM_NUM_TOPICS
+};
+
+#define STREAM_ALL_TOPICS ((1 << STREAM_NUM_TOPICS) - 1)
+
+struct StreamFrameHeader
+{
+    uint32 magic;
+    uint8 topic;
+    uint8 version;
+    uint16 sourceNodeId;
+    uint16 subProcessorIdx;
+    uint16 reserved;
+    uint32 payloadSize;
+    juce::int64 timestamp;      // of the first sample, or of the event
+    uint32 numChannels;         // continuous frames only
+    uint32 numSamples;          // continuous frames only
+};
+
+static_assert (sizeof (StreamFrameHeader) == 32, "StreamFrameHeader is part of the wire format");
+
+/**
+    A subprocessor whose channels are published, as listed in a DESCRIPTION frame.
+
+    Its continuous frames carry the channels in the order of the description, with the
+    subprocessor's own sample numbers as timestamps; its TTL events keep their lines.
+    A receiver that gives them back the same sample numbers and lines can align them with
+    its other streams through a shared sync line, like any local subprocessor.
+*/
+struct StreamSubProcessorInfo
+{
+    uint16 sourceNodeId;
+    uint16 subProcessorIdx;
+    uint32 numChannels;         // channels of its continuous frames
+    uint32 numTTLLines;         // lines of its TTL events, 0 if it has none
+    float sampleRate;
+};
+
+static_assert (sizeof (StreamSubProcessorInfo) == 16, "StreamSubProcessorInfo is part of the wire format");
+
+/**
+    Header of the shared memory ring, followed by capacity bytes of frames.
+
+    Frames are written back to back at writePosition modulo capacity, wrapping around the
+    end of the ring. Before a frame is written, writeLimit is moved to its end; once it is
+    complete, writePosition follows. Readers never block the writer: a reader keeps its own
+    read position, starting at writePosition, reads the frames up to writePosition, and
+    after copying them out checks that writeLimit - readPosition does not exceed capacity.
+    If it does, the frames were overwritten while being read and the reader has to skip
+    ahead to writePosition.
+*/
+struct StreamRingHeader
+{
+    uint32 magic;               // STREAM_FRAME_MAGIC
+    uint32 version;             // STREAM_FORMAT_VERSION
+    uint64 capacity;
+    std::atomic<uint64> writePosition;
+    std::atomic<uint64> writeLimit;
+    uint64 reserved[4];
+};
+
+static_assert (sizeof (StreamRingHeader) == 64, "StreamRingHeader is part of the wire format");
+
+#endif  // __STREAMFORMAT_H_2E8C4A71__
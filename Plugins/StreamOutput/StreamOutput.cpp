@@ -0,0 +1,271 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "StreamOutput.h"
+#include "StreamOutputEditor.h"
+
+
+StreamOutput::StreamOutput()
+    : GenericProcessor ("Stream Output")
+    , port (STREAM_DEFAULT_PORT)
+    , sharedMemory (true)
+{
+    setProcessorType (PROCESSOR_TYPE_SINK);
+
+    for (int i = 0; i < STREAM_NUM_TOPICS; i++)
+        topics[i] = true;
+}
+
+
+StreamOutput::~StreamOutput()
+{
+}
+
+
+AudioProcessorEditor* StreamOutput::createEditor()
+{
+    editor = new StreamOutputEditor (this);
+    return editor;
+}
+
+
+void StreamOutput::setParameter (int parameterIndex, float newValue)
+{
+    switch (parameterIndex)
+    {
+        case PORT:          port = jlimit (0, 65535, (int) newValue); break;
+        case CONTINUOUS:    topics[STREAM_CONTINUOUS] = newValue > 0; break;
+        case EVENTS:        topics[STREAM_EVENT] = newValue > 0; break;
+        case SPIKES:        topics[STREAM_SPIKE] = newValue > 0; break;
+        case SHARED_MEMORY: sharedMemory = newValue > 0; break;
+        default: break;
+    }
+}
+
+
+void StreamOutput::updateSettings()
+{
+    channelPointers.allocate ((size_t) jmax (1, getNumInputs()), false);
+}
+
+
+void StreamOutput::updateChannelGroups()
+{
+    channelGroups.clearQuick();
+
+    for (int i : getEditor()->getActiveChannels())
+    {
+        const DataChannel* channel = getDataChannel (i);
+
+        if (channel == nullptr)
+            continue;
+
+        int group = 0;
+
+        while (group < channelGroups.size()
+               && (channelGroups[group].sourceNodeId != channel->getSourceNodeID()
+                   || channelGroups[group].subProcessorIdx != channel->getSubProcessorIdx()))
+            group++;
+
+        if (group == channelGroups.size())
+        {
+            ChannelGroup newGroup;
+            newGroup.sourceNodeId = channel->getSourceNodeID();
+            newGroup.subProcessorIdx = channel->getSubProcessorIdx();
+            channelGroups.add (newGroup);
+        }
+
+        channelGroups.getReference (group).channels.add (i);
+    }
+
+    MemoryOutputStream description;
+
+    for (const ChannelGroup& group : channelGroups)
+    {
+        StreamSubProcessorInfo info;
+        info.sourceNodeId = group.sourceNodeId;
+        info.subProcessorIdx = group.subProcessorIdx;
+        info.numChannels = (uint32) group.channels.size();
+        info.numTTLLines = (uint32) getNumTTLLines (group.sourceNodeId, group.subProcessorIdx);
+        info.sampleRate = getDataChannel (group.channels[0])->getSampleRate();
+        description.write (&info, sizeof (info));
+
+        for (int i : group.channels)
+            description.writeFloat (getDataChannel (i)->getBitVolts());
+
+        for (int i : group.channels)
+            description.writeString (getDataChannel (i)->getName());
+    }
+
+    publisher.setDescription ((uint16) getNodeId(), channelGroups.size(), description.getData(), description.getDataSize());
+}
+
+
+int StreamOutput::getNumTTLLines (uint16 sourceNodeId, uint16 subProcessorIdx) const
+{
+    int numLines = 0;
+
+    for (int i = 0; i < getTotalEventChannels(); i++)
+    {
+        const EventChannel* channel = getEventChannel (i);
+
+        if (channel->getChannelType() == EventChannel::TTL
+            && channel->getSourceNodeID() == sourceNodeId
+            && channel->getSubProcessorIdx() == subProcessorIdx)
+            numLines = jmax (numLines, (int) channel->getNumChannels());
+    }
+
+    return numLines;
+}
+
+
+bool StreamOutput::enable()
+{
+    updateChannelGroups();
+
+    if (! publisher.start (port, sharedMemory ? getSharedMemoryName() : String()))
+        CoreServices::sendStatusMessage ("Stream Output: a transport could not be opened");
+
+    return true;
+}
+
+
+bool StreamOutput::disable()
+{
+    publisher.stop();
+
+    if (getNumDroppedFrames() > 0)
+        std::cout << "Stream Output dropped " << getNumDroppedFrames() << " frames" << std::endl;
+
+    return true;
+}
+
+
+void StreamOutput::process (AudioSampleBuffer& buffer)
+{
+    if (topics[STREAM_EVENT] || topics[STREAM_SPIKE])
+        checkForEvents (topics[STREAM_SPIKE]);
+
+    if (! topics[STREAM_CONTINUOUS])
+        return;
+
+    for (const ChannelGroup& group : channelGroups)
+    {
+        for (int i = 0; i < group.channels.size(); i++)
+            channelPointers[i] = buffer.getReadPointer (group.channels.getUnchecked (i));
+
+        publisher.publishContinuous (group.sourceNodeId, group.subProcessorIdx,
+                                     getTimestamp (group.channels[0]),
+                                     channelPointers, group.channels.size(),
+                                     getNumSamples (group.channels[0]));
+    }
+}
+
+
+void StreamOutput::handleEvent (const EventChannel* eventInfo, const MidiMessage& event, int)
+{
+    if (! topics[STREAM_EVENT])
+        return;
+
+    publisher.publishMessage (STREAM_EVENT, eventInfo->getSourceNodeID(), eventInfo->getSubProcessorIdx(),
+                              Event::getTimestamp (event), event.getRawData(), (size_t) event.getRawDataSize());
+}
+
+
+void StreamOutput::handleSpike (const SpikeChannel* spikeInfo, const MidiMessage& event, int)
+{
+    // spikes held by the SpikeStore are only valid during this block, so they are copied out in full
+    size_t size;
+    const uint8* spike = SpikeStore::getSpikeData (event, size);
+
+    if (spike != nullptr)
+        publisher.publishMessage (STREAM_SPIKE, spikeInfo->getSourceNodeID(), spikeInfo->getSubProcessorIdx(),
+                                  SpikeEvent::getTimestamp (event), spike, size);
+}
+
+
+int StreamOutput::getPort() const
+{
+    return port;
+}
+
+
+bool StreamOutput::isPublishing (StreamTopic topic) const
+{
+    return topics[topic];
+}
+
+
+bool StreamOutput::usesSharedMemory() const
+{
+    return sharedMemory;
+}
+
+
+String StreamOutput::getSharedMemoryName() const
+{
+    return "open-ephys-stream-" + String (getNodeId());
+}
+
+
+juce::int64 StreamOutput::getNumDroppedFrames() const
+{
+    return publisher.getNumDroppedFrames();
+}
+
+
+int StreamOutput::getNumClients() const
+{
+    return publisher.getNumClients();
+}
+
+
+void StreamOutput::saveCustomParametersToXml (XmlElement* parentElement)
+{
+    XmlElement* streamXml = parentElement->createNewChildElement ("STREAM");
+    streamXml->setAttribute ("port",         port);
+    streamXml->setAttribute ("continuous",   topics[STREAM_CONTINUOUS]);
+    streamXml->setAttribute ("events",       topics[STREAM_EVENT]);
+    streamXml->setAttribute ("spikes",       topics[STREAM_SPIKE]);
+    streamXml->setAttribute ("sharedmemory", sharedMemory);
+}
+
+
+void StreamOutput::loadCustomParametersFromXml()
+{
+    if (parametersAsXml == nullptr)
+        return;
+
+    forEachXmlChildElementWithTagName (*parametersAsXml, streamXml, "STREAM")
+    {
+        port = streamXml->getIntAttribute ("port", STREAM_DEFAULT_PORT);
+        topics[STREAM_CONTINUOUS] = streamXml->getBoolAttribute ("continuous", true);
+        topics[STREAM_EVENT]      = streamXml->getBoolAttribute ("events", true);
+        topics[STREAM_SPIKE]      = streamXml->getBoolAttribute ("spikes", true);
+        sharedMemory              = streamXml->getBoolAttribute ("sharedmemory", true);
+    }
+
+    if (editor != nullptr)
+        editor->updateSettings();
+}
@@ -0,0 +1,115 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __STREAMOUTPUT_H_C41F6B28__
+#define __STREAMOUTPUT_H_C41F6B28__
+
+#include <ProcessorHeaders.h>
+#include "StreamPublisher.h"
+
+/**
+    Publishes the continuous data, events and spikes reaching it to external programs,
+    such as real-time analysis in Python or MATLAB, without a copy of its own in the
+    signal chain.
+
+    Frames of the selected topics go to a shared memory ring for readers on the same
+    host, and to TCP clients, which can subscribe to a subset of the topics. The format
+    of both is described in StreamFormat.h. Only the channels selected in the editor are
+    published. Settings take effect when acquisition starts.
+
+    A NetworkSourceThread on another computer reads the stream back into its own signal
+    chain, so the processing and recording of a rig can be split across computers.
+
+    @see StreamPublisher, NetworkSourceThread
+*/
+class StreamOutput : public GenericProcessor
+{
+public:
+    StreamOutput();
+    ~StreamOutput();
+
+    enum Parameters
+    {
+        PORT = 0,           // 0 disables the network transport
+        CONTINUOUS,         // publish continuous blocks
+        EVENTS,             // publish events
+        SPIKES,             // publish spikes
+        SHARED_MEMORY       // publish to the shared memory ring
+    };
+
+    AudioProcessorEditor* createEditor() override;
+
+    void setParameter (int parameterIndex, float newValue) override;
+
+    void process (AudioSampleBuffer& buffer) override;
+
+    void handleEvent (const EventChannel* eventInfo, const MidiMessage& event, int samplePosition) override;
+    void handleSpike (const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition) override;
+
+    bool enable() override;
+    bool disable() override;
+
+    void updateSettings() override;
+
+    int getPort() const;
+    bool isPublishing (StreamTopic topic) const;
+    bool usesSharedMemory() const;
+
+    /** Name of the shared memory segment, see SharedMemoryRing */
+    String getSharedMemoryName() const;
+
+    juce::int64 getNumDroppedFrames() const;
+    int getNumClients() const;
+
+    void saveCustomParametersToXml (XmlElement* parentElement) override;
+    void loadCustomParametersFromXml() override;
+
+private:
+    /** Selected input channels of the same subprocessor, published together */
+    struct ChannelGroup
+    {
+        Array<int> channels;
+        uint16 sourceNodeId;
+        uint16 subProcessorIdx;
+    };
+
+    /** Groups the channels selected in the editor and hands their layout to the publisher */
+    void updateChannelGroups();
+
+    /** Lines of the TTL events of a subprocessor that reach this processor */
+    int getNumTTLLines (uint16 sourceNodeId, uint16 subProcessorIdx) const;
+
+    Array<ChannelGroup> channelGroups;
+    HeapBlock<const float*> channelPointers;
+
+    StreamPublisher publisher;
+
+    int port;
+    bool topics[STREAM_NUM_TOPICS];
+    bool sharedMemory;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamOutput);
+};
+
+#endif  // __STREAMOUTPUT_H_C41F6B28__
@@ -0,0 +1,125 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "StreamOutputEditor.h"
+#include "StreamOutput.h"
+
+
+StreamOutputEditor::StreamOutputEditor (StreamOutput* parentNode)
+    : GenericEditor (parentNode, false)
+    , node (parentNode)
+{
+    desiredWidth = 180;
+
+    portText = new Label ("Port Text", "Port:");
+    portText->setEditable (false);
+    portText->setJustificationType (Justification::centredLeft);
+    portText->setBounds (10, 30, 50, 20);
+    addAndMakeVisible (portText);
+
+    portLabel = new Label ("Port", String (node->getPort()));
+    portLabel->setEditable (true);
+    portLabel->setJustificationType (Justification::centredLeft);
+    portLabel->setColour (Label::backgroundColourId, Colours::grey);
+    portLabel->setColour (Label::textColourId, Colours::white);
+    portLabel->setTooltip ("TCP port clients connect to; 0 disables the network stream");
+    portLabel->setBounds (60, 30, 60, 20);
+    portLabel->addListener (this);
+    addAndMakeVisible (portLabel);
+
+    continuousButton = createToggle ("DATA", "Publish continuous data", 10, 65, 50);
+    eventsButton = createToggle ("EVENTS", "Publish events", 62, 65, 50);
+    spikesButton = createToggle ("SPIKES", "Publish spikes", 114, 65, 50);
+    sharedMemoryButton = createToggle ("SHARED MEM", "Publish to a shared memory ring for readers on the same computer", 10, 95, 100);
+
+    updateSettings();
+}
+
+
+StreamOutputEditor::~StreamOutputEditor()
+{
+}
+
+
+UtilityButton* StreamOutputEditor::createToggle (const String& name, const String& tooltip, int x, int y, int width)
+{
+    UtilityButton* button = new UtilityButton (name, Font ("Small Text", 13, Font::plain));
+    button->setRadius (3.0f);
+    button->setBounds (x, y, width, 20);
+    button->setClickingTogglesState (true);
+    button->setTooltip (tooltip);
+    button->addListener (this);
+    addAndMakeVisible (button);
+    return button;
+}
+
+
+void StreamOutputEditor::buttonEvent (Button* button)
+{
+    const float state = button->getToggleState() ? 1.0f : 0.0f;
+
+    if (button == continuousButton)
+        node->setParameter (StreamOutput::CONTINUOUS, state);
+    else if (button == eventsButton)
+        node->setParameter (StreamOutput::EVENTS, state);
+    else if (button == spikesButton)
+        node->setParameter (StreamOutput::SPIKES, state);
+    else if (button == sharedMemoryButton)
+        node->setParameter (StreamOutput::SHARED_MEMORY, state);
+}
+
+
+void StreamOutputEditor::labelTextChanged (Label* label)
+{
+    if (label == portLabel)
+    {
+        node->setParameter (StreamOutput::PORT, (float) label->getText().getIntValue());
+        label->setText (String (node->getPort()), dontSendNotification);
+    }
+}
+
+
+void StreamOutputEditor::updateSettings()
+{
+    portLabel->setText (String (node->getPort()), dontSendNotification);
+    continuousButton->setToggleState (node->isPublishing (STREAM_CONTINUOUS), dontSendNotification);
+    eventsButton->setToggleState (node->isPublishing (STREAM_EVENT), dontSendNotification);
+    spikesButton->setToggleState (node->isPublishing (STREAM_SPIKE), dontSendNotification);
+    sharedMemoryButton->setToggleState (node->usesSharedMemory(), dontSendNotification);
+}
+
+
+void StreamOutputEditor::startAcquisition()
+{
+    // the transports are opened when acquisition starts, so only the topics can change
+    portLabel->setEditable (false);
+    sharedMemoryButton->setEnabled (false);
+}
+
+
+void StreamOutputEditor::stopAcquisition()
+{
+    portLabel->setEditable (true);
+    sharedMemoryButton->setEnabled (true);
+}
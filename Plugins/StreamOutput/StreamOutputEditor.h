@@ -0,0 +1,68 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __STREAMOUTPUTEDITOR_H_0B7D93E4__
+#define __STREAMOUTPUTEDITOR_H_0B7D93E4__
+
+#include <EditorHeaders.h>
+
+class StreamOutput;
+
+/**
+    User interface for the StreamOutput: the network port and the published topics.
+
+    @see StreamOutput
+*/
+class StreamOutputEditor : public GenericEditor
+                         , public Label::Listener
+{
+public:
+    StreamOutputEditor (StreamOutput* parentNode);
+    ~StreamOutputEditor();
+
+    void buttonEvent (Button* button) override;
+    void labelTextChanged (Label* label) override;
+
+    /** Shows the processor's settings */
+    void updateSettings() override;
+
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+private:
+    UtilityButton* createToggle (const String& name, const String& tooltip, int x, int y, int width);
+
+    StreamOutput* node;
+
+    ScopedPointer<Label> portText;
+    ScopedPointer<Label> portLabel;
+    ScopedPointer<UtilityButton> continuousButton;
+    ScopedPointer<UtilityButton> eventsButton;
+    ScopedPointer<UtilityButton> spikesButton;
+    ScopedPointer<UtilityButton> sharedMemoryButton;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamOutputEditor);
+};
+
+#endif  // __STREAMOUTPUTEDITOR_H_0B7D93E4__
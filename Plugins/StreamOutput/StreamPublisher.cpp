@@ -0,0 +1,343 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "StreamPublisher.h"
+
+StreamPublisher::QueueWriter::QueueWriter (char* queue_, int start1_, int size1_, int start2_, int size2_)
+    : queue (queue_)
+    , start1 (start1_)
+    , size1 (size1_)
+    , start2 (start2_)
+    , size2 (size2_)
+    , written (0)
+{
+}
+
+void StreamPublisher::QueueWriter::write (const void* data, int size)
+{
+    const char* source = static_cast<const char*> (data);
+
+    while (size > 0)
+    {
+        const bool inFirst = written < size1;
+        const int offset = inFirst ? start1 + written : start2 + written - size1;
+        const int available = inFirst ? size1 - written : size2 - (written - size1);
+        const int chunk = jmin (size, available);
+
+        jassert (chunk > 0);
+
+        memcpy (queue + offset, source, (size_t) chunk);
+        source += chunk;
+        size -= chunk;
+        written += chunk;
+    }
+}
+
+
+StreamPublisher::StreamPublisher()
+    : Thread ("Stream Publisher")
+    , queue (STREAM_QUEUE_SIZE)
+    , droppedFrames (0)
+    , frameSize (0)
+    , numClients (0)
+{
+}
+
+StreamPublisher::~StreamPublisher()
+{
+    stop();
+}
+
+bool StreamPublisher::start (int port, const String& sharedMemoryName)
+{
+    stop();
+
+    queueData.allocate (STREAM_QUEUE_SIZE, false);
+    queue.reset();
+    droppedFrames = 0;
+
+    bool opened = true;
+
+    if (sharedMemoryName.isNotEmpty() && ! sharedMemory.create (sharedMemoryName, STREAM_RING_SIZE))
+    {
+        std::cout << "Stream Output: could not create shared memory " << sharedMemoryName << std::endl;
+        opened = false;
+    }
+
+    if (port > 0)
+    {
+        listener = new StreamingSocket();
+
+        if (! listener->createListener (port))
+        {
+            std::cout << "Stream Output: could not listen on port " << port << std::endl;
+            listener = nullptr;
+            opened = false;
+        }
+    }
+
+    startThread();
+    return opened;
+}
+
+void StreamPublisher::stop()
+{
+    stopThread (1000);
+
+    clients.clear();
+    numClients = 0;
+    listener = nullptr;
+    sharedMemory.close();
+    queueData.free();
+}
+
+void StreamPublisher::setDescription (uint16 sourceNodeId, int numSubProcessors, const void* payload, size_t size)
+{
+    StreamFrameHeader header;
+    initFrame (header, STREAM_DESCRIPTION, sourceNodeId, 0, 0, size);
+    header.numChannels = (uint32) numSubProcessors;
+
+    description.setSize (sizeof (header) + size, false);
+    description.copyFrom (&header, 0, sizeof (header));
+    description.copyFrom (payload, sizeof (header), size);
+}
+
+void StreamPublisher::initFrame (StreamFrameHeader& header, StreamTopic topic, uint16 sourceNodeId,
+                                 uint16 subProcessorIdx, juce::int64 timestamp, size_t payloadSize)
+{
+    header.magic = STREAM_FRAME_MAGIC;
+    header.topic = (uint8) topic;
+    header.version = STREAM_FORMAT_VERSION;
+    header.sourceNodeId = sourceNodeId;
+    header.subProcessorIdx = subProcessorIdx;
+    header.reserved = 0;
+    header.payloadSize = (uint32) payloadSize;
+    header.timestamp = timestamp;
+    header.numChannels = 0;
+    header.numSamples = 0;
+}
+
+void StreamPublisher::publishContinuous (uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 timestamp,
+                                         const float* const* channels, int numChannels, int numSamples)
+{
+    const size_t payloadSize = (size_t) numChannels * numSamples * sizeof (float);
+    const int frameBytes = (int) (sizeof (StreamFrameHeader) + payloadSize);
+
+    if (queueData == nullptr || numSamples <= 0 || queue.getFreeSpace() < frameBytes)
+    {
+        ++droppedFrames;
+        return;
+    }
+
+    StreamFrameHeader header;
+    initFrame (header, STREAM_CONTINUOUS, sourceNodeId, subProcessorIdx, timestamp, payloadSize);
+    header.numChannels = (uint32) numChannels;
+    header.numSamples = (uint32) numSamples;
+
+    int start1, size1, start2, size2;
+    queue.prepareToWrite (frameBytes, start1, size1, start2, size2);
+
+    QueueWriter writer (queueData, start1, size1, start2, size2);
+    writer.write (&header, sizeof (header));
+
+    for (int i = 0; i < numChannels; i++)
+        writer.write (channels[i], numSamples * (int) sizeof (float));
+
+    queue.finishedWrite (frameBytes);
+}
+
+void StreamPublisher::publishMessage (StreamTopic topic, uint16 sourceNodeId, uint16 subProcessorIdx,
+                                      juce::int64 timestamp, const void* message, size_t size)
+{
+    const int frameBytes = (int) (sizeof (StreamFrameHeader) + size);
+
+    if (queueData == nullptr || queue.getFreeSpace() < frameBytes)
+    {
+        ++droppedFrames;
+        return;
+    }
+
+    StreamFrameHeader header;
+    initFrame (header, topic, sourceNodeId, subProcessorIdx, timestamp, size);
+
+    int start1, size1, start2, size2;
+    queue.prepareToWrite (frameBytes, start1, size1, start2, size2);
+
+    QueueWriter writer (queueData, start1, size1, start2, size2);
+    writer.write (&header, sizeof (header));
+    writer.write (message, (int) size);
+
+    queue.finishedWrite (frameBytes);
+}
+
+juce::int64 StreamPublisher::getNumDroppedFrames() const
+{
+    return droppedFrames.get();
+}
+
+int StreamPublisher::getNumClients() const
+{
+    return numClients.get();
+}
+
+void StreamPublisher::run()
+{
+    while (! threadShouldExit())
+    {
+        acceptClients();
+        readSubscriptions();
+
+        bool published = false;
+
+        while (readFrame())
+        {
+            dispatchFrame();
+            published = true;
+
+            if (threadShouldExit())
+                return;
+        }
+
+        // the queue ran empty: send what the clients have batched so far
+        for (int i = clients.size(); --i >= 0;)
+            if (! sendBatch (*clients[i]))
+                clients.remove (i);
+
+        numClients = clients.size();
+
+        if (! published)
+            wait (1);
+    }
+}
+
+void StreamPublisher::readFromQueue (void* destination, int size)
+{
+    int start1, size1, start2, size2;
+    queue.prepareToRead (size, start1, size1, start2, size2);
+
+    memcpy (destination, queueData + start1, (size_t) size1);
+
+    if (size2 > 0)
+        memcpy (static_cast<char*> (destination) + size1, queueData + start2, (size_t) size2);
+}
+
+bool StreamPublisher::readFrame()
+{
+    if (queue.getNumReady() < (int) sizeof (StreamFrameHeader))
+        return false;
+
+    // frames are queued whole, so once the header is there the payload is too
+    StreamFrameHeader header;
+    readFromQueue (&header, sizeof (header));
+
+    frameSize = sizeof (StreamFrameHeader) + header.payloadSize;
+
+    if (frameBuffer.getSize() < frameSize)
+        frameBuffer.setSize (frameSize, false);
+
+    readFromQueue (frameBuffer.getData(), (int) frameSize);
+    queue.finishedRead ((int) frameSize);
+    return true;
+}
+
+void StreamPublisher::dispatchFrame()
+{
+    const char* frame = static_cast<const char*> (frameBuffer.getData());
+    const StreamFrameHeader* header = reinterpret_cast<const StreamFrameHeader*> (frame);
+
+    if (sharedMemory.isOpen())
+        sharedMemory.write (frame, sizeof (StreamFrameHeader), frame + sizeof (StreamFrameHeader), header->payloadSize);
+
+    const int topicBit = 1 << header->topic;
+
+    for (int i = clients.size(); --i >= 0;)
+    {
+        Client& client = *clients[i];
+
+        if ((client.topics & topicBit) == 0)
+            continue;
+
+        client.batch.write (frame, frameSize);
+
+        if (client.batch.getDataSize() >= STREAM_BATCH_SIZE && ! sendBatch (client))
+            clients.remove (i);
+    }
+}
+
+bool StreamPublisher::sendBatch (Client& client)
+{
+    const int size = (int) client.batch.getDataSize();
+
+    if (size == 0)
+        return true;
+
+    const bool sent = client.socket->write (client.batch.getData(), size) == size;
+    client.batch.reset();
+    return sent;
+}
+
+void StreamPublisher::acceptClients()
+{
+    if (listener == nullptr)
+        return;
+
+    while (listener->waitUntilReady (true, 0) == 1)
+    {
+        StreamingSocket* socket = listener->waitForNextConnection();
+
+        if (socket == nullptr)
+            break;
+
+        Client* client = new Client();
+        client->socket = socket;
+        client->batch.write (description.getData(), description.getSize());
+        clients.add (client);
+    }
+
+    numClients = clients.size();
+}
+
+void StreamPublisher::readSubscriptions()
+{
+    for (int i = clients.size(); --i >= 0;)
+    {
+        Client& client = *clients[i];
+
+        while (client.socket->waitUntilReady (true, 0) == 1)
+        {
+            uint8 topics;
+
+            if (client.socket->read (&topics, 1, false) != 1)
+            {
+                // the client hung up
+                clients.remove (i);
+                break;
+            }
+
+            client.topics = topics & STREAM_ALL_TOPICS;
+        }
+    }
+
+    numClients = clients.size();
+}
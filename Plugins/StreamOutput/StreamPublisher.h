@@ -0,0 +1,130 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __STREAMPUBLISHER_H_9A0C5E37__
+#define __STREAMPUBLISHER_H_9A0C5E37__
+
+#include "StreamFormat.h"
+#include "SharedMemoryRing.h"
+
+/* Frames waiting for the worker, in bytes */
+#define STREAM_QUEUE_SIZE (32 * 1024 * 1024)
+
+/* Bytes of the shared memory ring */
+#define STREAM_RING_SIZE (64 * 1024 * 1024)
+
+/* A client's batch is sent once it holds this many bytes, or when the queue runs empty */
+#define STREAM_BATCH_SIZE (256 * 1024)
+
+/**
+    Publishes frames to the StreamOutput's transports from its own thread.
+
+    The processing thread only copies each frame once into a lock-free queue; the worker
+    takes the frames out, writes them to the shared memory ring and batches them to every
+    network client that subscribed to their topic. Frames that don't fit in the queue
+    are dropped and counted. Every network client is sent the DESCRIPTION frame first,
+    so it knows the layout before the first continuous frame.
+
+    @see StreamOutput, StreamFormat.h
+*/
+class StreamPublisher : private Thread
+{
+public:
+    StreamPublisher();
+    ~StreamPublisher();
+
+    /** Opens the transports and starts the worker. A port of 0 disables the network transport
+        and an empty name the shared memory one. Returns false if a transport could not be opened. */
+    bool start (int port, const String& sharedMemoryName);
+    void stop();
+
+    /** Sets the DESCRIPTION frame, with numSubProcessors subprocessors described in the
+        payload as in StreamFormat.h. Call before start(). */
+    void setDescription (uint16 sourceNodeId, int numSubProcessors, const void* payload, size_t size);
+
+    /** Queues a continuous frame with numChannels channels of numSamples samples.
+        Called from the processing thread. */
+    void publishContinuous (uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 timestamp,
+                            const float* const* channels, int numChannels, int numSamples);
+
+    /** Queues an event or spike frame with its serialized message. Called from the processing thread. */
+    void publishMessage (StreamTopic topic, uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 timestamp,
+                         const void* message, size_t size);
+
+    juce::int64 getNumDroppedFrames() const;
+    int getNumClients() const;
+
+private:
+    struct Client
+    {
+        ScopedPointer<StreamingSocket> socket;
+        int topics = STREAM_ALL_TOPICS;
+        MemoryOutputStream batch;
+    };
+
+    /** Copies a frame into the free space of the queue, which may wrap around its end */
+    class QueueWriter
+    {
+    public:
+        QueueWriter (char* queue, int start1, int size1, int start2, int size2);
+        void write (const void* data, int size);
+
+    private:
+        char* const queue;
+        const int start1, size1, start2, size2;
+        int written;
+    };
+
+    void run() override;
+
+    void initFrame (StreamFrameHeader& header, StreamTopic topic, uint16 sourceNodeId,
+                    uint16 subProcessorIdx, juce::int64 timestamp, size_t payloadSize);
+
+    /** Takes the next frame out of the queue into frameBuffer. Returns false if there is none. */
+    bool readFrame();
+    void readFromQueue (void* destination, int size);
+
+    void acceptClients();
+    void readSubscriptions();
+    void dispatchFrame();
+    bool sendBatch (Client& client);
+
+    AbstractFifo queue;
+    HeapBlock<char> queueData;
+    Atomic<juce::int64> droppedFrames;
+
+    MemoryBlock frameBuffer;
+    size_t frameSize;
+
+    MemoryBlock description;
+
+    SharedMemoryRing sharedMemory;
+    ScopedPointer<StreamingSocket> listener;
+    OwnedArray<Client> clients;
+    Atomic<int> numClients;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamPublisher);
+};
+
+#endif  // __STREAMPUBLISHER_H_9A0C5E37__
@@ -0,0 +1,127 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SyntheticEditor.h"
+#include "SyntheticThread.h"
+
+using namespace SyntheticSource;
+
+namespace
+{
+	const int channelOptions[] = { 16, 32, 64, 128, 256, 384, 512, 1024, 2048, 4096 };
+	const int rateOptions[] = { 1000, 2500, 5000, 10000, 20000, 25000, 30000, 40000 };
+}
+
+SyntheticEditor::SyntheticEditor(SourceNode* parentNode, SyntheticThread* thread_)
+	: GenericEditor(parentNode, false), thread(thread_)
+{
+	desiredWidth = 170;
+
+	channelsLabel = new Label("Channels", "Channels");
+	channelsLabel->setFont(Font("Small Text", 10, Font::plain));
+	channelsLabel->setBounds(10, 30, 70, 20);
+	channelsLabel->setColour(Label::textColourId, Colours::darkgrey);
+	addAndMakeVisible(channelsLabel);
+
+	channelsCombo = new ComboBox("ChannelsComboBox");
+	channelsCombo->setBounds(15, 50, 65, 18);
+	for (int i = 0; i < numElementsInArray(channelOptions); i++)
+		channelsCombo->addItem(String(channelOptions[i]), i + 1);
+	channelsCombo->addListener(this);
+	addAndMakeVisible(channelsCombo);
+
+	rateLabel = new Label("Sample rate", "Sample rate");
+	rateLabel->setFont(Font("Small Text", 10, Font::plain));
+	rateLabel->setBounds(85, 30, 75, 20);
+	rateLabel->setColour(Label::textColourId, Colours::darkgrey);
+	addAndMakeVisible(rateLabel);
+
+	rateCombo = new ComboBox("RateComboBox");
+	rateCombo->setBounds(90, 50, 70, 18);
+	for (int i = 0; i < numElementsInArray(rateOptions); i++)
+		rateCombo->addItem(String(rateOptions[i] / 1000.0f, 1) + " kS/s", i + 1);
+	rateCombo->addListener(this);
+	addAndMakeVisible(rateCombo);
+
+	updateSelectors();
+}
+
+SyntheticEditor::~SyntheticEditor()
+{
+}
+
+void SyntheticEditor::updateSelectors()
+{
+	for (int i = 0; i < numElementsInArray(channelOptions); i++)
+		if (channelOptions[i] == thread->getNumChannels())
+			channelsCombo->setSelectedId(i + 1, dontSendNotification);
+
+	for (int i = 0; i < numElementsInArray(rateOptions); i++)
+		if (rateOptions[i] == roundToInt(thread->getSampleRate(0)))
+			rateCombo->setSelectedId(i + 1, dontSendNotification);
+}
+
+void SyntheticEditor::comboBoxChanged(ComboBox* comboBox)
+{
+	if (acquisitionIsActive)
+	{
+		CoreServices::sendStatusMessage("Can't change the synthetic source while acquisition is active!");
+		updateSelectors();
+		return;
+	}
+
+	if (comboBox == channelsCombo)
+		thread->setNumChannels(channelOptions[channelsCombo->getSelectedId() - 1]);
+	else if (comboBox == rateCombo)
+		thread->setSampleRate((float)rateOptions[rateCombo->getSelectedId() - 1]);
+
+	CoreServices::updateSignalChain(this);
+}
+
+void SyntheticEditor::startAcquisition()
+{
+	GenericEditor::startAcquisition();
+	channelsCombo->setEnabled(false);
+	rateCombo->setEnabled(false);
+}
+
+void SyntheticEditor::stopAcquisition()
+{
+	GenericEditor::stopAcquisition();
+	channelsCombo->setEnabled(true);
+	rateCombo->setEnabled(true);
+}
+
+void SyntheticEditor::saveCustomParameters(XmlElement* xml)
+{
+	xml->setAttribute("Channels", thread->getNumChannels());
+	xml->setAttribute("SampleRate", thread->getSampleRate(0));
+}
+
+void SyntheticEditor::loadCustomParameters(XmlElement* xml)
+{
+	thread->setNumChannels(xml->getIntAttribute("Channels", SYNTH_DEFAULT_CHANNELS));
+	thread->setSampleRate((float)xml->getDoubleAttribute("SampleRate", SYNTH_DEFAULT_RATE));
+	updateSelectors();
+	CoreServices::updateSignalChain(this);
+}
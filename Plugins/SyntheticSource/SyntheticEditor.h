@@ -0,0 +1,69 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SYNTHETICEDITOR_H_7A1E52C3__
+#define __SYNTHETICEDITOR_H_7A1E52C3__
+
+#include <EditorHeaders.h>
+
+class SourceNode;
+
+namespace SyntheticSource
+{
+
+	class SyntheticThread;
+
+	/**
+		Selects the channel count and sample rate of the synthetic source.
+
+		@see SyntheticThread
+	*/
+	class SyntheticEditor : public GenericEditor, public ComboBox::Listener
+	{
+	public:
+		SyntheticEditor(SourceNode* parentNode, SyntheticThread* thread);
+		~SyntheticEditor();
+
+		void comboBoxChanged(ComboBox* comboBox) override;
+
+		void startAcquisition() override;
+		void stopAcquisition() override;
+
+		void saveCustomParameters(XmlElement* xml) override;
+		void loadCustomParameters(XmlElement* xml) override;
+
+	private:
+		/** Selects the entries matching the thread settings */
+		void updateSelectors();
+
+		SyntheticThread* thread;
+
+		ScopedPointer<Label> channelsLabel, rateLabel;
+		ScopedPointer<ComboBox> channelsCombo, rateCombo;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SyntheticEditor);
+	};
+
+}
+
+#endif  // __SYNTHETICEDITOR_H_7A1E52C3__
@@ -0,0 +1,311 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SyntheticThread.h"
+#include "SyntheticEditor.h"
+
+using namespace SyntheticSource;
+
+namespace
+{
+	/** Deterministic generator for the tables and the spike trains */
+	inline uint32 nextRandom(uint32& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	/** Uniform value in [-1, 1) */
+	inline float randomUnit(uint32& state)
+	{
+		return (float)(nextRandom(state) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+	}
+
+	/** Adds the part of a spike starting at sample spikeStart that overlaps [first, first + numSamples) */
+	inline void addSpike(float* dst, const float* shape, int shapeSamples, float amplitude,
+		int64 spikeStart, int64 first, int numSamples)
+	{
+		int begin = (int)jmax((int64)0, first - spikeStart);
+		int end = (int)jmin((int64)shapeSamples, first + numSamples - spikeStart);
+		for (int k = begin; k < end; ++k)
+			dst[spikeStart - first + k] += amplitude * shape[k];
+	}
+}
+
+SyntheticThread::SyntheticThread(SourceNode* sn) : DataThread(sn),
+	numChannels(SYNTH_DEFAULT_CHANNELS),
+	sampleRate(SYNTH_DEFAULT_RATE),
+	lfpTableSize(0),
+	spikeSamples(0),
+	samplesGenerated(0),
+	droppedSamples(0),
+	startTimeMs(0),
+	offline(false)
+{
+	sourceBuffers.add(new DataBuffer(numChannels, SYNTH_BUFFER_SAMPLES));
+}
+
+SyntheticThread::~SyntheticThread()
+{
+}
+
+GenericEditor* SyntheticThread::createEditor(SourceNode* sn)
+{
+	return new SyntheticEditor(sn, this);
+}
+
+bool SyntheticThread::foundInputSource()
+{
+	return true;
+}
+
+int SyntheticThread::getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessor) const
+{
+	if (type == DataChannel::HEADSTAGE_CHANNEL && subProcessor == 0)
+		return numChannels;
+	return 0;
+}
+
+int SyntheticThread::getNumTTLOutputs(int subProcessor) const
+{
+	return subProcessor == 0 ? SYNTH_NUM_TTL_LINES : 0;
+}
+
+float SyntheticThread::getSampleRate(int subProcessor) const
+{
+	return sampleRate;
+}
+
+float SyntheticThread::getBitVolts(const DataChannel* chan) const
+{
+	return SYNTH_BIT_VOLTS;
+}
+
+void SyntheticThread::resizeBuffers()
+{
+	resizeSourceBuffer(0, numChannels);
+}
+
+void SyntheticThread::setNumChannels(int channels)
+{
+	numChannels = jlimit(1, SYNTH_MAX_CHANNELS, channels);
+}
+
+int SyntheticThread::getNumChannels() const
+{
+	return numChannels;
+}
+
+void SyntheticThread::setSampleRate(float rate)
+{
+	sampleRate = jmax(1000.0f, rate);
+}
+
+int64 SyntheticThread::getDroppedSamples() const
+{
+	return droppedSamples;
+}
+
+void SyntheticThread::prepareTables()
+{
+	// One second of LFP, so its delta, theta and gamma components repeat seamlessly
+	lfpTableSize = jmax(1, roundToInt(sampleRate));
+	lfpTable.malloc(lfpTableSize);
+	for (int i = 0; i < lfpTableSize; ++i)
+	{
+		double t = double_Pi * 2.0 * i / lfpTableSize;
+		lfpTable[i] = (float)(80.0 * std::sin(2.0 * t) + 40.0 * std::sin(8.0 * t) + 10.0 * std::sin(40.0 * t));
+	}
+
+	// Sum of four uniform values, scaled to 10 uV rms
+	uint32 state = 0x2545F491;
+	noiseTable.malloc(SYNTH_NOISE_TABLE_SIZE);
+	for (int i = 0; i < SYNTH_NOISE_TABLE_SIZE; ++i)
+	{
+		float sum = randomUnit(state) + randomUnit(state) + randomUnit(state) + randomUnit(state);
+		noiseTable[i] = sum * (10.0f * 0.8660254f);
+	}
+
+	// 1.6 ms biphasic waveform with a unit trough
+	spikeSamples = jmax(4, roundToInt(sampleRate * 0.0016f));
+	spikeTemplate.malloc(spikeSamples);
+	for (int k = 0; k < spikeSamples; ++k)
+	{
+		float t = (float)k / spikeSamples;
+		float trough = (t - 0.25f) / 0.06f;
+		float peak = (t - 0.5f) / 0.15f;
+		spikeTemplate[k] = -std::exp(-trough * trough) + 0.3f * std::exp(-peak * peak);
+	}
+
+	spikeTrains.malloc(numChannels);
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		SpikeTrain& train = spikeTrains[ch];
+		train.seed = 0x9E3779B9u * (uint32)(ch + 1) | 1;
+		train.amplitude = 50.0f + (float)(nextRandom(train.seed) % 100);
+		train.lastSpike = -spikeSamples;
+		train.nextSpike = nextRandom(train.seed) % lfpTableSize;
+	}
+}
+
+int64 SyntheticThread::nextSpikeTime(SpikeTrain& train, int64 sample) const
+{
+	// Around 5 Hz, with a refractory period that keeps spikes of a channel from overlapping
+	uint32 meanInterval = (uint32)jmax(1, lfpTableSize / 5);
+	return sample + 2 * spikeSamples + nextRandom(train.seed) % (2 * meanInterval);
+}
+
+void SyntheticThread::generateSamples(float* const* channels, int64* timestamps, uint64* eventCodes,
+	int dstStart, int numSamples, int64 first)
+{
+	// The TTL lines count in binary, the first one toggling ten times a second
+	int64 ttlHalfPeriod = jmax(1, roundToInt(sampleRate / 10.0f));
+	for (int i = 0; i < numSamples; ++i)
+	{
+		timestamps[dstStart + i] = first + i;
+		eventCodes[dstStart + i] = (uint64)((first + i) / ttlHalfPeriod) & ((1 << SYNTH_NUM_TTL_LINES) - 1);
+	}
+
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		float* dst = channels[ch] + dstStart;
+		int lfpIndex = (int)((first + ch * 37) % lfpTableSize);
+		int noiseIndex = (int)((first + ch * 7919) & (SYNTH_NOISE_TABLE_SIZE - 1));
+
+		// Contiguous runs of both tables, so the sums vectorize
+		int i = 0;
+		while (i < numSamples)
+		{
+			int run = jmin(numSamples - i, lfpTableSize - lfpIndex, SYNTH_NOISE_TABLE_SIZE - noiseIndex);
+			const float* lfp = lfpTable + lfpIndex;
+			const float* noise = noiseTable + noiseIndex;
+			for (int k = 0; k < run; ++k)
+				dst[i + k] = lfp[k] + noise[k];
+
+			i += run;
+			lfpIndex += run;
+			if (lfpIndex == lfpTableSize)
+				lfpIndex = 0;
+			noiseIndex = (noiseIndex + run) & (SYNTH_NOISE_TABLE_SIZE - 1);
+		}
+
+		SpikeTrain& train = spikeTrains[ch];
+		if (train.lastSpike + spikeSamples > first)
+			addSpike(dst, spikeTemplate, spikeSamples, train.amplitude, train.lastSpike, first, numSamples);
+
+		while (train.nextSpike < first + numSamples)
+		{
+			addSpike(dst, spikeTemplate, spikeSamples, train.amplitude, train.nextSpike, first, numSamples);
+			train.lastSpike = train.nextSpike;
+			train.nextSpike = nextSpikeTime(train, train.nextSpike);
+		}
+	}
+}
+
+bool SyntheticThread::startAcquisition()
+{
+	prepareTables();
+
+	samplesGenerated = 0;
+	droppedSamples = 0;
+	sourceBuffers[0]->clear();
+
+	std::cout << "Synthetic source generating " << numChannels << " channels at " << sampleRate << " Hz." << std::endl;
+
+	startTimeMs = Time::getMillisecondCounterHiRes();
+	offline = CoreServices::getOfflineMode();
+	startThread();
+
+	return true;
+}
+
+bool SyntheticThread::stopAcquisition()
+{
+	if (isThreadRunning())
+		signalThreadShouldExit();
+
+	if (!waitForThreadToExit(500))
+		std::cout << "Synthetic source thread failed to exit, continuing anyway..." << std::endl;
+
+	sourceBuffers[0]->clear();
+
+	if (droppedSamples > 0)
+		std::cout << "Synthetic source dropped " << droppedSamples << " of " << samplesGenerated
+		<< " samples because the buffer was full." << std::endl;
+
+	return true;
+}
+
+bool SyntheticThread::updateBuffer()
+{
+	DataBuffer* buffer = sourceBuffers[0];
+
+	// Samples are generated as they fall due in real time, or as fast as they are read offline
+	int64 due = SYNTH_BUFFER_SAMPLES;
+	if (!offline)
+	{
+		double elapsedMs = Time::getMillisecondCounterHiRes() - startTimeMs;
+		due = (int64)(elapsedMs * 0.001 * sampleRate) - samplesGenerated;
+	}
+
+	if (due < SYNTH_BLOCK_SAMPLES)
+	{
+		waitForData(SYNTH_BLOCK_SAMPLES);
+		return true;
+	}
+
+	int toWrite = (int)jmin(due, (int64)SYNTH_BUFFER_SAMPLES);
+	int startIndex1, blockSize1, startIndex2, blockSize2;
+	int numItems = buffer->prepareToWrite(toWrite, startIndex1, blockSize1, startIndex2, blockSize2);
+
+	// offline, a full buffer only means the graph hasn't caught up yet
+	if (offline && numItems < SYNTH_BLOCK_SAMPLES)
+	{
+		Thread::sleep(1);
+		return true;
+	}
+
+	float* const* channels = buffer->getChannelWritePointers();
+	int64* timestamps = buffer->getTimestampWritePointer();
+	uint64* eventCodes = buffer->getEventCodeWritePointer();
+
+	generateSamples(channels, timestamps, eventCodes, startIndex1, blockSize1, samplesGenerated);
+	if (blockSize2 > 0)
+		generateSamples(channels, timestamps, eventCodes, startIndex2, blockSize2, samplesGenerated + blockSize1);
+
+	buffer->finishedWrite(numItems, startIndex1);
+	samplesGenerated += numItems;
+
+	// A reader that can't keep up loses the samples the buffer has no room for,
+	// which shows up as a gap in the sample numbers
+	if (!offline && numItems < due)
+	{
+		droppedSamples += due - numItems;
+		samplesGenerated += due - numItems;
+	}
+
+	dataArrived();
+	return true;
+}
@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SYNTHETICTHREAD_H_7A1E52C3__
+#define __SYNTHETICTHREAD_H_7A1E52C3__
+
+#include <DataThreadHeaders.h>
+
+#define SYNTH_MAX_CHANNELS		4096
+#define SYNTH_DEFAULT_CHANNELS	384
+#define SYNTH_DEFAULT_RATE		30000.0f
+#define SYNTH_NUM_TTL_LINES		8
+#define SYNTH_BLOCK_SAMPLES		256
+#define SYNTH_BUFFER_SAMPLES	10000
+#define SYNTH_NOISE_TABLE_SIZE	65536	// must be a power of two
+#define SYNTH_BIT_VOLTS			0.195f
+
+namespace SyntheticSource
+{
+
+	/**
+		Generates synthetic neural data for load testing the signal chain without hardware.
+
+		Every channel carries a slow LFP, broadband noise and spikes at a few Hz, and the
+		TTL lines count up as a binary clock. The output only depends on the settings, so
+		runs can be compared, and the samples are generated straight into the DataBuffer
+		without allocating once acquisition has started.
+
+		The edges of the TTL lines are timestamped triggers for output processors, so a
+		chain like Synthetic Source -> Arduino Output run with --latency-benchmark measures
+		the closed-loop latency of the outputs without hardware inputs.
+
+		@see DataThread, SourceNode
+	*/
+	class SyntheticThread : public DataThread
+	{
+	public:
+		SyntheticThread(SourceNode* sn);
+		~SyntheticThread();
+
+		bool foundInputSource() override;
+
+		bool startAcquisition() override;
+		bool stopAcquisition() override;
+
+		int getNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessor) const override;
+		int getNumTTLOutputs(int subProcessor) const override;
+
+		float getSampleRate(int subProcessor) const override;
+		float getBitVolts(const DataChannel* chan) const override;
+
+		void resizeBuffers() override;
+
+		GenericEditor* createEditor(SourceNode* sn) override;
+
+		/** Number of generated channels, up to SYNTH_MAX_CHANNELS. Takes effect on the next chain update.*/
+		void setNumChannels(int numChannels);
+		int getNumChannels() const;
+
+		/** Sample rate of the generated data. Takes effect on the next chain update.*/
+		void setSampleRate(float rate);
+
+		/** Samples the DataBuffer had no room for during the last acquisition */
+		int64 getDroppedSamples() const;
+
+	private:
+		bool updateBuffer() override;
+
+		/** Per-channel state of the spike generator */
+		struct SpikeTrain
+		{
+			uint32 seed;
+			int64 lastSpike;
+			int64 nextSpike;
+			float amplitude;
+		};
+
+		/** Builds the LFP, noise and spike tables and the spike trains for the current settings */
+		void prepareTables();
+
+		/** Fills numSamples consecutive samples of every channel, starting at sample number first */
+		void generateSamples(float* const* channels, int64* timestamps, uint64* eventCodes,
+			int dstStart, int numSamples, int64 first);
+
+		/** Draws the time of the spike following the one at the given sample */
+		int64 nextSpikeTime(SpikeTrain& train, int64 sample) const;
+
+		int numChannels;
+		float sampleRate;
+
+		HeapBlock<float> lfpTable;
+		int lfpTableSize;
+		HeapBlock<float> noiseTable;
+		HeapBlock<float> spikeTemplate;
+		int spikeSamples;
+		HeapBlock<SpikeTrain> spikeTrains;
+
+		int64 samplesGenerated;
+		int64 droppedSamples;
+		double startTimeMs;
+
+		/** True when the graph runs offline; the samples are then generated as fast as
+			the buffer takes them instead of in real time */
+		bool offline;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SyntheticThread);
+	};
+
+}
+
+#endif  // __SYNTHETICTHREAD_H_7A1E52C3__
@@ -27,9 +27,23 @@
 
 
 #include "../Utils/Utils.h"
+#include "../Utils/PipelineTrace.h"
 
-AudioComponent::AudioComponent() : isPlaying(false)
+/* How often the offline speed estimate is refreshed */
+#define OFFLINE_SPEED_INTERVAL_MS 500
+
+AudioComponent::AudioComponent() : isPlaying(false), lowLatencyMode(false), normalBufferSize(1024), offlineMode(false),
+    timerClock(false), timerClockPeriodMs(TIMER_CLOCK_DEFAULT_PERIOD_MS), timerClockSampleRate(44100.0)
 {
+    // the device is opened once, directly with the settings it runs with
+    AudioDeviceManager::AudioDeviceSetup preferredSetup;
+    preferredSetup.bufferSize = 1024; /// larger buffer = fewer empty blocks, but longer latencies
+    preferredSetup.useDefaultInputChannels = false;
+    preferredSetup.inputChannels = 0;
+    preferredSetup.useDefaultOutputChannels = true;
+    preferredSetup.outputChannels = 2;
+    preferredSetup.sampleRate = 44100.0;
+
     bool initialized = false;
     while (!initialized)
     {
@@ -39,7 +53,7 @@ AudioComponent::AudioComponent() : isPlaying(false)
             0,  // *savedState (XmlElement)
             true, // selectDefaultDeviceOnFailure
             String::empty, // preferred device
-            0); // preferred device setup options
+            &preferredSetup); // preferred device setup options
 
         if (error == String::empty)
         {
@@ -67,16 +81,16 @@ AudioComponent::AudioComponent() : isPlaying(false)
 
     AudioIODevice* aIOd = deviceManager.getCurrentAudioDevice();
 
+    graphPlayer = new AudioProcessorPlayer();
+    callbackMonitor = new CallbackMonitor(graphPlayer);
+
     // the error string doesn't tell you if there's no audio device found...
     if (aIOd == 0)
     {
-        String titleMessage = String("No audio device found");
-        String contentMessage = String("Couldn't find an audio device. ") +
-                                String("Perhaps some other program has control of the default one.");
-        AlertWindow::showMessageBox(AlertWindow::InfoIcon,
-                                    titleMessage,
-                                    contentMessage);
-        JUCEApplication::quit();
+        // headless machines often have no sound card; the timer clock drives acquisition instead
+        LOGD("No audio device found, acquisition will run from the timer clock.");
+        timerClock = true;
+        return;
     }
 
 
@@ -89,15 +103,6 @@ AudioComponent::AudioComponent() : isPlaying(false)
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
-    setup.bufferSize = 1024; /// larger buffer = fewer empty blocks, but longer latencies
-    setup.useDefaultInputChannels = false;
-    setup.inputChannels = 0;
-    setup.useDefaultOutputChannels = true;
-    setup.outputChannels = 2;
-    setup.sampleRate = 44100.0;
-
-    String msg = deviceManager.setAudioDeviceSetup(setup, false);
-
     String devType = deviceManager.getCurrentAudioDeviceType();
     LOGD("Audio device type: ", devType);
 
@@ -110,8 +115,6 @@ AudioComponent::AudioComponent() : isPlaying(false)
     LOGD("Audio device sample rate: ", sr);
     LOGD("Audio device buffer size: ", buffSize);
 
-    graphPlayer = new AudioProcessorPlayer();
-
     stopDevice(); // reduces the amount of background processing when
     // device is not in use
 
@@ -131,17 +134,128 @@ int AudioComponent::getBufferSize()
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
+    if (timerClock && !offlineMode)
+    {
+        const double sampleRate = setup.sampleRate > 0 ? setup.sampleRate : timerClockSampleRate;
+        return jmax(1, roundToInt(timerClockPeriodMs * sampleRate / 1000.0));
+    }
+
     return setup.bufferSize;
 }
 
 int AudioComponent::getBufferSizeMs()
 {
+    if (timerClock && !offlineMode)
+        return roundToInt(timerClockPeriodMs);
+
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
     return int(float(setup.bufferSize)/setup.sampleRate*1000);
 }
 
+void AudioComponent::setLowLatencyMode(bool enabled)
+{
+    if (enabled == lowLatencyMode)
+        return;
+
+    AudioDeviceManager::AudioDeviceSetup setup;
+    deviceManager.getAudioDeviceSetup(setup);
+
+    if (enabled)
+    {
+        AudioIODevice* device = deviceManager.getCurrentAudioDevice();
+        if (device == nullptr)
+            return;
+
+        Array<int> sizes = device->getAvailableBufferSizes();
+        int lowLatencySize = setup.bufferSize;
+
+        for (auto size : sizes)
+        {
+            if (size >= LOW_LATENCY_BUFFER_SIZE && size < lowLatencySize)
+                lowLatencySize = size;
+        }
+
+        normalBufferSize = setup.bufferSize;
+        setup.bufferSize = lowLatencySize;
+    }
+    else
+    {
+        setup.bufferSize = normalBufferSize;
+    }
+
+    String error = deviceManager.setAudioDeviceSetup(setup, true);
+
+    if (error.isNotEmpty())
+    {
+        LOGD("Unable to change the audio buffer size: ", error);
+        return;
+    }
+
+    lowLatencyMode = enabled;
+    LOGD("Low-latency mode ", enabled ? "on" : "off", ", buffer size: ", getBufferSize());
+}
+
+bool AudioComponent::isLowLatencyMode() const
+{
+    return lowLatencyMode;
+}
+
+void AudioComponent::setOfflineMode(bool enabled)
+{
+    if (isPlaying)
+        return;
+
+    offlineMode = enabled;
+    LOGD("Offline mode ", enabled ? "on" : "off");
+}
+
+bool AudioComponent::isOfflineMode() const
+{
+    return offlineMode;
+}
+
+float AudioComponent::getOfflineSpeed() const
+{
+    if (offlineDriver == nullptr)
+        return 0.0f;
+
+    return offlineDriver->updateSpeed();
+}
+
+void AudioComponent::setTimerClock(bool enabled)
+{
+    if (isPlaying)
+        return;
+
+    timerClock = enabled;
+    LOGD("Timer clock ", enabled ? "on" : "off");
+}
+
+bool AudioComponent::isTimerClock() const
+{
+    return timerClock;
+}
+
+void AudioComponent::setTimerClockPeriodMs(double periodMs)
+{
+    timerClockPeriodMs = jlimit(0.1, 1000.0, periodMs);
+}
+
+double AudioComponent::getTimerClockPeriodMs() const
+{
+    return timerClockPeriodMs;
+}
+
+AudioComponent::CallbackStats AudioComponent::getCallbackStats() const
+{
+    if (!isPlaying || offlineDriver != nullptr)
+        return CallbackStats();
+
+    return callbackMonitor->getStats();
+}
+
 void AudioComponent::connectToProcessorGraph(AudioProcessorGraph* processorGraph)
 {
 
@@ -210,8 +324,38 @@ void AudioComponent::beginCallbacks()
         }
 
 
-        LOGD("Adding audio callback.");
-        deviceManager.addAudioCallback(graphPlayer);
+        AudioIODevice* device = deviceManager.getCurrentAudioDevice();
+
+        if (timerClock && !offlineMode)
+        {
+            // the graph runs at the device's rate, so the monitor output plays at the right speed
+            const double sampleRate = device != nullptr ? device->getCurrentSampleRate() : timerClockSampleRate;
+            const int blockSize = jmax(1, roundToInt(timerClockPeriodMs * sampleRate / 1000.0));
+
+            LOGD("Starting the timer clock: ", blockSize, " samples every ", timerClockPeriodMs, " ms.");
+            timerClockDevice = new TimerClockDevice(sampleRate, blockSize, 2);
+            timerClockDevice->open(BigInteger(), BigInteger(), sampleRate, blockSize);
+            timerClockDevice->start(callbackMonitor);
+
+            if (device != nullptr)
+                deviceManager.addAudioCallback(timerClockDevice->getMonitorCallback());
+        }
+        else if (offlineMode && device != nullptr)
+        {
+            LOGD("Starting offline processing.");
+            graphPlayer->audioDeviceAboutToStart(device);
+
+            offlineDriver = new OfflineDriver(graphPlayer,
+                                              device->getActiveOutputChannels().countNumberOfSetBits(),
+                                              device->getCurrentBufferSizeSamples(),
+                                              device->getCurrentSampleRate());
+            offlineDriver->startThread();
+        }
+        else
+        {
+            LOGD("Adding audio callback.");
+            deviceManager.addAudioCallback(callbackMonitor);
+        }
         isPlaying = true;
     }
     else
@@ -253,8 +397,29 @@ void AudioComponent::endCallbacks()
     }
 
 
-    LOGD("Removing audio callback.");
-    deviceManager.removeAudioCallback(graphPlayer);
+    if (timerClockDevice != nullptr)
+    {
+        LOGD("Stopping the timer clock.");
+        deviceManager.removeAudioCallback(timerClockDevice->getMonitorCallback());
+        timerClockDevice->stop();
+
+        LOGD("Timer clock: ", timerClockDevice->getSkippedBlocks(), " blocks skipped");
+        timerClockDevice = nullptr;
+    }
+    else if (offlineDriver != nullptr)
+    {
+        LOGD("Stopping offline processing.");
+        offlineDriver->stopThread(5000);
+        graphPlayer->audioDeviceStopped();
+
+        LOGD("Offline run: ", offlineDriver->getAverageSpeed(), "x real time");
+        offlineDriver = nullptr;
+    }
+    else
+    {
+        LOGD("Removing audio callback.");
+        deviceManager.removeAudioCallback(callbackMonitor);
+    }
     isPlaying = false;
 
     stopDevice();
@@ -286,7 +451,11 @@ void AudioComponent::saveStateToXml(XmlElement* parent)
     deviceManager.getAudioDeviceSetup(setup);
 
     parent->setAttribute("sampleRate", setup.sampleRate);
-    parent->setAttribute("bufferSize", setup.bufferSize);
+    parent->setAttribute("bufferSize", lowLatencyMode ? normalBufferSize : setup.bufferSize);
+    parent->setAttribute("lowLatencyMode", lowLatencyMode);
+    parent->setAttribute("offlineMode", offlineMode);
+    parent->setAttribute("timerClock", timerClock);
+    parent->setAttribute("timerClockPeriodMs", timerClockPeriodMs);
     parent->setAttribute("deviceType", deviceManager.getCurrentAudioDeviceType());
 }
 
@@ -340,4 +509,202 @@ void AudioComponent::loadStateFromXml(XmlElement* parent)
     }
 
     deviceManager.setAudioDeviceSetup(setup, true);
-}
\ No newline at end of file
+
+    lowLatencyMode = false;
+    setLowLatencyMode(parent->getBoolAttribute("lowLatencyMode", false));
+
+    setOfflineMode(parent->getBoolAttribute("offlineMode", false));
+
+    // without an audio device the timer clock stays on whatever the saved state says
+    setTimerClock(parent->getBoolAttribute("timerClock", false) || deviceManager.getCurrentAudioDevice() == nullptr);
+    setTimerClockPeriodMs(parent->getDoubleAttribute("timerClockPeriodMs", TIMER_CLOCK_DEFAULT_PERIOD_MS));
+}
+
+AudioComponent::OfflineDriver::OfflineDriver(AudioProcessorPlayer* player_, int numOutputChannels, int blockSize_, double sampleRate_)
+    : Thread("Offline processing"),
+      player(player_),
+      outputBuffer(jmax(1, numOutputChannels), blockSize_),
+      blockSize(blockSize_),
+      sampleRate(sampleRate_),
+      samplesProcessed(0),
+      startTime(Time::getMillisecondCounterHiRes()),
+      lastTime(startTime),
+      lastSamples(0),
+      lastSpeed(0.0f)
+{
+}
+
+void AudioComponent::OfflineDriver::run()
+{
+    // same calls the audio device would make, without waiting for it between blocks
+    while (!threadShouldExit())
+    {
+        player->audioDeviceIOCallback(nullptr, 0,
+                                      outputBuffer.getArrayOfWritePointers(),
+                                      outputBuffer.getNumChannels(),
+                                      blockSize);
+
+        samplesProcessed += blockSize;
+    }
+}
+
+float AudioComponent::OfflineDriver::updateSpeed()
+{
+    const double now = Time::getMillisecondCounterHiRes();
+
+    if (now - lastTime >= OFFLINE_SPEED_INTERVAL_MS)
+    {
+        const int64 samples = samplesProcessed.get();
+
+        lastSpeed = float((samples - lastSamples) / sampleRate / ((now - lastTime) / 1000.0));
+        lastSamples = samples;
+        lastTime = now;
+    }
+
+    return lastSpeed;
+}
+
+float AudioComponent::OfflineDriver::getAverageSpeed() const
+{
+    const double elapsed = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+    if (elapsed <= 0.0)
+        return 0.0f;
+
+    return float(samplesProcessed.get() / sampleRate / elapsed);
+}
+AudioComponent::CallbackMonitor::CallbackMonitor(AudioIODeviceCallback* target_)
+    : target(target_),
+      blockCount(0),
+      maxDelayNs(0),
+      lastBudgetNs(0),
+      overruns(0),
+      xruns(0),
+      sampleRate(0),
+      lastCallbackTicks(0),
+      nsPerTick(1.0e9 / double(Time::getHighResolutionTicksPerSecond()))
+{
+    for (auto& block : blocks)
+    {
+        block.intervalNs = 0;
+        block.delayNs = 0;
+        block.processNs = 0;
+    }
+}
+
+void AudioComponent::CallbackMonitor::audioDeviceAboutToStart(AudioIODevice* device)
+{
+    sampleRate = device->getCurrentSampleRate();
+    lastCallbackTicks = 0;
+
+    blockCount = 0;
+    maxDelayNs = 0;
+    lastBudgetNs = 0;
+    overruns = 0;
+    xruns = 0;
+
+    target->audioDeviceAboutToStart(device);
+}
+
+void AudioComponent::CallbackMonitor::audioDeviceStopped()
+{
+    target->audioDeviceStopped();
+}
+
+void AudioComponent::CallbackMonitor::audioDeviceError(const String& errorMessage)
+{
+    target->audioDeviceError(errorMessage);
+}
+
+void AudioComponent::CallbackMonitor::audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+                                                            float** outputChannelData, int numOutputChannels,
+                                                            int numSamples)
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    target->audioDeviceIOCallback(inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples);
+
+    const int64 endTicks = Time::getHighResolutionTicks();
+
+    PipelineTrace::addSpan("audio", "audio callback", startTicks, endTicks);
+
+    const uint32 budgetNs = sampleRate > 0 ? uint32(numSamples / sampleRate * 1.0e9) : 0;
+    const uint32 processNs = uint32(jmin(double(endTicks - startTicks) * nsPerTick, 4.0e9));
+
+    if (budgetNs > 0 && processNs > budgetNs)
+        overruns++;
+
+    // the first callback has no previous one to be late after
+    if (lastCallbackTicks == 0)
+    {
+        lastCallbackTicks = startTicks;
+        lastBudgetNs = budgetNs;
+        return;
+    }
+
+    const uint32 intervalNs = uint32(jmin(double(startTicks - lastCallbackTicks) * nsPerTick, 4.0e9));
+    const uint32 previousBudgetNs = lastBudgetNs.load(std::memory_order_relaxed);
+    const uint32 delayNs = intervalNs > previousBudgetNs ? intervalNs - previousBudgetNs : 0;
+
+    if (delayNs > previousBudgetNs / 2)
+        xruns++;
+
+    if (delayNs > maxDelayNs.load(std::memory_order_relaxed))
+        maxDelayNs = delayNs;
+
+    const int64 count = blockCount.load(std::memory_order_relaxed);
+    Block& block = blocks[count % CALLBACK_PROFILE_BLOCKS];
+
+    block.intervalNs.store(intervalNs, std::memory_order_relaxed);
+    block.delayNs.store(delayNs, std::memory_order_relaxed);
+    block.processNs.store(processNs, std::memory_order_relaxed);
+
+    blockCount.store(count + 1, std::memory_order_release);
+
+    lastCallbackTicks = startTicks;
+    lastBudgetNs.store(budgetNs, std::memory_order_relaxed);
+}
+
+AudioComponent::CallbackStats AudioComponent::CallbackMonitor::getStats() const
+{
+    CallbackStats stats;
+
+    const int64 count = blockCount.load(std::memory_order_acquire);
+    const int numBlocks = int(jmin<int64>(count, CALLBACK_PROFILE_BLOCKS));
+
+    stats.numCallbacks = count;
+    stats.blockUs = lastBudgetNs.load(std::memory_order_relaxed) / 1000.0f;
+    stats.maxDelayUs = maxDelayNs.load(std::memory_order_relaxed) / 1000.0f;
+    stats.overruns = overruns.load(std::memory_order_relaxed);
+    stats.xruns = xruns.load(std::memory_order_relaxed);
+
+    if (numBlocks == 0)
+        return stats;
+
+    double intervalSum = 0, intervalSquares = 0, delaySum = 0, processSum = 0;
+    uint32 maxProcessNs = 0;
+
+    for (int i = 0; i < numBlocks; i++)
+    {
+        const Block& block = blocks[(count - 1 - i) % CALLBACK_PROFILE_BLOCKS];
+
+        const double interval = block.intervalNs.load(std::memory_order_relaxed);
+        const uint32 processNs = block.processNs.load(std::memory_order_relaxed);
+
+        intervalSum += interval;
+        intervalSquares += interval * interval;
+        delaySum += block.delayNs.load(std::memory_order_relaxed);
+        processSum += processNs;
+        maxProcessNs = jmax(maxProcessNs, processNs);
+    }
+
+    const double meanInterval = intervalSum / numBlocks;
+
+    stats.meanIntervalUs = float(meanInterval / 1000.0);
+    stats.jitterUs = float(std::sqrt(jmax(0.0, intervalSquares / numBlocks - meanInterval * meanInterval)) / 1000.0);
+    stats.meanDelayUs = float(delaySum / numBlocks / 1000.0);
+    stats.meanProcessUs = float(processSum / numBlocks / 1000.0);
+    stats.maxProcessUs = maxProcessNs / 1000.0f;
+
+    return stats;
+}
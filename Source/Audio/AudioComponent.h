@@ -25,6 +25,17 @@
 #define __AUDIOCOMPONENT_H_D97C73CF__
 
 #include "../../JuceLibraryCode/JuceHeader.h"
+#include "TimerClockDevice.h"
+#include <atomic>
+
+/** Smallest buffer size used in low-latency mode; shorter blocks cost more in per-block overhead than they save */
+#define LOW_LATENCY_BUFFER_SIZE 32
+
+/** Number of audio callbacks the timing statistics are computed from */
+#define CALLBACK_PROFILE_BLOCKS 1024
+
+/** Block period of the timer clock unless set otherwise, in ms */
+#define TIMER_CLOCK_DEFAULT_PERIOD_MS 10.0
 
 /**
 
@@ -82,6 +93,63 @@ public:
     /** Returns the buffer size (in ms) currently being used.*/
     int getBufferSizeMs();
 
+    /** Switches the audio device to the smallest buffer size it supports that is at least
+    LOW_LATENCY_BUFFER_SIZE samples, so closed-loop chains react within a few samples, or
+    back to the buffer size that was used before. Recording and display work with any block size.*/
+    void setLowLatencyMode(bool enabled);
+
+    /** Returns true if low-latency mode is on.*/
+    bool isLowLatencyMode() const;
+
+    /** In offline mode, beginCallbacks() drives the ProcessorGraph from a thread of its own,
+    one block after the other as fast as the processors allow, instead of from the audio
+    device. Meant for reprocessing recordings with the File Reader; sources that stream
+    in real time will not keep up. Can only be changed while acquisition is stopped.*/
+    void setOfflineMode(bool enabled);
+
+    /** Returns true if offline mode is on.*/
+    bool isOfflineMode() const;
+
+    /** Returns how many seconds of data the offline run processes per second,
+    or 0 when no offline run is active.*/
+    float getOfflineSpeed() const;
+
+    /** With the timer clock on, beginCallbacks() drives the ProcessorGraph from a real-time
+    thread of its own, once every block period, instead of from the audio device, so block
+    timing doesn't depend on a sound card driver and acquisition runs on machines without one.
+    The output still goes to the audio device for monitoring when there is one. Offline mode
+    takes precedence. Can only be changed while acquisition is stopped; it is turned on at
+    startup when no audio device is found.*/
+    void setTimerClock(bool enabled);
+
+    /** Returns true if the timer clock is on.*/
+    bool isTimerClock() const;
+
+    /** Sets the block period of the timer clock, in ms. Takes effect at the next beginCallbacks().*/
+    void setTimerClockPeriodMs(double periodMs);
+
+    /** Returns the block period of the timer clock, in ms.*/
+    double getTimerClockPeriodMs() const;
+
+    /** Timing of the audio device callbacks since acquisition started */
+    struct CallbackStats
+    {
+        int64 numCallbacks = 0;
+        float blockUs = 0;              // duration of the last block at the device sample rate
+        float meanIntervalUs = 0;       // time between successive callbacks, over the recent callbacks
+        float jitterUs = 0;             // standard deviation of that interval
+        float meanDelayUs = 0;          // how late the recent callbacks came, past the end of the previous block
+        float maxDelayUs = 0;           // the latest callback since acquisition started
+        float meanProcessUs = 0;        // time spent processing the recent blocks
+        float maxProcessUs = 0;
+        int overruns = 0;               // blocks that took longer to process than they last
+        int xruns = 0;                  // callbacks more than half a block late, so the device dropped data
+    };
+
+    /** Returns the callback timing, of the timer clock when it drives the graph, or empty
+    statistics in offline mode or while stopped. Safe to call from any thread.*/
+    CallbackStats getCallbackStats() const;
+
     /** Saves all audio settings that can be loaded to an XML element */
     void saveStateToXml(XmlElement* parent);
 
@@ -94,8 +162,88 @@ private:
 
     bool isPlaying;
 
+    bool lowLatencyMode;
+    int normalBufferSize;
+
+    bool offlineMode;
+
+    bool timerClock;
+    double timerClockPeriodMs;
+
+    /** The device the timer clock drives the graph through while it is on, and its sample rate
+    when there is no audio device to take it from */
+    ScopedPointer<TimerClockDevice> timerClockDevice;
+    double timerClockSampleRate;
+
     ScopedPointer<AudioProcessorPlayer> graphPlayer;
 
+    /** Calls the AudioProcessorPlayer back to back in place of the audio device */
+    class OfflineDriver : public Thread
+    {
+    public:
+        OfflineDriver(AudioProcessorPlayer* player, int numOutputChannels, int blockSize, double sampleRate);
+
+        void run() override;
+
+        /** Seconds of data processed per second of wall-clock time since the last call */
+        float updateSpeed();
+
+        /** Seconds of data processed per second since the run started */
+        float getAverageSpeed() const;
+
+    private:
+        AudioProcessorPlayer* player;
+        AudioSampleBuffer outputBuffer;
+        int blockSize;
+        double sampleRate;
+
+        Atomic<int64> samplesProcessed;
+        double startTime;
+        double lastTime;
+        int64 lastSamples;
+        float lastSpeed;
+    };
+
+    ScopedPointer<OfflineDriver> offlineDriver;
+
+    /** Times the callbacks of the audio device on their way to the AudioProcessorPlayer */
+    class CallbackMonitor : public AudioIODeviceCallback
+    {
+    public:
+        CallbackMonitor(AudioIODeviceCallback* target);
+
+        void audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+                                   float** outputChannelData, int numOutputChannels, int numSamples) override;
+        void audioDeviceAboutToStart(AudioIODevice* device) override;
+        void audioDeviceStopped() override;
+        void audioDeviceError(const String& errorMessage) override;
+
+        CallbackStats getStats() const;
+
+    private:
+        struct Block
+        {
+            std::atomic<uint32> intervalNs;
+            std::atomic<uint32> delayNs;
+            std::atomic<uint32> processNs;
+        };
+
+        AudioIODeviceCallback* target;
+
+        Block blocks[CALLBACK_PROFILE_BLOCKS];
+        std::atomic<int64> blockCount;
+        std::atomic<uint32> maxDelayNs;
+        std::atomic<uint32> lastBudgetNs;
+        std::atomic<int> overruns;
+        std::atomic<int> xruns;
+
+        double sampleRate;
+        int64 lastCallbackTicks;
+        const double nsPerTick;
+    };
+
+    ScopedPointer<CallbackMonitor> callbackMonitor;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioComponent);
 
 };
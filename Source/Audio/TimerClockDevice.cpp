@@ -0,0 +1,234 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TimerClockDevice.h"
+#include "../Utils/ThreadConfig.h"
+
+TimerClockDevice::TimerClockDevice(double sampleRate_, int blockSize_, int numOutputChannels_)
+    : AudioIODevice("Timer clock", "Timer"),
+      Thread("Timer clock"),
+      sampleRate(sampleRate_),
+      blockSize(blockSize_),
+      numOutputChannels(jmax(1, numOutputChannels_)),
+      callback(nullptr),
+      outputBuffer(numOutputChannels, blockSize),
+      monitorFifo(blockSize * TIMER_CLOCK_MONITOR_BLOCKS),
+      monitorBuffer(numOutputChannels, blockSize * TIMER_CLOCK_MONITOR_BLOCKS),
+      monitorOutput(*this),
+      skippedBlocks(0),
+      opened(false)
+{
+}
+
+TimerClockDevice::~TimerClockDevice()
+{
+    close();
+}
+
+StringArray TimerClockDevice::getOutputChannelNames()
+{
+    StringArray names;
+    for (int i = 0; i < numOutputChannels; i++)
+        names.add("Output " + String(i + 1));
+    return names;
+}
+
+StringArray TimerClockDevice::getInputChannelNames()        { return StringArray(); }
+Array<double> TimerClockDevice::getAvailableSampleRates()   { Array<double> rates; rates.add(sampleRate); return rates; }
+Array<int> TimerClockDevice::getAvailableBufferSizes()      { Array<int> sizes; sizes.add(blockSize); return sizes; }
+int TimerClockDevice::getDefaultBufferSize()                { return blockSize; }
+
+String TimerClockDevice::open(const BigInteger&, const BigInteger&, double, int)
+{
+    // the rate and block size are those the clock was made with
+    opened = true;
+    return String::empty;
+}
+
+void TimerClockDevice::close()
+{
+    stop();
+    opened = false;
+}
+
+bool TimerClockDevice::isOpen()                             { return opened; }
+bool TimerClockDevice::isPlaying()                          { return isThreadRunning(); }
+String TimerClockDevice::getLastError()                     { return String::empty; }
+int TimerClockDevice::getCurrentBufferSizeSamples()         { return blockSize; }
+double TimerClockDevice::getCurrentSampleRate()             { return sampleRate; }
+int TimerClockDevice::getCurrentBitDepth()                  { return 32; }
+int TimerClockDevice::getOutputLatencyInSamples()           { return 0; }
+int TimerClockDevice::getInputLatencyInSamples()            { return 0; }
+
+BigInteger TimerClockDevice::getActiveOutputChannels() const
+{
+    BigInteger channels;
+    channels.setRange(0, numOutputChannels, true);
+    return channels;
+}
+
+BigInteger TimerClockDevice::getActiveInputChannels() const
+{
+    return BigInteger();
+}
+
+void TimerClockDevice::start(AudioIODeviceCallback* newCallback)
+{
+    if (isThreadRunning() || newCallback == nullptr)
+        return;
+
+    callback = newCallback;
+    callback->audioDeviceAboutToStart(this);
+
+    skippedBlocks = 0;
+    monitorFifo.reset();
+
+    // the clock stands in for a sound card's callback thread, so it runs real-time unless told otherwise
+    const int priority = ThreadConfig::getPriority(ThreadConfig::AUDIO);
+    setAffinityMask(ThreadConfig::getEffectiveCores(ThreadConfig::AUDIO));
+    startThread(priority == THREAD_DEFAULT_PRIORITY ? THREAD_REALTIME_PRIORITY : priority);
+}
+
+void TimerClockDevice::stop()
+{
+    if (callback == nullptr)
+        return;
+
+    stopThread(5000);
+    callback->audioDeviceStopped();
+    callback = nullptr;
+}
+
+AudioIODeviceCallback* TimerClockDevice::getMonitorCallback()
+{
+    return &monitorOutput;
+}
+
+int64 TimerClockDevice::getSkippedBlocks() const
+{
+    return skippedBlocks.load(std::memory_order_relaxed);
+}
+
+void TimerClockDevice::run()
+{
+    const double ticksPerSecond = double(Time::getHighResolutionTicksPerSecond());
+    const int64 periodTicks = jmax<int64>(1, int64(blockSize / sampleRate * ticksPerSecond + 0.5));
+
+    // like a sound card, the first block is due once a block's worth of time has passed
+    int64 deadline = Time::getHighResolutionTicks() + periodTicks;
+
+    while (!threadShouldExit())
+    {
+        waitUntil(deadline);
+
+        if (threadShouldExit())
+            break;
+
+        outputBuffer.clear();
+        callback->audioDeviceIOCallback(nullptr, 0, outputBuffer.getArrayOfWritePointers(), numOutputChannels, blockSize);
+        pushMonitorBlock();
+
+        deadline += periodTicks;
+
+        const int64 lateTicks = Time::getHighResolutionTicks() - deadline;
+        if (lateTicks > TIMER_CLOCK_MAX_LATE_BLOCKS * periodTicks)
+        {
+            const int64 missed = lateTicks / periodTicks;
+            skippedBlocks += missed;
+            deadline += missed * periodTicks;
+        }
+    }
+}
+
+void TimerClockDevice::waitUntil(int64 deadline)
+{
+    const double msPerTick = 1000.0 / double(Time::getHighResolutionTicksPerSecond());
+
+    while (!threadShouldExit())
+    {
+        const double remainingMs = double(deadline - Time::getHighResolutionTicks()) * msPerTick;
+
+        if (remainingMs <= 0)
+            return;
+
+        if (remainingMs > TIMER_CLOCK_SPIN_MS)
+            wait(int(remainingMs) - TIMER_CLOCK_SPIN_MS + 1);
+        else
+            Thread::yield();
+    }
+}
+
+void TimerClockDevice::pushMonitorBlock()
+{
+    int start1, size1, start2, size2;
+    monitorFifo.prepareToWrite(blockSize, start1, size1, start2, size2);
+
+    // a monitor that doesn't keep up loses the newest output
+    for (int ch = 0; ch < numOutputChannels; ch++)
+    {
+        if (size1 > 0)
+            monitorBuffer.copyFrom(ch, start1, outputBuffer, ch, 0, size1);
+        if (size2 > 0)
+            monitorBuffer.copyFrom(ch, start2, outputBuffer, ch, size1, size2);
+    }
+
+    monitorFifo.finishedWrite(size1 + size2);
+}
+
+TimerClockDevice::MonitorOutput::MonitorOutput(TimerClockDevice& owner_)
+    : owner(owner_)
+{
+}
+
+void TimerClockDevice::MonitorOutput::audioDeviceIOCallback(const float**, int,
+                                                            float** outputChannelData, int numOutputChannels,
+                                                            int numSamples)
+{
+    int start1, size1, start2, size2;
+    owner.monitorFifo.prepareToRead(numSamples, start1, size1, start2, size2);
+
+    for (int ch = 0; ch < numOutputChannels; ch++)
+    {
+        float* dest = outputChannelData[ch];
+        if (dest == nullptr)
+            continue;
+
+        const int source = ch % owner.numOutputChannels;
+
+        if (size1 > 0)
+            FloatVectorOperations::copy(dest, owner.monitorBuffer.getReadPointer(source, start1), size1);
+        if (size2 > 0)
+            FloatVectorOperations::copy(dest + size1, owner.monitorBuffer.getReadPointer(source, start2), size2);
+
+        // silence where the clock hasn't produced the output yet
+        if (size1 + size2 < numSamples)
+            FloatVectorOperations::clear(dest + size1 + size2, numSamples - size1 - size2);
+    }
+
+    owner.monitorFifo.finishedRead(size1 + size2);
+}
+
+void TimerClockDevice::MonitorOutput::audioDeviceAboutToStart(AudioIODevice*) {}
+
+void TimerClockDevice::MonitorOutput::audioDeviceStopped() {}
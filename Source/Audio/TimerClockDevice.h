@@ -0,0 +1,137 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TIMERCLOCKDEVICE_H_8E41C2B7__
+#define __TIMERCLOCKDEVICE_H_8E41C2B7__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+/** Blocks of output the timer clock can have waiting for the audio device */
+#define TIMER_CLOCK_MONITOR_BLOCKS 8
+
+/** Below this much time to the next deadline the clock thread spins instead of sleeping */
+#define TIMER_CLOCK_SPIN_MS 2
+
+/** A clock that falls this many blocks behind skips them instead of running them back to back */
+#define TIMER_CLOCK_MAX_LATE_BLOCKS 8
+
+/**
+
+  An audio device without hardware, which calls its callback from a thread of its own
+  once every block period.
+
+  Each block is due a period after the previous one was, whatever the time its
+  processing took, so the graph keeps to the configured rate on average. The thread
+  sleeps until shortly before a deadline and then spins up to it. A clock that falls
+  far behind skips the blocks it missed instead of catching up on them.
+
+  The output of the blocks can be handed on to a real audio device, through the
+  callback returned by getMonitorCallback(), so audio monitoring still works when
+  there is one. The two clocks are not locked to each other, so the monitor drops or
+  repeats silence when they drift apart.
+
+  @see AudioComponent
+
+*/
+
+class TimerClockDevice : public AudioIODevice,
+                         private Thread
+{
+public:
+    TimerClockDevice(double sampleRate, int blockSize, int numOutputChannels);
+    ~TimerClockDevice();
+
+    StringArray getOutputChannelNames() override;
+    StringArray getInputChannelNames() override;
+    Array<double> getAvailableSampleRates() override;
+    Array<int> getAvailableBufferSizes() override;
+    int getDefaultBufferSize() override;
+
+    String open(const BigInteger& inputChannels, const BigInteger& outputChannels,
+                double sampleRate, int bufferSizeSamples) override;
+    void close() override;
+    bool isOpen() override;
+
+    /** Starts the clock thread, which calls the callback once per block period */
+    void start(AudioIODeviceCallback* callback) override;
+    void stop() override;
+    bool isPlaying() override;
+
+    String getLastError() override;
+    int getCurrentBufferSizeSamples() override;
+    double getCurrentSampleRate() override;
+    int getCurrentBitDepth() override;
+    BigInteger getActiveOutputChannels() const override;
+    BigInteger getActiveInputChannels() const override;
+    int getOutputLatencyInSamples() override;
+    int getInputLatencyInSamples() override;
+
+    /** A callback for a real audio device that plays the output of the blocks */
+    AudioIODeviceCallback* getMonitorCallback();
+
+    /** Blocks skipped since the clock started, because it fell too far behind */
+    int64 getSkippedBlocks() const;
+
+private:
+    void run() override;
+
+    /** Sleeps, then spins, until the high resolution tick count reaches deadline */
+    void waitUntil(int64 deadline);
+
+    /** Queues the output of the last block for the monitor callback */
+    void pushMonitorBlock();
+
+    /** Plays the queued output on the real audio device */
+    class MonitorOutput : public AudioIODeviceCallback
+    {
+    public:
+        MonitorOutput(TimerClockDevice& owner);
+
+        void audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+                                   float** outputChannelData, int numOutputChannels, int numSamples) override;
+        void audioDeviceAboutToStart(AudioIODevice* device) override;
+        void audioDeviceStopped() override;
+
+    private:
+        TimerClockDevice& owner;
+    };
+
+    const double sampleRate;
+    const int blockSize;
+    const int numOutputChannels;
+
+    AudioIODeviceCallback* callback;
+    AudioSampleBuffer outputBuffer;
+
+    AbstractFifo monitorFifo;
+    AudioSampleBuffer monitorBuffer;
+    MonitorOutput monitorOutput;
+
+    std::atomic<int64> skippedBlocks;
+    bool opened;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimerClockDevice);
+};
+
+#endif  // __TIMERCLOCKDEVICE_H_8E41C2B7__
@@ -29,8 +29,10 @@
 #include "Processors/RecordNode/RecordNode.h"
 #include "UI/EditorViewport.h"
 #include "UI/ControlPanel.h"
+#include "Processors/MessageCenter/MessageCenter.h"
 #include "Processors/MessageCenter/MessageCenterEditor.h"
 #include "Processors/Events/Events.h"
+#include "Processors/SourceNode/SourceNode.h"
 
 
 using namespace AccessClass;
@@ -83,6 +85,11 @@ namespace CoreServices
 		return getProcessorGraph()->getGlobalTimestamp(false);
 	}
 
+	GlobalTimestampClock getGlobalTimestampClock()
+	{
+		return getProcessorGraph()->getGlobalTimestampClock();
+	}
+
 	juce::uint32 getGlobalTimestampSourceFullId()
 	{
 		return getProcessorGraph()->getGlobalTimestampSourceFullId();
@@ -103,6 +110,60 @@ namespace CoreServices
 		return getProcessorGraph()->getGlobalSampleRate(true);
 	}
 
+	juce::int64 getTimeSinceSampleNs(uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 sampleNumber)
+	{
+		SourceNode* source = dynamic_cast<SourceNode*>(getProcessorGraph()->getProcessorWithNodeId(sourceNodeId));
+		if (source == nullptr)
+			return -1;
+
+		const ClockDriftModel* model = source->getClockDriftModel(subProcessorIdx);
+		if (model == nullptr || !model->isValid())
+			return -1;
+
+		return ClockDriftModel::getCurrentTimeNs() - model->sampleToNs(sampleNumber);
+	}
+
+	static bool latencyBenchmark = false;
+
+	void setLatencyBenchmark(bool enable)
+	{
+		latencyBenchmark = enable;
+	}
+
+	bool getLatencyBenchmark()
+	{
+		return latencyBenchmark;
+	}
+
+	bool getOfflineMode()
+	{
+		return getAudioComponent()->isOfflineMode();
+	}
+
+	bool sendAnnotation(const String& text, juce::int64 timestamp)
+	{
+		if (timestamp < 0)
+			timestamp = getGlobalTimestamp();
+
+		return getProcessorGraph()->getMessageCenter()->addAnnotation(timestamp, false, text.toRawUTF8(), (int)text.getNumBytesAsUTF8());
+	}
+
+	bool sendAnnotation(const char* utf8Text, int size, juce::int64 timestamp)
+	{
+		if (timestamp < 0)
+			timestamp = getGlobalTimestamp();
+
+		return getProcessorGraph()->getMessageCenter()->addAnnotation(timestamp, false, utf8Text, size);
+	}
+
+	bool sendBinaryAnnotation(const void* data, int size, juce::int64 timestamp)
+	{
+		if (timestamp < 0)
+			timestamp = getGlobalTimestamp();
+
+		return getProcessorGraph()->getMessageCenter()->addAnnotation(timestamp, true, data, size);
+	}
+
 	void setRecordingDirectory(String dir)
 	{
 		getControlPanel()->setRecordingDirectory(dir);
@@ -207,6 +268,18 @@ namespace CoreServices
 			return false;
 		}
 
+		void setTriggeredRecording(bool triggered, float preSeconds, float postSeconds)
+		{
+			for (auto* node : getProcessorGraph()->getRecordNodes())
+				node->setTriggeredRecording(triggered, preSeconds, postSeconds);
+		}
+
+		void triggerRecording(uint16 sourceNodeId, uint16 subProcIdx, int64 timestamp, float sampleRate)
+		{
+			for (auto* node : getProcessorGraph()->getRecordNodes())
+				node->addRecordingTrigger(sourceNodeId, subProcIdx, timestamp, sampleRate);
+		}
+
 		/*
 		void writeSpike(const SpikeEvent* spike, const SpikeChannel* chan)
 		{
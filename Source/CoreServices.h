@@ -26,6 +26,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "Processors/PluginManager/OpenEphysPlugin.h"
+#include "Processors/GenericProcessor/ChannelWorkerPool.h"
 
 class GenericEditor;
 class GenericProcessor;
@@ -63,6 +64,31 @@ Defaults to the first hardware timestamp source or the software one if
 no hardware timestamping is present*/
 PLUGIN_API juce::int64 getGlobalTimestamp();
 
+/** The clock behind getGlobalTimestamp(), as published at the start of the last processing block.
+Callers that need many timestamps, such as one per event, can get the clock once per block and
+interpolate from it instead of calling getGlobalTimestamp() each time */
+struct GlobalTimestampClock
+{
+	juce::int64 timestamp{ 0 };		// global timestamp at ticks
+	juce::int64 ticks{ 0 };			// high resolution ticks when the timestamp source last processed a block
+	double samplesPerTick{ 1.0 };	// global sample rate divided by the tick rate
+
+	/** Global timestamp at a time given in high resolution ticks */
+	juce::int64 getTimestamp(juce::int64 atTicks) const
+	{
+		return timestamp + juce::int64(double(atTicks - ticks) * samplesPerTick);
+	}
+
+	/** Global timestamp now */
+	juce::int64 getTimestamp() const
+	{
+		return getTimestamp(juce::Time::getHighResolutionTicks());
+	}
+};
+
+/** Gets the global timestamp clock. Can be called from any thread; it doesn't lock */
+PLUGIN_API GlobalTimestampClock getGlobalTimestampClock();
+
 /** Gets the sample rate selected on the MessageCenter interface
 Defaults to the dsmple rate of the first hardware source or 
 the software high resolution timer if no hardware source is present*/
@@ -78,6 +104,46 @@ PLUGIN_API juce::int64 getSoftwareTimestamp();
 /** Gets the ticker frequency of the software timestamp clock*/
 PLUGIN_API float getSoftwareSampleRate();
 
+/** Gets the time in nanoseconds since a sample of a source subprocessor was acquired, using
+the clock drift model of the source. Returns -1 if the source has no valid model yet */
+PLUGIN_API juce::int64 getTimeSinceSampleNs(uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 sampleNumber);
+
+/** In latency benchmark mode (--latency-benchmark), output processors report the histograms of
+each stage of their closed-loop latency when acquisition stops, and the graph reports the
+process time of every processor */
+PLUGIN_API void setLatencyBenchmark(bool enable);
+PLUGIN_API bool getLatencyBenchmark();
+
+/** True when the graph runs offline, with blocks processed back to back as fast as possible
+instead of at the pace of the audio device. Sources that pace themselves in real time should
+then produce their data as fast as it is consumed */
+PLUGIN_API bool getOfflineMode();
+
+/** Calls function(startChannel, endChannel) for contiguous ranges covering numChannels, in
+parallel on the workers of the shared ChannelWorkerPool, and returns once all ranges are done.
+Real-time safe, for processing threads that need workers outside of a processor's process(),
+which can use GenericProcessor::forEachChannelRange. Use this instead of starting threads of
+your own, so the plugins don't compete for the cores. */
+template <typename RangeFunction>
+void parallelFor(int numChannels, RangeFunction function, int minChannelsPerRange = 32, int channelAlignment = 1)
+{
+	ChannelWorkerPool::getInstance()->parallelFor(numChannels, function, minChannelsPerRange, channelAlignment);
+}
+
+/** Adds a text annotation to the next processing block as a Message Center event, timestamped
+with the global timestamp at the time of the call, or with the given one. Can be called from
+any thread; it doesn't lock nor wait for the message thread. Returns false if acquisition is
+stopped, the text is longer than 512 bytes of UTF-8 or too many annotations are waiting */
+PLUGIN_API bool sendAnnotation(const String& text, juce::int64 timestamp = -1);
+
+/** Same as sendAnnotation, for size bytes of UTF-8 text that don't have to be copied into a
+String first, so it can be called from the processing thread without allocating */
+PLUGIN_API bool sendAnnotation(const char* utf8Text, int size, juce::int64 timestamp = -1);
+
+/** Same as sendAnnotation, for up to 512 bytes of binary data sent on the Message Center's
+annotation channel */
+PLUGIN_API bool sendBinaryAnnotation(const void* data, int size, juce::int64 timestamp = -1);
+
 /** Set new recording directory */
 PLUGIN_API void setRecordingDirectory(String dir);
 
@@ -116,6 +182,14 @@ PLUGIN_API int getRecordingNumber();
 PLUGIN_API int getExperimentNumber();
 PLUGIN_API bool getRecordThreadStatus();
 
+/** Sets every Record Node to record only the windows from preSeconds before to postSeconds after each
+trigger, as segments of the files opened when recording starts. Takes effect at the next recording */
+PLUGIN_API void setTriggeredRecording(bool triggered, float preSeconds, float postSeconds);
+
+/** Writes the windows around a trigger at a timestamp of a source subprocessor in every Record Node
+running a triggered recording. Called from the processing thread */
+PLUGIN_API void triggerRecording(uint16 sourceNodeId, uint16 subProcIdx, juce::int64 timestamp, float sampleRate);
+
 /* Spike related methods. See record engine documentation */
 
 PLUGIN_API void writeSpike(const SpikeEvent* spike, const SpikeChannel* chan);
@@ -27,6 +27,10 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainWindow.h"
 #include "UI/LookAndFeel/CustomLookAndFeel.h"
+#include "CoreServices.h"
+#include "Utils/StartupTrace.h"
+#include "Utils/RealtimeLog.h"
+#include "PipelineBenchmark.h"
 
 #include <stdio.h>
 #include <fstream>
@@ -59,6 +63,8 @@ public:
 
         std::cout << commandLine << std::endl;
 
+        RealtimeLog::start();
+
         StringArray parameters;
         parameters.addTokens(commandLine, " ", "\"");
         parameters.removeEmptyStrings();
@@ -86,20 +92,71 @@ public:
         customLookAndFeel = new CustomLookAndFeel();
         LookAndFeel::setDefaultLookAndFeel(customLookAndFeel);
 
+        StartupTrace::mark("look and feel");
+
 
-        // signal chain to load
-        if (!parameters.isEmpty())
+        // --headless keeps the window off the desktop and enables remote control,
+        // --control-port <port> enables remote control on a given port,
+        // --latency-benchmark reports the closed-loop latency of output processors,
+        // --pipeline-benchmark <seconds> runs the chain headless and offline for that much data,
+        //   recording to --record-dir <dir> and reporting to --benchmark-report <file>
+        bool headless = false;
+        int remoteControlPort = -1;
+        File fileToLoad;
+        double benchmarkSeconds = 0;
+        File benchmarkRecordDirectory;
+        File benchmarkReport;
+
+        for (int i = 0; i < parameters.size(); i++)
         {
-            File fileToLoad(File::getCurrentWorkingDirectory().getChildFile(parameters[0]));
-            mainWindow = new MainWindow(fileToLoad);
+            if (parameters[i] == "--headless")
+            {
+                headless = true;
+            }
+            else if (parameters[i] == "--control-port" && i + 1 < parameters.size())
+            {
+                remoteControlPort = parameters[++i].getIntValue();
+            }
+            else if (parameters[i] == "--latency-benchmark")
+            {
+                CoreServices::setLatencyBenchmark(true);
+            }
+            else if (parameters[i] == "--pipeline-benchmark" && i + 1 < parameters.size())
+            {
+                benchmarkSeconds = parameters[++i].getDoubleValue();
+            }
+            else if (parameters[i] == "--record-dir" && i + 1 < parameters.size())
+            {
+                benchmarkRecordDirectory = File::getCurrentWorkingDirectory().getChildFile(parameters[++i]);
+            }
+            else if (parameters[i] == "--benchmark-report" && i + 1 < parameters.size())
+            {
+                benchmarkReport = File::getCurrentWorkingDirectory().getChildFile(parameters[++i]);
+            }
+            else if (fileToLoad == File())
+            {
+                // signal chain to load
+                fileToLoad = File::getCurrentWorkingDirectory().getChildFile(parameters[i]);
+            }
         }
-        else
+
+        if (headless && remoteControlPort < 0)
+            remoteControlPort = DEFAULT_REMOTE_CONTROL_PORT;
+
+        // the benchmark does not need remote control
+        mainWindow = new MainWindow(fileToLoad, headless || benchmarkSeconds > 0, remoteControlPort);
+
+        if (benchmarkSeconds > 0)
         {
-            mainWindow = new MainWindow();
+            pipelineBenchmark = new PipelineBenchmark(benchmarkSeconds, benchmarkRecordDirectory, benchmarkReport);
+            pipelineBenchmark->start();
         }
     }
 
-    void shutdown() { }
+    void shutdown()
+    {
+        RealtimeLog::stop();
+    }
 
     //==============================================================================
     void systemRequestedQuit()
@@ -127,6 +184,7 @@ public:
 
 private:
     ScopedPointer <MainWindow> mainWindow;
+    ScopedPointer <PipelineBenchmark> pipelineBenchmark;
     ScopedPointer <CustomLookAndFeel> customLookAndFeel;
     std::ofstream console_out;
 };
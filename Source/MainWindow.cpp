@@ -24,14 +24,19 @@
 #include "MainWindow.h"
 #include "UI/UIComponent.h"
 #include "UI/EditorViewport.h"
+#include "Utils/XmlSnapshot.h"
+#include "Utils/MessageThreadMonitor.h"
+#include "Utils/StartupTrace.h"
+#include "Processors/Events/SpikeStore.h"
 #include <stdio.h>
 //-----------------------------------------------------------------------
 
 
-	MainWindow::MainWindow(const File& fileToLoad)
+	MainWindow::MainWindow(const File& fileToLoad, bool headless_, int remoteControlPort)
 : DocumentWindow(JUCEApplication::getInstance()->getApplicationName(),
 		Colour(Colours::black),
-		DocumentWindow::allButtons)
+		DocumentWindow::allButtons),
+	headless(headless_)
 {
 
 	setResizable(true,      // isResizable
@@ -39,6 +44,8 @@
 
 	shouldReloadOnStartup = true;
 
+	MessageThreadMonitor::getInstance()->start();
+
 	// Create ProcessorGraph and AudioComponent, and connect them.
 	// Callbacks will be set by the play button in the control panel
 
@@ -46,9 +53,11 @@
 	LOGD("");
 	LOGD("Created processor graph.");
 	LOGD("");
+	StartupTrace::mark("processor graph");
 
 	audioComponent = new AudioComponent();
 	LOGD("Created audio component.");
+	StartupTrace::mark("audio device");
 
 	audioComponent->connectToProcessorGraph(processorGraph);
 
@@ -65,13 +74,23 @@
 
 	loadWindowBounds();
 	setUsingNativeTitleBar(true);
-	Component::addToDesktop(getDesktopWindowStyleFlags());  // prevents the maximize
-	// button from randomly disappearing
-	setVisible(true);
+
+	if (headless)
+	{
+		LOGD("Running headless.");
+	}
+	else
+	{
+		Component::addToDesktop(getDesktopWindowStyleFlags());  // prevents the maximize
+		// button from randomly disappearing
+		setVisible(true);
+	}
 
 	// Constraining the window's size doesn't seem to work:
 	setResizeLimits(500, 500, 10000, 10000);
 
+	StartupTrace::mark("main window");
+
     if (!fileToLoad.getFullPathName().isEmpty())
     {
         ui->getEditorViewport()->loadState(fileToLoad);
@@ -84,7 +103,7 @@
 		if(lastConfig.existsAsFile())
 		{
 			LOGD("Comparing configs");
-			if(compareConfigFiles(lastConfig, recoveryConfig))
+			if(headless || compareConfigFiles(lastConfig, recoveryConfig))
 			{
 				ui->getEditorViewport()->loadState(lastConfig);
 			}
@@ -104,10 +123,25 @@
 		}
 	}
 
+	StartupTrace::mark("signal chain");
+
+	if (remoteControlPort >= 0)
+	{
+		remoteControl = new RemoteControlServer(remoteControlPort);
+		if (!remoteControl->start())
+			remoteControl = nullptr;
+	}
+
+	// the first turn of the message loop is when the window is drawn and acquisition can start
+	MessageManager::callAsync([] { StartupTrace::finish(); });
+
 }
 
 MainWindow::~MainWindow()
 {
+	remoteControl = nullptr;
+
+	MessageThreadMonitor::getInstance()->stop();
 
 	if (audioComponent->callbacksAreActive())
 	{
@@ -118,7 +152,8 @@ MainWindow::~MainWindow()
     
         
 
-	saveWindowBounds();
+	if (!headless)
+		saveWindowBounds();
 
 	audioComponent->disconnectProcessorGraph();
 	UIComponent* ui = (UIComponent*) getContentComponent();
@@ -161,6 +196,11 @@ void MainWindow::shutDownGUI()
 	processorGraph->disableProcessors();
 }
 
+bool MainWindow::isHeadless() const
+{
+	return headless;
+}
+
 void MainWindow::saveWindowBounds()
 {
 	LOGD("");
@@ -173,6 +213,8 @@ void MainWindow::saveWindowBounds()
 
 	xml->setAttribute("version", JUCEApplication::getInstance()->getApplicationVersion());
 	xml->setAttribute("shouldReloadOnStartup", shouldReloadOnStartup);
+	xml->setAttribute("compactSpikeMessages", SpikeStore::getInstance()->isEnabled());
+	xml->setAttribute("parallelRendering", processorGraph->isParallelRendering());
 
 	XmlElement* bounds = new XmlElement("BOUNDS");
 	bounds->setAttribute("x",getScreenX());
@@ -232,6 +274,8 @@ void MainWindow::loadWindowBounds()
 		String description;
 
 		shouldReloadOnStartup = xml->getBoolAttribute("shouldReloadOnStartup", false);
+		SpikeStore::getInstance()->setEnabled(xml->getBoolAttribute("compactSpikeMessages", false));
+		processorGraph->setParallelRendering(xml->getBoolAttribute("parallelRendering", false));
 
 		forEachXmlChildElement(*xml, e)
 		{
@@ -284,11 +328,8 @@ void MainWindow::loadWindowBounds()
 
 bool MainWindow::compareConfigFiles(File file1, File file2)
 {
-	XmlDocument lcDoc(file1);
-	XmlDocument rcDoc(file2);
-	
-	std::unique_ptr<XmlElement> lcXml (lcDoc.getDocumentElement());
-	std::unique_ptr<XmlElement> rcXml (rcDoc.getDocumentElement());
+	std::unique_ptr<XmlElement> lcXml (XmlSnapshot::readConfig(file1));
+	std::unique_ptr<XmlElement> rcXml (XmlSnapshot::readConfig(file2));
 
 	if(rcXml == 0 || ! rcXml->hasTagName("SETTINGS"))
 	{
@@ -28,6 +28,7 @@
 #include "UI/UIComponent.h"
 #include "Audio/AudioComponent.h"
 #include "Processors/ProcessorGraph/ProcessorGraph.h"
+#include "RemoteControlServer.h"
 
 /**
   The main window for the GUI application.
@@ -45,8 +46,11 @@ class MainWindow   : public DocumentWindow
 public:
 
     /** Initializes the MainWindow, creates the AudioComponent, ProcessorGraph,
-        and UIComponent, and sets the window boundaries. */
-    MainWindow(const File& fileToLoad = File());
+        and UIComponent, and sets the window boundaries.
+
+        A headless window is never put on the desktop, so nothing is painted. If
+        remoteControlPort is not negative, the GUI also accepts commands on that port. */
+    MainWindow(const File& fileToLoad = File(), bool headless = false, int remoteControlPort = -1);
 
     /** Destroys the AudioComponent, ProcessorGraph, and UIComponent, and saves the window boundaries. */
     ~MainWindow();
@@ -64,6 +68,9 @@ public:
 
 	void shutDownGUI();
 
+    /** Returns true if the window was created without being put on the desktop. */
+    bool isHeadless() const;
+
 private:
 
     /** Saves the MainWindow's boundaries into the file "windowState.xml", located in the directory
@@ -84,6 +91,10 @@ private:
     /** A pointer to the application's ProcessorGraph (owned by the MainWindow). */
     ScopedPointer<ProcessorGraph> processorGraph;
 
+    /** Accepts acquisition and recording commands over TCP, if enabled. */
+    ScopedPointer<RemoteControlServer> remoteControl;
+
+    bool headless;
 
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainWindow)
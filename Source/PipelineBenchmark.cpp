@@ -0,0 +1,224 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PipelineBenchmark.h"
+#include "AccessClass.h"
+#include "CoreServices.h"
+#include "Audio/AudioComponent.h"
+#include "Processors/ProcessorGraph/ProcessorGraph.h"
+#include "Processors/RecordNode/RecordNode.h"
+#include "Utils/AllocationCounter.h"
+#include "Utils/Utils.h"
+
+/* How often the progress is checked */
+#define BENCHMARK_POLL_MS 200
+/* The run is abandoned when no data goes through for this long */
+#define BENCHMARK_STALL_MS 30000
+
+PipelineBenchmark::PipelineBenchmark(double seconds_, const File& recordDirectory_, const File& reportFile_)
+    : seconds(seconds_),
+      recordDirectory(recordDirectory_),
+      reportFile(reportFile_),
+      started(false),
+      startTimestamp(0),
+      startTimeMs(0),
+      stopTimeMs(0),
+      lastTimestamp(0),
+      lastProgressMs(0),
+      startAllocations(0),
+      stopAllocations(0)
+{
+    if (reportFile == File())
+        reportFile = CoreServices::getSavedStateDirectory().getChildFile("pipeline-benchmark.json");
+}
+
+PipelineBenchmark::~PipelineBenchmark()
+{
+    stopTimer();
+    AllocationCounter::setEnabled(false);
+}
+
+void PipelineBenchmark::start()
+{
+    if (AccessClass::getProcessorGraph()->getListOfProcessors().size() == 0)
+    {
+        finish("no signal chain is loaded");
+        return;
+    }
+
+    // must be set before acquisition starts
+    AccessClass::getAudioComponent()->setOfflineMode(true);
+
+    if (recordDirectory != File())
+    {
+        recordDirectory.createDirectory();
+        CoreServices::setRecordingDirectory(recordDirectory.getFullPathName());
+    }
+
+    startTimer(BENCHMARK_POLL_MS);
+}
+
+void PipelineBenchmark::timerCallback()
+{
+    const double now = Time::getMillisecondCounterHiRes();
+
+    if (!started)
+    {
+        LOGD("Pipeline benchmark: recording ", seconds, " s of data offline");
+
+        AllocationCounter::setEnabled(true);
+        startAllocations = AllocationCounter::getCount();
+
+        CoreServices::setRecordingStatus(true);
+
+        if (!CoreServices::getAcquisitionStatus())
+        {
+            finish("acquisition could not start");
+            return;
+        }
+
+        started = true;
+        startTimeMs = now;
+        lastProgressMs = now;
+        startTimestamp = -1;
+        return;
+    }
+
+    const float sampleRate = CoreServices::getGlobalSampleRate();
+    const int64 timestamp = CoreServices::getGlobalTimestamp();
+
+    // the first timestamp of the run is only known once the sources have sent data
+    if (startTimestamp < 0)
+    {
+        if (sampleRate <= 0)
+            return;
+
+        startTimestamp = timestamp;
+        lastTimestamp = timestamp;
+    }
+
+    if (timestamp != lastTimestamp)
+    {
+        lastTimestamp = timestamp;
+        lastProgressMs = now;
+    }
+    else if (now - lastProgressMs > BENCHMARK_STALL_MS)
+    {
+        finish("no data went through for " + String(BENCHMARK_STALL_MS / 1000) + " s");
+        return;
+    }
+
+    if ((timestamp - startTimestamp) / sampleRate >= seconds)
+        finish(String());
+}
+
+void PipelineBenchmark::finish(const String& error)
+{
+    stopTimer();
+
+    stopTimeMs = Time::getMillisecondCounterHiRes();
+    stopAllocations = AllocationCounter::getCount();
+    AllocationCounter::setEnabled(false);
+
+    if (CoreServices::getAcquisitionStatus())
+    {
+        CoreServices::setRecordingStatus(false);
+        CoreServices::setAcquisitionStatus(false);
+    }
+
+    var report = createReport(error);
+
+    const String json = JSON::toString(report);
+    std::cout << "Pipeline benchmark:" << std::endl << json << std::endl;
+
+    if (!reportFile.replaceWithText(json))
+        LOGD("Pipeline benchmark: could not write ", reportFile.getFullPathName());
+
+    const bool dropped = int64(report["droppedSamples"]) > 0
+                         || int64(report["droppedEvents"]) > 0
+                         || int64(report["droppedSpikes"]) > 0;
+
+    JUCEApplication::getInstance()->setApplicationReturnValue(error.isNotEmpty() || dropped ? 1 : 0);
+    JUCEApplication::getInstance()->systemRequestedQuit();
+}
+
+var PipelineBenchmark::createReport(const String& error) const
+{
+    DynamicObject::Ptr report = new DynamicObject();
+
+    if (error.isNotEmpty())
+        report->setProperty("error", error);
+
+    const float sampleRate = CoreServices::getGlobalSampleRate();
+    const double dataSeconds = started && startTimestamp >= 0 && sampleRate > 0
+                               ? (lastTimestamp - startTimestamp) / sampleRate : 0.0;
+    const double wallSeconds = started ? (stopTimeMs - startTimeMs) / 1000.0 : 0.0;
+
+    report->setProperty("dataSeconds", dataSeconds);
+    report->setProperty("wallSeconds", wallSeconds);
+    report->setProperty("realtimeFactor", wallSeconds > 0 ? dataSeconds / wallSeconds : 0.0);
+
+    // the graph processes every processor once per block
+    int64 blocks = 0;
+    Array<var> processors;
+
+    for (auto processor : AccessClass::getProcessorGraph()->getListOfProcessors())
+    {
+        const ProcessTimeProfile& profile = processor->getProcessTimeProfile();
+        const ProcessTimeProfile::Stats stats = profile.getStats();
+        blocks = jmax(blocks, profile.getNumBlocks());
+
+        DynamicObject::Ptr entry = new DynamicObject();
+        entry->setProperty("name", processor->getName());
+        entry->setProperty("nodeId", processor->getNodeId());
+        entry->setProperty("blocks", profile.getNumBlocks());
+        entry->setProperty("meanUs", stats.meanUs);
+        entry->setProperty("p99Us", stats.p99Us);
+        entry->setProperty("maxUs", stats.maxUs);
+        entry->setProperty("budgetPercent", stats.budgetPercent);
+        entry->setProperty("allocationsPerBlock", stats.meanAllocations);
+        processors.add(var(entry.get()));
+    }
+
+    const int64 allocations = stopAllocations - startAllocations;
+
+    report->setProperty("blocks", blocks);
+    report->setProperty("allocations", allocations);
+    report->setProperty("allocationsPerBlock", blocks > 0 ? double(allocations) / blocks : 0.0);
+
+    int64 droppedSamples = 0, droppedEvents = 0, droppedSpikes = 0;
+
+    for (auto recordNode : AccessClass::getProcessorGraph()->getRecordNodes())
+    {
+        droppedSamples += recordNode->getTotalDroppedSamples();
+        droppedEvents += recordNode->getDroppedEvents();
+        droppedSpikes += recordNode->getDroppedSpikes();
+    }
+
+    report->setProperty("droppedSamples", droppedSamples);
+    report->setProperty("droppedEvents", droppedEvents);
+    report->setProperty("droppedSpikes", droppedSpikes);
+    report->setProperty("processors", processors);
+
+    return var(report.get());
+}
@@ -0,0 +1,84 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PIPELINEBENCHMARK_H_INCLUDED
+#define PIPELINEBENCHMARK_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/**
+
+  Runs the loaded signal chain end to end as a benchmark (--pipeline-benchmark <seconds>).
+
+  The graph is switched to offline mode, so the sources produce their data as fast
+  as the processors take it, and acquisition and recording run until the given number
+  of seconds of data has gone through every processor and RecordNode. The report
+  gives the speed relative to real time, the process time of each processor, the
+  allocations made by the processing threads per block, and the data the RecordNodes
+  dropped. It is printed and written as JSON, and the application quits with a
+  non-zero return value if any data was dropped.
+
+  Meant to be run headless on a saved chain, e.g. nightly:
+
+    open-ephys chain.xml --pipeline-benchmark 60 --record-dir /mnt/tmpfs --benchmark-report report.json
+
+  @see AudioComponent::setOfflineMode, AllocationCounter
+
+*/
+
+class PipelineBenchmark : private Timer
+{
+public:
+    /** The recording goes to recordDirectory if it is set, and the report to reportFile,
+        by default pipeline-benchmark.json in the saved state directory */
+    PipelineBenchmark(double seconds, const File& recordDirectory, const File& reportFile);
+    ~PipelineBenchmark();
+
+    /** Switches to offline mode; acquisition starts on the next turn of the message loop */
+    void start();
+
+private:
+    void timerCallback() override;
+
+    /** Stops acquisition, writes the report and quits */
+    void finish(const String& error);
+
+    var createReport(const String& error) const;
+
+    const double seconds;
+    const File recordDirectory;
+    File reportFile;
+
+    bool started;
+    int64 startTimestamp;
+    double startTimeMs;
+    double stopTimeMs;
+    int64 lastTimestamp;
+    double lastProgressMs;
+    int64 startAllocations;
+    int64 stopAllocations;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PipelineBenchmark)
+};
+
+#endif  // PIPELINEBENCHMARK_H_INCLUDED
@@ -295,7 +295,7 @@ AudioConfigurationWindow::AudioConfigurationWindow (AudioDeviceManager& adm, Aud
     , controlButton (cButton)
 
 {
-    centreWithSize (360,500);
+    centreWithSize (360,552);
     setUsingNativeTitleBar (true);
     setResizable (false,false);
 
@@ -312,13 +312,57 @@ AudioConfigurationWindow::AudioConfigurationWindow (AudioDeviceManager& adm, Aud
          false, // showChannelsAsStereoPairs
          false); // hideAdvancedOptionsWithButton
 
-    adsc->setBounds (0, 0, 450, 440);
+    adsc->setBounds (0, 0, 450, 522);
+
+    lowLatencyButton = new ToggleButton ("Low latency (" + String (LOW_LATENCY_BUFFER_SIZE) + " sample blocks, for closed-loop chains)");
+    lowLatencyButton->setColour (ToggleButton::textColourId, Colours::white);
+    lowLatencyButton->setToggleState (AccessClass::getAudioComponent()->isLowLatencyMode(), dontSendNotification);
+    lowLatencyButton->addListener (this);
+    lowLatencyButton->setBounds (10, 440, 340, 24);
+    adsc->addAndMakeVisible (lowLatencyButton);
+
+    offlineButton = new ToggleButton ("Offline (no audio device, process files as fast as possible)");
+    offlineButton->setColour (ToggleButton::textColourId, Colours::white);
+    offlineButton->setToggleState (AccessClass::getAudioComponent()->isOfflineMode(), dontSendNotification);
+    offlineButton->addListener (this);
+    offlineButton->setBounds (10, 466, 340, 24);
+    adsc->addAndMakeVisible (offlineButton);
+
+    timerClockButton = new ToggleButton ("Timer clock (" + String (AccessClass::getAudioComponent()->getTimerClockPeriodMs()) + " ms blocks, without the audio device's timing)");
+    timerClockButton->setColour (ToggleButton::textColourId, Colours::white);
+    timerClockButton->setToggleState (AccessClass::getAudioComponent()->isTimerClock(), dontSendNotification);
+    timerClockButton->addListener (this);
+    timerClockButton->setBounds (10, 492, 340, 24);
+    adsc->addAndMakeVisible (timerClockButton);
 
     setContentOwned (adsc, true);
     setVisible (false);
 }
 
 
+void AudioConfigurationWindow::buttonClicked (Button* button)
+{
+    if (button == lowLatencyButton)
+    {
+        AudioComponent* audioComponent = AccessClass::getAudioComponent();
+        audioComponent->setLowLatencyMode (lowLatencyButton->getToggleState());
+        lowLatencyButton->setToggleState (audioComponent->isLowLatencyMode(), dontSendNotification);
+    }
+    else if (button == offlineButton)
+    {
+        AudioComponent* audioComponent = AccessClass::getAudioComponent();
+        audioComponent->setOfflineMode (offlineButton->getToggleState());
+        offlineButton->setToggleState (audioComponent->isOfflineMode(), dontSendNotification);
+    }
+    else if (button == timerClockButton)
+    {
+        AudioComponent* audioComponent = AccessClass::getAudioComponent();
+        audioComponent->setTimerClock (timerClockButton->getToggleState());
+        timerClockButton->setToggleState (audioComponent->isTimerClock(), dontSendNotification);
+    }
+}
+
+
 AudioConfigurationWindow::~AudioConfigurationWindow()
 {
 }
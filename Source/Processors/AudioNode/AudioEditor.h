@@ -76,6 +76,7 @@ private:
 
 */
 class AudioConfigurationWindow : public DocumentWindow
+                               , public Button::Listener
 {
 public:
     AudioConfigurationWindow (AudioDeviceManager& adm, AudioWindowButton* b);
@@ -84,11 +85,18 @@ public:
     void paint (Graphics& g)    override;
     void resized()              override;
 
+    /** Toggles the low-latency and offline modes and the timer clock of the AudioComponent */
+    void buttonClicked (Button* button) override;
+
 
 private:
     void closeButtonPressed();
 
     AudioWindowButton* controlButton;
+
+    ScopedPointer<ToggleButton> lowLatencyButton;
+    ScopedPointer<ToggleButton> offlineButton;
+    ScopedPointer<ToggleButton> timerClockButton;
 };
 
 /**
@@ -186,36 +186,44 @@ void AudioNode::prepareToPlay(double sampleRate_, int estimatedSamplesPerBlock)
 
 void AudioNode::recreateBuffers()
 {
-	numSamplesExpected.clear();
-    samplesInBackupBuffer.clear();
-    samplesInOverflowBuffer.clear();
-    ratio.clear();
-    filters.clear();
-    bufferA.clear();
-    bufferB.clear();
-    bufferSwap.clear();
+    streams.clear();
+    channelStreams.clear();
 
     for (int i = 0; i < dataChannelArray.size(); i++)
     {
-        // processor sample rate divided by sound card sample rate
-        numSamplesExpected.add((int)(dataChannelArray[i]->getSampleRate()/destBufferSampleRate*float(estimatedSamples)) + 1);
-        samplesInBackupBuffer.add(0);
-        samplesInOverflowBuffer.add(0);
-        sourceBufferSampleRate.add(dataChannelArray[i]->getSampleRate());
+        const DataChannel* channel = dataChannelArray[i];
+        int streamIndex = -1;
 
-        filters.add(new Dsp::SmoothedFilterDesign<Dsp::RBJ::Design::LowPass, 1> (1024));
-
-        ratio.add(float(numSamplesExpected[i])/float(estimatedSamples));
-        updateFilter(i);
+        for (int s = 0; s < streams.size(); s++)
+        {
+            if (streams[s]->sourceNodeId == channel->getSourceNodeID()
+                && streams[s]->subProcessorIdx == channel->getSubProcessorIdx())
+                streamIndex = s;
+        }
 
-        bufferA.add(new AudioSampleBuffer(1,10000));
-        bufferB.add(new AudioSampleBuffer(1,10000));
-        bufferSwap.add(false);
+        if (streamIndex < 0)
+        {
+            MonitorStream* stream = new MonitorStream();
+            stream->sourceNodeId = channel->getSourceNodeID();
+            stream->subProcessorIdx = channel->getSubProcessorIdx();
+            stream->sampleRate = channel->getSampleRate();
+            stream->ring.calloc(AUDIO_MONITOR_RING_SIZE);
+            stream->writePosition = 0;
+            stream->readPosition = 0;
+            stream->readRemainder = 0.0;
+            stream->lastSample = 0.0f;
+            stream->filter = new Dsp::SmoothedFilterDesign<Dsp::RBJ::Design::LowPass, 1> (1024);
+
+            streamIndex = streams.size();
+            streams.add(stream);
+            updateFilter(streamIndex);
+        }
 
+        channelStreams.add(streamIndex);
     }
 
-//    tempBuffer->setSize(getNumInputs(), 4096);
-    tempBuffer->setSize(1, 4096);
+    // a callback reads at most a ring of source samples, and writes the resampled block after it
+    tempBuffer->setSize(2, AUDIO_MONITOR_RING_SIZE + 1);
 }
 
 bool AudioNode::enable()
@@ -226,11 +234,13 @@ bool AudioNode::enable()
 
 void AudioNode::updateFilter(int i)
 {
+    MonitorStream* stream = streams[i];
+    const bool downsample = stream->sampleRate > destBufferSampleRate;
 
-    double cutoffFreq = (ratio[i] > 1.0) ? 2 * destBufferSampleRate  // downsample
+    double cutoffFreq = downsample ? 2 * destBufferSampleRate  // downsample
                         : destBufferSampleRate / 2; // upsample
 
-    double sampleFreq = (ratio[i] > 1.0) ? sourceBufferSampleRate[i] // downsample
+    double sampleFreq = downsample ? stream->sampleRate // downsample
                         : destBufferSampleRate;  // upsample
 
     Dsp::Params params;
@@ -238,255 +248,146 @@ void AudioNode::updateFilter(int i)
     params[1] = cutoffFreq; // cutoff frequency
     params[2] = 1.25; //Q //
 
-    filters[i]->setParams(params);
+    stream->filter->setParams(params);
 
 }
 
-void AudioNode::process(AudioSampleBuffer& buffer)
+void AudioNode::mixStream(MonitorStream& stream, const AudioSampleBuffer& buffer)
 {
-    float gain;
-    int valuesNeeded = buffer.getNumSamples(); // samples needed to fill out the buffer
+    const int numSamples = jmin((int) getNumSourceSamples(stream.sourceNodeId, stream.subProcessorIdx),
+                                AUDIO_MONITOR_RING_SIZE);
 
-    LOGDD("Buffer size: ", buffer.getNumChannels());
+    // the ring holds the newest samples; older ones that were not played yet are dropped
+    const int writeIndex = int(stream.writePosition & (AUDIO_MONITOR_RING_SIZE - 1));
+    const int firstPart = jmin(numSamples, AUDIO_MONITOR_RING_SIZE - writeIndex);
 
-    // clear the left and right channels
-    buffer.clear(0,0,buffer.getNumSamples());
-    buffer.clear(1,0,buffer.getNumSamples());
+    FloatVectorOperations::clear(stream.ring + writeIndex, firstPart);
+    FloatVectorOperations::clear(stream.ring, numSamples - firstPart);
 
-    if (1)
+    for (int i = 0; i < channelStreams.size(); i++)
     {
+        if (streams[channelStreams[i]] != &stream || !dataChannelArray[i]->isMonitored())
+            continue;
 
-        AudioSampleBuffer* overflowBuffer;
-        AudioSampleBuffer* backupBuffer;
-
-        int nInputs = dataChannelArray.size();
-        if (nInputs > 0) // we have some channels
-        {
-
-//            tempBuffer->clear();
-
-            for (int i = 0; i < nInputs; i++) // cycle through them all
-            {
-
-                if (dataChannelArray[i]->isMonitored())
-                {
-                    tempBuffer->clear();
-                    LOGDD("Processing channel ", i);
-
-                    if (!bufferSwap[i])
-                    {
-                        overflowBuffer = bufferA[i];
-                        backupBuffer = bufferB[i];
-
-                        bufferSwap.set(i,true);
-                    }
-                    else
-                    {
-                        overflowBuffer = bufferB[i];
-                        backupBuffer = bufferA[i];
-
-                        bufferSwap.set(i,false);
-                    }
-
-                    backupBuffer->clear();
-
-                    samplesInOverflowBuffer.set(i,samplesInBackupBuffer[i]); // size of buffer after last round
-                    samplesInBackupBuffer.set(i,0);
-
-                    int orphanedSamples = 0;
-
-                    // 1. copy overflow buffer
+        // Data are floats in units of microvolts, so dividing by bitVolts and 0x7fff (max value for 16b signed)
+        // rescales to between -1 and +1. Audio output starts So, maximum gain applied to maximum data would be 10.
+        const float gain = volume / (float(0x7fff) * dataChannelArray[i]->getBitVolts());
 
-                    int samplesToCopyFromOverflowBuffer =
-                        ((samplesInOverflowBuffer[i] <= numSamplesExpected[i]) ?
-                         samplesInOverflowBuffer[i] :
-                         numSamplesExpected[i]);
-
-                    LOGDD("Copying ", samplesToCopyFromOverflowBuffer, " samples from overflow buffer of ", samplesInOverflowBuffer[i], " samples.");
-
-                    if (samplesToCopyFromOverflowBuffer > 0) // need to re-add samples from backup buffer
-                    {
+        const float* input = buffer.getReadPointer(i + 2); // add 2 to account for output channels
+        FloatVectorOperations::addWithMultiply(stream.ring + writeIndex, input, gain, firstPart);
+        FloatVectorOperations::addWithMultiply(stream.ring, input + firstPart, gain, numSamples - firstPart);
+    }
 
-                        tempBuffer->addFrom(0,    // destination channel
-                                            0,                // destination start sample
-                                            *overflowBuffer,  // source
-                                            0,                // source channel
-                                            0,                // source start sample
-                                            samplesToCopyFromOverflowBuffer,    // number of samples
-                                            1.0f              // gain to apply
-                                           );
+    stream.writePosition += numSamples;
+    stream.readPosition = jmax(stream.readPosition, stream.writePosition - AUDIO_MONITOR_RING_SIZE);
+}
 
-                        int leftoverSamples = samplesInOverflowBuffer[i] - samplesToCopyFromOverflowBuffer;
+void AudioNode::playStream(MonitorStream& stream, float* output, int numOutputSamples)
+{
+    // the source samples that play in this callback, at the nominal ratio of the sample rates
+    stream.readRemainder += stream.sampleRate / destBufferSampleRate * numOutputSamples;
+    const int numSourceSamples = jmin(int(stream.readRemainder), AUDIO_MONITOR_RING_SIZE);
+    stream.readRemainder -= numSourceSamples;
 
-                        LOGDD("Samples remaining in overflow buffer: ", leftoverSamples);
+    if (numSourceSamples == 0)
+        return;
 
-                        if (leftoverSamples > 0) // move remaining samples to the backup buffer
-                        {
+    // keep the delay bounded when the source delivers faster than the sound card plays
+    const int64 maxBacklog = int64(numSourceSamples) * (AUDIO_MONITOR_MAX_LATENCY_BLOCKS + 1);
+    if (stream.writePosition - stream.readPosition > maxBacklog)
+        stream.readPosition = stream.writePosition - numSourceSamples;
 
-                            backupBuffer->addFrom(0, // destination channel
-                                                  0,                     // destination start sample
-                                                  *overflowBuffer,       // source
-                                                  0,                     // source channel
-                                                  samplesToCopyFromOverflowBuffer,         // source start sample
-                                                  leftoverSamples,       // number of samples
-                                                  1.0f                   // gain to apply
-                                                 );
-                        }
+    // source[0] is the last sample of the previous callback, so the blocks join smoothly
+    float* source = tempBuffer->getWritePointer(0);
+    source[0] = stream.lastSample;
 
-                        samplesInBackupBuffer.set(i,leftoverSamples);
-                    }
+    const int numAvailable = int(jmin(int64(numSourceSamples), stream.writePosition - stream.readPosition));
+    const int readIndex = int(stream.readPosition & (AUDIO_MONITOR_RING_SIZE - 1));
+    const int firstPart = jmin(numAvailable, AUDIO_MONITOR_RING_SIZE - readIndex);
 
-                    gain = volume/(float(0x7fff) * dataChannelArray[i]->getBitVolts());
-                    // Data are floats in units of microvolts, so dividing by bitVolts and 0x7fff (max value for 16b signed)
-                    // rescales to between -1 and +1. Audio output starts So, maximum gain applied to maximum data would be 10.
+    FloatVectorOperations::copy(source + 1, stream.ring + readIndex, firstPart);
+    FloatVectorOperations::copy(source + 1 + firstPart, stream.ring, numAvailable - firstPart);
+    FloatVectorOperations::clear(source + 1 + numAvailable, numSourceSamples - numAvailable);
+    stream.readPosition += numAvailable;
 
-                    int remainingSamples = numSamplesExpected[i] - samplesToCopyFromOverflowBuffer;
+    if (stream.sampleRate > destBufferSampleRate * 1.00001)
+    {
+        // pre-apply filter before downsampling
+        float* ptr = source + 1;
+        stream.filter->process(numSourceSamples, &ptr);
+    }
 
-                    int samplesAvailable = getNumSourceSamples(dataChannelArray[i]->getSourceNodeID(), dataChannelArray[i]->getSubProcessorIdx());
+    stream.lastSample = source[numSourceSamples];
 
-                    int samplesToCopyFromIncomingBuffer = ((remainingSamples <= samplesAvailable) ?
-                                                           remainingSamples :
-                                                           samplesAvailable);
+    // linear interpolation, with the source block spread evenly over the output block
+    float* resampled = tempBuffer->getWritePointer(1);
+    const double step = double(numSourceSamples) / numOutputSamples;
 
-                    LOGDD("Copying ", samplesToCopyFromIncomingBuffer, " samples from incoming buffer of ", samplesAvailable, " samples.");
+    for (int n = 0; n < numOutputSamples; n++)
+    {
+        const double position = (n + 1) * step;
+        const int index = jmin(int(position), numSourceSamples - 1);
+        const float alpha = float(position - index);
 
+        resampled[n] = source[index] + alpha * (source[index + 1] - source[index]);
+    }
 
-                    if (samplesToCopyFromIncomingBuffer > 0)
-                    {
+    if (stream.sampleRate < destBufferSampleRate * 0.99999)
+    {
+        // apply the filter after upsampling
+        stream.filter->process(numOutputSamples, &resampled);
+    }
 
-                        //tempBuffer->addFrom(i,       // destination channel
-                        tempBuffer->addFrom(0,       // destination channel
-                                            samplesToCopyFromOverflowBuffer,           // destination start sample
-                                            buffer,      // source
-                                            i+2,           // source channel (add 2 to account for output channels)
-                                            0,           // source start sample
-                                            samplesToCopyFromIncomingBuffer, //  number of samples
-                                            gain       // gain to apply
-                                           );
+    FloatVectorOperations::add(output, resampled, numOutputSamples);
+}
 
-                        //if (destBufferPos == 0)
-                      //  LOGDD("Temp buffer 0 value: ", *tempBuffer->getReadPointer(i,0));
+void AudioNode::process(AudioSampleBuffer& buffer)
+{
+    int valuesNeeded = buffer.getNumSamples(); // samples needed to fill out the buffer
 
-                    }
-
-                    orphanedSamples = samplesAvailable - samplesToCopyFromIncomingBuffer;
+    // clear the left and right channels
+    buffer.clear(0,0,buffer.getNumSamples());
+    buffer.clear(1,0,buffer.getNumSamples());
 
-                    LOGDD("Samples remaining in incoming buffer: ", orphanedSamples);
+    // the streams are set up when acquisition starts
+    if (channelStreams.size() != dataChannelArray.size())
+        return;
 
-                    if (orphanedSamples > 0 && (samplesInBackupBuffer[i] + orphanedSamples < backupBuffer->getNumSamples()))
-                    {
+    valuesNeeded = jmin(valuesNeeded, tempBuffer->getNumSamples());
 
-                        backupBuffer->addFrom(0,                            // destination channel
-                                              samplesInBackupBuffer[i],     // destination start sample
-                                              buffer,                       // source
-                                              i+2,                          // source channel (add 2 to account for output channels)
-                                              remainingSamples,             // source start sample
-                                              orphanedSamples,              //  number of samples
-                                              gain                          // gain to apply
-                                             );
+    for (int s = 0; s < streams.size(); s++)
+    {
+        MonitorStream& stream = *streams[s];
 
-                        samplesInBackupBuffer.set(i, samplesInBackupBuffer[i] + orphanedSamples);
+        bool monitored = false;
+        for (int i = 0; i < channelStreams.size() && !monitored; i++)
+            monitored = channelStreams[i] == s && dataChannelArray[i]->isMonitored();
 
-                    }
-
-                    // now that our tempBuffer is ready, we can filter it and copy it into the
-                    // original buffer
-
-                    LOGDD("Ratio = ", ratio[i], ", gain = ", gain);
-                    LOGDD("Values needed = ", valuesNeeded, ", channel = ", i);
-
-                    if (ratio[i] > 1.00001)
-                    {
-                        // pre-apply filter before downsampling
-                        float* ptr = tempBuffer->getWritePointer(i);
-                        filters[i]->process(numSamplesExpected[i], &ptr);
-                    }
-
-                    // initialize variables
-                    int sourceBufferPos = 0;
-                    int sourceBufferSize = numSamplesExpected[i];
-                    float subSampleOffset = 0.0;
-                    int nextPos = (sourceBufferPos + 1) % sourceBufferSize;
-
-                    int destBufferPos;
-
-                    // code modified from "juce_ResamplingAudioSource.cpp":
-
-                    for (destBufferPos = 0; destBufferPos < valuesNeeded; destBufferPos++)
-                    {
-                        float gain = 1.0;
-                        float alpha = (float) subSampleOffset;
-                        float invAlpha = 1.0f - alpha;
-
-                        LOGDD("Copying sample ", sourceBufferPos);
-
-                        buffer.addFrom(0,    // destChannel
-                                       destBufferPos,  // destSampleOffset
-                                       *tempBuffer,     // source
-                                       //i,    // sourceChannel
-                                       0,       // sourceChannel
-                                       sourceBufferPos,// sourceSampleOffset
-                                       1,        // number of samples
-                                       invAlpha*gain);      // gain to apply to source
-
-                        buffer.addFrom(0,    // destChannel
-                                       destBufferPos,   // destSampleOffset
-                                       *tempBuffer,     // source
-                                       //i,      // sourceChannel
-                                       0,      // sourceChannel
-                                       nextPos,      // sourceSampleOffset
-                                       1,        // number of samples
-                                       alpha*gain);       // gain to apply to source
-
-                        // if (destBufferPos == 0)
-                        LOGDD("Output buffer 0 value: ", *buffer.getReadPointer(i+2,destBufferPos));
-
-                        subSampleOffset += ratio[i];
-
-                        while (subSampleOffset >= 1.0)
-                        {
-                            if (++sourceBufferPos >= sourceBufferSize)
-                                sourceBufferPos = 0;
-
-                            nextPos = (sourceBufferPos + 1) % sourceBufferSize;
-                            subSampleOffset -= 1.0;
-                        }
-                    }
-
-                    if (ratio[i] < 0.99999)
-                    {
-                        // apply the filter after upsampling
-                        float* ptr = buffer.getWritePointer(0);
-                        filters[i]->process(destBufferPos, &ptr);
-                    }
-
-                    // now copy the channel into the output zone
-
-                    // buffer.addFrom(0,    // destChannel
-                    //                0,  // destSampleOffset
-                    //                buffer,     // source
-                    //                 i+2,    // sourceChannel
-                    //                 0,// sourceSampleOffset
-                    //                 valuesNeeded,        // number of samples
-                    //                 1.0);      // gain to apply to source
-
-                } // if channelPointers[i]->isMonitored
-            } // end cycling through channels
-
-            // Simple implementation of a "noise gate" on audio output
-            expander.process(buffer.getWritePointer(0), // expand the left channel
-                             buffer.getNumSamples());
-
-            // copy the signal into the right channel (no stereo audio yet!)
-            buffer.addFrom(1,    // destChannel
-                           0,  // destSampleOffset
-                           buffer,     // source
-                           0,    // sourceChannel
-                           0,// sourceSampleOffset
-                           valuesNeeded,        // number of samples
-                           1.0);      // gain to apply to source
+        if (!monitored)
+        {
+            // start from silence when a channel of the stream is monitored again
+            stream.readPosition = stream.writePosition;
+            stream.readRemainder = 0.0;
+            stream.lastSample = 0.0f;
+            continue;
         }
+
+        mixStream(stream, buffer);
+        playStream(stream, buffer.getWritePointer(0), valuesNeeded);
     }
+
+    // Simple implementation of a "noise gate" on audio output
+    expander.process(buffer.getWritePointer(0), // expand the left channel
+                     buffer.getNumSamples());
+
+    // copy the signal into the right channel (no stereo audio yet!)
+    buffer.addFrom(1,    // destChannel
+                   0,  // destSampleOffset
+                   buffer,     // source
+                   0,    // sourceChannel
+                   0,// sourceSampleOffset
+                   buffer.getNumSamples(),        // number of samples
+                   1.0);      // gain to apply to source
 }
 
 
@@ -32,6 +32,11 @@
 #include "AudioEditor.h"
 #include "../Dsp/Dsp.h"
 
+/* Samples of each monitored stream held between callbacks. A power of two. */
+#define AUDIO_MONITOR_RING_SIZE 16384
+/* Blocks of source samples a stream may fall behind the output before the backlog is dropped */
+#define AUDIO_MONITOR_MAX_LATENCY_BLOCKS 4
+
 
 class AudioEditor;
 
@@ -122,6 +127,7 @@ public:
 
     void prepareToPlay(double sampleRate_, int estimatedSamplesPerBlock) override;
 
+    /** Sets the anti-aliasing filter of stream i for its sample rate */
     void updateFilter(int i);
 
 	bool enable() override;
@@ -140,28 +146,44 @@ private:
     float volume;
     float noiseGateLevel; // in microvolts
 
-    OwnedArray<AudioSampleBuffer> bufferA;
-    OwnedArray<AudioSampleBuffer> bufferB;
+    /** The monitored channels of one subprocessor, mixed into a single signal before it is
+        resampled to the sound card's rate, so monitoring more channels only costs the mix */
+    struct MonitorStream
+    {
+        uint16 sourceNodeId;
+        uint16 subProcessorIdx;
+        double sampleRate;
 
-    Array<int> numSamplesExpected;
+        /** Mix of the monitored channels, waiting to be played */
+        HeapBlock<float> ring;
+        int64 writePosition;
+        int64 readPosition;
 
-    Array<int> samplesInBackupBuffer;
-    Array<int> samplesInOverflowBuffer;
-    Array<double> sourceBufferSampleRate;
-    double destBufferSampleRate;
-	int estimatedSamples;
+        /** Source samples owed to the output, carried over between callbacks */
+        double readRemainder;
+        /** The last sample played, which the next block interpolates from */
+        float lastSample;
 
-    Array<bool> bufferSwap;
+        ScopedPointer<Dsp::Filter> filter;
+    };
 
-    Expander expander;
+    /** Mixes the incoming samples of a stream's monitored channels into its ring */
+    void mixStream(MonitorStream& stream, const AudioSampleBuffer& buffer);
+
+    /** Resamples the stream's share of the callback to numOutputSamples, adding it to output */
+    void playStream(MonitorStream& stream, float* output, int numOutputSamples);
 
-    // sample rate, timebase, and ratio info:
-    Array<double> ratio;
+    OwnedArray<MonitorStream> streams;
 
-    // major objects:
-    OwnedArray<Dsp::Filter> filters;
+    /** Index into streams of each input channel */
+    Array<int> channelStreams;
+
+    double destBufferSampleRate;
+	int estimatedSamples;
+
+    Expander expander;
 
-    // Temporary buffer for data
+    // Source samples of a stream, and the stream resampled, for one callback
     ScopedPointer<AudioSampleBuffer> tempBuffer;
 
 	//private map for datachannels with info relative to multiple processors
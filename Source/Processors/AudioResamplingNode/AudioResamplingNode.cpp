@@ -69,7 +69,8 @@ AudioResamplingNode::~AudioResamplingNode()
 
 void AudioResamplingNode::setParameter(int parameterIndex, float newValue)
 {
-    editor->updateParameterButtons(parameterIndex);
+    if (!isApplyingParameterChanges())
+        editor->updateParameterButtons(parameterIndex);
 
     switch (parameterIndex)
     {
@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChannelMask.h"
+#include "../Dsp/VectorOps.h"
+
+ChannelMask::ChannelMask()
+	: numBits(0)
+{
+}
+
+ChannelMask::ChannelMask(int numChannels, bool initialState)
+	: numBits(0)
+{
+	setSize(numChannels, initialState);
+}
+
+void ChannelMask::setSize(int numChannels, bool newState)
+{
+	const int oldBits = numBits;
+	numBits = jmax(0, numChannels);
+
+	words.resize((numBits + 31) / 32);
+
+	if (newState)
+		setRange(oldBits, numBits - 1, 1, true);
+
+	clearTail();
+}
+
+int ChannelMask::size() const
+{
+	return numBits;
+}
+
+void ChannelMask::set(int channel, bool state)
+{
+	if (!isPositiveAndBelow(channel, numBits))
+		return;
+
+	uint32& word = words.getReference(channel >> 5);
+	const uint32 bit = 1u << (channel & 31);
+	word = state ? (word | bit) : (word & ~bit);
+}
+
+void ChannelMask::setAll(bool state)
+{
+	for (uint32& word : words)
+		word = state ? ~0u : 0u;
+	clearTail();
+}
+
+void ChannelMask::setRange(int first, int last, int step, bool state)
+{
+	first = jmax(0, first);
+	last = jmin(numBits - 1, last);
+	step = jmax(1, step);
+
+	if (step == 1 && state)
+	{
+		// whole words at once where the range covers them
+		while (first <= last && (first & 31) != 0)
+			set(first++, true);
+		for (; first + 31 <= last; first += 32)
+			words.set(first >> 5, ~0u);
+	}
+
+	for (int channel = first; channel <= last; channel += step)
+		set(channel, state);
+}
+
+int ChannelMask::findNextSet(int start) const
+{
+	if (start < 0)
+		start = 0;
+
+	const int channel = Dsp::VectorOps::findNextMarked(words.begin(), start, numBits);
+	return channel < numBits ? channel : -1;
+}
+
+int ChannelMask::countSet() const
+{
+	int count = 0;
+	for (uint32 word : words)
+		count += countNumberOfBits(word);
+	return count;
+}
+
+bool ChannelMask::isEmpty() const
+{
+	for (uint32 word : words)
+		if (word != 0)
+			return false;
+	return true;
+}
+
+bool ChannelMask::operator==(const ChannelMask& other) const
+{
+	return numBits == other.numBits && words == other.words;
+}
+
+bool ChannelMask::operator!=(const ChannelMask& other) const
+{
+	return !operator==(other);
+}
+
+void ChannelMask::clearTail()
+{
+	if ((numBits & 31) != 0)
+		words.getReference(numBits >> 5) &= (1u << (numBits & 31)) - 1;
+}
@@ -0,0 +1,99 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELMASK_H_INCLUDED
+#define CHANNELMASK_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+
+/**
+A set of channels, stored one bit per channel.
+
+Processors keep the channels they work on in a mask and walk the set ones with
+findNextSet(), which skips 32 disabled channels at a time, instead of testing a
+flag per channel:
+
+for (int ch = mask.findNextSet(0); ch >= 0; ch = mask.findNextSet(ch + 1))
+
+or, equivalently, for (int ch : mask). Channels past the end of the mask read as unset.
+*/
+class PLUGIN_API ChannelMask
+{
+public:
+	ChannelMask();
+	explicit ChannelMask(int numChannels, bool initialState = false);
+
+	/** Resizes the mask. Channels that are kept keep their state, new ones take newState */
+	void setSize(int numChannels, bool newState = false);
+	int size() const;
+
+	bool operator[](int channel) const
+	{
+		return isPositiveAndBelow(channel, numBits) && (words[channel >> 5] & (1u << (channel & 31))) != 0;
+	}
+
+	void set(int channel, bool state);
+	void setAll(bool state);
+
+	/** Sets every step-th channel from first to last, both included */
+	void setRange(int first, int last, int step, bool state);
+
+	/** The first set channel from start, or -1 if there is none */
+	int findNextSet(int start) const;
+
+	int countSet() const;
+	bool isEmpty() const;
+
+	bool operator==(const ChannelMask& other) const;
+	bool operator!=(const ChannelMask& other) const;
+
+	/** Walks the set channels of a mask */
+	class Iterator
+	{
+	public:
+		Iterator(const ChannelMask& mask, int channel) : owner(mask), current(channel) {}
+
+		int operator*() const { return current; }
+		Iterator& operator++() { current = owner.findNextSet(current + 1); return *this; }
+		bool operator!=(const Iterator& other) const { return current != other.current; }
+
+	private:
+		const ChannelMask& owner;
+		int current;
+	};
+
+	Iterator begin() const { return Iterator(*this, findNextSet(0)); }
+	Iterator end() const { return Iterator(*this, -1); }
+
+private:
+	/** Clears the bits of the last word past the end, so whole words can be counted and compared */
+	void clearTail();
+
+	Array<uint32> words;
+	int numBits;
+
+	JUCE_LEAK_DETECTOR(ChannelMask);
+};
+
+#endif  // CHANNELMASK_H_INCLUDED
@@ -63,15 +63,21 @@ HistoryObject::~HistoryObject()
 
 String HistoryObject::getHistoricString() const
 {
-	return m_historicString;
+	StringArray entries;
+	for (const HistoryEntry* e = m_lastEntry; e != nullptr; e = e->previous)
+		entries.insert(0, e->entry);
+	return entries.joinIntoString(" -> ");
 }
 
 void HistoryObject::addToHistoricString(String entry)
 {
-	if (m_historicString.isEmpty())
-		m_historicString = entry;
-	else
-		m_historicString += (" -> " + entry);
+	if (entry.isEmpty())
+		return;
+
+	HistoryEntry* e = new HistoryEntry();
+	e->entry = entry;
+	e->previous = m_lastEntry;
+	m_lastEntry = e;
 }
 
 //SourceProcessorInfo
@@ -80,7 +80,14 @@ public:
 	void addToHistoricString(String entry);
 
 private:
-	String m_historicString;
+	/** One processor the data has gone through. Copies of a channel share the entries of
+		the processors before them, so adding an entry does not copy the whole string */
+	struct HistoryEntry : public ReferenceCountedObject
+	{
+		String entry;
+		ReferenceCountedObjectPtr<HistoryEntry> previous;
+	};
+	ReferenceCountedObjectPtr<HistoryEntry> m_lastEntry;
 };
 
 class PLUGIN_API SourceProcessorInfo
@@ -297,6 +297,30 @@ void MetaDataValue::setValue(const void* data)
 
 //Actual template instantiations at the end of the file
 
+//MetaDataSet
+
+MetaDataSet::MetaDataSet() {}
+
+//The copy starts unreferenced, and shares the descriptors and values, which are not modified once added
+MetaDataSet::MetaDataSet(const MetaDataSet& other)
+	:	ReferenceCountedObject(),
+		descriptors(other.descriptors),
+		values(other.values),
+		totalSize(other.totalSize),
+		maxSize(other.maxSize)
+{
+}
+
+//Gives the object a set of its own before it adds to it
+static MetaDataSet& getWritableSet(MetaDataSet::Ptr& set)
+{
+	if (set == nullptr)
+		set = new MetaDataSet();
+	else if (set->getReferenceCount() > 1)
+		set = new MetaDataSet(*set);
+	return *set;
+}
+
 //MetaDataInfoObject
 
 MetaDataInfoObject::MetaDataInfoObject() {}
@@ -315,8 +339,9 @@ void MetaDataInfoObject::addMetaData(MetaDataDescriptor* desc, MetaDataValue* va
 		delete val;
 		return;
 	}
-	m_metaDataDescriptorArray.add(desc);
-	m_metaDataValueArray.add(val);
+	MetaDataSet& metaData = getWritableSet(m_metaData);
+	metaData.descriptors.add(desc);
+	metaData.values.add(val);
 }
 
 void MetaDataInfoObject::addMetaData(const MetaDataDescriptor& desc, const MetaDataValue& val)
@@ -326,31 +351,35 @@ void MetaDataInfoObject::addMetaData(const MetaDataDescriptor& desc, const MetaD
 		jassertfalse;
 		return;
 	}
-	m_metaDataDescriptorArray.add(new MetaDataDescriptor(desc));
-	m_metaDataValueArray.add(new MetaDataValue(val));
+	MetaDataSet& metaData = getWritableSet(m_metaData);
+	metaData.descriptors.add(new MetaDataDescriptor(desc));
+	metaData.values.add(new MetaDataValue(val));
 }
 
 const MetaDataDescriptor* MetaDataInfoObject::getMetaDataDescriptor(int index) const
 {
-	return m_metaDataDescriptorArray[index];
+	if (m_metaData == nullptr) return nullptr;
+	return m_metaData->descriptors[index];
 }
 
 const MetaDataValue* MetaDataInfoObject::getMetaDataValue(int index) const
 {
-	return m_metaDataValueArray[index];
+	if (m_metaData == nullptr) return nullptr;
+	return m_metaData->values[index];
 }
 
 const int MetaDataInfoObject::getMetaDataCount() const
 {
-	return m_metaDataDescriptorArray.size();
+	if (m_metaData == nullptr) return 0;
+	return m_metaData->descriptors.size();
 }
 
 int MetaDataInfoObject::findMetaData(MetaDataDescriptor::MetaDataTypes type, unsigned int length, String identifier) const
 {
-	int nMetaData = m_metaDataDescriptorArray.size();
+	int nMetaData = getMetaDataCount();
 	for (int i = 0; i < nMetaData; i++)
 	{
-		MetaDataDescriptorPtr md = m_metaDataDescriptorArray[i];
+		MetaDataDescriptorPtr md = m_metaData->descriptors[i];
 		if (md->getType() == type && md->getLength() == length && compareIdentifierStrings(identifier,md->getIdentifier()))
 			return i;
 	}
@@ -369,12 +398,14 @@ bool MetaDataInfoObject::hasSimilarMetadata(const MetaDataInfoObject& other) con
 
 bool MetaDataInfoObject::checkMetaDataCoincidence(const MetaDataInfoObject& other, bool similar) const
 {
-	int nMetaData = m_metaDataDescriptorArray.size();
-	if (nMetaData != other.m_metaDataDescriptorArray.size()) return false;
+	//copies that have not added any field share the same set
+	if (m_metaData == other.m_metaData) return true;
+	int nMetaData = getMetaDataCount();
+	if (nMetaData != other.getMetaDataCount()) return false;
 	for (int i = 0; i < nMetaData; i++)
 	{
-		MetaDataDescriptorPtr md = m_metaDataDescriptorArray[i];
-		MetaDataDescriptorPtr mdo = other.m_metaDataDescriptorArray[i];
+		MetaDataDescriptorPtr md = m_metaData->descriptors[i];
+		MetaDataDescriptorPtr mdo = other.m_metaData->descriptors[i];
 		if (similar)
 		{
 			if (!md->isSimilar(*mdo)) return false;
@@ -401,11 +432,12 @@ void MetaDataEventObject::addEventMetaData(MetaDataDescriptor* desc)
 		jassertfalse;
 		return;
 	}
-	m_eventMetaDataDescriptorArray.add(desc);
+	MetaDataSet& metaData = getWritableSet(m_eventMetaData);
+	metaData.descriptors.add(desc);
 	size_t size = desc->getDataSize();
-	m_totalSize += size;
-	if (m_maxSize < size)
-		m_maxSize = size;
+	metaData.totalSize += size;
+	if (metaData.maxSize < size)
+		metaData.maxSize = size;
 }
 
 void MetaDataEventObject::addEventMetaData(const MetaDataDescriptor& desc)
@@ -416,34 +448,38 @@ void MetaDataEventObject::addEventMetaData(const MetaDataDescriptor& desc)
 		jassertfalse;
 		return;
 	}
-	m_eventMetaDataDescriptorArray.add(new MetaDataDescriptor(desc));
+	MetaDataSet& metaData = getWritableSet(m_eventMetaData);
+	metaData.descriptors.add(new MetaDataDescriptor(desc));
 	size_t size = desc.getDataSize();
-	m_totalSize += size;
-	if (m_maxSize < size)
-		m_maxSize = size;
+	metaData.totalSize += size;
+	if (metaData.maxSize < size)
+		metaData.maxSize = size;
 }
 
 size_t MetaDataEventObject::getTotalEventMetaDataSize() const
 {
-	return m_totalSize;
+	if (m_eventMetaData == nullptr) return 0;
+	return m_eventMetaData->totalSize;
 }
 
 const MetaDataDescriptor* MetaDataEventObject::getEventMetaDataDescriptor(int index) const
 {
-	return m_eventMetaDataDescriptorArray[index];
+	if (m_eventMetaData == nullptr) return nullptr;
+	return m_eventMetaData->descriptors[index];
 }
 
 int MetaDataEventObject::getEventMetaDataCount() const
 {
-	return m_eventMetaDataDescriptorArray.size();
+	if (m_eventMetaData == nullptr) return 0;
+	return m_eventMetaData->descriptors.size();
 }
 
 int MetaDataEventObject::findEventMetaData(MetaDataDescriptor::MetaDataTypes type, unsigned int length, String descriptor) const
 {
-	int nMetaData = m_eventMetaDataDescriptorArray.size();
+	int nMetaData = getEventMetaDataCount();
 	for (int i = 0; i < nMetaData; i++)
 	{
-		MetaDataDescriptorPtr md = m_eventMetaDataDescriptorArray[i];
+		MetaDataDescriptorPtr md = m_eventMetaData->descriptors[i];
 		if (md->getType() == type && md->getLength() == length && compareIdentifierStrings(descriptor,md->getIdentifier()))
 			return i;
 	}
@@ -462,12 +498,13 @@ bool MetaDataEventObject::hasSimilarEventMetadata(const MetaDataEventObject& oth
 
 bool MetaDataEventObject::checkMetaDataCoincidence(const MetaDataEventObject& other, bool similar) const
 {
-	int nMetaData = m_eventMetaDataDescriptorArray.size();
-	if (nMetaData != other.m_eventMetaDataDescriptorArray.size()) return false;
+	if (m_eventMetaData == other.m_eventMetaData) return true;
+	int nMetaData = getEventMetaDataCount();
+	if (nMetaData != other.getEventMetaDataCount()) return false;
 	for (int i = 0; i < nMetaData; i++)
 	{
-		MetaDataDescriptorPtr md = m_eventMetaDataDescriptorArray[i];
-		MetaDataDescriptorPtr mdo = other.m_eventMetaDataDescriptorArray[i];
+		MetaDataDescriptorPtr md = m_eventMetaData->descriptors[i];
+		MetaDataDescriptorPtr mdo = other.m_eventMetaData->descriptors[i];
 		if (similar)
 		{
 			if (!md->isSimilar(*mdo)) return false;
@@ -482,7 +519,8 @@ bool MetaDataEventObject::checkMetaDataCoincidence(const MetaDataEventObject& ot
 
 size_t MetaDataEventObject::getMaxEventMetaDataSize() const
 {
-	return m_maxSize;
+	if (m_eventMetaData == nullptr) return 0;
+	return m_eventMetaData->maxSize;
 }
 
 //MetaDataEvent
@@ -171,11 +171,41 @@ private:
 	JUCE_LEAK_DETECTOR(MetaDataValue);
 };
 
+/** The MetaDataTypes value of each primitive type. Other types do not compile */
+template <typename T> struct MetaDataTypeOf;
+template <> struct MetaDataTypeOf<char>   { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::CHAR; };
+template <> struct MetaDataTypeOf<int8>   { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::INT8; };
+template <> struct MetaDataTypeOf<uint8>  { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::UINT8; };
+template <> struct MetaDataTypeOf<int16>  { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::INT16; };
+template <> struct MetaDataTypeOf<uint16> { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::UINT16; };
+template <> struct MetaDataTypeOf<int32>  { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::INT32; };
+template <> struct MetaDataTypeOf<uint32> { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::UINT32; };
+template <> struct MetaDataTypeOf<int64>  { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::INT64; };
+template <> struct MetaDataTypeOf<uint64> { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::UINT64; };
+template <> struct MetaDataTypeOf<float>  { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::FLOAT; };
+template <> struct MetaDataTypeOf<double> { static const MetaDataDescriptor::MetaDataTypes type = MetaDataDescriptor::DOUBLE; };
+
 typedef ReferenceCountedArray<MetaDataDescriptor,CriticalSection> MetaDataDescriptorArray;
 typedef ReferenceCountedArray<MetaDataValue,CriticalSection> MetaDataValueArray;
 typedef ReferenceCountedObjectPtr<MetaDataDescriptor> MetaDataDescriptorPtr;
 typedef ReferenceCountedObjectPtr<MetaDataValue> MetaDataValuePtr;
 
+/** The metadata fields of an info object. Copies of the object made down the chain share
+	the same set, and an object only gets its own when it adds a field to a shared one */
+class PLUGIN_API MetaDataSet
+	: public ReferenceCountedObject
+{
+public:
+	MetaDataSet();
+	MetaDataSet(const MetaDataSet& other);
+	MetaDataDescriptorArray descriptors;
+	MetaDataValueArray values;
+	size_t totalSize{ 0 };
+	size_t maxSize{ 0 };
+
+	typedef ReferenceCountedObjectPtr<MetaDataSet> Ptr;
+};
+
 //Inherited for all info objects that have metadata
 class PLUGIN_API MetaDataInfoObject
 {
@@ -192,8 +222,8 @@ public:
 	bool hasSameMetadata(const MetaDataInfoObject& other) const;
 	bool hasSimilarMetadata(const MetaDataInfoObject& other) const;
 protected:
-	MetaDataDescriptorArray m_metaDataDescriptorArray;
-	MetaDataValueArray m_metaDataValueArray;
+	/** Null until the first field is added */
+	MetaDataSet::Ptr m_metaData;
 private:
 	bool checkMetaDataCoincidence(const MetaDataInfoObject& other, bool similar) const;
 };
@@ -227,10 +257,9 @@ public:
 	bool hasSameEventMetadata(const MetaDataEventObject& other) const;
 	bool hasSimilarEventMetadata(const MetaDataEventObject& other) const;
 protected:
-	MetaDataDescriptorArray m_eventMetaDataDescriptorArray;
+	/** Null until the first field is added. Only the descriptors and sizes are used */
+	MetaDataSet::Ptr m_eventMetaData;
 	MetaDataEventObject();
-	size_t m_totalSize{ 0 };
-	size_t m_maxSize{ 0 };
 private:
 	bool checkMetaDataCoincidence(const MetaDataEventObject& other, bool similar) const;
 };
@@ -249,6 +278,99 @@ protected:
 	MetaDataValueArray m_metaDataValues;
 };
 
+/**
+Lays out the metadata values of an event in a buffer of its own, in the order of the event metadata
+descriptors of the channel, exactly as they are serialized after the event data. It neither allocates
+nor locks, so the processing thread can build it on the stack instead of a MetaDataValueArray and hand
+getData() to GenericProcessor::addBinaryEvent, addTextEvent or addSpike:
+
+	MetaDataBuilder<> metaData;
+	metaData.add(static_cast<uint64>(bytesRead));
+	addBinaryEvent(chan, timestamp, data, dataSize, 0, metaData.getData());
+*/
+template <size_t MaxSize = 256, int MaxFields = 16>
+class MetaDataBuilder
+{
+public:
+	MetaDataBuilder() : m_size(0), m_numFields(0) {}
+
+	/** Appends a single value. Only the types listed in MetaDataTypes compile */
+	template <typename T>
+	MetaDataBuilder& add(T value)
+	{
+		return add(&value, 1);
+	}
+
+	/** Appends a field of length values */
+	template <typename T>
+	MetaDataBuilder& add(const T* values, unsigned int length)
+	{
+		size_t size = sizeof(T) * length;
+		if (m_numFields >= MaxFields || m_size + size > MaxSize)
+		{
+			jassertfalse;
+			return *this;
+		}
+
+		memcpy(m_data + m_size, values, size);
+		m_types[m_numFields] = MetaDataTypeOf<T>::type;
+		m_lengths[m_numFields] = length;
+		m_numFields++;
+		m_size += size;
+		return *this;
+	}
+
+	/** Appends a CHAR field of length bytes, truncating the text or padding it with zeros */
+	MetaDataBuilder& add(const String& text, unsigned int length)
+	{
+		if (m_numFields >= MaxFields || m_size + length > MaxSize || length == 0)
+		{
+			jassertfalse;
+			return *this;
+		}
+
+		zeromem(m_data + m_size, length);
+		text.copyToUTF8(m_data + m_size, length);
+		m_types[m_numFields] = MetaDataDescriptor::CHAR;
+		m_lengths[m_numFields] = length;
+		m_numFields++;
+		m_size += length;
+		return *this;
+	}
+
+	void clear()
+	{
+		m_size = 0;
+		m_numFields = 0;
+	}
+
+	const void* getData() const	{ return m_data; }
+	size_t getSize() const		{ return m_size; }
+	int getNumFields() const	{ return m_numFields; }
+
+	/** True if the fields have the type and length of the channel's event metadata descriptors, in order */
+	bool matches(const MetaDataEventObject* info) const
+	{
+		if (info == nullptr || info->getEventMetaDataCount() != m_numFields)
+			return false;
+
+		for (int i = 0; i < m_numFields; i++)
+		{
+			const MetaDataDescriptor* desc = info->getEventMetaDataDescriptor(i);
+			if (desc->getType() != m_types[i] || desc->getLength() != m_lengths[i])
+				return false;
+		}
+		return true;
+	}
+
+private:
+	char m_data[MaxSize];
+	MetaDataDescriptor::MetaDataTypes m_types[MaxFields];
+	unsigned int m_lengths[MaxFields];
+	size_t m_size;
+	int m_numFields;
+};
+
 //Helper function to compare identifier strings
 bool compareIdentifierStrings(const String& identifier, const String& compareWith);
 
@@ -22,42 +22,140 @@
 
 #include "DataBuffer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DB_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DB_USE_NEON 1
+#endif
+
+namespace
+{
+    /* Transposes 4 interleaved frames of 4 channels into 4 channel rows of 4 samples */
+    inline void transposeTile4x4 (const float* src, int srcStride, float* const* dst, int dstStart)
+    {
+#if DB_USE_SSE2
+        __m128 r0 = _mm_loadu_ps (src);
+        __m128 r1 = _mm_loadu_ps (src + srcStride);
+        __m128 r2 = _mm_loadu_ps (src + 2 * srcStride);
+        __m128 r3 = _mm_loadu_ps (src + 3 * srcStride);
+        _MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+        _mm_storeu_ps (dst[0] + dstStart, r0);
+        _mm_storeu_ps (dst[1] + dstStart, r1);
+        _mm_storeu_ps (dst[2] + dstStart, r2);
+        _mm_storeu_ps (dst[3] + dstStart, r3);
+#elif DB_USE_NEON
+        float32x4x2_t t01 = vtrnq_f32 (vld1q_f32 (src), vld1q_f32 (src + srcStride));
+        float32x4x2_t t23 = vtrnq_f32 (vld1q_f32 (src + 2 * srcStride), vld1q_f32 (src + 3 * srcStride));
+        vst1q_f32 (dst[0] + dstStart, vcombine_f32 (vget_low_f32 (t01.val[0]), vget_low_f32 (t23.val[0])));
+        vst1q_f32 (dst[1] + dstStart, vcombine_f32 (vget_low_f32 (t01.val[1]), vget_low_f32 (t23.val[1])));
+        vst1q_f32 (dst[2] + dstStart, vcombine_f32 (vget_high_f32 (t01.val[0]), vget_high_f32 (t23.val[0])));
+        vst1q_f32 (dst[3] + dstStart, vcombine_f32 (vget_high_f32 (t01.val[1]), vget_high_f32 (t23.val[1])));
+#else
+        for (int s = 0; s < 4; ++s)
+            for (int c = 0; c < 4; ++c)
+                dst[c][dstStart + s] = src[s * srcStride + c];
+#endif
+    }
+
+    /* Deinterleaves numSamples frames of numChans samples into the channel rows, starting at dstStart */
+    void deinterleave (const float* src, int numChans, float* const* dst, int dstStart, int numSamples)
+    {
+        int chan = 0;
+        for (; chan + 4 <= numChans; chan += 4)
+        {
+            int samp = 0;
+            for (; samp + 4 <= numSamples; samp += 4)
+                transposeTile4x4 (src + samp * numChans + chan, numChans, dst + chan, dstStart + samp);
+
+            for (; samp < numSamples; ++samp)
+                for (int c = chan; c < chan + 4; ++c)
+                    dst[c][dstStart + samp] = src[samp * numChans + c];
+        }
+
+        for (; chan < numChans; ++chan)
+            for (int samp = 0; samp < numSamples; ++samp)
+                dst[chan][dstStart + samp] = src[samp * numChans + chan];
+    }
+}
+
 
 DataBuffer::DataBuffer (int chans, int size)
     : abstractFifo  (size)
-    , buffer        (chans, size)
-    , numChans      (chans)
 {
-    timestampBuffer.malloc (size);
-    eventCodeBuffer.malloc (size);
+    allocate (chans, size);
 
 	lastTimestamp = 0;
+    highWaterMark = 0;
 }
 
 
 DataBuffer::~DataBuffer() {}
 
 
+void DataBuffer::allocate (int chans, int size)
+{
+    abstractFifo.setTotalSize (size);
+    abstractFifo.reset();
+
+    buffer.setDataToReferTo (memory.allocateChannels (chans, size), chans, size);
+    memory.prefault();
+
+    timestampBuffer.malloc (size);
+    eventCodeBuffer.malloc (size);
+
+    numChans = chans;
+}
+
+
 void DataBuffer::clear()
 {
     buffer.clear();
     abstractFifo.reset();
 	lastTimestamp = 0;
+    highWaterMark = 0;
 }
 
 
 void DataBuffer::resize (int chans, int size)
 {
-    buffer.setSize (chans, size);
-
-    timestampBuffer.malloc (size);
-    eventCodeBuffer.malloc (size);
+    allocate (chans, size);
 
 	lastTimestamp = 0;
+    highWaterMark = 0;
+}
 
-    numChans = chans;
+
+int DataBuffer::prepareToRead (int maxItems, int& startIndex1, int& blockSize1, int& startIndex2, int& blockSize2)
+{
+    int numReady = abstractFifo.getNumReady();
+    int numItems = (maxItems < numReady) ? maxItems : numReady;
+
+    abstractFifo.prepareToRead (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    return blockSize1 + blockSize2;
+}
+
+
+void DataBuffer::finishedRead (int numItems)
+{
+    abstractFifo.finishedRead (numItems);
 }
 
+
+const float* const* DataBuffer::getChannelReadPointers() const { return buffer.getArrayOfReadPointers(); }
+
+
+const int64* DataBuffer::getTimestampReadPointer() const { return timestampBuffer; }
+
+
+const uint64* DataBuffer::getEventCodeReadPointer() const { return eventCodeBuffer; }
+
+
+int64 DataBuffer::getLastTimestamp() const { return lastTimestamp; }
+
+
 int DataBuffer::addToBuffer (float* data, int64* timestamps, uint64* eventCodes, int numItems, int chunkSize)
 {
     int startIndex1, blockSize1, startIndex2, blockSize2;
@@ -101,14 +199,110 @@ int DataBuffer::addToBuffer (float* data, int64* timestamps, uint64* eventCodes,
 
     // finish write
     abstractFifo.finishedWrite (idx);
+    updateHighWaterMark();
 
     return idx;
 }
 
 
+int DataBuffer::addBlock (const float* interleaved, const int64* timestamps, const uint64* eventCodes, int numItems)
+{
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+
+    abstractFifo.prepareToWrite (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    int written = blockSize1 + blockSize2;
+    if (written <= 0)
+        return 0;
+
+    lastTimestamp = timestamps[written - 1];
+
+    float* const* channels = buffer.getArrayOfWritePointers();
+
+    deinterleave (interleaved, numChans, channels, startIndex1, blockSize1);
+    memcpy (timestampBuffer + startIndex1, timestamps, blockSize1 * sizeof (int64));
+    memcpy (eventCodeBuffer + startIndex1, eventCodes, blockSize1 * sizeof (uint64));
+
+    if (blockSize2 > 0)
+    {
+        deinterleave (interleaved + blockSize1 * numChans, numChans, channels, startIndex2, blockSize2);
+        memcpy (timestampBuffer + startIndex2, timestamps + blockSize1, blockSize2 * sizeof (int64));
+        memcpy (eventCodeBuffer + startIndex2, eventCodes + blockSize1, blockSize2 * sizeof (uint64));
+    }
+
+    abstractFifo.finishedWrite (written);
+    updateHighWaterMark();
+
+    return written;
+}
+
+
+int DataBuffer::prepareToWrite (int numItems, int& startIndex1, int& blockSize1, int& startIndex2, int& blockSize2)
+{
+    abstractFifo.prepareToWrite (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    return blockSize1 + blockSize2;
+}
+
+
+void DataBuffer::finishedWrite (int numItems, int startIndex1)
+{
+    if (numItems <= 0)
+        return;
+
+    lastTimestamp = timestampBuffer[(startIndex1 + numItems - 1) % abstractFifo.getTotalSize()];
+
+    abstractFifo.finishedWrite (numItems);
+    updateHighWaterMark();
+}
+
+
+float* const* DataBuffer::getChannelWritePointers() { return buffer.getArrayOfWritePointers(); }
+
+
+int64* DataBuffer::getTimestampWritePointer() { return timestampBuffer; }
+
+
+uint64* DataBuffer::getEventCodeWritePointer() { return eventCodeBuffer; }
+
+
+int DataBuffer::getNumChannels() const { return numChans; }
+
+
 int DataBuffer::getNumSamples() const { return abstractFifo.getNumReady(); }
 
 
+int DataBuffer::getCapacity() const { return abstractFifo.getTotalSize() - 1; }
+
+
+int DataBuffer::getHighWaterMark() const { return highWaterMark.get(); }
+
+
+void DataBuffer::resetHighWaterMark() { highWaterMark = 0; }
+
+
+void DataBuffer::updateHighWaterMark()
+{
+    // only the writer raises the mark, so no compare-and-swap is needed
+    const int numReady = abstractFifo.getNumReady();
+
+    if (numReady > highWaterMark.get())
+        highWaterMark = numReady;
+}
+
+
+int DataBuffer::getCapacityFor (int chans, float sampleRate)
+{
+    const int64 targetSamples = (int64) std::ceil (sampleRate * DATA_BUFFER_TARGET_MS / 1000.0);
+
+    // each sample of the ring stores a float per channel, a timestamp and an event word
+    const int64 bytesPerSample = (int64) jmax (chans, 1) * sizeof (float) + sizeof (int64) + sizeof (uint64);
+    const int64 maxSamples = (int64) DATA_BUFFER_MAX_BYTES / bytesPerSample;
+
+    return (int) jmax ((int64) DATA_BUFFER_MIN_SAMPLES, jmin (targetSamples, maxSamples));
+}
+
+
 int DataBuffer::readAllFromBuffer (AudioSampleBuffer& data, uint64* timestamp, uint64* eventCodes, int maxSize, int dstStartChannel, int numChannels)
 {
     // check to see if the maximum size is smaller than the total number of available ints
@@ -25,7 +25,14 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../PluginManager/OpenEphysPlugin.h"
+#include "../../Utils/RingMemory.h"
 
+/* Time the sources buffer, when they size their DataBuffers with getCapacityFor()... */
+#define DATA_BUFFER_TARGET_MS 500
+/* ...as long as the buffer takes no more memory than this */
+#define DATA_BUFFER_MAX_BYTES (128 * 1024 * 1024)
+/* Fewest samples a sized buffer holds, several blocks of any source */
+#define DATA_BUFFER_MIN_SAMPLES 4096
 
 /**
     Manages reading and writing data to a circular buffer.
@@ -55,18 +62,97 @@ public:
     */
     int addToBuffer (float* data, int64* timestamps, uint64* eventCodes, int numItems, int chunkSize=1);
 
+    /** Adds a whole block of interleaved samples to the buffer in one go.
+
+        Faster than calling addToBuffer once per sample: the samples are deinterleaved
+        into the channel buffers with vectorized transposes.
+
+        @param interleaved numItems frames of getNumChannels() consecutive samples.
+        @param timestamps Array of timestamps. Same length as numItems.
+        @param eventCodes Array of event codes. Same length as numItems.
+        @param numItems Total number of samples per channel.
+
+        @return The number of items actually written. May be less than numItems if
+        the buffer doesn't have space.
+    */
+    int addBlock (const float* interleaved, const int64* timestamps, const uint64* eventCodes, int numItems);
+
+    /** Reserves space for numItems samples, for sources that decode straight into the
+        channel buffers instead of going through addToBuffer.
+
+        The samples map to [startIndex1, startIndex1 + blockSize1) and then
+        [startIndex2, startIndex2 + blockSize2) of the storage returned by
+        getChannelWritePointers(), getTimestampWritePointer() and getEventCodeWritePointer().
+        Nothing becomes readable until finishedWrite() is called.
+
+        @return The number of items reserved. May be less than numItems if
+        the buffer doesn't have space.
+    */
+    int prepareToWrite (int numItems, int& startIndex1, int& blockSize1, int& startIndex2, int& blockSize2);
+
+    /** Makes the first numItems reserved samples available to the reader.*/
+    void finishedWrite (int numItems, int startIndex1);
+
+    /** Planar storage of each channel, as laid out by prepareToWrite().*/
+    float* const* getChannelWritePointers();
+    int64* getTimestampWritePointer();
+    uint64* getEventCodeWritePointer();
+
+    /** Returns the number of channels held by the buffer.*/
+    int getNumChannels() const;
+
     /** Returns the number of samples currently available in the buffer.*/
     int getNumSamples() const;
 
+    /** Returns the number of samples the buffer can hold.*/
+    int getCapacity() const;
+
+    /** Returns the largest number of samples that were waiting in the buffer after a write,
+        since the buffer was sized, cleared or the mark was reset.*/
+    int getHighWaterMark() const;
+    void resetHighWaterMark();
+
+    /** Returns the capacity for chans channels at sampleRate that holds DATA_BUFFER_TARGET_MS of
+        samples, bounded to DATA_BUFFER_MAX_BYTES, and never less than DATA_BUFFER_MIN_SAMPLES.*/
+    static int getCapacityFor (int chans, float sampleRate);
+
     /** Copies as many samples as possible from the DataBuffer to an AudioSampleBuffer.*/
     int readAllFromBuffer (AudioSampleBuffer& data, uint64* ts, uint64* eventCodes, int maxSize, int dstStartChannel = 0, int numChannels = -1);
 
+    /** Gives direct access to up to maxItems of the samples available for reading, without copying them.
+
+        The samples are in [startIndex1, startIndex1 + blockSize1) and then
+        [startIndex2, startIndex2 + blockSize2) of the storage returned by getChannelReadPointers(),
+        getTimestampReadPointer() and getEventCodeReadPointer(), and stay valid until
+        finishedRead() is called.
+
+        @return The number of items in the two slices.
+    */
+    int prepareToRead (int maxItems, int& startIndex1, int& blockSize1, int& startIndex2, int& blockSize2);
+
+    /** Releases the first numItems samples handed out by prepareToRead().*/
+    void finishedRead (int numItems);
+
+    const float* const* getChannelReadPointers() const;
+    const int64* getTimestampReadPointer() const;
+    const uint64* getEventCodeReadPointer() const;
+
+    /** Returns the timestamp of the last sample written to the buffer.*/
+    int64 getLastTimestamp() const;
+
     /** Resizes the data buffer */
     void resize (int chans, int size);
 
 
 private:
+    /** Replaces the storage with chans rings of size samples, faulted in by the calling thread */
+    void allocate (int chans, int size);
+
+    /** Raises the high-water mark to the samples waiting in the buffer. Called by the writer */
+    void updateHighWaterMark();
+
     AbstractFifo abstractFifo;
+    RingMemory memory;
     AudioSampleBuffer buffer;
 
     HeapBlock<int64> timestampBuffer;
@@ -76,6 +162,8 @@ private:
 
     int numChans;
 
+    Atomic<int> highWaterMark;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DataBuffer);
 };
 
@@ -23,13 +23,60 @@
 #include "DataThread.h"
 #include "../SourceNode/SourceNode.h"
 #include "../../Utils/Utils.h"
+#include "../../Utils/AllocationCounter.h"
+#include "../../Utils/PipelineTrace.h"
+#include "../../Utils/ThreadConfig.h"
+
+
+#define DATA_THREAD_MAX_CORES   32
+
+/* Fraction of the expected block period to sleep through before polling for the block */
+#define DATA_WAIT_SLEEP_FRACTION 0.8
+/* Longest poll interval, as a fraction of the block period */
+#define DATA_WAIT_MAX_BACKOFF    0.25
+
+
+/** Calls updateSubProcessorBuffer() for one subprocessor until stopped */
+class DataThread::SubProcessorReader : public Thread
+{
+public:
+    SubProcessorReader (DataThread* owner, int subProcessor)
+        : Thread ("Data Thread " + String (subProcessor))
+        , owner (owner)
+        , subProcessor (subProcessor)
+    {
+    }
+
+    void run() override
+    {
+        owner->countAllocations();
+
+        while (! threadShouldExit())
+        {
+            TRACE_SCOPE ("acquisition", "updateSubProcessorBuffer");
+
+            if (! owner->updateSubProcessorBuffer (subProcessor))
+            {
+                owner->readerFailed.set (1);
+                owner->notify();
+                return;
+            }
+        }
+    }
+
+private:
+    DataThread* owner;
+    int subProcessor;
+};
 
 
 DataThread::DataThread (SourceNode* s)
     : Thread     ("Data Thread")
+    , realTimePriority (true)
+    , firstCore (-1)
 {
     sn = s;
-    setPriority (10);
+    setPriority (getAcquisitionPriority());
 
 	int nSub = getNumSubProcessors();
 	for (int i = 0; i < nSub; i++)
@@ -48,21 +95,196 @@ DataThread::~DataThread()
 
 void DataThread::run()
 {
+    prepareWaitStates();
+    countAllocations();
+
+    if (usesSubProcessorThreads())
+    {
+        runSubProcessorReaders();
+        return;
+    }
+
     while (! threadShouldExit())
     {
+        TRACE_SCOPE ("acquisition", "updateBuffer");
+
         if (! updateBuffer())
-        {
-            const MessageManagerLock mmLock (Thread::getCurrentThread());
+            acquisitionError();
+    }
+}
 
-            LOGD("Aquisition error...stopping thread.");
-            signalThreadShouldExit();
-            LOGD("Notifying source node to stop acqusition.");
-            sn->acquisitionStopped();
-        }
+
+void DataThread::countAllocations()
+{
+    AllocationCounter::setThreadCounted (true);
+    AllocationCounter::setThreadTally (&sn->getProcessTimeProfile().getAllocationTally());
+}
+
+void DataThread::runSubProcessorReaders()
+{
+    readerFailed.set (0);
+
+    int nSub = getNumSubProcessors();
+    for (int i = 0; i < nSub; i++)
+    {
+        SubProcessorReader* reader = new SubProcessorReader (this, i);
+        reader->setAffinityMask (getCoreMask (firstCore < 0 ? -1 : firstCore + i));
+        readers.add (reader);
+        reader->startThread (getAcquisitionPriority());
+    }
+
+    while (! threadShouldExit() && readerFailed.get() == 0)
+        wait (100);
+
+    for (int i = 0; i < readers.size(); i++)
+        readers[i]->signalThreadShouldExit();
+    for (int i = 0; i < readers.size(); i++)
+        readers[i]->stopThread (500);
+    readers.clear();
+
+    if (readerFailed.get() != 0)
+        acquisitionError();
+}
+
+
+void DataThread::acquisitionError()
+{
+    const MessageManagerLock mmLock (Thread::getCurrentThread());
+
+    LOGD("Aquisition error...stopping thread.");
+    signalThreadShouldExit();
+    LOGD("Notifying source node to stop acqusition.");
+    sn->acquisitionStopped();
+}
+
+
+void DataThread::prepareWaitStates()
+{
+    double now = Time::getMillisecondCounterHiRes();
+    int nSub = getNumSubProcessors();
+
+    while (waitStates.size() < nSub)
+        waitStates.add (new DataWaitState());
+
+    for (int i = 0; i < waitStates.size(); i++)
+    {
+        waitStates[i]->lastDataMs = now;
+        waitStates[i]->backoffMs = 0;
+        waitStates[i]->dataReady.reset();
+    }
+}
+
+
+void DataThread::waitForData (int samplesPerBlock, int subProcessor)
+{
+    DataWaitState* state = waitStates[subProcessor];
+    if (state == nullptr)
+    {
+        Thread::sleep (1);
+        return;
+    }
+
+    float sampleRate = getSampleRate (subProcessor);
+    double periodMs = sampleRate > 0 ? 1000.0 * samplesPerBlock / sampleRate : 1.0;
+    double remainingMs = periodMs * DATA_WAIT_SLEEP_FRACTION - (Time::getMillisecondCounterHiRes() - state->lastDataMs);
+
+    int waitMs;
+    if (remainingMs >= 1.0)
+    {
+        waitMs = int (remainingMs);
+    }
+    else
+    {
+        // the block is due: poll, backing off while it is late
+        waitMs = state->backoffMs;
+        state->backoffMs = jlimit (1, jmax (1, int (periodMs * DATA_WAIT_MAX_BACKOFF)), state->backoffMs * 2);
+    }
+
+    if (waitMs <= 0)
+        Thread::yield();
+    else
+        state->dataReady.wait (waitMs);
+}
+
+
+void DataThread::dataArrived (int subProcessor)
+{
+    DataWaitState* state = waitStates[subProcessor];
+    if (state != nullptr)
+    {
+        state->lastDataMs = Time::getMillisecondCounterHiRes();
+        state->backoffMs = 0;
     }
 }
 
 
+void DataThread::notifyDataReady (int subProcessor)
+{
+    DataWaitState* state = waitStates[subProcessor];
+    if (state != nullptr)
+        state->dataReady.signal();
+}
+
+
+bool DataThread::usesSubProcessorThreads() const
+{
+    return false;
+}
+
+
+bool DataThread::updateSubProcessorBuffer (int)
+{
+    return false;
+}
+
+
+void DataThread::setAcquisitionThreadSettings (bool realTime, int core)
+{
+    realTimePriority = realTime;
+    firstCore = core < DATA_THREAD_MAX_CORES ? core : -1;
+
+    applyThreadSettings();
+}
+
+
+void DataThread::applyThreadSettings()
+{
+    setPriority (getAcquisitionPriority());
+    setAffinityMask (getCoreMask (firstCore));
+}
+
+
+int DataThread::getAcquisitionPriority() const
+{
+    if (! realTimePriority)
+        return 0;
+
+    const int priority = ThreadConfig::getPriority (ThreadConfig::ACQUISITION);
+    return priority == THREAD_DEFAULT_PRIORITY ? 5 : priority;
+}
+
+
+bool DataThread::usesRealTimePriority() const
+{
+    return realTimePriority;
+}
+
+
+int DataThread::getFirstAcquisitionCore() const
+{
+    return firstCore;
+}
+
+
+uint32 DataThread::getCoreMask (int core)
+{
+    if (core < 0)
+        return ThreadConfig::getEffectiveCores (ThreadConfig::ACQUISITION);
+
+    return uint32 (1) << (core % jmin (SystemStats::getNumCpus(), DATA_THREAD_MAX_CORES));
+}
+
+
 DataBuffer* DataThread::getBufferAddress(int subProcessor) const
 {
 
@@ -144,6 +366,11 @@ void DataThread::createExtraEvents(Array<EventChannel*>&)
 void DataThread::resizeBuffers()
 {}
 
+void DataThread::resizeSourceBuffer (int subProcessor, int numChannels)
+{
+    sourceBuffers[subProcessor]->resize (numChannels, DataBuffer::getCapacityFor (numChannels, getSampleRate (subProcessor)));
+}
+
 String DataThread::getChannelUnits(int chanIndex) const
 {
 	return String::empty;
@@ -65,8 +65,9 @@ public:
     /** Calls 'updateBuffer()' continuously while the thread is being run.*/
     void run() override;
 
-    /** Returns the address of the DataBuffer that the input source will fill.*/
-    DataBuffer* getBufferAddress(int subProcessor) const;
+    /** Returns the address of the DataBuffer that the input source will fill.
+    Sources that aggregate other threads return the buffers those threads fill.*/
+    virtual DataBuffer* getBufferAddress(int subProcessor) const;
 
 	/** Called when the chain updates, to add, remove or resize the sourceBuffers' DataBuffers as needed*/
 	virtual void resizeBuffers();
@@ -75,6 +76,30 @@ public:
     method for each DataThread.*/
     virtual bool updateBuffer() = 0;
 
+    /** Sources whose subprocessors stream independently can return true to get one reader
+    thread per subprocessor, each calling updateSubProcessorBuffer() instead of updateBuffer().*/
+    virtual bool usesSubProcessorThreads() const;
+
+    /** Fills the DataBuffer of a single subprocessor. Called from the reader thread of that
+    subprocessor when usesSubProcessorThreads() returns true.*/
+    virtual bool updateSubProcessorBuffer (int subProcessor);
+
+    /** Wakes a thread waiting in waitForData(), for sources with a data ready callback.*/
+    void notifyDataReady (int subProcessor = 0);
+
+    /** Sets how the acquisition threads are scheduled the next time acquisition starts.
+    realTime selects the real-time scheduling class; with firstCore >= 0 the thread, or each
+    subprocessor reader in turn, is pinned to a core starting at firstCore.
+    The real-time priority, and the cores used without a first core, are those of the
+    acquisition role in the ThreadConfig.*/
+    void setAcquisitionThreadSettings (bool realTime, int firstCore);
+
+    /** Applies the settings again, to pick up changes of the ThreadConfig before acquisition starts.*/
+    void applyThreadSettings();
+
+    bool usesRealTimePriority() const;
+    int getFirstAcquisitionCore() const;
+
     /** Experimental method used for testing data sources that can deliver outputs.*/
     virtual void setOutputHigh();
 
@@ -142,6 +167,26 @@ public:
 protected:
     virtual void setDefaultChannelNames();
 
+    /** Waits for the next block of a subprocessor when updateBuffer() found no data.
+
+    Sleeps until most of the expected block period, samplesPerBlock / getSampleRate(), has
+    passed since the last block, then polls with a growing backoff. Returns early when
+    notifyDataReady() is called.*/
+    void waitForData (int samplesPerBlock, int subProcessor = 0);
+
+    /** Tells the backoff of waitForData() that a block of the subprocessor has just been read.*/
+    void dataArrived (int subProcessor = 0);
+
+    /** Creates the wait state of every subprocessor before the acquisition threads use them.
+    Called by run(); sources whose updateBuffer() is called from another DataThread's readers
+    call it before starting them.*/
+    void prepareWaitStates();
+
+    /** Resizes the buffer of a subprocessor to numChannels channels, with the capacity
+    DataBuffer::getCapacityFor() gives at getSampleRate (subProcessor). Only safe while
+    the buffer is not being written or read.*/
+    void resizeSourceBuffer (int subProcessor, int numChannels);
+
     SourceNode* sn;
 
     Array<uint64> ttlEventWords;
@@ -151,8 +196,38 @@ protected:
 	OwnedArray<DataBuffer> sourceBuffers;
 
 private:
+    class SubProcessorReader;
+
+    /** Starts a reader per subprocessor and waits until the thread is stopped or a reader fails */
+    void runSubProcessorReaders();
+
+    /** Stops the thread and tells the source node after a failed update */
+    void acquisitionError();
+
+    /** Counts the allocations of the calling acquisition thread as made for the source node */
+    void countAllocations();
+
+    static uint32 getCoreMask (int core);
+
+    int getAcquisitionPriority() const;
+
+    struct DataWaitState
+    {
+        WaitableEvent dataReady;
+        double lastDataMs = 0;
+        int backoffMs = 0;
+    };
+
+    OwnedArray<DataWaitState> waitStates;
+
     Time timer;
 
+    OwnedArray<SubProcessorReader> readers;
+    Atomic<int> readerFailed;
+
+    bool realTimePriority;
+    int firstCore;
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DataThread);
 };
@@ -0,0 +1,177 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "ChannelStatistics.h"
+
+#include <algorithm>
+
+namespace Dsp
+{
+
+namespace
+{
+
+// Step of the median and MAD trackers, relative to the standard deviation of
+// the signal and the averaging rate. Close to the optimal gain for Gaussian
+// noise, 1 / (2 p(median)), for both of them.
+const double TrackingGain = 1.0;
+
+const double MadToNoiseLevel = 1.0 / 0.6745;
+
+inline float sign(float x)
+{
+    return float((x > 0) - (x < 0));
+}
+
+}
+
+ChannelStatistics::ChannelStatistics()
+    : m_numChannels(0)
+{
+}
+
+void ChannelStatistics::setup(int numChannels, double timeConstantSamples)
+{
+    if (numChannels != m_numChannels)
+    {
+        m_channels = std::vector<Channel>(numChannels);
+        m_numChannels = numChannels;
+    }
+
+    for (int channel = 0; channel < m_numChannels; ++channel)
+        setTimeConstant(channel, timeConstantSamples);
+
+    reset();
+}
+
+void ChannelStatistics::setTimeConstant(int channel, double timeConstantSamples)
+{
+    m_channels[channel].alpha = 1.0 / std::max(timeConstantSamples, 1.0);
+}
+
+void ChannelStatistics::reset()
+{
+    for (int channel = 0; channel < m_numChannels; ++channel)
+        reset(channel);
+}
+
+void ChannelStatistics::reset(int channel)
+{
+    Channel& c = m_channels[channel];
+
+    c.count = 0;
+    c.mean = 0;
+    c.meanSquare = 0;
+    c.median = 0;
+    c.mad = 0;
+
+    c.publishedMean = 0;
+    c.publishedRms = 0;
+    c.publishedMedian = 0;
+    c.publishedNoise = 0;
+}
+
+void ChannelStatistics::process(int channel, const float* samples, int numSamples)
+{
+    Channel& c = m_channels[channel];
+
+    double mean = c.mean;
+    double meanSquare = c.meanSquare;
+    float median = c.median;
+    float mad = c.mad;
+    int i = 0;
+
+    if (numSamples > 0 && c.count == 0)
+        median = samples[0];
+
+    // Warming up: cumulative averages, with a tracking step that shrinks
+    // as the estimates settle
+    for (; i < numSamples && c.count * c.alpha < 1.0; ++i)
+    {
+        const double x = samples[i];
+        const double rate = 1.0 / ++c.count;
+
+        mean += rate * (x - mean);
+        meanSquare += rate * (x * x - meanSquare);
+
+        const float step = float(TrackingGain * rate * std::sqrt(std::max(meanSquare - mean * mean, 0.0)));
+        const float deviation = samples[i] - median;
+
+        median += step * sign(deviation);
+        mad += step * sign(std::abs(deviation) - mad);
+    }
+
+    // Steady state: the step only depends on the spread of the signal, which
+    // changes slowly, so it is held for the rest of the block
+    if (i < numSamples)
+    {
+        const double alpha = c.alpha;
+        const float step = float(TrackingGain * alpha * std::sqrt(std::max(meanSquare - mean * mean, 0.0)));
+
+        for (; i < numSamples; ++i)
+        {
+            const double x = samples[i];
+
+            mean += alpha * (x - mean);
+            meanSquare += alpha * (x * x - meanSquare);
+
+            const float deviation = samples[i] - median;
+
+            median += step * sign(deviation);
+            mad += step * sign(std::abs(deviation) - mad);
+        }
+    }
+
+    c.mean = mean;
+    c.meanSquare = meanSquare;
+    c.median = median;
+    c.mad = mad;
+
+    c.publishedMean = float(mean);
+    c.publishedRms = float(std::sqrt(meanSquare));
+    c.publishedMedian = median;
+    c.publishedNoise = float(mad * MadToNoiseLevel);
+}
+
+float ChannelStatistics::getMean(int channel) const
+{
+    return m_channels[channel].publishedMean;
+}
+
+float ChannelStatistics::getRms(int channel) const
+{
+    return m_channels[channel].publishedRms;
+}
+
+float ChannelStatistics::getMedian(int channel) const
+{
+    return m_channels[channel].publishedMedian;
+}
+
+float ChannelStatistics::getNoiseLevel(int channel) const
+{
+    return m_channels[channel].publishedNoise;
+}
+
+}
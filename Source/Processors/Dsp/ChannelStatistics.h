@@ -0,0 +1,102 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_CHANNELSTATISTICS_H
+#define DSPFILTERS_CHANNELSTATISTICS_H
+
+#include "Common.h"
+
+#include <atomic>
+
+namespace Dsp
+{
+
+/*
+ * Streaming statistics of many channels: mean, RMS, median and a MAD based
+ * noise level, all following the signal over a time constant.
+ *
+ * The mean and the mean square are exponential moving averages. The median
+ * and the median absolute deviation are tracked by stochastic approximation,
+ * moving the estimate a small step towards each sample, which makes them as
+ * insensitive to spikes and artifacts as the exact values over a window but
+ * costs O(1) per sample and no history. Until a time constant of samples has
+ * been seen the averages are cumulative, so the values are usable after a
+ * few blocks.
+ *
+ * process() is meant for the audio thread. The getters can be called from
+ * any thread and return the values at the end of the last processed block.
+ *
+ */
+class PLUGIN_API ChannelStatistics
+{
+public:
+    ChannelStatistics();
+
+    // Also resets all the statistics
+    void setup(int numChannels, double timeConstantSamples);
+
+    int getNumChannels() const
+    {
+        return m_numChannels;
+    }
+
+    // Channels can have their own time constant, e.g. for their own sample rate
+    void setTimeConstant(int channel, double timeConstantSamples);
+
+    void reset();
+    void reset(int channel);
+
+    // Updates the statistics of a channel with the next block of its samples
+    void process(int channel, const float* samples, int numSamples);
+
+    float getMean(int channel) const;
+    float getRms(int channel) const;
+    float getMedian(int channel) const;
+
+    // Median absolute deviation scaled to the standard deviation of Gaussian
+    // noise (MAD / 0.6745), the usual robust estimate for spike thresholds
+    float getNoiseLevel(int channel) const;
+
+private:
+    struct Channel
+    {
+        double alpha;
+        double count;
+        double mean;
+        double meanSquare;
+        float median;
+        float mad;
+
+        std::atomic<float> publishedMean;
+        std::atomic<float> publishedRms;
+        std::atomic<float> publishedMedian;
+        std::atomic<float> publishedNoise;
+    };
+
+    int m_numChannels;
+    std::vector<Channel> m_channels;
+};
+
+}
+
+#endif
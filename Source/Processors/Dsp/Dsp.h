@@ -44,11 +44,17 @@ THE SOFTWARE.
 
 #include "Biquad.h"
 #include "Cascade.h"
+#include "ChannelStatistics.h"
+#include "EnvelopeDecimator.h"
 #include "Filter.h"
+#include "FirFilterBank.h"
+#include "MultichannelCascade.h"
 #include "PoleFilter.h"
+#include "PolyphaseDecimator.h"
 #include "SmoothedFilter.h"
 #include "State.h"
 #include "Utilities.h"
+#include "VectorOps.h"
 
 #include "Bessel.h"
 #include "Butterworth.h"
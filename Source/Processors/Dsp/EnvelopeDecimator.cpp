@@ -0,0 +1,186 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "EnvelopeDecimator.h"
+
+#include <algorithm>
+
+namespace Dsp
+{
+
+namespace
+{
+
+enum
+{
+    Lanes = EnvelopeDecimator::Lanes
+};
+
+// One group of channels, with the detector and smoother chosen at compile time
+// so the loop over the lanes has no branches in it
+template <bool Square, bool Boxcar>
+int processGroup(int numSamples, int numLanes, int phase, int factor,
+                 const float* const* input, float* const* output, bool rms,
+                 float coefficient, float* state,
+                 double* sums, float* boxcar, int boxcarLength, int boxcarPosition)
+{
+    const double scale = 1. / boxcarLength;
+
+    float x[Lanes] = { 0 };
+    int next = phase;
+    int k = 0;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (int l = 0; l < numLanes; ++l)
+            x[l] = input[l][i];
+
+        for (int l = 0; l < Lanes; ++l)
+            x[l] = Square ? x[l] * x[l] : std::abs(x[l]);
+
+        if (Boxcar)
+        {
+            float* const oldest = boxcar + boxcarPosition * Lanes;
+            for (int l = 0; l < Lanes; ++l)
+            {
+                sums[l] += x[l] - oldest[l];
+                oldest[l] = x[l];
+                state[l] = static_cast<float>(sums[l] * scale);
+            }
+
+            if (++boxcarPosition == boxcarLength)
+                boxcarPosition = 0;
+        }
+        else
+        {
+            for (int l = 0; l < Lanes; ++l)
+                state[l] += coefficient * (x[l] - state[l]);
+        }
+
+        if (i == next)
+        {
+            // written after the input sample is read, so this works in place
+            for (int l = 0; l < numLanes; ++l)
+                output[l][k] = rms ? std::sqrt(std::max(0.0f, state[l])) : state[l];
+
+            next += factor;
+            ++k;
+        }
+    }
+
+    return k;
+}
+
+}
+
+EnvelopeDecimator::EnvelopeDecimator()
+    : m_numChannels(0)
+    , m_factor(1)
+    , m_phase(0)
+    , m_detector(Rectified)
+    , m_smoother(OnePole)
+    , m_coefficient(1.0f)
+    , m_boxcarLength(1)
+    , m_boxcarPosition(0)
+{
+}
+
+void EnvelopeDecimator::setup(int numChannels, int factor, Detector detector, Smoother smoother, double smoothingSamples)
+{
+    assert(factor > 0);
+
+    m_numChannels = numChannels;
+    m_factor = factor;
+    m_detector = detector;
+    m_smoother = smoother;
+
+    smoothingSamples = std::max(1., smoothingSamples);
+    m_coefficient = static_cast<float>(1. - std::exp(-1. / smoothingSamples));
+    m_boxcarLength = smoother == Boxcar ? static_cast<int>(smoothingSamples + 0.5) : 1;
+
+    const int numGroups = (numChannels + Lanes - 1) / Lanes;
+    m_state.assign(numGroups * Lanes, 0.0f);
+    m_sums.assign(numGroups * Lanes, 0.);
+    m_boxcar.assign(numGroups * m_boxcarLength * Lanes, 0.0f);
+
+    reset();
+}
+
+void EnvelopeDecimator::setPhase(int phase)
+{
+    m_phase = ((phase % m_factor) + m_factor) % m_factor;
+}
+
+void EnvelopeDecimator::reset()
+{
+    std::fill(m_state.begin(), m_state.end(), 0.0f);
+    std::fill(m_sums.begin(), m_sums.end(), 0.);
+    std::fill(m_boxcar.begin(), m_boxcar.end(), 0.0f);
+    m_boxcarPosition = 0;
+    m_phase = 0;
+}
+
+int EnvelopeDecimator::getNumOutputSamples(int numSamples) const
+{
+    return numSamples > m_phase ? (numSamples - m_phase - 1) / m_factor + 1 : 0;
+}
+
+int EnvelopeDecimator::process(int numSamples, const float* const* input, float* const* output)
+{
+    const bool square = m_detector != Rectified;
+    const bool boxcar = m_smoother == Boxcar;
+    const bool rms = m_detector == Rms;
+
+    const int numOutputs = getNumOutputSamples(numSamples);
+
+    for (int first = 0; first < m_numChannels; first += Lanes)
+    {
+        const int group = first / Lanes;
+        const int numLanes = std::min(int(Lanes), m_numChannels - first);
+
+        float* const state = m_state.data() + group * Lanes;
+        double* const sums = m_sums.data() + group * Lanes;
+        float* const history = m_boxcar.data() + group * m_boxcarLength * Lanes;
+
+        if (square && boxcar)
+            processGroup<true, true>(numSamples, numLanes, m_phase, m_factor, input + first, output + first, rms,
+                                     m_coefficient, state, sums, history, m_boxcarLength, m_boxcarPosition);
+        else if (square)
+            processGroup<true, false>(numSamples, numLanes, m_phase, m_factor, input + first, output + first, rms,
+                                      m_coefficient, state, sums, history, m_boxcarLength, m_boxcarPosition);
+        else if (boxcar)
+            processGroup<false, true>(numSamples, numLanes, m_phase, m_factor, input + first, output + first, rms,
+                                      m_coefficient, state, sums, history, m_boxcarLength, m_boxcarPosition);
+        else
+            processGroup<false, false>(numSamples, numLanes, m_phase, m_factor, input + first, output + first, rms,
+                                       m_coefficient, state, sums, history, m_boxcarLength, m_boxcarPosition);
+    }
+
+    m_boxcarPosition = (m_boxcarPosition + numSamples) % m_boxcarLength;
+    m_phase += numOutputs * m_factor - numSamples;
+
+    return numOutputs;
+}
+
+}
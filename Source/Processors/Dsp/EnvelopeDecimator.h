@@ -0,0 +1,115 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_ENVELOPEDECIMATOR_H
+#define DSPFILTERS_ENVELOPEDECIMATOR_H
+
+#include "Common.h"
+
+namespace Dsp
+{
+
+/*
+ * Extracts the envelope of many channels and downsamples it by an integer
+ * factor, in a single pass over the input.
+ *
+ * Every sample is rectified or squared, then smoothed by a one-pole low pass
+ * or a boxcar (moving average), and one smoothed sample out of every factor
+ * samples is kept. The smoother is the only anti-aliasing filter, so it
+ * should be at least about factor samples long. Like PolyphaseDecimator,
+ * channels are processed in groups of Lanes channels in lockstep, so the
+ * recursions run across channels and can be vectorized, and all channels
+ * share the decimation phase.
+ *
+ */
+class PLUGIN_API EnvelopeDecimator
+{
+public:
+    enum
+    {
+        Lanes = 8
+    };
+
+    enum Detector
+    {
+        Rectified = 0,  // mean absolute value
+        Power,          // mean square
+        Rms             // square root of the mean square
+    };
+
+    enum Smoother
+    {
+        OnePole = 0,
+        Boxcar
+    };
+
+    EnvelopeDecimator();
+
+    // The one-pole smoother has a time constant of smoothingSamples, the boxcar
+    // averages the last smoothingSamples samples (rounded, at least one).
+    void setup(int numChannels, int factor, Detector detector, Smoother smoother, double smoothingSamples);
+
+    int getNumChannels() const
+    {
+        return m_numChannels;
+    }
+
+    int getFactor() const
+    {
+        return m_factor;
+    }
+
+    // Number of input samples to skip before the next kept sample
+    void setPhase(int phase);
+
+    int getPhase() const
+    {
+        return m_phase;
+    }
+
+    void reset();
+
+    // Number of samples the next process() call returns for a block of numSamples
+    int getNumOutputSamples(int numSamples) const;
+
+    // Processes a block, one array per channel. The output arrays can be the
+    // input arrays. Returns the number of output samples.
+    int process(int numSamples, const float* const* input, float* const* output);
+
+private:
+    int m_numChannels;
+    int m_factor;
+    int m_phase;
+    Detector m_detector;
+    Smoother m_smoother;
+    float m_coefficient;
+    int m_boxcarLength;
+    int m_boxcarPosition;
+    std::vector<float> m_state;
+    std::vector<double> m_sums;
+    std::vector<float> m_boxcar;
+};
+
+}
+
+#endif
@@ -0,0 +1,463 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "FirFilterBank.h"
+#include "MathSupplement.h"
+
+#include <algorithm>
+
+namespace Dsp
+{
+
+FirFilterBank::FirFilterBank()
+    : m_numChannels(0)
+    , m_partitionSize(0)
+    , m_fftSize(0)
+    , m_numBins(0)
+    , m_maxPartitions(0)
+    , m_fill(0)
+    , m_head(0)
+{
+}
+
+FirFilterBank::~FirFilterBank()
+{
+}
+
+std::vector<float> FirFilterBank::designBandPass(int numTaps, double sampleRate,
+                                                 double lowCut, double highCut)
+{
+    numTaps = std::max(3, numTaps | 1);
+
+    const double fl = lowCut / sampleRate;
+    const double fh = highCut / sampleRate;
+    const double center = (numTaps - 1) / 2.;
+
+    std::vector<double> h(numTaps);
+    for (int n = 0; n < numTaps; ++n)
+    {
+        const double t = n - center;
+        double v;
+        if (t == 0)
+            v = 2 * (fh - fl);
+        else
+            v = (std::sin(2 * doublePi * fh * t) - std::sin(2 * doublePi * fl * t)) / (doublePi * t);
+
+        const double window = 0.54 - 0.46 * std::cos(2 * doublePi * n / (numTaps - 1));
+        h[n] = v * window;
+    }
+
+    // unity gain at the center of the pass band
+    const double f0 = (fl + fh) / 2;
+    complex_t gain(0);
+    for (int n = 0; n < numTaps; ++n)
+        gain += h[n] * std::polar(1., -2 * doublePi * f0 * n);
+
+    const double scale = std::abs(gain) > 0 ? 1. / std::abs(gain) : 1.;
+
+    std::vector<float> taps(numTaps);
+    for (int n = 0; n < numTaps; ++n)
+        taps[n] = static_cast<float>(h[n] * scale);
+
+    return taps;
+}
+
+void FirFilterBank::setNumChannels(int numChannels, int partitionSize, int maxTaps)
+{
+    assert(partitionSize > 0 && (partitionSize & (partitionSize - 1)) == 0);
+
+    m_numChannels = numChannels;
+    m_partitionSize = partitionSize;
+    m_fftSize = partitionSize * 2;
+    m_numBins = partitionSize + 1;
+    m_maxPartitions = std::max(1, (maxTaps + partitionSize - 1) / partitionSize);
+
+    int order = 0;
+    while ((1 << order) < m_fftSize)
+        ++order;
+
+    m_forward = new juce::FFT(order, false);
+    m_inverse = new juce::FFT(order, true);
+
+    // each channel holds at most two kernels, so swapping kernels never reallocates this
+    m_kernels.clear();
+    m_kernels.reserve(2 * numChannels);
+    m_channelKernels.assign(numChannels, -1);
+    m_channelEnabled.assign(numChannels, true);
+
+    m_fadeKernels.assign(numChannels, -1);
+    m_fadePosition.assign(numChannels, 0);
+    m_fadeLength.assign(numChannels, 0);
+
+    m_input.assign(numChannels * m_fftSize, 0.0f);
+    m_output.assign(numChannels * m_partitionSize, 0.0f);
+    m_inputSpectra.assign(numChannels * m_maxPartitions * m_numBins, std::complex<float>(0));
+
+    m_timeBuffer.resize(m_fftSize);
+    m_freqBuffer.resize(m_fftSize);
+    m_accumulator.resize(2 * m_numBins);
+
+    m_fill = 0;
+    m_head = 0;
+}
+
+void FirFilterBank::releaseKernel(int channel)
+{
+    int index = m_channelKernels[channel];
+    if (index >= 0)
+        --m_kernels[index].numChannels;
+    m_channelKernels[channel] = -1;
+}
+
+void FirFilterBank::endFade(int channel)
+{
+    int index = m_fadeKernels[channel];
+    if (index >= 0)
+        --m_kernels[index].numChannels;
+    m_fadeKernels[channel] = -1;
+}
+
+FirFilterBank::KernelDesign FirFilterBank::prepareKernel(const std::vector<float>& taps) const
+{
+    assert(static_cast<int>(taps.size()) <= m_maxPartitions * m_partitionSize);
+
+    int order = 0;
+    while ((1 << order) < m_fftSize)
+        ++order;
+
+    // a transform of its own, as the one of the bank may be in use
+    juce::FFT forward(order, false);
+    std::vector<juce::FFT::Complex> timeBuffer(m_fftSize);
+    std::vector<juce::FFT::Complex> freqBuffer(m_fftSize);
+
+    KernelDesign design;
+    design.taps = taps;
+
+    const int numTaps = static_cast<int>(taps.size());
+    const int numPartitions = (numTaps + m_partitionSize - 1) / m_partitionSize;
+    design.spectra.resize(numPartitions * m_numBins);
+
+    const float scale = 1.0f / m_fftSize;
+    for (int p = 0; p < numPartitions; ++p)
+    {
+        for (int j = 0; j < m_fftSize; ++j)
+        {
+            const int tap = p * m_partitionSize + j;
+            timeBuffer[j].r = (j < m_partitionSize && tap < numTaps) ? taps[tap] : 0.0f;
+            timeBuffer[j].i = 0.0f;
+        }
+
+        forward.perform(&timeBuffer[0], &freqBuffer[0]);
+
+        for (int k = 0; k < m_numBins; ++k)
+            design.spectra[p * m_numBins + k] = std::complex<float>(freqBuffer[k].r * scale,
+                                                                    freqBuffer[k].i * scale);
+    }
+
+    return design;
+}
+
+void FirFilterBank::setChannelKernel(int channel, const std::vector<float>& taps)
+{
+    KernelDesign design = prepareKernel(taps);
+    setChannelKernel(channel, design);
+}
+
+void FirFilterBank::setChannelKernel(int channel, KernelDesign& design, int fadeSamples)
+{
+    assert(channel >= 0 && channel < m_numChannels);
+    assert(static_cast<int>(design.taps.size()) <= m_maxPartitions * m_partitionSize);
+
+    endFade(channel);
+
+    // a disabled channel doesn't advance its fade, so it switches at once
+    if (fadeSamples > 0 && m_channelEnabled[channel] && m_channelKernels[channel] >= 0)
+    {
+        m_fadeKernels[channel] = m_channelKernels[channel];
+        m_fadePosition[channel] = 0;
+        m_fadeLength[channel] = fadeSamples;
+        m_channelKernels[channel] = -1;
+    }
+    else
+    {
+        releaseKernel(channel);
+    }
+
+    // share an existing kernel if possible, otherwise reuse an unused one
+    int index = -1;
+    int unused = -1;
+    for (int i = 0; i < static_cast<int>(m_kernels.size()); ++i)
+    {
+        if (m_kernels[i].numChannels > 0 && m_kernels[i].taps == design.taps)
+        {
+            index = i;
+            break;
+        }
+        if (unused < 0 && m_kernels[i].numChannels == 0)
+            unused = i;
+    }
+
+    if (index < 0)
+    {
+        if (unused >= 0)
+        {
+            index = unused;
+        }
+        else
+        {
+            index = static_cast<int>(m_kernels.size());
+            m_kernels.push_back(Kernel());
+        }
+
+        Kernel& kernel = m_kernels[index];
+        kernel.numTaps = static_cast<int>(design.taps.size());
+        kernel.numChannels = 0;
+        kernel.taps.swap(design.taps);
+        kernel.spectra.swap(design.spectra);
+    }
+
+    ++m_kernels[index].numChannels;
+    m_channelKernels[channel] = index;
+}
+
+void FirFilterBank::setChannelEnabled(int channel, bool enabled)
+{
+    assert(channel >= 0 && channel < m_numChannels);
+
+    if (enabled && !m_channelEnabled[channel])
+    {
+        // the history of a disabled channel isn't kept up to date
+        std::fill(m_input.begin() + channel * m_fftSize, m_input.begin() + (channel + 1) * m_fftSize, 0.0f);
+        std::fill(m_output.begin() + channel * m_partitionSize, m_output.begin() + (channel + 1) * m_partitionSize, 0.0f);
+        std::fill(m_inputSpectra.begin() + channel * m_maxPartitions * m_numBins,
+                  m_inputSpectra.begin() + (channel + 1) * m_maxPartitions * m_numBins,
+                  std::complex<float>(0));
+    }
+    if (!enabled)
+        endFade(channel);
+    m_channelEnabled[channel] = enabled;
+}
+
+int FirFilterBank::getLatency(int channel) const
+{
+    const int index = m_channelKernels[channel];
+    if (index < 0)
+        return 0;
+    return m_partitionSize + (m_kernels[index].numTaps - 1) / 2;
+}
+
+void FirFilterBank::reset()
+{
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+    std::fill(m_inputSpectra.begin(), m_inputSpectra.end(), std::complex<float>(0));
+    for (int c = 0; c < m_numChannels; ++c)
+        endFade(c);
+    m_fill = 0;
+    m_head = 0;
+}
+
+void FirFilterBank::process(int numSamples, float* const* arrayOfChannels)
+{
+    int position = 0;
+
+    while (position < numSamples)
+    {
+        const int count = std::min(m_partitionSize - m_fill, numSamples - position);
+
+        for (int c = 0; c < m_numChannels; ++c)
+        {
+            if (!m_channelEnabled[c] || m_channelKernels[c] < 0)
+                continue;
+
+            // gather the input, and hand out the output of the previous partition
+            float* samples = arrayOfChannels[c] + position;
+            float* input = &m_input[c * m_fftSize + m_partitionSize + m_fill];
+            const float* output = &m_output[c * m_partitionSize + m_fill];
+
+            for (int i = 0; i < count; ++i)
+            {
+                input[i] = samples[i];
+                samples[i] = output[i];
+            }
+        }
+
+        m_fill += count;
+        position += count;
+
+        if (m_fill == m_partitionSize)
+        {
+            processPartition();
+            m_fill = 0;
+        }
+    }
+}
+
+void FirFilterBank::processPartition()
+{
+    m_head = (m_head + 1) % m_maxPartitions;
+
+    for (int pair = 0; pair < (m_numChannels + 1) / 2; ++pair)
+        processPair(pair);
+
+    // the current partition becomes the previous one
+    for (int c = 0; c < m_numChannels; ++c)
+    {
+        float* input = &m_input[c * m_fftSize];
+        std::copy(input + m_partitionSize, input + m_fftSize, input);
+    }
+}
+
+void FirFilterBank::processPair(int pair)
+{
+    const int channels[2] = { 2 * pair, 2 * pair + 1 };
+    bool active[2];
+    for (int i = 0; i < 2; ++i)
+        active[i] = channels[i] < m_numChannels && m_channelEnabled[channels[i]]
+                    && m_channelKernels[channels[i]] >= 0;
+
+    if (!active[0] && !active[1])
+        return;
+
+    // channel a in the real part, channel b in the imaginary part
+    for (int j = 0; j < m_fftSize; ++j)
+    {
+        m_timeBuffer[j].r = active[0] ? m_input[channels[0] * m_fftSize + j] : 0.0f;
+        m_timeBuffer[j].i = active[1] ? m_input[channels[1] * m_fftSize + j] : 0.0f;
+    }
+
+    m_forward->perform(&m_timeBuffer[0], &m_freqBuffer[0]);
+
+    // split the spectrum into the spectra of both channels
+    std::complex<float>* spectraA = &m_inputSpectra[(channels[0] * m_maxPartitions + m_head) * m_numBins];
+    std::complex<float>* spectraB = active[1] ? &m_inputSpectra[(channels[1] * m_maxPartitions + m_head) * m_numBins] : nullptr;
+
+    for (int k = 0; k < m_numBins; ++k)
+    {
+        const juce::FFT::Complex& z = m_freqBuffer[k];
+        const juce::FFT::Complex& zm = m_freqBuffer[(m_fftSize - k) % m_fftSize];
+        if (active[0])
+            spectraA[k] = std::complex<float>((z.r + zm.r) * 0.5f, (z.i - zm.i) * 0.5f);
+        if (active[1])
+            spectraB[k] = std::complex<float>((z.i + zm.i) * 0.5f, (zm.r - z.r) * 0.5f);
+    }
+
+    // multiply-accumulate the partitions of each kernel with the input history
+    for (int i = 0; i < 2; ++i)
+        accumulate(channels[i], active[i] ? m_channelKernels[channels[i]] : -1, &m_accumulator[i * m_numBins]);
+
+    transformOutput();
+
+    // the second half of the overlap-save frame holds the valid output
+    for (int j = 0; j < m_partitionSize; ++j)
+    {
+        if (active[0])
+            m_output[channels[0] * m_partitionSize + j] = m_timeBuffer[m_partitionSize + j].r;
+        if (active[1])
+            m_output[channels[1] * m_partitionSize + j] = m_timeBuffer[m_partitionSize + j].i;
+    }
+
+    bool fading[2];
+    for (int i = 0; i < 2; ++i)
+        fading[i] = active[i] && m_fadeKernels[channels[i]] >= 0;
+
+    if (!fading[0] && !fading[1])
+        return;
+
+    // filter the same history with the kernels faded out, and ramp from their output
+    for (int i = 0; i < 2; ++i)
+        accumulate(channels[i], fading[i] ? m_fadeKernels[channels[i]] : -1, &m_accumulator[i * m_numBins]);
+
+    transformOutput();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (!fading[i])
+            continue;
+
+        const int c = channels[i];
+        float* output = &m_output[c * m_partitionSize];
+        const float length = static_cast<float>(m_fadeLength[c]);
+
+        for (int j = 0; j < m_partitionSize; ++j)
+        {
+            const float previous = i == 0 ? m_timeBuffer[m_partitionSize + j].r : m_timeBuffer[m_partitionSize + j].i;
+            const float gain = std::min(1.0f, (m_fadePosition[c] + j + 1) / length);
+            output[j] = previous + gain * (output[j] - previous);
+        }
+
+        m_fadePosition[c] += m_partitionSize;
+        if (m_fadePosition[c] >= m_fadeLength[c])
+            endFade(c);
+    }
+}
+
+void FirFilterBank::accumulate(int channel, int kernel, std::complex<float>* acc)
+{
+    std::fill(acc, acc + m_numBins, std::complex<float>(0));
+
+    if (kernel < 0)
+        return;
+
+    const Kernel& k = m_kernels[kernel];
+    const int numPartitions = static_cast<int>(k.spectra.size()) / m_numBins;
+    const std::complex<float>* history = &m_inputSpectra[channel * m_maxPartitions * m_numBins];
+
+    for (int p = 0; p < numPartitions; ++p)
+    {
+        const int slot = (m_head - p + m_maxPartitions) % m_maxPartitions;
+        const std::complex<float>* x = history + slot * m_numBins;
+        const std::complex<float>* h = &k.spectra[p * m_numBins];
+
+        for (int b = 0; b < m_numBins; ++b)
+            acc[b] += x[b] * h[b];
+    }
+}
+
+void FirFilterBank::transformOutput()
+{
+    // recombine both outputs into one complex spectrum
+    const std::complex<float>* ya = &m_accumulator[0];
+    const std::complex<float>* yb = &m_accumulator[m_numBins];
+    for (int k = 0; k < m_fftSize; ++k)
+    {
+        std::complex<float> a, b;
+        if (k < m_numBins)
+        {
+            a = ya[k];
+            b = yb[k];
+        }
+        else
+        {
+            a = std::conj(ya[m_fftSize - k]);
+            b = std::conj(yb[m_fftSize - k]);
+        }
+        m_freqBuffer[k].r = a.real() - b.imag();
+        m_freqBuffer[k].i = a.imag() + b.real();
+    }
+
+    m_inverse->perform(&m_freqBuffer[0], &m_timeBuffer[0]);
+}
+
+}
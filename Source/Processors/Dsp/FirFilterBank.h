@@ -0,0 +1,143 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_FIRFILTERBANK_H
+#define DSPFILTERS_FIRFILTERBANK_H
+
+#include "Common.h"
+
+namespace Dsp
+{
+
+/*
+ * Linear-phase FIR filters for many channels, using uniformly partitioned
+ * overlap-save FFT convolution, so the cost grows slowly with kernel length.
+ *
+ * Samples are gathered into partitions of partitionSize samples, so each
+ * channel is delayed by partitionSize samples plus the group delay of its
+ * kernel, (numTaps - 1) / 2, whatever the size of the processed blocks.
+ * Pairs of channels share each transform, as the real and imaginary parts
+ * of one complex signal. Channels with identical kernels share their spectra.
+ *
+ */
+class PLUGIN_API FirFilterBank
+{
+public:
+    FirFilterBank();
+    ~FirFilterBank();
+
+    // Windowed-sinc (Hamming) band pass design. numTaps is made odd, so
+    // the group delay is a whole number of samples.
+    static std::vector<float> designBandPass(int numTaps, double sampleRate,
+                                             double lowCut, double highCut);
+
+    // partitionSize must be a power of two, and kernels can have up to maxTaps taps
+    void setNumChannels(int numChannels, int partitionSize, int maxTaps);
+
+    int getNumChannels() const
+    {
+        return m_numChannels;
+    }
+
+    // Taps and spectra of a kernel, prepared away from the processing thread
+    struct KernelDesign
+    {
+        std::vector<float> taps;
+        std::vector<std::complex<float> > spectra;
+    };
+
+    // Transforms the taps of a kernel for the current partition size. This
+    // allocates, but leaves the processing state alone, so it can run on
+    // another thread than process().
+    KernelDesign prepareKernel(const std::vector<float>& taps) const;
+
+    // Sets the kernel of one channel. Its taps are copied.
+    void setChannelKernel(int channel, const std::vector<float>& taps);
+
+    // Swaps in a prepared kernel, crossfading the output of the channel from
+    // its previous kernel over fadeSamples. This doesn't allocate: the storage
+    // of the replaced kernel is handed back in design, to be freed by the caller.
+    void setChannelKernel(int channel, KernelDesign& design, int fadeSamples = 0);
+
+    // Disabled channels are left untouched by process()
+    void setChannelEnabled(int channel, bool enabled);
+
+    // Total delay of a channel, in samples
+    int getLatency(int channel) const;
+
+    void reset();
+
+    // Filters a block of samples in place, one array per channel
+    void process(int numSamples, float* const* arrayOfChannels);
+
+private:
+    struct Kernel
+    {
+        int numTaps;
+        int numChannels;
+        std::vector<float> taps;
+        // numPartitions spectra of numBins bins, scaled for the inverse transform
+        std::vector<std::complex<float> > spectra;
+    };
+
+    void releaseKernel(int channel);
+    void endFade(int channel);
+    void processPartition();
+    void processPair(int pair);
+    void accumulate(int channel, int kernel, std::complex<float>* acc);
+    void transformOutput();
+
+    int m_numChannels;
+    int m_partitionSize;
+    int m_fftSize;
+    int m_numBins;
+    int m_maxPartitions;
+    int m_fill;
+    int m_head;
+
+    juce::ScopedPointer<juce::FFT> m_forward;
+    juce::ScopedPointer<juce::FFT> m_inverse;
+
+    std::vector<Kernel> m_kernels;
+    std::vector<int> m_channelKernels;
+    std::vector<bool> m_channelEnabled;
+
+    // per channel: the kernel faded out, or -1, and how far the fade has got
+    std::vector<int> m_fadeKernels;
+    std::vector<int> m_fadePosition;
+    std::vector<int> m_fadeLength;
+
+    // per channel: the previous and current input partitions, and the output partition
+    std::vector<float> m_input;
+    std::vector<float> m_output;
+    // per channel: a ring of the spectra of the last m_maxPartitions input partitions
+    std::vector<std::complex<float> > m_inputSpectra;
+
+    std::vector<juce::FFT::Complex> m_timeBuffer;
+    std::vector<juce::FFT::Complex> m_freqBuffer;
+    std::vector<std::complex<float> > m_accumulator;
+};
+
+}
+
+#endif
@@ -0,0 +1,473 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "MultichannelCascade.h"
+
+#include <algorithm>
+
+namespace Dsp
+{
+
+MultichannelCascade::MultichannelCascade()
+    : m_numFading(0)
+    , m_precision(DoublePrecision)
+    , m_groupsChanged(false)
+    , m_denormalPrevention(true)
+    , m_vsa(anti_denormal_vsa)
+    , m_blockVsa(anti_denormal_vsa)
+{
+}
+
+void MultichannelCascade::setNumChannels(int numChannels)
+{
+    m_coefficients.clear();
+    m_channelCoefficients.assign(numChannels, -1);
+    m_fadeCoefficients.assign(numChannels, -1);
+    m_fadePosition.assign(numChannels, 0);
+    m_fadeLength.assign(numChannels, 0);
+    m_channelEnabled.assign(numChannels, true);
+    m_state.assign(numChannels * MaxStages * 2, 0);
+    m_fadeState.assign(numChannels * MaxStages * 2, 0);
+    m_groupChannels.assign(numChannels, 0);
+    m_numFading = 0;
+
+    // each channel uses at most two sets of coefficients while fading, so
+    // changing coefficients never has to allocate
+    m_coefficients.reserve(numChannels * 2);
+    m_groups.reserve(numChannels);
+    m_groupsChanged = true;
+}
+
+void MultichannelCascade::Coefficients::setCascade(const Cascade& cascade)
+{
+    assert(cascade.getNumStages() <= MaxStages);
+
+    numStages = cascade.getNumStages();
+    for (int i = 0; i < numStages; ++i)
+    {
+        const Biquad& stage = cascade[i];
+        a1[i] = stage.m_a1;
+        a2[i] = stage.m_a2;
+        b0[i] = stage.m_b0;
+        b1[i] = stage.m_b1;
+        b2[i] = stage.m_b2;
+    }
+}
+
+bool MultichannelCascade::Coefficients::hasSameStages(const Coefficients& other) const
+{
+    if (numStages != other.numStages)
+        return false;
+
+    for (int i = 0; i < numStages; ++i)
+    {
+        if (a1[i] != other.a1[i] || a2[i] != other.a2[i]
+            || b0[i] != other.b0[i] || b1[i] != other.b1[i] || b2[i] != other.b2[i])
+            return false;
+    }
+    return true;
+}
+
+int MultichannelCascade::acquireCoefficients(const Coefficients& coefficients)
+{
+    // share an existing copy if possible, otherwise reuse an unused one
+    int index = -1;
+    int unused = -1;
+    for (int i = 0; i < static_cast<int>(m_coefficients.size()); ++i)
+    {
+        if (m_coefficients[i].numChannels > 0 && m_coefficients[i].hasSameStages(coefficients))
+        {
+            index = i;
+            break;
+        }
+        if (unused < 0 && m_coefficients[i].numChannels == 0)
+            unused = i;
+    }
+
+    if (index < 0)
+    {
+        if (unused < 0)
+        {
+            unused = static_cast<int>(m_coefficients.size());
+            m_coefficients.push_back(SharedCoefficients());
+        }
+
+        index = unused;
+        static_cast<Coefficients&>(m_coefficients[index]) = coefficients;
+        m_coefficients[index].numChannels = 0;
+    }
+
+    ++m_coefficients[index].numChannels;
+    return index;
+}
+
+void MultichannelCascade::releaseCoefficients(int index)
+{
+    if (index >= 0)
+        --m_coefficients[index].numChannels;
+}
+
+void MultichannelCascade::finishFade(int channel)
+{
+    if (m_fadeCoefficients[channel] < 0)
+        return;
+
+    releaseCoefficients(m_channelCoefficients[channel]);
+    m_channelCoefficients[channel] = m_fadeCoefficients[channel];
+    m_fadeCoefficients[channel] = -1;
+    --m_numFading;
+
+    std::copy(m_fadeState.begin() + channel * MaxStages * 2,
+              m_fadeState.begin() + (channel + 1) * MaxStages * 2,
+              m_state.begin() + channel * MaxStages * 2);
+
+    m_groupsChanged = true;
+}
+
+void MultichannelCascade::cancelFade(int channel)
+{
+    if (m_fadeCoefficients[channel] < 0)
+        return;
+
+    releaseCoefficients(m_fadeCoefficients[channel]);
+    m_fadeCoefficients[channel] = -1;
+    --m_numFading;
+    m_groupsChanged = true;
+}
+
+void MultichannelCascade::setChannelCascade(int channel, const Cascade& cascade)
+{
+    Coefficients c;
+    c.setCascade(cascade);
+    setChannelCoefficients(channel, c);
+}
+
+void MultichannelCascade::setChannelCoefficients(int channel, const Coefficients& coefficients,
+                                                 int fadeSamples)
+{
+    assert(channel >= 0 && channel < getNumChannels());
+    assert(coefficients.numStages <= MaxStages);
+
+    // a fade in progress jumps to its end, and the new fade starts from there
+    finishFade(channel);
+
+    const int index = acquireCoefficients(coefficients);
+    const int current = m_channelCoefficients[channel];
+
+    if (fadeSamples > 0 && current >= 0 && current != index && m_channelEnabled[channel])
+    {
+        m_fadeCoefficients[channel] = index;
+        m_fadePosition[channel] = 0;
+        m_fadeLength[channel] = fadeSamples;
+        ++m_numFading;
+
+        // the new filter starts from the state of the old one
+        std::copy(m_state.begin() + channel * MaxStages * 2,
+                  m_state.begin() + (channel + 1) * MaxStages * 2,
+                  m_fadeState.begin() + channel * MaxStages * 2);
+    }
+    else
+    {
+        releaseCoefficients(current);
+        m_channelCoefficients[channel] = index;
+    }
+
+    m_groupsChanged = true;
+}
+
+void MultichannelCascade::setChannelEnabled(int channel, bool enabled)
+{
+    assert(channel >= 0 && channel < getNumChannels());
+
+    if (m_channelEnabled[channel] != enabled)
+    {
+        finishFade(channel);
+        m_channelEnabled[channel] = enabled;
+        m_groupsChanged = true;
+    }
+}
+
+void MultichannelCascade::setPrecision(Precision precision)
+{
+    m_precision = precision;
+}
+
+void MultichannelCascade::setDenormalPrevention(bool shouldPrevent)
+{
+    m_denormalPrevention = shouldPrevent;
+}
+
+void MultichannelCascade::reset()
+{
+    for (int n = 0; n < getNumChannels(); ++n)
+        finishFade(n);
+
+    std::fill(m_state.begin(), m_state.end(), 0.0);
+    std::fill(m_fadeState.begin(), m_fadeState.end(), 0.0);
+}
+
+void MultichannelCascade::updateGroups()
+{
+    int numGrouped = 0;
+    for (int n = 0; n < getNumChannels(); ++n)
+    {
+        if (m_channelCoefficients[n] >= 0 && m_channelEnabled[n])
+            m_groupChannels[numGrouped++] = n;
+    }
+
+    // sorting in place keeps the channels of each group in ascending order
+    // without allocating
+    const std::vector<int>& coefficients = m_channelCoefficients;
+    const std::vector<int>& fadeCoefficients = m_fadeCoefficients;
+    std::sort(m_groupChannels.begin(), m_groupChannels.begin() + numGrouped,
+              [&coefficients, &fadeCoefficients](int a, int b)
+              {
+                  if (coefficients[a] != coefficients[b])
+                      return coefficients[a] < coefficients[b];
+                  if (fadeCoefficients[a] != fadeCoefficients[b])
+                      return fadeCoefficients[a] < fadeCoefficients[b];
+                  return a < b;
+              });
+
+    m_groups.clear();
+
+    for (int i = 0; i < numGrouped;)
+    {
+        ChannelGroup group;
+        group.coefficients = m_channelCoefficients[m_groupChannels[i]];
+        group.fadeCoefficients = m_fadeCoefficients[m_groupChannels[i]];
+        group.begin = i;
+
+        while (i < numGrouped
+               && m_channelCoefficients[m_groupChannels[i]] == group.coefficients
+               && m_fadeCoefficients[m_groupChannels[i]] == group.fadeCoefficients)
+            ++i;
+
+        group.end = i;
+        m_groups.push_back(group);
+    }
+
+    m_groupsChanged = false;
+}
+
+void MultichannelCascade::prepareToProcess(int numSamples)
+{
+    if (m_numFading > 0)
+    {
+        for (int n = 0; n < getNumChannels(); ++n)
+        {
+            if (m_fadeCoefficients[n] >= 0 && m_fadePosition[n] >= m_fadeLength[n])
+                finishFade(n);
+        }
+    }
+
+    if (m_groupsChanged)
+        updateGroups();
+
+    // keep the anti-denormal signal alternating across blocks
+    m_blockVsa = m_denormalPrevention ? m_vsa : 0;
+    if (numSamples & 1)
+        m_vsa = -m_vsa;
+}
+
+void MultichannelCascade::process(int numSamples, float* const* arrayOfChannels)
+{
+    prepareToProcess(numSamples);
+    processChannels(numSamples, arrayOfChannels, 0, getNumChannels());
+}
+
+void MultichannelCascade::processChannels(int numSamples, float* const* arrayOfChannels,
+                                          int startChannel, int endChannel)
+{
+    if (numSamples <= 0)
+        return;
+
+    float* lanes[Lanes];
+    double* states[Lanes];
+
+    for (size_t g = 0; g < m_groups.size(); ++g)
+    {
+        const ChannelGroup& group = m_groups[g];
+        const Coefficients& c = m_coefficients[group.coefficients];
+
+        // group channels are in ascending order
+        const std::vector<int>::const_iterator begin = m_groupChannels.begin();
+        std::vector<int>::const_iterator first = std::lower_bound(begin + group.begin, begin + group.end, startChannel);
+        std::vector<int>::const_iterator last = std::lower_bound(first, begin + group.end, endChannel);
+
+        while (first != last)
+        {
+            const int numLanes = static_cast<int>(std::min(static_cast<std::ptrdiff_t>(Lanes), last - first));
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                lanes[lane] = arrayOfChannels[first[lane]];
+                states[lane] = &m_state[first[lane] * MaxStages * 2];
+            }
+
+            if (group.fadeCoefficients < 0)
+                processGroupLanes(numLanes, numSamples, c, lanes, states);
+            else
+                processFadeLanes(numLanes, numSamples, group, lanes, &*first);
+
+            first += numLanes;
+        }
+    }
+}
+
+void MultichannelCascade::processGroupLanes(int numLanes, int numSamples, const Coefficients& c,
+                                            float* const* lanes, double* const* states) const
+{
+    if (m_precision == SinglePrecision)
+        processLanesOfType<float>(numLanes, numSamples, c, lanes, states);
+    else
+        processLanesOfType<double>(numLanes, numSamples, c, lanes, states);
+}
+
+template <typename StateType>
+void MultichannelCascade::processLanesOfType(int numLanes, int numSamples, const Coefficients& c,
+                                             float* const* lanes, double* const* states) const
+{
+    const StateType vsa = static_cast<StateType>(m_blockVsa);
+
+    switch (numLanes)
+    {
+        case 1: processLanes<StateType, 1>(numSamples, c, lanes, states, vsa); break;
+        case 2: processLanes<StateType, 2>(numSamples, c, lanes, states, vsa); break;
+        case 3: processLanes<StateType, 3>(numSamples, c, lanes, states, vsa); break;
+        case 4: processLanes<StateType, 4>(numSamples, c, lanes, states, vsa); break;
+        case 5: processLanes<StateType, 5>(numSamples, c, lanes, states, vsa); break;
+        case 6: processLanes<StateType, 6>(numSamples, c, lanes, states, vsa); break;
+        case 7: processLanes<StateType, 7>(numSamples, c, lanes, states, vsa); break;
+        default: processLanes<StateType, Lanes>(numSamples, c, lanes, states, vsa); break;
+    }
+}
+
+void MultichannelCascade::processFadeLanes(int numLanes, int numSamples, const ChannelGroup& group,
+                                           float* const* lanes, const int* channels)
+{
+    const Coefficients& from = m_coefficients[group.coefficients];
+    const Coefficients& to = m_coefficients[group.fadeCoefficients];
+
+    float fadeBuffer[Lanes][FadeChunkSize];
+    float* chunkLanes[Lanes];
+    float* fadeLanes[Lanes];
+    double* states[Lanes];
+    double* fadeStates[Lanes];
+
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        states[lane] = &m_state[channels[lane] * MaxStages * 2];
+        fadeStates[lane] = &m_fadeState[channels[lane] * MaxStages * 2];
+        fadeLanes[lane] = fadeBuffer[lane];
+    }
+
+    // the chunks have an even size, so the anti-denormal signal keeps its phase
+    for (int offset = 0; offset < numSamples; offset += FadeChunkSize)
+    {
+        const int chunkSize = std::min(int(FadeChunkSize), numSamples - offset);
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            chunkLanes[lane] = lanes[lane] + offset;
+            std::copy(chunkLanes[lane], chunkLanes[lane] + chunkSize, fadeBuffer[lane]);
+        }
+
+        processGroupLanes(numLanes, chunkSize, from, chunkLanes, states);
+        processGroupLanes(numLanes, chunkSize, to, fadeLanes, fadeStates);
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const int channel = channels[lane];
+            const double step = 1. / m_fadeLength[channel];
+            double gain = m_fadePosition[channel] * step;
+
+            for (int n = 0; n < chunkSize; ++n)
+            {
+                gain = std::min(1., gain + step);
+                chunkLanes[lane][n] += static_cast<float>(gain * (fadeBuffer[lane][n] - chunkLanes[lane][n]));
+            }
+
+            m_fadePosition[channel] += chunkSize;
+        }
+    }
+}
+
+template <typename StateType, int NumLanes>
+void MultichannelCascade::processLanes(int numSamples, const Coefficients& c,
+                                       float* const* lanes, double* const* states, StateType vsa) const
+{
+    StateType v1[MaxStages][NumLanes];
+    StateType v2[MaxStages][NumLanes];
+
+    for (int s = 0; s < c.numStages; ++s)
+    {
+        for (int lane = 0; lane < NumLanes; ++lane)
+        {
+            v1[s][lane] = static_cast<StateType>(states[lane][2 * s]);
+            v2[s][lane] = static_cast<StateType>(states[lane][2 * s + 1]);
+        }
+    }
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        vsa = -vsa;
+
+        StateType x[NumLanes];
+        for (int lane = 0; lane < NumLanes; ++lane)
+            x[lane] = lanes[lane][n];
+
+        for (int s = 0; s < c.numStages; ++s)
+        {
+            const StateType a1 = static_cast<StateType>(c.a1[s]);
+            const StateType a2 = static_cast<StateType>(c.a2[s]);
+            const StateType b0 = static_cast<StateType>(c.b0[s]);
+            const StateType b1 = static_cast<StateType>(c.b1[s]);
+            const StateType b2 = static_cast<StateType>(c.b2[s]);
+            const StateType ac = (s == 0) ? vsa : 0;
+
+            for (int lane = 0; lane < NumLanes; ++lane)
+            {
+                const StateType w = x[lane] - a1 * v1[s][lane] - a2 * v2[s][lane] + ac;
+                x[lane] = b0 * w + b1 * v1[s][lane] + b2 * v2[s][lane];
+                v2[s][lane] = v1[s][lane];
+                v1[s][lane] = w;
+            }
+        }
+
+        for (int lane = 0; lane < NumLanes; ++lane)
+            lanes[lane][n] = static_cast<float>(x[lane]);
+    }
+
+    for (int s = 0; s < c.numStages; ++s)
+    {
+        for (int lane = 0; lane < NumLanes; ++lane)
+        {
+            states[lane][2 * s] = v1[s][lane];
+            states[lane][2 * s + 1] = v2[s][lane];
+        }
+    }
+}
+
+}
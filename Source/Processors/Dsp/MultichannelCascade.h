@@ -0,0 +1,185 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_MULTICHANNELCASCADE_H
+#define DSPFILTERS_MULTICHANNELCASCADE_H
+
+#include "Common.h"
+#include "Cascade.h"
+
+namespace Dsp
+{
+
+/*
+ * Runs Direct Form II cascades over many channels at once.
+ *
+ * Channels given identical coefficients share a single copy of them, and
+ * are processed in groups of Lanes channels in lockstep, so the inner loop
+ * runs across channels and can be vectorized. The state of each channel is
+ * kept separately, so channels can change coefficients or be bypassed
+ * without disturbing the others.
+ *
+ * New coefficients can be crossfaded in: both filters run side by side
+ * for the length of the fade, and the output moves linearly from the old
+ * filter to the new one, so live changes don't cause clicks. Once the
+ * channels are set up, changing coefficients doesn't allocate memory, so
+ * it can be done on the audio thread between blocks.
+ *
+ * The filters run with double precision state by default. Single precision
+ * runs twice as many channels per vector instruction, and is accurate
+ * enough when the poles are well away from z = 1, i.e. for cutoffs that
+ * are not tiny fractions of the sample rate.
+ *
+ */
+class PLUGIN_API MultichannelCascade
+{
+public:
+    enum
+    {
+        Lanes = 8,
+        MaxStages = 16
+    };
+
+    enum Precision
+    {
+        DoublePrecision,
+        SinglePrecision
+    };
+
+    // The coefficients of a cascade, in a fixed size structure that can be
+    // designed on another thread and passed to the audio thread by value
+    struct Coefficients
+    {
+        int numStages;
+        double a1[MaxStages];
+        double a2[MaxStages];
+        double b0[MaxStages];
+        double b1[MaxStages];
+        double b2[MaxStages];
+
+        void setCascade(const Cascade& cascade);
+        bool hasSameStages(const Coefficients& other) const;
+    };
+
+    MultichannelCascade();
+
+    void setNumChannels(int numChannels);
+
+    int getNumChannels() const
+    {
+        return static_cast<int>(m_channelCoefficients.size());
+    }
+
+    // Copies the coefficients of a designed cascade for one channel
+    void setChannelCascade(int channel, const Cascade& cascade);
+
+    // Sets the coefficients of one channel, crossfading from its current
+    // filter over fadeSamples samples if the channel is already filtering
+    void setChannelCoefficients(int channel, const Coefficients& coefficients,
+                                int fadeSamples = 0);
+
+    // Disabled channels are left untouched by process()
+    void setChannelEnabled(int channel, bool enabled);
+
+    // The state is kept in double precision between blocks, so this can be
+    // changed at any point without a transient
+    void setPrecision(Precision precision);
+
+    Precision getPrecision() const
+    {
+        return m_precision;
+    }
+
+    // The anti-denormal signal can be turned off when the processing threads
+    // flush denormals to zero, as with FloatVectorOperations::disableDenormalisedNumberSupport()
+    void setDenormalPrevention(bool shouldPrevent);
+
+    void reset();
+
+    // Filters a block of samples in place, one array per channel
+    void process(int numSamples, float* const* arrayOfChannels);
+
+    // To split a block across threads, call prepareToProcess() once, then
+    // processChannels() for disjoint channel ranges, concurrently if needed
+    void prepareToProcess(int numSamples);
+    void processChannels(int numSamples, float* const* arrayOfChannels,
+                         int startChannel, int endChannel);
+
+private:
+    enum
+    {
+        FadeChunkSize = 64
+    };
+
+    struct SharedCoefficients : Coefficients
+    {
+        int numChannels;
+    };
+
+    // Channels with the same coefficients, and fading to the same ones, as a
+    // range of m_groupChannels
+    struct ChannelGroup
+    {
+        int coefficients;
+        int fadeCoefficients;
+        int begin;
+        int end;
+    };
+
+    int acquireCoefficients(const Coefficients& coefficients);
+    void releaseCoefficients(int index);
+    void finishFade(int channel);
+    void cancelFade(int channel);
+    void updateGroups();
+    void processGroupLanes(int numLanes, int numSamples, const Coefficients& c,
+                           float* const* lanes, double* const* states) const;
+    void processFadeLanes(int numLanes, int numSamples, const ChannelGroup& group,
+                          float* const* lanes, const int* channels);
+    template <typename StateType>
+    void processLanesOfType(int numLanes, int numSamples, const Coefficients& c,
+                            float* const* lanes, double* const* states) const;
+    template <typename StateType, int NumLanes>
+    void processLanes(int numSamples, const Coefficients& c,
+                      float* const* lanes, double* const* states, StateType vsa) const;
+
+    std::vector<SharedCoefficients> m_coefficients;
+    std::vector<int> m_channelCoefficients;
+    std::vector<int> m_fadeCoefficients;
+    std::vector<int> m_fadePosition;
+    std::vector<int> m_fadeLength;
+    std::vector<bool> m_channelEnabled;
+    std::vector<double> m_state;
+    std::vector<double> m_fadeState;
+    std::vector<ChannelGroup> m_groups;
+    std::vector<int> m_groupChannels;
+    int m_numFading;
+    Precision m_precision;
+    bool m_groupsChanged;
+    bool m_denormalPrevention;
+    double m_vsa;
+    double m_blockVsa;
+};
+
+}
+
+#endif
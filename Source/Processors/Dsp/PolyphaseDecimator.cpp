@@ -0,0 +1,160 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "PolyphaseDecimator.h"
+#include "MathSupplement.h"
+
+#include <algorithm>
+
+namespace Dsp
+{
+
+PolyphaseDecimator::PolyphaseDecimator()
+    : m_numChannels(0)
+    , m_factor(1)
+    , m_numTaps(1)
+    , m_phase(0)
+    , m_taps(1, 1.0f)
+{
+}
+
+std::vector<float> PolyphaseDecimator::designLowPass(int numTaps, double cutoff)
+{
+    numTaps = std::max(1, numTaps | 1);
+
+    const double center = (numTaps - 1) / 2.;
+
+    std::vector<double> h(numTaps);
+    double sum = 0;
+    for (int n = 0; n < numTaps; ++n)
+    {
+        const double t = n - center;
+        double v;
+        if (t == 0)
+            v = 2 * cutoff;
+        else
+            v = std::sin(2 * doublePi * cutoff * t) / (doublePi * t);
+
+        const double window = numTaps > 1 ? 0.54 - 0.46 * std::cos(2 * doublePi * n / (numTaps - 1)) : 1.;
+        h[n] = v * window;
+        sum += h[n];
+    }
+
+    const double scale = sum != 0 ? 1. / sum : 1.;
+
+    std::vector<float> taps(numTaps);
+    for (int n = 0; n < numTaps; ++n)
+        taps[n] = static_cast<float>(h[n] * scale);
+
+    return taps;
+}
+
+void PolyphaseDecimator::setup(int numChannels, int factor, const std::vector<float>& taps)
+{
+    assert(factor > 0 && !taps.empty());
+
+    m_numChannels = numChannels;
+    m_factor = factor;
+    m_numTaps = static_cast<int>(taps.size());
+
+    // reversed, so the dot products run forward in time
+    m_taps.assign(taps.rbegin(), taps.rend());
+
+    const int numGroups = (numChannels + Lanes - 1) / Lanes;
+    m_history.assign(numGroups * (m_numTaps - 1) * Lanes, 0.0f);
+
+    reset();
+}
+
+void PolyphaseDecimator::setPhase(int phase)
+{
+    m_phase = ((phase % m_factor) + m_factor) % m_factor;
+}
+
+void PolyphaseDecimator::reset()
+{
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_phase = 0;
+}
+
+int PolyphaseDecimator::getNumOutputSamples(int numSamples) const
+{
+    return numSamples > m_phase ? (numSamples - m_phase - 1) / m_factor + 1 : 0;
+}
+
+int PolyphaseDecimator::process(int numSamples, const float* const* input, float* const* output)
+{
+    const int historySize = m_numTaps - 1;
+    const int numOutputs = getNumOutputSamples(numSamples);
+
+    const size_t workSize = static_cast<size_t>(historySize + numSamples) * Lanes;
+    if (m_work.size() < workSize)
+        m_work.resize(workSize);
+
+    float* const work = m_work.data();
+    const float* const taps = m_taps.data();
+
+    for (int first = 0; first < m_numChannels; first += Lanes)
+    {
+        const int numLanes = std::min(int(Lanes), m_numChannels - first);
+        float* const history = m_history.data() + (first / Lanes) * historySize * Lanes;
+
+        // interleave the channels after the end of the previous block
+        std::copy(history, history + historySize * Lanes, work);
+
+        float* dest = work + historySize * Lanes;
+        for (int i = 0; i < numSamples; ++i, dest += Lanes)
+        {
+            for (int l = 0; l < numLanes; ++l)
+                dest[l] = input[first + l][i];
+            for (int l = numLanes; l < Lanes; ++l)
+                dest[l] = 0;
+        }
+
+        for (int k = 0; k < numOutputs; ++k)
+        {
+            // the kernel covers the historySize samples before the kept one
+            const float* x = work + (m_phase + k * m_factor) * Lanes;
+
+            float acc[Lanes] = { 0 };
+            for (int t = 0; t < m_numTaps; ++t, x += Lanes)
+            {
+                const float tap = taps[t];
+                for (int l = 0; l < Lanes; ++l)
+                    acc[l] += tap * x[l];
+            }
+
+            for (int l = 0; l < numLanes; ++l)
+                output[first + l][k] = acc[l];
+        }
+
+        std::copy(work + numSamples * Lanes, work + workSize, history);
+    }
+
+    m_phase += numOutputs * m_factor - numSamples;
+
+    return numOutputs;
+}
+
+}
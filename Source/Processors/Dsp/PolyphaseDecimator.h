@@ -0,0 +1,106 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_POLYPHASEDECIMATOR_H
+#define DSPFILTERS_POLYPHASEDECIMATOR_H
+
+#include "Common.h"
+
+namespace Dsp
+{
+
+/*
+ * Low pass filters and downsamples many channels by an integer factor.
+ *
+ * Only the samples that are kept are computed, each as a dot product of
+ * the FIR kernel with the latest input samples, so the cost per input
+ * sample is numTaps / factor. Channels are processed in groups of Lanes
+ * channels in lockstep, so the inner loop runs across channels and can be
+ * vectorized. All channels share the kernel and the decimation phase, so
+ * they must receive the same number of samples in each block.
+ *
+ */
+class PLUGIN_API PolyphaseDecimator
+{
+public:
+    enum
+    {
+        Lanes = 8
+    };
+
+    PolyphaseDecimator();
+
+    // Windowed-sinc (Hamming) low pass design with unity gain at DC. The cutoff
+    // is relative to the input sample rate. numTaps is made odd, so the group
+    // delay is a whole number of samples.
+    static std::vector<float> designLowPass(int numTaps, double cutoff);
+
+    // Keeps one sample out of every factor samples. The kernel taps are copied.
+    void setup(int numChannels, int factor, const std::vector<float>& taps);
+
+    int getNumChannels() const
+    {
+        return m_numChannels;
+    }
+
+    int getFactor() const
+    {
+        return m_factor;
+    }
+
+    // Group delay of the kernel, in input samples
+    int getLatency() const
+    {
+        return (m_numTaps - 1) / 2;
+    }
+
+    // Number of input samples to skip before the next kept sample
+    void setPhase(int phase);
+
+    int getPhase() const
+    {
+        return m_phase;
+    }
+
+    void reset();
+
+    // Number of samples the next process() call returns for a block of numSamples
+    int getNumOutputSamples(int numSamples) const;
+
+    // Downsamples a block, one array per channel. The output arrays can be the
+    // input arrays. Returns the number of output samples.
+    int process(int numSamples, const float* const* input, float* const* output);
+
+private:
+    int m_numChannels;
+    int m_factor;
+    int m_numTaps;
+    int m_phase;
+    std::vector<float> m_taps;
+    std::vector<float> m_history;
+    std::vector<float> m_work;
+};
+
+}
+
+#endif
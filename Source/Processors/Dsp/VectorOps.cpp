@@ -0,0 +1,365 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Common.h"
+#include "VectorOps.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define DSP_VECTOROPS_X86_DISPATCH 1
+#  define DSP_VECTOROPS_INLINE inline __attribute__((always_inline))
+#else
+#  define DSP_VECTOROPS_X86_DISPATCH 0
+#  define DSP_VECTOROPS_INLINE inline
+#endif
+
+namespace Dsp
+{
+
+namespace VectorOps
+{
+
+namespace
+{
+
+enum
+{
+    Width = 16,           // independent accumulators, enough for an AVX-512 register
+    SumBlockSize = 4096   // samples summed in single precision before adding to the total
+};
+
+// The generic kernels. They are inlined into each of the dispatched
+// versions below, so each one is compiled for its own instruction set.
+
+DSP_VECTOROPS_INLINE void gainAndOffsetKernel(float* dest, const float* src, float gain, float offset, int num)
+{
+    for (int i = 0; i < num; ++i)
+        dest[i] = src[i] * gain + offset;
+}
+
+template <bool Squared>
+DSP_VECTOROPS_INLINE double sumKernel(const float* src, int num)
+{
+    double total = 0;
+
+    for (int start = 0; start < num; start += SumBlockSize)
+    {
+        const int end = std::min(num, start + SumBlockSize);
+
+        float acc[Width] = { 0 };
+        int i = start;
+        for (; i + Width <= end; i += Width)
+        {
+            for (int l = 0; l < Width; ++l)
+                acc[l] += Squared ? src[i + l] * src[i + l] : src[i + l];
+        }
+
+        for (; i < end; ++i)
+            acc[0] += Squared ? src[i] * src[i] : src[i];
+
+        float blockTotal = 0;
+        for (int l = 0; l < Width; ++l)
+            blockTotal += acc[l];
+
+        total += blockTotal;
+    }
+
+    return total;
+}
+
+DSP_VECTOROPS_INLINE float squaredDistanceKernel(const float* a, const float* b, int num)
+{
+    float acc[Width] = { 0 };
+    int i = 0;
+    for (; i + Width <= num; i += Width)
+    {
+        for (int l = 0; l < Width; ++l)
+        {
+            const float d = a[i + l] - b[i + l];
+            acc[l] += d * d;
+        }
+    }
+
+    for (; i < num; ++i)
+    {
+        const float d = a[i] - b[i];
+        acc[0] += d * d;
+    }
+
+    float total = 0;
+    for (int l = 0; l < Width; ++l)
+        total += acc[l];
+
+    return total;
+}
+
+template <bool Above>
+DSP_VECTOROPS_INLINE int findFirstKernel(const float* src, int num, float threshold)
+{
+    int i = 0;
+
+    // test whole vectors at once, and only look for the sample in the one that has it
+    for (; i + Width <= num; i += Width)
+    {
+        int found = 0;
+        for (int l = 0; l < Width; ++l)
+            found |= Above ? (src[i + l] > threshold) : (src[i + l] < threshold);
+
+        if (found)
+            break;
+    }
+
+    for (; i < num; ++i)
+    {
+        if (Above ? (src[i] > threshold) : (src[i] < threshold))
+            return i;
+    }
+
+    return num;
+}
+
+template <bool Above>
+DSP_VECTOROPS_INLINE void markKernel(const float* src, int num, float threshold, juce::uint32* mask)
+{
+    int i = 0;
+
+    for (; i + 32 <= num; i += 32)
+    {
+        juce::uint32 bits = 0;
+        for (int l = 0; l < 32; ++l)
+            bits |= juce::uint32(Above ? (src[i + l] > threshold) : (src[i + l] < threshold)) << l;
+
+        mask[i / 32] |= bits;
+    }
+
+    for (; i < num; ++i)
+    {
+        if (Above ? (src[i] > threshold) : (src[i] < threshold))
+            mask[i / 32] |= juce::uint32(1) << (i % 32);
+    }
+}
+
+DSP_VECTOROPS_INLINE juce::uint32 quarterOf(float sample, float previous)
+{
+    // the four cases exclude each other
+    return juce::uint32((sample < previous) & (sample > 0.0f))
+         | juce::uint32((sample < 0.0f) & (previous >= 0.0f)) * 2
+         | juce::uint32((sample > previous) & (sample < 0.0f)) * 3
+         | juce::uint32((sample > 0.0f) & (previous <= 0.0f)) * 4;
+}
+
+DSP_VECTOROPS_INLINE void markQuarterKernel(const float* src, int num, float previous, int quarter,
+                                            juce::uint32* mask, juce::uint32* otherMask)
+{
+    const juce::uint32 target = juce::uint32(quarter);
+
+    // the first word compares its first sample with the previous block
+    int i = 0;
+
+    for (; i < num && i < 32; ++i)
+    {
+        const juce::uint32 q = quarterOf(src[i], i > 0 ? src[i - 1] : previous);
+        mask[0] |= juce::uint32(q == target) << i;
+        otherMask[0] |= juce::uint32((q != 0) & (q != target)) << i;
+    }
+
+    for (; i + 32 <= num; i += 32)
+    {
+        juce::uint32 bits = 0;
+        juce::uint32 otherBits = 0;
+
+        for (int l = 0; l < 32; ++l)
+        {
+            const juce::uint32 q = quarterOf(src[i + l], src[i + l - 1]);
+            bits |= juce::uint32(q == target) << l;
+            otherBits |= juce::uint32((q != 0) & (q != target)) << l;
+        }
+
+        mask[i / 32] |= bits;
+        otherMask[i / 32] |= otherBits;
+    }
+
+    for (; i < num; ++i)
+    {
+        const juce::uint32 q = quarterOf(src[i], src[i - 1]);
+        mask[i / 32] |= juce::uint32(q == target) << (i % 32);
+        otherMask[i / 32] |= juce::uint32((q != 0) & (q != target)) << (i % 32);
+    }
+}
+
+inline int findLowestSetBit(juce::uint32 bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return int(index);
+#else
+    int index = 0;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+struct Kernels
+{
+    void (*gainAndOffset)(float*, const float*, float, float, int);
+    double (*sum)(const float*, int);
+    double (*sumOfSquares)(const float*, int);
+    float (*squaredDistance)(const float*, const float*, int);
+    int (*findFirstAbove)(const float*, int, float);
+    int (*findFirstBelow)(const float*, int, float);
+    void (*markAbove)(const float*, int, float, juce::uint32*);
+    void (*markBelow)(const float*, int, float, juce::uint32*);
+    void (*markQuarter)(const float*, int, float, int, juce::uint32*, juce::uint32*);
+};
+
+#define DSP_VECTOROPS_DEFINE_KERNELS(suffix, attributes) \
+    attributes void gainAndOffset##suffix(float* dest, const float* src, float gain, float offset, int num) \
+        { gainAndOffsetKernel(dest, src, gain, offset, num); } \
+    attributes double sum##suffix(const float* src, int num) \
+        { return sumKernel<false>(src, num); } \
+    attributes double sumOfSquares##suffix(const float* src, int num) \
+        { return sumKernel<true>(src, num); } \
+    attributes float squaredDistance##suffix(const float* a, const float* b, int num) \
+        { return squaredDistanceKernel(a, b, num); } \
+    attributes int findFirstAbove##suffix(const float* src, int num, float threshold) \
+        { return findFirstKernel<true>(src, num, threshold); } \
+    attributes int findFirstBelow##suffix(const float* src, int num, float threshold) \
+        { return findFirstKernel<false>(src, num, threshold); } \
+    attributes void markAbove##suffix(const float* src, int num, float threshold, juce::uint32* mask) \
+        { markKernel<true>(src, num, threshold, mask); } \
+    attributes void markBelow##suffix(const float* src, int num, float threshold, juce::uint32* mask) \
+        { markKernel<false>(src, num, threshold, mask); } \
+    attributes void markQuarter##suffix(const float* src, int num, float previous, int quarter, \
+                                        juce::uint32* mask, juce::uint32* otherMask) \
+        { markQuarterKernel(src, num, previous, quarter, mask, otherMask); } \
+    const Kernels kernels##suffix = { gainAndOffset##suffix, sum##suffix, sumOfSquares##suffix, \
+                                      squaredDistance##suffix, \
+                                      findFirstAbove##suffix, findFirstBelow##suffix, \
+                                      markAbove##suffix, markBelow##suffix, markQuarter##suffix };
+
+DSP_VECTOROPS_DEFINE_KERNELS(Generic, )
+
+#if DSP_VECTOROPS_X86_DISPATCH
+DSP_VECTOROPS_DEFINE_KERNELS(Avx2, __attribute__((target("avx2,fma"))))
+DSP_VECTOROPS_DEFINE_KERNELS(Avx512, __attribute__((target("avx512f"))))
+#endif
+
+const Kernels& getKernels()
+{
+    static const Kernels* const kernels = []
+    {
+#if DSP_VECTOROPS_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return &kernelsAvx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return &kernelsAvx2;
+#endif
+        return &kernelsGeneric;
+    }();
+
+    return *kernels;
+}
+
+}
+
+void gainAndOffset(float* dest, const float* src, float gain, float offset, int num)
+{
+    getKernels().gainAndOffset(dest, src, gain, offset, num);
+}
+
+double sum(const float* src, int num)
+{
+    return getKernels().sum(src, num);
+}
+
+double sumOfSquares(const float* src, int num)
+{
+    return getKernels().sumOfSquares(src, num);
+}
+
+float squaredDistance(const float* a, const float* b, int num)
+{
+    return getKernels().squaredDistance(a, b, num);
+}
+
+int findFirstAbove(const float* src, int num, float threshold)
+{
+    return getKernels().findFirstAbove(src, num, threshold);
+}
+
+int findFirstBelow(const float* src, int num, float threshold)
+{
+    return getKernels().findFirstBelow(src, num, threshold);
+}
+
+void markAbove(const float* src, int num, float threshold, juce::uint32* mask)
+{
+    getKernels().markAbove(src, num, threshold, mask);
+}
+
+void markBelow(const float* src, int num, float threshold, juce::uint32* mask)
+{
+    getKernels().markBelow(src, num, threshold, mask);
+}
+
+void markQuarter(const float* src, int num, float previous, int quarter,
+                 juce::uint32* mask, juce::uint32* otherMask)
+{
+    getKernels().markQuarter(src, num, previous, quarter, mask, otherMask);
+}
+
+int findNextMarked(const juce::uint32* mask, int start, int num)
+{
+    if (start >= num)
+        return num;
+
+    int word = start / 32;
+    juce::uint32 bits = mask[word] & (~juce::uint32(0) << (start % 32));
+
+    while (bits == 0)
+    {
+        if (++word * 32 >= num)
+            return num;
+
+        bits = mask[word];
+    }
+
+    return std::min(num, word * 32 + findLowestSetBit(bits));
+}
+
+}
+
+}
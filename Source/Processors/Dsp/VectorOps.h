@@ -0,0 +1,104 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DSPFILTERS_VECTOROPS_H
+#define DSPFILTERS_VECTOROPS_H
+
+#include "Common.h"
+
+namespace Dsp
+{
+
+/*
+ * Elementwise kernels shared by the simple processors.
+ *
+ * The operations juce::FloatVectorOperations already has SSE and NEON
+ * versions of are forwarded to it. The others have a generic version,
+ * written so the compiler can vectorize it, and on x86 builds with GCC or
+ * Clang also AVX2 and AVX-512 versions, chosen at run time from the CPU.
+ * All of them can work in place.
+ *
+ */
+namespace VectorOps
+{
+
+inline void abs(float* dest, const float* src, int num)
+{
+    juce::FloatVectorOperations::abs(dest, src, num);
+}
+
+inline void clip(float* dest, const float* src, float low, float high, int num)
+{
+    juce::FloatVectorOperations::clip(dest, src, low, high, num);
+}
+
+inline void gain(float* dest, const float* src, float gain, int num)
+{
+    juce::FloatVectorOperations::multiply(dest, src, gain, num);
+}
+
+inline void offset(float* dest, float amount, int num)
+{
+    juce::FloatVectorOperations::add(dest, amount, num);
+}
+
+// dest = src * gain + offset, in a single pass
+PLUGIN_API void gainAndOffset(float* dest, const float* src, float gain, float offset, int num);
+
+// Accumulated in double precision every few thousand samples
+PLUGIN_API double sum(const float* src, int num);
+PLUGIN_API double sumOfSquares(const float* src, int num);
+
+// Sum of the squared differences of two vectors, e.g. the distance of a spike
+// waveform to a template. Meant for short vectors: it is accumulated in single
+// precision.
+PLUGIN_API float squaredDistance(const float* a, const float* b, int num);
+
+// Index of the first sample above (or below) the threshold, or num if
+// there is none: a quick way to skip the quiet parts of a signal before
+// looking at threshold crossings sample by sample
+PLUGIN_API int findFirstAbove(const float* src, int num, float threshold);
+PLUGIN_API int findFirstBelow(const float* src, int num, float threshold);
+
+// Sets bit (i % 32) of mask[i / 32] for every sample i above (or below) the
+// threshold, leaving the other bits as they are, so the crossings of several
+// channels can be combined into one mask. The mask has (num + 31) / 32 words.
+PLUGIN_API void markAbove(const float* src, int num, float threshold, juce::uint32* mask);
+PLUGIN_API void markBelow(const float* src, int num, float threshold, juce::uint32* mask);
+
+// Sorts every sample into the quarter of a cycle it is in, judged against the
+// sample before it (previous for the first one): 1 falling above zero, 2 crossing
+// zero downwards, 3 rising below zero, 4 crossing zero upwards, or none of them.
+// Sets bit (i % 32) of mask[i / 32] for every sample i in the given quarter, and
+// of otherMask for every sample in another one, leaving the other bits as they are.
+PLUGIN_API void markQuarter(const float* src, int num, float previous, int quarter,
+                            juce::uint32* mask, juce::uint32* otherMask);
+
+// Index of the first set bit of a mask from start, or num if there is none
+PLUGIN_API int findNextMarked(const juce::uint32* mask, int start, int num);
+
+}
+
+}
+
+#endif
@@ -43,8 +43,11 @@ static const int DURATION_ANIMATION_COLLAPSE_MS = 200;
 
 ChannelSelector::ChannelSelector(bool createButtons, Font& titleFont_) :
     eventsOnly(false)
+    , parameterChannels              (PARAMETER, titleFont_)
     , parameterSlicerChannelSelector (Channels::PARAM_CHANNELS,  "Parameter slicer channel selector component")
+    , audioChannels                  (AUDIO, titleFont_)
     , audioSlicerChannelSelector     (Channels::AUDIO_CHANNELS,  "Audio slicer channel selector component")
+    , recordChannels                 (RECORD, titleFont_)
     , recordSlicerChannelSelector    (Channels::RECORD_CHANNELS, "Record slicer channel selector component")
     , paramsToggled(true), paramsActive(true), recActive(true), radioStatus(false), isNotSink(createButtons)
     , moveRight(false), moveLeft(false), offsetLR(0), offsetUD(0), desiredOffset(0), titleFont(titleFont_), acquisitionIsActive(false)
@@ -82,29 +85,15 @@ ChannelSelector::ChannelSelector(bool createButtons, Font& titleFont_) :
     noneButton->addListener(this);
     addAndMakeVisible(noneButton);
 
-    // Buttons managers
+    // Channel grids
     // ====================================================================
-    addAndMakeVisible (audioButtonsManager);
-    //addAndMakeVisible (recordButtonsManager);
-    addAndMakeVisible (parameterButtonsManager);
-
-    // Enable fast mode selection for buttons
-    audioButtonsManager.setFastSelectionModeEnabled     (true);
-    recordButtonsManager.setFastSelectionModeEnabled    (true);
-    parameterButtonsManager.setFastSelectionModeEnabled (true);
-
-    audioButtonsManager.setMinPaddingBetweenButtons     (0);
-    recordButtonsManager.setMinPaddingBetweenButtons    (0);
-    parameterButtonsManager.setMinPaddingBetweenButtons (0);
-
-    audioButtonsManager.setColour       (ButtonGroupManager::outlineColourId, Colour (0x0));
-    recordButtonsManager.setColour      (ButtonGroupManager::outlineColourId, Colour (0x0));
-    parameterButtonsManager.setColour   (ButtonGroupManager::outlineColourId, Colour (0x0));
-
-    // Register listeners for buttons
-    audioButtonsManager.setButtonListener      (this);
-    recordButtonsManager.setButtonListener     (this);
-    parameterButtonsManager.setButtonListener  (this);
+    addAndMakeVisible (audioChannels);
+    //addAndMakeVisible (recordChannels);
+    addAndMakeVisible (parameterChannels);
+
+    audioChannels.setListener       (this);
+    recordChannels.setListener      (this);
+    parameterChannels.setListener   (this);
     // ====================================================================
 
     // Slicer channels selectors
@@ -135,13 +124,13 @@ ChannelSelector::ChannelSelector(bool createButtons, Font& titleFont_) :
 
 ChannelSelector::~ChannelSelector()
 {
-    // Just a temporary workaround as we don't want to delete these buttons managers by hands.
+    // Just a temporary workaround as we don't want to delete these channel grids by hands.
     // We will remove it after getting rid of the ugly calling of deleteAllChildren() method.
     // We should really use some RAII technuiqes to avoid calling this method.
     // TODO: refactor the code to follow RAII best principles and to avoid using raw pointers after merge with priyanjitdey94
-    removeChildComponent (&audioButtonsManager);
-    removeChildComponent (&recordButtonsManager);
-    removeChildComponent (&parameterButtonsManager);
+    removeChildComponent (&audioChannels);
+    removeChildComponent (&recordChannels);
+    removeChildComponent (&parameterChannels);
 
     removeChildComponent (&audioSlicerChannelSelector);
     removeChildComponent (&recordSlicerChannelSelector);
@@ -174,36 +163,26 @@ void ChannelSelector::paint(Graphics& g)
 
 void ChannelSelector::setNumChannels(int numChans)
 {
-    int difference = numChans - parameterButtonsManager.getNumButtons();
+LOGDD(numChans - parameterChannels.getNumChannels(), " channels needed.");
 
-LOGDD(difference, " buttons needed.");
+    parameterChannels.setNumChannels (numChans, paramsToggled);
 
-    if (difference > 0)
-    {
-        for (int n = 0; n < difference; n++)
-        {
-            addButton();
-        }
-    }
-    else if (difference < 0)
+    if (isNotSink)
     {
-        for (int n = 0; n < -difference; n++)
-        {
-            removeButton();
-        }
+        recordChannels.setNumChannels (numChans, false);
+        audioChannels.setNumChannels  (numChans, false);
     }
 
-    const int numButtons = parameterButtonsManager.getNumButtons();
     //Reassign numbers according to the actual channels (useful for channel mapper)
-    for (int n = 0; n < numButtons; ++n)
+    for (int n = 0; n < numChans; ++n)
     {
         int num = ( (GenericEditor*)getParentComponent())->getChannelDisplayNumber (n);
-        static_cast<ChannelSelectorButton*> (parameterButtonsManager.getButtonAt  (n))->setChannel (n + 1, num + 1);
+        parameterChannels.setDisplayNumber (n, num + 1);
 
         if (isNotSink)
         {
-            static_cast<ChannelSelectorButton*> (recordButtonsManager.getButtonAt (n))->setChannel (n + 1, num + 1);
-            static_cast<ChannelSelectorButton*> (audioButtonsManager.getButtonAt  (n))->setChannel (n + 1, num + 1);
+            recordChannels.setDisplayNumber (n, num + 1);
+            audioChannels.setDisplayNumber  (n, num + 1);
         }
     }
 
@@ -212,12 +191,12 @@ LOGDD(difference, " buttons needed.");
 
 int ChannelSelector::getNumChannels()
 {
-    return parameterButtonsManager.getNumButtons();
+    return parameterChannels.getNumChannels();
 }
 
 void ChannelSelector::shiftChannelsVertical(float amount)
 {
-    if (parameterButtonsManager.getNumButtons() > 16)
+    if (parameterChannels.getNumChannels() > 16)
     {
         offsetUD -= amount * 10;
         offsetUD = jmin(offsetUD, 0.0f);
@@ -234,9 +213,9 @@ void ChannelSelector::refreshButtonBoundaries()
     const int columnWidth   = getDesiredWidth() / (numColumnsGreaterThan100 + 1) + 1;
     const int rowHeight     = 14;
 
-    audioButtonsManager.setButtonSize      (columnWidth, rowHeight);
-    recordButtonsManager.setButtonSize     (columnWidth, rowHeight);
-    parameterButtonsManager.setButtonSize  (columnWidth, rowHeight);
+    audioChannels.setCellSize      (columnWidth, rowHeight);
+    recordChannels.setCellSize     (columnWidth, rowHeight);
+    parameterChannels.setCellSize  (columnWidth, rowHeight);
 
     const int xLoc = offsetLR + 3;
 
@@ -253,30 +232,30 @@ void ChannelSelector::refreshButtonBoundaries()
                                           .withY (audioSlicerChannelSelector.getY())
                                           .withHeight (audioSlicerChannelSelector.getHeight()));
 
-    // Set bounds for buttons managers
+    // Set bounds for channel grids
     // ===================================================================================================
-    const int headerHeight              = 25;
-    const int tabButtonHeight           = 15;
-    const int buttonsManagerWidth       = getDesiredWidth() - 6;
-    const int defaultButtonsManagerY    = headerHeight;
+    const int headerHeight          = 25;
+    const int tabButtonHeight       = 15;
+    const int channelGridWidth      = getDesiredWidth() - 6;
+    const int defaultChannelGridY   = headerHeight;
 
     // We will use just some hacks to set initial y and height if height is zero,
-    // otherwise we will use the same bounds for buttons maangers
-    int buttonsManagerX = xLoc;
-    parameterButtonsManager.setBounds   (buttonsManagerX,
-                                         parameterButtonsManager.getHeight() == 0 ? defaultButtonsManagerY : parameterButtonsManager.getY(),
-                                         buttonsManagerWidth,
-                                         getHeight() - parameterButtonsManager.getY() - tabButtonHeight);
-    buttonsManagerX -= getDesiredWidth();
-    recordButtonsManager.setBounds      (buttonsManagerX,
-                                         recordButtonsManager.getHeight() == 0 ? defaultButtonsManagerY : recordButtonsManager.getY(),
-                                         buttonsManagerWidth,
-                                         getHeight() - recordButtonsManager.getY() - tabButtonHeight);
-    buttonsManagerX -= getDesiredWidth();
-    audioButtonsManager.setBounds       (buttonsManagerX,
-                                         audioButtonsManager.getHeight() == 0 ? defaultButtonsManagerY : audioButtonsManager.getY(),
-                                         buttonsManagerWidth,
-                                         getHeight() - audioButtonsManager.getY() - tabButtonHeight);
+    // otherwise we will use the same bounds for channel grids
+    int channelGridX = xLoc;
+    parameterChannels.setBounds (channelGridX,
+                                 parameterChannels.getHeight() == 0 ? defaultChannelGridY : parameterChannels.getY(),
+                                 channelGridWidth,
+                                 getHeight() - parameterChannels.getY() - tabButtonHeight);
+    channelGridX -= getDesiredWidth();
+    recordChannels.setBounds    (channelGridX,
+                                 recordChannels.getHeight() == 0 ? defaultChannelGridY : recordChannels.getY(),
+                                 channelGridWidth,
+                                 getHeight() - recordChannels.getY() - tabButtonHeight);
+    channelGridX -= getDesiredWidth();
+    audioChannels.setBounds     (channelGridX,
+                                 audioChannels.getHeight() == 0 ? defaultChannelGridY : audioChannels.getY(),
+                                 channelGridWidth,
+                                 getHeight() - audioChannels.getY() - tabButtonHeight);
     // ===================================================================================================
 
     /*
@@ -326,56 +305,14 @@ LOGDD(desiredOffset - offsetLR);
     refreshButtonBoundaries();
 }
 
-void ChannelSelector::addButton()
-{
-    const int size = parameterButtonsManager.getNumButtons();
-
-    ChannelSelectorButton* b = new ChannelSelectorButton (size + 1, PARAMETER, titleFont);
-    parameterButtonsManager.addButton (b);
-
-    if (paramsToggled)
-        b->setToggleState(true, dontSendNotification);
-    else
-        b->setToggleState(false, dontSendNotification);
-
-    if (!paramsActive)
-        b->setActive(false);
-
-    if (isNotSink)
-    {
-        ChannelSelectorButton* br = new ChannelSelectorButton(size + 1, RECORD, titleFont);
-        recordButtonsManager.addButton (br);
-
-        ChannelSelectorButton* ba = new ChannelSelectorButton(size + 1, AUDIO, titleFont);
-        audioButtonsManager.addButton (ba);
-    }
-}
-
-void ChannelSelector::removeButton()
-{
-    int size = parameterButtonsManager.getNumButtons();
-
-    parameterButtonsManager.removeButton (size - 1);
-
-    if (isNotSink)
-    {
-        recordButtonsManager.removeButton (size - 1);
-        audioButtonsManager.removeButton  (size - 1);
-    }
-}
-
 Array<int> ChannelSelector::getActiveChannels()
 {
     Array<int> a;
 
     if (! eventsOnly)
     {
-        const int numButtons = parameterButtonsManager.getNumButtons();
-        for (int i = 0; i < numButtons; ++i)
-        {
-            if (parameterButtonsManager.getButtonAt (i)->getToggleState())
-                a.add (i);
-        }
+        for (int channel : parameterChannels.getChannelStates())
+            a.add (channel);
     }
     else
     {
@@ -389,71 +326,37 @@ void ChannelSelector::setActiveChannels(Array<int> a)
 {
 LOGDD("Setting active channels!");
 
-    const int numButtons = parameterButtonsManager.getNumButtons();
-    for (int i = 0; i < numButtons; ++i)
-    {
-        parameterButtonsManager.getButtonAt (i)->setToggleState (false, dontSendNotification);
-    }
+    ChannelMask channels (parameterChannels.getNumChannels());
 
     for (int i = 0; i < a.size(); i++)
-    {
-        if (a[i] < numButtons)
-        {
-            parameterButtonsManager.getButtonAt (a[i])->setToggleState (true, dontSendNotification);
-        }
-    }
+        channels.set (a[i], true);
+
+    parameterChannels.setAllChannelStates (false, dontSendNotification);
+    parameterChannels.setChannelStates (channels, true, dontSendNotification);
 }
 
 void ChannelSelector::inactivateButtons()
 {
     paramsActive = false;
-
-    const int numButtons = parameterButtonsManager.getNumButtons();
-    for (int i = 0; i < numButtons; ++i)
-    {
-        const auto& button = static_cast<ChannelSelectorButton*> (parameterButtonsManager.getButtonAt (i));
-        button->setActive (false);
-        button->repaint();
-    }
+    parameterChannels.setActive (false);
 }
 
 void ChannelSelector::activateButtons()
 {
     paramsActive = true;
-
-    const int numButtons = parameterButtonsManager.getNumButtons();
-    for (int i = 0; i < numButtons; ++i)
-    {
-        const auto& button = static_cast<ChannelSelectorButton*> (parameterButtonsManager.getButtonAt (i));
-        button->setActive (true);
-        button->repaint();
-    }
+    parameterChannels.setActive (true);
 }
 
 void ChannelSelector::inactivateRecButtons()
 {
     recActive = false;
-
-    const int numButtons = recordButtonsManager.getNumButtons();
-    for (int i = 0; i < numButtons; ++i)
-    {
-        const auto& button = static_cast<ChannelSelectorButton*> (recordButtonsManager.getButtonAt (i));
-        button->setActive (false);
-        button->repaint();
-    }
+    recordChannels.setActive (false);
 }
 
 void ChannelSelector::activateRecButtons()
 {
     recActive = true;
-
-    const int numButtons = recordButtonsManager.getNumButtons();
-    for (int i = 0; i < numButtons; ++i)
-    {
-        const auto& button = static_cast<ChannelSelectorButton*> (recordButtonsManager.getButtonAt (i));
-        button->setActive (true);
-        button->repaint();
-    }
+    recordChannels.setActive (true);
 }
 
 void ChannelSelector::refreshParameterColors()
@@ -483,63 +386,44 @@ void ChannelSelector::setRadioStatus(bool radioOn)
     {
         radioStatus = radioOn;
 
-        const int numButtons = parameterButtonsManager.getNumButtons();
-        for (int i = 0; i < numButtons; ++i)
-        {
-            parameterButtonsManager.getButtonAt (i)->setToggleState (false, dontSendNotification);
-        }
-
-        parameterButtonsManager.setRadioButtonMode (radioStatus);
+        parameterChannels.setAllChannelStates (false, dontSendNotification);
+        parameterChannels.setRadioMode (radioStatus);
     }
 }
 
 bool ChannelSelector::getParamStatus(int chan)
 {
-    if (chan >= 0 && chan < parameterButtonsManager.getNumButtons())
-        return parameterButtonsManager.getButtonAt (chan)->getToggleState();
-    else
-        return false;
+    return parameterChannels.getChannelState (chan);
 }
 
 bool ChannelSelector::getRecordStatus(int chan)
 {
-    if (chan >= 0 && chan < recordButtonsManager.getNumButtons())
-        return recordButtonsManager.getButtonAt (chan)->getToggleState();
-    else
-        return false;
+    return recordChannels.getChannelState (chan);
 }
 
 bool ChannelSelector::getAudioStatus(int chan)
 {
-    if (chan >= 0 && chan < audioButtonsManager.getNumButtons())
-        return audioButtonsManager.getButtonAt (chan)->getToggleState();
-    else
-        return false;
+    return audioChannels.getChannelState (chan);
 }
 
 void ChannelSelector::setParamStatus(int chan, bool b)
 {
-    if (chan >= 0 && chan < parameterButtonsManager.getNumButtons())
-        parameterButtonsManager.getButtonAt (chan)->setToggleState(b, sendNotification);
+    parameterChannels.setChannelState (chan, b, sendNotification);
 }
 
 void ChannelSelector::setRecordStatus(int chan, bool b)
 {
-    if (chan >= 0 && chan < recordButtonsManager.getNumButtons())
-        recordButtonsManager.getButtonAt (chan)->setToggleState(b, sendNotification);
+    recordChannels.setChannelState (chan, b, sendNotification);
 }
 
 void ChannelSelector::setAudioStatus(int chan, bool b)
 {
-    if (chan >= 0 && chan < audioButtonsManager.getNumButtons())
-        audioButtonsManager.getButtonAt (chan)->setToggleState (b, sendNotification);
+    audioChannels.setChannelState (chan, b, sendNotification);
 }
 
 void ChannelSelector::clearAudio()
 {
-    const int numButtons = audioButtonsManager.getNumButtons();
-    for (int chan = 0; chan < numButtons; ++chan)
-        audioButtonsManager.getButtonAt (chan)->setToggleState (false, sendNotification);
+    audioChannels.setAllChannelStates (false, sendNotification);
 }
 
 int ChannelSelector::getDesiredWidth()
@@ -595,18 +479,11 @@ void ChannelSelector::buttonClicked(Button* button)
         // select all active buttons
         if (offsetLR == recordOffset)
         {
-            for (int i = 0; i < recordButtonsManager.getNumButtons(); ++i)
-            {
-                recordButtonsManager.getButtonAt (i)->setToggleState (true, sendNotification);
-            }
-
+            recordChannels.setAllChannelStates (true, sendNotification);
         }
         else if (offsetLR == parameterOffset)
         {
-            for (int i = 0; i < parameterButtonsManager.getNumButtons(); ++i)
-            {
-                parameterButtonsManager.getButtonAt (i)->setToggleState (true, sendNotification);
-            }
+            parameterChannels.setAllChannelStates (true, sendNotification);
         }
         else if (offsetLR == audioOffset)
         {
@@ -618,17 +495,11 @@ void ChannelSelector::buttonClicked(Button* button)
         // deselect all active buttons
         if (offsetLR == recordOffset)
         {
-            for (int i = 0; i < recordButtonsManager.getNumButtons(); ++i)
-            {
-                recordButtonsManager.getButtonAt (i)->setToggleState (false, sendNotification);
-            }
+            recordChannels.setAllChannelStates (false, sendNotification);
         }
         else if (offsetLR == parameterOffset)
         {
-            for (int i = 0; i < parameterButtonsManager.getNumButtons(); ++i)
-            {
-                parameterButtonsManager.getButtonAt (i)->setToggleState (false, sendNotification);
-            }
+            parameterChannels.setAllChannelStates (false, sendNotification);
             
             if (radioStatus) // if radio buttons are active
             {
@@ -639,136 +510,118 @@ void ChannelSelector::buttonClicked(Button* button)
         }
         else if (offsetLR == audioOffset)
         {
-            for (int i = 0; i < audioButtonsManager.getNumButtons(); ++i)
-            {
-                audioButtonsManager.getButtonAt (i)->setToggleState (false, sendNotification);
-            }
+            audioChannels.setAllChannelStates (false, sendNotification);
         }
     }
-    else
-    {
-        ChannelSelectorButton* b = (ChannelSelectorButton*)button;
+    refreshParameterColors();
+}
 
-        if (b->getType() == AUDIO)
-        {
-            // get audio node, and inform it of the change
-            GenericEditor* editor = (GenericEditor*)getParentComponent();
 
-            const DataChannel* ch = editor->getChannel(b->getChannel() - 1);
-            //int channelNum = editor->getStartChannel() + b->getChannel() - 1;
-            bool status = b->getToggleState();
+void ChannelSelector::channelStatesChanged (ChannelSelectorGrid* grid, const Array<int>& channels)
+{
+    GenericEditor* editor = (GenericEditor*) getParentComponent();
+
+    if (grid->getType() == AUDIO)
+    {
+        // get audio node, and inform it of the change
+        for (int chan : channels)
+        {
+            const DataChannel* ch = editor->getChannel (chan);
+            bool status = grid->getChannelState (chan);
 
 //LOGDD("Requesting audio monitor for channel ", ch->nodeIndex + 1);
-            
+
             // change parameter directly on editor
             //     This is another of those ugly things that will go away once the
             //     probe audio system is implemented, but is needed to maintain compatibility
             //     between the older recording system and the newer channel objects.
             const_cast<DataChannel*>(ch)->setMonitored(status);
 
-            
             if (acquisitionIsActive) // use setParameter to change audio node's copy of parameter safely, if running
             {
                 AccessClass::getProcessorGraph()->
                 getAudioNode()->setChannelStatus(ch, status);
             }
         }
-        else if (b->getType() == RECORD)
+    }
+    else if (grid->getType() == RECORD)
+    {
+        // get record node, and inform it of the change
+        for (int chan : channels)
         {
-			
-            // get record node, and inform it of the change
-            GenericEditor* editor = (GenericEditor*)getParentComponent();
+            const DataChannel* ch = editor->getChannel (chan);
+            bool status = grid->getChannelState (chan);
 
-            const DataChannel* ch = editor->getChannel(b->getChannel() - 1);
-            //int channelNum = editor->getStartChannel() + b->getChannel() - 1;
-            bool status = b->getToggleState();
-
-            if (acquisitionIsActive) // use setParameter to change parameter safely
+            if (acquisitionIsActive)
             {
-                               
                 // disable toggling when acquisition is active
-                b->setToggleState(const_cast<DataChannel*>(ch)->getRecordState(), dontSendNotification);
+                grid->setChannelState (chan, ch->getRecordState(), dontSendNotification);
             }
             else     // change parameter directly
             {
-LOGDD("Setting record status for channel ", b->getChannel());
+LOGDD("Setting record status for channel ", chan + 1);
 
-				//This is another of those ugly things that will go away once the
-				//probe recording system is implemented, but is needed to maintain compatibility
-				//between the older recording system and the newer channel objects.
+                //This is another of those ugly things that will go away once the
+                //probe recording system is implemented, but is needed to maintain compatibility
+                //between the older recording system and the newer channel objects.
                 const_cast<DataChannel*>(ch)->setRecordState(status);
             }
-
-            AccessClass::getGraphViewer()->repaint();
-
         }
-        else // parameter type
+
+        AccessClass::getGraphViewer()->repaint();
+    }
+    else // parameter type
+    {
+        for (int chan : channels)
         {
-            GenericEditor* editor = (GenericEditor*) getParentComponent();
-            editor->channelChanged (b->getChannel() - 1, b->getToggleState());
+            editor->channelChanged (chan, grid->getChannelState (chan));
 
-            // do nothing
             if (radioStatus) // if radio buttons are active
             {
                 // send a message to parent
-                GenericEditor* editor = (GenericEditor*) getParentComponent();
-                editor->channelChanged (b->getChannel(), b->getToggleState());
+                editor->channelChanged (chan + 1, grid->getChannelState (chan));
             }
         }
-
     }
+
     refreshParameterColors();
 }
 
 
-void ChannelSelector::changeChannelsSelectionButtonClicked (SlicerChannelSelectorComponent* sender,
-                                                            Button* buttonThatWasClicked,
-                                                            bool isSelect)
+ChannelSelectorGrid* ChannelSelector::getChannelGrid (Channels::ChannelsType channelsType)
 {
-    const Channels::ChannelsType channelsType = sender->getChannelsType();
-
-    TiledButtonGroupManager* buttonsManager = nullptr;
     if (channelsType == Channels::AUDIO_CHANNELS)
-        buttonsManager = &audioButtonsManager;
+        return &audioChannels;
     else if (channelsType == Channels::RECORD_CHANNELS)
-        buttonsManager = &recordButtonsManager;
+        return &recordChannels;
     else if (channelsType == Channels::PARAM_CHANNELS)
-        buttonsManager = &parameterButtonsManager;
+        return &parameterChannels;
 
-    jassert (buttonsManager != nullptr);
+    return nullptr;
+}
 
-    Array<int> getBoxList = ListSliceParser::parseStringIntoRange (sender->getText(), audioButtonsManager.getNumButtons());
-    if (getBoxList.size() < 3)
-        return;
 
-    int i = 0;
-    while (i <= getBoxList.size() - 3)
-    {
-        const int lim = getBoxList[i + 1];
-        const int comd = getBoxList[i + 2];
-        for (int fa = getBoxList[i]; fa <= lim; fa += comd)
-        {
-            buttonsManager->getButtonAt (fa)->setToggleState (isSelect, sendNotification);
-        }
-        i += 3;
-    }
+void ChannelSelector::changeChannelsSelectionButtonClicked (SlicerChannelSelectorComponent* sender,
+                                                            Button* buttonThatWasClicked,
+                                                            bool isSelect)
+{
+    ChannelSelectorGrid* channelGrid = getChannelGrid (sender->getChannelsType());
+
+    jassert (channelGrid != nullptr);
+
+    const ChannelMask selection = ListSliceParser::parseStringIntoMask (sender->getText(), channelGrid->getNumChannels());
+
+    // overlapping ranges change each channel only once
+    channelGrid->setChannelStates (selection, isSelect, sendNotification);
 }
 
 
 void ChannelSelector::channelSelectorCollapsedStateChanged (SlicerChannelSelectorComponent* sender,
                                                             bool isCollapsed)
 {
-    const Channels::ChannelsType channelsType = sender->getChannelsType();
-
-    TiledButtonGroupManager* buttonsManager = nullptr;
-    if (channelsType == Channels::AUDIO_CHANNELS)
-        buttonsManager = &audioButtonsManager;
-    else if (channelsType == Channels::RECORD_CHANNELS)
-        buttonsManager = &recordButtonsManager;
-    else if (channelsType == Channels::PARAM_CHANNELS)
-        buttonsManager = &parameterButtonsManager;
+    ChannelSelectorGrid* channelGrid = getChannelGrid (sender->getChannelsType());
 
-    jassert (buttonsManager != nullptr);
+    jassert (channelGrid != nullptr);
 
     const int headerHeight      = 25;
     const int tabButtonHeight   = 15;
@@ -778,10 +631,10 @@ void ChannelSelector::channelSelectorCollapsedStateChanged (SlicerChannelSelecto
         yPos += SlicerChannelSelectorComponent::MAX_HEIGHT - 20;
 
     const int height = getHeight() - yPos - tabButtonHeight;
-    const juce::Rectangle<int> finalBounds (buttonsManager->getX(), yPos, buttonsManager->getWidth(), height);
+    const juce::Rectangle<int> finalBounds (channelGrid->getX(), yPos, channelGrid->getWidth(), height);
 
     auto& componentAnimator = Desktop::getInstance().getAnimator();
-    componentAnimator.animateComponent (buttonsManager, finalBounds, 1.f, DURATION_ANIMATION_COLLAPSE_MS, false, 1.0, 1.0);
+    componentAnimator.animateComponent (channelGrid, finalBounds, 1.f, DURATION_ANIMATION_COLLAPSE_MS, false, 1.0, 1.0);
 }
 
 ///////////// BUTTONS //////////////////////
@@ -983,75 +836,380 @@ void EditorButton::paintButton(Graphics& g, bool isMouseOver, bool isButtonDown)
 }
 
 
-ChannelSelectorButton::ChannelSelectorButton(int num_, int type_, Font& f) : Button("name")
+ChannelSelectorGrid::ChannelSelectorGrid (int type_, const Font& font)
+    : type              (type_)
+    , channelFont       (font)
+    , listener          (nullptr)
+    , isActive          (true)
+    , isRadioMode       (false)
+    , cellWidth         (10)
+    , cellHeight        (10)
+    , padding           (0)
+    , numColumns        (1)
+    , scrollPosition    (0)
+    , hoverChannel      (-1)
+    , mouseDownChannel  (-1)
+    , firstDragChannel  (-1)
+    , lastDragChannel   (-1)
+    , isDragging        (false)
 {
-    isActive = true;
-    num = num_;
-    displayNum = num_;
-    type = type_;
+    channelFont.setHeight (11);
+}
 
-    setClickingTogglesState(true);
 
-    buttonFont = f;
-    buttonFont.setHeight (11);
+void ChannelSelectorGrid::setListener (Listener* newListener)
+{
+    listener = newListener;
 }
 
-ChannelSelectorButton::~ChannelSelectorButton() {}
 
-int ChannelSelectorButton::getType()
+int ChannelSelectorGrid::getType() const
 {
     return type;
 }
 
-int ChannelSelectorButton::getChannel()
+
+void ChannelSelectorGrid::setNumChannels (int numChannels, bool newState)
+{
+    const int oldNumChannels = states.size();
+
+    // a radio grid starts with nothing selected
+    states.setSize (numChannels, newState && ! isRadioMode);
+    displayNumbers.resize (states.size());
+
+    for (int channel = oldNumChannels; channel < states.size(); ++channel)
+        displayNumbers.set (channel, channel + 1);
+
+    if (hoverChannel >= states.size())
+        hoverChannel = -1;
+
+    setScrollPosition (scrollPosition);
+    repaint();
+}
+
+
+int ChannelSelectorGrid::getNumChannels() const
+{
+    return states.size();
+}
+
+
+void ChannelSelectorGrid::setDisplayNumber (int channel, int displayNumber)
+{
+    if (isPositiveAndBelow (channel, displayNumbers.size())
+        && displayNumbers[channel] != displayNumber)
+    {
+        displayNumbers.set (channel, displayNumber);
+        repaintChannel (channel);
+    }
+}
+
+
+bool ChannelSelectorGrid::getChannelState (int channel) const
+{
+    return states[channel];
+}
+
+
+const ChannelMask& ChannelSelectorGrid::getChannelStates() const
+{
+    return states;
+}
+
+
+void ChannelSelectorGrid::setChannelState (int channel, bool state, NotificationType notification)
+{
+    if (! isPositiveAndBelow (channel, states.size()))
+        return;
+
+    Array<int> changed;
+    applyState (channel, state, changed);
+    sendChanges (changed, notification);
+}
+
+
+void ChannelSelectorGrid::setChannelStates (const ChannelMask& channels, bool state, NotificationType notification)
+{
+    Array<int> changed;
+
+    for (int channel : channels)
+    {
+        if (channel >= states.size())
+            break;
+
+        applyState (channel, state, changed);
+    }
+
+    sendChanges (changed, notification);
+}
+
+
+void ChannelSelectorGrid::setAllChannelStates (bool state, NotificationType notification)
 {
-    return num;
+    setChannelStates (ChannelMask (states.size(), true), state, notification);
 }
 
-void ChannelSelectorButton::setChannel(int n)
+
+void ChannelSelectorGrid::setActive (bool shouldBeActive)
 {
-    num = n;
-    displayNum = n;
+    isActive = shouldBeActive;
+    repaint();
 }
-void ChannelSelectorButton::setChannel(int n, int d)
+
+
+void ChannelSelectorGrid::setRadioMode (bool shouldBeRadio)
 {
-    num = n;
-    displayNum = d;
+    isRadioMode = shouldBeRadio;
 }
 
-void ChannelSelectorButton::paintButton(Graphics& g, bool isMouseOver, bool isButtonDown)
+
+void ChannelSelectorGrid::setCellSize (int width, int height)
+{
+    cellWidth  = jmax (1, width);
+    cellHeight = jmax (1, height);
+
+    resized();
+    repaint();
+}
+
+
+int ChannelSelectorGrid::getChannelAt (juce::Point<int> position) const
 {
-    if (isActive)
+    const int x = position.getX();
+    const int y = position.getY() + scrollPosition;
+
+    if (x < 0 || y < 0)
+        return -1;
+
+    const int column = x / (cellWidth + padding);
+    const int row    = y / (cellHeight + padding);
+
+    // the gaps between the cells belong to no channel
+    if (column >= numColumns
+        || x - column * (cellWidth + padding) >= cellWidth
+        || y - row * (cellHeight + padding) >= cellHeight)
+        return -1;
+
+    const int channel = row * numColumns + column;
+
+    return channel < states.size() ? channel : -1;
+}
+
+
+void ChannelSelectorGrid::paint (Graphics& g)
+{
+    const juce::Rectangle<int> clip = g.getClipBounds();
+    const int rowPitch = cellHeight + padding;
+
+    // only the rows in view are drawn
+    const int firstRow = jmax (0, (clip.getY() + scrollPosition) / rowPitch);
+    const int lastRow  = (clip.getBottom() + scrollPosition) / rowPitch;
+
+    g.setFont (channelFont);
+
+    for (int row = firstRow; row <= lastRow; ++row)
     {
-        if (getToggleState() == true)
-            g.setColour(Colours::orange);
-        else
-            g.setColour(Colours::darkgrey);
+        for (int column = 0; column < numColumns; ++column)
+        {
+            const int channel = row * numColumns + column;
 
-        if (isMouseOver)
-            g.setColour(Colours::white);
+            if (channel >= states.size())
+                return;
+
+            if (isActive)
+            {
+                if (channel == hoverChannel)
+                    g.setColour (Colours::white);
+                else if (states[channel])
+                    g.setColour (Colours::orange);
+                else
+                    g.setColour (Colours::darkgrey);
+            }
+            else
+            {
+                if (states[channel])
+                    g.setColour (Colours::yellow);
+                else
+                    g.setColour (Colours::lightgrey);
+            }
+
+            g.drawText (String (displayNumbers[channel]), getCellBounds (channel), Justification::centred, true);
+        }
     }
-    else
+}
+
+
+void ChannelSelectorGrid::resized()
+{
+    const int width = getWidth();
+
+    // spread the cells of a row over the whole width, as the buttons used to be
+    numColumns = jmax (1, width / cellWidth);
+    padding    = numColumns > 1 ? jmax (0, (width - numColumns * cellWidth) / (numColumns - 1)) : 0;
+
+    setScrollPosition (scrollPosition);
+}
+
+
+void ChannelSelectorGrid::mouseMove (const MouseEvent& e)
+{
+    const int channel = isActive ? getChannelAt (e.getPosition()) : -1;
+
+    if (channel != hoverChannel)
     {
-        if (getToggleState() == true)
-            g.setColour(Colours::yellow);
-        else
-            g.setColour(Colours::lightgrey);
+        repaintChannel (hoverChannel);
+        hoverChannel = channel;
+        repaintChannel (hoverChannel);
     }
+}
 
-    // g.fillRect(0,0,getWidth(),getHeight());
 
-    g.setFont(buttonFont);
+void ChannelSelectorGrid::mouseExit (const MouseEvent& e)
+{
+    repaintChannel (hoverChannel);
+    hoverChannel = -1;
+}
+
+
+void ChannelSelectorGrid::mouseDown (const MouseEvent& e)
+{
+    mouseDownChannel = getChannelAt (e.getPosition());
+    firstDragChannel = -1;
+    lastDragChannel  = -1;
+    isDragging       = false;
+}
+
+
+void ChannelSelectorGrid::mouseDrag (const MouseEvent& e)
+{
+    if (! isActive
+        || isRadioMode
+        || ! e.mouseWasDraggedSinceMouseDown())
+        return;
+
+    isDragging = true;
+
+    const int channel = getChannelAt (e.getPosition());
+
+    if (channel < 0 || channel == lastDragChannel)
+        return;
+
+    // Remember the first channel on which we started dragging
+    if (firstDragChannel < 0)
+        firstDragChannel = mouseDownChannel >= 0 ? mouseDownChannel : channel;
 
-    // g.drawRect(0,0,getWidth(),getHeight(),1.0);
+    lastDragChannel = channel;
 
-    g.drawText(String(displayNum), 0, 0, getWidth(), getHeight(), Justification::centred, true);
+    // Dragging selects the range it covers; with SHIFT held it deselects it
+    const bool state = ! e.mods.isShiftDown();
+
+    Array<int> changed;
+
+    for (int n = jmin (firstDragChannel, lastDragChannel); n <= jmax (firstDragChannel, lastDragChannel); ++n)
+        applyState (n, state, changed);
+
+    sendChanges (changed, sendNotification);
 }
 
-void ChannelSelectorButton::setActive(bool t)
+
+void ChannelSelectorGrid::mouseUp (const MouseEvent& e)
 {
-    isActive = t;
-    setClickingTogglesState(t);
+    if (! isDragging
+        && isActive
+        && mouseDownChannel >= 0
+        && getChannelAt (e.getPosition()) == mouseDownChannel)
+    {
+        // clicking the selected channel of a radio grid keeps it selected
+        if (! (isRadioMode && states[mouseDownChannel]))
+            setChannelState (mouseDownChannel, ! states[mouseDownChannel], sendNotification);
+    }
+
+    mouseDownChannel = -1;
+    firstDragChannel = -1;
+    lastDragChannel  = -1;
+    isDragging       = false;
+}
+
+
+void ChannelSelectorGrid::mouseWheelMove (const MouseEvent& e, const MouseWheelDetails& wheel)
+{
+    const int oldPosition = scrollPosition;
+
+    setScrollPosition (scrollPosition - roundToInt (wheel.deltaY * 8.0f * (cellHeight + padding)));
+
+    if (scrollPosition == oldPosition)
+    {
+        // nothing left to scroll, so let the parent have it
+        Component::mouseWheelMove (e, wheel);
+        return;
+    }
+
+    mouseMove (e);
+}
+
+
+void ChannelSelectorGrid::applyState (int channel, bool state, Array<int>& changed)
+{
+    if (states[channel] == state)
+        return;
+
+    if (state && isRadioMode)
+    {
+        for (int other = states.findNextSet (0); other >= 0; other = states.findNextSet (other + 1))
+        {
+            states.set (other, false);
+            changed.add (other);
+            repaintChannel (other);
+        }
+    }
+
+    states.set (channel, state);
+    changed.add (channel);
+    repaintChannel (channel);
+}
+
+
+void ChannelSelectorGrid::sendChanges (const Array<int>& changed, NotificationType notification)
+{
+    if (notification != dontSendNotification
+        && listener != nullptr
+        && changed.size() > 0)
+    {
+        listener->channelStatesChanged (this, changed);
+    }
+}
+
+
+juce::Rectangle<int> ChannelSelectorGrid::getCellBounds (int channel) const
+{
+    const int row    = channel / numColumns;
+    const int column = channel % numColumns;
+
+    return juce::Rectangle<int> (column * (cellWidth + padding),
+                                 row * (cellHeight + padding) - scrollPosition,
+                                 cellWidth,
+                                 cellHeight);
+}
+
+
+void ChannelSelectorGrid::repaintChannel (int channel)
+{
+    if (isPositiveAndBelow (channel, states.size()))
+        repaint (getCellBounds (channel));
+}
+
+
+void ChannelSelectorGrid::setScrollPosition (int position)
+{
+    const int numRows       = (states.size() + numColumns - 1) / numColumns;
+    const int contentHeight = numRows * (cellHeight + padding);
+    const int newPosition   = jlimit (0, jmax (0, contentHeight - getHeight()), position);
+
+    if (newPosition != scrollPosition)
+    {
+        scrollPosition = newPosition;
+        repaint();
+    }
 }
 
 
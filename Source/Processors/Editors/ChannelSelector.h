@@ -26,13 +26,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../Editors/GenericEditor.h"
-#include "../../UI/Utils/TiledButtonGroupManager.h"
 #include "../Channel/InfoObjects.h"
+#include "../Channel/ChannelMask.h"
 
 #include <stdio.h>
 
 class ChannelSelectorRegion;
-class ChannelSelectorButton;
+class ChannelSelectorGrid;
 class EditorButton;
 class ChannelSelectorBox;
 class ShowAlertMessage;
@@ -115,6 +115,113 @@ private:
 };
 
 
+/**
+    The channels of one ChannelSelector tab, drawn as a grid of channel numbers.
+
+    A single component paints the rows in view straight from a ChannelMask and
+    works out the channel under the mouse from the cell size, so an editor with
+    thousands of channels costs no more than one with a handful.
+
+    Clicking a channel toggles it. Dragging across channels selects the range
+    between the first and the current one, or deselects it with shift held.
+
+    @see ChannelSelector
+*/
+class ChannelSelectorGrid : public Component
+{
+public:
+    ChannelSelectorGrid (int type, const Font& font);
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** Called with the channels whose state has changed, either by the user or
+            by a call that sends a notification. Channels that were turned off in
+            radio mode come before the one that was turned on. */
+        virtual void channelStatesChanged (ChannelSelectorGrid* grid, const Array<int>& channels) = 0;
+    };
+
+    void setListener (Listener* listener);
+
+    /** The ChannelSelector tab the grid belongs to */
+    int getType() const;
+
+    /** Resizes the grid; channels that are added take newState */
+    void setNumChannels (int numChannels, bool newState);
+    int getNumChannels() const;
+
+    /** Sets the number drawn for a channel */
+    void setDisplayNumber (int channel, int displayNumber);
+
+    bool getChannelState (int channel) const;
+    const ChannelMask& getChannelStates() const;
+
+    void setChannelState (int channel, bool state, NotificationType notification);
+
+    /** Sets every channel of the mask to the same state */
+    void setChannelStates (const ChannelMask& channels, bool state, NotificationType notification);
+    void setAllChannelStates (bool state, NotificationType notification);
+
+    /** An inactive grid is drawn greyed out and ignores the mouse */
+    void setActive (bool isActive);
+
+    /** In radio mode at most one channel is selected, and dragging selects nothing */
+    void setRadioMode (bool isRadioMode);
+
+    /** Sets the size of the cell of each channel; the cells of a row are spread over the width */
+    void setCellSize (int width, int height);
+
+    /** The channel whose cell contains a point of the component, or -1 */
+    int getChannelAt (juce::Point<int> position) const;
+
+    void paint (Graphics& g) override;
+    void resized() override;
+
+    void mouseMove (const MouseEvent& e) override;
+    void mouseExit (const MouseEvent& e) override;
+    void mouseDown (const MouseEvent& e) override;
+    void mouseDrag (const MouseEvent& e) override;
+    void mouseUp (const MouseEvent& e) override;
+    void mouseWheelMove (const MouseEvent& e, const MouseWheelDetails& wheel) override;
+
+private:
+    /** Sets one channel, adding it and any radio partner it turns off to the changed list */
+    void applyState (int channel, bool state, Array<int>& changed);
+    void sendChanges (const Array<int>& changed, NotificationType notification);
+
+    juce::Rectangle<int> getCellBounds (int channel) const;
+    void repaintChannel (int channel);
+
+    void setScrollPosition (int position);
+
+    const int type;
+    Font channelFont;
+    Listener* listener;
+
+    ChannelMask states;
+    Array<int> displayNumbers;
+
+    bool isActive;
+    bool isRadioMode;
+
+    int cellWidth;
+    int cellHeight;
+    int padding;
+    int numColumns;
+    int scrollPosition;
+
+    int hoverChannel;
+    int mouseDownChannel;
+    int firstDragChannel;
+    int lastDragChannel;
+    bool isDragging;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelSelectorGrid)
+};
+
+
 /**
 Automatically creates an interactive editor for selecting channels.
 
@@ -127,6 +234,7 @@ channels to be selected for different purposes.
 class PLUGIN_API ChannelSelector : public Component
                                  , public Button::Listener
                                  , private SlicerChannelSelectorComponent::Listener
+                                 , private ChannelSelectorGrid::Listener
                                  , public Timer
 {
 public:
@@ -181,22 +289,22 @@ public:
     /** Called immediately after data acquisition ends.*/
     void stopAcquisition();
 
-    /** Inactivates all the ChannelSelectorButtons under the "param" tab.*/
+    /** Inactivates the channels under the "param" tab.*/
     void inactivateButtons();
 
-    /** Activates all the ChannelSelectorButtons under the "param" tab.*/
+    /** Activates the channels under the "param" tab.*/
     void activateButtons();
 
-    /** Inactivates all the ChannelSelectorButtons under the "rec" tab.*/
+    /** Inactivates the channels under the "rec" tab.*/
     void inactivateRecButtons();
 
-    /** Activates all the ChannelSelectorButtons under the "rec" tab.*/
+    /** Activates the channels under the "rec" tab.*/
     void activateRecButtons();
 
     /** Refreshes Parameter Colors on change*/
     void refreshParameterColors();
 
-    /** Controls the behavior of ChannelSelectorButtons; they can either behave
+    /** Controls the behavior of the "param" channels; they can either behave
     like radio buttons (only one selected at a time) or like toggle buttons (an
     arbitrary number can be selected at once).*/
     void setRadioStatus(bool);
@@ -216,25 +324,22 @@ private:
     EditorButton* allButton;
     EditorButton* noneButton;
 
-    /** An array of ChannelSelectorButtons used to select the channels that
-    will be updated when a parameter is changed.
+    /** The channels that will be updated when a parameter is changed.
     paramBox: TextBox where user input is taken for param tab.
     */
-    TiledButtonGroupManager parameterButtonsManager;
+    ChannelSelectorGrid parameterChannels;
     SlicerChannelSelectorComponent parameterSlicerChannelSelector;
 
-    /** An array of ChannelSelectorButtons used to select the channels that
-    are sent to the audio monitor.
+    /** The channels that are sent to the audio monitor.
     audioBox: TextBox where user input is taken for audio tab
     */
-    TiledButtonGroupManager audioButtonsManager;
+    ChannelSelectorGrid audioChannels;
     SlicerChannelSelectorComponent audioSlicerChannelSelector;
 
-    /** An array of ChannelSelectorButtons used to select the channels that
-    will be written to disk when the record button is pressed.
+    /** The channels that will be written to disk when the record button is pressed.
     recordBox: TextBox where user input is taken for record tab
     */
-    TiledButtonGroupManager recordButtonsManager;
+    ChannelSelectorGrid recordChannels;
     SlicerChannelSelectorComponent recordSlicerChannelSelector;
 
     bool paramsToggled;
@@ -261,8 +366,6 @@ private:
 
     void resized();
 
-    void addButton();
-    void removeButton();
     void refreshButtonBoundaries();
 
     /** Controls the speed of animations. */
@@ -283,6 +386,12 @@ private:
                                                bool isCollapsed)    override;
     // =================================================================================================
 
+    /** Passes the channels changed in a tab on to the editor, the audio node or the record node */
+    void channelStatesChanged (ChannelSelectorGrid* grid, const Array<int>& channels) override;
+
+    /** The grid of the tab a slicer selects channels in */
+    ChannelSelectorGrid* getChannelGrid (Channels::ChannelsType channelsType);
+
     Font& titleFont;
 
     enum { AUDIO, RECORD, PARAMETER };
@@ -328,39 +437,4 @@ private:
 };
 
 
-/**
-
-A button within the ChannelSelector representing an individual channel.
-
-@see ChannelSelector
-
-*/
-
-class ChannelSelectorButton : public Button
-{
-public:
-    ChannelSelectorButton(int num, int type, Font& f);
-    ~ChannelSelectorButton();
-
-    int getType();
-    int getChannel();
-    //Channel* getChannel() {return ch;}
-    void setActive(bool t);
-    void setChannel(int n);
-    void setChannel(int n, int d);
-
-private:
-    void paintButton(Graphics& g, bool isMouseOver, bool isButtonDown);
-
-    //Channel* ch;
-
-    int type;
-    int num;
-    int displayNum;
-    Font buttonFont;
-    bool isActive;
-};
-
-
-
 #endif  // __CHANNELSELECTOR_H_68124E35__
@@ -31,6 +31,7 @@
 #include "../../AccessClass.h"
 #include "../../UI/EditorViewport.h"
 #include "../../UI/GraphViewer.h"
+#include "../../Utils/MessageThreadMonitor.h"
 
 #include <math.h>
 
@@ -518,6 +519,8 @@ LOGDD("Editor for ");
 
 LOGDD(p->getName(), " updating settings.");
 
+    MessageThreadMonitor::ScopedTask task(p->getName() + " editor update");
+
     updateSettings();
 
     int numChannels;
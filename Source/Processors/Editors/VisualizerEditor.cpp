@@ -212,6 +212,11 @@ void VisualizerEditor::buttonClicked (Button* button)
         {
             return;
         }
+
+        // names the canvas in the message thread monitor's reports
+        if (canvas->getName().isEmpty())
+            canvas->setName (getName());
+
         canvas->update();
 
         if (isPlaying)
@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "Events.h"
+#include "SpikeStore.h"
 #include "../GenericProcessor/GenericProcessor.h"
 //EventBase
 
@@ -145,17 +146,22 @@ size_t SystemEvent::fillTimestampAndSamplesData(HeapBlock<char>& data, const Gen
 	* Timestamp - 8 bytes
 	* Buffer sample number - 4 bytes
 	*/
-	const int eventSize = 20;
-	data.malloc(eventSize);
+	data.malloc(TIMESTAMP_AND_SAMPLES_SIZE);
+	writeTimestampAndSamplesData(data, proc, subProcessorIdx, timestamp, nSamples);
+	return TIMESTAMP_AND_SAMPLES_SIZE;
+}
+
+void SystemEvent::writeTimestampAndSamplesData(void* dst, const GenericProcessor* proc, int16 subProcessorIdx, juce::int64 timestamp, uint32 nSamples)
+{
+	char* data = static_cast<char*>(dst);
 	data[0] = SYSTEM_EVENT;
 	data[1] = TIMESTAMP_AND_SAMPLES;
-	*reinterpret_cast<uint16*>(data.getData() + 2) = proc->getNodeId();
-	*reinterpret_cast<uint16*>(data.getData() + 4) = subProcessorIdx;
+	*reinterpret_cast<uint16*>(data + 2) = proc->getNodeId();
+	*reinterpret_cast<uint16*>(data + 4) = subProcessorIdx;
 	data[6] = 0;
 	data[7] = 0;
-	*reinterpret_cast<juce::int64*>(data.getData() + 8) = timestamp;
-	*reinterpret_cast<uint32*>(data.getData() + 16) = nSamples;
-	return eventSize;
+	*reinterpret_cast<juce::int64*>(data + 8) = timestamp;
+	*reinterpret_cast<uint32*>(data + 16) = nSamples;
 }
 
 size_t SystemEvent::fillTimestampSyncTextData(HeapBlock<char>& data, const GenericProcessor* proc, int16 subProcessorIdx, juce::int64 timestamp, bool softwareTime)
@@ -311,6 +317,31 @@ bool Event::createChecks(const EventChannel* channelInfo, EventChannel::EventCha
 	return true;
 }
 
+bool Event::serializeChecks(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, uint16 channel, const void* metaData, size_t dstSize)
+{
+	if (!channelInfo) return false;
+	if (channelInfo->getChannelType() != eventType) return false;
+	if ((channel < 0) || (channel >= channelInfo->getNumChannels())) return false;
+	if (channelInfo->getEventMetaDataCount() != 0 && !metaData) return false;
+	if (dstSize < channelInfo->getDataSize() + EVENT_BASE_SIZE + channelInfo->getTotalEventMetaDataSize()) return false;
+	return true;
+}
+
+void Event::serializeEnvelope(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, juce::int64 timestamp, uint16 channel, const void* metaData, char* buffer)
+{
+	*(buffer + 0) = PROCESSOR_EVENT;
+	*(buffer + 1) = static_cast<char>(eventType);
+	*(reinterpret_cast<uint16*>(buffer + 2)) = channelInfo->getSourceNodeID();
+	*(reinterpret_cast<uint16*>(buffer + 4)) = channelInfo->getSubProcessorIdx();
+	*(reinterpret_cast<uint16*>(buffer + 6)) = channelInfo->getSourceIndex();
+	*(reinterpret_cast<juce::int64*>(buffer + 8)) = timestamp;
+	*(reinterpret_cast<uint16*>(buffer + 16)) = channel;
+
+	size_t metaDataSize = channelInfo->getTotalEventMetaDataSize();
+	if (metaDataSize > 0)
+		memcpy(buffer + EVENT_BASE_SIZE + channelInfo->getDataSize(), metaData, metaDataSize);
+}
+
 const void* Event::getRawDataPointer() const
 {
 	return m_data.getData();
@@ -401,6 +432,36 @@ TTLEventPtr TTLEvent::createTTLEvent(const EventChannel* channelInfo, juce::int6
 	return event;
 }
 
+bool TTLEvent::serializeTTLEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* eventData, uint16 channel, void* dstBuffer, size_t dstSize, const void* metaData)
+{
+	if (!serializeChecks(channelInfo, EventChannel::TTL, channel, metaData, dstSize))
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+	memcpy((buffer + EVENT_BASE_SIZE), eventData, channelInfo->getDataSize());
+	serializeEnvelope(channelInfo, EventChannel::TTL, timestamp, channel, metaData, buffer);
+	return true;
+}
+
+bool TTLEvent::serializeTTLEdge(const EventChannel* channelInfo, juce::int64 timestamp, uint16 channel, bool state, void* dstBuffer, size_t dstSize, const void* metaData)
+{
+	if (!serializeChecks(channelInfo, EventChannel::TTL, channel, metaData, dstSize))
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+	memset(buffer + EVENT_BASE_SIZE, 0, channelInfo->getDataSize());
+	if (state)
+		buffer[EVENT_BASE_SIZE + channel / 8] = static_cast<char>(1 << (channel % 8));
+	serializeEnvelope(channelInfo, EventChannel::TTL, timestamp, channel, metaData, buffer);
+	return true;
+}
+
 TTLEventPtr TTLEvent::deserializeFromMessage(const MidiMessage& msg, const EventChannel* channelInfo)
 {
 	size_t totalSize = msg.getRawDataSize();
@@ -501,6 +562,49 @@ void TextEvent::serialize(void* dstBuffer, size_t dstSize) const
 	serializeMetaData(buffer + eventSize);
 }
 
+bool TextEvent::serializeTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const String& text, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize)
+{
+	if (!serializeChecks(channelInfo, EventChannel::TEXT, channel, metaData, dstSize))
+	{
+		jassertfalse;
+		return false;
+	}
+
+	if (text.getNumBytesAsUTF8() > channelInfo->getDataSize())
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+	size_t dataSize = channelInfo->getDataSize();
+	zeromem(buffer + EVENT_BASE_SIZE, dataSize);
+	text.copyToUTF8(buffer + EVENT_BASE_SIZE, dataSize);
+	serializeEnvelope(channelInfo, EventChannel::TEXT, timestamp, channel, metaData, buffer);
+	return true;
+}
+
+bool TextEvent::serializeTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const char* utf8, size_t numBytes, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize)
+{
+	if (!serializeChecks(channelInfo, EventChannel::TEXT, channel, metaData, dstSize))
+	{
+		jassertfalse;
+		return false;
+	}
+
+	if (numBytes > channelInfo->getDataSize())
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+	zeromem(buffer + EVENT_BASE_SIZE, channelInfo->getDataSize());
+	memcpy(buffer + EVENT_BASE_SIZE, utf8, numBytes);
+	serializeEnvelope(channelInfo, EventChannel::TEXT, timestamp, channel, metaData, buffer);
+	return true;
+}
+
 TextEventPtr TextEvent::createTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const String& text, uint16 channel)
 {
 	if (!createChecks(channelInfo, EventChannel::TEXT, channel))
@@ -712,6 +816,33 @@ BinaryEventPtr BinaryEvent::createBinaryEvent(const EventChannel* channelInfo, j
 	return event;
 }
 
+bool BinaryEvent::serializeBinaryEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* data, int dataSize, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize)
+{
+	EventChannel::EventChannelTypes type = channelInfo ? channelInfo->getChannelType() : EventChannel::INVALID;
+	if (type < EventChannel::BINARY_BASE_VALUE || type >= EventChannel::INVALID)
+	{
+		jassertfalse;
+		return false;
+	}
+
+	if (!serializeChecks(channelInfo, type, channel, metaData, dstSize))
+	{
+		jassertfalse;
+		return false;
+	}
+
+	if (dataSize < channelInfo->getDataSize())
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+	memcpy((buffer + EVENT_BASE_SIZE), data, channelInfo->getDataSize());
+	serializeEnvelope(channelInfo, type, timestamp, channel, metaData, buffer);
+	return true;
+}
+
 BinaryEventPtr BinaryEvent::deserializeFromMessage(const MidiMessage& msg, const EventChannel* channelInfo)
 {
 	size_t totalSize = msg.getRawDataSize();
@@ -860,6 +991,49 @@ void SpikeEvent::serialize(void* dstBuffer, size_t dstSize) const
 	serializeMetaData(buffer + eventSize);
 }
 
+bool SpikeEvent::serializeSpikeEvent(const SpikeChannel* channelInfo, juce::int64 timestamp, const float* thresholds, const SpikeBuffer& dataSource, uint16 sortedID, const void* metaData, void* dstBuffer, size_t dstSize)
+{
+	if (!channelInfo || !dataSource.m_ready || channelInfo->getChannelType() == SpikeChannel::INVALID)
+	{
+		jassertfalse;
+		return false;
+	}
+	int nChannels = channelInfo->getNumChannels();
+	if (nChannels != dataSource.m_nChans || channelInfo->getTotalSamples() != dataSource.m_nSamps)
+	{
+		jassertfalse;
+		return false;
+	}
+	size_t metaDataSize = channelInfo->getTotalEventMetaDataSize();
+	if (metaDataSize > 0 && !metaData)
+	{
+		jassertfalse;
+		return false;
+	}
+	size_t dataSize = channelInfo->getDataSize();
+	size_t eventSize = dataSize + SPIKE_BASE_SIZE + nChannels * sizeof(float);
+	if (dstSize < eventSize + metaDataSize)
+	{
+		jassertfalse;
+		return false;
+	}
+
+	char* buffer = static_cast<char*>(dstBuffer);
+
+	*(buffer + 0) = SPIKE_EVENT;
+	*(buffer + 1) = static_cast<char>(channelInfo->getChannelType());
+	*(reinterpret_cast<uint16*>(buffer + 2)) = channelInfo->getSourceNodeID();
+	*(reinterpret_cast<uint16*>(buffer + 4)) = channelInfo->getSubProcessorIdx();
+	*(reinterpret_cast<uint16*>(buffer + 6)) = channelInfo->getSourceIndex();
+	*(reinterpret_cast<juce::int64*>(buffer + 8)) = timestamp;
+	*(reinterpret_cast<uint16*>(buffer + 16)) = sortedID;
+	memcpy((buffer + SPIKE_BASE_SIZE), thresholds, nChannels * sizeof(float));
+	memcpy((buffer + SPIKE_BASE_SIZE + nChannels * sizeof(float)), dataSource.m_data.getData(), dataSize);
+	if (metaDataSize > 0)
+		memcpy((buffer + eventSize), metaData, metaDataSize);
+	return true;
+}
+
 SpikeEvent* SpikeEvent::createBasicSpike(const SpikeChannel* channelInfo, juce::int64 timestamp, Array<float> thresholds, SpikeBuffer& dataSource, uint16 sortedID)
 {
 	if (!dataSource.m_ready)
@@ -940,7 +1114,8 @@ SpikeEventPtr SpikeEvent::createSpikeEvent(const SpikeChannel* channelInfo, juce
 SpikeEventPtr SpikeEvent::deserializeFromMessage(const MidiMessage& msg, const SpikeChannel* channelInfo)
 {
 	int nChans = channelInfo->getNumChannels();
-	size_t totalSize = msg.getRawDataSize();
+	size_t totalSize;
+	const uint8* buffer = SpikeStore::getSpikeData(msg, totalSize);
 	size_t dataSize = channelInfo->getDataSize();
 	size_t thresholdSize = nChans*sizeof(float);
 	size_t metaDataSize = channelInfo->getTotalEventMetaDataSize();
@@ -951,12 +1126,18 @@ SpikeEventPtr SpikeEvent::deserializeFromMessage(const MidiMessage& msg, const S
 		return nullptr;
 	}
 
+	//a compact message whose spike is no longer in the store
+	if (buffer == nullptr)
+	{
+		jassertfalse;
+		return nullptr;
+	}
+
 	if (totalSize != (thresholdSize + dataSize + SPIKE_BASE_SIZE + metaDataSize))
 	{
 		jassertfalse;
 		return nullptr;
 	}
-	const uint8* buffer = msg.getRawData();
 	//TODO: remove the mask when the probe system is implemented
 	if (static_cast<EventType>(*(buffer + 0)&0x7F) != SPIKE_EVENT)
 	{
@@ -1048,7 +1229,7 @@ void  SpikeEvent::SpikeBuffer::set(const int chan, const float* source, const in
 		return;
 	}
 	jassert(chan >= 0 && chan < m_nChans && n <= m_nSamps);
-	memcpy(m_data.getData(), source, n*sizeof(float));
+	memcpy(m_data.getData() + chan*m_nSamps, source, n*sizeof(float));
 }
 
 void  SpikeEvent::SpikeBuffer::set(const int chan, const int start, const float* source, const int n)
@@ -1059,7 +1240,7 @@ void  SpikeEvent::SpikeBuffer::set(const int chan, const int start, const float*
 		return;
 	}
 	jassert(chan >= 0 && chan < m_nChans && (n + start) <= m_nSamps);
-	memcpy(m_data.getData() + start, source, n*sizeof(float));
+	memcpy(m_data.getData() + chan*m_nSamps + start, source, n*sizeof(float));
 }
 
 float SpikeEvent::SpikeBuffer::get(const int chan, const int samp)
@@ -1094,6 +1275,221 @@ const float* SpikeEvent::SpikeBuffer::getRawPointer()
 	return m_data.getData();
 }
 
+//EventView
+
+static size_t getMetaDataOffset(const MetaDataEventObject* info, int index)
+{
+	size_t offset = 0;
+	for (int i = 0; i < index; i++)
+		offset += info->getEventMetaDataDescriptor(i)->getDataSize();
+	return offset;
+}
+
+EventView::EventView(const MidiMessage& msg, const EventChannel* channelInfo)
+	: m_data(nullptr),
+	m_channelInfo(channelInfo)
+{
+	if (!channelInfo)
+		return;
+
+	size_t totalSize = msg.getRawDataSize();
+	if (totalSize != (channelInfo->getDataSize() + EVENT_BASE_SIZE + channelInfo->getTotalEventMetaDataSize()))
+	{
+		jassertfalse;
+		return;
+	}
+
+	const uint8* buffer = msg.getRawData();
+	//TODO: remove the mask when the probe system is implemented
+	if (static_cast<EventType>(*(buffer + 0) & 0x7F) != PROCESSOR_EVENT
+		|| static_cast<EventChannel::EventChannelTypes>(*(buffer + 1)) != channelInfo->getChannelType()
+		|| *reinterpret_cast<const uint16*>(buffer + 2) != channelInfo->getSourceNodeID()
+		|| *reinterpret_cast<const uint16*>(buffer + 4) != channelInfo->getSubProcessorIdx()
+		|| *reinterpret_cast<const uint16*>(buffer + 6) != channelInfo->getSourceIndex())
+	{
+		jassertfalse;
+		return;
+	}
+
+	m_data = buffer;
+}
+
+bool EventView::isValid() const
+{
+	return m_data != nullptr;
+}
+
+EventChannel::EventChannelTypes EventView::getEventType() const
+{
+	return m_channelInfo->getChannelType();
+}
+
+const EventChannel* EventView::getChannelInfo() const
+{
+	return m_channelInfo;
+}
+
+juce::int64 EventView::getTimestamp() const
+{
+	return *reinterpret_cast<const juce::int64*>(m_data + 8);
+}
+
+uint16 EventView::getSourceID() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 2);
+}
+
+uint16 EventView::getSubProcessorIdx() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 4);
+}
+
+uint16 EventView::getSourceIndex() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 6);
+}
+
+uint16 EventView::getChannel() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 16);
+}
+
+const void* EventView::getRawDataPointer() const
+{
+	return m_data + EVENT_BASE_SIZE;
+}
+
+bool EventView::getState() const
+{
+	jassert(getEventType() == EventChannel::TTL);
+	int channel = getChannel();
+	int byteIndex = channel / 8;
+	int bitIndex = channel % 8;
+
+	return ((1 << bitIndex) & *(m_data + EVENT_BASE_SIZE + byteIndex));
+}
+
+String EventView::getText() const
+{
+	jassert(getEventType() == EventChannel::TEXT);
+	return String(reinterpret_cast<const char*>(m_data + EVENT_BASE_SIZE), m_channelInfo->getLength());
+}
+
+const void* EventView::getMetaDataPointer(int index) const
+{
+	if ((index < 0) || (index >= m_channelInfo->getEventMetaDataCount()))
+	{
+		jassertfalse;
+		return nullptr;
+	}
+	return m_data + EVENT_BASE_SIZE + m_channelInfo->getDataSize() + getMetaDataOffset(m_channelInfo, index);
+}
+
+//SpikeView
+
+SpikeView::SpikeView(const MidiMessage& msg, const SpikeChannel* channelInfo)
+	: m_data(nullptr),
+	m_channelInfo(channelInfo)
+{
+	if (!channelInfo || channelInfo->getChannelType() == SpikeChannel::INVALID)
+		return;
+
+	size_t totalSize;
+	const uint8* buffer = SpikeStore::getSpikeData(msg, totalSize);
+	if (buffer == nullptr
+		|| totalSize != (channelInfo->getNumChannels() * sizeof(float) + channelInfo->getDataSize() + SPIKE_BASE_SIZE + channelInfo->getTotalEventMetaDataSize()))
+	{
+		jassertfalse;
+		return;
+	}
+
+	//TODO: remove the mask when the probe system is implemented
+	if (static_cast<EventType>(*(buffer + 0) & 0x7F) != SPIKE_EVENT
+		|| static_cast<SpikeChannel::ElectrodeTypes>(*(buffer + 1)) != channelInfo->getChannelType()
+		|| *reinterpret_cast<const uint16*>(buffer + 2) != channelInfo->getSourceNodeID()
+		|| *reinterpret_cast<const uint16*>(buffer + 4) != channelInfo->getSubProcessorIdx()
+		|| *reinterpret_cast<const uint16*>(buffer + 6) != channelInfo->getSourceIndex())
+	{
+		jassertfalse;
+		return;
+	}
+
+	m_data = buffer;
+}
+
+bool SpikeView::isValid() const
+{
+	return m_data != nullptr;
+}
+
+const SpikeChannel* SpikeView::getChannelInfo() const
+{
+	return m_channelInfo;
+}
+
+juce::int64 SpikeView::getTimestamp() const
+{
+	return *reinterpret_cast<const juce::int64*>(m_data + 8);
+}
+
+uint16 SpikeView::getSourceID() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 2);
+}
+
+uint16 SpikeView::getSubProcessorIdx() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 4);
+}
+
+uint16 SpikeView::getSourceIndex() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 6);
+}
+
+uint16 SpikeView::getSortedID() const
+{
+	return *reinterpret_cast<const uint16*>(m_data + 16);
+}
+
+float SpikeView::getThreshold(int chan) const
+{
+	if ((chan < 0) || (chan >= m_channelInfo->getNumChannels()))
+	{
+		jassertfalse;
+		return 0;
+	}
+	float threshold;
+	memcpy(&threshold, m_data + SPIKE_BASE_SIZE + chan * sizeof(float), sizeof(float));
+	return threshold;
+}
+
+const float* SpikeView::getDataPointer() const
+{
+	return reinterpret_cast<const float*>(m_data + SPIKE_BASE_SIZE + m_channelInfo->getNumChannels() * sizeof(float));
+}
+
+const float* SpikeView::getDataPointer(int channel) const
+{
+	if ((channel < 0) || (channel >= m_channelInfo->getNumChannels()))
+	{
+		jassertfalse;
+		return nullptr;
+	}
+	return getDataPointer() + channel * m_channelInfo->getTotalSamples();
+}
+
+const void* SpikeView::getMetaDataPointer(int index) const
+{
+	if ((index < 0) || (index >= m_channelInfo->getEventMetaDataCount()))
+	{
+		jassertfalse;
+		return nullptr;
+	}
+	return m_data + SPIKE_BASE_SIZE + m_channelInfo->getNumChannels() * sizeof(float) + m_channelInfo->getDataSize()
+		+ getMetaDataOffset(m_channelInfo, index);
+}
+
 //Template definitions
 template PLUGIN_API BinaryEventPtr BinaryEvent::createBinaryEvent<int8>(const EventChannel*, juce::int64, const int8* data, int, uint16);
 template PLUGIN_API BinaryEventPtr BinaryEvent::createBinaryEvent<uint8>(const EventChannel*, juce::int64, const uint8* data, int, uint16);
@@ -28,6 +28,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../Channel/InfoObjects.h"
 #define EVENT_BASE_SIZE 18
 #define SPIKE_BASE_SIZE 18
+#define TIMESTAMP_AND_SAMPLES_SIZE 20
+
+/* Identifier of the spike metadata that holds the projections of the waveform on its principal components,
+as floats. Record engines that export spike features for offline sorting look for it */
+#define SPIKE_PCA_METADATA_ID "spike.features.pca"
 
 class GenericProcessor;
 
@@ -63,6 +68,8 @@ class TTLEvent;
 class TextEvent;
 class BinaryEvent;
 class SpikeEvent;
+class EventView;
+class SpikeView;
 
 enum EventType
 {
@@ -119,6 +126,8 @@ class PLUGIN_API SystemEvent
 {
 public:
 	static size_t fillTimestampAndSamplesData(HeapBlock<char>& data, const GenericProcessor* proc, int16 subProcessorIdx, juce::int64 timestamp, uint32 nSamples);
+	/** Writes the TIMESTAMP_AND_SAMPLES_SIZE bytes of the same event into existing storage */
+	static void writeTimestampAndSamplesData(void* dst, const GenericProcessor* proc, int16 subProcessorIdx, juce::int64 timestamp, uint32 nSamples);
 	static size_t fillTimestampSyncTextData(HeapBlock<char>& data, const GenericProcessor* proc, int16 subProcessorIdx, juce::int64 timestamp, bool softwareTime = false);
 	static SystemEventType getSystemEventType(const MidiMessage& msg);
 	static uint32 getNumSamples(const MidiMessage& msg);
@@ -155,6 +164,10 @@ protected:
 	bool serializeHeader(EventChannel::EventChannelTypes type, char* buffer, size_t dstSize) const;
 	static bool createChecks(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, uint16 channel);
 	static bool createChecks(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, uint16 channel, const MetaDataValueArray& metaData);
+	/** Checks for the serializeXXXEvent methods, whose metadata is already serialized and can only be null for channels without any */
+	static bool serializeChecks(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, uint16 channel, const void* metaData, size_t dstSize);
+	/** Writes the header and metadata around data already copied after EVENT_BASE_SIZE */
+	static void serializeEnvelope(const EventChannel* channelInfo, EventChannel::EventChannelTypes eventType, juce::int64 timestamp, uint16 channel, const void* metaData, char* buffer);
 
 	const uint16 m_channel;
 	const EventChannel* m_channelInfo;
@@ -164,6 +177,16 @@ protected:
 
 };
 
+/** A change of a single TTL line, used to add TTL events in batches without creating TTLEvent objects.
+eventData points to the full TTL word after the change, of channelInfo->getDataSize() bytes */
+struct TTLEdge
+{
+	juce::int64 timestamp;
+	const void* eventData;
+	int sampleNum;
+	uint16 channel;
+};
+
 typedef ScopedPointer<TTLEvent> TTLEventPtr;
 class PLUGIN_API TTLEvent
 	: public Event
@@ -183,6 +206,15 @@ public:
 	static TTLEventPtr createTTLEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* eventData, int dataSize, uint16 channel);
 	static TTLEventPtr createTTLEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* eventData, int dataSize, const MetaDataValueArray& metaData, uint16 channel);
 	static TTLEventPtr deserializeFromMessage(const MidiMessage& msg, const EventChannel* channelInfo);
+
+	/** Writes the same message serialize() would for a TTL event, without creating the event.
+	eventData must hold channelInfo->getDataSize() bytes, and metaData the channel's event metadata laid out
+	as by a MetaDataBuilder, if it has any */
+	static bool serializeTTLEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* eventData, uint16 channel, void* dstBuffer, size_t dstSize, const void* metaData = nullptr);
+
+	/** Like serializeTTLEvent, for an event whose TTL word only has the bit of its own line set, or none
+	if the line went low */
+	static bool serializeTTLEdge(const EventChannel* channelInfo, juce::int64 timestamp, uint16 channel, bool state, void* dstBuffer, size_t dstSize, const void* metaData = nullptr);
 private:
 	TTLEvent() = delete;
 	TTLEvent(const EventChannel* channelInfo, juce::int64 timestamp, uint16 channel, const void* eventData);
@@ -205,6 +237,12 @@ public:
 	static TextEventPtr createTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const String& text, uint16 channel = 0);
 	static TextEventPtr createTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const String& text, const MetaDataValueArray& metaData, uint16 channel = 0);
 	static TextEventPtr deserializeFromMessage(const MidiMessage& msg, const EventChannel* channelInfo);
+
+	/** Writes the same message serialize() would for a text event, without creating the event. See serializeTTLEvent */
+	static bool serializeTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const String& text, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize);
+
+	/** Same as above, for text already encoded as numBytes of UTF-8, so no String has to be created */
+	static bool serializeTextEvent(const EventChannel* channelInfo, juce::int64 timestamp, const char* utf8, size_t numBytes, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize);
 private:
 	TextEvent() = delete;
 	TextEvent(const EventChannel* channelInfo, juce::int64 timestamp, uint16 channel, const String& text);
@@ -233,6 +271,10 @@ public:
 	static BinaryEventPtr createBinaryEvent(const EventChannel* channelInfo, juce::int64 timestamp, const T* data, int dataSize, const MetaDataValueArray& metaData, uint16 channel = 0);
 
 	static BinaryEventPtr deserializeFromMessage(const MidiMessage& msg, const EventChannel* channelInfo);
+
+	/** Writes the same message serialize() would for a binary event, without creating the event. data is of
+	the channel's binary type and holds at least dataSize bytes. See TTLEvent::serializeTTLEvent */
+	static bool serializeBinaryEvent(const EventChannel* channelInfo, juce::int64 timestamp, const void* data, int dataSize, uint16 channel, const void* metaData, void* dstBuffer, size_t dstSize);
 	
 private:
 	BinaryEvent() = delete;
@@ -300,6 +342,13 @@ public:
 	static SpikeEventPtr createSpikeEvent(const SpikeChannel* channelInfo, juce::int64 timestamp, Array<float> thresholds, SpikeBuffer& dataSource, uint16 sortedID, const MetaDataValueArray& metaData);
 
 	static SpikeEventPtr deserializeFromMessage(const MidiMessage& msg, const SpikeChannel* channelInfo);
+
+	/** Writes a spike event straight into existing storage, of at least getDataSize() + getTotalEventMetaDataSize()
+	+ SPIKE_BASE_SIZE + 4 * getNumChannels() bytes, without creating a SpikeEvent. The buffer stays valid, so detectors
+	can keep one per spike channel instead of allocating one for every spike. thresholds holds a value per channel.
+	metaData holds the getTotalEventMetaDataSize() bytes of the channel's event metadata values, in order, and
+	can only be null when the channel has no event metadata. */
+	static bool serializeSpikeEvent(const SpikeChannel* channelInfo, juce::int64 timestamp, const float* thresholds, const SpikeBuffer& dataSource, uint16 sortedID, const void* metaData, void* dstBuffer, size_t dstSize);
 private:
 	SpikeEvent() = delete;
 	SpikeEvent(const SpikeChannel* channelInfo, juce::int64 timestamp, Array<float> thresholds, HeapBlock<float>& data, uint16 sortedID);
@@ -312,5 +361,80 @@ private:
 	JUCE_LEAK_DETECTOR(SpikeEvent);
 };
 
+/**
+Non-owning view of a serialized TTL, text or binary event that reads its fields in place from the
+message bytes, without creating an Event nor copying its payload and metadata. Handlers that only
+read a few fields should prefer it to Event::deserializeFromMessage:
+
+	EventView ttl(event, eventInfo);
+	if (ttl.isValid() && ttl.getChannel() == triggerChannel && ttl.getState())
+		...
+
+It is only valid while the message is, that is, within handleEvent.
+*/
+class PLUGIN_API EventView
+{
+public:
+	/** Does the same checks as Event::deserializeFromMessage, leaving the view invalid if they fail */
+	EventView(const MidiMessage& msg, const EventChannel* channelInfo);
+
+	bool isValid() const;
+
+	EventChannel::EventChannelTypes getEventType() const;
+	const EventChannel* getChannelInfo() const;
+	juce::int64 getTimestamp() const;
+	uint16 getSourceID() const;
+	uint16 getSubProcessorIdx() const;
+	uint16 getSourceIndex() const;
+	/** Gets the channel that triggered the event */
+	uint16 getChannel() const;
+
+	/** Gets the raw data payload, of getChannelInfo()->getDataSize() bytes */
+	const void* getRawDataPointer() const;
+	/** For TTL events, whether the event's channel went high */
+	bool getState() const;
+	/** For text events, the text */
+	String getText() const;
+
+	/** Gets the serialized value of an event metadata field, of the type and length of its descriptor */
+	const void* getMetaDataPointer(int index) const;
+
+private:
+	const uint8* m_data;
+	const EventChannel* m_channelInfo;
+};
+
+/** Non-owning view of a serialized spike, like EventView, or of the spike a compact
+	message refers to in the SpikeStore. Valid only within handleSpike */
+class PLUGIN_API SpikeView
+{
+public:
+	/** Does the same checks as SpikeEvent::deserializeFromMessage, leaving the view invalid if they fail */
+	SpikeView(const MidiMessage& msg, const SpikeChannel* channelInfo);
+
+	bool isValid() const;
+
+	const SpikeChannel* getChannelInfo() const;
+	juce::int64 getTimestamp() const;
+	uint16 getSourceID() const;
+	uint16 getSubProcessorIdx() const;
+	uint16 getSourceIndex() const;
+	uint16 getSortedID() const;
+
+	float getThreshold(int chan) const;
+
+	/** The waveforms, channel after channel. The message bytes are not aligned, so read them with memcpy
+	on platforms that require aligned floats */
+	const float* getDataPointer() const;
+	const float* getDataPointer(int channel) const;
+
+	/** Gets the serialized value of an event metadata field, of the type and length of its descriptor */
+	const void* getMetaDataPointer(int index) const;
+
+private:
+	const uint8* m_data;
+	const SpikeChannel* m_channelInfo;
+};
+
 
 #endif
@@ -0,0 +1,135 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SpikeStore.h"
+#include "Events.h"
+
+SpikeStore* SpikeStore::getInstance()
+{
+	static SpikeStore store;
+	return &store;
+}
+
+SpikeStore::SpikeStore() :
+	m_used(0),
+	m_enabled(0),
+	m_generation(0),
+	m_running(false)
+{
+}
+
+void SpikeStore::setEnabled(bool enabled)
+{
+	m_enabled = enabled ? 1 : 0;
+}
+
+bool SpikeStore::isEnabled() const
+{
+	return m_enabled.get() != 0;
+}
+
+void SpikeStore::start()
+{
+	const ScopedLock sl(startStopLock);
+
+	if (m_running)
+		return;
+
+	m_arena.allocate(SPIKE_STORE_SIZE, false);
+	m_used = 0;
+	m_running = true;
+}
+
+void SpikeStore::stop()
+{
+	const ScopedLock sl(startStopLock);
+
+	m_running = false;
+	m_used = SPIKE_STORE_SIZE;
+	m_arena.free();
+}
+
+void SpikeStore::startBlock()
+{
+	if (!m_running)
+		return;
+
+	++m_generation;
+	m_used = 0;
+}
+
+uint8* SpikeStore::allocate(size_t size, SpikeHandle& handle)
+{
+	if (!m_running || m_enabled.get() == 0 || size > SPIKE_STORE_SIZE)
+		return nullptr;
+
+	//keep every spike 8-byte aligned
+	const int alignedSize = (int(size) + 7) & ~7;
+	const int end = (m_used += alignedSize);
+
+	if (end > SPIKE_STORE_SIZE)
+		return nullptr;
+
+	handle.generation = m_generation;
+	handle.offset = uint32(end - alignedSize);
+	handle.size = uint32(size);
+
+	return m_arena + handle.offset;
+}
+
+const uint8* SpikeStore::resolve(const SpikeHandle& handle) const
+{
+	if (!m_running || handle.generation != m_generation || handle.offset + handle.size > SPIKE_STORE_SIZE)
+		return nullptr;
+
+	return m_arena + handle.offset;
+}
+
+void SpikeStore::writeMessage(const uint8* spike, const SpikeHandle& handle, uint8* dst)
+{
+	memcpy(dst, spike, SPIKE_BASE_SIZE);
+	dst[1] |= SPIKE_STORE_FLAG;
+	memcpy(dst + SPIKE_BASE_SIZE, &handle, sizeof(SpikeHandle));
+}
+
+bool SpikeStore::isCompact(const MidiMessage& msg)
+{
+	return msg.getRawDataSize() == SPIKE_STORE_MESSAGE_SIZE
+		&& (msg.getRawData()[1] & SPIKE_STORE_FLAG) != 0;
+}
+
+const uint8* SpikeStore::getSpikeData(const MidiMessage& msg, size_t& size)
+{
+	if (!isCompact(msg))
+	{
+		size = msg.getRawDataSize();
+		return msg.getRawData();
+	}
+
+	SpikeHandle handle;
+	memcpy(&handle, msg.getRawData() + SPIKE_BASE_SIZE, sizeof(SpikeHandle));
+
+	const uint8* spike = getInstance()->resolve(handle);
+	size = spike != nullptr ? handle.size : 0;
+	return spike;
+}
@@ -0,0 +1,113 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SPIKESTORE_H_INCLUDED
+#define SPIKESTORE_H_INCLUDED
+
+#include <JuceHeader.h>
+#include "../PluginManager/OpenEphysPlugin.h"
+
+/* Bytes of spikes the store can hold per block; when it fills up, spikes are sent inline */
+#define SPIKE_STORE_SIZE (4 * 1024 * 1024)
+
+/* Set in the electrode type byte of a spike message that carries a SpikeHandle instead of the spike.
+Electrode types are all below 128, so a full spike never has it set. */
+#define SPIKE_STORE_FLAG 0x80
+
+/** Locates a spike in the SpikeStore */
+struct SpikeHandle
+{
+	uint32 generation;	// the block the spike was stored in
+	uint32 offset;
+	uint32 size;		// size of the serialized spike
+};
+
+/* Size of a compact spike message: the spike header followed by its handle */
+#define SPIKE_STORE_MESSAGE_SIZE (SPIKE_BASE_SIZE + sizeof(SpikeHandle))
+
+/**
+	Holds the serialized spikes of the current block, so spike messages only carry a handle
+	through the MidiBuffers of the downstream processors instead of the whole waveform.
+
+	The store is emptied at the start of every block of the ProcessorGraph, so a stored spike
+	can only be resolved during the block it was added in. Processors that keep spikes for
+	later must copy them, as SpikeEvent::deserializeFromMessage does.
+
+	A compact message keeps the spike header, so the type, source and timestamp of the
+	spike can be read from it as usual; the waveform must be read through SpikeEvent or
+	SpikeView, which resolve the handle with getSpikeData().
+
+	@see GenericProcessor::addSpike, SpikeView
+*/
+class PLUGIN_API SpikeStore
+{
+public:
+	static SpikeStore* getInstance();
+
+	/** Enables the compact spike messages. Disabled by default, as it changes the layout of spike
+		messages for processors that read their raw data or keep them past the block. Set from
+		the Edit menu, while acquisition is stopped. */
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	/** Allocates the store. Called by the ProcessorGraph when acquisition starts. */
+	void start();
+
+	/** Frees the store. Called by the ProcessorGraph when acquisition stops. */
+	void stop();
+
+	/** Empties the store. Called by the ProcessorGraph before each block is processed. */
+	void startBlock();
+
+	/** Reserves size bytes for a serialized spike and fills its handle. Safe to call from
+		concurrent processors. Returns nullptr if the store is disabled, stopped or full. */
+	uint8* allocate(size_t size, SpikeHandle& handle);
+
+	/** The serialized spike of a handle, or nullptr if it was stored in an earlier block */
+	const uint8* resolve(const SpikeHandle& handle) const;
+
+	/** Writes the compact message of a spike stored at handle into dst, which must hold
+		SPIKE_STORE_MESSAGE_SIZE bytes */
+	static void writeMessage(const uint8* spike, const SpikeHandle& handle, uint8* dst);
+
+	/** True if a spike message carries a handle instead of the spike */
+	static bool isCompact(const MidiMessage& msg);
+
+	/** The serialized spike of a message and its size: the message itself if it is not
+		compact, or the stored spike if it is. Returns nullptr if the handle is stale. */
+	static const uint8* getSpikeData(const MidiMessage& msg, size_t& size);
+
+private:
+	SpikeStore();
+
+	HeapBlock<uint8> m_arena;
+	Atomic<int> m_used;
+	Atomic<int> m_enabled;
+	uint32 m_generation;
+	bool m_running;
+	CriticalSection startStopLock;
+
+	JUCE_DECLARE_NON_COPYABLE(SpikeStore);
+};
+
+#endif  // SPIKESTORE_H_INCLUDED
@@ -0,0 +1,215 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SpikeWaveformStore.h"
+#include "Events.h"
+
+SpikeWaveformStore* SpikeWaveformStore::getInstance()
+{
+	static SpikeWaveformStore store;
+	return &store;
+}
+
+SpikeWaveformStore::SpikeWaveformStore()
+{
+}
+
+juce::uint64 SpikeWaveformStore::getKey(const SpikeChannel* electrode)
+{
+	return (juce::uint64(electrode->getSourceNodeID()) << 32)
+		| (juce::uint64(electrode->getSubProcessorIdx()) << 16)
+		| juce::uint64(electrode->getSourceIndex());
+}
+
+void SpikeWaveformStore::setElectrodes(const Array<const SpikeChannel*>& electrodes)
+{
+	OwnedArray<Electrode> kept;
+	std::unordered_map<juce::uint64, Electrode*> keptMap;
+
+	for (auto channel : electrodes)
+	{
+		const juce::uint64 key = getKey(channel);
+		if (keptMap.count(key) > 0)
+			continue;
+
+		const int numChannels = channel->getNumChannels();
+		const int numSamples = channel->getTotalSamples();
+
+		auto found = m_electrodeMap.find(key);
+		Electrode* electrode = found != m_electrodeMap.end() ? found->second : nullptr;
+
+		if (electrode != nullptr && electrode->numChannels == numChannels && electrode->numSamples == numSamples)
+		{
+			m_electrodes.removeObject(electrode, false);
+		}
+		else
+		{
+			electrode = new Electrode();
+			electrode->numChannels = numChannels;
+			electrode->numSamples = numSamples;
+			electrode->waveformSize = numChannels * numSamples;
+			electrode->timestamps.calloc(SPIKE_WAVEFORM_STORE_SPIKES);
+			electrode->sortedIds.calloc(SPIKE_WAVEFORM_STORE_SPIKES);
+			electrode->thresholds.calloc(SPIKE_WAVEFORM_STORE_SPIKES * numChannels);
+			electrode->waveforms.calloc(SPIKE_WAVEFORM_STORE_SPIKES * electrode->waveformSize);
+			electrode->written = 0;
+		}
+
+		kept.add(electrode);
+		keptMap[key] = electrode;
+	}
+
+	//the electrodes that are no longer kept are deleted with the old array
+	m_electrodes.swapWith(kept);
+	m_electrodeMap.swap(keptMap);
+}
+
+void SpikeWaveformStore::add(const SpikeChannel* electrode, const uint8* spike)
+{
+	auto found = m_electrodeMap.find(getKey(electrode));
+	if (found == m_electrodeMap.end())
+		return;
+
+	Electrode& e = *found->second;
+	const juce::int64 position = e.written.get();
+	const int slot = int(position % SPIKE_WAVEFORM_STORE_SPIKES);
+
+	memcpy(e.timestamps + slot, spike + 8, sizeof(juce::int64));
+	memcpy(e.sortedIds + slot, spike + 16, sizeof(uint16));
+	memcpy(e.thresholds + slot * e.numChannels, spike + SPIKE_BASE_SIZE, e.numChannels * sizeof(float));
+	memcpy(e.waveforms + slot * e.waveformSize, spike + SPIKE_BASE_SIZE + e.numChannels * sizeof(float),
+		e.waveformSize * sizeof(float));
+
+	//published after its slot is written
+	e.written = position + 1;
+}
+
+const SpikeWaveformStore::Electrode* SpikeWaveformStore::getElectrode(const SpikeChannel* electrode) const
+{
+	if (electrode == nullptr)
+		return nullptr;
+
+	auto found = m_electrodeMap.find(getKey(electrode));
+	return found != m_electrodeMap.end() ? found->second : nullptr;
+}
+
+juce::int64 SpikeWaveformStore::getNumWritten(const SpikeChannel* electrode) const
+{
+	const Electrode* e = getElectrode(electrode);
+	return e != nullptr ? e->written.get() : 0;
+}
+
+int SpikeWaveformStore::readNew(const SpikeChannel* electrode, juce::int64& position, int maxSpikes, Spikes& spikes) const
+{
+	const Electrode* e = getElectrode(electrode);
+	if (e == nullptr)
+	{
+		spikes = Spikes();
+		return 0;
+	}
+
+	const juce::int64 written = e->written.get();
+
+	//a position past the end is from an electrode that has been set up again
+	if (position < 0 || position > written)
+		position = written;
+
+	//the oldest slot may be being overwritten by the next spike
+	const juce::int64 first = jmax(position, written - SPIKE_WAVEFORM_STORE_SPIKES + 1);
+
+	Array<juce::int64> positions;
+	for (juce::int64 p = first; p < written; ++p)
+		positions.add(p);
+
+	position = written;
+
+	return copySpikes(*e, positions, maxSpikes, spikes);
+}
+
+int SpikeWaveformStore::readRange(const SpikeChannel* electrode, juce::int64 start, juce::int64 end, int maxSpikes, Spikes& spikes) const
+{
+	const Electrode* e = getElectrode(electrode);
+	if (e == nullptr)
+	{
+		spikes = Spikes();
+		return 0;
+	}
+
+	const juce::int64 written = e->written.get();
+
+	Array<juce::int64> positions;
+	for (juce::int64 p = jmax(juce::int64(0), written - SPIKE_WAVEFORM_STORE_SPIKES + 1); p < written; ++p)
+	{
+		const juce::int64 timestamp = e->timestamps[int(p % SPIKE_WAVEFORM_STORE_SPIKES)];
+		if (timestamp >= start && timestamp < end)
+			positions.add(p);
+	}
+
+	return copySpikes(*e, positions, maxSpikes, spikes);
+}
+
+int SpikeWaveformStore::copySpikes(const Electrode& electrode, const Array<juce::int64>& positions, int maxSpikes, Spikes& spikes)
+{
+	spikes.numChannels = electrode.numChannels;
+	spikes.numSamples = electrode.numSamples;
+	spikes.timestamps.clearQuick();
+	spikes.sortedIds.clearQuick();
+	spikes.thresholds.clearQuick();
+	spikes.waveforms.clearQuick();
+
+	const int numPositions = positions.size();
+	const int numSpikes = jmin(numPositions, jmax(0, maxSpikes));
+
+	Array<juce::int64> copied;
+	for (int k = 0; k < numSpikes; ++k)
+	{
+		const juce::int64 position = positions.getUnchecked(int(juce::int64(k) * numPositions / numSpikes));
+		const int slot = int(position % SPIKE_WAVEFORM_STORE_SPIKES);
+
+		const float* thresholds = electrode.thresholds + slot * electrode.numChannels;
+		const float* waveform = electrode.waveforms + slot * electrode.waveformSize;
+
+		spikes.timestamps.add(electrode.timestamps[slot]);
+		spikes.sortedIds.add(electrode.sortedIds[slot]);
+		spikes.thresholds.addArray(thresholds, electrode.numChannels);
+		spikes.waveforms.addArray(waveform, electrode.waveformSize);
+		copied.add(position);
+	}
+
+	//the positions are in order, so the spikes overwritten during the copy are the first ones
+	const juce::int64 oldestValid = electrode.written.get() - SPIKE_WAVEFORM_STORE_SPIKES + 1;
+
+	int numOverwritten = 0;
+	while (numOverwritten < copied.size() && copied.getUnchecked(numOverwritten) < oldestValid)
+		++numOverwritten;
+
+	if (numOverwritten > 0)
+	{
+		spikes.timestamps.removeRange(0, numOverwritten);
+		spikes.sortedIds.removeRange(0, numOverwritten);
+		spikes.thresholds.removeRange(0, numOverwritten * electrode.numChannels);
+		spikes.waveforms.removeRange(0, numOverwritten * electrode.waveformSize);
+	}
+
+	return spikes.size();
+}
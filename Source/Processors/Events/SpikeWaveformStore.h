@@ -0,0 +1,125 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SPIKEWAVEFORMSTORE_H_INCLUDED
+#define SPIKEWAVEFORMSTORE_H_INCLUDED
+
+#include <JuceHeader.h>
+#include "../PluginManager/OpenEphysPlugin.h"
+
+#include <unordered_map>
+
+class SpikeChannel;
+
+/* Most recent spikes kept per electrode */
+#define SPIKE_WAVEFORM_STORE_SPIKES 512
+
+/**
+	Keeps the most recent spikes of every electrode, so spike viewers can read them without
+	each one receiving, copying and holding the whole spike stream.
+
+	Each spike is written once, by GenericProcessor::addSpike in the processor that created its
+	spike channel, into a ring of SPIKE_WAVEFORM_STORE_SPIKES spikes of that electrode. Viewers
+	read copies of the spikes by electrode, either those written since their last read or those
+	in a range of timestamps, decimated to as many spikes as they can draw. An electrode is
+	identified by the source of its spike channel, so any copy of the channel downstream of the
+	detector finds it.
+
+	Writing never waits for readers: a reader that falls behind by more than the ring skips the
+	spikes that were overwritten. The electrodes are set by the ProcessorGraph when acquisition
+	starts, from the message thread, which is also where viewers are expected to read them.
+
+	@see GenericProcessor::addSpike, SpikeStore
+*/
+class PLUGIN_API SpikeWaveformStore
+{
+public:
+	/** Copies of spikes of an electrode, filled by the read methods */
+	struct Spikes
+	{
+		int numChannels = 0;
+		int numSamples = 0;
+		Array<juce::int64> timestamps;
+		Array<uint16> sortedIds;
+		Array<float> thresholds;	// numChannels per spike
+		Array<float> waveforms;		// numChannels * numSamples per spike, channel after channel
+
+		int size() const { return timestamps.size(); }
+		const float* getThresholds(int spike) const { return thresholds.begin() + spike * numChannels; }
+		const float* getWaveform(int spike) const { return waveforms.begin() + spike * numChannels * numSamples; }
+	};
+
+	static SpikeWaveformStore* getInstance();
+
+	/** Sets the electrodes spikes are kept for. Electrodes that were already kept, with the same
+		shape, keep their spikes. Called by the ProcessorGraph when acquisition starts. */
+	void setElectrodes(const Array<const SpikeChannel*>& electrodes);
+
+	/** Keeps a serialized spike of an electrode, laid out as by SpikeEvent::serializeSpikeEvent.
+		Spikes of electrodes that are not kept are ignored. Each electrode must only be written
+		from one thread at a time. */
+	void add(const SpikeChannel* electrode, const uint8* spike);
+
+	/** Number of spikes written to an electrode so far, or 0 if it is not kept */
+	juce::int64 getNumWritten(const SpikeChannel* electrode) const;
+
+	/** Copies the spikes of an electrode written since position, at most maxSpikes of them, spread
+		evenly over the spikes available if there are more, and moves position past the last spike
+		written. A negative position skips the spikes written before the call. Returns the number
+		of spikes copied. */
+	int readNew(const SpikeChannel* electrode, juce::int64& position, int maxSpikes, Spikes& spikes) const;
+
+	/** Copies the spikes of an electrode with timestamps from start up to end, excluded, decimated
+		like readNew. Returns the number of spikes copied. */
+	int readRange(const SpikeChannel* electrode, juce::int64 start, juce::int64 end, int maxSpikes, Spikes& spikes) const;
+
+private:
+	SpikeWaveformStore();
+
+	struct Electrode
+	{
+		int numChannels;
+		int numSamples;
+		int waveformSize;
+		HeapBlock<juce::int64> timestamps;
+		HeapBlock<uint16> sortedIds;
+		HeapBlock<float> thresholds;
+		HeapBlock<float> waveforms;
+		Atomic<juce::int64> written;
+	};
+
+	static juce::uint64 getKey(const SpikeChannel* electrode);
+
+	const Electrode* getElectrode(const SpikeChannel* electrode) const;
+
+	/** Copies the spikes of a list of positions, evenly spread over it if it has more than maxSpikes,
+		leaving out any that were overwritten while they were copied */
+	static int copySpikes(const Electrode& electrode, const Array<juce::int64>& positions, int maxSpikes, Spikes& spikes);
+
+	OwnedArray<Electrode> m_electrodes;
+	std::unordered_map<juce::uint64, Electrode*> m_electrodeMap;
+
+	JUCE_DECLARE_NON_COPYABLE(SpikeWaveformStore);
+};
+
+#endif  // SPIKEWAVEFORMSTORE_H_INCLUDED
@@ -22,9 +22,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "BinaryFileSource.h"
+#include "NpyReader.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace BinarySource;
 
+/* processAllChannelData() converts tiles of this many samples by this many channels, which fit in L1 */
+#define TILE_SAMPLES 16
+#define TILE_CHANNELS 64
+
+/* Event files are prefetched this many records ahead of the read position */
+#define EVENT_PREFETCH_RECORDS 4096
+
 BinaryFileSource::BinaryFileSource() : m_samplePos(0)
 {}
 
@@ -72,6 +85,10 @@ void BinaryFileSource::fillRecordInfo()
 	Identifier idChannels("channels");
 	Identifier idChannelName("channel_name");
 	Identifier idBitVolts("bit_volts");
+	Identifier idCompression("compression");
+	Identifier idDataFile("data_file");
+	Identifier idIndexFile("index_file");
+	Identifier idLayout("layout");
 
 	int numProcessors = continuousData.size();
 
@@ -88,11 +105,34 @@ void BinaryFileSource::fillRecordInfo()
 		String folderName = record[idFolder];
 		folderName = folderName.trimCharactersAtEnd("/");
 
-		File dataFile = m_rootPath.getChildFile("continuous").getChildFile(folderName).getChildFile("continuous.dat");
+		File folder = m_rootPath.getChildFile("continuous").getChildFile(folderName);
+		bool compressed = !record[idCompression].isVoid();
+		bool chunked = record[idLayout].toString() == "channel-major";
+		File dataFile = folder.getChildFile(compressed || chunked ? record[idDataFile].toString() : String("continuous.dat"));
 		if (!dataFile.existsAsFile()) continue;
 
 		int numChannels = record[idNumChannels];
-		int64 numSamples = (dataFile.getSize() / numChannels) / sizeof(int16);
+		int64 numSamples;
+		File indexFile;
+
+		if (compressed)
+		{
+			indexFile = folder.getChildFile(record[idIndexFile].toString());
+			CompressedContinuousReader reader;
+			if (!reader.open(dataFile, indexFile, numChannels)) continue;
+			numSamples = reader.getNumSamples();
+		}
+		else if (chunked)
+		{
+			indexFile = folder.getChildFile(record[idIndexFile].toString());
+			ChunkedContinuousReader reader;
+			if (!reader.open(dataFile, indexFile, numChannels)) continue;
+			numSamples = reader.getNumSamples();
+		}
+		else
+		{
+			numSamples = (dataFile.getSize() / numChannels) / sizeof(int16);
+		}
 
 		info.name = folderName;
 		info.sampleRate = record[idSampleRate];
@@ -113,6 +153,9 @@ void BinaryFileSource::fillRecordInfo()
 		numRecords++;	
 
 		m_dataFileArray.add(dataFile);
+		m_indexFileArray.add(indexFile);
+		m_chunkedRecords.add(chunked);
+		m_recordJson.add(record);
 		
 	}
 
@@ -120,8 +163,152 @@ void BinaryFileSource::fillRecordInfo()
 
 void BinaryFileSource::updateActiveRecord()
 {
-	m_dataFile = new MemoryMappedFile(m_dataFileArray[activeRecord.get()], MemoryMappedFile::readOnly);
+	int record = activeRecord.get();
+	m_dataFile = nullptr;
+	m_compressedReader = nullptr;
+	m_chunkedReader = nullptr;
+
+	if (m_chunkedRecords[record])
+	{
+		m_chunkedReader = new ChunkedContinuousReader();
+		m_chunkedReader->open(m_dataFileArray[record], m_indexFileArray[record], getActiveNumChannels());
+	}
+	else if (m_indexFileArray[record] != File::nonexistent)
+	{
+		m_compressedReader = new CompressedContinuousReader();
+		m_compressedReader->open(m_dataFileArray[record], m_indexFileArray[record], getActiveNumChannels());
+	}
+	else
+	{
+		m_dataFile = new MemoryMappedFile(m_dataFileArray[record], MemoryMappedFile::readOnly);
+
+#if JUCE_LINUX || JUCE_MAC
+		// playback walks the file front to back, so let the kernel read ahead aggressively
+		if (m_dataFile->getData() != nullptr)
+			madvise(m_dataFile->getData(), m_dataFile->getSize(), MADV_SEQUENTIAL);
+#endif
+	}
 	m_samplePos = 0;
+
+	const int numChannels = getActiveNumChannels();
+	m_bitVolts.malloc(jmax(1, numChannels));
+
+	m_activeChannels.clearQuick();
+
+	for (int c = 0; c < numChannels; c++)
+	{
+		m_bitVolts[c] = getChannelInfo(c).bitVolts;
+		m_activeChannels.add(c);
+	}
+
+	// left closed when the record was not synchronized
+	const File recordFolder = m_dataFileArray[record].getParentDirectory();
+
+	if (!m_syncSegments.open(recordFolder.getChildFile("synchronized_timestamp_segments.npy"), "f8", 3))
+		m_syncTimes.open(recordFolder.getChildFile("synchronized_timestamps.npy"), "f8");
+
+	openEventStreams();
+}
+
+void BinaryFileSource::openEventStreams()
+{
+	m_eventStreams.clear();
+
+	const int record = activeRecord.get();
+	const String prefix = getRecordName(record) + "/";
+	const File eventRoot = m_rootPath.getChildFile("events");
+	const File spikeRoot = m_rootPath.getChildFile("spikes");
+
+	var events = m_jsonData["events"];
+
+	for (int e = 0; e < events.size(); e++)
+	{
+		String folderName = events[e]["folder_name"];
+		if (!folderName.startsWith(prefix) || !folderName.contains("TTL"))
+			continue;
+
+		File folder = eventRoot.getChildFile(folderName.trimCharactersAtEnd("/").replace("/", File::separatorString));
+
+		ScopedPointer<EventStream> stream = new EventStream();
+		if (!stream->timestamps.open(folder.getChildFile("timestamps.npy"), "i8")
+			|| !stream->values.open(folder.getChildFile("channel_states.npy"), "i2"))
+			continue;
+
+		stream->info.type = RecordedEventStreamInfo::TTL;
+		stream->info.name = events[e]["channel_name"].toString();
+		stream->info.numChannels = jlimit(1, 64, (int)events[e]["num_channels"]);
+		stream->numEvents = jmin(stream->timestamps.getNumRecords(), stream->values.getNumRecords());
+
+		m_eventStreams.add(stream.release());
+	}
+
+	// spike_electrode_indices refer to the electrodes of a group, and the source channels of each
+	// electrode to the source processor's channels, which the record lists by source_processor_index
+	var recordChannels = m_recordJson[record]["channels"];
+	var spikes = m_jsonData["spikes"];
+
+	for (int s = 0; s < spikes.size(); s++)
+	{
+		var group = spikes[s];
+		if ((float)group["sample_rate"] != getRecordSampleRate(record))
+			continue;
+
+		var electrodes = group["channels"];
+		if (electrodes.size() <= 0)
+			continue;
+
+		ScopedPointer<EventStream> stream = new EventStream();
+		stream->info.type = RecordedEventStreamInfo::SPIKE;
+		stream->info.name = group["folder_name"].toString().trimCharactersAtEnd("/");
+		stream->info.numElectrodes = electrodes.size();
+		stream->info.numChannels = jmax(1, electrodes[0]["source_channel_info"].size());
+		stream->info.prePeakSamples = group["pre_peak_samples"];
+		stream->info.postPeakSamples = group["post_peak_samples"];
+
+		for (int el = 0; el < electrodes.size(); el++)
+		{
+			var sourceInfo = electrodes[el]["source_channel_info"];
+
+			for (int c = 0; c < stream->info.numChannels; c++)
+			{
+				int sourceIndex = sourceInfo[c]["source_processor_channel"];
+				int channel = jlimit(0, getRecordNumChannels(record) - 1, sourceIndex);
+
+				for (int rc = 0; rc < recordChannels.size(); rc++)
+				{
+					if ((int)recordChannels[rc]["source_processor_index"] == sourceIndex)
+					{
+						channel = rc;
+						break;
+					}
+				}
+
+				stream->info.sourceChannels.add(channel);
+			}
+		}
+
+		const int waveformSamples = stream->info.numChannels * (stream->info.prePeakSamples + stream->info.postPeakSamples);
+		File folder = spikeRoot.getChildFile(stream->info.name.replace("/", File::separatorString));
+
+		if (waveformSamples <= 0
+			|| !stream->timestamps.open(folder.getChildFile("spike_times.npy"), "i8")
+			|| !stream->values.open(folder.getChildFile("spike_electrode_indices.npy"), "u2")
+			|| !stream->clusters.open(folder.getChildFile("spike_clusters.npy"), "u2")
+			|| !stream->waveforms.open(folder.getChildFile("spike_waveforms.npy"), "i2", waveformSamples))
+			continue;
+
+		stream->numEvents = jmin(jmin(stream->timestamps.getNumRecords(), stream->values.getNumRecords()),
+			jmin(stream->clusters.getNumRecords(), stream->waveforms.getNumRecords()));
+
+		m_eventStreams.add(stream.release());
+	}
+
+	for (auto stream : m_eventStreams)
+	{
+		stream->cursor = 0;
+		stream->nextTimestamp = -1;
+		stream->prefetchMark = 0;
+	}
 }
 
 void BinaryFileSource::seekTo(int64 sample)
@@ -143,9 +330,18 @@ int BinaryFileSource::readData(int16* buffer, int nSamples)
 		samplesToRead = nSamples;
 	}
 
-	int16* data = static_cast<int16*>(m_dataFile->getData()) + (m_samplePos * nChans);
-
-	memcpy(buffer, data, samplesToRead*nChans*sizeof(int16));
+	if (m_compressedReader != nullptr)
+	{
+		samplesToRead = m_compressedReader->read(buffer, m_samplePos, samplesToRead);
+	}
+	else if (m_chunkedReader != nullptr)
+	{
+		samplesToRead = m_chunkedReader->read(buffer, m_samplePos, samplesToRead);
+	}
+	else
+	{
+		memcpy(buffer, getDataPointer(m_samplePos, samplesToRead), samplesToRead*nChans*sizeof(int16));
+	}
     m_samplePos += samplesToRead;
 	return samplesToRead;
 }
@@ -161,6 +357,378 @@ void BinaryFileSource::processChannelData(int16* inBuffer, float* outBuffer, int
 	}
 }
 
+void BinaryFileSource::setChannelMask(const Array<bool>& mask)
+{
+	FileSource::setChannelMask(mask);
+
+	m_activeChannels.clearQuick();
+
+	for (int c = 0; c < getActiveNumChannels(); c++)
+	{
+		if (isChannelActive(c))
+			m_activeChannels.add(c);
+	}
+
+	if (m_compressedReader != nullptr)
+		m_compressedReader->setChannelMask(mask);
+
+	if (m_chunkedReader != nullptr)
+		m_chunkedReader->setChannelMask(mask);
+}
+
+void BinaryFileSource::processAllChannelData(int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples)
+{
+	const int n = getActiveNumChannels();
+	numChannels = jmin(numChannels, n);
+
+	if (m_activeChannels.size() < n)
+	{
+		convertActiveChannels(inBuffer, outBuffers, numChannels, numSamples);
+		return;
+	}
+
+	// the block is read once, a tile at a time: each row of the tile is converted and
+	// scaled in one contiguous loop, then the tile is transposed into the channel buffers
+	float tile[TILE_SAMPLES][TILE_CHANNELS];
+
+	for (int64 i0 = 0; i0 < numSamples; i0 += TILE_SAMPLES)
+	{
+		const int tileSamples = (int) jmin((int64) TILE_SAMPLES, numSamples - i0);
+
+		for (int c0 = 0; c0 < numChannels; c0 += TILE_CHANNELS)
+		{
+			const int tileChannels = jmin(TILE_CHANNELS, numChannels - c0);
+			const float* bitVolts = m_bitVolts + c0;
+
+			for (int t = 0; t < tileSamples; t++)
+			{
+				const int16* row = inBuffer + (i0 + t) * n + c0;
+				float* dest = tile[t];
+
+				for (int c = 0; c < tileChannels; c++)
+					dest[c] = row[c] * bitVolts[c];
+			}
+
+			for (int c = 0; c < tileChannels; c++)
+			{
+				float* out = outBuffers[c0 + c] + i0;
+
+				for (int t = 0; t < tileSamples; t++)
+					out[t] = tile[t][c];
+			}
+		}
+	}
+}
+
+void BinaryFileSource::convertActiveChannels(int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples)
+{
+	const int n = getActiveNumChannels();
+
+	// as above, with each tile gathered from the active channels only
+	const int* active = m_activeChannels.getRawDataPointer();
+	int numActive = m_activeChannels.size();
+
+	while (numActive > 0 && active[numActive - 1] >= numChannels)
+		numActive--;
+
+	float tile[TILE_SAMPLES][TILE_CHANNELS];
+
+	for (int64 i0 = 0; i0 < numSamples; i0 += TILE_SAMPLES)
+	{
+		const int tileSamples = (int) jmin((int64) TILE_SAMPLES, numSamples - i0);
+
+		for (int k0 = 0; k0 < numActive; k0 += TILE_CHANNELS)
+		{
+			const int tileChannels = jmin(TILE_CHANNELS, numActive - k0);
+			const int* channels = active + k0;
+
+			for (int t = 0; t < tileSamples; t++)
+			{
+				const int16* row = inBuffer + (i0 + t) * n;
+				float* dest = tile[t];
+
+				for (int k = 0; k < tileChannels; k++)
+					dest[k] = row[channels[k]] * m_bitVolts[channels[k]];
+			}
+
+			for (int k = 0; k < tileChannels; k++)
+			{
+				float* out = outBuffers[channels[k]] + i0;
+
+				for (int t = 0; t < tileSamples; t++)
+					out[t] = tile[t][k];
+			}
+		}
+	}
+}
+
+int16* BinaryFileSource::getDataPointer(int64 sample, int64 numSamples)
+{
+	if (m_dataFile == nullptr || m_dataFile->getData() == nullptr)
+		return nullptr;
+
+	if (sample < 0 || sample + numSamples > getActiveNumSamples())
+		return nullptr;
+
+	return static_cast<int16*>(m_dataFile->getData()) + sample * getActiveNumChannels();
+}
+
+void BinaryFileSource::prefetch(int64 sample, int64 numSamples)
+{
+#if JUCE_LINUX || JUCE_MAC
+	if (m_dataFile == nullptr || m_dataFile->getData() == nullptr)
+		return;
+
+	const int64 numChannels = getActiveNumChannels();
+	const int64 totalSamples = getActiveNumSamples();
+
+	sample = jlimit((int64) 0, totalSamples, sample);
+	numSamples = jmin(numSamples, totalSamples - sample);
+
+	if (numSamples <= 0)
+		return;
+
+	// madvise() wants a page-aligned start
+	static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+
+	char* base = static_cast<char*>(m_dataFile->getData());
+	const size_t offset = (size_t) (sample * numChannels * sizeof(int16));
+	const size_t alignedOffset = offset - offset % pageSize;
+	const size_t length = (size_t) (numSamples * numChannels * sizeof(int16)) + offset - alignedOffset;
+
+	madvise(base + alignedOffset, length, MADV_WILLNEED);
+#endif
+}
+
+void BinaryFileSource::fillSeekIndex(FileSeekIndex& index)
+{
+	const int record = activeRecord.get();
+	const int64 numSamples = getActiveNumSamples();
+
+	index.clear(numSamples);
+
+	NpyReader timestamps;
+	if (timestamps.open(m_dataFileArray[record].getParentDirectory().getChildFile("timestamps.npy"), "i8"))
+	{
+		const int64* ts = static_cast<const int64*>(timestamps.getData());
+		const int64 n = jmin(timestamps.getNumRecords(), numSamples);
+
+		// a new block wherever the timestamps don't follow on from the previous sample
+		for (int64 i = 0; i < n; i++)
+		{
+			if (i == 0 || ts[i] != ts[i - 1] + 1)
+				index.addBlock(i, ts[i]);
+		}
+	}
+
+	var events = m_jsonData["events"];
+	const String prefix = getRecordName(record) + "/";
+
+	for (int e = 0; e < events.size(); e++)
+	{
+		String folderName = events[e]["folder_name"];
+		if (!folderName.startsWith(prefix) || !folderName.contains("TTL"))
+			continue;
+
+		folderName = folderName.trimCharactersAtEnd("/").replace("/", File::separatorString);
+		File folder = m_rootPath.getChildFile("events").getChildFile(folderName);
+
+		NpyReader eventTimestamps, states;
+		if (!eventTimestamps.open(folder.getChildFile("timestamps.npy"), "i8"))
+			continue;
+
+		// channel_states holds +channel for rising edges and -channel for falling ones
+		const bool hasStates = states.open(folder.getChildFile("channel_states.npy"), "i2");
+		const int64* ts = static_cast<const int64*>(eventTimestamps.getData());
+		const int16* state = static_cast<const int16*>(states.getData());
+
+		for (int64 i = 0; i < eventTimestamps.getNumRecords(); i++)
+		{
+			if (!hasStates || i >= states.getNumRecords() || state[i] > 0)
+				index.addEventTimestamp(ts[i]);
+		}
+	}
+
+	index.sortEvents();
+}
+
+int BinaryFileSource::getNumEventStreams() const
+{
+	return m_eventStreams.size();
+}
+
+RecordedEventStreamInfo BinaryFileSource::getEventStreamInfo(int stream) const
+{
+	return m_eventStreams[stream]->info;
+}
+
+void BinaryFileSource::readEvents(int64 startTimestamp, int64 endTimestamp, Array<RecordedEvent>& events)
+{
+	const int numStreams = m_eventStreams.size();
+
+	for (auto stream : m_eventStreams)
+	{
+		// playback jumped, find the first event of the new position
+		if (startTimestamp != stream->nextTimestamp)
+		{
+			const int64* ts = static_cast<const int64*>(stream->timestamps.getData());
+			stream->cursor = std::lower_bound(ts, ts + stream->numEvents, startTimestamp) - ts;
+			stream->prefetchMark = stream->cursor;
+		}
+
+		stream->nextTimestamp = endTimestamp;
+
+		if (stream->cursor >= stream->prefetchMark)
+		{
+			stream->timestamps.prefetch(stream->cursor, EVENT_PREFETCH_RECORDS);
+			stream->values.prefetch(stream->cursor, EVENT_PREFETCH_RECORDS);
+			stream->clusters.prefetch(stream->cursor, EVENT_PREFETCH_RECORDS);
+			stream->waveforms.prefetch(stream->cursor, EVENT_PREFETCH_RECORDS);
+			stream->prefetchMark = stream->cursor + EVENT_PREFETCH_RECORDS / 2;
+		}
+	}
+
+	// merge the streams, taking the earliest pending event each time
+	while (true)
+	{
+		int next = -1;
+		int64 nextTimestamp = endTimestamp;
+
+		for (int s = 0; s < numStreams; s++)
+		{
+			EventStream* stream = m_eventStreams.getUnchecked(s);
+			if (stream->cursor >= stream->numEvents)
+				continue;
+
+			const int64 ts = static_cast<const int64*>(stream->timestamps.getData())[stream->cursor];
+			if (ts < nextTimestamp)
+			{
+				next = s;
+				nextTimestamp = ts;
+			}
+		}
+
+		if (next < 0)
+			break;
+
+		EventStream* stream = m_eventStreams.getUnchecked(next);
+		const int64 i = stream->cursor++;
+
+		RecordedEvent event;
+		event.timestamp = nextTimestamp;
+		event.stream = next;
+
+		if (stream->info.type == RecordedEventStreamInfo::TTL)
+		{
+			event.value = static_cast<const int16*>(stream->values.getData())[i];
+			event.sortedId = 0;
+			event.waveform = nullptr;
+		}
+		else
+		{
+			const int waveformSamples = stream->info.numChannels * (stream->info.prePeakSamples + stream->info.postPeakSamples);
+
+			event.value = static_cast<const uint16*>(stream->values.getData())[i] - 1;
+			event.sortedId = static_cast<const uint16*>(stream->clusters.getData())[i];
+			event.waveform = static_cast<const int16*>(stream->waveforms.getData()) + i * waveformSamples;
+		}
+
+		events.add(event);
+	}
+}
+
+int64 BinaryFileSource::findSyncSegment(int64 sample) const
+{
+	const double* segments = static_cast<const double*>(m_syncSegments.getData());
+	const int64 n = m_syncSegments.getNumRecords();
+
+	if (segments == nullptr || n <= 0)
+		return -1;
+
+	// the last segment starting at or before the sample; the first one also covers the samples before it
+	int64 low = 0;
+	int64 high = n;
+
+	while (high - low > 1)
+	{
+		const int64 mid = (low + high) / 2;
+
+		if (segments[mid * 3] <= double(sample))
+			low = mid;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+double BinaryFileSource::getSyncTime(int64 sample)
+{
+	const int64 index = findSyncSegment(sample);
+
+	if (index >= 0)
+	{
+		const double* segment = static_cast<const double*>(m_syncSegments.getData()) + index * 3;
+
+		// a segment without a sample rate was written while the record was not synchronized
+		if (segment[2] <= 0.0)
+			return -1.0;
+
+		return segment[1] + (double(sample) - segment[0]) / segment[2];
+	}
+
+	const double* times = static_cast<const double*>(m_syncTimes.getData());
+	const int64 n = jmin(m_syncTimes.getNumRecords(), getActiveNumSamples());
+
+	if (times == nullptr || n <= 0)
+		return FileSource::getSyncTime(sample);
+
+	// past either end, carry on from the nearest sample at the record's own rate
+	const int64 nearest = jlimit((int64) 0, n - 1, sample);
+
+	return times[nearest] + double(sample - nearest) / getActiveSampleRate();
+}
+
+int64 BinaryFileSource::getSampleAtSyncTime(double seconds)
+{
+	const double* segments = static_cast<const double*>(m_syncSegments.getData());
+	const int64 numSegments = m_syncSegments.getNumRecords();
+
+	if (segments != nullptr && numSegments > 0)
+	{
+		const int64 numSamples = getActiveNumSamples();
+
+		// the first sample at or after the time, as with the per-sample times
+		for (int64 i = 0; i < numSegments; i++)
+		{
+			const double* segment = segments + i * 3;
+			const int64 first = jmax(int64(0), int64(segment[0]));
+			const int64 end = (i + 1 < numSegments) ? int64(segments[(i + 1) * 3]) : numSamples;
+
+			if (segment[2] <= 0.0 || end <= first)
+				continue;
+
+			const double position = segment[0] + (seconds - segment[1]) * segment[2];
+
+			if (position <= double(first))
+				return first;
+
+			if (position < double(end))
+				return jmin(end, int64(std::ceil(position)));
+		}
+
+		return numSamples;
+	}
+
+	const double* times = static_cast<const double*>(m_syncTimes.getData());
+	const int64 n = jmin(m_syncTimes.getNumRecords(), getActiveNumSamples());
+
+	if (times == nullptr || n <= 0)
+		return FileSource::getSampleAtSyncTime(seconds);
+
+	return std::lower_bound(times, times + n, seconds) - times;
+}
+
 bool BinaryFileSource::isReady()
 {
 	return true;
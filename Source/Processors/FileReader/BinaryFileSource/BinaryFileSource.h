@@ -25,6 +25,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define BINARYFILESOURCE_H_INCLUDED
 
 #include "../FileSource.h"
+#include "ChunkedContinuousReader.h"
+#include "CompressedContinuousReader.h"
+#include "NpyReader.h"
 
 namespace BinarySource
 {
@@ -40,6 +43,31 @@ namespace BinarySource
 
 		void processChannelData(int16* inBuffer, float* outBuffer, int channel, int64 numSamples) override;
 
+		void processAllChannelData(int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples) override;
+
+		/** Compressed and chunked records then read only the active channels */
+		void setChannelMask(const Array<bool>& mask) override;
+
+		int16* getDataPointer(int64 sample, int64 numSamples) override;
+
+		void prefetch(int64 sample, int64 numSamples) override;
+
+		/** Indexes the jumps in the record's timestamps.npy, and the rising edges of
+			the TTL channels that share its source processor */
+		void fillSeekIndex(FileSeekIndex& index) override;
+
+		/** The TTL folders that share the record's source processor, and the spike groups
+			recorded at its sample rate */
+		int getNumEventStreams() const override;
+		RecordedEventStreamInfo getEventStreamInfo(int stream) const override;
+
+		void readEvents(int64 startTimestamp, int64 endTimestamp, Array<RecordedEvent>& events) override;
+
+		/** From the record's synchronized_timestamp_segments.npy, or the per-sample
+			synchronized_timestamps.npy of older recordings, when it has either */
+		double getSyncTime(int64 sample) override;
+		int64 getSampleAtSyncTime(double seconds) override;
+
 		bool isReady() override;
 
 	private:
@@ -47,12 +75,58 @@ namespace BinarySource
 		void fillRecordInfo() override;
 		void updateActiveRecord() override;
 
+		void openEventStreams();
+
+		struct EventStream
+		{
+			RecordedEventStreamInfo info;
+			NpyReader timestamps;
+			NpyReader values;		// channel_states for TTLs, spike_electrode_indices for spikes
+			NpyReader clusters;		// spikes only
+			NpyReader waveforms;	// spikes only
+			int64 numEvents;
+			int64 cursor;			// the next event to read
+			int64 nextTimestamp;	// where the last read ended; a read starting elsewhere seeks
+			int64 prefetchMark;		// the cursor position that triggers the next prefetch
+		};
+
+		OwnedArray<EventStream> m_eventStreams;
+
+		/* The JSON entry of each record, for its channels' source indices */
+		Array<var> m_recordJson;
+
 		ScopedPointer<MemoryMappedFile> m_dataFile;
 		var m_jsonData;
 		Array<File> m_dataFileArray;
 
+		/* Records written by the Compressed Binary engine are decoded on the fly */
+		Array<File> m_indexFileArray;
+		ScopedPointer<CompressedContinuousReader> m_compressedReader;
+
+		/* ...and those of the Chunked Binary engine gathered from their channel rows */
+		Array<bool> m_chunkedRecords;
+		ScopedPointer<ChunkedContinuousReader> m_chunkedReader;
+
 		File m_rootPath;
 		int64 m_samplePos;
+
+		/* The active record's times on the main clock, as rows of
+		   (first sample, master time, sample rate) that hold until the next row starts */
+		NpyReader m_syncSegments;
+
+		/* ...or one per sample, as written by older versions */
+		NpyReader m_syncTimes;
+
+		/* The segment holding a sample, or -1 when the record has none */
+		int64 findSyncSegment(int64 sample) const;
+
+		/* bitVolts of each channel of the active record */
+		HeapBlock<float> m_bitVolts;
+
+		/* The channels processAllChannelData() converts, in order */
+		Array<int> m_activeChannels;
+
+		void convertActiveChannels(int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples);
 		
 	};
 }
@@ -0,0 +1,141 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChunkedContinuousReader.h"
+
+using namespace BinarySource;
+
+ChunkedContinuousReader::ChunkedContinuousReader() :
+	m_numChannels(0)
+{}
+
+ChunkedContinuousReader::~ChunkedContinuousReader()
+{}
+
+bool ChunkedContinuousReader::open(const File& dataFile, const File& indexFile, int numChannels)
+{
+	m_index.clear();
+	m_numChannels = numChannels;
+	setChannelMask(Array<bool>());
+
+	MemoryBlock indexData;
+	if (numChannels <= 0 || !indexFile.loadFileAsData(indexData))
+		return false;
+
+	int numEntries = int(indexData.getSize() / sizeof(BlockCodec::IndexEntry));
+	m_index.resize(numEntries);
+	memcpy(m_index.getRawDataPointer(), indexData.getData(), numEntries * sizeof(BlockCodec::IndexEntry));
+
+	m_dataFile = new MemoryMappedFile(dataFile, MemoryMappedFile::readOnly);
+	if (m_dataFile->getData() == nullptr && numEntries > 0)
+	{
+		m_dataFile = nullptr;
+		return false;
+	}
+
+	/* Drop the entries of chunks that did not make it to disk, e.g. after a crash */
+	while (m_index.size() > 0)
+	{
+		const BlockCodec::IndexEntry& last = m_index.getReference(m_index.size() - 1);
+		if (last.fileOffset + last.frameBytes <= (uint64)m_dataFile->getSize())
+			break;
+		m_index.removeLast();
+	}
+
+	for (const BlockCodec::IndexEntry& entry : m_index)
+	{
+		if (entry.frameBytes != sizeof(BlockCodec::FrameHeader) + size_t(numChannels) * entry.numSamples * sizeof(int16))
+		{
+			std::cout << "Chunk index of " << dataFile.getFullPathName() << " does not match its channels" << std::endl;
+			m_index.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int64 ChunkedContinuousReader::getNumSamples() const
+{
+	if (m_index.size() == 0)
+		return 0;
+	const BlockCodec::IndexEntry& last = m_index.getReference(m_index.size() - 1);
+	return int64(last.firstSample + last.numSamples);
+}
+
+int ChunkedContinuousReader::findChunk(int64 sample) const
+{
+	int lo = 0, hi = m_index.size() - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		const BlockCodec::IndexEntry& entry = m_index.getReference(mid);
+		if (sample < int64(entry.firstSample))
+			hi = mid - 1;
+		else if (sample >= int64(entry.firstSample + entry.numSamples))
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return -1;
+}
+
+void ChunkedContinuousReader::setChannelMask(const Array<bool>& mask)
+{
+	m_channels.clearQuick();
+
+	for (int c = 0; c < m_numChannels; c++)
+	{
+		if (mask.size() != m_numChannels || mask[c])
+			m_channels.add(c);
+	}
+}
+
+int ChunkedContinuousReader::read(int16* dest, int64 startSample, int nSamples)
+{
+	int samplesRead = 0;
+	int chunk = findChunk(startSample);
+
+	while (samplesRead < nSamples && chunk >= 0 && chunk < m_index.size())
+	{
+		const BlockCodec::IndexEntry& entry = m_index.getReference(chunk);
+		int offset = int(startSample + samplesRead - int64(entry.firstSample));
+		int count = jmin(nSamples - samplesRead, int(entry.numSamples) - offset);
+
+		const int16* rows = reinterpret_cast<const int16*>(static_cast<const char*>(m_dataFile->getData())
+			+ entry.fileOffset + sizeof(BlockCodec::FrameHeader));
+
+		for (int ch : m_channels)
+		{
+			const int16* source = rows + size_t(ch) * entry.numSamples + offset;
+			int16* out = dest + size_t(samplesRead) * m_numChannels + ch;
+
+			for (int s = 0; s < count; s++)
+				out[size_t(s) * m_numChannels] = source[s];
+		}
+
+		samplesRead += count;
+		chunk++;
+	}
+	return samplesRead;
+}
@@ -0,0 +1,63 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHUNKEDCONTINUOUSREADER_H_INCLUDED
+#define CHUNKEDCONTINUOUSREADER_H_INCLUDED
+
+#include <JuceHeader.h>
+#include "../../RecordNode/BinaryFormat/BlockCodec.h"
+
+namespace BinarySource
+{
+	/** Reads the continuous.chdat files written by the Chunked Binary engine.
+		The chunk index is loaded at open and the data file is mapped, so a read only
+		touches the rows of the channels in the mask, gathering them into interleaved
+		samples. */
+	class ChunkedContinuousReader
+	{
+	public:
+		ChunkedContinuousReader();
+		~ChunkedContinuousReader();
+
+		bool open(const File& dataFile, const File& indexFile, int numChannels);
+
+		int64 getNumSamples() const;
+
+		/** Reads nSamples interleaved samples starting at startSample. Returns the number of samples read */
+		int read(int16* dest, int64 startSample, int nSamples);
+
+		/** Reads only the channels set in the mask; the samples of the others are undefined.
+			An empty mask reads all of them */
+		void setChannelMask(const Array<bool>& mask);
+
+	private:
+		int findChunk(int64 sample) const;
+
+		ScopedPointer<MemoryMappedFile> m_dataFile;
+		Array<BlockCodec::IndexEntry> m_index;
+		int m_numChannels;
+		Array<int> m_channels;
+	};
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CompressedContinuousReader.h"
+
+using namespace BinarySource;
+
+CompressedContinuousReader::CompressedContinuousReader() :
+	m_numChannels(0),
+	m_frameCapacity(0),
+	m_cachedFrame(-1)
+{}
+
+CompressedContinuousReader::~CompressedContinuousReader()
+{}
+
+bool CompressedContinuousReader::open(const File& dataFile, const File& indexFile, int numChannels)
+{
+	m_index.clear();
+	m_cachedFrame = -1;
+	m_numChannels = numChannels;
+
+	MemoryBlock indexData;
+	if (numChannels <= 0 || !indexFile.loadFileAsData(indexData))
+		return false;
+
+	int numEntries = int(indexData.getSize() / sizeof(BlockCodec::IndexEntry));
+	m_index.resize(numEntries);
+	memcpy(m_index.getRawDataPointer(), indexData.getData(), numEntries * sizeof(BlockCodec::IndexEntry));
+
+	m_dataFile = new MemoryMappedFile(dataFile, MemoryMappedFile::readOnly);
+	if (m_dataFile->getData() == nullptr && numEntries > 0)
+	{
+		m_dataFile = nullptr;
+		return false;
+	}
+
+	/* Drop the entries of frames that did not make it to disk, e.g. after a crash */
+	while (m_index.size() > 0)
+	{
+		const BlockCodec::IndexEntry& last = m_index.getReference(m_index.size() - 1);
+		if (last.fileOffset + last.frameBytes <= (uint64)m_dataFile->getSize())
+			break;
+		m_index.removeLast();
+	}
+
+	return true;
+}
+
+int64 CompressedContinuousReader::getNumSamples() const
+{
+	if (m_index.size() == 0)
+		return 0;
+	const BlockCodec::IndexEntry& last = m_index.getReference(m_index.size() - 1);
+	return int64(last.firstSample + last.numSamples);
+}
+
+int CompressedContinuousReader::findFrame(int64 sample) const
+{
+	int lo = 0, hi = m_index.size() - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		const BlockCodec::IndexEntry& entry = m_index.getReference(mid);
+		if (sample < int64(entry.firstSample))
+			hi = mid - 1;
+		else if (sample >= int64(entry.firstSample + entry.numSamples))
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return -1;
+}
+
+bool CompressedContinuousReader::decodeFrame(int frame)
+{
+	if (frame == m_cachedFrame)
+		return true;
+
+	const BlockCodec::IndexEntry& entry = m_index.getReference(frame);
+	if (int(entry.numSamples) > m_frameCapacity)
+	{
+		m_frameCapacity = entry.numSamples;
+		m_frameData.malloc(m_frameCapacity * m_numChannels);
+	}
+
+	const char* data = static_cast<const char*>(m_dataFile->getData()) + entry.fileOffset;
+	const bool* mask = m_channelMask.size() == m_numChannels ? m_channelMask.getRawDataPointer() : nullptr;
+
+	if (!BlockCodec::decodeFrame(data, entry.frameBytes, m_frameData, m_numChannels, mask))
+	{
+		std::cout << "Corrupted compressed frame " << frame << std::endl;
+		m_cachedFrame = -1;
+		return false;
+	}
+
+	m_cachedFrame = frame;
+	return true;
+}
+
+void CompressedContinuousReader::setChannelMask(const Array<bool>& mask)
+{
+	m_channelMask = mask;
+
+	// the cached frame may lack channels that are now needed
+	m_cachedFrame = -1;
+}
+
+int CompressedContinuousReader::read(int16* dest, int64 startSample, int nSamples)
+{
+	int samplesRead = 0;
+	int frame = findFrame(startSample);
+
+	while (samplesRead < nSamples && frame >= 0 && frame < m_index.size())
+	{
+		if (!decodeFrame(frame))
+			break;
+
+		const BlockCodec::IndexEntry& entry = m_index.getReference(frame);
+		int offset = int(startSample + samplesRead - int64(entry.firstSample));
+		int count = jmin(nSamples - samplesRead, int(entry.numSamples) - offset);
+
+		memcpy(dest + samplesRead * m_numChannels, m_frameData + offset * m_numChannels, count * m_numChannels * sizeof(int16));
+		samplesRead += count;
+		frame++;
+	}
+	return samplesRead;
+}
@@ -0,0 +1,68 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSEDCONTINUOUSREADER_H_INCLUDED
+#define COMPRESSEDCONTINUOUSREADER_H_INCLUDED
+
+#include <JuceHeader.h>
+#include "../../RecordNode/BinaryFormat/BlockCodec.h"
+
+namespace BinarySource
+{
+	/** Reads the continuous.cdat files written by the Compressed Binary engine.
+		The frame index is loaded at open, so any sample range can be decoded without
+		going through the frames that come before it. The last decoded frame is cached,
+		as reads normally move forward through it. */
+	class CompressedContinuousReader
+	{
+	public:
+		CompressedContinuousReader();
+		~CompressedContinuousReader();
+
+		bool open(const File& dataFile, const File& indexFile, int numChannels);
+
+		int64 getNumSamples() const;
+
+		/** Decodes nSamples interleaved samples starting at startSample. Returns the number of samples read */
+		int read(int16* dest, int64 startSample, int nSamples);
+
+		/** Decodes only the channels set in the mask; the samples of the others are undefined.
+			An empty mask decodes all of them */
+		void setChannelMask(const Array<bool>& mask);
+
+	private:
+		int findFrame(int64 sample) const;
+		bool decodeFrame(int frame);
+
+		ScopedPointer<MemoryMappedFile> m_dataFile;
+		Array<BlockCodec::IndexEntry> m_index;
+		int m_numChannels;
+		Array<bool> m_channelMask;
+
+		HeapBlock<int16> m_frameData;
+		int m_frameCapacity;
+		int m_cachedFrame;
+	};
+}
+
+#endif
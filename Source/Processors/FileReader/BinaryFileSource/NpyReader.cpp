@@ -0,0 +1,125 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2021 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NpyReader.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace BinarySource;
+
+NpyReader::NpyReader() :
+	m_headerLength(0),
+	m_recordSize(0),
+	m_numRecords(0)
+{}
+
+NpyReader::~NpyReader()
+{}
+
+bool NpyReader::open(const File& file, const String& type, int valuesPerRecord)
+{
+	m_file = nullptr;
+	m_numRecords = 0;
+
+	if (!file.existsAsFile())
+		return false;
+
+	ScopedPointer<MemoryMappedFile> mapped = new MemoryMappedFile(file, MemoryMappedFile::readOnly);
+	const uint8* bytes = static_cast<const uint8*>(mapped->getData());
+	const size_t size = mapped->getSize();
+
+	/* \x93NUMPY, the version, then the header length in 2 (v1) or 4 (v2) bytes */
+	if (bytes == nullptr || size < 10 || bytes[0] != 0x93 || memcmp(bytes + 1, "NUMPY", 5) != 0)
+		return false;
+
+	size_t headerStart, headerLength;
+	if (bytes[6] == 1)
+	{
+		headerStart = 10;
+		headerLength = headerStart + (size_t)ByteOrder::littleEndianShort(bytes + 8);
+	}
+	else if (size >= 12)
+	{
+		headerStart = 12;
+		headerLength = headerStart + (size_t)ByteOrder::littleEndianInt(bytes + 8);
+	}
+	else
+		return false;
+
+	if (headerLength > size)
+		return false;
+
+	String header(CharPointer_UTF8(reinterpret_cast<const char*>(bytes + headerStart)), headerLength - headerStart);
+
+	if (!header.contains("'<" + type + "'") && !header.contains("'|" + type + "'"))
+		return false;
+
+	m_recordSize = type.getTrailingIntValue() * valuesPerRecord;
+	if (m_recordSize <= 0)
+		return false;
+
+	m_headerLength = headerLength;
+	m_numRecords = int64((size - headerLength) / m_recordSize);
+	m_file = mapped.release();
+
+#if JUCE_LINUX || JUCE_MAC
+	madvise(m_file->getData(), m_file->getSize(), MADV_SEQUENTIAL);
+#endif
+
+	return true;
+}
+
+int64 NpyReader::getNumRecords() const
+{
+	return m_numRecords;
+}
+
+const void* NpyReader::getData() const
+{
+	if (m_file == nullptr)
+		return nullptr;
+
+	return static_cast<const char*>(m_file->getData()) + m_headerLength;
+}
+
+void NpyReader::prefetch(int64 first, int64 numRecords) const
+{
+#if JUCE_LINUX || JUCE_MAC
+	numRecords = jmin(numRecords, m_numRecords - first);
+
+	if (m_file == nullptr || first < 0 || numRecords <= 0)
+		return;
+
+	// madvise() wants a page-aligned start
+	static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	const size_t offset = m_headerLength + (size_t)first * m_recordSize;
+	const size_t alignedOffset = offset - offset % pageSize;
+
+	madvise(static_cast<char*>(m_file->getData()) + alignedOffset,
+		(size_t)numRecords * m_recordSize + offset - alignedOffset, MADV_WILLNEED);
+#endif
+}
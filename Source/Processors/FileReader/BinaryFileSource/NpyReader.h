@@ -0,0 +1,61 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2021 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef NPYREADER_H_INCLUDED
+#define NPYREADER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+namespace BinarySource
+{
+	/** Maps a one-dimensional .npy file, such as the timestamps.npy files written
+		by the Binary engine, and gives direct access to its records. The number
+		of records is taken from the file size rather than from the header, which
+		is only rewritten from time to time while recording. */
+	class NpyReader
+	{
+	public:
+		NpyReader();
+		~NpyReader();
+
+		/** Opens the file if it holds little-endian values of the given numpy type, e.g. "i8",
+			valuesPerRecord to a record (e.g. channels x samples of a spike waveform) */
+		bool open(const File& file, const String& type, int valuesPerRecord = 1);
+
+		int64 getNumRecords() const;
+
+		/** The records, or nullptr if no file is open */
+		const void* getData() const;
+
+		/** Hints that the records [first, first + numRecords) will be read soon */
+		void prefetch(int64 first, int64 numRecords) const;
+
+	private:
+		ScopedPointer<MemoryMappedFile> m_file;
+		size_t m_headerLength;
+		int m_recordSize;
+		int64 m_numRecords;
+	};
+}
+
+#endif
@@ -28,21 +28,15 @@
 #include "../../Audio/AudioComponent.h"
 #include "../PluginManager/PluginManager.h"
 #include "BinaryFileSource/BinaryFileSource.h"
+#include "OpenEphysFileSource/OpenEphysFileSource.h"
 
 
 FileReader::FileReader()
     : GenericProcessor ("File Reader")
-    , Thread ("filereader_Async_Reader")
+    , m_playSample          (0)
     , timestamp             (0)
-    , currentSampleRate     (0)
-    , currentNumChannels    (0)
-    , currentSample         (0)
-    , currentNumSamples     (0)
-    , startSample           (0)
-    , stopSample            (0)
     , counter               (0)
-    , bufferCacheWindow     (0)
-    , m_shouldFillBackBuffer(false)
+    , m_playAllRecords      (false)
 	, m_bufferSize(1024)
 	, m_sysSampleRate(44100)
 {
@@ -85,8 +79,8 @@ FileReader::FileReader()
 
 FileReader::~FileReader()
 {
-    signalThreadShouldExit();
-    notify();
+    // the streams read from the sources
+    m_streams.clear();
 }
 
 
@@ -99,9 +93,81 @@ AudioProcessorEditor* FileReader::createEditor()
 
 void FileReader::createEventChannels()
 {
-    //editor = new FileReaderEditor (this, true);
+    m_streamChannels.clearQuick();
 
-    //return editor;
+    if (! input)
+        return;
+
+    const int numStreams = input->getNumEventStreams();
+
+    for (int i = 0; i < numStreams; ++i)
+    {
+        RecordedEventStreamInfo info = input->getEventStreamInfo (i);
+
+        if (info.type != RecordedEventStreamInfo::TTL)
+        {
+            m_streamChannels.add (-1);
+            continue;
+        }
+
+        EventChannel* chan = new EventChannel (EventChannel::TTL, info.numChannels, 0, getDefaultSampleRate(), this);
+        chan->setName (info.name.isEmpty() ? getName() + " recorded TTL events" : info.name);
+        chan->setDescription ("TTL events replayed from the file by the File Reader");
+        chan->setIdentifier ("recordedevent");
+
+        m_streamChannels.add (eventChannelArray.size());
+        eventChannelArray.add (chan);
+    }
+
+    m_ttlWords.clearQuick();
+    m_ttlWords.insertMultiple (0, 0, numStreams);
+}
+
+
+void FileReader::createSpikeChannels()
+{
+    m_spikeBuffers.clear();
+
+    if (! input)
+        return;
+
+    int maxChannels = 1;
+    int maxSamples = 1;
+
+    for (int i = 0; i < m_streamChannels.size(); ++i)
+    {
+        RecordedEventStreamInfo info = input->getEventStreamInfo (i);
+
+        if (info.type != RecordedEventStreamInfo::SPIKE)
+            continue;
+
+        const SpikeChannel::ElectrodeTypes type = SpikeChannel::typeFromNumChannels (info.numChannels);
+
+        if (type == SpikeChannel::INVALID)
+            continue;
+
+        m_streamChannels.set (i, spikeChannelArray.size());
+
+        for (int e = 0; e < info.numElectrodes; ++e)
+        {
+            Array<const DataChannel*> chans;
+
+            for (int c = 0; c < info.numChannels; ++c)
+                chans.add (getDataChannel (info.sourceChannels[e * info.numChannels + c]));
+
+            SpikeChannel* spk = new SpikeChannel (type, this, chans);
+            spk->setNumSamples (info.prePeakSamples, info.postPeakSamples);
+            spikeChannelArray.add (spk);
+
+            m_spikeBuffers.add (new SpikeEvent::SpikeBuffer (spk));
+        }
+
+        maxChannels = jmax (maxChannels, info.numChannels);
+        maxSamples = jmax (maxSamples, info.prePeakSamples + info.postPeakSamples);
+    }
+
+    m_spikeSamples.malloc (maxSamples);
+    m_spikeThresholds.calloc (maxChannels);
 }
 
 bool FileReader::isReady()
@@ -120,21 +186,34 @@ bool FileReader::isReady()
 
 float FileReader::getDefaultSampleRate() const
 {
-    if (input)
-        return currentSampleRate;
+    return getSampleRate (0);
+}
+
+
+float FileReader::getSampleRate (int subproc) const
+{
+    if (FileReaderStream* stream = m_streams[subproc])
+        return stream->getSampleRate();
     else
         return 44100.0;
 }
 
 
+int FileReader::getNumSubProcessors() const
+{
+    return jmax (1, m_streams.size());
+}
+
+
 int FileReader::getDefaultNumDataOutputs(DataChannel::DataChannelTypes type, int subproc) const
 {
-    if (subproc != 0) return 0;
     if (type != DataChannel::HEADSTAGE_CHANNEL) return 0;
-    if (input)
-        return currentNumChannels;
-    else
+    if (FileReaderStream* stream = m_streams[subproc])
+        return stream->getNumChannels();
+    else if (subproc == 0)
         return 16;
+    else
+        return 0;
 }
 
 
@@ -154,39 +233,42 @@ void FileReader::setEnabledState (bool t)
 
 bool FileReader::enable()
 {
-	timestamp = 0;
-
 	AudioDeviceManager& adm = AccessClass::getAudioComponent()->deviceManager;
 	AudioDeviceManager::AudioDeviceSetup ads;
 	adm.getAudioDeviceSetup(ads);
 	m_sysSampleRate = ads.sampleRate;
 	m_bufferSize = ads.bufferSize;
 	if (m_bufferSize == 0) m_bufferSize = 1024;
+	const bool offline = AccessClass::getAudioComponent()->isOfflineMode();
 
-	m_samplesPerBuffer.set(m_bufferSize * (getDefaultSampleRate() / m_sysSampleRate));
+	alignStreams();
 
-	bufferA.malloc(currentNumChannels * m_bufferSize * BUFFER_WINDOW_CACHE_SIZE);
-	bufferB.malloc(currentNumChannels * m_bufferSize * BUFFER_WINDOW_CACHE_SIZE);
+	int firstChannel = 0;
 
-        // reset stream to beginning
-        input->seekTo (startSample);
-        currentSample = startSample;
-        readAndFillBufferCache(bufferA); // pre-fill the front buffer with a blocking read
+	for (auto stream : m_streams)
+	{
+		Array<bool> mask;
+		mask.addArray(m_channelActive, firstChannel, stream->getNumChannels());
+		firstChannel += stream->getNumChannels();
 
-	// set the backbuffer so that on the next call to process() we start with bufferA and buffer
-	// cache window id = 0
-	readBuffer = &bufferB;
-	bufferCacheWindow = 0;
-	m_shouldFillBackBuffer.set(false);
+		stream->setChannelMask(mask);
+		stream->start(m_sysSampleRate, m_bufferSize, offline);
+	}
 
-	startThread(); // start async file reader thread
+	timestamp = 0;
+	m_playSample = m_streams[0]->getStartSample();
+	m_events.ensureStorageAllocated (1024);
+	for (int i = 0; i < m_ttlWords.size(); i++)
+		m_ttlWords.set (i, 0);
 
 	return isEnabled;
 }
 
 bool FileReader::disable()
 {
-	stopThread(100);
+	for (auto stream : m_streams)
+		stream->stop();
+
 	return true;
 }
 
@@ -216,20 +298,12 @@ bool FileReader::setFile (String fullpath)
     const int index = supportedExtensions[ext] - 1;
     const bool isExtensionSupported = index >= 0;
 
+    m_streams.clear();
+    m_extraSources.clear();
+
     if (isExtensionSupported)
     {
-        const int index = supportedExtensions[ext] -1 ;
-		const int numPluginFileSources = AccessClass::getPluginManager()->getNumFileSources();
-
-		if (index < numPluginFileSources)
-		{
-			Plugin::FileSourceInfo sourceInfo = AccessClass::getPluginManager()->getFileSourceInfo(index);
-			input = sourceInfo.creator();
-		}
-		else
-		{
-			input = createBuiltInFileSource(index - numPluginFileSources);
-		}
+		input = createFileSource(ext);
 		if (!input)
 		{
 			std::cerr << "Error creating file source for extension " << ext << std::endl;
@@ -260,6 +334,8 @@ bool FileReader::setFile (String fullpath)
         return false;
     }
 
+    m_fileExtension = ext;
+
     static_cast<FileReaderEditor*> (getEditor())->populateRecordings (input);
     setActiveRecording (0);
     
@@ -267,30 +343,75 @@ bool FileReader::setFile (String fullpath)
 }
 
 
+FileSource* FileReader::createFileSource (const String& ext) const
+{
+    const int index = supportedExtensions[ext] - 1;
+    const int numPluginFileSources = AccessClass::getPluginManager()->getNumFileSources();
+
+    if (index < 0)
+        return nullptr;
+
+    if (index < numPluginFileSources)
+    {
+        Plugin::FileSourceInfo sourceInfo = AccessClass::getPluginManager()->getFileSourceInfo (index);
+        return sourceInfo.creator();
+    }
+
+    return createBuiltInFileSource (index - numPluginFileSources);
+}
+
+
 void FileReader::setActiveRecording (int index)
 {
     if (!input) { return; }
 
-    input->setActiveRecord (index);
+    m_streams.clear();
+    m_extraSources.clear();
 
-    currentNumChannels  = input->getActiveNumChannels();
-    currentNumSamples   = input->getActiveNumSamples();
-    currentSampleRate   = input->getActiveSampleRate();
+    m_streams.add (new FileReaderStream (*input, index));
 
-    currentSample   = 0;
-    startSample     = 0;
-    stopSample      = currentNumSamples;
-    bufferCacheWindow = 0;
-
-    for (int i = 0; i < currentNumChannels; ++i)
+    if (m_playAllRecords)
     {
-        channelInfo.add (input->getChannelInfo (i));
+        const File file (input->getFileName());
+
+        // each record reads through its own source, so that the streams keep their own place
+        for (int i = 0; i < input->getNumRecords(); ++i)
+        {
+            if (i == index)
+                continue;
+
+            ScopedPointer<FileSource> source = createFileSource (m_fileExtension);
+
+            if (source == nullptr || ! source->OpenFile (file) || i >= source->getNumRecords())
+                continue;
+
+            m_streams.add (new FileReaderStream (*source, i));
+            m_extraSources.add (source.release());
+        }
     }
 
-    static_cast<FileReaderEditor*> (getEditor())->setTotalTime (samplesToMilliseconds (currentNumSamples));
-	input->seekTo(startSample);
+    const FileReaderStream& stream = *m_streams[0];
+
+    static_cast<FileReaderEditor*> (getEditor())->setTotalTime (samplesToMilliseconds (stream.getNumSamples()));
+    static_cast<FileReaderEditor*> (getEditor())->setNumEvents (stream.getSeekIndex().getNumEvents());
+}
+
+
+void FileReader::alignStreams()
+{
+    const FileReaderStream& selected = *m_streams[0];
+    FileSource& selectedSource = selected.getSource();
+
+    const double startTime = selectedSource.getSyncTime (selected.getStartSample());
+    const double stopTime  = selectedSource.getSyncTime (selected.getStopSample());
+
+    for (int i = 1; i < m_streams.size(); ++i)
+    {
+        FileReaderStream& stream = *m_streams[i];
+        FileSource& source = stream.getSource();
 
-   
+        stream.setRange (source.getSampleAtSyncTime (startTime), source.getSampleAtSyncTime (stopTime));
+    }
 }
 
 
@@ -307,47 +428,161 @@ void FileReader::updateSettings()
 {
      if (!input) return;
 
-     for (int i=0; i < currentNumChannels; i++)
+     // a new set of channels is all read to begin with
+     if (m_channelActive.size() != dataChannelArray.size())
      {
-         dataChannelArray[i]->setBitVolts(channelInfo[i].bitVolts);
-         dataChannelArray[i]->setName(channelInfo[i].name);
+         m_channelActive.clearQuick();
+         m_channelActive.insertMultiple (0, true, dataChannelArray.size());
+     }
+
+     // the channels of each subprocessor follow on from those of the one before
+     int channel = 0;
+
+     for (auto stream : m_streams)
+     {
+         for (int i=0; i < stream->getNumChannels(); i++, channel++)
+         {
+             RecordedChannelInfo info = stream->getChannelInfo(i);
+
+             dataChannelArray[channel]->setBitVolts(info.bitVolts);
+             dataChannelArray[channel]->setName(info.name);
+         }
      }
 }
 
 void FileReader::process (AudioSampleBuffer& buffer)
 {
-    const int samplesNeededPerBuffer = int (float (buffer.getNumSamples()) * (getDefaultSampleRate() / m_sysSampleRate));
-    m_samplesPerBuffer.set(samplesNeededPerBuffer);
-    // FIXME: needs to account for the fact that the ratio might not be an exact
-    //        integer value
-    
-    // if cache window id == 0, we need to read and cache BUFFER_WINDOW_CACHE_SIZE more buffer windows
-    if (bufferCacheWindow == 0)
+    int firstChannel = 0;
+
+    for (int i = 0; i < m_streams.size(); ++i)
     {
-        switchBuffer();
+        FileReaderStream& stream = *m_streams[i];
+
+        const int64 streamTimestamp = stream.getTimestamp();
+        const int numSamples = stream.process (buffer, firstChannel, buffer.getNumSamples());
+
+        if (i == 0)
+        {
+            timestamp = streamTimestamp;
+            addRecordedEvents (numSamples);
+        }
+
+        setTimestampAndSamples (streamTimestamp, numSamples, i);
+        firstChannel += stream.getNumChannels();
     }
-    
-    for (int i = 0; i < currentNumChannels; ++i)
+
+    const FileReaderStream& selected = *m_streams[0];
+    const int64 range = jmax ((int64) 1, selected.getStopSample() - selected.getStartSample());
+
+	static_cast<FileReaderEditor*> (getEditor())->setCurrentTime(samplesToMilliseconds(selected.getStartSample() + selected.getTimestamp() % range));
+}
+
+
+void FileReader::addRecordedEvents (int numSamples)
+{
+    if (m_streamChannels.size() == 0)
+        return;
+
+    const FileReaderStream& selected = *m_streams[0];
+    const FileSeekIndex& seekIndex = selected.getSeekIndex();
+    const int64 startSample = selected.getStartSample();
+    const int64 stopSample = selected.getStopSample();
+
+    int samplesDone = 0;
+
+    while (samplesDone < numSamples)
     {
-        // offset readBuffer index by current cache window count * buffer window size * num channels
-        input->processChannelData (*readBuffer + (samplesNeededPerBuffer * currentNumChannels * bufferCacheWindow),
-                                   buffer.getWritePointer (i, 0),
-                                   i,
-                                   samplesNeededPerBuffer);
+        if (m_playSample >= stopSample)
+            m_playSample = startSample;
+
+        // timestamps run on within a segment: it ends where they jump, or where playback wraps
+        const int64 segmentEnd = jmin (stopSample,
+                                       seekIndex.getNextBlockStart (m_playSample),
+                                       m_playSample + numSamples - samplesDone);
+
+        if (segmentEnd <= m_playSample)
+            break;
+
+        const int64 startTimestamp = seekIndex.getTimestampForSample (m_playSample);
+
+        m_events.clearQuick();
+        input->readEvents (startTimestamp, startTimestamp + (segmentEnd - m_playSample), m_events);
+
+        for (const RecordedEvent& event : m_events)
+            addRecordedEvent (event, samplesDone + (int) jmax ((int64) 0, event.timestamp - startTimestamp));
+
+        samplesDone += (int) (segmentEnd - m_playSample);
+        m_playSample = segmentEnd;
     }
-    
-    setTimestampAndSamples(timestamp, samplesNeededPerBuffer);
-	timestamp += samplesNeededPerBuffer;
+}
 
-	static_cast<FileReaderEditor*> (getEditor())->setCurrentTime(samplesToMilliseconds(startSample + timestamp % (stopSample - startSample)));
-    
-    bufferCacheWindow += 1;
-    bufferCacheWindow %= BUFFER_WINDOW_CACHE_SIZE;
+
+void FileReader::addRecordedEvent (const RecordedEvent& event, int sampleNum)
+{
+    const int channelIndex = m_streamChannels[event.stream];
+
+    if (channelIndex < 0)
+        return;
+
+    if (event.waveform == nullptr)
+    {
+        const EventChannel* chan = eventChannelArray[channelIndex];
+        const int line = std::abs (event.value) - 1;
+
+        if (line < 0 || line >= (int) chan->getNumChannels())
+            return;
+
+        uint64& word = m_ttlWords.getReference (event.stream);
+
+        if (event.value > 0)
+            word |= uint64 (1) << line;
+        else
+            word &= ~(uint64 (1) << line);
+
+        TTLEdge edge;
+        edge.timestamp = timestamp + sampleNum;
+        edge.eventData = &word;
+        edge.sampleNum = sampleNum;
+        edge.channel = (uint16) line;
+
+        addTTLEvents (chan, &edge, 1);
+    }
+    else
+    {
+        const int spikeIndex = channelIndex + event.value;
+
+        if (event.value < 0 || spikeIndex >= m_spikeBuffers.size())
+            return;
+
+        const SpikeChannel* chan = spikeChannelArray[spikeIndex];
+        SpikeEvent::SpikeBuffer& spikeBuffer = *m_spikeBuffers[spikeIndex];
+
+        const int numChannels = chan->getNumChannels();
+        const int numSamples = chan->getTotalSamples();
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const int16* source = event.waveform + c * numSamples;
+            const float bitVolts = chan->getChannelBitVolts (c);
+
+            for (int i = 0; i < numSamples; ++i)
+                m_spikeSamples[i] = source[i] * bitVolts;
+
+            spikeBuffer.set (c, m_spikeSamples, numSamples);
+        }
+
+        addSpike (chan, timestamp + sampleNum, m_spikeThresholds, spikeBuffer, event.sortedId, sampleNum);
+    }
 }
 
 
 void FileReader::setParameter (int parameterIndex, float newValue)
 {
+    FileReaderStream* selected = m_streams[0];
+
+    if (selected == nullptr)
+        return;
+
     switch (parameterIndex)
     {
         //Change selected recording
@@ -357,102 +592,91 @@ void FileReader::setParameter (int parameterIndex, float newValue)
 
         //set startTime
         case 1: 
-            startSample = millisecondsToSamples (newValue);
-            currentSample = startSample;
+            selected->setRange (millisecondsToSamples (newValue), selected->getStopSample());
 
-            static_cast<FileReaderEditor*> (getEditor())->setCurrentTime (samplesToMilliseconds (currentSample));
+            static_cast<FileReaderEditor*> (getEditor())->setCurrentTime (samplesToMilliseconds (selected->getStartSample()));
             break;
 
         //set stop time
         case 2:
-            stopSample = millisecondsToSamples(newValue);
-            currentSample = startSample;
+            selected->setRange (selected->getStartSample(), millisecondsToSamples (newValue));
 
-            static_cast<FileReaderEditor*> (getEditor())->setCurrentTime (samplesToMilliseconds (currentSample));
+            static_cast<FileReaderEditor*> (getEditor())->setCurrentTime (samplesToMilliseconds (selected->getStartSample()));
+            break;
+
+        //start playback at an event
+        case 3:
+        {
+            const FileSeekIndex& seekIndex = selected->getSeekIndex();
+            const int eventIndex = (int) newValue;
+
+            if (eventIndex < 0 || eventIndex >= seekIndex.getNumEvents())
+                break;
+
+            const int64 sample = seekIndex.getEventSample (eventIndex);
+
+            if (sample >= selected->getStopSample())
+                break;
+
+            selected->setRange (sample, selected->getStopSample());
+
+            static_cast<FileReaderEditor*> (getEditor())->setStartTime (samplesToMilliseconds (sample));
+            break;
+        }
+
+        //play all records together
+        case 4:
+            m_playAllRecords = newValue > 0;
+            setActiveRecording (selected->getRecordIndex());
             break;
     }
 }
 
 
-unsigned int FileReader::samplesToMilliseconds (int64 samples) const
+const FileSeekIndex& FileReader::getSeekIndex() const
 {
-    return (unsigned int) (1000.f * float (samples) / currentSampleRate);
-}
+    static const FileSeekIndex emptyIndex;
 
+    if (FileReaderStream* selected = m_streams[0])
+        return selected->getSeekIndex();
 
-int64 FileReader::millisecondsToSamples (unsigned int ms) const
-{
-    return (int64) (currentSampleRate * float (ms) / 1000.f);
+    return emptyIndex;
 }
 
-void FileReader::switchBuffer()
+
+bool FileReader::isPlayingAllRecords() const
 {
-    if (readBuffer == &bufferA)
-        readBuffer = &bufferB;
-    else
-        readBuffer = &bufferA;
-    
-    m_shouldFillBackBuffer.set(true);
-    notify();
+    return m_playAllRecords;
 }
 
-HeapBlock<int16>* FileReader::getFrontBuffer()
+
+void FileReader::setChannelState (int channel, bool active)
 {
-    return readBuffer;
+    if (channel >= 0 && channel < m_channelActive.size())
+        m_channelActive.set (channel, active);
 }
 
-HeapBlock<int16>* FileReader::getBackBuffer()
+
+FileReaderIOStats FileReader::getIOStats() const
 {
-    if (readBuffer == &bufferA) return &bufferB;
-    
-    return &bufferA;
+    FileReaderIOStats stats;
+
+    for (auto stream : m_streams)
+        stream->addIOStats (stats);
+
+    return stats;
 }
 
-void FileReader::run()
+
+unsigned int FileReader::samplesToMilliseconds (int64 samples) const
 {
-    while (!threadShouldExit())
-    {
-        if (m_shouldFillBackBuffer.compareAndSetBool(false, true))
-        {
-            readAndFillBufferCache(*getBackBuffer());
-        }
-        
-        wait(30);
-    }
+    return (unsigned int) (1000.f * float (samples) / getDefaultSampleRate());
 }
 
-void FileReader::readAndFillBufferCache(HeapBlock<int16> &cacheBuffer)
+
+int64 FileReader::millisecondsToSamples (unsigned int ms) const
 {
-    const int samplesNeededPerBuffer = m_samplesPerBuffer.get();
-    const int samplesNeeded = samplesNeededPerBuffer * BUFFER_WINDOW_CACHE_SIZE;
-    
-    int samplesRead = 0;
-    
-    // should only loop if reached end of file and resuming from start
-    while (samplesRead < samplesNeeded)
-    {
-        int samplesToRead = samplesNeeded - samplesRead;
-        
-        // if reached end of file stream
-        if ( (currentSample + samplesToRead) > stopSample)
-        {
-            samplesToRead = stopSample - currentSample;
-            if (samplesToRead > 0)
-                input->readData (cacheBuffer + samplesRead * currentNumChannels, samplesToRead);
-            
-            // reset stream to beginning
-            input->seekTo (startSample);
-            currentSample = startSample;
-        }
-        else // else read the block needed
-        {
-            input->readData (cacheBuffer + samplesRead * currentNumChannels, samplesToRead);
-            
-            currentSample += samplesToRead;
-        }
-        
-        samplesRead += samplesToRead;
-    }
+    return (int64) (getDefaultSampleRate() * float (ms) / 1000.f);
 }
 
 StringArray FileReader::getSupportedExtensions() const
@@ -470,7 +694,7 @@ StringArray FileReader::getSupportedExtensions() const
 
 int FileReader::getNumBuiltInFileSources() const
 {
-	return 1;
+	return 2;
 }
 
 String FileReader::getBuiltInFileSourceExtensions(int index) const
@@ -479,6 +703,8 @@ String FileReader::getBuiltInFileSourceExtensions(int index) const
 	{
 	case 0: //Binary
 		return "oebin";
+	case 1: //Open Ephys
+		return "continuous";
 	default:
 		return "";
 	}
@@ -490,6 +716,8 @@ FileSource* FileReader::createBuiltInFileSource(int index) const
 	{
 	case 0:
 		return new BinarySource::BinaryFileSource();
+	case 1:
+		return new OpenEphysSource::OpenEphysFileSource();
 	default:
 		return nullptr;
 	}
@@ -30,17 +30,20 @@
 
 #include "../GenericProcessor/GenericProcessor.h"
 #include "FileSource.h"
-
-#define BUFFER_WINDOW_CACHE_SIZE 10
+#include "FileSeekIndex.h"
+#include "FileReaderStream.h"
 
 
 /**
   Reads data from a file.
 
+  Each record played is a subprocessor with its own FileReaderStream. The selected
+  record is played on its own, or together with all the other records of the file,
+  lined up on the clock they share.
+
   @see GenericProcessor
 */
-class FileReader : public GenericProcessor,
-    private Thread
+class FileReader : public GenericProcessor
 {
 public:
     FileReader();
@@ -55,8 +58,10 @@ public:
     bool isGeneratesTimestamps()    const  override { return true; }
     bool isReady()                  override;
 
-    int getDefaultNumDataOutputs(DataChannel::DataChannelTypes type, int)        const override;
+    int getNumSubProcessors() const override;
+    int getDefaultNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessorIdx)        const override;
 
+    float getSampleRate (int subProcessorIdx = 0) const override;
     float getDefaultSampleRate()        const override;
     float getBitVolts (const DataChannel* chan)   const override;
 
@@ -70,61 +75,81 @@ public:
 
     bool isFileSupported          (const String& filename) const;
     bool isFileExtensionSupported (const String& ext) const;
-    void createEventChannels();
+    void createEventChannels() override;
+    void createSpikeChannels() override;
 	StringArray getSupportedExtensions() const;
 
+    /** Timestamp blocks and events of the selected recording */
+    const FileSeekIndex& getSeekIndex() const;
+
+    /** True when all the records of the file play together */
+    bool isPlayingAllRecords() const;
+
+    /** Read counters of all the streams since playback started */
+    FileReaderIOStats getIOStats() const;
+
+    /** Sets whether a channel is read from the file, counting across subprocessors; inactive
+        channels are played as silence. Changes take effect when acquisition next starts. */
+    void setChannelState (int channel, bool active);
+
 private:
     Array<const EventChannel*> moduleEventChannels;
+
+    /** For each event stream of the source, the index of its channel in eventChannelArray,
+        or of the first of its electrodes in spikeChannelArray; -1 if it has none */
+    Array<int> m_streamChannels;
+    Array<uint64> m_ttlWords;
+    OwnedArray<SpikeEvent::SpikeBuffer> m_spikeBuffers;
+    HeapBlock<float> m_spikeSamples;
+    HeapBlock<float> m_spikeThresholds;
+    Array<RecordedEvent> m_events;
+
+    /** The file position of the next block played, for the recorded events */
+    int64 m_playSample;
     unsigned int count = 0;
     
     void setActiveRecording (int index);
 
+    /** Lines the other streams up with the selected one on the shared clock, so that
+        they all start and loop at the same moment */
+    void alignStreams();
+
     unsigned int samplesToMilliseconds (int64 samples)  const;
     int64 millisecondsToSamples (unsigned int ms)       const;
 
+    /** The timestamp of the selected recording's current block */
     int64 timestamp;
 
-    float currentSampleRate;
-    int currentNumChannels;
-    int64 currentSample;
-    int64 currentNumSamples;
-    int64 startSample;
-    int64 stopSample;
-    int64 bufferCacheWindow; // the current buffer window to read from readBuffer
-    Array<RecordedChannelInfo> channelInfo;
-
     // for testing purposes only
     int counter;
 
+    /** The file opened, with the selected record, and its other records when they
+        all play, each in its own instance of the file source */
     ScopedPointer<FileSource> input;
+    OwnedArray<FileSource> m_extraSources;
+
+    /** One per subprocessor; the selected record's comes first */
+    OwnedArray<FileReaderStream> m_streams;
 
-    HeapBlock<int16> * readBuffer;      // Ptr to the current "front" buffer
-    HeapBlock<int16> bufferA;
-    HeapBlock<int16> bufferB;
+    bool m_playAllRecords;
+
+    /** Whether each output channel is read, all subprocessors' channels in turn */
+    Array<bool> m_channelActive;
+
+    String m_fileExtension;
 
     HashMap<String, int> supportedExtensions;
-    
-    Atomic<int> m_shouldFillBackBuffer;
-    Atomic<int> m_samplesPerBuffer;
 
 	unsigned int m_bufferSize;
 	float m_sysSampleRate;
-    
-    /** Swaps the backbuffer to the front and flags the background reader
-        thread to update the new backbuffer */
-    void switchBuffer();
-    
-    HeapBlock<int16>* getFrontBuffer();
-    HeapBlock<int16>* getBackBuffer();
-    
-    /** Executes the background thread task */
-    void run() override;
-    
-    /** Reads a chunk of the file that fills an entire buffer cache.
-     
-        This method will read into the buffer that passed in by the param 
-     */
-    void readAndFillBufferCache(HeapBlock<int16> &cacheBuffer);
+
+    /** Adds the recorded TTL events and spikes of the next numSamples samples played */
+    void addRecordedEvents (int numSamples);
+
+    void addRecordedEvent (const RecordedEvent& event, int sampleNum);
+
+    /** A new source for files with the extension, or nullptr if none supports it */
+    FileSource* createFileSource (const String& ext) const;
 
 	//Methods for built-in file sources
 	int getNumBuiltInFileSources() const;
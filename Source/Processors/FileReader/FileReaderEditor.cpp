@@ -49,6 +49,14 @@ FileReaderEditor::FileReaderEditor (GenericProcessor* parentNode, bool useDefaul
     recordSelector->addListener (this);
     addAndMakeVisible (recordSelector);
 
+    // plays the other records of the file alongside the selected one
+    playAllButton = new UtilityButton ("ALL", Font ("Small Text", 10, Font::plain));
+    playAllButton->addListener (this);
+    playAllButton->setBounds (155, 50, 30, 20);
+    playAllButton->setClickingTogglesState (true);
+    playAllButton->setTooltip ("Play all the records of the file together, each as a subprocessor");
+    addAndMakeVisible (playAllButton);
+
     currentTime = new DualTimeComponent (this, false);
     currentTime->setBounds (5, 80, 175, 20);
     addAndMakeVisible (currentTime);
@@ -57,7 +65,27 @@ FileReaderEditor::FileReaderEditor (GenericProcessor* parentNode, bool useDefaul
     timeLimits->setBounds (5, 105, 175, 20);
     addAndMakeVisible (timeLimits);
 
-    desiredWidth = 180;
+    eventTitle = new Label ("EventTitle", "TTL");
+    eventTitle->setFont (Font ("Small Text", 10, Font::plain));
+    eventTitle->setBounds (180, 80, 50, 20);
+    addAndMakeVisible (eventTitle);
+
+    // the number of the TTL event to start playback at
+    eventLabel = new Label ("EventLabel", "-");
+    eventLabel->setFont (Font ("Small Text", 10, Font::plain));
+    eventLabel->setEditable (true);
+    eventLabel->setColour (Label::backgroundColourId, Colours::lightgrey);
+    eventLabel->setColour (Label::outlineColourId,    Colours::black);
+    eventLabel->setBounds (185, 105, 45, 20);
+    eventLabel->addListener (this);
+    addAndMakeVisible (eventLabel);
+    setNumEvents (0);
+
+    ioMonitor = new FileReaderIOMonitor (fileReader);
+    ioMonitor->setBounds (188, 22, 52, 54);
+    addAndMakeVisible (ioMonitor);
+
+    desiredWidth = 240;
 
     setEnabledState (false);
 }
@@ -133,6 +161,11 @@ void FileReaderEditor::buttonEvent (Button* button)
                 // fileNameLabel->setText(fileToRead.getFileName(),false);
             }
         }
+        else if (button == playAllButton)
+        {
+            fileReader->setParameter (4, playAllButton->getToggleState() ? 1.0f : 0.0f);
+            CoreServices::updateSignalChain (this);
+        }
     }
 }
 
@@ -175,6 +208,42 @@ void FileReaderEditor::setCurrentTime (unsigned int ms)
 }
 
 
+void FileReaderEditor::setStartTime (unsigned int ms)
+{
+    timeLimits->setTimeMilliseconds  (0, ms);
+    currentTime->setTimeMilliseconds (0, ms);
+}
+
+
+void FileReaderEditor::setNumEvents (int numEvents)
+{
+    eventLabel->setText ("-", dontSendNotification);
+    eventLabel->setEnabled (numEvents > 0);
+    eventLabel->setTooltip (numEvents > 0 ? "Start playback at TTL event 1 to " + String (numEvents)
+                                          : "No TTL events in this recording");
+}
+
+
+void FileReaderEditor::labelTextChanged (Label* label)
+{
+    if (label != eventLabel)
+        return;
+
+    const int eventNumber = label->getText().getIntValue();
+
+    if (eventNumber >= 1 && eventNumber <= fileReader->getSeekIndex().getNumEvents())
+        fileReader->setParameter (3, eventNumber - 1);
+    else
+        label->setText ("-", dontSendNotification);
+}
+
+
+void FileReaderEditor::channelChanged (int channel, bool newState)
+{
+    fileReader->setChannelState (channel, newState);
+}
+
+
 void FileReaderEditor::comboBoxChanged (ComboBox* combo)
 {
     fileReader->setParameter (0, combo->getSelectedId() - 1);
@@ -206,6 +275,7 @@ void FileReaderEditor::clearEditor()
     timeLimits->setTimeMilliseconds     (1, 0);
     currentTime->setTimeMilliseconds    (0, 0);
     currentTime->setTimeMilliseconds    (1, 0);
+    setNumEvents (0);
 
     setEnabledState (false);
 }
@@ -214,14 +284,20 @@ void FileReaderEditor::clearEditor()
 void FileReaderEditor::startAcquisition()
 {
     recordSelector->setEnabled (false);
+    playAllButton->setEnabled (false);
     timeLimits->setEnable (false);
+    eventLabel->setEnabled (false);
+    ioMonitor->start();
 }
 
 
 void FileReaderEditor::stopAcquisition()
 {
     recordSelector->setEnabled (true);
+    playAllButton->setEnabled (true);
     timeLimits->setEnable (true);
+    eventLabel->setEnabled (fileReader->getSeekIndex().getNumEvents() > 0);
+    ioMonitor->stop();
 }
 
 
@@ -232,6 +308,7 @@ void FileReaderEditor::saveCustomParameters (XmlElement* xml)
     XmlElement* childNode = xml->createNewChildElement ("FILENAME");
     childNode->setAttribute ("path", fileReader->getFile());
     childNode->setAttribute ("recording", recordSelector->getSelectedId());
+    childNode->setAttribute ("play_all", fileReader->isPlayingAllRecords());
 
     childNode = xml->createNewChildElement ("TIME_LIMITS");
     childNode->setAttribute ("start_time",  (double)timeLimits->getTimeMilliseconds (0));
@@ -250,6 +327,12 @@ void FileReaderEditor::loadCustomParameters (XmlElement* xml)
 
             int recording = element->getIntAttribute ("recording");
             recordSelector->setSelectedId (recording,sendNotificationSync);
+
+            if (element->getBoolAttribute ("play_all", false))
+            {
+                playAllButton->setToggleState (true, dontSendNotification);
+                buttonEvent (playAllButton);
+            }
         }
         else if (element->hasTagName ("TIME_LIMITS"))
         {
@@ -306,6 +389,59 @@ void FileReaderEditor::filesDropped (const StringArray& files, int x, int y)
 }
 
 
+// FileReaderIOMonitor
+// ================================================================================
+FileReaderIOMonitor::FileReaderIOMonitor (FileReader* reader)
+    : Label         ("IOMonitor", String::empty)
+    , fileReader    (reader)
+    , lastBytesRead (0)
+    , lastStatsTime (0)
+{
+    setFont (Font ("Small Text", 9, Font::plain));
+    setJustificationType (Justification::topLeft);
+    setTooltip ("Read rate, slowest cache read, and blocks played as silence because reads fell behind");
+}
+
+
+void FileReaderIOMonitor::start()
+{
+    lastBytesRead = 0;
+    lastStatsTime = Time::getMillisecondCounterHiRes();
+
+    setText (String::empty, dontSendNotification);
+    startTimer (500);
+}
+
+
+void FileReaderIOMonitor::stop()
+{
+    stopTimer();
+}
+
+
+void FileReaderIOMonitor::timerCallback()
+{
+    const FileReaderIOStats stats = fileReader->getIOStats();
+    const double now = Time::getMillisecondCounterHiRes();
+
+    const double megabytesPerSecond = (stats.bytesRead - lastBytesRead) / jmax (1.0, now - lastStatsTime) / 1000.0;
+
+    lastBytesRead = stats.bytesRead;
+    lastStatsTime = now;
+
+    String text = String (megabytesPerSecond, 1) + " MB/s\n"
+                + String (stats.maxReadMilliseconds, 1) + " ms\n"
+                + String (stats.underruns) + " xrun";
+
+    // the read-ahead depth, when the samples are cached
+    if (stats.readAheadBuffers > 0)
+        text += " / " + String (stats.readAheadBuffers);
+
+    setText (text, dontSendNotification);
+    setColour (Label::textColourId, stats.underruns > 0 ? Colours::darkred : Colours::black);
+}
+
+
 // DualTimeComponent
 // ================================================================================
 DualTimeComponent::DualTimeComponent (FileReaderEditor* e, bool editable)
@@ -30,6 +30,7 @@
 
 class FileReader;
 class DualTimeComponent;
+class FileReaderIOMonitor;
 class FileSource;
 
 /**
@@ -43,6 +44,7 @@ class FileSource;
 class FileReaderEditor  : public GenericEditor
                         , public FileDragAndDropTarget
                         , public ComboBox::Listener
+                        , public Label::Listener
 {
 public:
     FileReaderEditor (GenericProcessor* parentNode, bool useDefaultParameterEditors);
@@ -67,6 +69,17 @@ public:
     void setTotalTime   (unsigned int ms);
     void setCurrentTime (unsigned int ms);
 
+    /** Shows a new playback start time, e.g. after jumping to an event */
+    void setStartTime   (unsigned int ms);
+
+    /** Enables the event field when the recording has events to jump to */
+    void setNumEvents   (int numEvents);
+
+    void labelTextChanged (Label* label) override;
+
+    /** The drawer's parameter buttons select the channels read from the file */
+    void channelChanged (int channel, bool newState) override;
+
 	void startAcquisition() override;
 	void stopAcquisition()  override;
 
@@ -83,8 +96,12 @@ private:
     ScopedPointer<UtilityButton>        fileButton;
     ScopedPointer<Label>                fileNameLabel;
     ScopedPointer<ComboBox>             recordSelector;
+    ScopedPointer<UtilityButton>        playAllButton;
     ScopedPointer<DualTimeComponent>    currentTime;
     ScopedPointer<DualTimeComponent>    timeLimits;
+    ScopedPointer<Label>                eventTitle;
+    ScopedPointer<Label>                eventLabel;
+    ScopedPointer<FileReaderIOMonitor>  ioMonitor;
 
     FileReader* fileReader;
     unsigned int recTotalTime;
@@ -97,6 +114,30 @@ private:
 };
 
 
+/**
+  Shows the read rate, the slowest cache read and the underruns of a
+  FileReader while it plays.
+*/
+class FileReaderIOMonitor : public Label
+                          , public Timer
+{
+public:
+    FileReaderIOMonitor (FileReader* fileReader);
+
+    /** Resets the counters shown and starts updating them */
+    void start();
+    void stop();
+
+    void timerCallback() override;
+
+private:
+    FileReader* fileReader;
+
+    int64 lastBytesRead;
+    double lastStatsTime;
+};
+
+
 class DualTimeComponent : public Component
                         , public Label::Listener
                         , public AsyncUpdater
@@ -0,0 +1,443 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "FileReaderStream.h"
+#include "../../Utils/PipelineTrace.h"
+#include "../../Utils/ThreadConfig.h"
+
+
+FileReaderStream::FileReaderStream (FileSource& source, int index)
+    : Thread ("filereader_Async_Reader_" + String (index))
+    , input                 (source)
+    , recordIndex           (index)
+    , currentSample         (0)
+    , timestamp             (0)
+    , m_frontBuffer         (0)
+    , m_backBuffer          (0)
+    , m_holdingFront        (false)
+    , m_numFilled           (0)
+    , m_readAhead           (READ_AHEAD_MIN_BUFFERS)
+    , m_readPosition        (0)
+    , m_cacheSamples        (0)
+    , m_bytesRead           (0)
+    , m_underruns           (0)
+    , m_maxReadMicroseconds (0)
+    , m_fileRate            (0)
+    , m_sysRate             (1)
+    , m_sampleRemainder     (0)
+    , m_zeroCopy            (false)
+    , m_offline             (false)
+{
+    input.setActiveRecord (recordIndex);
+
+    numChannels = input.getActiveNumChannels();
+    numSamples  = input.getActiveNumSamples();
+    sampleRate  = input.getActiveSampleRate();
+
+    startSample = 0;
+    stopSample  = numSamples;
+
+    for (int i = 0; i < numChannels; ++i)
+    {
+        channelInfo.add (input.getChannelInfo (i));
+    }
+
+    input.fillSeekIndex (seekIndex);
+    input.seekTo (startSample);
+}
+
+
+FileReaderStream::~FileReaderStream()
+{
+    stop();
+}
+
+
+FileSource& FileReaderStream::getSource() const
+{
+    return input;
+}
+
+
+int FileReaderStream::getRecordIndex() const
+{
+    return recordIndex;
+}
+
+
+int FileReaderStream::getNumChannels() const
+{
+    return numChannels;
+}
+
+
+int64 FileReaderStream::getNumSamples() const
+{
+    return numSamples;
+}
+
+
+float FileReaderStream::getSampleRate() const
+{
+    return sampleRate;
+}
+
+
+RecordedChannelInfo FileReaderStream::getChannelInfo (int channel) const
+{
+    return channelInfo[channel];
+}
+
+
+const FileSeekIndex& FileReaderStream::getSeekIndex() const
+{
+    return seekIndex;
+}
+
+
+int64 FileReaderStream::getStartSample() const
+{
+    return startSample;
+}
+
+
+int64 FileReaderStream::getStopSample() const
+{
+    return stopSample;
+}
+
+
+void FileReaderStream::setRange (int64 start, int64 stop)
+{
+    startSample = jlimit ((int64) 0, numSamples, start);
+    stopSample  = jlimit (startSample, numSamples, stop);
+
+    currentSample = startSample;
+}
+
+
+void FileReaderStream::setChannelMask (const Array<bool>& mask)
+{
+    m_channelMask = mask;
+}
+
+
+int64 FileReaderStream::getTimestamp() const
+{
+    return timestamp;
+}
+
+
+void FileReaderStream::addIOStats (FileReaderIOStats& stats) const
+{
+    stats.bytesRead += m_bytesRead.get();
+    stats.underruns += m_underruns.get();
+    stats.maxReadMilliseconds = jmax (stats.maxReadMilliseconds, m_maxReadMicroseconds.get() / 1000.0f);
+
+    if (! m_zeroCopy)
+        stats.readAheadBuffers = jmax (stats.readAheadBuffers, m_readAhead.get());
+}
+
+
+void FileReaderStream::start (float systemSampleRate, int bufferSize, bool offline)
+{
+    timestamp = 0;
+    m_offline = offline;
+
+    // both rates in mHz, so that the ratio between them is exact
+    m_fileRate = (int64) roundToInt (sampleRate * 1000.0);
+    m_sysRate = jmax ((int64) 1, (int64) roundToInt (systemSampleRate * 1000.0));
+    m_sampleRemainder = 0;
+
+    // each cache buffer holds BUFFER_WINDOW_CACHE_SIZE of the largest blocks process() can ask for
+    const int64 maxSamplesPerBuffer = ((int64) bufferSize * m_fileRate + m_sysRate - 1) / m_sysRate;
+    m_cacheSamples = (int) jmax ((int64) 1, maxSamplesPerBuffer * BUFFER_WINDOW_CACHE_SIZE);
+
+    m_channelPointers.malloc (jmax (1, numChannels));
+
+    m_bytesRead.set (0);
+    m_underruns.set (0);
+    m_maxReadMicroseconds.set (0);
+
+    input.setChannelMask (m_channelMask);
+
+    m_inactiveChannels.clearQuick();
+
+    for (int i = 0; i < numChannels; ++i)
+    {
+        if (! input.isChannelActive (i))
+            m_inactiveChannels.add (i);
+    }
+
+    m_zeroCopy = input.getDataPointer (startSample, 1) != nullptr;
+
+    // reset stream to beginning
+    input.seekTo (startSample);
+    currentSample = startSample;
+
+    if (m_zeroCopy)
+    {
+        input.prefetch (currentSample, m_cacheSamples);
+        m_readPosition = 0;
+
+        return;
+    }
+
+    // the whole ring is allocated up front, so that the read-ahead can deepen during playback
+    m_cache.malloc ((size_t) numChannels * m_cacheSamples * READ_AHEAD_MAX_BUFFERS);
+
+    m_frontBuffer = 0;
+    m_backBuffer = 0;
+    m_numFilled.set (0);
+    m_readAhead.set (READ_AHEAD_MIN_BUFFERS);
+
+    fillBackBuffer(); // pre-fill the front buffer with a blocking read
+
+    // with nothing left to read in the current front, the next call to process()
+    // moves on to the buffer just filled
+    m_holdingFront = false;
+    m_readPosition = m_cacheSamples;
+
+    if (! m_offline)
+        ThreadConfig::startThread (*this, ThreadConfig::RECORD_IO); // start async file reader thread
+}
+
+
+void FileReaderStream::stop()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (100);
+}
+
+
+int FileReaderStream::process (AudioSampleBuffer& buffer, int firstChannel, int numSystemSamples)
+{
+    // the file samples that fall within this block; what is left of the last one carries
+    // over to the next block, so the long-run rate is exact even when the ratio is not an integer
+    const int64 fileSamples = m_sampleRemainder + (int64) numSystemSamples * m_fileRate;
+    const int samplesNeededPerBuffer = (int) (fileSamples / m_sysRate);
+    m_sampleRemainder = fileSamples % m_sysRate;
+
+    // the source leaves the buffers of inactive channels as they were
+    for (int i = 0; i < m_inactiveChannels.size(); ++i)
+        buffer.clear (firstChannel + m_inactiveChannels.getUnchecked (i), 0, samplesNeededPerBuffer);
+
+    if (m_zeroCopy)
+        processInPlace (buffer, firstChannel, samplesNeededPerBuffer);
+    else
+        processFromCache (buffer, firstChannel, samplesNeededPerBuffer);
+
+    timestamp += samplesNeededPerBuffer;
+
+    return samplesNeededPerBuffer;
+}
+
+
+int16* FileReaderStream::getCacheBuffer (int index)
+{
+    return m_cache + (size_t) index * numChannels * m_cacheSamples;
+}
+
+
+void FileReaderStream::fillBackBuffer()
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    readAndFillBufferCache (getCacheBuffer (m_backBuffer));
+
+    const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    const int microseconds = (int) (seconds * 1.0e6);
+
+    if (microseconds > m_maxReadMicroseconds.get())
+        m_maxReadMicroseconds.set (microseconds);
+
+    m_bytesRead += (int64) m_cacheSamples * numChannels * sizeof (int16);
+
+    // playback needs the next buffer before this one is used up, so keep as many buffers
+    // ahead as it takes to cover a read this slow, with one to spare
+    const double bufferSeconds = m_cacheSamples / (double) sampleRate;
+    const int needed = (int) std::ceil (seconds / bufferSeconds) + 1;
+
+    if (needed > m_readAhead.get())
+        m_readAhead.set (jmin (needed, READ_AHEAD_MAX_BUFFERS));
+
+    m_backBuffer = (m_backBuffer + 1) % READ_AHEAD_MAX_BUFFERS;
+    ++m_numFilled;
+}
+
+
+void FileReaderStream::run()
+{
+    while (! threadShouldExit())
+    {
+        while (m_numFilled.get() < m_readAhead.get() && ! threadShouldExit())
+        {
+            fillBackBuffer();
+        }
+
+        // process() wakes us up when it has used up a buffer
+        wait (-1);
+    }
+}
+
+
+void FileReaderStream::processInPlace (AudioSampleBuffer& buffer, int firstChannel, int numSamples)
+{
+    int samplesDone = 0;
+
+    while (samplesDone < numSamples)
+    {
+        // reached the end of the selected range, resume from start
+        if (currentSample >= stopSample)
+            currentSample = startSample;
+
+        const int samplesToConvert = (int) jmin ((int64) (numSamples - samplesDone), stopSample - currentSample);
+
+        int16* data = input.getDataPointer (currentSample, samplesToConvert);
+
+        if (samplesToConvert <= 0 || data == nullptr)
+        {
+            for (int i = 0; i < numChannels; ++i)
+                buffer.clear (firstChannel + i, samplesDone, numSamples - samplesDone);
+
+            break;
+        }
+
+        for (int i = 0; i < numChannels; ++i)
+            m_channelPointers[i] = buffer.getWritePointer (firstChannel + i, samplesDone);
+
+        input.processAllChannelData (data, m_channelPointers, numChannels, samplesToConvert);
+        m_bytesRead += (int64) samplesToConvert * numChannels * sizeof (int16);
+
+        currentSample += samplesToConvert;
+        samplesDone += samplesToConvert;
+    }
+
+    // ask for the next cache-full of samples ahead of time, as often as the copying path
+    // refills its back buffer, so that page faults are rare on the audio thread
+    m_readPosition += numSamples;
+
+    if (m_readPosition >= m_cacheSamples)
+    {
+        m_readPosition = 0;
+
+        input.prefetch (currentSample, m_cacheSamples);
+
+        if (currentSample + m_cacheSamples > stopSample)
+            input.prefetch (startSample, currentSample + m_cacheSamples - stopSample);
+    }
+}
+
+
+void FileReaderStream::processFromCache (AudioSampleBuffer& buffer, int firstChannel, int numSamples)
+{
+    int samplesDone = 0;
+
+    // a block can straddle the end of the front buffer, so it may be converted in two parts
+    while (samplesDone < numSamples)
+    {
+        // front buffer used up, hand it back to the reader thread and move on to the next one
+        if (m_readPosition >= m_cacheSamples)
+        {
+            if (m_holdingFront)
+            {
+                m_frontBuffer = (m_frontBuffer + 1) % READ_AHEAD_MAX_BUFFERS;
+                m_holdingFront = false;
+                --m_numFilled;
+                notify();
+            }
+
+            if (m_offline && m_numFilled.get() == 0)
+                fillBackBuffer();
+
+            // the reader thread has fallen behind: play silence rather than wait for it on the
+            // audio thread, and keep more buffers ahead from now on
+            if (m_numFilled.get() == 0)
+            {
+                for (int i = 0; i < numChannels; ++i)
+                    buffer.clear (firstChannel + i, samplesDone, numSamples - samplesDone);
+
+                ++m_underruns;
+
+                if (m_readAhead.get() < READ_AHEAD_MAX_BUFFERS)
+                    ++m_readAhead;
+
+                notify();
+                break;
+            }
+
+            m_holdingFront = true;
+            m_readPosition = 0;
+        }
+
+        const int samplesToConvert = jmin (numSamples - samplesDone, m_cacheSamples - m_readPosition);
+
+        for (int i = 0; i < numChannels; ++i)
+            m_channelPointers[i] = buffer.getWritePointer (firstChannel + i, samplesDone);
+
+        input.processAllChannelData (getCacheBuffer (m_frontBuffer) + (int64) m_readPosition * numChannels,
+                                     m_channelPointers,
+                                     numChannels,
+                                     samplesToConvert);
+
+        m_readPosition += samplesToConvert;
+        samplesDone += samplesToConvert;
+    }
+}
+
+
+void FileReaderStream::readAndFillBufferCache (int16* cacheBuffer)
+{
+    TRACE_SCOPE ("file reader", "fill cache buffer");
+
+    const int samplesNeeded = m_cacheSamples;
+
+    int samplesRead = 0;
+
+    // should only loop if reached end of file and resuming from start
+    while (samplesRead < samplesNeeded)
+    {
+        int samplesToRead = samplesNeeded - samplesRead;
+
+        // if reached end of file stream
+        if ( (currentSample + samplesToRead) > stopSample)
+        {
+            samplesToRead = stopSample - currentSample;
+            if (samplesToRead > 0)
+                input.readData (cacheBuffer + samplesRead * numChannels, samplesToRead);
+
+            // reset stream to beginning
+            input.seekTo (startSample);
+            currentSample = startSample;
+        }
+        else // else read the block needed
+        {
+            input.readData (cacheBuffer + samplesRead * numChannels, samplesToRead);
+
+            currentSample += samplesToRead;
+        }
+
+        samplesRead += samplesToRead;
+    }
+}
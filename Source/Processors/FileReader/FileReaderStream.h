@@ -0,0 +1,178 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef FILEREADERSTREAM_H_INCLUDED
+#define FILEREADERSTREAM_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "FileSource.h"
+#include "FileSeekIndex.h"
+
+#define BUFFER_WINDOW_CACHE_SIZE 10
+
+/* The reader thread keeps between this many cache buffers filled ahead of playback... */
+#define READ_AHEAD_MIN_BUFFERS 2
+/* ...and this many, growing the depth when reads are slow or playback catches up with it */
+#define READ_AHEAD_MAX_BUFFERS 8
+
+
+/** Read counters of the streams since playback started */
+struct FileReaderIOStats
+{
+    int64 bytesRead = 0;
+    int underruns = 0;                  // blocks played as silence because the cache ran dry
+    float maxReadMilliseconds = 0;      // the slowest fill of a cache buffer
+    int readAheadBuffers = 0;           // the deepest read-ahead of any stream
+};
+
+
+/**
+  Plays the continuous data of one record of a FileSource in a loop between
+  a start and a stop sample. The samples are read ahead on the stream's own
+  thread into a ring of cache buffers, unless the source exposes them in place.
+
+  The FileReader plays one stream per subprocessor.
+
+  @see FileReader, FileSource
+*/
+class FileReaderStream : private Thread
+{
+public:
+    /** Plays a record of an opened source, which must outlive the stream */
+    FileReaderStream (FileSource& source, int recordIndex);
+    ~FileReaderStream();
+
+    FileSource& getSource() const;
+    int getRecordIndex() const;
+
+    int getNumChannels()    const;
+    int64 getNumSamples()   const;
+    float getSampleRate()   const;
+
+    RecordedChannelInfo getChannelInfo (int channel) const;
+
+    /** Timestamp blocks and events of the record */
+    const FileSeekIndex& getSeekIndex() const;
+
+    int64 getStartSample() const;
+    int64 getStopSample()  const;
+
+    /** Sets the samples played in a loop; playback resumes from startSample */
+    void setRange (int64 startSample, int64 stopSample);
+
+    /** Reads and converts only the channels set in the mask; the others are played as silence.
+        Takes effect at the next start() */
+    void setChannelMask (const Array<bool>& mask);
+
+    /** Rewinds to the start sample and fills the caches, for blocks of bufferSize samples at
+        the system sample rate. Offline, the caches are filled on the processing thread. */
+    void start (float systemSampleRate, int bufferSize, bool offline);
+    void stop();
+
+    /** Converts the file samples that fall within the next numSystemSamples samples of the
+        system into channels [firstChannel, firstChannel + getNumChannels()) of the buffer,
+        and returns how many there were */
+    int process (AudioSampleBuffer& buffer, int firstChannel, int numSystemSamples);
+
+    /** The timestamp of the next sample process() converts, counting from 0 at start() */
+    int64 getTimestamp() const;
+
+    /** Adds the stream's counters to those of the other streams */
+    void addIOStats (FileReaderIOStats& stats) const;
+
+private:
+    FileSource& input;
+    const int recordIndex;
+
+    float sampleRate;
+    int numChannels;
+    int64 numSamples;
+    int64 currentSample;
+    int64 startSample;
+    int64 stopSample;
+    int64 timestamp;
+    Array<RecordedChannelInfo> channelInfo;
+    FileSeekIndex seekIndex;
+
+    Array<bool> m_channelMask;
+    Array<int> m_inactiveChannels;
+
+    /** READ_AHEAD_MAX_BUFFERS cache buffers, filled and converted in turn */
+    HeapBlock<int16> m_cache;
+    int m_frontBuffer;          // the buffer process() converts from
+    int m_backBuffer;           // the next buffer the reader thread fills
+    bool m_holdingFront;        // false when the front buffer has not been filled yet
+    Atomic<int> m_numFilled;    // buffers filled and not yet used up, the front one included
+    Atomic<int> m_readAhead;    // buffers the reader thread keeps filled
+
+    int m_readPosition;     // samples of the front buffer already converted
+    int m_cacheSamples;     // samples held by each cache buffer
+
+    Atomic<int64> m_bytesRead;
+    Atomic<int> m_underruns;
+    Atomic<int> m_maxReadMicroseconds;
+
+    /** File and system sample rates in mHz; each block takes
+        (numSamples * m_fileRate + m_sampleRemainder) / m_sysRate samples of the file */
+    int64 m_fileRate;
+    int64 m_sysRate;
+    int64 m_sampleRemainder;
+
+    /** True when the source exposes its samples in place, so process() converts
+        straight from them and the back buffer thread is not used */
+    bool m_zeroCopy;
+    HeapBlock<float*> m_channelPointers;
+
+    /** True when the graph runs offline; blocks then come faster than real time,
+        so the back buffer is filled on the processing thread instead */
+    bool m_offline;
+
+    int16* getCacheBuffer (int index);
+
+    /** Fills the back buffer, and deepens the read-ahead when the read took longer
+        than playback can wait for */
+    void fillBackBuffer();
+
+    /** Executes the background thread task */
+    void run() override;
+
+    /** Converts the next block straight from the source's own memory,
+        wrapping from stopSample back to startSample */
+    void processInPlace (AudioSampleBuffer& buffer, int firstChannel, int numSamples);
+
+    /** Converts the next block from the front buffer, moving on to the next
+        buffer of the ring when the front one runs out. If that one is not filled
+        yet, the rest of the block is silent. */
+    void processFromCache (AudioSampleBuffer& buffer, int firstChannel, int numSamples);
+
+    /** Reads a chunk of the file that fills an entire buffer cache.
+
+        This method will read into the buffer that passed in by the param
+     */
+    void readAndFillBufferCache (int16* cacheBuffer);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FileReaderStream);
+};
+
+
+#endif  // FILEREADERSTREAM_H_INCLUDED
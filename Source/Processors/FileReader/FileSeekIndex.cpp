@@ -0,0 +1,153 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "FileSeekIndex.h"
+
+
+FileSeekIndex::FileSeekIndex()
+{
+    clear (0);
+}
+
+
+void FileSeekIndex::clear (int64 numSamples_)
+{
+    numSamples = numSamples_;
+
+    blocks.clearQuick();
+    blocks.add ({ 0, 0 });
+
+    eventSamples.clearQuick();
+}
+
+
+void FileSeekIndex::addBlock (int64 sample, int64 timestamp)
+{
+    if (sample <= 0)
+        blocks.getReference (0) = { 0, timestamp };
+    else if (sample > blocks.getLast().sample)
+        blocks.add ({ sample, timestamp });
+}
+
+
+void FileSeekIndex::addEventTimestamp (int64 timestamp)
+{
+    eventSamples.add (getSampleForTimestamp (timestamp));
+}
+
+
+void FileSeekIndex::sortEvents()
+{
+    std::sort (eventSamples.begin(), eventSamples.end());
+}
+
+
+int FileSeekIndex::findBlockForSample (int64 sample) const
+{
+    // the last block that starts at or before the sample
+    int lo = 0, hi = blocks.size() - 1;
+
+    while (lo < hi)
+    {
+        const int mid = (lo + hi + 1) / 2;
+
+        if (blocks.getReference (mid).sample <= sample)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+
+int64 FileSeekIndex::getTimestampForSample (int64 sample) const
+{
+    const Block& block = blocks.getReference (findBlockForSample (sample));
+
+    return block.timestamp + (sample - block.sample);
+}
+
+
+int64 FileSeekIndex::getNextBlockStart (int64 sample) const
+{
+    const int next = findBlockForSample (sample) + 1;
+
+    return next < blocks.size() ? blocks.getReference (next).sample : numSamples;
+}
+
+
+int64 FileSeekIndex::getSampleForTimestamp (int64 timestamp) const
+{
+    // blocks are in recording order, so their timestamps increase too
+    int lo = 0, hi = blocks.size() - 1;
+
+    while (lo < hi)
+    {
+        const int mid = (lo + hi + 1) / 2;
+
+        if (blocks.getReference (mid).timestamp <= timestamp)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    const Block& block = blocks.getReference (lo);
+    const int64 blockEnd = (lo + 1 < blocks.size()) ? blocks.getReference (lo + 1).sample : numSamples;
+
+    if (timestamp < block.timestamp)
+        return block.sample;
+
+    // in the gap after the block, the start of the next one is closest in playback
+    return jmin (block.sample + (timestamp - block.timestamp), blockEnd);
+}
+
+
+int FileSeekIndex::getNumRecordings() const
+{
+    return blocks.size();
+}
+
+
+int64 FileSeekIndex::getRecordingStartSample (int index) const
+{
+    return blocks[index].sample;
+}
+
+
+int FileSeekIndex::getNumEvents() const
+{
+    return eventSamples.size();
+}
+
+
+int64 FileSeekIndex::getEventSample (int index) const
+{
+    return eventSamples[index];
+}
+
+
+int FileSeekIndex::findEventAtOrAfter (int64 sample) const
+{
+    return int (std::lower_bound (eventSamples.begin(), eventSamples.end(), sample) - eventSamples.begin());
+}
@@ -0,0 +1,97 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef FILESEEKINDEX_H_INCLUDED
+#define FILESEEKINDEX_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+
+
+/**
+    Maps between sample positions and timestamps of a record, and lists the
+    places playback can jump to, so that seeking never scans the data.
+
+    The timestamps are kept as blocks of consecutive values: a new block starts
+    wherever they jump, which is where a new recording was appended to the same
+    files. Events are kept as sorted sample positions. All lookups are binary
+    searches.
+
+    Filled by FileSource::fillSeekIndex() when a record is selected.
+
+    @see FileReader
+*/
+class PLUGIN_API FileSeekIndex
+{
+public:
+    FileSeekIndex();
+
+    /** Starts again with a single block, timestamps counting up from 0 */
+    void clear (int64 numSamples);
+
+    /** Starts a new block of consecutive timestamps at the given sample. Blocks
+        are added in order of their samples; the first one replaces the default. */
+    void addBlock (int64 sample, int64 timestamp);
+
+    /** Adds the timestamp of an event; call sortEvents() once they are all in */
+    void addEventTimestamp (int64 timestamp);
+    void sortEvents();
+
+    int64 getTimestampForSample (int64 sample) const;
+
+    /** The first sample of the block after the one holding the sample, or the
+        number of samples if it is in the last block */
+    int64 getNextBlockStart (int64 sample) const;
+
+    /** The sample closest to the timestamp: the first one of a block if the
+        timestamp falls in the gap before it */
+    int64 getSampleForTimestamp (int64 timestamp) const;
+
+    /** The recordings within the record, in order */
+    int getNumRecordings() const;
+    int64 getRecordingStartSample (int index) const;
+
+    int getNumEvents() const;
+    int64 getEventSample (int index) const;
+
+    /** The index of the first event at or after the sample, or getNumEvents() if none */
+    int findEventAtOrAfter (int64 sample) const;
+
+private:
+    struct Block
+    {
+        int64 sample;
+        int64 timestamp;
+    };
+
+    int findBlockForSample (int64 sample) const;
+
+    Array<Block> blocks;
+    Array<int64> eventSamples;
+    int64 numSamples;
+
+    JUCE_LEAK_DETECTOR (FileSeekIndex);
+};
+
+
+#endif  // FILESEEKINDEX_H_INCLUDED
@@ -108,6 +108,7 @@ void FileSource::setActiveRecord (int index)
 {
 //    activeRecord = index;
     activeRecord.set(index);
+    channelMask.clearQuick();
     updateActiveRecord();
 }
 
@@ -142,6 +143,63 @@ bool FileSource::OpenFile (File file)
     return fileOpened;
 }
 
+void FileSource::processAllChannelData (int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples)
+{
+    for (int i = 0; i < numChannels; ++i)
+    {
+        if (isChannelActive (i))
+            processChannelData (inBuffer, outBuffers[i], i, numSamples);
+    }
+}
+
+void FileSource::setChannelMask (const Array<bool>& mask)
+{
+    channelMask = mask;
+}
+
+bool FileSource::isChannelActive (int channel) const
+{
+    return channel >= channelMask.size() || channelMask.getUnchecked (channel);
+}
+
+int16* FileSource::getDataPointer (int64 sample, int64 numSamples)
+{
+    return nullptr;
+}
+
+void FileSource::prefetch (int64 sample, int64 numSamples)
+{
+}
+
+void FileSource::fillSeekIndex (FileSeekIndex& index)
+{
+    index.clear (getActiveNumSamples());
+}
+
+int FileSource::getNumEventStreams() const
+{
+    return 0;
+}
+
+RecordedEventStreamInfo FileSource::getEventStreamInfo (int stream) const
+{
+    return RecordedEventStreamInfo();
+}
+
+void FileSource::readEvents (int64 startTimestamp, int64 endTimestamp, Array<RecordedEvent>& events)
+{
+}
+
+double FileSource::getSyncTime (int64 sample)
+{
+    return double (sample) / getActiveSampleRate();
+}
+
+int64 FileSource::getSampleAtSyncTime (double seconds)
+{
+    return (int64) std::ceil (seconds * getActiveSampleRate());
+}
+
 bool FileSource::isReady()
 {
     return true;
@@ -26,6 +26,7 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../PluginManager/OpenEphysPlugin.h"
+#include "FileSeekIndex.h"
 
 
 struct RecordedChannelInfo
@@ -35,6 +36,32 @@ struct RecordedChannelInfo
 };
 
 
+/** A stream of TTL events or spikes recorded along with the active record */
+struct RecordedEventStreamInfo
+{
+    enum Type { TTL, SPIKE };
+
+    Type type { TTL };
+    String name;
+    int numChannels { 0 };      // TTL lines, or channels per spike electrode
+    int numElectrodes { 0 };    // 0 for TTL streams
+    int prePeakSamples { 0 };
+    int postPeakSamples { 0 };
+    Array<int> sourceChannels;  // spikes: the record channel of each electrode channel, electrode after electrode
+};
+
+
+/** A TTL edge or a spike read back from a file */
+struct RecordedEvent
+{
+    int64 timestamp;
+    int stream;
+    int value;                  // TTL: +line on a rising edge, -line on a falling one, from 1; spikes: electrode, from 0
+    uint16 sortedId;
+    const int16* waveform;      // spikes: numChannels x (pre + post) samples, scaled by the channels' bitVolts
+};
+
+
 class PLUGIN_API FileSource
 {
 public:
@@ -65,6 +92,46 @@ public:
 
     virtual int readData (int16* buffer, int nSamples) = 0;
     virtual void processChannelData (int16* inBuffer, float* outBuffer, int channel, int64 numSamples) = 0;
+
+    /** Converts a block of interleaved samples into one buffer per active channel. The default calls
+        processChannelData() for each of them; sources can override it to read the block once.
+        The buffers of inactive channels are left untouched. */
+    virtual void processAllChannelData (int16* inBuffer, float** outBuffers, int numChannels, int64 numSamples);
+
+    /** Limits the conversions to the channels of the active record set in the mask. Sources that
+        store channels apart also skip reading the others, whose samples are then undefined.
+        All channels are active by default, and again whenever the active record changes. */
+    virtual void setChannelMask (const Array<bool>& mask);
+    bool isChannelActive (int channel) const;
+
+    /** Returns the interleaved samples [sample, sample + numSamples) of the active record in place,
+        e.g. from a memory-mapped file, or nullptr if they can only be copied out with readData().
+        The pointer stays valid until the active record changes. */
+    virtual int16* getDataPointer (int64 sample, int64 numSamples);
+
+    /** Hints that the samples [sample, sample + numSamples) will be read soon */
+    virtual void prefetch (int64 sample, int64 numSamples);
+
+    /** Fills the index with the timestamp blocks and events of the active record. The
+        default leaves a single block with timestamps counting up from 0, and no events. */
+    virtual void fillSeekIndex (FileSeekIndex& index);
+
+    /** The event streams of the active record; none by default */
+    virtual int getNumEventStreams() const;
+    virtual RecordedEventStreamInfo getEventStreamInfo (int stream) const;
+
+    /** Appends the events of all streams with timestamps in [startTimestamp, endTimestamp),
+        in timestamp order. Reads normally follow on from each other, so sources can keep
+        their place between calls. Waveform pointers stay valid until the active record changes. */
+    virtual void readEvents (int64 startTimestamp, int64 endTimestamp, Array<RecordedEvent>& events);
+
+    /** The time of a sample of the active record, in seconds, on a clock that all the
+        records of the file share. The default counts from the record's first sample. */
+    virtual double getSyncTime (int64 sample);
+
+    /** The first sample of the active record at or after a time on the shared clock */
+    virtual int64 getSampleAtSyncTime (double seconds);
+
     virtual void seekTo (int64 sample) = 0;
 
     virtual bool isReady();
@@ -83,6 +150,7 @@ protected:
     int numRecords;
     Atomic<int> activeRecord;       // atomic to protect against threaded data race in FileReader
     String filename;
+    Array<bool> channelMask;        // empty when all channels are active
 
 
 private:
@@ -0,0 +1,441 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "OpenEphysFileSource.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OEF_USE_SSE2 1
+#endif
+
+using namespace OpenEphysSource;
+
+/* The layout written by OriginalRecording: a text header, then blocks of an int64 timestamp,
+   a uint16 sample count, a uint16 recording number, the samples and a 10-byte marker */
+#define HEADER_BYTES 1024
+#define BLOCK_SAMPLES 1024
+#define BLOCK_HEADER_BYTES 12
+#define BLOCK_MARKER_BYTES 10
+#define BLOCK_BYTES (BLOCK_HEADER_BYTES + BLOCK_SAMPLES * 2 + BLOCK_MARKER_BYTES)
+
+namespace
+{
+#if OEF_USE_SSE2
+	/* Turns 8 rows of 8 samples of a channel into 8 rows of a sample of 8 channels */
+	inline void transpose8x8(__m128i* r)
+	{
+		const __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);
+		const __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);
+		const __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+		const __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+		const __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+		const __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+		const __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+		const __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+		const __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+		const __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+		const __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+		const __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+		const __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+		const __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+		const __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+		const __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+		r[0] = _mm_unpacklo_epi64(u0, u4);
+		r[1] = _mm_unpackhi_epi64(u0, u4);
+		r[2] = _mm_unpacklo_epi64(u1, u5);
+		r[3] = _mm_unpackhi_epi64(u1, u5);
+		r[4] = _mm_unpacklo_epi64(u2, u6);
+		r[5] = _mm_unpackhi_epi64(u2, u6);
+		r[6] = _mm_unpacklo_epi64(u3, u7);
+		r[7] = _mm_unpackhi_epi64(u3, u7);
+	}
+#endif
+
+	/* Writes numSamples big-endian samples from each source into its channel of the
+	   interleaved frames at dest */
+	void interleaveSwapped(const uint8* const* sources, const int* channels, int numChannels,
+		int16* dest, int frameSize, int numSamples)
+	{
+		int k = 0;
+
+#if OEF_USE_SSE2
+		// 8 channels by 8 samples at a time: swap the bytes of each row, then transpose
+		for (; k + 8 <= numChannels; k += 8)
+		{
+			const bool contiguous = channels[k + 7] - channels[k] == 7;
+			int s = 0;
+
+			for (; s + 8 <= numSamples; s += 8)
+			{
+				__m128i r[8];
+
+				for (int i = 0; i < 8; i++)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sources[k + i] + s * 2));
+					r[i] = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+				}
+
+				transpose8x8(r);
+
+				for (int j = 0; j < 8; j++)
+				{
+					int16* frame = dest + (s + j) * frameSize;
+
+					if (contiguous)
+					{
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(frame + channels[k]), r[j]);
+					}
+					else
+					{
+						int16 values[8];
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(values), r[j]);
+
+						for (int i = 0; i < 8; i++)
+							frame[channels[k + i]] = values[i];
+					}
+				}
+			}
+
+			for (; s < numSamples; s++)
+			{
+				for (int i = 0; i < 8; i++)
+					dest[s * frameSize + channels[k + i]] = (int16) ByteOrder::bigEndianShort(sources[k + i] + s * 2);
+			}
+		}
+#endif
+
+		for (; k < numChannels; k++)
+		{
+			for (int s = 0; s < numSamples; s++)
+				dest[s * frameSize + channels[k]] = (int16) ByteOrder::bigEndianShort(sources[k] + s * 2);
+		}
+	}
+
+	/* What follows the channel name in a file name, e.g. "_2" for the second experiment */
+	String getFileSuffix(const File& file)
+	{
+		const String channelAndSuffix = file.getFileNameWithoutExtension().fromFirstOccurrenceOf("_", false, false);
+
+		return channelAndSuffix.contains("_") ? channelAndSuffix.fromFirstOccurrenceOf("_", true, false) : String::empty;
+	}
+
+	String getHeaderValue(const String& header, const String& key)
+	{
+		return header.fromFirstOccurrenceOf("header." + key + " = ", false, false)
+			.upToFirstOccurrenceOf(";", false, false)
+			.trim()
+			.unquoted();
+	}
+
+	/* Headstage channels first, then auxiliary and ADC channels, each in numeric order */
+	struct ChannelOrder
+	{
+		static int getRank(const String& name)
+		{
+			if (name.startsWith("CH")) return 0;
+			if (name.startsWith("AUX")) return 1;
+			if (name.startsWith("ADC")) return 2;
+			return 3;
+		}
+
+		template <typename ChannelType>
+		static int compareElements(const ChannelType* first, const ChannelType* second)
+		{
+			const int rank = getRank(first->name) - getRank(second->name);
+
+			return rank != 0 ? rank : first->name.compareNatural(second->name);
+		}
+	};
+}
+
+OpenEphysFileSource::OpenEphysFileSource() : m_firstBlock(0), m_samplePos(0)
+{}
+
+OpenEphysFileSource::~OpenEphysFileSource()
+{}
+
+bool OpenEphysFileSource::Open(File file)
+{
+	m_channels.clear();
+
+	const String node = file.getFileNameWithoutExtension().upToFirstOccurrenceOf("_", false, false);
+	const String suffix = getFileSuffix(file);
+
+	Array<File> files;
+	file.getParentDirectory().findChildFiles(files, File::findFiles, false, node + "_*.continuous");
+
+	float sampleRate = 0;
+	int64 numBlocks = -1;
+
+	for (int i = 0; i < files.size(); i++)
+	{
+		// other experiments and recordings written to separate files are left out
+		if (getFileSuffix(files[i]) != suffix)
+			continue;
+
+		FileInputStream stream(files[i]);
+		if (stream.failedToOpen() || stream.getTotalLength() < HEADER_BYTES)
+			continue;
+
+		HeapBlock<char> headerText;
+		headerText.calloc(HEADER_BYTES + 1);
+		stream.read(headerText, HEADER_BYTES);
+		const String header(headerText.getData());
+
+		if (!header.contains("Open Ephys Data Format"))
+			continue;
+
+		ScopedPointer<ChannelFile> channel = new ChannelFile();
+		channel->file = files[i];
+		channel->name = getHeaderValue(header, "channel");
+		channel->sampleRate = getHeaderValue(header, "sampleRate").getFloatValue();
+		channel->bitVolts = getHeaderValue(header, "bitVolts").getFloatValue();
+		channel->data = new MemoryMappedFile(files[i], MemoryMappedFile::readOnly);
+
+		if (channel->data->getData() == nullptr || channel->sampleRate <= 0)
+			continue;
+
+		// all the channels of a processor share their rate; a file cut short limits the others
+		if (sampleRate == 0)
+			sampleRate = channel->sampleRate;
+		else if (channel->sampleRate != sampleRate)
+			continue;
+
+		const int64 channelBlocks = ((int64) channel->data->getSize() - HEADER_BYTES) / BLOCK_BYTES;
+		numBlocks = numBlocks < 0 ? channelBlocks : jmin(numBlocks, channelBlocks);
+
+		m_channels.add(channel.release());
+	}
+
+	if (m_channels.size() == 0 || numBlocks <= 0)
+	{
+		std::cout << "No Open Ephys continuous data found." << std::endl;
+		return false;
+	}
+
+	ChannelOrder order;
+	m_channels.sort(order);
+
+	// the block headers are the same in every file, so the first one indexes them all
+	m_blockTimestamps.clearQuick();
+	m_blockTimestamps.ensureStorageAllocated((int) numBlocks);
+	m_records.clearQuick();
+
+	const uint8* data = static_cast<const uint8*>(m_channels[0]->data->getData()) + HEADER_BYTES;
+
+	for (int64 b = 0; b < numBlocks; b++)
+	{
+		const uint8* block = data + b * BLOCK_BYTES;
+		const int recordingNumber = ByteOrder::littleEndianShort(block + 10);
+
+		if (ByteOrder::littleEndianShort(block + 8) != BLOCK_SAMPLES)
+			break;
+
+		m_blockTimestamps.add((int64) ByteOrder::littleEndianInt64(block));
+
+		if (m_records.size() == 0 || m_records.getLast().recordingNumber != recordingNumber)
+		{
+			RecordBlocks record;
+			record.recordingNumber = recordingNumber;
+			record.firstBlock = b;
+			record.numBlocks = 0;
+			m_records.add(record);
+		}
+
+		m_records.getReference(m_records.size() - 1).numBlocks++;
+	}
+
+	return m_records.size() > 0;
+}
+
+void OpenEphysFileSource::fillRecordInfo()
+{
+	for (int r = 0; r < m_records.size(); r++)
+	{
+		RecordInfo info;
+
+		info.name = "Recording " + String(m_records[r].recordingNumber + 1);
+		info.sampleRate = m_channels[0]->sampleRate;
+		info.numSamples = m_records[r].numBlocks * BLOCK_SAMPLES;
+
+		for (int c = 0; c < m_channels.size(); c++)
+		{
+			RecordedChannelInfo cInfo;
+
+			cInfo.name = m_channels[c]->name;
+			cInfo.bitVolts = m_channels[c]->bitVolts;
+
+			info.channels.add(cInfo);
+		}
+
+		infoArray.add(info);
+		numRecords++;
+	}
+}
+
+void OpenEphysFileSource::updateActiveRecord()
+{
+	m_firstBlock = m_records[activeRecord.get()].firstBlock;
+	m_samplePos = 0;
+
+	m_activeChannels.clearQuick();
+
+	for (int c = 0; c < m_channels.size(); c++)
+	{
+		m_activeChannels.add(c);
+
+#if JUCE_LINUX || JUCE_MAC
+		// playback walks the files front to back, so let the kernel read ahead aggressively
+		madvise(m_channels[c]->data->getData(), m_channels[c]->data->getSize(), MADV_SEQUENTIAL);
+#endif
+	}
+}
+
+const uint8* OpenEphysFileSource::getBlockSamples(const ChannelFile& channel, int64 block) const
+{
+	return static_cast<const uint8*>(channel.data->getData()) + HEADER_BYTES + block * BLOCK_BYTES + BLOCK_HEADER_BYTES;
+}
+
+void OpenEphysFileSource::setChannelMask(const Array<bool>& mask)
+{
+	FileSource::setChannelMask(mask);
+
+	// the files of inactive channels are not read at all
+	m_activeChannels.clearQuick();
+
+	for (int c = 0; c < m_channels.size(); c++)
+	{
+		if (isChannelActive(c))
+			m_activeChannels.add(c);
+	}
+}
+
+void OpenEphysFileSource::seekTo(int64 sample)
+{
+	m_samplePos = sample;
+}
+
+int OpenEphysFileSource::readData(int16* buffer, int nSamples)
+{
+	const int numChannels = getActiveNumChannels();
+	const int numActive = m_activeChannels.size();
+	const int samplesToRead = (int) jlimit((int64) 0, (int64) nSamples, getActiveNumSamples() - m_samplePos);
+
+	const uint8* sources[64];
+	int samplesRead = 0;
+
+	while (samplesRead < samplesToRead)
+	{
+		const int64 position = m_samplePos + samplesRead;
+		const int64 block = m_firstBlock + position / BLOCK_SAMPLES;
+		const int offset = (int) (position % BLOCK_SAMPLES);
+		const int count = jmin(samplesToRead - samplesRead, BLOCK_SAMPLES - offset);
+
+		// the channels of the block in batches of up to 64
+		for (int k0 = 0; k0 < numActive; k0 += 64)
+		{
+			const int batch = jmin(64, numActive - k0);
+			const int* channels = m_activeChannels.getRawDataPointer() + k0;
+
+			for (int k = 0; k < batch; k++)
+				sources[k] = getBlockSamples(*m_channels[channels[k]], block) + offset * 2;
+
+			interleaveSwapped(sources, channels, batch, buffer + (int64) samplesRead * numChannels, numChannels, count);
+		}
+
+		samplesRead += count;
+	}
+
+	m_samplePos += samplesToRead;
+	return samplesToRead;
+}
+
+void OpenEphysFileSource::processChannelData(int16* inBuffer, float* outBuffer, int channel, int64 numSamples)
+{
+	const int n = getActiveNumChannels();
+	const float bitVolts = m_channels[channel]->bitVolts;
+
+	for (int64 i = 0; i < numSamples; i++)
+	{
+		outBuffer[i] = inBuffer[n * i + channel] * bitVolts;
+	}
+}
+
+void OpenEphysFileSource::prefetch(int64 sample, int64 numSamples)
+{
+#if JUCE_LINUX || JUCE_MAC
+	const int64 totalSamples = getActiveNumSamples();
+
+	sample = jlimit((int64) 0, totalSamples, sample);
+	numSamples = jmin(numSamples, totalSamples - sample);
+
+	if (numSamples <= 0)
+		return;
+
+	// madvise() wants a page-aligned start
+	static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+
+	const int64 firstBlock = m_firstBlock + sample / BLOCK_SAMPLES;
+	const int64 lastBlock = m_firstBlock + (sample + numSamples - 1) / BLOCK_SAMPLES;
+
+	for (int k = 0; k < m_activeChannels.size(); k++)
+	{
+		const ChannelFile& channel = *m_channels[m_activeChannels[k]];
+
+		char* base = static_cast<char*>(channel.data->getData());
+		const size_t offset = (size_t) (HEADER_BYTES + firstBlock * BLOCK_BYTES);
+		const size_t alignedOffset = offset - offset % pageSize;
+		const size_t length = (size_t) ((lastBlock - firstBlock + 1) * BLOCK_BYTES) + offset - alignedOffset;
+
+		madvise(base + alignedOffset, length, MADV_WILLNEED);
+	}
+#endif
+}
+
+void OpenEphysFileSource::fillSeekIndex(FileSeekIndex& index)
+{
+	const RecordBlocks& record = m_records.getReference(activeRecord.get());
+
+	index.clear(getActiveNumSamples());
+
+	// a new block wherever the timestamps don't follow on from the block before
+	for (int64 b = 0; b < record.numBlocks; b++)
+	{
+		const int64 timestamp = m_blockTimestamps[(int) (record.firstBlock + b)];
+
+		if (b == 0 || timestamp != m_blockTimestamps[(int) (record.firstBlock + b - 1)] + BLOCK_SAMPLES)
+			index.addBlock(b * BLOCK_SAMPLES, timestamp);
+	}
+}
+
+bool OpenEphysFileSource::isReady()
+{
+	return true;
+}
@@ -0,0 +1,100 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2018 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef OPENEPHYSFILESOURCE_H_INCLUDED
+#define OPENEPHYSFILESOURCE_H_INCLUDED
+
+#include "../FileSource.h"
+
+namespace OpenEphysSource
+{
+	/** Reads the .continuous files written by the Open Ephys format engine.
+
+		Each channel is in its own file, so opening one of them opens all the files of the
+		same processor next to it. A file is a text header followed by fixed-size blocks of
+		1024 big-endian samples, each with its timestamp and recording number. The blocks of
+		the first file are indexed at open; every recording number is a record.
+
+		Only the files of active channels are read. Their samples are byte-swapped and
+		interleaved 8 channels by 8 samples at a time. */
+	class OpenEphysFileSource : public FileSource
+	{
+	public:
+		OpenEphysFileSource();
+		~OpenEphysFileSource();
+
+		int readData(int16* buffer, int nSamples) override;
+
+		void seekTo(int64 sample) override;
+
+		void processChannelData(int16* inBuffer, float* outBuffer, int channel, int64 numSamples) override;
+
+		void setChannelMask(const Array<bool>& mask) override;
+
+		void prefetch(int64 sample, int64 numSamples) override;
+
+		/** Indexes the blocks whose timestamps don't follow on from the one before */
+		void fillSeekIndex(FileSeekIndex& index) override;
+
+		bool isReady() override;
+
+	private:
+		bool Open(File file) override;
+		void fillRecordInfo() override;
+		void updateActiveRecord() override;
+
+		struct ChannelFile
+		{
+			File file;
+			String name;
+			float sampleRate;
+			float bitVolts;
+			ScopedPointer<MemoryMappedFile> data;
+		};
+
+		/** Where the blocks of a recording are in every channel file */
+		struct RecordBlocks
+		{
+			int recordingNumber;
+			int64 firstBlock;
+			int64 numBlocks;
+		};
+
+		/** The start of a block's samples in a channel file */
+		const uint8* getBlockSamples(const ChannelFile& channel, int64 block) const;
+
+		OwnedArray<ChannelFile> m_channels;
+		Array<RecordBlocks> m_records;
+
+		/* The timestamp of each block of the first channel file */
+		Array<int64> m_blockTimestamps;
+
+		/* The channels readData() reads, in order */
+		Array<int> m_activeChannels;
+
+		int64 m_firstBlock;
+		int64 m_samplePos;
+	};
+}
+
+#endif
@@ -0,0 +1,244 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ChannelWorkerPool.h"
+#include "../../Utils/AllocationCounter.h"
+#include "../../Utils/ThreadConfig.h"
+
+/* The caller processes ranges itself */
+#define MAX_CHANNEL_WORKERS 15
+/* Ranges a job is split into per thread, so the threads that finish early take more of them */
+#define CHANNEL_RANGES_PER_THREAD 4
+
+ChannelWorkerPool* ChannelWorkerPool::getInstance()
+{
+	static ChannelWorkerPool pool;
+	return &pool;
+}
+
+ChannelWorkerPool::ChannelWorkerPool() :
+	running(false),
+	nextWorker(0)
+{
+}
+
+ChannelWorkerPool::~ChannelWorkerPool()
+{
+	stop();
+}
+
+void ChannelWorkerPool::start()
+{
+	const ScopedLock sl(startStopLock);
+
+	if (workers.size() > 0)
+		return;
+
+	int numWorkers = jmin(SystemStats::getNumCpus() - 1, MAX_CHANNEL_WORKERS);
+
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		Worker* worker = new Worker(*this, i + 1);
+		ThreadConfig::startThread(*worker, ThreadConfig::COMPUTE_POOL);
+		workers.add(worker);
+	}
+
+	running = numWorkers > 0;
+}
+
+void ChannelWorkerPool::stop()
+{
+	const ScopedLock sl(startStopLock);
+
+	running = false;
+
+	/* Wait for the running jobs to finish */
+	for (auto& slot : slots)
+		while (slot.inUse)
+			Thread::yield();
+
+	for (auto worker : workers)
+	{
+		worker->signalThreadShouldExit();
+		worker->wakeUp.signal();
+	}
+	for (auto worker : workers)
+		worker->stopThread(1000);
+
+	workers.clear();
+}
+
+int ChannelWorkerPool::getNumThreads() const
+{
+	return workers.size() + 1;
+}
+
+int ChannelWorkerPool::JobSlot::getRangeStart(int range) const
+{
+	if (range >= numRanges)
+		return numChannels;
+
+	int numBlocks = (numChannels + alignment - 1) / alignment;
+	int start = (numBlocks * range / numRanges) * alignment;
+	return jmin(start, numChannels);
+}
+
+void ChannelWorkerPool::run(ChannelRangeJob& job, int numChannels, int minChannelsPerRange, int channelAlignment)
+{
+	int numRanges = jmin(getNumThreads() * CHANNEL_RANGES_PER_THREAD, numChannels / jmax(1, minChannelsPerRange));
+
+	if (numRanges <= 1 || !running)
+	{
+		job.processChannelRange(0, numChannels);
+		return;
+	}
+
+	JobSlot* slot = nullptr;
+
+	for (auto& s : slots)
+	{
+		bool expected = false;
+		if (s.inUse.compare_exchange_strong(expected, true))
+		{
+			slot = &s;
+			break;
+		}
+	}
+
+	/* stop() may have started waiting for the slots before this one was taken */
+	if (slot != nullptr && !running)
+	{
+		slot->inUse = false;
+		slot = nullptr;
+	}
+
+	if (slot == nullptr)
+	{
+		job.processChannelRange(0, numChannels);
+		return;
+	}
+
+	slot->job = &job;
+	slot->tally = AllocationCounter::getThreadTally();
+	slot->numChannels = numChannels;
+	slot->numRanges = numRanges;
+	slot->alignment = jmax(1, channelAlignment);
+	slot->nextRange = 0;
+	slot->pendingRanges = numRanges;
+	slot->open = true;
+
+	const int numWorkers = workers.size();
+	const int numToWake = jmin(numRanges - 1, numWorkers);
+	const int firstWorker = nextWorker.fetch_add(numToWake);
+
+	for (int i = 0; i < numToWake; ++i)
+		workers.getUnchecked((firstWorker + i) % numWorkers)->wakeUp.signal();
+
+	processRanges(*slot);
+
+	/* Whoever finishes the last range signals, exactly once per run */
+	slot->allRangesDone.wait();
+
+	/* Wait for the workers that are still looking at the slot before it can be reused */
+	slot->open = false;
+	while (slot->visitors > 0)
+		Thread::yield();
+
+	slot->job = nullptr;
+	slot->inUse = false;
+}
+
+bool ChannelWorkerPool::processRanges(JobSlot& slot)
+{
+	bool processed = false;
+
+	while (true)
+	{
+		const int range = slot.nextRange.fetch_add(1);
+
+		if (range >= slot.numRanges)
+			return processed;
+
+		const int start = slot.getRangeStart(range);
+		const int end = slot.getRangeStart(range + 1);
+
+		if (start < end)
+			slot.job->processChannelRange(start, end);
+
+		processed = true;
+
+		if (--slot.pendingRanges == 0)
+			slot.allRangesDone.signal();
+	}
+}
+
+bool ChannelWorkerPool::visitSlots()
+{
+	bool processed = false;
+
+	for (auto& slot : slots)
+	{
+		++slot.visitors;
+
+		if (slot.open)
+		{
+			AllocationCounter::setThreadTally(slot.tally);
+			processed = processRanges(slot) || processed;
+			AllocationCounter::setThreadTally(nullptr);
+		}
+
+		--slot.visitors;
+	}
+
+	return processed;
+}
+
+ChannelWorkerPool::Worker::Worker(ChannelWorkerPool& pool_, int index_) :
+	Thread("Channel Worker " + String(index_)),
+	pool(pool_),
+	index(index_)
+{
+}
+
+void ChannelWorkerPool::Worker::run()
+{
+	// same floating point mode as the audio thread
+	FloatVectorOperations::disableDenormalisedNumberSupport();
+
+	AllocationCounter::setThreadCounted(true);
+
+	while (true)
+	{
+		wakeUp.wait();
+
+		if (threadShouldExit())
+			break;
+
+		ThreadConfig::applyToCurrentThread(ThreadConfig::COMPUTE_POOL);
+
+		/* Keep helping while there are ranges left, of this job or of another one */
+		while (pool.visitSlots())
+			;
+	}
+}
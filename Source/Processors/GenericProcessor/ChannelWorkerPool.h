@@ -0,0 +1,150 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CHANNELWORKERPOOL_H_3B9E61D2__
+#define __CHANNELWORKERPOOL_H_3B9E61D2__
+
+#include <JuceHeader.h>
+#include "../PluginManager/OpenEphysPlugin.h"
+
+#include <atomic>
+
+/* Jobs that can run on the workers at the same time, from processors on different threads */
+#define MAX_CONCURRENT_CHANNEL_JOBS 4
+
+class AllocationTally;
+
+/** Work split into channel ranges by ChannelWorkerPool */
+class PLUGIN_API ChannelRangeJob
+{
+public:
+	virtual ~ChannelRangeJob() {}
+
+	/** Processes channels [startChannel, endChannel) */
+	virtual void processChannelRange(int startChannel, int endChannel) = 0;
+};
+
+/**
+	A pool of real-time worker threads, shared by all processors, that splits the channels
+	of a block into contiguous ranges and processes them in parallel.
+
+	A job is split into a few ranges per thread, and the workers and the calling thread
+	take the next unprocessed range until none are left, so a range that runs long does
+	not hold up the others. The boundaries only depend on the number of channels and
+	threads, so a channel is always processed within the same range, and run() returns
+	once every range is done.
+
+	Up to MAX_CONCURRENT_CHANNEL_JOBS jobs, from processors running on different threads,
+	share the workers at a time. The number of workers is fixed when acquisition starts;
+	at any other time, or if every job slot is taken, run() processes all channels on the
+	calling thread. run() neither allocates nor locks.
+
+	@see GenericProcessor::forEachChannelRange, CoreServices::parallelFor
+*/
+class PLUGIN_API ChannelWorkerPool
+{
+public:
+	static ChannelWorkerPool* getInstance();
+
+	/** Starts the worker threads. Called by the ProcessorGraph when acquisition starts. */
+	void start();
+
+	/** Stops the worker threads once the running jobs are done. Called by the ProcessorGraph
+		when acquisition stops. */
+	void stop();
+
+	/** Number of threads a job can run on, including the calling one */
+	int getNumThreads() const;
+
+	/** Splits numChannels into ranges of at least minChannelsPerRange channels, with boundaries
+		on multiples of channelAlignment, and returns when all of them have been processed */
+	void run(ChannelRangeJob& job, int numChannels, int minChannelsPerRange = 1, int channelAlignment = 1);
+
+	/** Calls function(startChannel, endChannel) for the ranges of numChannels, as run() does */
+	template <typename RangeFunction>
+	void parallelFor(int numChannels, RangeFunction& function, int minChannelsPerRange = 1, int channelAlignment = 1)
+	{
+		struct Job : public ChannelRangeJob
+		{
+			Job(RangeFunction& f) : rangeFunction(f) {}
+			void processChannelRange(int startChannel, int endChannel) override { rangeFunction(startChannel, endChannel); }
+			RangeFunction& rangeFunction;
+		};
+
+		Job job(function);
+		run(job, numChannels, minChannelsPerRange, channelAlignment);
+	}
+
+private:
+	class Worker : public Thread
+	{
+	public:
+		Worker(ChannelWorkerPool& pool, int index);
+		void run() override;
+
+		WaitableEvent wakeUp;
+
+	private:
+		ChannelWorkerPool& pool;
+		const int index;
+	};
+
+	/** A job being run, and the ranges of it still to be taken */
+	struct JobSlot
+	{
+		std::atomic<bool> inUse { false };		// claimed by a caller of run()
+		std::atomic<bool> open { false };		// its ranges may be taken
+		std::atomic<int> visitors { 0 };		// workers looking at the slot
+		std::atomic<int> nextRange { 0 };
+		std::atomic<int> pendingRanges { 0 };	// ranges not finished yet
+		WaitableEvent allRangesDone;
+
+		ChannelRangeJob* job = nullptr;
+		AllocationTally* tally = nullptr;		// of the processor that runs the job
+		int numChannels = 0;
+		int numRanges = 1;
+		int alignment = 1;
+
+		int getRangeStart(int range) const;
+	};
+
+	ChannelWorkerPool();
+	~ChannelWorkerPool();
+
+	/** Takes and processes ranges of a slot until none are left; returns true if it processed any */
+	bool processRanges(JobSlot& slot);
+
+	/** Takes ranges of any open slot, as a worker */
+	bool visitSlots();
+
+	OwnedArray<Worker> workers;
+	CriticalSection startStopLock;
+	std::atomic<bool> running;
+	std::atomic<int> nextWorker;	// the first worker the next job wakes up
+
+	JobSlot slots[MAX_CONCURRENT_CHANNEL_JOBS];
+
+	JUCE_DECLARE_NON_COPYABLE(ChannelWorkerPool);
+};
+
+#endif  // __CHANNELWORKERPOOL_H_3B9E61D2__
@@ -24,6 +24,9 @@
 #include "../../UI/UIComponent.h"
 #include "../../AccessClass.h"
 #include "../../Utils/Utils.h"
+#include "../../Utils/PipelineTrace.h"
+#include "../../CoreServices.h"
+#include "../ProcessorGraph/LoadShedder.h"
 
 #include <exception>
 
@@ -45,9 +48,19 @@ GenericProcessor::GenericProcessor(const String& name)
 	, m_processorType(PROCESSOR_TYPE_UTILITY)
 	, m_name(name)
 	, m_isParamsWereLoaded(false)
+	, m_parameterFifo(PARAMETER_QUEUE_SIZE)
+	, m_parameterChanges(PARAMETER_QUEUE_SIZE)
+	, m_queueParameterChanges(false)
+	, m_applyingParameterChanges(0)
 {
 	settings.numInputs = settings.numOutputs = 0;
 	m_lastProcessTime = Time::getHighResolutionTicks();
+	m_lastAllocationCount = 0;
+	m_eventScratchSize = 0;
+	m_eventBufferReserve = 0;
+	m_blockEventsData = nullptr;
+	m_blockEventsSize = 0;
+	m_mergeEventStreams = false;
 }
 
 
@@ -101,7 +114,9 @@ Parameter* GenericProcessor::getParameterObject(int parameterIndex) const
 
 void GenericProcessor::setParameter(int parameterIndex, float newValue)
 {
-	editor->updateParameterButtons(parameterIndex);
+	//the editor can't be touched from the processing thread
+	if (!isApplyingParameterChanges())
+		editor->updateParameterButtons(parameterIndex);
 	LOGD("Setting parameter");
 
 	if (currentChannel >= 0)
@@ -109,6 +124,120 @@ void GenericProcessor::setParameter(int parameterIndex, float newValue)
 }
 
 
+void GenericProcessor::queueParameterChange(int parameterIndex, float newValue, int channel)
+{
+	//a change to a parameter and channel that is still held back replaces the one held back
+	for (int i = m_heldParameterChanges.size(); --i >= 0;)
+	{
+		const ParameterChange& held = m_heldParameterChanges.getReference(i);
+		if (held.parameterIndex == parameterIndex && held.channel == channel)
+			m_heldParameterChanges.remove(i);
+	}
+
+	ParameterChange change;
+	change.parameterIndex = parameterIndex;
+	change.value = newValue;
+	change.channel = channel;
+	m_heldParameterChanges.add(change);
+
+	if (m_queueParameterChanges)
+	{
+		//the held back changes go first, so they keep their order
+		int numQueued = 0;
+		while (numQueued < m_heldParameterChanges.size())
+		{
+			int start1, size1, start2, size2;
+			m_parameterFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+			if (size1 + size2 == 0)
+				break;
+
+			m_parameterChanges[size1 > 0 ? start1 : start2] = m_heldParameterChanges.getReference(numQueued++);
+			m_parameterFifo.finishedWrite(1);
+		}
+
+		m_heldParameterChanges.removeRange(0, numQueued);
+
+		if (m_heldParameterChanges.size() > 0)
+			LOGD(getName(), ": parameter queue full, holding back ", m_heldParameterChanges.size(), " changes");
+	}
+	else
+	{
+		applyHeldParameterChanges();
+	}
+}
+
+
+bool GenericProcessor::isApplyingParameterChanges() const
+{
+	return m_applyingParameterChanges.get() != 0;
+}
+
+
+void GenericProcessor::applyHeldParameterChanges()
+{
+	//changes left over from the last acquisition go first. The processing thread is stopped, so they can be applied from here
+	applyParameterChanges();
+
+	const int previousChannel = currentChannel;
+
+	for (int i = 0; i < m_heldParameterChanges.size(); i++)
+	{
+		const ParameterChange& change = m_heldParameterChanges.getReference(i);
+		setCurrentChannel(change.channel);
+		setParameter(change.parameterIndex, change.value);
+	}
+
+	m_heldParameterChanges.clearQuick();
+	currentChannel = previousChannel;
+}
+
+
+void GenericProcessor::applyParameterChanges()
+{
+	int start1, size1, start2, size2;
+	m_parameterFifo.prepareToRead(m_parameterFifo.getNumReady(), start1, size1, start2, size2);
+
+	if (size1 + size2 == 0)
+		return;
+
+	m_applyingParameterChanges = m_queueParameterChanges ? 1 : 0;
+	const int previousChannel = currentChannel;
+
+	for (int i = 0; i < size1 + size2; i++)
+	{
+		const ParameterChange& change = m_parameterChanges[i < size1 ? start1 + i : start2 + i - size1];
+		currentChannel = change.channel;
+		setParameter(change.parameterIndex, change.value);
+
+		if (isApplyingParameterChanges())
+			recordParameterChange(change);
+	}
+
+	currentChannel = previousChannel;
+	m_applyingParameterChanges = 0;
+	m_parameterFifo.finishedRead(size1 + size2);
+}
+
+
+void GenericProcessor::recordParameterChange(const ParameterChange& change)
+{
+	// formatted on the stack and pushed without locking, as this runs on the processing thread
+	char text[256];
+	int size;
+
+	if (const Parameter* parameter = parameters[change.parameterIndex])
+		size = snprintf(text, sizeof(text), "Parameter change: %s (%d) %s channel %d = %g",
+			m_name.toRawUTF8(), nodeId, parameter->getName().toRawUTF8(), change.channel, change.value);
+	else
+		size = snprintf(text, sizeof(text), "Parameter change: %s (%d) parameter %d channel %d = %g",
+			m_name.toRawUTF8(), nodeId, change.parameterIndex, change.channel, change.value);
+
+	if (size > 0)
+		CoreServices::sendAnnotation(text, jmin(size, (int)sizeof(text) - 1));
+}
+
+
 const String GenericProcessor::getParameterName(int parameterIndex)
 {
 	return parameters[parameterIndex]->getName();
@@ -306,9 +435,15 @@ void GenericProcessor::update()
 	//	settings.numOutputs = 0;
 	//}
 
+	m_ignoredEventChannels.clear();
+	m_ignoredSpikeChannels.clear();
+
 	updateSettings(); // allow processors to change custom settings
 
 	updateChannelIndexes();
+	reserveEventStorage();
+
+	m_mergeEventStreams = sourceNode != nullptr && (sourceNode->isMerger() || sourceNode->m_mergeEventStreams);
 
 	m_needsToSendTimestampMessages.clear();
 	m_needsToSendTimestampMessages.insertMultiple(-1, false, getNumSubProcessors());
@@ -343,7 +478,7 @@ void GenericProcessor::updateChannelIndexes(bool updateNodeID)
 			channel->m_currentNodeType = getName(); //Fix when the ability to name individual processors is implemented
 		}
 		uint32 sourceID = getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx());
-		dataChannelMap[sourceID][channel->getSourceIndex()] = i;
+		dataChannelMap[sourceID].set(channel->getSourceIndex(), i);
 	}
 	nChans = eventChannelArray.size();
 	for (int i = 0; i < nChans; i++)
@@ -357,7 +492,7 @@ void GenericProcessor::updateChannelIndexes(bool updateNodeID)
 			channel->m_currentNodeType = getName(); //Fix when the ability to name individual processors is implemented
 		}
 		uint32 sourceID = getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx());
-		eventChannelMap[sourceID][channel->getSourceIndex()] = i;
+		eventChannelMap[sourceID].set(channel->getSourceIndex(), i);
 	}
 	nChans = spikeChannelArray.size();
 	for (int i = 0; i < nChans; i++)
@@ -371,8 +506,10 @@ void GenericProcessor::updateChannelIndexes(bool updateNodeID)
 			channel->m_currentNodeType = getName(); //Fix when the ability to name individual processors is implemented
 		}
 		uint32 sourceID = getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx());
-		spikeChannelMap[sourceID][channel->getSourceIndex()] = i;
+		spikeChannelMap[sourceID].set(channel->getSourceIndex(), i);
 	}
+
+	updateSourceSlots();
 }
 
 void GenericProcessor::createDataChannels()
@@ -495,67 +632,22 @@ void GenericProcessor::disableEditor()
 /** Used to get the number of samples in a given buffer, for a given channel. */
 uint32 GenericProcessor::getNumSamples(int channelNum) const
 {
-	int sourceNodeId = 0;
-	int subProcessorId = 0;
-	int nSamples = 0;
-
-	if (channelNum >= 0
-		&& channelNum < dataChannelArray.size())
-	{
-		sourceNodeId = dataChannelArray[channelNum]->getSourceNodeID();
-		subProcessorId = dataChannelArray[channelNum]->getSubProcessorIdx();
-	}
-	else
-	{
+	if (channelNum < 0 || channelNum >= m_dataChannelSlots.size())
 		return 0;
-	}
 
-	LOGDD("Requesting samples for channel ", channelNum, " with source node ", sourceNodeId);
-	uint32 sourceID = getProcessorFullId(sourceNodeId, subProcessorId);
-	try
-	{
-		nSamples = numSamples.at(sourceID);
-	}
-	catch (...)
-	{
-		return 0;
-	}
-
-	LOGDD(nSamples, " were found.");
-
-	return nSamples;
+	int slot = m_dataChannelSlots.getUnchecked(channelNum);
+	return slot >= 0 ? m_sourceClocks.getReference(slot).numSamples : 0;
 }
 
 
 /** Used to get the timestamp for a given buffer, for a given source node. */
 juce::uint64 GenericProcessor::getTimestamp(int channelNum) const
 {
-	int sourceNodeId = 0;
-	int subProcessorIdx = 0;
-	int64 ts = 0;
-
-	if (channelNum >= 0
-		&& channelNum < dataChannelArray.size())
-	{
-		sourceNodeId = dataChannelArray[channelNum]->getSourceNodeID();
-		subProcessorIdx = dataChannelArray[channelNum]->getSubProcessorIdx();
-	}
-	else
-	{
+	if (channelNum < 0 || channelNum >= m_dataChannelSlots.size())
 		return 0;
-	}
-
-	uint32 sourceID = getProcessorFullId(sourceNodeId, subProcessorIdx);
-	try
-	{
-		ts = timestamps.at(sourceID);
-	}
-	catch (...)
-	{
-		return 0;
-	}
 
-	return ts;
+	int slot = m_dataChannelSlots.getUnchecked(channelNum);
+	return slot >= 0 ? m_sourceClocks.getReference(slot).timestamp : 0;
 }
 
 uint32 GenericProcessor::getNumSourceSamples(uint16 processorID, uint16 subProcessorIdx) const
@@ -565,16 +657,12 @@ uint32 GenericProcessor::getNumSourceSamples(uint16 processorID, uint16 subProce
 
 uint32 GenericProcessor::getNumSourceSamples(uint32 fullSourceID) const
 {
-	uint32 nSamples;
-	try
-	{
-		nSamples = numSamples.at(fullSourceID);
-	}
-	catch (...)
-	{
-		return 0;
-	}
-	return nSamples;
+	int slot = findSourceSlot(fullSourceID);
+	if (slot >= 0)
+		return m_sourceClocks.getReference(slot).numSamples;
+
+	std::map<uint32, uint32>::const_iterator it = numSamples.find(fullSourceID);
+	return it != numSamples.end() ? it->second : 0;
 }
 
 juce::uint64 GenericProcessor::getSourceTimestamp(uint16 processorID, uint16 subProcessorIdx) const
@@ -584,16 +672,66 @@ juce::uint64 GenericProcessor::getSourceTimestamp(uint16 processorID, uint16 sub
 
 juce::uint64 GenericProcessor::getSourceTimestamp(uint32 fullSourceID) const
 {
-	juce::uint64 ts;
-	try
+	int slot = findSourceSlot(fullSourceID);
+	if (slot >= 0)
+		return m_sourceClocks.getReference(slot).timestamp;
+
+	std::map<uint32, juce::int64>::const_iterator it = timestamps.find(fullSourceID);
+	return it != timestamps.end() ? it->second : 0;
+}
+
+int GenericProcessor::findSourceSlot(uint32 fullSourceID) const
+{
+	std::unordered_map<uint32, int>::const_iterator it = m_sourceSlots.find(fullSourceID);
+	return it != m_sourceSlots.end() ? it->second : -1;
+}
+
+void GenericProcessor::setSourceClock(uint32 fullSourceID, juce::int64 timestamp, uint32 nSamples)
+{
+	int slot = findSourceSlot(fullSourceID);
+	if (slot >= 0)
 	{
-		ts = timestamps.at(fullSourceID);
+		SourceClock& clock = m_sourceClocks.getReference(slot);
+		clock.timestamp = timestamp;
+		clock.numSamples = nSamples;
 	}
-	catch (...)
+	else
 	{
-		return 0;
+		timestamps[fullSourceID] = timestamp;
+		numSamples[fullSourceID] = nSamples;
 	}
-	return ts;
+}
+
+void GenericProcessor::updateSourceSlots()
+{
+	Array<uint32> sourceIDs;
+	for (int i = 0; i < getNumSubProcessors(); i++)
+		sourceIDs.addIfNotAlreadyThere(getProcessorFullId(nodeId, i));
+	for (auto channel : dataChannelArray)
+		sourceIDs.addIfNotAlreadyThere(getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx()));
+	for (auto channel : eventChannelArray)
+		sourceIDs.addIfNotAlreadyThere(getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx()));
+	for (auto channel : spikeChannelArray)
+		sourceIDs.addIfNotAlreadyThere(getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx()));
+
+	Array<SourceClock> clocks;
+	for (auto sourceID : sourceIDs)
+	{
+		SourceClock clock;
+		clock.sourceID = sourceID;
+		clock.timestamp = getSourceTimestamp(sourceID);
+		clock.numSamples = getNumSourceSamples(sourceID);
+		clocks.add(clock);
+	}
+
+	m_sourceClocks.swapWith(clocks);
+	m_sourceSlots.clear();
+	for (int i = 0; i < m_sourceClocks.size(); i++)
+		m_sourceSlots[m_sourceClocks.getReference(i).sourceID] = i;
+
+	m_dataChannelSlots.clearQuick();
+	for (auto channel : dataChannelArray)
+		m_dataChannelSlots.add(findSourceSlot(getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx())));
 }
 
 
@@ -604,17 +742,13 @@ void GenericProcessor::setTimestampAndSamples(juce::uint64 timestamp, uint32 nSa
 	MidiBuffer& eventBuffer = *m_currentMidiBuffer;
 	LOGDD("Setting timestamp to ", timestamp);
 
-	HeapBlock<char> data;
-	size_t dataSize = SystemEvent::fillTimestampAndSamplesData(data, this, subProcessorIdx, timestamp, nSamples);
-
-
-	eventBuffer.addEvent(data, dataSize, 0);
+	uint8* data = eventBuffer.addEventSpace(TIMESTAMP_AND_SAMPLES_SIZE, 0);
+	SystemEvent::writeTimestampAndSamplesData(data, this, subProcessorIdx, timestamp, nSamples);
 
 	uint32 sourceID = getProcessorFullId(nodeId, subProcessorIdx);
 
-	//since the processor generating the timestamp won't get the event, add it to the map
-	timestamps[sourceID] = timestamp;
-	numSamples[sourceID] = nSamples;
+	//since the processor generating the timestamp won't get the event, store it here
+	setSourceClock(sourceID, timestamp, nSamples);
 
 	if (m_needsToSendTimestampMessages[subProcessorIdx] && nSamples > 0)
 	{
@@ -642,6 +776,10 @@ int GenericProcessor::processEventBuffer()
 
 	MidiBuffer& eventBuffer = *m_currentMidiBuffer;
 
+	m_blockEvents.clearQuick();
+	m_blockEventsData = eventBuffer.data.begin();
+	m_blockEventsSize = eventBuffer.data.size();
+
 	if (eventBuffer.getNumEvents() > 0)
 	{
 		MidiBuffer::Iterator i(eventBuffer);
@@ -662,14 +800,17 @@ int GenericProcessor::processEventBuffer()
 
 				juce::uint64 timestamp = *reinterpret_cast<const juce::uint64*>(dataptr + 8);
 				uint32 nSamples = *reinterpret_cast<const uint32*>(dataptr + 16);
-				numSamples[sourceID] = nSamples;
-				timestamps[sourceID] = timestamp;
+				setSourceClock(sourceID, timestamp, nSamples);
 			}
+			addBlockEvent(dataptr, dataSize, samplePosition);
 			//set the "recorded" bit on the first byte. This will go away when the probe system is implemented.
 			//doing a const cast is always a bad idea, but there's no better way to do this until whe change the event record system
 			if (nodeId < 900) //If the processor is not a specialized one
 				*const_cast<uint8*>(dataptr + 0) = *(dataptr + 0) | 0x80;
 		}
+
+		if (m_mergeEventStreams)
+			mergeBlockEventStreams();
 	}
 
 	return numRead;
@@ -681,40 +822,31 @@ int GenericProcessor::checkForEvents(bool checkForSpikes)
 
 	if (m_currentMidiBuffer->getNumEvents() > 0)
 	{
-		//Since adding events to the buffer inside this loop could be dangerous, create a temporal event buffer
+		//Since adding events to the buffer inside this loop could be dangerous, use a separate event buffer
 		//so any call to addEvent will operate on it;
-		MidiBuffer temporalEventBuffer;
+		MidiBuffer& temporalEventBuffer = m_pendingEventBuffer;
+		temporalEventBuffer.clear();
 		MidiBuffer* originalEventBuffer = m_currentMidiBuffer;
 		m_currentMidiBuffer = &temporalEventBuffer;
 		//int m = midiMessages.getNumEvents();
 		//LOGDD(m, " events received by node ", getNodeId());
 
-		MidiBuffer::Iterator i(*originalEventBuffer);
-		MidiMessage message(0xf4);
-
-		int samplePosition = 0;
-		i.setNextSamplePosition(samplePosition);
+		//events added by process() before this call are handled as well
+		updateBlockEvents();
 
-		while (i.getNextEvent(message, samplePosition))
+		for (const BlockEvent& blockEvent : m_blockEvents)
 		{
-			uint16 sourceId = EventBase::getSourceID(message);
-			uint16 subProc = EventBase::getSubProcessorIdx(message);
-			uint16 index = EventBase::getSourceIndex(message);
-			if (EventBase::getBaseType(message) == EventType::PROCESSOR_EVENT)
+			if (blockEvent.type == EventType::PROCESSOR_EVENT)
 			{
-				int eventIndex = getEventChannelIndex(index, sourceId, subProc);
-				if (eventIndex >= 0)
-					handleEvent(eventChannelArray[eventIndex], message, samplePosition);
+				handleEvent(eventChannelArray[blockEvent.channelIndex], MidiMessage(blockEvent.data, blockEvent.size, blockEvent.samplePosition), blockEvent.samplePosition);
 			}
-			else if (EventBase::getBaseType(message) == EventType::SYSTEM_EVENT && SystemEvent::getSystemEventType(message) == SystemEventType::TIMESTAMP_SYNC_TEXT)
+			else if (blockEvent.type == EventType::SYSTEM_EVENT)
 			{
-				handleTimestampSyncTexts(message);
+				handleTimestampSyncTexts(MidiMessage(blockEvent.data, blockEvent.size, blockEvent.samplePosition));
 			}
-			else if (checkForSpikes && EventBase::getBaseType(message) == EventType::SPIKE_EVENT)
+			else if (checkForSpikes && blockEvent.type == EventType::SPIKE_EVENT)
 			{
-				int spikeIndex = getSpikeChannelIndex(index, sourceId, subProc);
-				if (spikeIndex >= 0)
-					handleSpike(spikeChannelArray[index], message, samplePosition);
+				handleSpike(spikeChannelArray[blockEvent.channelIndex], MidiMessage(blockEvent.data, blockEvent.size, blockEvent.samplePosition), blockEvent.samplePosition);
 			}
 		}
 		//Restore the original buffer pointer and, if some new event has been added here, copy it to the original buffer
@@ -728,6 +860,142 @@ int GenericProcessor::checkForEvents(bool checkForSpikes)
 	return -1;
 }
 
+void GenericProcessor::addBlockEvent(const uint8* data, int size, int samplePosition)
+{
+	BlockEvent blockEvent;
+	blockEvent.data = data;
+	blockEvent.size = size;
+	blockEvent.samplePosition = samplePosition;
+	//TODO: remove the mask when the probe system is implemented
+	blockEvent.type = static_cast<EventType>(*data & 0x7F);
+	blockEvent.channelIndex = -1;
+
+	uint16 sourceId = *reinterpret_cast<const uint16*>(data + 2);
+	uint16 subProc = *reinterpret_cast<const uint16*>(data + 4);
+	uint16 index = *reinterpret_cast<const uint16*>(data + 6);
+
+	if (blockEvent.type == EventType::PROCESSOR_EVENT)
+	{
+		blockEvent.channelIndex = getEventChannelIndex(index, sourceId, subProc);
+		if (blockEvent.channelIndex < 0 || m_ignoredEventChannels[blockEvent.channelIndex])
+			return;
+	}
+	else if (blockEvent.type == EventType::SPIKE_EVENT)
+	{
+		blockEvent.channelIndex = getSpikeChannelIndex(index, sourceId, subProc);
+		if (blockEvent.channelIndex < 0 || m_ignoredSpikeChannels[blockEvent.channelIndex])
+			return;
+	}
+	else if (static_cast<SystemEventType>(data[1]) != TIMESTAMP_SYNC_TEXT)
+		return;
+
+	m_blockEvents.add(blockEvent);
+}
+
+void GenericProcessor::updateBlockEvents()
+{
+	const MidiBuffer& eventBuffer = *m_currentMidiBuffer;
+	if (eventBuffer.data.begin() == m_blockEventsData && eventBuffer.data.size() == m_blockEventsSize)
+		return;
+
+	m_blockEvents.clearQuick();
+	m_blockEventsData = eventBuffer.data.begin();
+	m_blockEventsSize = eventBuffer.data.size();
+
+	MidiBuffer::Iterator i(eventBuffer);
+	const uint8* dataptr;
+	int dataSize;
+	int samplePosition;
+
+	while (i.getNextEvent(dataptr, dataSize, samplePosition))
+		addBlockEvent(dataptr, dataSize, samplePosition);
+
+	if (m_mergeEventStreams)
+		mergeBlockEventStreams();
+}
+
+void GenericProcessor::mergeBlockEventStreams()
+{
+	const int numEvents = m_blockEvents.size();
+	if (numEvents < 2)
+		return;
+
+	m_eventStreams.clearQuick();
+	m_blockEventTimes.clearQuick();
+	m_blockEventNext.clearQuick();
+
+	for (int i = 0; i < numEvents; i++)
+	{
+		const BlockEvent& blockEvent = m_blockEvents.getReference(i);
+		uint16 sourceNodeId = *reinterpret_cast<const uint16*>(blockEvent.data + 2);
+		uint16 subProcessorIdx = *reinterpret_cast<const uint16*>(blockEvent.data + 4);
+		uint32 sourceID = getProcessorFullId(sourceNodeId, subProcessorIdx);
+
+		// seconds from the start of the source's block; system events stay ahead of the rest
+		double time = -1.0;
+		if (blockEvent.type != EventType::SYSTEM_EVENT)
+		{
+			juce::int64 timestamp = *reinterpret_cast<const juce::int64*>(blockEvent.data + 8);
+			float sampleRate = blockEvent.type == EventType::PROCESSOR_EVENT ?
+				eventChannelArray[blockEvent.channelIndex]->getSampleRate() :
+				spikeChannelArray[blockEvent.channelIndex]->getSampleRate();
+			time = double(timestamp - juce::int64(getSourceTimestamp(sourceID))) / (sampleRate > 0 ? sampleRate : 1.0f);
+		}
+		m_blockEventTimes.add(time);
+		m_blockEventNext.add(-1);
+
+		int stream = 0;
+		while (stream < m_eventStreams.size() && m_eventStreams.getReference(stream).sourceID != sourceID)
+			stream++;
+
+		if (stream == m_eventStreams.size())
+		{
+			EventStream newStream = { sourceID, i, i };
+			m_eventStreams.add(newStream);
+		}
+		else
+		{
+			EventStream& existing = m_eventStreams.getReference(stream);
+			m_blockEventNext.set(existing.tail, i);
+			existing.tail = i;
+		}
+	}
+
+	if (m_eventStreams.size() < 2)
+		return;
+
+	// There are only a few streams, so the earliest head is found by a scan. Ties go to the
+	// stream that appeared first, which keeps the merge stable.
+	m_mergedBlockEvents.clearQuick();
+	const int numStreams = m_eventStreams.size();
+	for (int n = 0; n < numEvents; n++)
+	{
+		int earliest = -1;
+		for (int s = 0; s < numStreams; s++)
+		{
+			int head = m_eventStreams.getReference(s).head;
+			if (head >= 0 && (earliest < 0 || m_blockEventTimes.getUnchecked(head) < m_blockEventTimes.getUnchecked(m_eventStreams.getReference(earliest).head)))
+				earliest = s;
+		}
+
+		EventStream& stream = m_eventStreams.getReference(earliest);
+		m_mergedBlockEvents.add(m_blockEvents.getReference(stream.head));
+		stream.head = m_blockEventNext.getUnchecked(stream.head);
+	}
+
+	m_blockEvents.swapWith(m_mergedBlockEvents);
+}
+
+void GenericProcessor::setEventChannelSubscription(int channelIndex, bool subscribe)
+{
+	m_ignoredEventChannels.setBit(channelIndex, !subscribe);
+}
+
+void GenericProcessor::setSpikeChannelSubscription(int channelIndex, bool subscribe)
+{
+	m_ignoredSpikeChannels.setBit(channelIndex, !subscribe);
+}
+
 void GenericProcessor::addEvent(int channelIndex, const Event* event, int sampleNum)
 {
 	addEvent(eventChannelArray[channelIndex], event, sampleNum);
@@ -736,9 +1004,82 @@ void GenericProcessor::addEvent(int channelIndex, const Event* event, int sample
 void GenericProcessor::addEvent(const EventChannel* channel, const Event* event, int sampleNum)
 {
 	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
-	HeapBlock<char> buffer(size);
+	uint8* buffer = m_currentMidiBuffer->addEventSpace(size, sampleNum >= 0 ? sampleNum : 0);
 	event->serialize(buffer, size);
-	m_currentMidiBuffer->addEvent(buffer, size, sampleNum >= 0 ? sampleNum : 0);
+}
+
+void GenericProcessor::addTTLEvents(const EventChannel* channel, const TTLEdge* edges, int numEdges)
+{
+	if (numEdges <= 0)
+		return;
+
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
+	if (size > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(size);
+		m_eventScratchSize = size;
+	}
+
+	for (int i = 0; i < numEdges; i++)
+	{
+		const TTLEdge& edge = edges[i];
+		if (TTLEvent::serializeTTLEvent(channel, edge.timestamp, edge.eventData, edge.channel, m_eventScratch, size))
+			m_currentMidiBuffer->addEvent(m_eventScratch, size, edge.sampleNum >= 0 ? edge.sampleNum : 0);
+	}
+}
+
+void GenericProcessor::addTTLEvent(const EventChannel* channel, juce::int64 timestamp, uint16 line, bool state, int sampleNum, const void* metaData)
+{
+	// checked before the space is reserved, so a bad call leaves no empty event behind
+	if (channel == nullptr || channel->getChannelType() != EventChannel::TTL || line >= channel->getNumChannels()
+		|| (channel->getEventMetaDataCount() != 0 && metaData == nullptr))
+	{
+		jassertfalse;
+		return;
+	}
+
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
+	uint8* buffer = m_currentMidiBuffer->addEventSpace(size, sampleNum >= 0 ? sampleNum : 0);
+	TTLEvent::serializeTTLEdge(channel, timestamp, line, state, buffer, size, metaData);
+}
+
+void GenericProcessor::addBinaryEvent(const EventChannel* channel, juce::int64 timestamp, const void* data, int dataSize, int sampleNum, const void* metaData, uint16 eventChannel)
+{
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
+	if (size > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(size);
+		m_eventScratchSize = size;
+	}
+
+	if (BinaryEvent::serializeBinaryEvent(channel, timestamp, data, dataSize, eventChannel, metaData, m_eventScratch, size))
+		m_currentMidiBuffer->addEvent(m_eventScratch, size, sampleNum >= 0 ? sampleNum : 0);
+}
+
+void GenericProcessor::addTextEvent(const EventChannel* channel, juce::int64 timestamp, const String& text, int sampleNum, const void* metaData, uint16 eventChannel)
+{
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
+	if (size > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(size);
+		m_eventScratchSize = size;
+	}
+
+	if (TextEvent::serializeTextEvent(channel, timestamp, text, eventChannel, metaData, m_eventScratch, size))
+		m_currentMidiBuffer->addEvent(m_eventScratch, size, sampleNum >= 0 ? sampleNum : 0);
+}
+
+void GenericProcessor::addTextEvent(const EventChannel* channel, juce::int64 timestamp, const char* utf8, size_t numBytes, int sampleNum, const void* metaData, uint16 eventChannel)
+{
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE;
+	if (size > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(size);
+		m_eventScratchSize = size;
+	}
+
+	if (TextEvent::serializeTextEvent(channel, timestamp, utf8, numBytes, eventChannel, metaData, m_eventScratch, size))
+		m_currentMidiBuffer->addEvent(m_eventScratch, size, sampleNum >= 0 ? sampleNum : 0);
 }
 
 void GenericProcessor::addSpike(int channelIndex, const SpikeEvent* event, int sampleNum)
@@ -749,21 +1090,133 @@ void GenericProcessor::addSpike(int channelIndex, const SpikeEvent* event, int s
 void GenericProcessor::addSpike(const SpikeChannel* channel, const SpikeEvent* event, int sampleNum)
 {
 	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + SPIKE_BASE_SIZE + channel->getNumChannels()*sizeof(float);
-	HeapBlock<char> buffer(size);
+
+	SpikeHandle handle;
+	if (uint8* stored = SpikeStore::getInstance()->allocate(size, handle))
+	{
+		event->serialize(stored, size);
+		keepSpikeWaveform(channel, stored);
+		addStoredSpike(stored, handle, sampleNum);
+		return;
+	}
+
+	uint8* buffer = m_currentMidiBuffer->addEventSpace(size, sampleNum >= 0 ? sampleNum : 0);
 	event->serialize(buffer, size);
-	m_currentMidiBuffer->addEvent(buffer, size, sampleNum >= 0 ? sampleNum : 0);
+	keepSpikeWaveform(channel, buffer);
+}
+
+void GenericProcessor::addSpike(const SpikeChannel* channel, juce::int64 timestamp, const float* thresholds, const SpikeEvent::SpikeBuffer& data, uint16 sortedID, int sampleNum, const void* metaData)
+{
+	size_t size = channel->getDataSize() + channel->getTotalEventMetaDataSize() + SPIKE_BASE_SIZE + channel->getNumChannels()*sizeof(float);
+
+	//the waveform is written once to the store, and only its handle goes through the buffers
+	SpikeHandle handle;
+	if (uint8* stored = SpikeStore::getInstance()->allocate(size, handle))
+	{
+		if (SpikeEvent::serializeSpikeEvent(channel, timestamp, thresholds, data, sortedID, metaData, stored, size))
+		{
+			keepSpikeWaveform(channel, stored);
+			addStoredSpike(stored, handle, sampleNum);
+		}
+		return;
+	}
+
+	if (size > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(size);
+		m_eventScratchSize = size;
+	}
+
+	if (SpikeEvent::serializeSpikeEvent(channel, timestamp, thresholds, data, sortedID, metaData, m_eventScratch, size))
+	{
+		keepSpikeWaveform(channel, reinterpret_cast<const uint8*>(m_eventScratch.getData()));
+		m_currentMidiBuffer->addEvent(m_eventScratch, size, sampleNum >= 0 ? sampleNum : 0);
+	}
+}
+
+void GenericProcessor::addStoredSpike(const uint8* spike, const SpikeHandle& handle, int sampleNum)
+{
+	uint8* buffer = m_currentMidiBuffer->addEventSpace(SPIKE_STORE_MESSAGE_SIZE, sampleNum >= 0 ? sampleNum : 0);
+	SpikeStore::writeMessage(spike, handle, buffer);
+}
+
+void GenericProcessor::keepSpikeWaveform(const SpikeChannel* channel, const uint8* spike)
+{
+	//only the processor that detected a spike keeps it, not those that pass it on
+	if (channel->getSourceNodeID() == nodeId)
+		SpikeWaveformStore::getInstance()->add(channel, spike);
+}
+
+void GenericProcessor::reserveEventStorage()
+{
+	size_t maxSize = EVENT_BASE_SIZE;
+
+	for (auto channel : eventChannelArray)
+		maxSize = jmax(maxSize, channel->getDataSize() + channel->getTotalEventMetaDataSize() + EVENT_BASE_SIZE);
+
+	for (auto channel : spikeChannelArray)
+		maxSize = jmax(maxSize, channel->getDataSize() + channel->getTotalEventMetaDataSize() + SPIKE_BASE_SIZE + channel->getNumChannels()*sizeof(float));
+
+	if (maxSize > m_eventScratchSize)
+	{
+		m_eventScratch.malloc(maxSize);
+		m_eventScratchSize = maxSize;
+	}
+
+	// the MidiBuffer stores a sample number and a size with each event
+	m_eventBufferReserve = EVENT_STORAGE_RESERVE_EVENTS * (maxSize + sizeof(int32) + sizeof(uint16));
+	m_pendingEventBuffer.ensureSize(m_eventBufferReserve);
+	m_blockEvents.ensureStorageAllocated(EVENT_STORAGE_RESERVE_EVENTS);
+	m_mergedBlockEvents.ensureStorageAllocated(EVENT_STORAGE_RESERVE_EVENTS);
+	m_blockEventTimes.ensureStorageAllocated(EVENT_STORAGE_RESERVE_EVENTS);
+	m_blockEventNext.ensureStorageAllocated(EVENT_STORAGE_RESERVE_EVENTS);
+	m_eventStreams.ensureStorageAllocated(eventChannelArray.size() + spikeChannelArray.size() + 1);
 }
 
 
 void GenericProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& eventBuffer)
 {
+	// denormals are flushed to zero for the whole block, instead of each filter adding
+	// anti-denormal signals to every sample
+	FloatVectorOperations::disableDenormalisedNumberSupport();
+
+	TRACE_SCOPE("processor", m_name);
+
+	// allocations made for the processor, by this thread or by the workers of its channel jobs
+	AllocationTally* previousTally = AllocationCounter::setThreadTally(&m_processProfile.getAllocationTally());
+
 	m_currentMidiBuffer = &eventBuffer;
+	eventBuffer.ensureSize(m_eventBufferReserve); // only allocates the first time the graph buffer is used
+	int numEvents = eventBuffer.getNumEvents();
+	applyParameterChanges();
 	processEventBuffer(); // extract buffer sizes and timestamps,
 	// set flag on all TTL events to zero
 
+	// displays give up blocks under load, so the processors feeding the Record Node keep up
+	if (isSheddable() && LoadShedder::shouldShedBlock())
+	{
+		AllocationCounter::setThreadTally(previousTally);
+		m_processProfile.addShedBlock();
+		return;
+	}
+
 	m_lastProcessTime = Time::getHighResolutionTicks();
 	process(buffer);
 
+	// the block has to be processed within its duration at the graph sample rate
+	double graphSampleRate = AudioProcessor::getSampleRate();
+	uint32 budgetNs = graphSampleRate > 0 ? (uint32)(buffer.getNumSamples() * 1.0e9 / graphSampleRate) : 0;
+	const int64 processTicks = Time::getHighResolutionTicks() - m_lastProcessTime;
+
+	AllocationCounter::setThreadTally(previousTally);
+
+	// since the previous block, so those of a source's DataThread are included
+	const int64 allocationCount = m_processProfile.getAllocationTally().getCount();
+	const uint32 numAllocations = (uint32)jmin(allocationCount - m_lastAllocationCount, (int64)UINT32_MAX);
+	m_lastAllocationCount = allocationCount;
+
+	m_processProfile.addBlock(processTicks, budgetNs, numEvents, numAllocations);
+
 }
 
 const DataChannel* GenericProcessor::getDataChannel(int index) const
@@ -808,28 +1261,18 @@ int GenericProcessor::getTotalConfigurationObjects() const
 
 int GenericProcessor::getDataChannelIndex(int channelIdx, int processorID, int subProcessorIdx) const
 {
-	uint32 sourceID = getProcessorFullId(processorID, subProcessorIdx);
-	try
-	{
-		return dataChannelMap.at(sourceID).at(channelIdx);
-	}
-	catch (...)
-	{
-		return -1;
-	}
+	return findChannelIndex(dataChannelMap, getProcessorFullId(processorID, subProcessorIdx), channelIdx);
 }
 
 int GenericProcessor::getEventChannelIndex(int channelIdx, int processorID, int subProcessorIdx) const
 {
-	uint32 sourceID = getProcessorFullId(processorID, subProcessorIdx);
-	try
-	{
-		return eventChannelMap.at(sourceID).at(channelIdx);
-	}
-	catch (...)
-	{
-		return -1;
-	}
+	return findChannelIndex(eventChannelMap, getProcessorFullId(processorID, subProcessorIdx), channelIdx);
+}
+
+int GenericProcessor::findChannelIndex(const ChannelIndexMap& map, uint32 sourceID, int channelIdx)
+{
+	ChannelIndexMap::const_iterator source = map.find(sourceID);
+	return source != map.end() ? source->second.get(channelIdx) : -1;
 }
 
 int GenericProcessor::getEventChannelIndex(const Event* event) const
@@ -839,15 +1282,7 @@ int GenericProcessor::getEventChannelIndex(const Event* event) const
 
 int GenericProcessor::getSpikeChannelIndex(int channelIdx, int processorID, int subProcessorIdx) const
 {
-	uint32 sourceID = getProcessorFullId(processorID, subProcessorIdx);
-	try
-	{
-		return spikeChannelMap.at(sourceID).at(channelIdx);
-	}
-	catch (...)
-	{
-		return -1;
-	}
+	return findChannelIndex(spikeChannelMap, getProcessorFullId(processorID, subProcessorIdx), channelIdx);
 }
 
 int GenericProcessor::getSpikeChannelIndex(const SpikeEvent* event) const
@@ -1089,6 +1524,8 @@ bool GenericProcessor::isSplitter()      const  { return getProcessorType() == P
 bool GenericProcessor::isMerger()        const  { return getProcessorType() == PROCESSOR_TYPE_MERGER; }
 bool GenericProcessor::isUtility()       const  { return getProcessorType() == PROCESSOR_TYPE_UTILITY; }
 bool GenericProcessor::isRecordNode()    const  { return getProcessorType() == PROCESSOR_TYPE_RECORD_NODE; }
+bool GenericProcessor::isReadOnly()      const  { return false; }
+bool GenericProcessor::isSheddable()     const  { return false; }
 
 int GenericProcessor::getNumParameters()    { return parameters.size(); }
 int GenericProcessor::getNumPrograms()      { return 0; }
@@ -1098,15 +1535,8 @@ int GenericProcessor::getNumInputs() const                  { return settings.nu
 int GenericProcessor::getNumOutputs() const                 { return settings.numOutputs; }
 int GenericProcessor::getNumOutputs(int subProcessorIdx) const
 {
-	uint32 sourceId = getProcessorFullId(nodeId, subProcessorIdx);
-	try
-	{
-		return dataChannelMap.at(sourceId).size();
-	}
-	catch (...)
-	{
-		return 0;
-	}
+	ChannelIndexMap::const_iterator source = dataChannelMap.find(getProcessorFullId(nodeId, subProcessorIdx));
+	return source != dataChannelMap.end() ? source->second.size() : 0;
 }
 
 int GenericProcessor::getDefaultNumDataOutputs(DataChannel::DataChannelTypes, int) const        { return 0; }
@@ -1166,11 +1596,17 @@ void GenericProcessor::setEnabledState(bool t)
 bool GenericProcessor::enableProcessor()
 {
 	m_lastProcessTime = Time::getHighResolutionTicks();
+	m_processProfile.reset();
+	m_lastAllocationCount = m_processProfile.getAllocationTally().getCount();
+	m_queueParameterChanges = true;
 	return enable();
 }
 
 bool GenericProcessor::disableProcessor()
 {
+	m_queueParameterChanges = false;
+	//the processing thread has stopped, so whatever it didn't get to is applied now
+	applyHeldParameterChanges();
 	return disable();
 }
 
@@ -1219,6 +1655,68 @@ int64 GenericProcessor::getLastProcessedsoftwareTime() const
 	return m_lastProcessTime;
 }
 
+const ProcessTimeProfile& GenericProcessor::getProcessTimeProfile() const
+{
+	return m_processProfile;
+}
+
+juce::int64 GenericProcessor::getOutputSignature() const
+{
+	juce::uint64 hash = 14695981039346656037ULL;
+	auto mix = [&hash](juce::uint64 value) { hash = (hash ^ value) * 1099511628211ULL; };
+	auto mixInfo = [&mix](const InfoObjectCommon* info)
+	{
+		mix(info->getName().hashCode64());
+		mix(info->getIdentifier().hashCode64());
+		mix(info->getSourceNodeID());
+		mix(info->getSubProcessorIdx());
+		mix(info->getSourceIndex());
+		mix(info->getSourceSubprocessorCount());
+		mix(roundToInt(info->getSampleRate() * 1000.0f));
+	};
+
+	mix(isEnabledState());
+	mix(settings.numOutputs);
+	mix(getNumSubProcessors());
+	mix(configurationObjectArray.size());
+
+	mix(dataChannelArray.size());
+	for (auto channel : dataChannelArray)
+	{
+		mixInfo(channel);
+		mix(channel->getHistoricString().hashCode64());
+		mix(channel->getChannelType());
+		mix(roundToInt(channel->getBitVolts() * 1.0e6));
+		mix(channel->getDataUnits().hashCode64());
+		mix(channel->getRecordState());
+	}
+
+	mix(eventChannelArray.size());
+	for (auto channel : eventChannelArray)
+	{
+		mixInfo(channel);
+		mix(channel->getChannelType());
+		mix(channel->getNumChannels());
+		mix(channel->getLength());
+		mix(channel->getEventMetaDataCount());
+		mix(channel->getTotalEventMetaDataSize());
+	}
+
+	mix(spikeChannelArray.size());
+	for (auto channel : spikeChannelArray)
+	{
+		mixInfo(channel);
+		mix(channel->getChannelType());
+		mix(channel->getNumChannels());
+		mix(channel->getPrePeakSamples());
+		mix(channel->getPostPeakSamples());
+		mix(channel->getEventMetaDataCount());
+		mix(channel->getTotalEventMetaDataSize());
+	}
+
+	return (juce::int64)hash;
+}
+
 void ChannelCreationIndexes::clearChannelCreationCounts()
 {
 	dataChannelCount = 0;
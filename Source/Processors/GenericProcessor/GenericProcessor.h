@@ -32,12 +32,21 @@
 #include "../../Processors/Dsp/LinearSmoothedValueAtomic.h"
 #include "../../Processors/PluginManager/PluginIDs.h"
 #include "../Channel/InfoObjects.h"
+#include "../Channel/ChannelMask.h"
 #include "../Events/Events.h"
+#include "../Events/SpikeStore.h"
+#include "../Events/SpikeWaveformStore.h"
+#include "ProcessTimeProfile.h"
+#include "ChannelWorkerPool.h"
 
 #include <time.h>
 #include <stdio.h>
 #include <map>
 #include <unordered_map>
+#include <vector>
+
+#define EVENT_STORAGE_RESERVE_EVENTS 256
+#define PARAMETER_QUEUE_SIZE 512
 
 class EditorViewport;
 class DataViewport;
@@ -120,6 +129,18 @@ public:
     be done through setParameter(). Otherwise the application will crash. */
     virtual void setParameter (int parameterIndex, float newValue) override;
 
+    /** Queues a call to setParameter(), with the current channel set to the given one, that is
+    made on the processing thread at the start of the next block, so editors can change parameters
+    during acquisition without racing process(). The changes queued before a block are all applied
+    before it. If the queue is full, the change is held back, replacing any held back change to the
+    same parameter and channel, until a later change finds room for it or acquisition stops. Outside of acquisition the change is applied
+    right away. Call from the message thread. */
+    void queueParameterChange (int parameterIndex, float newValue, int channel);
+
+    /** True while setParameter() is called with a queued change on the processing thread,
+    when it must not touch the editor */
+    bool isApplyingParameterChanges() const;
+
     /** Creates a GenericEditor.*/
     virtual AudioProcessorEditor* createEditor() override;
 
@@ -331,6 +352,20 @@ public:
     /** Returns true if a processor is a record node, false otherwise. */
     virtual bool isRecordNode() const;
 
+    /** Returns true if a processor never writes to its continuous channels, false otherwise.
+
+        Such a processor reads the channels of its source in place, without the copy that is
+        otherwise made when a splitter sends them to another branch as well.*/
+    virtual bool isReadOnly() const;
+
+    /** Returns true if a processor only displays data and may skip blocks when the graph
+        nears its deadline, false otherwise.
+
+        Such a processor must not write to its channels or add events, since downstream
+        processors see the blocks it skips unchanged.
+        @see LoadShedder*/
+    virtual bool isSheddable() const;
+
     /** Returns true if a processor is able to send its output to a given processor.
 
         Ideally, this should always return true, but there may be special cases
@@ -523,6 +558,13 @@ public:
 
 	juce::int64 getLastProcessedsoftwareTime() const;
 
+	/** Time spent in process() during the last blocks of the current acquisition */
+	const ProcessTimeProfile& getProcessTimeProfile() const;
+
+	/** Hash of the output settings and channels that downstream processors take from this one
+	in update(). The ProcessorGraph stops propagating a settings change where it leaves this unchanged. */
+	juce::int64 getOutputSignature() const;
+
 	static uint32 getProcessorFullId(uint16 processorId, uint16 subprocessorIdx);
 
 	static uint16 getNodeIdFromFullId(uint32 fullId);
@@ -561,6 +603,14 @@ protected:
 	Called by checkForEvents(). */
 	virtual void handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition = 0);
 
+	/** Selects whether checkForEvents() passes the events of an event channel, by index in
+	eventChannelArray, to handleEvent(). All channels are passed by default. The selection
+	is reset before each updateSettings(), where processors can restrict it to the channels they use. */
+	void setEventChannelSubscription(int channelIndex, bool subscribe);
+
+	/** Like setEventChannelSubscription(), for the spike channels passed to handleSpike() */
+	void setSpikeChannelSubscription(int channelIndex, bool subscribe);
+
 	/** Responds to TIMESTAMP_SYNC_TEXT system events, in case a processor needs to listen to them (useful for the record node) */
 	virtual void handleTimestampSyncTexts(const MidiMessage& event);
 
@@ -583,9 +633,40 @@ protected:
 	void addEvent(int channelIndex, const Event* event, int sampleNum);
 	void addEvent(const EventChannel* channel, const Event* event, int sampleNum);
 
+	/** Adds a TTL event for each edge, serializing them straight into the event buffer */
+	void addTTLEvents(const EventChannel* channel, const TTLEdge* edges, int numEdges);
+
+	/** Adds a TTL event for a single line, serialized in place in the event buffer. Its TTL word only
+	has the bit of the line set, or none when state is false. See TTLEvent::serializeTTLEdge */
+	void addTTLEvent(const EventChannel* channel, juce::int64 timestamp, uint16 line, bool state, int sampleNum, const void* metaData = nullptr);
+
+	/** Add a binary or text event to the event buffer without creating an Event, like addTTLEvents. metaData holds
+	the channel's event metadata as laid out by a MetaDataBuilder, so no MetaDataValue has to be allocated.
+	See BinaryEvent::serializeBinaryEvent and TextEvent::serializeTextEvent for the arguments */
+	void addBinaryEvent(const EventChannel* channel, juce::int64 timestamp, const void* data, int dataSize, int sampleNum, const void* metaData = nullptr, uint16 eventChannel = 0);
+	void addTextEvent(const EventChannel* channel, juce::int64 timestamp, const String& text, int sampleNum, const void* metaData = nullptr, uint16 eventChannel = 0);
+	void addTextEvent(const EventChannel* channel, juce::int64 timestamp, const char* utf8, size_t numBytes, int sampleNum, const void* metaData = nullptr, uint16 eventChannel = 0);
+
+	/** Spikes are serialized into the SpikeStore while it is enabled and has room, and
+	the event buffer only carries a handle to them. The spikes of channels this processor
+	created are also kept in the SpikeWaveformStore for the spike viewers. */
 	void addSpike(int channelIndex, const SpikeEvent* event, int sampleNum);
 	void addSpike(const SpikeChannel* channel, const SpikeEvent* event, int sampleNum);
 
+	/** Adds a spike to the event buffer without creating a SpikeEvent, like addTTLEvents.
+	See SpikeEvent::serializeSpikeEvent for the arguments */
+	void addSpike(const SpikeChannel* channel, juce::int64 timestamp, const float* thresholds, const SpikeEvent::SpikeBuffer& data, uint16 sortedID, int sampleNum, const void* metaData = nullptr);
+
+	/** Calls function(startChannel, endChannel) for contiguous ranges covering numChannels, in
+	parallel on the shared ChannelWorkerPool, and returns once all ranges are done. For use in
+	process() when channels don't depend on each other. Ranges hold at least minChannelsPerRange
+	channels, and start on multiples of channelAlignment. */
+	template <typename RangeFunction>
+	void forEachChannelRange(int numChannels, RangeFunction function, int minChannelsPerRange = 32, int channelAlignment = 1)
+	{
+		ChannelWorkerPool::getInstance()->parallelFor(numChannels, function, minChannelsPerRange, channelAlignment);
+	}
+
 	/** Method to create the data channels pertaining to this processor, called automatically by update()*/
 	virtual void createDataChannels();
 
@@ -607,11 +688,106 @@ protected:
 	void updateChannelIndexes(bool updateNodeID = true);
 
 private:
+	/** Sample count and timestamp of the current block of a source subprocessor */
+	struct SourceClock
+	{
+		uint32 sourceID;
+		uint32 numSamples;
+		juce::int64 timestamp;
+	};
+
+	/** Rebuilds the source slots for the channels and subprocessors known after an update,
+	keeping the last values of the sources that remain */
+	void updateSourceSlots();
+
+	/** Slot of a source subprocessor, -1 if it was not known at the last update */
+	int findSourceSlot(uint32 fullSourceID) const;
+
+	/** Stores the clock of a source, in its slot or, for sources unknown at the last update, in the fallback maps */
+	void setSourceClock(uint32 fullSourceID, juce::int64 timestamp, uint32 nSamples);
+
+	Array<SourceClock> m_sourceClocks;
+	std::unordered_map<uint32, int> m_sourceSlots;
+	/** Source slot of each data channel, so the per channel getters are a single indexed load */
+	Array<int> m_dataChannelSlots;
+
 	std::map<uint32, uint32> numSamples;
 	std::map<uint32, juce::int64> timestamps;
 
 	juce::int64 m_lastProcessTime;
 
+	ProcessTimeProfile m_processProfile;
+	/** Allocation count of the tally at the end of the previous block */
+	juce::int64 m_lastAllocationCount;
+
+	/** Event storage sized for the largest event of the processor's channels when the settings
+	are updated, so creating events never allocates on the processing thread */
+	void reserveEventStorage();
+
+	/** Adds the compact message of a spike serialized in the SpikeStore */
+	void addStoredSpike(const uint8* spike, const SpikeHandle& handle, int sampleNum);
+
+	/** Keeps a serialized spike in the SpikeWaveformStore if this processor created its channel */
+	void keepSpikeWaveform(const SpikeChannel* channel, const uint8* spike);
+
+	/** Scratch space for serializing an event that may turn out to be invalid */
+	HeapBlock<char> m_eventScratch;
+	size_t m_eventScratchSize;
+
+	/** Storage reserved for the events of a block, in the graph buffer and in the one
+	checkForEvents() collects new events in */
+	size_t m_eventBufferReserve;
+	MidiBuffer m_pendingEventBuffer;
+
+	/** An event of the current block, with its header already parsed */
+	struct BlockEvent
+	{
+		const uint8* data;
+		int size;
+		int samplePosition;
+		EventType type;
+		/** Index in eventChannelArray or spikeChannelArray, -1 for system events */
+		int channelIndex;
+	};
+
+	/** Adds an event to the table of the current block, unless it comes from a channel
+	nobody subscribed to */
+	void addBlockEvent(const uint8* data, int size, int samplePosition);
+
+	/** Builds the table again if the event buffer changed since processEventBuffer() */
+	void updateBlockEvents();
+
+	/** Table of the incoming events, built in the same pass processEventBuffer() makes to
+	read the timestamps, so checkForEvents() neither parses headers nor looks up channels */
+	Array<BlockEvent> m_blockEvents;
+	const uint8* m_blockEventsData;
+	int m_blockEventsSize;
+
+	/** True downstream of a Merger, where the events of the merged chains are handled in
+	timestamp order instead of the order the graph concatenated their buffers in */
+	bool m_mergeEventStreams;
+
+	/** The events of one source subprocessor in the block table, linked through m_blockEventNext */
+	struct EventStream
+	{
+		uint32 sourceID;
+		int head;
+		int tail;
+	};
+
+	/** Puts the block table in timestamp order with a k-way merge of the streams of each
+	source subprocessor, whose own events are already in order. Streams with different
+	clocks are compared by their time from the start of the block. */
+	void mergeBlockEventStreams();
+
+	Array<EventStream> m_eventStreams;
+	Array<double> m_blockEventTimes;
+	Array<int> m_blockEventNext;
+	Array<BlockEvent> m_mergedBlockEvents;
+
+	BigInteger m_ignoredEventChannels;
+	BigInteger m_ignoredSpikeChannels;
+
 	void createDataChannelsByType(DataChannel::DataChannelTypes type);
 
 	/** Each processor has a unique integer ID that can be used to identify it.*/
@@ -640,10 +816,67 @@ private:
     bool m_isParamsWereLoaded;
 	Array<bool> m_needsToSendTimestampMessages;
 
+	struct ParameterChange
+	{
+		int parameterIndex;
+		float value;
+		int channel;
+	};
+
+	/** Calls setParameter() for the changes queued so far */
+	void applyParameterChanges();
+
+	/** Calls setParameter() for the queued and held back changes, once the processing thread has stopped */
+	void applyHeldParameterChanges();
+
+	/** Records a change applied during acquisition as a Message Center annotation, so the
+	recording keeps the time of every automated or edited parameter change */
+	void recordParameterChange(const ParameterChange& change);
+
+	/** Single producer, single consumer queue from the message thread to the processing thread */
+	AbstractFifo m_parameterFifo;
+	HeapBlock<ParameterChange> m_parameterChanges;
+	/** Changes that didn't fit in the full queue, at most one per parameter and channel, queued
+	ahead of the next change. Only touched from the message thread */
+	Array<ParameterChange> m_heldParameterChanges;
+	/** Set while acquiring, when changes have to go through the queue */
+	bool m_queueParameterChanges;
+	/** Set by the processing thread while it applies queued changes */
+	Atomic<int> m_applyingParameterChanges;
+
 	MidiBuffer* m_currentMidiBuffer;
 
-	typedef std::map<uint16, int> ChannelIndexes;
+	/** Dense table from the source index of a channel to its index in the channel array,
+	rebuilt by updateChannelIndexes() whenever the settings change */
+	class ChannelIndexes
+	{
+	public:
+		ChannelIndexes() : numChannels(0) {}
+
+		void set(uint16 sourceIndex, int index)
+		{
+			if (sourceIndex >= indexes.size())
+				indexes.resize(sourceIndex + 1, -1);
+			if (indexes[sourceIndex] < 0)
+				++numChannels;
+			indexes[sourceIndex] = index;
+		}
+
+		int get(int sourceIndex) const
+		{
+			return (sourceIndex >= 0 && sourceIndex < (int)indexes.size()) ? indexes[sourceIndex] : -1;
+		}
+
+		int size() const { return numChannels; }
+
+	private:
+		std::vector<int> indexes;
+		int numChannels;
+	};
 	typedef std::unordered_map<uint32, ChannelIndexes> ChannelIndexMap;
+
+	/** Index in the channel array of a channel of a source, -1 if the processor does not have it */
+	static int findChannelIndex(const ChannelIndexMap& map, uint32 sourceID, int channelIdx);
 	ChannelIndexMap dataChannelMap;
 	ChannelIndexMap eventChannelMap;
 	ChannelIndexMap spikeChannelMap;
@@ -0,0 +1,132 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::reset()
+{
+	for (int i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+		bins[i] = 0;
+
+	count = 0;
+	totalNs = 0;
+	maxNs = 0;
+}
+
+void LatencyHistogram::add(juce::int64 latencyNs)
+{
+	latencyNs = jmax((juce::int64)0, latencyNs);
+
+	int bin = 0;
+	if (latencyNs > 1000)
+		bin = jmin(LATENCY_HISTOGRAM_BINS - 1, (int)(std::log2(latencyNs / 1000.0) * LATENCY_HISTOGRAM_BINS_PER_OCTAVE));
+
+	//a single thread adds latencies, so plain stores are enough
+	bins[bin].store(bins[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	totalNs.store(totalNs.load(std::memory_order_relaxed) + latencyNs, std::memory_order_relaxed);
+	if (latencyNs > maxNs.load(std::memory_order_relaxed))
+		maxNs.store(latencyNs, std::memory_order_relaxed);
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int64 LatencyHistogram::getCount() const
+{
+	return count.load(std::memory_order_acquire);
+}
+
+float LatencyHistogram::getMeanMs() const
+{
+	int64 n = getCount();
+	return n > 0 ? (float)(totalNs.load(std::memory_order_relaxed) / (double)n / 1.0e6) : 0.0f;
+}
+
+float LatencyHistogram::getMaxMs() const
+{
+	return maxNs.load(std::memory_order_relaxed) / 1.0e6f;
+}
+
+double LatencyHistogram::getBinStartMs(int bin)
+{
+	return bin == 0 ? 0.0 : 0.001 * std::exp2((double)bin / LATENCY_HISTOGRAM_BINS_PER_OCTAVE);
+}
+
+float LatencyHistogram::getPercentileMs(float fraction) const
+{
+	int64 n = getCount();
+	if (n == 0)
+		return 0.0f;
+
+	int64 target = jmax((int64)1, (int64)std::ceil(fraction * n));
+	int64 seen = 0;
+
+	for (int i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+	{
+		seen += bins[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+			return jmin((float)getBinStartMs(i + 1), getMaxMs());
+	}
+
+	return getMaxMs();
+}
+
+String LatencyHistogram::toString() const
+{
+	int64 n = getCount();
+	if (n == 0)
+		return "no samples";
+
+	String text = String(n) + " samples, mean " + String(getMeanMs(), 3) + " ms, p50 " + String(getPercentileMs(0.5f), 3)
+		+ " ms, p90 " + String(getPercentileMs(0.9f), 3) + " ms, p99 " + String(getPercentileMs(0.99f), 3)
+		+ " ms, max " + String(getMaxMs(), 3) + " ms\n";
+
+	int first = LATENCY_HISTOGRAM_BINS, last = -1;
+	uint32 largest = 0;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+	{
+		uint32 value = bins[i].load(std::memory_order_relaxed);
+		if (value == 0)
+			continue;
+
+		first = jmin(first, i);
+		last = i;
+		largest = jmax(largest, value);
+	}
+
+	for (int i = first; i <= last; i++)
+	{
+		uint32 value = bins[i].load(std::memory_order_relaxed);
+		int barLength = (int)((value * 40 + largest - 1) / largest);
+
+		text += String(getBinStartMs(i), 3).paddedLeft(' ', 10) + " - " + String(getBinStartMs(i + 1), 3).paddedLeft(' ', 9)
+			+ " ms | " + String::repeatedString("#", barLength) + " " + String(value) + "\n";
+	}
+
+	return text.trimEnd();
+}
@@ -0,0 +1,76 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef __LATENCYHISTOGRAM_H_5A0E7C31__
+#define __LATENCYHISTOGRAM_H_5A0E7C31__
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "../PluginManager/OpenEphysPlugin.h"
+
+#define LATENCY_HISTOGRAM_BINS_PER_OCTAVE	4
+#define LATENCY_HISTOGRAM_BINS				84	// 1 us to about 2 s
+
+/**
+	Distribution of latencies, in bins a quarter of an octave wide starting at 1 us,
+	so the resolution stays the same relative to the value from microseconds to seconds.
+
+	One thread adds latencies and any thread can read the distribution, without locks.
+
+	@see OutputDispatcher
+*/
+class PLUGIN_API LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	/** Forgets the recorded latencies */
+	void reset();
+
+	void add(juce::int64 latencyNs);
+
+	int64 getCount() const;
+	float getMeanMs() const;
+	float getMaxMs() const;
+
+	/** Upper edge of the bin holding the given fraction of the latencies, e.g. 0.99 */
+	float getPercentileMs(float fraction) const;
+
+	/** Percentiles and a text bar chart of the bins between the shortest and longest latency */
+	String toString() const;
+
+private:
+	/** Lower edge of a bin */
+	static double getBinStartMs(int bin);
+
+	std::atomic<uint32> bins[LATENCY_HISTOGRAM_BINS];
+	std::atomic<int64> count;
+	std::atomic<int64> totalNs;
+	std::atomic<int64> maxNs;
+
+	JUCE_DECLARE_NON_COPYABLE(LatencyHistogram);
+};
+
+#endif  // __LATENCYHISTOGRAM_H_5A0E7C31__
@@ -0,0 +1,202 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "OutputDispatcher.h"
+#include "../../CoreServices.h"
+
+OutputDispatcher::OutputDispatcher(const String& name, Device& device_, int capacity)
+	: Thread(name)
+	, device(device_)
+	, fifo(capacity)
+	, numWritten(0)
+	, numDropped(0)
+	, totalQueueTicks(0)
+	, maxQueueTicks(0)
+{
+	commands.calloc(capacity);
+}
+
+OutputDispatcher::~OutputDispatcher()
+{
+	stop();
+}
+
+void OutputDispatcher::start()
+{
+	if (isThreadRunning())
+		return;
+
+	fifo.reset();
+	latencyMonitor.reset();
+	chainLatency.reset();
+	queueLatency.reset();
+	writeLatency.reset();
+	totalLatency.reset();
+	numWritten = 0;
+	numDropped = 0;
+	totalQueueTicks = 0;
+	maxQueueTicks = 0;
+
+	startThread(9);
+}
+
+void OutputDispatcher::stop()
+{
+	if (!isThreadRunning())
+		return;
+
+	signalThreadShouldExit();
+	commandsQueued.signal();
+	stopThread(2000);
+
+	// anything queued after the thread's last pass
+	writeQueued();
+}
+
+bool OutputDispatcher::push(int channel, int value, uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 sampleNumber)
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+	if (size1 + size2 == 0)
+	{
+		numDropped.store(numDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	Command& command = commands[size1 > 0 ? start1 : start2];
+	command.channel = channel;
+	command.value = value;
+	command.sourceNodeId = sourceNodeId;
+	command.subProcessorIdx = subProcessorIdx;
+	command.sampleNumber = sampleNumber;
+	command.queuedTicks = Time::getHighResolutionTicks();
+
+	fifo.finishedWrite(1);
+	commandsQueued.signal();
+	return true;
+}
+
+void OutputDispatcher::run()
+{
+	while (!threadShouldExit())
+	{
+		commandsQueued.wait(100);
+		writeQueued();
+	}
+}
+
+void OutputDispatcher::writeQueued()
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+	for (int i = 0; i < size1 + size2; i++)
+	{
+		const Command& command = commands[i < size1 ? start1 + i : start2 + i - size1];
+
+		const int64 writeStart = Time::getHighResolutionTicks();
+		device.writeOutput(command);
+		const int64 writeEnd = Time::getHighResolutionTicks();
+
+		if (command.sourceNodeId != 0)
+			addLatency(command, writeStart, writeEnd);
+
+		//only this thread writes the statistics, so plain stores are enough
+		const int64 queued = writeStart - command.queuedTicks;
+		totalQueueTicks.store(totalQueueTicks.load(std::memory_order_relaxed) + queued, std::memory_order_relaxed);
+		if (queued > maxQueueTicks.load(std::memory_order_relaxed))
+			maxQueueTicks.store(queued, std::memory_order_relaxed);
+		numWritten.store(numWritten.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	fifo.finishedRead(size1 + size2);
+}
+
+void OutputDispatcher::addLatency(const Command& command, int64 writeStart, int64 writeEnd)
+{
+	const int64 total = CoreServices::getTimeSinceSampleNs(command.sourceNodeId, command.subProcessorIdx, command.sampleNumber);
+	if (total < 0)
+		return;
+
+	const double nsPerTick = 1.0e9 / Time::getHighResolutionTicksPerSecond();
+	const int64 queue = (int64)((writeStart - command.queuedTicks) * nsPerTick);
+	const int64 write = (int64)((writeEnd - writeStart) * nsPerTick);
+
+	latencyMonitor.addLatency(total);
+	totalLatency.add(total);
+	chainLatency.add(jmax<int64>(0, total - queue - write));
+	queueLatency.add(queue);
+	writeLatency.add(write);
+}
+
+OutputDispatcher::Stats OutputDispatcher::getStats() const
+{
+	Stats stats;
+	stats.numWritten = numWritten.load(std::memory_order_acquire);
+	stats.numDropped = numDropped.load(std::memory_order_relaxed);
+
+	if (stats.numWritten > 0)
+	{
+		const double ticksPerMs = Time::getHighResolutionTicksPerSecond() / 1000.0;
+		stats.meanQueueMs = (float)(totalQueueTicks.load(std::memory_order_relaxed) / ticksPerMs / stats.numWritten);
+		stats.maxQueueMs = (float)(maxQueueTicks.load(std::memory_order_relaxed) / ticksPerMs);
+	}
+
+	return stats;
+}
+
+const OutputLatencyMonitor& OutputDispatcher::getLatencyMonitor() const
+{
+	return latencyMonitor;
+}
+
+String OutputDispatcher::getSummary() const
+{
+	Stats stats = getStats();
+
+	String summary = String(stats.numWritten) + " writes, queued mean " + String(stats.meanQueueMs, 3)
+		+ " ms, max " + String(stats.maxQueueMs, 3) + " ms";
+
+	if (stats.numDropped > 0)
+		summary += ", " + String(stats.numDropped) + " dropped";
+
+	return summary + "; " + latencyMonitor.getSummary();
+}
+
+String OutputDispatcher::getReport() const
+{
+	String report = getSummary() + "\n";
+
+	if (totalLatency.getCount() == 0)
+		return report;
+
+	report += "signal chain:\n" + chainLatency.toString();
+	report += "queue:\n" + queueLatency.toString();
+	report += "write:\n" + writeLatency.toString();
+	report += "total:\n" + totalLatency.toString();
+
+	return report;
+}
@@ -0,0 +1,137 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef __OUTPUTDISPATCHER_H_3C6B9E12__
+#define __OUTPUTDISPATCHER_H_3C6B9E12__
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "../PluginManager/OpenEphysPlugin.h"
+#include "OutputLatencyMonitor.h"
+#include "LatencyHistogram.h"
+
+/**
+	Moves the hardware writes of an output processor off the processing thread.
+
+	handleEvent() queues a command with push(), which neither locks nor allocates, and
+	a high priority thread of the dispatcher hands the commands to the device in order.
+	A slow serial write then delays the following outputs of that device, but not the
+	signal chain.
+
+	The dispatcher also measures how long commands wait in the queue, and times each
+	write against the acquisition of its triggering sample with an OutputLatencyMonitor.
+	The latencies of the timed commands are also split into stages, in histograms:
+	the signal chain (acquisition until push), the queue, and the device write.
+
+	@see ArduinoOutput, PulsePalOutput
+*/
+class PLUGIN_API OutputDispatcher : private Thread
+{
+public:
+	/** An output for the device. The meaning of channel and value is up to the processor. */
+	struct Command
+	{
+		int channel;
+		int value;
+
+		/** The sample that caused the output, to time it; sourceNodeId 0 if there is none */
+		uint16 sourceNodeId;
+		uint16 subProcessorIdx;
+		juce::int64 sampleNumber;
+
+		juce::int64 queuedTicks;
+	};
+
+	/** Writes the commands to the hardware, on the dispatcher thread */
+	class Device
+	{
+	public:
+		virtual ~Device() {}
+		virtual void writeOutput(const Command& command) = 0;
+	};
+
+	struct Stats
+	{
+		int64 numWritten{ 0 };
+		int64 numDropped{ 0 };
+		float meanQueueMs{ 0 };
+		float maxQueueMs{ 0 };
+	};
+
+	OutputDispatcher(const String& name, Device& device, int capacity = 1024);
+	~OutputDispatcher();
+
+	/** Resets the statistics and starts the thread, e.g. in enable() */
+	void start();
+
+	/** Writes the commands still queued and stops the thread, e.g. in disable() */
+	void stop();
+
+	/** Queues a command for the device. Called on the processing thread.
+		Returns false, and counts the command as dropped, if the queue is full. */
+	bool push(int channel, int value, uint16 sourceNodeId = 0, uint16 subProcessorIdx = 0, juce::int64 sampleNumber = 0);
+
+	Stats getStats() const;
+
+	/** Time from acquisition to write of the commands that named their sample */
+	const OutputLatencyMonitor& getLatencyMonitor() const;
+
+	/** One line description of the queue and latency statistics */
+	String getSummary() const;
+
+	/** The summary followed by the histogram of each latency stage, for benchmarks */
+	String getReport() const;
+
+private:
+	void run() override;
+
+	/** Writes every command queued so far */
+	void writeQueued();
+
+	/** Times a written command that named its sample, in total and by stage */
+	void addLatency(const Command& command, int64 writeStart, int64 writeEnd);
+
+	Device& device;
+
+	AbstractFifo fifo;
+	HeapBlock<Command> commands;
+	WaitableEvent commandsQueued;
+
+	OutputLatencyMonitor latencyMonitor;
+
+	LatencyHistogram chainLatency;
+	LatencyHistogram queueLatency;
+	LatencyHistogram writeLatency;
+	LatencyHistogram totalLatency;
+
+	std::atomic<int64> numWritten;
+	std::atomic<int64> numDropped;
+	std::atomic<int64> totalQueueTicks;
+	std::atomic<int64> maxQueueTicks;
+
+	JUCE_DECLARE_NON_COPYABLE(OutputDispatcher);
+};
+
+#endif  // __OUTPUTDISPATCHER_H_3C6B9E12__
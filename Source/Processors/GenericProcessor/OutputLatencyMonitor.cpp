@@ -0,0 +1,86 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "OutputLatencyMonitor.h"
+#include "../../CoreServices.h"
+
+OutputLatencyMonitor::OutputLatencyMonitor()
+{
+	reset();
+}
+
+void OutputLatencyMonitor::reset()
+{
+	numOutputs = 0;
+	totalNs = 0;
+	minNs = std::numeric_limits<int64>::max();
+	maxNs = 0;
+}
+
+bool OutputLatencyMonitor::addOutput(uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 sampleNumber)
+{
+	int64 latency = CoreServices::getTimeSinceSampleNs(sourceNodeId, subProcessorIdx, sampleNumber);
+	if (latency < 0)
+		return false;
+
+	addLatency(latency);
+	return true;
+}
+
+void OutputLatencyMonitor::addLatency(juce::int64 latency)
+{
+	//a single thread adds outputs, so plain stores are enough
+	totalNs.store(totalNs.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+	if (latency < minNs.load(std::memory_order_relaxed))
+		minNs.store(latency, std::memory_order_relaxed);
+	if (latency > maxNs.load(std::memory_order_relaxed))
+		maxNs.store(latency, std::memory_order_relaxed);
+	numOutputs.store(numOutputs.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+OutputLatencyMonitor::Stats OutputLatencyMonitor::getStats() const
+{
+	Stats stats;
+	stats.numOutputs = numOutputs.load(std::memory_order_acquire);
+
+	if (stats.numOutputs > 0)
+	{
+		stats.minMs = minNs.load(std::memory_order_relaxed) / 1.0e6f;
+		stats.meanMs = (float)(totalNs.load(std::memory_order_relaxed) / (double)stats.numOutputs / 1.0e6);
+		stats.maxMs = maxNs.load(std::memory_order_relaxed) / 1.0e6f;
+	}
+
+	return stats;
+}
+
+String OutputLatencyMonitor::getSummary() const
+{
+	Stats stats = getStats();
+
+	if (stats.numOutputs == 0)
+		return "no timed outputs";
+
+	return String(stats.numOutputs) + " outputs, latency min " + String(stats.minMs, 2)
+		+ " ms, mean " + String(stats.meanMs, 2) + " ms, max " + String(stats.maxMs, 2) + " ms";
+}
@@ -0,0 +1,82 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __OUTPUTLATENCYMONITOR_H_7E21A94C__
+#define __OUTPUTLATENCYMONITOR_H_7E21A94C__
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "../PluginManager/OpenEphysPlugin.h"
+
+/**
+	Measures the closed-loop latency of an output processor: the time from the acquisition
+	of the sample that caused an output (e.g. the TTL that PhaseDetector raised) to the moment
+	the output is sent to the hardware.
+
+	The acquisition time of the sample comes from the clock drift model of its source, so
+	sources without one (e.g. file playback) aren't measured. The processing thread adds
+	outputs and any thread can read the statistics.
+
+	@see ArduinoOutput, PulsePalOutput
+*/
+class PLUGIN_API OutputLatencyMonitor
+{
+public:
+	struct Stats
+	{
+		int64 numOutputs{ 0 };
+		float minMs{ 0 };
+		float meanMs{ 0 };
+		float maxMs{ 0 };
+	};
+
+	OutputLatencyMonitor();
+
+	/** Forgets the measured outputs */
+	void reset();
+
+	/** Call right after sending an output caused by the given sample of a source subprocessor,
+		such as the timestamp of a TTL event and the timestamp origin of its channel.
+		Returns false if the source can't be timed. */
+	bool addOutput(uint16 sourceNodeId, uint16 subProcessorIdx, juce::int64 sampleNumber);
+
+	/** Adds a latency measured by the caller */
+	void addLatency(juce::int64 latencyNs);
+
+	/** Statistics of the outputs since the last reset. Safe to call from any thread. */
+	Stats getStats() const;
+
+	/** One line description of the statistics, for logs and status messages */
+	String getSummary() const;
+
+private:
+	std::atomic<int64> numOutputs;
+	std::atomic<int64> totalNs;
+	std::atomic<int64> minNs;
+	std::atomic<int64> maxNs;
+
+	JUCE_DECLARE_NON_COPYABLE(OutputLatencyMonitor);
+};
+
+#endif  // __OUTPUTLATENCYMONITOR_H_7E21A94C__
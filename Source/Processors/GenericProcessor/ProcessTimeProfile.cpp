@@ -0,0 +1,121 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ProcessTimeProfile.h"
+
+#include <algorithm>
+
+ProcessTimeProfile::ProcessTimeProfile()
+	: nsPerTick(1.0e9 / (double)Time::getHighResolutionTicksPerSecond())
+{
+	reset();
+}
+
+void ProcessTimeProfile::reset()
+{
+	for (int i = 0; i < PROCESS_PROFILE_BLOCKS; i++)
+	{
+		blocks[i].processNs.store(0, std::memory_order_relaxed);
+		blocks[i].budgetNs.store(0, std::memory_order_relaxed);
+		blocks[i].numEvents.store(0, std::memory_order_relaxed);
+		blocks[i].numAllocations.store(0, std::memory_order_relaxed);
+	}
+	blockCount.store(0, std::memory_order_release);
+	shedBlockCount.store(0, std::memory_order_release);
+}
+
+void ProcessTimeProfile::addBlock(int64 processTicks, uint32 budgetNs, uint32 numEvents, uint32 numAllocations)
+{
+	int64 count = blockCount.load(std::memory_order_relaxed);
+	Block& block = blocks[count % PROCESS_PROFILE_BLOCKS];
+
+	double ns = jlimit(0.0, 4.0e9, processTicks * nsPerTick);
+	block.processNs.store((uint32)ns, std::memory_order_relaxed);
+	block.budgetNs.store(budgetNs, std::memory_order_relaxed);
+	block.numEvents.store(numEvents, std::memory_order_relaxed);
+	block.numAllocations.store(numAllocations, std::memory_order_relaxed);
+
+	blockCount.store(count + 1, std::memory_order_release);
+}
+
+int64 ProcessTimeProfile::getNumBlocks() const
+{
+	return blockCount.load(std::memory_order_acquire);
+}
+
+void ProcessTimeProfile::addShedBlock()
+{
+	shedBlockCount.store(shedBlockCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int64 ProcessTimeProfile::getNumShedBlocks() const
+{
+	return shedBlockCount.load(std::memory_order_acquire);
+}
+
+AllocationTally& ProcessTimeProfile::getAllocationTally() const
+{
+	return allocations;
+}
+
+ProcessTimeProfile::Stats ProcessTimeProfile::getStats() const
+{
+	Stats stats;
+
+	// A block being overwritten meanwhile only mixes in a newer block's values
+	int numBlocks = (int)jmin(getNumBlocks(), (int64)PROCESS_PROFILE_BLOCKS);
+	if (numBlocks == 0)
+		return stats;
+
+	uint32 durations[PROCESS_PROFILE_BLOCKS];
+	double totalNs = 0, totalBudgetNs = 0, totalEvents = 0, totalAllocations = 0;
+	uint32 maxAllocations = 0;
+
+	for (int i = 0; i < numBlocks; i++)
+	{
+		durations[i] = blocks[i].processNs.load(std::memory_order_relaxed);
+		totalNs += durations[i];
+		totalBudgetNs += blocks[i].budgetNs.load(std::memory_order_relaxed);
+		totalEvents += blocks[i].numEvents.load(std::memory_order_relaxed);
+
+		const uint32 numAllocations = blocks[i].numAllocations.load(std::memory_order_relaxed);
+		totalAllocations += numAllocations;
+		maxAllocations = jmax(maxAllocations, numAllocations);
+	}
+
+	int p99Index = jmin(numBlocks - 1, (int)(numBlocks * 0.99));
+	std::nth_element(durations, durations + p99Index, durations + numBlocks);
+
+	stats.numBlocks = numBlocks;
+	stats.minUs = *std::min_element(durations, durations + numBlocks) * 0.001f;
+	stats.maxUs = *std::max_element(durations, durations + numBlocks) * 0.001f;
+	stats.p99Us = durations[p99Index] * 0.001f;
+	stats.meanUs = (float)(totalNs / numBlocks * 0.001);
+	stats.budgetPercent = totalBudgetNs > 0 ? (float)(100.0 * totalNs / totalBudgetNs) : 0.0f;
+	stats.meanEvents = (float)(totalEvents / numBlocks);
+	stats.meanAllocations = (float)(totalAllocations / numBlocks);
+	stats.maxAllocations = (int)maxAllocations;
+
+	return stats;
+}
@@ -0,0 +1,106 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __PROCESSTIMEPROFILE_H_3C8B0F2D__
+#define __PROCESSTIMEPROFILE_H_3C8B0F2D__
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "../PluginManager/OpenEphysPlugin.h"
+#include "../../Utils/AllocationCounter.h"
+
+#define PROCESS_PROFILE_BLOCKS 512
+
+/**
+	Keeps the time a processor took to process each of its last blocks, and the
+	heap allocations made for it meanwhile while the AllocationCounter is enabled.
+
+	The processing thread adds one entry per block, and any thread can compute the
+	statistics of the recent blocks, without locks on either side.
+
+	@see GenericProcessor
+*/
+class PLUGIN_API ProcessTimeProfile
+{
+public:
+	struct Stats
+	{
+		int numBlocks{ 0 };			// blocks the statistics are computed from
+		float minUs{ 0 };
+		float meanUs{ 0 };
+		float p99Us{ 0 };
+		float maxUs{ 0 };
+		float budgetPercent{ 0 };	// mean share of the block duration spent in process()
+		float meanEvents{ 0 };		// events received per block
+		float meanAllocations{ 0 };	// heap allocations per block
+		int maxAllocations{ 0 };
+	};
+
+	ProcessTimeProfile();
+
+	/** Forgets the recorded blocks. Only safe while the processor isn't processing.*/
+	void reset();
+
+	/** Called by the processing thread after each block.
+		budgetNs is the duration of the block at the graph sample rate.*/
+	void addBlock(int64 processTicks, uint32 budgetNs, uint32 numEvents, uint32 numAllocations = 0);
+
+	/** Statistics of the last PROCESS_PROFILE_BLOCKS blocks. Safe to call from any thread.*/
+	Stats getStats() const;
+
+	/** Total number of blocks since the last reset */
+	int64 getNumBlocks() const;
+
+	/** Called by the processing thread instead of addBlock() when the processor
+		gave up a block under load. Shed blocks aren't part of the statistics.*/
+	void addShedBlock();
+
+	/** Number of blocks shed since the last reset */
+	int64 getNumShedBlocks() const;
+
+	/** The allocations of the threads working for the processor.
+		Counted from any thread, hence available through a const profile.*/
+	AllocationTally& getAllocationTally() const;
+
+private:
+	struct Block
+	{
+		std::atomic<uint32> processNs;
+		std::atomic<uint32> budgetNs;
+		std::atomic<uint32> numEvents;
+		std::atomic<uint32> numAllocations;
+	};
+
+	Block blocks[PROCESS_PROFILE_BLOCKS];
+	std::atomic<int64> blockCount;
+	std::atomic<int64> shedBlockCount;
+
+	mutable AllocationTally allocations;
+
+	const double nsPerTick;
+
+	JUCE_DECLARE_NON_COPYABLE(ProcessTimeProfile);
+};
+
+#endif  // __PROCESSTIMEPROFILE_H_3C8B0F2D__
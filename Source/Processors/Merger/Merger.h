@@ -38,6 +38,10 @@
   it has no incoming or outgoing connections. It just allows the outputs from
   TWO source nodes to be connected to ONE destination.
 
+  The graph hands the destination the events of both chains in whatever order
+  it concatenated their buffers, so every processor downstream of a Merger
+  merges them back into timestamp order before handling them.
+
   @see GenericProcessor, ProcessorGraph
 
 */
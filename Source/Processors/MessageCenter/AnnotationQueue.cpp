@@ -0,0 +1,98 @@
+/*
+    -----------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AnnotationQueue.h"
+
+AnnotationQueue::AnnotationQueue()
+    : pushPosition (0),
+      popPosition (0)
+{
+    for (uint32 i = 0; i < ANNOTATION_QUEUE_SIZE; ++i)
+        slots[i].sequence.store (i, std::memory_order_relaxed);
+}
+
+bool AnnotationQueue::push (juce::int64 timestamp, bool isBinary, const void* data, int size)
+{
+    if (size < 0 || size > MAX_MSG_LENGTH)
+        return false;
+
+    uint32 position = pushPosition.load (std::memory_order_relaxed);
+    Slot* slot;
+
+    for (;;)
+    {
+        slot = &slots[position & (ANNOTATION_QUEUE_SIZE - 1)];
+        const int32 lag = int32 (slot->sequence.load (std::memory_order_acquire) - position);
+
+        if (lag == 0)
+        {
+            // the slot is free for this round; claim the position
+            if (pushPosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (lag < 0)
+        {
+            // the consumer has not freed the slot of the previous round yet
+            return false;
+        }
+        else
+        {
+            position = pushPosition.load (std::memory_order_relaxed);
+        }
+    }
+
+    slot->annotation.timestamp = timestamp;
+    slot->annotation.isBinary = isBinary;
+    slot->annotation.size = size;
+    memcpy (slot->annotation.data, data, (size_t) size);
+    zeromem (slot->annotation.data + size, (size_t) (MAX_MSG_LENGTH - size));
+
+    slot->sequence.store (position + 1, std::memory_order_release);
+    return true;
+}
+
+bool AnnotationQueue::pop (Annotation& annotation)
+{
+    Slot& slot = slots[popPosition & (ANNOTATION_QUEUE_SIZE - 1)];
+
+    if (slot.sequence.load (std::memory_order_acquire) != popPosition + 1)
+        return false;
+
+    annotation.timestamp = slot.annotation.timestamp;
+    annotation.isBinary = slot.annotation.isBinary;
+    annotation.size = slot.annotation.size;
+    memcpy (annotation.data, slot.annotation.data, MAX_MSG_LENGTH);
+
+    // free the slot for the push of the next round
+    slot.sequence.store (popPosition + ANNOTATION_QUEUE_SIZE, std::memory_order_release);
+    ++popPosition;
+    return true;
+}
+
+void AnnotationQueue::clear()
+{
+    Annotation annotation;
+
+    while (pop (annotation))
+        ;
+}
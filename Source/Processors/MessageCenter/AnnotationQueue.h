@@ -0,0 +1,85 @@
+/*
+    -----------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __ANNOTATIONQUEUE_H_4F1B8A6E__
+#define __ANNOTATIONQUEUE_H_4F1B8A6E__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+/* Longest text or binary annotation, in bytes */
+#define MAX_MSG_LENGTH 512
+
+/* Annotations that can wait for the next block; a power of two */
+#define ANNOTATION_QUEUE_SIZE 256
+
+/** A text or binary message waiting to be added to the event buffer */
+struct Annotation
+{
+    juce::int64 timestamp;
+    bool isBinary;
+    int size;
+    char data[MAX_MSG_LENGTH];     // padded with zeros after size bytes
+};
+
+/**
+    Bounded queue of annotations that any number of threads push without locking
+    and the MessageCenter pops on the processing thread.
+
+    Each slot carries a sequence number telling whether it is free for the push of
+    a given round or holds the annotation the consumer expects next, so producers
+    only contend on the atomic claim of a position.
+
+    @see MessageCenter, CoreServices::sendAnnotation
+*/
+class AnnotationQueue
+{
+public:
+    AnnotationQueue();
+
+    /** Copies an annotation of size bytes into the queue. Can be called from any thread.
+        Returns false if the queue is full or the annotation is too long. */
+    bool push (juce::int64 timestamp, bool isBinary, const void* data, int size);
+
+    /** Takes the oldest annotation out of the queue. Only called from the consumer thread.
+        Returns false if the queue is empty. */
+    bool pop (Annotation& annotation);
+
+    /** Drops all waiting annotations. Only called from the consumer thread. */
+    void clear();
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32> sequence;
+        Annotation annotation;
+    };
+
+    Slot slots[ANNOTATION_QUEUE_SIZE];
+    std::atomic<uint32> pushPosition;
+    uint32 popPosition;
+
+    JUCE_DECLARE_NON_COPYABLE (AnnotationQueue);
+};
+
+#endif  // __ANNOTATIONQUEUE_H_4F1B8A6E__
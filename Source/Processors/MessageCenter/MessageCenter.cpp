@@ -27,11 +27,10 @@
 #include "../../AccessClass.h"
 #include "../../Utils/Utils.h"
 
-#define MAX_MSG_LENGTH 512
 //---------------------------------------------------------------------
 
 MessageCenter::MessageCenter() :
-GenericProcessor("Message Center"), newEventAvailable(false), isRecording(false)
+GenericProcessor("Message Center"), newEventAvailable(false), isRecording(false), acquiring(false)
 {
 
     setPlayConfigDetails(0, // number of inputs
@@ -68,6 +67,16 @@ void MessageCenter::addSpecialProcessorChannels()
         eventChannel->setDescription("Messages from the GUI Message Center");
         eventChannelArray.add(new EventChannel(*eventChannel));
 
+        annotationChannel = new EventChannel(EventChannel::UINT8_ARRAY,
+                                             1,
+                                             MAX_MSG_LENGTH,
+                                             CoreServices::getGlobalSampleRate(),
+                                             this, 0);
+
+        annotationChannel->setName("GUI Annotations");
+        annotationChannel->setDescription("Binary annotations sent through the Message Center");
+        eventChannelArray.add(new EventChannel(*annotationChannel));
+
         updateChannelIndexes();
     }
 }
@@ -86,6 +95,19 @@ const EventChannel* MessageCenter::getMessageChannel()
     return getEventChannel(0);
 }
 
+const EventChannel* MessageCenter::getAnnotationChannel()
+{
+    return getEventChannel(1);
+}
+
+bool MessageCenter::addAnnotation(juce::int64 timestamp, bool isBinary, const void* data, int size)
+{
+    if (!acquiring.load())
+        return false;
+
+    return annotations.push(timestamp, isBinary, data, size);
+}
+
 void MessageCenter::setParameter(int parameterIndex, float newValue)
 {
     if (isRecording)
@@ -103,11 +125,16 @@ void MessageCenter::setParameter(int parameterIndex, float newValue)
 bool MessageCenter::enable()
 {
     messageCenterEditor->startAcquisition();
+
+    // annotations can't be queued while stopped, but drop any that raced with the last stop
+    annotations.clear();
+    acquiring = true;
     return true;
 }
 
 bool MessageCenter::disable()
 {
+    acquiring = false;
     messageCenterEditor->stopAcquisition();
     return true;
 }
@@ -142,5 +169,15 @@ void MessageCenter::process(AudioSampleBuffer& buffer)
         newEventAvailable = false;
     }
 
+    Annotation annotation;
+
+    while (annotations.pop(annotation))
+    {
+        if (annotation.isBinary)
+            addBinaryEvent(getEventChannel(1), annotation.timestamp, annotation.data, MAX_MSG_LENGTH, 0);
+        else
+            addTextEvent(getEventChannel(0), annotation.timestamp, annotation.data, (size_t) annotation.size, 0);
+    }
+
 
 }
\ No newline at end of file
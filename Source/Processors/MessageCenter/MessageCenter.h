@@ -29,6 +29,7 @@
 #include <stdio.h>
 
 #include "../GenericProcessor/GenericProcessor.h"
+#include "AnnotationQueue.h"
 
 class MessageCenterEditor;
 
@@ -63,6 +64,16 @@ public:
 
     const EventChannel* getMessageChannel();
 
+    /** The channel of binary annotations, see addAnnotation() */
+    const EventChannel* getAnnotationChannel();
+
+    /** Queues a text or binary annotation for the next processing block, to be sent with
+        the given timestamp. Can be called from any thread without locking, and doesn't
+        involve the message thread. Text goes to the message channel and binary data,
+        padded with zeros, to the annotation channel. Returns false if acquisition is stopped, the annotation
+        is too long or too many are waiting. */
+    bool addAnnotation(juce::int64 timestamp, bool isBinary, const void* data, int size);
+
     bool enable() override;
     bool disable() override;
 
@@ -85,6 +96,10 @@ private:
     bool needsToSendTimestampMessage;
 
     ScopedPointer<EventChannel> eventChannel;
+    ScopedPointer<EventChannel> annotationChannel;
+
+    AnnotationQueue annotations;
+    std::atomic<bool> acquiring;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MessageCenter);
 
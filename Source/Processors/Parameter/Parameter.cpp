@@ -39,6 +39,8 @@ Parameter::Parameter (const String& name, bool defaultValue, int ID, bool deacti
     m_minValueObject = 0;
     m_maxValueObject = 0;
 
+    m_typedDefaultValue = defaultValue;
+
     registerValueListeners();
 }
 
@@ -63,6 +65,8 @@ Parameter::Parameter (const String& name,
     m_minValueObject = minPossibleValue;
     m_maxValueObject = maxPossibleValue;
 
+    m_typedDefaultValue = defaultValue;
+
     registerValueListeners();
 }
 
@@ -83,6 +87,8 @@ Parameter::Parameter (const String& name,
     m_minValueObject = 0;
     m_maxValueObject = 0;
 
+    m_typedDefaultValue = defaultValue;
+
     registerValueListeners();
 }
 
@@ -107,10 +113,19 @@ Parameter::Parameter (const String& name, const String& labelName,
     m_minValueObject = minPossibleValue;
     m_maxValueObject = maxPossibleValue;
 
+    m_typedDefaultValue = defaultValue;
+
     registerValueListeners();
 }
 
 
+Parameter::~Parameter()
+{
+    for (auto& block : m_typedValues)
+        delete[] block.load();
+}
+
+
 void Parameter::registerValueListeners()
 {
     m_desiredXValueObject.addListener (this);
@@ -141,6 +156,24 @@ const Array<var>& Parameter::getPossibleValues() const      { return m_possibleV
 var Parameter::getValue   (int channel)   const { return m_values[channel]; }
 var Parameter::operator[] (int channel)   const { return m_values[channel]; }
 
+double Parameter::getDoubleValue (int channel) const noexcept
+{
+    if (isPositiveAndBelow (channel, PARAMETER_VALUE_BLOCK_SIZE * PARAMETER_MAX_VALUE_BLOCKS))
+    {
+        if (auto block = m_typedValues[channel / PARAMETER_VALUE_BLOCK_SIZE].load (std::memory_order_acquire))
+            return block[channel % PARAMETER_VALUE_BLOCK_SIZE].load (std::memory_order_relaxed);
+    }
+
+    return m_typedDefaultValue.load (std::memory_order_relaxed);
+}
+
+bool  Parameter::getBoolValue   (int channel) const noexcept { return getDoubleValue (channel) > 0.0; }
+int   Parameter::getIntValue    (int channel) const noexcept { return roundToInt (getDoubleValue (channel)); }
+float Parameter::getFloatValue  (int channel) const noexcept { return (float) getDoubleValue (channel); }
+
+uint32 Parameter::getChangeCount()          const noexcept { return m_changeCount.load (std::memory_order_relaxed); }
+juce::int64 Parameter::getLastChangeTicks() const noexcept { return m_lastChangeTicks.load (std::memory_order_relaxed); }
+
 Parameter::ParameterType Parameter::getParameterType() const noexcept { return m_parameterType; }
 
 bool Parameter::isBoolean()     const noexcept { return m_parameterType == PARAMETER_TYPE_BOOLEAN; }
@@ -246,21 +279,58 @@ void Parameter::setValue (float value, int channel)
     {
         const bool newValue = (value > 0.0f) ? true : false;
         m_values.set (channel, newValue);
+        storeTypedValue (channel, newValue ? 1.0 : 0.0);
     }
     else if (isContinuous())
     {
         const float newValue = jlimit (float (m_possibleValues[0]), float (m_possibleValues[1]), value);
         m_values.set (channel, newValue);
+        storeTypedValue (channel, newValue);
     }
     else if (isNumerical())
     {
         const double newValue = jlimit (double (m_possibleValues[0]), double (m_possibleValues[1]), (double)value);
         m_values.set (channel, newValue);
+        storeTypedValue (channel, newValue);
     }
     else
     {
         m_values.set (channel, value);
+        storeTypedValue (channel, value);
     }
+
+    m_changeCount.fetch_add (1, std::memory_order_relaxed);
+    m_lastChangeTicks.store (Time::getHighResolutionTicks(), std::memory_order_relaxed);
+}
+
+
+void Parameter::storeTypedValue (int channel, double value)
+{
+    if (! isPositiveAndBelow (channel, PARAMETER_VALUE_BLOCK_SIZE * PARAMETER_MAX_VALUE_BLOCKS))
+    {
+        jassertfalse;
+        return;
+    }
+
+    auto& slot = m_typedValues[channel / PARAMETER_VALUE_BLOCK_SIZE];
+    auto block = slot.load (std::memory_order_acquire);
+
+    if (block == nullptr)
+    {
+        auto newBlock = new std::atomic<double>[PARAMETER_VALUE_BLOCK_SIZE];
+        const double defaultValue = m_typedDefaultValue.load (std::memory_order_relaxed);
+
+        for (int i = 0; i < PARAMETER_VALUE_BLOCK_SIZE; ++i)
+            newBlock[i].store (defaultValue, std::memory_order_relaxed);
+
+        // a change applied directly while the queue was full may have raced us to it
+        if (slot.compare_exchange_strong (block, newBlock, std::memory_order_acq_rel))
+            block = newBlock;
+        else
+            delete[] newBlock;
+    }
+
+    block[channel % PARAMETER_VALUE_BLOCK_SIZE].store (value, std::memory_order_relaxed);
 }
 
 
@@ -352,6 +422,10 @@ void Parameter::valueChanged (Value& valueThatWasChanged)
         Array<var> possibleValues (createArrayFromString<int> (valueThatWasChanged.toString(), ","));
         m_possibleValues = possibleValues;
     }
+    else if (valueThatWasChanged.refersToSameSourceAs (m_defaultValueObject))
+    {
+        m_typedDefaultValue = (double) valueThatWasChanged.getValue();
+    }
 
     m_listeners.call (&Parameter::Listener::parameterValueChanged, valueThatWasChanged);
 }
@@ -27,7 +27,11 @@
 #include "../PluginManager/OpenEphysPlugin.h"
 
 #include <stdio.h>
+#include <atomic>
 
+/* Channels per block of a parameter's lock-free values, and the number of blocks it can have */
+#define PARAMETER_VALUE_BLOCK_SIZE 256
+#define PARAMETER_MAX_VALUE_BLOCKS 64
 
 /**
     Class for holding user-definable processor parameters.
@@ -37,6 +41,10 @@
     Using the Parameter class makes it easier to create a graphical interface for editing
     parameters, because each Parameter has a ParameterEditor that is created automatically.
 
+    Besides the var of each channel, setValue() keeps a lock-free numeric copy that the
+    typed getters read, so process() can use a parameter without going through var, and
+    counts the changes and times the last one.
+
     @see GenericProcessor, GenericEditor
 */
 class PLUGIN_API Parameter : private Value::Listener
@@ -82,6 +90,8 @@ public:
                int ID,
                bool deactivateDuringAcquisition = false);
 
+    ~Parameter();
+
 
     // Value::Listener
     void valueChanged (Value& valueThatWasChanged) override;
@@ -104,6 +114,19 @@ public:
     /** Returns the value of a parameter for a given channel.*/
     var operator[](int chan) const;
 
+    /** Lock-free typed reads of the value of a channel, which can be made from any thread.
+        A channel that was never set reads as the default value. */
+    bool getBoolValue (int chan) const noexcept;
+    int getIntValue (int chan) const noexcept;
+    float getFloatValue (int chan) const noexcept;
+    double getDoubleValue (int chan) const noexcept;
+
+    /** Number of calls to setValue() so far */
+    uint32 getChangeCount() const noexcept;
+
+    /** Time::getHighResolutionTicks() of the last call to setValue(), 0 if there was none */
+    juce::int64 getLastChangeTicks() const noexcept;
+
     /** Returns all the possible values that a parameter can take for Boolean and Discrete parameters;
         Returns the minimum and maximum value that a parameter can take for Continuous parameters.*/
     const Array<var>& getPossibleValues() const;
@@ -194,6 +217,9 @@ public:
 private:
     void registerValueListeners();
 
+    /** Stores the numeric copy of the value of a channel, allocating its block the first time */
+    void storeTypedValue (int chan, double value);
+
     //String m_name;
     //String m_description;
 
@@ -226,6 +252,15 @@ private:
     // ========================================================================
 
     ListenerList<Listener> m_listeners;
+
+    /** Blocks of PARAMETER_VALUE_BLOCK_SIZE channels, allocated on first use and kept until
+        the parameter is deleted, so readers never see them move */
+    std::atomic<std::atomic<double>*> m_typedValues[PARAMETER_MAX_VALUE_BLOCKS] {};
+    std::atomic<double> m_typedDefaultValue { 0.0 };
+    std::atomic<uint32> m_changeCount { 0 };
+    std::atomic<juce::int64> m_lastChangeTicks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (Parameter);
 };
 
 
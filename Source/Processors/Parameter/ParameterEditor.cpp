@@ -264,9 +264,9 @@ void ParameterEditor::buttonClicked (Button* buttonThatWasClicked)
         {
             for (int i = 0; i < activeChannels.size(); ++i)
             {
-                m_processor->setCurrentChannel (activeChannels[i]);
-                m_processor->setParameter (buttonThatWasClicked->getComponentID().getIntValue(),
-                                           buttonThatWasClicked->getButtonText().getFloatValue());
+                m_processor->queueParameterChange (buttonThatWasClicked->getComponentID().getIntValue(),
+                                                   buttonThatWasClicked->getButtonText().getFloatValue(),
+                                                   activeChannels[i]);
             }
         }
     }
@@ -283,9 +283,9 @@ void ParameterEditor::sliderValueChanged (Slider* sliderWhichValueHasChanged)
         {
             for (int i = 0; i < activeChannels.size(); ++i)
             {
-                m_processor->setCurrentChannel (activeChannels[i]);
-                m_processor->setParameter (sliderWhichValueHasChanged->getComponentID().getIntValue(),
-                                           sliderWhichValueHasChanged->getValue());
+                m_processor->queueParameterChange (sliderWhichValueHasChanged->getComponentID().getIntValue(),
+                                                   sliderWhichValueHasChanged->getValue(),
+                                                   activeChannels[i]);
             }
         }
     }
@@ -300,9 +300,9 @@ void ParameterEditor::parameterLabelValueChanged (ParameterLabel* parameterLabel
         {
             for (int i = 0; i < activeChannels.size(); ++i)
             {
-                m_processor->setCurrentChannel (activeChannels[i]);
-                m_processor->setParameter (parameterLabelWhichValueHasChanged->getComponentID().getIntValue(),
-                                           parameterLabelWhichValueHasChanged->getValue());
+                m_processor->queueParameterChange (parameterLabelWhichValueHasChanged->getComponentID().getIntValue(),
+                                                   parameterLabelWhichValueHasChanged->getValue(),
+                                                   activeChannels[i]);
             }
         }
     }
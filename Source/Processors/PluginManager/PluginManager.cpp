@@ -27,12 +27,96 @@
 #include <dlfcn.h>
 #include <execinfo.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
 
 #include "PluginManager.h"
 #include "../../UI/ProcessorList.h"
 #include "../../UI/ControlPanel.h"
 
 #include "../../Utils/Utils.h"
+#include "../../CoreServices.h"
+
+/** Libraries listed from this file aren't loaded until one of their plugins is used */
+#define PLUGIN_CACHE_FILE "pluginCache.xml"
+
+/* Instruction set variants a plugin library can be built for, best first. A variant is
+   installed next to the baseline library, with its name before the extension, as in
+   FilterNode.avx2.so; see plugin_add_simd_variants() in PluginRules.cmake */
+static const char* const librarySimdVariants[] = { "avx512", "avx2", "neon" };
+
+
+/*
+	 True if the CPU, and the operating system, support the instructions a variant
+	 of a plugin library was built with.
+ */
+static bool isSimdVariantSupported(const String& variant)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	unsigned int leaf1[4] = { 0 }, leaf7[4] = { 0 };
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	for (int i = 0; i < 4; i++) leaf1[i] = (unsigned int) regs[i];
+	__cpuidex(regs, 7, 0);
+	for (int i = 0; i < 4; i++) leaf7[i] = (unsigned int) regs[i];
+#else
+	__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+	__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+
+	const bool osSavesAvx = (leaf1[2] & (1u << 27)) != 0;	// OSXSAVE
+	if (!osSavesAvx)
+		return false;
+
+#if defined(_MSC_VER)
+	const uint64 xcr0 = _xgetbv(0);
+#else
+	unsigned int xcr0Low, xcr0High;
+	__asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+	const uint64 xcr0 = ((uint64) xcr0High << 32) | xcr0Low;
+#endif
+
+	const bool avxState = (xcr0 & 0x06) == 0x06;			// XMM and YMM registers
+	const bool avx512State = (xcr0 & 0xe6) == 0xe6;		// and the opmask and ZMM registers
+	const bool avx2 = (leaf7[1] & (1u << 5)) != 0 && (leaf1[2] & (1u << 12)) != 0;	// AVX2 and FMA
+
+	if (variant == "avx2")
+		return avxState && avx2;
+
+	if (variant == "avx512")	// F, DQ, BW and VL, as in plugin_add_simd_variants()
+		return avx512State && avx2 && (leaf7[1] & 0xc0030000u) == 0xc0030000u;
+
+	return false;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	return variant == "neon";
+#elif defined(__arm__) && defined(__linux__)
+	return variant == "neon" && (getauxval(AT_HWCAP) & (1 << 12)) != 0;	// HWCAP_NEON
+#else
+	return false;
+#endif
+}
+
+
+/*
+	 The instruction set variant of a plugin library file, or an empty string for
+	 the baseline build.
+ */
+static String getSimdVariant(const File& library)
+{
+	const String variant = library.getFileNameWithoutExtension().fromLastOccurrenceOf(".", false, false);
+
+	for (auto knownVariant : librarySimdVariants)
+		if (variant == knownVariant)
+			return variant;
+
+	return String();
+}
 
 
 static inline void closeHandle(decltype(LoadedLibInfo::handle) handle) {
@@ -72,6 +156,89 @@ static void errorMsg(const char *file, int line, const char *msg) {
 #define ERROR_MSG(msg) errorMsg(__FILE__, __LINE__, msg)
 
 
+/*
+	 Opens a plugin library. Dynamic linker requires
+	 a C-style string, so we we have to convert first.
+ */
+static decltype(LoadedLibInfo::handle) openLibrary(const String& pluginLoc)
+{
+	const char* processorLocCString = static_cast<const char*>(pluginLoc.toUTF8());
+
+#ifdef WIN32
+	HINSTANCE handle;
+	handle = LoadLibrary(processorLocCString);
+#elif defined(__APPLE__)
+    CFURLRef bundleURL = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault,
+                                                                 reinterpret_cast<const UInt8 *>(processorLocCString),
+                                                                 strlen(processorLocCString),
+                                                                 true);
+    assert(bundleURL);
+    CFBundleRef handle = CFBundleCreate(kCFAllocatorDefault, bundleURL);
+    CFRelease(bundleURL);
+#else
+	// Clear errors
+	dlerror();
+
+	/*
+	Changing this to resolve all variables immediately upon loading.
+	This will provide for quicker testing of the custom
+	processor stability and to ensure that it doesn't crash due
+	to memory mishaps.
+	*/
+	void *handle = 0;
+	handle = dlopen(processorLocCString,RTLD_GLOBAL|RTLD_NOW);
+#endif
+
+	if (!handle) {
+		ERROR_MSG("Failed to load plugin DLL");
+	}
+
+	return handle;
+}
+
+
+/*
+	 Finds the two functions every plugin library exports.
+ */
+static bool getLibraryFunctions(decltype(LoadedLibInfo::handle) handle,
+	LibraryInfoFunction& infoFunction, PluginInfoFunction& piFunction)
+{
+	infoFunction = 0;
+#ifdef WIN32
+	infoFunction = (LibraryInfoFunction)GetProcAddress(handle, "getLibInfo");
+#elif defined(__APPLE__)
+    infoFunction = (LibraryInfoFunction)CFBundleGetFunctionPointerForName(handle, CFSTR("getLibInfo"));
+#else
+    dlerror();
+	infoFunction = (LibraryInfoFunction)(dlsym(handle, "getLibInfo"));
+#endif
+
+	if (!infoFunction)
+	{
+		ERROR_MSG("Failed to load function 'getLibInfo'");
+		return false;
+	}
+
+	piFunction = 0;
+#ifdef WIN32
+	piFunction = (PluginInfoFunction)GetProcAddress(handle, "getPluginInfo");
+#elif defined(__APPLE__)
+    piFunction = (PluginInfoFunction)CFBundleGetFunctionPointerForName(handle, CFSTR("getPluginInfo"));
+#else
+    dlerror();
+	piFunction = (PluginInfoFunction)(dlsym(handle, "getPluginInfo"));
+#endif
+
+	if (!piFunction)
+	{
+        ERROR_MSG("Failed to load function 'getPluginInfo'");
+		return false;
+	}
+
+	return true;
+}
+
+
 PluginManager::PluginManager()
 {
 #ifdef _WIN32
@@ -107,6 +274,8 @@ PluginManager::PluginManager()
 
 PluginManager::~PluginManager()
 {
+	if (prefetchThread != nullptr)
+		prefetchThread->stopThread(10000);
 }
 
 
@@ -131,6 +300,15 @@ void PluginManager::loadAllPlugins()
 	    paths.add(File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile(".open-ephys/plugins"));	
 #endif
 
+    File cacheFile = CoreServices::getSavedStateDirectory().getChildFile(PLUGIN_CACHE_FILE);
+
+    pluginCache = XmlDocument::parse(cacheFile);
+    if (pluginCache != nullptr && pluginCache->getIntAttribute("apiVersion") != PLUGIN_API_VER)
+        pluginCache = nullptr;
+
+    newPluginCache = new XmlElement("PLUGINCACHE");
+    newPluginCache->setAttribute("apiVersion", PLUGIN_API_VER);
+
     for (auto &pluginPath : paths) {
         if (!pluginPath.isDirectory()) {
 			LOGD("Plugin path not found: ", pluginPath.getFullPathName(), "\nCreating new plugins directory...");
@@ -139,6 +317,15 @@ void PluginManager::loadAllPlugins()
             loadPlugins(pluginPath);
         }
     }
+
+    // libraries that were removed drop out of the cache
+    if (!newPluginCache->writeToFile(cacheFile, String::empty))
+        LOGD("Could not write the plugin cache to ", cacheFile.getFullPathName());
+
+    pluginCache = nullptr;
+    newPluginCache = nullptr;
+
+    prefetchLastSignalChain();
 }
 
 void PluginManager::loadPlugins(const File &pluginPath) {
@@ -158,10 +345,22 @@ void PluginManager::loadPlugins(const File &pluginPath) {
 	pluginPath.findChildFiles(foundDLLs, File::findFiles, true, pluginExt);
 #endif
 
+	selectSimdVariants(foundDLLs);
+
 	for (int i = 0; i < foundDLLs.size(); i++)
 	{
+		const String path = foundDLLs[i].getFullPathName();
+		XmlElement* entry = pluginCache != nullptr ? pluginCache->getChildByAttribute("path", path) : nullptr;
+
+		if (entry != nullptr && isCacheEntryCurrent(foundDLLs[i], *entry) && addCachedLibrary(foundDLLs[i], *entry))
+		{
+			LOGDD("Listed Plugin from cache: ", foundDLLs[i].getFileNameWithoutExtension());
+			newPluginCache->addChildElement(new XmlElement(*entry));
+			continue;
+		}
+
 		LOGD("Loading Plugin: ", foundDLLs[i].getFileNameWithoutExtension(), "... ");
-		int res = loadPlugin(foundDLLs[i].getFullPathName());
+		int res = loadPlugin(path);
 		if (res < 0)
 		{
 			LOGD(" DLL Load FAILED");
@@ -169,10 +368,69 @@ void PluginManager::loadPlugins(const File &pluginPath) {
 		else
 		{
 			LOGDD("Loaded with ", res, " plugins");
+
+			if (newPluginCache != nullptr)
+				if (XmlElement* newEntry = createCacheEntry(foundDLLs[i], libArray.size() - 1))
+					newPluginCache->addChildElement(newEntry);
 		}
 	}
 }
 
+void PluginManager::selectSimdVariants(Array<File>& libraries)
+{
+	StringArray supported;
+	for (auto variant : librarySimdVariants)
+		if (isSimdVariantSupported(variant))
+			supported.add(variant);
+
+	Array<File> selected;
+
+	for (auto& library : libraries)
+	{
+		const String variant = getSimdVariant(library);
+		const String baseName = variant.isEmpty() ? library.getFileNameWithoutExtension()
+			: library.getFileNameWithoutExtension().dropLastCharacters(variant.length() + 1);
+
+		/* Each library is looked at once, with the other builds of it in the same folder */
+		bool alreadyChosen = false;
+		for (auto& chosen : selected)
+		{
+			const String chosenVariant = getSimdVariant(chosen);
+			const String chosenBase = chosenVariant.isEmpty() ? chosen.getFileNameWithoutExtension()
+				: chosen.getFileNameWithoutExtension().dropLastCharacters(chosenVariant.length() + 1);
+
+			if (chosenBase == baseName && chosen.getParentDirectory() == library.getParentDirectory())
+				alreadyChosen = true;
+		}
+
+		if (alreadyChosen)
+			continue;
+
+		const String extension = library.getFileExtension();
+		File best = library.getSiblingFile(baseName + extension);
+
+		for (int i = supported.size(); --i >= 0;)
+		{
+			File candidate = library.getSiblingFile(baseName + "." + supported[i] + extension);
+			if (candidate.exists())
+				best = candidate;
+		}
+
+		if (!best.exists())
+		{
+			LOGD("No build of ", baseName, " runs on this CPU");
+			continue;
+		}
+
+		if (getSimdVariant(best).isNotEmpty())
+			LOGD("Using the ", getSimdVariant(best), " build of ", baseName);
+
+		selected.add(best);
+	}
+
+	libraries.swapWith(selected);
+}
+
 /*
 	 Takes the user-specified plugin and begins
 	 dynamic loading process. We want to ensure that
@@ -185,55 +443,18 @@ int PluginManager::loadPlugin(const String& pluginLoc) {
 	/*
 	Load in the selected processor. This takes the
 	dynamic object (.so) and copies it into RAM
-	Dynamic linker requires a C-style string, so we
-	we have to convert first.
-	*/
-	const char* processorLocCString = static_cast<const char*>(pluginLoc.toUTF8());
-
-#ifdef WIN32
-	HINSTANCE handle;
-	handle = LoadLibrary(processorLocCString);
-#elif defined(__APPLE__)
-    CFURLRef bundleURL = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault,
-                                                                 reinterpret_cast<const UInt8 *>(processorLocCString),
-                                                                 strlen(processorLocCString),
-                                                                 true);
-    assert(bundleURL);
-    CFBundleRef handle = CFBundleCreate(kCFAllocatorDefault, bundleURL);
-    CFRelease(bundleURL);
-#else
-	// Clear errors
-	dlerror();
-
-	/*
-	Changing this to resolve all variables immediately upon loading.
-	This will provide for quicker testing of the custom
-	processor stability and to ensure that it doesn't crash due
-	to memory mishaps.
 	*/
-	void *handle = 0;
-	handle = dlopen(processorLocCString,RTLD_GLOBAL|RTLD_NOW);
-#endif
+	auto handle = openLibrary(pluginLoc);
 
 	if (!handle) {
-		ERROR_MSG("Failed to load plugin DLL");
-		closeHandle(handle);
 		return -1;
 	}
 
-	LibraryInfoFunction infoFunction = 0;
-#ifdef WIN32
-	infoFunction = (LibraryInfoFunction)GetProcAddress(handle, "getLibInfo");
-#elif defined(__APPLE__)
-    infoFunction = (LibraryInfoFunction)CFBundleGetFunctionPointerForName(handle, CFSTR("getLibInfo"));
-#else
-    dlerror();
-	infoFunction = (LibraryInfoFunction)(dlsym(handle, "getLibInfo"));
-#endif
+	LibraryInfoFunction infoFunction;
+	PluginInfoFunction piFunction;
 
-	if (!infoFunction)
+	if (!getLibraryFunctions(handle, infoFunction, piFunction))
 	{
-		ERROR_MSG("Failed to load function 'getLibInfo'");
 		closeHandle(handle);
 		return -1;
 	}
@@ -248,30 +469,15 @@ int PluginManager::loadPlugin(const String& pluginLoc) {
 		return -1;
 	}
 
-	PluginInfoFunction piFunction = 0;
-#ifdef WIN32
-	piFunction = (PluginInfoFunction)GetProcAddress(handle, "getPluginInfo");
-#elif defined(__APPLE__)
-    piFunction = (PluginInfoFunction)CFBundleGetFunctionPointerForName(handle, CFSTR("getPluginInfo"));
-#else
-    dlerror();
-	piFunction = (PluginInfoFunction)(dlsym(handle, "getPluginInfo"));
-#endif
-
-	if (!piFunction)
-	{
-        ERROR_MSG("Failed to load function 'getPluginInfo'");
-		closeHandle(handle);
-		return -1;
-	}
-
 	LoadedLibInfo lib;
 	lib.apiVersion = libInfo.apiVersion;
 	lib.name = libInfo.name;
 	lib.libVersion = libInfo.libVersion;
 	lib.numPlugins = libInfo.numPlugins;
 	lib.handle = handle;
+	lib.path = pluginLoc;
 
+	const ScopedLock lock(loadLock);
 	libArray.add(lib);
 
 	Plugin::PluginInfo pInfo;
@@ -321,7 +527,7 @@ int PluginManager::loadPlugin(const String& pluginLoc) {
 			info.creator = pInfo.fileSource.creator;
 			info.name = pInfo.fileSource.name;
 			info.extensions = pInfo.fileSource.extensions;
-			info.libIndex = libArray.size();
+			info.libIndex = libArray.size() - 1;
 			Plugin::FileSourceInfo fsi = getFileSourceInfo(String::fromUTF8(info.name));
 			if(fsi.name == nullptr)
 				fileSourcePlugins.add(info);
@@ -337,6 +543,230 @@ int PluginManager::loadPlugin(const String& pluginLoc) {
 	return lib.numPlugins;
 }
 
+bool PluginManager::isCacheEntryCurrent(const File& file, const XmlElement& entry)
+{
+	return entry.getStringAttribute("size") == String(file.getSize())
+		&& entry.getStringAttribute("modified") == String(file.getLastModificationTime().toMilliseconds());
+}
+
+const char* PluginManager::addCachedString(const String& text)
+{
+	cachedStrings.add(text);
+	return cachedStrings.getReference(cachedStrings.size() - 1).toRawUTF8();
+}
+
+bool PluginManager::addCachedLibrary(const File& file, const XmlElement& entry)
+{
+	LoadedLibInfo lib;
+	lib.apiVersion = PLUGIN_API_VER;
+	lib.name = addCachedString(entry.getStringAttribute("name"));
+	lib.libVersion = entry.getIntAttribute("version");
+	lib.numPlugins = entry.getIntAttribute("numPlugins");
+	lib.handle = 0;
+	lib.path = file.getFullPathName();
+
+	const ScopedLock lock(loadLock);
+	libArray.add(lib);
+
+	forEachXmlChildElement(entry, pluginEntry)
+	{
+		const String name = pluginEntry->getStringAttribute("name");
+
+		if (pluginEntry->hasTagName("PROCESSOR"))
+		{
+			LoadedPluginInfo<Plugin::ProcessorInfo> info;
+			info.creator = nullptr;
+			info.name = addCachedString(name);
+			info.type = (Plugin::ProcessorType) pluginEntry->getIntAttribute("type", Plugin::InvalidProcessor);
+			info.libIndex = libArray.size() - 1;
+			if (getProcessorInfo(name).name == nullptr)
+				processorPlugins.add(info);
+		}
+		else if (pluginEntry->hasTagName("DATATHREAD"))
+		{
+			LoadedPluginInfo<Plugin::DataThreadInfo> info;
+			info.creator = nullptr;
+			info.name = addCachedString(name);
+			info.libIndex = libArray.size() - 1;
+			if (getDataThreadInfo(name).name == nullptr)
+				dataThreadPlugins.add(info);
+		}
+	}
+
+	return true;
+}
+
+XmlElement* PluginManager::createCacheEntry(const File& file, int libIndex) const
+{
+	// record engines are created at startup anyway, and file sources are matched by extension
+	for (const auto& info : recordEnginePlugins)
+		if (info.libIndex == libIndex)
+			return nullptr;
+
+	for (const auto& info : fileSourcePlugins)
+		if (info.libIndex == libIndex)
+			return nullptr;
+
+	XmlElement* entry = new XmlElement("LIBRARY");
+	entry->setAttribute("path", file.getFullPathName());
+	entry->setAttribute("size", String(file.getSize()));
+	entry->setAttribute("modified", String(file.getLastModificationTime().toMilliseconds()));
+	entry->setAttribute("name", libArray[libIndex].name);
+	entry->setAttribute("version", libArray[libIndex].libVersion);
+	entry->setAttribute("numPlugins", libArray[libIndex].numPlugins);
+
+	for (const auto& info : processorPlugins)
+	{
+		if (info.libIndex == libIndex)
+		{
+			XmlElement* pluginEntry = entry->createNewChildElement("PROCESSOR");
+			pluginEntry->setAttribute("name", info.name);
+			pluginEntry->setAttribute("type", info.type);
+		}
+	}
+
+	for (const auto& info : dataThreadPlugins)
+	{
+		if (info.libIndex == libIndex)
+			entry->createNewChildElement("DATATHREAD")->setAttribute("name", info.name);
+	}
+
+	return entry;
+}
+
+bool PluginManager::loadLibrary(int libIndex)
+{
+	String path;
+	{
+		const ScopedLock lock(loadLock);
+		if (!isPositiveAndBelow(libIndex, libArray.size()))
+			return false;
+		if (libArray[libIndex].handle)
+			return true;
+		path = libArray[libIndex].path;
+	}
+
+	LOGD("Loading Plugin: ", File(path).getFileNameWithoutExtension(), "... ");
+
+	// the library is opened without the lock, so listing the plugins doesn't wait for it
+	auto handle = openLibrary(path);
+
+	LibraryInfoFunction infoFunction;
+	PluginInfoFunction piFunction;
+
+	if (!handle || !getLibraryFunctions(handle, infoFunction, piFunction))
+	{
+		closeHandle(handle);
+		return false;
+	}
+
+	Plugin::LibraryInfo libInfo;
+	infoFunction(&libInfo);
+
+	if (libInfo.apiVersion != PLUGIN_API_VER)
+	{
+		std::cerr << path << " invalid version" << std::endl;
+		closeHandle(handle);
+		return false;
+	}
+
+	const ScopedLock lock(loadLock);
+
+	// loaded on another thread meanwhile
+	if (libArray[libIndex].handle)
+	{
+		closeHandle(handle);
+		return true;
+	}
+
+	libArray.getReference(libIndex).handle = handle;
+
+	Plugin::PluginInfo pInfo;
+	for (int i = 0; i < libInfo.numPlugins; i++)
+	{
+		if (piFunction(i, &pInfo))
+			break;
+
+		if (pInfo.type == Plugin::PLUGIN_TYPE_PROCESSOR)
+		{
+			for (auto& info : processorPlugins)
+				if (info.libIndex == libIndex && String(info.name) == pInfo.processor.name)
+					info.creator = pInfo.processor.creator;
+		}
+		else if (pInfo.type == Plugin::PLUGIN_TYPE_DATA_THREAD)
+		{
+			for (auto& info : dataThreadPlugins)
+				if (info.libIndex == libIndex && String(info.name) == pInfo.dataThread.name)
+					info.creator = pInfo.dataThread.creator;
+		}
+	}
+
+	return true;
+}
+
+bool PluginManager::loadPluginLibrary(Plugin::PluginType type, int index)
+{
+	int libIndex = getLibraryIndexFromPlugin(type, index);
+
+	if (libIndex < 0 || !loadLibrary(libIndex))
+		return false;
+
+	switch (type)
+	{
+		case Plugin::PLUGIN_TYPE_PROCESSOR:
+			return getProcessorInfo(index).creator != nullptr;
+		case Plugin::PLUGIN_TYPE_DATA_THREAD:
+			return getDataThreadInfo(index).creator != nullptr;
+		default:
+			return true;
+	}
+}
+
+void PluginManager::prefetchLastSignalChain()
+{
+	ScopedPointer<XmlElement> lastConfig = XmlDocument::parse(CoreServices::getSavedStateDirectory().getChildFile("lastConfig.xml"));
+
+	if (lastConfig == nullptr)
+		return;
+
+	Array<int> libraries;
+
+	forEachXmlChildElementWithTagName(*lastConfig, signalChain, "SIGNALCHAIN")
+	{
+		forEachXmlChildElementWithTagName(*signalChain, processor, "PROCESSOR")
+		{
+			const String libName = processor->getStringAttribute("libraryName");
+			const int libVersion = processor->getIntAttribute("libraryVersion");
+
+			for (int i = 0; i < libArray.size(); i++)
+			{
+				if (!libArray[i].handle && libName.equalsIgnoreCase(libArray[i].name)
+					&& libVersion == libArray[i].libVersion)
+					libraries.addIfNotAlreadyThere(i);
+			}
+		}
+	}
+
+	if (libraries.size() > 0)
+	{
+		prefetchThread = new PrefetchThread(*this, libraries);
+		prefetchThread->startThread();
+	}
+}
+
+PluginManager::PrefetchThread::PrefetchThread(PluginManager& manager_, const Array<int>& libraries_)
+	: Thread("Plugin prefetch")
+	, manager(manager_)
+	, libraries(libraries_)
+{
+}
+
+void PluginManager::PrefetchThread::run()
+{
+	for (int i = 0; i < libraries.size() && !threadShouldExit(); i++)
+		manager.loadLibrary(libraries[i]);
+}
+
 int PluginManager::getNumProcessors() const
 {
 	return processorPlugins.size();
@@ -359,6 +789,7 @@ int PluginManager::getNumFileSources() const
 
 Plugin::ProcessorInfo PluginManager::getProcessorInfo(int index) const
 {
+	const ScopedLock lock(loadLock);
 	if (index < processorPlugins.size())
 		return processorPlugins[index];
 	else
@@ -367,6 +798,7 @@ Plugin::ProcessorInfo PluginManager::getProcessorInfo(int index) const
 
 Plugin::DataThreadInfo PluginManager::getDataThreadInfo(int index) const
 {
+	const ScopedLock lock(loadLock);
 	if (index < dataThreadPlugins.size())
 		return dataThreadPlugins[index];
 	else
@@ -486,6 +918,7 @@ Plugin::FileSourceInfo PluginManager::getEmptyFileSourceInfo()
 template<class T>
 bool PluginManager::findPlugin(String name, String libName, const Array<LoadedPluginInfo<T>>& pluginArray, T& pluginInfo) const
 {
+	const ScopedLock lock(loadLock);
 	for (int i = 0; i < pluginArray.size(); i++)
 	{
 		String pName = String(pluginArray[i].name);
@@ -46,6 +46,7 @@ struct LoadedLibInfo : public Plugin::LibraryInfo
 #else
 	void* handle;
 #endif
+	String path;
 };
 
 template<class T>
@@ -57,6 +58,16 @@ struct LoadedPluginInfo : public T
 
 class GenericProcessor;
 
+/**
+	Finds the plugin libraries and keeps the information of their plugins.
+
+	Loading every library at startup is slow, so the plugins of each library are kept in
+	a cache, keyed by the file's path, size and modification time. The processors and
+	data threads of a library found in the cache are listed without loading it: the
+	library is loaded when one of its plugins is first created (see loadPluginLibrary()),
+	or ahead of time on a background thread when the last saved signal chain uses it.
+	Libraries with record engines or file sources are always loaded at startup.
+*/
 class PluginManager {
 
 public:
@@ -65,6 +76,9 @@ public:
 	void loadAllPlugins();
     void loadPlugins(const File &pluginPath);
 	int loadPlugin(const String&);
+	/** Loads the library of a plugin, if it was listed from the cache, so its creator
+		can be called. Returns false if the library can't be loaded. */
+	bool loadPluginLibrary(Plugin::PluginType type, int index);
 	//void unloadPlugin(Plugin *);
 	void removeAllPlugins();
 	int getNumProcessors() const;
@@ -84,12 +98,44 @@ public:
 	int getLibraryIndexFromPlugin(Plugin::PluginType type, int index);
 
 private:
+	/** Loads the libraries used by the last signal chain */
+	class PrefetchThread : public Thread
+	{
+	public:
+		PrefetchThread(PluginManager& manager, const Array<int>& libraries);
+		void run() override;
+	private:
+		PluginManager& manager;
+		Array<int> libraries;
+	};
+
+	/** Keeps one build of each library: the variant for the best instruction set the CPU
+		supports (e.g. FilterNode.avx2.so), or else the baseline one */
+	static void selectSimdVariants(Array<File>& libraries);
+	/** Opens a library listed from the cache and sets the creators of its plugins */
+	bool loadLibrary(int libIndex);
+	/** Lists the plugins of a library from its cache entry, without loading it */
+	bool addCachedLibrary(const File& file, const XmlElement& entry);
+	/** The cache entry of a loaded library, or nullptr if it can't be loaded lazily */
+	XmlElement* createCacheEntry(const File& file, int libIndex) const;
+	static bool isCacheEntryCurrent(const File& file, const XmlElement& entry);
+	/** Keeps the text of the cached names, which the info structures point to */
+	const char* addCachedString(const String& text);
+	void prefetchLastSignalChain();
+
 	Array<LoadedLibInfo> libArray;
 	Array<LoadedPluginInfo<Plugin::ProcessorInfo>> processorPlugins;
 	Array<LoadedPluginInfo<Plugin::DataThreadInfo>> dataThreadPlugins;
 	Array<LoadedPluginInfo<Plugin::RecordEngineInfo>> recordEnginePlugins;
 	Array<LoadedPluginInfo<Plugin::FileSourceInfo>> fileSourcePlugins;
 
+	StringArray cachedStrings;
+	ScopedPointer<XmlElement> pluginCache;
+	ScopedPointer<XmlElement> newPluginCache;
+	ScopedPointer<PrefetchThread> prefetchThread;
+	/** Held while a library is loaded, as the background thread sets creators */
+	mutable CriticalSection loadLock;
+
 	template<class T>
 	bool findPlugin(String name, String libName, const Array<LoadedPluginInfo<T>>& pluginArray, T& pluginInfo) const;
 
@@ -66,7 +66,10 @@ LOGDD("Creating editor.");
 void PROCESSORCLASSNAME::setParameter (int parameterIndex, float newValue)
 {
     GenericProcessor::setParameter (parameterIndex, newValue);
-    editor->updateParameterButtons (parameterIndex);
+
+    // queued changes are applied on the processing thread, where the editor can't be touched
+    if (! isApplyingParameterChanges())
+        editor->updateParameterButtons (parameterIndex);
 
     //Parameter& p =  parameters.getReference(parameterIndex);
     //p.setValue(newValue, 0);
@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "LoadShedder.h"
+
+#include <atomic>
+
+namespace
+{
+    std::atomic<int> level (LoadShedder::NONE);
+    std::atomic<float> load (0.0f);
+    std::atomic<int64> blockCount (0);
+    std::atomic<int64> shedBlocks (0);
+
+    // only touched by the audio thread
+    int64 levelChangeBlock = 0;
+    int numOverruns = 0;
+}
+
+void LoadShedder::reset()
+{
+    level.store (NONE);
+    load.store (0.0f);
+    blockCount.store (0);
+    shedBlocks.store (0);
+    levelChangeBlock = 0;
+    numOverruns = 0;
+}
+
+void LoadShedder::addGraphBlock (int64 processTicks, int numSamples, double sampleRate)
+{
+    if (numSamples <= 0 || sampleRate <= 0)
+        return;
+
+    const float blockLoad = (float) (Time::highResolutionTicksToSeconds (processTicks) * sampleRate / numSamples);
+    const float smoothed = load.load (std::memory_order_relaxed) * (1.0f - LOAD_SHED_SMOOTHING)
+        + blockLoad * LOAD_SHED_SMOOTHING;
+    load.store (smoothed, std::memory_order_relaxed);
+
+    const int64 block = blockCount.load (std::memory_order_relaxed) + 1;
+    const int current = level.load (std::memory_order_relaxed);
+    int next = current;
+
+    numOverruns = blockLoad >= 1.0f ? numOverruns + 1 : 0;
+
+    if (numOverruns >= LOAD_SHED_OVERRUN_BLOCKS || smoothed >= LOAD_SHED_SKIP_LOAD)
+        next = SKIP;
+    else if (smoothed >= LOAD_SHED_DECIMATE_LOAD)
+        next = jmax (current, (int) DECIMATE);
+    else if (block - levelChangeBlock >= LOAD_SHED_HOLD_BLOCKS)
+    {
+        // one step down at a time, once the load is clear of the level's threshold
+        if (current == SKIP && smoothed < LOAD_SHED_SKIP_LOAD - LOAD_SHED_HYSTERESIS)
+            next = DECIMATE;
+        else if (current == DECIMATE && smoothed < LOAD_SHED_DECIMATE_LOAD - LOAD_SHED_HYSTERESIS)
+            next = NONE;
+    }
+
+    if (next != current)
+    {
+        levelChangeBlock = block;
+        level.store (next, std::memory_order_relaxed);
+    }
+
+    if (next != NONE)
+        shedBlocks.store (shedBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    blockCount.store (block, std::memory_order_relaxed);
+}
+
+bool LoadShedder::shouldShedBlock()
+{
+    switch (level.load (std::memory_order_relaxed))
+    {
+        case SKIP:
+            return true;
+        case DECIMATE:
+            return (blockCount.load (std::memory_order_relaxed) & 1) != 0;
+        default:
+            return false;
+    }
+}
+
+LoadShedder::Level LoadShedder::getLevel()
+{
+    return (Level) level.load (std::memory_order_relaxed);
+}
+
+float LoadShedder::getLoad()
+{
+    return load.load (std::memory_order_relaxed);
+}
+
+int64 LoadShedder::getNumShedBlocks()
+{
+    return shedBlocks.load (std::memory_order_relaxed);
+}
+
+String LoadShedder::getLevelName (Level shedLevel)
+{
+    switch (shedLevel)
+    {
+        case DECIMATE:
+            return "decimating displays";
+        case SKIP:
+            return "skipping displays";
+        default:
+            return "none";
+    }
+}
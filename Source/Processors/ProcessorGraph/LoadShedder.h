@@ -0,0 +1,91 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef LOADSHEDDER_H_INCLUDED
+#define LOADSHEDDER_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+
+/* Smoothed share of the block duration spent in the graph at which sheddable processors
+   run every other block, and at which they stop running */
+#define LOAD_SHED_DECIMATE_LOAD 0.7f
+#define LOAD_SHED_SKIP_LOAD 0.9f
+/* How far below its threshold the load has to fall to leave a level */
+#define LOAD_SHED_HYSTERESIS 0.1f
+/* Consecutive blocks overrunning their duration that go straight to SKIP, so one late
+   block, e.g. from a scheduler hiccup, doesn't blank the displays */
+#define LOAD_SHED_OVERRUN_BLOCKS 4
+/* Blocks a level is held at least, so the load saved by shedding doesn't end it at once */
+#define LOAD_SHED_HOLD_BLOCKS 256
+/* Weight of each block in the smoothed load */
+#define LOAD_SHED_SMOOTHING 0.05f
+
+/**
+    Decides when the processors that only display data give up their work so that
+    the rest of the graph keeps within the duration of its blocks.
+
+    The ProcessorGraph reports the time each block took; the load, smoothed over
+    the last blocks, raises the level from NONE to DECIMATE, where sheddable
+    processors run every other block, and to SKIP, where they don't run at all.
+    LOAD_SHED_OVERRUN_BLOCKS blocks in a row that overrun their duration go straight
+    to SKIP. A level is held for LOAD_SHED_HOLD_BLOCKS blocks and left one step at a
+    time, once the load falls below its threshold by LOAD_SHED_HYSTERESIS.
+
+    Only the processors that return true from GenericProcessor::isSheddable() are
+    affected: sources, filters and Record Nodes always process every block.
+
+    @see ProcessorGraph, GenericProcessor::isSheddable
+*/
+class PLUGIN_API LoadShedder
+{
+public:
+    enum Level
+    {
+        NONE = 0,
+        DECIMATE,
+        SKIP
+    };
+
+    /** Forgets the load of the previous acquisition */
+    static void reset();
+
+    /** Called by the audio thread after each graph block, with the time it took */
+    static void addGraphBlock (int64 processTicks, int numSamples, double sampleRate);
+
+    /** True if sheddable processors skip the current block */
+    static bool shouldShedBlock();
+
+    static Level getLevel();
+
+    /** Smoothed share of the block duration spent in the graph */
+    static float getLoad();
+
+    /** Graph blocks processed while sheddable processors were shedding, since the last reset */
+    static int64 getNumShedBlocks();
+
+    static String getLevelName (Level level);
+};
+
+#endif  // LOADSHEDDER_H_INCLUDED
@@ -40,8 +40,13 @@
 #include "../../UI/GraphViewer.h"
 
 #include "../ProcessorManager/ProcessorManager.h"
+#include "../../Utils/MessageThreadMonitor.h"
+#include "../../Utils/AllocationCounter.h"
+#include "../../Utils/PipelineTrace.h"
+#include "../../Utils/ThreadConfig.h"
+#include "LoadShedder.h"
 
-ProcessorGraph::ProcessorGraph() : currentNodeId(100), isLoadingSignalChain(false)
+ProcessorGraph::ProcessorGraph() : currentNodeId(100), isLoadingSignalChain(false), parallelRendering(false)
 {
 
     // The ProcessorGraph will always have 0 inputs (all content is generated within graph)
@@ -194,7 +199,10 @@ GenericProcessor* ProcessorGraph::createProcessor(ProcessorDescription& descript
 
          // identifier within processor graph
         processor->setNodeId(id);
-        addNode(processor, id); // have to add it so it can be deleted by the graph
+        Node* node = addNode(processor, id); // have to add it so it can be deleted by the graph
+
+        if (processor->isReadOnly())
+            node->properties.set(readOnlyInputProperty, true);
         GenericEditor* editor = (GenericEditor*) processor->createEditor();
 
         editor->refreshColors();
@@ -284,7 +292,7 @@ GenericProcessor* ProcessorGraph::createProcessor(ProcessorDescription& descript
         return nullptr;
 	}
     
-    if (!signalChainIsLoading)
+    if (!signalChainIsLoading && !isLoadingSignalChain)
     {
         updateSettings(processor);
     } else {
@@ -464,6 +472,9 @@ void ProcessorGraph::updateSettings(GenericProcessor* processor, bool signalChai
         //updateViews(processor);
         return;
     }
+
+    MessageThreadMonitor::ScopedTask task("Signal chain update from "
+        + (processor != nullptr ? processor->getName() : String("the start")));
         
     GenericProcessor* processorToUpdate = processor;
     
@@ -473,6 +484,8 @@ void ProcessorGraph::updateSettings(GenericProcessor* processor, bool signalChai
     {
         if (processor != nullptr)
         {
+            int64 previousSignature = processor->getOutputSignature();
+
             processor->update();
             
             if (signalChainIsLoading)
@@ -499,8 +512,14 @@ void ProcessorGraph::updateSettings(GenericProcessor* processor, bool signalChai
                     processor->setEnabledState(false);
             }
                 
-                
-            if (processor->isSplitter())
+            // downstream processors only depend on the outputs of this one, so stop here if those
+            // didn't change (when loading, every processor needs to read its settings)
+            if (!signalChainIsLoading && processor->getOutputSignature() == previousSignature)
+            {
+                LOGDD(processor->getName(), " outputs unchanged, skipping downstream updates.");
+                processor = nullptr;
+            }
+            else if (processor->isSplitter())
             {
                 splitters.add((Splitter*) processor);
                 processor = splitters.getLast()->getDestNode(0); // travel down chain 0 first
@@ -521,7 +540,9 @@ void ProcessorGraph::updateSettings(GenericProcessor* processor, bool signalChai
 
 void ProcessorGraph::updateViews(GenericProcessor* processor)
 {
-    AccessClass::getGraphViewer()->updateNodes(rootNodes);
+    // the graph is drawn once, when the whole signal chain has been loaded
+    if (!isLoadingSignalChain)
+        AccessClass::getGraphViewer()->updateNodes(rootNodes);
     
     int tabIndex;
     
@@ -722,6 +743,12 @@ LOGD("Channel:", currentChannel, "Parameter:", parameterNameForXML, "Intended Va
 }*/
 
 
+void ProcessorGraph::prepareToLoadSignalChain()
+{
+    isLoadingSignalChain = true;
+}
+
+
 void ProcessorGraph::restoreParameters()
 {
     
@@ -739,9 +766,10 @@ void ProcessorGraph::restoreParameters()
         }
     }
     
-    // load source node parameters
+    // load source node parameters (their settings weren't updated when they were created)
     for (auto p : rootNodes)
     {
+        p->update();
         p->loadFromXml();
         
     }
@@ -815,6 +843,7 @@ GenericProcessor* ProcessorGraph::getProcessorWithNodeId(int nodeId)
 
 void ProcessorGraph::clearConnections()
 {
+    pendingConnections.clearQuick();
 
     for (int i = 0; i < getNumNodes(); i++)
     {
@@ -823,33 +852,64 @@ void ProcessorGraph::clearConnections()
 
         if (nodeId != OUTPUT_NODE_ID)
         {
-
-            if (nodeId != RECORD_NODE_ID && nodeId != AUDIO_NODE_ID)
-            {
-                disconnectNode(node->nodeId);
-            }
-
             GenericProcessor* p = (GenericProcessor*) node->getProcessor();
             p->resetConnections();
-
         }
     }
 
+    // keep the connections between the special nodes that aren't rebuilt below
+    for (int i = 0; i < getNumConnections(); i++)
+    {
+        const Connection* c = getConnection(i);
+
+        if ((c->sourceNodeId == RECORD_NODE_ID || c->sourceNodeId == AUDIO_NODE_ID || c->sourceNodeId == OUTPUT_NODE_ID)
+            && (c->destNodeId == RECORD_NODE_ID || c->destNodeId == AUDIO_NODE_ID || c->destNodeId == OUTPUT_NODE_ID))
+            pendingConnections.add(*c);
+    }
+
     // connect audio subnetwork
     for (int n = 0; n < 2; n++)
     {
 
-        addConnection(AUDIO_NODE_ID, n,
+        addPendingConnection(AUDIO_NODE_ID, n,
                       OUTPUT_NODE_ID, n);
 
     }
 
     for (auto& recordNode : getRecordNodes())
-        addConnection(MESSAGE_CENTER_ID, midiChannelIndex,
+        addPendingConnection(MESSAGE_CENTER_ID, midiChannelIndex,
                   recordNode->getNodeId(), midiChannelIndex);
 
 }
 
+void ProcessorGraph::addPendingConnection(uint32 sourceNodeId, int sourceChannelIndex,
+    uint32 destNodeId, int destChannelIndex)
+{
+    pendingConnections.add(Connection(sourceNodeId, sourceChannelIndex, destNodeId, destChannelIndex));
+}
+
+
+void ProcessorGraph::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    TRACE_SCOPE("graph", "graph block");
+
+    // spikes stored during the previous block have all been consumed
+    SpikeStore::getInstance()->startBlock();
+
+    // the device may hand the callback to a new thread at any time
+    AllocationCounter::setThreadCounted(true);
+    ThreadConfig::applyToCurrentThread(ThreadConfig::AUDIO);
+
+    // the timestamp source finished its previous block, so its clock can be read without racing it
+    publishTimestampClock();
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    AudioProcessorGraph::processBlock(buffer, midiMessages);
+
+    // sheddable processors give up their work in the next blocks if this one came close to its deadline
+    LoadShedder::addGraphBlock(Time::getHighResolutionTicks() - startTicks, buffer.getNumSamples(), getSampleRate());
+}
 
 void ProcessorGraph::updateConnections()
 {
@@ -1010,11 +1070,18 @@ void ProcessorGraph::updateConnections()
         }
     }
 
+    // only the connections that differ from the current ones are changed, and the
+    // rendering sequence is left alone if none do
+    if (!setConnections(pendingConnections))
+        LOGDD("Connections unchanged.");
+
     //OwnedArray<EventChannel> extraChannels;
     getMessageCenter()->addSpecialProcessorChannels();
 	
 	getAudioNode()->updatePlaybackBuffer();
 
+    updateRenderThreads();
+
     /*
     for (auto& recordNode : getRecordNodes())
         recordNode->addSpecialProcessorChannels(extraChannels);
@@ -1022,6 +1089,40 @@ void ProcessorGraph::updateConnections()
 
 } // end method
 
+
+void ProcessorGraph::setParallelRendering(bool enabled)
+{
+    parallelRendering = enabled;
+    updateRenderThreads();
+}
+
+
+bool ProcessorGraph::isParallelRendering() const
+{
+    return parallelRendering;
+}
+
+
+void ProcessorGraph::updateRenderThreads()
+{
+    if (!parallelRendering)
+    {
+        setNumRenderThreads (0);
+        return;
+    }
+
+    // the branches of each splitter, and separate signal chains, don't depend on each other,
+    // so they can be rendered on extra threads
+    int numBranches = rootNodes.size();
+    for (auto processor : getListOfProcessors())
+    {
+        if (processor->isSplitter())
+            numBranches++;
+    }
+
+    setNumRenderThreads (jlimit (0, SystemStats::getNumCpus() - 1, numBranches - 1));
+}
+
 void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcessor* dest,
     bool connectContinuous, bool connectEvents)
 {
@@ -1039,7 +1140,7 @@ void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcesso
         {
             LOGDD(chan, " ");
 
-            addConnection(source->getNodeId(),         // sourceNodeID
+            addPendingConnection(source->getNodeId(),         // sourceNodeID
                           chan,                        // sourceNodeChannelIndex
                           dest->getNodeId(),           // destNodeID
                           dest->getNextChannel(true)); // destNodeChannelIndex
@@ -1049,7 +1150,7 @@ void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcesso
     // 2. connect event channel
     if (connectEvents)
     {
-        addConnection(source->getNodeId(),    // sourceNodeID
+        addPendingConnection(source->getNodeId(),    // sourceNodeID
                       midiChannelIndex,       // sourceNodeChannelIndex
                       dest->getNodeId(),      // destNodeID
                       midiChannelIndex);      // destNodeChannelIndex
@@ -1081,7 +1182,7 @@ LOGD("#########SKIPPING CONNECT TO RECORD NODE");
 
         getAudioNode()->addInputChannel(source, chan);
 
-        addConnection(source->getNodeId(),                   // sourceNodeID
+        addPendingConnection(source->getNodeId(),                   // sourceNodeID
                       chan,                                  // sourceNodeChannelIndex
                       AUDIO_NODE_ID,                         // destNodeID
                       getAudioNode()->getNextChannel(true)); // destNodeChannelIndex
@@ -1107,7 +1208,7 @@ LOGD("#########SKIPPING CONNECT TO RECORD NODE");
     */
 
     // connect event channel
-    addConnection(source->getNodeId(),    // sourceNodeID
+    addPendingConnection(source->getNodeId(),    // sourceNodeID
                   midiChannelIndex,       // sourceNodeChannelIndex
                   AUDIO_NODE_ID,          // destNodeID
                   midiChannelIndex);      // destNodeChannelIndex
@@ -1122,7 +1223,7 @@ void ProcessorGraph::connectProcessorToMessageCenter(GenericProcessor* source)
 {
 
     // connect event channel
-    addConnection(getMessageCenter()->getNodeId(),    // sourceNodeID
+    addPendingConnection(getMessageCenter()->getNodeId(),    // sourceNodeID
                   midiChannelIndex,       // sourceNodeChannelIndex
                   source->getNodeId(),          // destNodeID
                   midiChannelIndex);      // destNodeChannelIndex
@@ -1359,6 +1460,29 @@ bool ProcessorGraph::enableProcessors()
         }
     }
 
+    // the spike channels each processor creates are its electrodes in the SpikeWaveformStore
+    Array<const SpikeChannel*> electrodes;
+    for (int i = 0; i < getNumNodes(); i++)
+    {
+        Node* node = getNode(i);
+
+        if (node->nodeId != OUTPUT_NODE_ID)
+        {
+            GenericProcessor* p = (GenericProcessor*) node->getProcessor();
+            for (int s = 0; s < p->getTotalSpikeChannels(); s++)
+            {
+                const SpikeChannel* channel = p->getSpikeChannel(s);
+                if (channel->getSourceNodeID() == p->getNodeId())
+                    electrodes.add(channel);
+            }
+        }
+    }
+    SpikeWaveformStore::getInstance()->setElectrodes(electrodes);
+
+    ChannelWorkerPool::getInstance()->start();
+    SpikeStore::getInstance()->start();
+    LoadShedder::reset();
+
 	//Update special channels indexes, at the end
 	//To change, as many other things, when the probe system is implemented
     for (auto& node : getRecordNodes())
@@ -1369,6 +1493,7 @@ bool ProcessorGraph::enableProcessors()
 
     //	sendActionMessage("Acquisition started.");
 	m_startSoftTimestamp = Time::getHighResolutionTicks();
+	publishTimestampClock();
 	if (m_timestampWindow)
 		m_timestampWindow->setAcquisitionState(true);
     return true;
@@ -1379,6 +1504,9 @@ bool ProcessorGraph::disableProcessors()
 
     LOGD("Disabling processors...");
 
+    ChannelWorkerPool::getInstance()->stop();
+    SpikeStore::getInstance()->stop();
+
     bool allClear;
 
     for (int i = 0; i < getNumNodes(); i++)
@@ -1400,6 +1528,18 @@ bool ProcessorGraph::disableProcessors()
         }
     }
 
+    if (CoreServices::getLatencyBenchmark())
+    {
+        std::cout << "Process time of the last blocks:" << std::endl;
+
+        for (auto processor : getListOfProcessors())
+        {
+            ProcessTimeProfile::Stats stats = processor->getProcessTimeProfile().getStats();
+            std::cout << "  " << processor->getName() << " (" << processor->getNodeId() << "): mean "
+                      << stats.meanUs << " us, p99 " << stats.p99Us << " us, max " << stats.maxUs << " us" << std::endl;
+        }
+    }
+
     //AccessClass::getEditorViewport()->signalChainCanBeEdited(true);
 	if (m_timestampWindow)
 		m_timestampWindow->setAcquisitionState(false);
@@ -1471,6 +1611,7 @@ void ProcessorGraph::setTimestampSource(int sourceIndex, int subIdx)
 	{
 		m_timestampSourceSubIdx = 0;
 	}
+	publishTimestampClock();
 }
 
 void ProcessorGraph::getTimestampSources(Array<const GenericProcessor*>& validSources, int& selectedSource, int& selectedSubId) const
@@ -1496,9 +1637,49 @@ int64 ProcessorGraph::getGlobalTimestamp(bool softwareOnly) const
 	}
 	else
 	{
-		return static_cast<int64>((Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - m_timestampSource->getLastProcessedsoftwareTime())
-			* m_timestampSource->getSampleRate(m_timestampSourceSubIdx)) + m_timestampSource->getSourceTimestamp(m_timestampSource->getNodeId(), m_timestampSourceSubIdx));
+		return getGlobalTimestampClock().getTimestamp();
+	}
+}
+
+void ProcessorGraph::publishTimestampClock()
+{
+	int64 timestamp = 0;
+	int64 ticks = m_startSoftTimestamp;
+	double samplesPerTick = 1.0;
+
+	if (m_timestampSource)
+	{
+		timestamp = m_timestampSource->getSourceTimestamp(m_timestampSource->getNodeId(), m_timestampSourceSubIdx);
+		ticks = m_timestampSource->getLastProcessedsoftwareTime();
+		samplesPerTick = m_timestampSource->getSampleRate(m_timestampSourceSubIdx) / double(Time::getHighResolutionTicksPerSecond());
 	}
+
+	uint32 seq = m_clockSequence.load(std::memory_order_relaxed);
+	m_clockSequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	m_clockTimestamp.store(timestamp, std::memory_order_relaxed);
+	m_clockTicks.store(ticks, std::memory_order_relaxed);
+	m_clockSamplesPerTick.store(samplesPerTick, std::memory_order_relaxed);
+
+	m_clockSequence.store(seq + 2, std::memory_order_release);
+}
+
+CoreServices::GlobalTimestampClock ProcessorGraph::getGlobalTimestampClock() const
+{
+	CoreServices::GlobalTimestampClock clock;
+	uint32 before, after;
+	do
+	{
+		before = m_clockSequence.load(std::memory_order_acquire);
+		clock.timestamp = m_clockTimestamp.load(std::memory_order_relaxed);
+		clock.ticks = m_clockTicks.load(std::memory_order_relaxed);
+		clock.samplesPerTick = m_clockSamplesPerTick.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = m_clockSequence.load(std::memory_order_relaxed);
+	} while ((before & 1) != 0 || before != after);
+
+	return clock;
 }
 
 float ProcessorGraph::getGlobalSampleRate(bool softwareOnly) const
@@ -27,6 +27,9 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 
 #include "../../AccessClass.h"
+#include "../../CoreServices.h"
+
+#include <atomic>
 
 class GenericProcessor;
 class GenericEditor;
@@ -108,10 +111,17 @@ public:
 
     void updateConnections();
 
+    /** Empties the SpikeStore before processing the block */
+    void processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages) override;
+
     bool processorWithSameNameExists(const String& name);
 
     void changeListenerCallback(ChangeBroadcaster* source);
 
+    /** Defers the settings updates of new processors, and of calls from within processors,
+        until restoreParameters() updates the whole signal chain in a single pass */
+    void prepareToLoadSignalChain();
+
     /** Loops through processors and restores parameters, if they're available. */
     void restoreParameters();
     
@@ -133,6 +143,9 @@ public:
 
 	int64 getGlobalTimestamp(bool softwareOnly) const;
 
+	/** The global clock as published at the start of the last block */
+	CoreServices::GlobalTimestampClock getGlobalTimestampClock() const;
+
 	float getGlobalSampleRate(bool softwareOnly) const;
 
 	uint32 getGlobalTimestampSourceFullId() const;
@@ -141,10 +154,20 @@ public:
     
     void viewSignalChain(int index);
 
+    /** Renders the branches of splitters, and separate signal chains, on extra threads.
+        Off by default, and only changed while acquisition is stopped */
+    void setParallelRendering(bool enabled);
+    bool isParallelRendering() const;
+
 private:
     int currentNodeId;
     
     bool isLoadingSignalChain;
+
+    bool parallelRendering;
+
+    /** Gives the graph a render thread per independent branch, if parallel rendering is on */
+    void updateRenderThreads();
     
 
 
@@ -156,8 +179,13 @@ private:
         MESSAGE_CENTER_ID = 904
     };
 
+    /** Starts collecting the connections of the signal chain, which updateConnections()
+        then applies in one go, changing only the connections that differ */
     void clearConnections();
 
+    void addPendingConnection(uint32 sourceNodeId, int sourceChannelIndex,
+        uint32 destNodeId, int destChannelIndex);
+
     void connectProcessors(GenericProcessor* source, GenericProcessor* dest,
         bool connectContinuous, bool connectEvents);
     void connectProcessorToAudioNode(GenericProcessor* source);
@@ -166,11 +194,22 @@ private:
 	int64 m_startSoftTimestamp{ 0 };
 	const GenericProcessor* m_timestampSource{ nullptr };
 	int m_timestampSourceSubIdx;
+
+	/** Takes the global clock from the timestamp source, once per block instead of once per call */
+	void publishTimestampClock();
+
+	/* Published clock. Odd sequence numbers mean an update is in progress */
+	std::atomic<uint32> m_clockSequence{ 0 };
+	std::atomic<int64> m_clockTimestamp{ 0 };
+	std::atomic<int64> m_clockTicks{ 0 };
+	std::atomic<double> m_clockSamplesPerTick{ 1.0 };
 	Array<const GenericProcessor*> m_validTimestampSources;
 	WeakReference<TimestampSourceSelectionWindow> m_timestampWindow;
     
     Array<GenericProcessor*> rootNodes;
 
+    Array<Connection> pendingConnections;
+
 };
 
 
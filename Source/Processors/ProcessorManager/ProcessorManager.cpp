@@ -156,6 +156,8 @@ namespace ProcessorManager
 			break;
 		case PluginProcessor:
 			{
+				if (!AccessClass::getPluginManager()->loadPluginLibrary(Plugin::PLUGIN_TYPE_PROCESSOR, index))
+					return nullptr;
 				Plugin::ProcessorInfo info = AccessClass::getPluginManager()->getProcessorInfo(index);
 				GenericProcessor* proc = info.creator();
 				proc->setPluginData(Plugin::PLUGIN_TYPE_PROCESSOR, index);
@@ -164,6 +166,8 @@ namespace ProcessorManager
 			}
 		case DataThreadProcessor:
 		{
+			if (!AccessClass::getPluginManager()->loadPluginLibrary(Plugin::PLUGIN_TYPE_DATA_THREAD, index))
+				return nullptr;
 			Plugin::DataThreadInfo info = AccessClass::getPluginManager()->getDataThreadInfo(index);
 			GenericProcessor* proc = new SourceNode(info.name, info.creator);
 			proc->setPluginData(Plugin::PLUGIN_TYPE_DATA_THREAD, index);
@@ -194,8 +198,10 @@ namespace ProcessorManager
 					if (procName.equalsIgnoreCase(info.name))
 					{
 						int libIndex = pm->getLibraryIndexFromPlugin(Plugin::PLUGIN_TYPE_PROCESSOR, i);
-						if (libName.equalsIgnoreCase(pm->getLibraryName(libIndex)) && libVersion == pm->getLibraryVersion(libIndex))
+						if (libName.equalsIgnoreCase(pm->getLibraryName(libIndex)) && libVersion == pm->getLibraryVersion(libIndex)
+							&& pm->loadPluginLibrary(Plugin::PLUGIN_TYPE_PROCESSOR, i))
 						{
+							info = pm->getProcessorInfo(i);
 							proc = info.creator();
 							proc->setPluginData(Plugin::PLUGIN_TYPE_PROCESSOR, i);
 							return proc;
@@ -211,8 +217,10 @@ namespace ProcessorManager
 					if (procName.equalsIgnoreCase(info.name))
 					{
 						int libIndex = pm->getLibraryIndexFromPlugin(Plugin::PLUGIN_TYPE_DATA_THREAD, i);
-						if (libName.equalsIgnoreCase(pm->getLibraryName(libIndex)) && libVersion == pm->getLibraryVersion(libIndex))
+						if (libName.equalsIgnoreCase(pm->getLibraryName(libIndex)) && libVersion == pm->getLibraryVersion(libIndex)
+							&& pm->loadPluginLibrary(Plugin::PLUGIN_TYPE_DATA_THREAD, i))
 						{
+							info = pm->getDataThreadInfo(i);
 							proc = new SourceNode(info.name, info.creator);
 							proc->setPluginData(Plugin::PLUGIN_TYPE_DATA_THREAD, i);
 							return proc;
@@ -0,0 +1,362 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AsyncBlockWriter.h"
+#include "../../../Utils/Utils.h"
+
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+BlockOutputFile::BlockOutputFile() :
+#if JUCE_LINUX
+m_fd(-1),
+#endif
+m_direct(false),
+m_mapStart(0),
+m_position(0),
+m_allocated(0),
+m_written(0)
+{
+}
+
+BlockOutputFile::~BlockOutputFile()
+{
+	if (isMapped())
+		closeMapped();
+
+#if JUCE_LINUX
+	if (m_fd >= 0)
+		::close(m_fd);
+#endif
+}
+
+bool BlockOutputFile::open(const File& file, OutputMode mode)
+{
+	/* Blocks are appended to an existing file, except with direct I/O, which truncates it */
+	m_written = file.getSize();
+
+	if (mode == MAPPED)
+	{
+		if (openMapped(file))
+			return true;
+		LOGD("Memory-mapped output not available for ", file.getFullPathName(), ", using buffered writes");
+	}
+
+#if JUCE_LINUX
+	if (mode == DIRECT)
+	{
+		m_fd = ::open(file.getFullPathName().toRawUTF8(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		if (m_fd >= 0)
+		{
+			m_direct = true;
+			m_written = 0;
+			return true;
+		}
+		LOGD("Direct I/O not available for ", file.getFullPathName(), ", using buffered writes");
+	}
+#endif
+	m_stream = file.createOutputStream(0);
+	return m_stream != nullptr;
+}
+
+bool BlockOutputFile::openIndex(const File& indexFile)
+{
+	if (indexFile.existsAsFile())
+		indexFile.deleteFile();
+
+	// every entry must reach the OS as soon as its block has, so the stream is unbuffered
+	m_index = indexFile.createOutputStream(0);
+	return m_index != nullptr;
+}
+
+bool BlockOutputFile::write(const void* data, size_t numBytes)
+{
+	if (!writeBlock(data, numBytes))
+		return false;
+
+	if (m_index != nullptr)
+	{
+		BlockIndexEntry entry;
+		entry.offset = m_written;
+		entry.numBytes = numBytes;
+		m_index->write(&entry, sizeof(BlockIndexEntry));
+	}
+
+	m_written += numBytes;
+	return true;
+}
+
+bool BlockOutputFile::writeBlock(const void* data, size_t numBytes)
+{
+	if (isMapped())
+		return writeMapped(data, numBytes);
+
+#if JUCE_LINUX
+	if (m_fd >= 0)
+	{
+		if (m_direct && ((numBytes % BLOCK_IO_ALIGNMENT) != 0 || ((pointer_sized_uint)data % BLOCK_IO_ALIGNMENT) != 0))
+		{
+			//Unaligned writes are not allowed with O_DIRECT
+			int flags = fcntl(m_fd, F_GETFL);
+			fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+			m_direct = false;
+		}
+
+		const char* ptr = static_cast<const char*>(data);
+		while (numBytes > 0)
+		{
+			ssize_t written = ::write(m_fd, ptr, numBytes);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				LOGD("Error writing data block: ", strerror(errno));
+				return false;
+			}
+			ptr += written;
+			numBytes -= written;
+		}
+		return true;
+	}
+#endif
+	if (m_stream == nullptr)
+		return false;
+	return m_stream->write(data, numBytes);
+}
+
+bool BlockOutputFile::isOpen() const
+{
+	if (isMapped())
+		return true;
+
+#if JUCE_LINUX
+	if (m_fd >= 0)
+		return true;
+#endif
+	return m_stream != nullptr;
+}
+
+bool BlockOutputFile::isDirect() const
+{
+	return m_direct;
+}
+
+bool BlockOutputFile::isMapped() const
+{
+	return m_mappedFile != File::nonexistent;
+}
+
+bool BlockOutputFile::openMapped(const File& file)
+{
+	if (!file.existsAsFile() && file.create().failed())
+		return false;
+
+#if JUCE_LINUX
+	m_fd = ::open(file.getFullPathName().toRawUTF8(), O_RDWR);
+	if (m_fd < 0)
+		return false;
+#else
+	m_stream = file.createOutputStream(0);
+	if (m_stream == nullptr)
+		return false;
+#endif
+
+	/* Blocks are appended, as with the buffered output */
+	m_position = file.getSize();
+	m_allocated = m_position;
+	m_mappedFile = file;
+
+	if (!mapWindow(m_position))
+	{
+		closeMapped();
+		return false;
+	}
+	return true;
+}
+
+bool BlockOutputFile::preallocate(int64 size)
+{
+	if (size <= m_allocated)
+		return true;
+
+	/* Grow in whole extents, so the file system can lay them out contiguously */
+	int64 newSize = ((size + BLOCK_PREALLOC_EXTENT - 1) / BLOCK_PREALLOC_EXTENT) * BLOCK_PREALLOC_EXTENT;
+
+#if JUCE_LINUX
+	int res = posix_fallocate(m_fd, m_allocated, newSize - m_allocated);
+	if (res != 0)
+	{
+		LOGD("Error preallocating ", m_mappedFile.getFullPathName(), ": ", strerror(res));
+		return false;
+	}
+#else
+	if (!m_stream->setPosition(newSize - 1) || !m_stream->writeByte(0))
+		return false;
+	m_stream->flush();
+#endif
+
+	m_allocated = newSize;
+	return true;
+}
+
+bool BlockOutputFile::mapWindow(int64 position)
+{
+	int64 windowStart = (position / BLOCK_MAP_WINDOW_SIZE) * BLOCK_MAP_WINDOW_SIZE;
+
+	m_map = nullptr;
+	if (!preallocate(windowStart + BLOCK_MAP_WINDOW_SIZE))
+		return false;
+
+	m_map = new MemoryMappedFile(m_mappedFile, Range<int64>(windowStart, windowStart + BLOCK_MAP_WINDOW_SIZE), MemoryMappedFile::readWrite);
+	if (m_map->getData() == nullptr || m_map->getRange().getStart() != windowStart)
+	{
+		LOGD("Unable to map ", m_mappedFile.getFullPathName(), " at ", windowStart);
+		m_map = nullptr;
+		return false;
+	}
+
+	m_mapStart = windowStart;
+	return true;
+}
+
+bool BlockOutputFile::writeMapped(const void* data, size_t numBytes)
+{
+	const char* ptr = static_cast<const char*>(data);
+	while (numBytes > 0)
+	{
+		int64 windowEnd = m_mapStart + BLOCK_MAP_WINDOW_SIZE;
+		if (m_map == nullptr || m_position >= windowEnd)
+		{
+			if (!mapWindow(m_position))
+				return false;
+			windowEnd = m_mapStart + BLOCK_MAP_WINDOW_SIZE;
+		}
+
+		size_t chunk = (size_t)jmin((int64)numBytes, windowEnd - m_position);
+		memcpy(static_cast<char*>(m_map->getData()) + (m_position - m_mapStart), ptr, chunk);
+
+		ptr += chunk;
+		numBytes -= chunk;
+		m_position += chunk;
+	}
+	return true;
+}
+
+void BlockOutputFile::closeMapped()
+{
+	m_map = nullptr;
+
+	/* Drop the preallocated space past the last written block */
+#if JUCE_LINUX
+	if (m_fd >= 0 && ftruncate(m_fd, m_position) != 0)
+		LOGD("Error truncating ", m_mappedFile.getFullPathName(), ": ", strerror(errno));
+#else
+	if (m_stream != nullptr)
+	{
+		m_stream->setPosition(m_position);
+		m_stream->truncate();
+		m_stream = nullptr;
+	}
+#endif
+
+	m_mappedFile = File::nonexistent;
+}
+
+AsyncBlockWriter::AsyncBlockWriter(int maxPendingBlocks) :
+Thread("Block Writer"),
+m_maxPendingBlocks(maxPendingBlocks)
+{
+}
+
+AsyncBlockWriter::~AsyncBlockWriter()
+{
+	flush();
+	stopThread(1000);
+}
+
+void AsyncBlockWriter::queueBlock(BlockOutputFile* file, HeapBlock<char>& storage, const void* data, size_t numBytes)
+{
+	if (!isThreadRunning())
+	{
+		file->write(data, numBytes);
+		return;
+	}
+
+	while (getNumPendingBlocks() >= m_maxPendingBlocks)
+		m_blockWritten.wait(10);
+
+	PendingBlock* block = new PendingBlock();
+	block->file = file;
+	block->storage.swapWith(storage);
+	block->data = data;
+	block->numBytes = numBytes;
+
+	{
+		const ScopedLock sl(m_queueLock);
+		m_queue.add(block);
+	}
+	m_blockQueued.signal();
+}
+
+void AsyncBlockWriter::flush()
+{
+	while (isThreadRunning() && getNumPendingBlocks() > 0)
+		m_blockWritten.wait(10);
+}
+
+int AsyncBlockWriter::getNumPendingBlocks() const
+{
+	const ScopedLock sl(m_queueLock);
+	return m_queue.size();
+}
+
+void AsyncBlockWriter::run()
+{
+	while (true)
+	{
+		PendingBlock* block = nullptr;
+		{
+			const ScopedLock sl(m_queueLock);
+			block = m_queue.getFirst();
+		}
+
+		if (block == nullptr)
+		{
+			if (threadShouldExit())
+				break;
+			m_blockQueued.wait(100);
+			continue;
+		}
+
+		block->file->write(block->data, block->numBytes);
+
+		{
+			const ScopedLock sl(m_queueLock);
+			m_queue.remove(0);
+		}
+		m_blockWritten.signal();
+	}
+}
@@ -0,0 +1,155 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ASYNCBLOCKWRITER_H
+#define ASYNCBLOCKWRITER_H
+
+#include "../../../../JuceLibraryCode/JuceHeader.h"
+
+/** Alignment of the memory blocks, so they can be written with direct I/O */
+#define BLOCK_IO_ALIGNMENT 4096
+
+/** Size of the file window kept mapped in memory-mapped mode */
+#define BLOCK_MAP_WINDOW_SIZE (64 * 1024 * 1024)
+
+/** Size of the extents preallocated ahead of the write position in memory-mapped mode */
+#define BLOCK_PREALLOC_EXTENT (256 * 1024 * 1024)
+
+/** Output file that receives whole memory blocks.
+
+	BUFFERED writes through a FileOutputStream.
+
+	DIRECT is only available on Linux: when supported by the file system, the file is opened
+	with O_DIRECT so full blocks bypass the page cache. Writes that are not aligned to
+	BLOCK_IO_ALIGNMENT (normally only the trailing partial block) silently switch the file
+	back to buffered mode. Other platforms fall back to BUFFERED.
+
+	MAPPED preallocates the file in BLOCK_PREALLOC_EXTENT extents (fallocate on Linux) and
+	copies the blocks into a sliding BLOCK_MAP_WINDOW_SIZE memory-mapped window, so long
+	recordings stay contiguous on disk and don't update file metadata on every write. The
+	file is truncated to the written length when closed.
+
+	When an index is opened, a BlockIndexEntry is appended to it after every block written, so
+	the extent of the data that reached the OS can be recovered after a crash without fsync,
+	even from a preallocated memory-mapped file that was never truncated.
+*/
+struct BlockIndexEntry
+{
+	uint64 offset;		// byte offset of the block in the data file
+	uint64 numBytes;
+};
+
+class BlockOutputFile
+{
+public:
+	enum OutputMode
+	{
+		BUFFERED = 0,
+		DIRECT,
+		MAPPED
+	};
+
+	BlockOutputFile();
+	virtual ~BlockOutputFile();
+
+	bool open(const File& file, OutputMode mode);
+	virtual bool write(const void* data, size_t numBytes);
+
+	/** Starts the block index of an opened file */
+	bool openIndex(const File& indexFile);
+
+	virtual bool isOpen() const;
+	bool isDirect() const;
+	bool isMapped() const;
+
+private:
+	bool writeBlock(const void* data, size_t numBytes);
+
+	bool openMapped(const File& file);
+	bool writeMapped(const void* data, size_t numBytes);
+
+	/** Extends the file so that it holds at least size bytes */
+	bool preallocate(int64 size);
+
+	/** Maps the window holding the given file position */
+	bool mapWindow(int64 position);
+
+	void closeMapped();
+
+#if JUCE_LINUX
+	int m_fd;
+#endif
+	ScopedPointer<FileOutputStream> m_stream;
+	bool m_direct;
+
+	File m_mappedFile;
+	ScopedPointer<MemoryMappedFile> m_map;
+	int64 m_mapStart;
+	int64 m_position;
+	int64 m_allocated;
+
+	ScopedPointer<FileOutputStream> m_index;
+	int64 m_written;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BlockOutputFile);
+};
+
+/** Dedicated I/O thread that writes full memory blocks to their files, so that disk stalls
+	do not block the RecordThread. Blocks are written in the order they are queued.
+*/
+class AsyncBlockWriter : public Thread
+{
+public:
+	AsyncBlockWriter(int maxPendingBlocks = 64);
+	~AsyncBlockWriter();
+
+	/** Queues numBytes starting at data for writing. Takes ownership of storage, which must hold data.
+		If the queue is full, waits until there is room for the block. */
+	void queueBlock(BlockOutputFile* file, HeapBlock<char>& storage, const void* data, size_t numBytes);
+
+	/** Waits until every queued block has been written */
+	void flush();
+
+	int getNumPendingBlocks() const;
+
+	void run() override;
+
+private:
+	struct PendingBlock
+	{
+		BlockOutputFile* file;
+		HeapBlock<char> storage;
+		const void* data;
+		size_t numBytes;
+	};
+
+	OwnedArray<PendingBlock> m_queue;
+	CriticalSection m_queueLock;
+	WaitableEvent m_blockQueued;
+	WaitableEvent m_blockWritten;
+	const int m_maxPendingBlocks;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AsyncBlockWriter);
+};
+
+#endif // ASYNCBLOCKWRITER_H
@@ -1,4 +1,5 @@
 #include "BinaryRecording.h"
+#include "../../../Utils/ThreadConfig.h"
 
 #define TIC std::chrono::high_resolution_clock::now()
 
@@ -7,9 +8,13 @@
 BinaryRecording::BinaryRecording()
 {
     m_bufferSize = MAX_BUFFER_SIZE;
-	m_scaledBuffer.malloc(MAX_BUFFER_SIZE);
+	m_spikeBufferSize = MAX_BUFFER_SIZE;
 	m_intBuffer.malloc(MAX_BUFFER_SIZE);
 	m_tsBuffer.malloc(MAX_BUFFER_SIZE);		
+	m_blockWriter = new AsyncBlockWriter();
+	for (int i = 0; i < BINARY_EVENT_WRITER_THREADS; i++)
+		m_eventWriters.add(new AsyncBlockWriter());
+	m_spikeExporter = new SpikeFeatureExporter();
 }
 
 BinaryRecording::~BinaryRecording() {}
@@ -90,14 +95,14 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
             if (!found)
             {
                 String datPath = getProcessorString(channelInfo);
-                continuousFileNames.add(contPath + datPath + "continuous.dat");
+                continuousFileNames.add(contPath + datPath);
 
                 LOGDD("Creating file: ", contPath, datPath, "timestamps.npy");
                 ScopedPointer<NpyFile> tFile = new NpyFile(contPath + datPath + "timestamps.npy", NpyType(BaseType::INT64,1));
                 m_dataTimestampFiles.add(tFile.release());
 
-                ScopedPointer<NpyFile> ftsFile = new NpyFile(contPath + datPath + "synchronized_timestamps.npy", NpyType(BaseType::DOUBLE,1));
-                m_dataFloatTimestampFiles.add(ftsFile.release());
+                ScopedPointer<NpyFile> segmentFile = new NpyFile(contPath + datPath + "synchronized_timestamp_segments.npy", NpyType(BaseType::DOUBLE,1), 3);
+                m_syncSegmentFiles.add(segmentFile.release());
 
                 m_fileIndexes.set(recordedChan, nInfoArrays);
                 m_channelIndexes.set(recordedChan, 0);
@@ -121,28 +126,34 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
         lastId = indexedDataChannels.size();
     }
 
+    ThreadConfig::startThread (*m_blockWriter, ThreadConfig::RECORD_IO);
+
+    /* Memory-mapped output takes precedence over direct I/O when both are selected */
+    BlockOutputFile::OutputMode outputMode = BlockOutputFile::BUFFERED;
+    if (m_useMappedFiles)
+        outputMode = BlockOutputFile::MAPPED;
+    else if (m_useDirectIO)
+        outputMode = BlockOutputFile::DIRECT;
+
     int nFiles = continuousFileNames.size();
     for (int i = 0; i < nFiles; i++)
     {
         int numChannels = jsonChannels.getReference(i).size();
-        ScopedPointer<SequentialBlockFile> bFile = new SequentialBlockFile(numChannels, samplesPerBlock);
-        if (bFile->openFile(continuousFileNames[i]))
+        DynamicObject::Ptr jsonFile = jsonContinuousfiles.getReference(i).getDynamicObject(); 
+        ScopedPointer<SequentialBlockFile> bFile = new SequentialBlockFile(numChannels, samplesPerBlock, m_blockWriter);
+        if (openContinuousFile(bFile, continuousFileNames[i], numChannels, outputMode, jsonFile))
             m_DataFiles.add(bFile.release());
         else
             m_DataFiles.add(nullptr);
-        DynamicObject::Ptr jsonFile = jsonContinuousfiles.getReference(i).getDynamicObject(); 
         jsonFile->setProperty("num_channels", numChannels);
         jsonFile->setProperty("channels", jsonChannels.getReference(i));
     }
 
     int nChans = getNumRecordedChannels();
-    //Timestamps
-    Array<uint32> procIDs;
-    for (int i = 0; i < nChans; i++)
 
-    {
-        m_startTS.add(getTimestamp(i));
-    }
+    m_channelBlockBuffer.malloc(jmax(nChans, 1) * samplesPerBlock);
+    m_channelBlockStart.insertMultiple(0, 0, nChans);
+    m_channelBlockSamples.insertMultiple(0, 0, nChans);
 
     int nEvents = getNumRecordedEvents();
     String eventPath(basepath + "events" + File::separatorString);
@@ -210,6 +221,7 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
     Array<uint16> indexedChannels;
     m_spikeFileIndexes.insertMultiple(0, 0, nSpikes);
     m_spikeChannelIndexes.insertMultiple(0, 0, nSpikes);
+    m_spikePCAIndexes.insertMultiple(0, -1, nSpikes);
     String spikePath(basepath + "spikes" + File::separatorString);
     Array<var> jsonSpikeFiles;
     Array<var> jsonSpikeChannels;
@@ -235,6 +247,13 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
         jsonChannel->setProperty("source_channel_info", jsonChannelInfo);
         createChannelMetaData(ch, jsonChannel);
 
+        for (int i = 0; i < ch->getEventMetaDataCount(); i++)
+        {
+            const MetaDataDescriptor* md = ch->getEventMetaDataDescriptor(i);
+            if (md->getIdentifier() == SPIKE_PCA_METADATA_ID && md->getType() == MetaDataDescriptor::FLOAT)
+                m_spikePCAIndexes.set(sp, i);
+        }
+
         int nIndexed = indexedSpikes.size();
         bool found = false;
         for (int i = 0; i < nIndexed; i++)
@@ -268,6 +287,14 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
             String spikeName = getProcessorString(ch) + "spike_group_" + String(groupIndex) + File::separatorString;
 
             rec->mainFile = new NpyFile(spikePath + spikeName + "spike_waveforms.npy", NpyType(BaseType::INT16, ch->getTotalSamples()), ch->getNumChannels());
+
+            /* Size the waveform buffer up front so writeSpike never allocates */
+            int waveformSamples = ch->getTotalSamples() * ch->getNumChannels();
+            if (waveformSamples > m_spikeBufferSize)
+            {
+                m_spikeBufferSize = waveformSamples;
+                m_intBuffer.malloc(waveformSamples);
+            }
             rec->timestampFile = new NpyFile(spikePath + spikeName + "spike_times.npy", NpyType(BaseType::INT64, 1));
             rec->channelFile = new NpyFile(spikePath + spikeName + "spike_electrode_indices.npy", NpyType(BaseType::UINT16, 1));
             rec->extraFile = new NpyFile(spikePath + spikeName + "spike_clusters.npy", NpyType(BaseType::UINT16, 1));
@@ -286,6 +313,15 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
             jsonFile->setProperty("post_peak_samples", (int)ch->getPostPeakSamples());
 
             rec->metaDataFile = createEventMetadataFile(ch, spikePath + spikeName + "metadata.npy", jsonFile);
+
+            if (m_exportSpikeFeatures)
+            {
+                int pcaIndex = m_spikePCAIndexes[sp];
+                int numFeatures = pcaIndex >= 0 ? ch->getEventMetaDataDescriptor(pcaIndex)->getLength() : numSpikeChannels;
+                m_spikeExporter->addGroup(spikePath + spikeName, numSpikeChannels, ch->getTotalSamples(), numFeatures, ch->getChannelBitVolts(0));
+                jsonFile->setProperty("features", pcaIndex >= 0 ? "principal_components" : "channel_troughs");
+            }
+
             m_spikeFiles.add(rec.release());
             jsonSpikeFiles.add(var(jsonFile));
         }
@@ -299,6 +335,33 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
         jsonFile->setProperty("channels", jsonSpikeChannels.getReference(i));
     }
 
+    /* The .npy files are written and their headers checkpointed from the I/O thread too */
+    for (auto file : m_dataTimestampFiles)
+        if (file) file->setAsyncWriter(m_blockWriter);
+    for (auto file : m_syncSegmentFiles)
+        if (file) file->setAsyncWriter(m_blockWriter);
+
+    /* The event and spike files are dealt round-robin to their own writers, so hundreds of
+       electrodes don't queue their small writes behind the continuous blocks and each other */
+    int numShards = jmin(BINARY_EVENT_WRITER_THREADS, m_eventFiles.size() + m_spikeFiles.size());
+    for (int i = 0; i < numShards; i++)
+        ThreadConfig::startThread(*m_eventWriters[i], ThreadConfig::RECORD_IO);
+
+    int shard = 0;
+    for (auto rec : m_eventFiles)
+    {
+        rec->setAsyncWriter(m_eventWriters[shard]);
+        shard = (shard + 1) % numShards;
+    }
+    for (auto rec : m_spikeFiles)
+    {
+        rec->setStageSize(BINARY_SPIKE_STAGE_SIZE);
+        rec->setAsyncWriter(m_eventWriters[shard]);
+        shard = (shard + 1) % numShards;
+    }
+
+    m_spikeExporter->start();
+
     File syncFile = File(basepath + "sync_messages.txt");
     Result res = syncFile.create();
     if (res.failed())
@@ -323,6 +386,12 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
 
 }
 
+bool BinaryRecording::openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode outputMode, DynamicObject* jsonFile)
+{
+    jsonFile->setProperty("block_index_file", "continuous.blocks");
+    return file->openFile(folderPath + "continuous.dat", outputMode, true);
+}
+
 NpyFile* BinaryRecording::createEventMetadataFile(const MetaDataEventObject* channel, String filename, DynamicObject* jsonFile)
 {
     int nMetaData = channel->getEventMetaDataCount();
@@ -467,22 +536,169 @@ void BinaryRecording::closeFiles()
 
 void BinaryRecording::resetChannels()
 {
+	//Destroying the files queues their remaining blocks, which are written before the writer stops
 	m_DataFiles.clear();
+	m_blockWriter->stopThread(5000);
+	m_spikeExporter->stop();
 	m_channelIndexes.clear();
 	m_fileIndexes.clear();
 	m_dataTimestampFiles.clear();
-    m_dataFloatTimestampFiles.clear();
+    m_syncSegmentFiles.clear();
 	m_eventFiles.clear();
 	m_spikeChannelIndexes.clear();
 	m_spikeFileIndexes.clear();
+	m_spikePCAIndexes.clear();
 	m_spikeFiles.clear();
+	for (auto writer : m_eventWriters)
+		writer->stopThread(5000);
 	m_syncTextFile = nullptr;
 
-	m_scaledBuffer.malloc(MAX_BUFFER_SIZE);
 	m_intBuffer.malloc(MAX_BUFFER_SIZE);
 	m_tsBuffer.malloc(MAX_BUFFER_SIZE);
 	m_bufferSize = MAX_BUFFER_SIZE;
+	m_spikeBufferSize = MAX_BUFFER_SIZE;
 	m_startTS.clear();
+
+	m_channelBlockBuffer.free();
+	m_channelBlockStart.clear();
+	m_channelBlockSamples.clear();
+}
+
+void BinaryRecording::startChannelBlock(bool lastBlock)
+{
+	//The files are opened before any data arrives, so the start timestamps are those of the first block
+	if (m_startTS.size() == 0)
+	{
+		for (int i = 0; i < getNumRecordedChannels(); i++)
+			m_startTS.add(getTimestamp(i));
+	}
+}
+
+void BinaryRecording::endChannelBlock(bool lastBlock)
+{
+	flushStagedChannels();
+
+	/* The .npy files batch their records; hand them to disk once per block, except for
+	   the event and spike files, which only go out with their header updates */
+	for (auto file : m_dataTimestampFiles)
+		if (file) file->flush();
+	for (auto file : m_syncSegmentFiles)
+		if (file) file->flush();
+	for (auto rec : m_eventFiles)
+		if (rec) rec->flushIfDue();
+	for (auto rec : m_spikeFiles)
+		if (rec) rec->flushIfDue();
+}
+
+int BinaryRecording::getNumPendingWrites() const
+{
+	int pending = m_blockWriter->getNumPendingBlocks();
+	for (auto writer : m_eventWriters)
+		pending += writer->getNumPendingBlocks();
+	return pending;
+}
+
+static void stageSamples(const float* data, int16* dest, float multFactor, int size)
+{
+	convertFloatToInt16Scaled(data, dest, multFactor, size);
+}
+
+static void stageSamples(const int16* data, int16* dest, float, int size)
+{
+	memcpy(dest, data, size * sizeof(int16));
+}
+
+template <typename SampleType>
+void BinaryRecording::stageChannelData(int writeChannel, const SampleType* data, float multFactor, int size)
+{
+	int64 startPos = getTimestamp(writeChannel) - m_startTS[writeChannel] - getSkippedSamples(writeChannel);
+	int staged = m_channelBlockSamples[writeChannel];
+
+	/* The staged row can only be extended with contiguous samples */
+	if (staged > 0 && m_channelBlockStart[writeChannel] + staged != startPos)
+	{
+		flushStagedChannel(writeChannel);
+		staged = 0;
+	}
+
+	while (size > 0)
+	{
+		if (staged == samplesPerBlock)
+		{
+			flushStagedChannel(writeChannel);
+			staged = 0;
+		}
+
+		if (staged == 0)
+			m_channelBlockStart.set(writeChannel, startPos);
+
+		int chunk = jmin(size, samplesPerBlock - staged);
+		stageSamples(data, m_channelBlockBuffer + writeChannel * samplesPerBlock + staged, multFactor, chunk);
+
+		staged += chunk;
+		m_channelBlockSamples.set(writeChannel, staged);
+		data += chunk;
+		startPos += chunk;
+		size -= chunk;
+	}
+}
+
+void BinaryRecording::flushStagedChannel(int writeChannel)
+{
+	int nSamples = m_channelBlockSamples[writeChannel];
+	if (nSamples == 0)
+		return;
+
+	m_DataFiles[m_fileIndexes[writeChannel]]->writeChannel(
+		m_channelBlockStart[writeChannel],
+		m_channelIndexes[writeChannel],
+		m_channelBlockBuffer + writeChannel * samplesPerBlock, nSamples);
+
+	m_channelBlockSamples.set(writeChannel, 0);
+}
+
+void BinaryRecording::flushStagedChannels()
+{
+	int nChans = m_channelBlockSamples.size();
+	int ch = 0;
+
+	while (ch < nChans)
+	{
+		int nSamples = m_channelBlockSamples[ch];
+		if (nSamples == 0)
+		{
+			ch++;
+			continue;
+		}
+
+		/* Group consecutive channels of the same file that cover the same samples */
+		int fileIndex = m_fileIndexes[ch];
+		int64 startPos = m_channelBlockStart[ch];
+		int run = 1;
+		while (ch + run < nChans
+			&& m_fileIndexes[ch + run] == fileIndex
+			&& m_channelIndexes[ch + run] == m_channelIndexes[ch] + run
+			&& m_channelBlockSamples[ch + run] == nSamples
+			&& m_channelBlockStart[ch + run] == startPos)
+		{
+			run++;
+		}
+
+		if (run == 1)
+		{
+			flushStagedChannel(ch);
+		}
+		else
+		{
+			m_DataFiles[fileIndex]->writeChannelBlock(startPos, m_channelIndexes[ch], run,
+				m_channelBlockBuffer + ch * samplesPerBlock, samplesPerBlock, nSamples);
+
+			for (int i = 0; i < run; i++)
+				m_channelBlockSamples.set(ch + i, 0);
+		}
+
+		ch += run;
+	}
 }
 
 void BinaryRecording::writeEventMetaData(const MetaDataEvent* event, NpyFile* file)
@@ -505,55 +721,21 @@ void BinaryRecording::increaseEventCounts(EventRecording* rec)
     if (rec->metaDataFile) rec->metaDataFile->increaseRecordCount();
 }
 
-void BinaryRecording::writeSynchronizedData(int writeChannel, int realChannel, const float* dataBuffer, const double* ftsBuffer, int size)
+void BinaryRecording::writeSyncSegment(int writeChannel, const SyncSegment& segment)
 {
+    /* One table per file, written from its first channel */
+	if (m_channelIndexes[writeChannel] != 0)
+		return;
 
-    if (!size)  
-        return;
-
-    /* If our internal buffer is too small to hold the data... */
-	if (size > m_bufferSize) //shouldn't happen, but if does, this prevents crash...
-	{
-		std::cerr << "[RN] Write buffer overrun, resizing from: " << m_bufferSize << " to: " << size << std::endl;
-		m_scaledBuffer.malloc(size);
-		m_intBuffer.malloc(size);
-		m_tsBuffer.malloc(size);
-		m_bufferSize = size;
-	}
-
-    /* Convert signal from float to int w/ bitVolts scaling */
-	double multFactor = 1 / (float(0x7fff) * getDataChannel(realChannel)->getBitVolts());
-	FloatVectorOperations::copyWithMultiply(m_scaledBuffer.getData(), dataBuffer, multFactor, size);
-	AudioDataConverters::convertFloatToInt16LE(m_scaledBuffer.getData(), m_intBuffer.getData(), size);
-
-    /* Get the file index that belongs to the current recording channel */
-	int fileIndex = m_fileIndexes[writeChannel];
-
-    /* Write the data to that file */
-	m_DataFiles[fileIndex]->writeChannel(
-		getTimestamp(writeChannel) - m_startTS[writeChannel],
-		m_channelIndexes[writeChannel],
-		m_intBuffer.getData(), size);
-
-    /* If is first channel in subprocessor */
-	if (m_channelIndexes[writeChannel] == 0)
-    {
-
-		int64 baseTS = getTimestamp(writeChannel);
-		for (int i = 0; i < size; i++)
-            /* Generate int timestamp */ 
-            m_tsBuffer[i] = baseTS + i;     
-
-        /* Write int timestamps to disc */
-		m_dataTimestampFiles[fileIndex]->writeData(m_tsBuffer, size*sizeof(int64));
-		m_dataTimestampFiles[fileIndex]->increaseRecordCount(size);
-
-        //LOGD("BinaryRecording::writeSynchronizedData: ", *ftsBuffer);
+	/* The segment starts at a row of the file, as counted by timestamps.npy */
+	double record[3] = {
+		double(jmax(int64(0), segment.sample - m_startTS[writeChannel])),
+		segment.masterTime,
+		segment.sampleRate };
 
-        m_dataFloatTimestampFiles[fileIndex]->writeData(ftsBuffer, size*sizeof(double));
-        m_dataFloatTimestampFiles[fileIndex]->increaseRecordCount(size);
-        
-	}
+	NpyFile* file = m_syncSegmentFiles[m_fileIndexes[writeChannel]];
+	file->writeData(record, sizeof(record));
+	file->increaseRecordCount();
 }
 
 void BinaryRecording::writeData(int writeChannel, int realChannel, const float* buffer, int size)
@@ -562,45 +744,39 @@ void BinaryRecording::writeData(int writeChannel, int realChannel, const float*
     if (!size)
         return;
 
-    /* If our internal buffer is too small to hold the data... */
-	if (size > m_bufferSize) //shouldn't happen, but if does, this prevents crash...
-	{
-		std::cerr << "[RN] Write buffer overrun, resizing from: " << m_bufferSize << " to: " << size << std::endl;
-		m_scaledBuffer.malloc(size);
-		m_intBuffer.malloc(size);
-		m_tsBuffer.malloc(size);
-		m_bufferSize = size;
-	}
+    /* Convert signal from float to int w/ bitVolts scaling, straight into the block staging buffer */
+	float multFactor = 1 / (float(0x7fff) * getDataChannel(realChannel)->getBitVolts());
+	stageChannelData(writeChannel, buffer, multFactor, size);
 
-    /* Convert signal from float to int w/ bitVolts scaling */
-	double multFactor = 1 / (float(0x7fff) * getDataChannel(realChannel)->getBitVolts());
-	FloatVectorOperations::copyWithMultiply(m_scaledBuffer.getData(), buffer, multFactor, size);
-	AudioDataConverters::convertFloatToInt16LE(m_scaledBuffer.getData(), m_intBuffer.getData(), size);
+    /* If is first channel in subprocessor */
+	if (m_channelIndexes[writeChannel] == 0)
+		writeSampleTimestamps(m_fileIndexes[writeChannel], getTimestamp(writeChannel), size);
 
-    /* Get the file index that belongs to the current recording channel */
-	int fileIndex = m_fileIndexes[writeChannel];
+}
 
-    /* Write the data to that file */
-	m_DataFiles[fileIndex]->writeChannel(
-		getTimestamp(writeChannel) - m_startTS[writeChannel],
-		m_channelIndexes[writeChannel],
-		m_intBuffer.getData(), size);
+void BinaryRecording::writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size)
+{
+	if (!size)
+		return;
+
+	stageChannelData(writeChannel, buffer, 1.0f, size);
 
-    /* If is first channel in subprocessor */
 	if (m_channelIndexes[writeChannel] == 0)
-    {
+		writeSampleTimestamps(m_fileIndexes[writeChannel], getTimestamp(writeChannel), size);
+}
 
-		int64 baseTS = getTimestamp(writeChannel);
-		for (int i = 0; i < size; i++)
-            /* Generate int timestamp */ 
-            m_tsBuffer[i] = baseTS + i;
+void BinaryRecording::writeSampleTimestamps(int fileIndex, int64 baseTS, int size)
+{
+	/* Generated in chunks of the scratch buffer, so large blocks don't need a reallocation */
+	for (int start = 0; start < size; start += m_bufferSize)
+	{
+		int chunk = jmin(m_bufferSize, size - start);
+		for (int i = 0; i < chunk; i++)
+			m_tsBuffer[i] = baseTS + start + i;
 
-        /* Write int timestamps to disc */
-		m_dataTimestampFiles[fileIndex]->writeData(m_tsBuffer, size*sizeof(int64));
-		m_dataTimestampFiles[fileIndex]->increaseRecordCount(size);
-        
+		m_dataTimestampFiles[fileIndex]->writeData(m_tsBuffer, chunk*sizeof(int64));
 	}
-
+	m_dataTimestampFiles[fileIndex]->increaseRecordCount(size);
 }
 
 void BinaryRecording::writeEvent(int eventIndex, const MidiMessage& event)
@@ -651,17 +827,15 @@ void BinaryRecording::writeSpike(int electrodeIndex, const SpikeEvent* spike)
 	int totalSamples = channel->getTotalSamples() * channel->getNumChannels();
     LOGDD("Got total number of samples: ", totalSamples);
 
-	if (totalSamples > m_bufferSize) //Shouldn't happen, and if it happens it'll be slow, but better this than crashing. Will be reset on file close and reset.
+	if (totalSamples > m_spikeBufferSize) //Shouldn't happen, as the buffer is sized for the largest electrode in openFiles
 	{
 		std::cerr << "(spike) Write buffer overrun, resizing to" << totalSamples << std::endl;
-		m_bufferSize = totalSamples;
-		m_scaledBuffer.malloc(totalSamples);
+		m_spikeBufferSize = totalSamples;
 		m_intBuffer.malloc(totalSamples);
 	}
 
-	double multFactor = 1 / (float(0x7fff) * channel->getChannelBitVolts(0));
-	FloatVectorOperations::copyWithMultiply(m_scaledBuffer.getData(), spike->getDataPointer(), multFactor, totalSamples);
-	AudioDataConverters::convertFloatToInt16LE(m_scaledBuffer.getData(), m_intBuffer.getData(), totalSamples);
+	float multFactor = 1 / (float(0x7fff) * channel->getChannelBitVolts(0));
+	convertFloatToInt16Scaled(spike->getDataPointer(), m_intBuffer.getData(), multFactor, totalSamples);
 	rec->mainFile->writeData(m_intBuffer.getData(), totalSamples*sizeof(int16));
 
 	int64 ts = spike->getTimestamp();
@@ -673,6 +847,13 @@ void BinaryRecording::writeSpike(int electrodeIndex, const SpikeEvent* spike)
 	writeEventMetaData(spike, rec->metaDataFile);
 
 	increaseEventCounts(rec);
+
+	if (m_exportSpikeFeatures)
+	{
+		int pcaIndex = m_spikePCAIndexes[electrodeIndex];
+		const float* features = pcaIndex >= 0 ? static_cast<const float*>(spike->getMetaDataValue(pcaIndex)->getRawValuePointer()) : nullptr;
+		m_spikeExporter->queueSpike(m_spikeFileIndexes[electrodeIndex], spikeChannel, sortedID, features, m_intBuffer);
+	}
 	
 }
 
@@ -690,10 +871,19 @@ RecordEngineManager* BinaryRecording::getEngineManager()
     EngineParameter* param;
     param = new EngineParameter(EngineParameter::BOOL, 0, "Record TTL full words", true);
     man->addParameter(param);
+    param = new EngineParameter(EngineParameter::BOOL, 1, "Direct disk I/O (bypass page cache)", false);
+    man->addParameter(param);
+    param = new EngineParameter(EngineParameter::BOOL, 2, "Preallocated memory-mapped data files", false);
+    man->addParameter(param);
+    param = new EngineParameter(EngineParameter::BOOL, 4, "Export spike features for offline sorting", false);
+    man->addParameter(param);
     return man;
 }
 
 void BinaryRecording::setParameter(EngineParameter& parameter)
 {
 	boolParameter(0, m_saveTTLWords);
+	boolParameter(1, m_useDirectIO);
+	boolParameter(2, m_useMappedFiles);
+	boolParameter(4, m_exportSpikeFeatures);
 }
\ No newline at end of file
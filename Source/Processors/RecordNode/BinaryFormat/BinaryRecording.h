@@ -7,7 +7,16 @@
 #include "../../../Utils/Utils.h"
 #include "../RecordEngine.h"
 #include "SequentialBlockFile.h"
+#include "AsyncBlockWriter.h"
 #include "NpyFile.h"
+#include "SpikeFeatureExporter.h"
+#include "SampleConversion.h"
+
+/* Most I/O threads the event and spike files are spread over */
+#define BINARY_EVENT_WRITER_THREADS 4
+
+/* Size of the staging buffers of the spike files, which are written once per header update */
+#define BINARY_SPIKE_STAGE_SIZE (1024 * 1024)
 
 class BinaryRecording : public RecordEngine
 {
@@ -20,8 +29,12 @@ public:
 	void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
 	void closeFiles() override;
 	void resetChannels() override;
+	void startChannelBlock(bool lastBlock) override;
+	void endChannelBlock(bool lastBlock) override;
+	int getNumPendingWrites() const override;
 	void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
-	void writeSynchronizedData(int writeChannel, int realChannel, const float* dataBuffer, const double* ftsBuffer, int size) override;
+	void writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size) override;
+	void writeSyncSegment(int writeChannel, const SyncSegment& segment) override;
 	void writeEvent(int eventIndex, const MidiMessage& event) override;
 	void addSpikeElectrode(int index, const SpikeChannel* elec) override;
 	void writeSpike(int electrodeIndex, const SpikeEvent* spike) override;
@@ -30,6 +43,11 @@ public:
 
 	static RecordEngineManager* getEngineManager();
 
+protected:
+	/** Opens the continuous data file of a recorded processor, given the path of its folder.
+		Formats that store the samples differently override this. */
+	virtual bool openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode outputMode, DynamicObject* jsonFile);
+
 private:
 
     class EventRecording
@@ -40,6 +58,36 @@ private:
         ScopedPointer<NpyFile> metaDataFile;
         ScopedPointer<NpyFile> channelFile;
         ScopedPointer<NpyFile> extraFile;
+
+        void flush()
+        {
+            mainFile->flush();
+            timestampFile->flush();
+            if (metaDataFile) metaDataFile->flush();
+            if (channelFile) channelFile->flush();
+            if (extraFile) extraFile->flush();
+        }
+
+        void flushIfDue()
+        {
+            mainFile->flushIfDue();
+            timestampFile->flushIfDue();
+            if (metaDataFile) metaDataFile->flushIfDue();
+            if (channelFile) channelFile->flushIfDue();
+            if (extraFile) extraFile->flushIfDue();
+        }
+
+        void setAsyncWriter(AsyncBlockWriter* writer)
+        {
+            for (NpyFile* file : { mainFile.get(), timestampFile.get(), metaDataFile.get(), channelFile.get(), extraFile.get() })
+                if (file) file->setAsyncWriter(writer);
+        }
+
+        void setStageSize(size_t size)
+        {
+            for (NpyFile* file : { mainFile.get(), timestampFile.get(), metaDataFile.get(), channelFile.get(), extraFile.get() })
+                if (file) file->setStageSize(size);
+        }
     };
 
     NpyFile* createEventMetadataFile(const MetaDataEventObject* channel, String fileName, DynamicObject* jsonObject);
@@ -47,12 +95,47 @@ private:
     void writeEventMetaData(const MetaDataEvent* event, NpyFile* file);
     void increaseEventCounts(EventRecording* rec);
 
+    /** Scales and converts samples straight into the channel's row of the block staging buffer,
+        flushing the row whenever it fills up. int16 samples are already scaled and are copied as they are */
+    template <typename SampleType>
+    void stageChannelData(int writeChannel, const SampleType* data, float multFactor, int size);
+
+    /** Writes the sample number of each sample of a block to the timestamps file */
+    void writeSampleTimestamps(int fileIndex, int64 baseTS, int size);
+
+    /** Writes the staged samples of a single channel to its file */
+    void flushStagedChannel(int writeChannel);
+
+    /** Writes all staged samples, in runs of consecutive channels of the same file */
+    void flushStagedChannels();
+
     bool m_saveTTLWords{ true };
+    bool m_useDirectIO{ false };
+    bool m_useMappedFiles{ false };
+    bool m_exportSpikeFeatures{ false };
+
+    /* I/O thread that writes the continuous data blocks off the RecordThread */
+    ScopedPointer<AsyncBlockWriter> m_blockWriter;
 
-	HeapBlock<float> m_scaledBuffer;
+    /* I/O threads the event and spike files are sharded over, each file staying on a single one so its writes keep their order */
+    OwnedArray<AsyncBlockWriter> m_eventWriters;
+
+    /* Background stage that writes the spike feature and waveform summary sidecars, one group per spike file */
+    ScopedPointer<SpikeFeatureExporter> m_spikeExporter;
+    /* Index of the principal component projections in the event metadata of each spike channel, or -1 */
+    Array<int> m_spikePCAIndexes;
+
+	/* Converted spike waveforms */
 	HeapBlock<int16> m_intBuffer;
 	HeapBlock<int64> m_tsBuffer;
+
+	/* Planar int16 staging buffer, one row of samplesPerBlock per recorded channel, so whole channel
+	blocks can be handed to the data files at once in endChannelBlock */
+	HeapBlock<int16> m_channelBlockBuffer;
+	Array<int64> m_channelBlockStart;
+	Array<int> m_channelBlockSamples;
 	int m_bufferSize;
+	int m_spikeBufferSize;
 	int m_ftsBufferSize;
 
 	OwnedArray<SequentialBlockFile> m_DataFiles;
@@ -66,7 +149,8 @@ private:
 	static String getProcessorString(const InfoObjectCommon* channelInfo);
 	
 	OwnedArray<NpyFile> m_dataTimestampFiles;
-	OwnedArray<NpyFile> m_dataFloatTimestampFiles;
+	/* Segments of the synchronized timestamps, as rows of (first sample index in the file, master time, sample rate) */
+	OwnedArray<NpyFile> m_syncSegmentFiles;
 	ScopedPointer<FileOutputStream> m_syncTextFile;
 
 	Array<unsigned int> m_spikeFileIndexes;
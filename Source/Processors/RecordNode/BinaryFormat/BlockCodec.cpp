@@ -0,0 +1,297 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "BlockCodec.h"
+
+/* Marks a channel stored without coding */
+#define RICE_RAW_CHANNEL 0xFF
+/* Largest Rice parameter; zigzagged differences of int16 samples take up to 17 bits */
+#define RICE_MAX_PARAMETER 16
+/* Quotients this large are escaped and followed by the full 17 bit value */
+#define RICE_ESCAPE 24
+#define RICE_ESCAPE_BITS 17
+
+namespace
+{
+	inline uint32 zigzag(int32 v)
+	{
+		return (uint32(v) << 1) ^ uint32(v >> 31);
+	}
+
+	inline int32 unzigzag(uint32 u)
+	{
+		return int32(u >> 1) ^ -int32(u & 1);
+	}
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8* dest) : m_dest(dest), m_pos(0), m_acc(0), m_bits(0) {}
+
+		inline void putBits(uint32 value, int numBits)
+		{
+			m_acc = (m_acc << numBits) | value;
+			m_bits += numBits;
+			while (m_bits >= 8)
+			{
+				m_bits -= 8;
+				m_dest[m_pos++] = uint8(m_acc >> m_bits);
+			}
+		}
+
+		inline void putOnes(int count)
+		{
+			while (count >= 16)
+			{
+				putBits(0xFFFF, 16);
+				count -= 16;
+			}
+			if (count > 0)
+				putBits((1u << count) - 1, count);
+		}
+
+		size_t finish()
+		{
+			if (m_bits > 0)
+				m_dest[m_pos++] = uint8(m_acc << (8 - m_bits));
+			m_bits = 0;
+			return m_pos;
+		}
+
+	private:
+		uint8* m_dest;
+		size_t m_pos;
+		uint64 m_acc;
+		int m_bits;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8* source, size_t numBytes) : m_src(source), m_size(numBytes), m_pos(0), m_acc(0), m_bits(0) {}
+
+		inline bool getBit(uint32& bit)
+		{
+			if (m_bits == 0 && !refill())
+				return false;
+			m_bits--;
+			bit = uint32(m_acc >> m_bits) & 1;
+			return true;
+		}
+
+		inline bool getBits(int numBits, uint32& value)
+		{
+			while (m_bits < numBits)
+			{
+				if (!refill())
+					return false;
+			}
+			m_bits -= numBits;
+			value = uint32(m_acc >> m_bits) & ((1u << numBits) - 1);
+			return true;
+		}
+
+	private:
+		inline bool refill()
+		{
+			if (m_pos >= m_size)
+				return false;
+			m_acc = (m_acc << 8) | m_src[m_pos++];
+			m_bits += 8;
+			return true;
+		}
+
+		const uint8* m_src;
+		size_t m_size;
+		size_t m_pos;
+		uint64 m_acc;
+		int m_bits;
+	};
+
+	/* Picks the Rice parameter closest to log2 of the mean coded value */
+	int chooseRiceParameter(uint64 sum, int count)
+	{
+		int k = 0;
+		while (k < RICE_MAX_PARAMETER && (uint64(count) << (k + 1)) < sum)
+			k++;
+		return k;
+	}
+}
+
+size_t BlockCodec::getMaxChannelBytes(int numSamples)
+{
+	return 1 + size_t(jmax(numSamples, 1)) * sizeof(int16);
+}
+
+size_t BlockCodec::encodeChannel(const int16* source, int stride, int numSamples, uint8* dest)
+{
+	if (numSamples <= 0)
+		return 0;
+
+	uint64 sum = 0;
+	for (int i = 1; i < numSamples; i++)
+		sum += zigzag(int32(source[i * stride]) - int32(source[(i - 1) * stride]));
+
+	const size_t rawBytes = getMaxChannelBytes(numSamples);
+	int k = chooseRiceParameter(sum, jmax(numSamples - 1, 1));
+
+	/* Rough size estimate: a stop bit plus k bits plus the quotient of every value */
+	uint64 estimatedBits = uint64(numSamples - 1) * (k + 1) + (sum >> k);
+	if (rawBytes > 16 && 3 + estimatedBits / 8 < rawBytes)
+	{
+		dest[0] = uint8(k);
+		dest[1] = uint8(uint16(source[0]));
+		dest[2] = uint8(uint16(source[0]) >> 8);
+
+		BitWriter writer(dest + 3);
+		const uint32 mask = (1u << k) - 1;
+		size_t limit = rawBytes - 3 - 8;
+		size_t approx = 0;
+
+		for (int i = 1; i < numSamples; i++)
+		{
+			uint32 u = zigzag(int32(source[i * stride]) - int32(source[(i - 1) * stride]));
+			uint32 q = u >> k;
+			if (q >= RICE_ESCAPE)
+			{
+				writer.putOnes(RICE_ESCAPE);
+				writer.putBits(u, RICE_ESCAPE_BITS);
+				approx += RICE_ESCAPE + RICE_ESCAPE_BITS;
+			}
+			else
+			{
+				writer.putOnes(q);
+				writer.putBits(0, 1);
+				if (k > 0)
+					writer.putBits(u & mask, k);
+				approx += q + 1 + k;
+			}
+
+			/* The estimate was off; coding would not pay for itself */
+			if (approx / 8 >= limit)
+				break;
+		}
+
+		if (approx / 8 < limit)
+			return 3 + writer.finish();
+	}
+
+	dest[0] = RICE_RAW_CHANNEL;
+	for (int i = 0; i < numSamples; i++)
+	{
+		uint16 v = uint16(source[i * stride]);
+		dest[1 + 2 * i] = uint8(v);
+		dest[2 + 2 * i] = uint8(v >> 8);
+	}
+	return rawBytes;
+}
+
+bool BlockCodec::decodeChannel(const uint8* source, size_t numBytes, int16* dest, int stride, int numSamples)
+{
+	if (numSamples <= 0)
+		return true;
+	if (numBytes < 1)
+		return false;
+
+	int k = source[0];
+	if (k == RICE_RAW_CHANNEL)
+	{
+		if (numBytes < getMaxChannelBytes(numSamples))
+			return false;
+		for (int i = 0; i < numSamples; i++)
+			dest[i * stride] = int16(uint16(source[1 + 2 * i]) | (uint16(source[2 + 2 * i]) << 8));
+		return true;
+	}
+
+	if (k > RICE_MAX_PARAMETER || numBytes < 3)
+		return false;
+
+	int32 value = int16(uint16(source[1]) | (uint16(source[2]) << 8));
+	dest[0] = int16(value);
+
+	BitReader reader(source + 3, numBytes - 3);
+	for (int i = 1; i < numSamples; i++)
+	{
+		uint32 q = 0, bit = 1, u = 0;
+		while (q < RICE_ESCAPE)
+		{
+			if (!reader.getBit(bit))
+				return false;
+			if (bit == 0)
+				break;
+			q++;
+		}
+
+		if (q == RICE_ESCAPE)
+		{
+			if (!reader.getBits(RICE_ESCAPE_BITS, u))
+				return false;
+		}
+		else
+		{
+			uint32 rem = 0;
+			if (k > 0 && !reader.getBits(k, rem))
+				return false;
+			u = (q << k) | rem;
+		}
+
+		value += unzigzag(u);
+		dest[i * stride] = int16(value);
+	}
+	return true;
+}
+
+bool BlockCodec::decodeFrame(const void* frame, size_t frameBytes, int16* dest, int numChannels, const bool* channelMask)
+{
+	if (frameBytes < sizeof(FrameHeader))
+		return false;
+
+	FrameHeader header;
+	memcpy(&header, frame, sizeof(FrameHeader));
+	if (header.magic != COMPRESSED_FRAME_MAGIC || int(header.numChannels) != numChannels
+		|| sizeof(FrameHeader) + header.payloadBytes > frameBytes
+		|| header.payloadBytes < numChannels * sizeof(uint32))
+		return false;
+
+	const uint8* table = static_cast<const uint8*>(frame) + sizeof(FrameHeader);
+	const uint8* data = table + numChannels * sizeof(uint32);
+	const uint8* end = table + header.payloadBytes;
+
+	for (int ch = 0; ch < numChannels; ch++)
+	{
+		uint32 channelBytes;
+		memcpy(&channelBytes, table + ch * sizeof(uint32), sizeof(uint32));
+		if (data + channelBytes > end)
+			return false;
+		if (channelMask != nullptr && !channelMask[ch])
+		{
+			// the coded channel is skipped without touching its bytes
+			data += channelBytes;
+			continue;
+		}
+		if (!decodeChannel(data, channelBytes, dest + ch, numChannels, int(header.numSamples)))
+			return false;
+		data += channelBytes;
+	}
+	return true;
+}
@@ -0,0 +1,81 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include "../../../../JuceLibraryCode/JuceHeader.h"
+
+/** Identifies the start of every compressed frame ("OEZF") */
+#define COMPRESSED_FRAME_MAGIC 0x465A454F
+
+/** Lossless codec for the compressed Binary format.
+
+	Every frame holds one block of interleaved int16 samples. Each channel is coded on its
+	own: the first sample is stored as is, the rest as zigzagged first differences written
+	with a Rice code whose parameter is chosen per channel and frame. Channels whose coded
+	size would exceed the raw samples are stored raw.
+
+	Frame layout (little endian):
+		FrameHeader
+		uint32 coded size of each channel
+		coded channels, one after the other
+
+	The frames are indexed by an array of IndexEntry in a separate file, so a reader can
+	seek to any sample without decoding what comes before it.
+*/
+class BlockCodec
+{
+public:
+	struct FrameHeader
+	{
+		uint32 magic;
+		uint32 numSamples;
+		uint32 numChannels;
+		uint32 payloadBytes; //Bytes after the header, including the channel size table
+	};
+
+	struct IndexEntry
+	{
+		uint64 fileOffset;
+		uint64 firstSample;
+		uint32 numSamples;
+		uint32 frameBytes;
+	};
+
+	/** Largest coded size of a channel of numSamples samples */
+	static size_t getMaxChannelBytes(int numSamples);
+
+	/** Codes numSamples samples read every stride elements from source. Returns the number of bytes written to dest,
+		which must hold getMaxChannelBytes(numSamples) */
+	static size_t encodeChannel(const int16* source, int stride, int numSamples, uint8* dest);
+
+	/** Decodes a channel coded by encodeChannel, writing its samples every stride elements of dest */
+	static bool decodeChannel(const uint8* source, size_t numBytes, int16* dest, int stride, int numSamples);
+
+	/** Decodes a whole frame into interleaved samples. dest must hold numSamples * numChannels samples.
+		If channelMask is given, only the channels set in it are decoded; the others are left as they were */
+	static bool decodeFrame(const void* frame, size_t frameBytes, int16* dest, int numChannels, const bool* channelMask = nullptr);
+};
+
+#endif // BLOCKCODEC_H
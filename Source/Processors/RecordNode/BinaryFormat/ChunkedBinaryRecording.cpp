@@ -0,0 +1,77 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChunkedBinaryRecording.h"
+
+ChunkedBinaryRecording::ChunkedBinaryRecording()
+{
+}
+
+ChunkedBinaryRecording::~ChunkedBinaryRecording()
+{
+}
+
+String ChunkedBinaryRecording::getEngineID() const
+{
+	return "CHUNKEDBINARY";
+}
+
+bool ChunkedBinaryRecording::openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode, DynamicObject* jsonFile)
+{
+	const double sampleRate = jsonFile->getProperty("sample_rate");
+	const int chunkSamples = jmax(1, roundToInt(sampleRate * m_chunkMilliseconds / 1000.0));
+
+	ScopedPointer<ChunkedOutputFile> output = new ChunkedOutputFile(numChannels, chunkSamples);
+	if (!output->open(File(folderPath + "continuous.chdat"), File(folderPath + "continuous.chidx")))
+	{
+		LOGD("Unable to create chunked output in ", folderPath);
+		return false;
+	}
+
+	jsonFile->setProperty("layout", "channel-major");
+	jsonFile->setProperty("chunk_samples", chunkSamples);
+	jsonFile->setProperty("data_file", "continuous.chdat");
+	jsonFile->setProperty("index_file", "continuous.chidx");
+
+	return file->openFile(output.release());
+}
+
+RecordEngineManager* ChunkedBinaryRecording::getEngineManager()
+{
+	RecordEngineManager* man = new RecordEngineManager("CHUNKEDBINARY", "Chunked Binary",
+		&(engineFactory<ChunkedBinaryRecording>));
+	EngineParameter* param;
+	param = new EngineParameter(EngineParameter::BOOL, 0, "Record TTL full words", true);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::INT, 3, "Chunk duration (ms)", CHUNK_DEFAULT_MILLISECONDS, 10, 60000);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::BOOL, 4, "Export spike features for offline sorting", false);
+	man->addParameter(param);
+	return man;
+}
+
+void ChunkedBinaryRecording::setParameter(EngineParameter& parameter)
+{
+	BinaryRecording::setParameter(parameter);
+	intParameter(3, m_chunkMilliseconds);
+}
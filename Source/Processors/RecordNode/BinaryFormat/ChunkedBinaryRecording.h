@@ -0,0 +1,61 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHUNKEDBINARYRECORDING_H
+#define CHUNKEDBINARYRECORDING_H
+
+#include "BinaryRecording.h"
+#include "ChunkedOutputFile.h"
+
+#define CHUNK_DEFAULT_MILLISECONDS 1000
+
+/** Binary format with the continuous data stored channel after channel.
+
+	Events, spikes, timestamps and structure.oebin are written exactly as in the Binary
+	format. The samples of each recorded processor go to continuous.chdat in chunks of a
+	fixed duration, each holding the rows of all channels, with continuous.chidx indexing
+	the chunks. Reading a few channels of a long recording then only reads their rows,
+	instead of the whole interleaved file.
+*/
+class ChunkedBinaryRecording : public BinaryRecording
+{
+public:
+	ChunkedBinaryRecording();
+	~ChunkedBinaryRecording();
+
+	String getEngineID() const override;
+
+	void setParameter(EngineParameter& parameter) override;
+
+	static RecordEngineManager* getEngineManager();
+
+protected:
+	bool openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode outputMode, DynamicObject* jsonFile) override;
+
+private:
+	int m_chunkMilliseconds{ CHUNK_DEFAULT_MILLISECONDS };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChunkedBinaryRecording);
+};
+
+#endif
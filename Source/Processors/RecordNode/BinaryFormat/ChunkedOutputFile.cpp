@@ -0,0 +1,153 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChunkedOutputFile.h"
+#include "../../../Utils/Utils.h"
+#include "../../../Utils/RealtimeLog.h"
+
+/* The blocks are transposed in tiles of this many samples by this many channels, which fit in L1 */
+#define TILE_SAMPLES 64
+#define TILE_CHANNELS 32
+
+ChunkedOutputFile::ChunkedOutputFile(int numChannels, int chunkSamples) :
+m_numChannels(numChannels),
+m_chunkSamples(jmax(chunkSamples, 1)),
+m_chunkFill(0),
+m_fileOffset(0),
+m_samplesWritten(0)
+{
+	m_chunk.malloc(size_t(jmax(numChannels, 1)) * m_chunkSamples);
+}
+
+ChunkedOutputFile::~ChunkedOutputFile()
+{
+	//The file is released after the last block was written, so the partial chunk goes now
+	if (isOpen() && m_chunkFill > 0)
+		writeChunk();
+}
+
+bool ChunkedOutputFile::open(const File& dataFile, const File& indexFile)
+{
+	dataFile.deleteFile();
+	indexFile.deleteFile();
+	if (dataFile.create().failed() || indexFile.create().failed())
+		return false;
+
+	m_dataStream = dataFile.createOutputStream();
+	m_indexStream = indexFile.createOutputStream();
+
+	if (m_dataStream == nullptr || m_indexStream == nullptr)
+	{
+		m_dataStream = nullptr;
+		m_indexStream = nullptr;
+		return false;
+	}
+
+	m_chunkFill = 0;
+	m_fileOffset = 0;
+	m_samplesWritten = 0;
+	return true;
+}
+
+bool ChunkedOutputFile::isOpen() const
+{
+	return m_dataStream != nullptr;
+}
+
+bool ChunkedOutputFile::write(const void* data, size_t numBytes)
+{
+	if (!isOpen())
+		return false;
+
+	const int16* block = static_cast<const int16*>(data);
+	int numSamples = int(numBytes / (m_numChannels * sizeof(int16)));
+
+	while (numSamples > 0)
+	{
+		const int count = jmin(numSamples, m_chunkSamples - m_chunkFill);
+
+		for (int s0 = 0; s0 < count; s0 += TILE_SAMPLES)
+		{
+			const int tileSamples = jmin(TILE_SAMPLES, count - s0);
+
+			for (int c0 = 0; c0 < m_numChannels; c0 += TILE_CHANNELS)
+			{
+				const int tileChannels = jmin(TILE_CHANNELS, m_numChannels - c0);
+
+				for (int c = c0; c < c0 + tileChannels; c++)
+				{
+					const int16* source = block + size_t(s0) * m_numChannels + c;
+					int16* dest = m_chunk + size_t(c) * m_chunkSamples + m_chunkFill + s0;
+
+					for (int s = 0; s < tileSamples; s++)
+						dest[s] = source[size_t(s) * m_numChannels];
+				}
+			}
+		}
+
+		block += size_t(count) * m_numChannels;
+		numSamples -= count;
+		m_chunkFill += count;
+
+		if (m_chunkFill == m_chunkSamples && !writeChunk())
+			return false;
+	}
+
+	return true;
+}
+
+bool ChunkedOutputFile::writeChunk()
+{
+	BlockCodec::FrameHeader header;
+	header.magic = CHUNKED_FRAME_MAGIC;
+	header.numSamples = m_chunkFill;
+	header.numChannels = m_numChannels;
+	header.payloadBytes = uint32(size_t(m_numChannels) * m_chunkFill * sizeof(int16));
+
+	bool ok = m_dataStream->write(&header, sizeof(header));
+
+	//A short last chunk is written with rows of its own length
+	if (m_chunkFill == m_chunkSamples)
+		ok = ok && m_dataStream->write(m_chunk, header.payloadBytes);
+	else
+		for (int ch = 0; ch < m_numChannels && ok; ch++)
+			ok = m_dataStream->write(m_chunk + size_t(ch) * m_chunkSamples, m_chunkFill * sizeof(int16));
+
+	if (!ok)
+	{
+		LOGRT("Error writing chunk");
+		return false;
+	}
+
+	BlockCodec::IndexEntry entry;
+	entry.fileOffset = m_fileOffset;
+	entry.firstSample = m_samplesWritten;
+	entry.numSamples = m_chunkFill;
+	entry.frameBytes = uint32(sizeof(header) + header.payloadBytes);
+	m_indexStream->write(&entry, sizeof(entry));
+
+	m_fileOffset += entry.frameBytes;
+	m_samplesWritten += m_chunkFill;
+	m_chunkFill = 0;
+	return true;
+}
@@ -0,0 +1,73 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHUNKEDOUTPUTFILE_H
+#define CHUNKEDOUTPUTFILE_H
+
+#include "AsyncBlockWriter.h"
+#include "BlockCodec.h"
+
+/** Identifies the start of every channel-major chunk ("OECK") */
+#define CHUNKED_FRAME_MAGIC 0x4B43454F
+
+/** Block output that stores the samples in fixed-length chunks, channel after channel.
+
+	The interleaved int16 blocks are transposed into the chunk in memory, so a reader that
+	needs a few channels only touches their rows. Each chunk is written as a
+	BlockCodec::FrameHeader followed by numChannels rows of numSamples samples, and indexed
+	by a BlockCodec::IndexEntry in the index file, like the frames of the compressed format.
+	All chunks hold chunkSamples samples except the last one, which is written when the
+	file is closed.
+*/
+class ChunkedOutputFile : public BlockOutputFile
+{
+public:
+	ChunkedOutputFile(int numChannels, int chunkSamples);
+	~ChunkedOutputFile();
+
+	bool open(const File& dataFile, const File& indexFile);
+
+	bool write(const void* data, size_t numBytes) override;
+	bool isOpen() const override;
+
+private:
+	/** Writes the samples gathered in the chunk so far */
+	bool writeChunk();
+
+	const int m_numChannels;
+	const int m_chunkSamples;
+
+	ScopedPointer<FileOutputStream> m_dataStream;
+	ScopedPointer<FileOutputStream> m_indexStream;
+
+	/* Chunk being filled, one row of m_chunkSamples per channel */
+	HeapBlock<int16> m_chunk;
+	int m_chunkFill;
+
+	uint64 m_fileOffset;
+	uint64 m_samplesWritten;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChunkedOutputFile);
+};
+
+#endif // CHUNKEDOUTPUTFILE_H
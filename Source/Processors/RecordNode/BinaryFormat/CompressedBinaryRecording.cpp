@@ -0,0 +1,87 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CompressedBinaryRecording.h"
+
+CompressedBinaryRecording::CompressedBinaryRecording()
+{
+}
+
+CompressedBinaryRecording::~CompressedBinaryRecording()
+{
+	//The data files code their last blocks on the pool, so they must go before it
+	resetChannels();
+}
+
+String CompressedBinaryRecording::getEngineID() const
+{
+	return "COMPRESSEDBINARY";
+}
+
+void CompressedBinaryRecording::openFiles(File rootFolder, int experimentNumber, int recordingNumber)
+{
+	/* The pool outlives the data files, which are only released when channels are reset */
+	if (m_pool == nullptr || m_poolThreads != m_numThreads)
+	{
+		m_pool = new ThreadPool(m_numThreads);
+		m_poolThreads = m_numThreads;
+	}
+
+	BinaryRecording::openFiles(rootFolder, experimentNumber, recordingNumber);
+}
+
+bool CompressedBinaryRecording::openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode, DynamicObject* jsonFile)
+{
+	ScopedPointer<CompressedOutputFile> output = new CompressedOutputFile(numChannels, m_pool, m_poolThreads);
+	if (!output->open(File(folderPath + "continuous.cdat"), File(folderPath + "continuous.cidx")))
+	{
+		LOGD("Unable to create compressed output in ", folderPath);
+		return false;
+	}
+
+	jsonFile->setProperty("compression", "delta-rice");
+	jsonFile->setProperty("data_file", "continuous.cdat");
+	jsonFile->setProperty("index_file", "continuous.cidx");
+
+	return file->openFile(output.release());
+}
+
+RecordEngineManager* CompressedBinaryRecording::getEngineManager()
+{
+	RecordEngineManager* man = new RecordEngineManager("COMPRESSEDBINARY", "Compressed Binary",
+		&(engineFactory<CompressedBinaryRecording>));
+	EngineParameter* param;
+	param = new EngineParameter(EngineParameter::BOOL, 0, "Record TTL full words", true);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::INT, 3, "Compression threads", COMPRESSION_DEFAULT_THREADS, 1, 32);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::BOOL, 4, "Export spike features for offline sorting", false);
+	man->addParameter(param);
+	return man;
+}
+
+void CompressedBinaryRecording::setParameter(EngineParameter& parameter)
+{
+	BinaryRecording::setParameter(parameter);
+	intParameter(3, m_numThreads);
+}
@@ -0,0 +1,62 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSEDBINARYRECORDING_H
+#define COMPRESSEDBINARYRECORDING_H
+
+#include "BinaryRecording.h"
+#include "CompressedOutputFile.h"
+
+#define COMPRESSION_DEFAULT_THREADS 4
+
+/** Binary format with losslessly compressed continuous data.
+
+	Events, spikes, timestamps and structure.oebin are written exactly as in the Binary
+	format. The samples of each recorded processor go to continuous.cdat, coded by
+	BlockCodec one block at a time, with continuous.cidx indexing the blocks.
+*/
+class CompressedBinaryRecording : public BinaryRecording
+{
+public:
+	CompressedBinaryRecording();
+	~CompressedBinaryRecording();
+
+	String getEngineID() const override;
+
+	void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
+	void setParameter(EngineParameter& parameter) override;
+
+	static RecordEngineManager* getEngineManager();
+
+protected:
+	bool openContinuousFile(SequentialBlockFile* file, const String& folderPath, int numChannels, BlockOutputFile::OutputMode outputMode, DynamicObject* jsonFile) override;
+
+private:
+	int m_numThreads{ COMPRESSION_DEFAULT_THREADS };
+	int m_poolThreads{ 0 };
+	ScopedPointer<ThreadPool> m_pool;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressedBinaryRecording);
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CompressedOutputFile.h"
+#include "../../../Utils/Utils.h"
+#include "../../../Utils/RealtimeLog.h"
+
+CompressedOutputFile::ChannelCoderJob::ChannelCoderJob(CompressedOutputFile* owner) :
+ThreadPoolJob("Channel coder"),
+firstChannel(0),
+lastChannel(0),
+m_owner(owner)
+{
+}
+
+ThreadPoolJob::JobStatus CompressedOutputFile::ChannelCoderJob::runJob()
+{
+	m_owner->encodeChannels(firstChannel, lastChannel);
+	return jobHasFinished;
+}
+
+CompressedOutputFile::CompressedOutputFile(int numChannels, ThreadPool* pool, int numJobs) :
+m_numChannels(numChannels),
+m_pool(pool),
+m_blockData(nullptr),
+m_blockSamples(0),
+m_maxChannelBytes(0),
+m_fileOffset(0),
+m_samplesWritten(0)
+{
+	m_channelBytes.calloc(jmax(numChannels, 1));
+
+	if (m_pool != nullptr)
+	{
+		numJobs = jmin(numJobs, numChannels);
+		for (int i = 0; i < numJobs; i++)
+			m_jobs.add(new ChannelCoderJob(this));
+	}
+}
+
+CompressedOutputFile::~CompressedOutputFile()
+{
+}
+
+bool CompressedOutputFile::open(const File& dataFile, const File& indexFile)
+{
+	dataFile.deleteFile();
+	indexFile.deleteFile();
+	if (dataFile.create().failed() || indexFile.create().failed())
+		return false;
+
+	m_dataStream = dataFile.createOutputStream();
+	m_indexStream = indexFile.createOutputStream();
+
+	if (m_dataStream == nullptr || m_indexStream == nullptr)
+	{
+		m_dataStream = nullptr;
+		m_indexStream = nullptr;
+		return false;
+	}
+
+	m_fileOffset = 0;
+	m_samplesWritten = 0;
+	return true;
+}
+
+bool CompressedOutputFile::isOpen() const
+{
+	return m_dataStream != nullptr;
+}
+
+void CompressedOutputFile::encodeChannels(int firstChannel, int lastChannel)
+{
+	for (int ch = firstChannel; ch < lastChannel; ch++)
+	{
+		m_channelBytes[ch] = (uint32)BlockCodec::encodeChannel(m_blockData + ch, m_numChannels, m_blockSamples,
+			m_channelData + ch * m_maxChannelBytes);
+	}
+}
+
+bool CompressedOutputFile::write(const void* data, size_t numBytes)
+{
+	if (!isOpen())
+		return false;
+
+	int numSamples = int(numBytes / (m_numChannels * sizeof(int16)));
+	if (numSamples == 0)
+		return true;
+
+	size_t maxChannelBytes = BlockCodec::getMaxChannelBytes(numSamples);
+	if (maxChannelBytes > m_maxChannelBytes)
+	{
+		m_maxChannelBytes = maxChannelBytes;
+		m_channelData.malloc(m_maxChannelBytes * m_numChannels);
+	}
+
+	m_blockData = static_cast<const int16*>(data);
+	m_blockSamples = numSamples;
+
+	/* Split the channels across the pool and wait for all of them */
+	int numJobs = m_jobs.size();
+	if (numJobs > 1)
+	{
+		for (int j = 0; j < numJobs; j++)
+		{
+			ChannelCoderJob* job = m_jobs[j];
+			job->firstChannel = (m_numChannels * j) / numJobs;
+			job->lastChannel = (m_numChannels * (j + 1)) / numJobs;
+			m_pool->addJob(job, false);
+		}
+		for (auto job : m_jobs)
+			m_pool->waitForJobToFinish(job, -1);
+	}
+	else
+	{
+		encodeChannels(0, m_numChannels);
+	}
+
+	BlockCodec::FrameHeader header;
+	header.magic = COMPRESSED_FRAME_MAGIC;
+	header.numSamples = numSamples;
+	header.numChannels = m_numChannels;
+	header.payloadBytes = m_numChannels * sizeof(uint32);
+	for (int ch = 0; ch < m_numChannels; ch++)
+		header.payloadBytes += m_channelBytes[ch];
+
+	bool ok = m_dataStream->write(&header, sizeof(header));
+	ok = ok && m_dataStream->write(m_channelBytes, m_numChannels * sizeof(uint32));
+	for (int ch = 0; ch < m_numChannels && ok; ch++)
+		ok = m_dataStream->write(m_channelData + ch * m_maxChannelBytes, m_channelBytes[ch]);
+
+	if (!ok)
+	{
+		LOGRT("Error writing compressed block");
+		return false;
+	}
+
+	BlockCodec::IndexEntry entry;
+	entry.fileOffset = m_fileOffset;
+	entry.firstSample = m_samplesWritten;
+	entry.numSamples = numSamples;
+	entry.frameBytes = uint32(sizeof(header) + header.payloadBytes);
+	m_indexStream->write(&entry, sizeof(entry));
+
+	m_fileOffset += entry.frameBytes;
+	m_samplesWritten += numSamples;
+	return true;
+}
@@ -0,0 +1,85 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSEDOUTPUTFILE_H
+#define COMPRESSEDOUTPUTFILE_H
+
+#include "AsyncBlockWriter.h"
+#include "BlockCodec.h"
+
+/** Block output that codes every interleaved int16 block with BlockCodec before writing it.
+
+	A frame is written to the data file for every block, and an IndexEntry for it to the
+	index file. When a ThreadPool is given, the channels of each block are coded in parallel
+	on it. Blocks are normally written from the AsyncBlockWriter thread, so the RecordThread
+	never waits for the coding.
+*/
+class CompressedOutputFile : public BlockOutputFile
+{
+public:
+	/** numJobs is the number of parts each block is split into, normally the number of threads of the pool */
+	CompressedOutputFile(int numChannels, ThreadPool* pool = nullptr, int numJobs = 1);
+	~CompressedOutputFile();
+
+	bool open(const File& dataFile, const File& indexFile);
+
+	bool write(const void* data, size_t numBytes) override;
+	bool isOpen() const override;
+
+private:
+	class ChannelCoderJob : public ThreadPoolJob
+	{
+	public:
+		ChannelCoderJob(CompressedOutputFile* owner);
+		JobStatus runJob() override;
+
+		int firstChannel;
+		int lastChannel;
+
+	private:
+		CompressedOutputFile* m_owner;
+	};
+
+	void encodeChannels(int firstChannel, int lastChannel);
+
+	const int m_numChannels;
+	ThreadPool* const m_pool;
+	OwnedArray<ChannelCoderJob> m_jobs;
+
+	ScopedPointer<FileOutputStream> m_dataStream;
+	ScopedPointer<FileOutputStream> m_indexStream;
+
+	//Block being coded
+	const int16* m_blockData;
+	int m_blockSamples;
+	size_t m_maxChannelBytes;
+	HeapBlock<uint8> m_channelData;
+	HeapBlock<uint32> m_channelBytes;
+
+	uint64 m_fileOffset;
+	uint64 m_samplesWritten;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressedOutputFile);
+};
+
+#endif // COMPRESSEDOUTPUTFILE_H
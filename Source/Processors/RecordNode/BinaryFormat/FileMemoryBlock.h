@@ -1,34 +1,46 @@
 #include "../../../../JuceLibraryCode/JuceHeader.h"
+#include "AsyncBlockWriter.h"
 
 template <class StorageType = int16>
 class FileMemoryBlock
 {
 public:
-	FileMemoryBlock(FileOutputStream* file, int blockSize, uint64 offset) :
-		m_data(blockSize, true),
+	/** If writer is not null, the block is handed over to its I/O thread when destroyed instead
+	of being written synchronously */
+	FileMemoryBlock(BlockOutputFile* file, AsyncBlockWriter* writer, int blockSize, uint64 offset) :
 		m_file(file),
+		m_writer(writer),
 		m_blockSize(blockSize),
 		m_offset(offset),
         m_finalFlushSamples(blockSize)
-	{};
+	{
+		//Over-allocate so the data can be aligned for direct I/O
+		m_storage.calloc(blockSize*sizeof(StorageType) + BLOCK_IO_ALIGNMENT);
+		m_data = reinterpret_cast<StorageType*>(((pointer_sized_uint)m_storage.getData() + BLOCK_IO_ALIGNMENT - 1) & ~(pointer_sized_uint)(BLOCK_IO_ALIGNMENT - 1));
+	};
 
 	~FileMemoryBlock() {
-		if (~m_flushed)
+		if (!m_flushed)
 		{
-			m_file->write(m_data, m_finalFlushSamples*sizeof(StorageType));
+			if (m_writer)
+				m_writer->queueBlock(m_file, m_storage, m_data, m_finalFlushSamples*sizeof(StorageType));
+			else
+				m_file->write(m_data, m_finalFlushSamples*sizeof(StorageType));
 		}
 	};
 
 	inline uint64 getOffset() { return m_offset; }
-	inline StorageType* getData() { return m_data.getData(); }
+	inline StorageType* getData() { return m_data; }
 	void partialFlush(size_t size)
 	{
         m_finalFlushSamples = size;
 	}
 
 private:
-	HeapBlock<StorageType> m_data;
-	FileOutputStream* const m_file;
+	HeapBlock<char> m_storage;
+	StorageType* m_data;
+	BlockOutputFile* const m_file;
+	AsyncBlockWriter* const m_writer;
 	const int m_blockSize;
 	const uint64 m_offset;
     size_t m_finalFlushSamples;
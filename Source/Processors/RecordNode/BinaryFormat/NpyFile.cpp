@@ -76,9 +76,8 @@ bool NpyFile::openFile(String path)
     }
     
     //file.deleteFile(); // overwrite, never append a new .npy file to end of an existing one
-    // output stream buffer size defaults to 32768 bytes, but is irrelevant because
-    // each updateHeader() call triggers a m_file->flush() to disk:
-    m_file = file.createOutputStream();
+    // data is batched in m_stage, so the stream itself doesn't need a buffer:
+    m_file = file.createOutputStream(0);
 
     /*
     if (m_file == nullptr)
@@ -97,6 +96,8 @@ bool NpyFile::openFile(String path)
     if (!m_file)
         return false;
 
+    m_stage.malloc(stageSize);
+    m_lastHeaderUpdate = Time::getMillisecondCounter();
     m_okOpen = true;
     return true;
 }
@@ -171,49 +172,154 @@ void NpyFile::writeHeader(const Array<NpyType>& typeList)
 
 void NpyFile::updateHeader()
 {
+    // the header must never count records that are not on disk yet
+    writeStagedData();
+    m_headerRecordCount = m_recordCount;
+    m_lastHeaderUpdate = Time::getMillisecondCounter();
+
+    String newShape = getShapeString();
+    size_t numBytes = newShape.getNumBytesAsUTF8();
+    if (m_shapePos + numBytes + 1 > m_headerLen) // +1 for newline
+    {
+        std::cerr << "Error. Header has grown too big to update in-place " << std::endl;
+    }
 
-    if (true)
+    if (m_writer != nullptr)
     {
-        // overwrite the shape part of the header - even without explicitly calling
-        // m_file->flush(), overwriting seems to trigger a flush to disk,
-        // while appending to end of file does not
-        int64 currentPos = m_file->getPosition(); // returns int64, necessary for big files
-        if (m_file->setPosition(m_shapePos))
-        {
-            String newShape = getShapeString();
-            if (m_shapePos + newShape.getNumBytesAsUTF8() + 1 > m_headerLen) // +1 for newline
-            {
-                std::cerr << "Error. Header has grown too big to update in-place " << std::endl;
-            }
-            m_file->write(newShape.toUTF8(), newShape.getNumBytesAsUTF8());
-            m_file->flush(); // not necessary, already flushed due to overwrite? do it anyway
-            m_file->setPosition(currentPos); // restore position to end of file
-        }
-        else
-        {
-            std::cerr << "Error. Unable to seek to update file header"
-                << m_file->getFile().getFullPathName() << std::endl;
-        }
+        // queued behind the staged data, so it is written after it
+        HeapBlock<char> shape(numBytes);
+        memcpy(shape, newShape.toRawUTF8(), numBytes);
+        const char* data = shape;
+        m_writer->queueBlock(m_headerOutput, shape, data, numBytes);
     }
+    else
+        writeShape(*m_file, m_shapePos, newShape.toRawUTF8(), numBytes);
+}
 
+bool NpyFile::writeShape(FileOutputStream& stream, int64 shapePos, const void* shape, size_t numBytes)
+{
+    // overwrite the shape part of the header - even without explicitly calling
+    // flush(), overwriting seems to trigger a flush to disk,
+    // while appending to end of file does not
+    int64 currentPos = stream.getPosition(); // returns int64, necessary for big files
+    if (!stream.setPosition(shapePos))
+    {
+        std::cerr << "Error. Unable to seek to update file header"
+            << stream.getFile().getFullPathName() << std::endl;
+        return false;
+    }
+
+    bool ok = stream.write(shape, numBytes);
+    stream.flush(); // not necessary, already flushed due to overwrite? do it anyway
+    stream.setPosition(currentPos); // restore position to end of file
+    return ok;
 }
 
 NpyFile::~NpyFile()
 {
-    updateHeader();
+    if (m_okOpen)
+        updateHeader();
+
+    // the stream must stay alive until all of its queued blocks are on disk
+    if (m_writer != nullptr)
+        m_writer->flush();
+}
+
+void NpyFile::setAsyncWriter(AsyncBlockWriter* writer)
+{
+    if (!m_okOpen)
+        return;
+
+    m_writer = writer;
+    m_dataOutput = new StreamOutput(*m_file);
+    m_headerOutput = new StreamOutput(*m_file, m_shapePos);
+}
+
+NpyFile::StreamOutput::StreamOutput(FileOutputStream& stream, int64 shapePos)
+    : m_stream(stream), m_shapePos(shapePos)
+{
+}
+
+bool NpyFile::StreamOutput::write(const void* data, size_t numBytes)
+{
+    if (m_shapePos >= 0)
+        return writeShape(m_stream, m_shapePos, data, numBytes);
+
+    return m_stream.write(data, numBytes);
+}
+
+bool NpyFile::StreamOutput::isOpen() const
+{
+    return true;
 }
 
 void NpyFile::writeData(const void* data, size_t size)
 {
-    m_file->write(data, size);
+    if (m_stagedBytes + size > stageSize)
+    {
+        writeStagedData();
+        if (size >= stageSize)
+        {
+            if (m_writer != nullptr)
+            {
+                HeapBlock<char> block(size);
+                memcpy(block, data, size);
+                const char* blockData = block;
+                m_writer->queueBlock(m_dataOutput, block, blockData, size);
+            }
+            else
+                m_file->write(data, size);
+            return;
+        }
+    }
+    memcpy(m_stage + m_stagedBytes, data, size);
+    m_stagedBytes += size;
+}
+
+void NpyFile::writeStagedData()
+{
+    if (m_stagedBytes == 0)
+        return;
+
+    if (m_writer != nullptr)
+    {
+        // the writer takes over the staging buffer, so staging continues in a fresh one
+        const char* data = m_stage;
+        m_writer->queueBlock(m_dataOutput, m_stage, data, m_stagedBytes);
+        m_stage.malloc(stageSize);
+    }
+    else
+        m_file->write(m_stage, m_stagedBytes);
+    m_stagedBytes = 0;
 }
 
 void NpyFile::increaseRecordCount(int count)
 {
-    int64 old_recordCount = m_recordCount;
     m_recordCount += count;
-    if ((old_recordCount / recordBufferSize) != (m_recordCount / recordBufferSize))
-        updateHeader(); // crossed recordBufferSize threshold, update header
+}
+
+void NpyFile::flush()
+{
+    if (!m_okOpen)
+        return;
+
+    writeStagedData();
+    if (m_recordCount != m_headerRecordCount
+        && Time::getMillisecondCounter() - m_lastHeaderUpdate >= headerUpdateInterval)
+        updateHeader();
+}
+
+void NpyFile::flushIfDue()
+{
+    if (Time::getMillisecondCounter() - m_lastHeaderUpdate >= headerUpdateInterval)
+        flush();
+}
+
+void NpyFile::setStageSize(size_t size)
+{
+    jassert(m_stagedBytes == 0);
+    stageSize = size;
+    m_stage.malloc(stageSize);
 }
 
 NpyType::NpyType(String n, BaseType t, size_t l)
@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../RecordEngine.h"
 #include "../../../Utils/Utils.h"
+#include "AsyncBlockWriter.h"
 
 
 class NpyType
@@ -50,14 +51,56 @@ public:
     NpyFile(String path, const Array<NpyType>& typeList);
     NpyFile(String path, NpyType type, unsigned int dim = 1);
     ~NpyFile();
+
+    /** Appends data to the staging buffer. It reaches the file on flush, or when the buffer fills up */
     void writeData(const void* data, size_t size);
     void increaseRecordCount(int count = 1);
+
+    /** Writes the staged data, and rewrites the header if it hasn't been for headerUpdateInterval */
+    void flush();
+
+    /** As flush(), but only once the header is due for its update, so the staging buffer can collect
+        many small records between two writes. The header never counts more than reached the file either way */
+    void flushIfDue();
+
+    /** Sets the size of the staging buffer. Call before writing any data */
+    void setStageSize(size_t size);
+
+    /** Hands the data writes and header checkpoints to the I/O thread of a writer, which must
+        outlive the file, so they cost the recording thread only a copy. The writer keeps them
+        in order, so the header never counts records that are not on disk yet. */
+    void setAsyncWriter(AsyncBlockWriter* writer);
 private:
+    /** Output the writer thread writes the file through: appending the data, or overwriting
+        the shape field of the header and returning to the end of the file */
+    class StreamOutput : public BlockOutputFile
+    {
+    public:
+        StreamOutput(FileOutputStream& stream, int64 shapePos = -1);
+
+        bool write(const void* data, size_t numBytes) override;
+        bool isOpen() const override;
+
+    private:
+        FileOutputStream& m_stream;
+        const int64 m_shapePos;
+    };
+
+    static bool writeShape(FileOutputStream& stream, int64 shapePos, const void* shape, size_t numBytes);
+
     bool openFile(String path);
     String getShapeString();
     void writeHeader(const Array<NpyType>& typeList);
     void updateHeader();
+    void writeStagedData();
     ScopedPointer<FileOutputStream> m_file;
+    AsyncBlockWriter* m_writer{ nullptr };
+    ScopedPointer<StreamOutput> m_dataOutput;
+    ScopedPointer<StreamOutput> m_headerOutput;
+    HeapBlock<char> m_stage;
+    size_t m_stagedBytes{ 0 };
+    int64 m_headerRecordCount{ 0 };
+    uint32 m_lastHeaderUpdate{ 0 };
     int64 m_headerLen; // total header length
     bool m_okOpen{ false };
     int64 m_recordCount{ 0 };
@@ -67,8 +110,11 @@ private:
 
     // Compile-time constants
 
-    // flush file buffer to disk and update the .npy header every this many records:
-    const int recordBufferSize{ 1024 };
+    // size of the staging buffer, writes larger than this go straight to the file:
+    size_t stageSize{ 65536 };
+
+    // minimum time between two .npy header updates, in milliseconds:
+    const uint32 headerUpdateInterval{ 2000 };
 
 };
 
@@ -0,0 +1,114 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SAMPLECONVERSION_H
+#define SAMPLECONVERSION_H
+
+#include "../../../../JuceLibraryCode/JuceHeader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SC_USE_SSE2 1
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SC_USE_NEON 1
+#endif
+
+/** Scales float samples and converts them to saturated int16 in a single pass.
+
+	Equivalent to FloatVectorOperations::copyWithMultiply followed by
+	AudioDataConverters::convertFloatToInt16LE, without the intermediate float buffer:
+	each sample becomes round(clamp(source * multFactor * 0x7fff, -0x7fff, 0x7fff)),
+	rounding to nearest even. The SSE2 path gives the same results as the two-pass
+	conversion; the NEON path does the final scaling in single precision, so it can
+	differ from it by one LSB on values close to half-way.
+*/
+template <bool bigEndian>
+inline void convertFloatToInt16ScaledWithByteOrder(const float* source, int16* dest, float multFactor, int numSamples)
+{
+	int i = 0;
+
+#if SC_USE_SSE2
+	const __m128 vGain = _mm_set1_ps(multFactor);
+	const __m128d vScale = _mm_set1_pd(double(0x7fff));
+	const __m128d vMax = _mm_set1_pd(double(0x7fff));
+	const __m128d vMin = _mm_set1_pd(-double(0x7fff));
+
+	/* The scaled samples are widened to double before the final scaling, like the two-pass conversion */
+	auto convert4 = [&](const float* src) -> __m128i
+	{
+		__m128 scaled = _mm_mul_ps(_mm_loadu_ps(src), vGain);
+		__m128d lo = _mm_mul_pd(_mm_cvtps_pd(scaled), vScale);
+		__m128d hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(scaled, scaled)), vScale);
+		lo = _mm_max_pd(_mm_min_pd(lo, vMax), vMin);
+		hi = _mm_max_pd(_mm_min_pd(hi, vMax), vMin);
+		return _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+	};
+
+	for (; i + 8 <= numSamples; i += 8)
+	{
+		__m128i packed = _mm_packs_epi32(convert4(source + i), convert4(source + i + 4));
+		if (bigEndian)
+			packed = _mm_or_si128(_mm_slli_epi16(packed, 8), _mm_srli_epi16(packed, 8));
+		_mm_storeu_si128((__m128i*)(dest + i), packed);
+	}
+#elif SC_USE_NEON
+	const float32x4_t vGain = vdupq_n_f32(multFactor);
+	const float32x4_t vScale = vdupq_n_f32(float(0x7fff));
+	const float32x4_t vMax = vdupq_n_f32(float(0x7fff));
+	const float32x4_t vMin = vdupq_n_f32(-float(0x7fff));
+
+	for (; i + 8 <= numSamples; i += 8)
+	{
+		float32x4_t a = vmulq_f32(vmulq_f32(vld1q_f32(source + i), vGain), vScale);
+		float32x4_t b = vmulq_f32(vmulq_f32(vld1q_f32(source + i + 4), vGain), vScale);
+		a = vmaxq_f32(vminq_f32(a, vMax), vMin);
+		b = vmaxq_f32(vminq_f32(b, vMax), vMin);
+		int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+		if (bigEndian)
+			packed = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(packed)));
+		vst1q_s16(dest + i, packed);
+	}
+#endif
+
+	const double maxVal = (double)0x7fff;
+	for (; i < numSamples; ++i)
+	{
+		float scaled = source[i] * multFactor;
+		int16 value = (int16)roundToInt(jlimit(-maxVal, maxVal, maxVal * scaled));
+		dest[i] = bigEndian ? (int16)ByteOrder::swap((uint16)value) : value;
+	}
+}
+
+inline void convertFloatToInt16Scaled(const float* source, int16* dest, float multFactor, int numSamples)
+{
+	convertFloatToInt16ScaledWithByteOrder<false>(source, dest, multFactor, numSamples);
+}
+
+/** As convertFloatToInt16Scaled, storing the samples big-endian as the Open Ephys format does */
+inline void convertFloatToInt16ScaledBE(const float* source, int16* dest, float multFactor, int numSamples)
+{
+	convertFloatToInt16ScaledWithByteOrder<true>(source, dest, multFactor, numSamples);
+}
+
+#endif
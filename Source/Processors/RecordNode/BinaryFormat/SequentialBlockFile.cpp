@@ -22,9 +22,113 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "SequentialBlockFile.h"
+#include "../../../Utils/RealtimeLog.h"
 
-SequentialBlockFile::SequentialBlockFile(int nChannels, int samplesPerBlock) :
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SBF_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SBF_USE_NEON 1
+#endif
+
+namespace
+{
+	/* Transposes an 8x8 tile of int16 samples: 8 planar channel rows into 8 interleaved sample frames */
+	inline void transposeTile8x8(const int16* src, int srcStride, int16* dst, int dstStride)
+	{
+#if SBF_USE_SSE2
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(src + 0 * srcStride));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(src + 1 * srcStride));
+		__m128i a2 = _mm_loadu_si128((const __m128i*)(src + 2 * srcStride));
+		__m128i a3 = _mm_loadu_si128((const __m128i*)(src + 3 * srcStride));
+		__m128i a4 = _mm_loadu_si128((const __m128i*)(src + 4 * srcStride));
+		__m128i a5 = _mm_loadu_si128((const __m128i*)(src + 5 * srcStride));
+		__m128i a6 = _mm_loadu_si128((const __m128i*)(src + 6 * srcStride));
+		__m128i a7 = _mm_loadu_si128((const __m128i*)(src + 7 * srcStride));
+
+		__m128i b0 = _mm_unpacklo_epi16(a0, a1);
+		__m128i b1 = _mm_unpackhi_epi16(a0, a1);
+		__m128i b2 = _mm_unpacklo_epi16(a2, a3);
+		__m128i b3 = _mm_unpackhi_epi16(a2, a3);
+		__m128i b4 = _mm_unpacklo_epi16(a4, a5);
+		__m128i b5 = _mm_unpackhi_epi16(a4, a5);
+		__m128i b6 = _mm_unpacklo_epi16(a6, a7);
+		__m128i b7 = _mm_unpackhi_epi16(a6, a7);
+
+		__m128i c0 = _mm_unpacklo_epi32(b0, b2);
+		__m128i c1 = _mm_unpackhi_epi32(b0, b2);
+		__m128i c2 = _mm_unpacklo_epi32(b1, b3);
+		__m128i c3 = _mm_unpackhi_epi32(b1, b3);
+		__m128i c4 = _mm_unpacklo_epi32(b4, b6);
+		__m128i c5 = _mm_unpackhi_epi32(b4, b6);
+		__m128i c6 = _mm_unpacklo_epi32(b5, b7);
+		__m128i c7 = _mm_unpackhi_epi32(b5, b7);
+
+		_mm_storeu_si128((__m128i*)(dst + 0 * dstStride), _mm_unpacklo_epi64(c0, c4));
+		_mm_storeu_si128((__m128i*)(dst + 1 * dstStride), _mm_unpackhi_epi64(c0, c4));
+		_mm_storeu_si128((__m128i*)(dst + 2 * dstStride), _mm_unpacklo_epi64(c1, c5));
+		_mm_storeu_si128((__m128i*)(dst + 3 * dstStride), _mm_unpackhi_epi64(c1, c5));
+		_mm_storeu_si128((__m128i*)(dst + 4 * dstStride), _mm_unpacklo_epi64(c2, c6));
+		_mm_storeu_si128((__m128i*)(dst + 5 * dstStride), _mm_unpackhi_epi64(c2, c6));
+		_mm_storeu_si128((__m128i*)(dst + 6 * dstStride), _mm_unpacklo_epi64(c3, c7));
+		_mm_storeu_si128((__m128i*)(dst + 7 * dstStride), _mm_unpackhi_epi64(c3, c7));
+#elif SBF_USE_NEON
+		int16x8x2_t t01 = vtrnq_s16(vld1q_s16(src + 0 * srcStride), vld1q_s16(src + 1 * srcStride));
+		int16x8x2_t t23 = vtrnq_s16(vld1q_s16(src + 2 * srcStride), vld1q_s16(src + 3 * srcStride));
+		int16x8x2_t t45 = vtrnq_s16(vld1q_s16(src + 4 * srcStride), vld1q_s16(src + 5 * srcStride));
+		int16x8x2_t t67 = vtrnq_s16(vld1q_s16(src + 6 * srcStride), vld1q_s16(src + 7 * srcStride));
+
+		int32x4x2_t u02 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[0]), vreinterpretq_s32_s16(t23.val[0]));
+		int32x4x2_t u13 = vtrnq_s32(vreinterpretq_s32_s16(t01.val[1]), vreinterpretq_s32_s16(t23.val[1]));
+		int32x4x2_t u46 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[0]), vreinterpretq_s32_s16(t67.val[0]));
+		int32x4x2_t u57 = vtrnq_s32(vreinterpretq_s32_s16(t45.val[1]), vreinterpretq_s32_s16(t67.val[1]));
+
+		#define SBF_JOIN(part, x, y) vcombine_s16(part(vreinterpretq_s16_s32(x)), part(vreinterpretq_s16_s32(y)))
+		vst1q_s16(dst + 0 * dstStride, SBF_JOIN(vget_low_s16, u02.val[0], u46.val[0]));
+		vst1q_s16(dst + 1 * dstStride, SBF_JOIN(vget_low_s16, u13.val[0], u57.val[0]));
+		vst1q_s16(dst + 2 * dstStride, SBF_JOIN(vget_low_s16, u02.val[1], u46.val[1]));
+		vst1q_s16(dst + 3 * dstStride, SBF_JOIN(vget_low_s16, u13.val[1], u57.val[1]));
+		vst1q_s16(dst + 4 * dstStride, SBF_JOIN(vget_high_s16, u02.val[0], u46.val[0]));
+		vst1q_s16(dst + 5 * dstStride, SBF_JOIN(vget_high_s16, u13.val[0], u57.val[0]));
+		vst1q_s16(dst + 6 * dstStride, SBF_JOIN(vget_high_s16, u02.val[1], u46.val[1]));
+		vst1q_s16(dst + 7 * dstStride, SBF_JOIN(vget_high_s16, u13.val[1], u57.val[1]));
+		#undef SBF_JOIN
+#else
+		for (int c = 0; c < 8; c++)
+			for (int i = 0; i < 8; i++)
+				dst[i * dstStride + c] = src[c * srcStride + i];
+#endif
+	}
+
+	/* dst[i*dstStride + c] = src[c*srcStride + i] for nChannels x nSamples, using 8x8 tiles where possible */
+	void interleaveChannels(const int16* src, int srcStride, int16* dst, int dstStride, int nChannels, int nSamples)
+	{
+		const int tiledChannels = nChannels & ~7;
+		const int tiledSamples = nSamples & ~7;
+
+		for (int c = 0; c < tiledChannels; c += 8)
+		{
+			for (int i = 0; i < tiledSamples; i += 8)
+				transposeTile8x8(src + c * srcStride + i, srcStride, dst + i * dstStride + c, dstStride);
+
+			for (int i = tiledSamples; i < nSamples; i++)
+				for (int k = 0; k < 8; k++)
+					dst[i * dstStride + c + k] = src[(c + k) * srcStride + i];
+		}
+
+		for (int c = tiledChannels; c < nChannels; c++)
+		{
+			const int16* row = src + c * srcStride;
+			for (int i = 0; i < nSamples; i++)
+				dst[i * dstStride + c] = row[i];
+		}
+	}
+}
+
+SequentialBlockFile::SequentialBlockFile(int nChannels, int samplesPerBlock, AsyncBlockWriter* writer) :
 m_file(nullptr),
+m_writer(writer),
 m_nChannels(nChannels),
 m_samplesPerBlock(samplesPerBlock),
 m_blockSize(nChannels*samplesPerBlock),
@@ -46,9 +150,14 @@ SequentialBlockFile::~SequentialBlockFile()
 
 	//manually flush the last one to avoid trailing zeroes
 	m_memBlocks[0]->partialFlush(m_lastBlockFill * m_nChannels);
+	m_memBlocks.clear();
+
+	//the output file must stay alive until all of its queued blocks are on disk
+	if (m_writer)
+		m_writer->flush();
 }
 
-bool SequentialBlockFile::openFile(String filename)
+bool SequentialBlockFile::openFile(String filename, BlockOutputFile::OutputMode mode, bool indexBlocks)
 {
 	File file(filename);
 	Result res = file.create();
@@ -60,15 +169,30 @@ bool SequentialBlockFile::openFile(String filename)
 		LOGD("Re-creating file: ", filename);
 	}
 
-	m_file = file.createOutputStream(streamBufferSize);
-	if (!m_file)
+	ScopedPointer<BlockOutputFile> output = new BlockOutputFile();
+	if (!output->open(file, mode))
 	{
 		LOGD("Unable to create output stream!");
 		return false;
 	}
 
+	if (indexBlocks && !output->openIndex(file.withFileExtension("blocks")))
+		LOGD("Unable to create block index for ", filename);
+
+	return openFile(output.release());
+}
+
+bool SequentialBlockFile::openFile(BlockOutputFile* file)
+{
+	m_file = file;
+	if (m_file == nullptr || !m_file->isOpen())
+	{
+		m_file = nullptr;
+		return false;
+	}
+
 	LOGDD("Added new FileBlock");
-	m_memBlocks.add(new FileBlock(m_file, m_blockSize, 0));
+	m_memBlocks.add(new FileBlock(m_file, m_writer, m_blockSize, 0));
 	return true;
 }
 
@@ -81,20 +205,12 @@ bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, int16* data
 		return false;
 	}
 
-	int bIndex = m_memBlocks.size() - 1;
-	if ((bIndex < 0) || (m_memBlocks[bIndex]->getOffset() + m_samplesPerBlock) < (startPos + nSamples))
-		allocateBlocks(startPos, nSamples);
-
-	for (bIndex = m_memBlocks.size() - 1; bIndex >= 0; bIndex--)
-	{
-		if (m_memBlocks[bIndex]->getOffset() <= startPos)
-			break;
-	}
+	int bIndex = getBlockIndex(startPos, nSamples);
 	if (bIndex < 0)
 	{
-		LOGD("Memory block unloaded ahead of time for chan", channel, " start ", startPos, " ns ", nSamples);
+		LOGRT("Memory block unloaded ahead of time for chan", channel, " start ", startPos, " ns ", nSamples);
 		for (int i = 0; i < m_nChannels; i++)
-			LOGD("CH: ", i, " last block ", m_currentBlock[i]); 
+			LOGRT("CH: ", i, " last block ", m_currentBlock[i]); 
 		return false;
 	}
 	int writtenSamples = 0;
@@ -135,6 +251,64 @@ bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, int16* data
 	return true;
 }
 
+bool SequentialBlockFile::writeChannelBlock(uint64 startPos, int firstChannel, int nChannels, const int16* data, int dataStride, int nSamples)
+{
+	if (!m_file)
+	{
+		printf("[RN]SequentialBlockFile::writeChannelBlock returned false: (!m_file)\n");
+		return false;
+	}
+
+	int bIndex = getBlockIndex(startPos, nSamples);
+	if (bIndex < 0)
+	{
+		LOGRT("Memory block unloaded ahead of time for chans ", firstChannel, "-", firstChannel + nChannels - 1, " start ", startPos, " ns ", nSamples);
+		return false;
+	}
+	int writtenSamples = 0;
+	int startIdx = startPos - m_memBlocks[bIndex]->getOffset();
+	int lastBlockIdx = m_memBlocks.size() - 1;
+
+	while (writtenSamples < nSamples)
+	{
+		int16* blockPtr = m_memBlocks[bIndex]->getData();
+		int samplesToWrite = jmin((nSamples - writtenSamples), (m_samplesPerBlock - startIdx));
+
+		interleaveChannels(data + writtenSamples, dataStride,
+			blockPtr + startIdx*m_nChannels + firstChannel, m_nChannels,
+			nChannels, samplesToWrite);
+
+		writtenSamples += samplesToWrite;
+
+		//Update the last block fill index
+		size_t samplePos = startIdx + samplesToWrite;
+		if (bIndex == lastBlockIdx && samplePos > m_lastBlockFill)
+		{
+			m_lastBlockFill = samplePos;
+		}
+
+		startIdx = 0;
+		bIndex++;
+	}
+	for (int i = 0; i < nChannels; i++)
+		m_currentBlock.set(firstChannel + i, bIndex - 1);
+	return true;
+}
+
+int SequentialBlockFile::getBlockIndex(uint64 startPos, int nSamples)
+{
+	int bIndex = m_memBlocks.size() - 1;
+	if ((bIndex < 0) || (m_memBlocks[bIndex]->getOffset() + m_samplesPerBlock) < (startPos + nSamples))
+		allocateBlocks(startPos, nSamples);
+
+	for (bIndex = m_memBlocks.size() - 1; bIndex >= 0; bIndex--)
+	{
+		if (m_memBlocks[bIndex]->getOffset() <= startPos)
+			break;
+	}
+	return bIndex;
+}
+
 void SequentialBlockFile::allocateBlocks(uint64 startIndex, int numSamples)
 {
 	//First deallocate full blocks
@@ -163,7 +337,7 @@ void SequentialBlockFile::allocateBlocks(uint64 startIndex, int numSamples)
 	for (int i = 0; i < newBlocks; i++)
 	{
 		lastOffset += m_samplesPerBlock;
-		m_memBlocks.add(new FileBlock(m_file, m_blockSize, lastOffset));
+		m_memBlocks.add(new FileBlock(m_file, m_writer, m_blockSize, lastOffset));
 	}
 	if (newBlocks > 0)
 		m_lastBlockFill = 0; //we've added some new blocks, so the last one will be empty
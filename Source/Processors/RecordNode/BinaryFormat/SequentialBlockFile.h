@@ -9,14 +9,25 @@ typedef FileMemoryBlock<int16> FileBlock;
 class SequentialBlockFile
 {
 public:
-	SequentialBlockFile(int nChannels, int samplesPerBlock);
+	/** If writer is not null, full blocks are written from its I/O thread */
+	SequentialBlockFile(int nChannels, int samplesPerBlock, AsyncBlockWriter* writer = nullptr);
 	~SequentialBlockFile();
 
-	bool openFile(String filename);
+	/** When indexBlocks is set, every block written is also logged to a sidecar .blocks index, see BlockOutputFile */
+	bool openFile(String filename, BlockOutputFile::OutputMode mode = BlockOutputFile::BUFFERED, bool indexBlocks = false);
+
+	/** Uses an already opened output, such as a CompressedOutputFile. Takes ownership of it */
+	bool openFile(BlockOutputFile* file);
 	bool writeChannel(uint64 startPos, int channel, int16* data, int nSamples);
 
+	/** Writes a block of consecutive channels at once. data holds nChannels planar rows of
+	at least nSamples each, separated by dataStride samples. The rows are transposed into
+	the interleaved file layout in tiles, which is much cheaper than writing them one by one. */
+	bool writeChannelBlock(uint64 startPos, int firstChannel, int nChannels, const int16* data, int dataStride, int nSamples);
+
 private:
-	ScopedPointer<FileOutputStream> m_file;
+	ScopedPointer<BlockOutputFile> m_file;
+	AsyncBlockWriter* const m_writer;
 	const int m_nChannels;
 	const int m_samplesPerBlock;
 	const int m_blockSize;
@@ -26,8 +37,10 @@ private:
 
 	void allocateBlocks(uint64 startIndex, int numSamples);
 
+	/** Finds the memory block holding startPos, allocating new ones if needed. Returns -1 if it was already flushed */
+	int getBlockIndex(uint64 startPos, int nSamples);
+
 	//Compile-time params
-	const int streamBufferSize{ 0 };
 	const int blockArrayInitSize{ 128 };
 
 };
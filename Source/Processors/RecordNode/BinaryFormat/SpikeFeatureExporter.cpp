@@ -0,0 +1,310 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "SpikeFeatureExporter.h"
+
+SpikeFeatureExporter::SpikeFeatureExporter()
+	: Thread("Spike Feature Exporter"),
+	m_queue(SPIKE_EXPORT_QUEUE_SIZE)
+{
+}
+
+SpikeFeatureExporter::~SpikeFeatureExporter()
+{
+	stop();
+}
+
+int SpikeFeatureExporter::addGroup(const String& folder, int numChannels, int numSamples, int numFeatures, float bitVolts)
+{
+	jassert(!isThreadRunning());
+
+	Group* group = new Group();
+	group->folder = folder;
+	group->numChannels = numChannels;
+	group->numSamples = numSamples;
+	group->numFeatures = numFeatures;
+	group->bitVolts = bitVolts;
+	group->recordSize = sizeof(SpikeHeader) + numFeatures * sizeof(float) + numChannels * numSamples * sizeof(int16);
+	group->featureFile = new NpyFile(File(folder).getChildFile("spike_features.npy").getFullPathName(),
+		NpyType(BaseType::FLOAT, numFeatures));
+	group->features.malloc(numFeatures);
+	group->changed = false;
+
+	m_groups.add(group);
+	return m_groups.size() - 1;
+}
+
+void SpikeFeatureExporter::start()
+{
+	if (m_groups.size() == 0)
+		return;
+
+	int waveformSamples = 0;
+	for (auto group : m_groups)
+		waveformSamples = jmax(waveformSamples, group->numChannels * group->numSamples);
+
+	m_waveform.malloc(waveformSamples);
+	m_queueData.malloc(SPIKE_EXPORT_QUEUE_SIZE);
+	m_queue.reset();
+
+	startThread();
+}
+
+void SpikeFeatureExporter::queueSpike(int groupIndex, uint16 electrode, uint16 sortedId, const float* features, const int16* waveform)
+{
+	if (!isThreadRunning())
+		return;
+
+	const Group& group = *m_groups[groupIndex];
+	const size_t featureBytes = features ? group.numFeatures * sizeof(float) : 0;
+	const size_t waveformBytes = group.numChannels * group.numSamples * sizeof(int16);
+	const int recordSize = int(sizeof(SpikeHeader) + featureBytes + waveformBytes);
+
+	//Every spike must get its row of features, so a full queue holds the RecordThread instead of dropping it
+	while (m_queue.getFreeSpace() < recordSize)
+	{
+		if (!isThreadRunning())
+			return;
+		m_spikeTaken.wait(100);
+	}
+
+	SpikeHeader header;
+	header.group = groupIndex;
+	header.electrode = electrode;
+	header.sortedId = sortedId;
+	header.hasFeatures = features != nullptr;
+
+	int start1, size1, start2, size2;
+	m_queue.prepareToWrite(recordSize, start1, size1, start2, size2);
+
+	int written = 0;
+	auto copyToQueue = [&](const void* data, size_t size)
+	{
+		const char* source = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			bool inFirst = written < size1;
+			int offset = inFirst ? start1 + written : start2 + written - size1;
+			size_t chunk = jmin(size, size_t(inFirst ? size1 - written : size2 - (written - size1)));
+
+			memcpy(m_queueData + offset, source, chunk);
+			source += chunk;
+			size -= chunk;
+			written += int(chunk);
+		}
+	};
+
+	copyToQueue(&header, sizeof(header));
+	if (features)
+		copyToQueue(features, featureBytes);
+	copyToQueue(waveform, waveformBytes);
+
+	m_queue.finishedWrite(recordSize);
+	m_spikeQueued.signal();
+}
+
+void SpikeFeatureExporter::stop()
+{
+	if (isThreadRunning())
+	{
+		signalThreadShouldExit();
+		m_spikeQueued.signal();
+		waitForThreadToExit(-1);
+	}
+
+	m_groups.clear();
+	m_queueData.free();
+}
+
+void SpikeFeatureExporter::run()
+{
+	uint32 nextSummary = Time::getMillisecondCounter() + SPIKE_SUMMARY_INTERVAL;
+
+	while (true)
+	{
+		//The queue is emptied before exiting, so every queued spike is exported
+		bool exiting = threadShouldExit();
+
+		if (exportSpike())
+		{
+			m_spikeTaken.signal();
+			continue;
+		}
+
+		for (auto group : m_groups)
+			if (group->featureFile) group->featureFile->flush();
+
+		if (exiting)
+			break;
+
+		if (Time::getMillisecondCounter() >= nextSummary)
+		{
+			writeSummaries();
+			nextSummary = Time::getMillisecondCounter() + SPIKE_SUMMARY_INTERVAL;
+		}
+
+		m_spikeQueued.wait(100);
+	}
+
+	for (auto group : m_groups)
+		group->featureFile = nullptr;
+
+	writeSummaries();
+}
+
+void SpikeFeatureExporter::readFromQueue(void* dest, size_t size)
+{
+	int start1, size1, start2, size2;
+	m_queue.prepareToRead(int(size), start1, size1, start2, size2);
+
+	memcpy(dest, m_queueData + start1, size1);
+	if (size2 > 0)
+		memcpy(static_cast<char*>(dest) + size1, m_queueData + start2, size2);
+
+	m_queue.finishedRead(size1 + size2);
+}
+
+bool SpikeFeatureExporter::exportSpike()
+{
+	//A spike is queued whole, so once its header is ready the rest of it is too
+	if (m_queue.getNumReady() < int(sizeof(SpikeHeader)))
+		return false;
+
+	SpikeHeader header;
+	readFromQueue(&header, sizeof(header));
+
+	Group& group = *m_groups[header.group];
+	const int waveformSamples = group.numChannels * group.numSamples;
+
+	if (header.hasFeatures)
+		readFromQueue(group.features, group.numFeatures * sizeof(float));
+	readFromQueue(m_waveform, waveformSamples * sizeof(int16));
+
+	if (!header.hasFeatures)
+	{
+		//Without projections, the features are the troughs of the channels
+		for (int ch = 0; ch < group.numFeatures; ch++)
+		{
+			const int16* samples = m_waveform + ch * group.numSamples;
+			int16 trough = samples[0];
+			for (int i = 1; i < group.numSamples; i++)
+				trough = jmin(trough, samples[i]);
+			group.features[ch] = trough * group.bitVolts;
+		}
+	}
+
+	if (group.featureFile)
+	{
+		group.featureFile->writeData(group.features, group.numFeatures * sizeof(float));
+		group.featureFile->increaseRecordCount();
+	}
+
+	addToUnit(group, header.electrode, header.sortedId, m_waveform);
+	return true;
+}
+
+void SpikeFeatureExporter::addToUnit(Group& group, uint16 electrode, uint16 sortedId, const int16* waveform)
+{
+	const uint32 key = (uint32(electrode) << 16) | sortedId;
+	const int waveformSamples = group.numChannels * group.numSamples;
+
+	auto found = group.unitIndexes.find(key);
+	Unit* unit;
+
+	if (found == group.unitIndexes.end())
+	{
+		unit = new Unit();
+		unit->electrode = electrode;
+		unit->sortedId = sortedId;
+		unit->count = 0;
+		unit->mean.calloc(waveformSamples);
+		unit->m2.calloc(waveformSamples);
+
+		group.unitIndexes[key] = group.units.size();
+		group.units.add(unit);
+	}
+	else
+	{
+		unit = group.units[found->second];
+	}
+
+	//Welford's running mean and variance
+	unit->count++;
+	for (int i = 0; i < waveformSamples; i++)
+	{
+		double value = waveform[i] * double(group.bitVolts);
+		double delta = value - unit->mean[i];
+		unit->mean[i] += delta / unit->count;
+		unit->m2[i] += delta * (value - unit->mean[i]);
+	}
+
+	group.changed = true;
+}
+
+void SpikeFeatureExporter::writeSummaries()
+{
+	for (auto group : m_groups)
+	{
+		if (group->changed)
+		{
+			writeSummary(*group);
+			group->changed = false;
+		}
+	}
+}
+
+void SpikeFeatureExporter::writeSummary(Group& group)
+{
+	const File folder(group.folder);
+	const String names[3] = { "waveform_summary_means.npy", "waveform_summary_stds.npy", "waveform_summary_units.npy" };
+	const int waveformSamples = group.numChannels * group.numSamples;
+
+	//Written aside and moved in place, so readers never see a half-written summary
+	{
+		NpyFile means(folder.getChildFile(names[0] + ".tmp").getFullPathName(), NpyType(BaseType::FLOAT, group.numSamples), group.numChannels);
+		NpyFile stds(folder.getChildFile(names[1] + ".tmp").getFullPathName(), NpyType(BaseType::FLOAT, group.numSamples), group.numChannels);
+		NpyFile units(folder.getChildFile(names[2] + ".tmp").getFullPathName(), NpyType(BaseType::INT64, 3));
+		HeapBlock<float> row(waveformSamples);
+
+		for (auto unit : group.units)
+		{
+			for (int i = 0; i < waveformSamples; i++)
+				row[i] = float(unit->mean[i]);
+			means.writeData(row, waveformSamples * sizeof(float));
+			means.increaseRecordCount();
+
+			for (int i = 0; i < waveformSamples; i++)
+				row[i] = float(std::sqrt(unit->m2[i] / jmax(int64(1), unit->count - 1)));
+			stds.writeData(row, waveformSamples * sizeof(float));
+			stds.increaseRecordCount();
+
+			int64 record[3] = { unit->electrode, unit->sortedId, unit->count };
+			units.writeData(record, sizeof(record));
+			units.increaseRecordCount();
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		folder.getChildFile(names[i] + ".tmp").moveFileTo(folder.getChildFile(names[i]));
+}
@@ -0,0 +1,127 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SPIKEFEATUREEXPORTER_H
+#define SPIKEFEATUREEXPORTER_H
+
+#include "NpyFile.h"
+#include <map>
+
+/** Size of the queue of spikes waiting for the exporter thread, in bytes */
+#define SPIKE_EXPORT_QUEUE_SIZE (16 * 1024 * 1024)
+
+/** Time between two rewrites of the waveform summaries, in milliseconds */
+#define SPIKE_SUMMARY_INTERVAL 10000
+
+/** Writes sidecar files to the spike group folders while recording, so offline sorters can
+	warm-start from them instead of starting from scratch once the session ends:
+
+	spike_features.npy - one row per spike, in the order of spike_times.npy: the projections on
+		the principal components if the spike channels carry them (SPIKE_PCA_METADATA_ID), or
+		else the trough of each channel, in microvolts
+	waveform_summary_units.npy - (electrode index, sorted id, number of spikes) of each unit so far
+	waveform_summary_means.npy, waveform_summary_stds.npy - mean and standard deviation of the
+		waveforms of each of those units, in microvolts
+
+	The RecordThread only copies each spike into a lock-free queue. The exporter thread appends the
+	features and updates the running statistics of the units, and rewrites the summaries every
+	SPIKE_SUMMARY_INTERVAL and when it stops.
+*/
+class SpikeFeatureExporter : public Thread
+{
+public:
+	SpikeFeatureExporter();
+	~SpikeFeatureExporter();
+
+	/** Adds the group of spike electrodes written to a folder, and returns its index. The waveforms
+		are numChannels by numSamples int16 counts of bitVolts. Call before start() */
+	int addGroup(const String& folder, int numChannels, int numSamples, int numFeatures, float bitVolts);
+
+	void start();
+
+	/** Queues a spike of an electrode of a group, with numFeatures features, or nullptr to derive them
+		from the waveform. Waits for room if the queue is full, so the features stay aligned with the spikes */
+	void queueSpike(int group, uint16 electrode, uint16 sortedId, const float* features, const int16* waveform);
+
+	/** Exports the spikes still queued, writes the final summaries and clears the groups */
+	void stop();
+
+	void run() override;
+
+private:
+	struct Unit
+	{
+		uint16 electrode;
+		uint16 sortedId;
+		int64 count;
+		HeapBlock<double> mean;
+		HeapBlock<double> m2;		// sums of squared deviations from the mean
+	};
+
+	struct Group
+	{
+		String folder;
+		int numChannels;
+		int numSamples;
+		int numFeatures;
+		float bitVolts;
+		size_t recordSize;
+		ScopedPointer<NpyFile> featureFile;
+		OwnedArray<Unit> units;
+		std::map<uint32, int> unitIndexes;
+		HeapBlock<float> features;
+		bool changed;
+	};
+
+	struct SpikeHeader
+	{
+		int32 group;
+		uint16 electrode;
+		uint16 sortedId;
+		int32 hasFeatures;
+	};
+
+	/** Takes the next spike out of the queue and exports it. Returns false if there is none */
+	bool exportSpike();
+
+	void readFromQueue(void* dest, size_t size);
+
+	/** Adds a waveform to the running statistics of its unit */
+	void addToUnit(Group& group, uint16 electrode, uint16 sortedId, const int16* waveform);
+
+	/** Rewrites the summaries of the groups whose units changed */
+	void writeSummaries();
+	void writeSummary(Group& group);
+
+	OwnedArray<Group> m_groups;
+
+	AbstractFifo m_queue;
+	HeapBlock<char> m_queueData;
+	WaitableEvent m_spikeQueued;
+	WaitableEvent m_spikeTaken;
+	HeapBlock<int16> m_waveform;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpikeFeatureExporter);
+};
+
+#endif // SPIKEFEATUREEXPORTER_H
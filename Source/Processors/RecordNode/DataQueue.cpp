@@ -22,33 +22,40 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "DataQueue.h"
+#include "BinaryFormat/SampleConversion.h"
+#include "../../Utils/RealtimeLog.h"
 
 DataQueue::DataQueue(int blockSize, int nBlocks) :
 	m_buffer(0, blockSize*nBlocks),
+	m_int16Channels(nullptr),
 	m_numChans(0),
+	m_numSyncChans(0),
 	m_blockSize(blockSize),
 	m_readInProgress(false),
 	m_numBlocks(nBlocks),
-	m_maxSize(blockSize*nBlocks)
+	m_maxSize(blockSize*nBlocks),
+	m_triggered(false),
+	m_holdSamples(0)
 {}
 
 DataQueue::~DataQueue()
 {}
 
-void DataQueue::setFTSChannels(int nChans)
+void DataQueue::setSyncChannels(int nChans)
 {
 	if (m_readInProgress)
 		return;
 
-	m_FTSFifos.clear();
-	m_readFTSSamples.clear();
-	m_numFTSChans = nChans;
+	m_segmentFifos.clear();
+	m_readSegments.clear();
+	m_numSyncChans = nChans;
 
 	for (int i = 0; i < nChans; ++i)
 	{
-		m_FTSFifos.add(new AbstractFifo(m_maxSize));
+		m_segmentFifos.add(new AbstractFifo(SYNC_SEGMENT_QUEUE_SIZE));
+		m_readSegments.add(0);
 	}
-	m_FTSBuffer.setSize(nChans, m_maxSize);
+	m_segments.malloc(jmax(nChans, 1) * SYNC_SEGMENT_QUEUE_SIZE);
 }
 
 void DataQueue::setChannels(int nChans)
@@ -57,7 +64,10 @@ void DataQueue::setChannels(int nChans)
 		return;
 
 	m_fifos.clear();
+	m_windowFifos.clear();
 	m_readSamples.clear();
+	m_channelGroups.clear();
+	m_groupReady.clear();
 	m_numChans = nChans;
 	m_timestamps.clear();
 	m_lastReadTimestamps.clear();
@@ -65,15 +75,32 @@ void DataQueue::setChannels(int nChans)
 	for (int i = 0; i < nChans; ++i)
 	{
 		m_fifos.add(new AbstractFifo(m_maxSize));
+		m_windowFifos.add(new AbstractFifo(TRIGGER_WINDOW_QUEUE_SIZE));
 		m_readSamples.add(0);
 		m_timestamps.add(new Array<int64>());
 		m_timestamps.getLast()->resize(m_numBlocks);
 		m_lastReadTimestamps.add(0);
 	}
-	m_buffer.setSize(nChans, m_maxSize);
+	allocateStorage(m_maxSize);
+	m_droppedSamples.calloc(jmax(nChans, 1));
+	m_windows.malloc(jmax(nChans, 1) * TRIGGER_WINDOW_QUEUE_SIZE);
 
 }
 
+void DataQueue::setChannelGroups(const Array<int>& groups)
+{
+	if (m_readInProgress)
+		return;
+
+	m_channelGroups = groups;
+	m_groupReady.clear();
+
+	int numGroups = 0;
+	for (auto group : groups)
+		numGroups = jmax(numGroups, group + 1);
+	m_groupReady.insertMultiple(0, 0, numGroups);
+}
+
 void DataQueue::resize(int nBlocks)
 {
 	if (m_readInProgress)
@@ -87,19 +114,75 @@ void DataQueue::resize(int nBlocks)
 	{
 		m_fifos[i]->setTotalSize(size);
 		m_fifos[i]->reset();
+		m_windowFifos[i]->reset();
 		m_readSamples.set(i, 0);
 		m_timestamps[i]->resize(nBlocks);
 		m_lastReadTimestamps.set(i, 0);
 	}
 
-	for (int i = 0; i < m_numFTSChans; ++i)
+	for (int i = 0; i < m_numSyncChans; ++i)
+	{
+		m_readSegments.set(i, 0);
+		m_segmentFifos[i]->reset();
+	}
+	allocateStorage(size);
+}
+
+void DataQueue::allocateStorage(int size)
+{
+	if (m_int16Scales.size() < m_numChans || m_numChans == 0)
+	{
+		m_int16Channels = nullptr;
+		m_buffer.setDataToReferTo(m_memory.allocateChannels(m_numChans, size), m_numChans, size);
+	}
+	else
 	{
-		m_readFTSSamples.set(i,0);
-		m_FTSFifos[i]->setTotalSize(size);
-		m_FTSFifos[i]->reset();
+		m_buffer.setSize(0, 0);
+		m_int16Channels = m_memory.allocateInt16Channels(m_numChans, size);
 	}
-	m_buffer.setSize(m_numChans, size);
-	m_FTSBuffer.setSize(m_numFTSChans, size);
+}
+
+void DataQueue::prefault()
+{
+	m_memory.prefault();
+}
+
+void DataQueue::setInt16Samples(const Array<float>& bitVolts)
+{
+	if (m_readInProgress)
+		return;
+
+	/* The same scaling the engines use to write int16 samples */
+	m_int16Scales.clearQuick();
+	for (float bv : bitVolts)
+		m_int16Scales.add(1.0f / (float(0x7fff) * bv));
+}
+
+bool DataQueue::usesInt16Samples() const
+{
+	return m_int16Channels != nullptr;
+}
+
+void DataQueue::setTriggeredRecording(bool triggered, int holdSamples)
+{
+	if (m_readInProgress)
+		return;
+
+	m_triggered = triggered;
+	m_holdSamples = triggered ? jlimit(0, m_maxSize, holdSamples) : 0;
+
+	for (auto fifo : m_windowFifos)
+		fifo->reset();
+}
+
+bool DataQueue::isTriggeredRecording() const
+{
+	return m_triggered;
+}
+
+void DataQueue::releaseHeldSamples()
+{
+	m_holdSamples = 0;
 }
 
 void DataQueue::fillTimestamps(int channel, int index, int size, int64 timestamp)
@@ -134,43 +217,41 @@ void DataQueue::fillTimestamps(int channel, int index, int size, int64 timestamp
 	}
 }
 
-float DataQueue::writeSynchronizedTimestampChannel(double start, double step, int destChannel, int64 nSamples)
+bool DataQueue::writeSyncSegment(const SyncSegment& segment, int destChannel)
 {
-
 	int index1, size1, index2, size2;
+	m_segmentFifos[destChannel]->prepareToWrite(1, index1, size1, index2, size2);
 
-	m_FTSFifos[destChannel]->prepareToWrite(nSamples, index1, size1, index2, size2);
-
-	//LOGD("nFTSChannels=", m_FTSFifos.size(), " destChannel=", destChannel, " index1: ", index1, " size1=", size1, " size2=", size2);
-
-	if ((size1 + size2) < nSamples)
+	if (size1 + size2 < 1)
 	{
-		LOGD(__FUNCTION__, " Recording Data Queue Overflow: sz1: ", size1, " sz2: ", size2, " nSamples: ", nSamples);
+		LOGRT(__FUNCTION__, " Synchronized timestamp segment queue full on channel ", destChannel);
+		return false;
 	}
 
-	//LOGD("DataQueue::writeSynchronizedTimestampChannel: ", start);
+	m_segments[destChannel * SYNC_SEGMENT_QUEUE_SIZE + (size1 > 0 ? index1 : index2)] = segment;
+	m_segmentFifos[destChannel]->finishedWrite(1);
 
-	for (int i = 0; i < size1; i++)
-	{
-		//LOGD("setSample: ", start + (float)i*step);
-		m_FTSBuffer.setSample(destChannel, index1+i, start+(double)i*step);
-		//LOGD("Set sample ", index1+i, " to ", start);
-		//m_FTSBuffer.setSample(destChannel, index1+i, start + (float)i*step);
-	}
+	return true;
+}
 
-	if (size2 > 0)
+
+bool DataQueue::writeTriggerWindow(int channel, int64 start, int64 end)
+{
+	int index1, size1, index2, size2;
+	m_windowFifos[channel]->prepareToWrite(1, index1, size1, index2, size2);
+
+	if (size1 + size2 < 1)
 	{
-		for (int i = 0; i < size2; i++)
-		{
-			//m_FTSBuffer.setSample(destChannel, index2+i, start + (float)i*step);
-			m_FTSBuffer.setSample(destChannel, index2 + i, start+(double)size1*step + double(i*step));
-		}
+		LOGRT(__FUNCTION__, " Trigger window queue full on channel ", channel);
+		return false;
 	}
 
-	m_FTSFifos[destChannel]->finishedWrite(size1 + size2);
-
-	return 1.0f - (float)m_FTSFifos[destChannel]->getFreeSpace() / (float)m_FTSFifos[destChannel]->getTotalSize();
+	TriggerWindow& window = m_windows[channel * TRIGGER_WINDOW_QUEUE_SIZE + (size1 > 0 ? index1 : index2)];
+	window.start = start;
+	window.end = end;
+	m_windowFifos[channel]->finishedWrite(1);
 
+	return true;
 }
 
 
@@ -180,30 +261,43 @@ float DataQueue::writeChannel(const AudioSampleBuffer& buffer, int srcChannel, i
 	m_fifos[destChannel]->prepareToWrite(nSamples, index1, size1, index2, size2);
 
 	if ((size1 + size2) < nSamples)
-	{ //TODO: turn this into a proper notification. Probably returning a bool.
-		//std::cerr << "Recording Data Queue Overflow" << std::endl;
-		LOGD(__FUNCTION__, " Recording Data Queue Overflow: sz1: ", size1, " sz2: ", size2, " nSamples: ", nSamples);
+	{
+		m_droppedSamples[destChannel] += nSamples - (size1 + size2);
+		LOGRT(__FUNCTION__, " Recording Data Queue Overflow: sz1: ", size1, " sz2: ", size2, " nSamples: ", nSamples);
 	}
-	m_buffer.copyFrom(destChannel,
-		index1,
-		buffer,
-		srcChannel,
-		0,
-		size1);
 
-	fillTimestamps(destChannel, index1, size1, timestamp);
+	if (m_int16Channels != nullptr)
+	{
+		const float* source = buffer.getReadPointer(srcChannel);
+		const float scale = m_int16Scales[destChannel];
 
-	if (size2 > 0)
+		convertFloatToInt16Scaled(source, m_int16Channels[destChannel] + index1, scale, size1);
+		if (size2 > 0)
+			convertFloatToInt16Scaled(source + size1, m_int16Channels[destChannel] + index2, scale, size2);
+	}
+	else
 	{
 		m_buffer.copyFrom(destChannel,
-			index2,
+			index1,
 			buffer,
 			srcChannel,
-			size1,
-			size2);
+			0,
+			size1);
 
-		fillTimestamps(destChannel, index2, size2, timestamp + size1);
+		if (size2 > 0)
+		{
+			m_buffer.copyFrom(destChannel,
+				index2,
+				buffer,
+				srcChannel,
+				size1,
+				size2);
+		}
 	}
+
+	fillTimestamps(destChannel, index1, size1, timestamp);
+	if (size2 > 0)
+		fillTimestamps(destChannel, index2, size2, timestamp + size1);
 	m_fifos[destChannel]->finishedWrite(size1 + size2);
 
 	return 1.0f - (float)m_fifos[destChannel]->getFreeSpace() / (float)m_fifos[destChannel]->getTotalSize();
@@ -221,12 +315,55 @@ const AudioSampleBuffer& DataQueue::getAudioBufferReference() const
 	return m_buffer;
 }
 
-const SynchronizedTimestampBuffer& DataQueue::getFTSBufferReference() const
+const int16* DataQueue::getInt16ReadPointer(int channel, int index) const
 {
-	return m_FTSBuffer;
+	return m_int16Channels[channel] + index;
 }
 
-bool DataQueue::startSynchronizedRead(Array<CircularBufferIndexes>& dataIndexes, Array<CircularBufferIndexes>& ftsIndexes, Array<int64>& timestamps, int nMax)
+void DataQueue::getReadSpans(const Array<CircularBufferIndexes>& indexes, Array<ChannelSpan>& spans)
+{
+	spans.clearQuick();
+
+	const int nChans = indexes.size();
+	int chan = 0;
+
+	while (chan < nChans)
+	{
+		const CircularBufferIndexes& idx = indexes.getReference(chan);
+		int run = 1;
+
+		while (chan + run < nChans)
+		{
+			const CircularBufferIndexes& next = indexes.getReference(chan + run);
+			if (next.index1 != idx.index1 || next.size1 != idx.size1
+				|| next.index2 != idx.index2 || next.size2 != idx.size2)
+				break;
+			run++;
+		}
+
+		spans.add({ chan, run });
+		chan += run;
+	}
+}
+
+void DataQueue::getReadPointers(int firstChannel, int numChannels, int index, const float** pointers) const
+{
+	for (int i = 0; i < numChannels; i++)
+		pointers[i] = m_buffer.getReadPointer(firstChannel + i) + index;
+}
+
+void DataQueue::getInt16ReadPointers(int firstChannel, int numChannels, int index, const int16** pointers) const
+{
+	for (int i = 0; i < numChannels; i++)
+		pointers[i] = m_int16Channels[firstChannel + i] + index;
+}
+
+const SyncSegment& DataQueue::getSyncSegment(int channel, int index) const
+{
+	return m_segments[channel * SYNC_SEGMENT_QUEUE_SIZE + index];
+}
+
+bool DataQueue::startSynchronizedRead(Array<CircularBufferIndexes>& dataIndexes, Array<CircularBufferIndexes>& segmentIndexes, Array<int64>& timestamps, int nMax)
 {
 
 	//This should never happen, but it never hurts to be on the safe side.
@@ -235,48 +372,18 @@ bool DataQueue::startSynchronizedRead(Array<CircularBufferIndexes>& dataIndexes,
 
 	m_readInProgress = true;
 	dataIndexes.clear();
-	ftsIndexes.clear();
+	segmentIndexes.clear();
 	timestamps.clear();
 
-	for (int chan = 0; chan < m_numChans; ++chan)
-	{
-		CircularBufferIndexes idx;
-		int readyToRead = m_fifos[chan]->getNumReady();
-		int samplesToRead = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
-
-		m_fifos[chan]->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
-		dataIndexes.add(idx);
-		m_readSamples.set(chan, idx.size1 + idx.size2);
+	prepareRead(dataIndexes, timestamps, nMax);
 
-		int blockMod = idx.index1 % m_blockSize;
-		int blockDiff = (blockMod == 0) ? 0 : (m_blockSize - blockMod);
-
-		//If the next timestamp block is within the data we're reading, include the translated timestamp in the output
-		int64 ts;
-		if (blockDiff < (idx.size1 + idx.size2))
-		{
-			int blockIdx = ((idx.index1 + blockDiff) / m_blockSize) % m_numBlocks;
-			ts = m_timestamps[chan]->getUnchecked(blockIdx) - blockDiff;
-		}
-		//If not, copy the last sent again 
-		else
-		{
-			ts = m_lastReadTimestamps[chan];
-		}
-		timestamps.add(ts);
-		m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
-	}
-
-	for (int chan = 0; chan < m_numFTSChans; ++chan)
+	//Segments are few, so all the queued ones are read regardless of nMax
+	for (int chan = 0; chan < m_numSyncChans; ++chan)
 	{
 		CircularBufferIndexes idx;
-		int readyToRead = m_FTSFifos[chan]->getNumReady();
-		int samplesToRead = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
-
-		m_FTSFifos[chan]->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
-		//LOGD("idx1: ", idx.index1, " | s1: ", idx.size1, " | idx2: ", idx.index2, " | s2: ", idx.size2);
-		ftsIndexes.add(idx);
-		m_readFTSSamples.set(chan, idx.size1 + idx.size2);
+		m_segmentFifos[chan]->prepareToRead(m_segmentFifos[chan]->getNumReady(), idx.index1, idx.size1, idx.index2, idx.size2);
+		segmentIndexes.add(idx);
+		m_readSegments.set(chan, idx.size1 + idx.size2);
 	}
 
 	return true;
@@ -292,38 +399,110 @@ bool DataQueue::startRead(Array<CircularBufferIndexes>& indexes, Array<int64>& t
 	indexes.clear(); //Just in case it's not empty already
 	timestamps.clear();
 
+	prepareRead(indexes, timestamps, nMax);
+
+	return true;
+}
+
+void DataQueue::prepareRead(Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax)
+{
+	/* The producer writes the channels of a subprocessor one after the other, so each group is read up to
+	what all its channels have. Triggered reads follow the windows of each channel instead */
+	const bool grouped = !m_triggered && m_channelGroups.size() == m_numChans;
+
+	if (grouped)
+	{
+		for (int group = 0; group < m_groupReady.size(); ++group)
+			m_groupReady.set(group, m_maxSize);
+
+		for (int chan = 0; chan < m_numChans; ++chan)
+		{
+			const int group = m_channelGroups[chan];
+			m_groupReady.set(group, jmin(m_groupReady[group], m_fifos[chan]->getNumReady()));
+		}
+	}
+
 	for (int chan = 0; chan < m_numChans; ++chan)
 	{
-		CircularBufferIndexes idx;
-		int readyToRead = m_fifos[chan]->getNumReady();
-		int samplesToRead = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
+		const int readyToRead = grouped ? m_groupReady[m_channelGroups[chan]] : m_fifos[chan]->getNumReady();
 
-		m_fifos[chan]->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
+		CircularBufferIndexes idx;
+		timestamps.add(prepareChannelRead(chan, readyToRead, nMax, idx));
 		indexes.add(idx);
-		m_readSamples.set(chan, idx.size1 + idx.size2);
+	}
+}
 
-		int blockMod = idx.index1 % m_blockSize;
-		int blockDiff = (blockMod == 0) ? 0 : (m_blockSize - blockMod);
+int64 DataQueue::prepareChannelRead(int chan, int readyToRead, int nMax, CircularBufferIndexes& idx)
+{
+	if (m_triggered)
+		readyToRead = skipToTriggerWindow(chan, readyToRead - m_holdSamples);
 
-		//If the next timestamp block is within the data we're reading, include the translated timestamp in the output
-		if (blockDiff < (idx.size1 + idx.size2))
-		{
-			int blockIdx = ((idx.index1 + blockDiff) / m_blockSize) % m_numBlocks;
-			int64 ts = m_timestamps[chan]->getUnchecked(blockIdx) - blockDiff;
-			timestamps.add(ts);
-			//update to the end of the block
-			m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
-		}
-		//If not, copy the last sent again 
-		else
+	int samplesToRead = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
+
+	m_fifos[chan]->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
+	m_readSamples.set(chan, idx.size1 + idx.size2);
+
+	int64 ts = getReadTimestamp(chan, idx.index1, idx.size1 + idx.size2);
+	//update to the end of the block
+	m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
+
+	return ts;
+}
+
+int64 DataQueue::getReadTimestamp(int chan, int index, int size) const
+{
+	int blockMod = index % m_blockSize;
+	int blockDiff = (blockMod == 0) ? 0 : (m_blockSize - blockMod);
+
+	//If the next timestamp block is within the data we're reading, translate its timestamp
+	if (blockDiff < size)
+	{
+		int blockIdx = ((index + blockDiff) / m_blockSize) % m_numBlocks;
+		return m_timestamps[chan]->getUnchecked(blockIdx) - blockDiff;
+	}
+	//If not, continue from the last read
+	return m_lastReadTimestamps[chan];
+}
+
+int DataQueue::skipToTriggerWindow(int chan, int numReadable)
+{
+	if (numReadable <= 0)
+		return 0;
+
+	AbstractFifo* fifo = m_fifos[chan];
+	AbstractFifo* windowFifo = m_windowFifos[chan];
+
+	int index1, size1, index2, size2;
+	fifo->prepareToRead(numReadable, index1, size1, index2, size2);
+	const int64 first = getReadTimestamp(chan, index1, numReadable);
+
+	int64 skip = numReadable;
+	int64 covered = 0;
+
+	while (windowFifo->getNumReady() > 0)
+	{
+		windowFifo->prepareToRead(1, index1, size1, index2, size2);
+		const TriggerWindow& window = m_windows[chan * TRIGGER_WINDOW_QUEUE_SIZE + (size1 > 0 ? index1 : index2)];
+
+		//Windows are queued in order, so one that ended before the readable samples is done with
+		if (window.end <= first)
 		{
-			int64 ts = m_lastReadTimestamps[chan];
-			timestamps.add(ts);
-			m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
+			windowFifo->finishedRead(1);
+			continue;
 		}
+
+		skip = jlimit(int64(0), int64(numReadable), window.start - first);
+		covered = jmin(int64(numReadable), window.end - first) - skip;
+		break;
 	}
 
-	return true;
+	if (skip > 0)
+	{
+		fifo->finishedRead(int(skip));
+		m_lastReadTimestamps.set(chan, first + skip);
+	}
+
+	return int(covered);
 }
 
 void DataQueue::stopSynchronizedRead()
@@ -337,10 +516,10 @@ void DataQueue::stopSynchronizedRead()
 		m_readSamples.set(i, 0);
 	}
 
-	for (int i = 0; i < m_numFTSChans; ++i)
+	for (int i = 0; i < m_numSyncChans; ++i)
 	{
-		m_FTSFifos[i]->finishedRead(m_readFTSSamples[i]);
-		m_readFTSSamples.set(i, 0);
+		m_segmentFifos[i]->finishedRead(m_readSegments[i]);
+		m_readSegments.set(i, 0);
 	}
 
 	m_readInProgress = false;
@@ -367,4 +546,45 @@ void DataQueue::getTimestampsForBlock(int idx, Array<int64>& timestamps) const
 	{
 		timestamps.add((*m_timestamps[chan])[idx]);
 	}
-}
\ No newline at end of file
+}
+
+int DataQueue::getNumReadySamples() const
+{
+	int ready = 0;
+	for (auto fifo : m_fifos)
+		ready = jmax(ready, fifo->getNumReady() - m_holdSamples);
+	return ready;
+}
+
+int DataQueue::getCapacity() const
+{
+	return m_maxSize;
+}
+
+int DataQueue::getNumBlocks() const
+{
+	return m_numBlocks;
+}
+
+void DataQueue::resetOverflowCounters()
+{
+	for (int chan = 0; chan < m_numChans; ++chan)
+		m_droppedSamples[chan] = 0;
+}
+
+int64 DataQueue::getDroppedSamples(int channel) const
+{
+	if (channel < 0 || channel >= m_numChans)
+		return 0;
+
+	return m_droppedSamples[channel].get();
+}
+
+int64 DataQueue::getTotalDroppedSamples() const
+{
+	int64 total = 0;
+	for (int chan = 0; chan < m_numChans; ++chan)
+		total += m_droppedSamples[chan].get();
+	return total;
+}
+
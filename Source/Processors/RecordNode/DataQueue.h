@@ -26,6 +26,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <JuceHeader.h>
 #include "../../Utils/Utils.h"
+#include "../../Utils/RingMemory.h"
+#include "SyncSegment.h"
+
+/* Segments each recorded subprocessor can have waiting; the fit changes about once per sync pulse */
+#define SYNC_SEGMENT_QUEUE_SIZE 256
+
+/* Trigger windows each channel can have waiting in a triggered recording */
+#define TRIGGER_WINDOW_QUEUE_SIZE 64
 
 class Synchronizer;
 
@@ -37,49 +45,135 @@ struct CircularBufferIndexes
 	int size2;
 };
 
+/** Consecutive channels of a read that share the same indexes */
+struct ChannelSpan
+{
+	int firstChannel;
+	int numChannels;
+};
+
+/** Timestamps [start, end) of a channel to record around a trigger */
+struct TriggerWindow
+{
+	int64 start;
+	int64 end;
+};
+
 class DataQueue
 {
 public:
 	DataQueue(int blockSize, int nBlocks);
 	~DataQueue();
 	void setChannels(int nChans);
-	void setFTSChannels(int nChans);
+	/** One queue of synchronized timestamp segments per recorded subprocessor */
+	void setSyncChannels(int nChans);
+	/** Groups the channels by recorded subprocessor, the group of each channel from 0 on. The
+		channels of a group are read to the same sample, so a read never catches the producer
+		between two of them. Takes effect until the next setChannels */
+	void setChannelGroups(const Array<int>& groups);
 	void resize(int nBlocks);
 	void getTimestampsForBlock(int idx, Array<int64>& timestamps) const;
+	int getNumBlocks() const;
+	void resetOverflowCounters();
+	/** Touches every page of the queue from the calling thread, which should be the one reading it */
+	void prefault();
+
+	/** Queues the samples of each channel as int16 counts of its bitVolts instead of as floats,
+		which halves the memory the queue streams through. Engines read them with
+		getInt16ReadPointer(). An empty array goes back to floats. Takes effect at the next setChannels */
+	void setInt16Samples(const Array<float>& bitVolts);
+	bool usesInt16Samples() const;
+
+	/** In a triggered recording, reads leave the newest holdSamples of every channel in the queue,
+		as a pre-trigger ring the next triggers can still reach back into, and only hand out the
+		samples inside the trigger windows. The samples no window covers are dropped unwritten. */
+	void setTriggeredRecording(bool triggered, int holdSamples);
+	bool isTriggeredRecording() const;
+	/** Lets the reads take the held samples too, for the last read of a recording */
+	void releaseHeldSamples();
 
 	//Only the methods after this comment are considered thread-safe.
 	//Caution must be had to avoid calling more than one of the methods above simulatenously
 	float writeChannel(const AudioSampleBuffer& buffer, int srcChannel, int destChannel, int nSamples, int64 timestamp);
-	float writeSynchronizedTimestampChannel(double start, double step, int destChannel, int64 nSamples);
+	/** Queues a new segment of a subprocessor's synchronized timestamps. Returns false if its queue is full */
+	bool writeSyncSegment(const SyncSegment& segment, int destChannel);
+	/** Queues the window of a trigger on a channel, before the samples it covers are written.
+		Returns false if its queue is full */
+	bool writeTriggerWindow(int channel, int64 start, int64 end);
 	bool startRead(Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax);
-	bool startSynchronizedRead(Array<CircularBufferIndexes>& dataIndexes, Array<CircularBufferIndexes>& ftsIndexes, Array<int64>& timestamps, int nMax);
+	/** Like startRead, and also reads every queued segment */
+	bool startSynchronizedRead(Array<CircularBufferIndexes>& dataIndexes, Array<CircularBufferIndexes>& segmentIndexes, Array<int64>& timestamps, int nMax);
+	/** Largest number of samples waiting to be read on any channel, the held ones excluded */
+	int getNumReadySamples() const;
+	int getCapacity() const;
 	const AudioSampleBuffer& getAudioBufferReference() const;
-	const SynchronizedTimestampBuffer& getFTSBufferReference() const;
+	/** The queued samples of a channel from index on, when usesInt16Samples() */
+	const int16* getInt16ReadPointer(int channel, int index) const;
+	/** Splits the channels of a read into spans of consecutive channels read over the same
+		ranges, whose samples can be handed to the engines together */
+	static void getReadSpans(const Array<CircularBufferIndexes>& indexes, Array<ChannelSpan>& spans);
+	/** Fills pointers with the queued samples of numChannels channels from firstChannel on, from index on */
+	void getReadPointers(int firstChannel, int numChannels, int index, const float** pointers) const;
+	/** Same as getReadPointers, when usesInt16Samples() */
+	void getInt16ReadPointers(int firstChannel, int numChannels, int index, const int16** pointers) const;
+	const SyncSegment& getSyncSegment(int channel, int index) const;
 	void stopRead();
 	void stopSynchronizedRead();
 
+	/** Number of samples of a channel dropped because the queue was full, since the last resetOverflowCounters */
+	int64 getDroppedSamples(int channel) const;
+	int64 getTotalDroppedSamples() const;
+
 private:
 	void fillTimestamps(int channel, int index, int size, int64 timestamp);
 
+	/** Prepares the read of every channel, up to nMax samples each */
+	void prepareRead(Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax);
+
+	/** Prepares the read of a channel with readyToRead samples waiting, and returns the timestamp of its first sample */
+	int64 prepareChannelRead(int channel, int readyToRead, int nMax, CircularBufferIndexes& idx);
+
+	/** Timestamp of the sample at index, the first one of a read of size samples */
+	int64 getReadTimestamp(int channel, int index, int size) const;
+
+	/** Drops the readable samples of a channel that come before its next trigger window, and
+		returns how many of the following ones the window covers */
+	int skipToTriggerWindow(int channel, int numReadable);
+
+	/** Points the buffers at new storage of size samples per channel, floats or int16 */
+	void allocateStorage(int size);
+
 	int lastIdx;
 
 	OwnedArray<AbstractFifo> m_fifos;
-	OwnedArray<AbstractFifo> m_FTSFifos;
+	OwnedArray<AbstractFifo> m_segmentFifos;
+	OwnedArray<AbstractFifo> m_windowFifos;
 
+	RingMemory m_memory;
 	AudioSampleBuffer m_buffer;
-	SynchronizedTimestampBuffer m_FTSBuffer;
+	int16** m_int16Channels;
+	Array<float> m_int16Scales;		//Conversion factor of each channel to int16 counts, empty for floats
+	HeapBlock<SyncSegment> m_segments;
+	HeapBlock<TriggerWindow> m_windows;
 
 	Array<int> m_readSamples;
-	Array<int> m_readFTSSamples;
+	Array<int> m_channelGroups;
+	Array<int> m_groupReady;		//Samples every channel of a group has waiting, during a read
+	Array<int> m_readSegments;
 	OwnedArray<Array<int64>> m_timestamps;
 	Array<int64> m_lastReadTimestamps;
 
+	//Written by the producer only, read from any thread
+	HeapBlock<Atomic<int64>> m_droppedSamples;
+
 	int m_numChans;
-	int m_numFTSChans;
+	int m_numSyncChans;
 	const int m_blockSize;
 	bool m_readInProgress;
 	int m_numBlocks;
 	int m_maxSize;
+	bool m_triggered;
+	int m_holdSamples;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DataQueue);
 };
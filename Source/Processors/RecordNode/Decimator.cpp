@@ -0,0 +1,151 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Decimator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DECIMATOR_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DECIMATOR_USE_NEON 1
+#endif
+
+namespace
+{
+	/* Sum of n consecutive samples, four at a time in two independent accumulators */
+	inline float sumSamples(const float* src, int n)
+	{
+		int i = 0;
+		float sum = 0.0f;
+
+#if DECIMATOR_USE_SSE2
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = _mm_add_ps(acc0, _mm_loadu_ps(src + i));
+			acc1 = _mm_add_ps(acc1, _mm_loadu_ps(src + i + 4));
+		}
+		acc0 = _mm_add_ps(acc0, acc1);
+		acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+		acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+		sum = _mm_cvtss_f32(acc0);
+#elif DECIMATOR_USE_NEON
+		float32x4_t acc0 = vdupq_n_f32(0.0f);
+		float32x4_t acc1 = vdupq_n_f32(0.0f);
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = vaddq_f32(acc0, vld1q_f32(src + i));
+			acc1 = vaddq_f32(acc1, vld1q_f32(src + i + 4));
+		}
+		acc0 = vaddq_f32(acc0, acc1);
+		float32x2_t half = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+		sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+		for (; i < n; i++)
+			sum += src[i];
+
+		return sum;
+	}
+}
+
+Decimator::Decimator(int numChannels, int factor)
+	: m_numChannels(numChannels),
+	m_factor(jmax(1, factor))
+{
+	m_sums.calloc(jmax(1, numChannels));
+	reset();
+}
+
+int Decimator::getNumChannels() const
+{
+	return m_numChannels;
+}
+
+int Decimator::getFactor() const
+{
+	return m_factor;
+}
+
+void Decimator::reset()
+{
+	for (int c = 0; c < m_numChannels; c++)
+		m_sums[c] = 0.0f;
+	m_count = 0;
+	m_nextTimestamp = -1;
+}
+
+int Decimator::process(const AudioSampleBuffer& source, const Array<int>& sourceChannels, int numSamples, int64 timestamp,
+	AudioSampleBuffer& dest, int64& firstOutput)
+{
+	if (timestamp != m_nextTimestamp)
+		reset();
+
+	m_nextTimestamp = timestamp + numSamples;
+
+	/* Output m is complete once sample (m + 1) * factor - 1 is in */
+	firstOutput = timestamp / m_factor;
+	const int numOutputs = int((timestamp + numSamples) / m_factor - firstOutput);
+
+	if (dest.getNumChannels() < m_numChannels || dest.getNumSamples() < numOutputs)
+		dest.setSize(jmax(dest.getNumChannels(), m_numChannels), jmax(dest.getNumSamples(), numOutputs), false, false, true);
+
+	/* Samples still needed to complete the first group */
+	const int firstNeed = m_factor - int(timestamp % m_factor);
+	int count = m_count;
+
+	for (int c = 0; c < m_numChannels; c++)
+	{
+		const float* src = source.getReadPointer(sourceChannels[c]);
+		float* out = dest.getWritePointer(c);
+
+		float sum = m_sums[c];
+		int need = firstNeed;
+		int pos = 0;
+		int k = 0;
+		count = m_count;
+
+		while (pos < numSamples)
+		{
+			const int n = jmin(need, numSamples - pos);
+			sum += sumSamples(src + pos, n);
+			count += n;
+			pos += n;
+
+			if (n == need)
+			{
+				// the first group may be partial when the recording starts inside it
+				out[k++] = sum / count;
+				sum = 0.0f;
+				count = 0;
+				need = m_factor;
+			}
+		}
+
+		m_sums[c] = sum;
+	}
+
+	m_count = count;
+	return numOutputs;
+}
@@ -0,0 +1,71 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DECIMATOR_H_INCLUDED
+#define DECIMATOR_H_INCLUDED
+
+#include <JuceHeader.h>
+
+/**
+	Downsamples the channels of a subprocessor by an integer factor on the record side,
+	averaging every group of factor consecutive samples. The average doubles as the
+	anti-aliasing filter, which is enough for LFP bands well below the new Nyquist rate.
+
+	Groups are aligned to sample numbers, so decimated sample m stands for the source
+	samples [m * factor, (m + 1) * factor). A group split between two blocks is carried
+	over; after a gap in the timestamps the groups start over.
+
+	@see RecordNode
+*/
+class Decimator
+{
+public:
+	Decimator(int numChannels, int factor);
+
+	int getNumChannels() const;
+	int getFactor() const;
+
+	/** Forgets the carried group, for a new recording */
+	void reset();
+
+	/** Decimates a block of numSamples samples whose first one is source sample timestamp.
+		Channel c is read from channel sourceChannels[c] of the source buffer and written
+		to channel c of dest, which grows if needed.
+
+		Returns the number of decimated samples, the first one being decimated sample firstOutput. */
+	int process(const AudioSampleBuffer& source, const Array<int>& sourceChannels, int numSamples, int64 timestamp,
+		AudioSampleBuffer& dest, int64& firstOutput);
+
+private:
+	const int m_numChannels;
+	const int m_factor;
+
+	/** Sum of the samples of the carried group of each channel */
+	HeapBlock<float> m_sums;
+	int m_count;
+	int64 m_nextTimestamp;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Decimator);
+};
+
+#endif  // DECIMATOR_H_INCLUDED
@@ -25,45 +25,40 @@
 #define EVENTQUEUE_H_INCLUDED
 
 #include <JuceHeader.h>
-//#include <Events.h>
-#include <vector>
+#include "../Events/Events.h"
 
-template <class MsgContainer>
-class AsyncEventMessage :
-	public ReferenceCountedObject
+/** Read-only view of a serialized event stored inline in an EventQueue.
+	Only valid between EventQueue::startRead and EventQueue::stopRead.
+*/
+struct EventSpan
 {
-public:
-	AsyncEventMessage(const MsgContainer& m, int64 t, int extra) : 
-		ReferenceCountedObject(),
-		m_data(m),
-		m_timestamp(t),
-		m_extra(extra)
-	{}
-
-	~AsyncEventMessage() {};
-
-	const MsgContainer& getData() const { return m_data;  }
-	const int64& getTimestamp() const { return m_timestamp; }
-	const int& getExtra() const { return m_extra;  }
-
-private:
-	const MsgContainer m_data;
-	const int64 m_timestamp;
-	const int m_extra;
+	const char* data;
+	size_t size;
+	int64 timestamp;
+	int extra;
 
+	/** Copies the payload into a MidiMessage, as expected by the record engines */
+	MidiMessage toMessage() const { return MidiMessage(data, static_cast<int>(size)); }
 };
 
-template <class EventClass>
+/** Fixed-capacity single-producer/single-consumer ring of serialized events.
+
+	All storage is preallocated in a single slab of equally sized slots, so adding an event
+	from the audio thread only copies its payload. Events larger than the slot size, or
+	arriving while the ring is full, are dropped and addEvent returns false.
+	Methods other than addEvent, startRead and stopRead must not be called while the
+	producer or the consumer are running.
+*/
 class EventQueue
 {
 public:
-	typedef AsyncEventMessage<EventClass> EventContainer;
-	typedef ReferenceCountedObjectPtr<EventContainer> EventClassPtr;
-
-	EventQueue(int size) :
-		m_fifo(size)
+	EventQueue(int size, size_t maxEventSize) :
+		m_fifo(size),
+		m_numSlots(size),
+		m_readInProgress(false),
+		m_numRead(0)
 	{
-		m_data.resize(size);
+		setMaxEventSize(maxEventSize);
 	}
 
 	~EventQueue()
@@ -74,68 +69,178 @@ public:
 		return m_fifo.getNumReady();
 	}
 
+	/** Empties the queue and clears the dropped event counter */
 	void reset()
 	{
-		m_data.clear();
-		m_data.resize(m_fifo.getTotalSize());
+		m_fifo.reset();
+		m_readInProgress = false;
+		m_numRead = 0;
+		m_droppedEvents = 0;
+	}
+
+	/** Number of events dropped since the last reset, because the queue was full or they were too large */
+	int64 getNumDroppedEvents() const
+	{
+		return m_droppedEvents.get();
+	}
+
+	int getSize() const
+	{
+		return m_numSlots;
 	}
 
 	void resize(int size)
 	{
-		m_data.clear();
+		m_numSlots = size;
 		m_fifo.setTotalSize(size);
-		m_data.resize(size);
+		allocateSlots();
 	}
 
-	void addEvent(const EventClass& ev, int64 t, int extra = 0)
+	/** Sets the largest payload a slot can hold and reallocates the slab */
+	void setMaxEventSize(size_t maxEventSize)
 	{
-		int pos1, size1, pos2, size2;
-		size1 = 0;
-		m_fifo.prepareToWrite(1, pos1, size1, pos2, size2);
+		m_maxEventSize = maxEventSize;
+		m_slotSize = (sizeof(SlotHeader) + maxEventSize + 7) & ~(size_t)7;
+		allocateSlots();
+	}
 
-		/* This means there is a buffer overrun. Instead of overwritting the existing data and risking a collision of both threads
-			we just skip the incoming samples. TODO: use this to notify of the overrun and act consequently   */
-		if (size1 > 0)
-		{
-			m_data[pos1] = new EventContainer(ev, t, extra);
-			m_fifo.finishedWrite(1);
-		}
+	size_t getMaxEventSize() const
+	{
+		return m_maxEventSize;
+	}
+
+	/** Copies an already serialized event (e.g. the raw data of an event MidiMessage) */
+	bool addEvent(const void* data, size_t size, int64 t, int extra = 0)
+	{
+		char* payload = prepareSlot(size, t, extra);
+		if (payload == nullptr)
+			return false;
+
+		memcpy(payload, data, size);
+		m_fifo.finishedWrite(1);
+		return true;
+	}
+
+	bool addEvent(const MidiMessage& ev, int64 t, int extra = 0)
+	{
+		return addEvent(ev.getRawData(), ev.getRawDataSize(), t, extra);
+	}
+
+	/** Serializes an event object straight into its slot. size must be the exact serialized size */
+	bool addEvent(const EventBase& ev, size_t size, int64 t, int extra = 0)
+	{
+		char* payload = prepareSlot(size, t, extra);
+		if (payload == nullptr)
+			return false;
+
+		ev.serialize(payload, size);
+		m_fifo.finishedWrite(1);
+		return true;
 	}
 
-	int getEvents(std::vector<EventClassPtr>& vec, int max)
+	/** Gets views of up to max events (all if max <= 0). The slots stay reserved until stopRead is called */
+	int startRead(Array<EventSpan>& spans, int max)
 	{
+		spans.clearQuick();
+		if (m_readInProgress)
+			return 0;
+
 		int pos1, size1, pos2, size2;
 		int numAvailable = m_fifo.getNumReady();
 		int numToRead = ((max < numAvailable) && (max > 0)) ? max : numAvailable;
 		m_fifo.prepareToRead(numToRead, pos1, size1, pos2, size2);
-		vec.resize(numToRead);
+
 		for (int i = 0; i < size1; ++i)
+			spans.add(getSpan(pos1 + i));
+		for (int i = 0; i < size2; ++i)
+			spans.add(getSpan(pos2 + i));
+
+		m_readInProgress = true;
+		m_numRead = numToRead;
+		return numToRead;
+	}
+
+	/** Releases the slots obtained by the last startRead */
+	void stopRead()
+	{
+		if (!m_readInProgress)
+			return;
+
+		m_fifo.finishedRead(m_numRead);
+		m_numRead = 0;
+		m_readInProgress = false;
+	}
+
+private:
+	struct SlotHeader
+	{
+		int64 timestamp;
+		uint32 size;
+		int32 extra;
+	};
+
+	void allocateSlots()
+	{
+		m_slab.calloc(m_slotSize * m_numSlots);
+		m_fifo.reset();
+	}
+
+	char* prepareSlot(size_t size, int64 t, int extra)
+	{
+		if (size > m_maxEventSize)
 		{
-			vec[i] = m_data[pos1 + i];
+			++m_droppedEvents;
+			return nullptr;
 		}
-		if (size2 > 0)
+
+		int pos1, size1, pos2, size2;
+		size1 = 0;
+		m_fifo.prepareToWrite(1, pos1, size1, pos2, size2);
+
+		/* This means there is a buffer overrun. Instead of overwritting the existing data and risking a collision of both threads
+			we just skip the incoming event. */
+		if (size1 == 0)
 		{
-			for (int i = 0; i < size2; ++i)
-			{
-				vec[size1 + i] = m_data[pos2 + i];
-			}
+			++m_droppedEvents;
+			return nullptr;
 		}
-		m_fifo.finishedRead(numToRead);
-		return numToRead;
+
+		char* slot = m_slab + pos1 * m_slotSize;
+		SlotHeader* header = reinterpret_cast<SlotHeader*>(slot);
+		header->timestamp = t;
+		header->size = static_cast<uint32>(size);
+		header->extra = extra;
+		return slot + sizeof(SlotHeader);
 	}
 
-private:
-	std::vector<EventClassPtr> m_data;
+	EventSpan getSpan(int slotIndex) const
+	{
+		const char* slot = m_slab + slotIndex * m_slotSize;
+		const SlotHeader* header = reinterpret_cast<const SlotHeader*>(slot);
+
+		EventSpan span;
+		span.data = slot + sizeof(SlotHeader);
+		span.size = header->size;
+		span.timestamp = header->timestamp;
+		span.extra = header->extra;
+		return span;
+	}
+
+	HeapBlock<char> m_slab;
 	AbstractFifo m_fifo;
+	int m_numSlots;
+	size_t m_maxEventSize;
+	size_t m_slotSize;
+	bool m_readInProgress;
+	int m_numRead;
+	Atomic<int64> m_droppedEvents;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EventQueue);
 };
-//NOTE: Events are sent as midimessages while spikes as spike objects due to the difference on how they are passed to the record node.
-//Once the probe system is implemented, this will be normalized
-typedef EventQueue<MidiMessage> EventMsgQueue;
-typedef EventQueue<SpikeEvent> SpikeMsgQueue;
-typedef ReferenceCountedObjectPtr<AsyncEventMessage<MidiMessage>> EventMessagePtr;
-typedef ReferenceCountedObjectPtr<AsyncEventMessage<SpikeEvent>> SpikeMessagePtr;
 
-#endif  // EVENTQUEUE_H_INCLUDED
+//NOTE: Events and spikes are both stored in their serialized form. Spikes are only
+//deserialized by the record thread, when they are about to be written.
+typedef EventQueue EventMsgQueue;
+typedef EventQueue SpikeMsgQueue;
 
+#endif  // EVENTQUEUE_H_INCLUDED
@@ -22,33 +22,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "OriginalRecording.h"
+#include "../BinaryFormat/SampleConversion.h"
+#include "../../../Utils/ThreadConfig.h"
 //#include "../../AccessClass.h"
 //#include "../../Audio/AudioComponent.h"
 
 OriginalRecording::OriginalRecording() : separateFiles(false),
-recordingNumber(0), experimentNumber(0), zeroBuffer(1, 50000),
+recordingNumber(0), experimentNumber(0),
 eventFile(nullptr), messageFile(nullptr), lastProcId(0), procIndex(0)
 {
-	/*continuousDataIntegerBuffer = new int16[10000];
-	continuousDataFloatBuffer = new float[10000];
-
-	recordMarker = new char[10];*/
-	continuousDataIntegerBuffer.malloc(10000);
-	continuousDataFloatBuffer.malloc(10000);
-	recordMarker.malloc(10);
-
-	for (int i = 0; i < 9; i++)
-	{
-		recordMarker[i] = i;
-	}
-	recordMarker[9] = 255;
-
-	zeroBuffer.clear();
 }
 
 OriginalRecording::~OriginalRecording()
 {
 	//Cleanup just in case
+	writers.clear();
 	for (int i = 0; i < fileArray.size(); i++)
 	{
 		if (fileArray[i] != nullptr) fclose(fileArray[i]);
@@ -57,9 +45,6 @@ OriginalRecording::~OriginalRecording()
 	{
 		if (spikeFileArray[i] != nullptr) fclose(spikeFileArray[i]);
 	}
-	/*   delete continuousDataFloatBuffer;
-	delete continuousDataIntegerBuffer;
-	delete recordMarker;*/
 }
 
 String OriginalRecording::getEngineID() const
@@ -75,8 +60,10 @@ void OriginalRecording::addSpikeElectrode(int index, const SpikeChannel* elec)
 void OriginalRecording::resetChannels()
 {
 	fileArray.clear();
+	channelFiles.clear();
 	spikeFileArray.clear();
 	blockIndex.clear();
+	recordBuffers.clear();
 	processorArray.clear();
 	samplesSinceLastTimestamp.clear();
 	originalChannelIndexes.clear();
@@ -97,12 +84,30 @@ void OriginalRecording::openFiles(File rootFolder, int experimentNumber, int rec
 
 	int nChannels = getNumRecordedChannels();
 
+	recordBuffers.clear();
+	channelFiles.clear();
+
 	for (int i = 0; i < nChannels; i++)
 	{
 		const DataChannel* ch = getDataChannel(getRealChannel(i));
 		openFile(rootFolder, ch, getRealChannel(i));
 		blockIndex.add(0);
 		samplesSinceLastTimestamp.add(0);
+
+		RecordBuffer* records = new RecordBuffer();
+		records->storage.malloc(RECORDS_PER_WRITE * RECORD_SIZE);
+		records->numRecords = 0;
+		recordBuffers.add(records);
+		channelFiles.add(new ChannelFile(fileArray[i]));
+	}
+
+	int numWriters = jmin(MAX_WRITER_THREADS, jmax(1, SystemStats::getNumCpus() / 2), nChannels);
+
+	writers.clear();
+	for (int i = 0; i < numWriters; i++)
+	{
+		writers.add(new AsyncBlockWriter());
+		ThreadConfig::startThread(*writers.getLast(), ThreadConfig::RECORD_IO);
 	}
 
 	int nSpikes = getNumRecordedSpikes();
@@ -458,134 +463,139 @@ void OriginalRecording::writeTTLEvent(int eventIndex, const MidiMessage& event)
 	diskWriteLock.exit();
 }
 
-void OriginalRecording::writeSynchronizedData(int writeChannel, int realChannel, const float* dataBuffer, const double* ftsBuffer, int size) {};
-
 void OriginalRecording::writeData(int writeChannel, int realChannel, const float* buffer, int size)
 {
-	int samplesWritten = 0;
-
-	samplesSinceLastTimestamp.set(writeChannel, 0);
-
-	int nSamples = size;
-
-	while (samplesWritten < nSamples) // there are still unwritten samples in this buffer
-	{
-		int numSamplesToWrite = nSamples - samplesWritten;
-
-		if (blockIndex[writeChannel] + numSamplesToWrite < BLOCK_LENGTH) // we still have space in this block
-		{
-
-			// write buffer to disk!
-			writeContinuousBuffer(buffer + samplesWritten,
-				numSamplesToWrite,
-				writeChannel);
-
-			//timestamp += numSamplesToWrite;
-			samplesSinceLastTimestamp.set(writeChannel, samplesSinceLastTimestamp[writeChannel] + numSamplesToWrite);
-			blockIndex.set(writeChannel, blockIndex[writeChannel] + numSamplesToWrite);
-			samplesWritten += numSamplesToWrite;
-
-		}
-		else   // there's not enough space left in this block for all remaining samples
-		{
-
-			numSamplesToWrite = BLOCK_LENGTH - blockIndex[writeChannel];
-
-			// write buffer to disk!
-			writeContinuousBuffer(buffer + samplesWritten,
-				numSamplesToWrite,
-				writeChannel);
-
-			// update our variables
-			samplesWritten += numSamplesToWrite;
-			//timestamp += numSamplesToWrite;
-			samplesSinceLastTimestamp.set(writeChannel, samplesSinceLastTimestamp[writeChannel] + numSamplesToWrite);
-			blockIndex.set(writeChannel, 0); // back to the beginning of the block
-		}
-	}
+	// check to see if the file exists
+	if (fileArray[writeChannel] == nullptr)
+		return;
 
+	// scale the data back into the range of int16
+	const float multFactor = 1 / (float(0x7fff) * getDataChannel(getRealChannel(writeChannel))->getBitVolts());
 
+	writeSamples(writeChannel, buffer, multFactor, size);
 }
 
-void OriginalRecording::writeContinuousBuffer(const float* data, int nSamples, int writeChannel)
+void OriginalRecording::writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size)
 {
-	// check to see if the file exists
 	if (fileArray[writeChannel] == nullptr)
 		return;
 
-	// scale the data back into the range of int16
-	float scaleFactor = float(0x7fff) * getDataChannel(getRealChannel(writeChannel))->getBitVolts();
+	writeSamples(writeChannel, buffer, 1.0f, size);
+}
 
-	for (int n = 0; n < nSamples; n++)
-	{
-		*(continuousDataFloatBuffer + n) = *(data + n) / scaleFactor;
-	}
-	AudioDataConverters::convertFloatToInt16BE(continuousDataFloatBuffer, continuousDataIntegerBuffer, nSamples);
+static void storeSamplesBE(const float* source, int16* dest, float multFactor, int numSamples)
+{
+	convertFloatToInt16ScaledBE(source, dest, multFactor, numSamples);
+}
+
+static void storeSamplesBE(const int16* source, int16* dest, float, int numSamples)
+{
+	for (int i = 0; i < numSamples; i++)
+		dest[i] = (int16) ByteOrder::swapIfLittleEndian((uint16) source[i]);
+}
+
+template <typename SampleType>
+void OriginalRecording::writeSamples(int writeChannel, const SampleType* buffer, float multFactor, int size)
+{
+	int samplesWritten = 0;
 
-	if (blockIndex[writeChannel] == 0)
+	while (samplesWritten < size) // there are still unwritten samples in this buffer
 	{
-		writeTimestampAndSampleCount(fileArray[writeChannel], writeChannel);
-	}
+		int index = blockIndex[writeChannel];
 
-	diskWriteLock.enter();
+		if (index == 0)
+			startRecord(writeChannel, getTimestamp(writeChannel) + samplesWritten);
 
-	size_t count = fwrite(continuousDataIntegerBuffer,      // ptr
-		2,                                // size of each element
-		nSamples,                         // count
-		fileArray[writeChannel]); // ptr to FILE object
+		int numSamplesToWrite = jmin(size - samplesWritten, BLOCK_LENGTH - index);
+		int16* recordSamples = reinterpret_cast<int16*>(getRecord(writeChannel) + RECORD_HEADER_SIZE);
 
-	LOGDD(writeChannel, " : ", nSamples, " : ", count);
+		storeSamplesBE(buffer + samplesWritten, recordSamples + index, multFactor, numSamplesToWrite);
 
-	jassert(count == nSamples); // make sure all the data was written
-	(void)count;  // Suppress unused variable warning in release builds
+		samplesWritten += numSamplesToWrite;
+		index += numSamplesToWrite;
 
-	diskWriteLock.exit();
+		if (index == BLOCK_LENGTH)
+		{
+			writeRecord(writeChannel);
+			index = 0; // back to the beginning of the block
+		}
 
-	if (blockIndex[writeChannel] + nSamples == BLOCK_LENGTH)
-	{
-		writeRecordMarker(fileArray[writeChannel]);
+		blockIndex.set(writeChannel, index);
 	}
+
+	samplesSinceLastTimestamp.set(writeChannel, size);
 }
 
-void OriginalRecording::writeTimestampAndSampleCount(FILE* file, int channel)
+uint8* OriginalRecording::getRecord(int channel) const
 {
-	diskWriteLock.enter();
+	const RecordBuffer* records = recordBuffers[channel];
+	return reinterpret_cast<uint8*>(records->storage.getData()) + records->numRecords * RECORD_SIZE;
+}
 
+void OriginalRecording::startRecord(int channel, int64 timestamp)
+{
+	uint8* header = getRecord(channel);
 	uint16 samps = BLOCK_LENGTH;
 
-	// int sourceNodeId = getChannel(channel)->sourceNodeId;
+	memcpy(header, &timestamp, 8);
+	memcpy(header + 8, &samps, 2);
+	memcpy(header + 10, &recordingNumber, 2);
+}
 
-	int64 ts = getTimestamp(channel) + samplesSinceLastTimestamp[channel];
+void OriginalRecording::writeRecord(int channel)
+{
+	// the marker indicating the end of a record
+	uint8* marker = getRecord(channel) + RECORD_SIZE - RECORD_MARKER_SIZE;
+	for (int b = 0; b < RECORD_MARKER_SIZE - 1; b++)
+		marker[b] = b;
+	marker[RECORD_MARKER_SIZE - 1] = 255;
+
+	if (++recordBuffers[channel]->numRecords == RECORDS_PER_WRITE)
+		queueRecords(channel);
+}
 
-	fwrite(&ts,                       // ptr
-		8,                               // size of each element
-		1,                               // count
-		file); // ptr to FILE object
+void OriginalRecording::queueRecords(int channel)
+{
+	RecordBuffer* records = recordBuffers[channel];
 
-	fwrite(&samps,                           // ptr
-		2,                               // size of each element
-		1,                               // count
-		file); // ptr to FILE object
+	if (records->numRecords == 0)
+		return;
 
-	fwrite(&recordingNumber,                         // ptr
-		2,                               // size of each element
-		1,                               // count
-		file); // ptr to FILE object
+	const char* data = records->storage.getData();
 
-	diskWriteLock.exit();
+	// the writer takes over the storage, so the channel continues in a fresh block
+	writers[channel % writers.size()]->queueBlock(channelFiles[channel], records->storage, data, records->numRecords * RECORD_SIZE);
+
+	records->storage.malloc(RECORDS_PER_WRITE * RECORD_SIZE);
+	records->numRecords = 0;
 }
 
-void OriginalRecording::writeRecordMarker(FILE* file)
+int OriginalRecording::getNumPendingWrites() const
 {
-	// write a 10-byte marker indicating the end of a record
+	int pending = 0;
+	for (auto writer : writers)
+		pending += writer->getNumPendingBlocks();
+	return pending;
+}
 
-	diskWriteLock.enter();
-	fwrite(recordMarker,        // ptr
-		1,                   // size of each element
-		10,                  // count
-		file);               // ptr to FILE object
+OriginalRecording::ChannelFile::ChannelFile(FILE* file) : m_file(file)
+{
+}
 
-	diskWriteLock.exit();
+bool OriginalRecording::ChannelFile::write(const void* data, size_t numBytes)
+{
+	if (m_file == nullptr)
+		return false;
+
+	size_t count = fwrite(data, 1, numBytes, m_file);
+
+	jassert(count == numBytes); // make sure all the data was written
+	return count == numBytes;
+}
+
+bool OriginalRecording::ChannelFile::isOpen() const
+{
+	return m_file != nullptr;
 }
 
 void OriginalRecording::closeFiles()
@@ -594,17 +604,34 @@ void OriginalRecording::closeFiles()
 	{
 		if (fileArray[i] != nullptr)
 		{
-			if (blockIndex[i] < BLOCK_LENGTH)
-			{
-				// fill out the rest of the current buffer
-				writeContinuousBuffer(zeroBuffer.getReadPointer(0), BLOCK_LENGTH - blockIndex[i], i);
-				diskWriteLock.enter();
-				fclose(fileArray[i]);
-				diskWriteLock.exit();
-			}
+			// fill out the rest of the current record with zeros
+			if (blockIndex[i] == 0)
+				startRecord(i, getTimestamp(i) + samplesSinceLastTimestamp[i]);
+
+			uint8* samples = getRecord(i) + RECORD_HEADER_SIZE;
+			memset(samples + 2 * blockIndex[i], 0, 2 * (BLOCK_LENGTH - blockIndex[i]));
+
+			writeRecord(i);
+			queueRecords(i);
 		}
 	}
+
+	// every queued record must reach its file before the files are closed
+	for (int i = 0; i < writers.size(); i++)
+	{
+		writers[i]->flush();
+		writers[i]->stopThread(5000);
+	}
+	writers.clear();
+
+	for (int i = 0; i < fileArray.size(); i++)
+	{
+		if (fileArray[i] != nullptr)
+			fclose(fileArray[i]);
+	}
 	fileArray.clear();
+	channelFiles.clear();
+	recordBuffers.clear();
 
 	blockIndex.clear();
 	samplesSinceLastTimestamp.clear();
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ORIGINALRECORDING_H_INCLUDED
 
 #include "../RecordEngine.h"
+#include "../BinaryFormat/AsyncBlockWriter.h"
 #include <stdio.h>
 #include <map>
 #include "../../../Utils/Utils.h"
@@ -31,6 +32,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define HEADER_SIZE 1024
 #define BLOCK_LENGTH 1024
 
+/* A continuous record: timestamp, sample count and recording number, BLOCK_LENGTH big-endian samples, and a marker */
+#define RECORD_HEADER_SIZE 12
+#define RECORD_MARKER_SIZE 10
+#define RECORD_SIZE (RECORD_HEADER_SIZE + 2 * BLOCK_LENGTH + RECORD_MARKER_SIZE)
+
+/* Complete records of a channel are handed to its writer thread this many at a time */
+#define RECORDS_PER_WRITE 8
+
+/* At most this many writer threads share the channel files */
+#define MAX_WRITER_THREADS 4
+
 #define VERSION 0.5
 
 #define VSTR(s) #s
@@ -48,9 +60,10 @@ public:
 	void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
 	void closeFiles() override;
 	void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
-	void writeSynchronizedData(int writeChannel, int realChannel, const float* dataBuffer, const double* ftsBuffer, int size) override;
+	void writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size) override;
 	void writeEvent(int eventIndex, const MidiMessage& event) override;
 	void resetChannels() override;
+	int getNumPendingWrites() const override;
 	void addSpikeElectrode(int index, const SpikeChannel* elec) override;
 	void writeSpike(int electrodeIndex, const SpikeEvent* spike) override;
 	void writeTimestampSyncText(uint16 sourceID, uint16 sourceIdx, int64 timestamp, float sourceSampleRate, String text) override;
@@ -61,9 +74,35 @@ private:
 	String getFileName(int channelIndex);
 	void openFile(File rootFolder, const InfoObjectCommon* ch, int channelIndex);
 	String generateHeader(const InfoObjectCommon* ch);
-	void writeContinuousBuffer(const float* data, int nSamples, int channel);
-	void writeTimestampAndSampleCount(FILE* file, int channel);
-	void writeRecordMarker(FILE* file);
+	/** The record a channel is filling */
+	uint8* getRecord(int channel) const;
+
+	/** Stores the samples of a channel in its records, big-endian. Float samples are scaled
+		by multFactor first; int16 samples are already scaled */
+	template <typename SampleType>
+	void writeSamples(int writeChannel, const SampleType* buffer, float multFactor, int size);
+
+	/** Starts the next record of a channel, at the given timestamp */
+	void startRecord(int channel, int64 timestamp);
+
+	/** Completes the record of a channel, queueing the channel's records once RECORDS_PER_WRITE are complete */
+	void writeRecord(int channel);
+
+	/** Hands the complete records of a channel to its writer thread */
+	void queueRecords(int channel);
+
+	/** A channel file as seen by its writer thread */
+	class ChannelFile : public BlockOutputFile
+	{
+	public:
+		ChannelFile(FILE* file);
+
+		bool write(const void* data, size_t numBytes) override;
+		bool isOpen() const override;
+
+	private:
+		FILE* const m_file;
+	};
 
 	void openSpikeFile(File rootFolder, const SpikeChannel* elec, int channelIndex);
 	String generateSpikeHeader(const SpikeChannel* elec);
@@ -83,23 +122,24 @@ private:
 	bool renameFiles;
 	String renamedPrefix;
 
-	/** Holds data that has been converted from float to int16 before
-	saving.
+	/** The records each channel is filling, RECORDS_PER_WRITE * RECORD_SIZE bytes per channel.
+	Samples are converted straight into them, and the complete records are queued to the
+	channel's writer thread in a single block. Only the record thread fills them, so they
+	need no lock.
 	*/
-	HeapBlock<int16> continuousDataIntegerBuffer;
-	//int16* continuousDataIntegerBuffer;
+	struct RecordBuffer
+	{
+		HeapBlock<char> storage;
+		int numRecords;
+	};
+	OwnedArray<RecordBuffer> recordBuffers;
 
-	/** Holds data that has been converted from float to int16 before
-	saving.
+	/** Channel files are spread over the writer threads, channel i going to thread
+	i % writers.size(), so that the records of each file are still written in order.
+	The queues are bounded, holding back the record thread when the disk falls behind.
 	*/
-	HeapBlock<float> continuousDataFloatBuffer;
-	//float* continuousDataFloatBuffer;
-
-	/** Used to indicate the end of each record */
-	HeapBlock<uint8> recordMarker;
-	//char* recordMarker;
-
-	AudioSampleBuffer zeroBuffer;
+	OwnedArray<AsyncBlockWriter> writers;
+	OwnedArray<ChannelFile> channelFiles;
 
 	FILE* eventFile;
 	FILE* messageFile;
@@ -1,60 +1,8 @@
 #include "RecordChannelSelector.h"
+#include "../../Utils/ListSliceParser.h"
 #include <string>
 #include <vector>
 
-ChannelButton::ChannelButton(int _id, RecordChannelSelector* _parent) : Button(String(_id)), id(_id), parent(_parent) {
-    setClickingTogglesState(true);
-}
-
-ChannelButton::~ChannelButton() {}
-
-void ChannelButton::mouseDown(const MouseEvent &event)
-{
-    parent->startDragCoords.setX(event.x + this->getX());
-    parent->startDragCoords.setY(event.y + this->getY());
-    parent->firstButtonSelectedState = !this->getToggleState();
-    parent->mouseDown(event);
-}
-
-void ChannelButton::mouseDrag(const MouseEvent &event)
-{
-    parent->mouseDrag(event);
-}
-
-void ChannelButton::mouseUp(const MouseEvent &event)
-{
-    parent->mouseUp(event);
-}
-
-void ChannelButton::paintButton(Graphics &g, bool isMouseOver, bool isButtonDown)
-{
-
-	g.setColour(Colour(0,0,0));
-    g.fillRoundedRectangle(0.0f, 0.0f, getWidth(), getHeight(), 0.001*getWidth());
-
-    if (isMouseOver)
-	{
-		if (getToggleState())
-			g.setColour(Colour(255, 65, 65));
-		else
-			g.setColour(Colour(210, 210, 210));
-	}
-	else 
-	{
-		if (getToggleState())
-			g.setColour(Colour(255, 0, 0));
-		else
-			g.setColour(Colour(110, 110, 110));
-	}
-	g.fillRoundedRectangle(1,1,getWidth()-2,getHeight()-2,0.001*getWidth());
-
-    //Draw text string in middle of button
-	g.setColour(Colour(255,255,255));
-	g.setFont(10);
-	g.drawText (String(id), 0,0, getWidth(), getHeight(), Justification::centred); 
-
-}
-
 SelectButton::SelectButton(const String& name) : Button(name) {
 	setClickingTogglesState(true);
 }
@@ -95,39 +43,30 @@ RangeEditor::~RangeEditor() {}
  * RECORD CHANNEL SELECTOR
 ***************************/
 
-RecordChannelSelector::RecordChannelSelector(std::vector<bool> channelStates, bool editable) 
+RecordChannelSelector::RecordChannelSelector(std::vector<bool> states, bool editable) 
     : Component(), 
-    nChannels(channelStates.size()),
+    editable(editable),
+    nChannels(states.size()),
+    channelStates(states.size()),
+    scrollRow(0),
+    hoverChannel(-1),
     mouseDragged(false), 
     startDragCoords(0,0),
-    shiftKeyDown(false),
     firstButtonSelectedState(false),
-    isDragging(false),
-    editable(editable)
+    draggedChannels(states.size()),
+    shiftKeyDown(false)
 {
 
     int width = 368; //can use any multiples of 16 here for dynamic resizing
 
-    int nColumns = 16;
-    int nRows = nChannels / nColumns + (int)(!(nChannels % nColumns == 0));
-    int buttonSize = width / 16;
-    int height = buttonSize * nRows;
+    nColumns = 16;
+    nRows = nChannels / nColumns + (int)(!(nChannels % nColumns == 0));
+    nVisibleRows = jmin(nRows, maxVisibleRows);
+    buttonSize = width / 16;
+    int height = buttonSize * nVisibleRows;
 
-	for (int i = 0; i < nRows; i++)
-	{
-		for (int j = 0; j < nColumns; j++)
-		{
-            if (nColumns*i+j < nChannels)
-            {
-                channelButtons.add(new ChannelButton(nColumns*i+j+1, this));
-                channelButtons.getLast()->setBounds(width/nColumns*j, height/nRows*i, buttonSize, buttonSize);
-                channelButtons.getLast()->setToggleState(channelStates[nColumns * i + j], NotificationType::dontSendNotification);
-                channelButtons.getLast()->addListener(this);
-                addChildAndSetID(channelButtons.getLast(), String(nColumns*i+j+1));
-            }
-			
-		}
-	}
+    for (int ch = 0; ch < nChannels; ch++)
+        channelStates.set(ch, states[ch]);
 
     if (editable)
     {
@@ -177,14 +116,134 @@ RecordChannelSelector::RecordChannelSelector(std::vector<bool> channelStates, bo
 
 RecordChannelSelector::~RecordChannelSelector() {}
 
+std::vector<bool> RecordChannelSelector::getChannelStates() const
+{
+    std::vector<bool> states(nChannels);
+
+    for (int ch = 0; ch < nChannels; ch++)
+        states[ch] = channelStates[ch];
+
+    return states;
+}
+
+void RecordChannelSelector::paint(Graphics &g)
+{
+    const juce::Rectangle<int> clip = g.getClipBounds();
+
+    // only the rows that are scrolled into view and need repainting
+    const int firstRow = scrollRow + jmax(0, clip.getY() / buttonSize);
+    const int lastRow = jmin(scrollRow + nVisibleRows, scrollRow + clip.getBottom() / buttonSize + 1);
+
+    g.setFont(10);
+
+    for (int ch = firstRow * nColumns; ch < jmin(nChannels, lastRow * nColumns); ch++)
+    {
+        const juce::Rectangle<float> bounds = getChannelBounds(ch).toFloat();
+
+        g.setColour(Colour(0,0,0));
+        g.fillRoundedRectangle(bounds, 0.001*bounds.getWidth());
+
+        if (ch == hoverChannel)
+        {
+            if (channelStates[ch])
+                g.setColour(Colour(255, 65, 65));
+            else
+                g.setColour(Colour(210, 210, 210));
+        }
+        else 
+        {
+            if (channelStates[ch])
+                g.setColour(Colour(255, 0, 0));
+            else
+                g.setColour(Colour(110, 110, 110));
+        }
+        g.fillRoundedRectangle(bounds.reduced(1), 0.001*bounds.getWidth());
+
+        //Draw text string in middle of button
+        g.setColour(Colour(255,255,255));
+        g.drawText (String(ch + 1), bounds, Justification::centred); 
+    }
+
+}
+
+int RecordChannelSelector::getChannelAt(juce::Point<int> position) const
+{
+    if (position.getX() < 0 || position.getY() < 0)
+        return -1;
+
+    const int column = position.getX() / buttonSize;
+    const int row = position.getY() / buttonSize;
+
+    if (column >= nColumns || row >= nVisibleRows)
+        return -1;
+
+    const int ch = (scrollRow + row) * nColumns + column;
+
+    return ch < nChannels ? ch : -1;
+}
+
+juce::Rectangle<int> RecordChannelSelector::getChannelBounds(int channel) const
+{
+    return juce::Rectangle<int>(channel % nColumns * buttonSize,
+                                (channel / nColumns - scrollRow) * buttonSize,
+                                buttonSize,
+                                buttonSize);
+}
+
+void RecordChannelSelector::setChannelState(int channel, bool state)
+{
+    if (channelStates[channel] != state)
+    {
+        channelStates.set(channel, state);
+        repaintChannel(channel);
+    }
+}
+
+void RecordChannelSelector::repaintChannel(int channel)
+{
+    if (isPositiveAndBelow(channel, nChannels))
+        repaint(getChannelBounds(channel));
+}
+
+void RecordChannelSelector::setScrollRow(int row)
+{
+    row = jlimit(0, nRows - nVisibleRows, row);
+
+    if (row != scrollRow)
+    {
+        scrollRow = row;
+        repaint(0, 0, getWidth(), nVisibleRows * buttonSize);
+    }
+}
+
 void RecordChannelSelector::mouseMove(const MouseEvent &event)
 {
+    const int ch = getChannelAt(event.getPosition());
 
+    if (ch != hoverChannel)
+    {
+        repaintChannel(hoverChannel);
+        hoverChannel = ch;
+        repaintChannel(hoverChannel);
+    }
 };
+
+void RecordChannelSelector::mouseExit(const MouseEvent &event)
+{
+    repaintChannel(hoverChannel);
+    hoverChannel = -1;
+}
+
 void RecordChannelSelector::mouseDown(const MouseEvent &event)
 {
     if (editable)
-        selectedButtons.clear();
+    {
+        startDragCoords = event.getPosition().translated(0, scrollRow * buttonSize);
+        draggedChannels.setAll(false);
+
+        const int ch = getChannelAt(event.getPosition());
+        firstButtonSelectedState = ch >= 0 ? !channelStates[ch] : true;
+    }
 };
 
 void RecordChannelSelector::mouseDrag(const MouseEvent &event)
@@ -195,38 +254,29 @@ void RecordChannelSelector::mouseDrag(const MouseEvent &event)
 
         mouseDragged = true;
 
-        int w = event.getDistanceFromDragStartX();
-        int h = event.getDistanceFromDragStartY();
-        int x = startDragCoords.getX();
-        int y = startDragCoords.getY();
+        // the box from where the drag started to the mouse, in grid coordinates
+        const juce::Point<int> end = event.getPosition().translated(0, scrollRow * buttonSize);
 
-        if (w < 0)
-        {
-            x = x + w;
-            w = -w;
-        }
+        const int firstColumn = jmax(0, jmin(startDragCoords.getX(), end.getX()) / buttonSize);
+        const int lastColumn = jmin(nColumns - 1, jmax(startDragCoords.getX(), end.getX()) / buttonSize);
+        const int firstRow = jmax(0, jmin(startDragCoords.getY(), end.getY()) / buttonSize);
+        const int lastRow = jmin(nRows - 1, jmax(startDragCoords.getY(), end.getY()) / buttonSize);
 
-        if (h < 0)
+        for (int row = firstRow; row <= lastRow; row++)
         {
-            y = y + h;
-            h = -h;
-        }
+            for (int column = firstColumn; column <= lastColumn; column++)
+            {
+                const int ch = row * nColumns + column;
 
-        dragBox.setBounds(x, y, w > 0 ? w : 1, h > 0 ? h : 1);
+                if (ch >= nChannels || draggedChannels[ch])
+                    continue;
 
-        for (auto button : channelButtons)
-        {
-            if (button->getBounds().intersects(dragBox) && !selectedButtons.contains(button->getId()))
-            {
-                selectedButtons.add(button->getId());
+                draggedChannels.set(ch, true);
 
                 if (shiftKeyDown) //toggle
-                    button->triggerClick();
+                    setChannelState(ch, !channelStates[ch]);
                 else //Use state of the first selected button
-                {
-                    button->setToggleState(firstButtonSelectedState, NotificationType::dontSendNotification);
-                }
-                
+                    setChannelState(ch, firstButtonSelectedState);
             }
         }
 
@@ -244,66 +294,39 @@ void RecordChannelSelector::mouseUp(const MouseEvent &event)
 
     if (!mouseDragged && editable)
     {
-        for (auto button : channelButtons)
-        {
-            if (button->getBounds().contains(startDragCoords))
-            {
-                button->triggerClick();
-                break;
-            }
-        }
+        const int ch = getChannelAt(startDragCoords.translated(0, -scrollRow * buttonSize));
+
+        if (ch >= 0)
+            setChannelState(ch, !channelStates[ch]);
     }
     mouseDragged = false;
 }
 
-void RecordChannelSelector::textEditorReturnKeyPressed(TextEditor& editor)
+void RecordChannelSelector::mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel)
 {
-
-    if (editable)
+    if (nRows <= nVisibleRows)
     {
-        channelStates = parseStringIntoRange(384);
-
-        if (channelStates.size() < 3)
-            return;
+        Component::mouseWheelMove(event, wheel);
+        return;
+    }
 
-        for (auto* btn : channelButtons)
-            btn->setToggleState(false, NotificationType::dontSendNotification);
+    int rows = roundToInt(-wheel.deltaY * 8.0f);
 
-        int i = 0;
-        while (i <= channelStates.size() - 3)
-        {
-            const int lim = channelStates[i+1];
-            const int comd = channelStates[i+2];
-            for (int fa = channelStates[i]; fa < lim; fa += comd)
-            {
-                channelButtons[i++]->setToggleState(true, NotificationType::dontSendNotification);
-            }
-            i+=3;
-        }
+    if (rows == 0 && wheel.deltaY != 0)
+        rows = wheel.deltaY > 0 ? -1 : 1;
 
-        for (auto val : channelStates)
-        {
-            LOGDD(val, ",");
-        }
-        std::cout << std::endl;
+    setScrollRow(scrollRow + rows);
+    mouseMove(event);
+}
 
-        for (auto* btn : channelButtons)
-            btn->setToggleState(false, NotificationType::dontSendNotification);
+void RecordChannelSelector::textEditorReturnKeyPressed(TextEditor& editor)
+{
 
-        for (i = 0; i < channelStates.size(); i += 3)
-        {
-            int startIdx = channelStates[i];
-            int endIdx = channelStates[i+1];
-            int step = channelStates[i+2];
-            
-            int ch = startIdx;
-            while (ch < endIdx)
-            {
-                channelButtons[ch]->setToggleState(true, NotificationType::dontSendNotification);
-                ch+=step;
-            }
+    if (editable)
+    {
+        channelStates = ListSliceParser::parseStringIntoMask(rangeEditor->getText(), nChannels);
 
-        }
+        repaint(0, 0, getWidth(), nVisibleRows * buttonSize);
     }
 
 }
@@ -319,25 +342,21 @@ void RecordChannelSelector::buttonClicked(Button* button)
         
         if (button->getButtonText() == String("ALL"))
         {
-            for (auto* btn : channelButtons)
-                btn->setToggleState(true, NotificationType::dontSendNotification);
+            channelStates.setAll(true);
+            repaint(0, 0, getWidth(), nVisibleRows * buttonSize);
             button->setToggleState(true, NotificationType::dontSendNotification);
             
         }
         else if (button->getButtonText() == String("NONE"))
         {
-            for (auto* btn : channelButtons)
-                btn->setToggleState(false, NotificationType::dontSendNotification);
+            channelStates.setAll(false);
+            repaint(0, 0, getWidth(), nVisibleRows * buttonSize);
             button->setToggleState(true, NotificationType::dontSendNotification);
         }
         else if (button->getButtonText() == String("RANGE:"))
         {
             button->setToggleState(true, NotificationType::dontSendNotification);
         }
-        else //channel button was manually selected
-        {
-            //TODO: Update text box with range string
-        }
         
         //rangeEditor->setText(rangeString);
 
@@ -357,7 +376,7 @@ void RecordChannelSelector::updateRangeString()
     
     for (int i = 0; i < nChannels; i++)
     {
-        if (channelButtons[i]->getToggleState())
+        if (channelStates[i])
         {
             if (inRange)
             {
@@ -399,153 +418,3 @@ void RecordChannelSelector::updateRangeString()
     }
     
 }
-
-int RecordChannelSelector::convertStringToInteger(String s)
-{
-    char ar[20];
-    int i, k = 0;
-    for (i = 0; i < s.length(); i++)
-    {
-        if (s[i] >= 48 && s[i] <= 57)
-        {
-            ar[k] = s[i];
-            k++;
-        }
-    }
-    if (k > 7)
-    {
-        return 1000000;
-    }
-    ar[k] = '\0';
-    k = atoi(ar);
-    return k;
-}
-
-Array<int> RecordChannelSelector::parseStringIntoRange(int rangeValue)
-{
-    String s = ",";
-    s += rangeEditor->getText();
-
-    Array<int> finalList, separator, rangeseparator;
-    int i, j, a, b, k, openb, closeb, otherchar, x, y;
-    s += ",";
-    for (i = 0; i < s.length(); i++) //split string by ' , ' or ' ; '
-    {
-        if (s[i] == ';' || s[i] == ',')
-        {
-            separator.add(i);
-        }
-    }
-    for (i = 0; i < separator.size() - 1; i++) // split ranges by ' : ' or ' - '
-    {
-        j = k = separator[i] + 1;
-        openb = closeb = otherchar = 0;
-        rangeseparator.clear();
-        for (; j < separator[i + 1]; j++)
-        {
-            if (s[j] == '-' || s[j] == ':')
-            {
-                rangeseparator.add(j);
-            }
-            else if (((int)s[j] == 32))
-            {
-                continue;
-            }
-            else if (s[j] == '[' || s[j] == '{' || s[j] == '(')
-            {
-                openb++;
-            }
-            else if (s[j] == ']' || s[j] == '}' || s[j] == ')')
-            {
-                closeb++;
-            }
-            else if ((int)s[j] > 57 || (int)s[j] < 48)
-            {
-                otherchar++;
-            }
-        }
-
-        if (openb != closeb || openb > 1 || closeb > 1 || otherchar > 0) //Invalid input
-        {
-            continue;
-        }
-
-        for (x = separator[i] + 1; x < separator[i + 1]; x++) //trim whitespace and brackets from front
-        {
-            if (((int)s[x] >= 48 && (int)s[x] <= 57) || s[x] == ':' || s[x] == '-')
-            {
-                break;
-            }
-        }
-        for (y = separator[i + 1] - 1; y > separator[i]; y--) //trim whitespace and brackets from end
-        {
-            if (((int)s[y] >= 48 && (int)s[y] <= 57) || s[y] == ':' || s[y] == '-')
-            {
-                break;
-            }
-        }
-        if (x > y)
-        {
-            continue;
-        }
-
-        if (rangeseparator.size() == 0) //syntax of form - x or [x]
-        {
-            a = convertStringToInteger(s.substring(x, y + 1));
-            if (a == 0 || a > rangeValue)
-            {
-                continue;
-            }
-            finalList.add(a - 1);
-            finalList.add(a - 1);
-            finalList.add(1);
-        }
-        else if (rangeseparator.size() == 1) // syntax of type - x-y or [x-y]
-        {
-            a = convertStringToInteger(s.substring(x, rangeseparator[0]));
-            b = convertStringToInteger(s.substring(rangeseparator[0] + 1, y + 1));
-            if (a == 0)
-            {
-                a = 1;
-            }
-            if (b == 0)
-            {
-                b = rangeValue;
-            }
-            if (a > b || a > rangeValue || b > rangeValue)
-            {
-                continue;
-            }
-            finalList.add(a - 1);
-            finalList.add(b - 1);
-            finalList.add(1);
-        }
-        else if (rangeseparator.size() == 2) // syntax of type [x:y:z] or x-y-z
-        {
-            a = convertStringToInteger(s.substring(x, rangeseparator[0] + 1));
-            k = convertStringToInteger(s.substring(rangeseparator[0] + 1, rangeseparator[1]));
-            b = convertStringToInteger(s.substring(rangeseparator[1] + 1, y + 1));
-
-            if (a == 0)
-            {
-                a = 1;
-            }
-            if (b == 0)
-            {
-                b = rangeValue;
-            }
-            if (k == 0)
-            {
-                k = 1;
-            }
-            if (a > b || a > rangeValue || b > rangeValue)
-            {
-                continue;
-            }
-            finalList.add(a - 1);
-            finalList.add(b - 1);
-            finalList.add(k);
-        }
-    }
-    return finalList;
-}
\ No newline at end of file
@@ -1,29 +1,12 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../Editors/GenericEditor.h"
+#include "../Channel/ChannelMask.h"
 #include "../../Utils/Utils.h"
 
 class RecordChannelSelector;
 
 enum Select { ALL, NONE, RANGE };
 
-class ChannelButton : public Button	
-{
-public:
-	ChannelButton(int id, RecordChannelSelector* parent);
-	~ChannelButton();
-    int getId() { return id; };
-private:
-	void mouseDown(const MouseEvent &event);
-	void mouseDrag(const MouseEvent &event);
-	void mouseUp(const MouseEvent &event);
-
-	int id; 
-	RecordChannelSelector* parent;
-    int width;
-    int height;
-	void paintButton(Graphics& g, bool isMouseOver, bool isButtonDown) override;
-};
-
 class SelectButton : public Button	
 {
 public:
@@ -42,43 +25,69 @@ private:
 	//TODO:
 };
 
+/**
+	Chooses the recorded channels of a subprocessor, shown as a grid of numbered cells.
+
+	The selector paints the cells itself from a ChannelMask, and scrolls when there are
+	more rows than fit, so it opens as fast for a probe with thousands of channels as
+	for a tetrode. A change repaints only the cells it touches.
+*/
 class RecordChannelSelector : public Component, public Button::Listener, public TextEditor::Listener
 {
 public:
 	RecordChannelSelector(std::vector<bool> channelStates, bool editable);
 	~RecordChannelSelector();
 
-	void mouseMove(const MouseEvent &event);
-	void mouseDown(const MouseEvent &event);
-	void mouseDrag(const MouseEvent &event);
-	void mouseUp(const MouseEvent &event);
-	void buttonClicked(Button *);
-	void modifierKeysChanged(const ModifierKeys& modifiers);
+	/** The state of every channel, in the form RecordNode::updateChannelStates takes */
+	std::vector<bool> getChannelStates() const;
+
+	void paint(Graphics& g) override;
+
+	void mouseMove(const MouseEvent &event) override;
+	void mouseExit(const MouseEvent &event) override;
+	void mouseDown(const MouseEvent &event) override;
+	void mouseDrag(const MouseEvent &event) override;
+	void mouseUp(const MouseEvent &event) override;
+	void mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel) override;
+	void buttonClicked(Button *) override;
+	void modifierKeysChanged(const ModifierKeys& modifiers) override;
 
 	bool editable;
-	bool isDragging;
-	juce::Point<int> startDragCoords;
-	bool firstButtonSelectedState;
 
 	int nChannels;
 
-	OwnedArray<ChannelButton> channelButtons;
+	/** Rows shown at once; the grid scrolls beyond that */
+	static const int maxVisibleRows = 16;
 
 private:
-	int convertStringToInteger(String s);
-	Array<int> parseStringIntoRange(int rangeValue);
+	/** The channel whose cell contains a point of the component, or -1 */
+	int getChannelAt(juce::Point<int> position) const;
+	juce::Rectangle<int> getChannelBounds(int channel) const;
 
-	void textEditorReturnKeyPressed(TextEditor &);
+	void setChannelState(int channel, bool state);
+	void repaintChannel(int channel);
+	void setScrollRow(int row);
+
+	void textEditorReturnKeyPressed(TextEditor &) override;
 	void updateRangeString();
-	void parseRangeString();
+
 	OwnedArray<SelectButton> selectButtons;
 	ScopedPointer<RangeEditor> rangeEditor;
 
 	String rangeString;
-	Array<int> channelStates;
+	ChannelMask channelStates;
+
+	int buttonSize;
+	int nColumns;
+	int nRows;
+	int nVisibleRows;
+	int scrollRow;
+	int hoverChannel;
+
 	bool mouseDragged;
-	juce::Rectangle<int> dragBox;
-	Array<int> selectedButtons;
+	juce::Point<int> startDragCoords;	// in grid coordinates, which do not scroll
+	bool firstButtonSelectedState;
+	ChannelMask draggedChannels;		// the channels a drag has already changed
 	bool shiftKeyDown;
     
 };
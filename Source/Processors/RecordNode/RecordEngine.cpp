@@ -29,9 +29,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "EngineConfigWindow.h"
 #include "OpenEphysFormat/OriginalRecording.h"
 #include "BinaryFormat/BinaryRecording.h"
+#include "BinaryFormat/CompressedBinaryRecording.h"
+#include "BinaryFormat/ChunkedBinaryRecording.h"
 
 RecordEngine::RecordEngine()
-	: manager(nullptr), recordNode(nullptr)
+	: manager(nullptr), recordNode(nullptr), int16ConversionSize(0)
 {
 }
 
@@ -59,9 +61,40 @@ void RecordEngine::startChannelBlock(bool lastBlock) {}
 
 void RecordEngine::endChannelBlock(bool lastBlock) {}
 
+int RecordEngine::getNumPendingWrites() const { return 0; }
+
+void RecordEngine::writeSyncSegment(int writeChannel, const SyncSegment& segment) {}
+
+void RecordEngine::writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size)
+{
+	if (size > int16ConversionSize)
+	{
+		int16ConversionBuffer.malloc(size);
+		int16ConversionSize = size;
+	}
+
+	const float bitVolts = getDataChannel(realChannel)->getBitVolts();
+	for (int i = 0; i < size; i++)
+		int16ConversionBuffer[i] = buffer[i] * bitVolts;
+
+	writeData(writeChannel, realChannel, int16ConversionBuffer, size);
+}
+
+void RecordEngine::writeDataBlock(int firstWriteChannel, const float* const* channels, int numChannels, int numSamples, const int64* timestamps)
+{
+	for (int i = 0; i < numChannels; i++)
+		writeData(firstWriteChannel + i, firstWriteChannel + i, channels[i], numSamples);
+}
+
+void RecordEngine::writeInt16DataBlock(int firstWriteChannel, const int16* const* channels, int numChannels, int numSamples, const int64* timestamps)
+{
+	for (int i = 0; i < numChannels; i++)
+		writeInt16Data(firstWriteChannel + i, firstWriteChannel + i, channels[i], numSamples);
+}
+
 const DataChannel* RecordEngine::getDataChannel(int index) const
 {
-	return recordNode->getDataChannel(index);
+	return recordNode->getRecordedDataChannel(index);
 }
 
 const EventChannel* RecordEngine::getEventChannel(int index) const
@@ -87,6 +120,11 @@ void RecordEngine::updateTimestamps(const Array<int64>& ts, int channel)
 		timestamps.set(channel, ts[channel]);
 }
 
+void RecordEngine::updateSkippedSamples(const Array<int64>& skipped)
+{
+	skippedSamples = skipped;
+}
+
 void RecordEngine::setChannelMapping(const Array<int>& chans, const Array<int>& chanProc, const Array<int>& chanOrder, OwnedArray<RecordProcessorInfo>& processors)
 {
 	channelMap = chans;
@@ -100,6 +138,11 @@ int64 RecordEngine::getTimestamp(int channel) const
 	return timestamps[channel];
 }
 
+int64 RecordEngine::getSkippedSamples(int channel) const
+{
+	return skippedSamples[channel];
+}
+
 int RecordEngine::getRealChannel(int channel) const
 {
 	return channelMap[channel];
@@ -115,6 +158,11 @@ int RecordEngine::getNumRecordedProcessors() const
 	return recordProcessors.size();
 }
 
+bool RecordEngine::usesSynchronizedTimestamps(const String& engineID)
+{
+	return engineID == "RAWBINARY" || engineID == "COMPRESSEDBINARY" || engineID == "CHUNKEDBINARY";
+}
+
 int RecordEngine::getNumRecordedEvents() const
 {
 	return recordNode->getTotalEventChannels();
@@ -253,7 +301,7 @@ void RecordEngineManager::addParameter(EngineParameter* param)
 
 int RecordEngineManager::getNumOfBuiltInEngines()
 {
-	return 2;
+	return 4;
 }
 
 RecordEngineManager* RecordEngineManager::createBuiltInEngineManager(int index)
@@ -264,6 +312,10 @@ RecordEngineManager* RecordEngineManager::createBuiltInEngineManager(int index)
 		return BinaryRecording::getEngineManager();
 	case 1: 
 		return OriginalRecording::getEngineManager();
+	case 2:
+		return CompressedBinaryRecording::getEngineManager();
+	case 3:
+		return ChunkedBinaryRecording::getEngineManager();
 
 	default:
 		return nullptr;
@@ -288,6 +340,14 @@ RecordEngine* RecordEngineManager::instantiateEngine()
 	{
 		return new OriginalRecording();
 	}
+	else if (id == "COMPRESSEDBINARY")
+	{
+		return new CompressedBinaryRecording();
+	}
+	else if (id == "CHUNKEDBINARY")
+	{
+		return new ChunkedBinaryRecording();
+	}
 
 	return nullptr;
 }
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../GenericProcessor/GenericProcessor.h"
 #include "../../Utils/Utils.h"
+#include "SyncSegment.h"
 
 #include <map>
 
@@ -71,12 +72,11 @@ public:
 	When recording starts (in the specified order):
 	1-directoryChanged (if needed)
 	2-(setChannelMapping)
-	3-(updateTimestamps*)
-	4-openFiles*
+	3-openFiles* (before the first block arrives, so getTimestamp() is not valid yet)
 	During recording: (RecordThread loop)
 	1-(updateTimestamps*) (can be called in a per-channel basis when the circular buffer wraps)
 	2-startChannelBlock*
-	3-writeData* (per channel. Can be called more than once to account for the circular buffer wrap)
+	3-writeDataBlock* (per span of channels covering the same samples. Can be called more than once to account for the circular buffer wrap)
 	4-endChannelBlock*
 	4-writeEvent* (if needed)
 	5-writeSpike* (if needed)
@@ -90,7 +90,8 @@ public:
 	/** Called for registering parameters */
 	virtual void setParameter(EngineParameter& parameter);
 
-	/** Called when recording starts to open all needed files */
+	/** Called when recording starts to open all needed files. The timestamps of the
+	first block are only known from the first startChannelBlock on */
 	virtual void openFiles(File rootFolder, int experimentNumber, int recordingNumber) = 0;
 
 	/** Called when recording stops to close all files and do all the necessary cleanups */
@@ -102,12 +103,29 @@ public:
 	/** Write continuous data for a channel. The raw buffer pointer is passed for speed, care must be taken to only read the specified number of bytes. */
 	virtual void writeData(int writeChannel, int realChannel, const float* buffer, int size) = 0;
 
-	/** Write continuous data for a channel with synchronized float timestamps */
-	virtual void writeSynchronizedData(int writeChannel, int realChannel, const float* dataBuffer, const double* ftsBuffer, int size) = 0;
+	/** Write continuous data for a channel as int16 counts of its bitVolts, which the RecordNode queues when it
+	records raw samples. By default the samples are converted back to floats and passed on to writeData. */
+	virtual void writeInt16Data(int writeChannel, int realChannel, const int16* buffer, int size);
+
+	/** Write continuous data for numChannels consecutive channels from firstWriteChannel on, which all have
+	numSamples new samples. timestamps holds the timestamp of the first sample of each channel. Lets an engine
+	interleave or compress the channels in one pass. By default calls writeData for each channel. */
+	virtual void writeDataBlock(int firstWriteChannel, const float* const* channels, int numChannels, int numSamples, const int64* timestamps);
+
+	/** Same as writeDataBlock for int16 samples. By default calls writeInt16Data for each channel. */
+	virtual void writeInt16DataBlock(int firstWriteChannel, const int16* const* channels, int numChannels, int numSamples, const int64* timestamps);
+
+	/** Called with each new segment of the synchronized timestamps of a recorded processor, before the
+	block holding its first sample is written. writeChannel is a channel of that processor.
+	Only engines for which usesSynchronizedTimestamps() is true receive segments. */
+	virtual void writeSyncSegment(int writeChannel, const SyncSegment& segment);
 
 	/** Called by the record thread after it has written a channel block */
 	virtual void endChannelBlock(bool lastBlock);
 
+	/** Number of blocks the engine has queued to its own I/O threads and not yet written. Called from the thread writing the engine */
+	virtual int getNumPendingWrites() const;
+
 	/** Write a single event to disk.  */
 	virtual void writeEvent(int eventChannel, const MidiMessage& event) = 0;
 
@@ -138,6 +156,9 @@ public:
 	/** Called at the start of every write block */
 	void updateTimestamps(const Array<int64>& timestamps, int channel = -1);
 
+	/** Called at the start of every write block of a triggered recording */
+	void updateSkippedSamples(const Array<int64>& skippedSamples);
+
 	/** Called prior to opening files, to set the map between recorded channels and actual channel numbers */
 	void setChannelMapping (const Array<int>& channels, const Array<int>& chanProcessor, const Array<int>& chanOrder, OwnedArray<RecordProcessorInfo>& processors);
 
@@ -158,6 +179,9 @@ public:
 	*/
 	int getNumRecordedProcessors() const;
 
+	/** True for the engines that write the synchronized timestamps, which requires reading the queue in synchronized mode */
+	static bool usesSynchronizedTimestamps(const String& engineID);
+
 
 protected:
 	/** Functions to access RecordNode arrays and utilities */
@@ -178,6 +202,11 @@ protected:
 	/** Gets the current block's first timestamp for a given recorded channel */
 	int64 getTimestamp(int channel) const;
 
+	/** Gets the samples of a recorded channel left out between the trigger windows of a triggered
+	recording so far, counted from the timestamps of the first block. Engines that place the samples in their files
+	by timestamp subtract them, so the segments are stored back to back */
+	int64 getSkippedSamples(int channel) const;
+
 	/** Gets the actual channel number from a recorded channel index */
 	int getRealChannel(int channel) const;
 
@@ -212,6 +241,7 @@ protected:
 private:
 
 	Array<int64> timestamps;
+	Array<int64> skippedSamples;
 	Array<int> channelMap;
 	Array<int> chanProcessorMap;
 	Array<int> chanOrderMap;
@@ -219,6 +249,10 @@ private:
 	RecordEngineManager* manager;
 	OwnedArray<RecordProcessorInfo> recordProcessors;
 
+	//Float view of the int16 samples handed to writeInt16Data
+	HeapBlock<float> int16ConversionBuffer;
+	int int16ConversionSize;
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordEngine);
 };
 
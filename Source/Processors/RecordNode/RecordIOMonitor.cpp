@@ -0,0 +1,138 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordIOMonitor.h"
+
+float EngineIOStats::getBucketLimit(int bucket)
+{
+	return float(IO_LATENCY_FIRST_BUCKET_MS * (1 << bucket));
+}
+
+float EngineIOStats::getLatencyPercentile(float fraction) const
+{
+	if (numWrites <= 0)
+		return 0.0f;
+
+	const int target = jmax(1, roundToInt(fraction * numWrites));
+	int count = 0;
+
+	for (int b = 0; b < IO_LATENCY_BUCKETS - 1; ++b)
+	{
+		count += latencyHistogram[b];
+		if (count >= target)
+			return getBucketLimit(b);
+	}
+
+	/* The last bucket is open-ended */
+	return maxLatencyMs;
+}
+
+RecordIOMonitor::RecordIOMonitor()
+{
+}
+
+void RecordIOMonitor::reset(const StringArray& engineIDs)
+{
+	const ScopedLock sl(m_engineLock);
+
+	m_engines.clear();
+	for (auto& id : engineIDs)
+	{
+		EngineCounters* counters = new EngineCounters();
+		counters->engineID = id;
+		counters->totalBytes = 0;
+		counters->bytesPerSecond = 0;
+		for (int b = 0; b < IO_LATENCY_BUCKETS; ++b)
+			counters->latencyHistogram[b] = 0;
+		counters->maxLatencyMs = 0.0f;
+		counters->pendingWrites = 0;
+		counters->windowStartTicks = Time::getHighResolutionTicks();
+		counters->windowBytes = 0;
+		m_engines.add(counters);
+	}
+}
+
+void RecordIOMonitor::recordWrite(int engineIndex, int64 numBytes, int64 ticks, int pendingWrites)
+{
+	/* The engines only change in reset(), which is never called while the engines are written */
+	EngineCounters* counters = m_engines[engineIndex];
+	if (counters == nullptr)
+		return;
+
+	const float latencyMs = float(Time::highResolutionTicksToSeconds(ticks) * 1000.0);
+
+	int bucket = 0;
+	while (bucket < IO_LATENCY_BUCKETS - 1 && latencyMs >= EngineIOStats::getBucketLimit(bucket))
+		++bucket;
+
+	counters->latencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	if (latencyMs > counters->maxLatencyMs.load(std::memory_order_relaxed))
+		counters->maxLatencyMs.store(latencyMs, std::memory_order_relaxed);
+	counters->pendingWrites.store(pendingWrites, std::memory_order_relaxed);
+	counters->totalBytes.fetch_add(numBytes, std::memory_order_relaxed);
+
+	counters->windowBytes += numBytes;
+
+	const int64 now = Time::getHighResolutionTicks();
+	const double elapsed = Time::highResolutionTicksToSeconds(now - counters->windowStartTicks);
+
+	if (elapsed * 1000.0 >= IO_RATE_WINDOW_MS)
+	{
+		counters->bytesPerSecond.store(counters->windowBytes / elapsed, std::memory_order_relaxed);
+		counters->windowBytes = 0;
+		counters->windowStartTicks = now;
+	}
+}
+
+void RecordIOMonitor::getStats(Array<EngineIOStats>& stats) const
+{
+	const ScopedLock sl(m_engineLock);
+
+	stats.clearQuick();
+	for (auto counters : m_engines)
+	{
+		EngineIOStats s;
+		s.engineID = counters->engineID;
+		s.totalBytes = counters->totalBytes.load(std::memory_order_relaxed);
+		s.bytesPerSecond = counters->bytesPerSecond.load(std::memory_order_relaxed);
+		s.numWrites = 0;
+		for (int b = 0; b < IO_LATENCY_BUCKETS; ++b)
+		{
+			s.latencyHistogram[b] = counters->latencyHistogram[b].load(std::memory_order_relaxed);
+			s.numWrites += s.latencyHistogram[b];
+		}
+		s.maxLatencyMs = counters->maxLatencyMs.load(std::memory_order_relaxed);
+		s.pendingWrites = counters->pendingWrites.load(std::memory_order_relaxed);
+		stats.add(s);
+	}
+}
+
+double RecordIOMonitor::getTotalBytesPerSecond() const
+{
+	const ScopedLock sl(m_engineLock);
+
+	double total = 0;
+	for (auto counters : m_engines)
+		total += counters->bytesPerSecond.load(std::memory_order_relaxed);
+	return total;
+}
@@ -0,0 +1,99 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDIOMONITOR_H_INCLUDED
+#define RECORDIOMONITOR_H_INCLUDED
+
+#include <JuceHeader.h>
+#include <atomic>
+
+/* Write calls are counted in buckets of doubling latency, the first one holding calls under IO_LATENCY_FIRST_BUCKET_MS */
+#define IO_LATENCY_BUCKETS 12
+#define IO_LATENCY_FIRST_BUCKET_MS 0.25
+
+/* The data rate is measured over windows of this length */
+#define IO_RATE_WINDOW_MS 500
+
+/** I/O counters of one record engine since the recording started */
+struct EngineIOStats
+{
+	String engineID;
+	int64 totalBytes;			// continuous data handed to the engine, counted as int16 samples
+	double bytesPerSecond;		// over the last IO_RATE_WINDOW_MS window
+	int numWrites;				// blocks written, one write call each
+	int latencyHistogram[IO_LATENCY_BUCKETS];
+	float maxLatencyMs;
+	int pendingWrites;			// blocks queued by the engine to its own I/O threads after the last write
+
+	/** The upper bound of the latency bucket holding the given fraction of the write calls, in ms */
+	float getLatencyPercentile(float fraction) const;
+
+	/** The upper bound of a latency bucket, in ms */
+	static float getBucketLimit(int bucket);
+};
+
+/**
+	Collects the write throughput and latency of every engine of a RecordThread.
+
+	Each engine reports from the thread that writes it, so the counters of an engine
+	have a single writer; getStats() can be called from any thread.
+*/
+class RecordIOMonitor
+{
+public:
+	RecordIOMonitor();
+
+	/** Clears the counters for a new recording, before any engine is written */
+	void reset(const StringArray& engineIDs);
+
+	/** Reports a block written to an engine: its size, how long the write took in high
+		resolution ticks, and the blocks the engine still has queued */
+	void recordWrite(int engineIndex, int64 numBytes, int64 ticks, int pendingWrites);
+
+	void getStats(Array<EngineIOStats>& stats) const;
+
+	/** Data rate of all the engines together */
+	double getTotalBytesPerSecond() const;
+
+private:
+	struct EngineCounters
+	{
+		String engineID;
+		std::atomic<int64> totalBytes;
+		std::atomic<double> bytesPerSecond;
+		std::atomic<int> latencyHistogram[IO_LATENCY_BUCKETS];
+		std::atomic<float> maxLatencyMs;
+		std::atomic<int> pendingWrites;
+
+		//Only touched by the writing thread
+		int64 windowStartTicks;
+		int64 windowBytes;
+	};
+
+	OwnedArray<EngineCounters> m_engines;
+	CriticalSection m_engineLock;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordIOMonitor);
+};
+
+#endif  // RECORDIOMONITOR_H_INCLUDED
@@ -4,6 +4,8 @@
 #include "../../UI/ControlPanel.h"
 #include "../../Processors/MessageCenter/MessageCenterEditor.h"
 #include "BinaryFormat/BinaryRecording.h"
+#include "../../Utils/RealtimeLog.h"
+#include "../../Utils/ThreadConfig.h"
 #include "OpenEphysFormat/OriginalRecording.h"
 
 #include "../../AccessClass.h"
@@ -42,13 +44,23 @@ RecordNode::RecordNode()
 	settingsNeeded(false),
 	receivedSoftwareTime(false),
     numSubprocessors(0),
-	isConnectedToMessageCenter(false)
+	isConnectedToMessageCenter(false),
+	selectedEngineIndex(0),
+	overflowPolicy(DROP_DATA),
+	peakFifoUsage(0.0f),
+	verifyRecordings(false),
+	queueRawSamples(false),
+	triggeredRecording(false),
+	preTriggerSeconds(0.0f),
+	postTriggerSeconds(0.0f),
+	triggerFifo(RECORDING_TRIGGER_QUEUE_SIZE)
 {
 	setProcessorType(PROCESSOR_TYPE_RECORD_NODE);
 
 	dataQueue = new DataQueue(WRITE_BLOCK_LENGTH, DATA_BUFFER_NBLOCKS);
-	eventQueue = new EventMsgQueue(EVENT_BUFFER_NEVENTS);
-	spikeQueue = new SpikeMsgQueue(SPIKE_BUFFER_NSPIKES);
+	eventQueue = new EventMsgQueue(EVENT_BUFFER_NEVENTS, EVENT_MIN_SLOT_SIZE);
+	spikeQueue = new SpikeMsgQueue(SPIKE_BUFFER_NSPIKES, EVENT_MIN_SLOT_SIZE);
+	triggers.malloc(RECORDING_TRIGGER_QUEUE_SIZE);
 
 	synchronizer = new Synchronizer(this);
 
@@ -59,7 +71,7 @@ RecordNode::RecordNode()
 
 	dataDirectory = CoreServices::getRecordingDirectory();
 
-	recordThread = new RecordThread(this, recordEngine);
+	recordThread = new RecordThread(this, engineArray);
 
 	lastDataChannelArraySize = 0;
 
@@ -75,10 +87,12 @@ void RecordNode::connectToMessageCenter()
 {
 
 	const EventChannel* messageChannel = AccessClass::getMessageCenter()->messageCenter->getMessageChannel();
+	const EventChannel* annotationChannel = AccessClass::getMessageCenter()->messageCenter->getAnnotationChannel();
 
 	if (!isConnectedToMessageCenter)
 	{
 		eventChannelArray.add(new EventChannel(*messageChannel));
+		eventChannelArray.add(new EventChannel(*annotationChannel));
 	
 		isConnectedToMessageCenter = true;
 
@@ -120,7 +134,8 @@ void RecordNode::addInputChannel(const GenericProcessor* sourceNode, int chan)
 		DataChannel* newChannel = new DataChannel(*orig);
 		newChannel->setRecordState(orig->getRecordState());
 		dataChannelArray.add(newChannel);
-		recordEngine->addDataChannel(channelIndex, dataChannelArray[channelIndex]);
+		for (auto engine : engineArray)
+			engine->addDataChannel(channelIndex, dataChannelArray[channelIndex]);
 
 	}
 	else
@@ -148,9 +163,57 @@ void RecordNode::addSpecialProcessorChannels(Array<EventChannel*>& channels)
 }
 
 void RecordNode::setEngine(int index)
+{
+	selectedEngineIndex = index;
+	additionalEngineIndexes.removeFirstMatchingValue(index);
+	instantiateEngines();
+}
+
+void RecordNode::setAdditionalEngine(int engineIndex, bool shouldRecord)
+{
+	if (engineIndex == selectedEngineIndex)
+		return;
+
+	if (shouldRecord)
+		additionalEngineIndexes.addIfNotAlreadyThere(engineIndex);
+	else
+		additionalEngineIndexes.removeFirstMatchingValue(engineIndex);
+
+	instantiateEngines();
+}
+
+bool RecordNode::isAdditionalEngine(int engineIndex) const
+{
+	return additionalEngineIndexes.contains(engineIndex);
+}
+
+const Array<int>& RecordNode::getAdditionalEngines() const
+{
+	return additionalEngineIndexes;
+}
+
+bool RecordNode::isEngineActive(const String& engineID) const
+{
+	for (auto engine : engineArray)
+	{
+		if (engine->getEngineID() == engineID)
+			return true;
+	}
+	return false;
+}
+
+void RecordNode::instantiateEngines()
 {
 	availableEngines = getAvailableRecordEngines();
-	recordEngine = availableEngines[index]->instantiateEngine();
+
+	engineArray.clear();
+	engineArray.add(availableEngines[selectedEngineIndex]->instantiateEngine());
+
+	for (auto index : additionalEngineIndexes)
+	{
+		if (index >= 0 && index < availableEngines.size())
+			engineArray.add(availableEngines[index]->instantiateEngine());
+	}
 }
 
 std::vector<RecordEngineManager*> RecordNode::getAvailableRecordEngines()
@@ -305,7 +368,8 @@ const String &RecordNode::getLastSettingsXml() const
 // - EngineConfigComponent (3, 0.0f) -- used to disable record thread (deprecated?)
 void RecordNode::setParameter(int parameterIndex, float newValue)
 {
-	editor->updateParameterButtons(parameterIndex);
+	if (!isApplyingParameterChanges())
+		editor->updateParameterButtons(parameterIndex);
 
 	if (currentChannel >= 0)
 	{
@@ -510,6 +574,27 @@ void RecordNode::setSyncChannel(int srcIndex, int subProcIdx, int channel)
 	synchronizer->setSyncChannel(srcIndex, subProcIdx, syncOrderMap[srcIndex][subProcIdx]+channel);
 }
 
+// called by RecordNodeEditor (when loading), FifoMonitor
+void RecordNode::setDecimationFactor(int srcIndex, int subProcIdx, int factor)
+{
+	decimationMap[srcIndex][subProcIdx] = jmax(1, factor);
+}
+
+// called by RecordNodeEditor, FifoMonitor
+int RecordNode::getDecimationFactor(int srcIndex, int subProcIdx)
+{
+	return jmax(1, decimationMap[srcIndex][subProcIdx]);
+}
+
+// called by RecordEngine
+const DataChannel* RecordNode::getRecordedDataChannel(int index) const
+{
+	if (index < dataChannelArray.size())
+		return dataChannelArray[index];
+
+	return decimatedChannels[index - dataChannelArray.size()];
+}
+
 // called by SyncControlButton
 int RecordNode::getSyncChannel(int srcIndex, int subProcIdx)
 {
@@ -537,13 +622,14 @@ bool RecordNode::enable()
 
 	connectToMessageCenter();
 
-	bool openEphysFormatSelected = static_cast<RecordNodeEditor*> (getEditor())->getSelectedEngineIdx() == 1;
+	bool openEphysFormatSelected = isEngineActive("OPENEPHYS");
 
 	if (openEphysFormatSelected && getNumInputs() > 300)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon,
 			"WARNING!", "Open Ephys format does not support > 300 channels. Resetting to Binary format");
 		static_cast<RecordNodeEditor*> (getEditor())->engineSelectCombo->setSelectedItemIndex(0);
+		additionalEngineIndexes.clear();
 		setEngine(0);
 		return false;
 	}
@@ -556,8 +642,11 @@ bool RecordNode::enable()
 	}
 
 	recordingNumber = -1;
-	recordEngine->configureEngine();
-	recordEngine->startAcquisition();
+	for (auto engine : engineArray)
+	{
+		engine->configureEngine();
+		engine->startAcquisition();
+	}
 
     synchronizer->reset();
     return true;
@@ -577,6 +666,8 @@ void RecordNode::startRecording()
 	channelMap.clear();
 	ftsChannelMap.clear();
 	int totChans = dataChannelArray.size();
+	firstRecordedChannels.clearQuick();
+	firstRecordedChannels.insertMultiple(0, false, totChans);
 	OwnedArray<RecordProcessorInfo> procInfo;
 	Array<int> chanProcessorMap;
 	Array<int> chanOrderinProc;
@@ -610,7 +701,7 @@ void RecordNode::startRecording()
 			if (chan->getSourceNodeID() != lastProcessor || chan->getSubProcessorIdx() != lastSubProcessor)
 			{
 				recordedProcessorIdx++;
-				startRecChannels.push_back(ch);
+				firstRecordedChannels.set(ch, true);
 				lastProcessor = chan->getSourceNodeID();
 				lastSubProcessor = chan->getSubProcessorIdx();
 
@@ -626,22 +717,133 @@ void RecordNode::startRecording()
 		}
 	}
 
-	int numRecordedChannels = channelMap.size();
+	/* The downsampled streams follow the input channels in the engines' channel map, each
+	   with its own synchronized timestamps */
+	Array<int> engineChannelMap(channelMap);
+	decimatedStreams.clear();
+	decimatedChannels.clear();
+
+	for (auto srcIndex : extract_keys(decimationMap))
+	{
+		for (auto subIndex : extract_keys(decimationMap[srcIndex]))
+		{
+			int factor = decimationMap[srcIndex][subIndex];
+			if (factor <= 1)
+				continue;
+
+			ScopedPointer<DecimatedStream> stream = new DecimatedStream();
+			stream->sourceID = srcIndex;
+			stream->subProcIdx = subIndex;
+			stream->firstRecordedChannel = engineChannelMap.size();
+
+			for (int ch = 0; ch < totChans; ++ch)
+			{
+				DataChannel* chan = dataChannelArray[ch];
+				if (chan->getSourceNodeID() != srcIndex || chan->getSubProcessorIdx() != subIndex)
+					continue;
+
+				DataChannel* decimated = new DataChannel(chan->getChannelType(), chan->getSampleRate() / factor, this, decimatedStreams.size());
+				decimated->setName(chan->getName() + "_D" + String(factor));
+				decimated->setDescription(chan->getSourceName() + " " + chan->getName() + " downsampled by " + String(factor));
+				decimated->setBitVolts(chan->getBitVolts());
+				decimated->setDataUnits(chan->getDataUnits());
+
+				if (stream->inputChannels.isEmpty())
+				{
+					recordedProcessorIdx++;
+					RecordProcessorInfo* pi = new RecordProcessorInfo();
+					pi->processorId = getNodeId();
+					procInfo.add(pi);
+				}
+
+				procInfo.getLast()->recordedChannels.add(engineChannelMap.size());
+				chanProcessorMap.add(getNodeId());
+				chanOrderinProc.add(stream->inputChannels.size());
+				ftsChannelMap.add(recordedProcessorIdx);
+
+				engineChannelMap.add(totChans + decimatedChannels.size());
+				decimatedChannels.add(decimated);
+				stream->inputChannels.add(ch);
+			}
+
+			if (stream->inputChannels.isEmpty())
+				continue;
+
+			stream->syncChannel = recordedProcessorIdx;
+			stream->decimator = new Decimator(stream->inputChannels.size(), factor);
+			decimatedStreams.add(stream.release());
+		}
+	}
+
+	int numRecordedChannels = engineChannelMap.size();
 	
 	validBlocks.clear();
 	validBlocks.insertMultiple(0, false, getNumInputs());
 
-	recordEngine->registerRecordNode(this);
-	//recordEngine->resetChannels();
-	recordEngine->setChannelMapping(channelMap, chanProcessorMap, chanOrderinProc, procInfo);
-	recordThread->setChannelMap(channelMap);
+	for (auto engine : engineArray)
+	{
+		//setChannelMapping takes ownership of the processor info, so every engine gets its own copy
+		OwnedArray<RecordProcessorInfo> engineProcInfo;
+		for (auto pi : procInfo)
+			engineProcInfo.add(new RecordProcessorInfo(*pi));
+
+		engine->registerRecordNode(this);
+		engine->setChannelMapping(engineChannelMap, chanProcessorMap, chanOrderinProc, engineProcInfo);
+	}
+	recordThread->setChannelMap(engineChannelMap);
 	recordThread->setFTSChannelMap(ftsChannelMap);
 
+	Array<float> queueBitVolts;
+	if (queueRawSamples)
+	{
+		for (int ch = 0; ch < numRecordedChannels; ++ch)
+			queueBitVolts.add(getRecordedDataChannel(ch)->getBitVolts());
+	}
+	dataQueue->setInt16Samples(queueBitVolts);
 	dataQueue->setChannels(numRecordedChannels);
-	dataQueue->setFTSChannels(recordedProcessorIdx+1);
+	dataQueue->setSyncChannels(recordedProcessorIdx+1);
+	dataQueue->setChannelGroups(ftsChannelMap);
+
+	/* The first block of each recorded processor queues the segment its timestamps start with */
+	syncFitCounts.clearQuick();
+	syncFitCounts.insertMultiple(0, -1, recordedProcessorIdx+1);
+
+	/* Size the queue slots for the largest event and spike that can arrive */
+	size_t maxEventSize = EVENT_MIN_SLOT_SIZE;
+	for (auto chan : eventChannelArray)
+		maxEventSize = jmax(maxEventSize, EVENT_BASE_SIZE + chan->getDataSize() + chan->getTotalEventMetaDataSize());
+	if (maxEventSize != eventQueue->getMaxEventSize())
+		eventQueue->setMaxEventSize(maxEventSize);
+
+	size_t maxSpikeSize = EVENT_MIN_SLOT_SIZE;
+	for (auto chan : spikeChannelArray)
+		maxSpikeSize = jmax(maxSpikeSize, getSerializedSpikeSize(chan));
+	if (maxSpikeSize != spikeQueue->getMaxEventSize())
+		spikeQueue->setMaxEventSize(maxSpikeSize);
+
+	updateQueueSizes();
+
+	/* A triggered recording also keeps the pre-trigger ring of every channel in the data queue,
+	with a block of margin for triggers that reach the node a block late */
+	int holdSamples = 0;
+	if (triggeredRecording)
+	{
+		for (int ch = 0; ch < numRecordedChannels; ++ch)
+			holdSamples = jmax(holdSamples, int(std::ceil(preTriggerSeconds * getRecordedDataChannel(ch)->getSampleRate())) + WRITE_BLOCK_LENGTH);
+
+		int nBlocks = jmin(DATA_BUFFER_NBLOCKS + (holdSamples + WRITE_BLOCK_LENGTH - 1) / WRITE_BLOCK_LENGTH, DATA_BUFFER_MAX_NBLOCKS);
+		if (nBlocks > dataQueue->getNumBlocks())
+			dataQueue->resize(nBlocks);
+
+		holdSamples = jmin(holdSamples, dataQueue->getCapacity() - DATA_BUFFER_NBLOCKS * WRITE_BLOCK_LENGTH);
+	}
+	dataQueue->setTriggeredRecording(triggeredRecording, holdSamples);
+	triggerFifo.reset();
 
 	eventQueue->reset();
 	spikeQueue->reset();
+	dataQueue->resetOverflowCounters();
+	peakFifoUsage = 0.0f;
 	recordThread->setQueuePointers(dataQueue, eventQueue, spikeQueue);
 	recordThread->setFirstBlockFlag(false);
 
@@ -663,7 +865,8 @@ void RecordNode::startRecording()
 			recordingNumber = 0;
 			experimentNumber = 1;
 			settingsNeeded = true;
-			recordEngine->directoryChanged();
+			for (auto engine : engineArray)
+				engine->directoryChanged();
 		}
 		else
 		{
@@ -675,14 +878,17 @@ void RecordNode::startRecording()
 			rootFolder.createDirectory();
 		}
 
-		useSynchronizer = static_cast<RecordNodeEditor*> (getEditor())->getSelectedEngineIdx() == 0;
+		useSynchronizer = false;
+		for (auto engine : engineArray)
+			useSynchronizer = useSynchronizer || RecordEngine::usesSynchronizedTimestamps(engine->getEngineID());
 
 		recordThread->setFileComponents(rootFolder, experimentNumber, recordingNumber);
 
 		LOGD("Num event channels: ", eventChannelArray.size());
 
-		recordThread->startThread();
-		isRecording = true;
+		/* The recording is armed: the record thread opens the files in the background and
+		calls filesOpened() when the node can start queueing data */
+		ThreadConfig::startThread(*recordThread, ThreadConfig::RECORD_IO);
 
 		if (settingsNeeded)
 		{
@@ -696,6 +902,12 @@ void RecordNode::startRecording()
 
 }
 
+// called by the record thread
+void RecordNode::filesOpened()
+{
+	isRecording = true;
+}
+
 // called by GenericProcessor::setRecording()
 void RecordNode::stopRecording()
 {
@@ -706,9 +918,48 @@ void RecordNode::stopRecording()
 		recordThread->signalThreadShouldExit();
 		recordThread->waitForThreadToExit(2000); //2000
 	}
+	/* In case the thread finished opening the files as it was being stopped */
+	isRecording = false;
 
 	eventMonitor->displayStatus();
+	reportDroppedData();
+
+	if (verifyRecordings)
+	{
+		const File recordingFolder = rootFolder.getChildFile("experiment" + String(experimentNumber))
+			.getChildFile("recording" + String(recordingNumber + 1));
+
+		if (recordingFolder.isDirectory())
+		{
+			// the files are closed by now; a previous check still running is abandoned
+			Array<File> folders;
+			folders.add(recordingFolder);
+
+			verifier = new RecordingVerifier(folders, triggeredRecording);
+			verifier->startThread(2);
+		}
+	}
+
+}
 
+void RecordNode::setVerifyRecordings(bool verify)
+{
+	verifyRecordings = verify;
+}
+
+bool RecordNode::getVerifyRecordings() const
+{
+	return verifyRecordings;
+}
+
+void RecordNode::setQueueRawSamples(bool raw)
+{
+	queueRawSamples = raw;
+}
+
+bool RecordNode::getQueueRawSamples() const
+{
+	return queueRawSamples;
 }
 
 void RecordNode::setRecordEvents(bool recordEvents)
@@ -721,6 +972,146 @@ void RecordNode::setRecordSpikes(bool recordSpikes)
 	this->recordSpikes = recordSpikes;
 }
 
+void RecordNode::setQueueOverflowPolicy(QueueOverflowPolicy policy)
+{
+	overflowPolicy = policy;
+}
+
+RecordNode::QueueOverflowPolicy RecordNode::getQueueOverflowPolicy() const
+{
+	return overflowPolicy;
+}
+
+void RecordNode::setTriggeredRecording(bool triggered, float preSeconds, float postSeconds)
+{
+	triggeredRecording = triggered;
+	preTriggerSeconds = jmax(preSeconds, 0.0f);
+	postTriggerSeconds = jmax(postSeconds, 0.0f);
+}
+
+bool RecordNode::isTriggeredRecording() const
+{
+	return triggeredRecording;
+}
+
+// called by the processing thread
+bool RecordNode::addRecordingTrigger(uint16 sourceNodeId, uint16 subProcIdx, int64 timestamp, float sampleRate)
+{
+	if (!isRecording || !triggeredRecording)
+		return false;
+
+	int start1, size1, start2, size2;
+	triggerFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+	if (size1 + size2 < 1)
+		return false;
+
+	RecordingTrigger& trigger = triggers[size1 > 0 ? start1 : start2];
+	trigger.sourceNodeId = sourceNodeId;
+	trigger.subProcIdx = subProcIdx;
+	trigger.timestamp = timestamp;
+	trigger.sampleRate = sampleRate;
+	triggerFifo.finishedWrite(1);
+
+	return true;
+}
+
+void RecordNode::getIOStats(Array<EngineIOStats>& stats) const
+{
+	recordThread->getIOMonitor().getStats(stats);
+}
+
+double RecordNode::getRemainingRecordingTime() const
+{
+	if (!recordThread->isThreadRunning())
+		return -1;
+
+	const double rate = recordThread->getIOMonitor().getTotalBytesPerSecond();
+	if (rate <= 0)
+		return -1;
+
+	return double(dataDirectory.getBytesFreeOnVolume()) / rate;
+}
+
+WriteScheduleMetrics RecordNode::getWriteScheduleMetrics() const
+{
+	return recordThread->getWriteScheduleMetrics();
+}
+
+int64 RecordNode::getDroppedSamples(int recordedChannel) const
+{
+	return dataQueue->getDroppedSamples(recordedChannel);
+}
+
+int64 RecordNode::getDroppedSamples(int srcIndex, int subProcIdx) const
+{
+	int64 dropped = 0;
+	for (int ch = 0; ch < channelMap.size(); ++ch)
+	{
+		const DataChannel* chan = dataChannelArray[channelMap[ch]];
+		if (chan != nullptr && chan->getSourceNodeID() == srcIndex && chan->getSubProcessorIdx() == subProcIdx)
+			dropped += dataQueue->getDroppedSamples(ch);
+	}
+	return dropped;
+}
+
+int64 RecordNode::getTotalDroppedSamples() const
+{
+	return dataQueue->getTotalDroppedSamples();
+}
+
+int64 RecordNode::getDroppedEvents() const
+{
+	return eventQueue->getNumDroppedEvents();
+}
+
+int64 RecordNode::getDroppedSpikes() const
+{
+	return spikeQueue->getNumDroppedEvents();
+}
+
+bool RecordNode::hasDroppedData() const
+{
+	return getTotalDroppedSamples() > 0 || getDroppedEvents() > 0 || getDroppedSpikes() > 0;
+}
+
+void RecordNode::updateQueueSizes()
+{
+	if (overflowPolicy != GROW_QUEUE || !hasRecorded)
+		return;
+
+	/* The queues can only be resized while the record thread is stopped, so a recording
+	that overflowed or came close to it grows them for the next one */
+	if (getTotalDroppedSamples() > 0 || peakFifoUsage > QUEUE_GROW_THRESHOLD)
+	{
+		int nBlocks = jmin(dataQueue->getNumBlocks() * 2, DATA_BUFFER_MAX_NBLOCKS);
+		if (nBlocks != dataQueue->getNumBlocks())
+		{
+			LOGD("Record Node ", getNodeId(), ": growing data queue to ", nBlocks, " blocks");
+			dataQueue->resize(nBlocks);
+		}
+	}
+
+	if (getDroppedEvents() > 0)
+		eventQueue->resize(eventQueue->getSize() * 2);
+
+	if (getDroppedSpikes() > 0)
+		spikeQueue->resize(spikeQueue->getSize() * 2);
+}
+
+void RecordNode::reportDroppedData()
+{
+	if (!hasDroppedData())
+		return;
+
+	LOGD("Record Node ", getNodeId(), " dropped ", getTotalDroppedSamples(), " samples, ",
+		getDroppedEvents(), " events and ", getDroppedSpikes(), " spikes");
+
+	CoreServices::sendStatusMessage("Record Node " + String(getNodeId()) + " dropped data: " +
+		String(getTotalDroppedSamples()) + " samples, " + String(getDroppedEvents()) + " events, " +
+		String(getDroppedSpikes()) + " spikes");
+}
+
 void RecordNode::handleEvent(const EventChannel* eventInfo, const MidiMessage& event, int samplePosition)
 {
 
@@ -730,7 +1121,7 @@ void RecordNode::handleEvent(const EventChannel* eventInfo, const MidiMessage& e
 		if (!msgCenterMessages.contains(Event::getTimestamp(event)))
 		{
 			msgCenterMessages.add(Event::getTimestamp(event));
-			LOGD("Received message.");
+			LOGRT("Received message.");
 		}
 		else
 			return;
@@ -763,18 +1154,25 @@ void RecordNode::handleEvent(const EventChannel* eventInfo, const MidiMessage& e
 // only called if recordSpikes is true
 void RecordNode::handleSpike(const SpikeChannel* spikeInfo, const MidiMessage& event, int samplePosition)
 {
-    
-	SpikeEventPtr newSpike = SpikeEvent::deserializeFromMessage(event, spikeInfo);
-	if (!newSpike) 
+
+	if (recordSpikes)
 	{
-		LOGD("Unable to deserialize spike event!");
-		return;
+		//The spike is queued in its serialized form and only deserialized by the record thread.
+		//A spike held by the SpikeStore is copied out of it, as the store is emptied every block
+		int electrodeIndex = getSpikeChannelIndex(spikeInfo->getSourceIndex(), spikeInfo->getSourceNodeID(), spikeInfo->getSubProcessorIdx());
+
+		size_t size;
+		const uint8* spike = SpikeStore::getSpikeData(event, size);
+
+		if (electrodeIndex >= 0 && spike != nullptr)
+			spikeQueue->addEvent(spike, size, SpikeEvent::getTimestamp(event), electrodeIndex);
 	}
 
-	if (recordSpikes)
-		writeSpike(newSpike, spikeInfo);
-	
+}
 
+size_t RecordNode::getSerializedSpikeSize(const SpikeChannel* elec)
+{
+	return SPIKE_BASE_SIZE + elec->getDataSize() + elec->getNumChannels() * sizeof(float) + elec->getTotalEventMetaDataSize();
 }
 
 void RecordNode::handleTimestampSyncTexts(const MidiMessage& event)
@@ -793,14 +1191,18 @@ void RecordNode::process(AudioSampleBuffer& buffer)
 	if (isRecording)
 	{
 
+		if (triggeredRecording)
+			openTriggerWindows();
+
 		DataChannel* chan; 
 		int sourceID;
 		int subProcIdx;
 
 		for (int ch = 0; ch < channelMap.size(); ch++)
 		{
+			const bool firstInSubprocessor = firstRecordedChannels[channelMap[ch]];
 
-			if (isFirstChannelInRecordedSubprocessor(channelMap[ch]))
+			if (firstInSubprocessor)
 			{
 
 				chan = dataChannelArray[ch];
@@ -823,22 +1225,26 @@ void RecordNode::process(AudioSampleBuffer& buffer)
 			if (shouldWrite && numSamples > 0)
 			{
 
-				if (isFirstChannelInRecordedSubprocessor(channelMap[ch]))
+				if (firstInSubprocessor)
 				{
 					
 					if (useSynchronizer)
 					{
-						double first = synchronizer->convertTimestamp(sourceID, subProcIdx, timestamp);
-						double second = synchronizer->convertTimestamp(sourceID, subProcIdx, timestamp + 1);
-						fifoUsage[sourceID][subProcIdx] = dataQueue->writeSynchronizedTimestampChannel(first, second - first, ftsChannelMap[ch], numSamples);
+						/* The synchronized timestamps are linear between fits, so only a change of fit is queued */
+						int fitCount = synchronizer->getFitCount(sourceID, subProcIdx);
+						int syncChannel = ftsChannelMap[ch];
+
+						if (fitCount != syncFitCounts[syncChannel]
+							&& dataQueue->writeSyncSegment(synchronizer->getSyncSegment(sourceID, subProcIdx, timestamp), syncChannel))
+						{
+							syncFitCounts.set(syncChannel, fitCount);
+						}
 					}
-					else
-					{
-						fifoUsage[sourceID][subProcIdx] = dataQueue->writeChannel(buffer, channelMap[ch], ch, numSamples, timestamp);
-						samplesWritten+=numSamples;
-						continue;
-					}
-					
+
+					fifoUsage[sourceID][subProcIdx] = dataQueue->writeChannel(buffer, channelMap[ch], ch, numSamples, timestamp);
+					peakFifoUsage = jmax(peakFifoUsage, fifoUsage[sourceID][subProcIdx]);
+					samplesWritten+=numSamples;
+					continue;
 
 				}
 
@@ -849,6 +1255,8 @@ void RecordNode::process(AudioSampleBuffer& buffer)
 
 		}
 
+		writeDecimatedStreams(buffer);
+
 		if (!setFirstBlock)
 		{
 			bool shouldSetFlag = true;
@@ -871,10 +1279,84 @@ void RecordNode::process(AudioSampleBuffer& buffer)
 
 }
 
+// called by process method
+void RecordNode::writeDecimatedStreams(const AudioSampleBuffer& buffer)
+{
+	for (auto stream : decimatedStreams)
+	{
+		int firstChannel = stream->inputChannels[0];
+		int blockSamples = getNumSamples(firstChannel);
+		if (blockSamples <= 0)
+			continue;
+
+		int64 blockTimestamp = getTimestamp(firstChannel);
+		int64 firstOutput;
+		int numOutputs = stream->decimator->process(buffer, stream->inputChannels, blockSamples, blockTimestamp, decimatedBuffer, firstOutput);
+		if (numOutputs <= 0)
+			continue;
+
+		if (useSynchronizer)
+		{
+			int fitCount = synchronizer->getFitCount(stream->sourceID, stream->subProcIdx);
+
+			if (fitCount != syncFitCounts[stream->syncChannel]
+				&& dataQueue->writeSyncSegment(synchronizer->getSyncSegment(stream->sourceID, stream->subProcIdx, blockTimestamp).decimate(stream->decimator->getFactor()), stream->syncChannel))
+			{
+				syncFitCounts.set(stream->syncChannel, fitCount);
+			}
+		}
+
+		for (int c = 0; c < stream->inputChannels.size(); c++)
+			dataQueue->writeChannel(decimatedBuffer, c, stream->firstRecordedChannel + c, numOutputs, firstOutput);
+	}
+}
+
+// called by process method
+void RecordNode::openTriggerWindows()
+{
+	int start1, size1, start2, size2;
+	triggerFifo.prepareToRead(triggerFifo.getNumReady(), start1, size1, start2, size2);
+
+	for (int i = 0; i < size1 + size2; ++i)
+	{
+		const RecordingTrigger& trigger = triggers[i < size1 ? start1 + i : start2 + i - size1];
+
+		/* The trigger's time from the start of the current block, the same on every subprocessor.
+		A trigger from a subprocessor the node doesn't receive is placed at the start of the block */
+		const int64 blockStart = int64(getSourceTimestamp(trigger.sourceNodeId, trigger.subProcIdx));
+		const double offset = (blockStart > 0 && trigger.sampleRate > 0) ? double(trigger.timestamp - blockStart) / trigger.sampleRate : 0.0;
+
+		for (int ch = 0; ch < channelMap.size(); ++ch)
+			openTriggerWindow(ch, getTimestamp(channelMap[ch]), dataChannelArray[channelMap[ch]]->getSampleRate(), offset);
+
+		for (auto stream : decimatedStreams)
+		{
+			const int64 streamStart = getTimestamp(stream->inputChannels[0]) / stream->decimator->getFactor();
+
+			for (int c = 0; c < stream->inputChannels.size(); c++)
+			{
+				const int ch = stream->firstRecordedChannel + c;
+				openTriggerWindow(ch, streamStart, getRecordedDataChannel(ch)->getSampleRate(), offset);
+			}
+		}
+	}
+
+	triggerFifo.finishedRead(size1 + size2);
+}
+
+void RecordNode::openTriggerWindow(int recordedChannel, int64 blockTimestamp, float sampleRate, double offset)
+{
+	const int64 trigger = blockTimestamp + int64(std::floor(offset * sampleRate + 0.5));
+
+	dataQueue->writeTriggerWindow(recordedChannel,
+		trigger - int64(std::ceil(preTriggerSeconds * sampleRate)),
+		trigger + int64(std::ceil(postTriggerSeconds * sampleRate)));
+}
+
 // called by process method
 bool RecordNode::isFirstChannelInRecordedSubprocessor(int ch)
 {
-	return std::find(startRecChannels.begin(), startRecChannels.end(), ch) != startRecChannels.end();
+	return firstRecordedChannels[ch];
 }
 
 // called by ProcessorGraph::connectProcessors
@@ -882,20 +1364,23 @@ void RecordNode::registerProcessor(const GenericProcessor* sourceNode)
 {
 	settings.numInputs += sourceNode->getNumOutputs();
 	setPlayConfigDetails(getNumInputs(), getNumOutputs(), 44100.0, 128);
-	recordEngine->registerProcessor(sourceNode);
+	for (auto engine : engineArray)
+		engine->registerProcessor(sourceNode);
 }
 
 // not called
 void RecordNode::registerSpikeSource(const GenericProcessor *processor)
 {
-	recordEngine->registerSpikeSource(processor);
+	for (auto engine : engineArray)
+		engine->registerSpikeSource(processor);
 }
 
 // not called
 int RecordNode::addSpikeElectrode(const SpikeChannel *elec)
 {
 	spikeChannelArray.add(new SpikeChannel(*elec));
-	recordEngine->addSpikeElectrode(spikeElectrodeIndex, elec);
+	for (auto engine : engineArray)
+		engine->addSpikeElectrode(spikeElectrodeIndex, elec);
 	return spikeElectrodeIndex++;
 }
 
@@ -908,7 +1393,7 @@ void RecordNode::writeSpike(const SpikeEvent *spike, const SpikeChannel *spikeEl
 		int electrodeIndex = getSpikeChannelIndex(spikeElectrode->getSourceIndex(), spikeElectrode->getSourceNodeID(), spikeElectrode->getSubProcessorIdx());
 		
 		if (electrodeIndex >= 0)
-			spikeQueue->addEvent(*spike, spike->getTimestamp(), electrodeIndex);
+			spikeQueue->addEvent(*spike, getSerializedSpikeSize(spikeElectrode), spike->getTimestamp(), electrodeIndex);
 	}
 }
 
@@ -920,7 +1405,7 @@ void RecordNode::filenameComponentChanged(FilenameComponent *fnc)
 	newDirectoryNeeded = true;
 }
 
-// not called?
+// called by FifoMonitor
 float RecordNode::getFreeSpace() const
 {
 	return 1.0f - float(dataDirectory.getBytesFreeOnVolume()) / float(dataDirectory.getVolumeTotalSize());
@@ -12,21 +12,27 @@
 #include "../GenericProcessor/GenericProcessor.h"
 #include "RecordNodeEditor.h"
 #include "RecordThread.h"
+#include "Decimator.h"
 #include "DataQueue.h"
 #include "Synchronizer.h"
+#include "RecordingVerifier.h"
 #include "../../Utils/Utils.h"
 
 //#include "taskflow/taskflow.hpp"
 
 #define WRITE_BLOCK_LENGTH		1024
 #define DATA_BUFFER_NBLOCKS		300
+#define DATA_BUFFER_MAX_NBLOCKS	2400
+#define QUEUE_GROW_THRESHOLD	0.9f
 #define EVENT_BUFFER_NEVENTS	512
 #define SPIKE_BUFFER_NSPIKES	512
+#define EVENT_MIN_SLOT_SIZE		512
 
 #define NIDAQ_BIT_VOLTS			0.001221f
 #define NPX_BIT_VOLTS			0.195f
 #define MAX_BUFFER_SIZE			40960
 #define CHANNELS_PER_THREAD		384
+#define RECORDING_TRIGGER_QUEUE_SIZE	64
 
 class EventMonitor
 {
@@ -46,6 +52,13 @@ class RecordNode : public GenericProcessor, public FilenameComponentListener
 
 public:
 
+	/** What to do when the record queues overflow during a recording */
+	enum QueueOverflowPolicy
+	{
+		DROP_DATA = 0,	//Drop the samples that do not fit and keep the queue sizes
+		GROW_QUEUE		//Also enlarge the queues before the next recording
+	};
+
     /** Constructor
       - Creates: DataQueue, EventQueue, SpikeQueue, Synchronizer,
         RecordThread, EventMonitor
@@ -70,6 +83,7 @@ public:
 
 	AudioProcessorEditor* createEditor() override;
 	bool hasEditor() const override { return true; }
+	bool isReadOnly() const override { return true; }
 
 	void addSpecialProcessorChannels(Array<EventChannel*>& channels);
 
@@ -79,6 +93,14 @@ public:
 	void setSyncChannel(int srcIdx, int subProcIdx, int channel);
 	int getSyncChannel(int srcIdx, int subProcIdx);
 
+	/** Also records all the channels of a subprocessor downsampled by factor, as a stream of its own. 1 records none */
+	void setDecimationFactor(int srcIdx, int subProcIdx, int factor);
+	int getDecimationFactor(int srcIdx, int subProcIdx);
+
+	/** The channel behind an index of the engines' channel map: an input channel, or past
+		the input channels, a channel of a downsampled stream */
+	const DataChannel* getRecordedDataChannel(int index) const;
+
 	void updateSettings() override;
     bool enable() override;
 	bool disable() override;
@@ -87,6 +109,10 @@ public:
 	void prepareToPlay(double sampleRate, int estimatedSamplesPerBlock);
 	void startRecording() override;
 
+	/** Called by the record thread once the engines have opened their files. The node
+		only queues data from then on, so the queue does not fill up while they open */
+	void filesOpened();
+
 	String generateDirectoryName();
 	void createNewDirectory();
     void filenameComponentChanged(FilenameComponent *);
@@ -107,13 +133,61 @@ public:
 	std::vector<RecordEngineManager*> getAvailableRecordEngines();
 
 	void setEngine(int selectedEngineIndex);
+
+	/** Adds or removes an engine that records alongside the selected one, sharing the same DataQueue */
+	void setAdditionalEngine(int engineIndex, bool shouldRecord);
+	bool isAdditionalEngine(int engineIndex) const;
+	const Array<int>& getAdditionalEngines() const;
+
+	/** Returns true if any of the active engines uses the given engine ID */
+	bool isEngineActive(const String& engineID) const;
 	void setRecordEvents(bool);
 	void setRecordSpikes(bool);
+
+	void setQueueOverflowPolicy(QueueOverflowPolicy policy);
+	QueueOverflowPolicy getQueueOverflowPolicy() const;
+
+	/** In a triggered recording, the files are opened when the recording starts, but only the samples from
+		preSeconds before to postSeconds after each trigger are written to them, segment after segment.
+		Events and spikes are all written. Takes effect at the next recording */
+	void setTriggeredRecording(bool triggered, float preSeconds, float postSeconds);
+	bool isTriggeredRecording() const;
+
+	/** When set, each recording is checked for lost samples on a background thread once it
+		stops, and a continuity_report.json is written next to its structure.oebin */
+	void setVerifyRecordings(bool verify);
+	bool getVerifyRecordings() const;
+
+	/** When set, the samples are queued for the record thread as int16 counts of each channel's
+		bitVolts, the format Binary and Open Ephys files store, instead of as floats. Halves the
+		memory traffic of the queue. Takes effect at the next recording */
+	void setQueueRawSamples(bool raw);
+	bool getQueueRawSamples() const;
+
+	/** Writes the windows around a trigger at a timestamp of a source subprocessor, if a triggered
+		recording is running. Called from the processing thread; the windows are opened in the next block */
+	bool addRecordingTrigger(uint16 sourceNodeId, uint16 subProcIdx, int64 timestamp, float sampleRate);
+
+	/** Samples dropped by the data queue in the current or last recording, for a recorded channel index */
+	int64 getDroppedSamples(int recordedChannel) const;
+	/** Samples dropped across all channels of a subprocessor */
+	int64 getDroppedSamples(int srcIndex, int subProcIdx) const;
+	int64 getTotalDroppedSamples() const;
+	int64 getDroppedEvents() const;
+	int64 getDroppedSpikes() const;
+	bool hasDroppedData() const;
+
+	/** Write throughput, latency and queue depth of each active engine in the current or last recording */
+	void getIOStats(Array<EngineIOStats>& stats) const;
+	/** Seconds left until the data directory fills up at the current write rate, or -1 when nothing is being written */
+	double getRemainingRecordingTime() const;
+	/** Batch sizes of the last record thread pass and the queue occupancy they were chosen from */
+	WriteScheduleMetrics getWriteScheduleMetrics() const;
+
 	void setDataDirectory(File);
 	File getDataDirectory();
 
 	ScopedPointer<RecordThread> recordThread;
-	ScopedPointer<RecordEngine> recordEngine;
 	std::vector<RecordEngineManager*> availableEngines;	
 
     ScopedPointer<Synchronizer> synchronizer;
@@ -132,13 +206,15 @@ public:
 	std::map<int, std::map<int, int>> eventMap;
 	std::map<int, std::map<int, int>> syncChannelMap;
 	std::map<int, std::map<int, int>> syncOrderMap;
+	std::map<int, std::map<int, int>> decimationMap;
 
 	std::map<int, std::map<int, float>> fifoUsage;
 
 	Array<int> channelMap; //Map from record channel index to source channel index
 	Array<int> ftsChannelMap; // Map from recorded channel index to recorded source processor idx
+	Array<int> syncFitCounts; // Synchronizer fit of each recorded source processor last queued as a segment
 	std::vector<std::vector<int>> subProcessorMap;
-	std::vector<int> startRecChannels;
+	Array<bool> firstRecordedChannels; // True for the first recorded channel of each subprocessor, by source channel index
 
     bool isSyncReady;
 
@@ -164,8 +240,7 @@ public:
 
     bool newDirectoryNeeded;
 
-    /** Called by the ControlPanel to determine the amount of space
-        left in the current dataDirectory.
+    /** Fraction of the volume holding the current dataDirectory that is already used.
     */
     float getFreeSpace() const;
 
@@ -196,7 +271,7 @@ private:
 	int lastDataChannelArraySize;
 
     bool isProcessing;
-	bool isRecording;
+	std::atomic<bool> isRecording;
 	bool hasRecorded;
 	bool settingsNeeded;
     bool shouldRecord;
@@ -231,7 +306,67 @@ private:
 
 	virtual void handleTimestampSyncTexts(const MidiMessage& event);
 
-    /**RecordEngines loaded**/
+	/** Size in bytes of a serialized spike of the given electrode */
+	static size_t getSerializedSpikeSize(const SpikeChannel* elec);
+
+    /** Re-creates the engine array from the selected and additional engine indexes */
+    void instantiateEngines();
+
+    /** Applies the overflow policy to the queues before a new recording starts */
+    void updateQueueSizes();
+
+    /** Logs and reports how much data was dropped during the last recording */
+    void reportDroppedData();
+
+    /** Writes the downsampled streams of a block to the data queue */
+    void writeDecimatedStreams(const AudioSampleBuffer& buffer);
+
+    /** Queues the windows of the triggers received since the last block, for every recorded channel */
+    void openTriggerWindows();
+
+    /** Queues a window around a trigger offset seconds after the start of the current block of a channel */
+    void openTriggerWindow(int recordedChannel, int64 blockTimestamp, float sampleRate, double offset);
+
+    /** All channels of a subprocessor, downsampled while recording */
+    struct DecimatedStream
+    {
+        int sourceID;
+        int subProcIdx;
+        Array<int> inputChannels;       // input channel of each stream channel
+        int firstRecordedChannel;       // index of the first stream channel in the data queue
+        int syncChannel;
+        ScopedPointer<Decimator> decimator;
+    };
+
+    OwnedArray<DecimatedStream> decimatedStreams;
+    OwnedArray<DataChannel> decimatedChannels;
+    AudioSampleBuffer decimatedBuffer;
+
+    int selectedEngineIndex;
+    Array<int> additionalEngineIndexes;
+
+    QueueOverflowPolicy overflowPolicy;
+    float peakFifoUsage;
+
+    struct RecordingTrigger
+    {
+        uint16 sourceNodeId;
+        uint16 subProcIdx;
+        int64 timestamp;
+        float sampleRate;
+    };
+
+    bool verifyRecordings;
+    bool queueRawSamples;
+    ScopedPointer<RecordingVerifier> verifier;
+
+    bool triggeredRecording;
+    float preTriggerSeconds;
+    float postTriggerSeconds;
+    AbstractFifo triggerFifo;
+    HeapBlock<RecordingTrigger> triggers;
+
+    /**RecordEngines loaded. The first one is the engine selected in the editor**/
     OwnedArray<RecordEngine> engineArray;
 
 
@@ -76,7 +76,7 @@ RecordNodeEditor::RecordNodeEditor(RecordNode* parentNode, bool useDefaultParame
 	addAndMakeVisible(dataPathButton);
 
 	engineSelectCombo = new ComboBox("engineSelectCombo");
-	engineSelectCombo->setBounds(42, 66, 93, 20);
+	engineSelectCombo->setBounds(42, 66, 72, 20);
 
 	std::vector<RecordEngineManager*> engines = recordNode->getAvailableRecordEngines();
 	for (int i = 0; i < engines.size(); i++)
@@ -87,6 +87,12 @@ RecordNodeEditor::RecordNodeEditor(RecordNode* parentNode, bool useDefaultParame
 	engineSelectCombo->addListener(this);
 	addAndMakeVisible(engineSelectCombo);
 
+	additionalEnginesButton = new UtilityButton("+", Font(12));
+	additionalEnginesButton->setBounds(117, 66, 18, 20);
+	additionalEnginesButton->setTooltip("Record additional formats in parallel");
+	additionalEnginesButton->addListener(this);
+	addAndMakeVisible(additionalEnginesButton);
+
 	recordEventsLabel = new Label("recordEvents", "RECORD EVENTS");
 	recordEventsLabel->setBounds(40, 91, 80, 20);
 	recordEventsLabel->setFont(Font("Small Text", 10.0f, Font::plain));
@@ -133,8 +139,15 @@ void RecordNodeEditor::saveCustomParameters(XmlElement* xml)
     xmlNode->setAttribute ("path", dataPathLabel->getText());
 	//TODO: This should be the actual engine name instead of index in case engines added/removed between launches
     xmlNode->setAttribute ("engine", engineSelectCombo->getSelectedId());
+	StringArray additionalEngines;
+	for (auto index : recordNode->getAdditionalEngines())
+		additionalEngines.add(String(index + 1));
+	xmlNode->setAttribute ("additionalEngines", additionalEngines.joinIntoString(","));
 	xmlNode->setAttribute ("recordEvents", eventRecord->getToggleState());
 	xmlNode->setAttribute ("recordSpikes", spikeRecord->getToggleState());
+	xmlNode->setAttribute ("verifyRecordings", recordNode->getVerifyRecordings());
+	xmlNode->setAttribute ("queueRawSamples", recordNode->getQueueRawSamples());
+	xmlNode->setAttribute ("queueOverflowPolicy", (int)recordNode->getQueueOverflowPolicy());
 
 	//Save channel states:
 	for (auto srcID : extract_keys(recordNode->dataChannelStates))
@@ -151,6 +164,7 @@ void RecordNodeEditor::saveCustomParameters(XmlElement* xml)
 				subProcNode->setAttribute("sub_idx", subIdx);
 				subProcNode->setAttribute("isMaster", recordNode->synchronizer->masterProcessor == srcID && recordNode->synchronizer->masterSubprocessor == subIdx);
 				subProcNode->setAttribute("syncChannel", recordNode->syncChannelMap[srcID][subIdx]);
+				subProcNode->setAttribute("decimation", recordNode->getDecimationFactor(srcID, subIdx));
 
 				XmlElement* recStateNode = subProcNode->createNewChildElement("RECORDSTATE");
 
@@ -178,8 +192,19 @@ void RecordNodeEditor::loadCustomParameters(XmlElement* xml)
 			//Get saved record path
 		    dataPathLabel->setText(xmlNode->getStringAttribute("path"), juce::NotificationType::sendNotification);
 			engineSelectCombo->setSelectedId(xmlNode->getStringAttribute("engine").getIntValue());
+			StringArray additionalEngines;
+			additionalEngines.addTokens(xmlNode->getStringAttribute("additionalEngines"), ",", "");
+			for (auto engineId : additionalEngines)
+			{
+				if (engineId.getIntValue() > 0)
+					recordNode->setAdditionalEngine(engineId.getIntValue() - 1, true);
+			}
 			eventRecord->setToggleState((bool)(xmlNode->getStringAttribute("recordEvents").getIntValue()), juce::NotificationType::sendNotification);
 			spikeRecord->setToggleState((bool)(xmlNode->getStringAttribute("recordSpikes").getIntValue()), juce::NotificationType::sendNotification);
+			recordNode->setVerifyRecordings(xmlNode->getBoolAttribute("verifyRecordings", false));
+			recordNode->setQueueRawSamples(xmlNode->getBoolAttribute("queueRawSamples", false));
+			recordNode->setQueueOverflowPolicy(xmlNode->getIntAttribute("queueOverflowPolicy", RecordNode::DROP_DATA) == RecordNode::GROW_QUEUE
+				? RecordNode::GROW_QUEUE : RecordNode::DROP_DATA);
 
 			//std::cout << "Loading RecordNode settings" << std::endl;
 
@@ -199,6 +224,7 @@ void RecordNodeEditor::loadCustomParameters(XmlElement* xml)
 							recordNode->setMasterSubprocessor(srcID, subIdx);
 						}
 						recordNode->setSyncChannel(srcID, subIdx, subNode->getIntAttribute("syncChannel"));
+						recordNode->setDecimationFactor(srcID, subIdx, subNode->getIntAttribute("decimation", 1));
 
 						XmlElement* recordStates = subNode->getChildByName("RECORDSTATE");
 
@@ -231,6 +257,7 @@ void RecordNodeEditor::timerCallback()
 	{
 		dataPathButton->setEnabled(false);
 		engineSelectCombo->setEnabled(false);
+		additionalEnginesButton->setEnabled(false);
 		eventRecord->setEnabled(false);
 		spikeRecord->setEnabled(false);
 	}
@@ -238,6 +265,7 @@ void RecordNodeEditor::timerCallback()
 	{
 		dataPathButton->setEnabled(true);
 		engineSelectCombo->setEnabled(true);
+		additionalEnginesButton->setEnabled(true);
 		eventRecord->setEnabled(true);
 		spikeRecord->setEnabled(true);
 	}
@@ -352,6 +380,38 @@ void RecordNodeEditor::buttonEvent(Button *button)
 		recordNode->updateChannelStates(((SyncControlButton*)button)->srcIndex, ((SyncControlButton*)button)->subProcIdx, fifo->channelStates);
 		*/
 	}
+	else if (button == additionalEnginesButton && !recordNode->recordThread->isThreadRunning())
+	{
+		std::vector<RecordEngineManager*> engines = recordNode->getAvailableRecordEngines();
+
+		/* Past the ids of the engines */
+		const int verifyItem = 1000;
+		const int rawSamplesItem = 1001;
+		const int growQueuesItem = 1002;
+
+		PopupMenu menu;
+		for (int i = 0; i < engines.size(); i++)
+		{
+			if (i != getSelectedEngineIdx())
+				menu.addItem(i + 1, "Also record " + engines[i]->getName(), true, recordNode->isAdditionalEngine(i));
+		}
+		menu.addSeparator();
+		menu.addItem(verifyItem, "Check Binary recordings for lost data", true, recordNode->getVerifyRecordings());
+		menu.addItem(rawSamplesItem, "Queue raw int16 samples", !recordNode->getRecordThreadStatus(), recordNode->getQueueRawSamples());
+		menu.addItem(growQueuesItem, "Grow queues after overflows", true,
+			recordNode->getQueueOverflowPolicy() == RecordNode::GROW_QUEUE);
+
+		const int result = menu.show();
+		if (result == verifyItem)
+			recordNode->setVerifyRecordings(!recordNode->getVerifyRecordings());
+		else if (result == rawSamplesItem)
+			recordNode->setQueueRawSamples(!recordNode->getQueueRawSamples());
+		else if (result == growQueuesItem)
+			recordNode->setQueueOverflowPolicy(recordNode->getQueueOverflowPolicy() == RecordNode::GROW_QUEUE
+				? RecordNode::DROP_DATA : RecordNode::GROW_QUEUE);
+		else if (result > 0)
+			recordNode->setAdditionalEngine(result - 1, !recordNode->isAdditionalEngine(result - 1));
+	}
 	else if (button == dataPathButton)
 	{
 		LOGD("Change data write directory!");
@@ -448,6 +508,10 @@ void RecordNodeEditor::showSubprocessorFifos(bool show)
 		engineSelectCombo->getX() + dX, engineSelectCombo->getY(),
 		engineSelectCombo->getWidth(), engineSelectCombo->getHeight());
 
+	additionalEnginesButton->setBounds(
+		additionalEnginesButton->getX() + dX, additionalEnginesButton->getY(),
+		additionalEnginesButton->getWidth(), additionalEnginesButton->getHeight());
+
 	recordEventsLabel->setBounds(
 		recordEventsLabel->getX() + dX, recordEventsLabel->getY(),
 		recordEventsLabel->getWidth(), recordEventsLabel->getHeight());
@@ -510,6 +574,14 @@ SyncControlButton::~SyncControlButton() {}
 
 void SyncControlButton::timerCallback()
 {
+	const SyncFit fit = node->synchronizer->getFit(srcIndex, subProcIdx);
+
+	if (fit.isSynchronized)
+		setTooltip(String(fit.driftPpm, 2) + " ppm drift, " + String(fit.jitterSamples, 2) + " samples jitter ("
+			+ String(fit.numPulses) + " pulses, " + String(fit.numRejected) + " rejected)");
+	else
+		setTooltip(String());
+
     repaint();
 }
 
@@ -668,12 +740,51 @@ void RecordToggleButton::paintButton(Graphics &g, bool isMouseOver, bool isButto
 
 }
 
-FifoMonitor::FifoMonitor(RecordNode* node, int srcID, int subID) : recordNode(node), srcID(srcID), subID(subID), fillPercentage(0.5)
+FifoMonitor::FifoMonitor(RecordNode* node, int srcID, int subID) : recordNode(node), srcID(srcID), subID(subID), fillPercentage(0.5), droppedSamples(0)
 {
 
 	startTimer(500);
 }
 
+void FifoMonitor::mouseDown(const MouseEvent &event)
+{
+	if (!event.mods.isRightButtonDown() || srcID < 0 || recordNode->recordThread->isThreadRunning())
+		return;
+
+	/* The sample rate of the subprocessor, to show the rate each factor leads to */
+	float sampleRate = 0.0f;
+	for (int ch = 0; ch < recordNode->getTotalDataChannels(); ch++)
+	{
+		const DataChannel* chan = recordNode->getDataChannel(ch);
+		if (chan->getSourceNodeID() == srcID && chan->getSubProcessorIdx() == subID)
+		{
+			sampleRate = chan->getSampleRate();
+			break;
+		}
+	}
+
+	const int factors[] = { 2, 4, 5, 10, 20, 25, 30, 50, 100 };
+	const int currentFactor = recordNode->getDecimationFactor(srcID, subID);
+
+	PopupMenu menu;
+	menu.addSectionHeader("Also record all channels downsampled");
+	menu.addItem(1, "Off", true, currentFactor == 1);
+	for (int factor : factors)
+	{
+		String text = "By " + String(factor);
+		if (sampleRate > 0)
+			text += " (" + String(sampleRate / factor, 0) + " Hz)";
+		menu.addItem(factor, text, true, currentFactor == factor);
+	}
+
+	const int result = menu.show();
+	if (result > 0)
+	{
+		recordNode->setDecimationFactor(srcID, subID, result);
+		repaint();
+	}
+}
+
 /* RECORD CHANNEL SELECTOR LISTENER */
 void FifoMonitor::mouseDoubleClick(const MouseEvent &event)
 {
@@ -702,9 +813,7 @@ void FifoMonitor::componentBeingDeleted(Component &component)
 
 	auto* channelSelector = (RecordChannelSelector*)component.getChildComponent(0);
 
-	channelStates.clear();
-	for (auto* btn : channelSelector->channelButtons)
-		channelStates.push_back(btn->getToggleState());
+	channelStates = channelSelector->getChannelStates();
 
 	recordNode->updateChannelStates(srcID, subID, channelStates);
 
@@ -716,16 +825,59 @@ void FifoMonitor::timerCallback()
 
 	if (srcID < 0) /* Disk space monitor */
 	{
-		float diskSpace = (float)recordNode->getDataDirectory().getBytesFreeOnVolume() / recordNode->getDataDirectory().getVolumeTotalSize();
-		setFillPercentage(1.0f - diskSpace);
+		setFillPercentage(recordNode->getFreeSpace());
+		updateIOTooltip();
 	}
 	else /* Subprocessor monitor */
 	{
+		int64 dropped = recordNode->getDroppedSamples(srcID, subID);
+		if (dropped != droppedSamples)
+		{
+			droppedSamples = dropped;
+			setTooltip(dropped > 0 ? String(dropped) + " samples dropped" : String::empty);
+		}
 		setFillPercentage(recordNode->fifoUsage[srcID][subID]);
 	}
 
 }
 
+void FifoMonitor::updateIOTooltip()
+{
+	String text = String(recordNode->getDataDirectory().getBytesFreeOnVolume() / (1024.0 * 1024.0 * 1024.0), 1) + " GB free";
+
+	double remaining = recordNode->getRemainingRecordingTime();
+	if (remaining >= 0)
+		text += ", " + String(remaining / 3600.0, 1) + " h at the current rate";
+
+	Array<EngineIOStats> stats;
+	recordNode->getIOStats(stats);
+
+	for (auto& s : stats)
+	{
+		text += "\n" + s.engineID + ": " + String(s.bytesPerSecond / (1024.0 * 1024.0), 1) + " MB/s";
+
+		if (s.numWrites > 0)
+			text += ", write " + String(s.getLatencyPercentile(0.5f), 2) + " ms median, "
+				+ String(s.getLatencyPercentile(0.99f), 2) + " ms p99, "
+				+ String(s.maxLatencyMs, 2) + " ms max";
+
+		if (s.pendingWrites > 0)
+			text += ", " + String(s.pendingWrites) + " blocks queued";
+	}
+
+	if (recordNode->getRecordThreadStatus())
+	{
+		const WriteScheduleMetrics batches = recordNode->getWriteScheduleMetrics();
+		text += "\nWrite batches: " + String(batches.samples) + " samples ("
+			+ String(roundToInt(batches.dataFill * 100)) + "% queued), "
+			+ String(batches.events) + " events (" + String(roundToInt(batches.eventFill * 100)) + "%), "
+			+ String(batches.spikes) + " spikes (" + String(roundToInt(batches.spikeFill * 100)) + "%)";
+	}
+
+	if (text != getTooltip())
+		setTooltip(text);
+}
+
 void FifoMonitor::setFillPercentage(float fill_)
 {
 	fillPercentage = fill_;
@@ -735,7 +887,8 @@ void FifoMonitor::setFillPercentage(float fill_)
 
 void FifoMonitor::paint(Graphics &g)
 {
-	g.setColour(Colours::grey);
+	/* A red frame flags a queue that has overflowed during this recording */
+	g.setColour(droppedSamples > 0 ? Colours::red : Colours::grey);
 	g.fillRoundedRectangle(0, 0, this->getWidth(), this->getHeight(), 4);
 	g.setColour(Colours::lightslategrey);
 	g.fillRoundedRectangle(2, 2, this->getWidth() - 4, this->getHeight() - 4, 2);
@@ -749,4 +902,11 @@ void FifoMonitor::paint(Graphics &g)
 	
 	float barHeight = (this->getHeight() - 4) * fillPercentage;
 	g.fillRoundedRectangle(2, this->getHeight() - 2 - barHeight, this->getWidth() - 4, barHeight, 2);
+
+	/* A dot marks a subprocessor that also records a downsampled stream */
+	if (srcID >= 0 && recordNode->getDecimationFactor(srcID, subID) > 1)
+	{
+		g.setColour(Colours::white);
+		g.fillEllipse(this->getWidth() / 2 - 2, 4, 4, 4);
+	}
 }
@@ -40,15 +40,21 @@ private:
 	void paintButton(Graphics& g, bool isMouseOver, bool isButtonDown) override;
 };
 
-class FifoMonitor : public Component, public Timer, public ComponentListener
+class FifoMonitor : public Component, public Timer, public ComponentListener, public SettableTooltipClient
 {
 public:
 	FifoMonitor(RecordNode*, int, int);
 
 	void setFillPercentage(float percentage);
 
+	/** Shows the free disk space and the I/O telemetry of every engine */
+	void updateIOTooltip();
+
 	void timerCallback();
 
+	/** Right-click chooses the downsampled stream recorded for the subprocessor */
+	void mouseDown(const MouseEvent &event);
+
 	void mouseDoubleClick(const MouseEvent &event);
 
 	void componentBeingDeleted(Component &component);
@@ -57,10 +63,10 @@ public:
 
 private :
 
-	OwnedArray<ChannelButton> channelButtons;
 	void paint(Graphics &g);
 
 	float fillPercentage;
+	int64 droppedSamples;
 	RecordNode *recordNode;
 	int srcID;
 	int subID;
@@ -146,6 +152,7 @@ private:
 	ScopedPointer<Label> engineSelectLabel;
 	ScopedPointer<Label> dataPathLabel;
 	ScopedPointer<Button> dataPathButton;
+	ScopedPointer<Button> additionalEnginesButton;
 	ScopedPointer<Label> recordEventsLabel;
 	ScopedPointer<RecordToggleButton> eventRecord;
 	ScopedPointer<Label> recordSpikesLabel;
@@ -22,25 +22,74 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "RecordThread.h"
-//#include "RecordEngine.h"
-//#include "../ProcessorGraph/ProcessorGraph.h"
 #include "RecordNode.h"
+#include "../../Utils/PipelineTrace.h"
+#include "../../Utils/ThreadConfig.h"
 
-//#define EVERY_ENGINE for(int eng = 0; eng < m_engineArray.size(); eng++) m_engineArray[eng]
-#define EVERY_ENGINE m_engine;
+RecordEngineWorker::RecordEngineWorker(RecordThread* parentThread, int engineIndex) :
+Thread("Record Engine Worker " + String(engineIndex)),
+m_parentThread(parentThread),
+m_engineIndex(engineIndex)
+{
+}
+
+RecordEngineWorker::~RecordEngineWorker()
+{
+	stopWorker();
+}
+
+void RecordEngineWorker::startBlock()
+{
+	m_doneEvent.reset();
+	m_startEvent.signal();
+}
 
-RecordThread::RecordThread(RecordNode* parentNode, const ScopedPointer<RecordEngine>& engine) :
+void RecordEngineWorker::waitForBlock()
+{
+	while (isThreadRunning() && !m_doneEvent.wait(10)) {}
+}
+
+void RecordEngineWorker::stopWorker()
+{
+	signalThreadShouldExit();
+	m_startEvent.signal();
+	stopThread(1000);
+}
+
+void RecordEngineWorker::run()
+{
+	while (!threadShouldExit())
+	{
+		if (!m_startEvent.wait(100))
+			continue;
+
+		if (threadShouldExit())
+			break;
+
+		m_parentThread->writeEngineBlock(m_engineIndex);
+		m_doneEvent.signal();
+	}
+	m_doneEvent.signal();
+}
+
+RecordThread::RecordThread(RecordNode* parentNode, const OwnedArray<RecordEngine>& engines) :
 Thread("Record Thread"),
-m_engine(engine),
+m_engineArray(engines),
 recordNode(parentNode),
 m_receivedFirstBlock(false),
 m_cleanExit(true),
-samplesWritten(0)
+samplesWritten(0),
+m_dataBuffer(nullptr),
+m_lastBlock(false),
+m_useSynchronizer(false),
+m_int16Samples(false),
+m_triggered(false)
 {
 }
 
 RecordThread::~RecordThread()
 {
+	m_workers.clear();
 }
 
 void RecordThread::setFileComponents(File rootFolder, int experimentNumber, int recordingNumber)
@@ -70,7 +119,9 @@ void RecordThread::setChannelMap(const Array<int>& channels)
 		return;
 	m_channelArray = channels;
 	m_numChannels = channels.size();
-	
+	m_readPointers.calloc(2 * m_numChannels + 1);
+	m_int16ReadPointers.calloc(2 * m_numChannels + 1);
+
 }
 
 void RecordThread::setQueuePointers(DataQueue* data, EventMsgQueue* events, SpikeMsgQueue* spikes)
@@ -89,202 +140,319 @@ void RecordThread::setFirstBlockFlag(bool state)
 void RecordThread::run()
 {
 	const AudioSampleBuffer& dataBuffer = m_dataQueue->getAudioBufferReference();
-	const SynchronizedTimestampBuffer& ftsBuffer = m_dataQueue->getFTSBufferReference();
 
-	bool closeEarly = true;
-	//1-Wait until the first block has arrived, so we can align the timestamps
-	bool isWaiting = false;
-	while (!m_receivedFirstBlock && !threadShouldExit())
+	//0-Fault in the queue from this thread, which places its pages next to the reader
+	m_dataQueue->prefault();
+
+	//The queue is read in synchronized mode if any of the engines consumes synchronized timestamps
+	m_useSynchronizer = false;
+	for (auto engine : m_engineArray)
 	{
-		if (!isWaiting)
-		{
-			isWaiting = true;
-		}
-		wait(1);
+		if (RecordEngine::usesSynchronizedTimestamps(engine->getEngineID()))
+			m_useSynchronizer = true;
 	}
 
-	//2-Open Files 
+	m_triggered = m_dataQueue->isTriggeredRecording();
+	m_int16Samples = m_dataQueue->usesInt16Samples();
+	m_nextTimestamps.clearQuick();
+	m_nextTimestamps.insertMultiple(0, -1, m_numChannels);
+	m_skippedSamples.clearQuick();
+	m_skippedSamples.insertMultiple(0, 0, m_numChannels);
+
+	for (auto engine : m_engineArray)
+		engine->updateSkippedSamples(m_skippedSamples);
+
+	//1-Open Files while the recording is armed, before the node queues any data.
+	//The engines learn the start timestamps from the first block they write.
+	bool filesOpen = false;
 	if (!threadShouldExit())
 	{
 		m_cleanExit = false;
-		closeEarly = false;
-		Array<int64> timestamps;
-		m_dataQueue->getTimestampsForBlock(0, timestamps);
-
-		//EVERY_ENGINE->updateTimestamps(timestamps);
-		m_engine->updateTimestamps(timestamps);
-		//EVERY_ENGINE->openFiles(m_rootFolder, m_experimentNumber, m_recordingNumber);
-		//LOGD(__FUNCTION__, " Opening files w/ experiment number: ", m_experimentNumber);
-		m_engine->openFiles(m_rootFolder, m_experimentNumber, m_recordingNumber);
+		filesOpen = true;
+
+		for (auto engine : m_engineArray)
+			engine->openFiles(m_rootFolder, m_experimentNumber, m_recordingNumber);
+
+		StringArray engineIDs;
+		for (auto engine : m_engineArray)
+			engineIDs.add(engine->getEngineID());
+		m_ioMonitor.reset(engineIDs);
+
+		//The first engine is written from this thread, every additional one gets its own worker
+		m_workers.clear();
+		for (int eng = 1; eng < m_engineArray.size(); eng++)
+		{
+			m_workers.add(new RecordEngineWorker(this, eng));
+			ThreadConfig::startThread(*m_workers.getLast(), ThreadConfig::RECORD_IO);
+		}
+
+		recordNode->filesOpened();
 	}
 
-	bool useSynchronizer = m_engine->getEngineID() == "RAWBINARY";
+	//2-Wait until the first block has arrived, so we can align the timestamps. setFirstBlockFlag wakes the thread up
+	while (!m_receivedFirstBlock && !threadShouldExit())
+		wait(-1);
+
+	const bool receivedData = m_receivedFirstBlock;
 
 	//3-Normal loop
-	if (useSynchronizer)
+	m_scheduler.reset();
+	while (!threadShouldExit())
 	{
-		while (!threadShouldExit())
-			writeSynchronizedData(dataBuffer, ftsBuffer, BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES);
-	}
-	else
-	{
-		while (!threadShouldExit())
-			writeData(dataBuffer, BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES);
+		m_scheduler.schedule(m_dataQueue->getNumReadySamples(), m_dataQueue->getCapacity(),
+			m_eventQueue->getRemainingEvents(), m_eventQueue->getSize(),
+			m_spikeQueue->getRemainingEvents(), m_spikeQueue->getSize());
+		writeData(dataBuffer, m_scheduler.getMaxSamples(), m_scheduler.getMaxEvents(), m_scheduler.getMaxSpikes());
 	}
 	
-	//LOGD(__FUNCTION__, " Exiting record thread");
 	//4-Before closing the thread, try to write the remaining samples
-	if (!closeEarly)
+	if (filesOpen)
 	{
-		writeData(dataBuffer, -1, -1, -1, true);
-		//LOGD(__FUNCTION__, " Closing files");
+		if (receivedData)
+		{
+			//A trigger can no longer arrive, so the pre-trigger ring is written out as far as its windows go
+			m_dataQueue->releaseHeldSamples();
+			writeData(dataBuffer, -1, -1, -1, true);
+		}
+
+		m_workers.clear();
+
 		//5-Close files
-		//EVERY_ENGINE->closeFiles();
-		m_engine->closeFiles();
+		for (auto engine : m_engineArray)
+			engine->closeFiles();
 	}
 	m_cleanExit = true;
 	m_receivedFirstBlock = false;
 
 }
 
-void RecordThread::writeSynchronizedData(const AudioSampleBuffer& dataBuffer, const SynchronizedTimestampBuffer& ftsBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock)
+void RecordThread::writeData(const AudioSampleBuffer& dataBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock)
 {
+	TRACE_SCOPE("record", "write block");
 
-	Array<int64> timestamps;
-	Array<CircularBufferIndexes> dataBufferIdxs;
-	Array<CircularBufferIndexes> ftsBufferIdxs;
-	m_dataQueue->startSynchronizedRead(dataBufferIdxs, ftsBufferIdxs, timestamps, maxSamples);
-	m_engine->updateTimestamps(timestamps);
-	m_engine->startChannelBlock(lastBlock);
-
-	/* Copy data to record engine */
-	for (int chan = 0; chan < m_numChannels; ++chan)
-	{
-
-		if (dataBufferIdxs[chan].size1 > 0)
-		{
-			m_engine->writeSynchronizedData(chan, chan, 
-				dataBuffer.getReadPointer(chan, dataBufferIdxs[chan].index1),
-				ftsBuffer.getReadPointer(m_ftsChannelArray[chan], dataBufferIdxs[chan].index1), dataBufferIdxs[chan].size1);
-
-			samplesWritten+=dataBufferIdxs[chan].size1;
+	m_dataBuffer = &dataBuffer;
+	m_lastBlock = lastBlock;
 
-			if (dataBufferIdxs[chan].size2 > 0)
-			{
-				timestamps.set(chan, timestamps[chan] + dataBufferIdxs[chan].size1);
-				m_engine->updateTimestamps(timestamps, chan);
-				m_engine->writeSynchronizedData(chan, chan,
-					dataBuffer.getReadPointer(chan, dataBufferIdxs[chan].index2),
-					ftsBuffer.getReadPointer(m_ftsChannelArray[chan], ftsBufferIdxs[m_ftsChannelArray[chan]].index2), dataBufferIdxs[chan].size2);
-				samplesWritten += dataBufferIdxs[chan].size2;
-			}
-		}
-	}
-
-	m_dataQueue->stopSynchronizedRead();
-	//EVERY_ENGINE->endChannelBlock(lastBlock);
-	m_engine->endChannelBlock(lastBlock);
+	/* Read the queues once; every engine works from the same indexes */
+	if (m_useSynchronizer)
+		m_dataQueue->startSynchronizedRead(m_dataBufferIdxs, m_segmentIdxs, m_blockTimestamps, maxSamples);
+	else
+		m_dataQueue->startRead(m_dataBufferIdxs, m_blockTimestamps, maxSamples);
 
-	std::vector<EventMessagePtr> events;
-	int nEvents = m_eventQueue->getEvents(events, maxEvents);
+	if (m_triggered)
+		countSkippedSamples();
 
-	for (int ev = 0; ev < nEvents; ++ev)
+	/* Consecutive channels read over the same ranges are handed to the engines together */
+	DataQueue::getReadSpans(m_dataBufferIdxs, m_dataSpans);
+	for (const auto& span : m_dataSpans)
 	{
-		const MidiMessage& event = events[ev]->getData();
-		if (SystemEvent::getBaseType(event) == SYSTEM_EVENT)
-		{
+		const CircularBufferIndexes& idx = m_dataBufferIdxs.getReference(span.firstChannel);
+		const int wrapped = m_numChannels + span.firstChannel;
 
-			uint16 sourceID = SystemEvent::getSourceID(event);
-			uint16 subProcIdx = SystemEvent::getSubProcessorIdx(event);
-			int64 timestamp = SystemEvent::getTimestamp(event);
-			m_engine->writeTimestampSyncText(sourceID, subProcIdx, timestamp,
-				recordNode->getSourceTimestamp(sourceID, subProcIdx),
-				SystemEvent::getSyncText(event));
+		if (m_int16Samples)
+		{
+			m_dataQueue->getInt16ReadPointers(span.firstChannel, span.numChannels, idx.index1, m_int16ReadPointers + span.firstChannel);
+			m_dataQueue->getInt16ReadPointers(span.firstChannel, span.numChannels, idx.index2, m_int16ReadPointers + wrapped);
 		}
 		else
-			m_engine->writeEvent(events[ev]->getExtra(), events[ev]->getData());
+		{
+			m_dataQueue->getReadPointers(span.firstChannel, span.numChannels, idx.index1, m_readPointers + span.firstChannel);
+			m_dataQueue->getReadPointers(span.firstChannel, span.numChannels, idx.index2, m_readPointers + wrapped);
+		}
 	}
 
-	std::vector<SpikeMessagePtr> spikes;
-	int nSpikes = m_spikeQueue->getEvents(spikes, maxSpikes);
+	/* Events and spikes are copied out of the queue slots, so those can be released right away */
+	m_events.clearQuick();
+	m_eventChannels.clearQuick();
+	m_eventQueue->startRead(m_eventSpans, maxEvents);
+	for (auto& span : m_eventSpans)
+	{
+		m_events.add(span.toMessage());
+		m_eventChannels.add(span.extra);
+	}
+	m_eventQueue->stopRead();
 
-	for (int sp = 0; sp < nSpikes; ++sp)
+	m_spikes.clearQuick(true);
+	m_spikeElectrodes.clearQuick();
+	m_spikeQueue->startRead(m_spikeSpans, maxSpikes);
+	for (auto& span : m_spikeSpans)
 	{
-		if (spikes[sp] != NULL)
+		SpikeEventPtr spike = SpikeEvent::deserializeFromMessage(span.toMessage(), recordNode->getSpikeChannel(span.extra));
+		if (spike != nullptr)
 		{
-			m_engine->writeSpike(spikes[sp]->getExtra(), &spikes[sp]->getData());
+			m_spikes.add(spike.release());
+			m_spikeElectrodes.add(span.extra);
 		}
-		//m_engine->writeSpike(0, &spikes[sp]->getData());
 	}
+	m_spikeQueue->stopRead();
+
+	for (auto worker : m_workers)
+		worker->startBlock();
+
+	writeEngineBlock(0);
+
+	for (auto worker : m_workers)
+		worker->waitForBlock();
+
+	/* All engines are done with the block, so the queue space can be released */
+	if (m_useSynchronizer)
+		m_dataQueue->stopSynchronizedRead();
+	else
+		m_dataQueue->stopRead();
 }
 
-void RecordThread::writeData(const AudioSampleBuffer& dataBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock)
+void RecordThread::writeEngineBlock(int engineIndex)
 {
-	Array<int64> timestamps;
-	Array<CircularBufferIndexes> idx;
-	m_dataQueue->startRead(idx, timestamps, maxSamples);
-	m_engine->updateTimestamps(timestamps);
-	m_engine->startChannelBlock(lastBlock);
-	for (int chan = 0; chan < m_numChannels; ++chan)
+	RecordEngine* engine = m_engineArray[engineIndex];
+	if (engine == nullptr)
+		return;
+
+	const bool writeSynchronized = m_useSynchronizer && RecordEngine::usesSynchronizedTimestamps(engine->getEngineID());
+	const int64 startSamples = samplesWritten;
+	const int64 blockStartTicks = Time::getHighResolutionTicks();
+	int64 startTicks = blockStartTicks;
+	int64 blockSamples = 0;
+
+	//Each engine gets its own copy, as the timestamps are updated when the circular buffer wraps
+	Array<int64> timestamps(m_blockTimestamps);
+	engine->updateTimestamps(timestamps);
+	if (m_triggered)
+		engine->updateSkippedSamples(m_skippedSamples);
+	engine->startChannelBlock(m_lastBlock);
+
+	/* Hand the new segments of the synchronized timestamps to the first channel of each recorded processor */
+	if (writeSynchronized)
 	{
-		if (idx[chan].size1 > 0)
+		for (int chan = 0; chan < m_numChannels; ++chan)
 		{
-			m_engine->writeData(chan, chan, dataBuffer.getReadPointer(chan, idx[chan].index1), idx[chan].size1);
-			samplesWritten+=idx[chan].size1;
-			if (idx[chan].size2 > 0)
-			{
-				timestamps.set(chan, timestamps[chan] + idx[chan].size1);
-				m_engine->updateTimestamps(timestamps, chan);
-				m_engine->writeData(chan, chan, dataBuffer.getReadPointer(chan, idx[chan].index2), idx[chan].size2);
-				samplesWritten += idx[chan].size2;
-			}
+			int syncChannel = m_ftsChannelArray[chan];
+			if (chan > 0 && m_ftsChannelArray[chan - 1] == syncChannel)
+				continue;
+
+			const CircularBufferIndexes& idx = m_segmentIdxs.getReference(syncChannel);
+
+			for (int i = 0; i < idx.size1; ++i)
+				engine->writeSyncSegment(chan, m_dataQueue->getSyncSegment(syncChannel, idx.index1 + i));
+
+			for (int i = 0; i < idx.size2; ++i)
+				engine->writeSyncSegment(chan, m_dataQueue->getSyncSegment(syncChannel, idx.index2 + i));
 		}
 	}
-	/* TODO: Writing float timestamps
-	for (int chan = 0; chan < m_numFTSChannels; ++chan)
+
+	/* Copy data to record engine, a span of channels at a time */
+	for (const auto& span : m_dataSpans)
 	{
-		if (tsIdx[chan].size1 > 0)
+		const CircularBufferIndexes& idx = m_dataBufferIdxs.getReference(span.firstChannel);
+		const int first = span.firstChannel;
+
+		if (idx.size1 > 0)
 		{
-			m_engine->writeFloatTimestamps();
+			if (m_int16Samples)
+				engine->writeInt16DataBlock(first, m_int16ReadPointers + first, span.numChannels, idx.size1, timestamps.getRawDataPointer() + first);
+			else
+				engine->writeDataBlock(first, m_readPointers + first, span.numChannels, idx.size1, timestamps.getRawDataPointer() + first);
+
+			if (idx.size2 > 0)
+			{
+				for (int chan = first; chan < first + span.numChannels; ++chan)
+				{
+					timestamps.set(chan, timestamps[chan] + idx.size1);
+					engine->updateTimestamps(timestamps, chan);
+				}
+
+				const int wrapped = m_numChannels + first;
+				if (m_int16Samples)
+					engine->writeInt16DataBlock(first, m_int16ReadPointers + wrapped, span.numChannels, idx.size2, timestamps.getRawDataPointer() + first);
+				else
+					engine->writeDataBlock(first, m_readPointers + wrapped, span.numChannels, idx.size2, timestamps.getRawDataPointer() + first);
+			}
+
+			const int64 spanSamples = int64(idx.size1 + idx.size2) * span.numChannels;
+			blockSamples += spanSamples;
+
+			if (engineIndex == 0)
+				samplesWritten += spanSamples;
 		}
 	}
-	*/
-	m_dataQueue->stopRead();
-	//EVERY_ENGINE->endChannelBlock(lastBlock);
-	m_engine->endChannelBlock(lastBlock);
 
-	//LOGD("RecordThread::writeData:: write events...");
+	engine->endChannelBlock(m_lastBlock);
 
-	std::vector<EventMessagePtr> events;
-	int nEvents = m_eventQueue->getEvents(events, maxEvents);
+	/* The scheduler measures throughput on the first engine, which bounds how fast the block is released */
+	if (engineIndex == 0)
+	{
+		int64 now = Time::getHighResolutionTicks();
+		if (m_numChannels > 0)
+			m_scheduler.recordWrite(WriteScheduler::DATA, int((samplesWritten - startSamples) / m_numChannels), now - startTicks);
+		startTicks = now;
+	}
 
-	for (int ev = 0; ev < nEvents; ++ev)
+	for (int ev = 0; ev < m_events.size(); ++ev)
 	{
-		const MidiMessage& event = events[ev]->getData();
+		const MidiMessage& event = m_events.getReference(ev);
 		if (SystemEvent::getBaseType(event) == SYSTEM_EVENT)
 		{
 			uint16 sourceID = SystemEvent::getSourceID(event);
 			uint16 subProcIdx = SystemEvent::getSubProcessorIdx(event);
 			int64 timestamp = SystemEvent::getTimestamp(event);
-			m_engine->writeTimestampSyncText(sourceID, subProcIdx, timestamp,
+			engine->writeTimestampSyncText(sourceID, subProcIdx, timestamp,
 				recordNode->getSourceTimestamp(sourceID, subProcIdx),
 				SystemEvent::getSyncText(event));
 		}
 		else
-			m_engine->writeEvent(events[ev]->getExtra(), events[ev]->getData());
+			engine->writeEvent(m_eventChannels[ev], event);
 	}
 
-	std::vector<SpikeMessagePtr> spikes;
-	int nSpikes = m_spikeQueue->getEvents(spikes, maxSpikes);
+	if (engineIndex == 0)
+	{
+		int64 now = Time::getHighResolutionTicks();
+		m_scheduler.recordWrite(WriteScheduler::EVENTS, m_events.size(), now - startTicks);
+		startTicks = now;
+	}
 
-	for (int sp = 0; sp < nSpikes; ++sp)
+	for (int sp = 0; sp < m_spikes.size(); ++sp)
 	{
-		if (spikes[sp] != NULL)
-		{
-			m_engine->writeSpike(spikes[sp]->getExtra(), &spikes[sp]->getData());
-		}
+		engine->writeSpike(m_spikeElectrodes[sp], m_spikes[sp]);
+	}
+
+	const int64 endTicks = Time::getHighResolutionTicks();
+
+	if (engineIndex == 0)
+		m_scheduler.recordWrite(WriteScheduler::SPIKES, m_spikes.size(), endTicks - startTicks);
+
+	m_ioMonitor.recordWrite(engineIndex, blockSamples * sizeof(int16), endTicks - blockStartTicks, engine->getNumPendingWrites());
+}
+
+void RecordThread::countSkippedSamples()
+{
+	for (int chan = 0; chan < m_numChannels; ++chan)
+	{
+		const CircularBufferIndexes& idx = m_dataBufferIdxs.getReference(chan);
+		const int size = idx.size1 + idx.size2;
+		const int64 start = m_blockTimestamps[chan];
+
+		//The engines start their files at the timestamps of the first block, even an empty one
+		if (m_nextTimestamps[chan] < 0)
+			m_nextTimestamps.set(chan, start);
+
+		if (size == 0)
+			continue;
+
+		const int64 next = m_nextTimestamps[chan];
+		if (start > next)
+			m_skippedSamples.set(chan, m_skippedSamples[chan] + start - next);
+
+		m_nextTimestamps.set(chan, start + size);
 	}
+}
 
+WriteScheduleMetrics RecordThread::getWriteScheduleMetrics() const
+{
+	return m_scheduler.getMetrics();
+}
+
+const RecordIOMonitor& RecordThread::getIOMonitor() const
+{
+	return m_ioMonitor;
 }
 
 void RecordThread::forceCloseFiles()
@@ -292,7 +460,7 @@ void RecordThread::forceCloseFiles()
 	if (isThreadRunning() || m_cleanExit)
 		return;
 
-	//EVERY_ENGINE->closeFiles();
-	m_engine->closeFiles();
+	for (auto engine : m_engineArray)
+		engine->closeFiles();
 	m_cleanExit = true;
-}
\ No newline at end of file
+}
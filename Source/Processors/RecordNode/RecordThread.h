@@ -27,20 +27,49 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "BinaryFormat/BinaryRecording.h"
 #include "EventQueue.h"
 #include "DataQueue.h"
+#include "WriteScheduler.h"
+#include "RecordIOMonitor.h"
 #include "../../Utils/Utils.h"
 #include <atomic>
 
-#define BLOCK_MAX_WRITE_SAMPLES 4096
-#define BLOCK_MAX_WRITE_EVENTS 32
-#define BLOCK_MAX_WRITE_SPIKES 32
-
 class RecordNode;
+class RecordThread;
+
+/** Worker that writes the block currently held by a RecordThread to one of its
+	additional engines, so that several formats can be written in parallel from a
+	single DataQueue read. The first engine is always written by the RecordThread itself.
+*/
+class RecordEngineWorker : public Thread
+{
+public:
+	RecordEngineWorker(RecordThread* parentThread, int engineIndex);
+	~RecordEngineWorker();
+
+	/** Wakes the worker up to write the current block */
+	void startBlock();
+
+	/** Blocks until the worker has finished writing the current block */
+	void waitForBlock();
+
+	/** Signals the worker to exit and waits for it */
+	void stopWorker();
+
+	void run() override;
+
+private:
+	RecordThread* m_parentThread;
+	const int m_engineIndex;
+
+	WaitableEvent m_startEvent;
+	WaitableEvent m_doneEvent;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordEngineWorker);
+};
 
 class RecordThread : public Thread
 {
 public:
-	RecordThread(RecordNode* parentNode, const ScopedPointer<RecordEngine>& engine);
-	//RecordThread(const OwnedArray<RecordEngine>& engines);
+	RecordThread(RecordNode* parentNode, const OwnedArray<RecordEngine>& engines);
 	~RecordThread();
 	void setFileComponents(File rootFolder, int experimentNumber, int recordingNumber);
 	void setChannelMap(const Array<int>& channels);
@@ -52,15 +81,31 @@ public:
 	void setFirstBlockFlag(bool state);
 	void forceCloseFiles();
 
+	/** Batch sizes chosen by the write scheduler on the last pass */
+	WriteScheduleMetrics getWriteScheduleMetrics() const;
+
+	/** Throughput and latency of each engine in the current or last recording */
+	const RecordIOMonitor& getIOMonitor() const;
+
 	RecordNode *recordNode;
 	int64 samplesWritten;
 
 private:
-	void writeData(const AudioSampleBuffer& buffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock = false);
-	void writeSynchronizedData(const AudioSampleBuffer& dataBuffer, const SynchronizedTimestampBuffer& ftsBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock = false);
+	friend class RecordEngineWorker;
+
+	/** Reads one block from the queues and hands it to every engine */
+	void writeData(const AudioSampleBuffer& dataBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock = false);
+
+	/** Writes the block currently held by the thread to a single engine. Called concurrently for different engines. */
+	void writeEngineBlock(int engineIndex);
 
-	//const OwnedArray<RecordEngine>& m_engineArray;
-	const ScopedPointer<RecordEngine>& m_engine;
+	/** Adds the samples a triggered read jumped over since the last one to the skipped samples of each channel */
+	void countSkippedSamples();
+
+	const OwnedArray<RecordEngine>& m_engineArray;
+	OwnedArray<RecordEngineWorker> m_workers;
+	WriteScheduler m_scheduler;
+	RecordIOMonitor m_ioMonitor;
 	Array<int> m_channelArray;
 	Array<int> m_ftsChannelArray;
 
@@ -71,6 +116,30 @@ private:
 	std::atomic<bool> m_receivedFirstBlock;
 	std::atomic<bool> m_cleanExit;
 
+	//Block shared by all engines between the queue read and its release
+	const AudioSampleBuffer* m_dataBuffer;
+	Array<int64> m_blockTimestamps;
+	Array<CircularBufferIndexes> m_dataBufferIdxs;
+	Array<CircularBufferIndexes> m_segmentIdxs;
+	Array<ChannelSpan> m_dataSpans;
+	//Read pointers of every channel for both parts of the read, the wrapped part from m_numChannels on
+	HeapBlock<const float*> m_readPointers;
+	HeapBlock<const int16*> m_int16ReadPointers;
+	Array<EventSpan> m_eventSpans;
+	Array<EventSpan> m_spikeSpans;
+	Array<MidiMessage> m_events;
+	Array<int> m_eventChannels;
+	OwnedArray<SpikeEvent> m_spikes;
+	Array<int> m_spikeElectrodes;
+	bool m_lastBlock;
+	bool m_useSynchronizer;
+	bool m_int16Samples;	//The queue holds int16 counts of each channel's bitVolts
+
+	//Triggered recordings write the samples of the trigger windows only, as segments of the same files
+	bool m_triggered;
+	Array<int64> m_nextTimestamps;
+	Array<int64> m_skippedSamples;
+
 	File m_rootFolder;
 	int m_experimentNumber;
 	int m_recordingNumber;
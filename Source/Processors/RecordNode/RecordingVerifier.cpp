@@ -0,0 +1,317 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordingVerifier.h"
+#include "../FileReader/BinaryFileSource/NpyReader.h"
+#include "../../CoreServices.h"
+#include "../../Utils/Utils.h"
+
+/* Timestamps scanned between two checks for the thread being stopped */
+#define VERIFY_CHUNK_RECORDS (1 << 20)
+
+namespace
+{
+    /** What a scan found in the differences between consecutive timestamps */
+    struct TimestampScan
+    {
+        int64 jumps = 0;        // differences of more than one sample
+        int64 missing = 0;      // samples skipped by them
+        int64 backwards = 0;    // differences below the smallest step allowed
+        int64 outOfRange = 0;   // timestamps outside the range checked against
+    };
+
+    /** Scans the n - 1 differences of ts. The loop has no branches, so the compiler
+        vectorizes it. */
+    void scanDifferences (const int64* ts, int64 n, int64 minStep, TimestampScan& scan)
+    {
+        int64 jumps = 0, missing = 0, backwards = 0;
+
+        for (int64 i = 1; i < n; i++)
+        {
+            const int64 d = ts[i] - ts[i - 1];
+            jumps += d > 1;
+            missing += d > 1 ? d - 1 : 0;
+            backwards += d < minStep;
+        }
+
+        scan.jumps += jumps;
+        scan.missing += missing;
+        scan.backwards += backwards;
+    }
+
+    void scanRange (const int64* ts, int64 n, int64 first, int64 last, TimestampScan& scan)
+    {
+        int64 outOfRange = 0;
+
+        for (int64 i = 0; i < n; i++)
+            outOfRange += (ts[i] < first) | (ts[i] > last);
+
+        scan.outOfRange += outOfRange;
+    }
+
+    /** The timestamp after which the first step other than one sample happens */
+    int64 findFirstDiscontinuity (const int64* ts, int64 n)
+    {
+        for (int64 i = 1; i < n; i++)
+        {
+            if (ts[i] - ts[i - 1] != 1)
+                return ts[i - 1];
+        }
+
+        return -1;
+    }
+}
+
+RecordingVerifier::RecordingVerifier (const Array<File>& recordingFolders, bool triggeredRecording)
+    : Thread ("Recording Verifier"),
+      folders (recordingFolders),
+      triggered (triggeredRecording)
+{
+}
+
+RecordingVerifier::~RecordingVerifier()
+{
+    stopThread (5000);
+}
+
+void RecordingVerifier::run()
+{
+    for (auto& folder : folders)
+    {
+        const double startMs = Time::getMillisecondCounterHiRes();
+
+        var report = verify (folder);
+
+        if (threadShouldExit())
+            return;
+
+        if (report.isVoid())
+            continue;
+
+        report.getDynamicObject()->setProperty ("seconds", (Time::getMillisecondCounterHiRes() - startMs) / 1000.0);
+
+        const File reportFile = folder.getChildFile ("continuity_report.json");
+
+        if (!reportFile.replaceWithText (JSON::toString (report)))
+            LOGD ("Could not write ", reportFile.getFullPathName());
+
+        const bool ok = report["ok"];
+        const String message = ok ? "Recording verified: no data lost in " + folder.getFileName()
+                                  : "Recording check failed for " + folder.getFileName() + ", see continuity_report.json";
+
+        LOGD (message);
+
+        MessageManager::callAsync ([message] { CoreServices::sendStatusMessage (message); });
+    }
+}
+
+var RecordingVerifier::verify (const File& recordingFolder)
+{
+    const File structureFile = recordingFolder.getChildFile ("structure.oebin");
+
+    if (!structureFile.existsAsFile())
+        return var();
+
+    const var structure = JSON::parse (structureFile);
+
+    DynamicObject::Ptr report = new DynamicObject();
+    report->setProperty ("recording", recordingFolder.getFullPathName());
+    report->setProperty ("triggered", triggered);
+
+    bool ok = true;
+
+    // the continuous streams set the range the events must fall in
+    int64 firstTimestamp = std::numeric_limits<int64>::max();
+    int64 lastTimestamp = std::numeric_limits<int64>::min();
+
+    Array<var> continuous;
+
+    if (const Array<var>* streams = structure["continuous"].getArray())
+    {
+        for (auto& info : *streams)
+        {
+            const File folder = recordingFolder.getChildFile ("continuous").getChildFile (info["folder_name"].toString());
+            continuous.add (verifyContinuous (folder, info, firstTimestamp, lastTimestamp, ok));
+
+            if (threadShouldExit())
+                return var();
+        }
+    }
+
+    report->setProperty ("continuous", continuous);
+
+    Array<var> events;
+
+    if (const Array<var>* streams = structure["events"].getArray())
+    {
+        for (auto& info : *streams)
+        {
+            const File folder = recordingFolder.getChildFile ("events").getChildFile (info["folder_name"].toString());
+            events.add (verifyTimestamps (folder.getChildFile ("timestamps.npy"), firstTimestamp, lastTimestamp, ok));
+
+            if (threadShouldExit())
+                return var();
+        }
+    }
+
+    report->setProperty ("events", events);
+
+    Array<var> spikes;
+
+    if (const Array<var>* streams = structure["spikes"].getArray())
+    {
+        for (auto& info : *streams)
+        {
+            const File folder = recordingFolder.getChildFile ("spikes").getChildFile (info["folder_name"].toString());
+            spikes.add (verifyTimestamps (folder.getChildFile ("spike_times.npy"), firstTimestamp, lastTimestamp, ok));
+
+            if (threadShouldExit())
+                return var();
+        }
+    }
+
+    report->setProperty ("spikes", spikes);
+    report->setProperty ("ok", ok);
+
+    return var (report.get());
+}
+
+var RecordingVerifier::verifyContinuous (const File& folder, const var& info, int64& firstTimestamp, int64& lastTimestamp, bool& ok)
+{
+    DynamicObject::Ptr result = new DynamicObject();
+    result->setProperty ("folder", info["folder_name"]);
+
+    const int numChannels = info["num_channels"];
+    result->setProperty ("channels", numChannels);
+
+    BinarySource::NpyReader timestamps;
+
+    if (!timestamps.open (folder.getChildFile ("timestamps.npy"), "i8"))
+    {
+        result->setProperty ("error", "timestamps.npy is missing or unreadable");
+        result->setProperty ("ok", false);
+        ok = false;
+        return var (result.get());
+    }
+
+    const int64 numSamples = timestamps.getNumRecords();
+    const int64* ts = static_cast<const int64*> (timestamps.getData());
+
+    TimestampScan scan;
+
+    for (int64 start = 1; start < numSamples && !threadShouldExit(); start += VERIFY_CHUNK_RECORDS)
+    {
+        const int64 end = jmin (numSamples, start + VERIFY_CHUNK_RECORDS);
+        timestamps.prefetch (end, VERIFY_CHUNK_RECORDS);
+        scanDifferences (ts + start - 1, end - start + 1, 1, scan);
+    }
+
+    result->setProperty ("samples", numSamples);
+    result->setProperty ("gaps", scan.jumps);
+    result->setProperty ("missingSamples", scan.missing);
+    result->setProperty ("backwardSteps", scan.backwards);
+
+    bool streamOk = scan.backwards == 0 && (triggered || scan.jumps == 0);
+
+    if (numSamples > 0)
+    {
+        result->setProperty ("firstTimestamp", ts[0]);
+        result->setProperty ("lastTimestamp", ts[numSamples - 1]);
+
+        if (scan.jumps + scan.backwards > 0)
+            result->setProperty ("firstDiscontinuity", findFirstDiscontinuity (ts, numSamples));
+
+        // a stream that went backwards still covers its lowest and highest timestamps
+        firstTimestamp = jmin (firstTimestamp, scan.backwards > 0 ? jmin (ts[0], ts[numSamples - 1]) : ts[0]);
+        lastTimestamp = jmax (lastTimestamp, scan.backwards > 0 ? jmax (ts[0], ts[numSamples - 1]) : ts[numSamples - 1]);
+    }
+
+    // compressed and chunked streams are read through their index; only continuous.dat has a fixed size per sample
+    if (info["data_file"].toString().isNotEmpty())
+    {
+        result->setProperty ("dataSamples", -1);
+    }
+    else
+    {
+        const int64 dataBytes = folder.getChildFile ("continuous.dat").getSize();
+        const int64 frameBytes = int64 (jmax (1, numChannels)) * sizeof (int16);
+
+        result->setProperty ("dataSamples", dataBytes / frameBytes);
+
+        if (dataBytes % frameBytes != 0)
+            result->setProperty ("error", "continuous.dat ends within a sample");
+
+        streamOk = streamOk && dataBytes % frameBytes == 0 && dataBytes / frameBytes == numSamples;
+    }
+
+    result->setProperty ("ok", streamOk);
+    ok = ok && streamOk;
+
+    return var (result.get());
+}
+
+var RecordingVerifier::verifyTimestamps (const File& file, int64 firstTimestamp, int64 lastTimestamp, bool& ok)
+{
+    DynamicObject::Ptr result = new DynamicObject();
+    result->setProperty ("folder", file.getParentDirectory().getFileName());
+
+    BinarySource::NpyReader timestamps;
+
+    if (!timestamps.open (file, "i8"))
+    {
+        result->setProperty ("error", file.getFileName() + " is missing or unreadable");
+        result->setProperty ("ok", false);
+        ok = false;
+        return var (result.get());
+    }
+
+    const int64 count = timestamps.getNumRecords();
+    const int64* ts = static_cast<const int64*> (timestamps.getData());
+    const bool hasRange = firstTimestamp <= lastTimestamp;
+
+    TimestampScan scan;
+
+    for (int64 start = 0; start < count && !threadShouldExit(); start += VERIFY_CHUNK_RECORDS)
+    {
+        const int64 end = jmin (count, start + VERIFY_CHUNK_RECORDS);
+
+        // several events may share a timestamp
+        if (start > 0)
+            scanDifferences (ts + start - 1, end - start + 1, 0, scan);
+        else
+            scanDifferences (ts, end, 0, scan);
+
+        if (hasRange)
+            scanRange (ts + start, end - start, firstTimestamp, lastTimestamp, scan);
+    }
+
+    result->setProperty ("count", count);
+    result->setProperty ("backwardSteps", scan.backwards);
+    result->setProperty ("outOfRange", scan.outOfRange);
+
+    const bool streamOk = scan.backwards == 0 && scan.outOfRange == 0;
+    result->setProperty ("ok", streamOk);
+    ok = ok && streamOk;
+
+    return var (result.get());
+}
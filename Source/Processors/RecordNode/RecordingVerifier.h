@@ -0,0 +1,73 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDINGVERIFIER_H_INCLUDED
+#define RECORDINGVERIFIER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+/**
+    Checks that a finished recording in the Binary format lost nothing, on a
+    background thread, and writes continuity_report.json next to its
+    structure.oebin.
+
+    For every continuous stream, timestamps.npy must increase one sample at a time
+    and continuous.dat must hold as many samples of all its channels. In a triggered
+    recording the jumps between the trigger windows are expected, so they are
+    counted but not flagged. The timestamps of the events and spikes must not go
+    backwards and must fall within those of the continuous data.
+
+    The files are memory-mapped and the timestamps scanned in one pass each, so a
+    session of hours is checked within seconds.
+
+    @see RecordNode::setVerifyRecordings
+*/
+class RecordingVerifier : public Thread
+{
+public:
+    /** Verifies the recording folders (experimentN/recordingM) in turn once started.
+        Folders without a structure.oebin, from other engines, are skipped. */
+    RecordingVerifier (const Array<File>& recordingFolders, bool triggeredRecording);
+    ~RecordingVerifier();
+
+private:
+    void run() override;
+
+    /** Verifies one recording folder and returns its report, or a void var if
+        the folder has no structure.oebin or the thread was stopped */
+    var verify (const File& recordingFolder);
+
+    /** Checks the timestamps.npy and continuous.dat of a continuous stream, and
+        widens [firstTimestamp, lastTimestamp] to its timestamps */
+    var verifyContinuous (const File& folder, const var& info, int64& firstTimestamp, int64& lastTimestamp, bool& ok);
+
+    /** Checks a file of event or spike timestamps against the continuous range */
+    var verifyTimestamps (const File& file, int64 firstTimestamp, int64 lastTimestamp, bool& ok);
+
+    const Array<File> folders;
+    const bool triggered;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RecordingVerifier);
+};
+
+#endif  // RECORDINGVERIFIER_H_INCLUDED
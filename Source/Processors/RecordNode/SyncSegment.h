@@ -0,0 +1,62 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SYNCSEGMENT_H_INCLUDED
+#define SYNCSEGMENT_H_INCLUDED
+
+#include <JuceHeader.h>
+
+/** A stretch of samples over which the synchronized timestamps are linear in the
+	sample number. It holds from its first sample until the next segment of the
+	same subprocessor starts.
+
+	The Synchronizer emits a new segment whenever its fit of a subprocessor changes,
+	so the timestamps of every sample can be evaluated from a handful of segments.
+*/
+struct SyncSegment
+{
+	int64 sample;			// first sample number of the segment
+	double masterTime;		// its time on the master clock, in seconds
+	double sampleRate;		// samples per second of master time; 0 while not synchronized
+
+	/** The synchronized timestamp of a sample, or -1 while not synchronized */
+	double getTime(int64 sampleNumber) const
+	{
+		if (sampleRate <= 0.0)
+			return -1.0;
+
+		return masterTime + double(sampleNumber - sample) / sampleRate;
+	}
+
+	/** The same timestamps for a stream decimated by factor, whose sample m stands for sample m * factor */
+	SyncSegment decimate(int factor) const
+	{
+		SyncSegment segment;
+		segment.sample = sample / factor;
+		segment.sampleRate = sampleRate / factor;
+		segment.masterTime = sampleRate > 0.0 ? getTime(segment.sample * factor) : masterTime;
+		return segment;
+	}
+};
+
+#endif  // SYNCSEGMENT_H_INCLUDED
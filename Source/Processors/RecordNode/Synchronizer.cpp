@@ -1,4 +1,20 @@
 #include "Synchronizer.h"
+#include "../../Utils/RealtimeLog.h"
+#include "../../Utils/ThreadConfig.h"
+
+/* Weight the earlier pulses keep at each new one; about ten minutes of memory at one pulse per second */
+#define SYNC_FIT_FORGETTING 0.998
+
+/* Pulses accepted before outliers are rejected, to learn the jitter of the sync events */
+#define SYNC_FIT_WARMUP_PULSES 10
+
+/* Pulses further from the fit than this many RMS residuals are rejected... */
+#define SYNC_OUTLIER_THRESHOLD 6.0
+/* ...unless they are within this many samples of it */
+#define SYNC_OUTLIER_MIN_SAMPLES 2.0
+
+/* This many rejected pulses in a row mean the clock itself jumped, so the fit restarts */
+#define SYNC_MAX_CONSECUTIVE_OUTLIERS 3
 
 FloatTimestampBuffer::FloatTimestampBuffer(int size)
 	: abstractFifo(size)
@@ -86,246 +102,351 @@ int FloatTimestampBuffer::readAllFromBuffer(AudioSampleBuffer& data, uint64* tim
 	
 }
 
-Subprocessor::Subprocessor(float expectedSampleRate_)
+Subprocessor::Subprocessor(int sourceID_, int subProcIdx_, float expectedSampleRate_)
+	: sourceID(sourceID_)
+	, subProcIdx(subProcIdx_)
+	, syncChannel(-1)
+	, windowEvent(0)
+	, fitSequence(0)
 {
 	expectedSampleRate = expectedSampleRate_;
-	actualSampleRate = -1.0f;
 
-	startSample = -1;
-	lastSample = -1;
-
-	startSampleMasterTime = -1.0f;
-	lastSampleMasterTime = -1.0f;
-
-	syncChannel = -1;
+	reset();
+}
 
-	isSynchronized = false;
-	receivedEventInWindow = false;
-	receivedMasterTimeInWindow = false;
+void Subprocessor::reset()
+{
+	windowEvent = 0;
 
-	sampleRateTolerance = 0.01;
+	restartFit();
+	publishFit();
 }
 
-void Subprocessor::reset()
+void Subprocessor::restartFit()
 {
+	fit = SyncFit();
+
+	fitWeight = 0.0;
+	meanTime = 0.0;
+	meanSample = 0.0;
+	sumTimeTime = 0.0;
+	sumTimeSample = 0.0;
+	residualVariance = 0.0;
+	consecutiveOutliers = 0;
+}
 
-	startSampleMasterTime = -1.0f;
-	lastSampleMasterTime = -1.0f;
+void Subprocessor::addEvent(int64 sampleNumber)
+{
+	uint64 state = windowEvent.load();
+	uint64 newState;
+
+	do {
+		if ((state & 3) == 0)
+			newState = (uint64(sampleNumber) << 2) | 1;
+		else // multiple events, something could be wrong
+			newState = (state & ~uint64(3)) | 2;
+	} while (!windowEvent.compare_exchange_weak(state, newState));
+}
 
-	actualSampleRate = -1.0f;
-	startSample = -1;
-	lastSample = -1;
+bool Subprocessor::takeWindowEvent(int64& sampleNumber)
+{
+	uint64 state = windowEvent.exchange(0);
 
-	receivedEventInWindow = false;
-	receivedMasterTimeInWindow = false;
-	isSynchronized = false;
+	if ((state & 3) != 1)
+		return false;
 
+	sampleNumber = int64(state) >> 2;
+	return true;
 }
 
-void Subprocessor::setMasterTime(float masterTimeSec_)
+void Subprocessor::updateFit(int64 sampleNumber, double masterTime)
 {
-	if (!receivedMasterTimeInWindow)
+	const double sample = double(sampleNumber);
+
+	if (fit.isSynchronized)
 	{
-		tempMasterTime = masterTimeSec_;
-		receivedMasterTimeInWindow = true;
+		const double residual = sample - (meanSample + fit.actualSampleRate * (masterTime - meanTime));
+
+		if (fit.numPulses >= SYNC_FIT_WARMUP_PULSES
+			&& std::abs(residual) > jmax(SYNC_OUTLIER_MIN_SAMPLES, SYNC_OUTLIER_THRESHOLD * std::sqrt(residualVariance)))
+		{
+			if (++consecutiveOutliers < SYNC_MAX_CONSECUTIVE_OUTLIERS)
+			{
+				fit.numRejected++;
+				publishFit();
+				return;
+			}
+
+			// reset the clock
+			LOGRT("Synchronizer: clock of ", sourceID, ".", subProcIdx, " jumped by ", residual, " samples, restarting its fit");
+			restartFit();
+		}
+		else
+		{
+			consecutiveOutliers = 0;
+
+			// the plain mean while warming up, then a moving one
+			residualVariance += (residual * residual - residualVariance) / jmin(fit.numPulses, 50);
+			fit.jitterSamples = std::sqrt(residualVariance);
+		}
 	}
-	else { // multiple events, something could be wrong
-		receivedMasterTimeInWindow = false;
+
+	// exponentially weighted least squares of the sample against the master time, in O(1)
+	fitWeight = SYNC_FIT_FORGETTING * fitWeight + 1.0;
+
+	const double timeDelta = masterTime - meanTime;
+	meanTime += timeDelta / fitWeight;
+	meanSample += (sample - meanSample) / fitWeight;
+
+	sumTimeTime = SYNC_FIT_FORGETTING * sumTimeTime + timeDelta * (masterTime - meanTime);
+	sumTimeSample = SYNC_FIT_FORGETTING * sumTimeSample + timeDelta * (sample - meanSample);
+
+	fit.numPulses++;
+
+	if (fit.numPulses >= 2 && sumTimeTime > 0.0)
+	{
+		const double sampleRate = sumTimeSample / sumTimeTime;
+
+		if (sampleRate > 0.0)
+		{
+			fit.startSample = meanSample;
+			fit.startSampleMasterTime = meanTime;
+			fit.actualSampleRate = sampleRate;
+			fit.driftPpm = (sampleRate / expectedSampleRate - 1.0) * 1e6;
+			fit.isSynchronized = true;
+			//LOGD("Updated sample rate: ", fit.actualSampleRate);
+		}
+		else { // time ran backwards between the pulses, start over from this one
+			restartFit();
+			updateFit(sampleNumber, masterTime);
+			return;
+		}
 	}
 
+	publishFit();
 }
 
-void Subprocessor::addEvent(int sampleNumber)
+void Subprocessor::publishFit()
 {
-	if (!receivedEventInWindow)
-	{
-		tempSampleNum = sampleNumber;
-		receivedEventInWindow = true;
-	}
-	else { // multiple events, something could be wrong
-		receivedEventInWindow = false;
-	}
+	const uint32 sequence = fitSequence.load(std::memory_order_relaxed);
+
+	fitSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
 
+	publishedStartSample.store(fit.startSample, std::memory_order_relaxed);
+	publishedStartMasterTime.store(fit.startSampleMasterTime, std::memory_order_relaxed);
+	publishedSampleRate.store(fit.actualSampleRate, std::memory_order_relaxed);
+	publishedSynchronized.store(fit.isSynchronized, std::memory_order_relaxed);
+	publishedDrift.store(fit.driftPpm, std::memory_order_relaxed);
+	publishedJitter.store(fit.jitterSamples, std::memory_order_relaxed);
+	publishedPulses.store(fit.numPulses, std::memory_order_relaxed);
+	publishedRejected.store(fit.numRejected, std::memory_order_relaxed);
+
+	fitSequence.store(sequence + 2, std::memory_order_release);
 }
 
-void Subprocessor::closeSyncWindow()
+SyncFit Subprocessor::getFit() const
 {
-	if (receivedEventInWindow && receivedMasterTimeInWindow)
-	{
-		if (startSample < 0)
-		{
-			startSample = tempSampleNum;
-			startSampleMasterTime = tempMasterTime;
-		}
-		else {
+	SyncFit published;
+	uint32 before, after;
 
-			lastSample = tempSampleNum;
-			lastSampleMasterTime = tempMasterTime;
+	// retry while the sync timer publishes a new fit
+	do {
+		before = fitSequence.load(std::memory_order_acquire);
 
-			double tempSampleRate = (lastSample - startSample) / (lastSampleMasterTime - startSampleMasterTime);
+		published.startSample = publishedStartSample.load(std::memory_order_relaxed);
+		published.startSampleMasterTime = publishedStartMasterTime.load(std::memory_order_relaxed);
+		published.actualSampleRate = publishedSampleRate.load(std::memory_order_relaxed);
+		published.isSynchronized = publishedSynchronized.load(std::memory_order_relaxed);
+		published.driftPpm = publishedDrift.load(std::memory_order_relaxed);
+		published.jitterSamples = publishedJitter.load(std::memory_order_relaxed);
+		published.numPulses = publishedPulses.load(std::memory_order_relaxed);
+		published.numRejected = publishedRejected.load(std::memory_order_relaxed);
 
-			if (actualSampleRate < 0.0f)
-			{
-				actualSampleRate = tempSampleRate;
-				isSynchronized = true;
-				//LOGD("New sample rate: ", actualSampleRate);
-			}
-			else {
-				// check whether the sample rate has changed
-				if (abs((tempSampleRate - actualSampleRate) / actualSampleRate) < sampleRateTolerance)
-				{
-					actualSampleRate = tempSampleRate;
-					isSynchronized = true;
-					//LOGD("Updated sample rate: ", actualSampleRate);
-				}
-				else { // reset the clock
-					startSample = tempSampleNum;
-					startSampleMasterTime = tempMasterTime;
-					isSynchronized = false;
-				}
-			}
-		}
-	}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = fitSequence.load(std::memory_order_relaxed);
+
+	} while ((before & 1) != 0 || before != after);
 
-	LOGDD("Subprocessor closed sync window.");
+	return published;
+}
 
-	receivedEventInWindow = false;
-	receivedMasterTimeInWindow = false;
+int Subprocessor::getFitCount() const
+{
+	return int(fitSequence.load(std::memory_order_acquire) >> 1);
 }
 
 // =======================================================
 
 Synchronizer::Synchronizer(RecordNode* parentNode)
+	: syncWindowIsOpen(false)
 {
 	syncWindowLengthMs = 50;
-	syncWindowIsOpen = false;
 	firstMasterSync = true;
+	masterStartSample = 0;
 	node = parentNode;
 }
 
 Synchronizer::~Synchronizer()
 {
-
+	stopTimer();
 }
 
 void Synchronizer::reset()
 {
-	
-    syncWindowIsOpen = false;
-    firstMasterSync = true;
+	stopTimer();
+
+	syncWindowIsOpen = false;
+	firstMasterSync = true;
 	eventCount = 0;
-    
-    std::map<int, std::map<int, Subprocessor*>>::iterator it;
-    std::map<int, Subprocessor*>::iterator ptr;
-    
-    for (it = subprocessors.begin(); it != subprocessors.end(); it++) {
-        for (ptr = it->second.begin(); ptr != it->second.end(); ptr++) {
-            ptr->second->reset();
-        }
-    }
+
+	for (auto subprocessor : subprocessorArray)
+		subprocessor->reset();
 }
 
 void Synchronizer::addSubprocessor(int sourceID, int subProcIndex, float expectedSampleRate)
 {
-	subprocessorArray.add(new Subprocessor(expectedSampleRate));
-	subprocessors[sourceID][subProcIndex] = subprocessorArray.getLast();
+	if (getSubprocessor(sourceID, subProcIndex) != nullptr)
+		return;
+
+	subprocessorArray.add(new Subprocessor(sourceID, subProcIndex, expectedSampleRate));
+	updateLookup();
+}
+
+void Synchronizer::updateLookup()
+{
+	int maxSourceID = 0;
+	int maxSubProcIdx = 0;
+
+	for (auto subprocessor : subprocessorArray)
+	{
+		maxSourceID = jmax(maxSourceID, subprocessor->sourceID);
+		maxSubProcIdx = jmax(maxSubProcIdx, subprocessor->subProcIdx);
+	}
+
+	lookupStride = maxSubProcIdx + 1;
+
+	lookup.clearQuick();
+	lookup.insertMultiple(0, -1, (maxSourceID + 1) * lookupStride);
+
+	for (int i = 0; i < subprocessorArray.size(); i++)
+		lookup.set(subprocessorArray[i]->sourceID * lookupStride + subprocessorArray[i]->subProcIdx, i);
+
+	master = getSubprocessor(masterProcessor, masterSubprocessor);
+}
+
+Subprocessor* Synchronizer::getSubprocessor(int sourceID, int subProcIdx) const
+{
+	if (sourceID < 0 || subProcIdx < 0 || subProcIdx >= lookupStride)
+		return nullptr;
+
+	const int index = sourceID * lookupStride + subProcIdx;
+
+	if (index >= lookup.size() || lookup.getUnchecked(index) < 0)
+		return nullptr;
+
+	return subprocessorArray.getUnchecked(lookup.getUnchecked(index));
 }
 
 void Synchronizer::setMasterSubprocessor(int sourceID, int subProcIndex)
 {
 	masterProcessor = sourceID;
 	masterSubprocessor = subProcIndex;
+	master = getSubprocessor(sourceID, subProcIndex);
 	reset();
 }
 
 void Synchronizer::setSyncChannel(int sourceID, int subProcIdx, int ttlChannel)
 {
 	//LOGD("Set sync channel: {", sourceID, ",", subProcIdx, "}->", ttlChannel);
-	subprocessors[sourceID][subProcIdx]->syncChannel = ttlChannel;
+	if (Subprocessor* subprocessor = getSubprocessor(sourceID, subProcIdx))
+		subprocessor->syncChannel = ttlChannel;
 	reset();
 }
 
 int Synchronizer::getSyncChannel(int sourceID, int subProcIdx)
 {
-	//LOGD("Get sync channel: {", sourceID, ",", subProcIdx, "}->", subprocessors[sourceID][subProcIdx]->syncChannel);
-	return subprocessors[sourceID][subProcIdx]->syncChannel;
+	Subprocessor* subprocessor = getSubprocessor(sourceID, subProcIdx);
+	return subprocessor != nullptr ? subprocessor->syncChannel.load() : -1;
 }
 
-void Synchronizer::addEvent(int sourceID, int subProcIdx, int ttlChannel, int sampleNumber)
+void Synchronizer::addEvent(int sourceID, int subProcIdx, int ttlChannel, int64 sampleNumber)
 {
+	Subprocessor* subprocessor = getSubprocessor(sourceID, subProcIdx);
 
-	if (subprocessors[sourceID][subProcIdx]->syncChannel == ttlChannel)
-	{
-		
-		if (!syncWindowIsOpen)
-		{
-			openSyncWindow();
-		}
-
-		subprocessors[sourceID][subProcIdx]->addEvent(sampleNumber);
-
-		if (sourceID == masterProcessor && subProcIdx == masterSubprocessor)
-		{
+	if (subprocessor == nullptr || subprocessor->syncChannel != ttlChannel)
+		return;
 
-			//LOGD("Got event on master!");
+	if (!syncWindowIsOpen.exchange(true))
+		openSyncWindow();
 
-			float masterTimeSec;
+	// the master's event is converted to the window's master time when the window closes
+	subprocessor->addEvent(sampleNumber);
+}
 
-			if (!firstMasterSync)
-			{
-				masterTimeSec = (sampleNumber - subprocessors[sourceID][subProcIdx]->startSample) / subprocessors[sourceID][subProcIdx]->expectedSampleRate;
-			}
-			else
-			{
-				masterTimeSec = 0.0f;
-				firstMasterSync = false;
-			}
+double Synchronizer::convertTimestamp(int sourceID, int subProcID, int64 sampleNumber)
+{
+	Subprocessor* subprocessor = getSubprocessor(sourceID, subProcID);
 
-			std::map<int, std::map<int, Subprocessor*>>::iterator it;
-			std::map<int, Subprocessor*>::iterator ptr;
+	if (subprocessor == nullptr)
+		return (double)-1.0;
 
-			for (it = subprocessors.begin(); it != subprocessors.end(); it++) 
-			{
-				for (ptr = it->second.begin(); ptr != it->second.end(); ptr++) 
-				{
-					ptr->second->setMasterTime(masterTimeSec);
-				}
-			}
+	const SyncFit fit = subprocessor->getFit();
 
-			/*
-			if (eventCount % 10 == 0)
-				LOGD("Master time: ", masterTimeSec);
-			*/
-		
-			eventCount++;
-		}
+	if (fit.isSynchronized)
+	{
+		return (double)(sampleNumber - fit.startSample) / fit.actualSampleRate + fit.startSampleMasterTime;
+	}
+	else {
+		return (double)-1.0;
 	}
 }
 
-double Synchronizer::convertTimestamp(int sourceID, int subProcID, int sampleNumber)
+int Synchronizer::getFitCount(int sourceID, int subProcID)
 {
+	Subprocessor* subprocessor = getSubprocessor(sourceID, subProcID);
+	return subprocessor != nullptr ? subprocessor->getFitCount() : 0;
+}
+
+SyncSegment Synchronizer::getSyncSegment(int sourceID, int subProcID, int64 sampleNumber)
+{
+	Subprocessor* subprocessor = getSubprocessor(sourceID, subProcID);
+
+	SyncSegment segment;
+	segment.sample = sampleNumber;
+	segment.sampleRate = 0.0;
+	segment.masterTime = -1.0;
 
-	if (subprocessors[sourceID][subProcID]->isSynchronized)
+	if (subprocessor != nullptr)
 	{
-		return (double)(sampleNumber - subprocessors[sourceID][subProcID]->startSample) /
-			subprocessors[sourceID][subProcID]->actualSampleRate +
-			subprocessors[sourceID][subProcID]->startSampleMasterTime;
-	}
-	else {
-		return (double)-1.0;
+		const SyncFit fit = subprocessor->getFit();
+
+		if (fit.isSynchronized)
+		{
+			segment.sampleRate = fit.actualSampleRate;
+			segment.masterTime = (double)(sampleNumber - fit.startSample) / segment.sampleRate +
+				fit.startSampleMasterTime;
+		}
 	}
+
+	return segment;
 }
 
 void Synchronizer::openSyncWindow()
 {
 	startTimer(syncWindowLengthMs);
-
-	syncWindowIsOpen = true;
 }
 
 bool Synchronizer::isSubprocessorSynced(int id, int idx)
 {
-	return subprocessors[id][idx]->isSynchronized;
+	Subprocessor* subprocessor = getSubprocessor(id, idx);
+	return subprocessor != nullptr && subprocessor->getFit().isSynchronized;
+}
+
+SyncFit Synchronizer::getFit(int id, int idx)
+{
+	Subprocessor* subprocessor = getSubprocessor(id, idx);
+	return subprocessor != nullptr ? subprocessor->getFit() : SyncFit();
 }
 
 SyncStatus Synchronizer::getStatus(int id, int idx)
@@ -348,14 +469,44 @@ void Synchronizer::hiResTimerCallback()
 {
 	stopTimer();
 
+	// the timer thread closes the windows of the acquisition clocks
+	ThreadConfig::applyToCurrentThread(ThreadConfig::ACQUISITION);
+
+	// events from here on open the next window
 	syncWindowIsOpen = false;
 
-	std::map<int, std::map<int, Subprocessor*>>::iterator it;
-	std::map<int, Subprocessor*>::iterator ptr;
+	int64 masterSample = 0;
+	const bool hasMasterTime = master != nullptr && master->takeWindowEvent(masterSample);
+	double masterTimeSec = 0.0;
 
-	for (it = subprocessors.begin(); it != subprocessors.end(); it++) {
-		for (ptr = it->second.begin(); ptr != it->second.end(); ptr++) {
-			ptr->second->closeSyncWindow();
+	if (hasMasterTime)
+	{
+		if (!firstMasterSync)
+		{
+			masterTimeSec = (masterSample - masterStartSample) / master->expectedSampleRate;
+		}
+		else
+		{
+			masterStartSample = masterSample;
+			firstMasterSync = false;
 		}
+
+		/*
+		if (eventCount % 10 == 0)
+			LOGD("Master time: ", masterTimeSec);
+		*/
+
+		eventCount++;
 	}
+
+	for (auto subprocessor : subprocessorArray)
+	{
+		int64 sampleNumber = masterSample;
+		bool hasEvent = (subprocessor == master) ? hasMasterTime : subprocessor->takeWindowEvent(sampleNumber);
+
+		if (hasEvent && hasMasterTime)
+			subprocessor->updateFit(sampleNumber, masterTimeSec);
+	}
+
+	LOGDD("Synchronizer closed sync window.");
 }
\ No newline at end of file
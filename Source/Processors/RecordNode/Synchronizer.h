@@ -3,9 +3,11 @@
 #include <algorithm>
 #include <memory>
 #include <map>
+#include <atomic>
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../../Utils/Utils.h"
+#include "SyncSegment.h"
 
 class FloatTimestampBuffer
 {
@@ -32,41 +34,84 @@ private:
 };
 
 
+/** The fit of a subprocessor's samples to the master clock: the sample at
+    startSampleMasterTime is startSample, and actualSampleRate samples follow each second */
+struct SyncFit
+{
+    double startSample = -1.0;
+    double startSampleMasterTime = -1.0;
+    double actualSampleRate = -1.0;
+    bool isSynchronized = false;
+
+    double driftPpm = 0.0;          // of actualSampleRate from the expected sample rate
+    double jitterSamples = 0.0;     // RMS distance of the accepted pulses from the fit
+    int numPulses = 0;              // pulses fitted since the fit (re)started
+    int numRejected = 0;            // pulses rejected as outliers since the fit (re)started
+};
+
 class Subprocessor
 {
 public:
-    Subprocessor(float expectedSampleRate);
+    Subprocessor(int sourceID, int subProcIdx, float expectedSampleRate);
 
+    /** Forgets the fit. Only called while the sync timer is stopped */
     void reset();
 
-    float expectedSampleRate;
-    float actualSampleRate;
-
-    int startSample;
-    int lastSample;
-
-    int syncChannel;
+    const int sourceID;
+    const int subProcIdx;
 
-    bool isSynchronized;
+    float expectedSampleRate;
 
-    bool receivedEventInWindow;
-    bool receivedMasterTimeInWindow;
+    std::atomic<int> syncChannel;
 
-    float masterIntervalSec;
+    /** Called from the processing thread with each sync event */
+    void addEvent(int64 sampleNumber);
 
-    int tempSampleNum;
-    float tempMasterTime;
+    /** Called from the sync timer when the window closes. Clears the window, and
+        returns its event unless there was none or more than one */
+    bool takeWindowEvent(int64& sampleNumber);
 
-    float startSampleMasterTime = -1.0f;
-    float lastSampleMasterTime = -1.0f;
+    /** Adds a sync pulse to a streaming least-squares fit of the samples against the
+        master time, unless it is an outlier, and publishes the result. Called from the sync timer only */
+    void updateFit(int64 sampleNumber, double masterTime);
 
-    float sampleRateTolerance;
+    /** The last published fit, from any thread */
+    SyncFit getFit() const;
 
-    void addEvent(int sampleNumber);
+    /** Changes whenever a new fit is published */
+    int getFitCount() const;
 
-    void setMasterTime(float time);
-    void openSyncWindow();
-    void closeSyncWindow();
+private:
+    void publishFit();
+
+    /** Starts a new fit, when the subprocessor's clock jumped */
+    void restartFit();
+
+    /* Only touched by the sync timer */
+    SyncFit fit;
+
+    /* Exponentially weighted sums of the fit, centred on the weighted means for precision */
+    double fitWeight;
+    double meanTime;
+    double meanSample;
+    double sumTimeTime;
+    double sumTimeSample;
+    double residualVariance;
+    int consecutiveOutliers;
+
+    /* The first event of the open window shifted left by 2, or'ed with the number of events (up to 2) */
+    std::atomic<uint64> windowEvent;
+
+    /* The published fit, guarded by a sequence count that is odd while it is being written */
+    std::atomic<uint32> fitSequence;
+    std::atomic<double> publishedStartSample;
+    std::atomic<double> publishedStartMasterTime;
+    std::atomic<double> publishedSampleRate;
+    std::atomic<bool> publishedSynchronized;
+    std::atomic<double> publishedDrift;
+    std::atomic<double> publishedJitter;
+    std::atomic<int> publishedPulses;
+    std::atomic<int> publishedRejected;
 };
 
 class RecordNode;
@@ -86,18 +131,26 @@ public:
     
     void reset();
 
+    /** Adds a subprocessor to the table. Called by RecordNode::updateSubprocessorMap, never while acquiring */
     void addSubprocessor(int sourceID, int subProcIdx, float expectedSampleRate);
     void setMasterSubprocessor(int sourceID, int subProcIdx);
     void setSyncChannel(int sourceID, int subProcIdx, int ttlChannel);
     int getSyncChannel(int sourceID, int subProcIdx);
     bool isSubprocessorSynced(int sourceID, int subProcIdx);
+
+    /** The fit of a subprocessor with its drift and jitter, from any thread */
+    SyncFit getFit(int sourceID, int subProcIdx);
     SyncStatus getStatus(int sourceID, int subProcIdx);
 
-    void addEvent(int sourceID, int subProcessorID, int ttlChannel, int sampleNumber);
+    void addEvent(int sourceID, int subProcessorID, int ttlChannel, int64 sampleNumber);
 
-    double convertTimestamp(int sourceID, int subProcID, int sampleNumber);
+    double convertTimestamp(int sourceID, int subProcID, int64 sampleNumber);
 
-    std::map<int, std::map<int, Subprocessor*>> subprocessors;
+    /** Changes whenever the fit of a subprocessor does, so a new segment is due */
+    int getFitCount(int sourceID, int subProcID);
+
+    /** The timestamps of the current fit of a subprocessor, from a sample onwards */
+    SyncSegment getSyncSegment(int sourceID, int subProcID, int64 sampleNumber);
 
     RecordNode* node;
 
@@ -108,17 +161,31 @@ public:
 
 private:
 
+    /** The table entry of a subprocessor, or nullptr. Lock-free, as the table only changes while not acquiring */
+    Subprocessor* getSubprocessor(int sourceID, int subProcIdx) const;
+
+    /** Rebuilds the dense index from (sourceID, subProcIdx) to the table */
+    void updateLookup();
+
     int eventCount = 0;
 
     float syncWindowLengthMs;
-    bool syncWindowIsOpen;
+    std::atomic<bool> syncWindowIsOpen;
 
     void hiResTimerCallback();
 
+    /* Only touched by the sync timer, or while it is stopped */
     bool firstMasterSync;
+    int64 masterStartSample;
 
     OwnedArray<Subprocessor> subprocessorArray;
     OwnedArray<FloatTimestampBuffer> ftsBuffer;
 
+    /* Index into subprocessorArray of sourceID * lookupStride + subProcIdx, or -1 */
+    Array<int> lookup;
+    int lookupStride = 0;
+
+    Subprocessor* master = nullptr;
+
     void openSyncWindow();
 };
\ No newline at end of file
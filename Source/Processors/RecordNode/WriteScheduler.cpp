@@ -0,0 +1,101 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "WriteScheduler.h"
+
+/* Weight of the newest measurement in the smoothed throughput */
+#define THROUGHPUT_SMOOTHING 0.2
+
+WriteScheduler::WriteScheduler()
+	: m_minBatch{ BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES }
+{
+	reset();
+}
+
+void WriteScheduler::reset()
+{
+	for (int s = 0; s < NUM_STREAMS; ++s)
+	{
+		m_throughput[s] = 0;
+		m_batch[s] = m_minBatch[s];
+		m_fill[s] = 0.0f;
+	}
+}
+
+void WriteScheduler::schedule(int readySamples, int sampleCapacity, int readyEvents, int eventCapacity, int readySpikes, int spikeCapacity)
+{
+	m_batch[DATA] = chooseBatch(DATA, readySamples, sampleCapacity);
+	m_batch[EVENTS] = chooseBatch(EVENTS, readyEvents, eventCapacity);
+	m_batch[SPIKES] = chooseBatch(SPIKES, readySpikes, spikeCapacity);
+}
+
+int WriteScheduler::chooseBatch(Stream stream, int ready, int capacity)
+{
+	const int minBatch = m_minBatch[stream];
+	const float fill = capacity > 0 ? float(ready) / capacity : 0.0f;
+	m_fill[stream] = fill;
+
+	if (ready <= minBatch)
+		return minBatch;
+
+	/* A queue close to overflowing is drained in one go */
+	if (fill >= WRITE_SCHEDULE_HIGH_FILL)
+		return ready;
+
+	/* Otherwise take a share of the backlog that grows with the occupancy... */
+	int batch = jmax(minBatch, roundToInt(ready * fill / WRITE_SCHEDULE_HIGH_FILL));
+
+	/* ...limited to what the engine is measured to write within the time budget */
+	if (m_throughput[stream] > 0)
+	{
+		int budget = int(m_throughput[stream] * WRITE_SCHEDULE_TARGET_MS / 1000.0);
+		batch = jmin(batch, jmax(minBatch, budget));
+	}
+
+	return batch;
+}
+
+void WriteScheduler::recordWrite(Stream stream, int numItems, int64 ticks)
+{
+	if (numItems <= 0 || ticks <= 0)
+		return;
+
+	double rate = numItems / Time::highResolutionTicksToSeconds(ticks);
+
+	if (m_throughput[stream] <= 0)
+		m_throughput[stream] = rate;
+	else
+		m_throughput[stream] += THROUGHPUT_SMOOTHING * (rate - m_throughput[stream]);
+}
+
+WriteScheduleMetrics WriteScheduler::getMetrics() const
+{
+	WriteScheduleMetrics metrics;
+	metrics.samples = m_batch[DATA];
+	metrics.events = m_batch[EVENTS];
+	metrics.spikes = m_batch[SPIKES];
+	metrics.dataFill = m_fill[DATA];
+	metrics.eventFill = m_fill[EVENTS];
+	metrics.spikeFill = m_fill[SPIKES];
+	return metrics;
+}
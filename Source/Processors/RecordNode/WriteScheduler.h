@@ -0,0 +1,101 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef WRITESCHEDULER_H_INCLUDED
+#define WRITESCHEDULER_H_INCLUDED
+
+#include <JuceHeader.h>
+#include "../../Utils/Utils.h"
+#include <atomic>
+
+#define BLOCK_MAX_WRITE_SAMPLES 4096
+#define BLOCK_MAX_WRITE_EVENTS 32
+#define BLOCK_MAX_WRITE_SPIKES 32
+
+/* Time budget for one pass of the record thread loop */
+#define WRITE_SCHEDULE_TARGET_MS 20.0
+/* Above this queue occupancy a stream is drained regardless of its time budget */
+#define WRITE_SCHEDULE_HIGH_FILL 0.75f
+
+/** Batch sizes chosen for the last record thread pass, along with the queue occupancy they were chosen from */
+struct WriteScheduleMetrics
+{
+	int samples;
+	int events;
+	int spikes;
+	float dataFill;
+	float eventFill;
+	float spikeFill;
+};
+
+/**
+	Sizes the record thread write batches from the occupancy of each queue and the
+	throughput measured while writing previous batches. The BLOCK_MAX_WRITE_* values
+	are used as the minimum batch of each stream, so an idle stream behaves as before,
+	while a stream that backs up is allowed to take a larger share of each pass.
+
+	Only the record thread calls schedule() and the record* methods; the metrics can be read from any thread.
+*/
+class WriteScheduler
+{
+public:
+	enum Stream
+	{
+		DATA = 0,
+		EVENTS,
+		SPIKES,
+		NUM_STREAMS
+	};
+
+	WriteScheduler();
+
+	/** Forgets the measured throughput and last batches, called before a new recording */
+	void reset();
+
+	/** Chooses the batch sizes for the next pass. ready is the number of items waiting in each queue, capacity its size */
+	void schedule(int readySamples, int sampleCapacity, int readyEvents, int eventCapacity, int readySpikes, int spikeCapacity);
+
+	int getMaxSamples() const { return m_batch[DATA]; }
+	int getMaxEvents() const { return m_batch[EVENTS]; }
+	int getMaxSpikes() const { return m_batch[SPIKES]; }
+
+	/** Reports how many items of a stream were written and how long it took, in high resolution ticks */
+	void recordWrite(Stream stream, int numItems, int64 ticks);
+
+	WriteScheduleMetrics getMetrics() const;
+
+private:
+	int chooseBatch(Stream stream, int ready, int capacity);
+
+	const int m_minBatch[NUM_STREAMS];
+
+	/* Smoothed items per second written by the engine, 0 until measured */
+	double m_throughput[NUM_STREAMS];
+
+	std::atomic<int> m_batch[NUM_STREAMS];
+	std::atomic<float> m_fill[NUM_STREAMS];
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WriteScheduler);
+};
+
+#endif  // WRITESCHEDULER_H_INCLUDED
@@ -0,0 +1,274 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "SerialEventLoop.h"
+
+#if defined( TARGET_LINUX )
+#include <sys/epoll.h>
+#elif defined( TARGET_OSX )
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#if defined( TARGET_OSX ) || defined( TARGET_LINUX )
+#include <unistd.h>
+#endif
+
+/** Ports handled per wakeup */
+#define SERIAL_EVENT_BATCH_SIZE 16
+
+/** How long the thread waits before checking whether it should exit */
+#define SERIAL_EVENT_TIMEOUT_MS 50
+
+
+SerialEventLoop* SerialEventLoop::getInstance()
+{
+    static SerialEventLoop loop;
+    return &loop;
+}
+
+
+SerialEventLoop::SerialEventLoop()
+    : Thread ("Serial I/O")
+{
+    readBuffer.malloc (SERIAL_EVENT_READ_SIZE);
+
+#if defined( TARGET_LINUX )
+    pollFd = epoll_create1 (EPOLL_CLOEXEC);
+#elif defined( TARGET_OSX )
+    pollFd = kqueue();
+#endif
+}
+
+
+SerialEventLoop::~SerialEventLoop()
+{
+    stopThread (1000);
+
+#if defined( TARGET_OSX ) || defined( TARGET_LINUX )
+    if (pollFd >= 0)
+        ::close (pollFd);
+#endif
+}
+
+
+bool SerialEventLoop::addPort (ofSerial& port, Listener* listener)
+{
+    const ScopedLock lock (portLock);
+
+    if (! port.bInited || indexOf (port) >= 0)
+        return false;
+
+#if defined( TARGET_LINUX )
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = port.fd;
+
+    if (pollFd < 0 || epoll_ctl (pollFd, EPOLL_CTL_ADD, port.fd, &event) != 0)
+        return false;
+#elif defined( TARGET_OSX )
+    struct kevent event;
+    EV_SET (&event, port.fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+
+    if (pollFd < 0 || kevent (pollFd, &event, 1, nullptr, 0, nullptr) != 0)
+        return false;
+#endif
+
+    WatchedPort watched;
+    watched.port = &port;
+    watched.listener = listener;
+    ports.add (watched);
+
+    if (! isThreadRunning())
+        startThread (8);
+
+    return true;
+}
+
+
+void SerialEventLoop::removePort (ofSerial& port)
+{
+    bool lastPort;
+
+    {
+        // waits for the I/O thread to be done with the listeners
+        const ScopedLock lock (portLock);
+
+        const int index = indexOf (port);
+
+        if (index < 0)
+            return;
+
+        unwatch (port);
+        ports.remove (index);
+
+        lastPort = ports.isEmpty();
+    }
+
+    if (lastPort && Thread::getCurrentThreadId() != getThreadId())
+        stopThread (1000);
+}
+
+
+void SerialEventLoop::unwatch (ofSerial& port)
+{
+#if defined( TARGET_LINUX )
+    epoll_event event;
+    epoll_ctl (pollFd, EPOLL_CTL_DEL, port.fd, &event);
+#elif defined( TARGET_OSX )
+    struct kevent event;
+    EV_SET (&event, port.fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    kevent (pollFd, &event, 1, nullptr, 0, nullptr);
+#endif
+}
+
+
+int SerialEventLoop::indexOf (const ofSerial& port) const
+{
+    for (int i = 0; i < ports.size(); ++i)
+    {
+        if (ports.getReference (i).port == &port)
+            return i;
+    }
+
+    return -1;
+}
+
+
+void SerialEventLoop::run()
+{
+#if defined( TARGET_OSX ) || defined( TARGET_LINUX )
+
+#if defined( TARGET_LINUX )
+    epoll_event events[SERIAL_EVENT_BATCH_SIZE];
+#else
+    struct kevent events[SERIAL_EVENT_BATCH_SIZE];
+    const struct timespec timeout = { 0, SERIAL_EVENT_TIMEOUT_MS * 1000000 };
+#endif
+
+    while (! threadShouldExit())
+    {
+#if defined( TARGET_LINUX )
+        const int numEvents = epoll_wait (pollFd, events, SERIAL_EVENT_BATCH_SIZE, SERIAL_EVENT_TIMEOUT_MS);
+#else
+        const int numEvents = kevent (pollFd, nullptr, 0, events, SERIAL_EVENT_BATCH_SIZE, &timeout);
+#endif
+
+        if (numEvents < 0)
+        {
+            if (errno != EINTR)
+                wait (SERIAL_EVENT_TIMEOUT_MS);
+
+            continue;
+        }
+
+        const ScopedLock lock (portLock);
+
+        for (int e = 0; e < numEvents; ++e)
+        {
+#if defined( TARGET_LINUX )
+            const int fd = events[e].data.fd;
+            const bool hungUp = (events[e].events & (EPOLLERR | EPOLLHUP)) != 0
+                                && (events[e].events & EPOLLIN) == 0;
+#else
+            const int fd = (int) events[e].ident;
+            const bool hungUp = (events[e].flags & EV_ERROR) != 0
+                                || ((events[e].flags & EV_EOF) != 0 && events[e].data == 0);
+#endif
+            // the port may have been removed since the wait returned
+            int index = -1;
+
+            for (int i = 0; i < ports.size(); ++i)
+            {
+                if (ports.getReference (i).port->fd == fd)
+                    index = i;
+            }
+
+            if (index < 0)
+                continue;
+
+            if (hungUp || ! readPort (index))
+                portFailed (index);
+        }
+    }
+
+#else
+
+    while (! threadShouldExit())
+    {
+        {
+            const ScopedLock lock (portLock);
+
+            for (int i = ports.size(); --i >= 0;)
+            {
+                const int bytesAvailable = ports.getReference (i).port->available();
+
+                if (bytesAvailable == OF_SERIAL_ERROR || (bytesAvailable > 0 && ! readPort (i)))
+                    portFailed (i);
+            }
+        }
+
+        wait (1);
+    }
+
+#endif
+}
+
+
+bool SerialEventLoop::readPort (int index)
+{
+    const WatchedPort watched = ports.getReference (index);
+
+    // the port was reported readable, so finding nothing at all means it hung up
+    for (bool firstRead = true;; firstRead = false)
+    {
+        const int bytesRead = watched.port->readBytes (readBuffer, SERIAL_EVENT_READ_SIZE);
+
+        if (bytesRead == OF_SERIAL_NO_DATA)
+            return true;
+
+        if (bytesRead < 0)
+            return false;
+
+        if (bytesRead == 0)
+            return ! firstRead;
+
+        watched.listener->serialDataReceived (*watched.port, readBuffer, bytesRead);
+
+        // the listener may have removed its port
+        if (indexOf (*watched.port) < 0 || bytesRead < SERIAL_EVENT_READ_SIZE)
+            return true;
+    }
+}
+
+
+void SerialEventLoop::portFailed (int index)
+{
+    const WatchedPort watched = ports.getReference (index);
+
+    unwatch (*watched.port);
+    ports.remove (index);
+
+    watched.listener->serialErrorOccurred (*watched.port);
+}
@@ -0,0 +1,108 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SERIALEVENTLOOP_H_5B3F7D21__
+#define __SERIALEVENTLOOP_H_5B3F7D21__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "ofSerial.h"
+
+/** Bytes read from a port at a time */
+#define SERIAL_EVENT_READ_SIZE 4096
+
+
+/**
+    Services the reads of any number of open serial ports from a single I/O thread.
+
+    The thread sleeps in the OS readiness wait (epoll on Linux, kqueue on macOS) until
+    one of the ports has bytes, reads them all and hands them to the port's listener,
+    so they are delivered as soon as they arrive, without any polling interval. On
+    Windows, where the ports are opened for synchronous I/O, the thread checks the
+    input queues of all the ports every millisecond instead.
+
+    Writes stay synchronous, on the caller's thread.
+
+    @see ofSerial
+*/
+class PLUGIN_API SerialEventLoop : private Thread
+{
+public:
+    class PLUGIN_API Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** Called on the I/O thread with the bytes read from a port */
+        virtual void serialDataReceived (ofSerial& port, const uint8* data, int numBytes) = 0;
+
+        /** Called on the I/O thread when a port can't be read anymore; it has been removed already */
+        virtual void serialErrorOccurred (ofSerial& port) = 0;
+    };
+
+    static SerialEventLoop* getInstance();
+
+    /** Starts reading an open port. Returns false if it can't be waited on. */
+    bool addPort (ofSerial& port, Listener* listener);
+
+    /** Stops reading a port, which must be done before closing it. Once this returns,
+        the listener isn't called anymore, unless this is called from the listener itself. */
+    void removePort (ofSerial& port);
+
+private:
+    SerialEventLoop();
+    ~SerialEventLoop();
+
+    void run() override;
+
+    /** Reads everything the port holds. Returns false if it can't be read anymore. */
+    bool readPort (int index);
+
+    /** Removes a port that failed, and tells its listener */
+    void portFailed (int index);
+
+    /** Removes a port from the OS wait */
+    void unwatch (ofSerial& port);
+
+    int indexOf (const ofSerial& port) const;
+
+    struct WatchedPort
+    {
+        ofSerial* port;
+        Listener* listener;
+    };
+
+    /** Held while ports are changed, and while the listeners are called */
+    CriticalSection portLock;
+    Array<WatchedPort> ports;
+
+    HeapBlock<uint8> readBuffer;
+
+#if defined( TARGET_OSX ) || defined( TARGET_LINUX )
+    int pollFd;     // the epoll or kqueue descriptor
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE (SerialEventLoop);
+};
+
+#endif  // __SERIALEVENTLOOP_H_5B3F7D21__
@@ -76,6 +76,7 @@ protected:
 //----------------------------------------------------------------------
 class PLUGIN_API ofSerial
 {
+    friend class SerialEventLoop;
 
 public:
     ofSerial();
@@ -0,0 +1,151 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ClockDriftModel.h"
+
+
+ClockDriftModel::ClockDriftModel()
+    : sequence (0)
+    , refSample (0)
+    , refNs (0)
+    , nsPerSample (0)
+    , valid (false)
+{
+    reset (30000.0);
+}
+
+
+void ClockDriftModel::reset (double nominalSampleRate)
+{
+    nominalNsPerSample = nominalSampleRate > 0 ? 1.0e9 / nominalSampleRate : 0;
+    originSample = 0;
+    originNs = 0;
+    numObservations = 0;
+    meanX = meanY = covXX = covXY = 0;
+
+    valid.store (false);
+    publish (0, getCurrentTimeNs(), nominalNsPerSample);
+}
+
+
+void ClockDriftModel::addObservation (juce::int64 sample, juce::int64 timeNs)
+{
+    if (numObservations == 0)
+    {
+        originSample = sample;
+        originNs = timeNs;
+    }
+
+    numObservations++;
+
+    // plain averages while the window fills up, exponentially weighted ones afterwards
+    double alpha = 1.0 / double (jmin (numObservations, (juce::int64) DRIFT_MODEL_WINDOW));
+
+    double dx = double (sample - originSample) - meanX;
+    double dy = double (timeNs - originNs) - meanY;
+    meanX += alpha * dx;
+    meanY += alpha * dy;
+    covXX = (1.0 - alpha) * (covXX + alpha * dx * dx);
+    covXY = (1.0 - alpha) * (covXY + alpha * dx * dy);
+
+    double slope = nominalNsPerSample;
+    if (covXX > 0)
+    {
+        double fitted = covXY / covXX;
+        if (nominalNsPerSample <= 0 || std::abs (fitted - nominalNsPerSample) <= nominalNsPerSample * DRIFT_MODEL_MAX_SKEW)
+            slope = fitted;
+    }
+
+    publish (originSample + juce::int64 (meanX), originNs + juce::int64 (meanY), slope);
+
+    if (numObservations >= 2)
+        valid.store (true, std::memory_order_release);
+}
+
+
+void ClockDriftModel::publish (juce::int64 sample, juce::int64 ns, double slope)
+{
+    juce::uint32 seq = sequence.load (std::memory_order_relaxed);
+    sequence.store (seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    refSample.store (sample, std::memory_order_relaxed);
+    refNs.store (ns, std::memory_order_relaxed);
+    nsPerSample.store (slope, std::memory_order_relaxed);
+
+    sequence.store (seq + 2, std::memory_order_release);
+}
+
+
+ClockDriftModel::Fit ClockDriftModel::readFit() const
+{
+    Fit fit;
+    juce::uint32 before, after;
+    do
+    {
+        before = sequence.load (std::memory_order_acquire);
+        fit.refSample = refSample.load (std::memory_order_relaxed);
+        fit.refNs = refNs.load (std::memory_order_relaxed);
+        fit.nsPerSample = nsPerSample.load (std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_acquire);
+        after = sequence.load (std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+    return fit;
+}
+
+
+juce::int64 ClockDriftModel::sampleToNs (juce::int64 sample) const
+{
+    Fit fit = readFit();
+    return fit.refNs + juce::int64 (double (sample - fit.refSample) * fit.nsPerSample);
+}
+
+
+juce::int64 ClockDriftModel::nsToSample (juce::int64 timeNs) const
+{
+    Fit fit = readFit();
+    if (fit.nsPerSample <= 0)
+        return fit.refSample;
+
+    return fit.refSample + juce::int64 (double (timeNs - fit.refNs) / fit.nsPerSample);
+}
+
+
+double ClockDriftModel::getMeasuredSampleRate() const
+{
+    Fit fit = readFit();
+    return fit.nsPerSample > 0 ? 1.0e9 / fit.nsPerSample : 0;
+}
+
+
+bool ClockDriftModel::isValid() const
+{
+    return valid.load (std::memory_order_acquire);
+}
+
+
+juce::int64 ClockDriftModel::getCurrentTimeNs()
+{
+    return juce::int64 (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks()) * 1.0e9);
+}
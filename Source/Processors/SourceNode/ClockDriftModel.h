@@ -0,0 +1,100 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CLOCKDRIFTMODEL_H_7A3E91C2__
+#define __CLOCKDRIFTMODEL_H_7A3E91C2__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+#include <atomic>
+
+/** Number of observations the fit effectively averages over once it has settled */
+#define DRIFT_MODEL_WINDOW      1000
+/** Largest relative difference between the fitted and nominal sample rates that is accepted */
+#define DRIFT_MODEL_MAX_SKEW    0.01
+
+/**
+    Running linear model relating the hardware sample numbers of a source to the
+    high resolution software clock, in nanoseconds.
+
+    Observations are added by a single thread, the SourceNode processing thread, and
+    the fit is published with a sequence lock so any thread can query it without locking.
+
+    @see SourceNode
+*/
+class PLUGIN_API ClockDriftModel
+{
+public:
+    ClockDriftModel();
+
+    /** Forgets all observations. Until new ones arrive the nominal sample rate is used.*/
+    void reset (double nominalSampleRate);
+
+    /** Adds an observation: the given hardware sample was current at the given software time.*/
+    void addObservation (juce::int64 sample, juce::int64 timeNs);
+
+    /** Converts a hardware sample number to the software clock, in nanoseconds.*/
+    juce::int64 sampleToNs (juce::int64 sample) const;
+
+    /** Converts a software clock time, in nanoseconds, to a hardware sample number.*/
+    juce::int64 nsToSample (juce::int64 timeNs) const;
+
+    /** Returns the sample rate of the hardware clock as measured by the software one.*/
+    double getMeasuredSampleRate() const;
+
+    /** Returns true once at least two observations have been fitted.*/
+    bool isValid() const;
+
+    /** Current time of the software clock the model maps to, in nanoseconds.*/
+    static juce::int64 getCurrentTimeNs();
+
+private:
+    struct Fit
+    {
+        juce::int64 refSample;
+        juce::int64 refNs;
+        double nsPerSample;
+    };
+
+    Fit readFit() const;
+    void publish (juce::int64 refSample, juce::int64 refNs, double nsPerSample);
+
+    /* Published fit. Odd sequence numbers mean an update is in progress */
+    std::atomic<juce::uint32> sequence;
+    std::atomic<juce::int64> refSample;
+    std::atomic<juce::int64> refNs;
+    std::atomic<double> nsPerSample;
+    std::atomic<bool> valid;
+
+    /* Writer state: exponentially weighted means and covariances, relative to the first observation */
+    double nominalNsPerSample;
+    juce::int64 originSample;
+    juce::int64 originNs;
+    juce::int64 numObservations;
+    double meanX, meanY, covXX, covXY;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClockDriftModel);
+};
+
+
+#endif  // __CLOCKDRIFTMODEL_H_7A3E91C2__
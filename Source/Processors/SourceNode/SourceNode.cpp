@@ -29,6 +29,65 @@
 
 #include "../../Utils/Utils.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SN_USE_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	/* Returns the index of the first of the numSamples event words that differs from the one before it,
+	or numSamples if none does. The word before the first one is last */
+	int findNextChange(const uint64* words, int numSamples, uint64 last)
+	{
+		if (numSamples <= 0)
+			return 0;
+		if (words[0] != last)
+			return 0;
+
+		int i = 1;
+#if SN_USE_SSE2
+		/* 64-bit equality from the 32-bit compare: both halves must match */
+		for (; i + 4 <= numSamples; i += 4)
+		{
+			__m128i eq0 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(words + i)), _mm_loadu_si128((const __m128i*)(words + i - 1)));
+			__m128i eq1 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(words + i + 2)), _mm_loadu_si128((const __m128i*)(words + i + 1)));
+			eq0 = _mm_and_si128(eq0, _mm_shuffle_epi32(eq0, _MM_SHUFFLE(2, 3, 0, 1)));
+			eq1 = _mm_and_si128(eq1, _mm_shuffle_epi32(eq1, _MM_SHUFFLE(2, 3, 0, 1)));
+			if (_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) != 0xFFFF)
+				break;
+		}
+#endif
+		for (; i < numSamples; ++i)
+		{
+			if (words[i] != words[i - 1])
+				return i;
+		}
+		return numSamples;
+	}
+
+	inline int lowestSetBit(uint64 bits)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)bits))
+			return (int)index;
+		_BitScanForward(&index, (unsigned long)(bits >> 32));
+		return (int)index + 32;
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+}
+
 
 SourceNode::SourceNode (const String& name_, DataThreadCreator dt)
     : GenericProcessor      (name_)
@@ -96,8 +155,8 @@ int SourceNode::getTTLState() const
 void SourceNode::resizeBuffers()
 {
 	inputBuffers.clear();
-	eventCodeBuffers.clear();
 	eventStates.clear();
+	driftModels.clear();
 	if (dataThread != nullptr)
 	{
 		dataThread->resizeBuffers();
@@ -105,8 +164,8 @@ void SourceNode::resizeBuffers()
 		for (int i = 0; i < numSubProcs; i++)
 		{
 			inputBuffers.add(dataThread->getBufferAddress(i));
-			eventCodeBuffers.add(new MemoryBlock(10000*sizeof(uint64)));
 			eventStates.add(0);
+			driftModels.add(new ClockDriftModel());
 		}
 	}
 }
@@ -202,6 +261,7 @@ void SourceNode::setChannelInfo(int channel, String name, float bitVolts)
 void SourceNode::createEventChannels()
 {
 	ttlChannels.clear();
+	burstChannels.clear();
 	if (dataThread)
 	{
 		//Create base TTL event channels
@@ -221,6 +281,21 @@ void SourceNode::createEventChannels()
 			}
 			else
 				ttlChannels.add(nullptr);
+
+			TTLCoalescer* coalescer = getTTLCoalescer(i);
+			coalescer->setNumChannels(nChans);
+
+			if (nChans > 0 && coalescer->countsBursts())
+			{
+				EventChannel* chan = new EventChannel(EventChannel::UINT32_ARRAY, nChans, 1, dataThread->getSampleRate(i), this, i);
+				chan->setName(getName() + " source TTL bursts");
+				chan->setDescription("Number of edges of a TTL line of the source processor \"" + getName() + "\" that were counted instead of sent as TTL events");
+				chan->setIdentifier("sourceevent.burst");
+				eventChannelArray.add(chan);
+				burstChannels.add(chan);
+			}
+			else
+				burstChannels.add(nullptr);
 		}
 		//Add other events that the source might create
 		Array<EventChannel*> events;
@@ -256,7 +331,8 @@ void SourceNode::setEnabledState (bool newState)
 
 void SourceNode::setParameter (int parameterIndex, float newValue)
 {
-    editor->updateParameterButtons (parameterIndex);
+    if (! isApplyingParameterChanges())
+        editor->updateParameterButtons (parameterIndex);
     LOGDD("Got parameter change notification");
 }
 
@@ -339,6 +415,16 @@ bool SourceNode::enable()
 
     if (dataThread != nullptr)
     {
+        for (int i = 0; i < driftModels.size(); i++)
+            driftModels[i]->reset (dataThread->getSampleRate (i));
+
+        for (int i = 0; i < ttlCoalescers.size(); i++)
+            ttlCoalescers[i]->reset();
+
+        for (int i = 0; i < inputBuffers.size(); i++)
+            inputBuffers[i]->resetHighWaterMark();
+
+        dataThread->applyThreadSettings();
         dataThread->startAcquisition();
         return true;
     }
@@ -354,8 +440,20 @@ bool SourceNode::disable()
     LOGD("Source node received disable signal");
 
     if (dataThread != nullptr)
+    {
         dataThread->stopAcquisition();
 
+        for (int i = 0; i < inputBuffers.size(); i++)
+        {
+            DataBuffer* buffer = inputBuffers[i];
+            float sampleRate = dataThread->getSampleRate (i);
+
+            LOGD ("Source buffer ", i, ": high-water mark ", buffer->getHighWaterMark(), " of ", buffer->getCapacity(),
+                  " samples (", sampleRate > 0 ? 1000.0f * buffer->getHighWaterMark() / sampleRate : 0.0f, " of ",
+                  sampleRate > 0 ? 1000.0f * buffer->getCapacity() / sampleRate : 0.0f, " ms)");
+        }
+    }
+
     startTimer (2000); // timer to check for connected source
 
     wasDisabled = true;
@@ -390,47 +488,147 @@ void SourceNode::process(AudioSampleBuffer& buffer)
 {
 	int nSubs = dataThread->getNumSubProcessors();
 	int copiedChannels = 0;
+	int64 nowNs = ClockDriftModel::getCurrentTimeNs();
 
 	for (int sub = 0; sub < nSubs; sub++)
 	{
+		DataBuffer* source = inputBuffers[sub];
 		int channelsToCopy = getNumOutputs(sub);
-		
-		int nSamples = inputBuffers[sub]->readAllFromBuffer(buffer, &timestamp, static_cast<uint64*>(eventCodeBuffers[sub]->getData()), buffer.getNumSamples(), copiedChannels, channelsToCopy);
+
+		// read the acquisition ring in place; only the samples are copied into the graph buffer
+		int startIndex1, blockSize1, startIndex2, blockSize2;
+		int nSamples = source->prepareToRead(buffer.getNumSamples(), startIndex1, blockSize1, startIndex2, blockSize2);
+
+		const float* const* channels = source->getChannelReadPointers();
+		for (int chan = 0; chan < channelsToCopy; ++chan)
+		{
+			buffer.copyFrom(copiedChannels + chan, 0, channels[chan] + startIndex1, blockSize1);
+			if (blockSize2 > 0)
+				buffer.copyFrom(copiedChannels + chan, blockSize1, channels[chan] + startIndex2, blockSize2);
+		}
 		copiedChannels += channelsToCopy;
 
+		timestamp = blockSize1 > 0 ? source->getTimestampReadPointer()[startIndex1] : source->getLastTimestamp();
+
 		setTimestampAndSamples(timestamp, nSamples, sub); 
 
+		// the newest sample in the buffer is the one acquired closest to now
+		if (nSamples > 0 && sub < driftModels.size())
+			driftModels[sub]->addObservation(source->getLastTimestamp(), nowNs);
+
 		if (ttlChannels[sub])
 		{
-			int numEventChannels = ttlChannels[sub]->getNumChannels();
-			// fill event buffer
-			uint64 last = eventStates[sub];
-			for (int i = 0; i < nSamples; ++i)
-			{
-				uint64 current = *(static_cast<uint64*>(eventCodeBuffers[sub]->getData()) + i);
-				//If there has been no change to the TTL word, avoid doing anything at all here
-				if (last != current)
-				{
-					//Create a TTL event for each bit that has changed
-					for (int c = 0; c < numEventChannels; ++c)
-					{
-						if (((current >> c) & 0x01) != ((last >> c) & 0x01))
-						{
-							TTLEventPtr event = TTLEvent::createTTLEvent(ttlChannels[sub], timestamp + i, &current, sizeof(uint64), c);
-							addEvent(ttlChannels[sub], event, i);
-						}
-					}
-					last = current;
-				}
-			}
-			eventStates.set(sub, last);
+			const uint64* eventCodes = source->getEventCodeReadPointer();
+			ttlEdges.clearQuick();
+			createTTLEvents(sub, eventCodes + startIndex1, blockSize1, 0);
+			if (blockSize2 > 0)
+				createTTLEvents(sub, eventCodes + startIndex2, blockSize2, blockSize1);
+			addCollectedTTLEvents(sub, nSamples);
 		}
+
+		source->finishedRead(nSamples);
 	}
 }
 
+void SourceNode::createTTLEvents(int sub, const uint64* eventCodes, int numSamples, int sampleOffset)
+{
+	int numEventChannels = ttlChannels[sub]->getNumChannels();
+	uint64 channelMask = numEventChannels >= 64 ? ~uint64(0) : (uint64(1) << numEventChannels) - 1;
+
+	uint64 last = eventStates[sub];
+	int i = findNextChange(eventCodes, numSamples, last);
+	while (i < numSamples)
+	{
+		uint64 current = eventCodes[i];
+		//Create a TTL event for each bit that has changed
+		uint64 changed = (current ^ last) & channelMask;
+		while (changed != 0)
+		{
+			TTLEdge edge;
+			edge.timestamp = timestamp + sampleOffset + i;
+			edge.eventData = eventCodes + i;
+			edge.sampleNum = sampleOffset + i;
+			edge.channel = static_cast<uint16>(lowestSetBit(changed));
+			ttlEdges.add(edge);
+			changed &= changed - 1;
+		}
+		last = current;
+		i++;
+		i += findNextChange(eventCodes + i, numSamples - i, last);
+	}
+	eventStates.set(sub, last);
+}
+
+void SourceNode::addCollectedTTLEvents(int sub, int numSamples)
+{
+	TTLCoalescer* coalescer = ttlCoalescers[sub];
+
+	if (coalescer == nullptr || !coalescer->isActive())
+	{
+		addTTLEvents(ttlChannels[sub], ttlEdges.getRawDataPointer(), ttlEdges.size());
+		return;
+	}
+
+	coalescer->process(ttlEdges.getRawDataPointer(), ttlEdges.size(), timestamp, numSamples);
+	addTTLEvents(ttlChannels[sub], coalescer->getEdges(), coalescer->getNumEdges());
+
+	if (const EventChannel* burstChannel = burstChannels[sub])
+	{
+		const TTLBurst* bursts = coalescer->getBursts();
+		for (int i = 0; i < coalescer->getNumBursts(); i++)
+			addBinaryEvent(burstChannel, bursts[i].timestamp, &bursts[i].numEdges, sizeof(uint32), bursts[i].sampleNum, nullptr, bursts[i].channel);
+	}
+}
+
+TTLCoalescer* SourceNode::getTTLCoalescer(int subProcessorIdx)
+{
+	while (ttlCoalescers.size() <= subProcessorIdx)
+		ttlCoalescers.add(new TTLCoalescer());
+
+	return ttlCoalescers[subProcessorIdx];
+}
+
+void SourceNode::setTTLCoalescing(int subProcessorIdx, int channel, const TTLCoalescer::ChannelSettings& settings)
+{
+	if (subProcessorIdx < 0 || channel < 0 || channel >= 64)
+		return;
+
+	TTLCoalescer* coalescer = getTTLCoalescer(subProcessorIdx);
+
+	if (channel >= coalescer->getNumChannels())
+		coalescer->setNumChannels(channel + 1);
+
+	coalescer->setChannelSettings(channel, settings);
+}
+
+TTLCoalescer::ChannelSettings SourceNode::getTTLCoalescing(int subProcessorIdx, int channel) const
+{
+	if (TTLCoalescer* coalescer = ttlCoalescers[subProcessorIdx])
+		return coalescer->getChannelSettings(channel);
+
+	return TTLCoalescer::ChannelSettings();
+}
+
+
+const ClockDriftModel* SourceNode::getClockDriftModel(int subProcessorIdx) const
+{
+	return driftModels[subProcessorIdx];
+}
+
+
+void SourceNode::setAcquisitionThreadSettings(bool realTime, int firstCore)
+{
+	if (dataThread != nullptr)
+		dataThread->setAcquisitionThreadSettings(realTime, firstCore);
+}
+
 
 void SourceNode::saveCustomParametersToXml (XmlElement* parentElement)
 {
+    XmlElement* threadXml = parentElement->createNewChildElement ("ACQUISITION_THREADS");
+    threadXml->setAttribute ("realtime", dataThread->usesRealTimePriority());
+    threadXml->setAttribute ("core",     dataThread->getFirstAcquisitionCore());
+
     XmlElement* channelXml = parentElement->createNewChildElement ("CHANNEL_INFO");
     if (dataThread->usesCustomNames())
     {
@@ -444,6 +642,23 @@ void SourceNode::saveCustomParametersToXml (XmlElement* parentElement)
             chan->setAttribute ("gain",     channelInfo[i].gain);
         }
     }
+
+    XmlElement* coalescingXml = parentElement->createNewChildElement ("TTL_COALESCING");
+    for (int sub = 0; sub < ttlCoalescers.size(); ++sub)
+    {
+        for (int i = 0; i < ttlCoalescers[sub]->getNumChannels(); ++i)
+        {
+            TTLCoalescer::ChannelSettings settings = ttlCoalescers[sub]->getChannelSettings (i);
+            if (settings.debounceSamples == 0 && settings.maxEdgesPerBlock == 0)
+                continue;
+
+            XmlElement* line = coalescingXml->createNewChildElement ("LINE");
+            line->setAttribute ("subprocessor", sub);
+            line->setAttribute ("channel",      i);
+            line->setAttribute ("debounce",     settings.debounceSamples);
+            line->setAttribute ("maxedges",     settings.maxEdgesPerBlock);
+        }
+    }
 }
 
 
@@ -454,7 +669,24 @@ void SourceNode::loadCustomParametersFromXml()
         // use parametersAsXml to restore state
         forEachXmlChildElement (*parametersAsXml, xmlNode)
         {
-            if (xmlNode->hasTagName ("CHANNEL_INFO"))
+            if (xmlNode->hasTagName ("ACQUISITION_THREADS"))
+            {
+                setAcquisitionThreadSettings (xmlNode->getBoolAttribute ("realtime", true),
+                                              xmlNode->getIntAttribute ("core", -1));
+                if (editor != nullptr)
+                    editor->updateSettings();
+            }
+            else if (xmlNode->hasTagName ("TTL_COALESCING"))
+            {
+                forEachXmlChildElementWithTagName (*xmlNode, line, "LINE")
+                {
+                    TTLCoalescer::ChannelSettings settings;
+                    settings.debounceSamples  = line->getIntAttribute ("debounce", 0);
+                    settings.maxEdgesPerBlock = line->getIntAttribute ("maxedges", 0);
+                    setTTLCoalescing (line->getIntAttribute ("subprocessor"), line->getIntAttribute ("channel"), settings);
+                }
+            }
+            else if (xmlNode->hasTagName ("CHANNEL_INFO"))
             {
                 forEachXmlChildElementWithTagName (*xmlNode, chan, "CHANNEL")
                 {
@@ -468,4 +700,4 @@ void SourceNode::loadCustomParametersFromXml()
             }
         }
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
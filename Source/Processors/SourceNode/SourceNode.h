@@ -27,6 +27,8 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include <stdio.h>
 #include "../DataThreads/DataThread.h"
+#include "ClockDriftModel.h"
+#include "TTLCoalescer.h"
 #include "../GenericProcessor/GenericProcessor.h"
 #include "../../UI/UIComponent.h"
 
@@ -88,6 +90,20 @@ public:
     bool tryEnablingEditor();
 
 	void setChannelInfo(int channel, String name, float bitVolts);
+
+	/** Returns the model relating the hardware timestamps of a subprocessor to the software clock.
+	It is updated every block while acquiring and can be queried from any thread. */
+	const ClockDriftModel* getClockDriftModel(int subProcessorIdx) const;
+
+	/** Scheduling of the acquisition threads, see DataThread::setAcquisitionThreadSettings */
+	void setAcquisitionThreadSettings(bool realTime, int firstCore);
+
+	/** Sets how the edges of a TTL line of a subprocessor are thinned out before they become
+	events, see TTLCoalescer. Changed while acquisition is stopped; turning burst counting
+	on or off for a subprocessor adds or removes its burst event channel at the next
+	signal chain update */
+	void setTTLCoalescing(int subProcessorIdx, int channel, const TTLCoalescer::ChannelSettings& settings);
+	TTLCoalescer::ChannelSettings getTTLCoalescing(int subProcessorIdx, int channel) const;
 protected:
 	int getDefaultNumDataOutputs(DataChannel::DataChannelTypes type, int subProcessorIdx = 0) const override;
 
@@ -108,13 +124,24 @@ private:
     uint64 timestamp;
     //uint64* eventCodeBuffer;
     //int* eventChannelState;
-    OwnedArray<MemoryBlock> eventCodeBuffers;
 	Array<uint64> eventStates;
 	Array<EventChannel*> ttlChannels;
+	Array<TTLEdge> ttlEdges;
+	OwnedArray<ClockDriftModel> driftModels;
+	OwnedArray<TTLCoalescer> ttlCoalescers;
+	Array<EventChannel*> burstChannels;
 
     int ttlState;
 	void resizeBuffers();
 
+	/** Collects a TTL edge for each bit that changes in the event words of a subprocessor */
+	void createTTLEvents(int sub, const uint64* eventCodes, int numSamples, int sampleOffset);
+
+	/** Adds the collected edges of a block as events, through the subprocessor's coalescer if it is active */
+	void addCollectedTTLEvents(int sub, int numSamples);
+
+	TTLCoalescer* getTTLCoalescer(int subProcessorIdx);
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SourceNode);
 };
@@ -67,13 +67,32 @@ SourceNodeEditor::SourceNodeEditor(GenericProcessor* parentNode, bool useDefault
 
     icon = new ImageIcon(im);
     addAndMakeVisible(icon);
-    icon->setBounds(50,40,70,70);
+    icon->setBounds(50,30,70,70);
 
     if (getName().equalsIgnoreCase("Custom FPGA"))
     {
-        icon->setBounds(20,15,120,120);
+        icon->setBounds(35,20,100,85);
     }
 
+    // scheduling of the acquisition threads
+    realTimeButton = new UtilityButton("RT", Font("Small Text", 13, Font::plain));
+    realTimeButton->setClickingTogglesState(true);
+    realTimeButton->setTooltip("Run the acquisition threads with real-time priority");
+    realTimeButton->addListener(this);
+    realTimeButton->setBounds(10, 107, 30, 18);
+    addAndMakeVisible(realTimeButton);
+
+    coreSelector = new ComboBox("Acquisition core");
+    coreSelector->addItem("Any core", 1);
+    for (int i = 0; i < jmin(SystemStats::getNumCpus(), 32); i++)
+        coreSelector->addItem("From core " + String(i), i + 2);
+    coreSelector->setTooltip("Pin the acquisition threads to consecutive cores");
+    coreSelector->addListener(this);
+    coreSelector->setBounds(45, 107, 115, 18);
+    addAndMakeVisible(coreSelector);
+
+    updateSettings();
+
     //Array<int> values;
     //values.add(1); values.add(2), values.add(3);
 
@@ -86,4 +105,46 @@ SourceNodeEditor::SourceNodeEditor(GenericProcessor* parentNode, bool useDefault
 SourceNodeEditor::~SourceNodeEditor()
 {
     deleteAllChildren();
-}
\ No newline at end of file
+}
+
+void SourceNodeEditor::updateSettings()
+{
+    DataThread* thread = static_cast<SourceNode*>(getProcessor())->getThread();
+    if (thread == nullptr)
+        return;
+
+    realTimeButton->setToggleState(thread->usesRealTimePriority(), dontSendNotification);
+    coreSelector->setSelectedId(thread->getFirstAcquisitionCore() + 2, dontSendNotification);
+}
+
+void SourceNodeEditor::buttonEvent(Button* button)
+{
+    if (button == realTimeButton)
+        applyThreadSettings();
+}
+
+void SourceNodeEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == coreSelector)
+        applyThreadSettings();
+}
+
+void SourceNodeEditor::applyThreadSettings()
+{
+    static_cast<SourceNode*>(getProcessor())->setAcquisitionThreadSettings(realTimeButton->getToggleState(),
+                                                                           coreSelector->getSelectedId() - 2);
+}
+
+void SourceNodeEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+    realTimeButton->setEnabled(false);
+    coreSelector->setEnabled(false);
+}
+
+void SourceNodeEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+    realTimeButton->setEnabled(true);
+    coreSelector->setEnabled(true);
+}
\ No newline at end of file
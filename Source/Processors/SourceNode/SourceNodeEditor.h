@@ -39,17 +39,32 @@ class ImageIcon;
 */
 
 
-class SourceNodeEditor : public GenericEditor
+class SourceNodeEditor : public GenericEditor,
+                         public ComboBox::Listener
 
 {
 public:
     SourceNodeEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
     virtual ~SourceNodeEditor();
 
+    void buttonEvent(Button* button) override;
+    void comboBoxChanged(ComboBox* comboBox) override;
+
+    void updateSettings() override;
+
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
 private:
 
+    /** Sends the scheduling selected in the editor to the data thread */
+    void applyThreadSettings();
+
     ImageIcon* icon;
 
+    UtilityButton* realTimeButton;
+    ComboBox* coreSelector;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SourceNodeEditor);
     
 
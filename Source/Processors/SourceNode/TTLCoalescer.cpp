@@ -0,0 +1,225 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TTLCoalescer.h"
+
+/* Edges a block can send before the arrays grow on the processing thread */
+#define TTL_COALESCER_RESERVED_EDGES 1024
+
+
+TTLCoalescer::TTLCoalescer()
+    : sentWord (0)
+{
+    sentEdges.ensureStorageAllocated (TTL_COALESCER_RESERVED_EDGES);
+    sentWords.ensureStorageAllocated (TTL_COALESCER_RESERVED_EDGES);
+}
+
+void TTLCoalescer::setNumChannels (int numChannels)
+{
+    numChannels = jlimit (0, 64, numChannels);
+
+    settings.resize (numChannels);
+    lines.resize (numChannels);
+    bursts.ensureStorageAllocated (numChannels);
+}
+
+int TTLCoalescer::getNumChannels() const
+{
+    return settings.size();
+}
+
+void TTLCoalescer::setChannelSettings (int channel, const ChannelSettings& newSettings)
+{
+    if (channel < 0 || channel >= settings.size())
+        return;
+
+    ChannelSettings& s = settings.getReference (channel);
+    s.debounceSamples = jmax (0, newSettings.debounceSamples);
+    s.maxEdgesPerBlock = jmax (0, newSettings.maxEdgesPerBlock);
+}
+
+TTLCoalescer::ChannelSettings TTLCoalescer::getChannelSettings (int channel) const
+{
+    return settings[channel];
+}
+
+bool TTLCoalescer::isActive() const
+{
+    for (const ChannelSettings& s : settings)
+        if (s.debounceSamples > 0 || s.maxEdgesPerBlock > 0)
+            return true;
+
+    return false;
+}
+
+bool TTLCoalescer::countsBursts() const
+{
+    for (const ChannelSettings& s : settings)
+        if (s.maxEdgesPerBlock > 0)
+            return true;
+
+    return false;
+}
+
+void TTLCoalescer::reset()
+{
+    for (int i = 0; i < lines.size(); i++)
+        lines.set (i, LineState());
+
+    sentWord = 0;
+    sentEdges.clearQuick();
+    sentWords.clearQuick();
+    bursts.clearQuick();
+}
+
+void TTLCoalescer::process (const TTLEdge* edges, int numEdges, juce::int64 blockTimestamp, int numSamples)
+{
+    sentEdges.clearQuick();
+    sentWords.clearQuick();
+    bursts.clearQuick();
+
+    const int numLines = lines.size();
+
+    for (int c = 0; c < numLines; c++)
+    {
+        LineState& line = lines.getReference (c);
+        line.sentInBlock = 0;
+        line.burstIndex = -1;
+    }
+
+    for (int i = 0; i < numEdges; i++)
+    {
+        const TTLEdge& edge = edges[i];
+
+        if (edge.channel >= numLines)
+            continue;
+
+        LineState& line = lines.getReference (edge.channel);
+        const ChannelSettings& s = settings.getReference (edge.channel);
+
+        // a state held back by the debounce that lasted past it is sent before the new edge
+        if (line.burstIndex < 0 && line.raw != line.sent && line.hasSent
+            && edge.timestamp >= line.lastSent + s.debounceSamples)
+            send (edge.channel, jmax (line.lastSent + s.debounceSamples, blockTimestamp), blockTimestamp);
+
+        line.raw = ((*static_cast<const uint64*> (edge.eventData) >> edge.channel) & 1) != 0;
+
+        if (line.burstIndex >= 0)
+        {
+            bursts.getReference (line.burstIndex).numEdges++;
+            line.lastCounted = edge.timestamp;
+            continue;
+        }
+
+        if (line.raw == line.sent)
+            continue;
+
+        if (s.debounceSamples > 0 && line.hasSent && edge.timestamp - line.lastSent < s.debounceSamples)
+            continue;
+
+        if (s.maxEdgesPerBlock > 0 && line.sentInBlock >= s.maxEdgesPerBlock)
+        {
+            TTLBurst burst;
+            burst.timestamp = edge.timestamp;
+            burst.sampleNum = edge.sampleNum;
+            burst.channel = edge.channel;
+            burst.numEdges = 1;
+
+            line.burstIndex = bursts.size();
+            line.lastCounted = edge.timestamp;
+            bursts.add (burst);
+            continue;
+        }
+
+        send (edge.channel, edge.timestamp, blockTimestamp);
+    }
+
+    // send the states that were held back, once their line has settled
+    const juce::int64 blockEnd = blockTimestamp + numSamples;
+
+    for (int c = 0; c < numLines; c++)
+    {
+        const LineState& line = lines.getReference (c);
+
+        if (line.raw == line.sent)
+            continue;
+
+        if (line.burstIndex >= 0)
+        {
+            send (c, line.lastCounted, blockTimestamp);
+        }
+        else
+        {
+            const juce::int64 release = line.lastSent + settings.getReference (c).debounceSamples;
+
+            if (release < blockEnd)
+                send (c, jmax (release, blockTimestamp), blockTimestamp);
+        }
+    }
+
+    // the words array no longer grows, so the edges can point into it
+    for (int i = 0; i < sentEdges.size(); i++)
+        sentEdges.getReference (i).eventData = sentWords.getRawDataPointer() + i;
+}
+
+void TTLCoalescer::send (int channel, juce::int64 timestamp, juce::int64 blockTimestamp)
+{
+    LineState& line = lines.getReference (channel);
+    line.sent = line.raw;
+    line.lastSent = timestamp;
+    line.hasSent = true;
+    line.sentInBlock++;
+
+    const uint64 bit = uint64 (1) << channel;
+    sentWord = line.sent ? (sentWord | bit) : (sentWord & ~bit);
+
+    TTLEdge edge;
+    edge.timestamp = timestamp;
+    edge.eventData = nullptr;
+    edge.sampleNum = int (timestamp - blockTimestamp);
+    edge.channel = static_cast<uint16> (channel);
+
+    sentEdges.add (edge);
+    sentWords.add (sentWord);
+}
+
+const TTLEdge* TTLCoalescer::getEdges() const
+{
+    return sentEdges.begin();
+}
+
+int TTLCoalescer::getNumEdges() const
+{
+    return sentEdges.size();
+}
+
+const TTLBurst* TTLCoalescer::getBursts() const
+{
+    return bursts.begin();
+}
+
+int TTLCoalescer::getNumBursts() const
+{
+    return bursts.size();
+}
@@ -0,0 +1,124 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __TTLCOALESCER_H_5C2D7E14__
+#define __TTLCOALESCER_H_5C2D7E14__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+#include "../Events/Events.h"
+
+/** A TTL line whose edges were thinned out during a block */
+struct TTLBurst
+{
+    juce::int64 timestamp;  // the first edge that was counted instead of sent
+    int sampleNum;
+    uint16 channel;
+    uint32 numEdges;        // edges counted in the block
+};
+
+/**
+    Thins out the TTL edges of a SourceNode subprocessor before they become events,
+    so bouncing lines or fast strobes don't flood the event buffers downstream.
+
+    Each line can be configured to:
+    - debounce: an edge that follows the last sent edge of the line by fewer than
+      debounceSamples is held back, and once that time has passed the line's state is
+      sent only if it still differs from the last sent one.
+    - count bursts: after maxEdgesPerBlock edges of the line in a block, its remaining
+      edges in the block are counted into a TTLBurst instead of being sent, and the
+      line's final state is sent at its last edge.
+
+    Edges that don't change the last sent state of their line are always dropped. The
+    TTL word of a sent edge holds the sent states of all lines.
+
+    Settings are changed while acquisition is stopped. process() is called once per
+    block from the processing thread.
+
+    @see SourceNode
+*/
+class PLUGIN_API TTLCoalescer
+{
+public:
+    struct ChannelSettings
+    {
+        int debounceSamples = 0;    // 0 disables debouncing
+        int maxEdgesPerBlock = 0;   // 0 sends every edge
+    };
+
+    TTLCoalescer();
+
+    void setNumChannels (int numChannels);
+    int getNumChannels() const;
+
+    void setChannelSettings (int channel, const ChannelSettings& settings);
+    ChannelSettings getChannelSettings (int channel) const;
+
+    /** True if any line is debounced or counts bursts */
+    bool isActive() const;
+
+    /** True if any line counts bursts */
+    bool countsBursts() const;
+
+    /** Sets all lines low and forgets their last edges. Called when acquisition starts. */
+    void reset();
+
+    /** Filters the edges of a block of numSamples samples starting at blockTimestamp.
+        The edges must be in time order, with eventData pointing to the raw TTL word. */
+    void process (const TTLEdge* edges, int numEdges, juce::int64 blockTimestamp, int numSamples);
+
+    /** Edges sent by the last process(). Their words are valid until the next call. */
+    const TTLEdge* getEdges() const;
+    int getNumEdges() const;
+
+    /** Bursts counted by the last process() */
+    const TTLBurst* getBursts() const;
+    int getNumBursts() const;
+
+private:
+    struct LineState
+    {
+        bool raw = false;           // state of the last edge received
+        bool sent = false;          // state of the last edge sent
+        juce::int64 lastSent = 0;   // timestamp of the last edge sent
+        bool hasSent = false;
+        int sentInBlock = 0;
+        int burstIndex = -1;        // index in bursts while the line is counting
+        juce::int64 lastCounted = 0;
+    };
+
+    void send (int channel, juce::int64 timestamp, juce::int64 blockTimestamp);
+
+    Array<ChannelSettings> settings;
+    Array<LineState> lines;
+    uint64 sentWord;
+
+    Array<TTLEdge> sentEdges;
+    Array<uint64> sentWords;
+    Array<TTLBurst> bursts;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TTLCoalescer);
+};
+
+#endif  // __TTLCOALESCER_H_5C2D7E14__
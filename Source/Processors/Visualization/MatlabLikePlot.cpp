@@ -284,7 +284,7 @@ void MatlabLikePlot::plotxy(XYline l)
 		l.removeMean();
 	}
 
-	drawComponent->plotxy(l);
+	drawComponent->plotxy(std::move(l));
 }
 
 
@@ -613,20 +613,18 @@ void AxesComponent::paint(Graphics &g)
 
 }
 /*************************************************************************/
-XYline::XYline(float x0_, float dx_, std::vector<float> y_, float gain_, juce::Colour color_) : gain(gain_), dx(dx_), x0(x0_), y(y_), color(color_)
+XYline::XYline(float x0_, float dx_, std::vector<float> y_, float gain_, juce::Colour color_) : gain(gain_), dx(dx_), x0(x0_), y(std::move(y_)), color(color_), cachedWidth(-1), cachedHeight(-1)
 {
 	// adjust gain
 	numpts = y.size();
-	for (int k=0;k<numpts;k++)
-	{
-		y[k] *= gain;
-	}
+	if (numpts > 0)
+		FloatVectorOperations::multiply(y.data(), gain, numpts);
 	xn = x0 + dx * (numpts-1);
 	verticalLine = false;
 	fixedDx = true;
 }
 
-XYline::XYline(float x0_, float ymin, float ymax, juce::Colour color_) : x0(x0_), color(color_) 
+XYline::XYline(float x0_, float ymin, float ymax, juce::Colour color_) : x0(x0_), color(color_), cachedWidth(-1), cachedHeight(-1)
 {
 	gain = 1.0;
 	y.clear();
@@ -662,16 +660,18 @@ void XYline::smooth(std::vector<float> smoothKernel)
 		smoothy[k] = response;
 	}
 	y = smoothy;
+	cachedWidth = -1;
 }
 
 void XYline::getYRange(float xmin, float xmax, double &lowestValue, double &highestValue)
 {
 	int startIndex = MIN(numpts,MAX(0, (xmin-x0)/dx));
 	int endIndex = MIN(numpts,MAX(0, (xmax-x0)/dx));
-	for (int k=startIndex;k<endIndex;k++)
+	if (endIndex > startIndex)
 	{
-		lowestValue = MIN(lowestValue,y[k]);
-		highestValue =MAX(highestValue,y[k]);
+		const Range<float> r = FloatVectorOperations::findMinAndMax(&y[startIndex], endIndex - startIndex);
+		lowestValue = MIN(lowestValue,r.getStart());
+		highestValue =MAX(highestValue,r.getEnd());
 	}
 }
 
@@ -691,6 +691,7 @@ void XYline::removeMean()
 	{
 		y[k] = (y[k]-mean)*gain;
 	}	
+	cachedWidth = -1;
 }
 
 
@@ -1002,86 +1003,130 @@ void XYline::draw(Graphics &g, float xmin, float xmax, float ymin, float ymax, i
 		g.drawLine(drawX, plotHeight-y0, drawX,  plotHeight-y1);
 		return;
 	}
-	// function is given in [x,y], where dx is fixed and known.
-	// use bilinear interpolation.
-	float xrange = xmax-xmin;
-	int screenQuantization ;
-	if (xrange  < 100 * 1e-3)  // if we are looking at a region that is smaller than 50 ms, try to get better visualization...
+
+	// repaints that don't change the range or the data (e.g. mouse moves) reuse the last path
+	if (plotWidth != cachedWidth || plotHeight != cachedHeight
+		|| xmin != cachedXmin || xmax != cachedXmax || ymin != cachedYmin || ymax != cachedYmax)
 	{
-		// usually, at this resolution, you see high frequency components. 
-		// if you subsample, you will no display things correctly...
-		screenQuantization = 1; 
-	} else 
+		updatePath(xmin, xmax, ymin, ymax, plotWidth, plotHeight);
+	}
+
+	g.strokePath(cachedPath, PathStrokeType(1.0f));
+
+	if (showBounds && boundsX.size() > 1)
 	{
-		screenQuantization = 5; // draw every 5 pixels
+		// now plot upper & lower bounds.
+		float dash_length[2] = {3,3};
+		for (int i=0;i<boundsX.size()-1;i++)
+		{
+			juce::Line<float> upperboundLine(boundsX[i], boundsMax[i], boundsX[i+1], boundsMax[i+1]);
+			juce::Line<float> lowerboundLine(boundsX[i], boundsMin[i], boundsX[i+1], boundsMin[i+1]);
+			g.drawDashedLine(upperboundLine,dash_length,2,1);
+			g.drawDashedLine(lowerboundLine,dash_length,2,1);
+		}
 	}
-	int numPointsToDraw = plotWidth / screenQuantization;
 
-	float scalex = plotWidth / (numPointsToDraw-1);
+}
+
+void XYline::updatePath(float xmin, float xmax, float ymin, float ymax, int plotWidth, int plotHeight)
+{
+	cachedXmin = xmin;
+	cachedXmax = xmax;
+	cachedYmin = ymin;
+	cachedYmax = ymax;
+	cachedWidth = plotWidth;
+	cachedHeight = plotHeight;
 
-	// bilinear interpolation
-	bool prevInrange;
-	float prevY = interp(xmin,prevInrange);
-	float prevYscaled = (prevY - ymin) / (ymax-ymin) * plotHeight;
+	cachedPath.clear();
+	boundsX.clear();
+	boundsMin.clear();
+	boundsMax.clear();
 
-	std::vector<int> screenx, bins; // used to draw upper & lower limits of the signal..
-	std::vector<float> min_in_bin, max_in_bin; // used to draw upper & lower limits of the signal..
-	if (prevInrange) {
-		screenx.push_back(0);
-		bins.push_back( (xmin-x0)/dx);
-	}
-	bool inrange;
+	if (numpts == 0 || plotWidth <= 0)
+		return;
 
+	const float xrange = xmax-xmin;
+	const float scaleY = plotHeight / (ymax-ymin);
+	const float samplesPerPixel = xrange / dx / plotWidth;
 
-	for (int i=1;i<numPointsToDraw;i++)
+	if (samplesPerPixel <= 1.0f)
 	{
-		float x_sample = xmin + i * xrange/ (numPointsToDraw-1);
-		float currY = interp(x_sample, inrange);
-		float yScaled = (currY - ymin) / (ymax-ymin) * plotHeight;
-		if (inrange && prevInrange) 
+		// fewer samples than pixels: connect the visible samples
+		const int first = jmax(0, int(std::floor((xmin-x0)/dx)));
+		const int last = jmin(numpts-1, int(std::ceil((xmax-x0)/dx)));
+
+		for (int k=first;k<=last;k++)
 		{
-			g.drawLine((i-1)*scalex, plotHeight-prevYscaled, (i)*scalex, plotHeight-yScaled);
-			screenx.push_back(i*scalex);
-			bins.push_back( (x_sample-x0)/dx);
+			const float screenX = (x0 + k*dx - xmin) / xrange * plotWidth;
+			const float screenY = plotHeight - (y[k]-ymin) * scaleY;
+
+			if (k == first)
+				cachedPath.startNewSubPath(screenX, screenY);
+			else
+				cachedPath.lineTo(screenX, screenY);
 		}
-		prevYscaled = yScaled;
-		prevInrange = inrange;
+
+		return;
 	}
 
-	if (showBounds && screenQuantization > 1)
+	// more samples than pixels: the min and max of each column, so no peak is skipped
+	const int boundsQuantization = 5; // bounds are drawn every 5 pixels
+	float boundMin = 0, boundMax = 0;
+	bool newBound = true;
+	bool inPath = false;
+	float lastY = 0;
+
+	cachedPath.preallocateSpace(plotWidth * 6);
+
+	for (int column=0;column<plotWidth;column++)
 	{
-		// now, we have screen coordinates and corresponding bins.
-		// compute minimum and maximum in between each bins...
-		for (int i=0;i<screenx.size()-1;i++)
+		const int start = jmax(0, int((xmin + column * xrange / plotWidth - x0) / dx));
+		const int end = jmin(numpts, jmax(start + 1, int((xmin + (column+1) * xrange / plotWidth - x0) / dx)));
+
+		if (start >= end)
 		{
-			double minV = 1e10;
-			double maxV = -1e10;
-			for (int k=bins[i];k<=bins[i+1];k++)
-			{
-				minV = MIN(y[k],minV);
-				maxV = MAX(y[k],maxV);
-			}
-			min_in_bin.push_back(minV);
-			max_in_bin.push_back(maxV);
+			inPath = false;
+			continue;
 		}
-		// now plot upper & lower bounds.
-	//	g.setColour(juce::Colours::white);
-		float dash_length[2] = {3,3};
-		for (int i=0;i<max_in_bin.size()-1;i++)
-		{
-			double upperBoundLeft = (max_in_bin[i]-ymin)/(ymax-ymin)*plotHeight;
-			double upperBoundRight = (max_in_bin[i+1]-ymin)/(ymax-ymin)*plotHeight;
 
-			double lowerBoundLeft = (min_in_bin[i]-ymin)/(ymax-ymin)*plotHeight;
-			double lowerBoundRight = (min_in_bin[i+1]-ymin)/(ymax-ymin)*plotHeight;
-			juce::Line<float> upperboundLine(screenx[i], plotHeight-upperBoundLeft, screenx[i+1], plotHeight-upperBoundRight);
-			juce::Line<float> lowerboundLine(screenx[i], plotHeight-lowerBoundLeft, screenx[i+1], plotHeight-lowerBoundRight);
-			g.drawDashedLine(upperboundLine,dash_length,2,1);
-			g.drawDashedLine(lowerboundLine,dash_length,2,1);
+		const Range<float> r = FloatVectorOperations::findMinAndMax(&y[start], end - start);
+		const float top = plotHeight - (r.getEnd()-ymin) * scaleY;
+		const float bottom = plotHeight - (r.getStart()-ymin) * scaleY;
+		const float screenX = column + 0.5f;
+
+		// visit the nearer extreme first, so consecutive columns join without crossing
+		const bool topFirst = std::abs(lastY - top) < std::abs(lastY - bottom);
+		const float firstY = topFirst ? top : bottom;
+		lastY = topFirst ? bottom : top;
 
+		if (inPath)
+			cachedPath.lineTo(screenX, firstY);
+		else
+			cachedPath.startNewSubPath(screenX, firstY);
+
+		cachedPath.lineTo(screenX, lastY);
+		inPath = true;
+
+		if (newBound)
+		{
+			boundMin = r.getStart();
+			boundMax = r.getEnd();
+			newBound = false;
+		}
+		else
+		{
+			boundMin = MIN(boundMin, r.getStart());
+			boundMax = MAX(boundMax, r.getEnd());
 		}
-	}
 
+		if (column % boundsQuantization == boundsQuantization - 1 || column == plotWidth - 1)
+		{
+			boundsX.push_back(screenX);
+			boundsMin.push_back(plotHeight - (boundMin-ymin) * scaleY);
+			boundsMax.push_back(plotHeight - (boundMax-ymin) * scaleY);
+			newBound = true;
+		}
+	}
 }
 
 /*************************************************************************/
@@ -1162,7 +1207,7 @@ void DrawComponent::plotxy(XYline l)
 {
 	l.getYRange(xmin,xmax,lowestValue, highestValue);
 	if (std::abs(lowestValue) < 1e10 && std::abs(highestValue) < 1e10)
-		lines.push_back(l);
+		lines.push_back(std::move(l));
 }
 	
 void DrawComponent::clearplot()
@@ -64,12 +64,23 @@ private:
 	float interp_bilinear(float x_sample, bool &inrange);
 
 	float interp_cubic(float x_sample, bool &inrange);
+
+	/** Rebuilds cachedPath for a new range or plot size: one min/max pair per pixel column
+		when there are more samples than columns, or the samples themselves otherwise */
+	void updatePath(float xmin, float xmax, float ymin, float ymax, int width, int height);
+
 	bool sortedX, fixedDx,  verticalLine;
 	float gain,dx, x0,xn,mean;
 	int numpts;
 	std::vector<float> x;
 	std::vector<float> y;
 	juce::Colour color;
+
+	// geometry of the last draw() call, reused while the range, size and data stay the same
+	Path cachedPath;
+	std::vector<float> boundsX, boundsMin, boundsMax;
+	float cachedXmin, cachedXmax, cachedYmin, cachedYmax;
+	int cachedWidth, cachedHeight;
 };
 
 enum DrawComponentMode {ZOOM = 1, PAN = 2, VERTICAL_SHIFT = 3, THRES_UPDATE = 4};
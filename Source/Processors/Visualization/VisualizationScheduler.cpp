@@ -0,0 +1,169 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "VisualizationScheduler.h"
+#include "Visualizer.h"
+#include "../../AccessClass.h"
+#include "../../Audio/AudioComponent.h"
+#include "../../Utils/MessageThreadMonitor.h"
+#include "../../Utils/PipelineTrace.h"
+
+/* Fastest refresh rate of any visualizer */
+#define TICK_INTERVAL_MS 10
+
+/* Share of the message thread that all refresh() calls may use together */
+#define FRAME_BUDGET 0.4
+
+/* Audio callback CPU load above which visualizers slow down */
+#define AUDIO_CPU_LIMIT 0.7
+
+/* Refresh intervals are stretched at most this much */
+#define MAX_THROTTLE 5.0f
+
+VisualizationScheduler* VisualizationScheduler::getInstance()
+{
+	static VisualizationScheduler scheduler;
+	return &scheduler;
+}
+
+VisualizationScheduler::VisualizationScheduler() :
+	lastTickMs(0),
+	averageLoad(0),
+	throttle(1.0f)
+{
+}
+
+VisualizationScheduler::~VisualizationScheduler()
+{
+	stopTimer();
+}
+
+int VisualizationScheduler::indexOf(Visualizer* visualizer) const
+{
+	for (int i = 0; i < visualizers.size(); i++)
+	{
+		if (visualizers.getReference(i).visualizer == visualizer)
+			return i;
+	}
+
+	return -1;
+}
+
+void VisualizationScheduler::addVisualizer(Visualizer* visualizer)
+{
+	if (indexOf(visualizer) >= 0)
+		return;
+
+	ScheduledVisualizer scheduled;
+	scheduled.visualizer = visualizer;
+	scheduled.nextRefreshMs = Time::getMillisecondCounterHiRes();
+
+	visualizers.add(scheduled);
+
+	if (!isTimerRunning())
+	{
+		lastTickMs = Time::getMillisecondCounterHiRes();
+		startTimer(TICK_INTERVAL_MS);
+	}
+}
+
+void VisualizationScheduler::removeVisualizer(Visualizer* visualizer)
+{
+	const int index = indexOf(visualizer);
+
+	if (index >= 0)
+		visualizers.remove(index);
+
+	if (visualizers.size() == 0)
+	{
+		stopTimer();
+		averageLoad = 0;
+		throttle = 1.0f;
+	}
+}
+
+float VisualizationScheduler::getThrottle() const
+{
+	return throttle;
+}
+
+void VisualizationScheduler::timerCallback()
+{
+	const double tickStartMs = Time::getMillisecondCounterHiRes();
+	double refreshMs = 0;
+
+	// refresh() may start or stop other visualizers, so the list is checked again after each call
+	for (int i = 0; i < visualizers.size(); i++)
+	{
+		ScheduledVisualizer& scheduled = visualizers.getReference(i);
+
+		if (tickStartMs < scheduled.nextRefreshMs)
+			continue;
+
+		Visualizer* visualizer = scheduled.visualizer;
+		const double intervalMs = 1000.0 / jmax(1.0f, visualizer->refreshRate);
+
+		// keep the phase, unless the visualizer fell more than one interval behind
+		scheduled.nextRefreshMs = jmax(scheduled.nextRefreshMs + intervalMs * throttle, tickStartMs);
+
+		// nothing on screen to update; the visualizer catches up when it is seen again
+		if (!visualizer->updateOnScreen())
+			continue;
+
+		const double startMs = Time::getMillisecondCounterHiRes();
+
+		{
+			const String taskName = visualizer->getName().isNotEmpty()
+				? visualizer->getName() + " refresh" : String("Visualizer refresh");
+			MessageThreadMonitor::ScopedTask task(taskName);
+			TRACE_SCOPE("visualizer", taskName);
+			visualizer->refresh();
+		}
+
+		refreshMs += Time::getMillisecondCounterHiRes() - startMs;
+
+		if (i >= visualizers.size() || visualizers.getReference(i).visualizer != visualizer)
+			i = indexOf(visualizer);
+	}
+
+	updateThrottle(refreshMs, tickStartMs - lastTickMs);
+	lastTickMs = tickStartMs;
+}
+
+void VisualizationScheduler::updateThrottle(double refreshMs, double elapsedMs)
+{
+	if (elapsedMs <= 0)
+		return;
+
+	averageLoad = 0.9 * averageLoad + 0.1 * jmin(1.0, refreshMs / elapsedMs);
+
+	double audioLoad = 0;
+
+	if (AudioComponent* audio = AccessClass::getAudioComponent())
+		audioLoad = audio->deviceManager.getCpuUsage();
+
+	if (averageLoad > FRAME_BUDGET || audioLoad > AUDIO_CPU_LIMIT)
+		throttle = jmin(MAX_THROTTLE, throttle * 1.05f);
+	else if (averageLoad < FRAME_BUDGET / 2 && audioLoad < AUDIO_CPU_LIMIT * 0.8)
+		throttle = jmax(1.0f, throttle / 1.05f);
+}
@@ -0,0 +1,83 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2021 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __VISUALIZATIONSCHEDULER_H_7C2E91A4__
+#define __VISUALIZATIONSCHEDULER_H_7C2E91A4__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+
+class Visualizer;
+
+/**
+	Drives the refresh() callbacks of all running Visualizers from a single timer.
+
+	Each visualizer is refreshed at its own refreshRate, but only while it is showing,
+	so canvases in hidden tabs or closed, minimized or covered windows cost nothing. The time spent in
+	refresh() is measured against a frame budget shared by all canvases; when they
+	exceed it together, or when the audio callback leaves little CPU headroom, every
+	refresh interval is stretched until the load drops again.
+
+	@see Visualizer::startCallbacks
+*/
+class PLUGIN_API VisualizationScheduler : private Timer
+{
+public:
+	static VisualizationScheduler* getInstance();
+
+	/** Starts refreshing a visualizer. Called by Visualizer::startCallbacks(). */
+	void addVisualizer(Visualizer* visualizer);
+
+	/** Stops refreshing a visualizer. Called by Visualizer::stopCallbacks(). */
+	void removeVisualizer(Visualizer* visualizer);
+
+	/** Factor by which all refresh intervals are currently stretched, 1 at full rate */
+	float getThrottle() const;
+
+private:
+	VisualizationScheduler();
+	~VisualizationScheduler();
+
+	void timerCallback() override;
+
+	/** Adjusts the throttle to the share of the last tick spent refreshing, and the audio CPU load */
+	void updateThrottle(double refreshMs, double elapsedMs);
+
+	struct ScheduledVisualizer
+	{
+		Visualizer* visualizer;
+		double nextRefreshMs;
+	};
+
+	int indexOf(Visualizer* visualizer) const;
+
+	Array<ScheduledVisualizer> visualizers;
+
+	double lastTickMs;
+	double averageLoad;
+	float throttle;
+
+	JUCE_DECLARE_NON_COPYABLE(VisualizationScheduler);
+};
+
+#endif  // __VISUALIZATIONSCHEDULER_H_7C2E91A4__
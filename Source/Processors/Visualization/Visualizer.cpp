@@ -22,22 +22,27 @@
 */
 
 #include "Visualizer.h"
+#include "VisualizationScheduler.h"
 
-Visualizer::Visualizer()
+Visualizer::Visualizer() : onScreen(false)
 {
 	refreshRate = 50;    // 50 Hz default refresh rate
 }
 
-Visualizer::~Visualizer() {}
+Visualizer::~Visualizer()
+{
+	VisualizationScheduler::getInstance()->removeVisualizer(this);
+}
 
 void Visualizer::startCallbacks()
 {
-	startTimer(1/float(refreshRate)*1000.0f);
+	onScreen = isOnScreen();
+	VisualizationScheduler::getInstance()->addVisualizer(this);
 }
 
 void Visualizer::stopCallbacks()
 {
-	stopTimer();
+	VisualizationScheduler::getInstance()->removeVisualizer(this);
 }
 
 void Visualizer::timerCallback()
@@ -45,6 +50,44 @@ void Visualizer::timerCallback()
 	refresh();
 }
 
+bool Visualizer::isOnScreen() const
+{
+	// hidden tabs, closed windows and minimized windows
+	if (!isShowing())
+		return false;
+
+	const Component* window = getTopLevelComponent();
+	const Rectangle<int> area = getScreenBounds();
+	Desktop& desktop = Desktop::getInstance();
+
+	// desktop windows are kept in the order they were brought to front, so those after
+	// this one's window cover it
+	for (int i = desktop.getNumComponents(); --i >= 0;)
+	{
+		const Component* other = desktop.getComponent(i);
+
+		if (other == window)
+			break;
+
+		if (other->isShowing() && other->isOpaque() && other->getScreenBounds().contains(area))
+			return false;
+	}
+
+	return true;
+}
+
+bool Visualizer::updateOnScreen()
+{
+	const bool nowOnScreen = isOnScreen();
+
+	if (nowOnScreen && !onScreen)
+		refreshState();
+
+	onScreen = nowOnScreen;
+
+	return onScreen;
+}
+
 void Visualizer::saveVisualizerParameters(XmlElement* xml) { }
 
 void Visualizer::loadVisualizerParameters(XmlElement* xml) { }
\ No newline at end of file
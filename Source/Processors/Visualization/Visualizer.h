@@ -43,7 +43,8 @@ public:
 	Visualizer();
 	~Visualizer();
 
-    /** Called when the component's tab becomes visible again.*/
+    /** Called when the component's tab becomes visible again, or its window is
+        uncovered or restored, to catch up with the data it didn't draw meanwhile.*/
     virtual void refreshState() = 0;
 
     /** Called when parameters of underlying data processor are changed.*/
@@ -64,16 +65,25 @@ public:
     /** Called by an editor to initiate a parameter change.*/
     virtual void setParameter(int, int, int, float) = 0;
 
-    /** Starts the timer callbacks. */
+    /** Starts calling refresh() from the VisualizationScheduler, at up to refreshRate
+        while the visualizer is showing. */
 	void startCallbacks();
 
-    /** Stops the timer callbacks. */
+    /** Stops the refresh() callbacks. */
 	void stopCallbacks();
 
     /** Called whenever the timer is triggered. */
 	void timerCallback();
 
-    /** Refresh rate in Hz. */
+    /** Returns true if the visualizer can be seen: it is showing, in the selected tab or a
+        window that isn't minimized, and no window in front of it covers it entirely. */
+	bool isOnScreen() const;
+
+    /** Called by the VisualizationScheduler before each refresh. Calls refreshState()
+        when the visualizer comes back on screen, and returns whether it is on screen. */
+	bool updateOnScreen();
+
+    /** Refresh rate in Hz, lowered by the VisualizationScheduler when the GUI or the audio thread is busy. */
     float refreshRate;
 
 
@@ -83,6 +93,9 @@ public:
     /** Loads parameters from XML */
 	virtual void loadVisualizerParameters(XmlElement* xml);
 
+private:
+	bool onScreen;
+
 };
 
 
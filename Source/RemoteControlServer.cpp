@@ -0,0 +1,203 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RemoteControlServer.h"
+#include "CoreServices.h"
+#include "Utils/Utils.h"
+
+RemoteControlServer::RemoteControlServer(int port_)
+    : Thread("Remote Control"), port(port_)
+{
+}
+
+RemoteControlServer::~RemoteControlServer()
+{
+    stop();
+}
+
+bool RemoteControlServer::start()
+{
+    if (!listener.createListener(port))
+    {
+        LOGD("Remote control: unable to listen on port ", port);
+        return false;
+    }
+
+    LOGD("Remote control: listening on port ", port);
+    startThread();
+    return true;
+}
+
+void RemoteControlServer::stop()
+{
+    signalThreadShouldExit();
+    listener.close();
+
+    {
+        const ScopedLock sl(connectionLock);
+        if (connection != nullptr)
+            connection->close();
+    }
+
+    stopThread(2000);
+}
+
+int RemoteControlServer::getPort() const
+{
+    return port;
+}
+
+void RemoteControlServer::run()
+{
+    while (!threadShouldExit())
+    {
+        StreamingSocket* client = listener.waitForNextConnection();
+
+        if (client == nullptr)
+        {
+            if (!listener.isConnected())
+                break;
+            continue;
+        }
+
+        {
+            const ScopedLock sl(connectionLock);
+            connection = client;
+        }
+
+        handleConnection(client);
+
+        const ScopedLock sl(connectionLock);
+        connection = nullptr;
+    }
+}
+
+void RemoteControlServer::handleConnection(StreamingSocket* client)
+{
+    String pending;
+    char buffer[512];
+
+    while (!threadShouldExit())
+    {
+        int ready = client->waitUntilReady(true, 100);
+
+        if (ready < 0)
+            break;
+        if (ready == 0)
+            continue;
+
+        int numRead = client->read(buffer, sizeof(buffer), false);
+
+        if (numRead <= 0)
+            break;
+
+        pending += String::fromUTF8(buffer, numRead);
+
+        int lineEnd;
+        while ((lineEnd = pending.indexOfChar('\n')) >= 0)
+        {
+            String command = pending.substring(0, lineEnd).trim();
+            pending = pending.substring(lineEnd + 1);
+
+            if (command.isEmpty())
+                continue;
+
+            String reply = executeCommand(command) + "\n";
+            client->write(reply.toRawUTF8(), (int) reply.getNumBytesAsUTF8());
+        }
+    }
+}
+
+String RemoteControlServer::executeCommand(const String& command)
+{
+    CommandRequest request;
+    request.command = command;
+
+    MessageManager::getInstance()->callFunctionOnMessageThread(executeOnMessageThread, &request);
+
+    return request.reply;
+}
+
+void* RemoteControlServer::executeOnMessageThread(void* userData)
+{
+    CommandRequest* request = static_cast<CommandRequest*>(userData);
+
+    String name = request->command.upToFirstOccurrenceOf(" ", false, false);
+    String argument = request->command.fromFirstOccurrenceOf(" ", false, false).trim();
+
+    if (name.equalsIgnoreCase("StartAcquisition"))
+    {
+        CoreServices::setAcquisitionStatus(true);
+        request->reply = "OK";
+    }
+    else if (name.equalsIgnoreCase("StopAcquisition"))
+    {
+        CoreServices::setAcquisitionStatus(false);
+        request->reply = "OK";
+    }
+    else if (name.equalsIgnoreCase("StartRecord"))
+    {
+        CoreServices::setRecordingStatus(true);
+        request->reply = "OK";
+    }
+    else if (name.equalsIgnoreCase("StopRecord"))
+    {
+        CoreServices::setRecordingStatus(false);
+        request->reply = "OK";
+    }
+    else if (name.equalsIgnoreCase("IsAcquiring"))
+    {
+        request->reply = CoreServices::getAcquisitionStatus() ? "1" : "0";
+    }
+    else if (name.equalsIgnoreCase("IsRecording"))
+    {
+        request->reply = CoreServices::getRecordingStatus() ? "1" : "0";
+    }
+    else if (name.equalsIgnoreCase("GetRecordingPath"))
+    {
+        request->reply = CoreServices::RecordNode::getRecordingPath().getFullPathName();
+    }
+    else if (name.equalsIgnoreCase("SetRecordingDirectory"))
+    {
+        if (CoreServices::getRecordingStatus())
+        {
+            request->reply = "ERROR recording in progress";
+        }
+        else
+        {
+            CoreServices::setRecordingDirectory(argument);
+            request->reply = "OK";
+        }
+    }
+    else if (name.equalsIgnoreCase("Quit"))
+    {
+        JUCEApplication::getInstance()->systemRequestedQuit();
+        request->reply = "OK";
+    }
+    else
+    {
+        request->reply = "ERROR unknown command " + name;
+    }
+
+    return nullptr;
+}
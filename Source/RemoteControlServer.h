@@ -0,0 +1,88 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2019 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef REMOTECONTROLSERVER_H_INCLUDED
+#define REMOTECONTROLSERVER_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#define DEFAULT_REMOTE_CONTROL_PORT 5600
+
+/**
+
+  Accepts text commands on a TCP port, so a GUI running headless can be driven
+  from another process.
+
+  Each command is a single line, and gets a single line reply:
+
+    StartAcquisition, StopAcquisition, StartRecord, StopRecord,
+    IsAcquiring, IsRecording, GetRecordingPath, SetRecordingDirectory <path>, Quit
+
+  Commands are executed on the message thread, as if the matching control
+  panel buttons had been pressed.
+
+  @see MainWindow, CoreServices
+
+*/
+
+class RemoteControlServer : public Thread
+{
+public:
+    RemoteControlServer(int port = DEFAULT_REMOTE_CONTROL_PORT);
+    ~RemoteControlServer();
+
+    /** Starts listening. Returns false if the port could not be bound. */
+    bool start();
+
+    /** Closes the listening socket and any open connection, and stops the thread. */
+    void stop();
+
+    int getPort() const;
+
+    void run() override;
+
+private:
+    struct CommandRequest
+    {
+        String command;
+        String reply;
+    };
+
+    /** Reads commands from a connection until it is closed */
+    void handleConnection(StreamingSocket* connection);
+
+    /** Runs a command on the message thread and returns its reply */
+    String executeCommand(const String& command);
+
+    static void* executeOnMessageThread(void* userData);
+
+    const int port;
+
+    StreamingSocket listener;
+    ScopedPointer<StreamingSocket> connection;
+    CriticalSection connectionLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RemoteControlServer)
+};
+
+#endif  // REMOTECONTROLSERVER_H_INCLUDED
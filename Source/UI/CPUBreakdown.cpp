@@ -0,0 +1,468 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CPUBreakdown.h"
+#include "../Processors/ProcessorGraph/ProcessorGraph.h"
+#include "../Processors/GenericProcessor/GenericProcessor.h"
+#include "../AccessClass.h"
+#include "../Utils/PipelineTrace.h"
+
+/* Processors listed in the breakdown, busiest first */
+#define CPU_BREAKDOWN_MAX_ROWS 12
+
+#define CPU_BREAKDOWN_WIDTH 560
+#define CPU_BREAKDOWN_ROW_HEIGHT 16
+#define CPU_BREAKDOWN_GRAPH_HEIGHT 90
+#define CPU_BREAKDOWN_BACKTRACE_HEIGHT 120
+
+
+CPUHistory::CPUHistory() :
+    sessionStartMs(Time::getMillisecondCounterHiRes()),
+    stride(1),
+    skipped(0)
+{
+}
+
+void CPUHistory::add(Point point)
+{
+    if (++skipped < stride)
+        return;
+
+    skipped = 0;
+
+    point.seconds = (Time::getMillisecondCounterHiRes() - sessionStartMs) / 1000.0;
+    points.add(point);
+
+    if (points.size() >= CPU_HISTORY_MAX_POINTS)
+    {
+        for (int i = 1; i < points.size() / 2; i++)
+            points.set(i, points[2 * i]);
+
+        points.removeRange(points.size() / 2, points.size());
+        stride *= 2;
+    }
+}
+
+const Array<CPUHistory::Point>& CPUHistory::getPoints() const
+{
+    return points;
+}
+
+
+CPUBreakdown::CPUBreakdown(ProcessorGraph* graph_, AudioComponent* audio_, const CPUHistory& history_) :
+    graph(graph_),
+    audio(audio_),
+    history(history_),
+    font("Small Text", 12, Font::plain)
+{
+    exportButton = new TextButton("Export CSV");
+    exportButton->addListener(this);
+    addAndMakeVisible(exportButton);
+
+    traceButton = new ToggleButton("Trace the pipeline");
+    traceButton->setColour(ToggleButton::textColourId, Colours::lightgrey);
+    traceButton->setToggleState(PipelineTrace::isEnabled(), dontSendNotification);
+    traceButton->addListener(this);
+    addAndMakeVisible(traceButton);
+
+    exportTraceButton = new TextButton("Export trace");
+    exportTraceButton->addListener(this);
+    addAndMakeVisible(exportTraceButton);
+
+    allocationButton = new ToggleButton("Detect allocations");
+    allocationButton->setColour(ToggleButton::textColourId, Colours::lightgrey);
+    allocationButton->setToggleState(AllocationCounter::isEnabled(), dontSendNotification);
+    allocationButton->addListener(this);
+    addAndMakeVisible(allocationButton);
+
+    backtraceButton = new ToggleButton("Sample call stacks");
+    backtraceButton->setColour(ToggleButton::textColourId, Colours::lightgrey);
+    backtraceButton->setToggleState(AllocationCounter::isBacktraceSampling(), dontSendNotification);
+    backtraceButton->setEnabled(AllocationCounter::isEnabled());
+    backtraceButton->addListener(this);
+    addAndMakeVisible(backtraceButton);
+
+    backtraceView = new TextEditor("Call stacks");
+    backtraceView->setMultiLine(true);
+    backtraceView->setReadOnly(true);
+    backtraceView->setScrollbarsShown(true);
+    backtraceView->setFont(Font(Font::getDefaultMonospacedFontName(), 11, Font::plain));
+    addAndMakeVisible(backtraceView);
+
+    updateStats();
+
+    const int numRows = jmin(CPU_BREAKDOWN_MAX_ROWS, jmax(1, graph->getListOfProcessors().size()));
+
+    setSize(CPU_BREAKDOWN_WIDTH,
+            CPU_BREAKDOWN_ROW_HEIGHT * (numRows + 8) + 2 * (CPU_BREAKDOWN_GRAPH_HEIGHT + 10)
+            + CPU_BREAKDOWN_BACKTRACE_HEIGHT + 78);
+
+    startTimer(500);
+}
+
+CPUBreakdown::~CPUBreakdown()
+{
+}
+
+void CPUBreakdown::updateStats()
+{
+    rows.clear();
+
+    for (auto processor : graph->getListOfProcessors())
+    {
+        ProcessorRow row;
+        row.name = processor->getName() + " (" + String(processor->getNodeId()) + ")";
+        row.stats = processor->getProcessTimeProfile().getStats();
+
+        if (row.stats.maxAllocations > 0)
+            row.backtrace = processor->getProcessTimeProfile().getAllocationTally().getBacktrace();
+
+        // busiest first
+        int index = 0;
+        while (index < rows.size() && rows.getReference(index).stats.budgetPercent >= row.stats.budgetPercent)
+            index++;
+
+        rows.insert(index, row);
+    }
+
+    callbackStats = audio->getCallbackStats();
+
+    updateBacktraces();
+}
+
+void CPUBreakdown::updateBacktraces()
+{
+    String text;
+
+    if (!AllocationCounter::isEnabled())
+        text = "Allocation detection is off";
+    else if (!AllocationCounter::isBacktraceSampling())
+        text = "Call stacks are not sampled";
+
+    for (auto& row : rows)
+    {
+        if (row.backtrace.isNotEmpty())
+            text << row.name << ":\n" << row.backtrace << "\n";
+    }
+
+    if (text.isEmpty())
+        text = "No allocations in the last blocks";
+
+    // keeps the scroll position while the stacks stay the same
+    if (text != backtraceView->getText())
+        backtraceView->setText(text, false);
+}
+
+void CPUBreakdown::timerCallback()
+{
+    updateStats();
+    repaint();
+}
+
+void CPUBreakdown::resized()
+{
+    exportButton->setBounds(getWidth() - 110, getHeight() - 30, 100, 22);
+    exportTraceButton->setBounds(getWidth() - 110, getHeight() - 58, 100, 22);
+    traceButton->setBounds(10, getHeight() - 30, 150, 22);
+    allocationButton->setBounds(10, getHeight() - 58, 150, 22);
+    backtraceButton->setBounds(165, getHeight() - 58, 150, 22);
+    backtraceView->setBounds(10, getHeight() - 68 - CPU_BREAKDOWN_BACKTRACE_HEIGHT,
+                             getWidth() - 20, CPU_BREAKDOWN_BACKTRACE_HEIGHT);
+}
+
+void CPUBreakdown::paint(Graphics& g)
+{
+    g.setFont(font);
+
+    const int h = CPU_BREAKDOWN_ROW_HEIGHT;
+    const int columns[] = { 10, 230, 290, 350, 410, 480 };
+    int y = 4;
+
+    g.setColour(Colours::white);
+    g.drawText("Processor", columns[0], y, 220, h, Justification::left);
+    g.drawText("mean us", columns[1], y, 60, h, Justification::left);
+    g.drawText("p99 us", columns[2], y, 60, h, Justification::left);
+    g.drawText("max us", columns[3], y, 60, h, Justification::left);
+    g.drawText("% of block", columns[4], y, 70, h, Justification::left);
+    g.drawText("allocs", columns[5], y, 70, h, Justification::left);
+    y += h;
+
+    g.setColour(Colours::lightgrey);
+
+    if (rows.size() == 0)
+    {
+        g.drawText("No processors", columns[0], y, 240, h, Justification::left);
+        y += h;
+    }
+
+    for (int i = 0; i < jmin(CPU_BREAKDOWN_MAX_ROWS, rows.size()); i++)
+    {
+        const ProcessorRow& row = rows.getReference(i);
+
+        g.drawText(row.name, columns[0], y, 215, h, Justification::left, true);
+        g.drawText(String(row.stats.meanUs, 0), columns[1], y, 60, h, Justification::left);
+        g.drawText(String(row.stats.p99Us, 0), columns[2], y, 60, h, Justification::left);
+        g.drawText(String(row.stats.maxUs, 0), columns[3], y, 60, h, Justification::left);
+        g.drawText(String(row.stats.budgetPercent, 1), columns[4], y, 70, h, Justification::left);
+
+        if (!AllocationCounter::isEnabled())
+        {
+            g.drawText("-", columns[5], y, 70, h, Justification::left);
+        }
+        else
+        {
+            // mean per block, and the most in any one block
+            g.setColour(row.stats.maxAllocations > 0 ? Colours::orange : Colours::lightgrey);
+            g.drawText(String(row.stats.meanAllocations, 1) + " / " + String(row.stats.maxAllocations),
+                       columns[5], y, 70, h, Justification::left);
+            g.setColour(Colours::lightgrey);
+        }
+
+        y += h;
+    }
+
+    y += h / 2;
+
+    g.setColour(Colours::white);
+    g.drawText("Audio callbacks", columns[0], y, 240, h, Justification::left);
+    y += h;
+
+    g.setColour(Colours::lightgrey);
+
+    if (callbackStats.numCallbacks == 0)
+    {
+        g.drawText(audio->isOfflineMode() ? "Not timed in offline mode" : "Acquisition is stopped",
+                   columns[0], y, 400, h, Justification::left);
+        y += 3 * h;
+    }
+    else
+    {
+        const AudioComponent::CallbackStats& s = callbackStats;
+
+        g.drawText(String(s.numCallbacks) + " callbacks of " + String(s.blockUs, 0) + " us, every "
+                   + String(s.meanIntervalUs, 0) + " us on average, jitter " + String(s.jitterUs, 0) + " us",
+                   columns[0], y, getWidth() - 20, h, Justification::left);
+        y += h;
+        g.drawText("Scheduling delay: mean " + String(s.meanDelayUs, 0) + " us, max " + String(s.maxDelayUs, 0)
+                   + " us; processing: mean " + String(s.meanProcessUs, 0) + " us, max " + String(s.maxProcessUs, 0) + " us",
+                   columns[0], y, getWidth() - 20, h, Justification::left);
+        y += h;
+
+        g.setColour(s.overruns + s.xruns > 0 ? Colours::orange : Colours::lightgrey);
+        g.drawText(String(s.overruns) + " overruns (blocks processed slower than real time), "
+                   + String(s.xruns) + " xruns (callbacks more than half a block late)",
+                   columns[0], y, getWidth() - 20, h, Justification::left);
+        y += 2 * h;
+    }
+
+    drawHistory(g, Rectangle<int>(10, y, getWidth() - 20, CPU_BREAKDOWN_GRAPH_HEIGHT), true);
+    y += CPU_BREAKDOWN_GRAPH_HEIGHT + 10;
+    drawHistory(g, Rectangle<int>(10, y, getWidth() - 20, CPU_BREAKDOWN_GRAPH_HEIGHT), false);
+}
+
+void CPUBreakdown::drawHistory(Graphics& g, Rectangle<int> area, bool loadGraph) const
+{
+    const Array<CPUHistory::Point>& points = history.getPoints();
+
+    g.setColour(Colours::black);
+    g.fillRect(area);
+    g.setColour(Colours::grey);
+    g.drawRect(area, 1);
+
+    g.setColour(Colours::lightgrey);
+    g.drawText(loadGraph ? "CPU (yellow) and processors (orange), % of block"
+                         : "Callback jitter (blue) and delay (white), us; overruns and xruns in red",
+               area.reduced(4, 2), Justification::topLeft);
+
+    if (points.size() < 2)
+        return;
+
+    const double firstSecond = points.getFirst().seconds;
+    const double span = jmax(1.0, points.getLast().seconds - firstSecond);
+
+    float maxValue = 100.0f;
+
+    if (!loadGraph)
+    {
+        maxValue = 1.0f;
+        for (auto& point : points)
+            maxValue = jmax(maxValue, point.jitterUs, point.meanDelayUs);
+    }
+
+    auto xOf = [&](double seconds) { return area.getX() + float((seconds - firstSecond) / span) * area.getWidth(); };
+    auto yOf = [&](float value) { return area.getBottom() - jmin(1.0f, value / maxValue) * (area.getHeight() - 16); };
+
+    for (int trace = 0; trace < 2; trace++)
+    {
+        Path path;
+
+        for (int i = 0; i < points.size(); i++)
+        {
+            const CPUHistory::Point& point = points.getReference(i);
+            float value;
+
+            if (loadGraph)
+                value = trace == 0 ? point.cpu * 100.0f : point.processorLoad * 100.0f;
+            else
+                value = trace == 0 ? point.jitterUs : point.meanDelayUs;
+
+            if (i == 0)
+                path.startNewSubPath(xOf(point.seconds), yOf(value));
+            else
+                path.lineTo(xOf(point.seconds), yOf(value));
+        }
+
+        if (loadGraph)
+            g.setColour(trace == 0 ? Colours::yellow : Colours::orange);
+        else
+            g.setColour(trace == 0 ? Colours::lightblue : Colours::white);
+
+        g.strokePath(path, PathStrokeType(1.0f));
+    }
+
+    if (!loadGraph)
+    {
+        // the counters restart with each acquisition, so any change marks new overruns or xruns
+        g.setColour(Colours::red);
+
+        for (int i = 1; i < points.size(); i++)
+        {
+            const CPUHistory::Point& point = points.getReference(i);
+            const CPUHistory::Point& previous = points.getReference(i - 1);
+
+            if (point.overruns != previous.overruns || point.xruns != previous.xruns)
+                g.fillRect(xOf(point.seconds) - 0.5f, float(area.getBottom() - 6), 1.0f, 6.0f);
+        }
+    }
+
+    g.setColour(Colours::grey);
+    g.drawText(String(span, 0) + " s", area.reduced(4, 2), Justification::bottomRight);
+    g.drawText(String(maxValue, 0), area.reduced(4, 2).withTrimmedTop(12), Justification::topRight);
+}
+
+String CPUBreakdown::toCsv() const
+{
+    String csv;
+
+    csv << "processor,node_id,blocks,min_us,mean_us,p99_us,max_us,block_percent,events_per_block,"
+           "allocations_per_block,max_allocations\n";
+
+    for (auto processor : graph->getListOfProcessors())
+    {
+        ProcessTimeProfile::Stats s = processor->getProcessTimeProfile().getStats();
+
+        csv << processor->getName().replace(",", " ") << "," << processor->getNodeId() << ","
+            << s.numBlocks << "," << s.minUs << "," << s.meanUs << "," << s.p99Us << ","
+            << s.maxUs << "," << s.budgetPercent << "," << s.meanEvents << ","
+            << s.meanAllocations << "," << s.maxAllocations << "\n";
+    }
+
+    const AudioComponent::CallbackStats s = audio->getCallbackStats();
+
+    csv << "\ncallbacks,block_us,mean_interval_us,jitter_us,mean_delay_us,max_delay_us,"
+           "mean_process_us,max_process_us,overruns,xruns\n";
+    csv << s.numCallbacks << "," << s.blockUs << "," << s.meanIntervalUs << "," << s.jitterUs << ","
+        << s.meanDelayUs << "," << s.maxDelayUs << "," << s.meanProcessUs << "," << s.maxProcessUs << ","
+        << s.overruns << "," << s.xruns << "\n";
+
+    csv << "\nseconds,cpu_percent,processor_percent,jitter_us,mean_delay_us,overruns,xruns,ui_latency_ms\n";
+
+    for (auto& point : history.getPoints())
+    {
+        csv << String(point.seconds, 3) << "," << point.cpu * 100.0f << "," << point.processorLoad * 100.0f << ","
+            << point.jitterUs << "," << point.meanDelayUs << "," << point.overruns << "," << point.xruns << ","
+            << point.uiLatencyMs << "\n";
+    }
+
+    return csv;
+}
+
+void CPUBreakdown::buttonClicked(Button* button)
+{
+    if (button == allocationButton)
+    {
+        AllocationCounter::setEnabled(allocationButton->getToggleState());
+        backtraceButton->setEnabled(allocationButton->getToggleState());
+        updateStats();
+        repaint();
+        return;
+    }
+
+    if (button == backtraceButton)
+    {
+        AllocationCounter::setBacktraceSampling(backtraceButton->getToggleState());
+        updateBacktraces();
+        return;
+    }
+
+    if (button == traceButton)
+    {
+        PipelineTrace::setEnabled(traceButton->getToggleState());
+        return;
+    }
+
+    if (button == exportTraceButton)
+    {
+        exportTrace();
+        return;
+    }
+
+    if (button != exportButton)
+        return;
+
+    // the chooser runs a modal loop that may close this box, so the data is copied first
+    const String csv = toCsv();
+
+    FileChooser fc("Export the CPU profile...",
+                   CoreServices::getDefaultUserSaveDirectory().getChildFile("cpu_profile.csv"),
+                   "*.csv",
+                   true);
+
+    if (fc.browseForFileToSave(true))
+    {
+        File file = fc.getResult();
+
+        if (file.replaceWithText(csv))
+            CoreServices::sendStatusMessage("Saved CPU profile to " + file.getFileName());
+        else
+            CoreServices::sendStatusMessage("Could not write " + file.getFileName());
+    }
+}
+
+void CPUBreakdown::exportTrace()
+{
+    FileChooser fc("Export the pipeline trace...",
+                   CoreServices::getDefaultUserSaveDirectory().getChildFile("pipeline_trace.json"),
+                   "*.json",
+                   true);
+
+    if (fc.browseForFileToSave(true))
+    {
+        File file = fc.getResult();
+
+        if (PipelineTrace::writeChromeTrace(file))
+            CoreServices::sendStatusMessage("Saved pipeline trace to " + file.getFileName());
+        else
+            CoreServices::sendStatusMessage("Could not write " + file.getFileName());
+    }
+}
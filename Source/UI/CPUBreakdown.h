@@ -0,0 +1,143 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CPUBREAKDOWN_H_5E1A7C93__
+#define __CPUBREAKDOWN_H_5E1A7C93__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Audio/AudioComponent.h"
+#include "../Processors/GenericProcessor/ProcessTimeProfile.h"
+
+class ProcessorGraph;
+
+/** Most points the CPUHistory keeps; when it fills up, every other point is dropped */
+#define CPU_HISTORY_MAX_POINTS 14400
+
+/**
+    The load of the audio thread over the session, one point per refresh of the
+    CPUMeter while acquisition runs.
+
+    Long sessions are thinned out: when the history is full, every other point
+    is dropped and points are kept half as often from then on.
+
+    @see CPUBreakdown
+*/
+class CPUHistory
+{
+public:
+    struct Point
+    {
+        double seconds;         // since the session started
+        float cpu;              // audio device CPU usage, 0 to 1
+        float processorLoad;    // share of the block duration spent in the processors
+        float jitterUs;         // standard deviation of the callback interval
+        float meanDelayUs;      // how late the callbacks came, on average
+        int overruns;           // since acquisition started
+        int xruns;
+        float uiLatencyMs;      // message thread latency
+    };
+
+    CPUHistory();
+
+    /** Adds a point, stamped with the time since the session started */
+    void add(Point point);
+
+    const Array<Point>& getPoints() const;
+
+private:
+    Array<Point> points;
+    double sessionStartMs;
+    int stride;     // points are kept once every stride calls to add()
+    int skipped;
+};
+
+/**
+    Breaks down the load shown by the CPUMeter: the time each processor takes per
+    block, the timing of the audio device callbacks (jitter, late callbacks, overruns
+    and xruns) and graphs of the history over the session, which can be exported
+    as CSV.
+
+    Allocation detection counts the heap allocations each processor makes per block
+    and, optionally, samples their call stacks, so plugins can be made real-time safe.
+    The pipeline can also be traced and exported as one timeline of all threads.
+
+    Opened in a CallOutBox by clicking on the CPUMeter.
+
+    @see CPUMeter, ProcessTimeProfile, AudioComponent::getCallbackStats, AllocationCounter, PipelineTrace
+*/
+class CPUBreakdown : public Component,
+    private Timer,
+    private Button::Listener
+{
+public:
+    CPUBreakdown(ProcessorGraph* graph, AudioComponent* audio, const CPUHistory& history);
+    ~CPUBreakdown();
+
+    void paint(Graphics& g) override;
+    void resized() override;
+
+    /** The breakdown and the history as CSV */
+    String toCsv() const;
+
+private:
+    void timerCallback() override;
+    void buttonClicked(Button* button) override;
+
+    /** Reads the current statistics of the processors and the audio callbacks */
+    void updateStats();
+
+    /** Shows the sampled call stacks of the processors that allocate */
+    void updateBacktraces();
+
+    void drawHistory(Graphics& g, Rectangle<int> area, bool loadGraph) const;
+
+    /** Writes the spans traced by every thread as a Chrome trace, for chrome://tracing or Perfetto */
+    void exportTrace();
+
+    ProcessorGraph* graph;
+    AudioComponent* audio;
+    const CPUHistory& history;
+
+    struct ProcessorRow
+    {
+        String name;
+        ProcessTimeProfile::Stats stats;
+        String backtrace;       // of a recent allocation, if sampled
+    };
+
+    Array<ProcessorRow> rows;
+    AudioComponent::CallbackStats callbackStats;
+
+    ScopedPointer<TextButton> exportButton;
+    ScopedPointer<ToggleButton> traceButton;
+    ScopedPointer<TextButton> exportTraceButton;
+    ScopedPointer<ToggleButton> allocationButton;
+    ScopedPointer<ToggleButton> backtraceButton;
+    ScopedPointer<TextEditor> backtraceView;
+
+    Font font;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CPUBreakdown);
+};
+
+#endif  // __CPUBREAKDOWN_H_5E1A7C93__
@@ -28,6 +28,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../AccessClass.h"
 #include "../Processors/RecordNode/RecordEngine.h"
 #include "../Processors/PluginManager/PluginManager.h"
+#include "../Utils/MessageThreadMonitor.h"
+#include "../Processors/ProcessorGraph/LoadShedder.h"
+
+/* Message thread latency that fills the CPUMeter's latency bar */
+#define LATENCY_FULL_SCALE_MS 100.0f
 
 
 const int SIZE_AUDIO_EDITOR_MAX_WIDTH = 500;
@@ -96,7 +101,8 @@ RecordButton::~RecordButton()
 }
 
 
-CPUMeter::CPUMeter() : Label("CPU Meter","0.0"), cpu(0.0f), lastCpu(0.0f)
+CPUMeter::CPUMeter(ProcessorGraph* graph_, AudioComponent* audio_) : Label("CPU Meter","0.0"), cpu(0.0f), lastCpu(0.0f), processorLoad(0.0f), offlineSpeed(0.0f),
+    meanLatency(0.0f), maxLatency(0.0f), graph(graph_), audio(audio_), shedLevel(LoadShedder::NONE)
 {
 
     font = Font("Small Text", 12, Font::plain);
@@ -106,7 +112,7 @@ CPUMeter::CPUMeter() : Label("CPU Meter","0.0"), cpu(0.0f), lastCpu(0.0f)
     // font = Font(typeface);
     // font.setHeight(12);
 
-    setTooltip("CPU usage");
+    setTooltip("CPU usage (click for details)");
 }
 
 CPUMeter::~CPUMeter()
@@ -119,6 +125,76 @@ void CPUMeter::updateCPU(float usage)
     cpu = usage;
 }
 
+void CPUMeter::updateProcessorLoad(float load, const String& breakdown)
+{
+    processorLoad = load;
+    processorBreakdown = breakdown;
+
+    updateTooltip();
+}
+
+void CPUMeter::updateMessageLatency(float meanMs, float maxMs, const String& longTasks)
+{
+    meanLatency = meanMs;
+    maxLatency = maxMs;
+    taskBreakdown = longTasks;
+
+    updateTooltip();
+}
+
+void CPUMeter::updateLoadShedding(int level, const String& shedProcessors)
+{
+    shedLevel = level;
+    shedBreakdown = shedProcessors;
+
+    updateTooltip();
+}
+
+void CPUMeter::addHistoryPoint(const AudioComponent::CallbackStats& callbacks)
+{
+    CPUHistory::Point point;
+    point.cpu = cpu;
+    point.processorLoad = processorLoad;
+    point.jitterUs = callbacks.jitterUs;
+    point.meanDelayUs = callbacks.meanDelayUs;
+    point.overruns = callbacks.overruns;
+    point.xruns = callbacks.xruns;
+    point.uiLatencyMs = meanLatency;
+
+    history.add(point);
+}
+
+void CPUMeter::mouseDown(const MouseEvent& event)
+{
+    CallOutBox::launchAsynchronously(new CPUBreakdown(graph, audio, history), getScreenBounds(), nullptr);
+}
+
+void CPUMeter::updateTooltip()
+{
+    String tooltip = "CPU usage (click for details)";
+
+    if (processorBreakdown.isNotEmpty())
+        tooltip += "\n" + processorBreakdown;
+
+    tooltip += "\nUI latency: mean " + String(meanLatency, 1) + " ms, max " + String(maxLatency, 0) + " ms";
+
+    if (taskBreakdown.isNotEmpty())
+        tooltip += "\n" + taskBreakdown;
+
+    if (shedLevel != LoadShedder::NONE)
+        tooltip += "\nLoad shedding: " + LoadShedder::getLevelName((LoadShedder::Level) shedLevel);
+
+    if (shedBreakdown.isNotEmpty())
+        tooltip += "\n" + shedBreakdown;
+
+    setTooltip(tooltip);
+}
+
+void CPUMeter::updateOfflineSpeed(float speed)
+{
+    offlineSpeed = speed;
+}
+
 void CPUMeter::paint(Graphics& g)
 {
     g.fillAll(Colours::grey);
@@ -126,11 +202,31 @@ void CPUMeter::paint(Graphics& g)
     g.setColour(Colours::yellow);
     g.fillRect(0.0f,0.0f,getWidth()*cpu,float(getHeight()));
 
+    // time spent in the processors, as a share of the block duration
+    g.setColour(Colours::orange);
+    g.fillRect(0.0f,float(getHeight()-4),getWidth()*jmin(1.0f,processorLoad),4.0f);
+
+    // message thread latency: the mean as a bar, the worst since the last update as a tick
+    g.setColour(maxLatency > LATENCY_FULL_SCALE_MS ? Colours::red : Colours::lightblue);
+    g.fillRect(0.0f,0.0f,getWidth()*jmin(1.0f,meanLatency/LATENCY_FULL_SCALE_MS),3.0f);
+    g.fillRect(jmin(getWidth()-2.0f,getWidth()*maxLatency/LATENCY_FULL_SCALE_MS),0.0f,2.0f,3.0f);
+
+    // displays giving up blocks under load: orange while decimating, red while skipping
+    if (shedLevel != LoadShedder::NONE)
+    {
+        g.setColour(shedLevel == LoadShedder::SKIP ? Colours::red : Colours::orange);
+        g.fillRect(getWidth()-5.0f,0.0f,5.0f,float(getHeight()));
+    }
+
     g.setColour(Colours::black);
     g.drawRect(0,0,getWidth(),getHeight(),1);
 
     g.setFont(font);
-    g.drawSingleLineText("CPU",65,12);
+
+    if (offlineSpeed > 0.0f)
+        g.drawSingleLineText(String(offlineSpeed, 1) + "x RT",55,12);
+    else
+        g.drawSingleLineText("CPU",65,12);
 
 }
 
@@ -400,7 +496,7 @@ ControlPanel::ControlPanel(ProcessorGraph* graph_, AudioComponent* audio_)
     masterClock = new Clock();
     addAndMakeVisible(masterClock);
 
-    cpuMeter = new CPUMeter();
+    cpuMeter = new CPUMeter(graph, audio);
     addAndMakeVisible(cpuMeter);
 
     diskMeter = new DiskSpaceMeter();
@@ -1041,17 +1137,80 @@ void ControlPanel::timerCallback()
 
 }
 
+void ControlPanel::updateProcessorLoad()
+{
+    // the processors taking the largest share of the block duration come first
+    Array<GenericProcessor*> processors = graph->getListOfProcessors();
+    Array<ProcessTimeProfile::Stats> stats;
+    float totalLoad = 0.0f;
+
+    for (auto processor : processors)
+    {
+        ProcessTimeProfile::Stats s = processor->getProcessTimeProfile().getStats();
+        stats.add(s);
+        totalLoad += s.budgetPercent / 100.0f;
+    }
+
+    String breakdown;
+    Array<int> shown;
+
+    for (int line = 0; line < jmin(5, processors.size()); line++)
+    {
+        int busiest = -1;
+        for (int i = 0; i < processors.size(); i++)
+        {
+            if (!shown.contains(i) && (busiest < 0 || stats[i].budgetPercent > stats[busiest].budgetPercent))
+                busiest = i;
+        }
+
+        shown.add(busiest);
+        breakdown += processors[busiest]->getName() + ": " + String(stats[busiest].budgetPercent, 1)
+            + "% (mean " + String(stats[busiest].meanUs, 0) + " us, p99 " + String(stats[busiest].p99Us, 0) + " us)\n";
+    }
+
+    cpuMeter->updateProcessorLoad(totalLoad, breakdown.trimEnd());
+
+    String shed;
+
+    for (auto processor : processors)
+    {
+        const int64 shedBlocks = processor->getProcessTimeProfile().getNumShedBlocks();
+
+        if (shedBlocks > 0)
+            shed += processor->getName() + ": " + String(shedBlocks) + " block(s) shed\n";
+    }
+
+    cpuMeter->updateLoadShedding(LoadShedder::getLevel(), shed.trimEnd());
+}
+
 void ControlPanel::refreshMeters()
 {
     if (playButton->getToggleState())
     {
-        cpuMeter->updateCPU(audio->deviceManager.getCpuUsage());
+        cpuMeter->updateCPU(audio->isOfflineMode() ? 0.0f : audio->deviceManager.getCpuUsage());
+        cpuMeter->updateOfflineSpeed(audio->getOfflineSpeed());
+        updateProcessorLoad();
     }
     else
     {
         cpuMeter->updateCPU(0.0f);
+        cpuMeter->updateProcessorLoad(0.0f, String::empty);
+        cpuMeter->updateLoadShedding(LoadShedder::NONE, String::empty);
+        cpuMeter->updateOfflineSpeed(0.0f);
     }
 
+    MessageThreadMonitor::Stats latency = MessageThreadMonitor::getInstance()->getStats();
+    String longTasks;
+
+    if (latency.longTasks > 0)
+        longTasks = String(latency.longTasks) + " long UI task(s), slowest: " + latency.worstTask
+            + " (" + String(latency.worstTaskMs, 0) + " ms)";
+
+    cpuMeter->updateMessageLatency(latency.meanLatencyMs, latency.maxLatencyMs, longTasks);
+
+    if (playButton->getToggleState())
+        cpuMeter->addHistoryPoint(audio->getCallbackStats());
+
     cpuMeter->repaint();
 
     masterClock->repaint();
@@ -1206,4 +1365,4 @@ StringArray ControlPanel::getRecentlyUsedFilenames()
 void ControlPanel::setRecentlyUsedFilenames(const StringArray& filenames)
 {
     filenameComponent->setRecentlyUsedFilenames(filenames);
-}
\ No newline at end of file
+}
\ No newline at end of file
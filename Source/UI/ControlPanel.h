@@ -31,6 +31,7 @@
 #include "../Processors/RecordNode/RecordNode.h"
 #include "../Processors/RecordNode/RecordEngine.h"
 #include "LookAndFeel/CustomLookAndFeel.h"
+#include "CPUBreakdown.h"
 #include "../AccessClass.h"
 #include "../Processors/Editors/GenericEditor.h" // for UtilityButton
 #include <queue>
@@ -99,13 +100,36 @@ public:
 class CPUMeter : public Label
 {
 public:
-    CPUMeter();
+    CPUMeter(ProcessorGraph* graph, AudioComponent* audio);
     ~CPUMeter();
 
     /** Updates the load level displayed by the CPUMeter. Called by
          the ControlPanel. */
     void updateCPU(float usage);
 
+    /** Updates the share of the block duration spent in the processors, and the
+        per-processor breakdown shown in the tooltip. Called by the ControlPanel. */
+    void updateProcessorLoad(float load, const String& breakdown);
+
+    /** Shows the speed of an offline run, in seconds of data per second, in place
+        of the CPU label, or the label again when speed is 0. Called by the ControlPanel. */
+    void updateOfflineSpeed(float speed);
+
+    /** Updates the message thread latency drawn along the top edge, and the
+        long tasks listed in the tooltip. Called by the ControlPanel. */
+    void updateMessageLatency(float meanMs, float maxMs, const String& longTasks);
+
+    /** Updates the load shedding level marked on the right edge, and the displays
+        that gave up blocks, listed in the tooltip. Called by the ControlPanel. */
+    void updateLoadShedding(int level, const String& shedProcessors);
+
+    /** Adds the current load and the callback timing to the session history.
+        Called by the ControlPanel while acquisition runs. */
+    void addHistoryPoint(const AudioComponent::CallbackStats& callbacks);
+
+    /** Opens the CPUBreakdown. */
+    void mouseDown(const MouseEvent& event) override;
+
     /** Draws the CPUMeter. */
     void paint(Graphics& g);
 
@@ -115,6 +139,22 @@ private:
 
     float cpu;
     float lastCpu;
+    float processorLoad;
+    float offlineSpeed;
+    float meanLatency;
+    float maxLatency;
+
+    ProcessorGraph* graph;
+    AudioComponent* audio;
+    CPUHistory history;
+
+    String processorBreakdown;
+    String taskBreakdown;
+
+    int shedLevel;
+    String shedBreakdown;
+
+    void updateTooltip();
 
 };
 
@@ -411,6 +451,9 @@ private:
     /** Updates the values displayed by the CPUMeter and DiskSpaceMeter.*/
     void refreshMeters();
 
+    /** Sends the processing time profiles of the processors to the CPUMeter.*/
+    void updateProcessorLoad();
+
     bool keyPressed(const KeyPress& key);
 
 
@@ -30,6 +30,8 @@
 #include "ProcessorList.h"
 #include "../Processors/ProcessorGraph/ProcessorGraph.h"
 #include "EditorViewportActions.h"
+#include "../Utils/XmlSnapshot.h"
+#include "../Utils/ThreadConfig.h"
 
 const int BORDER_SIZE = 6;
 const int TAB_SIZE = 30;
@@ -315,6 +317,10 @@ void EditorViewport::updateVisibleEditors(Array<GenericEditor*> visibleEditors,
         addChildComponent(editor);
         editor->setVisible(true);
     }
+
+    // laid out once the whole configuration is loaded
+    if (loadingConfig)
+        return;
         
     refreshEditors();
     signalChainTabComponent->refreshTabs(numberOfTabs, selectedTab);
@@ -1340,7 +1346,14 @@ const String EditorViewport::saveState(File fileToUse, String* xmlText)
     
     XmlElement* xml = createSettingsXml();
 
-    if (! xml->writeToFile(currentFile, String::empty))
+    // the configurations the GUI keeps for itself also get a snapshot, to restart from
+    bool written;
+    if (currentFile.getParentDirectory() == CoreServices::getSavedStateDirectory())
+        written = XmlSnapshot::writeConfig(*xml, currentFile);
+    else
+        written = xml->writeToFile(currentFile, String::empty);
+
+    if (! written)
         error = "Couldn't write to file ";
     else
         error = "Saved configuration as ";
@@ -1472,6 +1485,8 @@ XmlElement* EditorViewport::createSettingsXml()
 	timestampSettings->setAttribute("selected_sub_index", tsSubID);
 	xml->addChildElement(timestampSettings);
 
+    ThreadConfig::saveStateToXml(xml);
+
     //Resets Save Order for processors, allowing them to be saved again without omitting themselves from the order.
     int allProcessorSize = allProcessors.size();
     for (int i = 0; i < allProcessorSize; i++)
@@ -1591,8 +1606,7 @@ const String EditorViewport::loadState(File fileToLoad)
     
     currentFile = fileToLoad;
 
-    XmlDocument doc(currentFile);
-    XmlElement* xml = doc.getDocumentElement();
+    XmlElement* xml = XmlSnapshot::readConfig(currentFile);
     
     if (xml == 0 || ! xml->hasTagName("SETTINGS"))
     {
@@ -1689,6 +1703,9 @@ const String EditorViewport::loadStateFromXml(XmlElement* xml)
     
     AccessClass::getProcessorGraph()->clearSignalChain();
     
+    // processors are created and wired first, then updated all at once by restoreParameters()
+    AccessClass::getProcessorGraph()->prepareToLoadSignalChain();
+
     loadingConfig = true; //Indicate config is being loaded into the GUI
     String description;// = " ";
     int loadOrder = 0;
@@ -1763,6 +1780,10 @@ const String EditorViewport::loadStateFromXml(XmlElement* xml)
 				AccessClass::getProcessorGraph()->getRecordNode()->setParameter(3, 0.0f);
             */
 		}
+        else if (element->hasTagName("THREADS"))
+        {
+            ThreadConfig::loadStateFromXml(element);
+        }
 		else if (element->hasTagName("GLOBAL_TIMESTAMP"))
 		{
 			int tsID = element->getIntAttribute("selected_index", -1);
@@ -1772,6 +1793,8 @@ const String EditorViewport::loadStateFromXml(XmlElement* xml)
 
     }
 
+    loadingConfig = false;
+
     AccessClass::getProcessorGraph()->restoreParameters();
 
     AccessClass::getControlPanel()->loadStateFromXml(xml); // load the control panel settings
@@ -1783,8 +1806,6 @@ const String EditorViewport::loadStateFromXml(XmlElement* xml)
 
     //delete xml;
 
-    loadingConfig = false;
-    
     return error;
 }
 
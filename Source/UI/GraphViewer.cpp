@@ -36,6 +36,9 @@ GraphViewer::GraphViewer()
     currentVersionText = "GUI version " + app->getApplicationVersion();
     
     rootNum = 0;
+    wasAcquiring = false;
+
+    startTimer(500);
 }
 
 
@@ -45,7 +48,8 @@ GraphViewer::~GraphViewer()
 
 void GraphViewer::updateNodes(Array<GenericProcessor*> rootProcessors)
 {
-    removeAllNodes(); // clear the current nodes
+    // nodes placed by this update; the ones left over belong to removed processors
+    Array<GraphNode*> placedNodes;
             
     Array<Splitter*> splitters;
 
@@ -62,9 +66,17 @@ void GraphViewer::updateNodes(Array<GenericProcessor*> rootProcessors)
             {
                 level++;
                 
-                if (!nodeExists(processor))
+                GraphNode* gn = getNodeForEditor(processor->getEditor());
+
+                if (gn == nullptr)
                 {
                     addNode(processor->getEditor(), level, rootNum);
+                    placedNodes.add(availableNodes.getLast());
+                }
+                else if (!placedNodes.contains(gn)) // a merger is reached from both of its inputs
+                {
+                    placeNode(gn, level, rootNum);
+                    placedNodes.add(gn);
                 }
                 
                 if (processor->isSplitter())
@@ -85,8 +97,16 @@ void GraphViewer::updateNodes(Array<GenericProcessor*> rootProcessors)
             }
         }
     }
+
+    for (int i = availableNodes.size(); --i >= 0;)
+    {
+        if (!placedNodes.contains(availableNodes[i]))
+            availableNodes.remove(i);
+    }
     
-    //updateNodeLocations();
+    updateConnections();
+
+    repaint();
 }
 
 bool GraphViewer::nodeExists(GenericProcessor* p)
@@ -104,6 +124,15 @@ void GraphViewer::addNode (GenericEditor* editor, int level, int offset)
     addAndMakeVisible (gn);
     availableNodes.add (gn);
     
+    placeNode (gn, level, offset);
+}
+
+void GraphViewer::placeNode (GraphNode* gn, int level, int offset)
+{
+    // an editor may have been replaced by a new one at the same address,
+    // so everything the node shows is read again
+    gn->refresh();
+
     int thisNodeWidth = NODE_WIDTH;
 
     if (gn->getName().length() > 15)
@@ -115,12 +144,12 @@ void GraphViewer::addNode (GenericEditor* editor, int level, int offset)
     gn->setHorzShift(offset);
     gn->setWidth(thisNodeWidth);
     gn->updateBoundaries();
-    
 }
 
 void GraphViewer::removeAllNodes()
 {
     availableNodes.clear();
+    connectionPath.clear();
     
     repaint();
 }
@@ -170,6 +199,18 @@ void GraphViewer::paint (Graphics& g)
     g.drawFittedText (currentVersionText, 40, 40, getWidth()-50, getHeight()-45, Justification::bottomRight, 100);
     
     // Draw connections
+    g.setColour (Colour(30,30,30));
+    g.strokePath (connectionPath, PathStrokeType (3.5f));
+    
+    g.setColour (Colours::grey);
+    g.strokePath (connectionPath, PathStrokeType (2.0f));
+}
+
+
+void GraphViewer::updateConnections()
+{
+    connectionPath.clear();
+
     const int numAvailableNodes = availableNodes.size();
     for (int i = 0; i < numAvailableNodes; ++i)
     {
@@ -180,7 +221,7 @@ void GraphViewer::paint (Graphics& g)
                 int indexOfDest = getIndexOfEditor (availableNodes[i]->getDest());
                 
                 if (indexOfDest > -1)
-                    connectNodes (i, indexOfDest, g);
+                    connectNodes (i, indexOfDest);
             }
         }
         else
@@ -192,38 +233,28 @@ void GraphViewer::paint (Graphics& g)
                 int indexOfDest = getIndexOfEditor (editors[path]);
                 
                 if (indexOfDest > -1)
-                    connectNodes (i, indexOfDest, g);
+                    connectNodes (i, indexOfDest);
             }
         }
     }
 }
 
 
-void GraphViewer::connectNodes (int node1, int node2, Graphics& g)
+void GraphViewer::connectNodes (int node1, int node2)
 {
     
     juce::Point<float> start  = availableNodes[node1]->getCenterPoint();
     juce::Point<float> end    = availableNodes[node2]->getCenterPoint();
     
-    Path linePath;
     float x1 = start.getX();
     float y1 = start.getY();
     float x2 = end.getX();
     float y2 = end.getY();
     
-    linePath.startNewSubPath (x1, y1);
-    linePath.cubicTo (x1, y1 + (y2 - y1) * 0.9f,
-                      x2, y1 + (y2 - y1) * 0.1f,
-                      x2, y2);
-    
-    
-    g.setColour (Colour(30,30,30));
-    PathStrokeType stroke3 (3.5f);
-    g.strokePath (linePath, stroke3);
-    
-    g.setColour (Colours::grey);
-    PathStrokeType stroke2 (2.0f);
-    g.strokePath (linePath, stroke2);
+    connectionPath.startNewSubPath (x1, y1);
+    connectionPath.cubicTo (x1, y1 + (y2 - y1) * 0.9f,
+                            x2, y1 + (y2 - y1) * 0.1f,
+                            x2, y2);
 }
 
 /// ------------------------------------------------------
@@ -354,6 +385,20 @@ juce::Point<float> GraphNode::getCenterPoint() const
 }
 
 
+void GraphNode::refresh()
+{
+    const int newNodeId = editor->getProcessor()->getNodeId();
+    const String newInfoString = getInfoString();
+
+    if (newNodeId != nodeId || newInfoString != infoString)
+    {
+        nodeId = newNodeId;
+        infoString = newInfoString;
+        repaint();
+    }
+}
+
+
 void GraphNode::updateBoundaries()
 {
 
@@ -363,6 +408,45 @@ void GraphNode::updateBoundaries()
                NODE_HEIGHT);
 }
 
+void GraphViewer::timerCallback()
+{
+    bool acquiring = CoreServices::getAcquisitionStatus();
+
+    // the last values stay on the nodes once acquisition stops
+    if (acquiring || wasAcquiring)
+    {
+        for (auto node : availableNodes)
+            node->updateProcessTime();
+    }
+
+    wasAcquiring = acquiring;
+}
+
+
+void GraphNode::updateProcessTime()
+{
+    GenericProcessor* processor = (GenericProcessor*) editor->getProcessor();
+
+    processStats = processor->getProcessTimeProfile().getStats();
+
+    if (processStats.numBlocks > 0)
+    {
+        setTooltip ("Process time: mean " + String (processStats.meanUs, 1)
+                    + " us, min " + String (processStats.minUs, 1)
+                    + " us, p99 " + String (processStats.p99Us, 1)
+                    + " us, max " + String (processStats.maxUs, 1)
+                    + " us\nBlock budget: " + String (processStats.budgetPercent, 1)
+                    + "%\nEvents per block: " + String (processStats.meanEvents, 1));
+    }
+    else
+    {
+        setTooltip (String::empty);
+    }
+
+    repaint();
+}
+
+
 String GraphNode::getInfoString()
 {
     GenericProcessor* processor = (GenericProcessor*) editor->getProcessor();
@@ -422,5 +506,20 @@ void GraphNode::paint (Graphics& g)
     g.drawText (String(nodeId) + " " + getName(), 23, 1, getWidth() - 25, 20, Justification::left, true);
     
     g.setColour (Colours::black); // : editor->getBackgroundColor());
-    g.drawFittedText (getInfoString(), 10, 25, getWidth() - 5, 70, Justification::left, true);
+    g.drawFittedText (infoString, 10, 25, getWidth() - 5, 70, Justification::left, true);
+
+    // share of the block duration spent in process(), along the bottom of the node
+    if (processStats.numBlocks > 0)
+    {
+        float load = jmin (1.0f, processStats.budgetPercent / 100.0f);
+        float barWidth = (getWidth() - 27) * load;
+
+        g.setColour (load > 0.5f ? Colours::red : (load > 0.2f ? Colours::orange : Colours::green));
+        g.fillRect (2.0f, float (NODE_HEIGHT - 30), barWidth, 4.0f);
+
+        g.setColour (Colours::black);
+        g.setFont (10);
+        g.drawText (String (processStats.budgetPercent, 1) + "%", getWidth() - 70, NODE_HEIGHT - 43, 42, 12,
+                    Justification::right, false);
+    }
 }
@@ -37,6 +37,7 @@
 */
 
 class GraphNode : public Component
+                , public SettableTooltipClient
 {
 public:
     
@@ -101,6 +102,13 @@ public:
     //void switchIO (int path);
     
     void updateBoundaries();
+
+    /** Re-reads the id, name and channel counts of the processor, repainting
+        the node if they changed */
+    void refresh();
+
+    /** Refreshes the processing time shown on the node from the processor's profile */
+    void updateProcessTime();
     
 private:
     GenericEditor* editor;
@@ -109,6 +117,9 @@ private:
     
     
     String getInfoString();
+
+    /** The channel counts drawn on the node, as of the last refresh() */
+    String infoString;
     
     bool isMouseOver;
     int horzShift;
@@ -116,6 +127,8 @@ private:
     int nodeWidth;
     
     int nodeId;
+
+    ProcessTimeProfile::Stats processStats;
 };
 
 /**
@@ -128,6 +141,7 @@ private:
 
 */
 class GraphViewer : public Component
+                  , public Timer
 {
 public:
     
@@ -140,11 +154,16 @@ public:
     /** Draws the GraphViewer.*/
     void paint (Graphics& g)    override;
     
-    /** Adds a graph node for a particular processor */
+    /** Lays out the nodes of the signal chains starting at the root processors.
+        Nodes of processors that are still in the chain are kept and only moved,
+        so an update only creates the nodes of processors that were added. */
     void updateNodes    (Array<GenericProcessor*> rootProcessors);
     
     /** Adds a graph node for a particular processor */
     void addNode    (GenericEditor* editor, int level, int offset);
+
+    /** Moves an existing node to a level and offset, refreshing what it shows */
+    void placeNode  (GraphNode* node, int level, int offset);
     
     /** Clears the graph */
     void removeAllNodes();
@@ -156,12 +175,25 @@ public:
     
     /** Checks if a node exists for a given processor*/
     bool nodeExists(GenericProcessor* processor);
+
+    /** Refreshes the processing times of the nodes during acquisition */
+    void timerCallback() override;
     
 private:
-    void connectNodes (int, int, Graphics&);
+    /** Adds the connection between two nodes to the connection path */
+    void connectNodes (int, int);
+
+    /** Rebuilds the cached path of every connection from the node positions */
+    void updateConnections();
+
+    /** The connections between the nodes, built when the layout changes
+        so that painting only strokes it */
+    Path connectionPath;
 
     int rootNum;
 
+    bool wasAcquiring;
+
     String currentVersionText;
     
     OwnedArray<GraphNode> availableNodes;
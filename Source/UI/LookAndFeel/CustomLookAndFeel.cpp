@@ -24,48 +24,7 @@
 #include "CustomLookAndFeel.h"
 #include "../CustomArrowButton.h"
 
-CustomLookAndFeel::CustomLookAndFeel() :
-    // third argument to MIS means don't copy the binary data to make a new stream
-    cpmonoExtraLightStream(BinaryData::cpmonoextralightserialized,
-                           BinaryData::cpmonoextralightserializedSize,
-                           false),
-    cpmonoLightStream(BinaryData::cpmonolightserialized,
-                      BinaryData::cpmonolightserializedSize,
-                      false),
-    cpmonoPlainStream(BinaryData::cpmonoplainserialized,
-                      BinaryData::cpmonoplainserializedSize,
-                      false),
-    cpmonoBoldStream(BinaryData::cpmonoboldserialized,
-                     BinaryData::cpmonoboldserializedSize,
-                     false),
-    cpmonoBlackStream(BinaryData::cpmonoblackserialized,
-                      BinaryData::cpmonoblackserializedSize,
-                      false),
-    misoRegularStream(BinaryData::misoserialized,
-                      BinaryData::misoserializedSize,
-                      false),
-    silkscreenStream(BinaryData::silkscreenserialized,
-                     BinaryData::silkscreenserializedSize,
-                     false),
-    // heap allocation is necessary here, because otherwise the typefaces are
-    // deleted too soon (there's a singleton typefacecache that holds references
-    // to them whenever they're used).
-    cpmonoExtraLight(new CustomTypeface(cpmonoExtraLightStream)),
-    cpmonoLight(new CustomTypeface(cpmonoLightStream)),
-    cpmonoPlain(new CustomTypeface(cpmonoPlainStream)),
-    cpmonoBold(new CustomTypeface(cpmonoBoldStream)),
-    cpmonoBlack(new CustomTypeface(cpmonoBlackStream)),
-    misoRegular(new CustomTypeface(misoRegularStream)),
-    silkscreen(new CustomTypeface(silkscreenStream)),
-    firasansExtraLight(Typeface::createSystemTypefaceFor(BinaryData::FiraSansExtraLight_ttf, 
-                                                         BinaryData::FiraSansExtraLight_ttfSize)),
-    firasansRegular(Typeface::createSystemTypefaceFor(BinaryData::FiraSansRegular_ttf, 
-                                                      BinaryData::FiraSansRegular_ttfSize)),
-    firasansSemiBold(Typeface::createSystemTypefaceFor(BinaryData::FiraSansSemiBold_ttf, 
-                                                       BinaryData::FiraSansSemiBold_ttfSize)),
-    firasansExtraBold(Typeface::createSystemTypefaceFor(BinaryData::FiraSansExtraBold_ttf, 
-                                                        BinaryData::FiraSansExtraBold_ttfSize))
-
+CustomLookAndFeel::CustomLookAndFeel()
 {
 
     // UNCOMMENT AFTER UPDATE
@@ -101,6 +60,28 @@ CustomLookAndFeel::CustomLookAndFeel() :
 
 CustomLookAndFeel::~CustomLookAndFeel() {}
 
+Typeface::Ptr CustomLookAndFeel::loadTypeface(Typeface::Ptr& typeface, const void* data, size_t size, bool serialized)
+{
+    // fonts are also looked up from OpenGL render threads
+    const ScopedLock typefaceGuard(typefaceLock);
+
+    if (typeface == nullptr)
+    {
+        if (serialized)
+        {
+            // don't copy the binary data to make a new stream
+            MemoryInputStream stream(data, size, false);
+            typeface = new CustomTypeface(stream);
+        }
+        else
+        {
+            typeface = Typeface::createSystemTypefaceFor(data, size);
+        }
+    }
+
+    return typeface;
+}
+
 //==============================================================================
 // FONT/TYPEFACE METHODS :
 //==============================================================================
@@ -113,51 +94,51 @@ Typeface::Ptr CustomLookAndFeel::getTypefaceForFont(const Font& font)
     // missing.  adjust as needed
     if (typefaceName.equalsIgnoreCase("Default Extra Light"))
     {
-        return cpmonoExtraLight;
+        return loadTypeface(cpmonoExtraLight, BinaryData::cpmonoextralightserialized, BinaryData::cpmonoextralightserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Default Light"))
     {
-        return cpmonoLight;
+        return loadTypeface(cpmonoLight, BinaryData::cpmonolightserialized, BinaryData::cpmonolightserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Default"))
     {
-        return cpmonoPlain;
+        return loadTypeface(cpmonoPlain, BinaryData::cpmonoplainserialized, BinaryData::cpmonoplainserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Default Bold"))
     {
-        return cpmonoBold;
+        return loadTypeface(cpmonoBold, BinaryData::cpmonoboldserialized, BinaryData::cpmonoboldserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Default Black"))
     {
-        return cpmonoBlack;
+        return loadTypeface(cpmonoBlack, BinaryData::cpmonoblackserialized, BinaryData::cpmonoblackserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Paragraph"))
     {
-        return misoRegular;
+        return loadTypeface(misoRegular, BinaryData::misoserialized, BinaryData::misoserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("Small Text"))
     {
-        return silkscreen;
+        return loadTypeface(silkscreen, BinaryData::silkscreenserialized, BinaryData::silkscreenserializedSize, true);
     }
     else if (typefaceName.equalsIgnoreCase("FiraSans Light"))
     {
-        return firasansExtraLight;
+        return loadTypeface(firasansExtraLight, BinaryData::FiraSansExtraLight_ttf, BinaryData::FiraSansExtraLight_ttfSize, false);
     }
     else if (typefaceName.equalsIgnoreCase("FiraSans"))
     {
-        return firasansRegular;
+        return loadTypeface(firasansRegular, BinaryData::FiraSansRegular_ttf, BinaryData::FiraSansRegular_ttfSize, false);
     }
     else if (typefaceName.equalsIgnoreCase("FiraSans Bold"))
     {
-        return firasansSemiBold;
+        return loadTypeface(firasansSemiBold, BinaryData::FiraSansSemiBold_ttf, BinaryData::FiraSansSemiBold_ttfSize, false);
     }
     else if (typefaceName.equalsIgnoreCase("FiraSans Extra Bold"))
     {
-        return firasansExtraBold;
+        return loadTypeface(firasansExtraBold, BinaryData::FiraSansExtraBold_ttf, BinaryData::FiraSansExtraBold_ttfSize, false);
     }
     else   // default
     {
-        return firasansSemiBold;
+        return loadTypeface(firasansSemiBold, BinaryData::FiraSansSemiBold_ttf, BinaryData::FiraSansSemiBold_ttfSize, false);
     }
 
     // UNCOMMENT AFTER UPDATE
@@ -157,15 +157,10 @@ private:
     // this maps strings to customtypeface pointers
     HashMap<String, Typeface::Ptr> typefaceMap;
 
-    MemoryInputStream
-    cpmonoExtraLightStream,
-    cpmonoLightStream,
-    cpmonoPlainStream,
-    cpmonoBoldStream,
-    cpmonoBlackStream,
-    misoRegularStream,
-    silkscreenStream;
-
+    // created the first time a font uses them, so startup doesn't parse them all;
+    // heap allocation is necessary here, because otherwise the typefaces are
+    // deleted too soon (there's a singleton typefacecache that holds references
+    // to them whenever they're used).
     Typeface::Ptr
     cpmonoExtraLight,
     cpmonoLight,
@@ -179,6 +174,11 @@ private:
     firasansSemiBold,
     firasansExtraBold;
 
+    CriticalSection typefaceLock;
+
+    /** Returns a typeface, creating it from its binary data if it doesn't exist yet */
+    Typeface::Ptr loadTypeface(Typeface::Ptr& typeface, const void* data, size_t size, bool serialized);
+
     Font getCommonMenuFont();
 };
 
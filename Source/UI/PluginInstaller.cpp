@@ -37,9 +37,32 @@
 
 //-----------------------------------------------------------------------
 
+/* Connection timeout of the requests to the plugin gateway and the downloads */
+#define PLUGIN_REQUEST_TIMEOUT_MS 10000
+
+/* Archives downloaded at the same time */
+#define PLUGIN_DOWNLOAD_THREADS 4
+
+/* Times a download is resumed after its connection drops */
+#define PLUGIN_DOWNLOAD_ATTEMPTS 3
+
 static juce::String osType;
 StringArray updatablePlugins;
 
+static const juce::String gatewayUrl = "https://open-ephys-plugin-gateway.herokuapp.com/";
+
+/** Reads the response of the plugin gateway, or an empty string if it can't be reached */
+static juce::String fetchGatewayResponse()
+{
+	ScopedPointer<InputStream> stream = URL(gatewayUrl).createInputStream(false, nullptr, nullptr, juce::String(),
+																		   PLUGIN_REQUEST_TIMEOUT_MS);
+
+	if (stream == nullptr)
+		return juce::String();
+
+	return stream->readEntireStreamAsString();
+}
+
 PluginInstaller::PluginInstaller(MainWindow* mainWindow)
 : DocumentWindow(WINDOW_TITLE,
 		Colour(Colours::black),
@@ -152,8 +175,7 @@ void PluginInstaller::createXmlFile()
 
 /* ================================== Plugin Installer Component ================================== */
 
-PluginInstallerComponent::PluginInstallerComponent() : ThreadWithProgressWindow("Plugin Installer", false, false),
-													   checkForUpdates(false)
+PluginInstallerComponent::PluginInstallerComponent() : Thread("Plugin Updates")
 {
 	font = Font("FiraSans", 18, Font::plain);
 	setSize(getWidth() - 10, getHeight() - 10);
@@ -161,8 +183,8 @@ PluginInstallerComponent::PluginInstallerComponent() : ThreadWithProgressWindow(
 	addAndMakeVisible(pluginListAndInfo);
 	
 	//Auto check for updates on startup
-	checkForUpdates = true;
-	this->run();
+	readInstalledPlugins();
+	startThread();
 
 	addAndMakeVisible(sortingLabel);
 	sortingLabel.setColour(Label::textColourId, Colours::white);
@@ -237,6 +259,11 @@ PluginInstallerComponent::PluginInstallerComponent() : ThreadWithProgressWindow(
 	otherType.setToggleState(true, dontSendNotification);
 }
 
+PluginInstallerComponent::~PluginInstallerComponent()
+{
+	stopThread(PLUGIN_REQUEST_TIMEOUT_MS);
+}
+
 void PluginInstallerComponent::paint(Graphics& g)
 {
 	g.fillAll (Colours::darkgrey);
@@ -286,7 +313,7 @@ void PluginInstallerComponent::comboBoxChanged(ComboBox* comboBoxThatHasChanged)
 	}
 }
 
-void PluginInstallerComponent::run()
+bool PluginInstallerComponent::readInstalledPlugins()
 {
 	juce::String fileStr = "plugins" + File::separatorString + "installedPlugins.xml";
 	File xmlFile = CoreServices::getSavedStateDirectory().getChildFile(fileStr);
@@ -297,59 +324,72 @@ void PluginInstallerComponent::run()
 	if (xml == 0 || ! xml->hasTagName("PluginInstaller"))
 	{
 		LOGD("[PluginInstaller] File not found.");
-		return;
+		return false;
 	}
-	else
-	{	
-		installedPlugins.clear();
-		auto child = xml->getFirstChildElement();
 
-		juce::String baseUrl = "https://open-ephys-plugin-gateway.herokuapp.com/";
-		var gatewayData;
-		if (checkForUpdates)
-		{
-			setStatusMessage("Fetching plugin updates...");
-			updatablePlugins.clear();
+	installedPlugins.clear();
+	installedVersions.clear();
+	auto child = xml->getFirstChildElement();
 
-			juce::String response = URL(baseUrl).readEntireTextStream();
+	forEachXmlChildElement(*child, e)
+	{
+		installedPlugins.add(e->getTagName());
+		installedVersions.add(e->getAttributeValue(0));
+	}
 
-			if(response.isEmpty())
-			{
-				LOGD("Unable to fetch updates! Please check you internet connection and try again.")
-				return;
-			}
+	return true;
+}
 
-			juce::Result result = JSON::parse(response, gatewayData);
-			gatewayData = gatewayData.getProperty("plugins", var());
+void PluginInstallerComponent::run()
+{
+	juce::String response = fetchGatewayResponse();
 
-		}
+	if (threadShouldExit())
+		return;
 
-		forEachXmlChildElement(*child, e)
-		{
-			juce::String pName = e->getTagName();
-			installedPlugins.add(pName);
+	if(response.isEmpty())
+	{
+		LOGD("Unable to fetch updates! Please check you internet connection and try again.")
+		return;
+	}
 
-			if (checkForUpdates)
-			{	
-				juce::String latestVer;
+	Component::SafePointer<PluginInstallerComponent> installer(this);
 
-				//Get latest version
-				for (int i = 0; i < gatewayData.size(); i++)
-				{
-					if(gatewayData[i].getProperty("name", "NULL").toString().equalsIgnoreCase(pName))
-					{
-						latestVer = gatewayData[i].getProperty("latest_version", "NULL");
-						break;
-					}
-				}
+	MessageManager::callAsync([installer, response]
+	{
+		if (PluginInstallerComponent* component = installer.getComponent())
+			component->updatePluginVersions(response);
+	});
+}
+
+void PluginInstallerComponent::updatePluginVersions(const String& response)
+{
+	var gatewayData;
+	juce::Result result = JSON::parse(response, gatewayData);
+	gatewayData = gatewayData.getProperty("plugins", var());
 
-				if (latestVer.compareNatural(e->getAttributeValue(0)) > 0)
-					updatablePlugins.add(pName);
+	updatablePlugins.clear();
+
+	for (int n = 0; n < installedPlugins.size(); n++)
+	{
+		juce::String latestVer;
+
+		//Get latest version
+		for (int i = 0; i < gatewayData.size(); i++)
+		{
+			if(gatewayData[i].getProperty("name", "NULL").toString().equalsIgnoreCase(installedPlugins[n]))
+			{
+				latestVer = gatewayData[i].getProperty("latest_version", "NULL");
+				break;
 			}
 		}
 
-		checkForUpdates = false;
+		if (latestVer.compareNatural(installedVersions[n]) > 0)
+			updatablePlugins.add(installedPlugins[n]);
 	}
+
+	pluginListAndInfo.resized();
+	pluginListAndInfo.repaint();
 }
 
 void PluginInstallerComponent::buttonClicked(Button* button)
@@ -362,7 +402,7 @@ void PluginInstallerComponent::buttonClicked(Button* button)
 
 	if(button == &installedButton)
 	{
-		this->run();
+		readInstalledPlugins();
 		
 		pluginListAndInfo.pluginArray.clear();
 		pluginListAndInfo.pluginArray.addArray(installedPlugins);
@@ -376,9 +416,10 @@ void PluginInstallerComponent::buttonClicked(Button* button)
 	}
 	else if(button == &updatesButton)
 	{
-		checkForUpdates = true;
-		this->runThread();
-		pluginListAndInfo.resized();
+		readInstalledPlugins();
+
+		if (!isThreadRunning())
+			startThread();
 	}
 
 	if ( button == &sourceType || button == &filterType || button == &sinkType || button == &otherType)
@@ -447,7 +488,7 @@ void PluginInstallerComponent::buttonClicked(Button* button)
 
 /* ================================== Plugin Table Component ================================== */
 
-PluginListBoxComponent::PluginListBoxComponent() : Thread("Plugin List"), maxTextWidth(0)
+PluginListBoxComponent::PluginListBoxComponent() : Thread("Plugin List"), numRows(0), maxTextWidth(0)
 {
 	listFont = Font("FiraSans Bold", 22, Font::plain);
 
@@ -457,8 +498,6 @@ PluginListBoxComponent::PluginListBoxComponent() : Thread("Plugin List"), maxTex
 	//window->setColour(AlertWindow::backgroundColourId, Colour::fromRGB(50, 50, 50));
 	//setStatusMessage("Fetching plugins ...");
 
-	this->run(); //Load all plugin names and labels from bintray
-
 	addAndMakeVisible(pluginList);
 	pluginList.setModel(this);
 	pluginList.setColour(ListBox::backgroundColourId , Colour::fromRGB(50, 50, 50));
@@ -466,6 +505,15 @@ PluginListBoxComponent::PluginListBoxComponent() : Thread("Plugin List"), maxTex
 	pluginList.setMouseMoveSelectsRows(true);
 
 	addAndMakeVisible(pluginInfoPanel);
+
+	pluginInfoPanel.updateStatusMessage("Fetching plugins...", true);
+
+	startThread(); //Load all plugin names and labels from bintray
+}
+
+PluginListBoxComponent::~PluginListBoxComponent()
+{
+	stopThread(PLUGIN_REQUEST_TIMEOUT_MS);
 }
 
 int PluginListBoxComponent::getNumRows()
@@ -510,12 +558,33 @@ void PluginListBoxComponent::paintListBoxItem (int rowNumber, Graphics &g, int w
 void PluginListBoxComponent::run()
 {
 	/* Get list of plugins uploaded to bintray */
-	juce::String baseUrl = "https://open-ephys-plugin-gateway.herokuapp.com/";
-	juce::String response = URL(baseUrl).readEntireTextStream();
+	juce::String response = fetchGatewayResponse();
+
+	if (threadShouldExit())
+		return;
 
 	if(response.isEmpty())
 		LOGD("Unable to fetch plugins! Please check your internet connection and try again.")
 
+	Component::SafePointer<PluginListBoxComponent> list(this);
+
+	MessageManager::callAsync([list, response]
+	{
+		if (PluginListBoxComponent* component = list.getComponent())
+			component->loadPluginList(response);
+	});
+}
+
+void PluginListBoxComponent::loadPluginList(const String& response)
+{
+	if (response.isEmpty())
+	{
+		pluginInfoPanel.updateStatusMessage("Unable to fetch plugins! Please check your internet connection.", true);
+		return;
+	}
+
+	pluginInfoPanel.updateStatusMessage("Please select a plugin from the list on the left...", true);
+
 	var gatewayData;
 	Result result = JSON::parse(response, gatewayData);
 	
@@ -557,8 +626,8 @@ void PluginListBoxComponent::run()
 		//setProgress ((i + 1) / (double) numRows);
 	}
 	
-    const MessageManagerLock mmLock;
-    setNumRows(pluginArray.size());
+	setNumRows(pluginArray.size());
+	resized();
 }
 
 bool PluginListBoxComponent::loadPluginInfo(const String& pluginName)
@@ -692,7 +761,7 @@ void PluginListBoxComponent::returnKeyPressed (int lastRowSelected)
 
 /* ================================== Plugin Information Component ================================== */
 
-PluginInfoComponent::PluginInfoComponent() : ThreadWithProgressWindow("Plugin Installer", false, false)
+PluginInfoComponent::PluginInfoComponent() : Thread("Plugin Installer"), progressBar(progress), progress(0.0)
 {
 	infoFont = Font("FiraSans", 20, Font::plain);
 	infoFontBold = Font("FiraSans Bold", 20, Font::plain);
@@ -765,12 +834,19 @@ PluginInfoComponent::PluginInfoComponent() : ThreadWithProgressWindow("Plugin In
 	documentationButton.setColour(TextButton::buttonColourId, Colours::lightgrey);
 	documentationButton.addListener(this);
 
+	addChildComponent(progressBar);
+
 	addAndMakeVisible(statusLabel);
 	statusLabel.setFont(infoFont);
 	statusLabel.setColour(Label::textColourId, Colours::white);
 	statusLabel.setText("Please select a plugin from the list on the left...", dontSendNotification);
 }
 
+PluginInfoComponent::~PluginInfoComponent()
+{
+	stopThread(PLUGIN_REQUEST_TIMEOUT_MS);
+}
+
 void PluginInfoComponent::paint(Graphics& g)
 {
 	g.fillAll (Colour::fromRGB(50, 50, 50));
@@ -798,6 +874,9 @@ void PluginInfoComponent::resized()
 
 	downloadButton.setBounds(getWidth() - (getWidth() * 0.25) - 20, getHeight() - 60, getWidth() * 0.25, 30);
 	documentationButton.setBounds(20, getHeight() - 60, getWidth() * 0.25, 30);
+
+	progressBar.setBounds(documentationButton.getRight() + 20, getHeight() - 60,
+						  downloadButton.getX() - documentationButton.getRight() - 40, 30);
 	
 	statusLabel.setBounds(10, (getHeight() / 2) - 15, getWidth() - 10, 30);
 }
@@ -806,7 +885,55 @@ void PluginInfoComponent::buttonClicked(Button* button)
 {
 	if (button == &downloadButton)
 	{
-		this->runThread();
+		if (isThreadRunning())
+		{
+			CoreServices::sendStatusMessage("Please wait until " + installInfo.displayName + " is installed.");
+			return;
+		}
+
+		// the signal chain is checked here, so the install thread never touches it
+		if(pInfo.type == "RecordEngine" && AccessClass::getProcessorGraph()->hasRecordNode())
+		{
+			installInfo = pInfo;
+			finishInstall(RECNODE_IN_USE, juce::String(), juce::String());
+			return;
+		}
+		else if(AccessClass::getProcessorGraph()->processorWithSameNameExists(pInfo.displayName))
+		{
+			installInfo = pInfo;
+			finishInstall(PLUGIN_IN_USE, juce::String(), juce::String());
+			return;
+		}
+
+		installInfo = pInfo;
+		archives.clearQuick();
+
+		// If a plugin has depencies outside its zip, download them
+		for (int i = 0; i < installInfo.dependencies.size(); i++)
+		{
+			Archive dependency;
+			dependency.plugin = installInfo.dependencies[i];
+			dependency.version = installInfo.dependencyVersions[i];
+			dependency.isDependency = true;
+			dependency.file = getArchiveFile(dependency.plugin, dependency.version);
+			archives.add(dependency);
+		}
+
+		Archive plugin;
+		plugin.plugin = installInfo.pluginName;
+		plugin.version = installInfo.selectedVersion;
+		plugin.isDependency = false;
+		plugin.file = getArchiveFile(plugin.plugin, plugin.version);
+		archives.add(plugin);
+
+		downloadButton.setEnabled(false);
+		downloadButton.setButtonText("Installing...");
+
+		progress = 0.0;
+		progressBar.setTextToDisplay("Downloading " + installInfo.displayName + " ...");
+		progressBar.setVisible(true);
+
+		startThread();
 	}
 	else if (button == &documentationButton)
 	{
@@ -822,56 +949,114 @@ void PluginInfoComponent::setDownloadURL(const String& url)
 
 void PluginInfoComponent::run()
 {
-	LOGD("\nDownloading Plugin: ", pInfo.pluginName, "...  ");
+	LOGD("\nDownloading Plugin: ", installInfo.pluginName, "...  ");
 
-	// If a plugin has depencies outside its zip, download them
-	for (int i = 0; i < pInfo.dependencies.size(); i++)
-	{
-		setStatusMessage("Downloading dependency: " + pInfo.dependencies[i]);
+	// the archives are all downloaded at once, then installed one by one, the dependencies first
+	const int failedDownload = downloadArchives();
+
+	if (threadShouldExit())
+		return;
 
-		int retCode = downloadPlugin(pInfo.dependencies[i], pInfo.dependencyVersions[i], true);
+	int returnCode = ZIP_NOTFOUND;
+	juce::String failedDependency;
+	juce::String libName;
+
+	if (failedDownload >= 0)
+	{
+		if (archives[failedDownload].isDependency)
+			failedDependency = archives[failedDownload].plugin;
+	}
+	else
+	{
+		progress = -1.0;
 
-		if (retCode == 2)
+		for (const Archive& archive : archives)
 		{
-			AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-											"[Plugin Installer] " + pInfo.dependencies[i], 
-											"Could not install dependency: " + pInfo.dependencies[i] 
-											+ ". Please contact the developers.");
-			
-			LOGD("Download Failed!!");
-			return;
+			setInstallStatus("Installing " + (archive.isDependency ? archive.plugin : installInfo.displayName) + " ...");
+
+			int retCode = installArchive(archive, libName);
+
+			if (archive.isDependency && retCode == UNCMP_ERR)
+			{
+				failedDependency = archive.plugin;
+				break;
+			}
+
+			if (!archive.isDependency)
+				returnCode = retCode;
 		}
 	}
-	
-	setStatusMessage("Downloading " + pInfo.displayName + " ...");
 
-	// download the plugin
-	int dlReturnCode = downloadPlugin(pInfo.pluginName, pInfo.selectedVersion, false);
+	Component::SafePointer<PluginInfoComponent> panel(this);
 
-	if (dlReturnCode == SUCCESS)
-	{	
-		AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
-										pInfo.displayName + " Installed Successfully");
+	MessageManager::callAsync([panel, returnCode, failedDependency, libName]
+	{
+		if (PluginInfoComponent* component = panel.getComponent())
+			component->finishInstall(returnCode, failedDependency, libName);
+	});
+}
 
-		LOGD("Download Successfull!!");
+void PluginInfoComponent::setInstallStatus(const juce::String& text)
+{
+	Component::SafePointer<PluginInfoComponent> panel(this);
 
-		pInfo.installedVersion = pInfo.selectedVersion;
-		downloadButton.setEnabled(false);
-		downloadButton.setButtonText("Installed");
+	MessageManager::callAsync([panel, text]
+	{
+		if (PluginInfoComponent* component = panel.getComponent())
+			component->progressBar.setTextToDisplay(text);
+	});
+}
 
-		if(pInfo.latestVersion.equalsIgnoreCase(pInfo.latestVersion))
+void PluginInfoComponent::finishInstall(int dlReturnCode, const juce::String& failedDependency, const juce::String& libName)
+{
+	progressBar.setVisible(false);
+
+	if (failedDependency.isNotEmpty())
+	{
+		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
+										"[Plugin Installer] " + failedDependency, 
+										"Could not install dependency: " + failedDependency 
+										+ ". Please contact the developers.");
+		
+		LOGD("Download Failed!!");
+
+		if (!pInfo.versions.isEmpty())
+			comboBoxChanged(&versionMenu);
+		return;
+	}
+
+	// if the plugin is not a dependency, load the plugin and show it in processor list	
+	if (dlReturnCode == SUCCESS)
+	{
+		int loadPlugin = AccessClass::getPluginManager()->loadPlugin(libName);
+
+		if (loadPlugin == -1)
 		{
-			updatablePlugins.removeString(pInfo.pluginName);
-			this->getParentComponent()->resized();
+			dlReturnCode = LOAD_ERR;
+		}
+		else
+		{
+			AccessClass::getProcessorList()->fillItemList();
+			AccessClass::getProcessorList()->repaint();
+
+			if(installInfo.type == "Record Engine")
+				AccessClass::getControlPanel()->updateRecordEngineList();
 		}
-		
+	}
+
+	if (dlReturnCode == SUCCESS)
+	{	
+		AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon, 
+										"[Plugin Installer] " + installInfo.displayName, 
+										installInfo.displayName + " Installed Successfully");
+
+		LOGD("Download Successfull!!");
 	}
 	else if (dlReturnCode == ZIP_NOTFOUND)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
-										"Could not find the ZIP file for " + pInfo.displayName 
+										"[Plugin Installer] " + installInfo.displayName, 
+										"Could not find the ZIP file for " + installInfo.displayName 
 										+ ". Please contact the developers.");
 
 		LOGD("Download Failed!!");
@@ -879,7 +1064,7 @@ void PluginInfoComponent::run()
 	else if (dlReturnCode == UNCMP_ERR)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
+										"[Plugin Installer] " + installInfo.displayName, 
 										"Could not uncompress the ZIP file. Please try again.");
 
 		LOGD("Download Failed!!");
@@ -887,7 +1072,7 @@ void PluginInfoComponent::run()
 	else if (dlReturnCode == XML_MISSING)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
+										"[Plugin Installer] " + installInfo.displayName, 
 										"Unable to locate installedPlugins.xml \n Please restart Plugin Installer and try again.");
 
 		LOGD("XML File Missing!!");
@@ -895,8 +1080,8 @@ void PluginInfoComponent::run()
 	else if (dlReturnCode == VER_EXISTS_ERR)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
-										pInfo.displayName + " v" + pInfo.selectedVersion 
+										"[Plugin Installer] " + installInfo.displayName, 
+										installInfo.displayName + " v" + installInfo.selectedVersion 
 										+ " already exists. Please download another version.");
 
 		LOGD("Download Failed!!");
@@ -904,7 +1089,7 @@ void PluginInfoComponent::run()
 	else if (dlReturnCode == XML_WRITE_ERR)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
+										"[Plugin Installer] " + installInfo.displayName, 
 										"Unable to write to installedPlugins.xml \n Please try again.");
 		
 		LOGD("Writing to XML Failed!!");
@@ -912,34 +1097,38 @@ void PluginInfoComponent::run()
 	else if (dlReturnCode == LOAD_ERR)
 	{
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
-										"Unable to load " + pInfo.displayName 
+										"[Plugin Installer] " + installInfo.displayName, 
+										"Unable to load " + installInfo.displayName 
 										+ " in the Processor List.\nLook at console output for more details.");
 
 		LOGD("Loading Plugin Failed!!");
-
-		pInfo.installedVersion = pInfo.selectedVersion;
-        
-        const MessageManagerLock mmLock;
-		downloadButton.setEnabled(false);
-		downloadButton.setButtonText("Installed");
-
-		if(pInfo.latestVersion.equalsIgnoreCase(pInfo.latestVersion))
-		{
-			updatablePlugins.removeString(pInfo.pluginName);
-			this->getParentComponent()->resized();
-		}
 	}
 	else if (dlReturnCode == PLUGIN_IN_USE || dlReturnCode == RECNODE_IN_USE)
 	{
-		String name = (dlReturnCode == PLUGIN_IN_USE) ? pInfo.displayName : "Record Node";
+		String name = (dlReturnCode == PLUGIN_IN_USE) ? installInfo.displayName : "Record Node";
 		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, 
-										"[Plugin Installer] " + pInfo.displayName, 
+										"[Plugin Installer] " + installInfo.displayName, 
 										name + " is already in use. Please remove it from the signal chain and try again.");
 
 		LOGD("Error.. Plugin already in use. Please remove it from the signal chain and try again.");
 	}
 
+	if (dlReturnCode == SUCCESS || dlReturnCode == LOAD_ERR)
+	{
+		// another plugin may have been selected during the install
+		if (pInfo.pluginName == installInfo.pluginName)
+			pInfo.installedVersion = installInfo.selectedVersion;
+
+		if(installInfo.latestVersion.equalsIgnoreCase(installInfo.selectedVersion))
+		{
+			updatablePlugins.removeString(installInfo.pluginName);
+			this->getParentComponent()->resized();
+		}
+	}
+
+	// restores the install button of the selected plugin
+	if (!pInfo.versions.isEmpty())
+		comboBoxChanged(&versionMenu);
 }
  
 
@@ -1038,59 +1227,79 @@ void PluginInfoComponent::makeInfoVisible(bool isEnabled)
 	documentationButton.setVisible(isEnabled);
 }
 
-int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::String& version, bool isDependency) 
+URL PluginInfoComponent::getArchiveURL(const juce::String& plugin, const juce::String& version) const
 {
-
 	juce::String fileDownloadURL = downloadURL;
 	fileDownloadURL = fileDownloadURL.replace("<plugin-name>", plugin);
 	fileDownloadURL = fileDownloadURL.replace("<platform>", osType);
 	fileDownloadURL = fileDownloadURL.replace("<version>", version);
 
-	juce::String filename = plugin + "-" + osType + "_" + version + ".zip";
+	return URL(fileDownloadURL);
+}
 
-	//Unzip plugin and install in plugins directory
-	//curl -L https://dl.bintray.com/$bintrayUser/$repo/$filename
+File PluginInfoComponent::getArchiveFile(const juce::String& plugin, const juce::String& version) const
+{
+	juce::String filename = plugin + "-" + osType + "_" + version + ".zip";
 
-	URL fileUrl(fileDownloadURL);
+	return CoreServices::getSavedStateDirectory().getChildFile("plugin-downloads").getChildFile(filename);
+}
 
-	int statusC;
-	StringPairArray responseHeaders;
+int PluginInfoComponent::downloadArchives()
+{
+	archives.getReference(0).file.getParentDirectory().createDirectory();
 
-	//Create input stream from the plugin's zip file URL
-	ScopedPointer<InputStream> fileStream = fileUrl.createInputStream(false, nullptr, nullptr, juce::String(), 1000, &responseHeaders, &statusC, 5, juce::String());		
-	juce::String newLocation = responseHeaders.getValue("Location", "NULL");
+	ThreadPool pool(PLUGIN_DOWNLOAD_THREADS);
+	OwnedArray<PluginDownloadJob> jobs;
 
-	// ZIP URL Location changed, use the new location
-	if(newLocation != "NULL")
+	for (const Archive& archive : archives)
 	{
-		fileUrl = newLocation;
-		fileStream = fileUrl.createInputStream(false);
+		jobs.add(new PluginDownloadJob(getArchiveURL(archive.plugin, archive.version), archive.file));
+		pool.addJob(jobs.getLast(), false);
 	}
 
-	// ZIP file empty, return.
-	if(fileStream->getTotalLength() == 0)
-		return 0;
+	while (pool.getNumJobs() > 0)
+	{
+		if (threadShouldExit())
+		{
+			pool.removeAllJobs(true, PLUGIN_REQUEST_TIMEOUT_MS);
+			return -1;
+		}
 
-	//Get path to plugins directory
-	File pluginsPath = CoreServices::getSavedStateDirectory();
+		int64 downloaded = 0;
+		int64 total = 0;
+
+		for (auto job : jobs)
+		{
+			downloaded += job->getDownloadedBytes();
+			total += job->getTotalBytes();
+		}
 
-	//Construct path for downloaded zip file
-	juce::String pluginFilePath = pluginsPath.getFullPathName();
-	pluginFilePath += File::separatorString;
-	pluginFilePath += filename;
+		// until every archive size is known, the bar just shows that something is going on
+		progress = total > 0 && total >= downloaded ? double(downloaded) / double(total) : -1.0;
+
+		wait(100);
+	}
+
+	for (int i = 0; i < jobs.size(); i++)
+	{
+		if (!jobs[i]->succeeded())
+			return i;
+	}
+
+	return -1;
+}
 
-	//Create local file
-	File pluginFile(pluginFilePath);
-	pluginFile.deleteFile();
+int PluginInfoComponent::installArchive(const Archive& archive, juce::String& libName)
+{
+	const juce::String& plugin = archive.plugin;
+	const juce::String& version = archive.version;
+	const bool isDependency = archive.isDependency;
 
-	//Use the Url's input stream and write it to a file using output stream
-	FileOutputStream* out = pluginFile.createOutputStream();
-	out->writeFromInputStream(*fileStream, -1);
-	out->flush();
-	delete out;
+	//Get path to plugins directory
+	File pluginsPath = CoreServices::getSavedStateDirectory();
 
 	//Uncompress zip file contents
-	ZipFile pluginZip(pluginFile);
+	ZipFile pluginZip(archive.file);
 
 	//Get *.dll/*.so name of plugin
 #if JUCE_WINDOWS
@@ -1099,6 +1308,14 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 	auto entry = pluginZip.getEntry(1);
 #endif
 
+	// a broken archive is dropped from the cache, so that it is downloaded again
+	if (entry == nullptr)
+	{
+		LOGD("[PluginInstaller] Invalid archive ", archive.file.getFileName());
+		archive.file.deleteFile();
+		return UNCMP_ERR;
+	}
+
 	// Open installedPluings.xml file
 	juce::String fileStr = "plugins" + File::separatorString + "installedPlugins.xml";
 	File xmlFile = pluginsPath.getChildFile(fileStr);
@@ -1120,8 +1337,7 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 		if (xml == 0 || ! xml->hasTagName("PluginInstaller"))
 		{
 			LOGD("[PluginInstaller] File not found.");
-			pluginFile.deleteFile();
-			return 3;
+			return XML_MISSING;
 		}
 		else
 		{	
@@ -1138,8 +1354,7 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 					if (e->getAttributeValue(0).equalsIgnoreCase(pluginEntry->getAttributeValue(0)))
 					{
 						LOGD(plugin, " v", version, " already exists!!");
-						pluginFile.deleteFile();
-						return 4;
+						return VER_EXISTS_ERR;
 					}
 					else 
 					{
@@ -1154,18 +1369,6 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 				child->addChildElement(pluginEntry.release());
 
 		}
-
-		// Check if plugin already present in signal chain
-		if(pInfo.type == "RecordEngine" && AccessClass::getProcessorGraph()->hasRecordNode())
-		{
-			pluginFile.deleteFile();
-			return 8;
-		}
-		else if(AccessClass::getProcessorGraph()->processorWithSameNameExists(pInfo.displayName))
-		{
-			pluginFile.deleteFile();
-			return 7;	
-		}
 	}
 
 	// Uncompress the downloaded plugin's zip file
@@ -1192,8 +1395,7 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 				if(rs.failed())
 				{
 					LOGD(rs.getErrorMessage());
-					pluginFile.deleteFile();
-					return 2;
+					return UNCMP_ERR;
 				}
 			}
 			else
@@ -1206,38 +1408,145 @@ int PluginInfoComponent::downloadPlugin(const juce::String& plugin, const juce::
 		else
 		{
 			LOGD(rs.getErrorMessage());
-			pluginFile.deleteFile(); // delete zip after uncompressing
-			return 2;
+			archive.file.deleteFile();
+			return UNCMP_ERR;
 		}
 	}
 
-	pluginFile.deleteFile(); // delete zip after uncompressing
+	// keep only the archive of the installed version in the cache
+	Array<File> cached;
+	archive.file.getParentDirectory().findChildFiles(cached, File::findFiles, false, plugin + "-" + osType + "_*.zip");
+
+	for (auto& file : cached)
+	{
+		if (file != archive.file)
+			file.deleteFile();
+	}
 
-	// if the plugin is not a dependency, load the plugin and show it in processor list	
 	if (!isDependency)
 	{
 		// Write installed plugin's info to XML file
 		if (! xml->writeToFile(xmlFile, juce::String::empty))
 		{
 			LOGD("Error! Couldn't write to installedPlugins.xml");
-			return 5;
+			return XML_WRITE_ERR;
 		}
 		
-		juce::String libName = pluginsPath.getFullPathName() + File::separatorString + entry->filename;
+		libName = pluginsPath.getFullPathName() + File::separatorString + entry->filename;
+	}
 
-		int loadPlugin = AccessClass::getPluginManager()->loadPlugin(libName);
+	return SUCCESS;
 
-		if (loadPlugin == -1)
-			return 6;
+}
 
-		AccessClass::getProcessorList()->fillItemList();
-		AccessClass::getProcessorList()->repaint();
 
-		if(pInfo.type == "Record Engine")
-			AccessClass::getControlPanel()->updateRecordEngineList();
-		
+/* ================================== Plugin Download Job ================================== */
+
+PluginDownloadJob::PluginDownloadJob(const URL& url_, const File& archive_)
+	: ThreadPoolJob("Plugin Download"),
+	  url(url_),
+	  archive(archive_),
+	  success(false),
+	  downloadedBytes(0),
+	  totalBytes(-1)
+{
+}
+
+ThreadPoolJob::JobStatus PluginDownloadJob::runJob()
+{
+	// archives of a given version never change, so a cached one is used as it is
+	if (archive.existsAsFile())
+	{
+		downloadedBytes = totalBytes = archive.getSize();
+		success = true;
+		return jobHasFinished;
 	}
 
-	return 1;
+	// the download goes to a part file first, which a later attempt resumes
+	File partFile = archive.getSiblingFile(archive.getFileName() + ".part");
+
+	for (int attempt = 0; attempt < PLUGIN_DOWNLOAD_ATTEMPTS && !shouldExit(); attempt++)
+	{
+		const int64 resumeFrom = partFile.getSize();
+		const juce::String rangeHeader = resumeFrom > 0 ? "Range: bytes=" + juce::String(resumeFrom) + "-" : juce::String();
+
+		int statusCode = 0;
+		StringPairArray responseHeaders;
+
+		ScopedPointer<InputStream> fileStream = url.createInputStream(false, nullptr, nullptr, rangeHeader, PLUGIN_REQUEST_TIMEOUT_MS,
+																	  &responseHeaders, &statusCode, 5, juce::String());
+		juce::String newLocation = responseHeaders.getValue("Location", "NULL");
+
+		// ZIP URL Location changed, use the new location
+		if(newLocation != "NULL")
+		{
+			url = URL(newLocation);
+			fileStream = url.createInputStream(false, nullptr, nullptr, rangeHeader, PLUGIN_REQUEST_TIMEOUT_MS,
+											   &responseHeaders, &statusCode, 5, juce::String());
+		}
+
+		if (fileStream == nullptr)
+			continue;
+
+		// the part file is longer than the archive: start over
+		if (statusCode == 416)
+		{
+			partFile.deleteFile();
+			continue;
+		}
+
+		if (statusCode >= 400)
+			break;
+
+		// servers that ignore the range send the whole archive again
+		const bool resumed = resumeFrom > 0 && statusCode == 206;
+
+		if (!resumed)
+			partFile.deleteFile();
+
+		const int64 offset = resumed ? resumeFrom : 0;
+		const int64 length = fileStream->getTotalLength();
+
+		downloadedBytes = offset;
+		totalBytes = length >= 0 ? offset + length : -1;
+
+		{
+			FileOutputStream out(partFile);
+
+			if (out.failedToOpen())
+				break;
+
+			HeapBlock<char> buffer(65536);
+
+			while (!fileStream->isExhausted())
+			{
+				if (shouldExit())
+					return jobHasFinished;
+
+				const int numRead = fileStream->read(buffer, 65536);
+
+				if (numRead <= 0)
+					break;
+
+				out.write(buffer, (size_t) numRead);
+				downloadedBytes += numRead;
+			}
+
+			out.flush();
+		}
+
+		// the connection dropped before the end: resume it
+		if (totalBytes.get() >= 0 && downloadedBytes.get() < totalBytes.get())
+			continue;
+
+		// ZIP file empty
+		if (downloadedBytes.get() == 0)
+			break;
+
+		success = partFile.moveFileTo(archive);
+		return jobHasFinished;
+	}
 
+	LOGD("[PluginInstaller] Could not download ", archive.getFileName());
+	return jobHasFinished;
 }
@@ -64,16 +64,48 @@ struct SelectedPluginInfo
 
 extern StringArray updatablePlugins;
 
+/**
+ *  Downloads a plugin archive into the download cache, resuming a partial
+ *  download from where it stopped with an HTTP range request. Archives that
+ *  are already in the cache are not downloaded again.
+*/
+class PluginDownloadJob : public ThreadPoolJob
+{
+public:
+	PluginDownloadJob(const URL& url, const File& archive);
+
+	JobStatus runJob() override;
+
+	/** True once the whole archive is in the cache */
+	bool succeeded() const { return success; }
+
+	int64 getDownloadedBytes() const { return downloadedBytes.get(); }
+
+	/** Size of the archive, or -1 while it isn't known */
+	int64 getTotalBytes() const { return totalBytes.get(); }
+
+private:
+	URL url;
+	File archive;
+
+	bool success;
+	Atomic<int64> downloadedBytes;
+	Atomic<int64> totalBytes;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginDownloadJob);
+};
+
 /**
  *  Create Info Panel for the selected plugin from the table
 */
 class PluginInfoComponent : public Component,
                             public Button::Listener,
                             public ComboBox::Listener,
-                            public ThreadWithProgressWindow
+                            public Thread
 {
 public:
     PluginInfoComponent();
+    ~PluginInfoComponent();
 
     void paint (Graphics&) override;
     void resized() override;
@@ -92,10 +124,6 @@ public:
     /** Make the selected plugin's info visible **/
     void makeInfoVisible(bool isEnabled);
 
-    /** Called when the user hits the 'Download' button for a selected plugin **/
-    int downloadPlugin(const String& plugin, const String& version,
-                       bool isDependency);
-    
     void setDownloadURL(const String& url);
 
 private:
@@ -118,10 +146,44 @@ private:
 
     ComboBox versionMenu;
 
+    ProgressBar progressBar;
+    double progress;
+
     SelectedPluginInfo pInfo;
 
+    /** The plugin being installed, which stays the same if another one is selected meanwhile */
+    SelectedPluginInfo installInfo;
+
+    struct Archive
+    {
+        String plugin;
+        String version;
+        bool isDependency;
+        File file;
+    };
+
+    /** The dependencies and the plugin of the running install, in install order */
+    Array<Archive> archives;
+
     enum RetunCode {ZIP_NOTFOUND, SUCCESS, UNCMP_ERR, XML_MISSING, VER_EXISTS_ERR, XML_WRITE_ERR, LOAD_ERR, PLUGIN_IN_USE, RECNODE_IN_USE};
 
+    URL getArchiveURL(const String& plugin, const String& version) const;
+    File getArchiveFile(const String& plugin, const String& version) const;
+
+    /** Downloads all archives at once, and returns the index of the first that failed, or -1 */
+    int downloadArchives();
+
+    /** Uncompresses an archive into the plugins directory and records it in installedPlugins.xml.
+        Returns SUCCESS with the library to load in libName, or an error code */
+    int installArchive(const Archive& archive, String& libName);
+
+    /** Shows the progress of the install. Called from the install thread. */
+    void setInstallStatus(const String& text);
+
+    /** Loads the installed plugin and reports the result. Called on the message thread. */
+    void finishInstall(int returnCode, const String& failedDependency, const String& libName);
+
+    /** Downloads and installs the archives, off the message thread */
     void run() override;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginInfoComponent);
@@ -139,6 +201,7 @@ class PluginListBoxComponent : public Component,
 public:
 
     PluginListBoxComponent();
+    ~PluginListBoxComponent();
 
     /* Raw list of plugins available for download */
     StringArray pluginArray;
@@ -175,6 +238,10 @@ private:
 
     PluginInfoComponent pluginInfoPanel;
 
+    /** Fills the list from the gateway's response. Called on the message thread. */
+    void loadPluginList(const String& response);
+
+    /** Fetches the list of plugins, off the message thread */
     void run() override;
 
     // Loads selected plugin's info from bintray
@@ -194,11 +261,12 @@ private:
 class PluginInstallerComponent : public Component,
                                  public ComboBox::Listener,
                                  public Button::Listener,
-                                 public ThreadWithProgressWindow
+                                 public Thread
 {
 public:
 
     PluginInstallerComponent();
+    ~PluginInstallerComponent();
 
     void paint (Graphics&) override;
     void resized() override;
@@ -213,8 +281,7 @@ private:
 
     StringArray allPlugins;
     StringArray installedPlugins;
-
-    bool checkForUpdates;
+    StringArray installedVersions;
 
     Label sortingLabel;
     ComboBox sortByMenu;
@@ -228,6 +295,13 @@ private:
 
     Font font;
 
+    /** Reads the installed plugins from installedPlugins.xml */
+    bool readInstalledPlugins();
+
+    /** Marks the installed plugins that have a newer version. Called on the message thread. */
+    void updatePluginVersions(const String& response);
+
+    /** Fetches the latest versions of the plugins, off the message thread */
     void run() override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginInstallerComponent);
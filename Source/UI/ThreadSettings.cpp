@@ -0,0 +1,160 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ThreadSettings.h"
+#include "../Utils/ThreadConfig.h"
+
+#define THREAD_SETTINGS_ROW_HEIGHT 30
+#define THREAD_SETTINGS_FIRST_ROW 60
+
+ThreadSettingsWindow::ThreadSettingsWindow()
+	: DocumentWindow("Thread scheduling", Colours::red,
+	DocumentWindow::closeButton)
+{
+	setUsingNativeTitleBar(true);
+	setResizable(false, false);
+	m_settingsComponent = new ThreadSettingsComponent();
+	setContentNonOwned(m_settingsComponent, true);
+	centreWithSize(m_settingsComponent->getWidth(), m_settingsComponent->getHeight());
+}
+
+ThreadSettingsWindow::~ThreadSettingsWindow()
+{
+	masterReference.clear();
+}
+
+void ThreadSettingsWindow::updateSettings()
+{
+	m_settingsComponent->updateSettings();
+}
+
+void ThreadSettingsWindow::closeButtonPressed()
+{
+	setVisible(false);
+	delete this;
+}
+
+//Component
+ThreadSettingsComponent::ThreadSettingsComponent()
+{
+	setSize(400, THREAD_SETTINGS_FIRST_ROW + (ThreadConfig::NUM_ROLES + 1) * THREAD_SETTINGS_ROW_HEIGHT + 60);
+
+	for (int role = 0; role < ThreadConfig::NUM_ROLES; role++)
+	{
+		const int y = THREAD_SETTINGS_FIRST_ROW + role * THREAD_SETTINGS_ROW_HEIGHT;
+
+		Label* label = new Label("Role", ThreadConfig::getRoleName(ThreadConfig::Role(role)));
+		label->setBounds(10, y, 110, 24);
+		addAndMakeVisible(label);
+		m_roleLabels.add(label);
+
+		ComboBox* selector = new ComboBox("Priority");
+		selector->addItem("Default", 1);
+		for (int priority = 0; priority <= THREAD_REALTIME_PRIORITY; priority++)
+			selector->addItem(priority == THREAD_REALTIME_PRIORITY ? String(priority) + " (real-time)" : String(priority), priority + 2);
+		selector->setBounds(125, y, 120, 24);
+		selector->addListener(this);
+		addAndMakeVisible(selector);
+		m_prioritySelectors.add(selector);
+
+		TextEditor* editor = new TextEditor("Cores");
+		editor->setBounds(255, y, 135, 24);
+		editor->setTooltip("Cores the threads may run on, e.g. 2,3 or 4-7; all for any");
+		editor->addListener(this);
+		addAndMakeVisible(editor);
+		m_coreEditors.add(editor);
+	}
+
+	m_isolateButton = new ToggleButton("Keep other threads off the acquisition cores");
+	m_isolateButton->setBounds(10, THREAD_SETTINGS_FIRST_ROW + ThreadConfig::NUM_ROLES * THREAD_SETTINGS_ROW_HEIGHT + 5, 380, 24);
+	m_isolateButton->addListener(this);
+	addAndMakeVisible(m_isolateButton);
+
+	updateSettings();
+}
+
+ThreadSettingsComponent::~ThreadSettingsComponent()
+{}
+
+void ThreadSettingsComponent::updateSettings()
+{
+	for (int role = 0; role < ThreadConfig::NUM_ROLES; role++)
+	{
+		m_prioritySelectors[role]->setSelectedId(ThreadConfig::getPriority(ThreadConfig::Role(role)) + 2, dontSendNotification);
+		m_coreEditors[role]->setText(ThreadConfig::coresToString(ThreadConfig::getCores(ThreadConfig::Role(role))), false);
+	}
+
+	m_isolateButton->setToggleState(ThreadConfig::getIsolateAcquisition(), dontSendNotification);
+}
+
+void ThreadSettingsComponent::comboBoxChanged(ComboBox* c)
+{
+	const int role = m_prioritySelectors.indexOf(c);
+
+	if (role >= 0)
+		ThreadConfig::setPriority(ThreadConfig::Role(role), c->getSelectedId() - 2);
+}
+
+void ThreadSettingsComponent::applyCores(TextEditor& editor)
+{
+	const int role = m_coreEditors.indexOf(&editor);
+
+	if (role < 0)
+		return;
+
+	ThreadConfig::setCores(ThreadConfig::Role(role), ThreadConfig::parseCores(editor.getText()));
+
+	// show the cores as they were understood
+	editor.setText(ThreadConfig::coresToString(ThreadConfig::getCores(ThreadConfig::Role(role))), false);
+}
+
+void ThreadSettingsComponent::textEditorReturnKeyPressed(TextEditor& editor)
+{
+	applyCores(editor);
+}
+
+void ThreadSettingsComponent::textEditorFocusLost(TextEditor& editor)
+{
+	applyCores(editor);
+}
+
+void ThreadSettingsComponent::buttonClicked(Button* button)
+{
+	if (button == m_isolateButton)
+		ThreadConfig::setIsolateAcquisition(button->getToggleState());
+}
+
+void ThreadSettingsComponent::paint(Graphics& g)
+{
+	g.setColour(Colours::darkgrey);
+	g.fillAll();
+	g.setColour(Colours::black);
+	g.drawMultiLineText("Priority and cores of the threads of each role. Threads pick up changes "
+		"the next time they start, or with the next block while acquiring.",
+		10, 20, 380);
+	g.drawText("Priority", 125, THREAD_SETTINGS_FIRST_ROW - 20, 120, 18, Justification::left);
+	g.drawText("Cores", 255, THREAD_SETTINGS_FIRST_ROW - 20, 135, 18, Justification::left);
+	g.drawMultiLineText("The settings are saved with the signal chain.",
+		10, THREAD_SETTINGS_FIRST_ROW + (ThreadConfig::NUM_ROLES + 1) * THREAD_SETTINGS_ROW_HEIGHT + 20, 380);
+}
@@ -0,0 +1,82 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef THREADSETTINGS_H_INCLUDED
+#define THREADSETTINGS_H_INCLUDED
+
+#include <JuceHeader.h>
+
+/**
+	Edits the priority and cores of each thread role of the ThreadConfig.
+
+	@see ThreadConfig
+*/
+class ThreadSettingsComponent :
+	public Component,
+	public ComboBox::Listener,
+	public TextEditor::Listener,
+	public Button::Listener
+{
+public:
+	ThreadSettingsComponent();
+	~ThreadSettingsComponent();
+	void paint(Graphics& g) override;
+	void comboBoxChanged(ComboBox*) override;
+	void textEditorReturnKeyPressed(TextEditor&) override;
+	void textEditorFocusLost(TextEditor&) override;
+	void buttonClicked(Button*) override;
+
+	/** Shows the settings of the ThreadConfig, after a configuration was loaded */
+	void updateSettings();
+
+private:
+	void applyCores(TextEditor& editor);
+
+	OwnedArray<Label> m_roleLabels;
+	OwnedArray<ComboBox> m_prioritySelectors;
+	OwnedArray<TextEditor> m_coreEditors;
+	ScopedPointer<ToggleButton> m_isolateButton;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadSettingsComponent);
+};
+
+class ThreadSettingsWindow :
+	public DocumentWindow
+{
+public:
+	ThreadSettingsWindow();
+	~ThreadSettingsWindow();
+	void updateSettings();
+	void closeButtonPressed() override;
+
+private:
+	ScopedPointer<ThreadSettingsComponent> m_settingsComponent;
+
+	WeakReference<ThreadSettingsWindow>::Master masterReference;
+	friend class WeakReference<ThreadSettingsWindow>;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadSettingsWindow);
+};
+
+#endif
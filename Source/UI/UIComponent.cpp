@@ -35,7 +35,9 @@
 #include "GraphViewer.h"
 #include "../Processors/ProcessorGraph/ProcessorGraph.h"
 #include "../Audio/AudioComponent.h"
+#include "../Processors/Events/SpikeStore.h"
 #include "../MainWindow.h"
+#include "../Utils/StartupTrace.h"
 
 	UIComponent::UIComponent(MainWindow* mainWindow_, ProcessorGraph* pgraph, AudioComponent* audio_)
 : mainWindow(mainWindow_), processorGraph(pgraph), audio(audio_), messageCenterIsCollapsed(true)
@@ -48,6 +50,7 @@
 	addActionListener(messageCenterEditor);
 	
 LOGD("Created message center.");
+	StartupTrace::mark("default nodes");
 
 	infoLabel = new InfoLabel();
 LOGD("Created info label.");
@@ -69,6 +72,7 @@ LOGD("Created data viewport.");
 	//addAndMakeVisible(editorViewport);
     
 LOGD("Created editor viewport.");
+	StartupTrace::mark("viewports");
 
 	editorViewportButton = new EditorViewportButton(this);
 	addAndMakeVisible(editorViewportButton);
@@ -77,6 +81,7 @@ LOGD("Created editor viewport.");
 	addAndMakeVisible(controlPanel);
     
 LOGD("Created control panel.");
+	StartupTrace::mark("control panel");
 
 	processorList = new ProcessorList();
 	processorListViewport.setViewedComponent(processorList,false);
@@ -99,11 +104,13 @@ LOGD("Created plugin manager");
 	AccessClass::setUIComponent(this);
 
 	getPluginManager()->loadAllPlugins();
+	StartupTrace::mark("plugins");
 
 	getProcessorList()->fillItemList();
 	controlPanel->updateChildComponents();
 
 	processorGraph->updatePointers(); // needs to happen after processorGraph gets the right pointers
+	StartupTrace::mark("processor list");
 
 #if JUCE_MAC
 	MenuBarModel::setMacMainMenu(this);
@@ -120,6 +127,8 @@ UIComponent::~UIComponent()
 	dataViewport->destroyTab(0); // get rid of tab for InfoLabel
 	if (timestampWindow)
 		delete timestampWindow;
+	if (threadSettingsWindow)
+		delete threadSettingsWindow;
 	AccessClass::shutdownBroadcaster();
 }
 
@@ -426,6 +435,9 @@ PopupMenu UIComponent::getMenuForIndex(int menuIndex, const String& menuName)
 		menu.addCommandItem(commandManager, clearSignalChain);
 		menu.addSeparator();
 		menu.addCommandItem(commandManager, openTimestampSelectionWindow);
+		menu.addCommandItem(commandManager, openThreadSettingsWindow);
+		menu.addCommandItem(commandManager, toggleCompactSpikes);
+		menu.addCommandItem(commandManager, toggleParallelRendering);
 
 	}
 	else if (menuIndex == 2)
@@ -481,6 +493,9 @@ void UIComponent::getAllCommands(Array <CommandID>& commands)
 		showHelp,
 		resizeWindow,
 		openTimestampSelectionWindow,
+		openThreadSettingsWindow,
+		toggleCompactSpikes,
+		toggleParallelRendering,
 		openPluginInstaller
 	};
 
@@ -578,6 +593,22 @@ void UIComponent::getCommandInfo(CommandID commandID, ApplicationCommandInfo& re
 			result.setInfo("Timestamp Source", "Show timestamp source selection window.", "General", 0);
 			break;
 
+		case openThreadSettingsWindow:
+			result.setInfo("Thread Scheduling", "Show the priority and cores of the threads.", "General", 0);
+			break;
+
+		case toggleCompactSpikes:
+			result.setInfo("Compact spike messages", "Pass spikes between processors as handles to a shared store.", "General", 0);
+			result.setActive(!acquisitionStarted);
+			result.setTicked(SpikeStore::getInstance()->isEnabled());
+			break;
+
+		case toggleParallelRendering:
+			result.setInfo("Parallel rendering", "Render independent branches of the signal chain on extra threads.", "General", 0);
+			result.setActive(!acquisitionStarted);
+			result.setTicked(processorGraph->isParallelRendering());
+			break;
+
 		case openPluginInstaller:
 			result.setInfo("Plugin Installer", "Launch the plugin installer.", "General", 0);
 			result.addDefaultKeypress('P', ModifierKeys::commandModifier);
@@ -721,6 +752,14 @@ bool UIComponent::perform(const InvocationInfo& info)
 			}
 			break;
 
+		case toggleCompactSpikes:
+			SpikeStore::getInstance()->setEnabled(!SpikeStore::getInstance()->isEnabled());
+			break;
+
+		case toggleParallelRendering:
+			processorGraph->setParallelRendering(!processorGraph->isParallelRendering());
+			break;
+
         case undo:
             {
                 getEditorViewport()->undo();
@@ -783,6 +822,15 @@ bool UIComponent::perform(const InvocationInfo& info)
 			timestampWindow->toFront(true);
 			break;
 
+		case openThreadSettingsWindow:
+			if (threadSettingsWindow == nullptr)
+			{
+				threadSettingsWindow = new ThreadSettingsWindow();
+			}
+			threadSettingsWindow->setVisible(true);
+			threadSettingsWindow->toFront(true);
+			break;
+
 		case openPluginInstaller:
 			{
 				if (pluginInstaller == nullptr)
@@ -813,6 +861,10 @@ void UIComponent::saveStateToXml(XmlElement* xml)
 
 void UIComponent::loadStateFromXml(XmlElement* xml)
 {
+	// the thread settings have been loaded with the signal chain
+	if (threadSettingsWindow)
+		threadSettingsWindow->updateSettings();
+
 	forEachXmlChildElement(*xml, xmlNode)
 	{
 		if (xmlNode->hasTagName("UICOMPONENT"))
@@ -26,6 +26,7 @@
 
 #include "../../JuceLibraryCode/JuceHeader.h"
 #include "TimestampSourceSelection.h"
+#include "ThreadSettings.h"
 #include "PluginInstaller.h"
 #include "MessageCenterButton.h"
 
@@ -162,6 +163,7 @@ private:
 	ScopedPointer<PluginManager> pluginManager;
 
 	WeakReference<TimestampSourceSelectionWindow> timestampWindow;
+	WeakReference<ThreadSettingsWindow> threadSettingsWindow;
 
     WeakReference<PluginInstaller> pluginInstaller;
 
@@ -203,6 +205,9 @@ private:
         saveSignalChainAs       = 0x2014,
 		openTimestampSelectionWindow = 0x2015,
         openPluginInstaller     = 0x2016,
+        openThreadSettingsWindow = 0x2017,
+        toggleCompactSpikes     = 0x2018,
+        toggleParallelRendering = 0x2019,
         loadPluginSettings      = 0x3001,
         savePluginSettings      = 0x3002
     };
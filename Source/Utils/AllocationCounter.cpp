@@ -0,0 +1,179 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+/* Shortest time between two call stacks sampled for the same processor */
+#define BACKTRACE_SAMPLE_INTERVAL_MS 1000
+
+namespace
+{
+    thread_local bool threadCounted = false;
+    thread_local AllocationTally* threadTally = nullptr;
+    /* Set while a call stack is sampled, whose own allocations aren't counted */
+    thread_local bool sampling = false;
+
+    std::atomic<bool> countingEnabled { false };
+    std::atomic<bool> backtraceSampling { false };
+    std::atomic<int64> allocationCount { 0 };
+
+    inline void* allocate (std::size_t size)
+    {
+        AllocationCounter::allocated();
+        return std::malloc (size == 0 ? 1 : size);
+    }
+}
+
+AllocationTally::AllocationTally()
+    : count (0),
+      lastBacktraceMs (0)
+{
+}
+
+int64 AllocationTally::getCount() const
+{
+    return count.load (std::memory_order_relaxed);
+}
+
+String AllocationTally::getBacktrace() const
+{
+    const SpinLock::ScopedLockType lock (backtraceLock);
+    return backtrace;
+}
+
+void AllocationTally::sampleBacktrace()
+{
+    const uint32 now = Time::getMillisecondCounter();
+    uint32 last = lastBacktraceMs.load (std::memory_order_relaxed);
+
+    if ((last != 0 && now - last < BACKTRACE_SAMPLE_INTERVAL_MS)
+        || ! lastBacktraceMs.compare_exchange_strong (last, now))
+        return;
+
+    sampling = true;
+
+    String stack = SystemStats::getStackBacktrace();
+
+    {
+        const SpinLock::ScopedLockType lock (backtraceLock);
+        backtrace.swapWith (stack);
+    }
+
+    sampling = false;
+}
+
+
+void AllocationCounter::setThreadCounted (bool counted)
+{
+    threadCounted = counted;
+}
+
+AllocationTally* AllocationCounter::setThreadTally (AllocationTally* tally)
+{
+    AllocationTally* previous = threadTally;
+    threadTally = tally;
+    return previous;
+}
+
+AllocationTally* AllocationCounter::getThreadTally()
+{
+    return threadTally;
+}
+
+void AllocationCounter::setEnabled (bool enabled)
+{
+    countingEnabled = enabled;
+}
+
+bool AllocationCounter::isEnabled()
+{
+    return countingEnabled.load();
+}
+
+void AllocationCounter::setBacktraceSampling (bool enabled)
+{
+    backtraceSampling = enabled;
+}
+
+bool AllocationCounter::isBacktraceSampling()
+{
+    return backtraceSampling.load();
+}
+
+int64 AllocationCounter::getCount()
+{
+    return allocationCount.load();
+}
+
+void AllocationCounter::allocated()
+{
+    if (! threadCounted || sampling || ! countingEnabled.load (std::memory_order_relaxed))
+        return;
+
+    allocationCount.fetch_add (1, std::memory_order_relaxed);
+
+    if (threadTally != nullptr)
+    {
+        threadTally->count.fetch_add (1, std::memory_order_relaxed);
+
+        if (backtraceSampling.load (std::memory_order_relaxed))
+            threadTally->sampleBacktrace();
+    }
+}
+
+
+void* operator new (std::size_t size)
+{
+    if (void* p = allocate (size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    if (void* p = allocate (size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate (size);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate (size);
+}
+
+void operator delete (void* p) noexcept                             { std::free (p); }
+void operator delete[] (void* p) noexcept                           { std::free (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept      { std::free (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept    { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept                { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept              { std::free (p); }
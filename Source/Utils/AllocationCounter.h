@@ -0,0 +1,109 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ALLOCATIONCOUNTER_H_INCLUDED
+#define ALLOCATIONCOUNTER_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Processors/PluginManager/OpenEphysPlugin.h"
+
+#include <atomic>
+
+/**
+    The allocations attributed to one processor, with a sample of the call
+    stack of one of them.
+
+    @see AllocationCounter, ProcessTimeProfile
+*/
+class PLUGIN_API AllocationTally
+{
+public:
+    AllocationTally();
+
+    /** Allocations attributed to the processor since the application started */
+    int64 getCount() const;
+
+    /** The call stack of a recent allocation, or an empty string if none was sampled */
+    String getBacktrace() const;
+
+private:
+    friend class AllocationCounter;
+
+    /** Keeps the call stack of the current allocation if the last one is old enough */
+    void sampleBacktrace();
+
+    std::atomic<int64> count;
+    std::atomic<uint32> lastBacktraceMs;
+
+    SpinLock backtraceLock;
+    String backtrace;
+
+    JUCE_DECLARE_NON_COPYABLE (AllocationTally)
+};
+
+/**
+    Counts the heap allocations made by the processing threads.
+
+    The application replaces the global operator new, which adds to the count
+    while counting is enabled and the calling thread has been marked as one
+    that processes blocks: the thread calling the ProcessorGraph, the
+    ChannelWorkerPool workers and the DataThreads. Allocations there can block
+    on the allocator's locks, so a healthy signal chain makes none once
+    acquisition is running.
+
+    While a thread works for a processor, its allocations are also added to that
+    processor's AllocationTally, which samples the call stack of one allocation
+    per second so the CPUBreakdown can show where they come from.
+
+    @see PipelineBenchmark, CPUBreakdown
+*/
+class PLUGIN_API AllocationCounter
+{
+public:
+    /** Marks the calling thread as a processing thread, or not */
+    static void setThreadCounted (bool counted);
+
+    /** Attributes the allocations of the calling thread to a processor, or to none
+        if tally is null, and returns the tally it replaces */
+    static AllocationTally* setThreadTally (AllocationTally* tally);
+
+    /** The tally the allocations of the calling thread go to */
+    static AllocationTally* getThreadTally();
+
+    /** Counting is off by default, so the allocations only cost a flag check */
+    static void setEnabled (bool enabled);
+    static bool isEnabled();
+
+    /** Also samples the call stacks of the counted allocations, which is slow
+        enough to disturb the timing of the blocks */
+    static void setBacktraceSampling (bool enabled);
+    static bool isBacktraceSampling();
+
+    /** Allocations made by processing threads while counting was enabled */
+    static int64 getCount();
+
+    /** Called by the replaced operator new for every allocation */
+    static void allocated();
+};
+
+#endif  // ALLOCATIONCOUNTER_H_INCLUDED
@@ -176,3 +176,15 @@ Array<int> ListSliceParser::parseStringIntoRange(String textBoxInfo, int rangeVa
     }
     return finalList;
 }
+
+
+ChannelMask ListSliceParser::parseStringIntoMask (String textBoxInfo, int rangeValue)
+{
+    ChannelMask mask (rangeValue);
+    Array<int> ranges = parseStringIntoRange (textBoxInfo, rangeValue);
+
+    for (int i = 0; i + 2 < ranges.size(); i += 3)
+        mask.setRange (ranges[i], ranges[i + 1], ranges[i + 2], true);
+
+    return mask;
+}
@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define __LISTSPICEPARSER_H_
 
 #include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Processors/Channel/ChannelMask.h"
 
 class ListSliceParser;
 
@@ -40,6 +41,9 @@ class ListSliceParser
 public:
     static Array<int> parseStringIntoRange (String textBoxInfo,int rangeValue);
 
+    /** The channels the string selects out of rangeValue, as a mask */
+    static ChannelMask parseStringIntoMask (String textBoxInfo, int rangeValue);
+
 
 private:
     static int convertStringToInteger (String s);
@@ -0,0 +1,188 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "MessageThreadMonitor.h"
+#include "Utils.h"
+
+/* Time between two probes of the message loop */
+#define PROBE_INTERVAL_MS 50
+
+/* A probe waiting this long means the message thread is blocked */
+#define STALL_THRESHOLD_MS 250
+
+/* Named tasks that run longer are logged */
+#define LONG_TASK_MS 50
+
+/* Weight of each probe in the mean latency */
+#define LATENCY_SMOOTHING 0.1f
+
+
+MessageThreadMonitor* MessageThreadMonitor::getInstance()
+{
+    static MessageThreadMonitor monitor;
+    return &monitor;
+}
+
+MessageThreadMonitor::MessageThreadMonitor()
+    : Thread ("Message Thread Monitor"),
+      probeCount (0),
+      pendingProbe (0),
+      probeSentMs (0),
+      stallReported (false)
+{
+}
+
+MessageThreadMonitor::~MessageThreadMonitor()
+{
+    stop();
+}
+
+void MessageThreadMonitor::start()
+{
+    if (! isThreadRunning())
+        startThread (2);
+}
+
+void MessageThreadMonitor::stop()
+{
+    stopThread (1000);
+
+    const ScopedLock sl (lock);
+    pendingProbe = 0;
+}
+
+void MessageThreadMonitor::run()
+{
+    while (! threadShouldExit())
+    {
+        const double now = Time::getMillisecondCounterHiRes();
+        uint32 probe = 0;
+        String blockedTask;
+        double blockedMs = 0;
+
+        {
+            const ScopedLock sl (lock);
+
+            if (pendingProbe == 0)
+            {
+                probe = pendingProbe = ++probeCount;
+                probeSentMs = now;
+                stallReported = false;
+            }
+            else if (! stallReported && now - probeSentMs > STALL_THRESHOLD_MS)
+            {
+                stallReported = true;
+                blockedTask = currentTask;
+                blockedMs = now - probeSentMs;
+            }
+        }
+
+        if (probe != 0)
+        {
+            MessageManager::callAsync ([this, probe] { probeReceived (probe); });
+        }
+        else if (blockedMs > 0)
+        {
+            LOGD ("Message thread blocked for ", (int) blockedMs, " ms",
+                  blockedTask.isEmpty() ? String() : " in " + blockedTask);
+        }
+
+        wait (PROBE_INTERVAL_MS);
+    }
+}
+
+void MessageThreadMonitor::probeReceived (uint32 probe)
+{
+    const ScopedLock sl (lock);
+
+    // probes left over from before stop() are ignored
+    if (probe != pendingProbe)
+        return;
+
+    const float latencyMs = float (Time::getMillisecondCounterHiRes() - probeSentMs);
+
+    stats.meanLatencyMs += LATENCY_SMOOTHING * (latencyMs - stats.meanLatencyMs);
+    stats.maxLatencyMs = jmax (stats.maxLatencyMs, latencyMs);
+
+    pendingProbe = 0;
+}
+
+void MessageThreadMonitor::taskFinished (const String& source, double durationMs)
+{
+    if (durationMs < LONG_TASK_MS)
+        return;
+
+    LOGD ("Long message thread task: ", source, " took ", (int) durationMs, " ms");
+
+    const ScopedLock sl (lock);
+
+    stats.longTasks++;
+
+    if (durationMs > stats.worstTaskMs)
+    {
+        stats.worstTask = source;
+        stats.worstTaskMs = float (durationMs);
+    }
+}
+
+MessageThreadMonitor::Stats MessageThreadMonitor::getStats()
+{
+    const ScopedLock sl (lock);
+
+    Stats window = stats;
+
+    // a probe still waiting counts for as long as it has been blocked so far
+    if (pendingProbe != 0)
+        window.maxLatencyMs = jmax (window.maxLatencyMs, float (Time::getMillisecondCounterHiRes() - probeSentMs));
+
+    stats.maxLatencyMs = 0;
+    stats.longTasks = 0;
+    stats.worstTask = String();
+    stats.worstTaskMs = 0;
+
+    return window;
+}
+
+MessageThreadMonitor::ScopedTask::ScopedTask (const String& source)
+    : startMs (Time::getMillisecondCounterHiRes())
+{
+    MessageThreadMonitor* monitor = getInstance();
+
+    const ScopedLock sl (monitor->lock);
+    previousSource = monitor->currentTask;
+    monitor->currentTask = source;
+}
+
+MessageThreadMonitor::ScopedTask::~ScopedTask()
+{
+    MessageThreadMonitor* monitor = getInstance();
+    String source;
+
+    {
+        const ScopedLock sl (monitor->lock);
+        source = monitor->currentTask;
+        monitor->currentTask = previousSource;
+    }
+
+    monitor->taskFinished (source, Time::getMillisecondCounterHiRes() - startMs);
+}
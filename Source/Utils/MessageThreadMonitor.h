@@ -0,0 +1,100 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MESSAGETHREADMONITOR_H_INCLUDED
+#define MESSAGETHREADMONITOR_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+/**
+    Watches how quickly the message thread gets through its queue.
+
+    A background thread posts a probe message at a fixed interval and measures
+    how long it waits before the message loop dispatches it. When a probe is
+    still waiting after the stall threshold, the message thread is blocked, and
+    the task it is running is logged.
+
+    Tasks are named by placing a ScopedTask around the work that may take long
+    on the message thread (visualizer refreshes, signal chain updates, editor
+    updates); any of them that runs past the long task threshold is logged as well.
+    The ControlPanel shows the latency next to the CPU load.
+*/
+class MessageThreadMonitor : private Thread
+{
+public:
+    static MessageThreadMonitor* getInstance();
+
+    /** Starts and stops the probes. Called by the MainWindow. */
+    void start();
+    void stop();
+
+    /** Names the work running on the message thread while the object is in scope */
+    class ScopedTask
+    {
+    public:
+        explicit ScopedTask (const String& source);
+        ~ScopedTask();
+
+    private:
+        String previousSource;
+        double startMs;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedTask);
+    };
+
+    struct Stats
+    {
+        float meanLatencyMs = 0;    // smoothed dispatch delay of the probes
+        float maxLatencyMs = 0;     // longest delay, or blocked time, since the last call
+        int longTasks = 0;          // tasks past the threshold since the last call
+        String worstTask;           // the longest of them, if any
+        float worstTaskMs = 0;
+    };
+
+    /** Returns the latencies and long tasks since the previous call, and starts a new window */
+    Stats getStats();
+
+private:
+    MessageThreadMonitor();
+    ~MessageThreadMonitor();
+
+    void run() override;
+
+    /** Called on the message thread when a probe is dispatched */
+    void probeReceived (uint32 probe);
+
+    void taskFinished (const String& source, double durationMs);
+
+    CriticalSection lock;
+    String currentTask;
+    Stats stats;
+
+    uint32 probeCount;
+    uint32 pendingProbe;        // 0 when no probe is waiting
+    double probeSentMs;
+    bool stallReported;
+
+    JUCE_DECLARE_NON_COPYABLE (MessageThreadMonitor);
+};
+
+#endif  // MESSAGETHREADMONITOR_H_INCLUDED
@@ -0,0 +1,241 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PipelineTrace.h"
+
+#include <atomic>
+
+namespace
+{
+    struct Span
+    {
+        int64 startTicks;
+        int64 endTicks;
+        const char* category;
+        char name[PIPELINE_TRACE_NAME_LENGTH + 1];
+    };
+
+    /** The spans of one thread, written by it alone */
+    struct ThreadRing
+    {
+        ThreadRing() : spans (PIPELINE_TRACE_SPANS_PER_THREAD), count (0), inUse (true) {}
+
+        HeapBlock<Span> spans;
+        std::atomic<uint32> count;
+        std::atomic<bool> inUse;
+
+        uint64 threadId = 0;
+        String threadName;
+    };
+
+    std::atomic<bool> tracingEnabled { false };
+
+    CriticalSection& getRingsLock()
+    {
+        static CriticalSection lock;
+        return lock;
+    }
+
+    OwnedArray<ThreadRing>& getRings()
+    {
+        static OwnedArray<ThreadRing> rings;
+        return rings;
+    }
+
+    /** Hands the ring back when the thread exits, so the next new thread reuses it */
+    struct RingHolder
+    {
+        ThreadRing* ring = nullptr;
+
+        ~RingHolder()
+        {
+            if (ring != nullptr)
+                ring->inUse = false;
+        }
+    };
+
+    thread_local RingHolder ringHolder;
+
+    /** The ring of the calling thread, taken the first time it traces. The spans of
+        the thread that used a reused ring last are kept until they are overwritten. */
+    ThreadRing* getThreadRing()
+    {
+        if (ringHolder.ring != nullptr)
+            return ringHolder.ring;
+
+        const ScopedLock lock (getRingsLock());
+
+        ThreadRing* ring = nullptr;
+
+        for (auto r : getRings())
+        {
+            if (! r->inUse)
+            {
+                ring = r;
+                ring->inUse = true;
+                break;
+            }
+        }
+
+        if (ring == nullptr)
+            ring = getRings().add (new ThreadRing());
+
+        ring->threadId = (uint64) (pointer_sized_int) Thread::getCurrentThreadId();
+
+        if (Thread* thread = Thread::getCurrentThread())
+            ring->threadName = thread->getThreadName();
+        else if (MessageManager::getInstanceWithoutCreating() != nullptr
+                 && MessageManager::getInstanceWithoutCreating()->isThisTheMessageThread())
+            ring->threadName = "Message thread";
+        else
+            ring->threadName = "Audio device thread";
+
+        ringHolder.ring = ring;
+        return ring;
+    }
+
+    void writeSpan (const char* category, const char* name, int64 startTicks, int64 endTicks)
+    {
+        ThreadRing* ring = getThreadRing();
+
+        const uint32 count = ring->count.load (std::memory_order_relaxed);
+        Span& span = ring->spans[count % PIPELINE_TRACE_SPANS_PER_THREAD];
+
+        span.startTicks = startTicks;
+        span.endTicks = endTicks;
+        span.category = category;
+
+        int i = 0;
+        for (; i < PIPELINE_TRACE_NAME_LENGTH && name[i] != 0; i++)
+            span.name[i] = name[i];
+        span.name[i] = 0;
+
+        ring->count.store (count + 1, std::memory_order_release);
+    }
+}
+
+void PipelineTrace::setEnabled (bool enabled)
+{
+    if (enabled && ! tracingEnabled)
+    {
+        const ScopedLock lock (getRingsLock());
+
+        for (auto ring : getRings())
+            ring->count = 0;
+    }
+
+    tracingEnabled = enabled;
+}
+
+bool PipelineTrace::isEnabled()
+{
+    return tracingEnabled.load (std::memory_order_relaxed);
+}
+
+void PipelineTrace::addSpan (const char* category, const char* name, int64 startTicks, int64 endTicks)
+{
+    if (isEnabled())
+        writeSpan (category, name, startTicks, endTicks);
+}
+
+PipelineTrace::Scope::Scope (const char* category_, const char* name_)
+    : category (category_),
+      name (name_),
+      startTicks (isEnabled() ? Time::getHighResolutionTicks() : 0)
+{
+}
+
+PipelineTrace::Scope::Scope (const char* category_, const String& name_)
+    : category (category_),
+      name (nullptr),
+      nameString (name_),
+      startTicks (isEnabled() ? Time::getHighResolutionTicks() : 0)
+{
+}
+
+PipelineTrace::Scope::~Scope()
+{
+    // a scope that started while tracing was off is not traced
+    if (startTicks != 0 && isEnabled())
+        writeSpan (category, name != nullptr ? name : nameString.toRawUTF8(), startTicks, Time::getHighResolutionTicks());
+}
+
+bool PipelineTrace::writeChromeTrace (const File& file)
+{
+    const ScopedLock lock (getRingsLock());
+
+    const double usPerTick = 1.0e6 / (double) Time::getHighResolutionTicksPerSecond();
+
+    // timestamps start at the first span kept
+    int64 firstTicks = std::numeric_limits<int64>::max();
+
+    for (auto ring : getRings())
+    {
+        const uint32 count = ring->count.load (std::memory_order_acquire);
+        const uint32 first = count > PIPELINE_TRACE_SPANS_PER_THREAD ? count - PIPELINE_TRACE_SPANS_PER_THREAD : 0;
+
+        for (uint32 i = first; i < count; i++)
+            firstTicks = jmin (firstTicks, ring->spans[i % PIPELINE_TRACE_SPANS_PER_THREAD].startTicks);
+    }
+
+    file.deleteFile();
+    FileOutputStream out (file);
+
+    if (out.failedToOpen())
+        return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool firstEvent = true;
+
+    auto separator = [&]() -> const char*
+    {
+        const char* s = firstEvent ? "" : ",\n";
+        firstEvent = false;
+        return s;
+    };
+
+    for (auto ring : getRings())
+    {
+        out << separator() << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << (int64) ring->threadId
+            << ",\"name\":\"thread_name\",\"args\":{\"name\":" << JSON::toString (ring->threadName) << "}}";
+
+        const uint32 count = ring->count.load (std::memory_order_acquire);
+        const uint32 first = count > PIPELINE_TRACE_SPANS_PER_THREAD ? count - PIPELINE_TRACE_SPANS_PER_THREAD : 0;
+
+        for (uint32 i = first; i < count; i++)
+        {
+            const Span& span = ring->spans[i % PIPELINE_TRACE_SPANS_PER_THREAD];
+
+            out << separator() << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << (int64) ring->threadId
+                << ",\"cat\":\"" << span.category << "\",\"name\":" << JSON::toString (String (span.name))
+                << ",\"ts\":" << String ((span.startTicks - firstTicks) * usPerTick, 3)
+                << ",\"dur\":" << String ((span.endTicks - span.startTicks) * usPerTick, 3) << "}";
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush();
+
+    return out.getStatus().wasOk();
+}
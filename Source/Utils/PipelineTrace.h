@@ -0,0 +1,87 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PIPELINETRACE_H_INCLUDED
+#define PIPELINETRACE_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Processors/PluginManager/OpenEphysPlugin.h"
+
+/* Spans each thread keeps; older ones are overwritten */
+#define PIPELINE_TRACE_SPANS_PER_THREAD 16384
+/* Longest span name kept, the rest is cut off */
+#define PIPELINE_TRACE_NAME_LENGTH 39
+
+/**
+    Records when the stages of the pipeline ran, on every thread, so a block that
+    overran can be looked at on one timeline next to everything else that was
+    running: the audio callbacks, each processor's block, the DataThreads, the
+    RecordThread write loops, the FileReader's reads and the visualizer paints.
+
+    A stage is traced with a scope:
+
+        TRACE_SCOPE ("record", "write block");
+
+    While tracing is off a scope costs a flag check. While it is on, each thread
+    writes its spans into a ring of its own without locks, and writeChromeTrace()
+    dumps the rings as a Chrome trace, which chrome://tracing and the Perfetto UI
+    open.
+
+    @see CPUBreakdown
+*/
+class PLUGIN_API PipelineTrace
+{
+public:
+    /** Tracing is off by default; turning it on forgets the spans traced before */
+    static void setEnabled (bool enabled);
+    static bool isEnabled();
+
+    /** Writes the spans kept by every thread as a Chrome trace JSON file.
+        Returns false if the file could not be written. */
+    static bool writeChromeTrace (const File& file);
+
+    /** Traces the time from its construction to its destruction */
+    class PLUGIN_API Scope
+    {
+    public:
+        /** The category must be a string literal; the name is copied */
+        Scope (const char* category, const char* name);
+        Scope (const char* category, const String& name);
+        ~Scope();
+
+    private:
+        const char* category;
+        const char* name;
+        String nameString;
+        int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    /** Adds a span that has already ended, for code that times itself */
+    static void addSpan (const char* category, const char* name, int64 startTicks, int64 endTicks);
+};
+
+#define TRACE_SCOPE(category, name) PipelineTrace::Scope JUCE_JOIN_MACRO (traceScope_, __LINE__) (category, name)
+
+#endif  // PIPELINETRACE_H_INCLUDED
@@ -0,0 +1,175 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RealtimeLog.h"
+#include "Utils.h"
+
+#include <atomic>
+#include <sstream>
+
+/* How often the writer looks for new messages */
+#define REALTIME_LOG_POLL_MS 20
+
+namespace
+{
+    /** Bounded multi-producer queue: each slot's sequence tells whether it is free
+        for the producer at a position, or filled for the consumer. It is stored minus
+        the slot's index, so the zero-initialized queue is ready before any static
+        constructor runs. */
+    struct Slot
+    {
+        std::atomic<uint32> sequence;
+        RealtimeLog::Entry entry;
+    };
+
+    Slot slots[REALTIME_LOG_QUEUE_SIZE];
+    std::atomic<uint32> enqueuePosition { 0 };
+    uint32 dequeuePosition = 0;
+    std::atomic<uint32> droppedMessages { 0 };
+
+    bool pop (RealtimeLog::Entry& entry)
+    {
+        const uint32 index = dequeuePosition & (REALTIME_LOG_QUEUE_SIZE - 1);
+        Slot& slot = slots[index];
+
+        if ((int32) (slot.sequence.load (std::memory_order_acquire) + index - (dequeuePosition + 1)) < 0)
+            return false;
+
+        entry = slot.entry;
+        slot.sequence.store (dequeuePosition + REALTIME_LOG_QUEUE_SIZE - index, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+    void write (const RealtimeLog::Entry& entry)
+    {
+        std::ostringstream line;
+
+        for (int i = 0; i < entry.numArgs; i++)
+        {
+            const RealtimeLog::Entry::Arg& arg = entry.args[i];
+
+            switch (arg.type)
+            {
+                case RealtimeLog::Entry::TEXT:      line << (arg.text != nullptr ? arg.text : "(null)"); break;
+                case RealtimeLog::Entry::SIGNED:    line << arg.signedValue; break;
+                case RealtimeLog::Entry::UNSIGNED:  line << arg.unsignedValue; break;
+                case RealtimeLog::Entry::REAL:      line << arg.realValue; break;
+                case RealtimeLog::Entry::BOOLEAN:   line << (arg.signedValue != 0); break;
+                case RealtimeLog::Entry::CHARACTER: line << (char) arg.signedValue; break;
+            }
+        }
+
+        if (entry.truncated)
+            line << " ...";
+
+        LOGD (line.str());
+    }
+
+    /** Writes every queued message; only one thread at a time may drain the queue */
+    void drain()
+    {
+        RealtimeLog::Entry entry;
+
+        while (pop (entry))
+            write (entry);
+
+        if (const uint32 dropped = droppedMessages.exchange (0))
+            LOGD ("[Real-time log] ", dropped, " messages dropped, the queue was full");
+    }
+
+    class Writer : public Thread
+    {
+    public:
+        Writer() : Thread ("Real-time Log") {}
+
+        ~Writer()
+        {
+            stopThread (1000);
+        }
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                drain();
+                wait (REALTIME_LOG_POLL_MS);
+            }
+        }
+    };
+
+    CriticalSection writerLock;
+    ScopedPointer<Writer> writer;
+}
+
+void RealtimeLog::push (const Entry& entry)
+{
+    uint32 position = enqueuePosition.load (std::memory_order_relaxed);
+    uint32 index;
+    Slot* slot;
+
+    while (true)
+    {
+        index = position & (REALTIME_LOG_QUEUE_SIZE - 1);
+        slot = &slots[index];
+        const int32 difference = (int32) (slot->sequence.load (std::memory_order_acquire) + index - position);
+
+        if (difference == 0)
+        {
+            if (enqueuePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // the writer is a whole queue behind
+            droppedMessages.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = enqueuePosition.load (std::memory_order_relaxed);
+        }
+    }
+
+    slot->entry = entry;
+    slot->sequence.store (position + 1 - index, std::memory_order_release);
+}
+
+void RealtimeLog::start()
+{
+    const ScopedLock lock (writerLock);
+
+    if (writer == nullptr)
+    {
+        writer = new Writer();
+        writer->startThread (2);
+    }
+}
+
+void RealtimeLog::stop()
+{
+    const ScopedLock lock (writerLock);
+
+    writer = nullptr;
+    drain();
+}
@@ -0,0 +1,139 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef REALTIMELOG_H_INCLUDED
+#define REALTIMELOG_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Processors/PluginManager/OpenEphysPlugin.h"
+
+#include <type_traits>
+
+/* Messages waiting to be written; more are dropped and counted. A power of two. */
+#define REALTIME_LOG_QUEUE_SIZE 4096
+/* Arguments kept per message; the rest are cut off */
+#define REALTIME_LOG_MAX_ARGS 12
+
+/** Logs like LOGD, from a thread that must not block */
+#define LOGRT(...) \
+    RealtimeLog::log(__VA_ARGS__);
+
+/**
+    Debug logging for the audio, acquisition and recording threads.
+
+    LOGD formats its message and writes it to the console under a lock, which can
+    stall the thread that logs for as long as the console takes. LOGRT takes the
+    same arguments, but only copies them into a lock-free queue: string literals
+    by pointer and numbers by value. A background thread formats and writes the
+    messages in order through the same logger as LOGD.
+
+    Only string literals (or other strings that live as long as the application,
+    such as __FUNCTION__) and numbers can be logged; a juce::String does not compile.
+    If the queue is full the message is dropped, and the writer reports how many
+    were.
+
+    @see OELogger
+*/
+class PLUGIN_API RealtimeLog
+{
+public:
+    /** A logged message, before formatting */
+    struct Entry
+    {
+        enum ArgType : uint8 { TEXT, SIGNED, UNSIGNED, REAL, BOOLEAN, CHARACTER };
+
+        struct Arg
+        {
+            ArgType type;
+            union
+            {
+                const char* text;
+                int64 signedValue;
+                uint64 unsignedValue;
+                double realValue;
+            };
+        };
+
+        int numArgs = 0;
+        bool truncated = false;
+        Arg args[REALTIME_LOG_MAX_ARGS];
+
+        void add (const char* text)     { if (Arg* arg = next (TEXT)) arg->text = text; }
+        void add (bool value)           { if (Arg* arg = next (BOOLEAN)) arg->signedValue = value; }
+        void add (char value)           { if (Arg* arg = next (CHARACTER)) arg->signedValue = value; }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type add (T value)
+        {
+            if (Arg* arg = next (SIGNED)) arg->signedValue = value;
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type add (T value)
+        {
+            if (Arg* arg = next (UNSIGNED)) arg->unsignedValue = value;
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type add (T value)
+        {
+            if (Arg* arg = next (REAL)) arg->realValue = value;
+        }
+
+        /** Strings would have to be copied; log a literal, or use LOGD off the hot path */
+        void add (const String&) = delete;
+
+    private:
+        Arg* next (ArgType type)
+        {
+            if (numArgs == REALTIME_LOG_MAX_ARGS)
+            {
+                truncated = true;
+                return nullptr;
+            }
+
+            args[numArgs].type = type;
+            return &args[numArgs++];
+        }
+    };
+
+    /** Queues a message made of the arguments, which never blocks or allocates */
+    template <typename... Args>
+    static void log (const Args&... args)
+    {
+        Entry entry;
+        (entry.add (args), ...);
+        push (entry);
+    }
+
+    /** Starts the thread that writes the queued messages. Messages logged before are kept. */
+    static void start();
+
+    /** Writes the messages still queued and stops the thread */
+    static void stop();
+
+private:
+    static void push (const Entry& entry);
+};
+
+#endif  // REALTIMELOG_H_INCLUDED
@@ -0,0 +1,213 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RingMemory.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <sys/mman.h>
+#include <unistd.h>
+#elif JUCE_WINDOWS
+#include <windows.h>
+#endif
+
+/* Size of the huge pages that transparent huge pages map on x86-64 and aarch64 */
+#define RING_LARGE_PAGE_SIZE (2 * 1024 * 1024)
+/* Each channel of a ring starts on its own cache line */
+#define RING_CHANNEL_ALIGNMENT 64
+#define RING_PREFAULT_STRIDE 4096
+
+static bool useLargePages = true;
+
+void RingMemory::setUseLargePages (bool shouldUse)
+{
+    useLargePages = shouldUse;
+}
+
+bool RingMemory::getUseLargePages()
+{
+    return useLargePages;
+}
+
+RingMemory::RingMemory()
+    : data          (nullptr)
+    , size          (0)
+    , mappedSize    (0)
+    , largePages    (false)
+    , mapping       (MAPPING_NONE)
+{
+}
+
+RingMemory::~RingMemory()
+{
+    free();
+}
+
+bool RingMemory::allocate (size_t numBytes)
+{
+    free();
+
+    if (numBytes == 0)
+        return true;
+
+#if JUCE_LINUX || JUCE_MAC
+    const bool tryLargePages = JUCE_LINUX && useLargePages && numBytes >= RING_LARGE_PAGE_SIZE / 2;
+    const size_t pageSize = tryLargePages ? RING_LARGE_PAGE_SIZE : (size_t) sysconf (_SC_PAGESIZE);
+    const size_t length = (numBytes + pageSize - 1) / pageSize * pageSize;
+
+    // huge pages only back ranges aligned to their size, so map one page more and trim
+    const size_t slack = tryLargePages ? pageSize : 0;
+    void* block = mmap (nullptr, length + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (block != MAP_FAILED)
+    {
+        char* start = static_cast<char*> (block);
+
+        if (slack > 0)
+        {
+            char* aligned = reinterpret_cast<char*> ((reinterpret_cast<uintptr_t> (start) + pageSize - 1) & ~(uintptr_t) (pageSize - 1));
+
+            if (aligned > start)
+                munmap (start, aligned - start);
+
+            if (aligned + length < start + length + slack)
+                munmap (aligned + length, start + length + slack - (aligned + length));
+
+            start = aligned;
+        }
+
+       #if defined (MADV_HUGEPAGE)
+        if (tryLargePages)
+            largePages = madvise (start, length, MADV_HUGEPAGE) == 0;
+       #endif
+
+        data = start;
+        mappedSize = length;
+        mapping = MAPPING_PAGES;
+    }
+#elif JUCE_WINDOWS
+    // large pages need the "Lock pages in memory" privilege; without it the call fails
+    const size_t largePageSize = useLargePages ? GetLargePageMinimum() : 0;
+
+    if (largePageSize > 0 && numBytes >= largePageSize / 2)
+    {
+        const size_t length = (numBytes + largePageSize - 1) / largePageSize * largePageSize;
+        data = VirtualAlloc (nullptr, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+        if (data != nullptr)
+        {
+            mappedSize = length;
+            largePages = true;
+        }
+    }
+
+    if (data == nullptr)
+    {
+        data = VirtualAlloc (nullptr, numBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        mappedSize = numBytes;
+    }
+
+    if (data != nullptr)
+        mapping = MAPPING_PAGES;
+#endif
+
+    if (data == nullptr)
+    {
+        heapBlock.allocate (numBytes + RING_CHANNEL_ALIGNMENT, true);
+
+        if (heapBlock.getData() == nullptr)
+            return false;
+
+        data = reinterpret_cast<void*> ((reinterpret_cast<uintptr_t> (heapBlock.getData()) + RING_CHANNEL_ALIGNMENT - 1)
+                                        & ~(uintptr_t) (RING_CHANNEL_ALIGNMENT - 1));
+        mappedSize = numBytes;
+        mapping = MAPPING_HEAP;
+    }
+
+    size = numBytes;
+    return true;
+}
+
+float** RingMemory::allocateChannels (int numChannels, int numSamples)
+{
+    const size_t alignedSamples = ((size_t) numSamples * sizeof (float) + RING_CHANNEL_ALIGNMENT - 1)
+                                  / RING_CHANNEL_ALIGNMENT * RING_CHANNEL_ALIGNMENT / sizeof (float);
+
+    if (! allocate (alignedSamples * numChannels * sizeof (float)))
+        return nullptr;
+
+    channelPointers.malloc (numChannels + 1);
+
+    for (int i = 0; i < numChannels; i++)
+        channelPointers[i] = static_cast<float*> (data) + alignedSamples * i;
+
+    channelPointers[numChannels] = nullptr;
+
+    return channelPointers;
+}
+
+int16** RingMemory::allocateInt16Channels (int numChannels, int numSamples)
+{
+    const size_t alignedSamples = ((size_t) numSamples * sizeof (int16) + RING_CHANNEL_ALIGNMENT - 1)
+                                  / RING_CHANNEL_ALIGNMENT * RING_CHANNEL_ALIGNMENT / sizeof (int16);
+
+    if (! allocate (alignedSamples * numChannels * sizeof (int16)))
+        return nullptr;
+
+    int16ChannelPointers.malloc (numChannels + 1);
+
+    for (int i = 0; i < numChannels; i++)
+        int16ChannelPointers[i] = static_cast<int16*> (data) + alignedSamples * i;
+
+    int16ChannelPointers[numChannels] = nullptr;
+
+    return int16ChannelPointers;
+}
+
+void RingMemory::free()
+{
+    if (mapping == MAPPING_PAGES)
+    {
+#if JUCE_LINUX || JUCE_MAC
+        munmap (data, mappedSize);
+#elif JUCE_WINDOWS
+        VirtualFree (data, 0, MEM_RELEASE);
+#endif
+    }
+
+    heapBlock.free();
+
+    data = nullptr;
+    size = 0;
+    mappedSize = 0;
+    largePages = false;
+    mapping = MAPPING_NONE;
+}
+
+void RingMemory::prefault()
+{
+    volatile char* bytes = static_cast<volatile char*> (data);
+
+    // rewrite a byte of each page, which leaves the contents as they were
+    for (size_t i = 0; i < mappedSize; i += RING_PREFAULT_STRIDE)
+        bytes[i] = bytes[i];
+}
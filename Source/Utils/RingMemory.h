@@ -0,0 +1,91 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RINGMEMORY_H_INCLUDED
+#define RINGMEMORY_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+/**
+    Backing memory of the large sample rings that are written on one thread and
+    read on another, like the DataQueue of a RecordNode and the DataBuffer of a source.
+
+    The block is mapped on huge pages where the system allows it, which keeps the
+    ring from thrashing the TLB, and falls back to regular pages otherwise. Pages
+    are placed on the NUMA node of the thread that first touches them, so the
+    consuming thread should call prefault() before the ring is used.
+*/
+class RingMemory
+{
+public:
+    RingMemory();
+    ~RingMemory();
+
+    /** Replaces the block with one of numBytes, zero-filled. Returns false if it could not be allocated */
+    bool allocate (size_t numBytes);
+
+    /** Allocates numChannels rings of numSamples floats, each aligned to a cache line,
+        and returns their pointers, to be handed to AudioSampleBuffer::setDataToReferTo() */
+    float** allocateChannels (int numChannels, int numSamples);
+
+    /** As allocateChannels, for rings of int16 samples */
+    int16** allocateInt16Channels (int numChannels, int numSamples);
+
+    void free();
+
+    void* getData() const       { return data; }
+    size_t getSize() const      { return size; }
+
+    /** True when the block is mapped on huge pages */
+    bool usesLargePages() const { return largePages; }
+
+    /** Writes to every page of the block from the calling thread, so neither side
+        of the ring takes a page fault later and the pages live on this thread's node */
+    void prefault();
+
+    /** Whether new blocks are mapped on huge pages. On by default */
+    static void setUseLargePages (bool shouldUse);
+    static bool getUseLargePages();
+
+private:
+    enum Mapping
+    {
+        MAPPING_NONE = 0,
+        MAPPING_PAGES,          // mmap / VirtualAlloc
+        MAPPING_HEAP            // aligned heap block
+    };
+
+    void* data;
+    size_t size;
+    size_t mappedSize;
+    bool largePages;
+    Mapping mapping;
+
+    HeapBlock<float*> channelPointers;
+    HeapBlock<int16*> int16ChannelPointers;
+    HeapBlock<char> heapBlock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RingMemory);
+};
+
+#endif  // RINGMEMORY_H_INCLUDED
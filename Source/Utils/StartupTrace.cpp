@@ -0,0 +1,60 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "StartupTrace.h"
+#include "Utils.h"
+
+namespace
+{
+    // set during static initialization, as close to the launch as we get
+    const double launchMs = Time::getMillisecondCounterHiRes();
+
+    double lastMarkMs = launchMs;
+    StringArray phases;
+    bool finished = false;
+}
+
+void StartupTrace::mark(const String& phase)
+{
+    if (finished)
+        return;
+
+    const double now = Time::getMillisecondCounterHiRes();
+    const int phaseMs = roundToInt(now - lastMarkMs);
+
+    LOGD("[Startup] ", phase, ": ", phaseMs, " ms");
+
+    phases.add(phase + " " + String(phaseMs) + " ms");
+    lastMarkMs = now;
+}
+
+void StartupTrace::finish()
+{
+    if (finished)
+        return;
+
+    mark("first message loop");
+    finished = true;
+
+    LOGD("[Startup] Ready after ", roundToInt(lastMarkMs - launchMs), " ms (", phases.joinIntoString(", "), ")");
+}
@@ -0,0 +1,46 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef STARTUPTRACE_H_INCLUDED
+#define STARTUPTRACE_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+/**
+    Times the phases of startup, from the launch of the application to the
+    first turn of the message loop once the main window is built.
+
+    Each call to mark() closes a phase, named after the work done since the
+    previous mark, and finish() logs all of them with the total.
+*/
+class StartupTrace
+{
+public:
+    /** Ends the current phase and logs how long it took */
+    static void mark(const String& phase);
+
+    /** Logs the total startup time and the phases; later marks are ignored */
+    static void finish();
+};
+
+#endif  // STARTUPTRACE_H_INCLUDED
@@ -0,0 +1,267 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ThreadConfig.h"
+
+/* Thread affinity masks are 32 bits wide */
+#define THREAD_MAX_CORES 32
+
+namespace
+{
+    const int defaultPriorities[ThreadConfig::NUM_ROLES] =
+    {
+        THREAD_DEFAULT_PRIORITY,    // audio: the device driver's own
+        THREAD_REALTIME_PRIORITY,   // acquisition
+        5,                          // record I/O
+        THREAD_REALTIME_PRIORITY,   // compute pool, like the audio thread it works for
+        THREAD_DEFAULT_PRIORITY     // UI
+    };
+
+    Atomic<int> priorities[ThreadConfig::NUM_ROLES] =
+    {
+        Atomic<int> (defaultPriorities[0]), Atomic<int> (defaultPriorities[1]),
+        Atomic<int> (defaultPriorities[2]), Atomic<int> (defaultPriorities[3]),
+        Atomic<int> (defaultPriorities[4])
+    };
+    Atomic<uint32> cores[ThreadConfig::NUM_ROLES];
+    Atomic<int> isolateAcquisition;
+
+    /* Bumped on every change, so threads only reapply their settings when needed */
+    Atomic<int> generation (1);
+
+    uint32 getAllCores()
+    {
+        const int numCores = jmin (SystemStats::getNumCpus(), THREAD_MAX_CORES);
+        return numCores >= THREAD_MAX_CORES ? 0xffffffff : (uint32 (1) << numCores) - 1;
+    }
+
+    void settingsChanged()
+    {
+        ++generation;
+
+        if (MessageManager::getInstanceWithoutCreating() != nullptr
+            && MessageManager::getInstanceWithoutCreating()->isThisTheMessageThread())
+            ThreadConfig::applyToCurrentThread (ThreadConfig::UI);
+    }
+}
+
+
+String ThreadConfig::getRoleName (Role role)
+{
+    switch (role)
+    {
+        case AUDIO:         return "Audio";
+        case ACQUISITION:   return "Acquisition";
+        case RECORD_IO:     return "Record I/O";
+        case COMPUTE_POOL:  return "Compute pool";
+        case UI:            return "UI";
+        default:            return String();
+    }
+}
+
+
+void ThreadConfig::setPriority (Role role, int priority)
+{
+    priorities[role] = jlimit (THREAD_DEFAULT_PRIORITY, THREAD_REALTIME_PRIORITY, priority);
+    settingsChanged();
+}
+
+
+int ThreadConfig::getPriority (Role role)
+{
+    return priorities[role].get();
+}
+
+
+void ThreadConfig::setCores (Role role, uint32 coreMask)
+{
+    cores[role] = coreMask;
+    settingsChanged();
+}
+
+
+uint32 ThreadConfig::getCores (Role role)
+{
+    return cores[role].get();
+}
+
+
+void ThreadConfig::setIsolateAcquisition (bool isolate)
+{
+    isolateAcquisition = isolate ? 1 : 0;
+    settingsChanged();
+}
+
+
+bool ThreadConfig::getIsolateAcquisition()
+{
+    return isolateAcquisition.get() != 0;
+}
+
+
+uint32 ThreadConfig::getEffectiveCores (Role role)
+{
+    uint32 mask = cores[role].get();
+
+    if (mask == 0 && role != ACQUISITION && getIsolateAcquisition())
+    {
+        const uint32 acquisitionCores = cores[ACQUISITION].get();
+
+        // never leave a role without a core to run on
+        if (acquisitionCores != 0 && (getAllCores() & ~acquisitionCores) != 0)
+            mask = getAllCores() & ~acquisitionCores;
+    }
+
+    return mask;
+}
+
+
+void ThreadConfig::startThread (Thread& thread, Role role)
+{
+    const int priority = getPriority (role);
+
+    thread.setAffinityMask (getEffectiveCores (role));
+    thread.startThread (priority == THREAD_DEFAULT_PRIORITY ? 5 : priority);
+}
+
+
+void ThreadConfig::applyToCurrentThread (Role role)
+{
+    static thread_local int appliedGeneration = 0;
+
+    const int current = generation.get();
+
+    if (appliedGeneration == current)
+        return;
+
+    appliedGeneration = current;
+
+    const uint32 mask = getEffectiveCores (role);
+    Thread::setCurrentThreadAffinityMask (mask != 0 ? mask : getAllCores());
+
+    const int priority = getPriority (role);
+
+    if (priority != THREAD_DEFAULT_PRIORITY)
+        Thread::setCurrentThreadPriority (priority);
+}
+
+
+void ThreadConfig::reset()
+{
+    for (int role = 0; role < NUM_ROLES; role++)
+    {
+        priorities[role] = defaultPriorities[role];
+        cores[role] = 0;
+    }
+
+    isolateAcquisition = 0;
+    settingsChanged();
+}
+
+
+uint32 ThreadConfig::parseCores (const String& text)
+{
+    uint32 mask = 0;
+
+    StringArray items;
+    items.addTokens (text.trim(), ",; ", "");
+    items.removeEmptyStrings();
+
+    for (auto& item : items)
+    {
+        if (item.equalsIgnoreCase ("all"))
+            return 0;
+
+        int first = item.upToFirstOccurrenceOf ("-", false, false).getIntValue();
+        int last = item.contains ("-") ? item.fromFirstOccurrenceOf ("-", false, false).getIntValue() : first;
+
+        first = jlimit (0, THREAD_MAX_CORES - 1, first);
+        last = jlimit (first, THREAD_MAX_CORES - 1, last);
+
+        for (int core = first; core <= last; core++)
+            mask |= uint32 (1) << core;
+    }
+
+    return mask;
+}
+
+
+String ThreadConfig::coresToString (uint32 coreMask)
+{
+    if (coreMask == 0)
+        return "all";
+
+    StringArray ranges;
+
+    for (int core = 0; core < THREAD_MAX_CORES; core++)
+    {
+        if ((coreMask & (uint32 (1) << core)) == 0)
+            continue;
+
+        int last = core;
+        while (last + 1 < THREAD_MAX_CORES && (coreMask & (uint32 (1) << (last + 1))) != 0)
+            last++;
+
+        ranges.add (last > core ? String (core) + "-" + String (last) : String (core));
+        core = last;
+    }
+
+    return ranges.joinIntoString (",");
+}
+
+
+void ThreadConfig::saveStateToXml (XmlElement* parentElement)
+{
+    XmlElement* threads = parentElement->createNewChildElement ("THREADS");
+    threads->setAttribute ("isolateAcquisition", getIsolateAcquisition());
+
+    for (int role = 0; role < NUM_ROLES; role++)
+    {
+        XmlElement* roleElement = threads->createNewChildElement ("ROLE");
+        roleElement->setAttribute ("name", getRoleName (Role (role)));
+        roleElement->setAttribute ("priority", getPriority (Role (role)));
+        roleElement->setAttribute ("cores", coresToString (getCores (Role (role))));
+    }
+}
+
+
+void ThreadConfig::loadStateFromXml (XmlElement* threadsElement)
+{
+    isolateAcquisition = threadsElement->getBoolAttribute ("isolateAcquisition", false) ? 1 : 0;
+
+    forEachXmlChildElementWithTagName (*threadsElement, roleElement, "ROLE")
+    {
+        for (int role = 0; role < NUM_ROLES; role++)
+        {
+            if (roleElement->getStringAttribute ("name") != getRoleName (Role (role)))
+                continue;
+
+            priorities[role] = jlimit (THREAD_DEFAULT_PRIORITY, THREAD_REALTIME_PRIORITY,
+                                       roleElement->getIntAttribute ("priority", defaultPriorities[role]));
+            cores[role] = parseCores (roleElement->getStringAttribute ("cores"));
+        }
+    }
+
+    settingsChanged();
+}
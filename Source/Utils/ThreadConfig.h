@@ -0,0 +1,98 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef THREADCONFIG_H_INCLUDED
+#define THREADCONFIG_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../Processors/PluginManager/OpenEphysPlugin.h"
+
+/* Leaves the priority a thread was created with */
+#define THREAD_DEFAULT_PRIORITY -1
+/* Thread priorities run from 0 to this; on Linux and macOS it selects real-time scheduling */
+#define THREAD_REALTIME_PRIORITY 10
+
+/**
+    Application-wide scheduling of the threads, by the role they play.
+
+    Each role has a priority, from 0 to THREAD_REALTIME_PRIORITY or
+    THREAD_DEFAULT_PRIORITY to leave it alone, and a mask of the cores its
+    threads may run on, 0 for any. Threads started through startThread() take
+    the settings of their role when they start; long-lived threads call
+    applyToCurrentThread() from their loop to pick up later changes.
+
+    With isolation on, threads of the other roles that could run on any core
+    keep off the acquisition cores, so they are left to the acquisition threads
+    on machines shared with other work.
+
+    The settings are saved with the signal chain.
+
+    @see ThreadSettingsWindow, DataThread
+*/
+class PLUGIN_API ThreadConfig
+{
+public:
+    enum Role
+    {
+        AUDIO = 0,          // the audio callback that runs the ProcessorGraph
+        ACQUISITION,        // the DataThreads and their subprocessor readers
+        RECORD_IO,          // recording writers and file playback readers
+        COMPUTE_POOL,       // the ChannelWorkerPool and other processing workers
+        UI,                 // the message thread
+        NUM_ROLES
+    };
+
+    static String getRoleName (Role role);
+
+    static void setPriority (Role role, int priority);
+    static int getPriority (Role role);
+
+    static void setCores (Role role, uint32 coreMask);
+    static uint32 getCores (Role role);
+
+    static void setIsolateAcquisition (bool isolate);
+    static bool getIsolateAcquisition();
+
+    /** The cores the threads of a role run on, after isolation; 0 for any */
+    static uint32 getEffectiveCores (Role role);
+
+    /** Starts a thread with the settings of its role */
+    static void startThread (Thread& thread, Role role);
+
+    /** Applies the settings of its role to the calling thread, if they changed since
+        the last call from this thread. Cheap enough to call for every block. */
+    static void applyToCurrentThread (Role role);
+
+    /** Restores the defaults of every role */
+    static void reset();
+
+    /** Parses a list of cores such as "0,2-3"; empty or "all" is 0 */
+    static uint32 parseCores (const String& text);
+    static String coresToString (uint32 coreMask);
+
+    static void saveStateToXml (XmlElement* parentElement);
+    static void loadStateFromXml (XmlElement* threadsElement);
+};
+
+#endif  // THREADCONFIG_H_INCLUDED
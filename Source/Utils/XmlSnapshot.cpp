@@ -0,0 +1,236 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "XmlSnapshot.h"
+
+#define XML_SNAPSHOT_MAGIC 0x4e53454f     // "OESN"
+#define XML_SNAPSHOT_VERSION 1
+/* Deepest nesting a snapshot may have; deeper files are treated as corrupt */
+#define XML_SNAPSHOT_MAX_DEPTH 256
+
+/* An element is written as its tag index + 1, its attributes and its children;
+   a tag index of 0 marks a text element, followed by the index of its text */
+#define XML_SNAPSHOT_TEXT_ELEMENT 0
+
+
+namespace
+{
+    class StringTable
+    {
+    public:
+        int add (const String& text)
+        {
+            if (indices.contains (text))
+                return indices[text];
+
+            const int index = strings.size();
+            strings.add (text);
+            indices.set (text, index);
+            return index;
+        }
+
+        StringArray strings;
+
+    private:
+        HashMap<String, int> indices;
+    };
+
+    void writeElement (const XmlElement& element, StringTable& table, OutputStream& out)
+    {
+        if (element.isTextElement())
+        {
+            out.writeCompressedInt (XML_SNAPSHOT_TEXT_ELEMENT);
+            out.writeCompressedInt (table.add (element.getText()));
+            return;
+        }
+
+        out.writeCompressedInt (table.add (element.getTagName()) + 1);
+
+        const int numAttributes = element.getNumAttributes();
+        out.writeCompressedInt (numAttributes);
+
+        for (int i = 0; i < numAttributes; ++i)
+        {
+            out.writeCompressedInt (table.add (element.getAttributeName (i)));
+            out.writeCompressedInt (table.add (element.getAttributeValue (i)));
+        }
+
+        int numChildren = 0;
+        for (const XmlElement* child = element.getFirstChildElement(); child != nullptr; child = child->getNextElement())
+            ++numChildren;
+
+        out.writeCompressedInt (numChildren);
+
+        for (const XmlElement* child = element.getFirstChildElement(); child != nullptr; child = child->getNextElement())
+            writeElement (*child, table, out);
+    }
+
+    bool readIndex (InputStream& in, const StringArray& strings, int& index)
+    {
+        if (in.isExhausted())
+            return false;
+
+        index = in.readCompressedInt();
+        return isPositiveAndBelow (index, strings.size());
+    }
+
+    XmlElement* readElement (InputStream& in, const StringArray& strings, int depth)
+    {
+        if (depth > XML_SNAPSHOT_MAX_DEPTH || in.isExhausted())
+            return nullptr;
+
+        const int tag = in.readCompressedInt();
+        int index;
+
+        if (tag == XML_SNAPSHOT_TEXT_ELEMENT)
+            return readIndex (in, strings, index) ? XmlElement::createTextElement (strings[index]) : nullptr;
+
+        if (! isPositiveAndBelow (tag - 1, strings.size()))
+            return nullptr;
+
+        ScopedPointer<XmlElement> element = new XmlElement (strings[tag - 1]);
+
+        const int numAttributes = in.readCompressedInt();
+
+        for (int i = 0; i < numAttributes; ++i)
+        {
+            int value;
+
+            if (! readIndex (in, strings, index) || ! readIndex (in, strings, value))
+                return nullptr;
+
+            element->setAttribute (strings[index], strings[value]);
+        }
+
+        const int numChildren = in.readCompressedInt();
+
+        for (int i = 0; i < numChildren; ++i)
+        {
+            XmlElement* child = readElement (in, strings, depth + 1);
+
+            if (child == nullptr)
+                return nullptr;
+
+            element->addChildElement (child);
+        }
+
+        return element.release();
+    }
+}
+
+
+File XmlSnapshot::getSnapshotFile (const File& xmlFile)
+{
+    return xmlFile.withFileExtension ("snapshot");
+}
+
+
+bool XmlSnapshot::writeToFile (const XmlElement& xml, const File& file)
+{
+    StringTable table;
+    MemoryOutputStream elements;
+    writeElement (xml, table, elements);
+
+    TemporaryFile temp (file);
+
+    {
+        FileOutputStream out (temp.getFile());
+
+        if (out.failedToOpen())
+            return false;
+
+        out.writeInt (XML_SNAPSHOT_MAGIC);
+        out.writeInt (XML_SNAPSHOT_VERSION);
+        out.writeCompressedInt (table.strings.size());
+
+        for (int i = 0; i < table.strings.size(); ++i)
+            out.writeString (table.strings[i]);
+
+        out << elements;
+        out.flush();
+
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+
+XmlElement* XmlSnapshot::readFromFile (const File& file)
+{
+    MemoryMappedFile mapped (file, MemoryMappedFile::readOnly);
+
+    if (mapped.getData() == nullptr)
+        return nullptr;
+
+    MemoryInputStream in (mapped.getData(), mapped.getSize(), false);
+
+    if (in.readInt() != XML_SNAPSHOT_MAGIC || in.readInt() != XML_SNAPSHOT_VERSION)
+        return nullptr;
+
+    const int numStrings = in.readCompressedInt();
+
+    if (numStrings < 0)
+        return nullptr;
+
+    StringArray strings;
+    strings.ensureStorageAllocated (numStrings);
+
+    for (int i = 0; i < numStrings && ! in.isExhausted(); ++i)
+        strings.add (in.readString());
+
+    if (strings.size() != numStrings)
+        return nullptr;
+
+    return readElement (in, strings, 0);
+}
+
+
+bool XmlSnapshot::writeConfig (const XmlElement& xml, const File& xmlFile)
+{
+    if (! xml.writeToFile (xmlFile, String::empty))
+        return false;
+
+    // written after the XML, so it is never older than the file it copies
+    if (! writeToFile (xml, getSnapshotFile (xmlFile)))
+        getSnapshotFile (xmlFile).deleteFile();
+
+    return true;
+}
+
+
+XmlElement* XmlSnapshot::readConfig (const File& xmlFile)
+{
+    const File snapshot = getSnapshotFile (xmlFile);
+
+    if (xmlFile.existsAsFile() && snapshot.existsAsFile()
+        && snapshot.getLastModificationTime() >= xmlFile.getLastModificationTime())
+    {
+        if (XmlElement* xml = readFromFile (snapshot))
+            return xml;
+    }
+
+    XmlDocument doc (xmlFile);
+    return doc.getDocumentElement();
+}
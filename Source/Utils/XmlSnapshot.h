@@ -0,0 +1,58 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef XMLSNAPSHOT_H_INCLUDED
+#define XMLSNAPSHOT_H_INCLUDED
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+/**
+    A compact binary copy of an XML document, restored without parsing any text.
+
+    The GUI keeps one next to each configuration it saves for itself (the last
+    and the recovery configuration), so it can restart from them quickly. Every
+    tag, attribute and text is stored once in a string table, and the elements
+    refer to it by index, which keeps the per-channel parameters of large
+    configurations small. The XML file stays the reference: a snapshot older
+    than its XML file is ignored.
+*/
+class XmlSnapshot
+{
+public:
+    /** The snapshot kept next to an XML file */
+    static File getSnapshotFile (const File& xmlFile);
+
+    /** Writes the snapshot of an element, replacing the file only once it is complete */
+    static bool writeToFile (const XmlElement& xml, const File& file);
+
+    /** Maps a snapshot file and rebuilds its element, or returns nullptr if it isn't valid */
+    static XmlElement* readFromFile (const File& file);
+
+    /** Writes an XML file and its snapshot */
+    static bool writeConfig (const XmlElement& xml, const File& xmlFile);
+
+    /** Reads an XML file, from its snapshot when that is at least as recent */
+    static XmlElement* readConfig (const File& xmlFile);
+};
+
+#endif  // XMLSNAPSHOT_H_INCLUDED